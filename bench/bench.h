@@ -0,0 +1,67 @@
+#ifndef AWS_HTTP_BENCH_H
+#define AWS_HTTP_BENCH_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/common/common.h>
+
+/**
+ * State for one benchmark. The harness sets allocator, which counts every allocation made through it,
+ * and setup sets bytes_per_op and impl.
+ */
+struct bench_context {
+    struct aws_allocator *allocator;
+    /* Input or output bytes processed by one operation, for throughput. 0 if throughput is meaningless */
+    size_t bytes_per_op;
+    /* File to read input from, for the replay benchmark. NULL for the others */
+    const char *input_path;
+    void *impl;
+};
+
+/**
+ * A benchmark repeats run_op() as many times as fit in the measuring time.
+ * Anything run_op() allocates is counted towards allocations/op.
+ */
+struct bench {
+    const char *name;
+    int (*setup)(struct bench_context *ctx);
+    int (*run_op)(struct bench_context *ctx);
+    void (*clean_up)(struct bench_context *ctx);
+};
+
+/* Each codec's file defines its benchmarks */
+extern const struct bench g_h1_benches[];
+extern const size_t g_h1_bench_count;
+extern const struct bench g_h2_benches[];
+extern const size_t g_h2_bench_count;
+extern const struct bench g_hpack_benches[];
+extern const size_t g_hpack_bench_count;
+extern const struct bench g_websocket_benches[];
+extern const size_t g_websocket_bench_count;
+
+/**
+ * Replays a traffic capture (see aws_http_traffic_capture_options) through the HTTP/1.1, HTTP/2 and WebSocket
+ * decoders. Run once per capture file, with the file as the context's input_path.
+ */
+extern const struct bench g_replay_bench;
+
+/**
+ * Writes what the server sent in an HTTP/2 capture to corpus_dir, as a seed for the fuzz tests in tests/fuzz.
+ * Does nothing for other captures.
+ */
+int bench_replay_write_corpus(struct aws_allocator *allocator, const char *capture_path, const char *corpus_dir);
+
+/**
+ * Realistic header sets, shared by the codecs.
+ * Names and values are as a browser or an SDK client would send them, and as a typical server would answer.
+ */
+struct aws_http_header;
+extern const struct aws_http_header g_bench_request_headers[];
+extern const size_t g_bench_request_header_count;
+extern const struct aws_http_header g_bench_response_headers[];
+extern const size_t g_bench_response_header_count;
+
+#endif /* AWS_HTTP_BENCH_H */
@@ -0,0 +1,298 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "bench.h"
+
+#include <aws/http/private/h1_decoder.h>
+#include <aws/http/private/h1_encoder.h>
+#include <aws/http/request_response.h>
+#include <aws/io/stream.h>
+
+#define BODY_SIZE (16 * 1024)
+
+static struct aws_byte_cursor s_find_pseudo_header(
+    const struct aws_http_header *headers,
+    size_t count,
+    const char *name) {
+
+    for (size_t i = 0; i < count; ++i) {
+        if (aws_byte_cursor_eq_c_str(&headers[i].name, name)) {
+            return headers[i].value;
+        }
+    }
+    return aws_byte_cursor_from_c_str("");
+}
+
+static bool s_is_pseudo_header(const struct aws_http_header *header) {
+    return header->name.len > 0 && header->name.ptr[0] == ':';
+}
+
+/* Writes the HTTP/1.1 form of the shared header sets */
+static int s_append_h1_headers(struct aws_byte_buf *buf, const struct aws_http_header *headers, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (s_is_pseudo_header(&headers[i])) {
+            continue;
+        }
+        struct aws_byte_cursor colon = aws_byte_cursor_from_c_str(": ");
+        struct aws_byte_cursor crlf = aws_byte_cursor_from_c_str("\r\n");
+        if (aws_byte_buf_append_dynamic(buf, &headers[i].name) || aws_byte_buf_append_dynamic(buf, &colon) ||
+            aws_byte_buf_append_dynamic(buf, &headers[i].value) || aws_byte_buf_append_dynamic(buf, &crlf)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Decoding
+ */
+
+struct h1_decode_state {
+    struct aws_h1_decoder *decoder;
+    struct aws_byte_buf input;
+};
+
+static int s_on_header(const struct aws_h1_decoded_header *header, void *user_data) {
+    (void)header;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_body(const struct aws_byte_cursor *data, bool finished, void *user_data) {
+    (void)data;
+    (void)finished;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_request(
+    enum aws_http_method method_enum,
+    const struct aws_byte_cursor *method_str,
+    const struct aws_byte_cursor *uri,
+    void *user_data) {
+
+    (void)method_enum;
+    (void)method_str;
+    (void)uri;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_response(int status_code, void *user_data) {
+    (void)status_code;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_done(void *user_data) {
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_h1_decode_setup(struct bench_context *ctx, bool is_request) {
+    struct h1_decode_state *state = aws_mem_calloc(ctx->allocator, 1, sizeof(struct h1_decode_state));
+    ctx->impl = state;
+    aws_byte_buf_init(&state->input, ctx->allocator, BODY_SIZE + 1024);
+
+    if (is_request) {
+        struct aws_byte_cursor path =
+            s_find_pseudo_header(g_bench_request_headers, g_bench_request_header_count, ":path");
+        struct aws_byte_cursor authority =
+            s_find_pseudo_header(g_bench_request_headers, g_bench_request_header_count, ":authority");
+        struct aws_byte_cursor get = aws_byte_cursor_from_c_str("GET ");
+        struct aws_byte_cursor host = aws_byte_cursor_from_c_str(" HTTP/1.1\r\nHost: ");
+        struct aws_byte_cursor crlf = aws_byte_cursor_from_c_str("\r\n");
+        if (aws_byte_buf_append_dynamic(&state->input, &get) || aws_byte_buf_append_dynamic(&state->input, &path) ||
+            aws_byte_buf_append_dynamic(&state->input, &host) ||
+            aws_byte_buf_append_dynamic(&state->input, &authority) ||
+            aws_byte_buf_append_dynamic(&state->input, &crlf) ||
+            s_append_h1_headers(&state->input, g_bench_request_headers, g_bench_request_header_count) ||
+            aws_byte_buf_append_dynamic(&state->input, &crlf)) {
+            return AWS_OP_ERR;
+        }
+    } else {
+        struct aws_byte_cursor status = aws_byte_cursor_from_c_str("HTTP/1.1 200 OK\r\n");
+        struct aws_byte_cursor length = aws_byte_cursor_from_c_str("Content-Length: 16384\r\n\r\n");
+        if (aws_byte_buf_append_dynamic(&state->input, &status) ||
+            s_append_h1_headers(&state->input, g_bench_response_headers, g_bench_response_header_count) ||
+            aws_byte_buf_append_dynamic(&state->input, &length)) {
+            return AWS_OP_ERR;
+        }
+        if (!aws_byte_buf_write_u8_n(&state->input, 'x', BODY_SIZE)) {
+            return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
+        }
+    }
+
+    struct aws_h1_decoder_params params = {
+        .alloc = ctx->allocator,
+        .scratch_space_initial_size = 256,
+        .is_decoding_requests = is_request,
+        .vtable =
+            {
+                .on_header = s_on_header,
+                .on_body = s_on_body,
+                .on_request = s_on_request,
+                .on_response = s_on_response,
+                .on_done = s_on_done,
+            },
+    };
+    state->decoder = aws_h1_decoder_new(&params);
+    if (!state->decoder) {
+        return AWS_OP_ERR;
+    }
+
+    ctx->bytes_per_op = state->input.len;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_h1_decode_request_setup(struct bench_context *ctx) {
+    return s_h1_decode_setup(ctx, true /*is_request*/);
+}
+
+static int s_h1_decode_response_setup(struct bench_context *ctx) {
+    return s_h1_decode_setup(ctx, false /*is_request*/);
+}
+
+static int s_h1_decode_run_op(struct bench_context *ctx) {
+    struct h1_decode_state *state = ctx->impl;
+    struct aws_byte_cursor input = aws_byte_cursor_from_buf(&state->input);
+    while (input.len > 0) {
+        if (aws_h1_decode(state->decoder, &input)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static void s_h1_decode_clean_up(struct bench_context *ctx) {
+    struct h1_decode_state *state = ctx->impl;
+    if (state) {
+        aws_h1_decoder_destroy(state->decoder);
+        aws_byte_buf_clean_up(&state->input);
+        aws_mem_release(ctx->allocator, state);
+    }
+}
+
+/*
+ * Encoding
+ */
+
+struct h1_encode_state {
+    struct aws_http_message *request;
+    struct aws_byte_buf body;
+    struct aws_input_stream *body_stream;
+    struct aws_h1_encoder encoder;
+    struct aws_byte_buf output;
+    struct aws_linked_list chunk_list;
+};
+
+static int s_h1_encode_setup(struct bench_context *ctx, bool has_body) {
+    struct h1_encode_state *state = aws_mem_calloc(ctx->allocator, 1, sizeof(struct h1_encode_state));
+    ctx->impl = state;
+    aws_h1_encoder_init(&state->encoder, ctx->allocator);
+    aws_linked_list_init(&state->chunk_list);
+    aws_byte_buf_init(&state->output, ctx->allocator, 4096);
+
+    state->request = aws_http_message_new_request(ctx->allocator);
+    if (!state->request) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor path = s_find_pseudo_header(g_bench_request_headers, g_bench_request_header_count, ":path");
+    struct aws_byte_cursor authority =
+        s_find_pseudo_header(g_bench_request_headers, g_bench_request_header_count, ":authority");
+    if (aws_http_message_set_request_method(state->request, has_body ? aws_http_method_put : aws_http_method_get) ||
+        aws_http_message_set_request_path(state->request, path) ||
+        aws_http_message_add_header(
+            state->request, (struct aws_http_header){.name = aws_byte_cursor_from_c_str("Host"), .value = authority})) {
+        return AWS_OP_ERR;
+    }
+
+    for (size_t i = 0; i < g_bench_request_header_count; ++i) {
+        if (!s_is_pseudo_header(&g_bench_request_headers[i]) &&
+            aws_http_message_add_header(state->request, g_bench_request_headers[i])) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    if (has_body) {
+        aws_byte_buf_init(&state->body, ctx->allocator, BODY_SIZE);
+        aws_byte_buf_write_u8_n(&state->body, 'x', BODY_SIZE);
+        struct aws_byte_cursor body_cursor = aws_byte_cursor_from_buf(&state->body);
+        state->body_stream = aws_input_stream_new_from_cursor(ctx->allocator, &body_cursor);
+        if (!state->body_stream ||
+            aws_http_message_add_header(
+                state->request,
+                (struct aws_http_header){
+                    .name = aws_byte_cursor_from_c_str("Content-Length"),
+                    .value = aws_byte_cursor_from_c_str("16384"),
+                })) {
+            return AWS_OP_ERR;
+        }
+        aws_http_message_set_body_stream(state->request, state->body_stream);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_h1_encode_request_setup(struct bench_context *ctx) {
+    return s_h1_encode_setup(ctx, false /*has_body*/);
+}
+
+static int s_h1_encode_request_with_body_setup(struct bench_context *ctx) {
+    return s_h1_encode_setup(ctx, true /*has_body*/);
+}
+
+static int s_h1_encode_run_op(struct bench_context *ctx) {
+    struct h1_encode_state *state = ctx->impl;
+    if (state->body_stream && aws_input_stream_seek(state->body_stream, 0, AWS_SSB_BEGIN)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_h1_encoder_message message;
+    if (aws_h1_encoder_message_init_from_request(&message, ctx->allocator, state->request, &state->chunk_list)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+    if (aws_h1_encoder_start_message(&state->encoder, &message, NULL /*stream*/)) {
+        goto done;
+    }
+
+    size_t bytes_encoded = 0;
+    while (aws_h1_encoder_is_message_in_progress(&state->encoder)) {
+        state->output.len = 0;
+        if (aws_h1_encoder_process(&state->encoder, &state->output)) {
+            goto done;
+        }
+        bytes_encoded += state->output.len;
+    }
+    ctx->bytes_per_op = bytes_encoded;
+    result = AWS_OP_SUCCESS;
+
+done:
+    aws_h1_encoder_message_clean_up(&message);
+    return result;
+}
+
+static void s_h1_encode_clean_up(struct bench_context *ctx) {
+    struct h1_encode_state *state = ctx->impl;
+    if (state) {
+        aws_http_message_release(state->request);
+        aws_input_stream_release(state->body_stream);
+        aws_byte_buf_clean_up(&state->body);
+        aws_byte_buf_clean_up(&state->output);
+        aws_h1_encoder_clean_up(&state->encoder);
+        aws_mem_release(ctx->allocator, state);
+    }
+}
+
+const struct bench g_h1_benches[] = {
+    {"h1_decode_request", s_h1_decode_request_setup, s_h1_decode_run_op, s_h1_decode_clean_up},
+    {"h1_decode_response_16KiB_body", s_h1_decode_response_setup, s_h1_decode_run_op, s_h1_decode_clean_up},
+    {"h1_encode_request", s_h1_encode_request_setup, s_h1_encode_run_op, s_h1_encode_clean_up},
+    {"h1_encode_request_16KiB_body", s_h1_encode_request_with_body_setup, s_h1_encode_run_op, s_h1_encode_clean_up},
+};
+const size_t g_h1_bench_count = AWS_ARRAY_SIZE(g_h1_benches);
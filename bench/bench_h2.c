@@ -0,0 +1,262 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "bench.h"
+
+#include <aws/http/private/h2_decoder.h>
+#include <aws/http/private/h2_frames.h>
+#include <aws/http/request_response.h>
+#include <aws/io/stream.h>
+
+#define BODY_SIZE (16 * 1024)
+#define STREAM_ID 1
+
+static struct aws_http_headers *s_new_headers(
+    struct aws_allocator *allocator,
+    const struct aws_http_header *array,
+    size_t count) {
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    if (headers && aws_http_headers_add_array(headers, array, count)) {
+        aws_http_headers_release(headers);
+        return NULL;
+    }
+    return headers;
+}
+
+/* Encodes a whole HEADERS frame, appending it to output */
+static int s_encode_headers_frame(
+    struct aws_h2_frame_encoder *encoder,
+    const struct aws_http_headers *headers,
+    bool end_stream,
+    struct aws_byte_buf *output) {
+
+    struct aws_h2_frame *frame = aws_h2_frame_new_headers(
+        encoder->allocator, STREAM_ID, headers, end_stream, 0 /*pad_length*/, NULL /*optional_priority*/);
+    if (!frame) {
+        return AWS_OP_ERR;
+    }
+
+    bool frame_complete = false;
+    int result = AWS_OP_SUCCESS;
+    while (!frame_complete && result == AWS_OP_SUCCESS) {
+        if (output->capacity - output->len < 256) {
+            result = aws_byte_buf_reserve_relative(output, output->capacity);
+        }
+        if (result == AWS_OP_SUCCESS) {
+            result = aws_h2_encode_frame(encoder, frame, output, &frame_complete);
+        }
+    }
+    aws_h2_frame_destroy(frame);
+    return result;
+}
+
+/*
+ * Decoding
+ */
+
+struct h2_decode_state {
+    struct aws_h2_decoder *decoder;
+    struct aws_byte_buf input;
+};
+
+/* Nothing is done with what is decoded */
+static const struct aws_h2_decoder_vtable s_decoder_vtable = {0};
+
+/* A response: HEADERS, then one full-size DATA frame that ends the stream */
+static int s_h2_decode_setup(struct bench_context *ctx) {
+    struct h2_decode_state *state = aws_mem_calloc(ctx->allocator, 1, sizeof(struct h2_decode_state));
+    ctx->impl = state;
+    aws_byte_buf_init(&state->input, ctx->allocator, BODY_SIZE + 1024);
+
+    struct aws_h2_decoder_params params = {
+        .alloc = ctx->allocator,
+        .vtable = &s_decoder_vtable,
+        .skip_connection_preface = true,
+    };
+    state->decoder = aws_h2_decoder_new(&params);
+    if (!state->decoder) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_h2_frame_encoder encoder;
+    if (aws_h2_frame_encoder_init(&encoder, ctx->allocator, NULL /*logging_id*/)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_http_headers *headers =
+        s_new_headers(ctx->allocator, g_bench_response_headers, g_bench_response_header_count);
+    int result = AWS_OP_ERR;
+    if (!headers) {
+        goto done;
+    }
+
+    /* The first header-block fills both sides' dynamic tables.
+     * Later ones, like the one measured, refer to the table like a busy connection would */
+    if (s_encode_headers_frame(&encoder, headers, false /*end_stream*/, &state->input)) {
+        goto done;
+    }
+    struct aws_byte_cursor first_block = aws_byte_cursor_from_buf(&state->input);
+    if (aws_h2err_failed(aws_h2_decode(state->decoder, &first_block))) {
+        goto done;
+    }
+    state->input.len = 0;
+
+    if (s_encode_headers_frame(&encoder, headers, false /*end_stream*/, &state->input)) {
+        goto done;
+    }
+
+    struct aws_byte_buf body;
+    aws_byte_buf_init(&body, ctx->allocator, BODY_SIZE);
+    aws_byte_buf_write_u8_n(&body, 'x', BODY_SIZE);
+    struct aws_byte_cursor body_cursor = aws_byte_cursor_from_buf(&body);
+    struct aws_byte_cursor payload;
+    int32_t stream_window = AWS_H2_WINDOW_UPDATE_MAX;
+    size_t connection_window = AWS_H2_WINDOW_UPDATE_MAX;
+    bool body_complete = false;
+    if (aws_byte_buf_reserve_relative(&state->input, BODY_SIZE + AWS_H2_FRAME_PREFIX_SIZE) ||
+        aws_h2_encode_zero_copy_data_frame(
+            &encoder,
+            STREAM_ID,
+            &body_cursor,
+            true /*body_ends_stream*/,
+            &stream_window,
+            &connection_window,
+            &state->input,
+            &payload,
+            &body_complete) ||
+        aws_byte_buf_append(&state->input, &payload)) {
+        aws_byte_buf_clean_up(&body);
+        goto done;
+    }
+    aws_byte_buf_clean_up(&body);
+
+    ctx->bytes_per_op = state->input.len;
+    result = AWS_OP_SUCCESS;
+
+done:
+    aws_http_headers_release(headers);
+    aws_h2_frame_encoder_clean_up(&encoder);
+    return result;
+}
+
+static int s_h2_decode_run_op(struct bench_context *ctx) {
+    struct h2_decode_state *state = ctx->impl;
+    struct aws_byte_cursor input = aws_byte_cursor_from_buf(&state->input);
+    while (input.len > 0) {
+        if (aws_h2err_failed(aws_h2_decode(state->decoder, &input))) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static void s_h2_decode_clean_up(struct bench_context *ctx) {
+    struct h2_decode_state *state = ctx->impl;
+    if (state) {
+        aws_h2_decoder_destroy(state->decoder);
+        aws_byte_buf_clean_up(&state->input);
+        aws_mem_release(ctx->allocator, state);
+    }
+}
+
+/*
+ * Encoding
+ */
+
+struct h2_encode_state {
+    struct aws_h2_frame_encoder encoder;
+    bool encoder_initialized;
+    struct aws_http_headers *headers;
+    struct aws_byte_buf body;
+    struct aws_input_stream *body_stream;
+    struct aws_byte_buf output;
+};
+
+static int s_h2_encode_setup(struct bench_context *ctx) {
+    struct h2_encode_state *state = aws_mem_calloc(ctx->allocator, 1, sizeof(struct h2_encode_state));
+    ctx->impl = state;
+    aws_byte_buf_init(&state->output, ctx->allocator, BODY_SIZE + 1024);
+
+    if (aws_h2_frame_encoder_init(&state->encoder, ctx->allocator, NULL /*logging_id*/)) {
+        return AWS_OP_ERR;
+    }
+    state->encoder_initialized = true;
+
+    state->headers = s_new_headers(ctx->allocator, g_bench_request_headers, g_bench_request_header_count);
+    if (!state->headers) {
+        return AWS_OP_ERR;
+    }
+
+    aws_byte_buf_init(&state->body, ctx->allocator, BODY_SIZE);
+    aws_byte_buf_write_u8_n(&state->body, 'x', BODY_SIZE);
+    struct aws_byte_cursor body_cursor = aws_byte_cursor_from_buf(&state->body);
+    state->body_stream = aws_input_stream_new_from_cursor(ctx->allocator, &body_cursor);
+    if (!state->body_stream) {
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Like a connection sending request after request, the dynamic table is warm after the first */
+static int s_h2_encode_headers_run_op(struct bench_context *ctx) {
+    struct h2_encode_state *state = ctx->impl;
+    state->output.len = 0;
+    if (s_encode_headers_frame(&state->encoder, state->headers, true /*end_stream*/, &state->output)) {
+        return AWS_OP_ERR;
+    }
+    ctx->bytes_per_op = state->output.len;
+    return AWS_OP_SUCCESS;
+}
+
+/* One full-size DATA frame, copied from a body stream */
+static int s_h2_encode_data_run_op(struct bench_context *ctx) {
+    struct h2_encode_state *state = ctx->impl;
+    if (aws_input_stream_seek(state->body_stream, 0, AWS_SSB_BEGIN)) {
+        return AWS_OP_ERR;
+    }
+
+    state->output.len = 0;
+    int32_t stream_window = AWS_H2_WINDOW_UPDATE_MAX;
+    size_t connection_window = AWS_H2_WINDOW_UPDATE_MAX;
+    bool body_complete = false;
+    bool body_stalled = false;
+    if (aws_h2_encode_data_frame(
+            &state->encoder,
+            STREAM_ID,
+            state->body_stream,
+            true /*body_ends_stream*/,
+            0 /*pad_length*/,
+            &stream_window,
+            &connection_window,
+            &state->output,
+            &body_complete,
+            &body_stalled)) {
+        return AWS_OP_ERR;
+    }
+    ctx->bytes_per_op = state->output.len;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_h2_encode_clean_up(struct bench_context *ctx) {
+    struct h2_encode_state *state = ctx->impl;
+    if (state) {
+        if (state->encoder_initialized) {
+            aws_h2_frame_encoder_clean_up(&state->encoder);
+        }
+        aws_http_headers_release(state->headers);
+        aws_input_stream_release(state->body_stream);
+        aws_byte_buf_clean_up(&state->body);
+        aws_byte_buf_clean_up(&state->output);
+        aws_mem_release(ctx->allocator, state);
+    }
+}
+
+const struct bench g_h2_benches[] = {
+    {"h2_decode_headers_and_16KiB_data", s_h2_decode_setup, s_h2_decode_run_op, s_h2_decode_clean_up},
+    {"h2_encode_headers", s_h2_encode_setup, s_h2_encode_headers_run_op, s_h2_encode_clean_up},
+    {"h2_encode_16KiB_data", s_h2_encode_setup, s_h2_encode_data_run_op, s_h2_encode_clean_up},
+};
+const size_t g_h2_bench_count = AWS_ARRAY_SIZE(g_h2_benches);
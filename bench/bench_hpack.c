@@ -0,0 +1,163 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "bench.h"
+
+#include <aws/http/private/hpack.h>
+#include <aws/http/request_response.h>
+
+struct hpack_state {
+    struct aws_hpack_encoder encoder;
+    struct aws_hpack_decoder decoder;
+    bool codec_initialized;
+    struct aws_http_headers *headers;
+    /* Encoded header-block, or Huffman-encoded strings back to back */
+    struct aws_byte_buf encoded;
+    struct aws_byte_buf output;
+};
+
+static int s_hpack_setup_common(struct bench_context *ctx) {
+    struct hpack_state *state = aws_mem_calloc(ctx->allocator, 1, sizeof(struct hpack_state));
+    ctx->impl = state;
+    aws_hpack_encoder_init(&state->encoder, ctx->allocator, NULL /*log_id*/);
+    aws_hpack_decoder_init(&state->decoder, ctx->allocator, NULL /*log_id*/);
+    state->codec_initialized = true;
+    aws_byte_buf_init(&state->encoded, ctx->allocator, 1024);
+    aws_byte_buf_init(&state->output, ctx->allocator, 1024);
+
+    state->headers = aws_http_headers_new(ctx->allocator);
+    if (!state->headers ||
+        aws_http_headers_add_array(state->headers, g_bench_request_headers, g_bench_request_header_count)) {
+        return AWS_OP_ERR;
+    }
+
+    size_t plain_len = 0;
+    for (size_t i = 0; i < g_bench_request_header_count; ++i) {
+        plain_len += g_bench_request_headers[i].name.len + g_bench_request_headers[i].value.len;
+    }
+    ctx->bytes_per_op = plain_len;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_decode_block(struct aws_hpack_decoder *decoder, struct aws_byte_cursor block) {
+    while (block.len > 0) {
+        struct aws_hpack_decode_result result;
+        if (aws_hpack_decode(decoder, &block, &result)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* The first header-block fills both sides' dynamic tables, the measured ones refer to the tables */
+static int s_hpack_setup_warm(struct bench_context *ctx) {
+    if (s_hpack_setup_common(ctx)) {
+        return AWS_OP_ERR;
+    }
+
+    struct hpack_state *state = ctx->impl;
+    if (aws_hpack_encode_header_block(&state->encoder, state->headers, &state->encoded) ||
+        s_decode_block(&state->decoder, aws_byte_cursor_from_buf(&state->encoded))) {
+        return AWS_OP_ERR;
+    }
+
+    state->encoded.len = 0;
+    return aws_hpack_encode_header_block(&state->encoder, state->headers, &state->encoded);
+}
+
+static int s_hpack_encode_run_op(struct bench_context *ctx) {
+    struct hpack_state *state = ctx->impl;
+    state->output.len = 0;
+    return aws_hpack_encode_header_block(&state->encoder, state->headers, &state->output);
+}
+
+static int s_hpack_decode_run_op(struct bench_context *ctx) {
+    struct hpack_state *state = ctx->impl;
+    return s_decode_block(&state->decoder, aws_byte_cursor_from_buf(&state->encoded));
+}
+
+/* The first header-block on a new connection, where every header is inserted into an empty dynamic table */
+static int s_hpack_encode_cold_run_op(struct bench_context *ctx) {
+    struct hpack_state *state = ctx->impl;
+    struct aws_hpack_encoder encoder;
+    aws_hpack_encoder_init(&encoder, ctx->allocator, NULL /*log_id*/);
+    state->output.len = 0;
+    int result = aws_hpack_encode_header_block(&encoder, state->headers, &state->output);
+    aws_hpack_encoder_clean_up(&encoder);
+    return result;
+}
+
+/*
+ * Huffman coding, of every header value
+ */
+
+static int s_huffman_setup(struct bench_context *ctx) {
+    if (s_hpack_setup_common(ctx)) {
+        return AWS_OP_ERR;
+    }
+
+    struct hpack_state *state = ctx->impl;
+    aws_hpack_encoder_set_huffman_mode(&state->encoder, AWS_HPACK_HUFFMAN_ALWAYS);
+
+    size_t values_len = 0;
+    for (size_t i = 0; i < g_bench_request_header_count; ++i) {
+        values_len += g_bench_request_headers[i].value.len;
+        if (aws_hpack_encode_string(&state->encoder, g_bench_request_headers[i].value, &state->encoded)) {
+            return AWS_OP_ERR;
+        }
+    }
+    ctx->bytes_per_op = values_len;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_huffman_encode_run_op(struct bench_context *ctx) {
+    struct hpack_state *state = ctx->impl;
+    state->output.len = 0;
+    for (size_t i = 0; i < g_bench_request_header_count; ++i) {
+        if (aws_hpack_encode_string(&state->encoder, g_bench_request_headers[i].value, &state->output)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_huffman_decode_run_op(struct bench_context *ctx) {
+    struct hpack_state *state = ctx->impl;
+    state->output.len = 0;
+    struct aws_byte_cursor encoded = aws_byte_cursor_from_buf(&state->encoded);
+    while (encoded.len > 0) {
+        bool complete = false;
+        if (aws_hpack_decode_string(&state->decoder, &encoded, &state->output, &complete)) {
+            return AWS_OP_ERR;
+        }
+        if (!complete) {
+            return aws_raise_error(AWS_ERROR_INVALID_STATE);
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static void s_hpack_clean_up(struct bench_context *ctx) {
+    struct hpack_state *state = ctx->impl;
+    if (state) {
+        if (state->codec_initialized) {
+            aws_hpack_encoder_clean_up(&state->encoder);
+            aws_hpack_decoder_clean_up(&state->decoder);
+        }
+        aws_http_headers_release(state->headers);
+        aws_byte_buf_clean_up(&state->encoded);
+        aws_byte_buf_clean_up(&state->output);
+        aws_mem_release(ctx->allocator, state);
+    }
+}
+
+const struct bench g_hpack_benches[] = {
+    {"hpack_encode_request_headers", s_hpack_setup_warm, s_hpack_encode_run_op, s_hpack_clean_up},
+    {"hpack_encode_request_headers_cold", s_hpack_setup_common, s_hpack_encode_cold_run_op, s_hpack_clean_up},
+    {"hpack_decode_request_headers", s_hpack_setup_warm, s_hpack_decode_run_op, s_hpack_clean_up},
+    {"huffman_encode", s_huffman_setup, s_huffman_encode_run_op, s_hpack_clean_up},
+    {"huffman_decode", s_huffman_setup, s_huffman_decode_run_op, s_hpack_clean_up},
+};
+const size_t g_hpack_bench_count = AWS_ARRAY_SIZE(g_hpack_benches);
@@ -0,0 +1,339 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "bench.h"
+
+#include <aws/common/array_list.h>
+#include <aws/common/file.h>
+#include <aws/http/private/h1_decoder.h>
+#include <aws/http/private/h2_decoder.h>
+#include <aws/http/private/traffic_capture.h>
+#include <aws/http/private/websocket_decoder.h>
+#include <aws/http/status_code.h>
+
+#include <stdio.h>
+
+/*
+ * Replays a capture recorded with aws_http_traffic_capture_options through the decoders.
+ * Each direction is fed to its decoder in the same pieces the connection received or sent them,
+ * so segmentation is as realistic as the header and frame mix.
+ */
+
+struct replay_state {
+    struct aws_byte_buf file;
+    struct aws_http_traffic_capture_file_header header;
+    /* aws_byte_cursors into `file`, one per record */
+    struct aws_array_list client_to_server;
+    struct aws_array_list server_to_client;
+
+    /* HTTP/1 only. Methods of the requests decoded so far, so HEAD responses are decoded without a body */
+    struct aws_array_list request_methods;
+};
+
+/* Per-direction decoding state, for one replay */
+struct h1_replay_direction {
+    struct replay_state *state;
+    bool is_requests;
+    size_t message_index;
+    /* A 1xx response, which is followed by the real response to the same request */
+    bool is_informational;
+    /* The message being decoded is a WebSocket upgrade. Once it's done, what follows is WebSocket frames */
+    bool is_upgrade;
+    bool is_websocket;
+};
+
+static int s_on_header(const struct aws_h1_decoded_header *header, void *user_data) {
+    struct h1_replay_direction *direction = user_data;
+    if (direction->is_requests && header->name == AWS_HTTP_HEADER_UPGRADE &&
+        aws_byte_cursor_eq_c_str_ignore_case(&header->value_data, "websocket")) {
+        direction->is_upgrade = true;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_body(const struct aws_byte_cursor *data, bool finished, void *user_data) {
+    (void)data;
+    (void)finished;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_request(
+    enum aws_http_method method_enum,
+    const struct aws_byte_cursor *method_str,
+    const struct aws_byte_cursor *uri,
+    void *user_data) {
+
+    (void)method_str;
+    (void)uri;
+    struct h1_replay_direction *direction = user_data;
+    return aws_array_list_push_back(&direction->state->request_methods, &method_enum);
+}
+
+static int s_on_response(int status_code, void *user_data) {
+    struct h1_replay_direction *direction = user_data;
+    direction->is_informational = status_code / 100 == 1;
+    if (status_code == AWS_HTTP_STATUS_CODE_101_SWITCHING_PROTOCOLS) {
+        direction->is_upgrade = true;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_done(void *user_data) {
+    struct h1_replay_direction *direction = user_data;
+    /* An informational response doesn't complete the request it answers */
+    if (!direction->is_informational) {
+        direction->message_index++;
+    }
+    direction->is_websocket = direction->is_upgrade;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_websocket_frame(const struct aws_websocket_frame *frame, void *user_data) {
+    (void)frame;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_websocket_payload(struct aws_byte_cursor data, void *user_data) {
+    (void)data;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static bool s_is_head_response(struct h1_replay_direction *direction) {
+    enum aws_http_method method = AWS_HTTP_METHOD_UNKNOWN;
+    if (aws_array_list_get_at(&direction->state->request_methods, &method, direction->message_index)) {
+        return false;
+    }
+    return method == AWS_HTTP_METHOD_HEAD;
+}
+
+static int s_replay_h1_direction(
+    struct bench_context *ctx,
+    const struct aws_array_list *chunks,
+    struct h1_replay_direction *direction) {
+
+    struct aws_h1_decoder_params params = {
+        .alloc = ctx->allocator,
+        .scratch_space_initial_size = 256,
+        .is_decoding_requests = direction->is_requests,
+        .user_data = direction,
+        .vtable =
+            {
+                .on_header = s_on_header,
+                .on_body = s_on_body,
+                .on_request = s_on_request,
+                .on_response = s_on_response,
+                .on_done = s_on_done,
+            },
+    };
+    struct aws_h1_decoder *decoder = aws_h1_decoder_new(&params);
+    if (!decoder) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_websocket_decoder websocket_decoder;
+    aws_websocket_decoder_init(
+        &websocket_decoder, ctx->allocator, s_on_websocket_frame, s_on_websocket_payload, direction);
+
+    int result = AWS_OP_ERR;
+    for (size_t i = 0; i < aws_array_list_length(chunks); ++i) {
+        struct aws_byte_cursor chunk;
+        aws_array_list_get_at(chunks, &chunk, i);
+        while (chunk.len > 0) {
+            if (direction->is_websocket) {
+                bool frame_complete = false;
+                if (aws_websocket_decoder_process(&websocket_decoder, &chunk, &frame_complete)) {
+                    goto done;
+                }
+                continue;
+            }
+
+            if (!direction->is_requests) {
+                aws_h1_decoder_set_body_headers_ignored(decoder, s_is_head_response(direction));
+            }
+            if (aws_h1_decode(decoder, &chunk)) {
+                goto done;
+            }
+        }
+    }
+    result = AWS_OP_SUCCESS;
+
+done:
+    aws_websocket_decoder_clean_up(&websocket_decoder);
+    aws_h1_decoder_destroy(decoder);
+    return result;
+}
+
+static int s_replay_h1(struct bench_context *ctx) {
+    struct replay_state *state = ctx->impl;
+    aws_array_list_clear(&state->request_methods);
+
+    /* Requests first, responses need to know which requests were HEAD */
+    struct h1_replay_direction requests = {.state = state, .is_requests = true};
+    struct h1_replay_direction responses = {.state = state, .is_requests = false};
+    if (s_replay_h1_direction(ctx, &state->client_to_server, &requests) ||
+        s_replay_h1_direction(ctx, &state->server_to_client, &responses)) {
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Nothing is done with what is decoded */
+static const struct aws_h2_decoder_vtable s_h2_decoder_vtable = {0};
+
+static int s_replay_h2_direction(struct bench_context *ctx, const struct aws_array_list *chunks, bool is_server) {
+    /* The connection preface is in the capture, so the decoder checks it like it would on a real connection */
+    struct aws_h2_decoder_params params = {
+        .alloc = ctx->allocator,
+        .vtable = &s_h2_decoder_vtable,
+        .is_server = is_server,
+    };
+    struct aws_h2_decoder *decoder = aws_h2_decoder_new(&params);
+    if (!decoder) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_SUCCESS;
+    for (size_t i = 0; i < aws_array_list_length(chunks); ++i) {
+        struct aws_byte_cursor chunk;
+        aws_array_list_get_at(chunks, &chunk, i);
+        struct aws_h2err err = aws_h2_decode(decoder, &chunk);
+        if (aws_h2err_failed(err)) {
+            result = aws_raise_error(err.aws_code);
+            break;
+        }
+    }
+
+    aws_h2_decoder_destroy(decoder);
+    return result;
+}
+
+static int s_replay_h2(struct bench_context *ctx) {
+    struct replay_state *state = ctx->impl;
+    if (s_replay_h2_direction(ctx, &state->client_to_server, true /*is_server*/) ||
+        s_replay_h2_direction(ctx, &state->server_to_client, false /*is_server*/)) {
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_replay_setup(struct bench_context *ctx) {
+    struct replay_state *state = aws_mem_calloc(ctx->allocator, 1, sizeof(struct replay_state));
+    ctx->impl = state;
+    aws_array_list_init_dynamic(&state->client_to_server, ctx->allocator, 64, sizeof(struct aws_byte_cursor));
+    aws_array_list_init_dynamic(&state->server_to_client, ctx->allocator, 64, sizeof(struct aws_byte_cursor));
+    aws_array_list_init_dynamic(&state->request_methods, ctx->allocator, 64, sizeof(enum aws_http_method));
+
+    if (aws_byte_buf_init_from_file(&state->file, ctx->allocator, ctx->input_path)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor input = aws_byte_cursor_from_buf(&state->file);
+    if (aws_http_traffic_capture_read_file_header(&input, &state->header)) {
+        return AWS_OP_ERR;
+    }
+
+    if (state->header.http_version != AWS_HTTP_VERSION_1_1 && state->header.http_version != AWS_HTTP_VERSION_2) {
+        return aws_raise_error(AWS_ERROR_HTTP_UNSUPPORTED_PROTOCOL);
+    }
+
+    while (input.len > 0) {
+        struct aws_http_traffic_capture_record record;
+        if (aws_http_traffic_capture_read_record(&input, &record)) {
+            /* The capturing process may have died mid-write, replay what's whole */
+            fprintf(stderr, "%s: ignoring %zu bytes of truncated record\n", ctx->input_path, input.len);
+            break;
+        }
+
+        /* The server's inbound data is the client's outbound */
+        bool is_client_to_server = (record.direction == AWS_HTTP_TRAFFIC_CAPTURE_INBOUND) == state->header.is_server;
+        if (aws_array_list_push_back(
+                is_client_to_server ? &state->client_to_server : &state->server_to_client, &record.data)) {
+            return AWS_OP_ERR;
+        }
+        ctx->bytes_per_op += record.data.len;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Decoders are created anew for each replay, since their state can't be rewound to the start of the connection */
+static int s_replay_run_op(struct bench_context *ctx) {
+    struct replay_state *state = ctx->impl;
+    return state->header.http_version == AWS_HTTP_VERSION_2 ? s_replay_h2(ctx) : s_replay_h1(ctx);
+}
+
+static void s_replay_clean_up(struct bench_context *ctx) {
+    struct replay_state *state = ctx->impl;
+    if (state) {
+        aws_array_list_clean_up(&state->client_to_server);
+        aws_array_list_clean_up(&state->server_to_client);
+        aws_array_list_clean_up(&state->request_methods);
+        aws_byte_buf_clean_up(&state->file);
+        aws_mem_release(ctx->allocator, state);
+    }
+}
+
+const struct bench g_replay_bench = {"replay", s_replay_setup, s_replay_run_op, s_replay_clean_up};
+
+int bench_replay_write_corpus(struct aws_allocator *allocator, const char *capture_path, const char *corpus_dir) {
+    struct bench_context ctx = {.allocator = allocator, .input_path = capture_path};
+    int result = AWS_OP_ERR;
+    FILE *seed = NULL;
+    struct aws_byte_buf seed_path;
+    AWS_ZERO_STRUCT(seed_path);
+
+    if (s_replay_setup(&ctx)) {
+        goto done;
+    }
+
+    /* The fuzz targets decode what an HTTP/2 client receives, skipping the preface */
+    struct replay_state *state = ctx.impl;
+    if (state->header.http_version != AWS_HTTP_VERSION_2) {
+        result = AWS_OP_SUCCESS;
+        goto done;
+    }
+
+    struct aws_byte_cursor capture_name = aws_byte_cursor_from_c_str(capture_path);
+    for (size_t i = capture_name.len; i > 0; --i) {
+        if (capture_name.ptr[i - 1] == '/' || capture_name.ptr[i - 1] == '\\') {
+            aws_byte_cursor_advance(&capture_name, i);
+            break;
+        }
+    }
+    struct aws_byte_cursor dir = aws_byte_cursor_from_c_str(corpus_dir);
+    struct aws_byte_cursor extension = aws_byte_cursor_from_c_str(".h2");
+    aws_byte_buf_init(&seed_path, allocator, dir.len + capture_name.len + extension.len + 2);
+    aws_byte_buf_append(&seed_path, &dir);
+    aws_byte_buf_write_u8(&seed_path, (uint8_t)aws_get_platform_directory_separator());
+    aws_byte_buf_append(&seed_path, &capture_name);
+    aws_byte_buf_append(&seed_path, &extension);
+    aws_byte_buf_write_u8(&seed_path, '\0');
+
+    seed = aws_fopen((const char *)seed_path.buffer, "wb");
+    if (!seed) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < aws_array_list_length(&state->server_to_client); ++i) {
+        struct aws_byte_cursor chunk;
+        aws_array_list_get_at(&state->server_to_client, &chunk, i);
+        if (fwrite(chunk.ptr, 1, chunk.len, seed) != chunk.len) {
+            aws_raise_error(AWS_ERROR_FILE_WRITE_FAILURE);
+            goto done;
+        }
+    }
+    result = AWS_OP_SUCCESS;
+
+done:
+    if (seed) {
+        fclose(seed);
+    }
+    aws_byte_buf_clean_up(&seed_path);
+    s_replay_clean_up(&ctx);
+    return result;
+}
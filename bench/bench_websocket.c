@@ -0,0 +1,131 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "bench.h"
+
+#include <aws/http/private/websocket_decoder.h>
+#include <aws/http/private/websocket_encoder.h>
+
+#define PAYLOAD_SIZE (16 * 1024)
+
+struct websocket_state {
+    struct aws_websocket_encoder encoder;
+    struct aws_websocket_decoder decoder;
+    bool decoder_initialized;
+    struct aws_websocket_frame frame;
+    struct aws_byte_buf payload;
+    /* What's left of the payload for the frame being encoded */
+    struct aws_byte_cursor payload_remaining;
+    /* A whole encoded frame */
+    struct aws_byte_buf encoded;
+    struct aws_byte_buf output;
+};
+
+static int s_stream_outgoing_payload(struct aws_byte_buf *out_buf, void *user_data) {
+    struct websocket_state *state = user_data;
+    aws_byte_buf_write_to_capacity(out_buf, &state->payload_remaining);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_frame(const struct aws_websocket_frame *frame, void *user_data) {
+    (void)frame;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_payload(struct aws_byte_cursor data, void *user_data) {
+    (void)data;
+    (void)user_data;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_encode_frame(struct websocket_state *state, struct aws_byte_buf *output) {
+    state->payload_remaining = aws_byte_cursor_from_buf(&state->payload);
+    if (aws_websocket_encoder_start_frame(&state->encoder, &state->frame)) {
+        return AWS_OP_ERR;
+    }
+    while (aws_websocket_encoder_is_frame_in_progress(&state->encoder)) {
+        if (aws_websocket_encoder_process(&state->encoder, output)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* A single 16KiB BINARY frame. Clients mask what they send, servers don't */
+static int s_websocket_setup(struct bench_context *ctx, bool masked) {
+    struct websocket_state *state = aws_mem_calloc(ctx->allocator, 1, sizeof(struct websocket_state));
+    ctx->impl = state;
+    aws_websocket_encoder_init(&state->encoder, s_stream_outgoing_payload, state);
+    aws_websocket_decoder_init(&state->decoder, ctx->allocator, s_on_frame, s_on_payload, state);
+    state->decoder_initialized = true;
+
+    aws_byte_buf_init(&state->payload, ctx->allocator, PAYLOAD_SIZE);
+    aws_byte_buf_write_u8_n(&state->payload, 'x', PAYLOAD_SIZE);
+    aws_byte_buf_init(&state->encoded, ctx->allocator, PAYLOAD_SIZE + 16);
+    aws_byte_buf_init(&state->output, ctx->allocator, PAYLOAD_SIZE + 16);
+
+    state->frame = (struct aws_websocket_frame){
+        .fin = true,
+        .masked = masked,
+        .opcode = AWS_WEBSOCKET_OPCODE_BINARY,
+        .payload_length = PAYLOAD_SIZE,
+        .masking_key = {0x37, 0xfa, 0x21, 0x3d},
+    };
+
+    if (s_encode_frame(state, &state->encoded)) {
+        return AWS_OP_ERR;
+    }
+
+    ctx->bytes_per_op = state->encoded.len;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_websocket_setup_masked(struct bench_context *ctx) {
+    return s_websocket_setup(ctx, true /*masked*/);
+}
+
+static int s_websocket_setup_unmasked(struct bench_context *ctx) {
+    return s_websocket_setup(ctx, false /*masked*/);
+}
+
+static int s_websocket_encode_run_op(struct bench_context *ctx) {
+    struct websocket_state *state = ctx->impl;
+    state->output.len = 0;
+    return s_encode_frame(state, &state->output);
+}
+
+static int s_websocket_decode_run_op(struct bench_context *ctx) {
+    struct websocket_state *state = ctx->impl;
+    struct aws_byte_cursor encoded = aws_byte_cursor_from_buf(&state->encoded);
+    bool frame_complete = false;
+    while (!frame_complete) {
+        if (aws_websocket_decoder_process(&state->decoder, &encoded, &frame_complete)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static void s_websocket_clean_up(struct bench_context *ctx) {
+    struct websocket_state *state = ctx->impl;
+    if (state) {
+        if (state->decoder_initialized) {
+            aws_websocket_decoder_clean_up(&state->decoder);
+        }
+        aws_byte_buf_clean_up(&state->payload);
+        aws_byte_buf_clean_up(&state->encoded);
+        aws_byte_buf_clean_up(&state->output);
+        aws_mem_release(ctx->allocator, state);
+    }
+}
+
+const struct bench g_websocket_benches[] = {
+    {"websocket_encode_16KiB", s_websocket_setup_unmasked, s_websocket_encode_run_op, s_websocket_clean_up},
+    {"websocket_encode_16KiB_masked", s_websocket_setup_masked, s_websocket_encode_run_op, s_websocket_clean_up},
+    {"websocket_decode_16KiB", s_websocket_setup_unmasked, s_websocket_decode_run_op, s_websocket_clean_up},
+    {"websocket_decode_16KiB_masked", s_websocket_setup_masked, s_websocket_decode_run_op, s_websocket_clean_up},
+};
+const size_t g_websocket_bench_count = AWS_ARRAY_SIZE(g_websocket_benches);
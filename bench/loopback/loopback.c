@@ -0,0 +1,942 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+/*
+ * End-to-end throughput and latency over loopback.
+ *
+ * HTTP/1.1 runs against an aws_http_server in this process, through an aws_http_connection_manager.
+ * Every leased connection keeps `concurrency` requests in flight, which is the pipelining depth.
+ *
+ * HTTP/2 runs through an aws_http2_stream_manager against tests/py_localhost/server.py,
+ * since the server in this library only handles HTTP/1.1 requests.
+ *
+ * Requests go to /loopback/<response-size>, and both servers answer with that many bytes of body.
+ */
+
+#include <aws/common/clock.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/http/connection.h>
+#include <aws/http/connection_manager.h>
+#include <aws/http/http2_stream_manager.h>
+#include <aws/http/request_response.h>
+#include <aws/http/server.h>
+#include <aws/http/statistics.h>
+#include <aws/io/channel_bootstrap.h>
+#include <aws/io/event_loop.h>
+#include <aws/io/host_resolver.h>
+#include <aws/io/socket.h>
+#include <aws/io/stream.h>
+#include <aws/io/tls_channel_handler.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_DURATION_MS 2000
+#define MAX_SWEEP_VALUES 16
+#define PATH_PREFIX "/loopback/"
+
+struct sweep {
+    size_t values[MAX_SWEEP_VALUES];
+    size_t count;
+};
+
+struct loopback_options {
+    struct sweep connections;
+    struct sweep concurrency;
+    struct sweep request_sizes;
+    struct sweep response_sizes;
+    bool run_plain;
+    bool run_tls;
+    const char *h2_host;
+    uint32_t h2_port;
+    uint64_t duration_ns;
+    bool csv;
+};
+
+struct loopback_config {
+    bool http2;
+    bool tls;
+    size_t connections;
+    size_t concurrency;
+    size_t request_size;
+    size_t response_size;
+};
+
+struct loopback {
+    struct aws_allocator *allocator;
+    const struct loopback_options *options;
+
+    struct aws_event_loop_group *event_loop_group;
+    struct aws_host_resolver *host_resolver;
+    struct aws_client_bootstrap *client_bootstrap;
+    struct aws_server_bootstrap *server_bootstrap;
+    struct aws_socket_options socket_options;
+
+    struct aws_tls_ctx *client_tls_ctx;
+    struct aws_tls_ctx *h2_client_tls_ctx;
+    struct aws_tls_ctx *server_tls_ctx;
+    struct aws_tls_connection_options server_tls_options;
+
+    /* One pre-serialized response per size in the sweep, indexed like options->response_sizes */
+    struct aws_http_static_response *static_responses[MAX_SWEEP_VALUES];
+    /* Bodies of requests and responses are slices of this */
+    struct aws_byte_buf payload;
+
+    struct aws_http_server *plain_server;
+    struct aws_http_server *tls_server;
+    uint32_t plain_port;
+    uint32_t tls_port;
+
+    struct aws_mutex lock;
+    struct aws_condition_variable signal;
+    size_t servers_destroyed;
+};
+
+/* A request kept in flight for the length of a run, re-sent as soon as its response completes */
+struct request_slot {
+    struct loopback_run *run;
+    struct aws_http_connection *connection;
+    struct aws_http_message *request;
+    struct aws_input_stream *body_stream;
+    uint64_t start_ns;
+    size_t response_body_bytes;
+};
+
+struct loopback_run {
+    struct loopback *loopback;
+    struct loopback_config config;
+    struct aws_byte_cursor path;
+    uint64_t deadline_ns;
+
+    struct aws_http_connection_manager *connection_manager;
+    struct aws_http2_stream_manager *stream_manager;
+    struct request_slot *slots;
+    size_t slot_count;
+
+    /* Everything below is guarded by loopback->lock */
+    struct aws_http_connection **connections;
+    size_t connections_acquired;
+    size_t in_flight;
+    bool manager_shutdown;
+    int error_code;
+    uint64_t requests_completed;
+    uint64_t bytes_transferred;
+    size_t errors;
+    struct aws_http_latency_histogram latency;
+};
+
+static uint64_t s_now_ns(void) {
+    uint64_t now = 0;
+    aws_high_res_clock_get_ticks(&now);
+    return now;
+}
+
+/*
+ * Server
+ */
+
+static int s_server_on_request_done(struct aws_http_stream *stream, void *user_data) {
+    struct loopback *loopback = user_data;
+
+    struct aws_byte_cursor uri;
+    if (aws_http_stream_get_incoming_request_uri(stream, &uri)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor prefix = aws_byte_cursor_from_c_str(PATH_PREFIX);
+    uint64_t size = 0;
+    if (aws_byte_cursor_starts_with(&uri, &prefix)) {
+        aws_byte_cursor_advance(&uri, prefix.len);
+        if (aws_byte_cursor_utf8_parse_u64(uri, &size) == AWS_OP_SUCCESS) {
+            for (size_t i = 0; i < loopback->options->response_sizes.count; ++i) {
+                if (loopback->options->response_sizes.values[i] == size) {
+                    return aws_http_stream_send_static_response(stream, loopback->static_responses[i]);
+                }
+            }
+        }
+    }
+    return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+}
+
+static void s_server_on_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)error_code;
+    (void)user_data;
+    aws_http_stream_release(stream);
+}
+
+static struct aws_http_stream *s_server_on_incoming_request(struct aws_http_connection *connection, void *user_data) {
+    struct aws_http_request_handler_options options = AWS_HTTP_REQUEST_HANDLER_OPTIONS_INIT;
+    options.server_connection = connection;
+    options.user_data = user_data;
+    options.on_request_done = s_server_on_request_done;
+    options.on_complete = s_server_on_stream_complete;
+    return aws_http_stream_new_server_request_handler(&options);
+}
+
+static void s_server_on_incoming_connection(
+    struct aws_http_server *server,
+    struct aws_http_connection *connection,
+    int error_code,
+    void *user_data) {
+
+    (void)server;
+    if (error_code) {
+        return;
+    }
+
+    struct aws_http_server_connection_options options = AWS_HTTP_SERVER_CONNECTION_OPTIONS_INIT;
+    options.connection_user_data = user_data;
+    options.on_incoming_request = s_server_on_incoming_request;
+    if (aws_http_connection_configure_server(connection, &options)) {
+        aws_http_connection_close(connection);
+        aws_http_connection_release(connection);
+    }
+}
+
+static void s_server_on_destroy(void *user_data) {
+    struct loopback *loopback = user_data;
+    aws_mutex_lock(&loopback->lock);
+    loopback->servers_destroyed++;
+    aws_mutex_unlock(&loopback->lock);
+    aws_condition_variable_notify_all(&loopback->signal);
+}
+
+static struct aws_http_server *s_server_new(struct loopback *loopback, bool tls, uint32_t *out_port) {
+    struct aws_socket_endpoint endpoint;
+    AWS_ZERO_STRUCT(endpoint);
+    snprintf(endpoint.address, sizeof(endpoint.address), "127.0.0.1");
+
+    struct aws_http_server_options options = AWS_HTTP_SERVER_OPTIONS_INIT;
+    options.allocator = loopback->allocator;
+    options.bootstrap = loopback->server_bootstrap;
+    options.endpoint = &endpoint;
+    options.socket_options = &loopback->socket_options;
+    options.tls_options = tls ? &loopback->server_tls_options : NULL;
+    options.server_user_data = loopback;
+    options.on_incoming_connection = s_server_on_incoming_connection;
+    options.on_destroy_complete = s_server_on_destroy;
+    options.listener_per_event_loop = true;
+
+    struct aws_http_server *server = aws_http_server_new(&options);
+    if (server) {
+        *out_port = aws_http_server_get_listener_endpoint(server)->port;
+    }
+    return server;
+}
+
+static int s_build_static_responses(struct loopback *loopback) {
+    for (size_t i = 0; i < loopback->options->response_sizes.count; ++i) {
+        size_t size = loopback->options->response_sizes.values[i];
+        char content_length[32];
+        snprintf(content_length, sizeof(content_length), "%zu", size);
+
+        struct aws_http_message *response = aws_http_message_new_response(loopback->allocator);
+        struct aws_byte_cursor body = aws_byte_cursor_from_array(loopback->payload.buffer, size);
+        struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(loopback->allocator, &body);
+        if (response && body_stream && !aws_http_message_set_response_status(response, 200) &&
+            !aws_http_message_add_header(
+                response,
+                (struct aws_http_header){
+                    .name = aws_byte_cursor_from_c_str("Content-Length"),
+                    .value = aws_byte_cursor_from_c_str(content_length),
+                })) {
+            aws_http_message_set_body_stream(response, body_stream);
+            loopback->static_responses[i] = aws_http_static_response_new(loopback->allocator, response);
+        }
+        aws_http_message_release(response);
+        aws_input_stream_release(body_stream);
+        if (!loopback->static_responses[i]) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Client
+ */
+
+static void s_send_request(struct request_slot *slot);
+
+/* Records a finished request, and says whether the slot should send another */
+static bool s_slot_on_complete(struct request_slot *slot, int error_code, int status) {
+    struct loopback_run *run = slot->run;
+    struct loopback *loopback = run->loopback;
+    uint64_t now_ns = s_now_ns();
+    uint64_t latency_us = aws_timestamp_convert(now_ns - slot->start_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MICROS, 0);
+    bool succeeded = error_code == AWS_ERROR_SUCCESS && status == 200;
+    bool send_again = succeeded && now_ns < run->deadline_ns;
+
+    aws_mutex_lock(&loopback->lock);
+    if (succeeded) {
+        run->requests_completed++;
+        run->bytes_transferred += run->config.request_size + slot->response_body_bytes;
+        aws_http_latency_histogram_record(&run->latency, latency_us);
+    } else {
+        run->errors++;
+        if (!run->error_code) {
+            run->error_code = error_code ? error_code : AWS_ERROR_HTTP_UNKNOWN;
+        }
+    }
+    if (!send_again) {
+        run->in_flight--;
+    }
+    aws_mutex_unlock(&loopback->lock);
+
+    if (!send_again) {
+        aws_condition_variable_notify_all(&loopback->signal);
+    }
+    return send_again;
+}
+
+static int s_on_response_body(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
+    (void)stream;
+    struct request_slot *slot = user_data;
+    slot->response_body_bytes += data->len;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct request_slot *slot = user_data;
+    int status = 0;
+    if (!error_code) {
+        aws_http_stream_get_incoming_response_status(stream, &status);
+    }
+    aws_http_stream_release(stream);
+
+    if (s_slot_on_complete(slot, error_code, status)) {
+        s_send_request(slot);
+    }
+}
+
+static void s_on_h2_stream_acquired(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct request_slot *slot = user_data;
+    if (!stream) {
+        if (s_slot_on_complete(slot, error_code, 0 /*status*/)) {
+            s_send_request(slot);
+        }
+    }
+}
+
+static void s_send_request(struct request_slot *slot) {
+    slot->response_body_bytes = 0;
+    if (slot->body_stream) {
+        aws_input_stream_seek(slot->body_stream, 0, AWS_SSB_BEGIN);
+    }
+
+    struct aws_http_make_request_options options = {
+        .self_size = sizeof(options),
+        .request = slot->request,
+        .user_data = slot,
+        .on_response_body = s_on_response_body,
+        .on_complete = s_on_stream_complete,
+    };
+
+    slot->start_ns = s_now_ns();
+    if (slot->run->config.http2) {
+        struct aws_http2_stream_manager_acquire_stream_options acquire_options = {
+            .callback = s_on_h2_stream_acquired,
+            .user_data = slot,
+            .options = &options,
+        };
+        aws_http2_stream_manager_acquire_stream(slot->run->stream_manager, &acquire_options);
+        return;
+    }
+
+    struct aws_http_stream *stream = aws_http_connection_make_request(slot->connection, &options);
+    if (!stream || aws_http_stream_activate(stream)) {
+        int error_code = aws_last_error();
+        aws_http_stream_release(stream);
+        /* A failed request isn't re-sent, so this can't loop on a connection that's gone */
+        s_slot_on_complete(slot, error_code, 0 /*status*/);
+    }
+}
+
+static int s_slot_init(struct request_slot *slot, struct loopback_run *run) {
+    struct loopback *loopback = run->loopback;
+    slot->run = run;
+    slot->request = run->config.http2 ? aws_http2_message_new_request(loopback->allocator)
+                                      : aws_http_message_new_request(loopback->allocator);
+    if (!slot->request) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor method = run->config.request_size ? aws_http_method_put : aws_http_method_get;
+    if (aws_http_message_set_request_method(slot->request, method) ||
+        aws_http_message_set_request_path(slot->request, run->path)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_http_headers *headers = aws_http_message_get_headers(slot->request);
+    struct aws_byte_cursor authority =
+        aws_byte_cursor_from_c_str(run->config.http2 ? loopback->options->h2_host : "localhost");
+    if (run->config.http2) {
+        if (aws_http2_headers_set_request_scheme(headers, aws_byte_cursor_from_c_str("https")) ||
+            aws_http2_headers_set_request_authority(headers, authority)) {
+            return AWS_OP_ERR;
+        }
+    } else if (aws_http_headers_set(headers, aws_byte_cursor_from_c_str("Host"), authority)) {
+        return AWS_OP_ERR;
+    }
+
+    if (run->config.request_size) {
+        char content_length[32];
+        snprintf(content_length, sizeof(content_length), "%zu", run->config.request_size);
+        struct aws_byte_cursor body = aws_byte_cursor_from_array(loopback->payload.buffer, run->config.request_size);
+        slot->body_stream = aws_input_stream_new_from_cursor(loopback->allocator, &body);
+        if (!slot->body_stream ||
+            aws_http_headers_set(
+                headers, aws_byte_cursor_from_c_str("Content-Length"), aws_byte_cursor_from_c_str(content_length))) {
+            return AWS_OP_ERR;
+        }
+        aws_http_message_set_body_stream(slot->request, slot->body_stream);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_connection_acquired(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct loopback_run *run = user_data;
+    aws_mutex_lock(&run->loopback->lock);
+    if (connection) {
+        run->connections[run->connections_acquired] = connection;
+    } else if (!run->error_code) {
+        run->error_code = error_code;
+    }
+    run->connections_acquired++;
+    aws_mutex_unlock(&run->loopback->lock);
+    aws_condition_variable_notify_all(&run->loopback->signal);
+}
+
+static void s_on_manager_shutdown(void *user_data) {
+    struct loopback_run *run = user_data;
+    aws_mutex_lock(&run->loopback->lock);
+    run->manager_shutdown = true;
+    aws_mutex_unlock(&run->loopback->lock);
+    aws_condition_variable_notify_all(&run->loopback->signal);
+}
+
+static bool s_all_connections_acquired(void *user_data) {
+    struct loopback_run *run = user_data;
+    return run->connections_acquired == run->config.connections;
+}
+
+static bool s_nothing_in_flight(void *user_data) {
+    struct loopback_run *run = user_data;
+    return run->in_flight == 0;
+}
+
+static bool s_manager_is_shutdown(void *user_data) {
+    struct loopback_run *run = user_data;
+    return run->manager_shutdown;
+}
+
+static void s_wait(struct loopback *loopback, aws_condition_predicate_fn *pred, void *user_data) {
+    aws_mutex_lock(&loopback->lock);
+    aws_condition_variable_wait_pred(&loopback->signal, &loopback->lock, pred, user_data);
+    aws_mutex_unlock(&loopback->lock);
+}
+
+static int s_create_manager(struct loopback_run *run) {
+    struct loopback *loopback = run->loopback;
+    const struct loopback_config *config = &run->config;
+
+    struct aws_tls_connection_options tls_options;
+    AWS_ZERO_STRUCT(tls_options);
+    struct aws_byte_cursor host =
+        aws_byte_cursor_from_c_str(config->http2 ? loopback->options->h2_host : "127.0.0.1");
+    if (config->tls) {
+        aws_tls_connection_options_init_from_ctx(
+            &tls_options, config->http2 ? loopback->h2_client_tls_ctx : loopback->client_tls_ctx);
+        struct aws_byte_cursor server_name = aws_byte_cursor_from_c_str("localhost");
+        if (aws_tls_connection_options_set_server_name(&tls_options, loopback->allocator, &server_name)) {
+            aws_tls_connection_options_clean_up(&tls_options);
+            return AWS_OP_ERR;
+        }
+    }
+
+    if (config->http2) {
+        struct aws_http2_stream_manager_options options = {
+            .bootstrap = loopback->client_bootstrap,
+            .socket_options = &loopback->socket_options,
+            .tls_connection_options = config->tls ? &tls_options : NULL,
+            .host = host,
+            .port = loopback->options->h2_port,
+            .ideal_concurrent_streams_per_connection = config->concurrency,
+            .max_connections = config->connections,
+            .shutdown_complete_user_data = run,
+            .shutdown_complete_callback = s_on_manager_shutdown,
+        };
+        run->stream_manager = aws_http2_stream_manager_new(loopback->allocator, &options);
+    } else {
+        struct aws_http_connection_manager_options options = {
+            .bootstrap = loopback->client_bootstrap,
+            .initial_window_size = SIZE_MAX,
+            .socket_options = &loopback->socket_options,
+            .tls_connection_options = config->tls ? &tls_options : NULL,
+            .host = host,
+            .port = config->tls ? loopback->tls_port : loopback->plain_port,
+            .max_connections = config->connections,
+            .shutdown_complete_user_data = run,
+            .shutdown_complete_callback = s_on_manager_shutdown,
+        };
+        run->connection_manager = aws_http_connection_manager_new(loopback->allocator, &options);
+    }
+
+    aws_tls_connection_options_clean_up(&tls_options);
+    return (run->stream_manager || run->connection_manager) ? AWS_OP_SUCCESS : AWS_OP_ERR;
+}
+
+static void s_print_result(
+    const struct loopback_options *options,
+    const struct loopback_run *run,
+    uint64_t elapsed_ns) {
+
+    const struct loopback_config *config = &run->config;
+    double seconds = (double)elapsed_ns / 1e9;
+    double requests_per_sec = seconds > 0 ? (double)run->requests_completed / seconds : 0.0;
+    double mb_per_sec = seconds > 0 ? (double)run->bytes_transferred / seconds / 1e6 : 0.0;
+    uint64_t p50 = aws_http_latency_histogram_percentile(&run->latency, 50.0);
+    uint64_t p99 = aws_http_latency_histogram_percentile(&run->latency, 99.0);
+    uint64_t p999 = aws_http_latency_histogram_percentile(&run->latency, 99.9);
+    const char *protocol = config->http2 ? "h2" : "http1.1";
+    const char *transport = config->tls ? "tls" : "plain";
+
+    if (options->csv) {
+        printf(
+            "%s,%s,%zu,%zu,%zu,%zu,%.1f,%.1f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%zu\n",
+            protocol,
+            transport,
+            config->connections,
+            config->concurrency,
+            config->request_size,
+            config->response_size,
+            requests_per_sec,
+            mb_per_sec,
+            p50,
+            p99,
+            p999,
+            run->errors);
+    } else {
+        printf(
+            "%-8s %-6s %6zu %6zu %10zu %10zu %12.1f %10.1f %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %7zu\n",
+            protocol,
+            transport,
+            config->connections,
+            config->concurrency,
+            config->request_size,
+            config->response_size,
+            requests_per_sec,
+            mb_per_sec,
+            p50,
+            p99,
+            p999,
+            run->errors);
+    }
+    fflush(stdout);
+}
+
+static int s_run(struct loopback *loopback, const struct loopback_config *config) {
+    struct loopback_run run = {
+        .loopback = loopback,
+        .config = *config,
+    };
+
+    char path[64];
+    snprintf(path, sizeof(path), PATH_PREFIX "%zu", config->response_size);
+    run.path = aws_byte_cursor_from_c_str(path);
+
+    run.slot_count = config->connections * config->concurrency;
+    run.slots = aws_mem_calloc(loopback->allocator, run.slot_count, sizeof(struct request_slot));
+    run.connections = aws_mem_calloc(loopback->allocator, config->connections, sizeof(struct aws_http_connection *));
+
+    int result = AWS_OP_ERR;
+    for (size_t i = 0; i < run.slot_count; ++i) {
+        if (s_slot_init(&run.slots[i], &run)) {
+            goto done;
+        }
+    }
+
+    if (s_create_manager(&run)) {
+        goto done;
+    }
+
+    /* HTTP/1.1 connections are set up before the clock starts, HTTP/2 ones as the first streams need them */
+    if (run.connection_manager) {
+        for (size_t i = 0; i < config->connections; ++i) {
+            aws_http_connection_manager_acquire_connection(
+                run.connection_manager, s_on_connection_acquired, &run);
+        }
+        s_wait(loopback, s_all_connections_acquired, &run);
+        if (run.error_code) {
+            goto release_connections;
+        }
+        for (size_t i = 0; i < run.slot_count; ++i) {
+            run.slots[i].connection = run.connections[i % config->connections];
+        }
+    }
+
+    uint64_t start_ns = s_now_ns();
+    run.deadline_ns = start_ns + loopback->options->duration_ns;
+    run.in_flight = run.slot_count;
+    for (size_t i = 0; i < run.slot_count; ++i) {
+        s_send_request(&run.slots[i]);
+    }
+    s_wait(loopback, s_nothing_in_flight, &run);
+    uint64_t elapsed_ns = s_now_ns() - start_ns;
+
+    s_print_result(loopback->options, &run, elapsed_ns);
+    result = run.errors ? AWS_OP_ERR : AWS_OP_SUCCESS;
+
+release_connections:
+    for (size_t i = 0; i < config->connections; ++i) {
+        if (run.connections[i]) {
+            aws_http_connection_manager_release_connection(run.connection_manager, run.connections[i]);
+        }
+    }
+
+done:
+    if (run.connection_manager || run.stream_manager) {
+        if (run.connection_manager) {
+            aws_http_connection_manager_release(run.connection_manager);
+        } else {
+            aws_http2_stream_manager_release(run.stream_manager);
+        }
+        s_wait(loopback, s_manager_is_shutdown, &run);
+    }
+    if (run.error_code && result) {
+        fprintf(stderr, "run failed, %s\n", aws_error_name(run.error_code));
+    }
+    for (size_t i = 0; i < run.slot_count; ++i) {
+        aws_http_message_release(run.slots[i].request);
+        aws_input_stream_release(run.slots[i].body_stream);
+    }
+    aws_mem_release(loopback->allocator, run.slots);
+    aws_mem_release(loopback->allocator, run.connections);
+    return result;
+}
+
+/*
+ * Setup
+ */
+
+static struct aws_tls_ctx *s_client_tls_ctx_new(struct aws_allocator *allocator, const char *alpn_list) {
+    struct aws_tls_ctx_options options;
+    aws_tls_ctx_options_init_default_client(&options, allocator);
+    /* Both servers use the self-signed certificate in tests/resources */
+    aws_tls_ctx_options_set_verify_peer(&options, false);
+    struct aws_tls_ctx *ctx = NULL;
+    if (aws_tls_ctx_options_set_alpn_list(&options, alpn_list) == AWS_OP_SUCCESS) {
+        ctx = aws_tls_client_ctx_new(allocator, &options);
+    }
+    aws_tls_ctx_options_clean_up(&options);
+    return ctx;
+}
+
+static int s_init_tls(struct loopback *loopback) {
+    loopback->client_tls_ctx = s_client_tls_ctx_new(loopback->allocator, "http/1.1");
+    loopback->h2_client_tls_ctx = s_client_tls_ctx_new(loopback->allocator, "h2");
+    if (!loopback->client_tls_ctx || !loopback->h2_client_tls_ctx) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_tls_ctx_options options;
+#ifdef __APPLE__
+    struct aws_byte_cursor pwd_cur = aws_byte_cursor_from_c_str("1234");
+    if (aws_tls_ctx_options_init_server_pkcs12_from_path(
+            &options, loopback->allocator, LOOPBACK_RESOURCES_DIR "/unittests.p12", &pwd_cur)) {
+        return AWS_OP_ERR;
+    }
+#else
+    if (aws_tls_ctx_options_init_default_server_from_path(
+            &options,
+            loopback->allocator,
+            LOOPBACK_RESOURCES_DIR "/unittests.crt",
+            LOOPBACK_RESOURCES_DIR "/unittests.key")) {
+        return AWS_OP_ERR;
+    }
+#endif /* __APPLE__ */
+    aws_tls_ctx_options_set_alpn_list(&options, "http/1.1");
+    loopback->server_tls_ctx = aws_tls_server_ctx_new(loopback->allocator, &options);
+    aws_tls_ctx_options_clean_up(&options);
+    if (!loopback->server_tls_ctx) {
+        return AWS_OP_ERR;
+    }
+    aws_tls_connection_options_init_from_ctx(&loopback->server_tls_options, loopback->server_tls_ctx);
+    return AWS_OP_SUCCESS;
+}
+
+static bool s_servers_destroyed(void *user_data) {
+    struct loopback *loopback = user_data;
+    return loopback->servers_destroyed == (loopback->plain_server ? 1 : 0) + (loopback->tls_server ? 1 : 0);
+}
+
+static int s_loopback_init(struct loopback *loopback) {
+    size_t max_payload = 0;
+    for (size_t i = 0; i < loopback->options->request_sizes.count; ++i) {
+        max_payload = aws_max_size(max_payload, loopback->options->request_sizes.values[i]);
+    }
+    for (size_t i = 0; i < loopback->options->response_sizes.count; ++i) {
+        max_payload = aws_max_size(max_payload, loopback->options->response_sizes.values[i]);
+    }
+    if (aws_byte_buf_init(&loopback->payload, loopback->allocator, max_payload)) {
+        return AWS_OP_ERR;
+    }
+    aws_byte_buf_write_u8_n(&loopback->payload, 'x', max_payload);
+
+    aws_mutex_init(&loopback->lock);
+    aws_condition_variable_init(&loopback->signal);
+
+    loopback->event_loop_group = aws_event_loop_group_new_default(loopback->allocator, 0 /*max_threads*/, NULL);
+    if (!loopback->event_loop_group) {
+        return AWS_OP_ERR;
+    }
+    struct aws_host_resolver_default_options resolver_options = {
+        .el_group = loopback->event_loop_group,
+        .max_entries = 8,
+    };
+    loopback->host_resolver = aws_host_resolver_new_default(loopback->allocator, &resolver_options);
+    struct aws_client_bootstrap_options bootstrap_options = {
+        .event_loop_group = loopback->event_loop_group,
+        .host_resolver = loopback->host_resolver,
+    };
+    loopback->client_bootstrap = aws_client_bootstrap_new(loopback->allocator, &bootstrap_options);
+    loopback->server_bootstrap = aws_server_bootstrap_new(loopback->allocator, loopback->event_loop_group);
+    if (!loopback->host_resolver || !loopback->client_bootstrap || !loopback->server_bootstrap) {
+        return AWS_OP_ERR;
+    }
+
+    loopback->socket_options = (struct aws_socket_options){
+        .type = AWS_SOCKET_STREAM,
+        .domain = AWS_SOCKET_IPV4,
+        .connect_timeout_ms = 10000,
+    };
+
+    if (loopback->options->run_tls && s_init_tls(loopback)) {
+        return AWS_OP_ERR;
+    }
+    if (s_build_static_responses(loopback)) {
+        return AWS_OP_ERR;
+    }
+    if (loopback->options->run_plain) {
+        loopback->plain_server = s_server_new(loopback, false /*tls*/, &loopback->plain_port);
+        if (!loopback->plain_server) {
+            return AWS_OP_ERR;
+        }
+    }
+    if (loopback->options->run_tls) {
+        loopback->tls_server = s_server_new(loopback, true /*tls*/, &loopback->tls_port);
+        if (!loopback->tls_server) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static void s_loopback_clean_up(struct loopback *loopback) {
+    if (loopback->plain_server || loopback->tls_server) {
+        aws_http_server_release(loopback->plain_server);
+        aws_http_server_release(loopback->tls_server);
+        s_wait(loopback, s_servers_destroyed, loopback);
+    }
+    for (size_t i = 0; i < MAX_SWEEP_VALUES; ++i) {
+        aws_http_static_response_release(loopback->static_responses[i]);
+    }
+    if (loopback->server_tls_ctx) {
+        aws_tls_connection_options_clean_up(&loopback->server_tls_options);
+    }
+    aws_tls_ctx_release(loopback->server_tls_ctx);
+    aws_tls_ctx_release(loopback->client_tls_ctx);
+    aws_tls_ctx_release(loopback->h2_client_tls_ctx);
+    aws_server_bootstrap_release(loopback->server_bootstrap);
+    aws_client_bootstrap_release(loopback->client_bootstrap);
+    aws_host_resolver_release(loopback->host_resolver);
+    aws_event_loop_group_release(loopback->event_loop_group);
+    aws_condition_variable_clean_up(&loopback->signal);
+    aws_mutex_clean_up(&loopback->lock);
+    aws_byte_buf_clean_up(&loopback->payload);
+}
+
+/*
+ * Options
+ */
+
+static void s_usage(const char *program) {
+    fprintf(stderr, "usage: %s [options]\n", program);
+    fprintf(stderr, " Sweeps take a comma-separated list of values, and every combination is run.\n");
+    fprintf(stderr, " --connections LIST: connection counts, default 1,4,16\n");
+    fprintf(stderr, " --concurrency LIST: requests in flight per connection, which is the HTTP/1.1 pipelining depth,");
+    fprintf(stderr, " default 1,8\n");
+    fprintf(stderr, " --request-sizes LIST: request body bytes, 0 sends GET, default 0,16384\n");
+    fprintf(stderr, " --response-sizes LIST: response body bytes, default 0,16384,1048576\n");
+    fprintf(stderr, " --transport plain|tls|both: default both\n");
+    fprintf(stderr, " --h2-host HOST --h2-port PORT: also run HTTP/2 against tests/py_localhost/server.py\n");
+    fprintf(stderr, " --duration-ms MS: time to measure each combination for, default %d\n", DEFAULT_DURATION_MS);
+    fprintf(stderr, " --csv: print results as CSV, for tracking across builds\n");
+    fprintf(stderr, " --help: print this message\n");
+}
+
+static int s_parse_sweep(const char *arg, struct sweep *sweep) {
+    sweep->count = 0;
+    struct aws_byte_cursor input = aws_byte_cursor_from_c_str(arg);
+    struct aws_byte_cursor value;
+    AWS_ZERO_STRUCT(value);
+    while (aws_byte_cursor_next_split(&input, ',', &value)) {
+        uint64_t parsed = 0;
+        if (sweep->count == MAX_SWEEP_VALUES || aws_byte_cursor_utf8_parse_u64(value, &parsed) ||
+            parsed > SIZE_MAX) {
+            return AWS_OP_ERR;
+        }
+        sweep->values[sweep->count++] = (size_t)parsed;
+    }
+    return sweep->count ? AWS_OP_SUCCESS : AWS_OP_ERR;
+}
+
+static int s_parse_options(int argc, char **argv, struct loopback_options *options) {
+    s_parse_sweep("1,4,16", &options->connections);
+    s_parse_sweep("1,8", &options->concurrency);
+    s_parse_sweep("0,16384", &options->request_sizes);
+    s_parse_sweep("0,16384,1048576", &options->response_sizes);
+    options->run_plain = true;
+    options->run_tls = true;
+    options->duration_ns = aws_timestamp_convert(DEFAULT_DURATION_MS, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--connections") == 0 && has_value) {
+            if (s_parse_sweep(argv[++i], &options->connections)) {
+                return AWS_OP_ERR;
+            }
+        } else if (strcmp(argv[i], "--concurrency") == 0 && has_value) {
+            if (s_parse_sweep(argv[++i], &options->concurrency)) {
+                return AWS_OP_ERR;
+            }
+        } else if (strcmp(argv[i], "--request-sizes") == 0 && has_value) {
+            if (s_parse_sweep(argv[++i], &options->request_sizes)) {
+                return AWS_OP_ERR;
+            }
+        } else if (strcmp(argv[i], "--response-sizes") == 0 && has_value) {
+            if (s_parse_sweep(argv[++i], &options->response_sizes)) {
+                return AWS_OP_ERR;
+            }
+        } else if (strcmp(argv[i], "--transport") == 0 && has_value) {
+            const char *transport = argv[++i];
+            options->run_plain = strcmp(transport, "plain") == 0 || strcmp(transport, "both") == 0;
+            options->run_tls = strcmp(transport, "tls") == 0 || strcmp(transport, "both") == 0;
+            if (!options->run_plain && !options->run_tls) {
+                return AWS_OP_ERR;
+            }
+        } else if (strcmp(argv[i], "--h2-host") == 0 && has_value) {
+            options->h2_host = argv[++i];
+        } else if (strcmp(argv[i], "--h2-port") == 0 && has_value) {
+            options->h2_port = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--duration-ms") == 0 && has_value) {
+            uint64_t duration_ms = strtoull(argv[++i], NULL, 10);
+            if (duration_ms == 0) {
+                return AWS_OP_ERR;
+            }
+            options->duration_ns = aws_timestamp_convert(duration_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            options->csv = true;
+        } else {
+            return AWS_OP_ERR;
+        }
+    }
+
+    for (size_t i = 0; i < options->connections.count; ++i) {
+        if (options->connections.values[i] == 0) {
+            return AWS_OP_ERR;
+        }
+    }
+    for (size_t i = 0; i < options->concurrency.count; ++i) {
+        if (options->concurrency.values[i] == 0) {
+            return AWS_OP_ERR;
+        }
+    }
+    /* server.py only listens with TLS */
+    if (options->h2_host && (options->h2_port == 0 || !options->run_tls)) {
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    struct loopback_options options;
+    AWS_ZERO_STRUCT(options);
+    if (s_parse_options(argc, argv, &options)) {
+        s_usage(argv[0]);
+        return 1;
+    }
+
+    struct aws_allocator *allocator = aws_default_allocator();
+    aws_http_library_init(allocator);
+
+    struct loopback loopback = {
+        .allocator = allocator,
+        .options = &options,
+    };
+
+    int exit_code = 0;
+    if (s_loopback_init(&loopback)) {
+        fprintf(stderr, "setup failed, %s\n", aws_error_name(aws_last_error()));
+        exit_code = 1;
+        goto done;
+    }
+
+    if (options.csv) {
+        printf("protocol,transport,connections,concurrency,request_bytes,response_bytes,"
+               "requests_per_sec,mb_per_sec,p50_us,p99_us,p999_us,errors\n");
+    } else {
+        printf(
+            "%-8s %-6s %6s %6s %10s %10s %12s %10s %10s %10s %10s %7s\n",
+            "protocol",
+            "tls",
+            "conns",
+            "depth",
+            "req bytes",
+            "resp bytes",
+            "req/s",
+            "MB/s",
+            "p50 us",
+            "p99 us",
+            "p99.9 us",
+            "errors");
+    }
+
+    for (int http2 = 0; http2 <= (options.h2_host ? 1 : 0); ++http2) {
+        for (int tls = 0; tls <= 1; ++tls) {
+            if ((tls ? !options.run_tls : !options.run_plain) || (http2 && !tls)) {
+                continue;
+            }
+            for (size_t c = 0; c < options.connections.count; ++c) {
+                for (size_t d = 0; d < options.concurrency.count; ++d) {
+                    for (size_t q = 0; q < options.request_sizes.count; ++q) {
+                        for (size_t r = 0; r < options.response_sizes.count; ++r) {
+                            struct loopback_config config = {
+                                .http2 = http2,
+                                .tls = tls,
+                                .connections = options.connections.values[c],
+                                .concurrency = options.concurrency.values[d],
+                                .request_size = options.request_sizes.values[q],
+                                .response_size = options.response_sizes.values[r],
+                            };
+                            if (s_run(&loopback, &config)) {
+                                exit_code = 1;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+done:
+    s_loopback_clean_up(&loopback);
+    aws_http_library_clean_up();
+    return exit_code;
+}
@@ -0,0 +1,593 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+/*
+ * Load generation for elasticurl.
+ *
+ * Every in-flight request is a slot, with its own copy of the request and body stream.
+ * Closed-loop runs re-send from a slot as soon as its response completes.
+ * Open-loop runs send on a schedule from a task on one of the event loops, and requests that come due while
+ * every slot is busy are skipped and counted, rather than sent late.
+ *
+ * HTTP/1.1 requests lease a connection from an aws_http_connection_manager for each request, and HTTP/2 requests
+ * go through an aws_http2_stream_manager, the same way an SDK built on this library would send them.
+ */
+
+#include "load.h"
+
+#include <aws/common/clock.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/mutex.h>
+#include <aws/common/task_scheduler.h>
+#include <aws/http/connection.h>
+#include <aws/http/connection_manager.h>
+#include <aws/http/http2_stream_manager.h>
+#include <aws/http/request_response.h>
+#include <aws/http/statistics.h>
+#include <aws/io/event_loop.h>
+#include <aws/io/stream.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4204) /* Declared initializers */
+#endif
+
+#define MAX_ERROR_KINDS 16
+
+/* How far a failed request got, worked out from its aws_http_stream_metrics */
+enum load_failure_phase {
+    /* No connection, or the request never started to be sent */
+    LOAD_FAILURE_BEFORE_SEND,
+    /* The request went out, but no response arrived */
+    LOAD_FAILURE_BEFORE_RESPONSE,
+    /* The response started, but didn't complete */
+    LOAD_FAILURE_DURING_RESPONSE,
+    LOAD_FAILURE_PHASE_COUNT,
+};
+
+static const char *s_failure_phase_names[LOAD_FAILURE_PHASE_COUNT] = {
+    "before send",
+    "before response",
+    "during response",
+};
+
+struct load_error_kind {
+    int error_code;
+    uint64_t counts[LOAD_FAILURE_PHASE_COUNT];
+};
+
+struct load_slot {
+    struct load_run *run;
+    struct aws_http_message *request;
+    struct aws_input_stream *body_stream;
+    /* HTTP/1.1 only, the connection leased for the current request */
+    struct aws_http_connection *connection;
+    /* When the request was sent, or for open-loop runs, when it was due */
+    uint64_t start_ns;
+    uint64_t response_body_bytes;
+    struct aws_http_stream_metrics metrics;
+    bool has_metrics;
+};
+
+struct load_run {
+    struct aws_allocator *allocator;
+    const struct elasticurl_load_options *options;
+
+    struct aws_http_connection_manager *connection_manager;
+    struct aws_http2_stream_manager *stream_manager;
+
+    struct load_slot *slots;
+    /* Slots the scheduler task is about to send from. Only touched by the scheduler task */
+    struct load_slot **to_send;
+    struct aws_event_loop *scheduler_loop;
+    struct aws_task scheduler_task;
+    uint64_t start_ns;
+    uint64_t deadline_ns;
+
+    struct aws_mutex lock;
+    struct aws_condition_variable signal;
+
+    /* Everything below is guarded by lock */
+    struct {
+        struct load_slot **free_slots;
+        size_t free_slot_count;
+        size_t in_flight;
+        /* True while the scheduler task is scheduled or running */
+        bool scheduling;
+        bool manager_shutdown;
+
+        uint64_t requests_sent;
+        /* Open-loop only, how many points on the schedule have passed */
+        uint64_t requests_due;
+        uint64_t requests_skipped;
+        uint64_t responses;
+        uint64_t response_body_bytes;
+        /* Responses by status class, index 0 holds anything outside 1xx-5xx */
+        uint64_t status_classes[6];
+
+        struct load_error_kind errors[MAX_ERROR_KINDS];
+        size_t error_kind_count;
+        uint64_t error_count;
+        uint64_t unlisted_error_count;
+
+        struct aws_http_latency_histogram latency;
+        struct aws_http_latency_histogram queue_latency;
+        struct aws_http_latency_histogram first_byte_latency;
+    } synced_data;
+};
+
+static uint64_t s_now_ns(void) {
+    uint64_t now = 0;
+    aws_high_res_clock_get_ticks(&now);
+    return now;
+}
+
+static uint64_t s_ns_to_us(uint64_t ns) {
+    return aws_timestamp_convert(ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MICROS, NULL);
+}
+
+static void s_schedule_synced(struct load_run *run, uint64_t run_at_ns);
+
+/* Must be called with the lock held */
+static bool s_budget_remains_synced(const struct load_run *run, uint64_t now_ns) {
+    if (run->options->requests && run->synced_data.requests_sent >= run->options->requests) {
+        return false;
+    }
+    if (run->deadline_ns && now_ns >= run->deadline_ns) {
+        return false;
+    }
+    return true;
+}
+
+static enum load_failure_phase s_failure_phase(const struct load_slot *slot) {
+    if (!slot->has_metrics || slot->metrics.send_start_timestamp_ns < 0) {
+        return LOAD_FAILURE_BEFORE_SEND;
+    }
+    if (slot->metrics.receive_start_timestamp_ns < 0) {
+        return LOAD_FAILURE_BEFORE_RESPONSE;
+    }
+    return LOAD_FAILURE_DURING_RESPONSE;
+}
+
+/* Must be called with the lock held */
+static void s_record_error_synced(struct load_run *run, int error_code, enum load_failure_phase phase) {
+    run->synced_data.error_count++;
+    for (size_t i = 0; i < run->synced_data.error_kind_count; ++i) {
+        if (run->synced_data.errors[i].error_code == error_code) {
+            run->synced_data.errors[i].counts[phase]++;
+            return;
+        }
+    }
+    if (run->synced_data.error_kind_count == MAX_ERROR_KINDS) {
+        run->synced_data.unlisted_error_count++;
+        return;
+    }
+    struct load_error_kind *kind = &run->synced_data.errors[run->synced_data.error_kind_count++];
+    kind->error_code = error_code;
+    kind->counts[phase] = 1;
+}
+
+/*
+ * Sending
+ */
+
+static void s_slot_complete(struct load_slot *slot, int error_code, int status);
+
+static int s_on_response_body(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
+    (void)stream;
+    struct load_slot *slot = user_data;
+    slot->response_body_bytes += data->len;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_metrics(
+    struct aws_http_stream *stream,
+    const struct aws_http_stream_metrics *metrics,
+    void *user_data) {
+
+    (void)stream;
+    struct load_slot *slot = user_data;
+    slot->metrics = *metrics;
+    slot->has_metrics = true;
+}
+
+static void s_on_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct load_slot *slot = user_data;
+    int status = 0;
+    if (!error_code) {
+        aws_http_stream_get_incoming_response_status(stream, &status);
+    }
+    aws_http_stream_release(stream);
+
+    if (slot->connection) {
+        aws_http_connection_manager_release_connection(slot->run->connection_manager, slot->connection);
+        slot->connection = NULL;
+    }
+    s_slot_complete(slot, error_code, status);
+}
+
+static struct aws_http_make_request_options s_make_request_options(struct load_slot *slot) {
+    struct aws_http_make_request_options options = {
+        .self_size = sizeof(options),
+        .request = slot->request,
+        .user_data = slot,
+        .on_response_body = s_on_response_body,
+        .on_metrics = s_on_metrics,
+        .on_complete = s_on_stream_complete,
+    };
+    return options;
+}
+
+static void s_on_connection_acquired(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct load_slot *slot = user_data;
+    if (!connection) {
+        s_slot_complete(slot, error_code, 0 /*status*/);
+        return;
+    }
+
+    slot->connection = connection;
+    struct aws_http_make_request_options options = s_make_request_options(slot);
+    struct aws_http_stream *stream = aws_http_connection_make_request(connection, &options);
+    if (!stream || aws_http_stream_activate(stream)) {
+        error_code = aws_last_error();
+        aws_http_stream_release(stream);
+        aws_http_connection_manager_release_connection(slot->run->connection_manager, connection);
+        slot->connection = NULL;
+        s_slot_complete(slot, error_code, 0 /*status*/);
+    }
+}
+
+static void s_on_h2_stream_acquired(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct load_slot *slot = user_data;
+    if (!stream) {
+        s_slot_complete(slot, error_code, 0 /*status*/);
+    }
+}
+
+static void s_slot_send(struct load_slot *slot) {
+    slot->response_body_bytes = 0;
+    slot->has_metrics = false;
+    if (slot->body_stream) {
+        aws_input_stream_seek(slot->body_stream, 0, AWS_SSB_BEGIN);
+    }
+
+    struct load_run *run = slot->run;
+    if (run->stream_manager) {
+        struct aws_http_make_request_options options = s_make_request_options(slot);
+        struct aws_http2_stream_manager_acquire_stream_options acquire_options = {
+            .callback = s_on_h2_stream_acquired,
+            .user_data = slot,
+            .options = &options,
+        };
+        aws_http2_stream_manager_acquire_stream(run->stream_manager, &acquire_options);
+    } else {
+        aws_http_connection_manager_acquire_connection(run->connection_manager, s_on_connection_acquired, slot);
+    }
+}
+
+/* Records a finished request, then sends the next one from the slot or hands the slot back */
+static void s_slot_complete(struct load_slot *slot, int error_code, int status) {
+    struct load_run *run = slot->run;
+    uint64_t now_ns = s_now_ns();
+    bool closed_loop = run->options->rate == 0;
+    bool send_again = false;
+
+    aws_mutex_lock(&run->lock);
+    if (error_code) {
+        s_record_error_synced(run, error_code, s_failure_phase(slot));
+    } else {
+        run->synced_data.responses++;
+        run->synced_data.response_body_bytes += slot->response_body_bytes;
+        run->synced_data.status_classes[status >= 100 && status < 600 ? status / 100 : 0]++;
+        aws_http_latency_histogram_record(&run->synced_data.latency, s_ns_to_us(now_ns - slot->start_ns));
+        if (slot->has_metrics && slot->metrics.queue_duration_ns >= 0) {
+            aws_http_latency_histogram_record(
+                &run->synced_data.queue_latency, s_ns_to_us((uint64_t)slot->metrics.queue_duration_ns));
+        }
+        if (slot->has_metrics && slot->metrics.time_to_first_byte_ns >= 0) {
+            aws_http_latency_histogram_record(
+                &run->synced_data.first_byte_latency, s_ns_to_us((uint64_t)slot->metrics.time_to_first_byte_ns));
+        }
+    }
+
+    /* Failures aren't re-sent from here, since a request that fails synchronously would recurse.
+     * The slot goes back to the scheduler task instead. */
+    if (closed_loop && !error_code && s_budget_remains_synced(run, now_ns)) {
+        run->synced_data.requests_sent++;
+        send_again = true;
+        slot->start_ns = now_ns;
+    } else {
+        run->synced_data.free_slots[run->synced_data.free_slot_count++] = slot;
+        run->synced_data.in_flight--;
+        if (closed_loop && error_code && !run->synced_data.scheduling) {
+            s_schedule_synced(run, now_ns);
+        }
+        aws_condition_variable_notify_all(&run->signal);
+    }
+    aws_mutex_unlock(&run->lock);
+
+    if (send_again) {
+        s_slot_send(slot);
+    }
+}
+
+/*
+ * Scheduling
+ */
+
+/* Must be called with the lock held */
+static void s_schedule_synced(struct load_run *run, uint64_t run_at_ns) {
+    run->synced_data.scheduling = true;
+    aws_event_loop_schedule_task_future(run->scheduler_loop, &run->scheduler_task, run_at_ns);
+}
+
+/*
+ * Takes free slots for the requests that are due.
+ * Closed-loop runs fill every free slot, open-loop runs take one slot per point on the schedule that has passed.
+ * Returns how many slots went into run->to_send. Must be called with the lock held.
+ */
+static size_t s_take_due_slots_synced(struct load_run *run, uint64_t now_ns) {
+    size_t count = 0;
+    double rate = run->options->rate;
+    uint64_t due = rate > 0 ? (uint64_t)((double)(now_ns - run->start_ns) * rate / 1e9) + 1 : UINT64_MAX;
+
+    while (run->synced_data.requests_due < due && s_budget_remains_synced(run, now_ns)) {
+        uint64_t start_ns = now_ns;
+        if (rate > 0) {
+            start_ns = run->start_ns + (uint64_t)((double)run->synced_data.requests_due * 1e9 / rate);
+            run->synced_data.requests_due++;
+        }
+        if (run->synced_data.free_slot_count == 0) {
+            if (rate > 0) {
+                run->synced_data.requests_skipped++;
+                continue;
+            }
+            break;
+        }
+
+        struct load_slot *slot = run->synced_data.free_slots[--run->synced_data.free_slot_count];
+        slot->start_ns = start_ns;
+        run->synced_data.requests_sent++;
+        run->synced_data.in_flight++;
+        run->to_send[count++] = slot;
+    }
+    return count;
+}
+
+static void s_scheduler_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct load_run *run = arg;
+    uint64_t now_ns = s_now_ns();
+
+    aws_mutex_lock(&run->lock);
+    size_t count = status == AWS_TASK_STATUS_RUN_READY ? s_take_due_slots_synced(run, now_ns) : 0;
+    bool reschedule = status == AWS_TASK_STATUS_RUN_READY && run->options->rate > 0 &&
+                      s_budget_remains_synced(run, now_ns);
+    if (reschedule) {
+        uint64_t next_due_ns =
+            run->start_ns + (uint64_t)((double)run->synced_data.requests_due * 1e9 / run->options->rate);
+        s_schedule_synced(run, aws_max_u64(now_ns, next_due_ns));
+    } else {
+        run->synced_data.scheduling = false;
+        aws_condition_variable_notify_all(&run->signal);
+    }
+    aws_mutex_unlock(&run->lock);
+
+    for (size_t i = 0; i < count; ++i) {
+        s_slot_send(run->to_send[i]);
+    }
+}
+
+/*
+ * Setup and reporting
+ */
+
+static void s_on_manager_shutdown(void *user_data) {
+    struct load_run *run = user_data;
+    aws_mutex_lock(&run->lock);
+    run->synced_data.manager_shutdown = true;
+    aws_condition_variable_notify_all(&run->signal);
+    aws_mutex_unlock(&run->lock);
+}
+
+static bool s_is_run_done(void *user_data) {
+    struct load_run *run = user_data;
+    return !run->synced_data.scheduling && run->synced_data.in_flight == 0;
+}
+
+static bool s_is_manager_shutdown(void *user_data) {
+    struct load_run *run = user_data;
+    return run->synced_data.manager_shutdown;
+}
+
+static int s_create_manager(struct load_run *run) {
+    const struct elasticurl_load_options *options = run->options;
+
+    if (options->http2) {
+        struct aws_http2_stream_manager_options manager_options = {
+            .bootstrap = options->bootstrap,
+            .socket_options = options->socket_options,
+            .tls_connection_options = options->tls_options,
+            .http2_prior_knowledge = options->http2_prior_knowledge,
+            .host = options->host,
+            .port = options->port,
+            .ideal_concurrent_streams_per_connection =
+                (options->concurrency + options->connections - 1) / options->connections,
+            .max_connections = options->connections,
+            .shutdown_complete_user_data = run,
+            .shutdown_complete_callback = s_on_manager_shutdown,
+        };
+        run->stream_manager = aws_http2_stream_manager_new(run->allocator, &manager_options);
+        return run->stream_manager ? AWS_OP_SUCCESS : AWS_OP_ERR;
+    }
+
+    struct aws_http_connection_manager_options manager_options = {
+        .bootstrap = options->bootstrap,
+        .initial_window_size = SIZE_MAX,
+        .socket_options = options->socket_options,
+        .tls_connection_options = options->tls_options,
+        .host = options->host,
+        .port = options->port,
+        .max_connections = options->connections,
+        .shutdown_complete_user_data = run,
+        .shutdown_complete_callback = s_on_manager_shutdown,
+    };
+    run->connection_manager = aws_http_connection_manager_new(run->allocator, &manager_options);
+    return run->connection_manager ? AWS_OP_SUCCESS : AWS_OP_ERR;
+}
+
+static int s_slot_init(struct load_slot *slot, struct load_run *run) {
+    slot->run = run;
+    slot->request = run->options->new_request(run->options->user_data);
+    if (!slot->request) {
+        return AWS_OP_ERR;
+    }
+
+    if (run->options->body.len) {
+        struct aws_byte_cursor body = run->options->body;
+        slot->body_stream = aws_input_stream_new_from_cursor(run->allocator, &body);
+        if (!slot->body_stream) {
+            return AWS_OP_ERR;
+        }
+    }
+    aws_http_message_set_body_stream(slot->request, slot->body_stream);
+    return AWS_OP_SUCCESS;
+}
+
+static void s_print_latency(const char *name, const struct aws_http_latency_histogram *histogram) {
+    if (histogram->count == 0) {
+        return;
+    }
+    printf(
+        "  %-12s %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+        name,
+        (double)aws_http_latency_histogram_percentile(histogram, 50.0) / 1000.0,
+        (double)aws_http_latency_histogram_percentile(histogram, 90.0) / 1000.0,
+        (double)aws_http_latency_histogram_percentile(histogram, 99.0) / 1000.0,
+        (double)aws_http_latency_histogram_percentile(histogram, 99.9) / 1000.0,
+        (double)histogram->max_us / 1000.0);
+}
+
+static void s_print_report(const struct load_run *run, uint64_t elapsed_ns) {
+    double seconds = (double)elapsed_ns / 1e9;
+    double per_second = seconds > 0 ? 1.0 / seconds : 0.0;
+
+    printf(
+        "%" PRIu64 " requests in %.2fs over at most %zu %s connections, %.1f responses/s, %.2f MB/s of body\n",
+        run->synced_data.requests_sent,
+        seconds,
+        run->options->connections,
+        run->options->http2 ? "HTTP/2" : "HTTP/1.1",
+        (double)run->synced_data.responses * per_second,
+        (double)run->synced_data.response_body_bytes * per_second / 1e6);
+
+    printf("Status codes:");
+    static const char *s_status_class_names[6] = {"other", "1xx", "2xx", "3xx", "4xx", "5xx"};
+    for (size_t i = 1; i <= AWS_ARRAY_SIZE(s_status_class_names); ++i) {
+        size_t class_index = i % AWS_ARRAY_SIZE(s_status_class_names);
+        if (run->synced_data.status_classes[class_index]) {
+            printf(
+                " %s=%" PRIu64, s_status_class_names[class_index], run->synced_data.status_classes[class_index]);
+        }
+    }
+    printf("\n");
+
+    if (run->synced_data.requests_skipped) {
+        printf(
+            "Skipped %" PRIu64 " requests that came due while all %zu requests were in flight, raise --concurrency\n",
+            run->synced_data.requests_skipped,
+            run->options->concurrency);
+    }
+
+    printf("Latency (ms)        p50        p90        p99      p99.9        max\n");
+    s_print_latency("total", &run->synced_data.latency);
+    s_print_latency("queued", &run->synced_data.queue_latency);
+    s_print_latency("first byte", &run->synced_data.first_byte_latency);
+
+    if (run->synced_data.error_count) {
+        printf("Errors: %" PRIu64 "\n", run->synced_data.error_count);
+        for (size_t i = 0; i < run->synced_data.error_kind_count; ++i) {
+            const struct load_error_kind *kind = &run->synced_data.errors[i];
+            printf("  %s:", aws_error_name(kind->error_code));
+            for (size_t phase = 0; phase < LOAD_FAILURE_PHASE_COUNT; ++phase) {
+                if (kind->counts[phase]) {
+                    printf(" %s=%" PRIu64, s_failure_phase_names[phase], kind->counts[phase]);
+                }
+            }
+            printf("\n");
+        }
+        if (run->synced_data.unlisted_error_count) {
+            printf("  other errors: %" PRIu64 "\n", run->synced_data.unlisted_error_count);
+        }
+    }
+    fflush(stdout);
+}
+
+int elasticurl_load_run(struct aws_allocator *allocator, const struct elasticurl_load_options *options) {
+    AWS_FATAL_ASSERT(options->concurrency > 0 && options->connections > 0);
+
+    struct load_run run = {
+        .allocator = allocator,
+        .options = options,
+        .scheduler_loop = aws_event_loop_group_get_next_loop(options->event_loop_group),
+    };
+    aws_mutex_init(&run.lock);
+    aws_condition_variable_init(&run.signal);
+    aws_task_init(&run.scheduler_task, s_scheduler_task, &run, "elasticurl_load_scheduler");
+
+    run.slots = aws_mem_calloc(allocator, options->concurrency, sizeof(struct load_slot));
+    run.to_send = aws_mem_calloc(allocator, options->concurrency, sizeof(struct load_slot *));
+    run.synced_data.free_slots = aws_mem_calloc(allocator, options->concurrency, sizeof(struct load_slot *));
+
+    int result = AWS_OP_ERR;
+    for (size_t i = 0; i < options->concurrency; ++i) {
+        if (s_slot_init(&run.slots[i], &run)) {
+            fprintf(stderr, "Failed to create request with error %s\n", aws_error_debug_str(aws_last_error()));
+            goto done;
+        }
+        run.synced_data.free_slots[run.synced_data.free_slot_count++] = &run.slots[i];
+    }
+
+    if (s_create_manager(&run)) {
+        fprintf(stderr, "Failed to create connection manager with error %s\n", aws_error_debug_str(aws_last_error()));
+        goto done;
+    }
+
+    run.start_ns = s_now_ns();
+    run.deadline_ns = options->duration_ns ? run.start_ns + options->duration_ns : 0;
+
+    aws_mutex_lock(&run.lock);
+    s_schedule_synced(&run, run.start_ns);
+    aws_condition_variable_wait_pred(&run.signal, &run.lock, s_is_run_done, &run);
+    aws_mutex_unlock(&run.lock);
+    uint64_t elapsed_ns = s_now_ns() - run.start_ns;
+
+    s_print_report(&run, elapsed_ns);
+    result = run.synced_data.responses ? AWS_OP_SUCCESS : AWS_OP_ERR;
+
+done:
+    if (run.connection_manager || run.stream_manager) {
+        if (run.connection_manager) {
+            aws_http_connection_manager_release(run.connection_manager);
+        } else {
+            aws_http2_stream_manager_release(run.stream_manager);
+        }
+        aws_mutex_lock(&run.lock);
+        aws_condition_variable_wait_pred(&run.signal, &run.lock, s_is_manager_shutdown, &run);
+        aws_mutex_unlock(&run.lock);
+    }
+    for (size_t i = 0; i < options->concurrency; ++i) {
+        aws_http_message_release(run.slots[i].request);
+        aws_input_stream_release(run.slots[i].body_stream);
+    }
+    aws_mem_release(allocator, run.slots);
+    aws_mem_release(allocator, run.to_send);
+    aws_mem_release(allocator, run.synced_data.free_slots);
+    aws_condition_variable_clean_up(&run.signal);
+    aws_mutex_clean_up(&run.lock);
+    return result;
+}
@@ -0,0 +1,58 @@
+#ifndef ELASTICURL_LOAD_H
+#define ELASTICURL_LOAD_H
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/common/byte_buf.h>
+
+struct aws_client_bootstrap;
+struct aws_event_loop_group;
+struct aws_http_message;
+struct aws_socket_options;
+struct aws_tls_connection_options;
+
+/* Builds a request with no body stream. The load run gives each in-flight request its own stream over `body`. */
+typedef struct aws_http_message *(elasticurl_load_new_request_fn)(void *user_data);
+
+struct elasticurl_load_options {
+    /* Stop after this many requests have been sent. 0 for no limit */
+    size_t requests;
+    /* Stop sending once this much time has passed. 0 for no limit */
+    uint64_t duration_ns;
+    /* Most requests in flight at once */
+    size_t concurrency;
+    /*
+     * Requests per second, sent on a fixed schedule whether or not earlier responses have arrived (open-loop).
+     * Latency is measured from when each request was due, not from when a free slot let it go out.
+     * 0 sends a new request as soon as one completes (closed-loop).
+     */
+    double rate;
+    /* Most connections to open */
+    size_t connections;
+
+    /* HTTP/2 requests go through an aws_http2_stream_manager, HTTP/1.1 ones through an aws_http_connection_manager */
+    bool http2;
+    bool http2_prior_knowledge;
+
+    struct aws_event_loop_group *event_loop_group;
+    struct aws_client_bootstrap *bootstrap;
+    const struct aws_socket_options *socket_options;
+    const struct aws_tls_connection_options *tls_options;
+    struct aws_byte_cursor host;
+    uint32_t port;
+
+    struct aws_byte_cursor body;
+    elasticurl_load_new_request_fn *new_request;
+    void *user_data;
+};
+
+/**
+ * Sends requests until the request count or duration is reached, then prints throughput, latency percentiles
+ * and a breakdown of failures to stdout.
+ * Returns AWS_OP_ERR if the run couldn't be set up, or if no request succeeded.
+ */
+int elasticurl_load_run(struct aws_allocator *allocator, const struct elasticurl_load_options *options);
+
+#endif /* ELASTICURL_LOAD_H */
@@ -2,9 +2,13 @@
  * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
  * SPDX-License-Identifier: Apache-2.0.
  */
+#include "load.h"
+#include "ranged_download.h"
+
 #include <aws/http/connection.h>
 #include <aws/http/request_response.h>
 
+#include <aws/common/clock.h>
 #include <aws/common/command_line_parser.h>
 #include <aws/common/condition_variable.h>
 #include <aws/common/hash_table.h>
@@ -16,6 +20,7 @@
 
 #include <aws/io/channel_bootstrap.h>
 #include <aws/io/event_loop.h>
+#include <aws/io/host_resolver.h>
 #include <aws/io/logging.h>
 #include <aws/io/shared_library.h>
 #include <aws/io/socket.h>
@@ -24,6 +29,7 @@
 #include <aws/io/uri.h>
 
 #include <inttypes.h>
+#include <stdlib.h>
 
 #ifdef _MSC_VER
 #    pragma warning(disable : 4996) /* Disable warnings about fopen() being insecure */
@@ -64,6 +70,25 @@ struct elasticurl_ctx {
     enum aws_log_level log_level;
     enum aws_http_version required_http_version;
     bool exchange_completed;
+    /* Set by any of the load options, which send many requests and report on them instead of printing a response */
+    bool load_mode;
+    struct elasticurl_load_options load;
+    /* Set by --ranged, which downloads to --output in byte ranges, several at once */
+    bool ranged_download;
+    uint64_t part_size;
+    /* Set by --timing, which prints where the time went once the response is done */
+    bool print_timing;
+    struct {
+        int64_t start_ns;
+        int64_t dns_done_ns;
+        int dns_error_code;
+        bool dns_done;
+        struct aws_http_connection_setup_metrics setup_metrics;
+        bool has_setup_metrics;
+        struct aws_http_stream_metrics stream_metrics;
+        bool has_stream_metrics;
+        uint64_t response_body_bytes;
+    } timing;
 };
 
 static void s_usage(int exit_code) {
@@ -96,6 +121,19 @@ static void s_usage(int exit_code) {
     fprintf(stderr, "      --version: print the version of elasticurl.\n");
     fprintf(stderr, "      --http2: HTTP/2 connection required\n");
     fprintf(stderr, "      --http1_1: HTTP/1.1 connection required\n");
+    fprintf(stderr, "      --timing: print DNS, connect, TLS, first byte and transfer times to stderr.\n");
+    fprintf(stderr, "\n Load options, which send many requests and print throughput, latency and errors:\n\n");
+    fprintf(stderr, "  -n, --requests INT: number of requests to send.\n");
+    fprintf(stderr, "      --concurrency INT: most requests in flight at once. Default is 10.\n");
+    fprintf(stderr, "      --duration TIME: how long to send requests for, e.g. 30s, 500ms, 2m. Default is 10s\n");
+    fprintf(stderr, "                       if --requests isn't set.\n");
+    fprintf(stderr, "      --rate FLOAT: requests per second, sent on schedule whether or not responses have\n");
+    fprintf(stderr, "                    arrived. By default a new request is sent as soon as one completes.\n");
+    fprintf(stderr, "      --connections INT: most connections to open. Default is --concurrency for HTTP/1.1,\n");
+    fprintf(stderr, "                         and 1 for HTTP/2, which multiplexes requests.\n");
+    fprintf(stderr, "\n Ranged download, which also uses --concurrency and --connections:\n\n");
+    fprintf(stderr, "      --ranged: find the size with HEAD, then GET byte ranges of it in parallel into --output.\n");
+    fprintf(stderr, "      --part-size SIZE: size of each range, e.g. 8388608, 512K, 8M. Default is 8M.\n");
     fprintf(stderr, "  -h, --help\n");
     fprintf(stderr, "            Display this message and quit.\n");
     exit(exit_code);
@@ -125,6 +163,14 @@ static struct aws_cli_option s_long_options[] = {
     {"version", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'V'},
     {"http2", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'w'},
     {"http1_1", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'W'},
+    {"timing", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'T'},
+    {"requests", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'n'},
+    {"concurrency", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'q'},
+    {"duration", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'D'},
+    {"rate", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'R'},
+    {"connections", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'N'},
+    {"ranged", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'r'},
+    {"part-size", AWS_CLI_OPTIONS_REQUIRED_ARGUMENT, NULL, 'z'},
     {"help", AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 'h'},
     /* Per getopt(3) the last element of the array has to be filled with all zeros */
     {NULL, AWS_CLI_OPTIONS_NO_ARGUMENT, NULL, 0},
@@ -157,12 +203,61 @@ static int s_parse_signing_context(
     return AWS_OP_SUCCESS;
 }
 
+/* Parses a duration such as 30, 30s, 500ms or 2m. Plain numbers are seconds. */
+static uint64_t s_parse_duration_ns(const char *duration) {
+    char *suffix = NULL;
+    double value = strtod(duration, &suffix);
+    uint64_t unit_ns = AWS_TIMESTAMP_NANOS;
+    if (!strcmp(suffix, "ms")) {
+        unit_ns = AWS_TIMESTAMP_NANOS / AWS_TIMESTAMP_MILLIS;
+    } else if (!strcmp(suffix, "m")) {
+        unit_ns = 60 * (uint64_t)AWS_TIMESTAMP_NANOS;
+    } else if (strcmp(suffix, "s") && strcmp(suffix, "")) {
+        value = 0;
+    }
+    if (suffix == duration || value <= 0) {
+        fprintf(stderr, "invalid duration %s.\n", duration);
+        s_usage(1);
+    }
+    return (uint64_t)(value * (double)unit_ns);
+}
+
+static size_t s_parse_positive_count(const char *count, const char *option_name) {
+    long long value = atoll(count);
+    if (value <= 0) {
+        fprintf(stderr, "--%s must be a positive integer.\n", option_name);
+        s_usage(1);
+    }
+    return (size_t)value;
+}
+
+/* Parses a size such as 1048576, 512K or 8M. The suffixes are powers of 1024. */
+static uint64_t s_parse_size(const char *size) {
+    char *suffix = NULL;
+    unsigned long long value = strtoull(size, &suffix, 10);
+    uint64_t multiplier = 1;
+    if (!strcmp(suffix, "K")) {
+        multiplier = 1024;
+    } else if (!strcmp(suffix, "M")) {
+        multiplier = 1024 * 1024;
+    } else if (!strcmp(suffix, "G")) {
+        multiplier = 1024 * 1024 * 1024;
+    } else if (strcmp(suffix, "")) {
+        value = 0;
+    }
+    if (suffix == size || value == 0) {
+        fprintf(stderr, "invalid size %s.\n", size);
+        s_usage(1);
+    }
+    return (uint64_t)value * multiplier;
+}
+
 static void s_parse_options(int argc, char **argv, struct elasticurl_ctx *ctx) {
     bool uri_found = false;
     while (true) {
         int option_index = 0;
-        int c =
-            aws_cli_getopt_long(argc, argv, "a:b:c:e:f:H:d:g:j:l:m:M:GPHiko:t:v:VwWh", s_long_options, &option_index);
+        int c = aws_cli_getopt_long(
+            argc, argv, "a:b:c:e:f:H:d:g:j:l:m:M:GPHiko:t:v:VwWTn:q:D:R:N:rz:h", s_long_options, &option_index);
         if (c == -1) {
             break;
         }
@@ -276,6 +371,37 @@ static void s_parse_options(int argc, char **argv, struct elasticurl_ctx *ctx) {
                 ctx->alpn = "http/1.1";
                 ctx->required_http_version = AWS_HTTP_VERSION_1_1;
                 break;
+            case 'T':
+                ctx->print_timing = true;
+                break;
+            case 'n':
+                ctx->load.requests = s_parse_positive_count(aws_cli_optarg, "requests");
+                ctx->load_mode = true;
+                break;
+            case 'q':
+                ctx->load.concurrency = s_parse_positive_count(aws_cli_optarg, "concurrency");
+                break;
+            case 'D':
+                ctx->load.duration_ns = s_parse_duration_ns(aws_cli_optarg);
+                ctx->load_mode = true;
+                break;
+            case 'R':
+                ctx->load.rate = atof(aws_cli_optarg);
+                if (ctx->load.rate <= 0) {
+                    fprintf(stderr, "--rate must be a positive number.\n");
+                    s_usage(1);
+                }
+                ctx->load_mode = true;
+                break;
+            case 'N':
+                ctx->load.connections = s_parse_positive_count(aws_cli_optarg, "connections");
+                break;
+            case 'r':
+                ctx->ranged_download = true;
+                break;
+            case 'z':
+                ctx->part_size = s_parse_size(aws_cli_optarg);
+                break;
             case 'h':
                 s_usage(0);
                 break;
@@ -317,6 +443,28 @@ static void s_parse_options(int argc, char **argv, struct elasticurl_ctx *ctx) {
         }
     }
 
+    if (ctx->ranged_download) {
+        if (ctx->load_mode) {
+            fprintf(stderr, "--ranged can't be used with --requests, --duration or --rate.\n");
+            s_usage(1);
+        }
+        if (ctx->output == stdout) {
+            fprintf(stderr, "--ranged writes ranges at their offsets, so it needs --output.\n");
+            s_usage(1);
+        }
+        if (ctx->input_body != NULL) {
+            fprintf(stderr, "--ranged doesn't send a request body.\n");
+            s_usage(1);
+        }
+    } else if (ctx->load.concurrency || ctx->load.connections) {
+        ctx->load_mode = true;
+    }
+
+    if (ctx->print_timing && (ctx->load_mode || ctx->ranged_download)) {
+        fprintf(stderr, "--timing is for single requests. The load options and --ranged print their own reports.\n");
+        s_usage(1);
+    }
+
     if (ctx->input_body == NULL) {
         struct aws_byte_cursor empty_cursor;
         AWS_ZERO_STRUCT(empty_cursor);
@@ -327,6 +475,33 @@ static void s_parse_options(int argc, char **argv, struct elasticurl_ctx *ctx) {
         fprintf(stderr, "A URI for the request must be supplied.\n");
         s_usage(1);
     }
+
+    if (ctx->load_mode || ctx->ranged_download) {
+        if (ctx->signing_function != NULL) {
+            fprintf(stderr, "Signing isn't supported with the load options or --ranged.\n");
+            s_usage(1);
+        }
+
+        /* Requests are built before any connection exists, so the version can't be left to ALPN */
+        if (ctx->required_http_version != AWS_HTTP_VERSION_2) {
+            ctx->alpn = "http/1.1";
+            ctx->required_http_version = AWS_HTTP_VERSION_1_1;
+        }
+        ctx->load.http2 = ctx->required_http_version == AWS_HTTP_VERSION_2;
+
+        if (ctx->load.concurrency == 0) {
+            ctx->load.concurrency = 10;
+        }
+        if (ctx->load.connections == 0) {
+            ctx->load.connections = ctx->load.http2 ? 1 : ctx->load.concurrency;
+        }
+        if (ctx->part_size == 0) {
+            ctx->part_size = 8 * 1024 * 1024;
+        }
+        if (ctx->load.requests == 0 && ctx->load.duration_ns == 0) {
+            ctx->load.duration_ns = 10 * (uint64_t)AWS_TIMESTAMP_NANOS;
+        }
+    }
 }
 
 static int s_on_incoming_body_fn(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
@@ -335,6 +510,7 @@ static int s_on_incoming_body_fn(struct aws_http_stream *stream, const struct aw
     struct elasticurl_ctx *app_ctx = user_data;
 
     fwrite(data->ptr, 1, data->len, app_ctx->output);
+    app_ctx->timing.response_body_bytes += data->len;
 
     return AWS_OP_SUCCESS;
 }
@@ -385,6 +561,17 @@ static int s_on_incoming_header_block_done_fn(
     return AWS_OP_SUCCESS;
 }
 
+static void s_on_stream_metrics_fn(
+    struct aws_http_stream *stream,
+    const struct aws_http_stream_metrics *metrics,
+    void *user_data) {
+
+    (void)stream;
+    struct elasticurl_ctx *app_ctx = user_data;
+    app_ctx->timing.stream_metrics = *metrics;
+    app_ctx->timing.has_stream_metrics = true;
+}
+
 static void s_on_stream_complete_fn(struct aws_http_stream *stream, int error_code, void *user_data) {
     (void)error_code;
     (void)user_data;
@@ -493,6 +680,8 @@ static void s_on_client_connection_setup(struct aws_http_connection *connection,
     }
 
     app_ctx->connection = connection;
+    app_ctx->timing.has_setup_metrics =
+        aws_http_connection_get_setup_metrics(connection, &app_ctx->timing.setup_metrics) == AWS_OP_SUCCESS;
     app_ctx->request = s_build_http_request(app_ctx, aws_http_connection_get_version(connection));
 
     /* If async signing function is set, invoke it. It must invoke the signing complete callback when it's done. */
@@ -521,6 +710,7 @@ static void s_on_signing_complete(struct aws_http_message *request, int error_co
         .on_response_headers = s_on_incoming_headers_fn,
         .on_response_header_block_done = s_on_incoming_header_block_done_fn,
         .on_response_body = s_on_incoming_body_fn,
+        .on_metrics = s_on_stream_metrics_fn,
         .on_complete = s_on_stream_complete_fn,
     };
 
@@ -549,6 +739,149 @@ static void s_on_client_connection_shutdown(struct aws_http_connection *connecti
     aws_condition_variable_notify_all(&app_ctx->c_var);
 }
 
+static struct aws_http_message *s_new_ranged_request(struct aws_byte_cursor method, void *user_data) {
+    struct elasticurl_ctx *app_ctx = user_data;
+    struct aws_http_message *request = s_build_http_request(app_ctx, app_ctx->required_http_version);
+    aws_http_message_set_request_method(request, method);
+    return request;
+}
+
+static struct aws_http_message *s_new_load_request(void *user_data) {
+    struct elasticurl_ctx *app_ctx = user_data;
+    return s_build_http_request(app_ctx, app_ctx->required_http_version);
+}
+
+/* Reads the whole request body, so that every request in flight can have its own stream over it */
+static void s_read_load_body(struct elasticurl_ctx *app_ctx, struct aws_byte_buf *body) {
+    int64_t length = 0;
+    if (aws_input_stream_get_length(app_ctx->input_body, &length) ||
+        aws_byte_buf_init(body, app_ctx->allocator, (size_t)length)) {
+        fprintf(stderr, "failed to read request body with error %s.\n", aws_error_debug_str(aws_last_error()));
+        exit(1);
+    }
+
+    while (body->len < body->capacity) {
+        struct aws_stream_status status;
+        if (aws_input_stream_read(app_ctx->input_body, body) ||
+            aws_input_stream_get_status(app_ctx->input_body, &status)) {
+            fprintf(stderr, "failed to read request body with error %s.\n", aws_error_debug_str(aws_last_error()));
+            exit(1);
+        }
+        if (status.is_end_of_stream) {
+            break;
+        }
+    }
+}
+
+static int64_t s_timestamp_now(void) {
+    uint64_t now = 0;
+    aws_high_res_clock_get_ticks(&now);
+    return (int64_t)now;
+}
+
+static void s_on_host_resolved(
+    struct aws_host_resolver *resolver,
+    const struct aws_string *host_name,
+    int err_code,
+    const struct aws_array_list *host_addresses,
+    void *user_data) {
+
+    (void)resolver;
+    (void)host_name;
+    (void)host_addresses;
+    struct elasticurl_ctx *app_ctx = user_data;
+
+    aws_mutex_lock(&app_ctx->mutex);
+    app_ctx->timing.dns_done_ns = s_timestamp_now();
+    app_ctx->timing.dns_error_code = err_code;
+    app_ctx->timing.dns_done = true;
+    aws_mutex_unlock(&app_ctx->mutex);
+    aws_condition_variable_notify_all(&app_ctx->c_var);
+}
+
+static bool s_dns_done_predicate(void *arg) {
+    struct elasticurl_ctx *app_ctx = arg;
+    return app_ctx->timing.dns_done;
+}
+
+/*
+ * Resolves the host before connecting, so that the lookup can be timed on its own.
+ * The connection then finds the address in the resolver's cache.
+ */
+static void s_resolve_host_for_timing(struct elasticurl_ctx *app_ctx, struct aws_host_resolver *resolver) {
+    struct aws_string *host_name = aws_string_new_from_cursor(app_ctx->allocator, &app_ctx->uri.host_name);
+    struct aws_host_resolution_config resolution_config = {
+        .impl = aws_default_dns_resolve,
+        .max_ttl = 30,
+    };
+
+    app_ctx->timing.start_ns = s_timestamp_now();
+    if (aws_host_resolver_resolve_host(resolver, host_name, s_on_host_resolved, &resolution_config, app_ctx)) {
+        app_ctx->timing.dns_error_code = aws_last_error();
+    } else {
+        aws_mutex_lock(&app_ctx->mutex);
+        aws_condition_variable_wait_pred(&app_ctx->c_var, &app_ctx->mutex, s_dns_done_predicate, app_ctx);
+        aws_mutex_unlock(&app_ctx->mutex);
+    }
+    aws_string_destroy(host_name);
+
+    if (app_ctx->timing.dns_error_code) {
+        fprintf(stderr, "DNS lookup failed with error %s\n", aws_error_debug_str(app_ctx->timing.dns_error_code));
+        exit(1);
+    }
+}
+
+/* Prints how long a phase took and when it ended, or dashes if it didn't happen */
+static void s_print_timing_row(const char *phase, int64_t start_ns, int64_t *previous_ns, int64_t timestamp_ns) {
+    if (timestamp_ns < 0) {
+        fprintf(stderr, "  %-14s %12s %12s\n", phase, "-", "-");
+        return;
+    }
+    fprintf(
+        stderr,
+        "  %-14s %9.3f ms %9.3f ms\n",
+        phase,
+        (double)(timestamp_ns - *previous_ns) / 1e6,
+        (double)(timestamp_ns - start_ns) / 1e6);
+    *previous_ns = timestamp_ns;
+}
+
+static void s_print_timing(const struct elasticurl_ctx *app_ctx) {
+    const struct aws_http_connection_setup_metrics *setup = &app_ctx->timing.setup_metrics;
+    const struct aws_http_stream_metrics *stream = &app_ctx->timing.stream_metrics;
+    int64_t start_ns = app_ctx->timing.start_ns;
+    int64_t previous_ns = start_ns;
+    int64_t none = -1;
+
+    fprintf(stderr, "\n  %-14s %12s %12s\n", "Phase", "Duration", "Elapsed");
+    s_print_timing_row("DNS lookup", start_ns, &previous_ns, app_ctx->timing.dns_done_ns);
+    if (!app_ctx->timing.has_setup_metrics) {
+        fprintf(stderr, "  connection setup failed\n");
+        return;
+    }
+    s_print_timing_row("TCP connect", start_ns, &previous_ns, setup->socket_connected_timestamp_ns);
+    s_print_timing_row(
+        "TLS handshake",
+        start_ns,
+        &previous_ns,
+        setup->tls_negotiation_duration_ns >= 0 ? setup->setup_complete_timestamp_ns : none);
+    previous_ns = aws_max_i64(previous_ns, setup->setup_complete_timestamp_ns);
+    if (!app_ctx->timing.has_stream_metrics) {
+        fprintf(stderr, "  request failed\n");
+        return;
+    }
+    s_print_timing_row("request sent", start_ns, &previous_ns, stream->send_end_timestamp_ns);
+    s_print_timing_row("first byte", start_ns, &previous_ns, stream->receive_start_timestamp_ns);
+    s_print_timing_row("transfer", start_ns, &previous_ns, stream->receive_end_timestamp_ns);
+
+    double transfer_seconds = (double)stream->receiving_duration_ns / 1e9;
+    fprintf(
+        stderr,
+        "  body: %" PRIu64 " bytes, %.2f MB/s over the transfer\n",
+        app_ctx->timing.response_body_bytes,
+        transfer_seconds > 0 ? (double)app_ctx->timing.response_body_bytes / transfer_seconds / 1e6 : 0.0);
+}
+
 static bool s_completion_predicate(void *arg) {
     struct elasticurl_ctx *app_ctx = arg;
     return app_ctx->exchange_completed;
@@ -687,7 +1020,9 @@ int main(int argc, char **argv) {
         }
     }
 
-    struct aws_event_loop_group *el_group = aws_event_loop_group_new_default(allocator, 1, NULL);
+    /* Load runs and ranged downloads use an event loop per core, so that one thread doesn't limit them */
+    struct aws_event_loop_group *el_group =
+        aws_event_loop_group_new_default(allocator, app_ctx.load_mode || app_ctx.ranged_download ? 0 : 1, NULL);
 
     struct aws_host_resolver_default_options resolver_options = {
         .el_group = el_group,
@@ -727,10 +1062,57 @@ int main(int argc, char **argv) {
         /* Use prior knowledge to connect */
         http_client_options.prior_knowledge_http2 = true;
     }
-    aws_http_client_connect(&http_client_options);
-    aws_mutex_lock(&app_ctx.mutex);
-    aws_condition_variable_wait_pred(&app_ctx.c_var, &app_ctx.mutex, s_completion_predicate, &app_ctx);
-    aws_mutex_unlock(&app_ctx.mutex);
+
+    int exit_code = 0;
+    if (app_ctx.load_mode) {
+        struct aws_byte_buf load_body;
+        s_read_load_body(&app_ctx, &load_body);
+
+        app_ctx.load.http2_prior_knowledge = http_client_options.prior_knowledge_http2;
+        app_ctx.load.event_loop_group = el_group;
+        app_ctx.load.bootstrap = bootstrap;
+        app_ctx.load.socket_options = &socket_options;
+        app_ctx.load.tls_options = tls_options;
+        app_ctx.load.host = app_ctx.uri.host_name;
+        app_ctx.load.port = port;
+        app_ctx.load.body = aws_byte_cursor_from_buf(&load_body);
+        app_ctx.load.new_request = s_new_load_request;
+        app_ctx.load.user_data = &app_ctx;
+        if (elasticurl_load_run(allocator, &app_ctx.load)) {
+            exit_code = 1;
+        }
+        aws_byte_buf_clean_up(&load_body);
+    } else if (app_ctx.ranged_download) {
+        struct elasticurl_ranged_download_options ranged_options = {
+            .part_size = app_ctx.part_size,
+            .concurrency = app_ctx.load.concurrency,
+            .connections = app_ctx.load.connections,
+            .http2 = app_ctx.load.http2,
+            .http2_prior_knowledge = http_client_options.prior_knowledge_http2,
+            .bootstrap = bootstrap,
+            .socket_options = &socket_options,
+            .tls_options = tls_options,
+            .host = app_ctx.uri.host_name,
+            .port = port,
+            .output = app_ctx.output,
+            .new_request = s_new_ranged_request,
+            .user_data = &app_ctx,
+        };
+        if (elasticurl_ranged_download_run(allocator, &ranged_options)) {
+            exit_code = 1;
+        }
+    } else {
+        if (app_ctx.print_timing) {
+            s_resolve_host_for_timing(&app_ctx, resolver);
+        }
+        aws_http_client_connect(&http_client_options);
+        aws_mutex_lock(&app_ctx.mutex);
+        aws_condition_variable_wait_pred(&app_ctx.c_var, &app_ctx.mutex, s_completion_predicate, &app_ctx);
+        aws_mutex_unlock(&app_ctx.mutex);
+        if (app_ctx.print_timing) {
+            s_print_timing(&app_ctx);
+        }
+    }
 
     aws_client_bootstrap_release(bootstrap);
     aws_host_resolver_release(resolver);
@@ -768,5 +1150,5 @@ int main(int argc, char **argv) {
 
     aws_hash_table_clean_up(&app_ctx.signing_context);
 
-    return 0;
+    return exit_code;
 }
@@ -0,0 +1,499 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+/*
+ * Parallel ranged download for elasticurl.
+ *
+ * A HEAD request finds the object's size, then each of `concurrency` slots GETs one byte range at a time,
+ * taking the next range as soon as its last one completes. HTTP/1.1 ranges each lease a connection from an
+ * aws_http_connection_manager, HTTP/2 ranges are multiplexed by an aws_http2_stream_manager.
+ *
+ * Nothing is buffered. Body data is written to the output at its offset from the on_response_body callback,
+ * which holds up the connection's event loop while the write happens, so a slow disk slows the download instead
+ * of growing memory.
+ */
+
+#include "ranged_download.h"
+
+#include <aws/common/clock.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/mutex.h>
+#include <aws/http/connection.h>
+#include <aws/http/connection_manager.h>
+#include <aws/http/http2_stream_manager.h>
+#include <aws/http/request_response.h>
+
+#include <inttypes.h>
+
+#ifdef _WIN32
+#    include <io.h>
+#    include <windows.h>
+#else
+#    include <errno.h>
+#    include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4204) /* Declared initializers */
+#endif
+
+struct range_slot {
+    struct ranged_download *download;
+    struct aws_http_message *request;
+    /* HTTP/1.1 only, the connection leased for the current request */
+    struct aws_http_connection *connection;
+    bool is_head;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t received;
+    int status;
+};
+
+struct ranged_download {
+    struct aws_allocator *allocator;
+    const struct elasticurl_ranged_download_options *options;
+
+    struct aws_http_connection_manager *connection_manager;
+    struct aws_http2_stream_manager *stream_manager;
+
+    struct range_slot head;
+    struct range_slot *slots;
+    /* Set from the HEAD response, before any range is requested */
+    uint64_t object_size;
+    bool object_size_known;
+    uint64_t part_count;
+
+    struct aws_mutex lock;
+    struct aws_condition_variable signal;
+
+    /* Everything below is guarded by lock */
+    struct {
+        size_t in_flight;
+        uint64_t next_part;
+        uint64_t parts_done;
+        bool manager_shutdown;
+        /* The first failure, which stops any more ranges being requested */
+        int error_code;
+        int error_status;
+        bool error_in_head;
+        uint64_t error_offset;
+        uint64_t error_length;
+    } synced_data;
+};
+
+static uint64_t s_now_ns(void) {
+    uint64_t now = 0;
+    aws_high_res_clock_get_ticks(&now);
+    return now;
+}
+
+static int s_write_at(FILE *file, struct aws_byte_cursor data, uint64_t offset) {
+#ifdef _WIN32
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+    while (data.len > 0) {
+        OVERLAPPED overlapped;
+        AWS_ZERO_STRUCT(overlapped);
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD written = 0;
+        if (!WriteFile(handle, data.ptr, (DWORD)aws_min_size(data.len, UINT32_MAX), &written, &overlapped)) {
+            return aws_raise_error(AWS_ERROR_SYS_CALL_FAILURE);
+        }
+        aws_byte_cursor_advance(&data, written);
+        offset += written;
+    }
+#else
+    int fd = fileno(file);
+    while (data.len > 0) {
+        ssize_t written = pwrite(fd, data.ptr, data.len, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return aws_raise_error(AWS_ERROR_SYS_CALL_FAILURE);
+        }
+        aws_byte_cursor_advance(&data, (size_t)written);
+        offset += (uint64_t)written;
+    }
+#endif
+    return AWS_OP_SUCCESS;
+}
+
+/* Gives the slot the next range, if there is one and nothing has failed. Must be called with the lock held */
+static bool s_take_next_part_synced(struct ranged_download *download, struct range_slot *slot) {
+    if (download->synced_data.error_code || download->synced_data.next_part == download->part_count) {
+        return false;
+    }
+    uint64_t part_size = download->options->part_size;
+    slot->offset = download->synced_data.next_part++ * part_size;
+    slot->length = aws_min_u64(part_size, download->object_size - slot->offset);
+    return true;
+}
+
+/*
+ * Requests
+ */
+
+static void s_slot_send(struct range_slot *slot);
+
+static void s_slot_complete(struct range_slot *slot, int error_code) {
+    struct ranged_download *download = slot->download;
+    if (!error_code) {
+        if (slot->status != (slot->is_head ? 200 : 206)) {
+            error_code = AWS_ERROR_HTTP_INVALID_STATUS_CODE;
+        } else if (slot->is_head && !download->object_size_known) {
+            error_code = AWS_ERROR_HTTP_HEADER_NOT_FOUND;
+        } else if (!slot->is_head && slot->received != slot->length) {
+            error_code = AWS_ERROR_HTTP_PROTOCOL_ERROR;
+        }
+    }
+
+    bool send_next = false;
+    aws_mutex_lock(&download->lock);
+    if (error_code) {
+        if (!download->synced_data.error_code) {
+            download->synced_data.error_code = error_code;
+            download->synced_data.error_status = slot->status;
+            download->synced_data.error_in_head = slot->is_head;
+            download->synced_data.error_offset = slot->offset;
+            download->synced_data.error_length = slot->length;
+        }
+    } else if (!slot->is_head) {
+        download->synced_data.parts_done++;
+        send_next = s_take_next_part_synced(download, slot);
+    }
+    if (!send_next) {
+        download->synced_data.in_flight--;
+        aws_condition_variable_notify_all(&download->signal);
+    }
+    aws_mutex_unlock(&download->lock);
+
+    if (send_next) {
+        s_slot_send(slot);
+    }
+}
+
+static int s_on_response_headers(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    const struct aws_http_header *header_array,
+    size_t num_headers,
+    void *user_data) {
+
+    (void)stream;
+    struct range_slot *slot = user_data;
+    if (!slot->is_head || header_block != AWS_HTTP_HEADER_BLOCK_MAIN) {
+        return AWS_OP_SUCCESS;
+    }
+
+    for (size_t i = 0; i < num_headers; ++i) {
+        if (aws_byte_cursor_eq_c_str_ignore_case(&header_array[i].name, "content-length")) {
+            if (aws_byte_cursor_utf8_parse_u64(header_array[i].value, &slot->download->object_size)) {
+                return AWS_OP_ERR;
+            }
+            slot->download->object_size_known = true;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_response_header_block_done(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    void *user_data) {
+
+    struct range_slot *slot = user_data;
+    if (header_block != AWS_HTTP_HEADER_BLOCK_MAIN) {
+        return AWS_OP_SUCCESS;
+    }
+
+    aws_http_stream_get_incoming_response_status(stream, &slot->status);
+    /* A server that ignored the Range header would send the whole object, so stop it early */
+    if (!slot->is_head && slot->status != 206) {
+        return aws_raise_error(AWS_ERROR_HTTP_INVALID_STATUS_CODE);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_response_body(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
+    (void)stream;
+    struct range_slot *slot = user_data;
+    if (data->len > slot->length - slot->received) {
+        return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
+    }
+    if (s_write_at(slot->download->options->output, *data, slot->offset + slot->received)) {
+        return AWS_OP_ERR;
+    }
+    slot->received += data->len;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct range_slot *slot = user_data;
+    aws_http_stream_release(stream);
+
+    if (slot->connection) {
+        aws_http_connection_manager_release_connection(slot->download->connection_manager, slot->connection);
+        slot->connection = NULL;
+    }
+    s_slot_complete(slot, error_code);
+}
+
+static struct aws_http_make_request_options s_make_request_options(struct range_slot *slot) {
+    struct aws_http_make_request_options options = {
+        .self_size = sizeof(options),
+        .request = slot->request,
+        .user_data = slot,
+        .on_response_headers = s_on_response_headers,
+        .on_response_header_block_done = s_on_response_header_block_done,
+        .on_response_body = s_on_response_body,
+        .on_complete = s_on_stream_complete,
+    };
+    return options;
+}
+
+static void s_on_connection_acquired(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct range_slot *slot = user_data;
+    if (!connection) {
+        s_slot_complete(slot, error_code);
+        return;
+    }
+
+    slot->connection = connection;
+    struct aws_http_make_request_options options = s_make_request_options(slot);
+    struct aws_http_stream *stream = aws_http_connection_make_request(connection, &options);
+    if (!stream || aws_http_stream_activate(stream)) {
+        error_code = aws_last_error();
+        aws_http_stream_release(stream);
+        aws_http_connection_manager_release_connection(slot->download->connection_manager, connection);
+        slot->connection = NULL;
+        s_slot_complete(slot, error_code);
+    }
+}
+
+static void s_on_h2_stream_acquired(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct range_slot *slot = user_data;
+    if (!stream) {
+        s_slot_complete(slot, error_code);
+    }
+}
+
+static void s_slot_send(struct range_slot *slot) {
+    struct ranged_download *download = slot->download;
+    slot->received = 0;
+    slot->status = 0;
+
+    if (!slot->is_head) {
+        char range[64];
+        snprintf(
+            range, sizeof(range), "bytes=%" PRIu64 "-%" PRIu64, slot->offset, slot->offset + slot->length - 1);
+        if (aws_http_headers_set(
+                aws_http_message_get_headers(slot->request),
+                aws_byte_cursor_from_c_str("range"),
+                aws_byte_cursor_from_c_str(range))) {
+            s_slot_complete(slot, aws_last_error());
+            return;
+        }
+    }
+
+    if (download->stream_manager) {
+        struct aws_http_make_request_options options = s_make_request_options(slot);
+        struct aws_http2_stream_manager_acquire_stream_options acquire_options = {
+            .callback = s_on_h2_stream_acquired,
+            .user_data = slot,
+            .options = &options,
+        };
+        aws_http2_stream_manager_acquire_stream(download->stream_manager, &acquire_options);
+    } else {
+        aws_http_connection_manager_acquire_connection(
+            download->connection_manager, s_on_connection_acquired, slot);
+    }
+}
+
+/*
+ * Setup
+ */
+
+static void s_on_manager_shutdown(void *user_data) {
+    struct ranged_download *download = user_data;
+    aws_mutex_lock(&download->lock);
+    download->synced_data.manager_shutdown = true;
+    aws_condition_variable_notify_all(&download->signal);
+    aws_mutex_unlock(&download->lock);
+}
+
+static bool s_nothing_in_flight(void *user_data) {
+    struct ranged_download *download = user_data;
+    return download->synced_data.in_flight == 0;
+}
+
+static bool s_is_manager_shutdown(void *user_data) {
+    struct ranged_download *download = user_data;
+    return download->synced_data.manager_shutdown;
+}
+
+/* Sends the slot's request, and waits for it and every range it goes on to take */
+static void s_send_and_wait(struct ranged_download *download, struct range_slot **slots, size_t count) {
+    aws_mutex_lock(&download->lock);
+    download->synced_data.in_flight += count;
+    aws_mutex_unlock(&download->lock);
+
+    for (size_t i = 0; i < count; ++i) {
+        s_slot_send(slots[i]);
+    }
+
+    aws_mutex_lock(&download->lock);
+    aws_condition_variable_wait_pred(&download->signal, &download->lock, s_nothing_in_flight, download);
+    aws_mutex_unlock(&download->lock);
+}
+
+static int s_create_manager(struct ranged_download *download) {
+    const struct elasticurl_ranged_download_options *options = download->options;
+
+    if (options->http2) {
+        struct aws_http2_stream_manager_options manager_options = {
+            .bootstrap = options->bootstrap,
+            .socket_options = options->socket_options,
+            .tls_connection_options = options->tls_options,
+            .http2_prior_knowledge = options->http2_prior_knowledge,
+            .host = options->host,
+            .port = options->port,
+            .ideal_concurrent_streams_per_connection =
+                (options->concurrency + options->connections - 1) / options->connections,
+            .max_connections = options->connections,
+            .shutdown_complete_user_data = download,
+            .shutdown_complete_callback = s_on_manager_shutdown,
+        };
+        download->stream_manager = aws_http2_stream_manager_new(download->allocator, &manager_options);
+        return download->stream_manager ? AWS_OP_SUCCESS : AWS_OP_ERR;
+    }
+
+    struct aws_http_connection_manager_options manager_options = {
+        .bootstrap = options->bootstrap,
+        .initial_window_size = SIZE_MAX,
+        .socket_options = options->socket_options,
+        .tls_connection_options = options->tls_options,
+        .host = options->host,
+        .port = options->port,
+        .max_connections = options->connections,
+        .shutdown_complete_user_data = download,
+        .shutdown_complete_callback = s_on_manager_shutdown,
+    };
+    download->connection_manager = aws_http_connection_manager_new(download->allocator, &manager_options);
+    return download->connection_manager ? AWS_OP_SUCCESS : AWS_OP_ERR;
+}
+
+static void s_print_failure(const struct ranged_download *download) {
+    if (download->synced_data.error_status && download->synced_data.error_code == AWS_ERROR_HTTP_INVALID_STATUS_CODE) {
+        fprintf(stderr, "Server responded with status %d", download->synced_data.error_status);
+    } else {
+        fprintf(stderr, "Failed with error %s", aws_error_debug_str(download->synced_data.error_code));
+    }
+    if (download->synced_data.error_in_head) {
+        fprintf(stderr, " for the HEAD request\n");
+    } else {
+        fprintf(
+            stderr,
+            " for bytes %" PRIu64 "-%" PRIu64 "\n",
+            download->synced_data.error_offset,
+            download->synced_data.error_offset + download->synced_data.error_length - 1);
+    }
+}
+
+int elasticurl_ranged_download_run(
+    struct aws_allocator *allocator,
+    const struct elasticurl_ranged_download_options *options) {
+
+    AWS_FATAL_ASSERT(options->part_size > 0 && options->concurrency > 0 && options->connections > 0);
+
+    struct ranged_download download = {
+        .allocator = allocator,
+        .options = options,
+    };
+    aws_mutex_init(&download.lock);
+    aws_condition_variable_init(&download.signal);
+    download.slots = aws_mem_calloc(allocator, options->concurrency, sizeof(struct range_slot));
+
+    int result = AWS_OP_ERR;
+    if (s_create_manager(&download)) {
+        fprintf(stderr, "Failed to create connection manager with error %s\n", aws_error_debug_str(aws_last_error()));
+        goto done;
+    }
+
+    uint64_t start_ns = s_now_ns();
+    download.head = (struct range_slot){
+        .download = &download,
+        .request = options->new_request(aws_http_method_head, options->user_data),
+        .is_head = true,
+    };
+    if (!download.head.request) {
+        goto done;
+    }
+    struct range_slot *head = &download.head;
+    s_send_and_wait(&download, &head, 1);
+    if (download.synced_data.error_code) {
+        s_print_failure(&download);
+        goto done;
+    }
+
+    download.part_count = (download.object_size + options->part_size - 1) / options->part_size;
+    size_t slot_count = (size_t)aws_min_u64(options->concurrency, download.part_count);
+    struct range_slot **first_slots = aws_mem_calloc(allocator, aws_max_size(slot_count, 1), sizeof(void *));
+    for (size_t i = 0; i < slot_count; ++i) {
+        struct range_slot *slot = &download.slots[i];
+        slot->download = &download;
+        slot->request = options->new_request(aws_http_method_get, options->user_data);
+        if (!slot->request) {
+            aws_mem_release(allocator, first_slots);
+            goto done;
+        }
+        aws_mutex_lock(&download.lock);
+        s_take_next_part_synced(&download, slot);
+        aws_mutex_unlock(&download.lock);
+        first_slots[i] = slot;
+    }
+
+    uint64_t transfer_start_ns = s_now_ns();
+    s_send_and_wait(&download, first_slots, slot_count);
+    aws_mem_release(allocator, first_slots);
+    uint64_t end_ns = s_now_ns();
+
+    if (download.synced_data.error_code) {
+        s_print_failure(&download);
+        goto done;
+    }
+
+    double transfer_seconds = (double)(end_ns - transfer_start_ns) / 1e9;
+    printf(
+        "%" PRIu64 " bytes in %" PRIu64 " ranges over at most %zu %s connections, %.2fs (%.2fs total), %.2f MB/s\n",
+        download.object_size,
+        download.part_count,
+        options->connections,
+        options->http2 ? "HTTP/2" : "HTTP/1.1",
+        transfer_seconds,
+        (double)(end_ns - start_ns) / 1e9,
+        transfer_seconds > 0 ? (double)download.object_size / transfer_seconds / 1e6 : 0.0);
+    result = AWS_OP_SUCCESS;
+
+done:
+    if (download.connection_manager || download.stream_manager) {
+        if (download.connection_manager) {
+            aws_http_connection_manager_release(download.connection_manager);
+        } else {
+            aws_http2_stream_manager_release(download.stream_manager);
+        }
+        aws_mutex_lock(&download.lock);
+        aws_condition_variable_wait_pred(&download.signal, &download.lock, s_is_manager_shutdown, &download);
+        aws_mutex_unlock(&download.lock);
+    }
+    aws_http_message_release(download.head.request);
+    for (size_t i = 0; i < options->concurrency; ++i) {
+        aws_http_message_release(download.slots[i].request);
+    }
+    aws_mem_release(allocator, download.slots);
+    aws_condition_variable_clean_up(&download.signal);
+    aws_mutex_clean_up(&download.lock);
+    return result;
+}
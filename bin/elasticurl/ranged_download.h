@@ -0,0 +1,54 @@
+#ifndef ELASTICURL_RANGED_DOWNLOAD_H
+#define ELASTICURL_RANGED_DOWNLOAD_H
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/common/byte_buf.h>
+
+#include <stdio.h>
+
+struct aws_client_bootstrap;
+struct aws_http_message;
+struct aws_socket_options;
+struct aws_tls_connection_options;
+
+/* Builds a request with the given method and no body */
+typedef struct aws_http_message *(elasticurl_ranged_new_request_fn)(struct aws_byte_cursor method, void *user_data);
+
+struct elasticurl_ranged_download_options {
+    /* Size of each byte range requested */
+    uint64_t part_size;
+    /* Most ranges in flight at once */
+    size_t concurrency;
+    /* Most connections to open */
+    size_t connections;
+
+    /* HTTP/2 ranges go through an aws_http2_stream_manager, HTTP/1.1 ones through an aws_http_connection_manager */
+    bool http2;
+    bool http2_prior_knowledge;
+
+    struct aws_client_bootstrap *bootstrap;
+    const struct aws_socket_options *socket_options;
+    const struct aws_tls_connection_options *tls_options;
+    struct aws_byte_cursor host;
+    uint32_t port;
+
+    /* Each range is written here at its own offset, as it arrives. Must be a regular file. */
+    FILE *output;
+    elasticurl_ranged_new_request_fn *new_request;
+    void *user_data;
+};
+
+/**
+ * Finds the object's size with a HEAD request, then GETs it in byte ranges, several at once.
+ * Bodies aren't buffered: each range is written to the output at its offset as the data arrives,
+ * so memory use doesn't grow with the object or part size.
+ * Prints the transfer rate to stdout. Returns AWS_OP_ERR if any range failed.
+ */
+int elasticurl_ranged_download_run(
+    struct aws_allocator *allocator,
+    const struct elasticurl_ranged_download_options *options);
+
+#endif /* ELASTICURL_RANGED_DOWNLOAD_H */
@@ -15,6 +15,7 @@ struct aws_socket_options;
 struct aws_socket_endpoint;
 struct aws_tls_connection_options;
 struct aws_http2_setting;
+struct aws_http_memory_budget;
 struct proxy_env_var_settings;
 
 /**
@@ -144,6 +145,43 @@ struct aws_http_connection_monitoring_options {
      * user_data to be passed to statistics_observer_fn.
      */
     void *statistics_observer_user_data;
+
+    /**
+     * Optional (ignored if 0).
+     * Health score (see aws_http_connection_get_health_score()) below which the connection counts as degraded.
+     * Connection managers and HTTP/2 stream managers hand out degraded connections only when there's nothing
+     * healthier, and recycle them one at a time once they're done with their work,
+     * instead of using them until the throughput check above shuts them down.
+     */
+    uint32_t degraded_health_score;
+};
+
+/**
+ * Debugging aid: record the raw bytes a connection sends and receives, with timestamps, to a file.
+ * The recordings can be replayed through the decoders with `aws-c-http-bench --replay`,
+ * to measure decoding on real traffic, or to seed the fuzz corpora.
+ *
+ * Bytes are recorded as the HTTP connection sees them, after TLS decryption, from the first byte
+ * (including the HTTP/2 connection preface) until the connection closes. WebSocket frames are recorded too,
+ * if the connection is upgraded. File writes happen on the connection's event-loop thread,
+ * so this is not meant to be left on for busy, latency-sensitive connections.
+ *
+ * While capturing, HTTP/1.1 file bodies are sent through the channel instead of straight to the socket,
+ * so they're recorded like everything else.
+ */
+struct aws_http_traffic_capture_options {
+    /**
+     * Required.
+     * Existing directory to write into. Each connection gets its own file, with a unique name ending in ".awscap".
+     * If a file can't be created, the connection goes ahead without being captured.
+     */
+    struct aws_byte_cursor directory;
+
+    /**
+     * Optional.
+     * Recording stops once a file reaches this many bytes. If zero is specified (the default) there's no limit.
+     */
+    uint64_t max_file_size;
 };
 
 /**
@@ -163,6 +201,76 @@ struct aws_http1_connection_options {
      * A capacity that is too big may waste memory without helping throughput.
      */
     size_t read_buffer_capacity;
+
+    /**
+     * Optional
+     * Lets the read buffer's capacity adapt to how quickly the incoming HTTP-stream consumes data.
+     * `read_buffer_capacity` becomes the starting and minimum capacity, and this is the maximum.
+     * The capacity doubles each time the stream keeps up with a full connection window,
+     * halves while data piles up behind a stream window of zero,
+     * and drops back to the minimum when the connection has no streams.
+     *
+     * Ignored if `manual_window_management` is false.
+     * If zero is specified (the default), or it's less than the minimum, the capacity is fixed.
+     */
+    size_t read_buffer_max_capacity;
+
+    /**
+     * Optional
+     * Client-only. Limits how many requests may be written before their responses arrive.
+     * If zero is specified (the default) there's no limit, and every request is written as soon as the one before it.
+     * If set, only idempotent requests (GET, HEAD, PUT, DELETE, OPTIONS) are pipelined: any other request waits for
+     * all earlier responses, and later requests wait for its response.
+     * If the connection breaks, requests pipelined behind the first unanswered one fail with
+     * AWS_ERROR_HTTP_PIPELINED_REQUEST_UNANSWERED, since they didn't break it.
+     */
+    size_t max_pipeline_depth;
+
+    /**
+     * Optional
+     * Server-only. Close the connection once it has gone this long with no request in progress.
+     * If zero is specified (the default) idle connections stay open.
+     */
+    uint64_t idle_timeout_ms;
+
+    /**
+     * Optional
+     * Server-only. Close the connection after responding to this many requests.
+     * If zero is specified (the default) there's no limit.
+     */
+    size_t max_requests;
+
+    /**
+     * Optional
+     * Client-only. The read buffer draws its window from this budget, which may be shared with other connections.
+     * While the budget is exhausted the window stays closed, even if the read buffer has room.
+     * The connection keeps a reference to the budget until it's destroyed.
+     * See aws_http_memory_budget_new().
+     *
+     * Ignored if `manual_window_management` is false.
+     */
+    struct aws_http_memory_budget *memory_budget;
+
+    /**
+     * Optional
+     * Client-only. Requests with a Content-Length of at least this many bytes get an "Expect: 100-continue" header,
+     * so the server can turn them down before the body is uploaded.
+     * The body is held back until the server responds with 100 (Continue), or `expect_continue_timeout_ms` passes.
+     * If the server responds with a final status instead (ex: 401, 413, 3xx), the body is never sent.
+     * The request completes with that response, and the connection closes afterwards,
+     * since the server may still expect the body.
+     * Requests that already have an "Expect: 100-continue" header are held back the same way, whatever their size.
+     * If zero is specified (the default) no header is added.
+     */
+    uint64_t expect_continue_threshold;
+
+    /**
+     * Optional
+     * Client-only. How long to hold back the body of an "Expect: 100-continue" request before sending it anyway,
+     * since not every server responds with 100 (Continue).
+     * If zero is specified (the default) AWS_HTTP1_DEFAULT_EXPECT_CONTINUE_TIMEOUT_MS is used.
+     */
+    uint64_t expect_continue_timeout_ms;
 };
 
 /**
@@ -238,6 +346,108 @@ struct aws_http2_connection_options {
      * But, the client will always automatically update the window for padding even for manual window update.
      */
     bool conn_manual_window_management;
+
+    /**
+     * Optional.
+     * Coalesce the WINDOW_UPDATE frames sent to the peer.
+     *
+     * If 0 (the default), a WINDOW_UPDATE frame is sent each time a flow-control window is incremented,
+     * whether automatically or via aws_http_stream_update_window() and aws_http2_connection_update_window().
+     *
+     * Otherwise, increments to each stream's window and to the connection's window are accumulated,
+     * and a single WINDOW_UPDATE carrying the sum is sent once the accumulated increment reaches
+     * this percentage of the full window (the remaining window plus the accumulated increment).
+     * An accumulated increment is always sent once the remaining window is used up, so data never stalls.
+     * Values above 100 are treated as 100.
+     * An increment accumulated for a stream is dropped if the stream closes before it's sent.
+     */
+    uint32_t window_update_threshold_percent;
+
+    /**
+     * Optional.
+     * Automatically grow the flow-control window of streams to match the bandwidth-delay product (BDP) of the
+     * connection, so a high-latency link isn't limited to one window of data per round trip.
+     *
+     * If 0 (the default), stream windows stay at the SETTINGS_INITIAL_WINDOW_SIZE from `initial_settings_array`.
+     *
+     * Otherwise, a PING is sent when DATA arrives, and the DATA bytes received before its ACK are counted.
+     * Whenever a round trip carries at least 2/3 of the current window, the window is doubled by sending
+     * SETTINGS_INITIAL_WINDOW_SIZE, up to this value (capped at 2^31-1). This value bounds the memory that may be
+     * needed to buffer each stream's incoming data.
+     *
+     * Ignored if the connection was created with manual window management for streams.
+     */
+    uint32_t bdp_max_window_size;
+
+    /**
+     * Optional.
+     * Batch outgoing frames into fewer, fuller io messages (e.g. whole TLS records), to cut down on
+     * partially filled records and syscalls when many small streams are active.
+     *
+     * If 0 (the default), frames are written as soon as they're ready.
+     * Otherwise, writes are corked until the end of the event-loop tick, so HEADERS, DATA, and control frames
+     * queued by different streams share a message. A message holding fewer than this many bytes
+     * is held up to `write_batch_max_delay_ms` for more frames to join it, unless it carries a control frame the
+     * peer may be waiting on (PING, SETTINGS, RST_STREAM, GOAWAY), which is sent right away.
+     * Messages never exceed the channel's max message size, so larger values just mean "full messages".
+     *
+     * See aws_crt_statistics_http2_channel for the counters that show how full messages are.
+     */
+    size_t write_batch_target_size;
+
+    /**
+     * Optional.
+     * Used with `write_batch_target_size`: the longest a message that's short of the target size is held back.
+     * If 0, messages are only held until the end of the current event-loop tick.
+     */
+    uint32_t write_batch_max_delay_ms;
+
+    /**
+     * Optional.
+     * Keep HPACK state small, for servers holding many connections that are mostly idle.
+     * HPACK tables are always allocated on first use, so a connection that never exchanges headers costs nothing.
+     *
+     * If 0 (the default), HPACK tables keep their memory for the life of the connection.
+     * Otherwise:
+     * - SETTINGS_HEADER_TABLE_SIZE is advertised as AWS_HTTP2_LEAN_HPACK_HEADER_TABLE_SIZE,
+     *   unless `initial_settings_array` sets it, which bounds the table the peer makes this side keep.
+     * - Once no streams have been active for this many milliseconds, HPACK memory is released.
+     *   The table for encoding is emptied (the peer is told at the start of the next header block),
+     *   and the table for decoding is shrunk to fit the entries the peer may still refer to.
+     *
+     * See aws_http2_connection_get_hpack_memory_usage().
+     */
+    uint32_t lean_hpack_idle_ms;
+
+    /**
+     * Optional.
+     * Limits on the RST_STREAM frames the peer may send, to cut short "rapid reset" attacks,
+     * where streams are opened and immediately cancelled, faster than they can be served.
+     *
+     * Each RST_STREAM received for a stream still in progress spends a token from a bucket holding up to
+     * `stream_reset_burst` tokens, which refills at `max_stream_resets_per_second`. Once the bucket is empty,
+     * the connection is closed with GOAWAY(ENHANCE_YOUR_CALM), before the frame is passed to its stream.
+     * Resets of streams that already completed are free.
+     *
+     * Set either to zero to use the defaults, AWS_HTTP2_DEFAULT_MAX_STREAM_RESETS_PER_SECOND and
+     * AWS_HTTP2_DEFAULT_STREAM_RESET_BURST. Set max_stream_resets_per_second to UINT32_MAX for no limit.
+     * Client connections have no limit unless max_stream_resets_per_second is set.
+     */
+    uint32_t max_stream_resets_per_second;
+    uint32_t stream_reset_burst;
+
+    /**
+     * Optional.
+     * Limits on the PING and SETTINGS frames the peer may send, each of which must be answered with an ACK.
+     * Works like `max_stream_resets_per_second`: once the bucket is empty, the connection is closed with
+     * GOAWAY(ENHANCE_YOUR_CALM) instead of queueing another ACK.
+     *
+     * Set either to zero to use the defaults, AWS_HTTP2_DEFAULT_MAX_CONTROL_FRAMES_PER_SECOND and
+     * AWS_HTTP2_DEFAULT_CONTROL_FRAME_BURST. Set max_control_frames_per_second to UINT32_MAX for no limit.
+     * Client connections have no limit unless max_control_frames_per_second is set.
+     */
+    uint32_t max_control_frames_per_second;
+    uint32_t control_frame_burst;
 };
 
 /**
@@ -416,6 +626,26 @@ struct aws_http_client_connection_options {
      * Host resolution override that allows the user to override DNS behavior for this particular connection.
      */
     const struct aws_host_resolution_config *host_resolution_config;
+
+    /**
+     * Optional.
+     * If set, the connection's traffic is recorded to a file. See `aws_http_traffic_capture_options`.
+     * Ignored for connections through a tunneling proxy.
+     * aws_http_client_connect() makes a copy.
+     */
+    const struct aws_http_traffic_capture_options *traffic_capture_options;
+
+    /**
+     * Optional.
+     * If non-zero, connection attempts race as RFC 8305 ("Happy Eyeballs") describes. The host is resolved
+     * up front and its addresses are tried in turn, alternating between IPv6 and IPv4. An attempt that hasn't
+     * finished after this many milliseconds gets the next attempt started alongside it, and an attempt that
+     * fails starts the next one right away. The first attempt to set up a connection wins. Attempts still in
+     * flight are abandoned, and any of them that connects later is closed.
+     * on_setup is invoked once: with the winning connection, or with the last error if every attempt failed.
+     * RFC 8305 recommends 250 milliseconds. Ignored when a proxy is used.
+     */
+    uint64_t connection_attempt_delay_ms;
 };
 
 /* Predefined settings identifiers (RFC-7540 6.5.2) */
@@ -428,6 +658,10 @@ enum aws_http2_settings_id {
     AWS_HTTP2_SETTINGS_MAX_FRAME_SIZE = 0x5,
     AWS_HTTP2_SETTINGS_MAX_HEADER_LIST_SIZE = 0x6,
     AWS_HTTP2_SETTINGS_END_RANGE, /* End of known values */
+
+    /* RFC-8441 Section 3. Extended CONNECT, used to bootstrap websockets over HTTP/2.
+     * Outside the range above: it's only received from the peer, and tracked on its own. */
+    AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL = 0x8,
 };
 
 /* A HTTP/2 setting and its value, used in SETTINGS frame */
@@ -436,11 +670,59 @@ struct aws_http2_setting {
     uint32_t value;
 };
 
+/**
+ * Timing of a client connection's setup. See `aws_http_connection_get_setup_metrics()`.
+ * Timestamps are from `aws_high_res_clock_get_ticks`. -1 means data not available.
+ * For connections through a proxy, these cover the connection to the proxy.
+ */
+struct aws_http_connection_setup_metrics {
+    /* When the connection was requested, by aws_http_client_connect() or a connection manager */
+    int64_t connect_start_timestamp_ns;
+    /* When the socket connected. Host resolution comes first, unless the address was already cached */
+    int64_t socket_connected_timestamp_ns;
+    /* When the connection was ready for requests, after TLS negotiation if TLS was used */
+    int64_t setup_complete_timestamp_ns;
+
+    /* Host resolution plus TCP connect (socket_connected_timestamp_ns - connect_start_timestamp_ns) */
+    int64_t connect_duration_ns;
+    /* TLS only. The TLS handshake, including ALPN (setup_complete_timestamp_ns - socket_connected_timestamp_ns) */
+    int64_t tls_negotiation_duration_ns;
+};
+
+/**
+ * The score of a healthy connection, see aws_http_connection_get_health_score().
+ */
+#define AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX (100)
+
+/**
+ * HTTP/1.1: Default for aws_http1_connection_options.expect_continue_timeout_ms.
+ */
+#define AWS_HTTP1_DEFAULT_EXPECT_CONTINUE_TIMEOUT_MS (1000)
+
+/**
+ * HTTP/2: SETTINGS_HEADER_TABLE_SIZE advertised with aws_http2_connection_options.lean_hpack_idle_ms.
+ */
+#define AWS_HTTP2_LEAN_HPACK_HEADER_TABLE_SIZE (512)
+
 /**
  * HTTP/2: Default value for max closed streams we will keep in memory.
  */
 #define AWS_HTTP2_DEFAULT_MAX_CLOSED_STREAMS (32)
 
+/**
+ * HTTP/2: Defaults for aws_http2_connection_options.max_stream_resets_per_second and stream_reset_burst.
+ * The rate applies to server connections only.
+ */
+#define AWS_HTTP2_DEFAULT_MAX_STREAM_RESETS_PER_SECOND (200)
+#define AWS_HTTP2_DEFAULT_STREAM_RESET_BURST (1000)
+
+/**
+ * HTTP/2: Defaults for aws_http2_connection_options.max_control_frames_per_second and control_frame_burst.
+ * The rate applies to server connections only.
+ */
+#define AWS_HTTP2_DEFAULT_MAX_CONTROL_FRAMES_PER_SECOND (100)
+#define AWS_HTTP2_DEFAULT_CONTROL_FRAME_BURST (1000)
+
 /**
  * HTTP/2: The size of payload for HTTP/2 PING frame.
  */
@@ -520,6 +802,17 @@ bool aws_http_connection_is_client(const struct aws_http_connection *connection)
 AWS_HTTP_API
 enum aws_http_version aws_http_connection_get_version(const struct aws_http_connection *connection);
 
+/**
+ * Returns the connection's health, from 0 to AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX, as last scored by its monitor.
+ * Each statistics report is scored on throughput against monitoring_options.minimum_throughput_bytes_per_second,
+ * the share of streams that completed with an error, and for HTTP/2, how far the round trip time has grown
+ * past the connection's best. Recent reports weigh the most, and reports without stream activity are skipped.
+ * Connections without monitoring_options always score AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX.
+ * This may be called from any thread.
+ */
+AWS_HTTP_API
+uint32_t aws_http_connection_get_health_score(const struct aws_http_connection *connection);
+
 /**
  * Returns the channel hosting the HTTP connection.
  * Do not expose this function to language bindings.
@@ -527,6 +820,15 @@ enum aws_http_version aws_http_connection_get_version(const struct aws_http_conn
 AWS_HTTP_API
 struct aws_channel *aws_http_connection_get_channel(struct aws_http_connection *connection);
 
+/**
+ * Gets the timing of a client connection's setup.
+ * Raises AWS_ERROR_INVALID_STATE for server connections.
+ */
+AWS_HTTP_API
+int aws_http_connection_get_setup_metrics(
+    const struct aws_http_connection *connection,
+    struct aws_http_connection_setup_metrics *out_metrics);
+
 /**
  * Returns the remote endpoint of the HTTP connection.
  */
@@ -615,6 +917,16 @@ void aws_http2_connection_get_remote_settings(
     const struct aws_http_connection *http2_connection,
     struct aws_http2_setting out_settings[AWS_HTTP2_SETTINGS_COUNT]);
 
+/**
+ * Get the bytes currently allocated for HPACK header compression on this connection (HTTP/2 only),
+ * for both directions. The value is updated as the connection reads and writes, so it may lag slightly.
+ * See aws_http2_connection_options.lean_hpack_idle_ms.
+ *
+ * @param http2_connection HTTP/2 connection.
+ */
+AWS_HTTP_API
+size_t aws_http2_connection_get_hpack_memory_usage(const struct aws_http_connection *http2_connection);
+
 /**
  * Send a custom GOAWAY frame (HTTP/2 only).
  *
@@ -7,14 +7,17 @@
  */
 
 #include <aws/http/http.h>
+#include <aws/http/statistics.h>
 
 #include <aws/common/byte_buf.h>
 
 AWS_PUSH_SANE_WARNING_LEVEL
 
 struct aws_client_bootstrap;
+struct aws_event_loop;
 struct aws_http_connection;
 struct aws_http_connection_manager;
+struct aws_http_memory_budget;
 struct aws_socket_options;
 struct aws_tls_connection_options;
 struct proxy_env_var_settings;
@@ -27,6 +30,19 @@ typedef void(aws_http_connection_manager_on_connection_setup_fn)(
 
 typedef void(aws_http_connection_manager_shutdown_complete_fn)(void *user_data);
 
+/**
+ * Number of distinct error codes counted in aws_http_manager_metrics.connect_failures
+ */
+#define AWS_HTTP_MANAGER_METRICS_ERROR_CODE_SLOTS 8
+
+/**
+ * How many times an error happened, see aws_http_manager_metrics.connect_failures
+ */
+struct aws_http_manager_error_count {
+    int error_code;
+    uint64_t count;
+};
+
 /**
  * Metrics for logging and debugging purpose.
  */
@@ -44,6 +60,84 @@ struct aws_http_manager_metrics {
     size_t pending_concurrency_acquires;
     /* The number of connections (http/1.1) or streams (for h2 via. stream manager) currently vended to user. */
     size_t leased_concurrency;
+
+    /*
+     * The rest covers everything since the manager was created.
+     * Telling pool starvation (long acquire waits) from slow servers (long connection setups) takes both.
+     */
+
+    /* Time acquisitions (of connections, or of streams for the stream manager) spent waiting */
+    struct aws_http_latency_histogram acquire_wait;
+    /* Time new connections took to set up (connect, TLS and proxy negotiation) */
+    struct aws_http_latency_histogram connection_setup;
+    /* Time from set up to shut down, for connections that have shut down */
+    struct aws_http_latency_histogram connection_lifetime;
+    /* Time idle connections sat in the pool before they were culled */
+    struct aws_http_latency_histogram idle_before_cull;
+
+    /* Number of new connections that failed to set up */
+    uint64_t connect_failure_count;
+    /*
+     * connect_failure_count by error code, for the first AWS_HTTP_MANAGER_METRICS_ERROR_CODE_SLOTS error codes seen.
+     * Unused slots have a count of 0.
+     */
+    struct aws_http_manager_error_count connect_failures[AWS_HTTP_MANAGER_METRICS_ERROR_CODE_SLOTS];
+};
+
+/**
+ * How much an acquisition cares which event loop its connection runs on.
+ * A connection on the acquirer's own event loop spares every request a cross-thread hop.
+ */
+enum aws_http_connection_manager_event_loop_affinity {
+    /* Any connection will do. */
+    AWS_HTTP_CONNECTION_MANAGER_AFFINITY_NONE,
+    /* Prefer an idle connection on the event loop, and create new connections on it,
+     * but take a connection on another event loop if that's what's idle. */
+    AWS_HTTP_CONNECTION_MANAGER_AFFINITY_PREFER,
+    /* Only take a connection on the event loop, waiting for a new one if needed.
+     * An idle connection on another event loop may be closed to make room under max_connections. */
+    AWS_HTTP_CONNECTION_MANAGER_AFFINITY_REQUIRE,
+};
+
+/**
+ * When the pool is saturated, pending acquisitions are served highest priority first,
+ * and in the order they were made within a priority.
+ */
+enum aws_http_connection_manager_acquisition_priority {
+    /* Background work, that can wait on everything else. */
+    AWS_HTTP_CONNECTION_MANAGER_PRIORITY_LOW = -1,
+    AWS_HTTP_CONNECTION_MANAGER_PRIORITY_NORMAL = 0,
+    /* Interactive work, that gets ahead of everything else. */
+    AWS_HTTP_CONNECTION_MANAGER_PRIORITY_HIGH = 1,
+};
+
+/**
+ * Options for aws_http_connection_manager_acquire_connection_with_options()
+ */
+struct aws_http_connection_manager_acquire_options {
+    /* Required. Notified of the acquired connection, or of the failure to acquire one. */
+    aws_http_connection_manager_on_connection_setup_fn *callback;
+    void *user_data;
+
+    /* Optional. Default is AWS_HTTP_CONNECTION_MANAGER_AFFINITY_NONE. */
+    enum aws_http_connection_manager_event_loop_affinity event_loop_affinity;
+
+    /*
+     * Optional. The event loop for event_loop_affinity, it must belong to the manager's bootstrap.
+     * If NULL, the event loop whose thread is calling. If the caller isn't on one of the bootstrap's
+     * event loops either, the acquisition has no affinity.
+     */
+    struct aws_event_loop *event_loop;
+
+    /* Optional. Default is AWS_HTTP_CONNECTION_MANAGER_PRIORITY_NORMAL. */
+    enum aws_http_connection_manager_acquisition_priority priority;
+
+    /*
+     * Optional. If set to a non-zero value, an acquisition still pending this many milliseconds after it was made
+     * fails with AWS_ERROR_HTTP_CONNECTION_MANAGER_ACQUISITION_TIMEOUT, instead of taking a connection once one
+     * frees up.
+     */
+    uint64_t acquisition_timeout_ms;
 };
 
 /*
@@ -67,6 +161,11 @@ struct aws_http_connection_manager_options {
      * Leave NULL to create cleartext (HTTP) connections.
      * For cleartext connections, use `http2_prior_knowledge` (RFC-7540 3.4)
      * to control whether that are treated as HTTP/1.1 or HTTP/2.
+     *
+     * Every connection the manager makes uses the aws_tls_ctx in these options.
+     * TLS session resumption, where the platform's TLS implementation does it, is cached per aws_tls_ctx.
+     * So to let managers for the same host resume each other's sessions, create them from the same aws_tls_ctx,
+     * rather than a new one per manager, and set the server name so sessions are matched to the host.
      */
     const struct aws_tls_connection_options *tls_connection_options;
 
@@ -124,6 +223,94 @@ struct aws_http_connection_manager_options {
      * timeout will be closed automatically.
      */
     uint64_t max_connection_idle_in_milliseconds;
+
+    /**
+     * Optional.
+     * If set to true, the manager is split into one shard per event loop in the bootstrap's event loop group,
+     * so that acquiring and releasing from many threads doesn't contend on one lock.
+     * Each shard has its own idle connections and pending acquisitions, and creates its connections on its event loop.
+     * Acquisitions go to the shard of the calling event loop thread (round-robin from other threads).
+     * A shard that runs out of connections takes idle connections from the other shards.
+     * max_connections is shared by all shards.
+     */
+    bool enable_sharding;
+
+    /**
+     * Optional.
+     * If set to a non-zero value, the manager opens connections in the background to keep at least this many idle
+     * (counting those still being set up), so that a burst of acquisitions doesn't wait on connection setup.
+     * Idle culling leaves this many connections open. Can't exceed max_connections.
+     * In sharded mode it's split evenly between the shards.
+     */
+    size_t min_idle_connections;
+
+    /**
+     * Optional.
+     * If set to true, the manager also opens connections ahead of demand.  It keeps a moving average of the time
+     * between acquisitions and of the time a new connection takes to set up, and keeps enough connections idle
+     * for the acquisitions expected while one more connection is set up.
+     */
+    bool enable_predictive_warming;
+
+    /**
+     * Optional.
+     * The most connections to have setting up at once while warming up the pool.
+     * Connections created for pending acquisitions don't wait on this. Default is 2.
+     */
+    size_t max_warming_connections;
+
+    /**
+     * Optional.
+     * If set to a non-zero value, and connections go through a tunneling proxy, the most connections to have
+     * negotiating a tunnel (proxy connect, CONNECT request, and any multi-leg authentication) at once.
+     * This covers connections for pending acquisitions as well as warming, so that a burst of acquisitions doesn't
+     * stampede the proxy.  Acquisitions beyond it wait for a tunnel to be set up, or for a connection to be released.
+     * Pair it with min_idle_connections or enable_predictive_warming to keep pre-negotiated tunnels ready.
+     * In sharded mode it's split evenly between the shards.
+     */
+    size_t max_concurrent_proxy_negotiations;
+
+    /**
+     * Optional.
+     * If set to a non-zero value, idle culling adapts to demand.  The manager tracks peak concurrency
+     * (connections in use plus waiting acquisitions) over a sliding window of this many milliseconds.
+     * Enough idle connections to cover that peak are culled by max_connection_idle_in_milliseconds as usual,
+     * the rest once idle for surplus_connection_idle_in_milliseconds.
+     */
+    uint64_t adaptive_culling_window_in_milliseconds;
+
+    /**
+     * Optional.
+     * How long idle connections beyond the recent peak stay open, when adaptive culling is on. Default is 1 second.
+     */
+    uint64_t surplus_connection_idle_in_milliseconds;
+
+    /**
+     * Optional.
+     * If set to true, connections are spread across all the addresses the host resolves to, instead of going
+     * wherever the resolver's choice of address lands them.  New connections go to the address with the fewest
+     * connections, and an address is backed off for a while after a connection to it fails.
+     * Ignored when a proxy is used.
+     */
+    bool enable_multi_address;
+
+    /**
+     * Optional.
+     * If non-zero, each new connection races attempts across the host's addresses.
+     * See `aws_http_client_connection_options.connection_attempt_delay_ms`.
+     * Ignored with enable_multi_address, which picks one address for each connection itself.
+     */
+    uint64_t connection_attempt_delay_ms;
+
+    /**
+     * Optional.
+     * Budget shared with other managers and connections, see aws_http_memory_budget_new().
+     * With enable_read_back_pressure, each HTTP/1.1 connection's read buffer draws its window from it.
+     * While it's exhausted, no new connections are made, and acquisitions wait for a connection to be released.
+     * A manager with no connections at all may still make one, so its acquisitions aren't stuck forever.
+     * The manager keeps a reference to the budget until it's destroyed.
+     */
+    struct aws_http_memory_budget *memory_budget;
 };
 
 AWS_EXTERN_C_BEGIN
@@ -172,6 +359,15 @@ void aws_http_connection_manager_acquire_connection(
     aws_http_connection_manager_on_connection_setup_fn *callback,
     void *user_data);
 
+/*
+ * Same as aws_http_connection_manager_acquire_connection(), with options.
+ * Use it to get a connection on a particular event loop, typically the caller's own.
+ */
+AWS_HTTP_API
+void aws_http_connection_manager_acquire_connection_with_options(
+    struct aws_http_connection_manager *manager,
+    const struct aws_http_connection_manager_acquire_options *options);
+
 /*
  * Returns a connection back to the manager.  All acquired connections must
  * eventually be released back to the manager in order to avoid a resource leak.
@@ -14,6 +14,7 @@ struct aws_http2_stream_manager;
 struct aws_client_bootstrap;
 struct aws_http_connection;
 struct aws_http_connection_manager;
+struct aws_http_memory_budget;
 struct aws_socket_options;
 struct aws_tls_connection_options;
 struct proxy_env_var_settings;
@@ -38,6 +39,22 @@ typedef void(
  */
 typedef void(aws_http2_stream_manager_shutdown_complete_fn)(void *user_data);
 
+/**
+ * How a new stream picks between connections that can take it.
+ * Two connections are sampled at random, and the stream goes to the better one by the policy.
+ * The connection-state policies fall back to comparing streams assigned when the two are even.
+ */
+enum aws_http2_stream_manager_selection_policy {
+    /* Fewest streams assigned. */
+    AWS_HTTP2_STREAM_MANAGER_SELECTION_FEWEST_STREAMS,
+    /* Most room in the peer's connection flow-control window, so the least data sent and not yet acknowledged. */
+    AWS_HTTP2_STREAM_MANAGER_SELECTION_LEAST_OUTSTANDING_BYTES,
+    /* Fewest streams waiting on the peer's connection flow-control window. */
+    AWS_HTTP2_STREAM_MANAGER_SELECTION_FEWEST_STALLED_STREAMS,
+    /* Lowest smoothed round trip time, from PINGs. Set connection_ping_period_ms to keep it current. */
+    AWS_HTTP2_STREAM_MANAGER_SELECTION_LOWEST_RTT,
+};
+
 /**
  * HTTP/2 stream manager configuration struct.
  *
@@ -142,11 +159,64 @@ struct aws_http2_stream_manager_options {
      * other end and the value here.
      */
     size_t max_concurrent_streams_per_connection;
+    /**
+     * Optional.
+     * If true, each connection's ideal number of concurrent streams adapts to how the server copes, starting from
+     * ideal_concurrent_streams_per_connection (8 if that's unset):
+     * - It grows by one after each round of that many streams complete, if the connection was kept busy with that
+     *   many streams during the round, and none of them took over twice the lowest latency seen on the connection.
+     * - It halves, at most once a round, when a stream takes longer than that, or the server refuses a stream
+     *   (REFUSED_STREAM).
+     * It stays between 1 and the connection's max concurrent streams. A new connection starts from the last number
+     * learned. As with a fixed ideal number, a connection past it only takes new streams once max_connections are
+     * open, so a server that slows down under load gets streams spread over more connections instead.
+     */
+    bool enable_adaptive_concurrency;
     /**
      * Required.
      * The max number of connections will be open at same time. If all the connections are full, manager will wait until
      * available to vender more streams */
     size_t max_connections;
+
+    /**
+     * Optional.
+     * Default is AWS_HTTP2_STREAM_MANAGER_SELECTION_FEWEST_STREAMS.
+     * How a new stream picks between connections, see `aws_http2_stream_manager_selection_policy`.
+     */
+    enum aws_http2_stream_manager_selection_policy selection_policy;
+
+    /**
+     * Optional.
+     * If set, once a stream with an ID of at least this is made on a connection, the manager opens a successor
+     * connection in the background. New streams move to the successor once it's ready, and the old connection
+     * drains, instead of every stream waiting on a new connection once the old one runs out of stream IDs.
+     * Connections being drained don't count against max_connections.
+     */
+    uint32_t connection_replacement_stream_id;
+    /**
+     * Optional.
+     * If set, connections older than this many milliseconds are replaced the same way.
+     */
+    uint64_t connection_replacement_age_ms;
+
+    /**
+     * Optional.
+     * If set, a stream the server never processed is replayed up to this many times, instead of completing with
+     * an error. Those are the streams above the last-stream-id of a GOAWAY, and streams reset with REFUSED_STREAM.
+     * A stream cut off by GOAWAY is replayed on another connection. The replay is a new stream: the callbacks in
+     * `aws_http_make_request_options` may be invoked with it instead of the stream passed to the acquire callback,
+     * which stays the one to release. `aws_http_stream_metrics.retry_count` tells the attempts apart.
+     * Only requests without a body, or whose body stream can seek back to the start, are replayed.
+     * Ignored for hedged streams and manual data writes.
+     */
+    size_t max_unprocessed_stream_retries;
+
+    /**
+     * Optional.
+     * While this budget is exhausted, no new connections are made, and streams wait for room on the ones there are.
+     * See `aws_http_connection_manager_options.memory_budget`.
+     */
+    struct aws_http_memory_budget *memory_budget;
 };
 
 struct aws_http2_stream_manager_acquire_stream_options {
@@ -162,6 +232,22 @@ struct aws_http2_stream_manager_acquire_stream_options {
     void *user_data;
     /* Required. see `aws_http_make_request_options` */
     const struct aws_http_make_request_options *options;
+    /**
+     * Optional.
+     * Only for idempotent requests. If set, and the stream hasn't started responding after this many milliseconds,
+     * a duplicate stream is made on a different connection. The first of the two to start responding is the one
+     * delivered to the callbacks in `options`, and the other is reset with CANCEL. The callbacks may be invoked
+     * with the duplicate stream instead of the stream passed to `callback`, which stays the one to release.
+     * `options->on_destroy` is invoked once both streams are gone.
+     * Ignored for requests with a body stream or manual data writes.
+     */
+    uint64_t hedge_delay_ms;
+    /**
+     * Optional.
+     * If set, hedge after the p95 latency of recently completed streams instead, once the stream manager has seen
+     * enough of them. hedge_delay_ms is used until then.
+     */
+    bool hedge_after_p95_latency;
 };
 
 AWS_EXTERN_C_BEGIN
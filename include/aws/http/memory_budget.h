@@ -0,0 +1,57 @@
+#ifndef AWS_HTTP_MEMORY_BUDGET_H
+#define AWS_HTTP_MEMORY_BUDGET_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+AWS_PUSH_SANE_WARNING_LEVEL
+
+/**
+ * A limit on how many bytes of incoming data may be buffered, shared by many connections.
+ *
+ * Each connection's buffering is normally bounded on its own (see aws_http1_connection_options.read_buffer_capacity),
+ * so the total grows with the number of connections. Connections given the same budget draw their read windows
+ * from it instead. Once it's exhausted, their windows stop opening, and their peers stop sending,
+ * until data is processed and bytes are given back.
+ *
+ * Connection managers given a budget also stop opening new connections while it's exhausted.
+ * Acquisitions wait for a connection to be released instead, though a manager with no connections may still open one.
+ *
+ * Only HTTP/1.1 connections with manual_window_management draw from the budget.
+ * HTTP/2 connections, and connections without manual_window_management, don't, since their windows can't be shrunk.
+ *
+ * The budget is ref-counted and any thread may use it.
+ */
+struct aws_http_memory_budget;
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Create a budget of `limit` bytes, which must be non-zero.
+ */
+AWS_HTTP_API
+struct aws_http_memory_budget *aws_http_memory_budget_new(struct aws_allocator *allocator, size_t limit);
+
+AWS_HTTP_API
+struct aws_http_memory_budget *aws_http_memory_budget_acquire(struct aws_http_memory_budget *budget);
+
+AWS_HTTP_API
+void aws_http_memory_budget_release(struct aws_http_memory_budget *budget);
+
+AWS_HTTP_API
+size_t aws_http_memory_budget_get_limit(const struct aws_http_memory_budget *budget);
+
+/**
+ * Bytes currently drawn from the budget, across everything sharing it.
+ */
+AWS_HTTP_API
+size_t aws_http_memory_budget_get_used(const struct aws_http_memory_budget *budget);
+
+AWS_EXTERN_C_END
+AWS_POP_SANE_WARNING_LEVEL
+
+#endif /* AWS_HTTP_MEMORY_BUDGET_H */
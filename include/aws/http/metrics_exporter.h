@@ -0,0 +1,104 @@
+#ifndef AWS_HTTP_METRICS_EXPORTER_H
+#define AWS_HTTP_METRICS_EXPORTER_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+#include <aws/common/array_list.h>
+#include <aws/common/byte_buf.h>
+
+AWS_PUSH_SANE_WARNING_LEVEL
+
+struct aws_crt_statistics_handler;
+struct aws_http_connection_manager;
+struct aws_http2_stream_manager;
+
+/**
+ * Aggregates HTTP statistics across every connection and manager in the process,
+ * and renders them as OpenMetrics (Prometheus) text on demand.
+ *
+ * Connections feed it their channel statistics (aws_crt_statistics_http1_channel and
+ * aws_crt_statistics_http2_channel), either through aws_http_metrics_exporter_observe_statistics()
+ * as the statistics_observer_fn of aws_http_connection_monitoring_options, or through a handler from
+ * aws_http_metrics_exporter_new_statistics_handler() set on the channel.
+ * Those are added into per-thread shards of atomic counters, so event loops never contend with each other
+ * or with rendering. Managers are added by name, and sampled with their fetch_metrics function when rendering.
+ *
+ * The exporter is ref-counted and any thread may use it.
+ */
+struct aws_http_metrics_exporter;
+
+AWS_EXTERN_C_BEGIN
+
+AWS_HTTP_API
+struct aws_http_metrics_exporter *aws_http_metrics_exporter_new(struct aws_allocator *allocator);
+
+AWS_HTTP_API
+struct aws_http_metrics_exporter *aws_http_metrics_exporter_acquire(struct aws_http_metrics_exporter *exporter);
+
+AWS_HTTP_API
+void aws_http_metrics_exporter_release(struct aws_http_metrics_exporter *exporter);
+
+/**
+ * Adds a connection's statistics sample to the exporter. Matches aws_http_statistics_observer_fn,
+ * pass the exporter as statistics_observer_user_data.
+ */
+AWS_HTTP_API
+void aws_http_metrics_exporter_observe_statistics(
+    size_t connection_nonce,
+    const struct aws_array_list *stats_list,
+    void *exporter);
+
+/**
+ * Returns a statistics handler that adds every sample of the channel it's set on to the exporter,
+ * for connections without connection monitoring. The handler keeps the exporter alive until destroyed.
+ */
+AWS_HTTP_API
+struct aws_crt_statistics_handler *aws_http_metrics_exporter_new_statistics_handler(
+    struct aws_http_metrics_exporter *exporter);
+
+/**
+ * Reports a connection manager's metrics, labeled with the given name, until it's removed.
+ * The manager must be removed before it's released.
+ */
+AWS_HTTP_API
+int aws_http_metrics_exporter_add_connection_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const struct aws_http_connection_manager *manager,
+    struct aws_byte_cursor name);
+
+AWS_HTTP_API
+void aws_http_metrics_exporter_remove_connection_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const struct aws_http_connection_manager *manager);
+
+/**
+ * Reports a HTTP/2 stream manager's metrics, labeled with the given name, until it's removed.
+ * The manager must be removed before it's released.
+ */
+AWS_HTTP_API
+int aws_http_metrics_exporter_add_stream_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const struct aws_http2_stream_manager *manager,
+    struct aws_byte_cursor name);
+
+AWS_HTTP_API
+void aws_http_metrics_exporter_remove_stream_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const struct aws_http2_stream_manager *manager);
+
+/**
+ * Appends the current metrics, in the OpenMetrics text format, to the dynamic buffer.
+ * Everything is a running total since the exporter was created, durations are in seconds.
+ */
+AWS_HTTP_API
+int aws_http_metrics_exporter_render(struct aws_http_metrics_exporter *exporter, struct aws_byte_buf *output);
+
+AWS_EXTERN_C_END
+AWS_POP_SANE_WARNING_LEVEL
+
+#endif /* AWS_HTTP_METRICS_EXPORTER_H */
@@ -0,0 +1,63 @@
+#ifndef AWS_HTTP_ASYNC_BODY_STREAM_H
+#define AWS_HTTP_ASYNC_BODY_STREAM_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+struct aws_async_input_stream;
+struct aws_channel;
+struct aws_http_message;
+struct aws_input_stream;
+
+/* Invoked on the channel's thread once the read an async body stream was waiting on completes */
+typedef void(aws_http_async_body_stream_ready_fn)(void *user_data);
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Create a stream that presents an aws_async_input_stream as an aws_input_stream, so the encoders can read it
+ * without ever blocking the event-loop thread.
+ * The stream reads ahead from `source`, one read at a time, into a buffer of `buffer_size` bytes.
+ * Reading copies out whatever has arrived, and starts the next read once the buffer is drained.
+ * While a read is in progress, reading gives 0 bytes without reaching end-of-stream,
+ * see aws_http_async_body_stream_wait(). Its length is unknown, and it can't seek.
+ */
+AWS_HTTP_API
+struct aws_input_stream *aws_http_async_body_stream_new(
+    struct aws_allocator *allocator,
+    struct aws_async_input_stream *source,
+    size_t buffer_size);
+
+/**
+ * Returns a new reference to the stream an encoder should read the message's body from, or NULL if it has none.
+ * This is the message's body stream, or its async body stream wrapped by aws_http_async_body_stream_new().
+ */
+AWS_HTTP_API
+struct aws_input_stream *aws_http_message_acquire_outgoing_body(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *message);
+
+/**
+ * If `stream` is waiting on an async read (directly, or underneath a content encoding stream),
+ * arrange for `on_ready` to be invoked on the channel's thread once the read completes, and return true.
+ * The channel is kept alive until then.
+ * Returns false if the stream can be read right now, or isn't an async body stream at all.
+ *
+ * While a wait is pending, further calls just return true: pass the same `on_ready` and `user_data` each time,
+ * it's only invoked once.
+ * Must be called from the channel's thread.
+ */
+AWS_HTTP_API
+bool aws_http_async_body_stream_wait(
+    struct aws_input_stream *stream,
+    struct aws_channel *channel,
+    aws_http_async_body_stream_ready_fn *on_ready,
+    void *user_data);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_ASYNC_BODY_STREAM_H */
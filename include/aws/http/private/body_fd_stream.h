@@ -0,0 +1,28 @@
+#ifndef AWS_HTTP_BODY_FD_STREAM_H
+#define AWS_HTTP_BODY_FD_STREAM_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+struct aws_input_stream;
+
+/**
+ * If the stream was made by aws_http_body_stream_new_from_fd(), returns true and sets the file descriptor,
+ * the current file offset, and the number of bytes that remain. Otherwise returns false.
+ */
+bool aws_http_body_fd_stream_get_range(
+    struct aws_input_stream *stream,
+    int *out_fd,
+    uint64_t *out_offset,
+    uint64_t *out_remaining);
+
+/**
+ * Advance the stream past bytes that were sent straight from the file, without being read.
+ */
+void aws_http_body_fd_stream_skip(struct aws_input_stream *stream, uint64_t bytes);
+
+#endif /* AWS_HTTP_BODY_FD_STREAM_H */
@@ -14,6 +14,7 @@
 #include <aws/common/atomics.h>
 #include <aws/io/channel.h>
 #include <aws/io/channel_bootstrap.h>
+#include <aws/io/host_resolver.h>
 
 struct aws_http_message;
 struct aws_http_make_request_options;
@@ -24,6 +25,13 @@ struct aws_http_stream;
  * tests override the vtable to mock those systems */
 struct aws_http_connection_system_vtable {
     int (*aws_client_bootstrap_new_socket_channel)(struct aws_socket_channel_bootstrap_options *options);
+    /* Only used when racing connection attempts, see connection_attempt_delay_ms */
+    int (*aws_host_resolver_resolve_host)(
+        struct aws_host_resolver *resolver,
+        const struct aws_string *host_name,
+        aws_on_host_resolved_result_fn *res,
+        const struct aws_host_resolution_config *config,
+        void *user_data);
 };
 
 struct aws_http_connection_vtable {
@@ -39,8 +47,11 @@ struct aws_http_connection_vtable {
     struct aws_http_stream *(*new_server_request_handler_stream)(
         const struct aws_http_request_handler_options *options);
     int (*stream_send_response)(struct aws_http_stream *stream, struct aws_http_message *response);
+    int (*stream_send_static_response)(struct aws_http_stream *stream, struct aws_http_static_response *response);
     void (*close)(struct aws_http_connection *connection);
     void (*stop_new_requests)(struct aws_http_connection *connection);
+    /* Must be called on the connection's thread. See aws_http_connection_drain() */
+    void (*drain)(struct aws_http_connection *connection);
     bool (*is_open)(const struct aws_http_connection *connection);
     bool (*new_requests_allowed)(const struct aws_http_connection *connection);
 
@@ -76,6 +87,7 @@ struct aws_http_connection_vtable {
     void (*get_remote_settings)(
         const struct aws_http_connection *http2_connection,
         struct aws_http2_setting out_settings[AWS_HTTP2_SETTINGS_COUNT]);
+    size_t (*get_hpack_memory_usage)(const struct aws_http_connection *http2_connection);
 };
 
 typedef int(aws_http_proxy_request_transform_fn)(struct aws_http_message *request, void *user_data);
@@ -92,23 +104,32 @@ struct aws_http_connection {
     enum aws_http_version http_version;
 
     aws_http_proxy_request_transform_fn *proxy_request_transform;
+    /* Set on forwarding proxy connections: "http://host:port" of the origin server,
+     * which the H1 encoder writes in front of origin-form request paths. Owned by user_data */
+    struct aws_byte_cursor proxy_request_target_prefix;
     void *user_data;
 
     /* Connection starts with 1 hold for the user.
      * aws_http_streams will also acquire holds on their connection for the duration of their lifetime */
     struct aws_atomic_var refcount;
 
+    /* Published by the connection monitor, if any. See aws_http_connection_get_health_score() */
+    struct aws_atomic_var health_score;
+
     /* Starts at either 1 or 2, increments by two with each new stream */
     uint32_t next_stream_id;
 
     union {
         struct aws_http_connection_client_data {
             uint64_t response_first_byte_timeout_ms;
+            struct aws_http_connection_setup_metrics setup_metrics;
         } client;
 
         struct aws_http_connection_server_data {
             aws_http_on_incoming_request_fn *on_incoming_request;
             aws_http_on_server_connection_shutdown_fn *on_shutdown;
+            /* Set if the server has admission control. The connection holds a reference */
+            struct aws_http_server_admission *admission;
         } server;
     } client_or_server_data;
 
@@ -139,6 +160,11 @@ struct aws_http_client_bootstrap {
     struct aws_http2_connection_options http2_options; /* allocated with bootstrap */
     struct aws_hash_table *alpn_string_map;            /* allocated with bootstrap */
     struct aws_http_connection *connection;
+    /* Filled in as setup progresses, and copied to the connection once it's created */
+    struct aws_http_connection_setup_metrics setup_metrics;
+    /* NULL unless the user asked for traffic capture. The options' directory points into it */
+    struct aws_string *traffic_capture_directory;
+    struct aws_http_traffic_capture_options traffic_capture_options;
 };
 
 AWS_EXTERN_C_BEGIN
@@ -159,6 +185,14 @@ int aws_http_client_connect_internal(
 AWS_HTTP_API
 void aws_http_connection_acquire(struct aws_http_connection *connection);
 
+/**
+ * Gracefully close a server connection: it refuses new requests, lets the ones in progress finish, then closes.
+ * HTTP/1 connections say "Connection: close" in the final response, HTTP/2 connections send GOAWAY.
+ * Must be called on the connection's thread. Used by aws_http_server_drain(), exported for tests.
+ */
+AWS_HTTP_API
+void aws_http_connection_drain(struct aws_http_connection *connection);
+
 /**
  * Allow tests to fake stats data
  */
@@ -184,12 +218,15 @@ uint32_t aws_http_connection_get_next_stream_id(struct aws_http_connection *conn
  * @param channel channel to apply the http handler/connection to
  * @param is_server should the handler behave like an http server
  * @param is_using_tls is tls is being used (do an alpn check of the to-the-left channel handler)
+ * @param is_socket_channel the channel was set up by a socket bootstrap, so its leftmost handler is the socket handler.
+ *                          Only then may HTTP/1 send file bodies straight to the socket.
  * @param manual_window_management is manual window management enabled
  * @param prior_knowledge_http2 prior knowledge about http2 connection to be used
  * @param initial_window_size what should the initial window size be
  * @param alpn_string_map the customized ALPN string map from `struct aws_string *` to `enum aws_http_version`.
  * @param http1_options http1 options
  * @param http2_options http2 options
+ * @param traffic_capture_options if not NULL, the connection's traffic is recorded
  * @return a new http connection or NULL on failure
  */
 AWS_HTTP_API
@@ -198,12 +235,14 @@ struct aws_http_connection *aws_http_connection_new_channel_handler(
     struct aws_channel *channel,
     bool is_server,
     bool is_using_tls,
+    bool is_socket_channel,
     bool manual_window_management,
     bool prior_knowledge_http2,
     size_t initial_window_size,
     const struct aws_hash_table *alpn_string_map,
     const struct aws_http1_connection_options *http1_options,
     const struct aws_http2_connection_options *http2_options,
+    const struct aws_http_traffic_capture_options *traffic_capture_options,
     void *connection_user_data);
 
 AWS_EXTERN_C_END
@@ -10,6 +10,8 @@
 
 #include <aws/http/connection.h>
 
+#include <aws/io/host_resolver.h>
+
 struct aws_http_connection_manager;
 
 /* vtable of functions that aws_http_connection_manager uses to interact with external systems.
@@ -26,6 +28,15 @@ struct aws_http_connection_manager_system_vtable {
     bool (*aws_channel_thread_is_callers_thread)(struct aws_channel *channel);
     struct aws_channel *(*aws_http_connection_get_channel)(struct aws_http_connection *connection);
     enum aws_http_version (*aws_http_connection_get_version)(const struct aws_http_connection *connection);
+    /* Optional, connections count as healthy without it */
+    uint32_t (*aws_http_connection_get_health_score)(const struct aws_http_connection *connection);
+    /* Only used in multi-address mode */
+    int (*aws_host_resolver_resolve_host)(
+        struct aws_host_resolver *resolver,
+        const struct aws_string *host_name,
+        aws_on_host_resolved_result_fn *res,
+        const struct aws_host_resolution_config *config,
+        void *user_data);
 };
 
 AWS_HTTP_API
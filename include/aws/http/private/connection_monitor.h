@@ -22,6 +22,10 @@ struct aws_statistics_handler_http_connection_monitor_impl {
     uint32_t last_incoming_stream_id;
     uint32_t last_outgoing_stream_id;
     uint64_t last_measured_throughput;
+
+    /* See aws_http_connection_get_health_score(). Published to the connection, if one is set */
+    uint32_t health_score;
+    struct aws_http_connection *connection;
 };
 
 AWS_EXTERN_C_BEGIN
@@ -35,6 +39,14 @@ struct aws_crt_statistics_handler *aws_crt_statistics_handler_new_http_connectio
     struct aws_allocator *allocator,
     struct aws_http_connection_monitoring_options *options);
 
+/**
+ * Publish health scores to this connection, see aws_http_connection_get_health_score().
+ */
+AWS_HTTP_API
+void aws_http_connection_monitor_set_connection(
+    struct aws_crt_statistics_handler *handler,
+    struct aws_http_connection *connection);
+
 /**
  * Validates monitoring options to ensure they are sensible
  */
@@ -0,0 +1,34 @@
+#ifndef AWS_HTTP_CONTENT_ENCODING_STREAM_H
+#define AWS_HTTP_CONTENT_ENCODING_STREAM_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+struct aws_http_content_encoding_options;
+struct aws_http_message;
+struct aws_input_stream;
+
+/**
+ * Returns a new stream that reads the message's body stream, encoding it as it goes,
+ * see aws_http_content_encoding_options. Its length is unknown, and it can't seek.
+ * `message` is not modified. The connection sends the Content-Encoding header,
+ * and leaves out the message's Content-Length header, in whatever it actually sends.
+ */
+AWS_HTTP_API
+struct aws_input_stream *aws_http_content_encoding_stream_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *message,
+    const struct aws_http_content_encoding_options *options);
+
+/**
+ * If the stream was made by aws_http_content_encoding_stream_new(), returns the body stream it reads.
+ * Otherwise returns NULL.
+ */
+AWS_HTTP_API
+struct aws_input_stream *aws_http_content_encoding_stream_get_source(struct aws_input_stream *stream);
+
+#endif /* AWS_HTTP_CONTENT_ENCODING_STREAM_H */
@@ -9,17 +9,40 @@
 #include <aws/common/mutex.h>
 #include <aws/http/private/connection_impl.h>
 #include <aws/http/private/h1_encoder.h>
+#include <aws/http/private/memory_budget_impl.h>
+#include <aws/http/private/mpsc_queue.h>
+#include <aws/http/private/timer_wheel.h>
 #include <aws/http/statistics.h>
 
 #ifdef _MSC_VER
 #    pragma warning(disable : 4214) /* nonstandard extension used: bit field types other than int */
 #endif
 
+struct aws_h1_stream;
+
 struct aws_h1_connection {
     struct aws_http_connection base;
 
     size_t initial_stream_window_size;
 
+    /* Client-only, see aws_http1_connection_options. 0 for no limit */
+    size_t max_pipeline_depth;
+
+    /* Client-only, see aws_http1_connection_options. Threshold is 0 to disable */
+    uint64_t expect_continue_threshold;
+    uint64_t expect_continue_timeout_ms;
+
+    /* Server-only, see aws_http1_connection_options. 0 to disable */
+    uint64_t idle_timeout_ms;
+    size_t max_requests;
+
+    /* Recycles the chunks written to this connection's streams */
+    struct aws_h1_chunk_pool chunk_pool;
+
+    /* Socket that file bodies are sent to directly with sendfile(), see aws_h1_connection_enable_sendfile().
+     * -1 if file bodies are read and copied like any other body. */
+    int sendfile_socket_fd;
+
     /* Task responsible for sending data.
      * As long as there is data available to send, the task will be "active" and repeatedly:
      * 1) Encode outgoing stream data to an aws_io_message and send it up the channel.
@@ -33,18 +56,38 @@ struct aws_h1_connection {
      * adds more outgoing data. */
     struct aws_channel_task outgoing_stream_task;
 
-    /* Task that removes items from `synced_data` and does their on-thread work.
+    /* Task that takes new client streams from `new_client_stream_queue` and does their on-thread work.
      * Runs once and wait until it's scheduled again.
-     * Any function that wants to schedule this task MUST:
-     * - acquire the synced_data.lock
-     * - check whether `synced_data.is_cross_thread_work_scheduled` was true or false.
-     * - set `synced_data.is_cross_thread_work_scheduled = true`
-     * - release synced_data.lock
-     * - ONLY IF `synced_data.is_cross_thread_work_scheduled` CHANGED from false to true:
-     *   - then schedule the task
-     */
+     * It's scheduled by whoever pushes onto the empty queue (see aws_http_mpsc_queue_push()),
+     * so activating a stream never takes the lock. */
     struct aws_channel_task cross_thread_work_task;
 
+    /* New client streams that have not been moved to `thread_data.stream_list` yet.
+     * Any thread may push, via aws_h1_stream_activate(). Closed when writing shuts down.
+     * This queue is not used on servers. */
+    struct aws_http_mpsc_queue new_client_stream_queue;
+
+    /* Client-only. ID for the next activated stream. Atomic, so activation doesn't need the lock */
+    struct aws_atomic_var next_client_stream_id;
+
+    /* int. If non-zero, reason to immediately reject new streams. (ex: closing)
+     * Any thread may read it. Only written while holding synced_data.lock */
+    struct aws_atomic_var new_stream_error_code;
+
+    /* Task that frees the body data in `synced_data.released_body_refs`.
+     * Scheduled on the event-loop, rather than the channel, so it still runs on-thread after the channel shuts down.
+     * Each outstanding aws_http1_incoming_body_ref holds the channel, which keeps this connection alive. */
+    struct aws_task body_ref_release_task;
+
+    /* NULL unless the read buffer draws its window from a budget shared with other connections,
+     * see aws_http1_connection_options.memory_budget */
+    struct aws_http_memory_budget *memory_budget;
+
+    /* Invoked once bytes are given back to an exhausted `memory_budget`. It schedules `memory_budget_task`,
+     * which tries to open the window again. The channel is held from when waiting starts until the task runs */
+    struct aws_http_memory_budget_waiter memory_budget_waiter;
+    struct aws_channel_task memory_budget_task;
+
     /* Only the event-loop thread may touch this data */
     struct {
         /* List of streams being worked on. */
@@ -61,9 +104,27 @@ struct aws_h1_connection {
         struct aws_h1_stream *incoming_stream;
         struct aws_h1_decoder *incoming_stream_decoder;
 
+        /* Reused to pass each batch of decoded headers to the stream's on_incoming_headers callback.
+         * (struct aws_http_header) */
+        struct aws_array_list incoming_headers_batch;
+
+        /* Reused by any stream with a content decoder, to pass decoded body data to on_incoming_body.
+         * Allocated the first time it's needed */
+        struct aws_byte_buf content_decode_buffer;
+
         /* Used to encode requests and responses */
         struct aws_h1_encoder encoder;
 
+        /* How long to wait before trying sendfile() again while the socket is full.
+         * Doubles with each try that sends nothing, and is 0 again once a try sends something */
+        uint64_t sendfile_retry_delay_ns;
+
+        /* Server-only. Armed in the event-loop's shared timer wheel while no request is in progress */
+        struct aws_http_timer idle_timer;
+
+        /* Server-only. Number of requests received, counted against `max_requests` */
+        size_t request_count;
+
         /**
          * All aws_io_messages arriving in the read direction are queued here before processing.
          * This allows the connection to receive more data than the the current HTTP-stream might allow,
@@ -72,11 +133,19 @@ struct aws_h1_connection {
          * The `aws_io_message.copy_mark` is used to track progress on partially processed messages.
          * `pending_bytes` is the sum of all unprocessed bytes across all queued messages.
          * `capacity` is the limit for how many unprocessed bytes we'd like in the queue.
+         *
+         * If autotuning (see aws_http1_connection_options.read_buffer_max_capacity) `capacity` adapts
+         * between `min_capacity` and `max_capacity`. Otherwise all three are the same.
+         * `is_window_exhausted` is set when the connection window reaches 0, meaning the socket could
+         * have delivered more data if the window were bigger.
          */
         struct {
             struct aws_linked_list messages;
             size_t pending_bytes;
             size_t capacity;
+            size_t min_capacity;
+            size_t max_capacity;
+            bool is_window_exhausted;
         } read_buffer;
 
         /**
@@ -88,6 +157,16 @@ struct aws_h1_connection {
          */
         size_t connection_window;
 
+        /* The queued message the decoder is working on, while aws_h1_decode() runs. Otherwise NULL */
+        struct aws_io_message *decoding_message;
+
+        /* Sum of body bytes retained via aws_http1_stream_retain_incoming_body() that haven't been freed yet.
+         * These count against the connection window, like bytes in the read_buffer. */
+        size_t retained_body_bytes;
+
+        /* Bytes drawn from `memory_budget`: the connection window, plus data in the read_buffer or retained */
+        size_t memory_budget_drawn;
+
         /* Only used by tests. Sum of window_increments issued by this slot. Resets each time it's queried */
         size_t recent_window_increments;
 
@@ -112,24 +191,35 @@ struct aws_h1_connection {
         bool is_outgoing_stream_task_active : 1;
 
         bool is_processing_read_messages : 1;
+
+        /* see `memory_budget_waiter` */
+        bool is_waiting_for_memory_budget : 1;
+
+        /* Server-only. Set by aws_http_connection_drain(), the final response gets a "Connection: close" header */
+        bool is_draining : 1;
+
+        /* True if a user retained body data from the front message of the read_buffer.
+         * The message may still be freed normally, check `synced_data.decoding_message_ref`. */
+        bool is_decoding_message_retained : 1;
     } thread_data;
 
     /* Any thread may touch this data, but the lock must be held */
     struct {
         struct aws_mutex lock;
 
-        /* New client streams that have not been moved to `stream_list` yet.
-         * This list is not used on servers. */
-        struct aws_linked_list new_client_stream_list;
-
         /* If non-zero, then window_update_task is scheduled */
         size_t window_update_size;
 
-        /* If non-zero, reason to immediately reject new streams. (ex: closing) */
-        int new_stream_error_code;
+        /* Reference to the front message of the read_buffer, whose body data a user has retained.
+         * NULL once every reference is released, or once the connection is done with the message
+         * (then the reference frees the message) */
+        struct aws_http1_incoming_body_ref *decoding_message_ref;
+
+        /* References whose count reached 0, for `body_ref_release_task` to free */
+        struct aws_linked_list released_body_refs;
 
-        /* See `cross_thread_work_task` */
-        bool is_cross_thread_work_task_scheduled : 1;
+        /* See `body_ref_release_task` */
+        bool is_body_ref_release_task_scheduled : 1;
 
         /* For checking status from outside the event-loop thread. */
         bool is_open : 1;
@@ -165,6 +255,15 @@ struct aws_http_connection *aws_http_connection_new_http1_1_client(
     size_t initial_window_size,
     const struct aws_http1_connection_options *http1_options);
 
+/**
+ * Let the connection send file bodies (see aws_http_body_stream_new_from_fd()) straight to the socket.
+ * Only valid for plaintext connections whose slot is right next to the socket handler,
+ * so nothing between the connection and the socket needs to see the data.
+ * Does nothing on platforms without sendfile().
+ */
+AWS_HTTP_API
+void aws_h1_connection_enable_sendfile(struct aws_http_connection *connection_base, int socket_fd);
+
 /* Allow tests to check current window stats */
 AWS_HTTP_API
 struct aws_h1_window_stats aws_h1_connection_window_stats(struct aws_http_connection *connection_base);
@@ -198,4 +297,16 @@ void aws_h1_connection_try_write_outgoing_stream(struct aws_h1_connection *conne
  */
 void aws_h1_connection_try_process_read_messages(struct aws_h1_connection *connection);
 
+/* Set up the timers of a new client stream. They're armed later, on the connection's thread. */
+void aws_h1_connection_init_stream_timers(struct aws_h1_stream *stream);
+
+/**
+ * Implements aws_http1_stream_retain_incoming_body().
+ * MUST be called from the connection's event-loop thread, while the stream's on_incoming_body callback runs.
+ */
+struct aws_http1_incoming_body_ref *aws_h1_connection_retain_incoming_body(
+    struct aws_h1_connection *connection,
+    struct aws_h1_stream *stream,
+    struct aws_byte_cursor *data);
+
 #endif /* AWS_HTTP_H1_CONNECTION_H */
@@ -30,6 +30,13 @@ struct aws_h1_decoder_vtable {
      */
     int (*on_header)(const struct aws_h1_decoded_header *header, void *user_data);
 
+    /**
+     * Optional. If set, it's called in place of `on_header`, with all the headers of a header-block at once.
+     * A block that spans multiple `aws_h1_decode` calls is delivered in several batches, one per call at most,
+     * since the headers point into that call's input. Same read-only rules as `on_header`.
+     */
+    int (*on_headers_batch)(const struct aws_h1_decoded_header *headers, size_t num_headers, void *user_data);
+
     /**
      * Called from `aws_h1_decode` when a portion of the http body has been received.
      * `finished` is true if this is the last section of the http body, and false if more body data is yet to be
@@ -72,6 +79,7 @@ AWS_HTTP_API void aws_h1_decoder_destroy(struct aws_h1_decoder *decoder);
 AWS_HTTP_API int aws_h1_decode(struct aws_h1_decoder *decoder, struct aws_byte_cursor *data);
 
 AWS_HTTP_API void aws_h1_decoder_set_logging_id(struct aws_h1_decoder *decoder, const void *id);
+/* Set true when decoding the response to a HEAD request. Has no effect when decoding requests. */
 AWS_HTTP_API void aws_h1_decoder_set_body_headers_ignored(struct aws_h1_decoder *decoder, bool body_headers_ignored);
 
 /* RFC-7230 section 4.2 Message Format */
@@ -85,6 +93,17 @@ AWS_HTTP_API uint64_t aws_h1_decoder_get_content_length(const struct aws_h1_deco
 AWS_HTTP_API bool aws_h1_decoder_get_body_headers_ignored(const struct aws_h1_decoder *decoder);
 AWS_HTTP_API enum aws_http_header_block aws_h1_decoder_get_header_block(const struct aws_h1_decoder *decoder);
 
+/**
+ * Bytes of the current message consumed so far, including the start line, headers, and any chunked encoding.
+ * Callbacks may call this to learn how much of the message has been decoded, up to and including what triggered them.
+ */
+AWS_HTTP_API uint64_t aws_h1_decoder_get_message_bytes(const struct aws_h1_decoder *decoder);
+
+/**
+ * Bytes of the current message's start line and headers. 0 until the head is done.
+ */
+AWS_HTTP_API uint64_t aws_h1_decoder_get_head_bytes(const struct aws_h1_decoder *decoder);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_HTTP_H1_DECODER_H */
@@ -5,20 +5,43 @@
  * SPDX-License-Identifier: Apache-2.0.
  */
 
+#include <aws/common/mutex.h>
+#include <aws/common/ref_count.h>
 #include <aws/http/private/http_impl.h>
 #include <aws/http/private/request_response_impl.h>
 
+struct aws_h1_chunk_pool;
+
 struct aws_h1_chunk {
     struct aws_allocator *allocator;
+    /* Pool this chunk goes back to when destroyed, NULL if it's freed instead */
+    struct aws_h1_chunk_pool *pool;
     struct aws_input_stream *data;
+    /* If set, data is NULL, and this caller-owned memory is sent without copying */
+    struct aws_byte_cursor zero_copy_data;
     uint64_t data_size;
     aws_http1_stream_write_chunk_complete_fn *on_complete;
     void *user_data;
     struct aws_linked_list_node node;
-    /* Buffer containing pre-encoded start line: chunk-size [chunk-ext] CRLF */
+    /* Buffer containing pre-encoded start line: chunk-size [chunk-ext] CRLF.
+     * If the chunk has no extensions, this stays empty and the line is normally written
+     * straight into the outgoing message, the buffer is only filled if the line must be split across messages. */
     struct aws_byte_buf chunk_line;
 };
 
+/**
+ * Recycles chunks without extensions (they're all the same size),
+ * so that streaming many chunks doesn't cost an allocation and free per chunk.
+ * Any thread may use the pool.
+ */
+struct aws_h1_chunk_pool {
+    struct aws_allocator *allocator;
+    struct aws_mutex lock;
+    struct aws_linked_list free_list; /* aws_h1_chunk */
+    size_t free_count;
+    size_t max_free;
+};
+
 struct aws_h1_trailer {
     struct aws_allocator *allocator;
     struct aws_byte_buf trailer_data;
@@ -31,7 +54,9 @@ struct aws_h1_trailer {
 struct aws_h1_encoder_message {
     /* Upon creation, the "head" (everything preceding body) is buffered here. */
     struct aws_byte_buf outgoing_head_buf;
-    /* Single stream used for unchunked body */
+    /* Length of the head alone. outgoing_head_buf may also hold the body of a static response */
+    size_t head_len;
+    /* Single stream used for unchunked body, or for chunked body if has_chunked_body_stream is set */
     struct aws_input_stream *body;
 
     /* Pointer to list of `struct aws_h1_chunk`, used for chunked encoding.
@@ -48,12 +73,32 @@ struct aws_h1_encoder_message {
     uint64_t content_length;
     bool has_connection_close_header;
     bool has_chunked_encoding_header;
+    /* Body stream of unknown length, sent with chunked encoding instead of pending_chunk_list */
+    bool has_chunked_body_stream;
+    /* Request-only. The body is held back after the head, until the server responds with 100 (Continue) */
+    bool has_expect_continue_header;
+};
+
+/**
+ * A response serialized ahead of time, see aws_http_static_response_new().
+ * Immutable once created.
+ */
+struct aws_http_static_response {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+    /* Head and body, ready to write */
+    struct aws_byte_buf data;
+    /* Length of the head alone, which is all that's sent in reply to a HEAD request */
+    size_t head_len;
+    bool has_connection_close_header;
 };
 
 enum aws_h1_encoder_state {
     AWS_H1_ENCODER_STATE_INIT,
     AWS_H1_ENCODER_STATE_HEAD,
+    AWS_H1_ENCODER_STATE_AWAIT_CONTINUE,
     AWS_H1_ENCODER_STATE_UNCHUNKED_BODY,
+    AWS_H1_ENCODER_STATE_CHUNKED_BODY_STREAM,
     AWS_H1_ENCODER_STATE_CHUNK_NEXT,
     AWS_H1_ENCODER_STATE_CHUNK_LINE,
     AWS_H1_ENCODER_STATE_CHUNK_BODY,
@@ -76,16 +121,26 @@ struct aws_h1_encoder {
     size_t chunk_count;
     /* Encoder logs with this stream ptr as the ID, and passes this ptr to the chunk_complete callback */
     struct aws_http_stream *current_stream;
+    /* If set, a body from aws_http_body_stream_new_from_fd() isn't encoded.
+     * The connection sends it straight from the file instead, see aws_h1_encoder_get_file_body() */
+    bool sends_file_bodies_directly;
 };
 
-struct aws_h1_chunk *aws_h1_chunk_new(struct aws_allocator *allocator, const struct aws_http1_chunk_options *options);
+int aws_h1_chunk_pool_init(struct aws_h1_chunk_pool *pool, struct aws_allocator *allocator, size_t max_free);
+void aws_h1_chunk_pool_clean_up(struct aws_h1_chunk_pool *pool);
+
+/* Pool is optional, pass NULL to always allocate */
+struct aws_h1_chunk *aws_h1_chunk_new(
+    struct aws_allocator *allocator,
+    struct aws_h1_chunk_pool *pool,
+    const struct aws_http1_chunk_options *options);
 struct aws_h1_trailer *aws_h1_trailer_new(
     struct aws_allocator *allocator,
     const struct aws_http_headers *trailing_headers);
 
 void aws_h1_trailer_destroy(struct aws_h1_trailer *trailer);
 
-/* Just destroy the chunk (don't fire callback) */
+/* Just destroy the chunk (don't fire callback). It goes back to its pool, if it came from one */
 void aws_h1_chunk_destroy(struct aws_h1_chunk *chunk);
 
 /* Destroy chunk and fire its completion callback */
@@ -103,6 +158,37 @@ int aws_h1_encoder_message_init_from_request(
     const struct aws_http_message *request,
     struct aws_linked_list *pending_chunk_list);
 
+/* Like aws_h1_encoder_message_init_from_request(), but sends `body` instead of the request's body stream.
+ * The body's length needn't be known, it's sent with chunked encoding.
+ * The request's Content-Length header is left out, and "Transfer-Encoding: chunked" is added
+ * if the request doesn't already have it. */
+AWS_HTTP_API
+int aws_h1_encoder_message_init_from_request_with_chunked_body(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator,
+    const struct aws_http_message *request,
+    struct aws_input_stream *body,
+    struct aws_linked_list *pending_chunk_list);
+
+/* Like aws_h1_encoder_message_init_from_request(), but for requests sent through a forwarding proxy.
+ * `target_prefix` ("http://host:port") is written in front of an origin-form path, making the request-target
+ * absolute-form without rewriting the request's path. An asterisk-form OPTIONS target becomes just the prefix.
+ * Other targets are sent as-is.
+ * `chunked_body` is optional, see aws_h1_encoder_message_init_from_request_with_chunked_body().
+ * `target_prefix` only needs to stay valid for the duration of this call. */
+AWS_HTTP_API
+int aws_h1_encoder_message_init_from_proxied_request(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator,
+    const struct aws_http_message *request,
+    struct aws_byte_cursor target_prefix,
+    struct aws_input_stream *chunked_body,
+    struct aws_linked_list *pending_chunk_list);
+
+/* Returns true if aws_h1_encoder_message_init_from_proxied_request() would prefix this request-target */
+AWS_HTTP_API
+bool aws_h1_encoder_is_prefixable_request_target(struct aws_byte_cursor method, struct aws_byte_cursor path);
+
 int aws_h1_encoder_message_init_from_response(
     struct aws_h1_encoder_message *message,
     struct aws_allocator *allocator,
@@ -110,6 +196,39 @@ int aws_h1_encoder_message_init_from_response(
     bool body_headers_ignored,
     struct aws_linked_list *pending_chunk_list);
 
+/* Like aws_h1_encoder_message_init_from_response(), but the response was serialized ahead of time.
+ * Nothing is allocated or validated. The message points into the static response, which must outlive it. */
+AWS_HTTP_API
+void aws_h1_encoder_message_init_from_static_response(
+    struct aws_h1_encoder_message *message,
+    const struct aws_http_static_response *response,
+    bool body_headers_ignored,
+    struct aws_linked_list *pending_chunk_list);
+
+/* Add a header to a message whose head hasn't been sent yet.
+ * The header must already be valid, it's written as-is. A message pointing into a static response gets a copy
+ * of its own. */
+AWS_HTTP_API
+void aws_h1_encoder_message_add_header(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor name,
+    struct aws_byte_cursor value);
+
+/* Add a "Connection: close" header to a message whose head hasn't been sent yet.
+ * A message pointing into a static response gets a copy of its own. */
+AWS_HTTP_API
+void aws_h1_encoder_message_add_connection_close(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator);
+
+/* Add an "Expect: 100-continue" header to a request whose head hasn't been sent yet,
+ * so the body is held back until the server responds with 100 (Continue). */
+AWS_HTTP_API
+void aws_h1_encoder_message_add_expect_continue(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator);
+
 AWS_HTTP_API
 void aws_h1_encoder_message_clean_up(struct aws_h1_encoder_message *message);
 
@@ -135,6 +254,45 @@ bool aws_h1_encoder_is_message_in_progress(const struct aws_h1_encoder *encoder)
 AWS_HTTP_API
 bool aws_h1_encoder_is_waiting_for_chunks(const struct aws_h1_encoder *encoder);
 
+/* Return true if the head of an "Expect: 100-continue" request is written, and its body is held back */
+AWS_HTTP_API
+bool aws_h1_encoder_is_waiting_for_continue(const struct aws_h1_encoder *encoder);
+
+/* Stop holding back the body of an "Expect: 100-continue" request.
+ * If `send_body` is false, the body is never sent and the message is done */
+AWS_HTTP_API
+void aws_h1_encoder_end_wait_for_continue(struct aws_h1_encoder *encoder, bool send_body);
+
+/**
+ * If the encoder has reached a zero-copy chunk's data, returns true and sets out_data.
+ * The caller must send out_data in its own aws_io_message,
+ * and not call aws_h1_encoder_process() again until that message has completed.
+ * The chunk's completion callback is moved to out_on_complete and out_user_data:
+ * the caller is responsible for invoking it once the channel is done with the memory.
+ */
+AWS_HTTP_API
+bool aws_h1_encoder_take_zero_copy_data(
+    struct aws_h1_encoder *encoder,
+    struct aws_byte_cursor *out_data,
+    aws_http1_stream_write_chunk_complete_fn **out_on_complete,
+    void **out_user_data);
+
+/**
+ * If the encoder has reached a body that should be sent straight from a file (see `sends_file_bodies_directly`),
+ * returns true and sets the range of the file that remains to be sent.
+ * The caller reports each part it sends with aws_h1_encoder_on_file_body_sent().
+ */
+AWS_HTTP_API
+bool aws_h1_encoder_get_file_body(
+    const struct aws_h1_encoder *encoder,
+    int *out_fd,
+    uint64_t *out_offset,
+    uint64_t *out_remaining);
+
+/* Part of the file body was sent. The message is done once all of it has been sent. */
+AWS_HTTP_API
+void aws_h1_encoder_on_file_body_sent(struct aws_h1_encoder *encoder, uint64_t bytes);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_HTTP_H1_ENCODER_H */
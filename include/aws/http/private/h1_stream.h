@@ -8,6 +8,7 @@
 #include <aws/http/private/h1_encoder.h>
 #include <aws/http/private/http_impl.h>
 #include <aws/http/private/request_response_impl.h>
+#include <aws/http/private/timer_wheel.h>
 #include <aws/io/channel.h>
 
 #ifdef _MSC_VER
@@ -40,6 +41,11 @@ struct aws_h1_stream {
      */
     struct aws_channel_task cross_thread_work_task;
 
+    /* enum aws_h1_stream_api_state. Any thread may read it.
+     * INIT->ACTIVE is claimed with a compare-exchange by aws_h1_stream_activate(), without the lock.
+     * All other writes hold the connection's lock, so they stay consistent with `synced_data`. */
+    struct aws_atomic_var api_state;
+
     /* Message (derived from outgoing request or response) to be submitted to encoder */
     struct aws_h1_encoder_message encoder_message;
 
@@ -52,9 +58,36 @@ struct aws_h1_stream {
      * See RFC-7230 Section 6: Connection Management. */
     bool is_final_stream;
 
+    /* Client-only. Whether the request may be pipelined when the connection limits it */
+    bool is_idempotent;
+
+    /* Client-only. Armed in the event-loop's shared timer wheel, which is cheaper than a task per stream.
+     * We only touch these from the connection's thread.
+     * These live here rather than in the common stream data, since HTTP/2 streams don't use them */
+    struct aws_http_timer response_first_byte_timer;
+    struct aws_http_timer request_timer;
+    /* Armed while the body is held back waiting for 100 (Continue) */
+    struct aws_http_timer expect_continue_timer;
+
+    /* Server-only. Whether the stream counts against the server's admission control until it completes */
+    bool is_admission_counted;
+
+    /* Server-only. Set if encoder_message points into a static response, which must outlive it */
+    struct aws_http_static_response *static_response;
+
     /* Buffer for incoming data that needs to stick around. */
     struct aws_byte_buf incoming_storage_buf;
 
+    /* Client-only. new_decoder is NULL unless the response body should be decoded */
+    struct aws_http_content_decoding_options content_decoding;
+
+    /* Content-Encoding values from the main header block, collected until the block is done */
+    struct aws_byte_buf incoming_content_coding;
+
+    /* Decodes the incoming body. NULL if the body is passed along as-is */
+    struct aws_http_content_decoder *content_decoder;
+    bool has_content_decoder_input;
+
     struct {
         /* TODO: move most other members in here */
 
@@ -68,6 +101,10 @@ struct aws_h1_stream {
          * Only body data (not headers, etc) counts against the stream's flow-control window. */
         uint64_t stream_window;
 
+        /* Decoded body delivered beyond the stream's window, deducted from later window updates.
+         * See aws_http_content_decoding_options */
+        uint64_t stream_window_debt;
+
         /* Whether a "request handler" stream has a response to send.
          * Has mirror variable in synced_data */
         bool has_outgoing_response : 1;
@@ -85,8 +122,6 @@ struct aws_h1_stream {
          * but haven't yet moved to encoder_message where the encoder will find them. */
         struct aws_h1_trailer *pending_trailer;
 
-        enum aws_h1_stream_api_state api_state;
-
         /* Sum of all aws_http_stream_update_window() calls that haven't yet moved to thread_data.stream_window */
         uint64_t pending_window_update;
 
@@ -120,5 +155,6 @@ int aws_h1_stream_activate(struct aws_http_stream *stream);
 void aws_h1_stream_cancel(struct aws_http_stream *stream, int error_code);
 
 int aws_h1_stream_send_response(struct aws_h1_stream *stream, struct aws_http_message *response);
+int aws_h1_stream_send_static_response(struct aws_h1_stream *stream, struct aws_http_static_response *response);
 
 #endif /* AWS_HTTP_H1_STREAM_H */
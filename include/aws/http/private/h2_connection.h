@@ -13,11 +13,34 @@
 
 #include <aws/http/private/connection_impl.h>
 #include <aws/http/private/h2_frames.h>
+#include <aws/http/private/timer_wheel.h>
 #include <aws/http/statistics.h>
 
 struct aws_h2_decoder;
 struct aws_h2_stream;
 
+/* Open-addressed table of active streams, indexed by stream-id.
+ * A connection's stream-ids increase as streams are created, and only a bounded number are active at once,
+ * so a stream's home slot (id / 2) rarely collides with another active stream, and lookup is usually one probe. */
+struct aws_h2_active_streams {
+    /* Each slot is NULL, an aws_h2_stream*, or a marker left by a removed stream. Count is a power of 2 */
+    struct aws_h2_stream **slots;
+    size_t capacity;
+    size_t count;
+    /* Slots holding a removed-marker. These are cleared when the table is rebuilt */
+    size_t removed_count;
+};
+
+/* Limits how often something may happen: each time spends a token, and tokens refill at a steady rate */
+struct aws_h2_token_bucket {
+    /* Tokens are counted in billionths, so a refill after any number of nanoseconds is exact */
+    uint64_t nano_tokens;
+    uint64_t max_nano_tokens;
+    /* UINT32_MAX means there's no limit */
+    uint32_t tokens_per_second;
+    uint64_t last_refill_ns;
+};
+
 struct aws_h2_connection {
     struct aws_http_connection base;
 
@@ -26,25 +49,58 @@ struct aws_h2_connection {
 
     struct aws_channel_task cross_thread_work_task;
     struct aws_channel_task outgoing_frames_task;
+    /* Sends the held write batch once its deadline passes */
+    struct aws_channel_task write_batch_task;
 
     bool conn_manual_window_management;
 
+    /* See aws_http2_connection_options.window_update_threshold_percent. 0 means WINDOW_UPDATEs aren't coalesced */
+    uint32_t window_update_threshold_percent;
+
+    /* See aws_http2_connection_options.bdp_max_window_size. 0 means stream windows aren't tuned */
+    uint32_t bdp_max_window_size;
+
+    /* See aws_http2_connection_options.write_batch_target_size. 0 means outgoing frames aren't batched */
+    size_t write_batch_target_size;
+    uint64_t write_batch_max_delay_ns;
+
+    /* See aws_http2_connection_options.lean_hpack_idle_ms. 0 means HPACK memory is never trimmed */
+    uint64_t lean_hpack_idle_ms;
+
     /* Only the event-loop thread may touch this data */
     struct {
         struct aws_h2_decoder *decoder;
         struct aws_h2_frame_encoder encoder;
 
+        /* Small-block allocator for the frames built on this thread (control frames, HEADERS), so their memory is
+         * recycled instead of coming from the heap each time. Not thread-safe: frames created on other threads use
+         * base.alloc. */
+        struct aws_allocator *frame_allocator;
+
         /* True when reading/writing has stopped, whether due to errors or normal channel shutdown. */
         bool is_reading_stopped;
         bool is_writing_stopped;
 
         bool is_outgoing_frames_task_active;
 
+        /* Partially filled message the outgoing frames task is holding so more frames can join it.
+         * Only used with write batching. */
+        struct aws_io_message *write_batch_msg;
+        /* When write_batch_msg must be sent, even if it isn't full */
+        uint64_t write_batch_deadline_ns;
+        /* True once the message being filled holds a control frame the peer may be waiting on (PING, SETTINGS,
+         * RST_STREAM, GOAWAY). Such a message is never held. */
+        bool write_batch_has_urgent_frame;
+        bool is_write_batch_task_scheduled;
+
         /* Settings received from peer, which restricts the message to send */
         uint32_t settings_peer[AWS_HTTP2_SETTINGS_END_RANGE];
         /* Local settings to send/sent to peer, which affects the decoding */
         uint32_t settings_self[AWS_HTTP2_SETTINGS_END_RANGE];
 
+        /* True once peer sends SETTINGS_ENABLE_CONNECT_PROTOCOL=1, allowing extended CONNECT (RFC-8441) */
+        bool peer_enables_connect_protocol;
+
         /* List using aws_h2_pending_settings.node
          * Contains settings waiting to be ACKed by peer and applied */
         struct aws_linked_list pending_settings_queue;
@@ -59,11 +115,11 @@ struct aws_h2_connection {
         /* Maps stream-id to aws_h2_stream*.
          * Contains all streams in the open, reserved, and half-closed states (terms from RFC-7540 5.1).
          * Once a stream enters closed state, it is removed from this map. */
-        struct aws_hash_table active_streams_map;
+        struct aws_h2_active_streams active_streams;
 
         /* List using aws_h2_stream.node.
          * Contains all streams with DATA frames to send.
-         * Any stream in this list is also in the active_streams_map. */
+         * Any stream in this list is also in active_streams. */
         struct aws_linked_list outgoing_streams_list;
 
         /* List using aws_h2_stream.node.
@@ -99,6 +155,20 @@ struct aws_h2_connection {
          * connection */
         size_t window_size_self;
 
+        /* Increment for window_size_self that's been granted, but whose WINDOW_UPDATE hasn't been sent yet.
+         * Only non-zero when WINDOW_UPDATEs are coalesced */
+        size_t window_update_pending;
+
+        /* Bandwidth-delay product estimation, used to grow SETTINGS_INITIAL_WINDOW_SIZE */
+        struct {
+            /* True while the PING measuring the current sample waits for its ACK */
+            bool ping_in_flight;
+            /* DATA bytes received since that PING was sent */
+            uint64_t sample_bytes;
+            /* Largest SETTINGS_INITIAL_WINDOW_SIZE sent for tuning. 0 if none sent yet */
+            uint32_t window_size;
+        } bdp;
+
         /* Highest self-initiated stream-id that peer might have processed.
          * Defaults to max stream-id, may be lowered when GOAWAY frame received. */
         uint32_t goaway_received_last_stream_id;
@@ -118,6 +188,9 @@ struct aws_h2_connection {
         bool channel_shutdown_immediately;
         bool channel_shutdown_waiting_for_goaway_to_be_written;
 
+        /* Set by aws_http_connection_drain(). The connection closes once no streams are active */
+        bool is_draining;
+
         /* TODO: Consider adding stream monitor */
         struct aws_crt_statistics_http2_channel stats;
 
@@ -126,6 +199,16 @@ struct aws_h2_connection {
         /* Timestamp when connection has data to receive, which is when there is an active stream */
         uint64_t incoming_timestamp_ns;
 
+        /* Token buckets limiting how fast the peer may send RST_STREAM, and PING or SETTINGS.
+         * See aws_http2_connection_options.max_stream_resets_per_second */
+        struct aws_h2_token_bucket stream_reset_bucket;
+        struct aws_h2_token_bucket control_frame_bucket;
+
+        /* Armed while no streams are active, with lean_hpack_idle_ms */
+        struct aws_http_timer hpack_idle_timer;
+        /* Last value published to synced_data.hpack_memory_usage */
+        size_t hpack_memory_usage;
+
     } thread_data;
 
     /* Any thread may touch this data, but the lock must be held (unless it's an atomic) */
@@ -176,6 +259,9 @@ struct aws_h2_connection {
         uint32_t settings_peer[AWS_HTTP2_SETTINGS_END_RANGE];
         /* For checking local settings to send/sent to peer from outside the event-loop thread. */
         uint32_t settings_self[AWS_HTTP2_SETTINGS_END_RANGE];
+
+        /* (atomic) size_t of HPACK bytes allocated, for checking from outside the event-loop thread */
+        struct aws_atomic_var hpack_memory_usage;
     } synced_data;
 };
 
@@ -221,6 +307,7 @@ enum aws_h2_data_encode_status {
     AWS_H2_DATA_ENCODE_ONGOING_BODY_STREAM_STALLED, /* stalled reading from body stream */
     AWS_H2_DATA_ENCODE_ONGOING_WAITING_FOR_WRITES,  /* waiting for next manual write */
     AWS_H2_DATA_ENCODE_ONGOING_WINDOW_STALLED,      /* stalled due to reduced window size */
+    AWS_H2_DATA_ENCODE_ONGOING_WAITING_FOR_BODY,    /* waiting on an async body stream's read */
 };
 
 /* When window size is too small to fit the possible padding into it, we stop sending data and wait for WINDOW_UPDATE */
@@ -254,6 +341,15 @@ AWS_EXTERN_C_END
  */
 void aws_h2_connection_enqueue_outgoing_frame(struct aws_h2_connection *connection, struct aws_h2_frame *frame);
 
+/**
+ * Returns whether a coalesced WINDOW_UPDATE should be sent now,
+ * given a flow-control window's remaining size and the increment waiting to be sent for it.
+ */
+bool aws_h2_connection_should_send_window_update(
+    const struct aws_h2_connection *connection,
+    int64_t window_size_self,
+    size_t window_update_pending);
+
 /**
  * Invoked immediately after a stream enters the CLOSED state.
  * The connection will remove the stream from its "active" datastructures,
@@ -287,4 +383,19 @@ void aws_h2_connection_shutdown_due_to_write_err(struct aws_h2_connection *conne
  */
 void aws_h2_try_write_outgoing_frames(struct aws_h2_connection *connection);
 
+/* How loaded a connection is, for picking between connections */
+struct aws_h2_connection_load {
+    /* Room left in the peer's connection flow-control window */
+    size_t window_size_peer;
+    /* Streams waiting on the peer's connection window */
+    uint32_t stalled_stream_count;
+    /* From PING round trips. 0 until the first one completes */
+    uint64_t smoothed_rtt_ns;
+};
+
+/**
+ * Sample the connection's load. Only called within the eventloop thread
+ */
+void aws_h2_connection_get_load(struct aws_http_connection *http2_connection, struct aws_h2_connection_load *out_load);
+
 #endif /* AWS_HTTP_H2_CONNECTION_H */
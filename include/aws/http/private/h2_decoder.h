@@ -37,6 +37,17 @@ struct aws_h2_decoder_vtable {
     struct aws_h2err (
         *on_headers_end)(uint32_t stream_id, bool malformed, enum aws_http_header_block block_type, void *userdata);
 
+    /* Optional. If set, a HEADERS header-block's fields are collected and delivered all at once, right before
+     * _end(), instead of via _i() calls. name_enums[i] is the aws_http_header_name of headers[i].
+     * Not called if the header-block is malformed. The arrays are only valid for the duration of the call. */
+    struct aws_h2err (*on_headers_batch)(
+        uint32_t stream_id,
+        const struct aws_http_header *headers,
+        const enum aws_http_header_name *name_enums,
+        size_t num_headers,
+        enum aws_http_header_block block_type,
+        void *userdata);
+
     /* For PUSH_PROMISE header-block: _begin() is called, then 0+ _i() calls, then _end().
      * No other decoder callbacks will occur in this time.
      * If something is malformed, no further _i() calls occur, and it is reported in _end() */
@@ -116,6 +127,18 @@ AWS_HTTP_API void aws_h2_decoder_set_setting_header_table_size(struct aws_h2_dec
 AWS_HTTP_API void aws_h2_decoder_set_setting_enable_push(struct aws_h2_decoder *decoder, uint32_t data);
 AWS_HTTP_API void aws_h2_decoder_set_setting_max_frame_size(struct aws_h2_decoder *decoder, uint32_t data);
 
+/* Size of the header-block in progress, as HPACK-encoded, and as the sum of its names and values.
+ * Valid through on_headers_end() and on_push_promise_end() */
+AWS_HTTP_API uint64_t aws_h2_decoder_get_header_block_encoded_len(const struct aws_h2_decoder *decoder);
+AWS_HTTP_API uint64_t aws_h2_decoder_get_header_block_plain_len(const struct aws_h2_decoder *decoder);
+
+/* Bytes allocated for HPACK decoding */
+AWS_HTTP_API size_t aws_h2_decoder_get_hpack_memory_usage(const struct aws_h2_decoder *decoder);
+
+/* Release HPACK memory the decoder doesn't currently need, see aws_hpack_decoder_trim().
+ * Does nothing while a header-block is in progress */
+AWS_HTTP_API int aws_h2_decoder_trim_hpack(struct aws_h2_decoder *decoder);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_HTTP_H2_DECODER_H */
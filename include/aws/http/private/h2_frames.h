@@ -112,6 +112,14 @@ struct aws_h2_frame_encoder {
     struct aws_hpack_encoder hpack;
     struct aws_h2_frame *current_frame;
 
+    /* HEADERS and PUSH_PROMISE frames encode their header-block straight into the output,
+     * except for any header that might not fit in the current frame. That's encoded here, and spills into the next.
+     * Only one frame is encoded at a time, so it's reused, growing to the largest such header seen. */
+    struct aws_byte_buf header_block_buf;
+
+    /* Length of the most recently completed header-block */
+    size_t header_block_len;
+
     /* Settings for frame encoder, which is based on the settings received from peer */
     struct {
         /*  the size of the largest frame payload */
@@ -225,6 +233,26 @@ int aws_h2_encode_data_frame(
     bool *body_complete,
     bool *body_stalled);
 
+/**
+ * Attempt to encode the prefix of a DATA frame into the output buffer,
+ * whose payload is a slice of `body` that the caller will send immediately after output, without copying.
+ * The slice is as large as MAX_FRAME_SIZE and the flow-control windows allow.
+ * out_payload is set to the slice, and `body` is advanced past it.
+ * If there isn't space for a frame prefix, nothing is encoded and out_payload is empty.
+ * body_complete will be set true if the frame uses the last of `body`.
+ */
+AWS_HTTP_API
+int aws_h2_encode_zero_copy_data_frame(
+    struct aws_h2_frame_encoder *encoder,
+    uint32_t stream_id,
+    struct aws_byte_cursor *body,
+    bool body_ends_stream,
+    int32_t *stream_window_size_peer,
+    size_t *connection_window_size_peer,
+    struct aws_byte_buf *output,
+    struct aws_byte_cursor *out_payload,
+    bool *body_complete);
+
 AWS_HTTP_API
 void aws_h2_frame_destroy(struct aws_h2_frame *frame);
 
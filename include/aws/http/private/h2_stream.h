@@ -64,10 +64,18 @@ enum aws_h2_stream_body_state {
 /* represents a write operation, which will be turned into a data frame */
 struct aws_h2_stream_data_write {
     struct aws_linked_list_node node;
+    /* NULL if this is a zero-copy write */
     struct aws_input_stream *data_stream;
+    /* Caller-owned memory that hasn't been encoded yet (zero-copy writes only) */
+    struct aws_byte_cursor zero_copy_data;
+    /* Slice of zero_copy_data that the channel is still holding. Cleared when the channel is done with it */
+    struct aws_byte_cursor zero_copy_in_flight;
     aws_http2_stream_write_data_complete_fn *on_complete;
     void *user_data;
     bool end_stream;
+    /* If the write finishes while a slice is in flight, destruction waits until the channel is done with it */
+    bool destroy_pending;
+    int destroy_error_code;
 };
 
 struct aws_h2_stream {
@@ -80,10 +88,16 @@ struct aws_h2_stream {
     struct {
         enum aws_h2_stream_state state;
         int32_t window_size_peer;
+        /* When the stream stalled waiting for the peer's window to open, 0 if it isn't stalled */
+        uint64_t window_stalled_timestamp_ns;
         /* The local window size.
          * We allow this value exceed the max window size (int64 can hold much more than 0x7FFFFFFF),
          * We leave it up to the remote peer to detect whether the max window size has been exceeded. */
         int64_t window_size_self;
+        /* Increment for window_size_self that's been granted, but whose WINDOW_UPDATE hasn't been sent yet.
+         * Only non-zero when the connection coalesces WINDOW_UPDATEs. Dropped if the stream closes. */
+        size_t window_update_pending;
+        /* Released once the HEADERS frame is created, NULL after that */
         struct aws_http_message *outgoing_message;
         /* All queued writes. If the message provides a body stream, it will be first in this list
          * This list can drain, which results in the stream being put to sleep (moved to waiting_streams_list in
@@ -100,6 +114,9 @@ struct aws_h2_stream {
          * asleep. When stream needs to be awaken, moving the stream back to the outgoing_streams_list and set this bool
          * to false */
         bool waiting_for_writes;
+        /* Indicates that the stream is in the waiting_streams_list until its async body stream's read completes.
+         * The stream holds a reference on itself while this is set */
+        bool waiting_for_body;
     } thread_data;
 
     /* Any thread may touch this data, but the lock must be held (unless it's an atomic) */
@@ -125,6 +142,9 @@ struct aws_h2_stream {
     } synced_data;
     bool manual_write;
 
+    /* Controls when the connection sends this stream's DATA, relative to other streams. Doesn't change. */
+    struct aws_http2_stream_priority priority;
+
     /* Store the sent reset HTTP/2 error code, set to -1, if none has sent so far */
     int64_t sent_reset_error_code;
 
@@ -151,12 +171,23 @@ void aws_h2_stream_complete(struct aws_h2_stream *stream, int error_code);
 /* Connection is ready to send data from stream now.
  * Stream may complete itself during this call.
  * data_encode_status: see `aws_h2_data_encode_status`
+ * out_zero_copy_write: set if a zero-copy DATA frame's prefix was encoded at the end of output.
+ * The connection must send the write's `zero_copy_in_flight` right after output,
+ * then call aws_h2_stream_on_zero_copy_data_written() once the channel is done with it.
+ * The stream holds a reference on itself until then.
  */
 int aws_h2_stream_encode_data_frame(
     struct aws_h2_stream *stream,
     struct aws_h2_frame_encoder *encoder,
     struct aws_byte_buf *output,
-    int *data_encode_status);
+    int *data_encode_status,
+    struct aws_h2_stream_data_write **out_zero_copy_write);
+
+/* The channel is done with a zero-copy write's in-flight slice. The stream may be destroyed during this call. */
+void aws_h2_stream_on_zero_copy_data_written(
+    struct aws_h2_stream *stream,
+    struct aws_h2_stream_data_write *write,
+    int error_code);
 
 struct aws_h2err aws_h2_stream_on_decoder_headers_begin(struct aws_h2_stream *stream);
 
@@ -166,6 +197,14 @@ struct aws_h2err aws_h2_stream_on_decoder_headers_i(
     enum aws_http_header_name name_enum,
     enum aws_http_header_block block_type);
 
+/* All header-fields of a header-block at once, in place of aws_h2_stream_on_decoder_headers_i() calls */
+struct aws_h2err aws_h2_stream_on_decoder_headers_batch(
+    struct aws_h2_stream *stream,
+    const struct aws_http_header *headers,
+    const enum aws_http_header_name *name_enums,
+    size_t num_headers,
+    enum aws_http_header_block block_type);
+
 struct aws_h2err aws_h2_stream_on_decoder_headers_end(
     struct aws_h2_stream *stream,
     bool malformed,
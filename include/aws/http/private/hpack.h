@@ -49,6 +49,8 @@ enum aws_hpack_huffman_mode {
  * Maintains the dynamic table.
  * Insertion is backwards, indexing is forwards
  */
+struct aws_hpack_dynamic_table_entry;
+
 struct aws_hpack_context {
     struct aws_allocator *allocator;
 
@@ -56,28 +58,80 @@ struct aws_hpack_context {
     const void *log_id;
 
     struct {
-        /* Array of headers, pointers to memory we alloced, which needs to be cleaned up whenever we move an entry out
-         */
-        struct aws_http_header *buffer;
-        size_t buffer_capacity; /* Number of http_headers that can fit in buffer */
+        /* Ring of entries, see notes in hpack.c. Entries, buckets, and strings are all in one allocation */
+        struct aws_hpack_dynamic_table_entry *entries;
+        size_t entries_capacity;
+
+        /* Ring of bytes that entry names and values are stored in */
+        uint8_t *strings;
+        size_t strings_capacity;
+        size_t strings_head;  /* where the next entry's strings go */
+        bool strings_wrapped; /* true if newer strings have wrapped around before older strings */
+
+        /* Reverse lookup. Each bucket has the seq of the newest entry with that hash (0 if none) */
+        uint64_t *buckets_name_only;
+        uint64_t *buckets_name_and_value;
+        size_t bucket_count; /* power of 2 */
 
         size_t num_elements;
-        size_t index_0;
+        uint64_t newest_seq; /* seq of entry at index 0. Seqs start at 1 */
 
         /* Size in bytes, according to [4.1] */
         size_t size;
         size_t max_size;
-
-        /* aws_http_header * -> size_t */
-        struct aws_hash_table reverse_lookup;
-        /* aws_byte_cursor * -> size_t */
-        struct aws_hash_table reverse_lookup_name_only;
     } dynamic_table;
 };
 
+/* Number of recently encoded string literals each encoder remembers */
+#define AWS_HPACK_ENCODER_STRING_CACHE_SIZE 16
+
+/* String literals longer than this are not cached */
+#define AWS_HPACK_ENCODER_STRING_CACHE_MAX_LITERAL_LEN 1024
+
+/**
+ * A string literal, and its complete encoding (length prefix and data) under the current Huffman mode.
+ */
+struct aws_hpack_encoder_string_cache_entry {
+    uint64_t hash;
+    /* When this was last used, according to the cache's clock. 0 if the entry is empty */
+    uint64_t last_used;
+    size_t literal_len;
+    /* Literal bytes, immediately followed by their encoding */
+    struct aws_byte_buf storage;
+};
+
 /**
  * Encodes outgoing headers.
  */
+/* Number of header names each encoder keeps value statistics for, to pick how they're indexed */
+#define AWS_HPACK_ENCODER_NAME_STATS_SIZE 32
+
+/* Number of recent values remembered per name, to tell whether a value is a repeat */
+#define AWS_HPACK_ENCODER_NAME_STATS_RECENT_VALUES 4
+
+/* A name is judged once it's been encoded this many times */
+#define AWS_HPACK_ENCODER_NAME_STATS_MIN_SAMPLES 8
+
+/* Counts are halved once samples reach this, so names that settle down get indexed again */
+#define AWS_HPACK_ENCODER_NAME_STATS_MAX_SAMPLES 64
+
+/**
+ * How often a header name's values repeat. Names whose values rarely repeat (request IDs, dates, signatures)
+ * aren't worth a dynamic table entry, since inserting them just evicts entries that would be reused.
+ * Names are only compared by hash and length. A collision merely skews the statistics.
+ */
+struct aws_hpack_encoder_name_stats {
+    uint64_t name_hash;
+    size_t name_len;
+    /* When this was last used, according to the encoder's name_stats clock. 0 if the entry is empty */
+    uint64_t last_used;
+    uint64_t recent_value_hashes[AWS_HPACK_ENCODER_NAME_STATS_RECENT_VALUES];
+    /* Number of distinct values ever recorded. The newest goes at this index, mod the array size */
+    size_t num_recent_values;
+    uint32_t samples;
+    uint32_t repeats;
+};
+
 struct aws_hpack_encoder {
     const void *log_id;
 
@@ -86,6 +140,20 @@ struct aws_hpack_encoder {
 
     struct aws_hpack_context context;
 
+    /* LRU cache of recently encoded literals, so that repeated values (user-agent, x-amz-*, etc)
+     * that aren't in the dynamic table can be written with 1 memcpy */
+    struct {
+        struct aws_hpack_encoder_string_cache_entry entries[AWS_HPACK_ENCODER_STRING_CACHE_SIZE];
+        uint64_t clock;
+    } string_cache;
+
+    /* Value statistics of recently encoded header names, for adaptive indexing */
+    struct {
+        struct aws_hpack_encoder_name_stats entries[AWS_HPACK_ENCODER_NAME_STATS_SIZE];
+        uint64_t clock;
+        bool disabled;
+    } name_stats;
+
     struct {
         size_t latest_value;
         size_t smallest_value;
@@ -99,8 +167,6 @@ struct aws_hpack_encoder {
 struct aws_hpack_decoder {
     const void *log_id;
 
-    struct aws_huffman_decoder huffman_decoder;
-
     struct aws_hpack_context context;
 
     /* TODO: check the new (RFC 9113 - 4.3.1) to make sure we did it right */
@@ -123,6 +189,9 @@ struct aws_hpack_decoder {
             HPACK_STRING_STATE_VALUE,
         } state;
         bool use_huffman;
+        /* Huffman decoding state machine, see hpack_decoder.c */
+        uint8_t huffman_state;
+        uint8_t huffman_flags;
         uint64_t length;
     } progress_string;
 
@@ -181,6 +250,17 @@ void aws_hpack_context_init(
 AWS_HTTP_API
 void aws_hpack_context_clean_up(struct aws_hpack_context *context);
 
+/* Returns the bytes allocated for the dynamic table. 0 until the first insert */
+AWS_HTTP_API
+size_t aws_hpack_context_get_memory_usage(const struct aws_hpack_context *context);
+
+/**
+ * Shrink the dynamic table's storage to fit its current entries, freeing it entirely if there are none.
+ * Entries are kept, and storage grows back on demand.
+ */
+AWS_HTTP_API
+int aws_hpack_context_compact(struct aws_hpack_context *context);
+
 /* Returns the hpack size of a header (name.len + value.len + 32) [4.1] */
 AWS_HTTP_API
 size_t aws_hpack_get_header_size(const struct aws_http_header *header);
@@ -226,6 +306,29 @@ void aws_hpack_encoder_update_max_table_size(struct aws_hpack_encoder *encoder,
 AWS_HTTP_API
 void aws_hpack_encoder_set_huffman_mode(struct aws_hpack_encoder *encoder, enum aws_hpack_huffman_mode mode);
 
+/**
+ * Bytes allocated by the encoder: its dynamic table, and the string cache.
+ */
+AWS_HTTP_API
+size_t aws_hpack_encoder_get_memory_usage(const struct aws_hpack_encoder *encoder);
+
+/**
+ * Empty the encoder's dynamic table and free what it and the string cache had allocated.
+ * The peer is told with a Dynamic Table Size Update at the start of the next header-block,
+ * which shrinks the table to 0 and restores its current max size [RFC-7541 4.2].
+ * Call between header-blocks.
+ */
+AWS_HTTP_API
+int aws_hpack_encoder_trim(struct aws_hpack_encoder *encoder);
+
+/**
+ * Adaptive indexing is on by default. Headers that ask to be cached (AWS_HTTP_HEADER_COMPRESSION_USE_CACHE),
+ * but whose name rarely repeats a value, are encoded "without indexing" rather than inserted into the dynamic table.
+ * Turn it off to index every such header, as RFC-7541 Appendix C does.
+ */
+AWS_HTTP_API
+void aws_hpack_encoder_set_adaptive_indexing(struct aws_hpack_encoder *encoder, bool enabled);
+
 /**
  * Encode header-block into the output.
  * This function will mutate hpack, so an error means hpack can no longer be used.
@@ -237,6 +340,29 @@ int aws_hpack_encode_header_block(
     const struct aws_http_headers *headers,
     struct aws_byte_buf *output);
 
+/**
+ * The pieces of aws_hpack_encode_header_block(), for callers that spread one header-block across several buffers.
+ * Start with aws_hpack_encode_header_block_start(), which encodes any pending Dynamic Table Size Updates,
+ * then encode each header in order with aws_hpack_encode_header().
+ * These mutate hpack too, so an error means hpack can no longer be used.
+ * Output is dynamically resized if it's too short.
+ */
+AWS_HTTP_API
+int aws_hpack_encode_header_block_start(struct aws_hpack_encoder *encoder, struct aws_byte_buf *output);
+
+AWS_HTTP_API
+int aws_hpack_encode_header(
+    struct aws_hpack_encoder *encoder,
+    const struct aws_http_header *header,
+    struct aws_byte_buf *output);
+
+/**
+ * The most bytes aws_hpack_encode_header() could write for this header, however it ends up encoded.
+ * If a fixed-size output has this much room, the header is sure to fit without resizing.
+ */
+AWS_HTTP_API
+size_t aws_hpack_get_encoded_header_length_upper_bound(const struct aws_http_header *header);
+
 AWS_HTTP_API
 void aws_hpack_decoder_init(struct aws_hpack_decoder *decoder, struct aws_allocator *allocator, const void *log_id);
 
@@ -249,6 +375,19 @@ void aws_hpack_decoder_clean_up(struct aws_hpack_decoder *decoder);
 AWS_HTTP_API
 void aws_hpack_decoder_update_max_table_size(struct aws_hpack_decoder *decoder, uint32_t new_max_size);
 
+/**
+ * Bytes allocated by the decoder: its dynamic table, and scratch space for the entry being decoded.
+ */
+AWS_HTTP_API
+size_t aws_hpack_decoder_get_memory_usage(const struct aws_hpack_decoder *decoder);
+
+/**
+ * Shrink the decoder's storage to fit the dynamic table entries the peer may still refer to.
+ * The entries themselves are the peer's to evict. Call between header-blocks.
+ */
+AWS_HTTP_API
+int aws_hpack_decoder_trim(struct aws_hpack_decoder *decoder);
+
 /**
  * Decode the next entry in the header-block-fragment.
  * If result->type is ONGOING, then call decode() again with more data to resume decoding.
@@ -0,0 +1,47 @@
+#ifndef AWS_HTTP2_PREFACE_DETECTOR_H
+#define AWS_HTTP2_PREFACE_DETECTOR_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+struct aws_channel;
+
+/**
+ * Invoked once the first bytes from the client show which protocol it speaks.
+ * To keep the connection, install the HTTP connection at the end of the channel before returning,
+ * and the bytes received so far are passed along to it. Otherwise, shut down the channel.
+ */
+typedef void(aws_http2_preface_detector_on_detected_fn)(
+    struct aws_channel *channel,
+    enum aws_http_version version,
+    void *user_data);
+
+struct aws_http2_preface_detector_options {
+    struct aws_allocator *allocator;
+    struct aws_channel *channel;
+
+    /* Read window of the HTTP connection that will follow the detector */
+    size_t initial_window_size;
+
+    aws_http2_preface_detector_on_detected_fn *on_detected;
+    void *user_data;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Install a channel handler, at the end of a server channel, which holds incoming data until it can tell whether
+ * the client opened with the HTTP/2 connection preface (AWS_HTTP_VERSION_2) or not (AWS_HTTP_VERSION_1_1).
+ * Afterwards, it passes all data straight through.
+ * Must be called from the channel's thread.
+ */
+AWS_HTTP_API
+int aws_http2_preface_detector_install(const struct aws_http2_preface_detector_options *options);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP2_PREFACE_DETECTOR_H */
@@ -6,9 +6,11 @@
  * SPDX-License-Identifier: Apache-2.0.
  */
 
+#include <aws/common/array_list.h>
 #include <aws/common/mutex.h>
 #include <aws/common/ref_count.h>
 #include <aws/http/http2_stream_manager.h>
+#include <aws/http/private/h2_connection.h>
 #include <aws/http/private/random_access_set.h>
 
 enum aws_h2_sm_state_type {
@@ -22,6 +24,12 @@ enum aws_h2_sm_connection_state_type {
     AWS_H2SMCST_FULL,
 };
 
+/* A stream done with its connection, waiting for the connection's finish streams task */
+struct aws_h2_sm_finished_stream {
+    uint64_t latency_ns;
+    bool is_refused;
+};
+
 /* Live with the streams opening, and if there no outstanding pending acquisition and no opening streams on the
  * connection, this structure should die */
 struct aws_h2_sm_connection {
@@ -36,13 +44,73 @@ struct aws_h2_sm_connection {
     struct aws_ref_count ref_count;
     struct aws_channel_task ping_task;
     struct aws_channel_task ping_timeout_task;
+    /* Tells the stream manager about the streams finished on the connection, once a tick */
+    struct aws_channel_task finish_streams_task;
     struct {
         bool ping_received;
         bool stopped_new_requests;
         uint64_t next_ping_task_time;
+        /* struct aws_h2_sm_finished_stream, since the finish streams task last ran */
+        struct aws_array_list finished_streams;
+        bool finish_streams_task_scheduled;
     } thread_data;
 
     enum aws_h2_sm_connection_state_type state;
+    /* In ideal_available_set or nonideal_available_set, never both */
+    struct aws_intrusive_random_access_set_node available_node;
+
+    /* Sampled from the connection's thread for the selection policy, protected by the stream manager's lock */
+    struct aws_h2_connection_load load;
+    /* Sampled the same way, if the stream manager steers by health */
+    uint32_t health_score;
+
+    uint64_t created_timestamp;
+    /* Replacement, protected by the stream manager's lock.  Waits in connections_awaiting_successor for its
+     * successor, then retires from the available sets and drains */
+    struct aws_linked_list_node successor_node;
+    bool successor_requested;
+    bool is_retiring;
+
+    /* Protected by the stream manager's lock, see enable_adaptive_concurrency */
+    struct {
+        uint32_t ideal_streams;
+        uint64_t min_latency_ns;
+        /* A round lasts ideal_streams completions */
+        uint32_t round_completed_count;
+        /* The connection had ideal_streams streams assigned at some point in the round */
+        bool round_saturated;
+        /* The ideal number already went down in the round */
+        bool round_decreased;
+    } adaptive;
+};
+
+/* Completed stream latencies kept for hedging after the p95 */
+#define AWS_H2_SM_LATENCY_SAMPLES 64
+
+/**
+ * Shared by a hedged acquisition and the duplicate made for it, lives until both of them are gone.
+ * The first of the two streams to start responding wins, the other is reset.
+ */
+struct aws_h2_sm_hedge {
+    struct aws_allocator *allocator;
+    struct aws_http2_stream_manager *stream_manager;
+    struct aws_ref_count ref_count;
+    /* The user's options, with the request kept alive for the duplicate */
+    struct aws_http_make_request_options options;
+    struct aws_http_message *request;
+    uint64_t delay_ns;
+    bool after_p95_latency;
+    /* Scheduled on the primary stream's connection */
+    struct aws_channel_task hedge_task;
+
+    struct aws_mutex lock;
+    /* Protected by lock */
+    struct aws_h2_sm_pending_stream_acquisition *primary;
+    struct aws_h2_sm_pending_stream_acquisition *duplicate;
+    struct aws_h2_sm_pending_stream_acquisition *winner;
+    bool is_decided;
+    /* The user's on_destroy is owed once the primary stream was made */
+    bool stream_made;
 };
 
 /* Live from the user request to acquire a stream to the stream completed. */
@@ -57,6 +125,23 @@ struct aws_h2_sm_pending_stream_acquisition {
     struct aws_channel_task make_request_task;
     aws_http2_stream_manager_on_stream_acquired_fn *callback;
     void *user_data;
+    uint64_t acquire_timestamp;
+    uint64_t activate_timestamp;
+
+    /* NULL unless hedged */
+    struct aws_h2_sm_hedge *hedge;
+    /* A duplicate stays off the primary's connection */
+    const struct aws_h2_sm_connection *excluded_connection;
+    /* Protected by the hedge's lock. Set while the stream is active, so the winner can reset it */
+    struct aws_http_stream *hedge_stream;
+
+    /* Earlier attempts the server never processed, see max_unprocessed_stream_retries */
+    uint32_t retry_count;
+    /* A replay holds the stream the user got until its own stream is made. If it fails before then, that's the
+     * stream reported as completed */
+    struct aws_http_stream *replaced_stream;
+    /* Set once response headers arrive, the server is processing the stream then */
+    bool response_started;
 };
 
 /* connections_acquiring_count, open_stream_count, pending_make_requests_count AND pending_stream_acquisition_count */
@@ -107,6 +192,13 @@ struct aws_http2_stream_manager {
      * one connection reaches this number. But, if the max connections reaches, manager will reuse connections to create
      * the acquired steams as much as possible. */
     size_t ideal_concurrent_streams_per_connection;
+    bool enable_adaptive_concurrency;
+    enum aws_http2_stream_manager_selection_policy selection_policy;
+    uint32_t connection_replacement_stream_id;
+    uint64_t connection_replacement_age_ns;
+    /* From monitoring_options. Connections scoring below it are picked last, and replaced one at a time */
+    uint32_t degraded_health_score;
+    size_t max_unprocessed_stream_retries;
     /**
      * Default is no limit. 0 will be considered as using the default value.
      * The real number of concurrent streams per connection will be controlled by the minmal value of the setting from
@@ -131,15 +223,15 @@ struct aws_http2_stream_manager {
         /**
          * A set of all connections that meet all requirement to use. Note: there will be connections not in this set,
          * but hold by the stream manager, which can be tracked by the streams created on it. Set of `struct
-         * aws_h2_sm_connection *`
+         * aws_h2_sm_connection` by available_node
          */
-        struct aws_random_access_set ideal_available_set;
+        struct aws_intrusive_random_access_set ideal_available_set;
         /**
          * A set of all available connections that exceed the soft limits set by users. Note: there will be connections
          * not in this set, but hold by the stream manager, which can be tracked by the streams created. Set of `struct
-         * aws_h2_sm_connection *`
+         * aws_h2_sm_connection` by available_node
          */
-        struct aws_random_access_set nonideal_available_set;
+        struct aws_intrusive_random_access_set nonideal_available_set;
         /* We don't mantain set for connections that is full or "dead" (Cannot make any new streams). We have streams
          * opening from the connection tracking them */
 
@@ -154,6 +246,14 @@ struct aws_http2_stream_manager {
          */
         size_t holding_connections_count;
 
+        /**
+         * Connections past their replacement threshold, waiting on a successor, list of `struct
+         * aws_h2_sm_connection`.  Once the successor is acquired, the front of the list retires: it leaves the
+         * available sets, stops counting in holding_connections_count, and is released once its streams finish.
+         */
+        struct aws_linked_list connections_awaiting_successor;
+        size_t retiring_connections_count;
+
         /**
          * Counts that contributes to the internal refcount.
          * When the value changes, s_sm_count_increase/decrease_synced needed.
@@ -168,6 +268,17 @@ struct aws_http2_stream_manager {
         size_t internal_refcount_stats[AWS_SMCT_COUNT];
 
         bool finish_pending_stream_acquisitions_task_scheduled;
+
+        /* Time from stream acquisition to its request being made, see aws_http_manager_metrics */
+        struct aws_http_latency_histogram acquire_wait;
+
+        /* Ring of the most recent successful stream latencies, from activation to completion */
+        uint64_t recent_latencies_ns[AWS_H2_SM_LATENCY_SAMPLES];
+        size_t recent_latencies_count;
+        size_t recent_latencies_next;
+
+        /* The ideal number of streams a new connection starts from, if enable_adaptive_concurrency */
+        uint32_t adaptive_ideal_streams;
     } synced_data;
 };
 
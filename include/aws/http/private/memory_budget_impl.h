@@ -0,0 +1,85 @@
+#ifndef AWS_HTTP_MEMORY_BUDGET_IMPL_H
+#define AWS_HTTP_MEMORY_BUDGET_IMPL_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/memory_budget.h>
+
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
+#include <aws/common/ref_count.h>
+
+/**
+ * Invoked once bytes are given back to an exhausted budget.
+ * It's invoked with the budget's lock held, on whichever thread gave them back,
+ * so it must not call into the budget. Schedule a task to draw again instead.
+ */
+typedef void(aws_http_memory_budget_on_available_fn)(void *user_data);
+
+/**
+ * Someone waiting for bytes to be given back, see aws_http_memory_budget_draw().
+ * Owned by the waiter. It may only be waiting on one budget at a time.
+ */
+struct aws_http_memory_budget_waiter {
+    struct aws_linked_list_node node;
+    aws_http_memory_budget_on_available_fn *on_available;
+    void *user_data;
+};
+
+struct aws_http_memory_budget {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+    size_t limit;
+
+    /* Any thread may touch this data, but the lock must be held */
+    struct {
+        struct aws_mutex lock;
+        size_t used;
+        /* struct aws_http_memory_budget_waiter */
+        struct aws_linked_list waiters;
+    } synced_data;
+};
+
+AWS_EXTERN_C_BEGIN
+
+AWS_HTTP_API
+void aws_http_memory_budget_waiter_init(
+    struct aws_http_memory_budget_waiter *waiter,
+    aws_http_memory_budget_on_available_fn *on_available,
+    void *user_data);
+
+/**
+ * Draw up to `size` bytes from the budget. Returns how many were drawn, which is less than `size` if it's exhausted.
+ * If so, and `optional_waiter` is set, the waiter is invoked once some bytes are given back.
+ * Drawing and waiting happen together, so bytes given back in between aren't missed.
+ */
+AWS_HTTP_API
+size_t aws_http_memory_budget_draw(
+    struct aws_http_memory_budget *budget,
+    size_t size,
+    struct aws_http_memory_budget_waiter *optional_waiter);
+
+/**
+ * Give back bytes drawn earlier, and notify everyone waiting.
+ */
+AWS_HTTP_API
+void aws_http_memory_budget_give_back(struct aws_http_memory_budget *budget, size_t size);
+
+/**
+ * Stop waiting. Returns true if the waiter was still waiting,
+ * or false if it's already been invoked.
+ */
+AWS_HTTP_API
+bool aws_http_memory_budget_stop_waiting(
+    struct aws_http_memory_budget *budget,
+    struct aws_http_memory_budget_waiter *waiter);
+
+AWS_HTTP_API
+bool aws_http_memory_budget_is_exhausted(const struct aws_http_memory_budget *budget);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_MEMORY_BUDGET_IMPL_H */
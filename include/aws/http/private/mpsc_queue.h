@@ -0,0 +1,75 @@
+#ifndef AWS_HTTP_MPSC_QUEUE_H
+#define AWS_HTTP_MPSC_QUEUE_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/common/atomics.h>
+#include <aws/common/linked_list.h>
+#include <aws/http/http.h>
+
+/**
+ * Lock-free queue for handing work from any number of threads to a single consumer (ex: the event-loop thread).
+ *
+ * It's intrusive: items are linked through an aws_linked_list_node embedded in the item,
+ * and the consumer receives them as an ordinary aws_linked_list, in the order they were pushed.
+ * While an item is in the queue, only its node's `next` pointer is in use.
+ *
+ * The queue doubles as the consumer's "task scheduled" flag: a push that finds the queue empty
+ * reports it, and that producer (and only that producer) schedules the consumer's task.
+ * Once the task takes everything, the next push reports empty again.
+ *
+ * Once closed, pushes fail, so a producer learns that nobody will ever take its item.
+ */
+struct aws_http_mpsc_queue {
+    /* Most recently pushed node, NULL when empty, or a sentinel once closed */
+    struct aws_atomic_var head;
+};
+
+enum aws_http_mpsc_queue_push_result {
+    /* Pushed. The consumer's task was already due to run */
+    AWS_HTTP_MPSC_QUEUE_PUSHED,
+    /* Pushed into an empty queue. The caller must schedule the consumer's task */
+    AWS_HTTP_MPSC_QUEUE_PUSHED_FIRST,
+    /* Queue is closed, the node was not pushed */
+    AWS_HTTP_MPSC_QUEUE_CLOSED,
+};
+
+AWS_EXTERN_C_BEGIN
+
+AWS_HTTP_API
+void aws_http_mpsc_queue_init(struct aws_http_mpsc_queue *queue);
+
+/**
+ * Push a node. May be called from any thread.
+ */
+AWS_HTTP_API
+enum aws_http_mpsc_queue_push_result aws_http_mpsc_queue_push(
+    struct aws_http_mpsc_queue *queue,
+    struct aws_linked_list_node *node);
+
+/**
+ * Take every node pushed so far, appending them to `out_list` in the order they were pushed.
+ * Only the consumer may call this. Takes nothing once the queue is closed.
+ */
+AWS_HTTP_API
+void aws_http_mpsc_queue_take_all(struct aws_http_mpsc_queue *queue, struct aws_linked_list *out_list);
+
+/**
+ * Close the queue, so later pushes fail, and take whatever was still in it (see aws_http_mpsc_queue_take_all()).
+ * Only the consumer may call this. Closing again takes nothing.
+ */
+AWS_HTTP_API
+void aws_http_mpsc_queue_close(struct aws_http_mpsc_queue *queue, struct aws_linked_list *out_list);
+
+/**
+ * Whether nothing is waiting in the queue (it's empty or closed).
+ */
+AWS_HTTP_API
+bool aws_http_mpsc_queue_is_empty(const struct aws_http_mpsc_queue *queue);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_MPSC_QUEUE_H */
@@ -9,6 +9,7 @@
 #include <aws/http/http.h>
 
 #include <aws/common/hash_table.h>
+#include <aws/common/linked_list.h>
 #include <aws/http/connection.h>
 #include <aws/http/proxy.h>
 #include <aws/http/status_code.h>
@@ -17,6 +18,8 @@
 
 struct aws_http_connection_manager_options;
 struct aws_http_message;
+struct aws_http_stream;
+struct aws_http2_stream_manager;
 struct aws_channel_slot;
 struct aws_string;
 struct aws_tls_connection_options;
@@ -57,6 +60,8 @@ struct aws_http_proxy_config {
     struct aws_tls_connection_options *tls_options;
 
     struct aws_http_proxy_strategy *proxy_strategy;
+
+    struct aws_http2_stream_manager *http2_stream_manager;
 };
 
 /*
@@ -98,6 +103,8 @@ struct aws_http_proxy_user_data {
      */
     struct aws_string *original_host;
     uint32_t original_port;
+    /* Forwarding proxies only: "http://host:port", the prefix that makes request paths absolute-form */
+    struct aws_byte_buf forwarding_target_prefix;
     void *original_user_data;
     struct aws_tls_connection_options *original_tls_options;
     struct aws_client_bootstrap *original_bootstrap;
@@ -128,6 +135,28 @@ struct aws_http_proxy_user_data {
     struct aws_event_loop *requested_event_loop;
 
     const struct aws_host_resolution_config *host_resolution_config;
+
+    /* Only used when the tunnel is a CONNECT stream on an HTTP/2 connection to the proxy.
+     * The origin connection gets a channel of its own, where the leftmost handler
+     * passes data back and forth with the stream. See s_connect_via_http2_tunnel() */
+    struct {
+        struct aws_http_stream *stream;
+        struct aws_channel *channel;
+        struct aws_channel_slot *slot;
+
+        /* Stream DATA that the tunnel's channel hasn't taken yet */
+        struct aws_byte_buf pending_read_data;
+
+        /* aws_io_messages whose data is being written to the stream, in order */
+        struct aws_linked_list pending_writes;
+
+        bool is_stream_acquire_done;
+        bool is_stream_complete;
+        int stream_error_code;
+        bool got_success_response;
+        bool is_reading_stopped;
+        bool is_writing_stopped;
+    } http2;
 };
 
 /* vtable of functions that proxy uses to interact with external systems.
@@ -161,6 +190,16 @@ int aws_http_rewrite_uri_for_proxy_request(
 AWS_HTTP_API
 void aws_http_proxy_system_set_vtable(struct aws_http_proxy_system_vtable *vtable);
 
+/**
+ * Build the CONNECT request for a tunnel over HTTP/2 from the HTTP/1.1 one (after the proxy strategy has modified it).
+ * RFC-9113 8.5: only ":method" and ":authority" are sent, with no ":scheme" or ":path",
+ * and connection-specific headers are dropped.
+ */
+AWS_HTTP_API
+struct aws_http_message *aws_http_proxy_new_http2_connect_request(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *http1_connect_request);
+
 /**
  * Checks if tunneling proxy negotiation should continue to try and connect
  * @param proxy_negotiator negotiator to query
@@ -18,6 +18,35 @@ struct aws_random_access_set {
     struct aws_random_access_set_impl *impl;
 };
 
+struct aws_intrusive_random_access_set;
+
+/**
+ * Embed in the element to store it in an aws_intrusive_random_access_set, one node per set the element can be in.
+ * Zero-initialized, it's in no set. Get the element back with AWS_CONTAINER_OF.
+ */
+struct aws_intrusive_random_access_set_node {
+    struct aws_intrusive_random_access_set *owner;
+    size_t index;
+};
+
+/**
+ * Orders the elements of an aws_intrusive_random_access_set in min-heap mode.
+ * Returns true if a should be closer to the top than b.
+ */
+typedef bool(aws_intrusive_random_access_set_less_fn)(
+    const struct aws_intrusive_random_access_set_node *a,
+    const struct aws_intrusive_random_access_set_node *b);
+
+/**
+ * Variant of aws_random_access_set where each element stores its own index, so add, remove and random get need no
+ * hashing, and no allocation unless the array grows.
+ * In min-heap mode, the array is also kept as a heap, so the min is at hand in constant time.
+ */
+struct aws_intrusive_random_access_set {
+    struct aws_array_list list; /* Pointers of the nodes */
+    aws_intrusive_random_access_set_less_fn *less_fn;
+};
+
 AWS_EXTERN_C_BEGIN
 
 /**
@@ -82,5 +111,78 @@ int aws_random_access_set_exist(const struct aws_random_access_set *set, const v
 AWS_HTTP_API
 int aws_random_access_set_random_get_ptr_index(const struct aws_random_access_set *set, void **out, size_t index);
 
+/**
+ * Initialize the intrusive set.
+ *
+ * @param set                       Pointer of structure to initialize with
+ * @param allocator                 Allocator
+ * @param less_fn                   Optional. If set, the set is kept as a min-heap ordered by it
+ * @param initial_item_allocation   The initial number of item to allocate.
+ * @return AWS_OP_ERR if any fails to initialize, AWS_OP_SUCCESS on success.
+ */
+AWS_HTTP_API
+int aws_intrusive_random_access_set_init(
+    struct aws_intrusive_random_access_set *set,
+    struct aws_allocator *allocator,
+    aws_intrusive_random_access_set_less_fn *less_fn,
+    size_t initial_item_allocation);
+
+/**
+ * Clean up the set. The elements are left as they are, but their nodes are no longer in the set.
+ */
+AWS_HTTP_API
+void aws_intrusive_random_access_set_clean_up(struct aws_intrusive_random_access_set *set);
+
+/**
+ * Insert the node. added is false if it's in the set already. The node must not be in another set.
+ */
+AWS_HTTP_API
+int aws_intrusive_random_access_set_add(
+    struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node *node,
+    bool *added);
+
+/**
+ * Remove the node. If it's not in the set, nothing will happen.
+ */
+AWS_HTTP_API
+void aws_intrusive_random_access_set_remove(
+    struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node *node);
+
+AWS_HTTP_API
+bool aws_intrusive_random_access_set_exist(
+    const struct aws_intrusive_random_access_set *set,
+    const struct aws_intrusive_random_access_set_node *node);
+
+AWS_HTTP_API
+size_t aws_intrusive_random_access_set_get_size(const struct aws_intrusive_random_access_set *set);
+
+/**
+ * Get a random node. Fails when the set is empty.
+ */
+AWS_HTTP_API
+int aws_intrusive_random_access_set_random_get(
+    const struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node **out);
+
+/**
+ * Get the node currently stored at that index. It may change if operations like remove and add happens.
+ * In min-heap mode, index 0 is the min.
+ */
+AWS_HTTP_API
+int aws_intrusive_random_access_set_get_index(
+    const struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node **out,
+    size_t index);
+
+/**
+ * Min-heap mode only. Restore the order after the key of a node in the set changed.
+ */
+AWS_HTTP_API
+void aws_intrusive_random_access_set_update(
+    struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node *node);
+
 AWS_EXTERN_C_END
 #endif /* AWS_HTTP_RANDOM_ACCESS_SET_H */
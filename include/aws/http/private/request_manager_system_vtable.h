@@ -0,0 +1,41 @@
+#ifndef AWS_HTTP_REQUEST_MANAGER_SYSTEM_VTABLE_H
+#define AWS_HTTP_REQUEST_MANAGER_SYSTEM_VTABLE_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/connection_manager.h>
+#include <aws/http/http2_stream_manager.h>
+
+struct aws_http_request_manager;
+
+/* vtable of functions that aws_http_request_manager uses to interact with its sub-managers.
+ * tests override the vtable to hand out connections of their own */
+struct aws_http_request_manager_system_vtable {
+    void (*aws_http_connection_manager_acquire_connection)(
+        struct aws_http_connection_manager *manager,
+        aws_http_connection_manager_on_connection_setup_fn *callback,
+        void *user_data);
+    int (*aws_http_connection_manager_release_connection)(
+        struct aws_http_connection_manager *manager,
+        struct aws_http_connection *connection);
+    void (*aws_http2_stream_manager_acquire_stream)(
+        struct aws_http2_stream_manager *http2_stream_manager,
+        const struct aws_http2_stream_manager_acquire_stream_options *acquire_stream_option);
+};
+
+AWS_HTTP_API
+bool aws_http_request_manager_system_vtable_is_valid(const struct aws_http_request_manager_system_vtable *table);
+
+/* Must be called before any request is made */
+AWS_HTTP_API
+void aws_http_request_manager_set_system_vtable(
+    struct aws_http_request_manager *manager,
+    const struct aws_http_request_manager_system_vtable *system_vtable);
+
+AWS_HTTP_API
+extern const struct aws_http_request_manager_system_vtable *g_aws_http_request_manager_default_system_vtable_ptr;
+
+#endif /* AWS_HTTP_REQUEST_MANAGER_SYSTEM_VTABLE_H */
@@ -21,6 +21,8 @@ struct aws_http_stream_vtable {
 
     int (*http1_write_chunk)(struct aws_http_stream *http1_stream, const struct aws_http1_chunk_options *options);
     int (*http1_add_trailer)(struct aws_http_stream *http1_stream, const struct aws_http_headers *trailing_headers);
+    struct aws_http1_incoming_body_ref *(
+        *http1_retain_incoming_body)(struct aws_http_stream *http1_stream, struct aws_byte_cursor *data);
 
     int (*http2_reset_stream)(struct aws_http_stream *http2_stream, uint32_t http2_error);
     int (*http2_get_received_error_code)(struct aws_http_stream *http2_stream, uint32_t *http2_error);
@@ -57,9 +59,7 @@ struct aws_http_stream {
         struct aws_http_stream_client_data {
             int response_status;
             uint64_t response_first_byte_timeout_ms;
-            /* Using aws_task instead of aws_channel_task because, currently, channel-tasks can't be canceled.
-             * We only touch this from the connection's thread */
-            struct aws_task response_first_byte_timeout_task;
+            uint64_t request_timeout_ms;
         } client;
         struct aws_http_stream_server_data {
             struct aws_byte_cursor request_method_str;
@@ -74,4 +74,38 @@ struct aws_http_stream {
     struct aws_http_stream_server_data *server_data;
 };
 
+AWS_EXTERN_C_BEGIN
+
+/**
+ * If the request was created from an aws_http_message_template, and its leading headers are still exactly the
+ * template's headers, get the template's pre-encoded HTTP/1.1 header lines and return true.
+ * out_header_count is set to the number of leading headers covered by out_header_lines.
+ * The out_has_ flags report what those headers contain, since the encoder won't scan them again.
+ * Otherwise, return false.
+ */
+AWS_HTTP_API
+bool aws_http_message_get_template_encoding(
+    const struct aws_http_message *request,
+    struct aws_byte_cursor *out_header_lines,
+    size_t *out_header_count,
+    bool *out_has_connection_close_header,
+    bool *out_has_expect_continue_header);
+
+/**
+ * Get the well-known name of the header at this index, which was looked up when the header was added.
+ * Returns AWS_HTTP_HEADER_UNKNOWN if the name isn't well-known, or the index is out of range.
+ */
+AWS_HTTP_API
+enum aws_http_header_name aws_http_headers_get_name_enum(const struct aws_http_headers *headers, size_t index);
+
+/**
+ * Whether the header at this index has a valid HTTP/1.1 field-name and field-value (RFC-7230 3.2).
+ * This was checked when the header was added, so encoders needn't scan it again.
+ * Returns false if the index is out of range.
+ */
+AWS_HTTP_API
+bool aws_http_headers_is_field_valid(const struct aws_http_headers *headers, size_t index);
+
+AWS_EXTERN_C_END
+
 #endif /* AWS_HTTP_REQUEST_RESPONSE_IMPL_H */
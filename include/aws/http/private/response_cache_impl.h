@@ -0,0 +1,40 @@
+#ifndef AWS_HTTP_RESPONSE_CACHE_IMPL_H
+#define AWS_HTTP_RESPONSE_CACHE_IMPL_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/response_cache.h>
+
+#include <aws/common/hash_table.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
+#include <aws/common/ref_count.h>
+
+/* URIs are spread over this many shards, each with its own lock */
+#define AWS_HTTP_RESPONSE_CACHE_SHARD_COUNT 8
+
+struct aws_http_response_cache_shard {
+    struct aws_mutex lock;
+    /* URI (aws_string *) -> aws_http_cached_response. The shard holds a reference to each */
+    struct aws_hash_table responses;
+    /* aws_http_cached_response, most recently used at the front */
+    struct aws_linked_list lru_list;
+    size_t size;
+};
+
+struct aws_http_response_cache {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+    size_t shard_capacity;
+
+    /* Wall clock, in nanoseconds since the Unix epoch, since freshness is measured against Date headers.
+     * aws_sys_clock_get_ticks(), unless a test replaces it */
+    int (*system_clock_fn)(uint64_t *timestamp);
+
+    struct aws_http_response_cache_shard shards[AWS_HTTP_RESPONSE_CACHE_SHARD_COUNT];
+};
+
+#endif /* AWS_HTTP_RESPONSE_CACHE_IMPL_H */
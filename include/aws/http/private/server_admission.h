@@ -0,0 +1,121 @@
+#ifndef AWS_HTTP_SERVER_ADMISSION_H
+#define AWS_HTTP_SERVER_ADMISSION_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/server.h>
+
+#include <aws/common/atomics.h>
+#include <aws/common/ref_count.h>
+#include <aws/common/task_scheduler.h>
+
+struct aws_event_loop;
+struct aws_event_loop_group;
+struct aws_http_static_response;
+
+/* How often each event loop's lag is measured */
+#define AWS_HTTP_SERVER_LAG_PROBE_INTERVAL_MS 100
+
+/**
+ * Measures how late a periodic task runs on one event loop.
+ */
+struct aws_http_server_lag_probe {
+    struct aws_http_server_admission *admission;
+    struct aws_event_loop *event_loop;
+    struct aws_task task;
+    uint64_t scheduled_run_ns;
+    struct aws_atomic_var lag_ms;
+};
+
+/**
+ * Admission control shared by a server and its connections.
+ * Ref-counted, each lag probe and each admitted connection keeps it alive.
+ * Any thread may use it.
+ */
+struct aws_http_server_admission {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+    struct aws_http_server_admission_options options;
+
+    struct aws_atomic_var connection_count;
+    struct aws_atomic_var in_flight_stream_count;
+    /* Set once the server is shutting down, lag probes stop when they see it */
+    struct aws_atomic_var is_stopped;
+
+    /* Response to every shed HTTP/1 request, serialized once and shared by streams on any thread */
+    struct aws_http_static_response *shed_response;
+
+    size_t probe_count;
+    struct aws_http_server_lag_probe *probes;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Lag is only measured if options->max_event_loop_lag_ms is set,
+ * in which case a probe runs on every event loop in the group.
+ */
+AWS_HTTP_API
+struct aws_http_server_admission *aws_http_server_admission_new(
+    struct aws_allocator *allocator,
+    struct aws_event_loop_group *event_loop_group,
+    const struct aws_http_server_admission_options *options);
+
+AWS_HTTP_API
+struct aws_http_server_admission *aws_http_server_admission_acquire(struct aws_http_server_admission *admission);
+
+AWS_HTTP_API
+void aws_http_server_admission_release(struct aws_http_server_admission *admission);
+
+/**
+ * Stop measuring lag. The probes let go of the admission control the next time they run.
+ */
+AWS_HTTP_API
+void aws_http_server_admission_stop(struct aws_http_server_admission *admission);
+
+/**
+ * Returns true, and counts the connection as open, if a new connection on this event loop may be accepted.
+ * Each admitted connection must be followed by aws_http_server_admission_on_connection_closed().
+ */
+AWS_HTTP_API
+bool aws_http_server_admission_try_admit_connection(
+    struct aws_http_server_admission *admission,
+    struct aws_event_loop *event_loop);
+
+AWS_HTTP_API
+void aws_http_server_admission_on_connection_closed(struct aws_http_server_admission *admission);
+
+/**
+ * Returns true, and counts the stream as in flight, if a new request on this event loop may be processed.
+ * Each admitted stream must be followed by aws_http_server_admission_on_stream_complete().
+ */
+AWS_HTTP_API
+bool aws_http_server_admission_try_admit_stream(
+    struct aws_http_server_admission *admission,
+    struct aws_event_loop *event_loop);
+
+AWS_HTTP_API
+void aws_http_server_admission_on_stream_complete(struct aws_http_server_admission *admission);
+
+/**
+ * Returns true if a new request on this event loop would be shed. Nothing is counted.
+ */
+AWS_HTTP_API
+bool aws_http_server_admission_is_overloaded(
+    const struct aws_http_server_admission *admission,
+    const struct aws_event_loop *event_loop);
+
+/**
+ * Most recently measured lag of the event loop, in milliseconds. 0 if lag isn't measured.
+ */
+AWS_HTTP_API
+uint64_t aws_http_server_admission_get_event_loop_lag_ms(
+    const struct aws_http_server_admission *admission,
+    const struct aws_event_loop *event_loop);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_SERVER_ADMISSION_H */
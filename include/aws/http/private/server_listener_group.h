@@ -0,0 +1,60 @@
+#ifndef AWS_HTTP_SERVER_LISTENER_GROUP_H
+#define AWS_HTTP_SERVER_LISTENER_GROUP_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+#include <aws/io/channel_bootstrap.h>
+
+struct aws_http_server_listener_group;
+
+/**
+ * Options for aws_http_server_listener_group_new().
+ * Callbacks use the same signatures as aws_server_bootstrap's, with a NULL bootstrap.
+ */
+struct aws_http_server_listener_group_options {
+    struct aws_allocator *allocator;
+    struct aws_event_loop_group *event_loop_group;
+    const struct aws_socket_endpoint *endpoint;
+    const struct aws_socket_options *socket_options;
+    const struct aws_tls_connection_options *tls_options; /* optional */
+    bool enable_read_back_pressure;
+    aws_server_bootstrap_on_accept_channel_setup_fn *incoming_callback;
+    aws_server_bootstrap_on_accept_channel_shutdown_fn *shutdown_callback;
+    aws_server_bootstrap_on_server_listener_destroy_fn *destroy_callback;
+    void *user_data;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Listen on the endpoint with one SO_REUSEPORT socket per event loop in the group.
+ * The kernel load-balances incoming connections across the sockets,
+ * and each connection's channel lives on the event loop whose socket accepted it.
+ * Raises AWS_ERROR_PLATFORM_NOT_SUPPORTED where SO_REUSEPORT isn't available.
+ */
+AWS_HTTP_API
+struct aws_http_server_listener_group *aws_http_server_listener_group_new(
+    const struct aws_http_server_listener_group_options *options);
+
+/**
+ * Stop listening. destroy_callback is invoked once every listener is closed
+ * and every channel has finished shutting down. The user must shut down the channels.
+ */
+AWS_HTTP_API
+void aws_http_server_listener_group_destroy(struct aws_http_server_listener_group *listener_group);
+
+/**
+ * Endpoint the sockets are bound to. If a port of 0 was requested, this holds the port actually chosen.
+ */
+AWS_HTTP_API
+const struct aws_socket_endpoint *aws_http_server_listener_group_get_endpoint(
+    const struct aws_http_server_listener_group *listener_group);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_SERVER_LISTENER_GROUP_H */
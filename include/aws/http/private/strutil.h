@@ -52,6 +52,21 @@ bool aws_strutil_is_lowercase_http_token(struct aws_byte_cursor token);
 AWS_HTTP_API
 bool aws_strutil_is_http_field_value(struct aws_byte_cursor cursor);
 
+/**
+ * Split an HTTP/1 header line (CRLF already removed) into name and value, validating while it splits.
+ * The line is scanned once, 16 bytes at a time where SIMD is available, to find the first ':' and
+ * any octet that's illegal in field-content. The value is trimmed of leading and trailing whitespace.
+ *
+ * Returns true if the name is a valid token and the value is a valid field-value.
+ * Returns false if the line is invalid in any way, without saying why. Callers that need details should fall back to
+ * aws_strutil_is_http_token() and aws_strutil_is_http_field_value().
+ */
+AWS_HTTP_API
+bool aws_strutil_split_http_header_line(
+    struct aws_byte_cursor line,
+    struct aws_byte_cursor *out_name,
+    struct aws_byte_cursor *out_value);
+
 /**
  * Return whether this ASCII/UTF-8 sequence is a valid HTTP response status reason-phrase.
  *
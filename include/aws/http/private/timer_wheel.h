@@ -0,0 +1,117 @@
+#ifndef AWS_HTTP_TIMER_WHEEL_H
+#define AWS_HTTP_TIMER_WHEEL_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/common/linked_list.h>
+#include <aws/common/task_scheduler.h>
+#include <aws/http/http.h>
+
+struct aws_event_loop;
+struct aws_http_timer;
+struct aws_http_timer_wheel;
+
+enum {
+    /* Timers fire on a whole tick, never early, and at most one tick late */
+    AWS_HTTP_TIMER_WHEEL_TICK_NS = 1000 * 1000,
+    AWS_HTTP_TIMER_WHEEL_SLOT_BITS = 6,
+    AWS_HTTP_TIMER_WHEEL_SLOTS = 1 << AWS_HTTP_TIMER_WHEEL_SLOT_BITS,
+    /* With 1ms ticks, 4 levels of 64 slots cover about 4.6 hours. Later timers wait in an overflow list */
+    AWS_HTTP_TIMER_WHEEL_LEVELS = 4,
+};
+
+/**
+ * Invoked when a timer expires. The timer is no longer armed, and may be re-armed or freed from this callback.
+ */
+typedef void(aws_http_timer_fn)(struct aws_http_timer *timer, void *user_data);
+
+/**
+ * A timer to embed in whatever it times out. Arm and cancel are constant time.
+ */
+struct aws_http_timer {
+    struct aws_linked_list_node node;
+    aws_http_timer_fn *fn;
+    void *user_data;
+    /* Wheel the timer is armed in. NULL when not armed */
+    struct aws_http_timer_wheel *wheel;
+    uint64_t expiry_tick;
+    uint8_t level;
+    uint8_t slot;
+};
+
+/**
+ * Hierarchical timer wheel for protocol timers (timeouts that are usually canceled before they fire).
+ * Each level's slots cover AWS_HTTP_TIMER_WHEEL_SLOTS times the span of the level below.
+ * Timers move down a level each time the wheel reaches the start of their slot, and fire from level 0.
+ * Not thread-safe. See aws_http_event_loop_timer_arm() for the wheel shared by an event-loop's connections.
+ */
+struct aws_http_timer_wheel {
+    /* Next tick to process. Every timer expiring before this has fired */
+    uint64_t current_tick;
+    size_t num_timers;
+    struct aws_linked_list slots[AWS_HTTP_TIMER_WHEEL_LEVELS][AWS_HTTP_TIMER_WHEEL_SLOTS];
+    /* Bit N is set if slots[level][N] is not empty */
+    uint64_t occupied[AWS_HTTP_TIMER_WHEEL_LEVELS];
+    /* Timers beyond the top level, re-sorted each time the top level turns */
+    struct aws_linked_list overflow;
+};
+
+AWS_EXTERN_C_BEGIN
+
+AWS_HTTP_API
+void aws_http_timer_init(struct aws_http_timer *timer, aws_http_timer_fn *fn, void *user_data);
+
+AWS_HTTP_API
+bool aws_http_timer_is_armed(const struct aws_http_timer *timer);
+
+/**
+ * Cancel the timer, if it's armed. Its callback will not be invoked.
+ */
+AWS_HTTP_API
+void aws_http_timer_cancel(struct aws_http_timer *timer);
+
+AWS_HTTP_API
+void aws_http_timer_wheel_init(struct aws_http_timer_wheel *wheel, uint64_t now_ns);
+
+/**
+ * Clean up the wheel. Timers still armed are disarmed, without their callbacks being invoked.
+ */
+AWS_HTTP_API
+void aws_http_timer_wheel_clean_up(struct aws_http_timer_wheel *wheel);
+
+/**
+ * Arm the timer to fire once the wheel advances past `expiry_ns`. If the timer is already armed, it's re-armed.
+ */
+AWS_HTTP_API
+void aws_http_timer_wheel_arm(struct aws_http_timer_wheel *wheel, struct aws_http_timer *timer, uint64_t expiry_ns);
+
+/**
+ * Fire every timer that has expired by `now_ns`.
+ */
+AWS_HTTP_API
+void aws_http_timer_wheel_advance(struct aws_http_timer_wheel *wheel, uint64_t now_ns);
+
+/**
+ * Returns when aws_http_timer_wheel_advance() next needs to be called, or UINT64_MAX if no timers are armed.
+ * This may be earlier than the next timer's expiry, when timers need to move down a level.
+ */
+AWS_HTTP_API
+uint64_t aws_http_timer_wheel_next_run_ns(const struct aws_http_timer_wheel *wheel);
+
+/**
+ * Arm the timer to fire `timeout_ns` from now, in the wheel shared by everything on this event-loop.
+ * The wheel is created the first time it's needed, and lives as long as the event-loop.
+ * MUST be called from the event-loop's thread. The callback is invoked on that thread.
+ */
+AWS_HTTP_API
+int aws_http_event_loop_timer_arm(
+    struct aws_event_loop *event_loop,
+    struct aws_http_timer *timer,
+    uint64_t timeout_ns);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_TIMER_WHEEL_H */
@@ -0,0 +1,50 @@
+#ifndef AWS_HTTP_TRACING_H
+#define AWS_HTTP_TRACING_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+/**
+ * USDT (static tracepoint) probes on hot paths, for tools like bpftrace, perf, and SystemTap.
+ * Compiled in when built with -DAWS_HTTP_ENABLE_USDT=ON, otherwise they compile to nothing.
+ * An enabled probe costs a single nop until a tracer attaches to it.
+ *
+ * Probes belong to the "aws_c_http" provider. A double underscore in a probe's name
+ * reads as a dash to tracers (ex: stream__create is "stream-create").
+ *
+ * Arguments must be integers or pointers:
+ *
+ * stream__create(stream, connection)
+ * stream__activate(stream, stream_id)
+ * stream__complete(stream, error_code)
+ * header__block__done(stream, header_block, is_http2)
+ * h2__frame__sent(connection, frame_type, stream_id)
+ * h2__frame__received(connection, frame_type, stream_id, payload_len)
+ * h2__window__update__sent(connection, stream_id, increment)
+ * h2__window__update__received(connection, stream_id, increment)
+ * connection__manager__acquire(manager, connection, error_code)
+ * connection__manager__release(manager, connection)
+ * stream__manager__acquire(stream_manager, stream, error_code)
+ * stream__manager__release(stream_manager, stream)
+ * websocket__frame__in(websocket, opcode, payload_length)
+ * websocket__frame__out(websocket, opcode, payload_length)
+ */
+
+#ifdef AWS_HTTP_USE_USDT
+#    include <sys/sdt.h>
+
+#    define AWS_HTTP_PROBE2(name, a, b) DTRACE_PROBE2(aws_c_http, name, a, b)
+#    define AWS_HTTP_PROBE3(name, a, b, c) DTRACE_PROBE3(aws_c_http, name, a, b, c)
+#    define AWS_HTTP_PROBE4(name, a, b, c, d) DTRACE_PROBE4(aws_c_http, name, a, b, c, d)
+
+#else
+
+#    define AWS_HTTP_PROBE2(name, a, b)
+#    define AWS_HTTP_PROBE3(name, a, b, c)
+#    define AWS_HTTP_PROBE4(name, a, b, c, d)
+
+#endif /* AWS_HTTP_USE_USDT */
+
+#endif /* AWS_HTTP_TRACING_H */
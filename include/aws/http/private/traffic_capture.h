@@ -0,0 +1,96 @@
+#ifndef AWS_HTTP_TRAFFIC_CAPTURE_H
+#define AWS_HTTP_TRAFFIC_CAPTURE_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+struct aws_channel_slot;
+struct aws_http_traffic_capture_options;
+
+/*
+ * Capture file format. All integers are big-endian.
+ *
+ * File header (20 bytes):
+ *   8 bytes  magic "AWSHTCAP"
+ *   1 byte   format version (1)
+ *   1 byte   HTTP version of the connection (enum aws_http_version)
+ *   1 byte   flags, see AWS_HTTP_TRAFFIC_CAPTURE_FLAG_*
+ *   1 byte   reserved (0)
+ *   8 bytes  wall-clock time the capture began, nanoseconds since the Unix epoch
+ *
+ * Followed by records until the end of the file (13 byte header, then the data):
+ *   1 byte   direction (enum aws_http_traffic_capture_direction)
+ *   8 bytes  high-res clock nanoseconds since the capture began
+ *   4 bytes  data length
+ *   N bytes  data, exactly as one aws_io_message carried it
+ *
+ * A process that dies mid-write can leave a truncated record at the end of the file.
+ */
+#define AWS_HTTP_TRAFFIC_CAPTURE_FORMAT_VERSION 1
+#define AWS_HTTP_TRAFFIC_CAPTURE_FILE_HEADER_SIZE 20
+#define AWS_HTTP_TRAFFIC_CAPTURE_RECORD_HEADER_SIZE 13
+
+/* The connection was the server side, so inbound data is requests */
+#define AWS_HTTP_TRAFFIC_CAPTURE_FLAG_SERVER 0x01
+
+enum aws_http_traffic_capture_direction {
+    /* Received from the peer */
+    AWS_HTTP_TRAFFIC_CAPTURE_INBOUND = 1,
+    /* Sent to the peer */
+    AWS_HTTP_TRAFFIC_CAPTURE_OUTBOUND = 2,
+};
+
+struct aws_http_traffic_capture_file_header {
+    enum aws_http_version http_version;
+    bool is_server;
+    uint64_t start_time_ns;
+};
+
+struct aws_http_traffic_capture_record {
+    enum aws_http_traffic_capture_direction direction;
+    uint64_t timestamp_ns;
+    /* Points into the input that was read */
+    struct aws_byte_cursor data;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Install a channel handler immediately to the left of the HTTP connection's slot, which records everything passing
+ * through it to a new file in the capture directory. Must be called from the channel's thread, after the connection's
+ * slot is in the channel and before its handler is set, so that nothing the connection sends is missed.
+ *
+ * Not being able to create the file is logged, and isn't an error: the connection carries on without capture.
+ */
+AWS_HTTP_API
+int aws_http_traffic_capture_install(
+    struct aws_allocator *allocator,
+    struct aws_channel_slot *connection_slot,
+    const struct aws_http_traffic_capture_options *options,
+    enum aws_http_version http_version,
+    bool is_server);
+
+/**
+ * Read the file header from the start of a capture, advancing the cursor past it.
+ * Raises AWS_ERROR_INVALID_ARGUMENT if the input isn't a capture this code understands.
+ */
+AWS_HTTP_API
+int aws_http_traffic_capture_read_file_header(
+    struct aws_byte_cursor *input,
+    struct aws_http_traffic_capture_file_header *header);
+
+/**
+ * Read the next record, advancing the cursor past it.
+ * Raises AWS_ERROR_SHORT_BUFFER if the input ends partway through a record,
+ * and AWS_ERROR_INVALID_ARGUMENT if the record's direction isn't known.
+ */
+AWS_HTTP_API
+int aws_http_traffic_capture_read_record(struct aws_byte_cursor *input, struct aws_http_traffic_capture_record *record);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_TRAFFIC_CAPTURE_H */
@@ -31,6 +31,7 @@ enum aws_websocket_decoder_state {
 };
 
 struct aws_websocket_decoder {
+    struct aws_allocator *alloc;
     enum aws_websocket_decoder_state state;
     uint64_t state_bytes_processed; /* For multi-byte states, the number of bytes processed so far */
     uint8_t state_cache[8];         /* For multi-byte states to cache data that might be split across packets */
@@ -42,7 +43,20 @@ struct aws_websocket_decoder {
     /* True while processing a TEXT "message" (from the start of a TEXT frame,
      * until the end of the TEXT or CONTINUATION frame with the FIN bit set). */
     bool processing_text_message;
-    struct aws_utf8_decoder *text_message_validator;
+    struct aws_websocket_utf8_validator text_message_validator;
+
+    /* Set if permessage-deflate (RFC-7692) was negotiated, NULL otherwise. Not owned by the decoder. */
+    struct aws_websocket_decompressor *decompressor;
+
+    /* True if the peer resets its compression context after each message */
+    bool reset_decompressor_after_message;
+
+    /* True while processing a compressed "message" (from a TEXT or BINARY frame with the RSV1 bit set,
+     * until the end of the frame with the FIN bit set). */
+    bool processing_compressed_message;
+
+    /* Decompressed payload is written here before it's passed to on_payload */
+    struct aws_byte_buf decompressed_buf;
 
     void *user_data;
     aws_websocket_decoder_frame_fn *on_frame;
@@ -62,11 +76,24 @@ void aws_websocket_decoder_init(
 AWS_HTTP_API
 void aws_websocket_decoder_clean_up(struct aws_websocket_decoder *decoder);
 
+/**
+ * Decompress messages that have the RSV1 bit set, as per permessage-deflate (RFC-7692).
+ * Once this is set, the RSV1 bit is only permitted on the first frame of a TEXT or BINARY message,
+ * and `on_payload` receives decompressed data.
+ * The decompressor must outlive the decoder.
+ */
+AWS_HTTP_API
+void aws_websocket_decoder_set_decompressor(
+    struct aws_websocket_decoder *decoder,
+    struct aws_websocket_decompressor *decompressor,
+    bool reset_after_message);
+
 /**
  * Returns when all data is processed, or a frame and its payload have completed.
  * `data` will be advanced to reflect the amount of data processed by this call.
  * `frame_complete` will be set true if this call returned due to completion of a frame.
- * The `on_frame` and `on_payload` callbacks may each be invoked once as a result of this call.
+ * The `on_frame` callback may be invoked once as a result of this call.
+ * The `on_payload` callback may be invoked once, or more if the payload is being decompressed.
  * If an error occurs, the decoder is invalid forevermore.
  */
 AWS_HTTP_API int aws_websocket_decoder_process(
@@ -0,0 +1,45 @@
+#ifndef AWS_HTTP_WEBSOCKET_DEFLATE_H
+#define AWS_HTTP_WEBSOCKET_DEFLATE_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/websocket.h>
+
+/* RFC-7692 Section 7.2.1: A sync-flushed DEFLATE block ends with these 4 bytes.
+ * The sender removes them from the end of each message, and the receiver appends them again */
+#define AWS_WEBSOCKET_DEFLATE_TAIL_LENGTH 4
+AWS_HTTP_API
+extern const uint8_t aws_websocket_deflate_tail[AWS_WEBSOCKET_DEFLATE_TAIL_LENGTH];
+
+/* RFC-7692 Section 7.1.2: LZ77 window bits, when the max_window_bits parameters are omitted */
+#define AWS_WEBSOCKET_DEFLATE_DEFAULT_WINDOW_BITS 15
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Client: append the value for the handshake request's Sec-WebSocket-Extensions header,
+ * offering permessage-deflate with the given options.
+ */
+AWS_HTTP_API
+int aws_websocket_permessage_deflate_write_offer(
+    const struct aws_websocket_permessage_deflate_options *options,
+    struct aws_byte_buf *out_value);
+
+/**
+ * Client: validate the server's response to our offer (RFC-7692 Section 5.1), and get the agreed parameters.
+ * `response_value` is the value of the response's Sec-WebSocket-Extensions header.
+ * Raises AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE if the server accepted something other than permessage-deflate,
+ * or its parameters are malformed or incompatible with the offer.
+ */
+AWS_HTTP_API
+int aws_websocket_permessage_deflate_parse_response(
+    const struct aws_websocket_permessage_deflate_options *offer,
+    struct aws_byte_cursor response_value,
+    struct aws_websocket_permessage_deflate_params *out_params);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_WEBSOCKET_DEFLATE_H */
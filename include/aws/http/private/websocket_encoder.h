@@ -19,6 +19,7 @@ enum aws_websocket_encoder_state {
     AWS_WEBSOCKET_ENCODER_STATE_MASKING_KEY,
     AWS_WEBSOCKET_ENCODER_STATE_PAYLOAD_CHECK,
     AWS_WEBSOCKET_ENCODER_STATE_PAYLOAD,
+    AWS_WEBSOCKET_ENCODER_STATE_PRE_ENCODED,
     AWS_WEBSOCKET_ENCODER_STATE_DONE,
 };
 
@@ -31,6 +32,10 @@ struct aws_websocket_encoder {
     /* True when the next data frame must be a CONTINUATION frame */
     bool expecting_continuation_data_frame;
 
+    /* Set if the frame in progress was encoded ahead of time. This is what remains to be written */
+    struct aws_byte_cursor pre_encoded;
+    bool is_frame_pre_encoded;
+
     void *user_data;
     aws_websocket_encoder_payload_fn *stream_outgoing_payload;
 };
@@ -46,6 +51,16 @@ void aws_websocket_encoder_init(
 AWS_HTTP_API
 int aws_websocket_encoder_start_frame(struct aws_websocket_encoder *encoder, const struct aws_websocket_frame *frame);
 
+/**
+ * Start writing a frame that's already encoded, header and payload. `frame` describes it, and is checked
+ * just as aws_websocket_encoder_start_frame() would check it. `encoded` must stay valid until the frame is written.
+ */
+AWS_HTTP_API
+int aws_websocket_encoder_start_pre_encoded_frame(
+    struct aws_websocket_encoder *encoder,
+    const struct aws_websocket_frame *frame,
+    struct aws_byte_cursor encoded);
+
 AWS_HTTP_API
 bool aws_websocket_encoder_is_frame_in_progress(const struct aws_websocket_encoder *encoder);
 
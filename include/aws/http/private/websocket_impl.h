@@ -53,6 +53,23 @@ struct aws_websocket_frame {
     uint8_t masking_key[4];
 };
 
+/**
+ * Incremental UTF-8 validator for TEXT messages, which may split a code point across frames or reads.
+ * Zero-initialize or call aws_websocket_utf8_validator_reset() before use.
+ */
+struct aws_websocket_utf8_validator {
+    /* Continuation bytes still expected for the current code point, 0 if between code points */
+    uint8_t remaining;
+    /* Range allowed for the next continuation byte.
+     * Narrower than 0x80-0xBF right after some lead bytes, to reject overlong encodings,
+     * UTF-16 surrogates, and code points above U+10FFFF */
+    uint8_t next_min;
+    uint8_t next_max;
+};
+
+/* Initial read window when it's managed automatically by a read budget, if the user doesn't set one */
+#define AWS_WEBSOCKET_DEFAULT_AUTO_WINDOW_SIZE (64 * 1024)
+
 struct aws_websocket_handler_options {
     struct aws_allocator *allocator;
     struct aws_channel *channel;
@@ -65,6 +82,24 @@ struct aws_websocket_handler_options {
 
     bool is_server;
     bool manual_window_update;
+
+    /* Optional. Set if permessage-deflate (RFC-7692) was negotiated, with the agreed `permessage_deflate_params` */
+    const struct aws_websocket_permessage_deflate_options *permessage_deflate;
+    struct aws_websocket_permessage_deflate_params permessage_deflate_params;
+
+    /* Optional. See aws_websocket_client_connection_options.write_batch_target_size */
+    size_t write_batch_target_size;
+    uint32_t write_batch_max_delay_ms;
+    aws_websocket_on_outgoing_frames_complete_fn *on_outgoing_frames_complete;
+
+    /* Optional. See aws_websocket_client_connection_options.on_incoming_message */
+    aws_websocket_on_incoming_message_fn *on_incoming_message;
+    size_t max_incoming_message_size;
+
+    /* Optional. See aws_websocket_client_connection_options.read_budget.
+     * If either is set, the read window is managed automatically and `manual_window_update` is ignored */
+    size_t read_budget;
+    struct aws_websocket_read_budget *shared_read_budget;
 };
 
 struct aws_websocket_client_bootstrap_system_vtable {
@@ -97,6 +132,33 @@ const char *aws_websocket_opcode_str(uint8_t opcode);
 AWS_HTTP_API
 uint64_t aws_websocket_frame_encoded_size(const struct aws_websocket_frame *frame);
 
+/**
+ * XOR payload data in place against the masking-key (RFC-6455 Section 5.3).
+ * mask_offset is the number of payload bytes that preceded this data in the frame,
+ * so payloads may be masked piecemeal as they're encoded/decoded.
+ * Uses the widest SIMD path available at runtime, falling back to 64-bit word-at-a-time.
+ */
+AWS_HTTP_API
+void aws_websocket_mask_payload(struct aws_byte_cursor payload, const uint8_t masking_key[4], uint64_t mask_offset);
+
+AWS_HTTP_API
+void aws_websocket_utf8_validator_reset(struct aws_websocket_utf8_validator *validator);
+
+/**
+ * Validate the next piece of a UTF-8 string.
+ * Runs of ASCII are checked a whole SIMD block at a time, using the widest path available at runtime.
+ * Raises AWS_ERROR_INVALID_UTF8 if the text is invalid so far.
+ */
+AWS_HTTP_API
+int aws_websocket_utf8_validator_update(struct aws_websocket_utf8_validator *validator, struct aws_byte_cursor text);
+
+/**
+ * Finish validating a UTF-8 string, and reset the validator.
+ * Raises AWS_ERROR_INVALID_UTF8 if the string ended in the middle of a code point.
+ */
+AWS_HTTP_API
+int aws_websocket_utf8_validator_finalize(struct aws_websocket_utf8_validator *validator);
+
 /**
  * Create a websocket channel-handler and insert it into the channel.
  */
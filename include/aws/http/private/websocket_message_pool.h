@@ -0,0 +1,167 @@
+#ifndef AWS_HTTP_WEBSOCKET_MESSAGE_POOL_H
+#define AWS_HTTP_WEBSOCKET_MESSAGE_POOL_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/common/atomics.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
+#include <aws/common/ref_count.h>
+#include <aws/http/websocket.h>
+
+/* Max size of a reassembled incoming message, if the user doesn't set one */
+#define AWS_WEBSOCKET_DEFAULT_MAX_INCOMING_MESSAGE_SIZE (16 * 1024 * 1024)
+
+/* Capacity of the smallest size class. Each class is twice the size of the one before,
+ * except the largest, which is exactly the pool's max message size */
+#define AWS_WEBSOCKET_MESSAGE_POOL_MIN_CLASS_SIZE 1024
+
+/* Enough classes to double from the min class size up to SIZE_MAX */
+#define AWS_WEBSOCKET_MESSAGE_POOL_MAX_CLASSES (sizeof(size_t) * 8 - 10)
+
+/* Number of free buffers kept for each size class, beyond that they're freed */
+#define AWS_WEBSOCKET_MESSAGE_POOL_MAX_FREE_PER_CLASS 4
+
+/**
+ * A reassembled incoming TEXT or BINARY message.
+ * Its payload storage is allocated along with it, and it goes back to its pool when the ref-count reaches zero.
+ */
+struct aws_websocket_incoming_message {
+    struct aws_allocator *allocator;
+    struct aws_websocket_message_pool *pool;
+    struct aws_atomic_var ref_count;
+    struct aws_linked_list_node node;
+    size_t size_class;
+    uint8_t opcode;
+    struct aws_byte_buf payload;
+    /* Bytes counted against the read budgets while the user holds the message, refunded on release */
+    size_t charged_bytes;
+};
+
+/**
+ * Invoked from whatever thread released a message, once budget has been freed up
+ * after aws_websocket_message_pool_wait_for_budget() was called.
+ * Invoked with the pool's lock held, so it must not call back into the pool.
+ */
+typedef void(aws_websocket_message_pool_on_budget_freed_fn)(void *user_data);
+
+/**
+ * Memory budget shared by the message pools of many websockets.
+ */
+struct aws_websocket_read_budget {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+    struct aws_mutex lock;
+    size_t max_bytes;
+    size_t charged_bytes;
+    /* aws_websocket_message_pool waiting for budget to be freed up */
+    struct aws_linked_list waiting_pools;
+};
+
+/**
+ * Recycles message buffers in power-of-2 size classes, so that receiving many messages
+ * doesn't cost an allocation and free (and several reallocs for fragmented messages) per message.
+ * Any thread may release messages back to the pool.
+ * The pool is ref-counted, each outstanding message keeps it alive.
+ */
+struct aws_websocket_message_pool {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+    struct aws_mutex lock;
+    size_t max_message_size;
+    size_t num_classes;
+    struct aws_linked_list free_lists[AWS_WEBSOCKET_MESSAGE_POOL_MAX_CLASSES]; /* aws_websocket_incoming_message */
+    size_t free_counts[AWS_WEBSOCKET_MESSAGE_POOL_MAX_CLASSES];
+
+    /* Read budgets. A max of 0 and NULL shared_budget mean the pool isn't budgeted */
+    size_t max_charged_bytes;
+    size_t charged_bytes;
+    struct aws_websocket_read_budget *shared_budget;
+
+    /* Set while the websocket is interested in budget being freed up */
+    aws_websocket_message_pool_on_budget_freed_fn *on_budget_freed;
+    void *on_budget_freed_user_data;
+    bool is_waiting_for_budget;
+
+    /* Node in shared_budget's waiting_pools (protected by the shared budget's lock) */
+    struct aws_linked_list_node shared_budget_node;
+    bool is_waiting_for_shared_budget;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/* If max_message_size is 0, AWS_WEBSOCKET_DEFAULT_MAX_INCOMING_MESSAGE_SIZE is used */
+AWS_HTTP_API
+struct aws_websocket_message_pool *aws_websocket_message_pool_new(
+    struct aws_allocator *allocator,
+    size_t max_message_size);
+
+AWS_HTTP_API
+void aws_websocket_message_pool_release(struct aws_websocket_message_pool *pool);
+
+/**
+ * Budget the memory of messages that the pool's user holds.
+ * Either `max_charged_bytes` may be 0, or `shared_budget` NULL, but not both.
+ * The pool keeps the shared budget alive via ref-counting.
+ * on_budget_freed is invoked after budget is freed up, if aws_websocket_message_pool_wait_for_budget()
+ * was called first. Set NULL to stop listening, after which it's never invoked again.
+ */
+AWS_HTTP_API
+void aws_websocket_message_pool_set_budget(
+    struct aws_websocket_message_pool *pool,
+    size_t max_charged_bytes,
+    struct aws_websocket_read_budget *shared_budget,
+    aws_websocket_message_pool_on_budget_freed_fn *on_budget_freed,
+    void *user_data);
+
+/**
+ * Stop listening for budget to be freed up.
+ * on_budget_freed will not be invoked again once this returns.
+ */
+AWS_HTTP_API
+void aws_websocket_message_pool_stop_budget_callbacks(struct aws_websocket_message_pool *pool);
+
+/**
+ * Count the message against the read budgets, until its last reference is released.
+ * Does nothing if the pool isn't budgeted.
+ */
+AWS_HTTP_API
+void aws_websocket_message_pool_charge(
+    struct aws_websocket_message_pool *pool,
+    struct aws_websocket_incoming_message *message);
+
+/**
+ * Returns true if either of the pool's read budgets is exceeded.
+ */
+AWS_HTTP_API
+bool aws_websocket_message_pool_is_over_budget(struct aws_websocket_message_pool *pool);
+
+/**
+ * Have on_budget_freed invoked once, the next time any budgeted message is released.
+ */
+AWS_HTTP_API
+void aws_websocket_message_pool_wait_for_budget(struct aws_websocket_message_pool *pool);
+
+/**
+ * Get an empty message with room for at least `capacity` bytes, which may not exceed the pool's max message size.
+ * The message's ref-count is 1.
+ */
+AWS_HTTP_API
+struct aws_websocket_incoming_message *aws_websocket_message_pool_acquire(
+    struct aws_websocket_message_pool *pool,
+    size_t capacity);
+
+/**
+ * Ensure the message has room for at least `capacity` bytes, which may not exceed the pool's max message size.
+ * If it doesn't, the contents move to a buffer from a larger size class and `*message` is updated.
+ * The message must not be shared (ref-count of 1).
+ */
+AWS_HTTP_API
+int aws_websocket_incoming_message_reserve(struct aws_websocket_incoming_message **message, size_t capacity);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_HTTP_WEBSOCKET_MESSAGE_POOL_H */
@@ -15,6 +15,7 @@ AWS_PUSH_SANE_WARNING_LEVEL
 
 struct aws_http_client_connection_options;
 struct aws_http_connection_manager_options;
+struct aws_http2_stream_manager;
 
 struct aws_http_message;
 struct aws_http_header;
@@ -150,6 +151,22 @@ struct aws_http_proxy_options {
      * Replaced by instantiating a proxy_strategy via aws_http_proxy_strategy_new_basic_auth()
      */
     struct aws_byte_cursor auth_password;
+
+    /**
+     * Optional. Tunneling proxies only.
+     * HTTP/2 connections to the proxy, on which tunnels are opened as CONNECT streams (RFC-9113 8.5),
+     * so that many tunnels share a connection instead of each costing a TCP and TLS handshake with the proxy.
+     * Create it with the proxy's host, port, and TLS options (which offer ALPN "h2").
+     *
+     * Each tunnel gets a channel of its own, on the event-loop of the HTTP/2 connection it was opened on
+     * (`requested_event_loop` is ignored), where the origin's TLS handler and HTTP connection are installed
+     * just as they would be on a connection to the proxy. Closing the tunnel resets or ends its stream,
+     * the connection to the proxy stays open for other tunnels.
+     *
+     * If NULL, each tunnel is a new HTTP/1.1 connection to the proxy.
+     * The proxy configuration holds a reference to it.
+     */
+    struct aws_http2_stream_manager *http2_stream_manager;
 };
 
 /**
@@ -362,6 +379,9 @@ struct aws_http_proxy_strategy_tunneling_ntlm_options {
 /*
  * Options necessary to create an adaptive sequential strategy that tries one or more of kerberos and ntlm (in that
  * order, if both are active).  If an options struct is NULL, then that strategy will not be used.
+ *
+ * The adaptive strategy remembers which scheme the proxy accepted (see remember_successful_strategy in the sequence
+ * options), so later connections authenticate on their first CONNECT instead of after a 407.
  */
 struct aws_http_proxy_strategy_tunneling_adaptive_options {
     /*
@@ -382,6 +402,14 @@ struct aws_http_proxy_strategy_tunneling_sequence_options {
     struct aws_http_proxy_strategy **strategies;
 
     uint32_t strategy_count;
+
+    /*
+     * If true, the strategy remembers which strategy in the sequence led to a successful CONNECT, and later
+     * connections start from it, wrapping around to the ones before it if it stops working.
+     * A strategy that continues on the same connection (like ntlm after its challenge) is remembered by the strategy
+     * that began that connection's negotiation.  Tokens are never reused, only the choice of strategy.
+     */
+    bool remember_successful_strategy;
 };
 
 AWS_EXTERN_C_BEGIN
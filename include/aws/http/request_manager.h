@@ -0,0 +1,183 @@
+#ifndef AWS_HTTP_REQUEST_MANAGER_H
+#define AWS_HTTP_REQUEST_MANAGER_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+AWS_PUSH_SANE_WARNING_LEVEL
+
+struct aws_http_request_manager;
+struct aws_client_bootstrap;
+struct aws_http_connection_monitoring_options;
+struct aws_http_make_request_options;
+struct aws_http_memory_budget;
+struct aws_http_proxy_options;
+struct aws_http_stream;
+struct aws_socket_options;
+struct aws_tls_connection_options;
+struct proxy_env_var_settings;
+
+/**
+ * Always invoked asynchronously when the stream was made, successfully or not.
+ * When stream is NULL, error code will be set to indicate what happened.
+ * If there is a stream returned, it's already activated and you own it completely.
+ */
+typedef void(
+    aws_http_request_manager_on_stream_acquired_fn)(struct aws_http_stream *stream, int error_code, void *user_data);
+
+/**
+ * Invoked asynchronously when the request manager has been shutdown completely.
+ * Never invoked when `aws_http_request_manager_new` failed.
+ */
+typedef void(aws_http_request_manager_shutdown_complete_fn)(void *user_data);
+
+/**
+ * Request manager configuration struct.
+ *
+ * The request manager makes requests to one endpoint without knowing in advance which protocol it speaks.
+ * Secure connections offer ALPN "h2;http/1.1". If the first connection negotiates HTTP/2, every request
+ * becomes a stream multiplexed by an aws_http2_stream_manager. Otherwise, each request leases a pooled
+ * connection from an aws_http_connection_manager, which is released once the request completes.
+ * Requests made before the first connection is established wait for it.
+ *
+ * An endpoint that speaks HTTP/2 costs one extra connection, which was only used to learn the protocol.
+ */
+struct aws_http_request_manager_options {
+    /**
+     * basic http connection configuration
+     */
+    struct aws_client_bootstrap *bootstrap;
+    const struct aws_socket_options *socket_options;
+
+    /**
+     * Optional.
+     * Options to create secure (HTTPS) connections. Its ALPN list is replaced with "h2;http/1.1".
+     * Cleartext (HTTP) connections always use HTTP/1.1.
+     */
+    const struct aws_tls_connection_options *tls_connection_options;
+
+    struct aws_byte_cursor host;
+    uint32_t port;
+
+    /* Connection monitor for the underlying connections made */
+    const struct aws_http_connection_monitoring_options *monitoring_options;
+
+    /* Optional. Proxy configuration for underlying http connection */
+    const struct aws_http_proxy_options *proxy_options;
+    const struct proxy_env_var_settings *proxy_ev_settings;
+
+    /**
+     * Required.
+     * The max number of connections open at the same time, whichever protocol the endpoint speaks.
+     */
+    size_t max_connections;
+
+    /**
+     * Optional. HTTP/2 only.
+     * See `aws_http2_stream_manager_options` for details.
+     */
+    size_t ideal_concurrent_streams_per_connection;
+    size_t max_concurrent_streams_per_connection;
+    size_t max_unprocessed_stream_retries;
+    bool enable_adaptive_concurrency;
+
+    /**
+     * Optional.
+     * While this budget is exhausted, no new connections are made, and requests wait for the ones there are.
+     * See `aws_http_connection_manager_options.memory_budget`.
+     */
+    struct aws_http_memory_budget *memory_budget;
+
+    /**
+     * Optional.
+     * If true, a GET made while an identical one is still waiting for its response shares that request's stream,
+     * instead of making another request. Each requester still gets a stream of its own, which hears the same
+     * response: the same headers, and the same body data, passed to each requester in turn without copying.
+     * Cancelling one of these streams only stops its own callbacks, the response keeps coming for the others.
+     *
+     * GETs are identical if their authority, path, and the values of the headers named in
+     * `coalescing_header_names` match. Any other header is ignored, so name every header that changes the response
+     * (authorization, range, etc.). Requests with a body, `content_decoding`, or `http2_use_manual_data_writes`
+     * are never coalesced.
+     *
+     * A GET only joins until the response begins, a later one makes a request of its own.
+     * The names are copied.
+     */
+    bool enable_request_coalescing;
+    const struct aws_byte_cursor *coalescing_header_names;
+    size_t num_coalescing_header_names;
+
+    /**
+     * Optional.
+     * When the request manager finishes deleting all the resources, the callback will be invoked.
+     */
+    void *shutdown_complete_user_data;
+    aws_http_request_manager_shutdown_complete_fn *shutdown_complete_callback;
+};
+
+struct aws_http_request_manager_acquire_stream_options {
+    /**
+     * Required.
+     * Invoked when the request manager has made the stream.
+     */
+    aws_http_request_manager_on_stream_acquired_fn *callback;
+    /**
+     * Optional.
+     * User data for the callback.
+     */
+    void *user_data;
+    /* Required. see `aws_http_make_request_options` */
+    const struct aws_http_make_request_options *options;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Create a request manager. No connection is made until the first stream is acquired.
+ */
+AWS_HTTP_API
+struct aws_http_request_manager *aws_http_request_manager_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_request_manager_options *options);
+
+/**
+ * Acquire a refcount from the request manager, request manager will start to destroy after the refcount drops to
+ * zero. NULL is acceptable. Initial refcount after new is 1.
+ */
+AWS_HTTP_API
+struct aws_http_request_manager *aws_http_request_manager_acquire(struct aws_http_request_manager *manager);
+
+/**
+ * Release a refcount from the request manager, request manager will start to destroy after the refcount drops to
+ * zero. NULL is acceptable.
+ */
+AWS_HTTP_API
+struct aws_http_request_manager *aws_http_request_manager_release(struct aws_http_request_manager *manager);
+
+/**
+ * Make a request asynchronously, on an HTTP/2 connection shared with other streams if the endpoint speaks it,
+ * or on a pooled HTTP/1.1 connection otherwise.
+ *
+ * @param manager
+ * @param acquire_stream_options see `aws_http_request_manager_acquire_stream_options`
+ */
+AWS_HTTP_API
+void aws_http_request_manager_acquire_stream(
+    struct aws_http_request_manager *manager,
+    const struct aws_http_request_manager_acquire_stream_options *acquire_stream_options);
+
+/**
+ * Returns the protocol the endpoint negotiated: AWS_HTTP_VERSION_2, AWS_HTTP_VERSION_1_1,
+ * or AWS_HTTP_VERSION_UNKNOWN until the first connection is established.
+ */
+AWS_HTTP_API
+enum aws_http_version aws_http_request_manager_get_version(const struct aws_http_request_manager *manager);
+
+AWS_EXTERN_C_END
+AWS_POP_SANE_WARNING_LEVEL
+
+#endif /* AWS_HTTP_REQUEST_MANAGER_H */
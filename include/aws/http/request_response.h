@@ -13,6 +13,7 @@
 AWS_PUSH_SANE_WARNING_LEVEL
 
 struct aws_http_connection;
+struct aws_async_input_stream;
 struct aws_input_stream;
 
 /**
@@ -22,6 +23,13 @@ struct aws_input_stream;
  * In http/2, a push-promise stream can be sent by a server and received by a client.
  */
 struct aws_http_stream;
+struct aws_http_static_response;
+
+/**
+ * Keeps HTTP/1 body data alive after the on_incoming_body callback returns.
+ * See aws_http1_stream_retain_incoming_body().
+ */
+struct aws_http1_incoming_body_ref;
 
 /**
  * Controls whether a header's strings may be compressed by encoding the index of
@@ -107,6 +115,15 @@ enum aws_http_header_block {
  */
 struct aws_http_message;
 
+/**
+ * A set of headers shared by many HTTP/1.1 requests,
+ * which are validated and encoded once, rather than every time a request is sent.
+ * Create requests from the template with aws_http_message_new_request_from_template().
+ *
+ * A template is immutable once created, and may be used from multiple threads.
+ */
+struct aws_http_message_template;
+
 /**
  * Function to invoke when a message transformation completes.
  * This function MUST be invoked or the application will soft-lock.
@@ -164,7 +181,8 @@ typedef int(aws_http_on_incoming_header_block_done_fn)(
 
 /**
  * Called repeatedly as body data is received.
- * The data must be copied immediately if you wish to preserve it.
+ * The data must be copied immediately if you wish to preserve it,
+ * or retained with aws_http1_stream_retain_incoming_body() on HTTP/1 streams.
  * This is always invoked on the HTTP connection's event-loop thread.
  *
  * Note that, if the connection is using manual_window_management then the window
@@ -230,6 +248,48 @@ struct aws_http_stream_metrics {
 
     /* The stream-id on the connection when this stream was activated. */
     uint32_t stream_id;
+
+    /* The time stamp when the stream was queued: when aws_http_stream_activate() was called, or when
+     * aws_http2_stream_manager_acquire_stream() was called if the stream came from a stream manager.
+     * -1 means data not available. Timestamp are from `aws_high_res_clock_get_ticks` */
+    int64_t queue_start_timestamp_ns;
+    /* The time duration the stream waited before it started to be encoded (send_start_timestamp_ns -
+     * queue_start_timestamp_ns). This covers waiting for a connection, waiting behind other requests on an
+     * HTTP/1 connection, and waiting for HTTP/2 concurrency. -1 means data not available. */
+    int64_t queue_duration_ns;
+
+    /* Client only. The time duration from start encoding the request to receiving the first byte of the response
+     * (receive_start_timestamp_ns - send_start_timestamp_ns). -1 means data not available. */
+    int64_t time_to_first_byte_ns;
+    /* Client only. The time duration from start encoding the request to receiving the complete main header block of
+     * the response. -1 means data not available. */
+    int64_t time_to_headers_done_ns;
+
+    /* HTTP/2 only. The total time duration the stream had body data to send, but was stalled waiting for the peer
+     * to open its flow-control window. 0 for HTTP/1 */
+    int64_t flow_control_stalled_duration_ns;
+
+    /* Bytes of the outgoing and incoming messages as they were transferred on the connection.
+     * For HTTP/1 this is the whole message, including chunked encoding.
+     * For HTTP/2 this is the HPACK-encoded header blocks plus the DATA frame payloads. */
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+
+    /* Size of the header blocks, before and after encoding.
+     * The plain size is the sum of every header's name and value length for HTTP/2,
+     * and the encoded size is the HPACK-compressed size.
+     * HTTP/1 headers are not compressed, so both sizes are the size of the message head. */
+    uint64_t header_bytes_sent;
+    uint64_t header_bytes_sent_encoded;
+    uint64_t header_bytes_received;
+    uint64_t header_bytes_received_encoded;
+
+    /* The number of streams the connection carried before this one. 0 means this is the connection's first stream */
+    uint32_t connection_reuse_count;
+
+    /* The number of earlier attempts at this request the server never processed, which this stream replays.
+     * 0 for a first attempt. See `aws_http2_stream_manager_options.max_unprocessed_stream_retries` */
+    uint32_t retry_count;
 };
 
 /**
@@ -243,6 +303,165 @@ typedef void(aws_http_on_stream_metrics_fn)(
     const struct aws_http_stream_metrics *metrics,
     void *user_data);
 
+/**
+ * Default urgency of an HTTP/2 stream (RFC-9218 4.1).
+ */
+#define AWS_HTTP2_PRIORITY_URGENCY_DEFAULT (3)
+
+/**
+ * Least urgent value for an HTTP/2 stream's urgency. 0 is the most urgent.
+ */
+#define AWS_HTTP2_PRIORITY_URGENCY_MAX (7)
+
+/**
+ * Controls how an HTTP/2 stream's outgoing DATA is scheduled, relative to other streams on the same connection.
+ * The parameters are those of RFC-9218 (Extensible Prioritization Scheme for HTTP).
+ */
+struct aws_http2_stream_priority {
+    /**
+     * 0 (most urgent) to AWS_HTTP2_PRIORITY_URGENCY_MAX (least urgent).
+     * A stream only sends DATA when no more urgent stream has DATA ready to send.
+     */
+    uint8_t urgency;
+
+    /**
+     * If true, the stream takes turns sending DATA with other streams of the same urgency.
+     * If false, the stream keeps sending its DATA until it runs out or stalls,
+     * before streams of the same urgency that come after it get a turn.
+     */
+    bool incremental;
+};
+
+/**
+ * Decodes a response body's Content-Encoding (RFC-9110 8.4), for aws_http_content_decoding_options.
+ * The library has no codecs of its own: gzip, deflate, brotli, zstd, etc are provided by the user.
+ */
+struct aws_http_content_decoder {
+    const struct aws_http_content_decoder_vtable *vtable;
+    void *impl;
+};
+
+struct aws_http_content_decoder_vtable {
+    /**
+     * Decode as much of `input` as fits in the remaining capacity of `output`,
+     * advancing `input` past the encoded data consumed.
+     * This is also called with empty `input` to collect output the decoder is still holding,
+     * until a call leaves space in `output`.
+     * Raise an error if the encoded data is invalid.
+     */
+    int (*decode)(
+        struct aws_http_content_decoder *decoder,
+        struct aws_byte_cursor *input,
+        struct aws_byte_buf *output);
+
+    /**
+     * Invoked after all of the body has been decoded.
+     * Raise an error if the encoded data ended early.
+     */
+    int (*finish)(struct aws_http_content_decoder *decoder);
+
+    void (*destroy)(struct aws_http_content_decoder *decoder);
+};
+
+/**
+ * Invoked when a response's main header block specifies a Content-Encoding.
+ * `content_coding` is the Content-Encoding value, or comma-separated values if the header appeared more than once.
+ * Set `out_decoder` to decode the body, or leave it NULL to receive the body as-is.
+ * Return AWS_OP_ERR to fail the stream.
+ */
+typedef int(aws_http_content_decoder_new_fn)(
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor content_coding,
+    void *user_data,
+    struct aws_http_content_decoder **out_decoder);
+
+/**
+ * Options for decoding response bodies.
+ * When a decoder is created, on_response_body receives decoded data.
+ * Response headers are reported as received, Content-Encoding and Content-Length still describe the encoded body.
+ *
+ * With manual window management, the stream's window measures decoded bytes.
+ * Encoded data is read no faster than the window allows, but one read's worth may decode to more than the window.
+ * Any excess is deducted from later aws_http_stream_update_window() calls, so the total stays within the window.
+ */
+struct aws_http_content_decoding_options {
+    /**
+     * Value for the request's Accept-Encoding header, such as "gzip, br".
+     * Optional. If set, and the request has no Accept-Encoding header, one is added to the request.
+     */
+    struct aws_byte_cursor accept_encoding;
+
+    /**
+     * Creates the decoder for each response with a Content-Encoding.
+     * Required.
+     */
+    aws_http_content_decoder_new_fn *new_decoder;
+
+    void *user_data;
+};
+
+/**
+ * Encodes a request body for its Content-Encoding, for aws_http_content_encoding_options.
+ * As with decoders, the codecs themselves are provided by the user.
+ */
+struct aws_http_content_encoder {
+    const struct aws_http_content_encoder_vtable *vtable;
+    void *impl;
+};
+
+struct aws_http_content_encoder_vtable {
+    /**
+     * Encode as much of `input` as possible into the remaining capacity of `output`,
+     * advancing `input` past the data consumed.
+     * The encoder may consume input without producing output yet.
+     */
+    int (*encode)(
+        struct aws_http_content_encoder *encoder,
+        struct aws_byte_cursor *input,
+        struct aws_byte_buf *output);
+
+    /**
+     * Invoked after all of the body has been passed to encode().
+     * Write the rest of the encoded data into the remaining capacity of `output`,
+     * and set `out_done` once it's all written. This is called again while `out_done` is false.
+     */
+    int (*finish)(struct aws_http_content_encoder *encoder, struct aws_byte_buf *output, bool *out_done);
+
+    void (*destroy)(struct aws_http_content_encoder *encoder);
+};
+
+/**
+ * Invoked once per request, to create the encoder for its body.
+ * Set `out_encoder` and return AWS_OP_SUCCESS, or return AWS_OP_ERR to fail the request.
+ */
+typedef int(aws_http_content_encoder_new_fn)(
+    struct aws_allocator *allocator,
+    void *user_data,
+    struct aws_http_content_encoder **out_encoder);
+
+/**
+ * Options for encoding a request body as it's sent.
+ * A Content-Encoding header with `content_coding` is sent, and the request's Content-Length header is left out,
+ * since the encoded length isn't known in advance. HTTP/1.1 sends the encoded body with chunked encoding.
+ * The request itself is not modified, so it may be sent again.
+ * The request must have a body stream, and must not already have a Content-Encoding or Transfer-Encoding header.
+ */
+struct aws_http_content_encoding_options {
+    /**
+     * Value for the request's Content-Encoding header, such as "gzip".
+     * Required.
+     */
+    struct aws_byte_cursor content_coding;
+
+    /**
+     * Creates the encoder for the request body.
+     * Required.
+     */
+    aws_http_content_encoder_new_fn *new_encoder;
+
+    void *user_data;
+};
+
 /**
  * Options for creating a stream which sends a request from the client and receives a response from the server.
  */
@@ -315,6 +534,40 @@ struct aws_http_make_request_options {
      * TODO: Only supported in HTTP/1.1 now, support it in HTTP/2
      */
     uint64_t response_first_byte_timeout_ms;
+
+    /**
+     * Optional (ignored if 0).
+     * If the request isn't sent and its response fully received within N milliseconds of the stream being activated,
+     * then fail with AWS_ERROR_HTTP_REQUEST_TIMEOUT.
+     * An HTTP/1.1 connection can't abandon a request mid-flight, so the connection is closed.
+     * TODO: Only supported in HTTP/1.1 now, support it in HTTP/2
+     */
+    uint64_t request_timeout_ms;
+
+    /**
+     * Optional.
+     * Decode the response body's Content-Encoding, see `aws_http_content_decoding_options`.
+     * The options are copied.
+     * Only supported in HTTP/1.1. On an HTTP/2 connection, making the request fails with
+     * AWS_ERROR_HTTP_UNSUPPORTED_PROTOCOL.
+     */
+    const struct aws_http_content_decoding_options *content_decoding;
+
+    /**
+     * Optional.
+     * Encode the request body as it's sent, see `aws_http_content_encoding_options`.
+     */
+    const struct aws_http_content_encoding_options *content_encoding;
+
+    /**
+     * Optional (ignored for HTTP/1).
+     * Priority of this request's outgoing DATA on its HTTP/2 connection.
+     * If not set, the stream has urgency AWS_HTTP2_PRIORITY_URGENCY_DEFAULT and is incremental,
+     * so streams that don't set a priority take turns sending DATA.
+     * This only affects the order in which this side sends DATA,
+     * it is not signaled to the peer.
+     */
+    const struct aws_http2_stream_priority *http2_priority;
 };
 
 struct aws_http_request_handler_options {
@@ -454,6 +707,16 @@ struct aws_http1_chunk_options {
      * User provided data passed to the on_complete callback on its invocation.
      */
     void *user_data;
+
+    /**
+     * Optional alternative to `chunk_data`, for sending caller-owned memory without copying it.
+     * If set, `chunk_data` must be NULL and `chunk_data_size` must equal `zero_copy_data.len`.
+     *
+     * The memory is NOT copied: it is handed to the channel as its own aws_io_message.
+     * It must remain valid and unchanged until on_complete is invoked,
+     * which only happens once the channel is done with it.
+     */
+    struct aws_byte_cursor zero_copy_data;
 };
 
 /**
@@ -498,6 +761,16 @@ struct aws_http2_stream_write_data_options {
      * User provided data passed to the on_complete callback on its invocation.
      */
     void *user_data;
+
+    /**
+     * Send data directly from caller-owned memory, instead of copying it out of the `data` input stream.
+     * Optional.
+     * If set, `data` must be NULL.
+     * Each DATA frame's payload is handed to the channel as a slice of this memory,
+     * so it must remain valid and unchanged until `on_complete` is invoked.
+     * `on_complete` is not invoked until the channel is done with the last slice.
+     */
+    struct aws_byte_cursor zero_copy_data;
 };
 
 #define AWS_HTTP_REQUEST_HANDLER_OPTIONS_INIT                                                                          \
@@ -527,6 +800,18 @@ bool aws_http_header_name_eq(struct aws_byte_cursor name_a, struct aws_byte_curs
 AWS_HTTP_API
 struct aws_http_headers *aws_http_headers_new(struct aws_allocator *allocator);
 
+/**
+ * Create a new headers object in arena mode.
+ * Rather than making an allocation for each header's name and value, storage is bump-allocated
+ * from large blocks, which are all freed when the object is deleted.
+ * This means far fewer calls to the allocator, but memory used by erased headers is not reclaimed
+ * until aws_http_headers_clear() is called, or the object is deleted.
+ * Pass 0 for `block_size` to use a default size for the first block.
+ * The caller has a hold on the object and must call aws_http_headers_release() when they are done with it.
+ */
+AWS_HTTP_API
+struct aws_http_headers *aws_http_headers_new_with_arena(struct aws_allocator *allocator, size_t block_size);
+
 /**
  * Acquire a hold on the object, preventing it from being deleted until
  * aws_http_headers_release() is called by all those with a hold on it.
@@ -729,6 +1014,66 @@ int aws_http2_headers_set_response_status(struct aws_http_headers *h2_headers, i
 AWS_HTTP_API
 struct aws_http_message *aws_http_message_new_request(struct aws_allocator *allocator);
 
+/**
+ * Like aws_http_message_new_request(), but its headers are created in arena mode.
+ * See aws_http_headers_new_with_arena().
+ */
+AWS_HTTP_API
+struct aws_http_message *aws_http_message_new_request_with_arena(struct aws_allocator *allocator);
+
+/**
+ * Create a new request template, containing copies of these headers.
+ * The headers are validated now, and encoded for HTTP/1.1 so that requests from the template
+ * can skip this work when they're sent.
+ *
+ * Content-Length and Transfer-Encoding headers are not allowed in a template,
+ * since they depend on each request's body. Raises AWS_ERROR_HTTP_INVALID_HEADER_FIELD if present.
+ *
+ * The caller has a hold on the object and must call aws_http_message_template_release() when they are done with it.
+ */
+AWS_HTTP_API
+struct aws_http_message_template *aws_http_message_template_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_headers *headers);
+
+/**
+ * Acquire a hold on the template, preventing it from being deleted until
+ * aws_http_message_template_release() is called by all those with a hold on it.
+ *
+ * This function returns the passed in template (possibly NULL) so that acquire-and-assign can be done with a single
+ * statement.
+ */
+AWS_HTTP_API
+struct aws_http_message_template *aws_http_message_template_acquire(
+    struct aws_http_message_template *message_template);
+
+/**
+ * Release a hold on the template.
+ * The template is deleted when all holds on it are released.
+ * Requests created from the template keep a hold on it.
+ *
+ * This function always returns NULL so that release-and-assign-NULL can be done with a single statement.
+ */
+AWS_HTTP_API
+struct aws_http_message_template *aws_http_message_template_release(
+    struct aws_http_message_template *message_template);
+
+/**
+ * Create a new HTTP/1.1 request message, whose headers start out as a copy of the template's headers.
+ * The method and path must be set individually, and further headers may be added as usual.
+ *
+ * The request's headers are in arena mode (see aws_http_headers_new_with_arena()),
+ * and copying the template's headers costs little more than a memcpy.
+ * When sent over HTTP/1.1, the template's pre-encoded header lines are used,
+ * so long as none of the template's headers have been modified, erased, or had headers inserted before them.
+ *
+ * The caller has a hold on the object and must call aws_http_message_release() when they are done with it.
+ */
+AWS_HTTP_API
+struct aws_http_message *aws_http_message_new_request_from_template(
+    struct aws_allocator *allocator,
+    struct aws_http_message_template *message_template);
+
 /**
  * Like aws_http_message_new_request(), but uses existing aws_http_headers instead of creating a new one.
  * Acquires a hold on the headers, and releases it when the request is destroyed.
@@ -874,6 +1219,49 @@ struct aws_input_stream *aws_http_message_get_body_stream(const struct aws_http_
 AWS_HTTP_API
 void aws_http_message_set_body_stream(struct aws_http_message *message, struct aws_input_stream *body_stream);
 
+/**
+ * Get the async body stream.
+ * Returns NULL if no async body stream is set.
+ */
+AWS_HTTP_API
+struct aws_async_input_stream *aws_http_message_get_body_async_stream(const struct aws_http_message *message);
+
+/**
+ * Set a body stream that reads asynchronously, for a body that comes from disk or from another network call.
+ * A connection never blocks its event-loop thread reading this stream. It reads ahead one read at a time,
+ * and while a read is in progress it gets on with other work, picking the body up again once the read completes.
+ * An aws_input_stream body is read synchronously on the event-loop thread, stalling every connection on it.
+ *
+ * A message has one body: setting a non-NULL async body stream releases any body stream set by
+ * aws_http_message_set_body_stream(), and vice versa.
+ * NULL is an acceptable value for messages with no body.
+ * The message acquires a reference to the stream, which is released when the message is destroyed.
+ *
+ * HTTP/1.1 messages need a Content-Length header, or "Transfer-Encoding: chunked" to send the stream as chunks.
+ */
+AWS_HTTP_API
+void aws_http_message_set_body_async_stream(
+    struct aws_http_message *message,
+    struct aws_async_input_stream *body_stream);
+
+/**
+ * Create a body stream that reads `length` bytes of an open file, starting at `offset`.
+ * The stream does NOT take ownership of the file descriptor, which must stay open until the stream is destroyed.
+ * Reads don't move the file's seek position.
+ *
+ * On plaintext HTTP/1 connections, a Content-Length body from this stream is sent straight from the file
+ * to the socket, without being copied through userspace, where the platform supports it (Linux sendfile()).
+ * Otherwise the stream is read like any other aws_input_stream.
+ *
+ * Returns NULL and raises AWS_ERROR_UNSUPPORTED_OPERATION on platforms without file descriptors.
+ */
+AWS_HTTP_API
+struct aws_input_stream *aws_http_body_stream_new_from_fd(
+    struct aws_allocator *allocator,
+    int fd,
+    uint64_t offset,
+    uint64_t length);
+
 /**
  * aws_future<aws_http_message*>
  */
@@ -950,6 +1338,33 @@ AWS_HTTP_API int aws_http1_stream_add_chunked_trailer(
     struct aws_http_stream *http1_stream,
     const struct aws_http_headers *trailing_headers);
 
+/**
+ * Keep body data from the `on_incoming_body` callback valid after the callback returns, without copying it.
+ * This may only be called from within the stream's `on_incoming_body` callback, with a copy of the `data` cursor
+ * it was given. On return, `data` points to memory that stays valid until the returned reference is released
+ * with aws_http1_incoming_body_ref_release().
+ *
+ * Usually the data is left in the aws_io_message it arrived in and `data` is unchanged.
+ * If the data isn't in a message (ex: small chunks combined by the decoder), it is copied once and
+ * `data` is updated to point at the copy.
+ *
+ * Retained bytes count against the connection's read window. If the connection uses manual window management,
+ * it stops reading from the socket while too much body data is retained.
+ *
+ * Returns NULL and raises an error on failure.
+ * AWS_ERROR_INVALID_STATE is raised if this isn't an HTTP/1 stream, or if called outside `on_incoming_body`.
+ */
+AWS_HTTP_API struct aws_http1_incoming_body_ref *aws_http1_stream_retain_incoming_body(
+    struct aws_http_stream *http1_stream,
+    struct aws_byte_cursor *data);
+
+/**
+ * Release body data kept alive by aws_http1_stream_retain_incoming_body().
+ * This may be called from any thread. The memory is freed on the connection's event-loop thread.
+ * Passing NULL is a no-op.
+ */
+AWS_HTTP_API void aws_http1_incoming_body_ref_release(struct aws_http1_incoming_body_ref *ref);
+
 /**
  *
  * This datastructure has more functions for inspecting and modifying headers than
@@ -1092,6 +1507,38 @@ int aws_http_stream_get_incoming_request_uri(const struct aws_http_stream *strea
 AWS_HTTP_API
 int aws_http_stream_send_response(struct aws_http_stream *stream, struct aws_http_message *response);
 
+/**
+ * Validate and serialize a response once, so it can be sent any number of times
+ * (ex: a 204 for health checks, a 404, a redirect) without building and validating a message per request.
+ *
+ * The response may have a body stream (but not an async one), which is read in full during this call,
+ * in which case it needs a Content-Length header. Chunked encoding is not allowed.
+ * The response message is not referenced after this call.
+ *
+ * The result is immutable and ref-counted, so any thread may use it. Release it when done.
+ * Currently only HTTP/1.1 connections can send it.
+ */
+AWS_HTTP_API
+struct aws_http_static_response *aws_http_static_response_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *response);
+
+AWS_HTTP_API
+struct aws_http_static_response *aws_http_static_response_acquire(struct aws_http_static_response *response);
+
+AWS_HTTP_API
+void aws_http_static_response_release(struct aws_http_static_response *response);
+
+/**
+ * Like aws_http_stream_send_response(), but sends a response serialized ahead of time.
+ * The stream keeps the static response alive as long as it needs it.
+ * Raises AWS_ERROR_HTTP_UNSUPPORTED_PROTOCOL if the connection isn't HTTP/1.1.
+ */
+AWS_HTTP_API
+int aws_http_stream_send_static_response(
+    struct aws_http_stream *stream,
+    struct aws_http_static_response *response);
+
 /**
  * Increment the stream's flow-control window to keep data flowing.
  *
@@ -0,0 +1,152 @@
+#ifndef AWS_HTTP_RESPONSE_CACHE_H
+#define AWS_HTTP_RESPONSE_CACHE_H
+
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/http.h>
+
+AWS_PUSH_SANE_WARNING_LEVEL
+
+struct aws_http_headers;
+struct aws_http_message;
+
+/**
+ * An in-memory cache of responses to GET requests, which follows the rules for a private cache in RFC 9111.
+ *
+ * The cache doesn't make requests itself, whoever makes them consults it:
+ * - Before making a GET, look it up with aws_http_response_cache_lookup().
+ *   If the cached response is fresh, use it instead of making the request.
+ *   If it's stale, add its validators to the request with aws_http_cached_response_add_validators(),
+ *   and if the server answers 304 (Not Modified), pass that response's headers to
+ *   aws_http_response_cache_update() and use the cached response it returns.
+ * - Once a complete response arrives, offer it with aws_http_response_cache_store().
+ *   Responses that mustn't be stored (no-store, Vary: *, etc.) are ignored,
+ *   and successful responses to unsafe methods (POST, PUT, DELETE, etc.) evict what's cached for their URI.
+ *
+ * The cache is split into shards by URI, each with its own lock and least-recently-used list,
+ * so lookups of different URIs rarely contend. Each shard holds an equal part of max_bytes,
+ * and evicts its least recently used responses to stay within it.
+ *
+ * The cache is ref-counted and any thread may use it.
+ */
+struct aws_http_response_cache;
+
+/**
+ * A cached response. It never changes, revalidation makes a new one, which shares the same body.
+ * It's ref-counted, so one that's in use stays valid after it's evicted or replaced.
+ */
+struct aws_http_cached_response;
+
+struct aws_http_response_cache_options {
+    /**
+     * Required.
+     * The most bytes of responses (headers and bodies) the cache holds.
+     * A response bigger than its share of one shard (max_bytes / 8) is never stored.
+     */
+    size_t max_bytes;
+};
+
+enum aws_http_response_cache_lookup_result {
+    /* Nothing usable is cached, make the request */
+    AWS_HTTP_RESPONSE_CACHE_MISS,
+    /* The cached response may be used as is */
+    AWS_HTTP_RESPONSE_CACHE_FRESH,
+    /* The cached response may be used once the server says it's still valid, see aws_http_response_cache_update() */
+    AWS_HTTP_RESPONSE_CACHE_STALE,
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Create a cache. Returns NULL and raises AWS_ERROR_INVALID_ARGUMENT if max_bytes is zero.
+ */
+AWS_HTTP_API
+struct aws_http_response_cache *aws_http_response_cache_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_response_cache_options *options);
+
+AWS_HTTP_API
+struct aws_http_response_cache *aws_http_response_cache_acquire(struct aws_http_response_cache *cache);
+
+AWS_HTTP_API
+void aws_http_response_cache_release(struct aws_http_response_cache *cache);
+
+/**
+ * Look up the cached response to a request.
+ * Unless the result is AWS_HTTP_RESPONSE_CACHE_MISS, out_response is set, and the caller must release it.
+ * The request's own Cache-Control (no-store, no-cache, max-age) is honored.
+ */
+AWS_HTTP_API
+enum aws_http_response_cache_lookup_result aws_http_response_cache_lookup(
+    struct aws_http_response_cache *cache,
+    const struct aws_http_message *request,
+    struct aws_http_cached_response **out_response);
+
+/**
+ * Offer a complete response to the cache. It's copied if it may be stored, and ignored otherwise.
+ * Returns AWS_OP_ERR only if something went wrong storing it.
+ */
+AWS_HTTP_API
+int aws_http_response_cache_store(
+    struct aws_http_response_cache *cache,
+    const struct aws_http_message *request,
+    int status_code,
+    const struct aws_http_headers *response_headers,
+    struct aws_byte_cursor body);
+
+/**
+ * The server answered a revalidation of `stale_response` with 304 (Not Modified).
+ * Returns the cached response refreshed with the 304's headers, which replaces the stale one in the cache.
+ * The caller must release it. Returns NULL if something went wrong.
+ */
+AWS_HTTP_API
+struct aws_http_cached_response *aws_http_response_cache_update(
+    struct aws_http_response_cache *cache,
+    struct aws_http_cached_response *stale_response,
+    const struct aws_http_headers *not_modified_headers);
+
+/**
+ * Bytes of responses currently held, across all shards.
+ */
+AWS_HTTP_API
+size_t aws_http_response_cache_get_size(const struct aws_http_response_cache *cache);
+
+AWS_HTTP_API
+struct aws_http_cached_response *aws_http_cached_response_acquire(struct aws_http_cached_response *response);
+
+AWS_HTTP_API
+void aws_http_cached_response_release(struct aws_http_cached_response *response);
+
+AWS_HTTP_API
+int aws_http_cached_response_get_status(const struct aws_http_cached_response *response);
+
+/**
+ * The response's headers. They live as long as the response.
+ */
+AWS_HTTP_API
+const struct aws_http_headers *aws_http_cached_response_get_headers(const struct aws_http_cached_response *response);
+
+/**
+ * The response's body. It lives as long as the response.
+ */
+AWS_HTTP_API
+struct aws_byte_cursor aws_http_cached_response_get_body(const struct aws_http_cached_response *response);
+
+/**
+ * Add conditional headers to a request that revalidates this response:
+ * If-None-Match from its ETag, and If-Modified-Since from its Last-Modified.
+ * Returns AWS_OP_ERR and raises AWS_ERROR_HTTP_HEADER_NOT_FOUND if the response has neither,
+ * in which case the request can't be conditional, and a 200 replaces the response instead.
+ */
+AWS_HTTP_API
+int aws_http_cached_response_add_validators(
+    const struct aws_http_cached_response *response,
+    struct aws_http_message *request);
+
+AWS_EXTERN_C_END
+AWS_POP_SANE_WARNING_LEVEL
+
+#endif /* AWS_HTTP_RESPONSE_CACHE_H */
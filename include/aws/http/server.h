@@ -14,6 +14,7 @@ struct aws_http_connection;
 struct aws_server_bootstrap;
 struct aws_socket_options;
 struct aws_tls_connection_options;
+struct aws_http_traffic_capture_options;
 /**
  * A listening socket which accepts incoming HTTP connections,
  * creating a server-side aws_http_connection to handle each one.
@@ -29,6 +30,36 @@ typedef void(aws_http_server_on_incoming_connection_fn)(
 
 typedef void(aws_http_server_on_destroy_fn)(void *user_data);
 
+/**
+ * Admission control, for shedding load once the server is saturated rather than letting throughput collapse.
+ * Every limit is optional, 0 means no limit.
+ */
+struct aws_http_server_admission_options {
+    /**
+     * Incoming connections beyond this many open connections are closed as soon as they're accepted,
+     * before any HTTP processing happens. on_incoming_connection is invoked with AWS_ERROR_HTTP_SERVER_OVERLOADED.
+     */
+    size_t max_connections;
+
+    /**
+     * Once this many requests are in flight across the whole server, new requests are shed.
+     * A request is in flight from on_incoming_request until its stream completes.
+     */
+    size_t max_in_flight_streams;
+
+    /**
+     * Once an event loop runs this far behind, new connections on it are turned away and new requests are shed.
+     * Lag is how late a periodic task on each event loop runs.
+     */
+    uint64_t max_event_loop_lag_ms;
+
+    /**
+     * Value of the Retry-After header in responses to shed requests.
+     * If 0, no Retry-After header is sent.
+     */
+    uint32_t retry_after_sec;
+};
+
 /**
  * Options for creating an HTTP server.
  * Initialize with AWS_HTTP_SERVER_OPTIONS_INIT to set default values.
@@ -106,6 +137,64 @@ struct aws_http_server_options {
      * reaches 0, no further data will be received.
      **/
     bool manual_window_management;
+
+    /**
+     * Set to true to listen with one socket per event loop in the bootstrap's event loop group, instead of one.
+     * Optional.
+     *
+     * The sockets share the endpoint via SO_REUSEPORT, so the kernel load-balances incoming connections across them,
+     * and each connection stays on the event loop whose socket accepted it. This keeps a single accepting event loop
+     * from becoming the bottleneck when many connections are coming in.
+     *
+     * Requires an IPv4 or IPv6 endpoint, and a platform with SO_REUSEPORT.
+     * Otherwise aws_http_server_new() fails with AWS_ERROR_INVALID_ARGUMENT or AWS_ERROR_PLATFORM_NOT_SUPPORTED.
+     */
+    bool listener_per_event_loop;
+
+    /**
+     * Optional.
+     * If set, the server sheds load once any of these limits is reached.
+     * A shed HTTP/1 request gets a "503 Service Unavailable" response without on_incoming_request being invoked.
+     * A shed HTTP/2 stream is reset with REFUSED_STREAM, and the connection is sent a graceful GOAWAY.
+     * Server makes a copy.
+     */
+    const struct aws_http_server_admission_options *admission_options;
+
+    /**
+     * Set to true to accept HTTP/2 "prior knowledge" connections on a cleartext server (h2c, RFC-7540 3.4).
+     * Optional, not allowed with tls_options (TLS negotiates HTTP/2 via ALPN).
+     *
+     * The server peeks at the first bytes each client sends. If they're the HTTP/2 connection preface,
+     * the connection is HTTP/2, otherwise it's HTTP/1.1. on_incoming_connection is invoked once this is known,
+     * which is after the client's first bytes arrive.
+     *
+     * An HTTP/1.1 request with "Upgrade: h2c" (RFC-7540 3.2) is processed like any other HTTP/1.1 request,
+     * the server doesn't switch protocols. The RFC permits this, the client carries on with HTTP/1.1.
+     */
+    bool accept_http2_prior_knowledge;
+
+    /**
+     * Optional.
+     * HTTP/1 connections are closed once they've gone this long with no request in progress.
+     * Idle connections are tracked in each event loop's shared timer wheel, not with a task per connection.
+     * If zero is specified (the default) idle connections are left open until the client closes them.
+     */
+    uint64_t idle_timeout_ms;
+
+    /**
+     * Optional.
+     * HTTP/1 connections are closed after responding to this many requests.
+     * Requests the client pipelined behind the last one are not processed, the client must retry them.
+     * If zero is specified (the default) there's no limit.
+     */
+    size_t max_requests_per_connection;
+
+    /**
+     * Optional.
+     * If set, each incoming connection's traffic is recorded to a file. See `aws_http_traffic_capture_options`.
+     * Server makes a copy.
+     */
+    const struct aws_http_traffic_capture_options *traffic_capture_options;
 };
 
 /**
@@ -185,6 +274,22 @@ struct aws_http_server *aws_http_server_new(const struct aws_http_server_options
 AWS_HTTP_API
 void aws_http_server_release(struct aws_http_server *server);
 
+/**
+ * Shut the server down gracefully, instead of releasing it with aws_http_server_release().
+ * The server stops listening right away, but lets the requests already in progress finish:
+ * - HTTP/1 connections with no request in progress close right away. Otherwise, the latest request becomes
+ *   the final one, its response gets a "Connection: close" header, and the connection closes once it's sent.
+ * - HTTP/2 connections send a graceful GOAWAY with the last stream processed,
+ *   and close once their active streams complete.
+ *
+ * Connections still open after `timeout_ms` are closed, their in-progress streams fail.
+ * If `timeout_ms` is 0, there's no deadline.
+ * As with aws_http_server_release(), on_destroy_complete is invoked once every connection has shut down.
+ * This counts as releasing the server, don't use it again.
+ */
+AWS_HTTP_API
+void aws_http_server_drain(struct aws_http_server *server, uint64_t timeout_ms);
+
 /**
  * Configure a server connection.
  * This must be called from the server's on_incoming_connection callback.
@@ -29,6 +29,22 @@ struct aws_crt_statistics_http1_channel {
 
     uint32_t current_outgoing_stream_id;
     uint32_t current_incoming_stream_id;
+
+    /* Bytes written and read by the connection, across all streams.
+     * Written bytes include file bodies sent directly to the socket */
+    uint64_t bytes_written;
+    uint64_t bytes_read;
+
+    /* Streams that completed, and how many of those completed with an error */
+    uint32_t streams_completed;
+    uint32_t streams_failed;
+
+    /* RST_STREAM frames, and PING and SETTINGS frames (not counting ACKs), received from the peer */
+    uint32_t stream_resets_received;
+    uint32_t control_frames_received;
+    /* True if the connection was closed with GOAWAY(ENHANCE_YOUR_CALM) because the peer sent those too fast.
+     * See aws_http2_connection_options.max_stream_resets_per_second. Carries over between reports */
+    bool flood_detected;
 };
 
 struct aws_crt_statistics_http2_channel {
@@ -39,10 +55,95 @@ struct aws_crt_statistics_http2_channel {
 
     /* True if during the time of report, there has ever been no active streams on the connection */
     bool was_inactive;
+
+    /* Number of io messages of encoded frames written to the channel */
+    uint64_t messages_written;
+    /* Bytes in those messages. Divide by message_capacity_written for how full messages were */
+    uint64_t bytes_written;
+    uint64_t message_capacity_written;
+    /* DATA payload bytes written straight from the user's buffers, after the frame headers in bytes_written */
+    uint64_t zero_copy_bytes_written;
+    /* Bytes read from the channel */
+    uint64_t bytes_read;
+
+    /* Round trip time in nanoseconds, measured by PINGs on this connection (including the stream manager's).
+     * Smoothed and variance are computed as in RFC-6298. All are 0 until the first PING ACK arrives.
+     * These carry over between reports */
+    uint64_t smoothed_rtt_ns;
+    uint64_t min_rtt_ns;
+    uint64_t rtt_variance_ns;
+
+    /* Connection flow-control windows at the time of report */
+    uint64_t window_size_peer;
+    uint64_t window_size_self;
+
+    /* Number of streams waiting on the peer's connection window at the time of report */
+    uint32_t stalled_window_stream_count;
+
+    /* Streams that completed, and how many of those completed with an error */
+    uint32_t streams_completed;
+    uint32_t streams_failed;
+
+    /* RST_STREAM frames, and PING and SETTINGS frames (not counting ACKs), received from the peer */
+    uint32_t stream_resets_received;
+    uint32_t control_frames_received;
+    /* True if the connection was closed with GOAWAY(ENHANCE_YOUR_CALM) because the peer sent those too fast.
+     * See aws_http2_connection_options.max_stream_resets_per_second. Carries over between reports */
+    bool flood_detected;
+};
+
+/**
+ * Number of buckets in an aws_http_latency_histogram.
+ * Buckets are log-linear, four per power of two, covering 0 to about 2.4 hours in microseconds.
+ */
+#define AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT 128
+
+/**
+ * A histogram of durations, in microseconds.  Percentiles read from it are accurate to within 25%.
+ * Zero it to initialize.
+ */
+struct aws_http_latency_histogram {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT];
 };
 
 AWS_EXTERN_C_BEGIN
 
+/**
+ * Records a duration, in microseconds, into a histogram
+ */
+AWS_HTTP_API
+void aws_http_latency_histogram_record(struct aws_http_latency_histogram *histogram, uint64_t value_us);
+
+/**
+ * Adds everything recorded in one histogram into another
+ */
+AWS_HTTP_API
+void aws_http_latency_histogram_merge(
+    struct aws_http_latency_histogram *histogram,
+    const struct aws_http_latency_histogram *other);
+
+/**
+ * Returns the duration, in microseconds, that the given percentile of recorded durations (0 to 100) don't exceed.
+ * Returns 0 if nothing has been recorded.
+ */
+AWS_HTTP_API
+uint64_t aws_http_latency_histogram_percentile(const struct aws_http_latency_histogram *histogram, double percentile);
+
+/**
+ * Returns the index of the bucket a duration, in microseconds, is counted in
+ */
+AWS_HTTP_API
+size_t aws_http_latency_histogram_bucket_index(uint64_t value_us);
+
+/**
+ * Returns the largest duration, in microseconds, counted in a bucket
+ */
+AWS_HTTP_API
+uint64_t aws_http_latency_histogram_bucket_upper_bound(size_t bucket_index);
+
 /**
  * Initializes a http channel handler statistics struct
  */
@@ -11,6 +11,7 @@ AWS_PUSH_SANE_WARNING_LEVEL
 
 struct aws_http_header;
 struct aws_http_message;
+struct aws_http2_stream_manager;
 
 /* TODO: Document lifetime stuff */
 /* TODO: Document CLOSE frame behavior (when auto-sent during close, when auto-closed) */
@@ -21,6 +22,24 @@ struct aws_http_message;
  */
 struct aws_websocket;
 
+/**
+ * A complete incoming TEXT or BINARY message, reassembled from its frames.
+ * See `aws_websocket_client_connection_options.on_incoming_message`.
+ */
+struct aws_websocket_incoming_message;
+
+/**
+ * A budget of memory for incoming messages, shared by many websockets.
+ * See `aws_websocket_client_connection_options.shared_read_budget`.
+ */
+struct aws_websocket_read_budget;
+
+/**
+ * A frame encoded once, ahead of time, which server websockets can send any number of times.
+ * See aws_websocket_encoded_frame_new().
+ */
+struct aws_websocket_encoded_frame;
+
 /**
  * Opcode describing the type of a websocket frame.
  * RFC-6455 Section 5.2
@@ -84,6 +103,185 @@ struct aws_websocket_incoming_frame {
     uint64_t payload_length;
     uint8_t opcode;
     bool fin;
+
+    /**
+     * True if this frame is part of a message compressed with permessage-deflate (RFC-7692).
+     * The payload is decompressed before it's passed to on_incoming_frame_payload,
+     * so `payload_length` is the compressed length, and the decompressed length is not known in advance.
+     */
+    bool compressed;
+};
+
+/**
+ * Parameters of the permessage-deflate extension (RFC-7692 Section 7.1), as agreed on in the opening handshake.
+ * A window_bits value of 0 means the parameter was not used, and the window may be as large as 32KiB (15 bits).
+ */
+struct aws_websocket_permessage_deflate_params {
+    /* The server resets its compression context after each message it sends */
+    bool server_no_context_takeover;
+
+    /* The client resets its compression context after each message it sends */
+    bool client_no_context_takeover;
+
+    /* Max LZ77 window, from 8 to 15 bits, that the server compresses with */
+    uint8_t server_max_window_bits;
+
+    /* Max LZ77 window, from 8 to 15 bits, that the client compresses with */
+    uint8_t client_max_window_bits;
+};
+
+/**
+ * Compresses outgoing messages for permessage-deflate.
+ * This library links no compression library, so the raw DEFLATE (RFC-1951) codec is provided by the user.
+ */
+struct aws_websocket_compressor {
+    const struct aws_websocket_compressor_vtable *vtable;
+    void *impl;
+};
+
+struct aws_websocket_compressor_vtable {
+    /**
+     * Compress as much of `input` as possible into the remaining capacity of `output`,
+     * advancing `input` past the data consumed.
+     * The compressor may consume input without producing output yet.
+     *
+     * If `flush` is true, once the input is consumed, write all pending output and
+     * end it on a byte boundary with an empty non-final stored block (zlib's Z_SYNC_FLUSH).
+     * This is called again with empty `input` until a call leaves space in `output`.
+     */
+    int (*compress)(
+        struct aws_websocket_compressor *compressor,
+        struct aws_byte_cursor *input,
+        struct aws_byte_buf *output,
+        bool flush);
+
+    /**
+     * Forget the LZ77 window, so the next message doesn't refer back to previous ones.
+     * Invoked between messages when "no_context_takeover" is in effect.
+     */
+    int (*reset)(struct aws_websocket_compressor *compressor);
+
+    void (*destroy)(struct aws_websocket_compressor *compressor);
+};
+
+/**
+ * Decompresses incoming messages for permessage-deflate.
+ */
+struct aws_websocket_decompressor {
+    const struct aws_websocket_decompressor_vtable *vtable;
+    void *impl;
+};
+
+struct aws_websocket_decompressor_vtable {
+    /**
+     * Decompress as much of `input` as fits in the remaining capacity of `output`,
+     * advancing `input` past the compressed data consumed.
+     * This is also called with empty `input` to collect output the decompressor is still holding,
+     * until a call leaves space in `output`.
+     * Raise an error if the compressed data is invalid.
+     */
+    int (*decompress)(
+        struct aws_websocket_decompressor *decompressor,
+        struct aws_byte_cursor *input,
+        struct aws_byte_buf *output);
+
+    /**
+     * Forget the LZ77 window, so the next message is decompressed from scratch.
+     * Invoked between messages when the peer uses "no_context_takeover".
+     */
+    int (*reset)(struct aws_websocket_decompressor *decompressor);
+
+    void (*destroy)(struct aws_websocket_decompressor *decompressor);
+};
+
+/**
+ * Invoked once the opening handshake agrees to use permessage-deflate.
+ * `window_bits` is the LZ77 window size to use, from 8 to 15.
+ * Set the out-param and return AWS_OP_SUCCESS, or return AWS_OP_ERR to fail the connection.
+ */
+typedef int(aws_websocket_compressor_new_fn)(
+    struct aws_allocator *allocator,
+    uint8_t window_bits,
+    void *user_data,
+    struct aws_websocket_compressor **out_compressor);
+
+typedef int(aws_websocket_decompressor_new_fn)(
+    struct aws_allocator *allocator,
+    uint8_t window_bits,
+    void *user_data,
+    struct aws_websocket_decompressor **out_decompressor);
+
+/**
+ * Called once per batch of outgoing frames, after the `on_complete` callback of each frame in the batch.
+ * A batch is all the frames that finished in one io message written to the socket.
+ * `num_frames` is the number of frames in the batch.
+ * error_code will be zero if the batch was written successfully.
+ *
+ * When sending many small frames, leave each frame's `on_complete` NULL and use this instead,
+ * so there's one callback per io message instead of one per frame.
+ * Invoked on the websocket's event-loop thread.
+ */
+typedef void(aws_websocket_on_outgoing_frames_complete_fn)(
+    struct aws_websocket *websocket,
+    size_t num_frames,
+    int error_code,
+    void *user_data);
+
+/**
+ * Options for the permessage-deflate extension (RFC-7692).
+ *
+ * A client offers the extension with these parameters in its Sec-WebSocket-Extensions header.
+ * If the server accepts, TEXT and BINARY messages are compressed, and the RSV1 bit marks compressed messages.
+ *
+ * A server uses these options with aws_websocket_permessage_deflate_negotiate() to answer a client's offer.
+ */
+struct aws_websocket_permessage_deflate_options {
+    /**
+     * Client: ask the server to reset its compression context after each message.
+     * Server: reset the compression context after each message, whether or not the client asked.
+     */
+    bool server_no_context_takeover;
+
+    /**
+     * Client: reset the compression context after each message.
+     * Server: require the client to reset its compression context after each message.
+     */
+    bool client_no_context_takeover;
+
+    /**
+     * Optional, 8 to 15, or 0 for no limit.
+     * Client: ask the server to use an LZ77 window no larger than this.
+     * Server: use an LZ77 window no larger than this.
+     */
+    uint8_t server_max_window_bits;
+
+    /**
+     * Optional, 8 to 15, or 0 for no limit.
+     * Client: use an LZ77 window no larger than this.
+     * Server: ask the client to use an LZ77 window no larger than this, if the client supports the parameter.
+     */
+    uint8_t client_max_window_bits;
+
+    /**
+     * Optional.
+     * Messages whose first frame is final and has a payload shorter than this are sent uncompressed.
+     * Compressing a tiny message usually makes it larger.
+     */
+    size_t compression_threshold;
+
+    /**
+     * Creates the compressor for outgoing messages.
+     * Required.
+     */
+    aws_websocket_compressor_new_fn *new_compressor;
+
+    /**
+     * Creates the decompressor for incoming messages.
+     * Required.
+     */
+    aws_websocket_decompressor_new_fn *new_decompressor;
+
+    void *user_data;
 };
 
 /**
@@ -116,6 +314,8 @@ typedef bool(aws_websocket_on_incoming_frame_begin_fn)(
  * The websocket automatically increments the window to account for any
  * other incoming bytes, including other parts of a frame (opcode, payload-length, etc)
  * and the payload of other frame types (PING, PONG, CLOSE).
+ * If the payload was compressed with permessage-deflate, the window shrinks by the decompressed size.
+ * One read may decompress to more than the window, and any excess is deducted from later window increments.
  *
  * Return true to proceed normally. If false is returned, the websocket will read no further data,
  * the frame will complete with an error-code, and the connection will close.
@@ -140,6 +340,21 @@ typedef bool(aws_websocket_on_incoming_frame_complete_fn)(
     int error_code,
     void *user_data);
 
+/**
+ * Called when a complete TEXT or BINARY message has arrived, after its final frame's payload.
+ * The message is only valid during the callback, unless aws_websocket_incoming_message_acquire() is called.
+ * Release each acquired reference with aws_websocket_incoming_message_release(), which returns the buffer
+ * to the websocket's pool for reuse.
+ * Invoked once per message on the websocket's event-loop thread.
+ *
+ * Return true to proceed normally. If false is returned, the websocket will read no further data
+ * and the connection will close.
+ */
+typedef bool(aws_websocket_on_incoming_message_fn)(
+    struct aws_websocket *websocket,
+    struct aws_websocket_incoming_message *message,
+    void *user_data);
+
 /**
  * Options for creating a websocket client connection.
  */
@@ -207,8 +422,9 @@ struct aws_websocket_client_connection_options {
 
     /**
      * Initial size of the websocket's read window.
-     * Ignored unless `manual_window_management` is true.
+     * Ignored unless `manual_window_management` is true, or a read budget is set.
      * Set to 0 to prevent any incoming websocket frames until aws_websocket_increment_read_window() is called.
+     * With a read budget, 0 means the default of 64KiB.
      */
     size_t initial_window_size;
 
@@ -288,6 +504,97 @@ struct aws_websocket_client_connection_options {
      * Host resolution override that allows the user to override DNS behavior for this particular connection.
      */
     const struct aws_host_resolution_config *host_resolution_config;
+
+    /**
+     * Optional.
+     * Offer the permessage-deflate extension, see `aws_websocket_permessage_deflate_options`.
+     * A Sec-WebSocket-Extensions header is added to the `handshake_request`, which must not already have one.
+     * If the server declines, the websocket is set up without compression.
+     * The options are copied.
+     */
+    const struct aws_websocket_permessage_deflate_options *permessage_deflate;
+
+    /**
+     * Optional.
+     * Batch outgoing frames into fewer, fuller io messages, to cut down on partially filled messages
+     * (and TLS records, and syscalls) when sending many small frames.
+     *
+     * If 0 (the default), a message is sent as soon as the queued frames have been written to it.
+     * Otherwise, a message holding fewer than this many bytes is held up to `write_batch_max_delay_ms`
+     * for more frames to join it. A message holding a CLOSE frame is always sent immediately.
+     * Messages never exceed the channel's max message size, so larger values just mean "full messages".
+     */
+    size_t write_batch_target_size;
+
+    /**
+     * Optional.
+     * Used with `write_batch_target_size`: the longest a message that's short of the target size is held back.
+     * If 0, messages are never held back, and only frames that are already queued share a message.
+     */
+    uint32_t write_batch_max_delay_ms;
+
+    /**
+     * Optional.
+     * Called once per batch of outgoing frames that were written to the socket in the same io message.
+     * See `aws_websocket_on_outgoing_frames_complete_fn`.
+     */
+    aws_websocket_on_outgoing_frames_complete_fn *on_outgoing_frames_complete;
+
+    /**
+     * Optional.
+     * If set, TEXT and BINARY messages are delivered whole via this callback, instead of piecemeal.
+     * Their frames' payloads are reassembled into buffers from a pool of power-of-2 size classes,
+     * and `on_incoming_frame_payload` is only invoked for control frames (PING, PONG, CLOSE).
+     * The frame "begin" and "complete" callbacks are still invoked for every frame.
+     * See `aws_websocket_on_incoming_message_fn`.
+     */
+    aws_websocket_on_incoming_message_fn *on_incoming_message;
+
+    /**
+     * Optional.
+     * Used with `on_incoming_message`: the largest message that will be reassembled.
+     * A bigger message fails the connection with AWS_ERROR_HTTP_WEBSOCKET_MESSAGE_TOO_BIG.
+     * If 0, the default is 16MiB.
+     */
+    size_t max_incoming_message_size;
+
+    /**
+     * Optional.
+     * If set, the websocket runs over a stream from this HTTP/2 stream manager,
+     * via an extended CONNECT request (RFC-8441), instead of getting a connection of its own.
+     * The `bootstrap`, `socket_options`, `tls_options`, `proxy_options`, `host`, `port`,
+     * `requested_event_loop`, and `host_resolution_config` options are ignored.
+     * The `handshake_request` is converted: the method becomes CONNECT with `:protocol: websocket`,
+     * and the HTTP/1.1-only headers (Upgrade, Connection, Sec-WebSocket-Key) are dropped,
+     * so it needn't have a Sec-WebSocket-Key.
+     * The server must send SETTINGS_ENABLE_CONNECT_PROTOCOL, or setup fails with
+     * AWS_ERROR_HTTP_EXTENDED_CONNECT_NOT_SUPPORTED.
+     * The websocket keeps the stream manager alive via ref-counting.
+     */
+    struct aws_http2_stream_manager *http2_stream_manager;
+
+    /**
+     * Optional.
+     * Manage the read window automatically, so a slow consumer can't make memory grow without bound.
+     * This is the most memory that messages delivered via `on_incoming_message`, but not yet released,
+     * may hold for this websocket.
+     *
+     * The read window is restored as soon as each payload is received, as long as the websocket is within budget.
+     * Once it's over budget, the window shrinks as data arrives (see aws_websocket_increment_read_window()),
+     * until enough messages are released (see aws_websocket_incoming_message_release()) to get back within budget.
+     *
+     * Requires `on_incoming_message`, and `manual_window_management` must be false.
+     * 0 means no per-websocket budget.
+     */
+    size_t read_budget;
+
+    /**
+     * Optional.
+     * Like `read_budget`, but shared by every websocket using it, for a limit across the whole process.
+     * Either or both budgets may be set.
+     * The websocket keeps the budget alive via ref-counting.
+     */
+    struct aws_websocket_read_budget *shared_read_budget;
 };
 
 /**
@@ -355,6 +662,30 @@ struct aws_websocket_send_frame_options {
     bool fin;
 };
 
+/**
+ * Options for sending a pre-encoded frame.
+ * This structure is copied immediately by aws_websocket_send_encoded_frame().
+ */
+struct aws_websocket_send_encoded_frame_options {
+    /**
+     * Required.
+     * The frame to send. The websocket holds a reference to it until the send completes.
+     */
+    struct aws_websocket_encoded_frame *encoded_frame;
+
+    /**
+     * User data passed to callbacks.
+     */
+    void *user_data;
+
+    /**
+     * Callback for completion of send operation.
+     * See `aws_websocket_outgoing_frame_complete_fn`.
+     * Optional.
+     */
+    aws_websocket_outgoing_frame_complete_fn *on_complete;
+};
+
 AWS_EXTERN_C_BEGIN
 
 /**
@@ -409,6 +740,64 @@ void aws_websocket_close(struct aws_websocket *websocket, bool free_scarce_resou
 AWS_HTTP_API
 int aws_websocket_send_frame(struct aws_websocket *websocket, const struct aws_websocket_send_frame_options *options);
 
+/**
+ * Encode a frame once, so the same frame can be sent on many websockets
+ * (ex: a pub/sub server fanning a message out to its subscribers) without encoding it or reading its payload again.
+ *
+ * The frame's header and payload are copied into one immutable buffer, which every send shares.
+ * The frame is always final (FIN set), so it's either a whole TEXT or BINARY message, or a control frame.
+ * It's never masked or compressed, so only server websockets may send it
+ * (RFC-6455 Section 5.1 says clients must mask every frame, RFC-7692 lets any message go uncompressed).
+ *
+ * The frame is ref-counted, with an initial count of 1. Any thread may use it.
+ * Returns NULL and raises AWS_ERROR_INVALID_ARGUMENT if the opcode is CONTINUATION or unknown,
+ * or a control frame's payload is longer than 125 bytes.
+ */
+AWS_HTTP_API
+struct aws_websocket_encoded_frame *aws_websocket_encoded_frame_new(
+    struct aws_allocator *allocator,
+    uint8_t opcode,
+    struct aws_byte_cursor payload);
+
+/**
+ * Increment the encoded frame's ref-count.
+ * Returns the same pointer that was passed in.
+ */
+AWS_HTTP_API
+struct aws_websocket_encoded_frame *aws_websocket_encoded_frame_acquire(struct aws_websocket_encoded_frame *frame);
+
+/**
+ * Decrement the encoded frame's ref-count.
+ * It is safe to pass NULL, nothing will happen.
+ */
+AWS_HTTP_API
+void aws_websocket_encoded_frame_release(struct aws_websocket_encoded_frame *frame);
+
+/**
+ * Send a pre-encoded frame, see aws_websocket_encoded_frame_new().
+ * The frame is queued with those from aws_websocket_send_frame(), and written out as is.
+ * Raises AWS_ERROR_UNSUPPORTED_OPERATION if this isn't a server websocket.
+ * A callback will be invoked when the operation completes.
+ * This function may be called from any thread.
+ */
+AWS_HTTP_API
+int aws_websocket_send_encoded_frame(
+    struct aws_websocket *websocket,
+    const struct aws_websocket_send_encoded_frame_options *options);
+
+/**
+ * Send a pre-encoded frame on each of `num_websockets` websockets, as if by aws_websocket_send_encoded_frame().
+ * A websocket that can't send it (ex: it's closed) is skipped, and on_complete isn't invoked for it.
+ * on_complete is invoked once for each other websocket, on that websocket's event-loop thread.
+ * Returns the number of websockets the frame was queued on.
+ * This function may be called from any thread.
+ */
+AWS_HTTP_API
+size_t aws_websocket_broadcast_encoded_frame(
+    struct aws_websocket *const *websockets,
+    size_t num_websockets,
+    const struct aws_websocket_send_encoded_frame_options *options);
+
 /**
  * Manually increment the read window to keep frames flowing.
  *
@@ -430,11 +819,65 @@ int aws_websocket_send_frame(struct aws_websocket *websocket, const struct aws_w
 AWS_HTTP_API
 void aws_websocket_increment_read_window(struct aws_websocket *websocket, size_t size);
 
+/**
+ * Create a read budget that many websockets can share, see `aws_websocket_client_connection_options.read_budget`.
+ * `max_bytes` is the most memory that delivered, but not yet released, incoming messages may hold
+ * across all the websockets before they're throttled.
+ * The budget is ref-counted, with an initial count of 1.
+ */
+AWS_HTTP_API
+struct aws_websocket_read_budget *aws_websocket_read_budget_new(struct aws_allocator *allocator, size_t max_bytes);
+
+/**
+ * Increment the read budget's ref-count.
+ * Returns the same pointer that was passed in.
+ */
+AWS_HTTP_API
+struct aws_websocket_read_budget *aws_websocket_read_budget_acquire(struct aws_websocket_read_budget *budget);
+
+/**
+ * Decrement the read budget's ref-count.
+ * It is safe to pass NULL, nothing will happen.
+ */
+AWS_HTTP_API
+void aws_websocket_read_budget_release(struct aws_websocket_read_budget *budget);
+
+/**
+ * Keep an incoming message valid after the `on_incoming_message` callback returns.
+ * Returns the same pointer that was passed in.
+ * This function may be called from any thread.
+ */
+AWS_HTTP_API
+struct aws_websocket_incoming_message *aws_websocket_incoming_message_acquire(
+    struct aws_websocket_incoming_message *message);
+
+/**
+ * Release a reference acquired with aws_websocket_incoming_message_acquire().
+ * Once the last reference is released, the buffer goes back to the websocket's pool.
+ * The message may outlive the websocket.
+ * This function may be called from any thread.
+ */
+AWS_HTTP_API
+void aws_websocket_incoming_message_release(struct aws_websocket_incoming_message *message);
+
+/**
+ * Returns the message's opcode, AWS_WEBSOCKET_OPCODE_TEXT or AWS_WEBSOCKET_OPCODE_BINARY.
+ */
+AWS_HTTP_API
+uint8_t aws_websocket_incoming_message_get_opcode(const struct aws_websocket_incoming_message *message);
+
+/**
+ * Returns the message's complete payload (decompressed, if permessage-deflate is in use).
+ */
+AWS_HTTP_API
+struct aws_byte_cursor aws_websocket_incoming_message_get_payload(const struct aws_websocket_incoming_message *message);
+
 /**
  * Convert the websocket into a mid-channel handler.
  * The websocket will stop being usable via its public API and become just another handler in the channel.
  * The caller will likely install a channel handler to the right.
- * This must not be called in the middle of an incoming frame (between "frame begin" and "frame complete" callbacks).
+ * This must not be called in the middle of an incoming frame (between "frame begin" and "frame complete" callbacks),
+ * or in the middle of an incoming message being reassembled for `on_incoming_message`.
  * This MUST be called from the websocket's thread.
  *
  * If successful:
@@ -449,6 +892,9 @@ void aws_websocket_increment_read_window(struct aws_websocket *websocket, size_t
  * - aws_websocket_release() must still be called or the websocket and its channel will never be cleaned up.
  * - The websocket will still invoke its "on connection shutdown" callback when channel shutdown completes.
  *
+ * A websocket using permessage-deflate cannot be converted,
+ * since decompressed data might not fit the downstream read window.
+ *
  * If unsuccessful, NULL is returned and the websocket is unchanged.
  */
 AWS_HTTP_API
@@ -470,6 +916,25 @@ struct aws_channel *aws_websocket_get_channel(const struct aws_websocket *websoc
 AWS_HTTP_API
 int aws_websocket_random_handshake_key(struct aws_byte_buf *dst);
 
+/**
+ * For servers: answer a client's offer of the permessage-deflate extension (RFC-7692 Section 5).
+ * `sec_websocket_extensions` is the value of the request's Sec-WebSocket-Extensions header
+ * (or the comma-separated values, if there were several such headers).
+ *
+ * The first permessage-deflate offer that `options` can satisfy is accepted:
+ * `out_accepted` is set true, `out_params` receives the agreed parameters,
+ * and the value for the response's Sec-WebSocket-Extensions header is appended to `out_response_value`.
+ * Offers that can't be satisfied, or are malformed, are declined and `out_accepted` is set false.
+ * Other extensions are ignored.
+ */
+AWS_HTTP_API
+int aws_websocket_permessage_deflate_negotiate(
+    const struct aws_websocket_permessage_deflate_options *options,
+    struct aws_byte_cursor sec_websocket_extensions,
+    struct aws_websocket_permessage_deflate_params *out_params,
+    struct aws_byte_buf *out_response_value,
+    bool *out_accepted);
+
 /**
  * Create request with all required fields for a websocket upgrade request.
  * The method and path are set, and the the following headers are added:
@@ -0,0 +1,238 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/async_body_stream.h>
+
+#include <aws/http/private/content_encoding_stream.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/http/request_response.h>
+#include <aws/io/async_stream.h>
+#include <aws/io/channel.h>
+#include <aws/io/future.h>
+#include <aws/io/stream.h>
+
+/* Body stream that reads ahead from an aws_async_input_stream, see aws_http_async_body_stream_new() */
+struct aws_http_async_body_stream {
+    struct aws_input_stream base;
+    struct aws_allocator *allocator;
+    struct aws_async_input_stream *source;
+
+    /* Destination of the read in progress, or of the last one */
+    struct aws_byte_buf buffer;
+    /* Data in the buffer that hasn't been read out yet */
+    struct aws_byte_cursor unread;
+
+    /* The read in progress, NULL if there isn't one */
+    struct aws_future_bool *read_future;
+
+    /* Non-zero once a read fails */
+    int error_code;
+    bool is_source_done;
+
+    /* Set while an aws_http_async_body_stream_wait() is pending */
+    struct aws_channel *waiting_channel;
+    aws_http_async_body_stream_ready_fn *on_ready;
+    void *on_ready_user_data;
+};
+
+static struct aws_input_stream_vtable s_async_body_stream_vtable;
+
+/* If the read in progress has completed, take its result.
+ * While a wait is pending, its callback is the one to take it */
+static void s_collect_read(struct aws_http_async_body_stream *body) {
+    if (body->read_future == NULL || body->waiting_channel != NULL || !aws_future_bool_is_done(body->read_future)) {
+        return;
+    }
+
+    body->error_code = aws_future_bool_get_error(body->read_future);
+    if (!body->error_code) {
+        body->is_source_done = aws_future_bool_get_result(body->read_future);
+        body->unread = aws_byte_cursor_from_buf(&body->buffer);
+    }
+    body->read_future = aws_future_bool_release(body->read_future);
+}
+
+static void s_start_read(struct aws_http_async_body_stream *body) {
+    AWS_ASSERT(body->read_future == NULL && body->unread.len == 0);
+
+    aws_byte_buf_reset(&body->buffer, false /*zero_contents*/);
+    body->read_future = aws_async_input_stream_read(body->source, &body->buffer);
+
+    /* Reads from memory, or from a source with data on hand, complete immediately */
+    s_collect_read(body);
+}
+
+static int s_async_body_stream_seek(
+    struct aws_input_stream *stream,
+    int64_t offset,
+    enum aws_stream_seek_basis basis) {
+
+    (void)stream;
+    (void)offset;
+    (void)basis;
+    return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+}
+
+static int s_async_body_stream_read(struct aws_input_stream *stream, struct aws_byte_buf *dest) {
+    struct aws_http_async_body_stream *body = AWS_CONTAINER_OF(stream, struct aws_http_async_body_stream, base);
+
+    s_collect_read(body);
+    while (true) {
+        if (body->error_code) {
+            return aws_raise_error(body->error_code);
+        }
+
+        aws_byte_buf_write_to_capacity(dest, &body->unread);
+        if (body->unread.len > 0 || body->read_future != NULL || body->is_source_done) {
+            /* dest is full, or the data isn't here yet, or there's no more */
+            return AWS_OP_SUCCESS;
+        }
+
+        /* Buffer is drained. Read ahead, so there may be data ready the next time we're asked */
+        s_start_read(body);
+        if (body->read_future == NULL && body->unread.len == 0 && !body->is_source_done && !body->error_code) {
+            /* Completed with no data and no end-of-stream. Don't spin on it, try again next time */
+            return AWS_OP_SUCCESS;
+        }
+    }
+}
+
+static int s_async_body_stream_get_status(struct aws_input_stream *stream, struct aws_stream_status *status) {
+    struct aws_http_async_body_stream *body = AWS_CONTAINER_OF(stream, struct aws_http_async_body_stream, base);
+
+    s_collect_read(body);
+    status->is_end_of_stream = body->is_source_done && body->unread.len == 0;
+    status->is_valid = body->error_code == 0;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_async_body_stream_get_length(struct aws_input_stream *stream, int64_t *out_length) {
+    (void)stream;
+    (void)out_length;
+    return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+}
+
+static void s_async_body_stream_free(struct aws_http_async_body_stream *body) {
+    aws_async_input_stream_release(body->source);
+    aws_byte_buf_clean_up(&body->buffer);
+    aws_mem_release(body->allocator, body);
+}
+
+/* The stream was destroyed during a read. Now the source is done writing into the buffer, it can be freed */
+static void s_on_orphaned_read_done(void *user_data) {
+    struct aws_http_async_body_stream *body = user_data;
+    aws_future_bool_release(body->read_future);
+    s_async_body_stream_free(body);
+}
+
+static void s_async_body_stream_destroy(void *user_data) {
+    struct aws_http_async_body_stream *body = user_data;
+    AWS_ASSERT(body->waiting_channel == NULL);
+
+    if (body->read_future != NULL) {
+        /* Invoked immediately if the read is already done */
+        aws_future_bool_register_callback(body->read_future, s_on_orphaned_read_done, body);
+        return;
+    }
+
+    s_async_body_stream_free(body);
+}
+
+static struct aws_input_stream_vtable s_async_body_stream_vtable = {
+    .seek = s_async_body_stream_seek,
+    .read = s_async_body_stream_read,
+    .get_status = s_async_body_stream_get_status,
+    .get_length = s_async_body_stream_get_length,
+};
+
+struct aws_input_stream *aws_http_async_body_stream_new(
+    struct aws_allocator *allocator,
+    struct aws_async_input_stream *source,
+    size_t buffer_size) {
+
+    AWS_PRECONDITION(source);
+    AWS_PRECONDITION(buffer_size > 0);
+
+    struct aws_http_async_body_stream *body = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_async_body_stream));
+    body->allocator = allocator;
+    body->source = aws_async_input_stream_acquire(source);
+    aws_byte_buf_init(&body->buffer, allocator, buffer_size);
+    body->base.impl = body;
+    body->base.vtable = &s_async_body_stream_vtable;
+    aws_ref_count_init(&body->base.ref_count, body, s_async_body_stream_destroy);
+    return &body->base;
+}
+
+struct aws_input_stream *aws_http_message_acquire_outgoing_body(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *message) {
+
+    struct aws_async_input_stream *async_body = aws_http_message_get_body_async_stream(message);
+    if (async_body) {
+        /* Read ahead up to one full channel message at a time */
+        return aws_http_async_body_stream_new(allocator, async_body, g_aws_channel_max_fragment_size);
+    }
+
+    return aws_input_stream_acquire(aws_http_message_get_body_stream(message));
+}
+
+static void s_on_read_done_for_wait(void *user_data) {
+    struct aws_http_async_body_stream *body = user_data;
+
+    struct aws_channel *channel = body->waiting_channel;
+    aws_http_async_body_stream_ready_fn *on_ready = body->on_ready;
+    void *on_ready_user_data = body->on_ready_user_data;
+    body->waiting_channel = NULL;
+    body->on_ready = NULL;
+    body->on_ready_user_data = NULL;
+
+    s_collect_read(body);
+    on_ready(on_ready_user_data);
+
+    aws_channel_release_hold(channel);
+    aws_input_stream_release(&body->base);
+}
+
+bool aws_http_async_body_stream_wait(
+    struct aws_input_stream *stream,
+    struct aws_channel *channel,
+    aws_http_async_body_stream_ready_fn *on_ready,
+    void *user_data) {
+
+    AWS_PRECONDITION(aws_channel_thread_is_callers_thread(channel));
+    AWS_PRECONDITION(on_ready);
+
+    struct aws_input_stream *encoding_source = aws_http_content_encoding_stream_get_source(stream);
+    if (encoding_source != NULL) {
+        stream = encoding_source;
+    }
+
+    if (stream == NULL || stream->vtable != &s_async_body_stream_vtable) {
+        return false;
+    }
+
+    struct aws_http_async_body_stream *body = AWS_CONTAINER_OF(stream, struct aws_http_async_body_stream, base);
+    if (body->waiting_channel != NULL) {
+        AWS_ASSERT(body->on_ready == on_ready && body->on_ready_user_data == user_data);
+        return true;
+    }
+
+    s_collect_read(body);
+    if (body->read_future == NULL) {
+        /* Data, end-of-stream, or an error is ready now */
+        return false;
+    }
+
+    body->waiting_channel = channel;
+    body->on_ready = on_ready;
+    body->on_ready_user_data = user_data;
+
+    /* Keep the channel, and ourselves, alive until the read completes */
+    aws_channel_acquire_hold(channel);
+    aws_input_stream_acquire(&body->base);
+    aws_future_bool_register_channel_callback(body->read_future, channel, s_on_read_done_for_wait, body);
+    return true;
+}
@@ -0,0 +1,176 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/body_fd_stream.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/http/request_response.h>
+#include <aws/io/stream.h>
+
+#ifndef _WIN32
+#    include <errno.h>
+#    include <unistd.h>
+
+/* Body stream that reads a range of an open file, with pread() so it doesn't depend on the file's seek position */
+struct aws_http_body_fd_stream {
+    struct aws_input_stream base;
+    struct aws_allocator *allocator;
+    int fd;
+    /* Offset of the range in the file */
+    uint64_t start;
+    uint64_t length;
+    /* Progress through the range */
+    uint64_t position;
+};
+
+static int s_fd_stream_seek(struct aws_input_stream *stream, int64_t offset, enum aws_stream_seek_basis basis) {
+    struct aws_http_body_fd_stream *fd_stream = AWS_CONTAINER_OF(stream, struct aws_http_body_fd_stream, base);
+
+    int64_t position = basis == AWS_SSB_BEGIN ? offset : (int64_t)fd_stream->length + offset;
+    if (position < 0 || (uint64_t)position > fd_stream->length) {
+        return aws_raise_error(AWS_IO_STREAM_INVALID_SEEK_POSITION);
+    }
+
+    fd_stream->position = (uint64_t)position;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_fd_stream_read(struct aws_input_stream *stream, struct aws_byte_buf *dest) {
+    struct aws_http_body_fd_stream *fd_stream = AWS_CONTAINER_OF(stream, struct aws_http_body_fd_stream, base);
+
+    size_t reading = (size_t)aws_min_u64(dest->capacity - dest->len, fd_stream->length - fd_stream->position);
+    if (reading == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    ssize_t amount_read =
+        pread(fd_stream->fd, dest->buffer + dest->len, reading, (off_t)(fd_stream->start + fd_stream->position));
+    if (amount_read < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+            /* Nothing read, caller will try again */
+            return AWS_OP_SUCCESS;
+        }
+        return aws_raise_error(AWS_IO_STREAM_READ_FAILED);
+    }
+
+    if (amount_read == 0) {
+        /* File ended before the range did */
+        return aws_raise_error(AWS_IO_STREAM_READ_FAILED);
+    }
+
+    dest->len += (size_t)amount_read;
+    fd_stream->position += (uint64_t)amount_read;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_fd_stream_get_status(struct aws_input_stream *stream, struct aws_stream_status *status) {
+    struct aws_http_body_fd_stream *fd_stream = AWS_CONTAINER_OF(stream, struct aws_http_body_fd_stream, base);
+
+    status->is_end_of_stream = fd_stream->position == fd_stream->length;
+    status->is_valid = true;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_fd_stream_get_length(struct aws_input_stream *stream, int64_t *out_length) {
+    struct aws_http_body_fd_stream *fd_stream = AWS_CONTAINER_OF(stream, struct aws_http_body_fd_stream, base);
+
+    *out_length = (int64_t)fd_stream->length;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_fd_stream_destroy(void *user_data) {
+    struct aws_http_body_fd_stream *fd_stream = user_data;
+    aws_mem_release(fd_stream->allocator, fd_stream);
+}
+
+static struct aws_input_stream_vtable s_fd_stream_vtable = {
+    .seek = s_fd_stream_seek,
+    .read = s_fd_stream_read,
+    .get_status = s_fd_stream_get_status,
+    .get_length = s_fd_stream_get_length,
+};
+
+struct aws_input_stream *aws_http_body_stream_new_from_fd(
+    struct aws_allocator *allocator,
+    int fd,
+    uint64_t offset,
+    uint64_t length) {
+
+    uint64_t end = 0;
+    if (fd < 0 || aws_add_u64_checked(offset, length, &end) || end > INT64_MAX) {
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    struct aws_http_body_fd_stream *fd_stream = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_body_fd_stream));
+    fd_stream->allocator = allocator;
+    fd_stream->fd = fd;
+    fd_stream->start = offset;
+    fd_stream->length = length;
+    fd_stream->base.impl = fd_stream;
+    fd_stream->base.vtable = &s_fd_stream_vtable;
+    aws_ref_count_init(&fd_stream->base.ref_count, fd_stream, s_fd_stream_destroy);
+    return &fd_stream->base;
+}
+
+bool aws_http_body_fd_stream_get_range(
+    struct aws_input_stream *stream,
+    int *out_fd,
+    uint64_t *out_offset,
+    uint64_t *out_remaining) {
+
+    if (stream == NULL || stream->vtable != &s_fd_stream_vtable) {
+        return false;
+    }
+
+    struct aws_http_body_fd_stream *fd_stream = AWS_CONTAINER_OF(stream, struct aws_http_body_fd_stream, base);
+    *out_fd = fd_stream->fd;
+    *out_offset = fd_stream->start + fd_stream->position;
+    *out_remaining = fd_stream->length - fd_stream->position;
+    return true;
+}
+
+void aws_http_body_fd_stream_skip(struct aws_input_stream *stream, uint64_t bytes) {
+    struct aws_http_body_fd_stream *fd_stream = AWS_CONTAINER_OF(stream, struct aws_http_body_fd_stream, base);
+    AWS_FATAL_ASSERT(bytes <= fd_stream->length - fd_stream->position);
+    fd_stream->position += bytes;
+}
+
+#else /* _WIN32 */
+
+struct aws_input_stream *aws_http_body_stream_new_from_fd(
+    struct aws_allocator *allocator,
+    int fd,
+    uint64_t offset,
+    uint64_t length) {
+
+    (void)allocator;
+    (void)fd;
+    (void)offset;
+    (void)length;
+    aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+    return NULL;
+}
+
+bool aws_http_body_fd_stream_get_range(
+    struct aws_input_stream *stream,
+    int *out_fd,
+    uint64_t *out_offset,
+    uint64_t *out_remaining) {
+
+    (void)stream;
+    (void)out_fd;
+    (void)out_offset;
+    (void)out_remaining;
+    return false;
+}
+
+void aws_http_body_fd_stream_skip(struct aws_input_stream *stream, uint64_t bytes) {
+    (void)stream;
+    (void)bytes;
+    AWS_FATAL_ASSERT(false);
+}
+
+#endif /* _WIN32 */
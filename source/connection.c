@@ -8,19 +8,30 @@
 
 #include <aws/http/private/h1_connection.h>
 #include <aws/http/private/h2_connection.h>
+#include <aws/http/private/http2_preface_detector.h>
 
 #include <aws/http/private/proxy_impl.h>
+#include <aws/http/private/server_admission.h>
+#include <aws/http/private/server_listener_group.h>
+#include <aws/http/private/traffic_capture.h>
 
+#include <aws/common/clock.h>
 #include <aws/common/hash_table.h>
 #include <aws/common/mutex.h>
+#include <aws/common/ref_count.h>
 #include <aws/common/string.h>
+#include <aws/http/memory_budget.h>
 #include <aws/http/request_response.h>
 #include <aws/io/channel_bootstrap.h>
+#include <aws/io/event_loop.h>
+#include <aws/io/host_resolver.h>
 #include <aws/io/logging.h>
 #include <aws/io/socket.h>
 #include <aws/io/socket_channel_handler.h>
 #include <aws/io/tls_channel_handler.h>
 
+#include <inttypes.h>
+
 #ifdef _MSC_VER
 #    pragma warning(disable : 4204) /* non-constant aggregate initializer */
 #    pragma warning(disable : 4232) /* function pointer to dll symbol */
@@ -28,6 +39,7 @@
 
 static struct aws_http_connection_system_vtable s_default_system_vtable = {
     .aws_client_bootstrap_new_socket_channel = aws_client_bootstrap_new_socket_channel,
+    .aws_host_resolver_resolve_host = aws_host_resolver_resolve_host,
 };
 
 static const struct aws_http_connection_system_vtable *s_system_vtable_ptr = &s_default_system_vtable;
@@ -38,6 +50,8 @@ void aws_http_client_bootstrap_destroy(struct aws_http_client_bootstrap *bootstr
     if (bootstrap->alpn_string_map) {
         aws_hash_table_clean_up(bootstrap->alpn_string_map);
     }
+    aws_string_destroy(bootstrap->traffic_capture_directory);
+    aws_http_memory_budget_release(bootstrap->http1_options.memory_budget);
     aws_mem_release(bootstrap->alloc, bootstrap);
 }
 
@@ -53,11 +67,31 @@ struct aws_http_server {
     struct aws_server_bootstrap *bootstrap;
     bool is_using_tls;
     bool manual_window_management;
+    bool accept_http2_prior_knowledge;
     size_t initial_window_size;
+    uint64_t idle_timeout_ms;
+    size_t max_requests_per_connection;
     void *user_data;
     aws_http_server_on_incoming_connection_fn *on_incoming_connection;
     aws_http_server_on_destroy_fn *on_destroy_complete;
+    /* Either socket or listener_group is set, depending on whether there's a listener per event loop */
     struct aws_socket *socket;
+    struct aws_http_server_listener_group *listener_group;
+    /* NULL unless the user asked for admission control */
+    struct aws_http_server_admission *admission;
+    /* NULL unless the user asked for traffic capture. The options' directory points into it */
+    struct aws_string *traffic_capture_directory;
+    struct aws_http_traffic_capture_options traffic_capture_options;
+
+    /* Set up by aws_http_server_drain(), if it has a deadline. Only touched on `event_loop` after that */
+    struct {
+        struct aws_event_loop *event_loop;
+        /* Closes the connections that are still open when time is up */
+        struct aws_task deadline_task;
+        /* Cleans up once the listener is destroyed, cancelling deadline_task if it hasn't run */
+        struct aws_task finish_task;
+        bool is_deadline_task_scheduled;
+    } drain;
 
     /* Any thread may touch this data, but the lock must be held */
     struct {
@@ -79,18 +113,37 @@ static void s_server_unlock_synced_data(struct aws_http_server *server) {
     (void)err;
 }
 
+/* Lock must be held */
+static void s_server_shut_down_channels_synced(struct aws_http_server *server) {
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(&server->synced_data.channel_to_connection_map);
+         !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+        struct aws_channel *channel = (struct aws_channel *)iter.element.key;
+        aws_channel_shutdown(channel, AWS_ERROR_HTTP_CONNECTION_CLOSED);
+    }
+}
+
+static const struct aws_socket_endpoint *s_server_get_endpoint(const struct aws_http_server *server) {
+    if (server->listener_group) {
+        return aws_http_server_listener_group_get_endpoint(server->listener_group);
+    }
+    return &server->socket->local_endpoint;
+}
+
 /* Determine the http-version, create appropriate type of connection, and insert it into the channel. */
 struct aws_http_connection *aws_http_connection_new_channel_handler(
     struct aws_allocator *alloc,
     struct aws_channel *channel,
     bool is_server,
     bool is_using_tls,
+    bool is_socket_channel,
     bool manual_window_management,
     bool prior_knowledge_http2,
     size_t initial_window_size,
     const struct aws_hash_table *alpn_string_map,
     const struct aws_http1_connection_options *http1_options,
     const struct aws_http2_connection_options *http2_options,
+    const struct aws_http_traffic_capture_options *traffic_capture_options,
     void *connection_user_data) {
 
     struct aws_channel_slot *connection_slot = NULL;
@@ -221,6 +274,31 @@ struct aws_http_connection *aws_http_connection_new_channel_handler(
     }
     connection->user_data = connection_user_data;
 
+    /* Capture goes in before the connection's handler is set, so it sees the very first bytes sent.
+     * It sits between the connection and the socket, which also keeps sendfile from bypassing it */
+    if (traffic_capture_options) {
+        if (aws_http_traffic_capture_install(alloc, connection_slot, traffic_capture_options, version, is_server)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_CONNECTION,
+                "static: Failed to install traffic capture on channel %p, error %d (%s).",
+                (void *)channel,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+
+            goto error;
+        }
+    }
+
+    if (version == AWS_HTTP_VERSION_1_1 && !is_using_tls && is_socket_channel) {
+        /* If nothing sits between the connection and the socket, file bodies can go straight to the socket.
+         * Only a socket bootstrap's channel is known to have the socket handler leftmost, a tunnel's isn't */
+        struct aws_channel_slot *socket_slot = connection_slot->adj_left;
+        if (socket_slot && !socket_slot->adj_left && socket_slot->handler) {
+            const struct aws_socket *socket = aws_socket_handler_get_socket(socket_slot->handler);
+            aws_h1_connection_enable_sendfile(connection, socket->io_handle.data.fd);
+        }
+    }
+
     /* Connect handler and slot */
     if (aws_channel_slot_set_handler(connection_slot, &connection->channel_handler)) {
         AWS_LOGF_ERROR(
@@ -260,6 +338,11 @@ void aws_http_connection_stop_new_requests(struct aws_http_connection *connectio
     connection->vtable->stop_new_requests(connection);
 }
 
+void aws_http_connection_drain(struct aws_http_connection *connection) {
+    AWS_ASSERT(connection);
+    connection->vtable->drain(connection);
+}
+
 bool aws_http_connection_is_open(const struct aws_http_connection *connection) {
     AWS_ASSERT(connection);
     return connection->vtable->is_open(connection);
@@ -270,6 +353,11 @@ bool aws_http_connection_new_requests_allowed(const struct aws_http_connection *
     return connection->vtable->new_requests_allowed(connection);
 }
 
+uint32_t aws_http_connection_get_health_score(const struct aws_http_connection *connection) {
+    AWS_ASSERT(connection);
+    return (uint32_t)aws_atomic_load_int(&connection->health_score);
+}
+
 bool aws_http_connection_is_client(const struct aws_http_connection *connection) {
     return connection->client_data;
 }
@@ -355,6 +443,13 @@ void aws_http2_connection_get_remote_settings(
     http2_connection->vtable->get_remote_settings(http2_connection, out_settings);
 }
 
+size_t aws_http2_connection_get_hpack_memory_usage(const struct aws_http_connection *http2_connection) {
+    AWS_ASSERT(http2_connection);
+    AWS_PRECONDITION(http2_connection->vtable);
+    AWS_FATAL_ASSERT(http2_connection->http_version == AWS_HTTP_VERSION_2);
+    return http2_connection->vtable->get_hpack_memory_usage(http2_connection);
+}
+
 void aws_http2_connection_update_window(struct aws_http_connection *http2_connection, uint32_t increment_size) {
     AWS_ASSERT(http2_connection);
     AWS_PRECONDITION(http2_connection->vtable);
@@ -367,6 +462,19 @@ struct aws_channel *aws_http_connection_get_channel(struct aws_http_connection *
     return connection->channel_slot->channel;
 }
 
+int aws_http_connection_get_setup_metrics(
+    const struct aws_http_connection *connection,
+    struct aws_http_connection_setup_metrics *out_metrics) {
+    AWS_PRECONDITION(connection);
+    AWS_PRECONDITION(out_metrics);
+
+    if (!connection->client_data) {
+        return aws_raise_error(AWS_ERROR_INVALID_STATE);
+    }
+    *out_metrics = connection->client_data->setup_metrics;
+    return AWS_OP_SUCCESS;
+}
+
 const struct aws_socket_endpoint *aws_http_connection_get_remote_endpoint(
     const struct aws_http_connection *connection) {
     AWS_ASSERT(connection);
@@ -431,34 +539,31 @@ void aws_http_connection_release(struct aws_http_connection *connection) {
     }
 }
 
-/* At this point, the server bootstrapper has accepted an incoming connection from a client and set up a channel.
- * Now we need to create an aws_http_connection and insert it into the channel as a channel-handler.
+/* Create an aws_http_connection and insert it into the server's channel as a channel-handler.
  * Note: Be careful not to access server->socket until lock is acquired to avoid race conditions */
-static void s_server_bootstrap_on_accept_channel_setup(
-    struct aws_server_bootstrap *bootstrap,
-    int error_code,
-    struct aws_channel *channel,
-    void *user_data) {
-
-    (void)bootstrap;
-    AWS_ASSERT(user_data);
-    struct aws_http_server *server = user_data;
+static void s_server_new_connection(struct aws_http_server *server, struct aws_channel *channel, bool is_http2) {
+    int error_code = AWS_ERROR_SUCCESS;
     bool user_cb_invoked = false;
+    bool is_admitted = false;
+    bool is_tracked = false;
     struct aws_http_connection *connection = NULL;
-    if (error_code) {
-        AWS_LOGF_ERROR(
-            AWS_LS_HTTP_SERVER,
-            "%p: Incoming connection failed with error code %d (%s)",
-            (void *)server,
-            error_code,
-            aws_error_name(error_code));
 
-        goto error;
+    /* Turn the connection away before doing any HTTP work, if the server is overloaded */
+    if (server->admission) {
+        if (!aws_http_server_admission_try_admit_connection(server->admission, aws_channel_get_event_loop(channel))) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_HTTP_SERVER, "%p: Server is overloaded, closing incoming connection.", (void *)server);
+            error_code = AWS_ERROR_HTTP_SERVER_OVERLOADED;
+            goto error;
+        }
+        is_admitted = true;
     }
     /* Create connection */
     /* TODO: expose http1/2 options to server API */
     struct aws_http1_connection_options http1_options;
     AWS_ZERO_STRUCT(http1_options);
+    http1_options.idle_timeout_ms = server->idle_timeout_ms;
+    http1_options.max_requests = server->max_requests_per_connection;
     struct aws_http2_connection_options http2_options;
     AWS_ZERO_STRUCT(http2_options);
     connection = aws_http_connection_new_channel_handler(
@@ -466,12 +571,14 @@ static void s_server_bootstrap_on_accept_channel_setup(
         channel,
         true,
         server->is_using_tls,
+        true, /* is_socket_channel */
         server->manual_window_management,
-        false, /* prior_knowledge_http2 */
+        is_http2, /* prior_knowledge_http2 */
         server->initial_window_size,
         NULL, /* alpn_string_map */
         &http1_options,
         &http2_options,
+        server->traffic_capture_directory ? &server->traffic_capture_options : NULL,
         NULL /* connection_user_data */);
     if (!connection) {
         AWS_LOGF_ERROR(
@@ -483,6 +590,7 @@ static void s_server_bootstrap_on_accept_channel_setup(
 
         goto error;
     }
+    connection->server_data->admission = aws_http_server_admission_acquire(server->admission);
 
     int put_err = 0;
     /* BEGIN CRITICAL SECTION */
@@ -492,6 +600,7 @@ static void s_server_bootstrap_on_accept_channel_setup(
     }
     if (!error_code) {
         put_err = aws_hash_table_put(&server->synced_data.channel_to_connection_map, channel, connection, NULL);
+        is_tracked = !put_err;
     }
     s_server_unlock_synced_data(server);
     /* END CRITICAL SECTION */
@@ -508,8 +617,8 @@ static void s_server_bootstrap_on_accept_channel_setup(
             AWS_LS_HTTP_SERVER,
             "%p: %s:%u: Failed to store connection object, error %d (%s).",
             (void *)server,
-            server->socket->local_endpoint.address,
-            server->socket->local_endpoint.port,
+            s_server_get_endpoint(server)->address,
+            s_server_get_endpoint(server)->port,
             aws_last_error(),
             aws_error_name(aws_last_error()));
 
@@ -523,8 +632,8 @@ static void s_server_bootstrap_on_accept_channel_setup(
         (void *)connection,
         AWS_BYTE_CURSOR_PRI(aws_http_version_to_str(connection->http_version)),
         (void *)server,
-        server->socket->local_endpoint.address,
-        server->socket->local_endpoint.port);
+        s_server_get_endpoint(server)->address,
+        s_server_get_endpoint(server)->port);
 
     server->on_incoming_connection(server, connection, AWS_ERROR_SUCCESS, server->user_data);
     user_cb_invoked = true;
@@ -552,6 +661,17 @@ error:
         server->on_incoming_connection(server, NULL, error_code, server->user_data);
     }
 
+    /* Once tracked, the admission control is settled when the channel shuts down */
+    if (!is_tracked) {
+        if (is_admitted) {
+            aws_http_server_admission_on_connection_closed(server->admission);
+        }
+        if (connection) {
+            aws_http_server_admission_release(connection->server_data->admission);
+            connection->server_data->admission = NULL;
+        }
+    }
+
     if (channel) {
         aws_channel_shutdown(channel, error_code);
     }
@@ -562,6 +682,85 @@ error:
     }
 }
 
+static void s_server_on_protocol_detected(struct aws_channel *channel, enum aws_http_version version, void *user_data) {
+    struct aws_http_server *server = user_data;
+    s_server_new_connection(server, channel, version == AWS_HTTP_VERSION_2);
+}
+
+/* Hold off on creating the connection until the client's first bytes show whether it speaks HTTP/2 */
+static int s_server_install_preface_detector(struct aws_http_server *server, struct aws_channel *channel) {
+    /* Track the channel while its protocol is unknown, so it's shut down along with the server */
+    int error_code = AWS_ERROR_SUCCESS;
+    /* BEGIN CRITICAL SECTION */
+    s_server_lock_synced_data(server);
+    if (server->synced_data.is_shutting_down) {
+        error_code = AWS_ERROR_HTTP_CONNECTION_CLOSED;
+    } else if (aws_hash_table_put(&server->synced_data.channel_to_connection_map, channel, NULL, NULL)) {
+        error_code = aws_last_error();
+    }
+    s_server_unlock_synced_data(server);
+    /* END CRITICAL SECTION */
+    if (error_code) {
+        return aws_raise_error(error_code);
+    }
+
+    struct aws_http2_preface_detector_options detector_options = {
+        .allocator = server->alloc,
+        .channel = channel,
+        .initial_window_size = server->initial_window_size,
+        .on_detected = s_server_on_protocol_detected,
+        .user_data = server,
+    };
+    return aws_http2_preface_detector_install(&detector_options);
+}
+
+/* At this point, the server bootstrapper has accepted an incoming connection from a client and set up a channel.
+ * Now we need to create an aws_http_connection and insert it into the channel as a channel-handler. */
+static void s_server_bootstrap_on_accept_channel_setup(
+    struct aws_server_bootstrap *bootstrap,
+    int error_code,
+    struct aws_channel *channel,
+    void *user_data) {
+
+    (void)bootstrap;
+    AWS_ASSERT(user_data);
+    struct aws_http_server *server = user_data;
+    if (error_code) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_SERVER,
+            "%p: Incoming connection failed with error code %d (%s)",
+            (void *)server,
+            error_code,
+            aws_error_name(error_code));
+
+        goto error;
+    }
+
+    if (server->accept_http2_prior_knowledge) {
+        if (s_server_install_preface_detector(server, channel)) {
+            error_code = aws_last_error();
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_SERVER,
+                "%p: Failed to install HTTP/2 preface detector, error %d (%s).",
+                (void *)server,
+                error_code,
+                aws_error_name(error_code));
+
+            goto error;
+        }
+        return;
+    }
+
+    s_server_new_connection(server, channel, false /*is_http2*/);
+    return;
+
+error:
+    server->on_incoming_connection(server, NULL, error_code, server->user_data);
+    if (channel) {
+        aws_channel_shutdown(channel, error_code);
+    }
+}
+
 /* clean the server memory up */
 static void s_http_server_clean_up(struct aws_http_server *server) {
     if (!server) {
@@ -569,6 +768,7 @@ static void s_http_server_clean_up(struct aws_http_server *server) {
     }
 
     aws_server_bootstrap_release(server->bootstrap);
+    aws_http_server_admission_release(server->admission);
 
     /* invoke the user callback */
     if (server->on_destroy_complete) {
@@ -576,6 +776,7 @@ static void s_http_server_clean_up(struct aws_http_server *server) {
     }
     aws_hash_table_clean_up(&server->synced_data.channel_to_connection_map);
     aws_mutex_clean_up(&server->synced_data.lock);
+    aws_string_destroy(server->traffic_capture_directory);
     aws_mem_release(server->alloc, server);
 }
 
@@ -602,13 +803,21 @@ static void s_server_bootstrap_on_accept_channel_shutdown(
     s_server_unlock_synced_data(server);
     /* END CRITICAL SECTION */
 
-    if (!remove_err && was_present) {
+    /* The channel is tracked without a connection while the preface detector waits to hear from the client */
+    if (!remove_err && was_present && map_elem.value) {
         struct aws_http_connection *connection = map_elem.value;
         AWS_LOGF_INFO(AWS_LS_HTTP_CONNECTION, "id=%p: Server connection shut down.", (void *)connection);
         /* Tell user about shutdown */
         if (connection->server_data->on_shutdown) {
             connection->server_data->on_shutdown(connection, error_code, connection->user_data);
         }
+
+        /* Every stream completed as the channel shut down, so the connection is done with admission control */
+        if (server->admission) {
+            aws_http_server_admission_on_connection_closed(server->admission);
+            aws_http_server_admission_release(connection->server_data->admission);
+            connection->server_data->admission = NULL;
+        }
     }
 }
 
@@ -618,9 +827,70 @@ static void s_server_bootstrap_on_server_listener_destroy(struct aws_server_boot
     (void)bootstrap;
     AWS_ASSERT(user_data);
     struct aws_http_server *server = user_data;
+
+    /* A drain deadline may still be pending, it can only be cancelled from its own event loop */
+    if (server->drain.event_loop) {
+        aws_event_loop_schedule_task_now(server->drain.event_loop, &server->drain.finish_task);
+        return;
+    }
+
+    s_http_server_clean_up(server);
+}
+
+static void s_server_drain_deadline_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_http_server *server = arg;
+    server->drain.is_deadline_task_scheduled = false;
+
+    if (status != AWS_TASK_STATUS_RUN_READY) {
+        return;
+    }
+
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_SERVER, "%p: Drain deadline reached, closing the connections still open.", (void *)server);
+
+    /* BEGIN CRITICAL SECTION */
+    s_server_lock_synced_data(server);
+    s_server_shut_down_channels_synced(server);
+    s_server_unlock_synced_data(server);
+    /* END CRITICAL SECTION */
+}
+
+static void s_server_drain_finish_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    (void)status;
+    struct aws_http_server *server = arg;
+
+    if (server->drain.is_deadline_task_scheduled) {
+        /* Every connection finished before the deadline. The task runs now, with a cancelled status */
+        aws_event_loop_cancel_task(server->drain.event_loop, &server->drain.deadline_task);
+    }
+
     s_http_server_clean_up(server);
 }
 
+struct aws_http_server_drain_connection_task {
+    struct aws_channel_task task;
+    struct aws_allocator *alloc;
+    struct aws_http_connection *connection;
+};
+
+/* Drains a connection on its own thread. The channel is held until this runs */
+static void s_server_drain_connection_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_http_server_drain_connection_task *drain_task = arg;
+    struct aws_http_connection *connection = drain_task->connection;
+    struct aws_channel *channel = connection->channel_slot->channel;
+    aws_mem_release(drain_task->alloc, drain_task);
+
+    if (status == AWS_TASK_STATUS_RUN_READY && aws_http_connection_is_open(connection)) {
+        aws_http_connection_drain(connection);
+    }
+
+    /* Releasing the hold may destroy the connection, so this must come last */
+    aws_channel_release_hold(channel);
+}
+
 struct aws_http_server *aws_http_server_new(const struct aws_http_server_options *options) {
     aws_http_fatal_assert_library_initialized();
 
@@ -635,6 +905,12 @@ struct aws_http_server *aws_http_server_new(const struct aws_http_server_options
         return NULL;
     }
 
+    if (options->accept_http2_prior_knowledge && options->tls_options) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_SERVER, "static: HTTP/2 prior knowledge only works with cleartext TCP.");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
     server = aws_mem_calloc(options->allocator, 1, sizeof(struct aws_http_server));
     if (!server) {
         /* nothing to clean up */
@@ -649,6 +925,28 @@ struct aws_http_server *aws_http_server_new(const struct aws_http_server_options
     server->on_incoming_connection = options->on_incoming_connection;
     server->on_destroy_complete = options->on_destroy_complete;
     server->manual_window_management = options->manual_window_management;
+    server->accept_http2_prior_knowledge = options->accept_http2_prior_knowledge;
+    server->idle_timeout_ms = options->idle_timeout_ms;
+    server->max_requests_per_connection = options->max_requests_per_connection;
+    if (options->traffic_capture_options) {
+        server->traffic_capture_directory =
+            aws_string_new_from_cursor(options->allocator, &options->traffic_capture_options->directory);
+        server->traffic_capture_options = *options->traffic_capture_options;
+        server->traffic_capture_options.directory = aws_byte_cursor_from_string(server->traffic_capture_directory);
+    }
+
+    if (options->admission_options) {
+        server->admission = aws_http_server_admission_new(
+            options->allocator, options->bootstrap->event_loop_group, options->admission_options);
+        if (!server->admission) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_SERVER,
+                "static: Failed to set up admission control, error %d (%s).",
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            goto admission_error;
+        }
+    }
 
     int err = aws_mutex_init(&server->synced_data.lock);
     if (err) {
@@ -685,11 +983,27 @@ struct aws_http_server *aws_http_server_new(const struct aws_http_server_options
         .user_data = server,
     };
 
-    server->socket = aws_server_bootstrap_new_socket_listener(&bootstrap_options);
+    if (options->listener_per_event_loop) {
+        struct aws_http_server_listener_group_options listener_group_options = {
+            .allocator = options->allocator,
+            .event_loop_group = options->bootstrap->event_loop_group,
+            .endpoint = options->endpoint,
+            .socket_options = options->socket_options,
+            .tls_options = options->tls_options,
+            .enable_read_back_pressure = options->manual_window_management,
+            .incoming_callback = s_server_bootstrap_on_accept_channel_setup,
+            .shutdown_callback = s_server_bootstrap_on_accept_channel_shutdown,
+            .destroy_callback = s_server_bootstrap_on_server_listener_destroy,
+            .user_data = server,
+        };
+        server->listener_group = aws_http_server_listener_group_new(&listener_group_options);
+    } else {
+        server->socket = aws_server_bootstrap_new_socket_listener(&bootstrap_options);
+    }
 
     s_server_unlock_synced_data(server);
 
-    if (!server->socket) {
+    if (!server->socket && !server->listener_group) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_SERVER,
             "static: Failed creating new socket listener, error %d (%s). Cannot create server.",
@@ -703,8 +1017,8 @@ struct aws_http_server *aws_http_server_new(const struct aws_http_server_options
         AWS_LS_HTTP_SERVER,
         "%p %s:%u: Server setup complete, listening for incoming connections.",
         (void *)server,
-        server->socket->local_endpoint.address,
-        server->socket->local_endpoint.port);
+        s_server_get_endpoint(server)->address,
+        s_server_get_endpoint(server)->port);
 
     return server;
 
@@ -713,6 +1027,13 @@ socket_error:
 hash_table_error:
     aws_mutex_clean_up(&server->synced_data.lock);
 mutex_error:
+    if (server->admission) {
+        aws_http_server_admission_stop(server->admission);
+        aws_http_server_admission_release(server->admission);
+    }
+admission_error:
+    aws_string_destroy(server->traffic_capture_directory);
+    aws_server_bootstrap_release(server->bootstrap);
     aws_mem_release(server->alloc, server);
     return NULL;
 }
@@ -731,12 +1052,7 @@ void aws_http_server_release(struct aws_http_server *server) {
     }
     if (!already_shutting_down) {
         /* shutdown all existing channels */
-        for (struct aws_hash_iter iter = aws_hash_iter_begin(&server->synced_data.channel_to_connection_map);
-             !aws_hash_iter_done(&iter);
-             aws_hash_iter_next(&iter)) {
-            struct aws_channel *channel = (struct aws_channel *)iter.element.key;
-            aws_channel_shutdown(channel, AWS_ERROR_HTTP_CONNECTION_CLOSED);
-        }
+        s_server_shut_down_channels_synced(server);
     }
     s_server_unlock_synced_data(server);
     /* END CRITICAL SECTION */
@@ -747,25 +1063,133 @@ void aws_http_server_release(struct aws_http_server *server) {
         return;
     }
 
+    if (server->admission) {
+        aws_http_server_admission_stop(server->admission);
+    }
+
     /* stop listening, clean up the socket, after all existing connections finish shutting down, the
      * s_server_bootstrap_on_server_listener_destroy will be invoked, clean up of the server will be there */
     AWS_LOGF_INFO(
         AWS_LS_HTTP_SERVER,
         "%p %s:%u: Shutting down the server.",
         (void *)server,
-        server->socket->local_endpoint.address,
-        server->socket->local_endpoint.port);
+        s_server_get_endpoint(server)->address,
+        s_server_get_endpoint(server)->port);
 
-    aws_server_bootstrap_destroy_socket_listener(server->bootstrap, server->socket);
+    if (server->listener_group) {
+        aws_http_server_listener_group_destroy(server->listener_group);
+    } else {
+        aws_server_bootstrap_destroy_socket_listener(server->bootstrap, server->socket);
+    }
 
     /* wait for connections to finish shutting down
      * clean up will be called from eventloop */
 }
 
+void aws_http_server_drain(struct aws_http_server *server, uint64_t timeout_ms) {
+    if (!server) {
+        return;
+    }
+
+    bool already_shutting_down = false;
+    /* BEGIN CRITICAL SECTION */
+    s_server_lock_synced_data(server);
+    if (server->synced_data.is_shutting_down) {
+        already_shutting_down = true;
+    } else {
+        server->synced_data.is_shutting_down = true;
+
+        for (struct aws_hash_iter iter = aws_hash_iter_begin(&server->synced_data.channel_to_connection_map);
+             !aws_hash_iter_done(&iter);
+             aws_hash_iter_next(&iter)) {
+            struct aws_channel *channel = (struct aws_channel *)iter.element.key;
+            struct aws_http_connection *connection = iter.element.value;
+            if (connection == NULL) {
+                /* The client hasn't sent anything yet, so there's nothing in progress */
+                aws_channel_shutdown(channel, AWS_ERROR_HTTP_CONNECTION_CLOSED);
+                continue;
+            }
+
+            struct aws_http_server_drain_connection_task *drain_task =
+                aws_mem_calloc(server->alloc, 1, sizeof(struct aws_http_server_drain_connection_task));
+            drain_task->alloc = server->alloc;
+            drain_task->connection = connection;
+            aws_channel_task_init(
+                &drain_task->task, s_server_drain_connection_task, drain_task, "http_server_drain_connection");
+            aws_channel_acquire_hold(channel);
+            aws_channel_schedule_task_now(channel, &drain_task->task);
+        }
+    }
+    s_server_unlock_synced_data(server);
+    /* END CRITICAL SECTION */
+
+    if (already_shutting_down) {
+        AWS_LOGF_TRACE(AWS_LS_HTTP_SERVER, "id=%p: The server is already shutting down", (void *)server);
+        return;
+    }
+
+    if (server->admission) {
+        aws_http_server_admission_stop(server->admission);
+    }
+
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_SERVER,
+        "%p %s:%u: Draining the server, with a deadline of %" PRIu64 "ms.",
+        (void *)server,
+        s_server_get_endpoint(server)->address,
+        s_server_get_endpoint(server)->port,
+        timeout_ms);
+
+    /* Set up the deadline before the listener is destroyed, its callback may fire on another thread right away */
+    if (timeout_ms != 0) {
+        struct aws_event_loop *event_loop = aws_event_loop_group_get_next_loop(server->bootstrap->event_loop_group);
+        aws_task_init(&server->drain.deadline_task, s_server_drain_deadline_task, server, "http_server_drain_deadline");
+        aws_task_init(&server->drain.finish_task, s_server_drain_finish_task, server, "http_server_drain_finish");
+        server->drain.event_loop = event_loop;
+        server->drain.is_deadline_task_scheduled = true;
+
+        uint64_t now_ns = 0;
+        aws_event_loop_current_clock_time(event_loop, &now_ns);
+        uint64_t deadline_ns = aws_add_u64_saturating(
+            now_ns, aws_timestamp_convert(timeout_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
+        aws_event_loop_schedule_task_future(event_loop, &server->drain.deadline_task, deadline_ns);
+    }
+
+    /* Stop listening. Once the last connection has shut down, the server cleans up */
+    if (server->listener_group) {
+        aws_http_server_listener_group_destroy(server->listener_group);
+    } else {
+        aws_server_bootstrap_destroy_socket_listener(server->bootstrap, server->socket);
+    }
+}
+
 const struct aws_socket_endpoint *aws_http_server_get_listener_endpoint(const struct aws_http_server *server) {
     AWS_FATAL_ASSERT(server);
 
-    return &server->socket->local_endpoint;
+    return s_server_get_endpoint(server);
+}
+
+static int64_t s_timestamp_now(void) {
+    uint64_t now = 0;
+    if (aws_high_res_clock_get_ticks(&now)) {
+        return -1;
+    }
+    return (int64_t)now;
+}
+
+/* The socket has connected and the channel exists, but TLS (if any) hasn't been negotiated yet */
+static void s_client_bootstrap_on_channel_creation(
+    struct aws_client_bootstrap *channel_bootstrap,
+    int error_code,
+    struct aws_channel *channel,
+    void *user_data) {
+
+    (void)channel_bootstrap;
+    (void)channel;
+    struct aws_http_client_bootstrap *http_bootstrap = user_data;
+    if (!error_code) {
+        http_bootstrap->setup_metrics.socket_connected_timestamp_ns = s_timestamp_now();
+    }
 }
 
 /* At this point, the channel bootstrapper has established a connection to the server and set up a channel.
@@ -806,12 +1230,14 @@ static void s_client_bootstrap_on_channel_setup(
         channel,
         false,
         http_bootstrap->is_using_tls,
+        true, /* is_socket_channel */
         http_bootstrap->stream_manual_window_management,
         http_bootstrap->prior_knowledge_http2,
         http_bootstrap->initial_window_size,
         http_bootstrap->alpn_string_map,
         &http_bootstrap->http1_options,
         &http_bootstrap->http2_options,
+        http_bootstrap->traffic_capture_directory ? &http_bootstrap->traffic_capture_options : NULL,
         http_bootstrap->user_data);
     if (!http_bootstrap->connection) {
         AWS_LOGF_ERROR(
@@ -836,6 +1262,7 @@ static void s_client_bootstrap_on_channel_setup(
             goto error;
         }
 
+        aws_http_connection_monitor_set_connection(http_connection_monitor, http_bootstrap->connection);
         aws_channel_set_statistics_handler(channel, http_connection_monitor);
     }
 
@@ -843,6 +1270,19 @@ static void s_client_bootstrap_on_channel_setup(
     http_bootstrap->connection->client_data->response_first_byte_timeout_ms =
         http_bootstrap->response_first_byte_timeout_ms;
 
+    struct aws_http_connection_setup_metrics *setup_metrics = &http_bootstrap->setup_metrics;
+    setup_metrics->setup_complete_timestamp_ns = s_timestamp_now();
+    if (setup_metrics->connect_start_timestamp_ns >= 0 && setup_metrics->socket_connected_timestamp_ns >= 0) {
+        setup_metrics->connect_duration_ns =
+            setup_metrics->socket_connected_timestamp_ns - setup_metrics->connect_start_timestamp_ns;
+    }
+    if (http_bootstrap->is_using_tls && setup_metrics->socket_connected_timestamp_ns >= 0 &&
+        setup_metrics->setup_complete_timestamp_ns >= 0) {
+        setup_metrics->tls_negotiation_duration_ns =
+            setup_metrics->setup_complete_timestamp_ns - setup_metrics->socket_connected_timestamp_ns;
+    }
+    http_bootstrap->connection->client_data->setup_metrics = *setup_metrics;
+
     AWS_LOGF_INFO(
         AWS_LS_HTTP_CONNECTION,
         "id=%p: " PRInSTR " client connection established.",
@@ -1080,8 +1520,16 @@ int aws_http_client_connect_internal(
     http_bootstrap->on_shutdown = options.on_shutdown;
     http_bootstrap->proxy_request_transform = proxy_request_transform;
     http_bootstrap->http1_options = *options.http1_options;
+    aws_http_memory_budget_acquire(http_bootstrap->http1_options.memory_budget);
     http_bootstrap->http2_options = *options.http2_options;
     http_bootstrap->response_first_byte_timeout_ms = options.response_first_byte_timeout_ms;
+    http_bootstrap->setup_metrics = (struct aws_http_connection_setup_metrics){
+        .connect_start_timestamp_ns = s_timestamp_now(),
+        .socket_connected_timestamp_ns = -1,
+        .setup_complete_timestamp_ns = -1,
+        .connect_duration_ns = -1,
+        .tls_negotiation_duration_ns = -1,
+    };
 
     /* keep a copy of the settings array if it's not NULL */
     if (options.http2_options->num_initial_settings > 0) {
@@ -1103,6 +1551,14 @@ int aws_http_client_connect_internal(
         http_bootstrap->monitoring_options = *options.monitoring_options;
     }
 
+    if (options.traffic_capture_options) {
+        http_bootstrap->traffic_capture_directory =
+            aws_string_new_from_cursor(options.allocator, &options.traffic_capture_options->directory);
+        http_bootstrap->traffic_capture_options = *options.traffic_capture_options;
+        http_bootstrap->traffic_capture_options.directory =
+            aws_byte_cursor_from_string(http_bootstrap->traffic_capture_directory);
+    }
+
     AWS_LOGF_TRACE(
         AWS_LS_HTTP_CONNECTION,
         "static: attempting to initialize a new client channel to %s:%u",
@@ -1115,6 +1571,7 @@ int aws_http_client_connect_internal(
         .port = options.port,
         .socket_options = options.socket_options,
         .tls_options = options.tls_options,
+        .creation_callback = s_client_bootstrap_on_channel_creation,
         .setup_callback = s_client_bootstrap_on_channel_setup,
         .shutdown_callback = s_client_bootstrap_on_channel_shutdown,
         .enable_read_back_pressure = options.manual_window_management,
@@ -1150,6 +1607,517 @@ error:
     return AWS_OP_ERR;
 }
 
+/*
+ * Races connection attempts across the addresses a host resolves to, see connection_attempt_delay_ms.
+ * The host resolution in flight, each attempt, and each stagger task hold a reference.
+ */
+struct aws_http_connect_race {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+
+    /* Options for every attempt. Everything they point to is owned by the race */
+    struct aws_http_client_connection_options options;
+    struct aws_string *host_name;
+    struct aws_socket_options socket_options;
+    struct aws_tls_connection_options *tls_options;
+    struct aws_http1_connection_options http1_options;
+    struct aws_http2_connection_options http2_options;
+    struct aws_http2_setting *initial_settings;
+    struct aws_http_connection_monitoring_options monitoring_options;
+    struct aws_hash_table alpn_string_map;
+    struct aws_host_resolution_config host_resolution_config;
+    struct aws_http_traffic_capture_options traffic_capture_options;
+    struct aws_string *traffic_capture_directory;
+
+    /* The user's callbacks, the attempts get ours. Every attempt's connection has the race as its user_data,
+     * so the HTTP/2 callbacks are wrapped as well, and only the winner's are passed on */
+    aws_http_on_client_connection_setup_fn *on_setup;
+    aws_http_on_client_connection_shutdown_fn *on_shutdown;
+    aws_http2_on_change_settings_complete_fn *on_initial_settings_completed;
+    aws_http2_on_goaway_received_fn *on_goaway_received;
+    aws_http2_on_remote_settings_change_fn *on_remote_settings_change;
+    void *user_data;
+
+    /* Where stagger tasks run */
+    struct aws_event_loop *event_loop;
+    uint64_t attempt_delay_ns;
+
+    struct aws_mutex lock;
+    struct {
+        /* aws_string *, in the order they're tried */
+        struct aws_array_list addresses;
+        size_t next_address;
+        size_t attempts_in_flight;
+        /* Bumped with each attempt, so a stagger task can tell if another attempt started since it was scheduled */
+        size_t attempt_count;
+        /* Set once the user's on_setup has been invoked, or is about to be */
+        bool is_decided;
+        struct aws_http_connection *winner;
+    } synced_data;
+};
+
+struct aws_http_connect_race_stagger {
+    struct aws_task task;
+    struct aws_http_connect_race *race;
+    size_t attempt_count;
+};
+
+static void s_connect_race_destroy(void *user_data) {
+    struct aws_http_connect_race *race = user_data;
+
+    for (size_t i = 0; i < aws_array_list_length(&race->synced_data.addresses); ++i) {
+        struct aws_string *address = NULL;
+        aws_array_list_get_at(&race->synced_data.addresses, &address, i);
+        aws_string_destroy(address);
+    }
+    aws_array_list_clean_up(&race->synced_data.addresses);
+
+    if (race->tls_options) {
+        aws_tls_connection_options_clean_up(race->tls_options);
+        aws_mem_release(race->allocator, race->tls_options);
+    }
+    if (race->options.alpn_string_map) {
+        aws_hash_table_clean_up(&race->alpn_string_map);
+    }
+    aws_mem_release(race->allocator, race->initial_settings);
+    aws_http_memory_budget_release(race->http1_options.memory_budget);
+    aws_string_destroy(race->traffic_capture_directory);
+    aws_string_destroy(race->host_name);
+    aws_client_bootstrap_release(race->options.bootstrap);
+    aws_mutex_clean_up(&race->lock);
+    aws_mem_release(race->allocator, race);
+}
+
+static void s_on_connect_race_attempt_setup(struct aws_http_connection *connection, int error_code, void *user_data);
+static void s_on_connect_race_attempt_shutdown(struct aws_http_connection *connection, int error_code, void *user_data);
+static void s_on_connect_race_attempt_initial_settings_completed(
+    struct aws_http_connection *http2_connection,
+    int error_code,
+    void *user_data);
+static void s_on_connect_race_attempt_goaway_received(
+    struct aws_http_connection *http2_connection,
+    uint32_t last_stream_id,
+    uint32_t http2_error_code,
+    struct aws_byte_cursor debug_data,
+    void *user_data);
+static void s_on_connect_race_attempt_remote_settings_change(
+    struct aws_http_connection *http2_connection,
+    const struct aws_http2_setting *settings_array,
+    size_t num_settings,
+    void *user_data);
+
+static struct aws_http_connect_race *s_connect_race_new(const struct aws_http_client_connection_options *options) {
+    struct aws_allocator *allocator = options->allocator;
+    struct aws_http_connect_race *race = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_connect_race));
+    race->allocator = allocator;
+    aws_ref_count_init(&race->ref_count, race, s_connect_race_destroy);
+    aws_mutex_init(&race->lock);
+    aws_array_list_init_dynamic(&race->synced_data.addresses, allocator, 4, sizeof(struct aws_string *));
+
+    race->options = *options;
+    race->options.bootstrap = aws_client_bootstrap_acquire(options->bootstrap);
+    /* Set below, once there's a copy */
+    race->options.alpn_string_map = NULL;
+    race->on_setup = options->on_setup;
+    race->on_shutdown = options->on_shutdown;
+    race->user_data = options->user_data;
+    race->attempt_delay_ns =
+        aws_timestamp_convert(options->connection_attempt_delay_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    race->event_loop = options->requested_event_loop;
+    if (race->event_loop == NULL) {
+        race->event_loop = aws_event_loop_group_get_next_loop(options->bootstrap->event_loop_group);
+    }
+
+    race->host_name = aws_string_new_from_cursor(allocator, &options->host_name);
+    if (race->host_name == NULL) {
+        goto error;
+    }
+    race->options.host_name = aws_byte_cursor_from_string(race->host_name);
+
+    if (options->socket_options) {
+        race->socket_options = *options->socket_options;
+        race->options.socket_options = &race->socket_options;
+    }
+
+    if (options->tls_options) {
+        race->tls_options = aws_mem_calloc(allocator, 1, sizeof(struct aws_tls_connection_options));
+        if (aws_tls_connection_options_copy(race->tls_options, options->tls_options)) {
+            aws_mem_release(allocator, race->tls_options);
+            race->tls_options = NULL;
+            goto error;
+        }
+        if (race->tls_options->server_name == NULL) {
+            /* Attempts connect to addresses, so the host has to be named for SNI */
+            if (aws_tls_connection_options_set_server_name(race->tls_options, allocator, &options->host_name)) {
+                goto error;
+            }
+        }
+        race->options.tls_options = race->tls_options;
+    }
+
+    if (options->http1_options) {
+        race->http1_options = *options->http1_options;
+        aws_http_memory_budget_acquire(race->http1_options.memory_budget);
+    }
+    race->options.http1_options = &race->http1_options;
+
+    if (options->http2_options) {
+        race->http2_options = *options->http2_options;
+        if (race->http2_options.num_initial_settings > 0) {
+            size_t settings_size = race->http2_options.num_initial_settings * sizeof(struct aws_http2_setting);
+            race->initial_settings = aws_mem_acquire(allocator, settings_size);
+            memcpy(race->initial_settings, options->http2_options->initial_settings_array, settings_size);
+            race->http2_options.initial_settings_array = race->initial_settings;
+        }
+        race->on_initial_settings_completed = race->http2_options.on_initial_settings_completed;
+        race->on_goaway_received = race->http2_options.on_goaway_received;
+        race->on_remote_settings_change = race->http2_options.on_remote_settings_change;
+        if (race->on_initial_settings_completed) {
+            race->http2_options.on_initial_settings_completed = s_on_connect_race_attempt_initial_settings_completed;
+        }
+        if (race->on_goaway_received) {
+            race->http2_options.on_goaway_received = s_on_connect_race_attempt_goaway_received;
+        }
+        if (race->on_remote_settings_change) {
+            race->http2_options.on_remote_settings_change = s_on_connect_race_attempt_remote_settings_change;
+        }
+    }
+    race->options.http2_options = &race->http2_options;
+
+    if (options->monitoring_options) {
+        race->monitoring_options = *options->monitoring_options;
+        race->options.monitoring_options = &race->monitoring_options;
+    }
+
+    if (options->alpn_string_map) {
+        if (aws_http_alpn_map_init_copy(allocator, &race->alpn_string_map, options->alpn_string_map)) {
+            goto error;
+        }
+        race->options.alpn_string_map = &race->alpn_string_map;
+    }
+
+    if (options->host_resolution_config) {
+        race->host_resolution_config = *options->host_resolution_config;
+        race->options.host_resolution_config = &race->host_resolution_config;
+    }
+
+    if (options->traffic_capture_options) {
+        race->traffic_capture_directory =
+            aws_string_new_from_cursor(allocator, &options->traffic_capture_options->directory);
+        if (race->traffic_capture_directory == NULL) {
+            goto error;
+        }
+        race->traffic_capture_options = *options->traffic_capture_options;
+        race->traffic_capture_options.directory = aws_byte_cursor_from_string(race->traffic_capture_directory);
+        race->options.traffic_capture_options = &race->traffic_capture_options;
+    }
+
+    if (s_validate_http_client_connection_options(&race->options)) {
+        goto error;
+    }
+
+    race->options.on_setup = s_on_connect_race_attempt_setup;
+    race->options.on_shutdown = s_on_connect_race_attempt_shutdown;
+    race->options.user_data = race;
+    return race;
+
+error:
+    aws_ref_count_release(&race->ref_count);
+    return NULL;
+}
+
+/* Invoke the user's on_setup with the failure of the last attempt */
+static void s_connect_race_fail(struct aws_http_connect_race *race, int error_code) {
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Every attempt to connect to %s failed, last error %d (%s).",
+        (void *)race,
+        aws_string_c_str(race->host_name),
+        error_code,
+        aws_error_name(error_code));
+
+    race->on_setup(NULL, error_code, race->user_data);
+}
+
+static void s_connect_race_start_next_attempt(struct aws_http_connect_race *race);
+
+static void s_connect_race_stagger_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_http_connect_race_stagger *stagger = arg;
+    struct aws_http_connect_race *race = stagger->race;
+
+    if (status == AWS_TASK_STATUS_RUN_READY) {
+        aws_mutex_lock(&race->lock);
+        bool is_latest_attempt = stagger->attempt_count == race->synced_data.attempt_count;
+        aws_mutex_unlock(&race->lock);
+
+        if (is_latest_attempt) {
+            /* Nothing has happened since the last attempt started. Don't wait on it any longer */
+            s_connect_race_start_next_attempt(race);
+        }
+    }
+
+    aws_mem_release(race->allocator, stagger);
+    aws_ref_count_release(&race->ref_count);
+}
+
+static void s_connect_race_schedule_stagger(struct aws_http_connect_race *race, size_t attempt_count) {
+    struct aws_http_connect_race_stagger *stagger =
+        aws_mem_calloc(race->allocator, 1, sizeof(struct aws_http_connect_race_stagger));
+    stagger->race = race;
+    stagger->attempt_count = attempt_count;
+    aws_ref_count_acquire(&race->ref_count);
+    aws_task_init(&stagger->task, s_connect_race_stagger_task, stagger, "http_connect_race_stagger");
+
+    uint64_t now = 0;
+    aws_event_loop_current_clock_time(race->event_loop, &now);
+    aws_event_loop_schedule_task_future(race->event_loop, &stagger->task, now + race->attempt_delay_ns);
+}
+
+/* An attempt failed. Go on to the next address, or if there's none left and nothing else is in flight, give up */
+static void s_connect_race_on_attempt_failed(struct aws_http_connect_race *race, int error_code) {
+    bool start_next = false;
+    bool give_up = false;
+    aws_mutex_lock(&race->lock);
+    --race->synced_data.attempts_in_flight;
+    if (!race->synced_data.is_decided) {
+        if (race->synced_data.next_address < aws_array_list_length(&race->synced_data.addresses)) {
+            start_next = true;
+        } else if (race->synced_data.attempts_in_flight == 0) {
+            race->synced_data.is_decided = true;
+            give_up = true;
+        }
+    }
+    aws_mutex_unlock(&race->lock);
+
+    if (start_next) {
+        s_connect_race_start_next_attempt(race);
+    } else if (give_up) {
+        s_connect_race_fail(race, error_code);
+    }
+
+    /* Release the attempt's reference */
+    aws_ref_count_release(&race->ref_count);
+}
+
+/* Start an attempt on the next address, unless the race is over or there's none left */
+static void s_connect_race_start_next_attempt(struct aws_http_connect_race *race) {
+    struct aws_string *address = NULL;
+    size_t attempt_count = 0;
+    aws_mutex_lock(&race->lock);
+    if (!race->synced_data.is_decided &&
+        race->synced_data.next_address < aws_array_list_length(&race->synced_data.addresses)) {
+        aws_array_list_get_at(&race->synced_data.addresses, &address, race->synced_data.next_address);
+        ++race->synced_data.next_address;
+        ++race->synced_data.attempts_in_flight;
+        attempt_count = ++race->synced_data.attempt_count;
+    }
+    aws_mutex_unlock(&race->lock);
+
+    if (address == NULL) {
+        return;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Attempt %zu to connect to %s, at address %s.",
+        (void *)race,
+        attempt_count,
+        aws_string_c_str(race->host_name),
+        aws_string_c_str(address));
+
+    struct aws_http_client_connection_options options = race->options;
+    options.host_name = aws_byte_cursor_from_string(address);
+    aws_ref_count_acquire(&race->ref_count);
+    if (aws_http_client_connect_internal(&options, NULL)) {
+        s_connect_race_on_attempt_failed(race, aws_last_error());
+        return;
+    }
+
+    s_connect_race_schedule_stagger(race, attempt_count);
+}
+
+static void s_on_connect_race_attempt_setup(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct aws_http_connect_race *race = user_data;
+    if (error_code) {
+        s_connect_race_on_attempt_failed(race, error_code);
+        return;
+    }
+
+    aws_mutex_lock(&race->lock);
+    --race->synced_data.attempts_in_flight;
+    bool is_winner = !race->synced_data.is_decided;
+    if (is_winner) {
+        race->synced_data.is_decided = true;
+        race->synced_data.winner = connection;
+    }
+    aws_mutex_unlock(&race->lock);
+
+    if (is_winner) {
+        race->on_setup(connection, AWS_ERROR_SUCCESS, race->user_data);
+    } else {
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_CONNECTION,
+            "id=%p: Closing connection %p, another attempt already won the race.",
+            (void *)race,
+            (void *)connection);
+        aws_http_connection_release(connection);
+    }
+}
+
+static void s_on_connect_race_attempt_shutdown(
+    struct aws_http_connection *connection,
+    int error_code,
+    void *user_data) {
+
+    struct aws_http_connect_race *race = user_data;
+
+    if (s_connect_race_is_winner(race, connection) && race->on_shutdown) {
+        race->on_shutdown(connection, error_code, race->user_data);
+    }
+
+    /* Release the attempt's reference */
+    aws_ref_count_release(&race->ref_count);
+}
+
+static bool s_connect_race_is_winner(struct aws_http_connect_race *race, struct aws_http_connection *connection) {
+    aws_mutex_lock(&race->lock);
+    bool is_winner = race->synced_data.winner == connection;
+    aws_mutex_unlock(&race->lock);
+    return is_winner;
+}
+
+/* A losing attempt's HTTP/2 connection is none of the user's business. The attempt keeps the race alive */
+static void s_on_connect_race_attempt_initial_settings_completed(
+    struct aws_http_connection *http2_connection,
+    int error_code,
+    void *user_data) {
+
+    struct aws_http_connect_race *race = user_data;
+    if (s_connect_race_is_winner(race, http2_connection)) {
+        race->on_initial_settings_completed(http2_connection, error_code, race->user_data);
+    }
+}
+
+static void s_on_connect_race_attempt_goaway_received(
+    struct aws_http_connection *http2_connection,
+    uint32_t last_stream_id,
+    uint32_t http2_error_code,
+    struct aws_byte_cursor debug_data,
+    void *user_data) {
+
+    struct aws_http_connect_race *race = user_data;
+    if (s_connect_race_is_winner(race, http2_connection)) {
+        race->on_goaway_received(http2_connection, last_stream_id, http2_error_code, debug_data, race->user_data);
+    }
+}
+
+static void s_on_connect_race_attempt_remote_settings_change(
+    struct aws_http_connection *http2_connection,
+    const struct aws_http2_setting *settings_array,
+    size_t num_settings,
+    void *user_data) {
+
+    struct aws_http_connect_race *race = user_data;
+    if (s_connect_race_is_winner(race, http2_connection)) {
+        race->on_remote_settings_change(http2_connection, settings_array, num_settings, race->user_data);
+    }
+}
+
+static void s_on_connect_race_host_resolved(
+    struct aws_host_resolver *resolver,
+    const struct aws_string *host_name,
+    int err_code,
+    const struct aws_array_list *host_addresses,
+    void *user_data) {
+
+    (void)resolver;
+    (void)host_name;
+    struct aws_http_connect_race *race = user_data;
+
+    if (!err_code) {
+        /* RFC 8305 section 4: alternate between families, starting with IPv6 */
+        size_t address_count = aws_array_list_length(host_addresses);
+        size_t next_by_family[2] = {0, 0};
+        bool is_ipv6_turn = true;
+        aws_mutex_lock(&race->lock);
+        while (aws_array_list_length(&race->synced_data.addresses) < address_count) {
+            struct aws_host_address *host_address = NULL;
+            size_t *next = &next_by_family[is_ipv6_turn ? 0 : 1];
+            for (; *next < address_count; ++*next) {
+                aws_array_list_get_at_ptr(host_addresses, (void **)&host_address, *next);
+                if ((host_address->record_type == AWS_ADDRESS_RECORD_TYPE_AAAA) == is_ipv6_turn) {
+                    break;
+                }
+            }
+            is_ipv6_turn = !is_ipv6_turn;
+            if (*next == address_count) {
+                /* None of this family left, the other family takes every turn */
+                continue;
+            }
+            ++*next;
+
+            struct aws_string *address = aws_string_new_from_string(race->allocator, host_address->address);
+            if (address == NULL || aws_array_list_push_back(&race->synced_data.addresses, &address)) {
+                aws_string_destroy(address);
+                err_code = aws_last_error();
+                break;
+            }
+        }
+        if (!err_code && address_count == 0) {
+            err_code = AWS_IO_DNS_QUERY_FAILED;
+        }
+        race->synced_data.is_decided = err_code != 0;
+        aws_mutex_unlock(&race->lock);
+    }
+
+    if (err_code) {
+        s_connect_race_fail(race, err_code);
+    } else {
+        s_connect_race_start_next_attempt(race);
+    }
+
+    /* Release the resolution's reference */
+    aws_ref_count_release(&race->ref_count);
+}
+
+static int s_connect_race_start(const struct aws_http_client_connection_options *options) {
+    struct aws_http_connect_race *race = s_connect_race_new(options);
+    if (race == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Racing connection attempts to %s:%u, %" PRIu64 "ms apart.",
+        (void *)race,
+        aws_string_c_str(race->host_name),
+        options->port,
+        options->connection_attempt_delay_ms);
+
+    /* The resolution's reference is the one from creation */
+    struct aws_client_bootstrap *bootstrap = race->options.bootstrap;
+    if (s_system_vtable_ptr->aws_host_resolver_resolve_host(
+            bootstrap->host_resolver,
+            race->host_name,
+            s_on_connect_race_host_resolved,
+            race->options.host_resolution_config ? race->options.host_resolution_config
+                                                 : &bootstrap->host_resolver_config,
+            race)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION,
+            "id=%p: Failed to start resolving %s, error %d (%s).",
+            (void *)race,
+            aws_string_c_str(race->host_name),
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        aws_ref_count_release(&race->ref_count);
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 int aws_http_client_connect(const struct aws_http_client_connection_options *options) {
     aws_http_fatal_assert_library_initialized();
     if (options->prior_knowledge_http2 && options->tls_options) {
@@ -1161,6 +2129,9 @@ int aws_http_client_connect(const struct aws_http_client_connection_options *opt
         return aws_http_client_connect_via_proxy(options);
     } else {
         if (!options->proxy_ev_settings || options->proxy_ev_settings->env_var_type != AWS_HPEV_ENABLE) {
+            if (options->connection_attempt_delay_ms > 0) {
+                return s_connect_race_start(options);
+            }
             return aws_http_client_connect_internal(options, NULL);
         } else {
             /* Proxy through envrionment variable is enabled */
@@ -9,15 +9,20 @@
 #include <aws/http/private/connection_manager_system_vtable.h>
 #include <aws/http/private/connection_monitor.h>
 #include <aws/http/private/http_impl.h>
+#include <aws/http/private/memory_budget_impl.h>
 #include <aws/http/private/proxy_impl.h>
+#include <aws/http/private/tracing.h>
 
+#include <aws/io/channel.h>
 #include <aws/io/channel_bootstrap.h>
 #include <aws/io/event_loop.h>
+#include <aws/io/host_resolver.h>
 #include <aws/io/logging.h>
 #include <aws/io/socket.h>
 #include <aws/io/tls_channel_handler.h>
 #include <aws/io/uri.h>
 
+#include <aws/common/atomics.h>
 #include <aws/common/clock.h>
 #include <aws/common/hash_table.h>
 #include <aws/common/linked_list.h>
@@ -25,20 +30,55 @@
 #include <aws/common/ref_count.h>
 #include <aws/common/string.h>
 
+#include <inttypes.h>
+
 #ifdef _MSC_VER
 #    pragma warning(disable : 4232) /* function pointer to dll symbol */
 #endif
 
+/* Number of slots the adaptive culling window is divided into */
+#define CONCURRENCY_WINDOW_SLOTS 8
+
+/* Degraded connections are recycled on release, but no more than one per this interval */
+#define DEGRADED_CONNECTION_RECYCLE_INTERVAL_MS 1000
+
 /*
  * Established connections not currently in use are tracked via this structure.
  */
 struct aws_idle_connection {
     struct aws_allocator *allocator;
     struct aws_linked_list_node node;
+    uint64_t idle_start_timestamp;
     uint64_t cull_timestamp;
     struct aws_http_connection *connection;
 };
 
+/*
+ * One per new connection attempt, as the user_data of the connection's callbacks.  Lives until the connection
+ * shuts down, or fails to set up.
+ */
+struct aws_managed_connection {
+    struct aws_allocator *allocator;
+    struct aws_http_connection_manager *manager;
+    uint64_t connect_timestamp;
+    uint64_t setup_timestamp;
+    /* The address connected to in multi-address mode, NULL if it went through the resolver's choice */
+    struct aws_string *address;
+};
+
+/*
+ * Multi-address mode: one per address the host resolved to.
+ */
+struct aws_managed_address {
+    struct aws_string *address;
+    /* Connections set up or being set up to this address */
+    size_t connection_count;
+    uint64_t backoff_ms;
+    uint64_t retry_timestamp;
+    /* Not in the latest resolution.  Gets no new connections, and is dropped once its connections are gone */
+    bool is_stale;
+};
+
 /*
  * System vtable to use under normal circumstances
  */
@@ -51,6 +91,8 @@ static struct aws_http_connection_manager_system_vtable s_default_system_vtable
     .aws_channel_thread_is_callers_thread = aws_channel_thread_is_callers_thread,
     .aws_http_connection_get_channel = aws_http_connection_get_channel,
     .aws_http_connection_get_version = aws_http_connection_get_version,
+    .aws_http_connection_get_health_score = aws_http_connection_get_health_score,
+    .aws_host_resolver_resolve_host = aws_host_resolver_resolve_host,
 };
 
 const struct aws_http_connection_manager_system_vtable *g_aws_http_connection_manager_default_system_vtable_ptr =
@@ -203,6 +245,21 @@ struct aws_http_connection_manager {
      */
     size_t pending_acquisition_count;
 
+    /*
+     * The number of incomplete connection acquisition requests with event loop affinity.
+     * While zero, acquisitions are served in order without looking at event loops.
+     */
+    size_t affine_acquisition_count;
+
+    /*
+     * Fails pending acquisitions that time out, while there are any with a deadline.  It holds an internal ref
+     * while it's scheduled.  deadline_acquisition_count and is_acquisition_timeout_task_scheduled are protected
+     * by the lock.
+     */
+    struct aws_task acquisition_timeout_task;
+    size_t deadline_acquisition_count;
+    bool is_acquisition_timeout_task_scheduled;
+
     /*
      * Counts that contributes to the internal refcount.
      * When the value changes, s_connection_manager_internal_ref_increase/decrease needed.
@@ -286,12 +343,97 @@ struct aws_http_connection_manager {
      */
     uint64_t max_connection_idle_in_milliseconds;
 
+    /*
+     * Pool warming, see min_idle_connections and enable_predictive_warming in the options.
+     * The fields below max_warming_connections are protected by the lock.
+     */
+    size_t min_idle_connections;
+    bool enable_predictive_warming;
+    size_t max_warming_connections;
+
+    /* See max_concurrent_proxy_negotiations in the options. 0 unless connections go through a tunneling proxy */
+    size_t max_proxy_negotiations;
+
+    /* Predictive warming. Moving averages of the time between acquisitions, and of connection setup time */
+    uint64_t last_acquisition_timestamp;
+    uint64_t acquisition_interval_ewma_ns;
+    uint64_t connection_setup_ewma_ns;
+
+    /* Warming is held off until this time after a connection fails, the backoff doubles with each failure */
+    uint64_t warming_retry_timestamp;
+    uint64_t warming_backoff_ms;
+
+    /*
+     * Adaptive culling, see adaptive_culling_window_in_milliseconds in the options.
+     * concurrency_peaks is a ring of the peak concurrency in each slot of the sliding window, the current slot
+     * started at concurrency_slot_start.  Those are protected by the lock.
+     */
+    uint64_t adaptive_culling_window_ms;
+    uint64_t surplus_connection_idle_ms;
+    size_t concurrency_peaks[CONCURRENCY_WINDOW_SLOTS];
+    size_t concurrency_slot;
+    uint64_t concurrency_slot_start;
+
+    /* Health steering, see degraded_health_score in the monitoring options. Protected by the lock */
+    uint64_t degraded_recycle_timestamp;
+
+    /*
+     * Multi-address mode, see enable_multi_address in the options.  managed_addresses is a list of
+     * struct aws_managed_address, refreshed from the resolver every so often.  Those are protected by the lock.
+     */
+    bool enable_multi_address;
+    struct aws_array_list managed_addresses;
+    uint64_t address_refresh_timestamp;
+    bool is_resolving_addresses;
+
+    /* Otherwise, connection attempts may race across addresses.  See connection_attempt_delay_ms in the options */
+    uint64_t connection_attempt_delay_ms;
+
+    /* NULL unless new connections are held back while a shared budget is exhausted.  See memory_budget in options */
+    struct aws_http_memory_budget *memory_budget;
+
+    /*
+     * The histograms and failure counts reported by aws_http_connection_manager_fetch_metrics().
+     * The gauges in it are unused, they're read off the current state instead.  Protected by the lock.
+     */
+    struct aws_http_manager_metrics metrics;
+
     /*
      * Task to cull idle connections.  This task is run periodically on the cull_event_loop if a non-zero
      * culling time interval is specified.
      */
     struct aws_task *cull_task;
     struct aws_event_loop *cull_event_loop;
+
+    /*
+     * Sharded mode (enable_sharding). The manager the user holds doesn't pool anything itself, it routes calls
+     * to one shard per event loop.  Each shard is a manager of its own, with its own lock, idle stack, pending
+     * acquisitions and transactions, and it shares the max_connections budget with the others through the
+     * parent's atomics.
+     */
+    struct aws_http_connection_manager **shards;
+    size_t shard_count;
+    /* Picks a shard for acquisitions from threads that aren't one of the shards' event loops */
+    struct aws_atomic_var next_shard;
+    /* Shards whose internal refcount hasn't dropped to zero. All shards are destroyed together after the last one */
+    struct aws_atomic_var live_shard_count;
+    /* Pending connects and open connections across all shards, held against max_connections */
+    struct aws_atomic_var shared_connection_count;
+    /* Shards with acquisitions that neither an idle connection nor a pending connect will serve */
+    struct aws_atomic_var starved_shard_count;
+
+    /* Only set on a shard */
+    struct aws_http_connection_manager *parent;
+    struct aws_event_loop *shard_event_loop;
+    size_t shard_index;
+    /*
+     * Mirrors of state protected by the lock, so other shards can skip this one without taking its lock.
+     * is_starved: acquisitions that neither an idle connection nor a pending connect will serve. While set, the
+     *     shard is counted in the parent's starved_shard_count.
+     * idle_connection_hint: idle_connection_count as of the last time the lock was released.
+     */
+    struct aws_atomic_var is_starved;
+    struct aws_atomic_var idle_connection_hint;
 };
 
 struct aws_http_connection_manager_snapshot {
@@ -358,6 +500,9 @@ void aws_http_connection_manager_set_system_vtable(
     AWS_FATAL_ASSERT(aws_http_connection_manager_system_vtable_is_valid(system_vtable));
 
     manager->system_vtable = system_vtable;
+    for (size_t i = 0; i < manager->shard_count; ++i) {
+        manager->shards[i]->system_vtable = system_vtable;
+    }
 }
 
 /*
@@ -381,6 +526,14 @@ struct aws_http_connection_acquisition {
     struct aws_http_connection *connection;
     int error_code;
     struct aws_channel_task acquisition_task;
+    uint64_t acquire_timestamp;
+    /* NULL if the acquisition has no event loop affinity */
+    struct aws_event_loop *event_loop;
+    /* AWS_HTTP_CONNECTION_MANAGER_AFFINITY_REQUIRE, only a connection on event_loop will do */
+    bool event_loop_required;
+    enum aws_http_connection_manager_acquisition_priority priority;
+    /* 0 if the acquisition doesn't time out */
+    uint64_t deadline_timestamp;
 };
 
 static void s_connection_acquisition_task(
@@ -398,15 +551,25 @@ static void s_connection_acquisition_task(
             AWS_LS_HTTP_CONNECTION_MANAGER,
             "id=%p: Failed to complete connection acquisition because the connection was closed",
             (void *)pending_acquisition->manager);
+        AWS_HTTP_PROBE3(
+            connection__manager__acquire, pending_acquisition->manager, NULL, AWS_ERROR_HTTP_CONNECTION_CLOSED);
         pending_acquisition->callback(NULL, AWS_ERROR_HTTP_CONNECTION_CLOSED, pending_acquisition->user_data);
-        /* release it back to prevent a leak of the connection count. */
-        aws_http_connection_manager_release_connection(pending_acquisition->manager, pending_acquisition->connection);
+        /* release it back to prevent a leak of the connection count. In sharded mode the connection may have come
+         * from another shard, so let the parent find its owner. */
+        struct aws_http_connection_manager *manager = pending_acquisition->manager;
+        aws_http_connection_manager_release_connection(
+            manager->parent ? manager->parent : manager, pending_acquisition->connection);
     } else {
         AWS_LOGF_DEBUG(
             AWS_LS_HTTP_CONNECTION_MANAGER,
             "id=%p: Successfully completed connection acquisition with connection id=%p",
             (void *)pending_acquisition->manager,
             (void *)pending_acquisition->connection);
+        AWS_HTTP_PROBE3(
+            connection__manager__acquire,
+            pending_acquisition->manager,
+            pending_acquisition->connection,
+            pending_acquisition->error_code);
         pending_acquisition->callback(
             pending_acquisition->connection, pending_acquisition->error_code, pending_acquisition->user_data);
     }
@@ -463,14 +626,51 @@ static void s_aws_http_connection_manager_complete_acquisitions(
                 aws_error_str(pending_acquisition->error_code));
         }
 
+        AWS_HTTP_PROBE3(
+            connection__manager__acquire,
+            pending_acquisition->manager,
+            pending_acquisition->connection,
+            pending_acquisition->error_code);
         pending_acquisition->callback(
             pending_acquisition->connection, pending_acquisition->error_code, pending_acquisition->user_data);
         aws_mem_release(allocator, pending_acquisition);
     }
 }
 
+static uint64_t s_manager_now(const struct aws_http_connection_manager *manager) {
+    uint64_t now = 0;
+    manager->system_vtable->aws_high_res_clock_get_ticks(&now);
+    return now;
+}
+
+/* Only invoked with the lock held */
+static void s_metrics_record_duration(
+    struct aws_http_latency_histogram *histogram,
+    uint64_t start_timestamp,
+    uint64_t end_timestamp) {
+
+    uint64_t duration_ns = end_timestamp > start_timestamp ? end_timestamp - start_timestamp : 0;
+    aws_http_latency_histogram_record(
+        histogram, aws_timestamp_convert(duration_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MICROS, NULL));
+}
+
+/* Only invoked with the lock held */
+static void s_metrics_record_connect_failure(struct aws_http_connection_manager *manager, int error_code) {
+    struct aws_http_manager_metrics *metrics = &manager->metrics;
+    ++metrics->connect_failure_count;
+
+    for (size_t i = 0; i < AWS_HTTP_MANAGER_METRICS_ERROR_CODE_SLOTS; ++i) {
+        struct aws_http_manager_error_count *slot = &metrics->connect_failures[i];
+        if (slot->count == 0 || slot->error_code == error_code) {
+            slot->error_code = error_code;
+            ++slot->count;
+            return;
+        }
+    }
+}
+
 /*
- * Moves the first pending connection acquisition into a (task set) list.  Call this while holding the lock to
+ * Moves a pending connection acquisition into a (task set) list.  Call this while holding the lock to
  * build the set of callbacks to be completed once the lock is released.
  *
  * Hard Requirement: Manager's lock must held somewhere in the call stack
@@ -479,14 +679,14 @@ static void s_aws_http_connection_manager_complete_acquisitions(
  * If this was a failed acquisition then connection is null and error_code is hopefully a useful diagnostic (extreme
  * edge cases exist where it may not be though)
  */
-static void s_aws_http_connection_manager_move_front_acquisition(
+static void s_aws_http_connection_manager_move_acquisition(
     struct aws_http_connection_manager *manager,
+    struct aws_linked_list_node *node,
     struct aws_http_connection *connection,
     int error_code,
     struct aws_linked_list *output_list) {
 
-    AWS_FATAL_ASSERT(!aws_linked_list_empty(&manager->pending_acquisitions));
-    struct aws_linked_list_node *node = aws_linked_list_pop_front(&manager->pending_acquisitions);
+    aws_linked_list_remove(node);
 
     AWS_FATAL_ASSERT(manager->pending_acquisition_count > 0);
     --manager->pending_acquisition_count;
@@ -504,9 +704,152 @@ static void s_aws_http_connection_manager_move_front_acquisition(
     pending_acquisition->connection = connection;
     pending_acquisition->error_code = error_code;
 
+    s_metrics_record_duration(
+        &manager->metrics.acquire_wait, pending_acquisition->acquire_timestamp, s_manager_now(manager));
+
+    if (pending_acquisition->event_loop) {
+        AWS_FATAL_ASSERT(manager->affine_acquisition_count > 0);
+        --manager->affine_acquisition_count;
+    }
+    if (pending_acquisition->deadline_timestamp) {
+        AWS_FATAL_ASSERT(manager->deadline_acquisition_count > 0);
+        --manager->deadline_acquisition_count;
+    }
+
     aws_linked_list_push_back(output_list, node);
 }
 
+/*
+ * Pending acquisitions are kept highest priority first, and in the order they were made within a priority,
+ * so the front of the list is always the next to serve.  Only invoked with the lock held.
+ */
+static void s_aws_http_connection_manager_insert_acquisition(
+    struct aws_http_connection_manager *manager,
+    struct aws_http_connection_acquisition *acquisition) {
+
+    /* Most acquisitions share a priority, so look for the spot from the back */
+    struct aws_linked_list_node *node = aws_linked_list_rbegin(&manager->pending_acquisitions);
+    while (node != aws_linked_list_rend(&manager->pending_acquisitions)) {
+        struct aws_http_connection_acquisition *current =
+            AWS_CONTAINER_OF(node, struct aws_http_connection_acquisition, node);
+        if (current->priority >= acquisition->priority) {
+            aws_linked_list_insert_after(node, &acquisition->node);
+            return;
+        }
+        node = aws_linked_list_prev(node);
+    }
+
+    aws_linked_list_push_front(&manager->pending_acquisitions, &acquisition->node);
+}
+
+/* Fails pending acquisitions that are past their deadline.  Only invoked with the lock held */
+static void s_aws_http_connection_manager_expire_acquisitions(
+    struct aws_http_connection_manager *manager,
+    struct aws_linked_list *output_list) {
+
+    if (manager->deadline_acquisition_count == 0) {
+        return;
+    }
+
+    uint64_t now = s_manager_now(manager);
+    struct aws_linked_list_node *node = aws_linked_list_begin(&manager->pending_acquisitions);
+    while (node != aws_linked_list_end(&manager->pending_acquisitions)) {
+        struct aws_http_connection_acquisition *acquisition =
+            AWS_CONTAINER_OF(node, struct aws_http_connection_acquisition, node);
+        node = aws_linked_list_next(node);
+        if (acquisition->deadline_timestamp == 0 || acquisition->deadline_timestamp > now) {
+            continue;
+        }
+
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_CONNECTION_MANAGER,
+            "id=%p: Failing pending connection acquisition that timed out",
+            (void *)manager);
+        s_aws_http_connection_manager_move_acquisition(
+            manager,
+            &acquisition->node,
+            NULL,
+            AWS_ERROR_HTTP_CONNECTION_MANAGER_ACQUISITION_TIMEOUT,
+            output_list);
+    }
+}
+
+/* Moves the first pending connection acquisition, see s_aws_http_connection_manager_move_acquisition() */
+static void s_aws_http_connection_manager_move_front_acquisition(
+    struct aws_http_connection_manager *manager,
+    struct aws_http_connection *connection,
+    int error_code,
+    struct aws_linked_list *output_list) {
+
+    AWS_FATAL_ASSERT(!aws_linked_list_empty(&manager->pending_acquisitions));
+    s_aws_http_connection_manager_move_acquisition(
+        manager, aws_linked_list_front(&manager->pending_acquisitions), connection, error_code, output_list);
+}
+
+/* The event loop a connection runs on */
+static struct aws_event_loop *s_connection_event_loop(
+    const struct aws_http_connection_manager *manager,
+    struct aws_http_connection *connection) {
+
+    struct aws_channel *channel = manager->system_vtable->aws_http_connection_get_channel(connection);
+    return channel ? aws_channel_get_event_loop(channel) : NULL;
+}
+
+/* Whether the connection's health has dropped below monitoring_options.degraded_health_score */
+static bool s_connection_is_degraded(
+    const struct aws_http_connection_manager *manager,
+    const struct aws_http_connection *connection) {
+
+    return manager->monitoring_options.degraded_health_score > 0 &&
+           manager->system_vtable->aws_http_connection_get_health_score != NULL &&
+           manager->system_vtable->aws_http_connection_get_health_score(connection) <
+               manager->monitoring_options.degraded_health_score;
+}
+
+/*
+ * Picks the idle connection to serve an acquisition with, NULL if the acquisition requires an event loop
+ * that has no idle connection.  Healthy connections win over the acquisition's preferred event loop,
+ * and degraded connections are only picked if there's nothing else.  Only invoked with the lock held.
+ *
+ * It is absolutely critical that this prefers the back of the list.  By making the idle connections
+ * a LIFO stack, the list will always be sorted from oldest (in terms of idle time) to newest.  This means
+ * we can always use the cull timestamp of the first connection as the next scheduled time for culling.
+ * It also means that when we cull connections, we can quit the loop as soon as we find a connection
+ * whose timestamp is greater than the current timestamp.  Taking a connection out of the middle keeps it sorted.
+ */
+static struct aws_idle_connection *s_aws_http_connection_manager_find_idle_connection(
+    struct aws_http_connection_manager *manager,
+    const struct aws_http_connection_acquisition *acquisition) {
+
+    AWS_FATAL_ASSERT(!aws_linked_list_empty(&manager->idle_connections));
+
+    /* Lower is better: 0 is healthy on the preferred event loop, 1 healthy elsewhere, 2 and 3 the same but degraded */
+    struct aws_idle_connection *best = NULL;
+    int best_rank = 0;
+    for (struct aws_linked_list_node *node = aws_linked_list_rbegin(&manager->idle_connections);
+         node != aws_linked_list_rend(&manager->idle_connections) && (best == NULL || best_rank > 0);
+         node = aws_linked_list_prev(node)) {
+        struct aws_idle_connection *idle_connection = AWS_CONTAINER_OF(node, struct aws_idle_connection, node);
+        int rank = 0;
+        if (acquisition->event_loop &&
+            s_connection_event_loop(manager, idle_connection->connection) != acquisition->event_loop) {
+            if (acquisition->event_loop_required) {
+                continue;
+            }
+            rank += 1;
+        }
+        if (s_connection_is_degraded(manager, idle_connection->connection)) {
+            rank += 2;
+        }
+        if (best == NULL || rank < best_rank) {
+            best = idle_connection;
+            best_rank = rank;
+        }
+    }
+
+    return best;
+}
+
 /*
  * Encompasses all of the external operations that need to be done for various
  * events:
@@ -527,6 +870,12 @@ struct aws_connection_management_transaction {
     struct aws_linked_list connections_to_release; /* <struct aws_idle_connection> */
     struct aws_http_connection_manager_snapshot snapshot;
     size_t new_connections;
+    /* Event loops to pin the new connections to (NULL for none). Only set up if acquisitions have affinity */
+    struct aws_array_list new_connection_event_loops; /* <struct aws_event_loop *> */
+    /* Sharded mode. Whether this shard was starved (see is_starved) when the transaction was built */
+    bool shard_starved;
+    /* Sharded mode. Set if the transaction was started on behalf of another shard, which does the rebalancing */
+    bool is_shard_kick;
 };
 
 static void s_aws_connection_management_transaction_init(
@@ -545,6 +894,7 @@ static void s_aws_connection_management_transaction_clean_up(struct aws_connecti
     AWS_FATAL_ASSERT(aws_linked_list_empty(&work->connections_to_release));
     AWS_FATAL_ASSERT(aws_linked_list_empty(&work->completions));
     AWS_ASSERT(work->manager);
+    aws_array_list_clean_up(&work->new_connection_event_loops);
     aws_ref_count_release(&work->manager->internal_ref_count);
 }
 
@@ -573,25 +923,326 @@ static void s_connection_manager_internal_ref_decrease(
     }
 }
 
+/*
+ * Sharded mode: a shard has acquisitions that neither an idle connection nor a pending connect will serve,
+ * because the shared budget ran out.  Only invoked with the lock held.
+ */
+static bool s_shard_should_be_starved(const struct aws_http_connection_manager *manager) {
+    return manager->state == AWS_HCMST_READY &&
+           manager->pending_acquisition_count >
+               manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS] + manager->pending_settings_count;
+}
+
+/* Sharded mode: refresh what other shards can see of this one. Only invoked with the lock held */
+static void s_shard_update_hints(struct aws_http_connection_manager *manager) {
+    if (manager->parent == NULL) {
+        return;
+    }
+
+    aws_atomic_store_int(&manager->idle_connection_hint, manager->idle_connection_count);
+
+    size_t is_starved = s_shard_should_be_starved(manager);
+    if (is_starved != aws_atomic_load_int(&manager->is_starved)) {
+        aws_atomic_store_int(&manager->is_starved, is_starved);
+        if (is_starved) {
+            aws_atomic_fetch_add(&manager->parent->starved_shard_count, 1);
+        } else {
+            aws_atomic_fetch_sub(&manager->parent->starved_shard_count, 1);
+        }
+    }
+}
+
+/*
+ * Sharded mode: take up to num new connections out of the budget shared by all shards, returns how many we got.
+ * Not sharded: the manager's own counts already hold it to max_connections.
+ */
+static size_t s_shard_reserve_connections(struct aws_http_connection_manager *manager, size_t num) {
+    if (manager->parent == NULL || num == 0) {
+        return num;
+    }
+
+    struct aws_atomic_var *shared_count = &manager->parent->shared_connection_count;
+    size_t current = aws_atomic_load_int(shared_count);
+    size_t reserved = 0;
+    do {
+        if (current >= manager->max_connections) {
+            return 0;
+        }
+        reserved = aws_min_size(num, manager->max_connections - current);
+    } while (!aws_atomic_compare_exchange_int(shared_count, &current, current + reserved));
+
+    return reserved;
+}
+
+/* Sharded mode: return connections that failed or shut down to the shared budget */
+static void s_shard_release_connections(struct aws_http_connection_manager *manager, size_t num) {
+    if (manager->parent == NULL || num == 0) {
+        return;
+    }
+
+    AWS_FATAL_ASSERT(aws_atomic_load_int(&manager->parent->shared_connection_count) >= num);
+    aws_atomic_fetch_sub(&manager->parent->shared_connection_count, num);
+}
+
+static const size_t s_default_max_warming_connections = 2;
+static const uint64_t s_warming_min_backoff_ms = 100;
+static const uint64_t s_warming_max_backoff_ms = 10000;
+/* How often the cull task checks on the pool when only warming needs it */
+static const uint64_t s_warming_check_interval_ms = 1000;
+
+static bool s_warming_enabled(const struct aws_http_connection_manager *manager) {
+    return manager->min_idle_connections > 0 || manager->enable_predictive_warming;
+}
+
+/* Whether the cull task has anything to do */
+static bool s_culling_enabled(const struct aws_http_connection_manager *manager) {
+    return manager->max_connection_idle_in_milliseconds > 0 || manager->adaptive_culling_window_ms > 0 ||
+           s_warming_enabled(manager);
+}
+
+/*
+ * How many more connections can start negotiating proxy tunnels right now, capped at num.
+ * Only invoked with the lock held.
+ */
+static size_t s_proxy_negotiations_available(const struct aws_http_connection_manager *manager, size_t num) {
+    if (manager->max_proxy_negotiations == 0) {
+        return num;
+    }
+
+    return aws_min_size(
+        num,
+        aws_sub_size_saturating(manager->max_proxy_negotiations, manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS]));
+}
+
+/*
+ * How many more connections the memory budget allows right now, capped at num.  While it's exhausted, acquisitions
+ * wait for the connections this manager already has, unless it has none at all.
+ * Only invoked with the lock held.
+ */
+static size_t s_memory_budget_connections_available(const struct aws_http_connection_manager *manager, size_t num) {
+    if (manager->memory_budget == NULL || num == 0 || !aws_http_memory_budget_is_exhausted(manager->memory_budget)) {
+        return num;
+    }
+
+    size_t connection_count = manager->internal_ref[AWS_HCMCT_VENDED_CONNECTION] +
+                              manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS] + manager->pending_settings_count +
+                              manager->idle_connection_count;
+    if (connection_count == 0) {
+        return 1;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_CONNECTION_MANAGER,
+        "id=%p: Memory budget exhausted, acquisitions wait for one of %zu connections instead of %zu new ones",
+        (void *)manager,
+        connection_count,
+        num);
+    return 0;
+}
+
+/* Weighs each new sample 1/8, same as a TCP RTT estimator */
+static void s_ewma_update(uint64_t *ewma, uint64_t sample) {
+    if (*ewma == 0) {
+        *ewma = sample;
+    } else {
+        *ewma = *ewma - *ewma / 8 + sample / 8;
+    }
+}
+
+/* Only invoked with the lock held */
+static void s_warming_on_acquisition(struct aws_http_connection_manager *manager) {
+    if (!manager->enable_predictive_warming) {
+        return;
+    }
+
+    uint64_t now = s_manager_now(manager);
+    if (manager->last_acquisition_timestamp != 0 && now > manager->last_acquisition_timestamp) {
+        s_ewma_update(&manager->acquisition_interval_ewma_ns, now - manager->last_acquisition_timestamp);
+    }
+    manager->last_acquisition_timestamp = now;
+}
+
+/* A new connection set up, or failed to. Only invoked with the lock held */
+static void s_warming_on_connection_done(
+    struct aws_http_connection_manager *manager,
+    int error_code,
+    uint64_t connect_timestamp,
+    uint64_t now) {
+
+    if (!s_warming_enabled(manager)) {
+        return;
+    }
+
+    if (manager->enable_predictive_warming && !error_code && now > connect_timestamp) {
+        s_ewma_update(&manager->connection_setup_ewma_ns, now - connect_timestamp);
+    }
+
+    if (error_code) {
+        manager->warming_backoff_ms = manager->warming_backoff_ms == 0
+                                          ? s_warming_min_backoff_ms
+                                          : aws_min_u64(manager->warming_backoff_ms * 2, s_warming_max_backoff_ms);
+        manager->warming_retry_timestamp =
+            now + aws_timestamp_convert(manager->warming_backoff_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    } else {
+        manager->warming_backoff_ms = 0;
+        manager->warming_retry_timestamp = 0;
+    }
+}
+
+/* How many connections to keep idle. Only invoked with the lock held */
+static size_t s_warming_target(const struct aws_http_connection_manager *manager, uint64_t now) {
+    size_t target = manager->min_idle_connections;
+
+    if (manager->enable_predictive_warming && manager->acquisition_interval_ewma_ns > 0 &&
+        manager->connection_setup_ewma_ns > 0) {
+        /* Once acquisitions stop, the time since the last one takes over, and the prediction decays */
+        uint64_t interval =
+            aws_max_u64(manager->acquisition_interval_ewma_ns, now - manager->last_acquisition_timestamp);
+        uint64_t predicted = manager->connection_setup_ewma_ns / interval;
+        target = (size_t)aws_max_u64(target, aws_min_u64(predicted, manager->max_connections));
+    }
+
+    return target;
+}
+
+/*
+ * Adds connections to the transaction to bring the idle connections, and those that will be idle once set up,
+ * up to the warming target.  Only invoked with the lock held, while READY.
+ */
+static void s_warming_build_transaction(struct aws_connection_management_transaction *work) {
+    struct aws_http_connection_manager *manager = work->manager;
+    if (!s_warming_enabled(manager)) {
+        return;
+    }
+
+    uint64_t now = s_manager_now(manager);
+    if (now < manager->warming_retry_timestamp) {
+        return;
+    }
+
+    size_t connecting = manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS] + manager->pending_settings_count;
+    size_t warm_count = manager->idle_connection_count +
+                        aws_sub_size_saturating(connecting, manager->pending_acquisition_count);
+    size_t target = s_warming_target(manager, now);
+    if (warm_count >= target) {
+        return;
+    }
+
+    /* Warm connections would only draw on memory the budget can't spare */
+    if (manager->memory_budget && aws_http_memory_budget_is_exhausted(manager->memory_budget)) {
+        return;
+    }
+
+    size_t new_connections = target - warm_count;
+    new_connections = aws_min_size(
+        new_connections,
+        aws_sub_size_saturating(
+            manager->max_connections,
+            manager->internal_ref[AWS_HCMCT_VENDED_CONNECTION] + connecting + manager->idle_connection_count));
+    new_connections = aws_min_size(
+        new_connections,
+        aws_sub_size_saturating(
+            manager->max_warming_connections, manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS]));
+    new_connections = s_proxy_negotiations_available(manager, new_connections);
+    new_connections = s_shard_reserve_connections(manager, new_connections);
+    if (new_connections == 0) {
+        return;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_CONNECTION_MANAGER,
+        "id=%p: Warming up %zu connections for a target of %zu idle",
+        (void *)manager,
+        new_connections,
+        target);
+    work->new_connections += new_connections;
+    s_connection_manager_internal_ref_increase(manager, AWS_HCMCT_PENDING_CONNECTIONS, new_connections);
+}
+
+static const uint64_t s_default_surplus_connection_idle_ms = 1000;
+
+static uint64_t s_concurrency_slot_ns(const struct aws_http_connection_manager *manager) {
+    return aws_timestamp_convert(
+               manager->adaptive_culling_window_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL) /
+           CONCURRENCY_WINDOW_SLOTS;
+}
+
+/* Moves the sliding window up to now, and returns the peak concurrency in it. Only invoked with the lock held */
+static size_t s_concurrency_window_peak(struct aws_http_connection_manager *manager, uint64_t now) {
+    uint64_t slot_ns = aws_max_u64(s_concurrency_slot_ns(manager), 1);
+    if (now - manager->concurrency_slot_start >= slot_ns * CONCURRENCY_WINDOW_SLOTS) {
+        /* The whole window went by */
+        AWS_ZERO_ARRAY(manager->concurrency_peaks);
+        manager->concurrency_slot_start = now;
+    }
+    while (now - manager->concurrency_slot_start >= slot_ns) {
+        manager->concurrency_slot = (manager->concurrency_slot + 1) % CONCURRENCY_WINDOW_SLOTS;
+        manager->concurrency_peaks[manager->concurrency_slot] = 0;
+        manager->concurrency_slot_start += slot_ns;
+    }
+
+    size_t peak = 0;
+    for (size_t i = 0; i < CONCURRENCY_WINDOW_SLOTS; ++i) {
+        peak = aws_max_size(peak, manager->concurrency_peaks[i]);
+    }
+    return peak;
+}
+
+/* Only invoked with the lock held */
+static void s_concurrency_window_update(struct aws_http_connection_manager *manager) {
+    if (manager->adaptive_culling_window_ms == 0) {
+        return;
+    }
+
+    s_concurrency_window_peak(manager, s_manager_now(manager));
+    size_t concurrency = manager->internal_ref[AWS_HCMCT_VENDED_CONNECTION] + manager->pending_acquisition_count;
+    size_t *slot_peak = &manager->concurrency_peaks[manager->concurrency_slot];
+    *slot_peak = aws_max_size(*slot_peak, concurrency);
+}
+
+/*
+ * How many idle connections adaptive culling keeps to the regular idle timeout, SIZE_MAX if it's off.
+ * Only invoked with the lock held.
+ */
+static size_t s_adaptive_culling_keep_count(struct aws_http_connection_manager *manager, uint64_t now) {
+    if (manager->adaptive_culling_window_ms == 0) {
+        return SIZE_MAX;
+    }
+
+    size_t peak = s_concurrency_window_peak(manager, now);
+    return aws_max_size(
+        manager->min_idle_connections,
+        aws_sub_size_saturating(peak, manager->internal_ref[AWS_HCMCT_VENDED_CONNECTION]));
+}
+
 /* Only invoked with the lock held */
 static void s_aws_http_connection_manager_build_transaction(struct aws_connection_management_transaction *work) {
     struct aws_http_connection_manager *manager = work->manager;
 
     if (manager->state == AWS_HCMST_READY) {
         /*
-         * Step 1 - If there's free connections, complete acquisition requests
+         * Step 0 - Acquisitions that timed out shouldn't take a connection
+         */
+        s_aws_http_connection_manager_expire_acquisitions(manager, &work->completions);
+
+        /*
+         * Step 1 - If there's free connections, complete acquisition requests.  An acquisition that requires
+         * an event loop with no idle connection is passed over, and keeps waiting.
          */
-        while (!aws_linked_list_empty(&manager->idle_connections) > 0 && manager->pending_acquisition_count > 0) {
+        struct aws_linked_list_node *acquisition_node = aws_linked_list_begin(&manager->pending_acquisitions);
+        while (!aws_linked_list_empty(&manager->idle_connections) &&
+               acquisition_node != aws_linked_list_end(&manager->pending_acquisitions)) {
             AWS_FATAL_ASSERT(manager->idle_connection_count >= 1);
-            /*
-             * It is absolutely critical that this is pop_back and not front.  By making the idle connections
-             * a LIFO stack, the list will always be sorted from oldest (in terms of idle time) to newest.  This means
-             * we can always use the cull timestamp of the first connection as the next scheduled time for culling.
-             * It also means that when we cull connections, we can quit the loop as soon as we find a connection
-             * whose timestamp is greater than the current timestamp.
-             */
-            struct aws_linked_list_node *node = aws_linked_list_pop_back(&manager->idle_connections);
-            struct aws_idle_connection *idle_connection = AWS_CONTAINER_OF(node, struct aws_idle_connection, node);
+            struct aws_http_connection_acquisition *acquisition =
+                AWS_CONTAINER_OF(acquisition_node, struct aws_http_connection_acquisition, node);
+            acquisition_node = aws_linked_list_next(acquisition_node);
+
+            struct aws_idle_connection *idle_connection =
+                s_aws_http_connection_manager_find_idle_connection(manager, acquisition);
+            if (idle_connection == NULL) {
+                continue;
+            }
+            aws_linked_list_remove(&idle_connection->node);
             struct aws_http_connection *connection = idle_connection->connection;
 
             AWS_LOGF_DEBUG(
@@ -599,8 +1250,8 @@ static void s_aws_http_connection_manager_build_transaction(struct aws_connectio
                 "id=%p: Grabbing pooled connection (%p)",
                 (void *)manager,
                 (void *)connection);
-            s_aws_http_connection_manager_move_front_acquisition(
-                manager, connection, AWS_ERROR_SUCCESS, &work->completions);
+            s_aws_http_connection_manager_move_acquisition(
+                manager, &acquisition->node, connection, AWS_ERROR_SUCCESS, &work->completions);
             s_connection_manager_internal_ref_increase(manager, AWS_HCMCT_VENDED_CONNECTION, 1);
             --manager->idle_connection_count;
             aws_mem_release(idle_connection->allocator, idle_connection);
@@ -619,16 +1270,54 @@ static void s_aws_http_connection_manager_build_transaction(struct aws_connectio
             work->new_connections = manager->pending_acquisition_count -
                                     manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS] -
                                     manager->pending_settings_count;
-            size_t max_new_connections =
-                manager->max_connections -
-                (manager->internal_ref[AWS_HCMCT_VENDED_CONNECTION] +
-                 manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS] + manager->pending_settings_count);
+            /* Idle connections are only left here if they're on the wrong event loop for what's pending */
+            size_t max_new_connections = aws_sub_size_saturating(
+                manager->max_connections,
+                manager->internal_ref[AWS_HCMCT_VENDED_CONNECTION] +
+                    manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS] + manager->pending_settings_count +
+                    manager->idle_connection_count);
+
+            while (work->new_connections > max_new_connections && manager->idle_connection_count > 0) {
+                /* Close the oldest to make room for one on the right event loop */
+                struct aws_linked_list_node *node = aws_linked_list_pop_front(&manager->idle_connections);
+                aws_linked_list_push_back(&work->connections_to_release, node);
+                --manager->idle_connection_count;
+                ++max_new_connections;
+            }
 
             if (work->new_connections > max_new_connections) {
                 work->new_connections = max_new_connections;
             }
+            /* The rest wait for a tunnel negotiation to finish, and are picked up by the transaction it triggers */
+            work->new_connections = s_proxy_negotiations_available(manager, work->new_connections);
+            work->new_connections = s_memory_budget_connections_available(manager, work->new_connections);
+            work->new_connections = s_shard_reserve_connections(manager, work->new_connections);
             s_connection_manager_internal_ref_increase(manager, AWS_HCMCT_PENDING_CONNECTIONS, work->new_connections);
+
+            /*
+             * Pending connections are counted against the oldest acquisitions, so the new ones are for
+             * the newest.  Pin each to the event loop its acquisition wants.
+             */
+            if (manager->affine_acquisition_count > 0 && work->new_connections > 0 &&
+                aws_array_list_init_dynamic(
+                    &work->new_connection_event_loops,
+                    work->allocator,
+                    work->new_connections,
+                    sizeof(struct aws_event_loop *)) == AWS_OP_SUCCESS) {
+                struct aws_linked_list_node *node = aws_linked_list_rbegin(&manager->pending_acquisitions);
+                for (size_t i = 0; i < work->new_connections; ++i) {
+                    struct aws_http_connection_acquisition *acquisition =
+                        AWS_CONTAINER_OF(node, struct aws_http_connection_acquisition, node);
+                    aws_array_list_push_back(&work->new_connection_event_loops, &acquisition->event_loop);
+                    node = aws_linked_list_prev(node);
+                }
+            }
         }
+
+        /*
+         * Step 3 - Keep the pool warm
+         */
+        s_warming_build_transaction(work);
     } else {
         /*
          * swap our internal connection set with the empty work set
@@ -657,6 +1346,10 @@ static void s_aws_http_connection_manager_build_transaction(struct aws_connectio
         manager->pending_acquisition_count = 0;
     }
 
+    s_concurrency_window_update(manager);
+    s_shard_update_hints(manager);
+    work->shard_starved = aws_atomic_load_int(&manager->is_starved) != 0;
+
     s_aws_http_connection_manager_get_snapshot(manager, &work->snapshot);
 }
 
@@ -687,6 +1380,12 @@ static void s_aws_http_connection_manager_finish_destroy(struct aws_http_connect
     AWS_FATAL_ASSERT(aws_linked_list_empty(&manager->idle_connections));
 
     aws_string_destroy(manager->host);
+    for (size_t i = 0; i < aws_array_list_length(&manager->managed_addresses); ++i) {
+        struct aws_managed_address *managed_address = NULL;
+        aws_array_list_get_at_ptr(&manager->managed_addresses, (void **)&managed_address, i);
+        aws_string_destroy(managed_address->address);
+    }
+    aws_array_list_clean_up(&manager->managed_addresses);
     if (manager->initial_settings) {
         aws_array_list_clean_up(manager->initial_settings);
         aws_mem_release(manager->allocator, manager->initial_settings);
@@ -702,6 +1401,7 @@ static void s_aws_http_connection_manager_finish_destroy(struct aws_http_connect
     if (manager->proxy_config) {
         aws_http_proxy_config_destroy(manager->proxy_config);
     }
+    aws_http_memory_budget_release(manager->memory_budget);
 
     /*
      * If this task exists then we are actually in the corresponding event loop running the final destruction task.
@@ -723,8 +1423,44 @@ static void s_aws_http_connection_manager_finish_destroy(struct aws_http_connect
     aws_mem_release(manager->allocator, manager);
 }
 
-/* This is scheduled to run on the cull task's event loop. Should only be scheduled to run if we have one  */
-static void s_final_destruction_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+/* Sharded mode: the manager the user holds, and all its shards, are destroyed once every shard is done */
+static void s_sharded_connection_manager_destroy(struct aws_http_connection_manager *manager) {
+    AWS_LOGF_INFO(AWS_LS_HTTP_CONNECTION_MANAGER, "id=%p: Destroying self and shards", (void *)manager);
+
+    for (size_t i = 0; i < manager->shard_count; ++i) {
+        s_aws_http_connection_manager_finish_destroy(manager->shards[i]);
+    }
+    aws_mem_release(manager->allocator, manager->shards);
+
+    aws_mutex_clean_up(&manager->lock);
+
+    if (manager->shutdown_complete_callback) {
+        manager->shutdown_complete_callback(manager->shutdown_complete_user_data);
+    }
+
+    aws_mem_release(manager->allocator, manager);
+}
+
+/*
+ * Invoked when the internal refcount drops to zero.  A shard isn't destroyed until all the shards are done,
+ * so while a shard is alive it can safely reach into any other shard.
+ */
+static void s_aws_http_connection_manager_on_zero_internal_refs(void *user_data) {
+    struct aws_http_connection_manager *manager = user_data;
+    if (manager->parent == NULL) {
+        s_aws_http_connection_manager_finish_destroy(manager);
+        return;
+    }
+
+    struct aws_http_connection_manager *parent = manager->parent;
+    AWS_LOGF_DEBUG(AWS_LS_HTTP_CONNECTION_MANAGER, "id=%p: Shard id=%p done", (void *)parent, (void *)manager);
+    if (aws_atomic_fetch_sub(&parent->live_shard_count, 1) == 1) {
+        s_sharded_connection_manager_destroy(parent);
+    }
+}
+
+/* This is scheduled to run on the cull task's event loop. Should only be scheduled to run if we have one  */
+static void s_final_destruction_task(struct aws_task *task, void *arg, enum aws_task_status status) {
     (void)status;
     struct aws_http_connection_manager *manager = arg;
     struct aws_allocator *allocator = manager->allocator;
@@ -740,8 +1476,9 @@ static void s_final_destruction_task(struct aws_task *task, void *arg, enum aws_
 }
 
 static void s_cull_task(struct aws_task *task, void *arg, enum aws_task_status status);
+static void s_acquisition_timeout_task(struct aws_task *task, void *arg, enum aws_task_status status);
 static void s_schedule_connection_culling(struct aws_http_connection_manager *manager) {
-    if (manager->max_connection_idle_in_milliseconds == 0) {
+    if (!s_culling_enabled(manager)) {
         return;
     }
 
@@ -753,16 +1490,21 @@ static void s_schedule_connection_culling(struct aws_http_connection_manager *ma
     }
 
     if (manager->cull_event_loop == NULL) {
-        manager->cull_event_loop = aws_event_loop_group_get_next_loop(manager->bootstrap->event_loop_group);
+        /* A shard culls on its own event loop, same as its connections */
+        manager->cull_event_loop = manager->shard_event_loop
+                                       ? manager->shard_event_loop
+                                       : aws_event_loop_group_get_next_loop(manager->bootstrap->event_loop_group);
     }
     AWS_FATAL_ASSERT(manager->cull_event_loop != NULL);
 
-    uint64_t cull_task_time = 0;
+    uint64_t cull_task_time = UINT64_MAX;
 
     aws_mutex_lock(&manager->lock);
     const struct aws_linked_list_node *end = aws_linked_list_end(&manager->idle_connections);
     struct aws_linked_list_node *oldest_node = aws_linked_list_begin(&manager->idle_connections);
-    if (oldest_node != end) {
+    if (manager->max_connection_idle_in_milliseconds == 0) {
+        /* No regular idle timeout, only checking on warming and surplus connections */
+    } else if (oldest_node != end) {
         /*
          * Since the connections are in LIFO order in the list, the front of the list has the closest
          * cull time.
@@ -781,6 +1523,31 @@ static void s_schedule_connection_culling(struct aws_http_connection_manager *ma
             now + aws_timestamp_convert(
                       manager->max_connection_idle_in_milliseconds, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
     }
+    if (s_warming_enabled(manager)) {
+        /* Check back on the pool in case warming was held off, or nothing else happens to kick it */
+        uint64_t now = 0;
+        manager->system_vtable->aws_high_res_clock_get_ticks(&now);
+        cull_task_time = aws_min_u64(
+            cull_task_time,
+            now + aws_timestamp_convert(s_warming_check_interval_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
+    }
+    if (manager->adaptive_culling_window_ms > 0 && oldest_node != end) {
+        /*
+         * The oldest idle connection is the next to become surplus.  If it's already past the surplus timeout,
+         * the recent peak is holding onto it, so check back once the window has moved on a slot.
+         */
+        uint64_t now = 0;
+        manager->system_vtable->aws_high_res_clock_get_ticks(&now);
+        struct aws_idle_connection *oldest_idle_connection =
+            AWS_CONTAINER_OF(oldest_node, struct aws_idle_connection, node);
+        uint64_t surplus_cull_time =
+            oldest_idle_connection->idle_start_timestamp +
+            aws_timestamp_convert(manager->surplus_connection_idle_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+        if (surplus_cull_time <= now) {
+            surplus_cull_time = now + aws_max_u64(s_concurrency_slot_ns(manager), 1);
+        }
+        cull_task_time = aws_min_u64(cull_task_time, surplus_cull_time);
+    }
     aws_mutex_unlock(&manager->lock);
 
     aws_event_loop_schedule_task_future(manager->cull_event_loop, manager->cull_task, cull_task_time);
@@ -788,6 +1555,15 @@ static void s_schedule_connection_culling(struct aws_http_connection_manager *ma
     return;
 }
 
+static struct aws_http_connection_manager *s_connection_manager_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_connection_manager_options *options,
+    struct aws_http_connection_manager *parent,
+    size_t shard_index);
+static struct aws_http_connection_manager *s_sharded_connection_manager_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_connection_manager_options *options);
+
 struct aws_http_connection_manager *aws_http_connection_manager_new(
     struct aws_allocator *allocator,
     const struct aws_http_connection_manager_options *options) {
@@ -812,6 +1588,13 @@ struct aws_http_connection_manager *aws_http_connection_manager_new(
         return NULL;
     }
 
+    if (options->min_idle_connections > options->max_connections) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION_MANAGER, "Invalid options - min_idle_connections cannot exceed max_connections");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
     if (options->tls_connection_options && options->http2_prior_knowledge) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_CONNECTION_MANAGER, "Invalid options - HTTP/2 prior knowledge cannot be set when TLS is used");
@@ -819,6 +1602,24 @@ struct aws_http_connection_manager *aws_http_connection_manager_new(
         return NULL;
     }
 
+    if (options->enable_sharding) {
+        if (options->bootstrap == NULL) {
+            AWS_LOGF_ERROR(AWS_LS_HTTP_CONNECTION_MANAGER, "Invalid options - sharding requires a bootstrap");
+            aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+            return NULL;
+        }
+        return s_sharded_connection_manager_new(allocator, options);
+    }
+
+    return s_connection_manager_new(allocator, options, NULL /*parent*/, 0 /*shard_index*/);
+}
+
+static struct aws_http_connection_manager *s_connection_manager_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_connection_manager_options *options,
+    struct aws_http_connection_manager *parent,
+    size_t shard_index) {
+
     struct aws_http_connection_manager *manager =
         aws_mem_calloc(allocator, 1, sizeof(struct aws_http_connection_manager));
     if (manager == NULL) {
@@ -831,24 +1632,44 @@ struct aws_http_connection_manager *aws_http_connection_manager_new(
         goto on_error;
     }
 
-    aws_ref_count_init(
-        &manager->internal_ref_count,
-        manager,
-        (aws_simple_completion_callback *)s_aws_http_connection_manager_finish_destroy);
+    aws_ref_count_init(&manager->internal_ref_count, manager, s_aws_http_connection_manager_on_zero_internal_refs);
+
+    if (parent) {
+        manager->parent = parent;
+        manager->shard_index = shard_index;
+        manager->shard_event_loop = aws_event_loop_group_get_loop_at(options->bootstrap->event_loop_group, shard_index);
+        aws_atomic_init_int(&manager->is_starved, 0);
+        aws_atomic_init_int(&manager->idle_connection_hint, 0);
+    }
 
     aws_linked_list_init(&manager->idle_connections);
     aws_linked_list_init(&manager->pending_acquisitions);
+    aws_task_init(&manager->acquisition_timeout_task, s_acquisition_timeout_task, manager, "acquisition_timeout");
+    if (aws_array_list_init_dynamic(&manager->managed_addresses, allocator, 0, sizeof(struct aws_managed_address))) {
+        goto on_error;
+    }
 
     manager->host = aws_string_new_from_cursor(allocator, &options->host);
     if (manager->host == NULL) {
         goto on_error;
     }
 
+    manager->enable_multi_address = options->enable_multi_address && options->proxy_options == NULL;
+    manager->connection_attempt_delay_ms = options->connection_attempt_delay_ms;
+    manager->memory_budget = aws_http_memory_budget_acquire(options->memory_budget);
     if (options->tls_connection_options) {
+        /* The copy shares the caller's aws_tls_ctx, and with it any TLS session cache the platform keeps there */
         manager->tls_connection_options = aws_mem_calloc(allocator, 1, sizeof(struct aws_tls_connection_options));
         if (aws_tls_connection_options_copy(manager->tls_connection_options, options->tls_connection_options)) {
             goto on_error;
         }
+        if (manager->enable_multi_address && manager->tls_connection_options->server_name == NULL) {
+            /* Connections are made to addresses, so the host has to be named for SNI */
+            if (aws_tls_connection_options_set_server_name(
+                    manager->tls_connection_options, allocator, &options->host)) {
+                goto on_error;
+            }
+        }
     }
     if (options->proxy_options) {
         manager->proxy_config = aws_http_proxy_config_new_from_manager_options(allocator, options);
@@ -873,6 +1694,17 @@ struct aws_http_connection_manager *aws_http_connection_manager_new(
     manager->shutdown_complete_user_data = options->shutdown_complete_user_data;
     manager->enable_read_back_pressure = options->enable_read_back_pressure;
     manager->max_connection_idle_in_milliseconds = options->max_connection_idle_in_milliseconds;
+    manager->min_idle_connections = options->min_idle_connections;
+    manager->enable_predictive_warming = options->enable_predictive_warming;
+    manager->max_warming_connections =
+        options->max_warming_connections ? options->max_warming_connections : s_default_max_warming_connections;
+    if (manager->proxy_config && manager->proxy_config->connection_type == AWS_HPCT_HTTP_TUNNEL) {
+        manager->max_proxy_negotiations = options->max_concurrent_proxy_negotiations;
+    }
+    manager->adaptive_culling_window_ms = options->adaptive_culling_window_in_milliseconds;
+    manager->surplus_connection_idle_ms = options->surplus_connection_idle_in_milliseconds
+                                              ? options->surplus_connection_idle_in_milliseconds
+                                              : s_default_surplus_connection_idle_ms;
     if (options->proxy_ev_settings) {
         manager->proxy_ev_settings = *options->proxy_ev_settings;
     }
@@ -901,6 +1733,16 @@ struct aws_http_connection_manager *aws_http_connection_manager_new(
 
     AWS_LOGF_INFO(AWS_LS_HTTP_CONNECTION_MANAGER, "id=%p: Successfully created", (void *)manager);
 
+    if (manager->min_idle_connections > 0) {
+        /* Start warming up the pool right away */
+        struct aws_connection_management_transaction work;
+        s_aws_connection_management_transaction_init(&work, manager);
+        aws_mutex_lock(&manager->lock);
+        s_aws_http_connection_manager_build_transaction(&work);
+        aws_mutex_unlock(&manager->lock);
+        s_aws_http_connection_manager_execute_transaction(&work);
+    }
+
     return manager;
 
 on_error:
@@ -910,6 +1752,146 @@ on_error:
     return NULL;
 }
 
+static struct aws_http_connection_manager *s_sharded_connection_manager_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_connection_manager_options *options) {
+
+    size_t shard_count = aws_event_loop_group_get_loop_count(options->bootstrap->event_loop_group);
+    AWS_FATAL_ASSERT(shard_count > 0);
+
+    struct aws_http_connection_manager *manager =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_http_connection_manager));
+    if (manager == NULL) {
+        return NULL;
+    }
+
+    manager->allocator = allocator;
+    if (aws_mutex_init(&manager->lock)) {
+        aws_mem_release(allocator, manager);
+        return NULL;
+    }
+
+    manager->shards = aws_mem_calloc(allocator, shard_count, sizeof(struct aws_http_connection_manager *));
+    manager->state = AWS_HCMST_READY;
+    manager->max_connections = options->max_connections;
+    manager->system_vtable = g_aws_http_connection_manager_default_system_vtable_ptr;
+    manager->external_ref_count = 1;
+    manager->shutdown_complete_callback = options->shutdown_complete_callback;
+    manager->shutdown_complete_user_data = options->shutdown_complete_user_data;
+    aws_atomic_init_int(&manager->next_shard, 0);
+    aws_atomic_init_int(&manager->live_shard_count, 0);
+    aws_atomic_init_int(&manager->shared_connection_count, 0);
+    aws_atomic_init_int(&manager->starved_shard_count, 0);
+
+    struct aws_http_connection_manager_options shard_options = *options;
+    shard_options.enable_sharding = false;
+    shard_options.shutdown_complete_callback = NULL;
+    shard_options.shutdown_complete_user_data = NULL;
+    /* Rounded up, so the shards together keep at least what was asked for */
+    shard_options.min_idle_connections = (options->min_idle_connections + shard_count - 1) / shard_count;
+    shard_options.max_concurrent_proxy_negotiations =
+        (options->max_concurrent_proxy_negotiations + shard_count - 1) / shard_count;
+
+    for (size_t i = 0; i < shard_count; ++i) {
+        struct aws_http_connection_manager *shard = s_connection_manager_new(allocator, &shard_options, manager, i);
+        if (shard == NULL) {
+            goto on_error;
+        }
+        manager->shards[manager->shard_count++] = shard;
+        aws_atomic_fetch_add(&manager->live_shard_count, 1);
+    }
+
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_CONNECTION_MANAGER, "id=%p: Successfully created with %zu shards", (void *)manager, shard_count);
+
+    return manager;
+
+on_error:
+    /* Nobody has seen this manager, so it's destroyed quietly once any shards already created are done */
+    manager->shutdown_complete_callback = NULL;
+    shard_count = manager->shard_count;
+    if (shard_count == 0) {
+        s_sharded_connection_manager_destroy(manager);
+        return NULL;
+    }
+
+    struct aws_http_connection_manager **shards = manager->shards;
+    for (size_t i = 0; i < shard_count; ++i) {
+        aws_http_connection_manager_release(shards[i]);
+    }
+
+    return NULL;
+}
+
+/*
+ * Sharded mode: acquisitions go to the shard of the event loop they asked for, or else of the calling
+ * event loop thread, otherwise round-robin
+ */
+static struct aws_http_connection_manager *s_sharded_connection_manager_pick_shard(
+    struct aws_http_connection_manager *manager,
+    struct aws_event_loop *event_loop) {
+
+    for (size_t i = 0; i < manager->shard_count; ++i) {
+        if (event_loop ? manager->shards[i]->shard_event_loop == event_loop
+                       : aws_event_loop_thread_is_callers_thread(manager->shards[i]->shard_event_loop)) {
+            return manager->shards[i];
+        }
+    }
+
+    size_t next_shard = aws_atomic_fetch_add(&manager->next_shard, 1);
+    return manager->shards[next_shard % manager->shard_count];
+}
+
+/* Sharded mode: a connection belongs to the shard whose event loop it runs on */
+static struct aws_http_connection_manager *s_sharded_connection_manager_find_shard(
+    struct aws_http_connection_manager *manager,
+    struct aws_http_connection *connection) {
+
+    struct aws_event_loop *event_loop = s_connection_event_loop(manager, connection);
+    for (size_t i = 0; i < manager->shard_count; ++i) {
+        if (manager->shards[i]->shard_event_loop == event_loop) {
+            return manager->shards[i];
+        }
+    }
+    return NULL;
+}
+
+static void s_sharded_connection_manager_release(struct aws_http_connection_manager *manager) {
+    bool shutting_down = false;
+
+    aws_mutex_lock(&manager->lock);
+    if (manager->external_ref_count > 0) {
+        manager->external_ref_count -= 1;
+        if (manager->external_ref_count == 0) {
+            manager->state = AWS_HCMST_SHUTTING_DOWN;
+            shutting_down = true;
+        }
+    } else {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION_MANAGER,
+            "id=%p: Connection manager release called with a zero reference count",
+            (void *)manager);
+    }
+    aws_mutex_unlock(&manager->lock);
+
+    if (!shutting_down) {
+        return;
+    }
+
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_CONNECTION_MANAGER,
+        "id=%p: ref count now zero, shutting down %zu shards",
+        (void *)manager,
+        manager->shard_count);
+
+    /* The manager is destroyed with the last shard, so don't touch it after that one is released */
+    size_t shard_count = manager->shard_count;
+    struct aws_http_connection_manager **shards = manager->shards;
+    for (size_t i = 0; i < shard_count; ++i) {
+        aws_http_connection_manager_release(shards[i]);
+    }
+}
+
 void aws_http_connection_manager_acquire(struct aws_http_connection_manager *manager) {
     aws_mutex_lock(&manager->lock);
     AWS_FATAL_ASSERT(manager->external_ref_count > 0);
@@ -918,6 +1900,11 @@ void aws_http_connection_manager_acquire(struct aws_http_connection_manager *man
 }
 
 void aws_http_connection_manager_release(struct aws_http_connection_manager *manager) {
+    if (manager->shards) {
+        s_sharded_connection_manager_release(manager);
+        return;
+    }
+
     struct aws_connection_management_transaction work;
     s_aws_connection_management_transaction_init(&work, manager);
 
@@ -979,15 +1966,261 @@ static void s_aws_http_connection_manager_h2_on_initial_settings_completed(
     int error_code,
     void *user_data);
 
-static int s_aws_http_connection_manager_new_connection(struct aws_http_connection_manager *manager) {
+static void s_managed_connection_destroy(struct aws_managed_connection *managed_connection) {
+    aws_string_destroy(managed_connection->address);
+    aws_mem_release(managed_connection->allocator, managed_connection);
+}
+
+static const uint64_t s_address_min_backoff_ms = 100;
+static const uint64_t s_address_max_backoff_ms = 10000;
+/* The resolver caches, so this mostly picks up on what it already learned */
+static const uint64_t s_address_refresh_interval_ms = 10000;
+
+/* Only invoked with the lock held */
+static struct aws_managed_address *s_managed_address_find(
+    struct aws_http_connection_manager *manager,
+    const struct aws_string *address,
+    size_t *out_index) {
+
+    for (size_t i = 0; i < aws_array_list_length(&manager->managed_addresses); ++i) {
+        struct aws_managed_address *managed_address = NULL;
+        aws_array_list_get_at_ptr(&manager->managed_addresses, (void **)&managed_address, i);
+        if (aws_string_eq(managed_address->address, address)) {
+            if (out_index) {
+                *out_index = i;
+            }
+            return managed_address;
+        }
+    }
+
+    return NULL;
+}
+
+/* Only invoked with the lock held */
+static void s_managed_address_remove_if_unused(struct aws_http_connection_manager *manager, size_t index) {
+    struct aws_managed_address *managed_address = NULL;
+    aws_array_list_get_at_ptr(&manager->managed_addresses, (void **)&managed_address, index);
+    if (!managed_address->is_stale || managed_address->connection_count > 0) {
+        return;
+    }
+
+    aws_string_destroy(managed_address->address);
+    /* Order doesn't matter, so move the last one into its place */
+    size_t last_index = aws_array_list_length(&manager->managed_addresses) - 1;
+    if (index != last_index) {
+        aws_array_list_swap(&manager->managed_addresses, index, last_index);
+    }
+    aws_array_list_pop_back(&manager->managed_addresses);
+}
+
+static void s_on_host_addresses_resolved(
+    struct aws_host_resolver *resolver,
+    const struct aws_string *host_name,
+    int err_code,
+    const struct aws_array_list *host_addresses,
+    void *user_data) {
+    (void)resolver;
+    (void)host_name;
+
+    struct aws_http_connection_manager *manager = user_data;
+
+    aws_mutex_lock(&manager->lock);
+    manager->is_resolving_addresses = false;
+    if (err_code) {
+        AWS_LOGF_WARN(
+            AWS_LS_HTTP_CONNECTION_MANAGER,
+            "id=%p: Failed to resolve host addresses, error %d(%s)",
+            (void *)manager,
+            err_code,
+            aws_error_str(err_code));
+    } else {
+        for (size_t i = 0; i < aws_array_list_length(&manager->managed_addresses); ++i) {
+            struct aws_managed_address *managed_address = NULL;
+            aws_array_list_get_at_ptr(&manager->managed_addresses, (void **)&managed_address, i);
+            managed_address->is_stale = true;
+        }
+
+        for (size_t i = 0; i < aws_array_list_length(host_addresses); ++i) {
+            struct aws_host_address *host_address = NULL;
+            aws_array_list_get_at_ptr(host_addresses, (void **)&host_address, i);
+            struct aws_managed_address *managed_address =
+                s_managed_address_find(manager, host_address->address, NULL);
+            if (managed_address) {
+                managed_address->is_stale = false;
+                continue;
+            }
+
+            struct aws_managed_address new_address;
+            AWS_ZERO_STRUCT(new_address);
+            new_address.address = aws_string_new_from_string(manager->allocator, host_address->address);
+            if (new_address.address == NULL ||
+                aws_array_list_push_back(&manager->managed_addresses, &new_address)) {
+                aws_string_destroy(new_address.address);
+                break;
+            }
+        }
+
+        /* Walk backwards, removal moves the last one into the removed one's place */
+        for (size_t i = aws_array_list_length(&manager->managed_addresses); i > 0; --i) {
+            s_managed_address_remove_if_unused(manager, i - 1);
+        }
+
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_CONNECTION_MANAGER,
+            "id=%p: Host resolved to %zu addresses",
+            (void *)manager,
+            aws_array_list_length(host_addresses));
+    }
+    aws_mutex_unlock(&manager->lock);
+
+    aws_ref_count_release(&manager->internal_ref_count);
+}
+
+/*
+ * Multi-address mode: picks the address for a new connection, and counts the connection against it.
+ * Returns NULL to leave it to the resolver, if there's no address to pick yet.
+ */
+static struct aws_string *s_managed_address_pick(struct aws_http_connection_manager *manager, uint64_t now) {
+    if (!manager->enable_multi_address || manager->system_vtable->aws_host_resolver_resolve_host == NULL) {
+        return NULL;
+    }
+
+    aws_mutex_lock(&manager->lock);
+    bool should_resolve = !manager->is_resolving_addresses && now >= manager->address_refresh_timestamp;
+    if (should_resolve) {
+        manager->is_resolving_addresses = true;
+        manager->address_refresh_timestamp =
+            now + aws_timestamp_convert(s_address_refresh_interval_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    }
+    aws_mutex_unlock(&manager->lock);
+
+    if (should_resolve) {
+        /* The resolver may call back before returning, so this can't be done with the lock held */
+        aws_ref_count_acquire(&manager->internal_ref_count);
+        if (manager->system_vtable->aws_host_resolver_resolve_host(
+                manager->bootstrap->host_resolver,
+                manager->host,
+                s_on_host_addresses_resolved,
+                &manager->bootstrap->host_resolver_config,
+                manager)) {
+            AWS_LOGF_WARN(
+                AWS_LS_HTTP_CONNECTION_MANAGER,
+                "id=%p: Failed to start resolving host addresses, error %d(%s)",
+                (void *)manager,
+                aws_last_error(),
+                aws_error_str(aws_last_error()));
+            aws_mutex_lock(&manager->lock);
+            manager->is_resolving_addresses = false;
+            aws_mutex_unlock(&manager->lock);
+            aws_ref_count_release(&manager->internal_ref_count);
+        }
+    }
+
+    /*
+     * The fewest connections wins, among addresses that aren't backed off.  If they all are, the one
+     * that comes off backoff first.
+     */
+    struct aws_string *address = NULL;
+    aws_mutex_lock(&manager->lock);
+    struct aws_managed_address *best = NULL;
+    for (size_t i = 0; i < aws_array_list_length(&manager->managed_addresses); ++i) {
+        struct aws_managed_address *managed_address = NULL;
+        aws_array_list_get_at_ptr(&manager->managed_addresses, (void **)&managed_address, i);
+        if (managed_address->is_stale) {
+            continue;
+        }
+        if (best == NULL) {
+            best = managed_address;
+            continue;
+        }
+
+        bool is_ready = managed_address->retry_timestamp <= now;
+        bool best_is_ready = best->retry_timestamp <= now;
+        if (is_ready != best_is_ready) {
+            if (is_ready) {
+                best = managed_address;
+            }
+        } else if (is_ready ? managed_address->connection_count < best->connection_count
+                            : managed_address->retry_timestamp < best->retry_timestamp) {
+            best = managed_address;
+        }
+    }
+    if (best) {
+        address = aws_string_new_from_string(manager->allocator, best->address);
+        if (address) {
+            ++best->connection_count;
+        }
+    }
+    aws_mutex_unlock(&manager->lock);
+
+    return address;
+}
+
+/*
+ * Multi-address mode: a connection attempt to an address finished.  On failure, the connection no longer counts
+ * against the address, and the address backs off.  Only invoked with the lock held.
+ */
+static void s_managed_address_on_connection_done(
+    struct aws_http_connection_manager *manager,
+    const struct aws_string *address,
+    int error_code,
+    uint64_t now) {
+
+    size_t index = 0;
+    struct aws_managed_address *managed_address =
+        address ? s_managed_address_find(manager, address, &index) : NULL;
+    if (managed_address == NULL) {
+        return;
+    }
+
+    if (!error_code) {
+        managed_address->backoff_ms = 0;
+        managed_address->retry_timestamp = 0;
+        return;
+    }
+
+    AWS_FATAL_ASSERT(managed_address->connection_count > 0);
+    --managed_address->connection_count;
+    managed_address->backoff_ms = managed_address->backoff_ms == 0
+                                      ? s_address_min_backoff_ms
+                                      : aws_min_u64(managed_address->backoff_ms * 2, s_address_max_backoff_ms);
+    managed_address->retry_timestamp =
+        now + aws_timestamp_convert(managed_address->backoff_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_CONNECTION_MANAGER,
+        "id=%p: Backing off address %s for %" PRIu64 "ms",
+        (void *)manager,
+        aws_string_c_str(managed_address->address),
+        managed_address->backoff_ms);
+    s_managed_address_remove_if_unused(manager, index);
+}
+
+/* Multi-address mode: a connection to an address shut down.  Only invoked with the lock held */
+static void s_managed_address_on_connection_shutdown(
+    struct aws_http_connection_manager *manager,
+    const struct aws_string *address) {
+
+    size_t index = 0;
+    struct aws_managed_address *managed_address =
+        address ? s_managed_address_find(manager, address, &index) : NULL;
+    if (managed_address == NULL) {
+        return;
+    }
+
+    AWS_FATAL_ASSERT(managed_address->connection_count > 0);
+    --managed_address->connection_count;
+    s_managed_address_remove_if_unused(manager, index);
+}
+
+static int s_aws_http_connection_manager_new_connection(
+    struct aws_http_connection_manager *manager,
+    struct aws_event_loop *event_loop) {
     struct aws_http_client_connection_options options;
     AWS_ZERO_STRUCT(options);
     options.self_size = sizeof(struct aws_http_client_connection_options);
     options.bootstrap = manager->bootstrap;
     options.tls_options = manager->tls_connection_options;
     options.allocator = manager->allocator;
-    options.user_data = manager;
-    options.host_name = aws_byte_cursor_from_string(manager->host);
     options.port = manager->port;
     options.initial_window_size = manager->initial_window_size;
     options.socket_options = &manager->socket_options;
@@ -996,6 +2229,8 @@ static int s_aws_http_connection_manager_new_connection(struct aws_http_connecti
     options.manual_window_management = manager->enable_read_back_pressure;
     options.proxy_ev_settings = &manager->proxy_ev_settings;
     options.prior_knowledge_http2 = manager->http2_prior_knowledge;
+    /* NULL unless an acquisition asked for it, or this is a shard */
+    options.requested_event_loop = event_loop ? event_loop : manager->shard_event_loop;
 
     struct aws_http2_connection_options h2_options;
     AWS_ZERO_STRUCT(h2_options);
@@ -1012,6 +2247,11 @@ static int s_aws_http_connection_manager_new_connection(struct aws_http_connecti
 
     options.http2_options = &h2_options;
 
+    struct aws_http1_connection_options h1_options;
+    AWS_ZERO_STRUCT(h1_options);
+    h1_options.memory_budget = manager->memory_budget;
+    options.http1_options = &h1_options;
+
     if (aws_http_connection_monitoring_options_is_valid(&manager->monitoring_options)) {
         options.monitoring_options = &manager->monitoring_options;
     }
@@ -1024,6 +2264,19 @@ static int s_aws_http_connection_manager_new_connection(struct aws_http_connecti
         options.proxy_options = &proxy_options;
     }
 
+    struct aws_managed_connection *managed_connection =
+        aws_mem_calloc(manager->allocator, 1, sizeof(struct aws_managed_connection));
+    managed_connection->allocator = manager->allocator;
+    managed_connection->manager = manager;
+    managed_connection->connect_timestamp = s_manager_now(manager);
+    managed_connection->address = s_managed_address_pick(manager, managed_connection->connect_timestamp);
+    options.host_name = aws_byte_cursor_from_string(
+        managed_connection->address ? managed_connection->address : manager->host);
+    if (managed_connection->address == NULL) {
+        options.connection_attempt_delay_ms = manager->connection_attempt_delay_ms;
+    }
+    options.user_data = managed_connection;
+
     if (manager->system_vtable->aws_http_client_connect(&options)) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_CONNECTION_MANAGER,
@@ -1031,12 +2284,168 @@ static int s_aws_http_connection_manager_new_connection(struct aws_http_connecti
             (void *)manager,
             aws_last_error(),
             aws_error_str(aws_last_error()));
+        int error_code = aws_last_error();
+        aws_mutex_lock(&manager->lock);
+        s_managed_address_on_connection_done(
+            manager, managed_connection->address, error_code, managed_connection->connect_timestamp);
+        aws_mutex_unlock(&manager->lock);
+        s_managed_connection_destroy(managed_connection);
+        aws_raise_error(error_code);
         return AWS_OP_ERR;
     }
 
     return AWS_OP_SUCCESS;
 }
 
+static int s_idle_connection(struct aws_http_connection_manager *manager, struct aws_http_connection *connection);
+
+/*
+ * Sharded mode: take an idle connection from another shard.  The connection stays owned by that shard,
+ * which is where the user releases it back to.
+ */
+static struct aws_http_connection *s_shard_vend_idle_connection(struct aws_http_connection_manager *peer) {
+    struct aws_http_connection *connection = NULL;
+
+    aws_mutex_lock(&peer->lock);
+    if (peer->state == AWS_HCMST_READY && !aws_linked_list_empty(&peer->idle_connections)) {
+        /* pop_back for the same reason as in build_transaction, the newest idle connection */
+        struct aws_linked_list_node *node = aws_linked_list_pop_back(&peer->idle_connections);
+        struct aws_idle_connection *idle_connection = AWS_CONTAINER_OF(node, struct aws_idle_connection, node);
+        connection = idle_connection->connection;
+        --peer->idle_connection_count;
+        s_connection_manager_internal_ref_increase(peer, AWS_HCMCT_VENDED_CONNECTION, 1);
+        aws_mem_release(idle_connection->allocator, idle_connection);
+        s_shard_update_hints(peer);
+    }
+    aws_mutex_unlock(&peer->lock);
+
+    return connection;
+}
+
+/* Sharded mode: hand a connection taken by s_shard_vend_idle_connection() back without kicking anyone */
+static void s_shard_return_idle_connection(
+    struct aws_http_connection_manager *peer,
+    struct aws_http_connection *connection) {
+
+    struct aws_connection_management_transaction work;
+    s_aws_connection_management_transaction_init(&work, peer);
+    work.is_shard_kick = true;
+
+    aws_mutex_lock(&peer->lock);
+    s_connection_manager_internal_ref_decrease(peer, AWS_HCMCT_VENDED_CONNECTION, 1);
+    if (!peer->system_vtable->aws_http_connection_new_requests_allowed(connection) ||
+        s_idle_connection(peer, connection)) {
+        work.connection_to_release = connection;
+    }
+    s_aws_http_connection_manager_build_transaction(&work);
+    aws_mutex_unlock(&peer->lock);
+
+    s_aws_http_connection_manager_execute_transaction(&work);
+}
+
+/* Only invoked with the lock held */
+static bool s_front_acquisition_requires_event_loop(struct aws_http_connection_manager *manager) {
+    struct aws_http_connection_acquisition *acquisition = AWS_CONTAINER_OF(
+        aws_linked_list_front(&manager->pending_acquisitions), struct aws_http_connection_acquisition, node);
+    return acquisition->event_loop_required;
+}
+
+/* Sharded mode: serve a starved shard's acquisitions with idle connections from the other shards */
+static void s_shard_serve_from_peers(struct aws_http_connection_manager *manager) {
+    struct aws_http_connection_manager *parent = manager->parent;
+
+    for (size_t i = 1; i < parent->shard_count && aws_atomic_load_int(&manager->is_starved); ++i) {
+        struct aws_http_connection_manager *peer = parent->shards[(manager->shard_index + i) % parent->shard_count];
+
+        while (aws_atomic_load_int(&peer->idle_connection_hint) > 0) {
+            /* Never hold two shard locks at once: take from the peer first, then hand to this shard */
+            struct aws_http_connection *connection = s_shard_vend_idle_connection(peer);
+            if (connection == NULL) {
+                break;
+            }
+
+            struct aws_linked_list completions;
+            aws_linked_list_init(&completions);
+            bool still_starved = false;
+
+            aws_mutex_lock(&manager->lock);
+            /* A connection from another shard is on another event loop, which won't do for some acquisitions */
+            if (s_shard_should_be_starved(manager) && !s_front_acquisition_requires_event_loop(manager)) {
+                still_starved = true;
+                AWS_LOGF_DEBUG(
+                    AWS_LS_HTTP_CONNECTION_MANAGER,
+                    "id=%p: Grabbing pooled connection (%p) from shard id=%p",
+                    (void *)manager,
+                    (void *)connection,
+                    (void *)peer);
+                s_aws_http_connection_manager_move_front_acquisition(
+                    manager, connection, AWS_ERROR_SUCCESS, &completions);
+                s_shard_update_hints(manager);
+            }
+            aws_mutex_unlock(&manager->lock);
+
+            if (!still_starved) {
+                s_shard_return_idle_connection(peer, connection);
+                return;
+            }
+
+            s_aws_http_connection_manager_complete_acquisitions(&completions, manager->allocator);
+        }
+    }
+}
+
+/* Sharded mode: let a starved shard retry now that it may find budget or idle connections */
+static void s_shard_kick(struct aws_http_connection_manager *manager) {
+    struct aws_connection_management_transaction work;
+    bool kicked = false;
+
+    aws_mutex_lock(&manager->lock);
+    if (s_shard_should_be_starved(manager)) {
+        kicked = true;
+        s_aws_connection_management_transaction_init(&work, manager);
+        work.is_shard_kick = true;
+        s_aws_http_connection_manager_build_transaction(&work);
+    }
+    aws_mutex_unlock(&manager->lock);
+
+    if (kicked) {
+        s_aws_http_connection_manager_execute_transaction(&work);
+    }
+}
+
+/*
+ * Sharded mode: a starved shard looks to its peers.  A shard with something to spare (an idle connection,
+ * or budget it freed up) kicks the starved ones.
+ */
+static void s_shard_rebalance(struct aws_connection_management_transaction *work) {
+    struct aws_http_connection_manager *manager = work->manager;
+    struct aws_http_connection_manager *parent = manager->parent;
+    if (parent == NULL) {
+        return;
+    }
+
+    if (work->shard_starved) {
+        s_shard_serve_from_peers(manager);
+        return;
+    }
+
+    if (work->is_shard_kick || aws_atomic_load_int(&parent->starved_shard_count) == 0) {
+        return;
+    }
+
+    if (work->snapshot.idle_connection_count == 0 &&
+        aws_atomic_load_int(&parent->shared_connection_count) >= manager->max_connections) {
+        return;
+    }
+
+    for (size_t i = 1; i < parent->shard_count; ++i) {
+        struct aws_http_connection_manager *peer = parent->shards[(manager->shard_index + i) % parent->shard_count];
+        if (aws_atomic_load_int(&peer->is_starved)) {
+            s_shard_kick(peer);
+        }
+    }
+}
+
 static void s_aws_http_connection_manager_execute_transaction(struct aws_connection_management_transaction *work) {
 
     struct aws_http_connection_manager *manager = work->manager;
@@ -1093,7 +2502,11 @@ static void s_aws_http_connection_manager_execute_transaction(struct aws_connect
     }
 
     for (size_t i = 0; i < work->new_connections; ++i) {
-        if (s_aws_http_connection_manager_new_connection(manager)) {
+        struct aws_event_loop *event_loop = NULL;
+        if (i < aws_array_list_length(&work->new_connection_event_loops)) {
+            aws_array_list_get_at(&work->new_connection_event_loops, &event_loop, i);
+        }
+        if (s_aws_http_connection_manager_new_connection(manager, event_loop)) {
             ++new_connection_failures;
             representative_error = aws_last_error();
             if (push_errors) {
@@ -1110,7 +2523,17 @@ static void s_aws_http_connection_manager_execute_transaction(struct aws_connect
         aws_mutex_lock(&manager->lock);
 
         AWS_FATAL_ASSERT(manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS] >= new_connection_failures);
+        uint64_t now = s_manager_now(manager);
+        s_warming_on_connection_done(manager, representative_error, now, now);
+        for (size_t i = 0; i < new_connection_failures; ++i) {
+            int error = representative_error;
+            if (i < aws_array_list_length(&errors)) {
+                aws_array_list_get_at(&errors, &error, i);
+            }
+            s_metrics_record_connect_failure(manager, error);
+        }
         s_connection_manager_internal_ref_decrease(manager, AWS_HCMCT_PENDING_CONNECTIONS, new_connection_failures);
+        s_shard_release_connections(manager, new_connection_failures);
 
         /*
          * Rather than failing one acquisition for each connection failure, if there's at least one
@@ -1135,6 +2558,7 @@ static void s_aws_http_connection_manager_execute_transaction(struct aws_connect
             s_aws_http_connection_manager_move_front_acquisition(manager, NULL, error, &work->completions);
             ++i;
         }
+        s_shard_update_hints(manager);
 
         aws_mutex_unlock(&manager->lock);
     }
@@ -1147,7 +2571,12 @@ static void s_aws_http_connection_manager_execute_transaction(struct aws_connect
     aws_array_list_clean_up(&errors);
 
     /*
-     * Step 5 - Clean up work.  Do this here rather than at the end of every caller. Destroy the manager if necessary
+     * Step 5 - Sharded mode only, move idle connections between shards
+     */
+    s_shard_rebalance(work);
+
+    /*
+     * Step 6 - Clean up work.  Do this here rather than at the end of every caller. Destroy the manager if necessary
      */
     s_aws_connection_management_transaction_clean_up(work);
 }
@@ -1157,15 +2586,130 @@ void aws_http_connection_manager_acquire_connection(
     aws_http_connection_manager_on_connection_setup_fn *callback,
     void *user_data) {
 
+    struct aws_http_connection_manager_acquire_options options = {
+        .callback = callback,
+        .user_data = user_data,
+    };
+    aws_http_connection_manager_acquire_connection_with_options(manager, &options);
+}
+
+/* The bootstrap's event loop whose thread is calling, or NULL */
+static struct aws_event_loop *s_find_callers_event_loop(struct aws_http_connection_manager *manager) {
+    struct aws_event_loop_group *event_loop_group = manager->bootstrap->event_loop_group;
+    size_t event_loop_count = aws_event_loop_group_get_loop_count(event_loop_group);
+    for (size_t i = 0; i < event_loop_count; ++i) {
+        struct aws_event_loop *event_loop = aws_event_loop_group_get_loop_at(event_loop_group, i);
+        if (aws_event_loop_thread_is_callers_thread(event_loop)) {
+            return event_loop;
+        }
+    }
+    return NULL;
+}
+
+/* How late may a timed out acquisition be failed, at most */
+static const uint64_t s_acquisition_timeout_check_interval_ms = 100;
+
+static void s_schedule_acquisition_timeout_task(struct aws_http_connection_manager *manager) {
+    /*
+     * Runs at the earliest deadline, but no later than the check interval from now, since an acquisition with
+     * an earlier deadline may come along in the meantime.
+     */
+    uint64_t now = s_manager_now(manager);
+    uint64_t run_time =
+        now + aws_timestamp_convert(
+                  s_acquisition_timeout_check_interval_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+
+    aws_mutex_lock(&manager->lock);
+    struct aws_event_loop *event_loop = manager->cull_event_loop;
+    const struct aws_linked_list_node *end = aws_linked_list_end(&manager->pending_acquisitions);
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&manager->pending_acquisitions); node != end;
+         node = aws_linked_list_next(node)) {
+        struct aws_http_connection_acquisition *acquisition =
+            AWS_CONTAINER_OF(node, struct aws_http_connection_acquisition, node);
+        if (acquisition->deadline_timestamp) {
+            run_time = aws_min_u64(run_time, acquisition->deadline_timestamp);
+        }
+    }
+    aws_mutex_unlock(&manager->lock);
+
+    aws_ref_count_acquire(&manager->internal_ref_count);
+    aws_event_loop_schedule_task_future(event_loop, &manager->acquisition_timeout_task, run_time);
+}
+
+static void s_acquisition_timeout_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_http_connection_manager *manager = arg;
+
+    bool reschedule = false;
+    if (status == AWS_TASK_STATUS_RUN_READY) {
+        struct aws_connection_management_transaction work;
+        s_aws_connection_management_transaction_init(&work, manager);
+
+        aws_mutex_lock(&manager->lock);
+        if (manager->state == AWS_HCMST_READY) {
+            s_aws_http_connection_manager_build_transaction(&work);
+        } else {
+            s_aws_http_connection_manager_get_snapshot(manager, &work.snapshot);
+        }
+        reschedule = manager->state == AWS_HCMST_READY && manager->deadline_acquisition_count > 0;
+        manager->is_acquisition_timeout_task_scheduled = reschedule;
+        aws_mutex_unlock(&manager->lock);
+
+        s_aws_http_connection_manager_execute_transaction(&work);
+    } else {
+        aws_mutex_lock(&manager->lock);
+        manager->is_acquisition_timeout_task_scheduled = false;
+        aws_mutex_unlock(&manager->lock);
+    }
+
+    if (reschedule) {
+        s_schedule_acquisition_timeout_task(manager);
+    }
+
+    /* The ref held while it was scheduled */
+    aws_ref_count_release(&manager->internal_ref_count);
+}
+
+void aws_http_connection_manager_acquire_connection_with_options(
+    struct aws_http_connection_manager *manager,
+    const struct aws_http_connection_manager_acquire_options *options) {
+
+    AWS_PRECONDITION(options->callback);
+
+    if (manager->shards) {
+        aws_http_connection_manager_acquire_connection_with_options(
+            s_sharded_connection_manager_pick_shard(manager, options->event_loop), options);
+        return;
+    }
+
     AWS_LOGF_DEBUG(AWS_LS_HTTP_CONNECTION_MANAGER, "id=%p: Acquire connection", (void *)manager);
 
     struct aws_http_connection_acquisition *request =
         aws_mem_calloc(manager->allocator, 1, sizeof(struct aws_http_connection_acquisition));
 
     request->allocator = manager->allocator;
-    request->callback = callback;
-    request->user_data = user_data;
+    request->callback = options->callback;
+    request->user_data = options->user_data;
     request->manager = manager;
+    request->acquire_timestamp = s_manager_now(manager);
+    request->priority = options->priority;
+    if (options->acquisition_timeout_ms > 0) {
+        request->deadline_timestamp =
+            request->acquire_timestamp +
+            aws_timestamp_convert(options->acquisition_timeout_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    }
+
+    if (options->event_loop_affinity != AWS_HTTP_CONNECTION_MANAGER_AFFINITY_NONE) {
+        request->event_loop = options->event_loop ? options->event_loop : s_find_callers_event_loop(manager);
+        request->event_loop_required =
+            request->event_loop && options->event_loop_affinity == AWS_HTTP_CONNECTION_MANAGER_AFFINITY_REQUIRE;
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_CONNECTION_MANAGER,
+            "id=%p: Acquisition %s event loop %p",
+            (void *)manager,
+            request->event_loop_required ? "requires" : "prefers",
+            (void *)request->event_loop);
+    }
 
     struct aws_connection_management_transaction work;
     s_aws_connection_management_transaction_init(&work, manager);
@@ -1175,13 +2719,35 @@ void aws_http_connection_manager_acquire_connection(
     /* It's a use after free crime, we don't want to handle */
     AWS_FATAL_ASSERT(manager->state == AWS_HCMST_READY);
 
-    aws_linked_list_push_back(&manager->pending_acquisitions, &request->node);
+    s_aws_http_connection_manager_insert_acquisition(manager, request);
     ++manager->pending_acquisition_count;
+    if (request->event_loop) {
+        ++manager->affine_acquisition_count;
+    }
+    if (request->deadline_timestamp) {
+        ++manager->deadline_acquisition_count;
+    }
+    s_warming_on_acquisition(manager);
 
     s_aws_http_connection_manager_build_transaction(&work);
 
+    bool schedule_timeout_task = false;
+    if (manager->deadline_acquisition_count > 0 && !manager->is_acquisition_timeout_task_scheduled) {
+        manager->is_acquisition_timeout_task_scheduled = true;
+        schedule_timeout_task = true;
+        if (manager->cull_event_loop == NULL) {
+            manager->cull_event_loop = manager->shard_event_loop
+                                           ? manager->shard_event_loop
+                                           : aws_event_loop_group_get_next_loop(manager->bootstrap->event_loop_group);
+        }
+    }
+
     aws_mutex_unlock(&manager->lock);
 
+    if (schedule_timeout_task) {
+        s_schedule_acquisition_timeout_task(manager);
+    }
+
     s_aws_http_connection_manager_execute_transaction(&work);
 }
 
@@ -1198,6 +2764,7 @@ static int s_idle_connection(struct aws_http_connection_manager *manager, struct
         goto on_error;
     }
 
+    idle_connection->idle_start_timestamp = idle_start_timestamp;
     idle_connection->cull_timestamp =
         idle_start_timestamp +
         aws_timestamp_convert(
@@ -1219,6 +2786,21 @@ int aws_http_connection_manager_release_connection(
     struct aws_http_connection_manager *manager,
     struct aws_http_connection *connection) {
 
+    if (manager->shards) {
+        struct aws_http_connection_manager *shard = s_sharded_connection_manager_find_shard(manager, connection);
+        if (shard == NULL) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_CONNECTION_MANAGER,
+                "id=%p: Released connection (id=%p) does not belong to any shard",
+                (void *)manager,
+                (void *)connection);
+            return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        }
+        return aws_http_connection_manager_release_connection(shard, connection);
+    }
+
+    AWS_HTTP_PROBE2(connection__manager__release, manager, connection);
+
     struct aws_connection_management_transaction work;
     s_aws_connection_management_transaction_init(&work, manager);
 
@@ -1247,6 +2829,23 @@ int aws_http_connection_manager_release_connection(
 
     s_connection_manager_internal_ref_decrease(manager, AWS_HCMCT_VENDED_CONNECTION, 1);
 
+    if (!should_release_connection && s_connection_is_degraded(manager, connection)) {
+        uint64_t now = 0;
+        manager->system_vtable->aws_high_res_clock_get_ticks(&now);
+        uint64_t recycle_interval_ns = aws_timestamp_convert(
+            DEGRADED_CONNECTION_RECYCLE_INTERVAL_MS, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+        if (manager->degraded_recycle_timestamp == 0 ||
+            now - manager->degraded_recycle_timestamp >= recycle_interval_ns) {
+            AWS_LOGF_INFO(
+                AWS_LS_HTTP_CONNECTION_MANAGER,
+                "id=%p: Recycling degraded connection (id=%p) instead of reusing it",
+                (void *)manager,
+                (void *)connection);
+            manager->degraded_recycle_timestamp = now;
+            should_release_connection = true;
+        }
+    }
+
     if (!should_release_connection) {
         if (s_idle_connection(manager, connection)) {
             should_release_connection = true;
@@ -1273,7 +2872,8 @@ static void s_aws_http_connection_manager_h2_on_goaway_received(
     uint32_t http2_error_code,
     struct aws_byte_cursor debug_data,
     void *user_data) {
-    struct aws_http_connection_manager *manager = user_data;
+    struct aws_managed_connection *managed_connection = user_data;
+    struct aws_http_connection_manager *manager = managed_connection->manager;
     /* We don't offer user the details, but we can still log it out for debugging */
     AWS_LOGF_DEBUG(
         AWS_LS_HTTP_CONNECTION_MANAGER,
@@ -1354,7 +2954,8 @@ static void s_aws_http_connection_manager_h2_on_initial_settings_completed(
     struct aws_http_connection *http2_connection,
     int error_code,
     void *user_data) {
-    struct aws_http_connection_manager *manager = user_data;
+    struct aws_managed_connection *managed_connection = user_data;
+    struct aws_http_connection_manager *manager = managed_connection->manager;
     /* The other side acknowledge about the settings which also means we received the settings from other side at this
      * point, because the settings should be the fist frame to be sent */
 
@@ -1384,7 +2985,8 @@ static void s_aws_http_connection_manager_on_connection_setup(
     struct aws_http_connection *connection,
     int error_code,
     void *user_data) {
-    struct aws_http_connection_manager *manager = user_data;
+    struct aws_managed_connection *managed_connection = user_data;
+    struct aws_http_connection_manager *manager = managed_connection->manager;
 
     struct aws_connection_management_transaction work;
     s_aws_connection_management_transaction_init(&work, manager);
@@ -1407,10 +3009,19 @@ static void s_aws_http_connection_manager_on_connection_setup(
     aws_mutex_lock(&manager->lock);
 
     AWS_FATAL_ASSERT(manager->internal_ref[AWS_HCMCT_PENDING_CONNECTIONS] > 0);
+    uint64_t now = s_manager_now(manager);
+    s_warming_on_connection_done(manager, error_code, managed_connection->connect_timestamp, now);
+    s_managed_address_on_connection_done(manager, managed_connection->address, error_code, now);
     s_connection_manager_internal_ref_decrease(manager, AWS_HCMCT_PENDING_CONNECTIONS, 1);
     if (!error_code) {
         /* Shutdown will not be invoked if setup completed with error */
         s_connection_manager_internal_ref_increase(manager, AWS_HCMCT_OPEN_CONNECTION, 1);
+        s_metrics_record_duration(&manager->metrics.connection_setup, managed_connection->connect_timestamp, now);
+        managed_connection->setup_timestamp = now;
+    } else {
+        s_shard_release_connections(manager, 1);
+        s_metrics_record_connect_failure(manager, error_code);
+        s_managed_connection_destroy(managed_connection);
     }
 
     if (connection != NULL &&
@@ -1446,7 +3057,8 @@ static void s_aws_http_connection_manager_on_connection_shutdown(
     void *user_data) {
     (void)error_code;
 
-    struct aws_http_connection_manager *manager = user_data;
+    struct aws_managed_connection *managed_connection = user_data;
+    struct aws_http_connection_manager *manager = managed_connection->manager;
 
     AWS_LOGF_DEBUG(
         AWS_LS_HTTP_CONNECTION_MANAGER,
@@ -1461,6 +3073,11 @@ static void s_aws_http_connection_manager_on_connection_shutdown(
 
     AWS_FATAL_ASSERT(manager->internal_ref[AWS_HCMCT_OPEN_CONNECTION] > 0);
     s_connection_manager_internal_ref_decrease(manager, AWS_HCMCT_OPEN_CONNECTION, 1);
+    s_shard_release_connections(manager, 1);
+    s_metrics_record_duration(
+        &manager->metrics.connection_lifetime, managed_connection->setup_timestamp, s_manager_now(manager));
+    s_managed_address_on_connection_shutdown(manager, managed_connection->address);
+    s_managed_connection_destroy(managed_connection);
 
     /*
      * Find and, if found, remove it from idle connections
@@ -1488,7 +3105,7 @@ static void s_aws_http_connection_manager_on_connection_shutdown(
 static void s_cull_idle_connections(struct aws_http_connection_manager *manager) {
     AWS_LOGF_INFO(AWS_LS_HTTP_CONNECTION_MANAGER, "id=%p: culling idle connections", (void *)manager);
 
-    if (manager == NULL || manager->max_connection_idle_in_milliseconds == 0) {
+    if (manager == NULL || !s_culling_enabled(manager)) {
         return;
     }
 
@@ -1503,21 +3120,46 @@ static void s_cull_idle_connections(struct aws_http_connection_manager *manager)
     aws_mutex_lock(&manager->lock);
 
     /* Only if we're not shutting down */
-    if (manager->state == AWS_HCMST_READY) {
+    if (manager->state == AWS_HCMST_READY &&
+        (manager->max_connection_idle_in_milliseconds > 0 || manager->adaptive_culling_window_ms > 0)) {
+        /* Idle connections beyond the recent peak concurrency go after the shorter surplus timeout */
+        size_t keep_count = s_adaptive_culling_keep_count(manager, now);
+        uint64_t surplus_idle_ns =
+            aws_timestamp_convert(manager->surplus_connection_idle_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+
         const struct aws_linked_list_node *end = aws_linked_list_end(&manager->idle_connections);
         struct aws_linked_list_node *current_node = aws_linked_list_begin(&manager->idle_connections);
         while (current_node != end) {
             struct aws_linked_list_node *node = current_node;
             struct aws_idle_connection *current_idle_connection =
                 AWS_CONTAINER_OF(node, struct aws_idle_connection, node);
-            if (current_idle_connection->cull_timestamp > now) {
+            bool is_timed_out =
+                manager->max_connection_idle_in_milliseconds > 0 && current_idle_connection->cull_timestamp <= now;
+            bool is_surplus = manager->idle_connection_count > keep_count &&
+                              current_idle_connection->idle_start_timestamp + surplus_idle_ns <= now;
+            if (!is_timed_out && !is_surplus) {
                 break;
             }
 
             current_node = aws_linked_list_next(current_node);
             aws_linked_list_remove(node);
+
+            if (!is_surplus && manager->idle_connection_count <= manager->min_idle_connections) {
+                /* Keep it, as the newest idle connection, so the list stays sorted by cull time */
+                current_idle_connection->cull_timestamp =
+                    now + aws_timestamp_convert(
+                              manager->max_connection_idle_in_milliseconds,
+                              AWS_TIMESTAMP_MILLIS,
+                              AWS_TIMESTAMP_NANOS,
+                              NULL);
+                aws_linked_list_push_back(&manager->idle_connections, node);
+                continue;
+            }
+
             aws_linked_list_push_back(&work.connections_to_release, node);
             --manager->idle_connection_count;
+            s_metrics_record_duration(
+                &manager->metrics.idle_before_cull, current_idle_connection->idle_start_timestamp, now);
 
             AWS_LOGF_DEBUG(
                 AWS_LS_HTTP_CONNECTION_MANAGER,
@@ -1527,7 +3169,13 @@ static void s_cull_idle_connections(struct aws_http_connection_manager *manager)
         }
     }
 
-    s_aws_http_connection_manager_get_snapshot(manager, &work.snapshot);
+    if (manager->state == AWS_HCMST_READY) {
+        /* Also brings the pool back up to its warming target */
+        s_aws_http_connection_manager_build_transaction(&work);
+    } else {
+        s_shard_update_hints(manager);
+        s_aws_http_connection_manager_get_snapshot(manager, &work.snapshot);
+    }
 
     aws_mutex_unlock(&manager->lock);
 
@@ -1547,13 +3195,47 @@ static void s_cull_task(struct aws_task *task, void *arg, enum aws_task_status s
     s_schedule_connection_culling(manager);
 }
 
+/* Adds the histograms and failure counts of one set of metrics into another */
+static void s_metrics_merge(struct aws_http_manager_metrics *metrics, const struct aws_http_manager_metrics *other) {
+    aws_http_latency_histogram_merge(&metrics->acquire_wait, &other->acquire_wait);
+    aws_http_latency_histogram_merge(&metrics->connection_setup, &other->connection_setup);
+    aws_http_latency_histogram_merge(&metrics->connection_lifetime, &other->connection_lifetime);
+    aws_http_latency_histogram_merge(&metrics->idle_before_cull, &other->idle_before_cull);
+
+    metrics->connect_failure_count += other->connect_failure_count;
+    for (size_t i = 0; i < AWS_HTTP_MANAGER_METRICS_ERROR_CODE_SLOTS && other->connect_failures[i].count; ++i) {
+        for (size_t j = 0; j < AWS_HTTP_MANAGER_METRICS_ERROR_CODE_SLOTS; ++j) {
+            struct aws_http_manager_error_count *slot = &metrics->connect_failures[j];
+            if (slot->count == 0 || slot->error_code == other->connect_failures[i].error_code) {
+                slot->error_code = other->connect_failures[i].error_code;
+                slot->count += other->connect_failures[i].count;
+                break;
+            }
+        }
+    }
+}
+
 void aws_http_connection_manager_fetch_metrics(
     const struct aws_http_connection_manager *manager,
     struct aws_http_manager_metrics *out_metrics) {
     AWS_PRECONDITION(manager);
     AWS_PRECONDITION(out_metrics);
 
+    if (manager->shards) {
+        AWS_ZERO_STRUCT(*out_metrics);
+        for (size_t i = 0; i < manager->shard_count; ++i) {
+            struct aws_http_manager_metrics shard_metrics;
+            aws_http_connection_manager_fetch_metrics(manager->shards[i], &shard_metrics);
+            out_metrics->available_concurrency += shard_metrics.available_concurrency;
+            out_metrics->pending_concurrency_acquires += shard_metrics.pending_concurrency_acquires;
+            out_metrics->leased_concurrency += shard_metrics.leased_concurrency;
+            s_metrics_merge(out_metrics, &shard_metrics);
+        }
+        return;
+    }
+
     AWS_FATAL_ASSERT(aws_mutex_lock((struct aws_mutex *)(void *)&manager->lock) == AWS_OP_SUCCESS);
+    *out_metrics = manager->metrics;
     out_metrics->available_concurrency = manager->idle_connection_count;
     out_metrics->pending_concurrency_acquires = manager->pending_acquisition_count;
     out_metrics->leased_concurrency = manager->internal_ref[AWS_HCMCT_VENDED_CONNECTION];
@@ -5,6 +5,8 @@
 
 #include <aws/http/private/connection_monitor.h>
 
+#include <aws/http/private/connection_impl.h>
+
 #include <aws/http/connection.h>
 #include <aws/http/statistics.h>
 #include <aws/io/channel.h>
@@ -12,8 +14,74 @@
 #include <aws/io/statistics.h>
 
 #include <aws/common/clock.h>
+#include <aws/common/math.h>
 
 #include <inttypes.h>
+#include <math.h>
+
+/* Saturates at UINT64_MAX. interval_ms must not be 0 */
+static uint64_t s_bytes_per_second(uint64_t bytes, uint64_t interval_ms) {
+    double fractional_bytes_per_second = (double)bytes * (double)AWS_TIMESTAMP_MILLIS / (double)interval_ms;
+    if (fractional_bytes_per_second >= (double)UINT64_MAX) {
+        return UINT64_MAX;
+    }
+    return (uint64_t)fractional_bytes_per_second;
+}
+
+/* Each report moves the health score this fraction of the way to the report's own score */
+static const double s_health_score_smoothing = 0.25;
+
+/* Round trip times up to this multiple of the connection's best don't count against its health */
+static const uint64_t s_health_rtt_allowance_multiplier = 2;
+
+/*
+ * Score a report from 0 to 1 by multiplying together the signals it carries, then fold it into the health score.
+ * Reports without stream activity carry no signal, and leave the score alone.
+ */
+static void s_update_health_score(
+    struct aws_statistics_handler_http_connection_monitor_impl *impl,
+    struct aws_channel *channel,
+    bool throughput_checked,
+    uint64_t bytes_per_second,
+    uint32_t streams_completed,
+    uint32_t streams_failed,
+    uint64_t smoothed_rtt_ns,
+    uint64_t min_rtt_ns) {
+
+    if (!throughput_checked && streams_completed == 0) {
+        return;
+    }
+
+    double report_score = 1.0;
+    if (throughput_checked && bytes_per_second < impl->options.minimum_throughput_bytes_per_second) {
+        report_score *= (double)bytes_per_second / (double)impl->options.minimum_throughput_bytes_per_second;
+    }
+    if (streams_completed > 0) {
+        report_score *= 1.0 - (double)aws_min_u32(streams_failed, streams_completed) / (double)streams_completed;
+    }
+    uint64_t rtt_allowance_ns = aws_mul_u64_saturating(min_rtt_ns, s_health_rtt_allowance_multiplier);
+    if (min_rtt_ns > 0 && smoothed_rtt_ns > rtt_allowance_ns) {
+        report_score *= (double)rtt_allowance_ns / (double)smoothed_rtt_ns;
+    }
+
+    /* Round towards the report, so a run of perfect reports gets all the way back to the max */
+    double previous_score = (double)impl->health_score;
+    double target_score = report_score * AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX;
+    double health_score = previous_score + (target_score - previous_score) * s_health_score_smoothing;
+    health_score = health_score > previous_score ? ceil(health_score) : floor(health_score);
+    impl->health_score = (uint32_t)aws_min_u64((uint64_t)health_score, AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX);
+
+    AWS_LOGF_TRACE(
+        AWS_LS_IO_CHANNEL,
+        "id=%p: channel health score %" PRIu32 " (report scored %.2f)",
+        (void *)channel,
+        impl->health_score,
+        report_score);
+
+    if (impl->connection) {
+        aws_atomic_store_int(&impl->connection->health_score, impl->health_score);
+    }
+}
 
 static void s_process_statistics(
     struct aws_crt_statistics_handler *handler,
@@ -34,13 +102,17 @@ static void s_process_statistics(
     uint64_t bytes_written = 0;
     uint32_t h1_current_outgoing_stream_id = 0;
     uint32_t h1_current_incoming_stream_id = 0;
+    uint32_t streams_completed = 0;
+    uint32_t streams_failed = 0;
+    uint64_t smoothed_rtt_ns = 0;
+    uint64_t min_rtt_ns = 0;
 
     /*
      * Pull out the data needed to perform the throughput calculation
      */
     size_t stats_count = aws_array_list_length(stats_list);
     bool h2 = false;
-    bool h2_was_inactive = false;
+    uint64_t h2_bytes = 0;
 
     for (size_t i = 0; i < stats_count; ++i) {
         struct aws_crt_statistics_base *stats_base = NULL;
@@ -64,6 +136,8 @@ static void s_process_statistics(
                 pending_write_interval_ms = http1_stats->pending_outgoing_stream_ms;
                 h1_current_outgoing_stream_id = http1_stats->current_outgoing_stream_id;
                 h1_current_incoming_stream_id = http1_stats->current_incoming_stream_id;
+                streams_completed = http1_stats->streams_completed;
+                streams_failed = http1_stats->streams_failed;
 
                 break;
             }
@@ -73,7 +147,12 @@ static void s_process_statistics(
                     (struct aws_crt_statistics_http2_channel *)stats_base;
                 pending_read_interval_ms = h2_stats->pending_incoming_stream_ms;
                 pending_write_interval_ms = h2_stats->pending_outgoing_stream_ms;
-                h2_was_inactive |= h2_stats->was_inactive;
+                h2_bytes = aws_add_u64_saturating(h2_stats->bytes_read, h2_stats->bytes_written);
+                h2_bytes = aws_add_u64_saturating(h2_bytes, h2_stats->zero_copy_bytes_written);
+                streams_completed = h2_stats->streams_completed;
+                streams_failed = h2_stats->streams_failed;
+                smoothed_rtt_ns = h2_stats->smoothed_rtt_ns;
+                min_rtt_ns = h2_stats->min_rtt_ns;
                 h2 = true;
                 break;
             }
@@ -93,27 +172,25 @@ static void s_process_statistics(
     uint64_t bytes_per_second = 0;
     uint64_t max_pending_io_interval_ms = 0;
 
-    if (pending_write_interval_ms > 0) {
-        double fractional_bytes_written_per_second =
-            (double)bytes_written * (double)AWS_TIMESTAMP_MILLIS / (double)pending_write_interval_ms;
-        if (fractional_bytes_written_per_second >= (double)UINT64_MAX) {
-            bytes_per_second = UINT64_MAX;
-        } else {
-            bytes_per_second = (uint64_t)fractional_bytes_written_per_second;
+    if (h2) {
+        /* Streams share an HTTP/2 connection, so count the connection's bytes across all streams,
+         * over the time that any stream was active */
+        max_pending_io_interval_ms = aws_max_u64(pending_read_interval_ms, pending_write_interval_ms);
+        if (max_pending_io_interval_ms > 0) {
+            bytes_per_second = s_bytes_per_second(h2_bytes, max_pending_io_interval_ms);
         }
-        max_pending_io_interval_ms = pending_write_interval_ms;
-    }
-
-    if (pending_read_interval_ms > 0) {
-        double fractional_bytes_read_per_second =
-            (double)bytes_read * (double)AWS_TIMESTAMP_MILLIS / (double)pending_read_interval_ms;
-        if (fractional_bytes_read_per_second >= (double)UINT64_MAX) {
-            bytes_per_second = UINT64_MAX;
-        } else {
-            bytes_per_second = aws_add_u64_saturating(bytes_per_second, (uint64_t)fractional_bytes_read_per_second);
+    } else {
+        if (pending_write_interval_ms > 0) {
+            bytes_per_second = s_bytes_per_second(bytes_written, pending_write_interval_ms);
+            max_pending_io_interval_ms = pending_write_interval_ms;
         }
-        if (pending_read_interval_ms > max_pending_io_interval_ms) {
-            max_pending_io_interval_ms = pending_read_interval_ms;
+
+        if (pending_read_interval_ms > 0) {
+            bytes_per_second =
+                aws_add_u64_saturating(bytes_per_second, s_bytes_per_second(bytes_read, pending_read_interval_ms));
+            if (pending_read_interval_ms > max_pending_io_interval_ms) {
+                max_pending_io_interval_ms = pending_read_interval_ms;
+            }
         }
     }
 
@@ -128,8 +205,9 @@ static void s_process_statistics(
      */
     bool check_throughput = false;
     if (h2) {
-        /* For HTTP/2, check throughput only if there always has any active stream on the connection */
-        check_throughput = !h2_was_inactive;
+        /* For HTTP/2, check throughput if any stream was active during the interval.
+         * Failure time only accrues for the time streams were active, so a mostly idle connection isn't evicted */
+        check_throughput = max_pending_io_interval_ms > 0;
     } else {
         /* For HTTP/1, check throughput only if at least one stream exists and was observed in that role previously */
         check_throughput =
@@ -141,6 +219,16 @@ static void s_process_statistics(
     }
     impl->last_measured_throughput = bytes_per_second;
 
+    s_update_health_score(
+        impl,
+        channel,
+        check_throughput,
+        bytes_per_second,
+        streams_completed,
+        streams_failed,
+        smoothed_rtt_ns,
+        min_rtt_ns);
+
     if (!check_throughput) {
         AWS_LOGF_TRACE(AWS_LS_IO_CHANNEL, "id=%p: channel throughput does not need to be checked", (void *)channel);
         impl->throughput_failure_time_ms = 0;
@@ -175,6 +263,10 @@ static void s_process_statistics(
         impl->options.minimum_throughput_bytes_per_second,
         impl->options.allowable_throughput_failure_interval_seconds);
 
+    impl->health_score = 0;
+    if (impl->connection) {
+        aws_atomic_store_int(&impl->connection->health_score, 0);
+    }
     aws_channel_shutdown(channel, AWS_ERROR_HTTP_CHANNEL_THROUGHPUT_FAILURE);
 }
 
@@ -217,6 +309,7 @@ struct aws_crt_statistics_handler *aws_crt_statistics_handler_new_http_connectio
     AWS_ZERO_STRUCT(*handler);
     AWS_ZERO_STRUCT(*impl);
     impl->options = *options;
+    impl->health_score = AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX;
 
     handler->vtable = &s_http_connection_monitor_vtable;
     handler->allocator = allocator;
@@ -225,6 +318,14 @@ struct aws_crt_statistics_handler *aws_crt_statistics_handler_new_http_connectio
     return handler;
 }
 
+void aws_http_connection_monitor_set_connection(
+    struct aws_crt_statistics_handler *handler,
+    struct aws_http_connection *connection) {
+
+    struct aws_statistics_handler_http_connection_monitor_impl *impl = handler->impl;
+    impl->connection = connection;
+}
+
 bool aws_http_connection_monitoring_options_is_valid(const struct aws_http_connection_monitoring_options *options) {
     if (options == NULL) {
         return false;
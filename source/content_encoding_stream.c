@@ -0,0 +1,202 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/content_encoding_stream.h>
+
+#include <aws/http/private/async_body_stream.h>
+#include <aws/http/private/strutil.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/http/request_response.h>
+#include <aws/io/logging.h>
+#include <aws/io/stream.h>
+
+enum {
+    UNENCODED_BUFFER_SIZE = 16 * 1024,
+};
+
+/* Body stream that reads another body stream, and passes it through a content encoder */
+struct aws_http_content_encoding_stream {
+    struct aws_input_stream base;
+    struct aws_allocator *allocator;
+    struct aws_input_stream *body;
+    struct aws_http_content_encoder *encoder;
+    /* Data read from the body that the encoder hasn't consumed yet */
+    struct aws_byte_buf unencoded;
+    struct aws_byte_cursor unencoded_cursor;
+    bool is_body_done;
+    bool is_encoder_done;
+};
+
+static int s_encoding_stream_seek(
+    struct aws_input_stream *stream,
+    int64_t offset,
+    enum aws_stream_seek_basis basis) {
+
+    (void)stream;
+    (void)offset;
+    (void)basis;
+    return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+}
+
+/* Make sure there's body data for the encoder, unless the body is done or has nothing right now */
+static int s_encoding_stream_fill(struct aws_http_content_encoding_stream *encoding_stream) {
+    if (encoding_stream->unencoded_cursor.len > 0 || encoding_stream->is_body_done) {
+        return AWS_OP_SUCCESS;
+    }
+
+    aws_byte_buf_reset(&encoding_stream->unencoded, false /*zero_contents*/);
+    if (aws_input_stream_read(encoding_stream->body, &encoding_stream->unencoded)) {
+        return AWS_OP_ERR;
+    }
+    encoding_stream->unencoded_cursor = aws_byte_cursor_from_buf(&encoding_stream->unencoded);
+
+    if (encoding_stream->unencoded.len == 0) {
+        struct aws_stream_status status;
+        if (aws_input_stream_get_status(encoding_stream->body, &status)) {
+            return AWS_OP_ERR;
+        }
+        encoding_stream->is_body_done = status.is_end_of_stream;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_encoding_stream_read(struct aws_input_stream *stream, struct aws_byte_buf *dest) {
+    struct aws_http_content_encoding_stream *encoding_stream =
+        AWS_CONTAINER_OF(stream, struct aws_http_content_encoding_stream, base);
+    struct aws_http_content_encoder *encoder = encoding_stream->encoder;
+
+    while (dest->len < dest->capacity && !encoding_stream->is_encoder_done) {
+        if (s_encoding_stream_fill(encoding_stream)) {
+            return AWS_OP_ERR;
+        }
+
+        const size_t prev_dest_len = dest->len;
+        const size_t prev_unencoded_len = encoding_stream->unencoded_cursor.len;
+        if (prev_unencoded_len > 0) {
+            if (encoder->vtable->encode(encoder, &encoding_stream->unencoded_cursor, dest)) {
+                return AWS_OP_ERR;
+            }
+        } else if (encoding_stream->is_body_done) {
+            if (encoder->vtable->finish(encoder, dest, &encoding_stream->is_encoder_done)) {
+                return AWS_OP_ERR;
+            }
+        } else {
+            /* Body has no data right now, try again later */
+            break;
+        }
+
+        if (dest->len == prev_dest_len && encoding_stream->unencoded_cursor.len == prev_unencoded_len &&
+            !encoding_stream->is_encoder_done) {
+            AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=%p: Content encoder made no progress.", (void *)stream);
+            return aws_raise_error(AWS_ERROR_HTTP_CONTENT_ENCODING_FAILED);
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_encoding_stream_get_status(struct aws_input_stream *stream, struct aws_stream_status *status) {
+    struct aws_http_content_encoding_stream *encoding_stream =
+        AWS_CONTAINER_OF(stream, struct aws_http_content_encoding_stream, base);
+
+    status->is_end_of_stream = encoding_stream->is_encoder_done;
+    status->is_valid = true;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_encoding_stream_get_length(struct aws_input_stream *stream, int64_t *out_length) {
+    (void)stream;
+    (void)out_length;
+    return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+}
+
+static void s_encoding_stream_destroy(void *user_data) {
+    struct aws_http_content_encoding_stream *encoding_stream = user_data;
+    if (encoding_stream->encoder) {
+        encoding_stream->encoder->vtable->destroy(encoding_stream->encoder);
+    }
+    aws_input_stream_release(encoding_stream->body);
+    aws_byte_buf_clean_up(&encoding_stream->unencoded);
+    aws_mem_release(encoding_stream->allocator, encoding_stream);
+}
+
+static struct aws_input_stream_vtable s_encoding_stream_vtable = {
+    .seek = s_encoding_stream_seek,
+    .read = s_encoding_stream_read,
+    .get_status = s_encoding_stream_get_status,
+    .get_length = s_encoding_stream_get_length,
+};
+
+struct aws_input_stream *aws_http_content_encoding_stream_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *message,
+    const struct aws_http_content_encoding_options *options) {
+
+    const bool has_body =
+        aws_http_message_get_body_stream(message) != NULL || aws_http_message_get_body_async_stream(message) != NULL;
+    const struct aws_http_headers *headers = aws_http_message_get_const_headers(message);
+
+    if (!options->new_encoder || options->content_coding.len == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM, "id=static: Content encoding options must provide content_coding and new_encoder");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+    if (!aws_strutil_is_http_field_value(options->content_coding)) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=static: Content encoding options have an invalid content_coding");
+        aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_VALUE);
+        return NULL;
+    }
+    if (!has_body) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=static: Cannot encode the body of a request with no body stream");
+        aws_raise_error(AWS_ERROR_HTTP_MISSING_BODY_STREAM);
+        return NULL;
+    }
+    if (aws_http_headers_has(headers, aws_byte_cursor_from_c_str("Content-Encoding")) ||
+        aws_http_headers_has(headers, aws_byte_cursor_from_c_str("Transfer-Encoding"))) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM,
+            "id=static: Cannot encode the body of a request which already has Content-Encoding or Transfer-Encoding");
+        aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_FIELD);
+        return NULL;
+    }
+
+    struct aws_http_content_encoding_stream *encoding_stream =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_http_content_encoding_stream));
+    encoding_stream->allocator = allocator;
+    encoding_stream->body = aws_http_message_acquire_outgoing_body(allocator, message);
+    encoding_stream->base.impl = encoding_stream;
+    encoding_stream->base.vtable = &s_encoding_stream_vtable;
+    aws_ref_count_init(&encoding_stream->base.ref_count, encoding_stream, s_encoding_stream_destroy);
+
+    if (aws_byte_buf_init(&encoding_stream->unencoded, allocator, UNENCODED_BUFFER_SIZE)) {
+        goto error;
+    }
+
+    if (options->new_encoder(allocator, options->user_data, &encoding_stream->encoder)) {
+        goto error;
+    }
+    if (!encoding_stream->encoder) {
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        goto error;
+    }
+
+    return &encoding_stream->base;
+
+error:
+    aws_input_stream_release(&encoding_stream->base);
+    return NULL;
+}
+
+struct aws_input_stream *aws_http_content_encoding_stream_get_source(struct aws_input_stream *stream) {
+    if (stream == NULL || stream->vtable != &s_encoding_stream_vtable) {
+        return NULL;
+    }
+
+    struct aws_http_content_encoding_stream *encoding_stream =
+        AWS_CONTAINER_OF(stream, struct aws_http_content_encoding_stream, base);
+    return encoding_stream->body;
+}
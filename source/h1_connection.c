@@ -6,22 +6,39 @@
 #include <aws/common/math.h>
 #include <aws/common/mutex.h>
 #include <aws/common/string.h>
+#include <aws/http/private/async_body_stream.h>
 #include <aws/http/private/h1_connection.h>
 #include <aws/http/private/h1_decoder.h>
 #include <aws/http/private/h1_stream.h>
 #include <aws/http/private/request_response_impl.h>
+#include <aws/http/private/server_admission.h>
+#include <aws/http/private/tracing.h>
 #include <aws/http/status_code.h>
 #include <aws/io/event_loop.h>
 #include <aws/io/logging.h>
 
+#include <errno.h>
 #include <inttypes.h>
 
+#if defined(__linux__)
+#    include <sys/sendfile.h>
+#    define AWS_H1_HAS_SENDFILE
+#endif
+
 #ifdef _MSC_VER
 #    pragma warning(disable : 4204) /* non-constant aggregate initializer */
 #endif
 
 enum {
     DECODER_INITIAL_SCRATCH_SIZE = 256,
+    CHUNK_POOL_MAX_FREE = 32,
+    /* Limit each run of the outgoing-stream-task, so a big file can't hog the event-loop */
+    SENDFILE_MAX_BYTES_PER_TICK = 1024 * 1024,
+    /* How long to wait before trying again when the socket can't take more of a file body.
+     * The wait doubles each time the socket is still full, up to the max */
+    SENDFILE_RETRY_MIN_DELAY_NS = 100 * 1000,
+    SENDFILE_RETRY_MAX_DELAY_NS = 25 * 1000 * 1000,
+    CONTENT_DECODE_BUFFER_SIZE = 16 * 1024,
 };
 
 static int s_handler_process_read_message(
@@ -56,8 +73,10 @@ static struct aws_http_stream *s_make_request(
 static struct aws_http_stream *s_new_server_request_handler_stream(
     const struct aws_http_request_handler_options *options);
 static int s_stream_send_response(struct aws_http_stream *stream, struct aws_http_message *response);
+static int s_stream_send_static_response(struct aws_http_stream *stream, struct aws_http_static_response *response);
 static void s_connection_close(struct aws_http_connection *connection_base);
 static void s_connection_stop_new_request(struct aws_http_connection *connection_base);
+static void s_connection_drain(struct aws_http_connection *connection_base);
 static bool s_connection_is_open(const struct aws_http_connection *connection_base);
 static bool s_connection_new_requests_allowed(const struct aws_http_connection *connection_base);
 static int s_decoder_on_request(
@@ -66,13 +85,21 @@ static int s_decoder_on_request(
     const struct aws_byte_cursor *uri,
     void *user_data);
 static int s_decoder_on_response(int status_code, void *user_data);
-static int s_decoder_on_header(const struct aws_h1_decoded_header *header, void *user_data);
+static int s_decoder_on_headers_batch(
+    const struct aws_h1_decoded_header *headers,
+    size_t num_headers,
+    void *user_data);
 static int s_decoder_on_body(const struct aws_byte_cursor *data, bool finished, void *user_data);
 static int s_decoder_on_done(void *user_data);
 static void s_reset_statistics(struct aws_channel_handler *handler);
 static void s_gather_statistics(struct aws_channel_handler *handler, struct aws_array_list *stats);
 static void s_write_outgoing_stream(struct aws_h1_connection *connection, bool first_try);
+static void s_end_wait_for_continue(struct aws_h1_connection *connection, struct aws_h1_stream *stream, bool send_body);
 static int s_try_process_next_stream_read_message(struct aws_h1_connection *connection, bool *out_stop_processing);
+static void s_body_ref_release_task(struct aws_task *task, void *arg, enum aws_task_status status);
+static int s_arm_stream_timer(struct aws_h1_connection *connection, struct aws_http_timer *timer, uint64_t timeout_ms);
+static void s_server_update_idle_timer(struct aws_h1_connection *connection);
+static void s_server_on_idle_timeout(struct aws_http_timer *timer, void *user_data);
 
 static struct aws_http_connection_vtable s_h1_connection_vtable = {
     .channel_handler_vtable =
@@ -91,8 +118,10 @@ static struct aws_http_connection_vtable s_h1_connection_vtable = {
     .make_request = s_make_request,
     .new_server_request_handler_stream = s_new_server_request_handler_stream,
     .stream_send_response = s_stream_send_response,
+    .stream_send_static_response = s_stream_send_static_response,
     .close = s_connection_close,
     .stop_new_requests = s_connection_stop_new_request,
+    .drain = s_connection_drain,
     .is_open = s_connection_is_open,
     .new_requests_allowed = s_connection_new_requests_allowed,
     .change_settings = NULL,
@@ -107,7 +136,7 @@ static struct aws_http_connection_vtable s_h1_connection_vtable = {
 static const struct aws_h1_decoder_vtable s_h1_decoder_vtable = {
     .on_request = s_decoder_on_request,
     .on_response = s_decoder_on_response,
-    .on_header = s_decoder_on_header,
+    .on_headers_batch = s_decoder_on_headers_batch,
     .on_body = s_decoder_on_body,
     .on_done = s_decoder_on_done,
 };
@@ -156,7 +185,7 @@ static void s_stop(
         /* Even if we're not scheduling shutdown just yet (ex: sent final request but waiting to read final response)
          * we don't consider the connection "open" anymore so user can't create more streams */
         connection->synced_data.is_open = false;
-        connection->synced_data.new_stream_error_code = AWS_ERROR_HTTP_CONNECTION_CLOSED;
+        aws_atomic_store_int(&connection->new_stream_error_code, AWS_ERROR_HTTP_CONNECTION_CLOSED);
 
         aws_h1_connection_unlock_synced_data(connection);
     } /* END CRITICAL SECTION */
@@ -204,13 +233,50 @@ static void s_connection_stop_new_request(struct aws_http_connection *connection
 
     { /* BEGIN CRITICAL SECTION */
         aws_h1_connection_lock_synced_data(connection);
-        if (!connection->synced_data.new_stream_error_code) {
-            connection->synced_data.new_stream_error_code = AWS_ERROR_HTTP_CONNECTION_CLOSED;
+        if (!aws_atomic_load_int(&connection->new_stream_error_code)) {
+            aws_atomic_store_int(&connection->new_stream_error_code, AWS_ERROR_HTTP_CONNECTION_CLOSED);
         }
         aws_h1_connection_unlock_synced_data(connection);
     } /* END CRITICAL SECTION */
 }
 
+/* Server-only. The request in progress (if any) becomes the final one, and its response says "Connection: close" */
+static void s_connection_drain(struct aws_http_connection *connection_base) {
+    struct aws_h1_connection *connection = AWS_CONTAINER_OF(connection_base, struct aws_h1_connection, base);
+    AWS_ASSERT(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+    AWS_ASSERT(connection->base.server_data);
+
+    if (connection->thread_data.is_draining || connection->thread_data.has_switched_protocols) {
+        /* Nothing more to do, or nothing HTTP/1 can do (the server's deadline closes switched connections) */
+        return;
+    }
+    connection->thread_data.is_draining = true;
+
+    if (aws_linked_list_empty(&connection->thread_data.stream_list)) {
+        AWS_LOGF_DEBUG(AWS_LS_HTTP_CONNECTION, "id=%p: Draining idle connection, closing.", (void *)&connection->base);
+        s_connection_close(&connection->base);
+        return;
+    }
+
+    struct aws_h1_stream *final_stream =
+        AWS_CONTAINER_OF(aws_linked_list_back(&connection->thread_data.stream_list), struct aws_h1_stream, node);
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Draining connection, stream=%p will be the final stream on this connection.",
+        (void *)&connection->base,
+        (void *)&final_stream->base);
+
+    final_stream->is_final_stream = true;
+    s_connection_stop_new_request(&connection->base);
+
+    /* If the final request was already read, don't read any more. Otherwise that happens once it's done */
+    if (final_stream->is_incoming_message_done) {
+        s_stop(
+            connection, true /*stop_reading*/, false /*stop_writing*/, false /*schedule_shutdown*/, AWS_ERROR_SUCCESS);
+    }
+}
+
 static bool s_connection_is_open(const struct aws_http_connection *connection_base) {
     struct aws_h1_connection *connection = AWS_CONTAINER_OF(connection_base, struct aws_h1_connection, base);
     bool is_open;
@@ -226,13 +292,7 @@ static bool s_connection_is_open(const struct aws_http_connection *connection_ba
 
 static bool s_connection_new_requests_allowed(const struct aws_http_connection *connection_base) {
     struct aws_h1_connection *connection = AWS_CONTAINER_OF(connection_base, struct aws_h1_connection, base);
-    int new_stream_error_code;
-    { /* BEGIN CRITICAL SECTION */
-        aws_h1_connection_lock_synced_data(connection);
-        new_stream_error_code = connection->synced_data.new_stream_error_code;
-        aws_h1_connection_unlock_synced_data(connection);
-    } /* END CRITICAL SECTION */
-    return new_stream_error_code == 0;
+    return aws_atomic_load_int(&connection->new_stream_error_code) == 0;
 }
 
 static int s_stream_send_response(struct aws_http_stream *stream, struct aws_http_message *response) {
@@ -242,6 +302,13 @@ static int s_stream_send_response(struct aws_http_stream *stream, struct aws_htt
     return aws_h1_stream_send_response(h1_stream, response);
 }
 
+static int s_stream_send_static_response(struct aws_http_stream *stream, struct aws_http_static_response *response) {
+    AWS_PRECONDITION(stream);
+    AWS_PRECONDITION(response);
+    struct aws_h1_stream *h1_stream = AWS_CONTAINER_OF(stream, struct aws_h1_stream, base);
+    return aws_h1_stream_send_static_response(h1_stream, response);
+}
+
 /* Calculate the desired window size for connection that has switched protocols and become a midchannel handler. */
 static size_t s_calculate_midchannel_desired_connection_window(struct aws_h1_connection *connection) {
     AWS_ASSERT(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
@@ -267,10 +334,13 @@ static size_t s_calculate_stream_mode_desired_connection_window(struct aws_h1_co
 
     /* Connection window should match the available space in the read-buffer */
     AWS_ASSERT(
-        connection->thread_data.read_buffer.pending_bytes <= connection->thread_data.read_buffer.capacity &&
+        (connection->thread_data.read_buffer.pending_bytes <= connection->thread_data.read_buffer.capacity ||
+         connection->thread_data.read_buffer.min_capacity != connection->thread_data.read_buffer.max_capacity) &&
         "This isn't fatal, but our math is off");
     const size_t desired_connection_window = aws_sub_size_saturating(
-        connection->thread_data.read_buffer.capacity, connection->thread_data.read_buffer.pending_bytes);
+        aws_sub_size_saturating(
+            connection->thread_data.read_buffer.capacity, connection->thread_data.read_buffer.pending_bytes),
+        connection->thread_data.retained_body_bytes);
 
     AWS_LOGF_TRACE(
         AWS_LS_HTTP_CONNECTION,
@@ -286,6 +356,95 @@ static size_t s_calculate_stream_mode_desired_connection_window(struct aws_h1_co
     return desired_connection_window;
 }
 
+/* Adapt the read buffer's capacity to how quickly the incoming HTTP-stream consumes data.
+ * Shrinking doesn't take back window that's already been granted, so pending bytes may briefly exceed capacity.
+ * The window just stays closed until they're processed. */
+static void s_autotune_read_buffer(struct aws_h1_connection *connection) {
+    AWS_ASSERT(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+    AWS_ASSERT(!connection->thread_data.has_switched_protocols);
+
+    if (connection->thread_data.read_buffer.min_capacity == connection->thread_data.read_buffer.max_capacity) {
+        return;
+    }
+
+    const size_t prev_capacity = connection->thread_data.read_buffer.capacity;
+    const size_t min_capacity = connection->thread_data.read_buffer.min_capacity;
+    struct aws_h1_stream *incoming_stream = connection->thread_data.incoming_stream;
+    size_t new_capacity = prev_capacity;
+
+    if (aws_linked_list_empty(&connection->thread_data.stream_list)) {
+        /* Idle connections shouldn't invite lots of data */
+        new_capacity = min_capacity;
+    } else if (connection->thread_data.read_buffer.pending_bytes == 0) {
+        /* Stream consumed everything. If the window ran out first, a bigger window would have been faster */
+        if (connection->thread_data.read_buffer.is_window_exhausted) {
+            new_capacity = aws_min_size(
+                connection->thread_data.read_buffer.max_capacity, aws_mul_size_saturating(prev_capacity, 2));
+        }
+    } else if (incoming_stream && incoming_stream->thread_data.stream_window == 0) {
+        /* Data is piling up behind a slow stream */
+        new_capacity = aws_max_size(min_capacity, prev_capacity / 2);
+    }
+
+    connection->thread_data.read_buffer.is_window_exhausted = false;
+
+    if (new_capacity != prev_capacity) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_CONNECTION,
+            "id=%p: Read buffer capacity autotuned from %zu to %zu.",
+            (void *)&connection->base,
+            prev_capacity,
+            new_capacity);
+        connection->thread_data.read_buffer.capacity = new_capacity;
+    }
+}
+
+/* Settle up with the memory budget, then draw up to `increment_size` more for the connection window.
+ * Returns how much the window may grow. If that's less than asked, waits for bytes to be given back */
+static size_t s_draw_window_from_memory_budget(struct aws_h1_connection *connection, size_t increment_size) {
+    AWS_ASSERT(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+
+    /* Once protocols have switched, data passes straight through to the next handler, nothing is buffered here */
+    if (connection->thread_data.has_switched_protocols) {
+        aws_http_memory_budget_give_back(connection->memory_budget, connection->thread_data.memory_budget_drawn);
+        connection->thread_data.memory_budget_drawn = 0;
+        return increment_size;
+    }
+
+    /* Give back whatever was processed or freed since the last time */
+    const size_t needed = aws_add_size_saturating(
+        connection->thread_data.connection_window,
+        aws_add_size_saturating(
+            connection->thread_data.read_buffer.pending_bytes, connection->thread_data.retained_body_bytes));
+    if (connection->thread_data.memory_budget_drawn > needed) {
+        aws_http_memory_budget_give_back(
+            connection->memory_budget, connection->thread_data.memory_budget_drawn - needed);
+        connection->thread_data.memory_budget_drawn = needed;
+    }
+
+    if (increment_size == 0) {
+        return 0;
+    }
+
+    struct aws_http_memory_budget_waiter *waiter =
+        connection->thread_data.is_waiting_for_memory_budget ? NULL : &connection->memory_budget_waiter;
+    const size_t drawn = aws_http_memory_budget_draw(connection->memory_budget, increment_size, waiter);
+    connection->thread_data.memory_budget_drawn += drawn;
+
+    if (drawn < increment_size && waiter) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_CONNECTION,
+            "id=%p: Memory budget exhausted, connection window held at %zu until bytes are given back.",
+            (void *)&connection->base,
+            connection->thread_data.connection_window + drawn);
+
+        connection->thread_data.is_waiting_for_memory_budget = true;
+        aws_channel_acquire_hold(connection->base.channel_slot->channel);
+    }
+
+    return drawn;
+}
+
 /* Increment connection window, if necessary */
 static int s_update_connection_window(struct aws_h1_connection *connection) {
     AWS_ASSERT(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
@@ -298,7 +457,11 @@ static int s_update_connection_window(struct aws_h1_connection *connection) {
                                     ? s_calculate_midchannel_desired_connection_window(connection)
                                     : s_calculate_stream_mode_desired_connection_window(connection);
 
-    const size_t increment_size = aws_sub_size_saturating(desired_size, connection->thread_data.connection_window);
+    size_t increment_size = aws_sub_size_saturating(desired_size, connection->thread_data.connection_window);
+    if (connection->memory_budget) {
+        increment_size = s_draw_window_from_memory_budget(connection, increment_size);
+    }
+
     if (increment_size > 0) {
         /* Update local `connection_window`. See comments at variable's declaration site
          * on why we use this instead of the official `aws_channel_slot.window_size` */
@@ -320,61 +483,106 @@ static int s_update_connection_window(struct aws_h1_connection *connection) {
     return AWS_OP_SUCCESS;
 }
 
+/* Invoked on whichever thread gave bytes back to the budget, with the budget's lock held */
+static void s_on_memory_budget_available(void *user_data) {
+    struct aws_h1_connection *connection = user_data;
+    aws_channel_schedule_task_now(connection->base.channel_slot->channel, &connection->memory_budget_task);
+}
+
+static void s_memory_budget_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_h1_connection *connection = arg;
+    struct aws_channel *channel = connection->base.channel_slot->channel;
+
+    connection->thread_data.is_waiting_for_memory_budget = false;
+    if (status == AWS_TASK_STATUS_RUN_READY && s_update_connection_window(connection)) {
+        s_shutdown_due_to_error(connection, aws_last_error());
+    }
+
+    /* Releasing the hold may destroy the connection, so this must come last */
+    aws_channel_release_hold(channel);
+}
+
+/* Stream IDs are only 31 bits [RFC 7540 5.1.1] */
+static const size_t s_max_client_stream_id = UINT32_MAX >> 1;
+
+static void s_log_activate_failed(
+    struct aws_h1_connection *connection,
+    struct aws_http_stream *stream,
+    int error_code) {
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Failed to activate the stream id=%p, new streams are not allowed now. error %d (%s)",
+        (void *)&connection->base,
+        (void *)stream,
+        error_code,
+        aws_error_name(error_code));
+}
+
+/* Activation takes no lock. Apps may activate thousands of streams per second on one connection,
+ * from many threads, so the stream is pushed onto a lock-free queue instead of a locked list. */
 int aws_h1_stream_activate(struct aws_http_stream *stream) {
     struct aws_h1_stream *h1_stream = AWS_CONTAINER_OF(stream, struct aws_h1_stream, base);
 
     struct aws_http_connection *base_connection = stream->owning_connection;
     struct aws_h1_connection *connection = AWS_CONTAINER_OF(base_connection, struct aws_h1_connection, base);
 
-    bool should_schedule_task = false;
+    if (aws_atomic_load_int(&h1_stream->api_state) != AWS_H1_STREAM_API_STATE_INIT) {
+        /* stream has already been activated. */
+        return AWS_OP_SUCCESS;
+    }
 
-    { /* BEGIN CRITICAL SECTION */
-        /* Note: We're touching both the connection's and stream's synced_data in this section,
-         * which is OK because an h1_connection and all its h1_streams share a single lock. */
-        aws_h1_connection_lock_synced_data(connection);
+    int new_stream_error_code = (int)aws_atomic_load_int(&connection->new_stream_error_code);
+    if (new_stream_error_code) {
+        s_log_activate_failed(connection, stream, new_stream_error_code);
+        return aws_raise_error(new_stream_error_code);
+    }
 
-        if (stream->id) {
-            /* stream has already been activated. */
-            aws_h1_connection_unlock_synced_data(connection);
-            return AWS_OP_SUCCESS;
-        }
+    /* Only one caller gets to move the stream from INIT to ACTIVE */
+    size_t expected_state = AWS_H1_STREAM_API_STATE_INIT;
+    if (!aws_atomic_compare_exchange_int(&h1_stream->api_state, &expected_state, AWS_H1_STREAM_API_STATE_ACTIVE)) {
+        /* stream has already been activated. */
+        return AWS_OP_SUCCESS;
+    }
 
-        if (connection->synced_data.new_stream_error_code) {
-            aws_h1_connection_unlock_synced_data(connection);
-            AWS_LOGF_ERROR(
-                AWS_LS_HTTP_CONNECTION,
-                "id=%p: Failed to activate the stream id=%p, new streams are not allowed now. error %d (%s)",
-                (void *)&connection->base,
-                (void *)stream,
-                connection->synced_data.new_stream_error_code,
-                aws_error_name(connection->synced_data.new_stream_error_code));
-            return aws_raise_error(connection->synced_data.new_stream_error_code);
-        }
+    const size_t next_id = aws_atomic_fetch_add(&connection->next_client_stream_id, 2);
+    if (AWS_UNLIKELY(next_id > s_max_client_stream_id)) {
+        AWS_LOGF_INFO(AWS_LS_HTTP_CONNECTION, "id=%p: All available stream ids are gone", (void *)base_connection);
+        aws_atomic_store_int(&h1_stream->api_state, AWS_H1_STREAM_API_STATE_INIT);
+        return aws_raise_error(AWS_ERROR_HTTP_STREAM_IDS_EXHAUSTED);
+    }
 
-        stream->id = aws_http_connection_get_next_stream_id(base_connection);
-        if (!stream->id) {
-            aws_h1_connection_unlock_synced_data(connection);
-            /* aws_http_connection_get_next_stream_id() raises its own error. */
-            return AWS_OP_ERR;
-        }
+    /* ID successfully assigned */
+    stream->id = (uint32_t)next_id;
+    if (stream->metrics.queue_start_timestamp_ns == -1) {
+        aws_high_res_clock_get_ticks((uint64_t *)&stream->metrics.queue_start_timestamp_ns);
+    }
+    stream->metrics.connection_reuse_count = (stream->id - 1) / 2;
+    stream->metrics.stream_id = stream->id;
 
-        /* ID successfully assigned */
-        h1_stream->synced_data.api_state = AWS_H1_STREAM_API_STATE_ACTIVE;
+    /* connection keeps activated stream alive until stream completes.
+     * Take that reference before pushing, the connection may complete the stream as soon as it's in the queue */
+    aws_atomic_fetch_add(&stream->refcount, 1);
 
-        aws_linked_list_push_back(&connection->synced_data.new_client_stream_list, &h1_stream->node);
-        if (!connection->synced_data.is_cross_thread_work_task_scheduled) {
-            connection->synced_data.is_cross_thread_work_task_scheduled = true;
-            should_schedule_task = true;
+    enum aws_http_mpsc_queue_push_result push_result =
+        aws_http_mpsc_queue_push(&connection->new_client_stream_queue, &h1_stream->node);
+    if (push_result == AWS_HTTP_MPSC_QUEUE_CLOSED) {
+        /* The connection finished shutting down after we checked new_stream_error_code */
+        aws_atomic_fetch_sub(&stream->refcount, 1);
+        stream->id = 0;
+        aws_atomic_store_int(&h1_stream->api_state, AWS_H1_STREAM_API_STATE_INIT);
+
+        new_stream_error_code = (int)aws_atomic_load_int(&connection->new_stream_error_code);
+        if (!new_stream_error_code) {
+            new_stream_error_code = AWS_ERROR_HTTP_CONNECTION_CLOSED;
         }
+        s_log_activate_failed(connection, stream, new_stream_error_code);
+        return aws_raise_error(new_stream_error_code);
+    }
 
-        aws_h1_connection_unlock_synced_data(connection);
-    } /* END CRITICAL SECTION */
-
-    /* connection keeps activated stream alive until stream completes */
-    aws_atomic_fetch_add(&stream->refcount, 1);
-    stream->metrics.stream_id = stream->id;
+    AWS_HTTP_PROBE2(stream__activate, stream, (uint32_t)next_id);
 
-    if (should_schedule_task) {
+    if (push_result == AWS_HTTP_MPSC_QUEUE_PUSHED_FIRST) {
         AWS_LOGF_TRACE(
             AWS_LS_HTTP_CONNECTION, "id=%p: Scheduling connection cross-thread work task.", (void *)base_connection);
         aws_channel_schedule_task_now(connection->base.channel_slot->channel, &connection->cross_thread_work_task);
@@ -395,7 +603,7 @@ void aws_h1_stream_cancel(struct aws_http_stream *stream, int error_code) {
 
     { /* BEGIN CRITICAL SECTION */
         aws_h1_connection_lock_synced_data(connection);
-        if (h1_stream->synced_data.api_state != AWS_H1_STREAM_API_STATE_ACTIVE ||
+        if (aws_atomic_load_int(&h1_stream->api_state) != AWS_H1_STREAM_API_STATE_ACTIVE ||
             connection->synced_data.is_open == false) {
             /* Not active, nothing to cancel. */
             aws_h1_connection_unlock_synced_data(connection);
@@ -434,12 +642,7 @@ struct aws_http_stream *s_make_request(
     struct aws_h1_connection *connection = AWS_CONTAINER_OF(client_connection, struct aws_h1_connection, base);
 
     /* Insert new stream into pending list, and schedule outgoing_stream_task if it's not already running. */
-    int new_stream_error_code;
-    { /* BEGIN CRITICAL SECTION */
-        aws_h1_connection_lock_synced_data(connection);
-        new_stream_error_code = connection->synced_data.new_stream_error_code;
-        aws_h1_connection_unlock_synced_data(connection);
-    } /* END CRITICAL SECTION */
+    int new_stream_error_code = (int)aws_atomic_load_int(&connection->new_stream_error_code);
     if (new_stream_error_code) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_CONNECTION,
@@ -475,7 +678,7 @@ error:
     return NULL;
 }
 
-/* Extract work items from synced_data, and perform the work on-thread. */
+/* Extract new client streams from the queue, and perform their work on-thread. */
 static void s_cross_thread_work_task(struct aws_channel_task *channel_task, void *arg, enum aws_task_status status) {
     (void)channel_task;
     struct aws_h1_connection *connection = arg;
@@ -487,17 +690,30 @@ static void s_cross_thread_work_task(struct aws_channel_task *channel_task, void
     AWS_LOGF_TRACE(
         AWS_LS_HTTP_CONNECTION, "id=%p: Running connection cross-thread work task.", (void *)&connection->base);
 
-    /* BEGIN CRITICAL SECTION */
-    aws_h1_connection_lock_synced_data(connection);
-
-    connection->synced_data.is_cross_thread_work_task_scheduled = false;
-
-    bool has_new_client_streams = !aws_linked_list_empty(&connection->synced_data.new_client_stream_list);
-    aws_linked_list_move_all_back(
-        &connection->thread_data.stream_list, &connection->synced_data.new_client_stream_list);
-
-    aws_h1_connection_unlock_synced_data(connection);
-    /* END CRITICAL SECTION */
+    /* Once the queue is empty, the next stream activated will schedule this task again */
+    struct aws_linked_list new_client_streams;
+    aws_linked_list_init(&new_client_streams);
+    aws_http_mpsc_queue_take_all(&connection->new_client_stream_queue, &new_client_streams);
+
+    bool has_new_client_streams = !aws_linked_list_empty(&new_client_streams);
+    while (!aws_linked_list_empty(&new_client_streams)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&new_client_streams);
+        struct aws_h1_stream *stream = AWS_CONTAINER_OF(node, struct aws_h1_stream, node);
+        aws_linked_list_push_back(&connection->thread_data.stream_list, node);
+
+        /* The request timeout counts from when the stream reaches the connection's thread */
+        const uint64_t request_timeout_ms = stream->base.client_data->request_timeout_ms;
+        if (request_timeout_ms != 0 &&
+            s_arm_stream_timer(connection, &stream->request_timer, request_timeout_ms)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_STREAM,
+                "id=%p: Failed to arm request timeout, error %d (%s). Closing connection.",
+                (void *)&stream->base,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            s_shutdown_due_to_error(connection, aws_last_error());
+        }
+    }
 
     /* Kick off outgoing-stream task if necessary */
     if (has_new_client_streams) {
@@ -554,7 +770,7 @@ static int s_aws_http1_switch_protocols(struct aws_h1_connection *connection) {
     connection->thread_data.has_switched_protocols = true;
     { /* BEGIN CRITICAL SECTION */
         aws_h1_connection_lock_synced_data(connection);
-        connection->synced_data.new_stream_error_code = AWS_ERROR_HTTP_SWITCHED_PROTOCOLS;
+        aws_atomic_store_int(&connection->new_stream_error_code, AWS_ERROR_HTTP_SWITCHED_PROTOCOLS);
         aws_h1_connection_unlock_synced_data(connection);
     } /* END CRITICAL SECTION */
 
@@ -577,12 +793,17 @@ static void s_stream_complete(struct aws_h1_stream *stream, int error_code) {
         }
     }
 
-    if (stream->base.client_data && stream->base.client_data->response_first_byte_timeout_task.fn != NULL) {
-        /* There is an outstanding response timeout task, but stream completed, we can cancel it now. We are
-         * safe to do it as we always on connection thread to schedule the task or cancel it */
-        struct aws_event_loop *connection_loop = aws_channel_get_event_loop(connection->base.channel_slot->channel);
-        /* The task will be zeroed out within the call */
-        aws_event_loop_cancel_task(connection_loop, &stream->base.client_data->response_first_byte_timeout_task);
+    ++connection->thread_data.stats.streams_completed;
+    if (error_code != AWS_ERROR_SUCCESS) {
+        ++connection->thread_data.stats.streams_failed;
+    }
+
+    if (stream->base.client_data) {
+        /* Stream completed, so any outstanding timers can be canceled. We are safe to do it as we always on
+         * connection thread to arm or cancel them */
+        aws_http_timer_cancel(&stream->response_first_byte_timer);
+        aws_http_timer_cancel(&stream->request_timer);
+        aws_http_timer_cancel(&stream->expect_continue_timer);
     }
 
     if (error_code != AWS_ERROR_SUCCESS) {
@@ -615,6 +836,11 @@ static void s_stream_complete(struct aws_h1_stream *stream, int error_code) {
     /* Remove stream from list. */
     aws_linked_list_remove(&stream->node);
 
+    if (stream->is_admission_counted) {
+        aws_http_server_admission_on_stream_complete(connection->base.server_data->admission);
+        stream->is_admission_counted = false;
+    }
+
     /* Nice logging */
     if (error_code) {
         AWS_LOGF_DEBUG(
@@ -651,13 +877,15 @@ static void s_stream_complete(struct aws_h1_stream *stream, int error_code) {
         s_connection_close(&connection->base);
     }
 
+    s_server_update_idle_timer(connection);
+
     { /* BEGIN CRITICAL SECTION */
         /* Note: We're touching the stream's synced_data here, which is OK
          * because an h1_connection and all its h1_streams share a single lock. */
         aws_h1_connection_lock_synced_data(connection);
 
         /* Mark stream complete */
-        stream->synced_data.api_state = AWS_H1_STREAM_API_STATE_COMPLETE;
+        aws_atomic_store_int(&stream->api_state, AWS_H1_STREAM_API_STATE_COMPLETE);
 
         /* Move chunks out of synced data */
         aws_linked_list_move_all_back(&stream->thread_data.pending_chunk_list, &stream->synced_data.pending_chunk_list);
@@ -672,6 +900,7 @@ static void s_stream_complete(struct aws_h1_stream *stream, int error_code) {
         aws_h1_chunk_complete_and_destroy(chunk, &stream->base, AWS_ERROR_HTTP_STREAM_HAS_COMPLETED);
     }
 
+    AWS_HTTP_PROBE2(stream__complete, &stream->base, error_code);
     if (stream->base.on_metrics) {
         stream->base.on_metrics(&stream->base, &stream->base.metrics, stream->base.user_data);
     }
@@ -759,19 +988,10 @@ static void s_client_update_incoming_stream_ptr(struct aws_h1_connection *connec
     s_set_incoming_stream_ptr(connection, desired);
 }
 
-static void s_http_stream_response_first_byte_timeout_task(
-    struct aws_task *task,
-    void *arg,
-    enum aws_task_status status) {
-    (void)task;
-    struct aws_h1_stream *stream = arg;
+static void s_http_stream_response_first_byte_timeout(struct aws_http_timer *timer, void *user_data) {
+    (void)timer;
+    struct aws_h1_stream *stream = user_data;
     struct aws_http_connection *connection_base = stream->base.owning_connection;
-    /* zero-out task to indicate that it's no longer scheduled */
-    AWS_ZERO_STRUCT(stream->base.client_data->response_first_byte_timeout_task);
-
-    if (status == AWS_TASK_STATUS_CANCELED) {
-        return;
-    }
 
     struct aws_h1_connection *connection = AWS_CONTAINER_OF(connection_base, struct aws_h1_connection, base);
     /* Timeout happened, close the connection */
@@ -794,6 +1014,93 @@ static void s_http_stream_response_first_byte_timeout_task(
         AWS_ERROR_HTTP_RESPONSE_FIRST_BYTE_TIMEOUT);
 }
 
+static void s_http_stream_request_timeout(struct aws_http_timer *timer, void *user_data) {
+    (void)timer;
+    struct aws_h1_stream *stream = user_data;
+    struct aws_h1_connection *connection =
+        AWS_CONTAINER_OF(stream->base.owning_connection, struct aws_h1_connection, base);
+
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Closing connection as request did not complete in time. request_timeout_ms is %" PRIu64 ".",
+        (void *)&connection->base,
+        stream->base.client_data->request_timeout_ms);
+
+    /* Don't stop reading/writing immediately, let that happen naturally during the channel shutdown process. */
+    s_stop(
+        connection,
+        false /*stop_reading*/,
+        false /*stop_writing*/,
+        true /*schedule_shutdown*/,
+        AWS_ERROR_HTTP_REQUEST_TIMEOUT);
+}
+
+/* Server didn't respond to "Expect: 100-continue" in time. Maybe it never will, so send the body anyway */
+static void s_http_stream_expect_continue_timeout(struct aws_http_timer *timer, void *user_data) {
+    (void)timer;
+    struct aws_h1_stream *stream = user_data;
+    struct aws_h1_connection *connection =
+        AWS_CONTAINER_OF(stream->base.owning_connection, struct aws_h1_connection, base);
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_STREAM,
+        "id=%p: No 100 (Continue) after %" PRIu64 "ms, sending body anyway.",
+        (void *)&stream->base,
+        connection->expect_continue_timeout_ms);
+
+    s_end_wait_for_continue(connection, stream, true /*send_body*/);
+}
+
+void aws_h1_connection_init_stream_timers(struct aws_h1_stream *stream) {
+    aws_http_timer_init(&stream->response_first_byte_timer, s_http_stream_response_first_byte_timeout, stream);
+    aws_http_timer_init(&stream->request_timer, s_http_stream_request_timeout, stream);
+    aws_http_timer_init(&stream->expect_continue_timer, s_http_stream_expect_continue_timeout, stream);
+}
+
+/* Arm one of a stream's or the connection's timers in the event-loop's shared timer wheel */
+static int s_arm_stream_timer(struct aws_h1_connection *connection, struct aws_http_timer *timer, uint64_t timeout_ms) {
+    struct aws_event_loop *connection_loop = aws_channel_get_event_loop(connection->base.channel_slot->channel);
+    return aws_http_event_loop_timer_arm(
+        connection_loop, timer, aws_timestamp_convert(timeout_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
+}
+
+static void s_server_on_idle_timeout(struct aws_http_timer *timer, void *user_data) {
+    (void)timer;
+    struct aws_h1_connection *connection = user_data;
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Closing connection, no request arrived for %" PRIu64 "ms.",
+        (void *)&connection->base,
+        connection->idle_timeout_ms);
+
+    s_connection_close(&connection->base);
+}
+
+/* Arm the server's idle timer while no request is in progress, and cancel it while one is */
+static void s_server_update_idle_timer(struct aws_h1_connection *connection) {
+    if (!connection->base.server_data || connection->idle_timeout_ms == 0) {
+        return;
+    }
+
+    bool is_idle = aws_linked_list_empty(&connection->thread_data.stream_list) &&
+                   !connection->thread_data.is_reading_stopped && !connection->thread_data.has_switched_protocols;
+
+    if (!is_idle) {
+        aws_http_timer_cancel(&connection->thread_data.idle_timer);
+    } else if (!aws_http_timer_is_armed(&connection->thread_data.idle_timer)) {
+        if (s_arm_stream_timer(connection, &connection->thread_data.idle_timer, connection->idle_timeout_ms)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_CONNECTION,
+                "id=%p: Failed to arm idle timeout, error %d (%s). Closing connection.",
+                (void *)&connection->base,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            s_shutdown_due_to_error(connection, aws_last_error());
+        }
+    }
+}
+
 static void s_set_outgoing_message_done(struct aws_h1_stream *stream) {
     struct aws_http_connection *connection = stream->base.owning_connection;
     struct aws_channel *channel = aws_http_connection_get_channel(connection);
@@ -821,25 +1128,42 @@ static void s_set_outgoing_message_done(struct aws_h1_stream *stream) {
                                                  : stream->base.client_data->response_first_byte_timeout_ms;
         }
         if (response_first_byte_timeout_ms != 0) {
-            /* The task should not be initialized before. */
-            AWS_ASSERT(stream->base.client_data->response_first_byte_timeout_task.fn == NULL);
-            aws_task_init(
-                &stream->base.client_data->response_first_byte_timeout_task,
-                s_http_stream_response_first_byte_timeout_task,
-                stream,
-                "http_stream_response_first_byte_timeout_task");
-            uint64_t now_ns = 0;
-            aws_channel_current_clock_time(channel, &now_ns);
-            struct aws_event_loop *connection_loop = aws_channel_get_event_loop(channel);
-            aws_event_loop_schedule_task_future(
-                connection_loop,
-                &stream->base.client_data->response_first_byte_timeout_task,
-                now_ns + aws_timestamp_convert(
-                             response_first_byte_timeout_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
+            /* The timer should not be armed before. */
+            AWS_ASSERT(!aws_http_timer_is_armed(&stream->response_first_byte_timer));
+            struct aws_h1_connection *h1_connection = AWS_CONTAINER_OF(connection, struct aws_h1_connection, base);
+            if (s_arm_stream_timer(
+                    h1_connection,
+                    &stream->response_first_byte_timer,
+                    response_first_byte_timeout_ms)) {
+                AWS_LOGF_ERROR(
+                    AWS_LS_HTTP_STREAM,
+                    "id=%p: Failed to arm response first byte timeout, error %d (%s). Closing connection.",
+                    (void *)&stream->base,
+                    aws_last_error(),
+                    aws_error_name(aws_last_error()));
+                s_shutdown_due_to_error(h1_connection, aws_last_error());
+            }
         }
     }
 }
 
+/**
+ * Whether the client stream must wait for responses to the requests ahead of it before it's written.
+ * Called from event-loop thread.
+ */
+static bool s_client_pipeline_is_full(struct aws_h1_connection *connection, struct aws_h1_stream *next) {
+    size_t in_flight = 0;
+    bool all_idempotent = next->is_idempotent;
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&connection->thread_data.stream_list);
+         node != &next->node;
+         node = aws_linked_list_next(node)) {
+        struct aws_h1_stream *stream = AWS_CONTAINER_OF(node, struct aws_h1_stream, node);
+        all_idempotent &= stream->is_idempotent;
+        ++in_flight;
+    }
+    return in_flight >= connection->max_pipeline_depth || (in_flight > 0 && !all_idempotent);
+}
+
 /**
  * If necessary, update `outgoing_stream` so it is pointing at a stream
  * with data to send, or NULL if all streams are done sending data.
@@ -907,6 +1231,12 @@ static struct aws_h1_stream *s_update_outgoing_stream_ptr(struct aws_h1_connecti
                 break;
             }
 
+            /* STOP if we're a client and pipelining is limited, until enough responses arrive.
+             * The streams skipped above are the requests in flight. */
+            if (connection->max_pipeline_depth && s_client_pipeline_is_full(connection, stream)) {
+                break;
+            }
+
             /* We found a stream to work on! */
             current = stream;
             current_changed = true;
@@ -925,8 +1255,24 @@ static struct aws_h1_stream *s_update_outgoing_stream_ptr(struct aws_h1_connecti
         s_set_outgoing_stream_ptr(connection, current);
 
         if (current) {
-            AWS_ASSERT(current->base.metrics.send_start_timestamp_ns == -1);
-            aws_high_res_clock_get_ticks((uint64_t *)&current->base.metrics.send_start_timestamp_ns);
+            /* Tell the client not to send anything more, if this is the final response of a server that's
+             * draining, or that has received max_requests requests on this connection */
+            const bool server_is_ending = connection->thread_data.is_draining ||
+                                          (connection->max_requests &&
+                                           connection->thread_data.request_count >= connection->max_requests);
+            if (server_is_ending && current->is_final_stream &&
+                !current->encoder_message.has_connection_close_header) {
+                aws_h1_encoder_message_add_connection_close(&current->encoder_message, connection->base.alloc);
+            }
+
+            struct aws_http_stream_metrics *metrics = &current->base.metrics;
+            AWS_ASSERT(metrics->send_start_timestamp_ns == -1);
+            aws_high_res_clock_get_ticks((uint64_t *)&metrics->send_start_timestamp_ns);
+            if (metrics->queue_start_timestamp_ns != -1) {
+                metrics->queue_duration_ns = metrics->send_start_timestamp_ns - metrics->queue_start_timestamp_ns;
+            }
+            metrics->header_bytes_sent = current->encoder_message.head_len;
+            metrics->header_bytes_sent_encoded = current->encoder_message.head_len;
 
             err = aws_h1_encoder_start_message(
                 &connection->thread_data.encoder, &current->encoder_message, &current->base);
@@ -987,32 +1333,249 @@ static void s_on_channel_write_complete(
     aws_channel_schedule_task_now(channel, &connection->outgoing_stream_task);
 }
 
-static void s_outgoing_stream_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
-    (void)task;
-    if (status != AWS_TASK_STATUS_RUN_READY) {
-        return;
+/* An aws_io_message whose data is caller-owned memory from a zero-copy chunk (see aws_http1_chunk_options).
+ * The chunk's completion callback moves here, so it only fires once the channel is done with the memory. */
+struct aws_h1_zero_copy_message {
+    struct aws_io_message base;
+    struct aws_h1_connection *connection;
+    /* Hold a reference, so the stream is still valid when the chunk's callback fires */
+    struct aws_http_stream *stream;
+    aws_http1_stream_write_chunk_complete_fn *on_chunk_complete;
+    void *user_data;
+};
+
+static void s_zero_copy_message_complete_chunk(struct aws_h1_zero_copy_message *zero_copy_msg, int err_code) {
+    if (zero_copy_msg->on_chunk_complete) {
+        zero_copy_msg->on_chunk_complete(zero_copy_msg->stream, err_code, zero_copy_msg->user_data);
     }
+    aws_http_stream_release(zero_copy_msg->stream);
+}
 
-    struct aws_h1_connection *connection = arg;
-    AWS_ASSERT(connection->thread_data.is_outgoing_stream_task_active);
-    AWS_ASSERT(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+static void s_on_zero_copy_message_write_complete(
+    struct aws_channel *channel,
+    struct aws_io_message *message,
+    int err_code,
+    void *user_data) {
 
-    s_write_outgoing_stream(connection, false /*first_try*/);
+    struct aws_h1_zero_copy_message *zero_copy_msg = user_data;
+    struct aws_h1_connection *connection = zero_copy_msg->connection;
+
+    /* The message is released by whoever invoked this callback, once it returns */
+    s_zero_copy_message_complete_chunk(zero_copy_msg, err_code);
+    s_on_channel_write_complete(channel, message, err_code, connection);
 }
 
-void aws_h1_connection_try_write_outgoing_stream(struct aws_h1_connection *connection) {
-    AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+/* Send caller-owned memory as its own aws_io_message, without copying */
+static int s_send_zero_copy_message(
+    struct aws_h1_connection *connection,
+    struct aws_byte_cursor data,
+    aws_http1_stream_write_chunk_complete_fn *on_chunk_complete,
+    void *user_data) {
 
-    if (connection->thread_data.is_outgoing_stream_task_active) {
-        /* Task is already active */
-        return;
+    struct aws_h1_zero_copy_message *zero_copy_msg =
+        aws_mem_calloc(connection->base.alloc, 1, sizeof(struct aws_h1_zero_copy_message));
+
+    /* Releasing the message frees the whole struct, but not the memory it points to */
+    zero_copy_msg->base.allocator = connection->base.alloc;
+    zero_copy_msg->base.message_type = AWS_IO_MESSAGE_APPLICATION_DATA;
+    zero_copy_msg->base.message_data = aws_byte_buf_from_array(data.ptr, data.len);
+    zero_copy_msg->base.on_completion = s_on_zero_copy_message_write_complete;
+    zero_copy_msg->base.user_data = zero_copy_msg;
+    zero_copy_msg->connection = connection;
+    zero_copy_msg->stream = aws_http_stream_acquire(connection->thread_data.encoder.current_stream);
+    zero_copy_msg->on_chunk_complete = on_chunk_complete;
+    zero_copy_msg->user_data = user_data;
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Outgoing stream task is sending zero-copy message of size %zu.",
+        (void *)&connection->base,
+        data.len);
+
+    connection->thread_data.stats.bytes_written += data.len;
+    connection->thread_data.encoder.current_stream->metrics.bytes_sent += data.len;
+    if (aws_channel_slot_send_message(connection->base.channel_slot, &zero_copy_msg->base, AWS_CHANNEL_DIR_WRITE)) {
+        int error_code = aws_last_error();
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION,
+            "id=%p: Failed to send zero-copy message in write direction, error %d (%s). Closing connection.",
+            (void *)&connection->base,
+            error_code,
+            aws_error_name(error_code));
+
+        s_zero_copy_message_complete_chunk(zero_copy_msg, error_code);
+        aws_mem_release(zero_copy_msg->base.allocator, zero_copy_msg);
+        return aws_raise_error(error_code);
     }
 
-    connection->thread_data.is_outgoing_stream_task_active = true;
-    s_write_outgoing_stream(connection, true /*first_try*/);
+    return AWS_OP_SUCCESS;
 }
 
-/* Do the actual work of the outgoing-stream-task */
+/**
+ * Called after the encoder has filled part of an aws_io_message.
+ * Returns true if the next stream is ready to be encoded into the same message.
+ * Only messages that are already ready get coalesced, we never wait for more, so no message is delayed.
+ * Called from event-loop thread.
+ */
+static bool s_can_coalesce_next_outgoing_stream(struct aws_h1_connection *connection, const struct aws_byte_buf *dst) {
+    /* Encoder stopped mid-message: the buffer is full, or it's waiting on body data, chunks, or zero-copy data */
+    if (aws_h1_encoder_is_message_in_progress(&connection->thread_data.encoder)) {
+        return false;
+    }
+
+    if (dst->len == dst->capacity || connection->thread_data.is_writing_stopped) {
+        return false;
+    }
+
+    /* Finish the current stream and start the next, if its data is ready */
+    struct aws_h1_stream *next = s_update_outgoing_stream_ptr(connection);
+    return next && !aws_h1_encoder_is_waiting_for_chunks(&connection->thread_data.encoder);
+}
+
+void aws_h1_connection_enable_sendfile(struct aws_http_connection *connection_base, int socket_fd) {
+    struct aws_h1_connection *connection = AWS_CONTAINER_OF(connection_base, struct aws_h1_connection, base);
+#ifdef AWS_H1_HAS_SENDFILE
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_CONNECTION, "id=%p: File bodies will be sent directly to the socket.", (void *)&connection->base);
+    connection->sendfile_socket_fd = socket_fd;
+    connection->thread_data.encoder.sends_file_bodies_directly = true;
+#else
+    (void)connection;
+    (void)socket_fd;
+#endif
+}
+
+/**
+ * Send part of a body straight from a file to the socket.
+ * This only runs while no aws_io_message is in flight, so the socket has already written everything before the body.
+ * The socket handler owns the socket's writability events, so if the socket is full we try again after a delay,
+ * backing off while it stays full.
+ */
+static int s_send_file_body(struct aws_h1_connection *connection, int file_fd, uint64_t offset, uint64_t remaining) {
+#ifdef AWS_H1_HAS_SENDFILE
+    struct aws_channel *channel = connection->base.channel_slot->channel;
+
+    if (remaining == 0) {
+        /* The file range ended before the Content-Length did */
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION, "id=%p: File body is shorter than its Content-Length.", (void *)&connection->base);
+        return aws_raise_error(AWS_ERROR_HTTP_OUTGOING_STREAM_LENGTH_INCORRECT);
+    }
+
+    off_t file_offset = (off_t)offset;
+    size_t count = (size_t)aws_min_u64(remaining, SENDFILE_MAX_BYTES_PER_TICK);
+    ssize_t sent = sendfile(connection->sendfile_socket_fd, file_fd, &file_offset, count);
+    if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            int error_code =
+                (errno == EPIPE || errno == ECONNRESET) ? AWS_IO_SOCKET_CLOSED : AWS_ERROR_SYS_CALL_FAILURE;
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_CONNECTION,
+                "id=%p: Failed to send file body, errno %d. Closing connection.",
+                (void *)&connection->base,
+                errno);
+            return aws_raise_error(error_code);
+        }
+
+        /* Socket is full, try again later */
+        uint64_t *retry_delay_ns = &connection->thread_data.sendfile_retry_delay_ns;
+        *retry_delay_ns = *retry_delay_ns == 0 ? SENDFILE_RETRY_MIN_DELAY_NS
+                                               : aws_min_u64(*retry_delay_ns * 2, SENDFILE_RETRY_MAX_DELAY_NS);
+        uint64_t now_ns = 0;
+        aws_channel_current_clock_time(channel, &now_ns);
+        aws_channel_schedule_task_future(channel, &connection->outgoing_stream_task, now_ns + *retry_delay_ns);
+        return AWS_OP_SUCCESS;
+    }
+
+    if (sent == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION, "id=%p: File ended before its body was sent.", (void *)&connection->base);
+        return aws_raise_error(AWS_ERROR_HTTP_OUTGOING_STREAM_LENGTH_INCORRECT);
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_CONNECTION,
+        "id=%p: Outgoing stream task sent %zd bytes of file body directly to socket.",
+        (void *)&connection->base,
+        sent);
+
+    connection->thread_data.sendfile_retry_delay_ns = 0;
+    connection->thread_data.stats.bytes_written += (uint64_t)sent;
+    connection->thread_data.encoder.current_stream->metrics.bytes_sent += (uint64_t)sent;
+    aws_h1_encoder_on_file_body_sent(&connection->thread_data.encoder, (uint64_t)sent);
+
+    /* Nothing was written through the channel, so no write-complete callback will reschedule the task */
+    aws_channel_schedule_task_now(channel, &connection->outgoing_stream_task);
+    return AWS_OP_SUCCESS;
+#else
+    (void)connection;
+    (void)file_fd;
+    (void)offset;
+    (void)remaining;
+    /* The encoder only stops at file bodies after aws_h1_connection_enable_sendfile() */
+    AWS_FATAL_ASSERT(false);
+    return AWS_OP_ERR;
+#endif
+}
+
+static void s_outgoing_stream_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    if (status != AWS_TASK_STATUS_RUN_READY) {
+        return;
+    }
+
+    struct aws_h1_connection *connection = arg;
+    AWS_ASSERT(connection->thread_data.is_outgoing_stream_task_active);
+    AWS_ASSERT(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+
+    s_write_outgoing_stream(connection, false /*first_try*/);
+}
+
+void aws_h1_connection_try_write_outgoing_stream(struct aws_h1_connection *connection) {
+    AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+
+    if (connection->thread_data.is_outgoing_stream_task_active) {
+        /* Task is already active */
+        return;
+    }
+
+    connection->thread_data.is_outgoing_stream_task_active = true;
+    s_write_outgoing_stream(connection, true /*first_try*/);
+}
+
+/* An async body's read completed, see aws_http_async_body_stream_wait() */
+static void s_on_async_body_ready(void *user_data) {
+    struct aws_h1_connection *connection = user_data;
+    aws_h1_connection_try_write_outgoing_stream(connection);
+}
+
+/* Stop holding back the body of an "Expect: 100-continue" request, if it still is */
+static void s_end_wait_for_continue(
+    struct aws_h1_connection *connection,
+    struct aws_h1_stream *stream,
+    bool send_body) {
+    AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+
+    aws_http_timer_cancel(&stream->expect_continue_timer);
+    if (connection->thread_data.outgoing_stream != stream ||
+        !aws_h1_encoder_is_waiting_for_continue(&connection->thread_data.encoder)) {
+        return;
+    }
+
+    if (!send_body) {
+        /* The server may still expect the body, so this connection can't be used for anything else */
+        stream->is_final_stream = true;
+    }
+    aws_h1_encoder_end_wait_for_continue(&connection->thread_data.encoder, send_body);
+
+    /* Called from decoder callbacks too, so let the outgoing stream task do the rest later */
+    if (!connection->thread_data.is_outgoing_stream_task_active && !connection->thread_data.is_writing_stopped) {
+        connection->thread_data.is_outgoing_stream_task_active = true;
+        aws_channel_schedule_task_now(connection->base.channel_slot->channel, &connection->outgoing_stream_task);
+    }
+}
+
+/* Do the actual work of the outgoing-stream-task */
 static void s_write_outgoing_stream(struct aws_h1_connection *connection, bool first_try) {
     AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
     AWS_PRECONDITION(connection->thread_data.is_outgoing_stream_task_active);
@@ -1026,14 +1589,16 @@ static void s_write_outgoing_stream(struct aws_h1_connection *connection, bool f
      * The outgoing stream task will be kicked off again when user adds more data (new stream, new chunk, etc) */
     struct aws_h1_stream *outgoing_stream = s_update_outgoing_stream_ptr(connection);
     bool waiting_for_chunks = aws_h1_encoder_is_waiting_for_chunks(&connection->thread_data.encoder);
-    if (!outgoing_stream || waiting_for_chunks) {
+    bool waiting_for_continue = aws_h1_encoder_is_waiting_for_continue(&connection->thread_data.encoder);
+    if (!outgoing_stream || waiting_for_chunks || waiting_for_continue) {
         if (!first_try) {
             AWS_LOGF_TRACE(
                 AWS_LS_HTTP_CONNECTION,
-                "id=%p: Outgoing stream task stopped. outgoing_stream=%p waiting_for_chunks:%d",
+                "id=%p: Outgoing stream task stopped. outgoing_stream=%p waiting_for_chunks:%d waiting_for_continue:%d",
                 (void *)&connection->base,
                 outgoing_stream ? (void *)&outgoing_stream->base : NULL,
-                waiting_for_chunks);
+                waiting_for_chunks,
+                waiting_for_continue);
         }
         connection->thread_data.is_outgoing_stream_task_active = false;
         return;
@@ -1043,7 +1608,33 @@ static void s_write_outgoing_stream(struct aws_h1_connection *connection, bool f
         AWS_LOGF_TRACE(AWS_LS_HTTP_CONNECTION, "id=%p: Outgoing stream task has begun.", (void *)&connection->base);
     }
 
-    struct aws_io_message *msg = aws_channel_slot_acquire_max_message_for_write(connection->base.channel_slot);
+    struct aws_io_message *msg = NULL;
+
+    /* If the encoder has reached caller-owned data, it goes in its own message instead of being copied */
+    struct aws_byte_cursor zero_copy_data;
+    aws_http1_stream_write_chunk_complete_fn *on_chunk_complete = NULL;
+    void *chunk_user_data = NULL;
+    if (aws_h1_encoder_take_zero_copy_data(
+            &connection->thread_data.encoder, &zero_copy_data, &on_chunk_complete, &chunk_user_data)) {
+
+        if (s_send_zero_copy_message(connection, zero_copy_data, on_chunk_complete, chunk_user_data)) {
+            goto error;
+        }
+        return;
+    }
+
+    /* If the encoder has reached a file body, it goes straight from the file to the socket */
+    int file_fd;
+    uint64_t file_offset;
+    uint64_t file_remaining;
+    if (aws_h1_encoder_get_file_body(&connection->thread_data.encoder, &file_fd, &file_offset, &file_remaining)) {
+        if (s_send_file_body(connection, file_fd, file_offset, file_remaining)) {
+            goto error;
+        }
+        return;
+    }
+
+    msg = aws_channel_slot_acquire_max_message_for_write(connection->base.channel_slot);
     if (!msg) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_CONNECTION,
@@ -1067,6 +1658,23 @@ static void s_write_outgoing_stream(struct aws_h1_connection *connection, bool f
         goto error;
     }
 
+    /* If there's room, keep filling the message from the streams queued behind this one,
+     * so pipelined messages share an aws_io_message instead of paying for one each. */
+    while (s_can_coalesce_next_outgoing_stream(connection, &msg->message_data)) {
+        if (AWS_OP_SUCCESS != aws_h1_encoder_process(&connection->thread_data.encoder, &msg->message_data)) {
+            goto error;
+        }
+    }
+
+    /* If the head of an "Expect: 100-continue" request just went out, don't wait forever for the server's answer */
+    if (aws_h1_encoder_is_waiting_for_continue(&connection->thread_data.encoder)) {
+        struct aws_http_timer *timer = &connection->thread_data.outgoing_stream->expect_continue_timer;
+        if (!aws_http_timer_is_armed(timer) &&
+            s_arm_stream_timer(connection, timer, connection->expect_continue_timeout_ms)) {
+            goto error;
+        }
+    }
+
     if (msg->message_data.len > 0) {
         AWS_LOGF_TRACE(
             AWS_LS_HTTP_CONNECTION,
@@ -1074,6 +1682,7 @@ static void s_write_outgoing_stream(struct aws_h1_connection *connection, bool f
             (void *)&connection->base,
             msg->message_data.len);
 
+        connection->thread_data.stats.bytes_written += msg->message_data.len;
         if (aws_channel_slot_send_message(connection->base.channel_slot, msg, AWS_CHANNEL_DIR_WRITE)) {
             AWS_LOGF_ERROR(
                 AWS_LS_HTTP_CONNECTION,
@@ -1086,7 +1695,25 @@ static void s_write_outgoing_stream(struct aws_h1_connection *connection, bool f
         }
 
     } else {
-        /* If message is empty, warn that no work is being done
+        aws_mem_release(msg->allocator, msg);
+
+        /* If the body is an async stream whose read is still in progress,
+         * stop the task and resume it once the read completes, instead of polling */
+        struct aws_h1_encoder_message *encoder_message = connection->thread_data.encoder.message;
+        if (encoder_message != NULL &&
+            aws_http_async_body_stream_wait(
+                encoder_message->body, connection->base.channel_slot->channel, s_on_async_body_ready, connection)) {
+
+            AWS_LOGF_TRACE(
+                AWS_LS_HTTP_CONNECTION,
+                "id=%p: Outgoing stream task stopped, waiting on async body of stream %p.",
+                (void *)&connection->base,
+                (void *)&outgoing_stream->base);
+            connection->thread_data.is_outgoing_stream_task_active = false;
+            return;
+        }
+
+        /* Otherwise, warn that no work is being done
          * and reschedule the task to try again next tick.
          * It's likely that body isn't ready, so body streaming function has no data to write yet.
          * If this scenario turns out to be common we should implement a "pause" feature. */
@@ -1096,8 +1723,6 @@ static void s_write_outgoing_stream(struct aws_h1_connection *connection, bool f
             (void *)&connection->base,
             outgoing_stream ? (void *)&outgoing_stream->base : NULL);
 
-        aws_mem_release(msg->allocator, msg);
-
         aws_channel_schedule_task_now(connection->base.channel_slot->channel, &connection->outgoing_stream_task);
     }
 
@@ -1185,8 +1810,10 @@ static int s_decoder_on_response(int status_code, void *user_data) {
     return AWS_OP_SUCCESS;
 }
 
-static int s_decoder_on_header(const struct aws_h1_decoded_header *header, void *user_data) {
-    struct aws_h1_connection *connection = user_data;
+/* Act on a decoded header, before it's delivered to the user */
+static void s_process_incoming_header(
+    struct aws_h1_connection *connection,
+    const struct aws_h1_decoded_header *header) {
     struct aws_h1_stream *incoming_stream = connection->thread_data.incoming_stream;
 
     AWS_LOGF_TRACE(
@@ -1196,9 +1823,6 @@ static int s_decoder_on_header(const struct aws_h1_decoded_header *header, void
         AWS_BYTE_CURSOR_PRI(header->name_data),
         AWS_BYTE_CURSOR_PRI(header->value_data));
 
-    enum aws_http_header_block header_block =
-        aws_h1_decoder_get_header_block(connection->thread_data.incoming_stream_decoder);
-
     /* RFC-7230 section 6.1.
      * "Connection: close" header signals that a connection will not persist after the current request/response */
     if (header->name == AWS_HTTP_HEADER_CONNECTION) {
@@ -1218,7 +1842,7 @@ static int s_decoder_on_header(const struct aws_h1_decoded_header *header, void
             incoming_stream->is_final_stream = true;
             { /* BEGIN CRITICAL SECTION */
                 aws_h1_connection_lock_synced_data(connection);
-                connection->synced_data.new_stream_error_code = AWS_ERROR_HTTP_CONNECTION_CLOSED;
+                aws_atomic_store_int(&connection->new_stream_error_code, AWS_ERROR_HTTP_CONNECTION_CLOSED);
                 aws_h1_connection_unlock_synced_data(connection);
             } /* END CRITICAL SECTION */
 
@@ -1250,15 +1874,89 @@ static int s_decoder_on_header(const struct aws_h1_decoded_header *header, void
             }
         }
     }
+}
 
-    if (incoming_stream->base.on_incoming_headers) {
-        struct aws_http_header deliver = {
-            .name = header->name_data,
-            .value = header->value_data,
+/* Collect the main header block's Content-Encoding values, comma-separated if there's more than one header */
+static int s_append_content_coding(struct aws_h1_stream *incoming_stream, struct aws_byte_cursor value) {
+    struct aws_byte_buf *content_coding = &incoming_stream->incoming_content_coding;
+    if (!content_coding->allocator) {
+        if (aws_byte_buf_init(content_coding, incoming_stream->base.alloc, value.len)) {
+            return AWS_OP_ERR;
+        }
+    } else {
+        struct aws_byte_cursor separator = aws_byte_cursor_from_c_str(", ");
+        if (aws_byte_buf_append_dynamic(content_coding, &separator)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return aws_byte_buf_append_dynamic(content_coding, &value);
+}
+
+/* Let the user create a decoder for the body, if the main header block had a Content-Encoding */
+static int s_create_content_decoder(struct aws_h1_stream *incoming_stream) {
+    if (incoming_stream->incoming_content_coding.len == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_byte_cursor content_coding = aws_byte_cursor_from_buf(&incoming_stream->incoming_content_coding);
+    if (incoming_stream->content_decoding.new_decoder(
+            incoming_stream->base.alloc,
+            content_coding,
+            incoming_stream->content_decoding.user_data,
+            &incoming_stream->content_decoder)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM,
+            "id=%p: Failed to create decoder for Content-Encoding '" PRInSTR "', error %d (%s).",
+            (void *)&incoming_stream->base,
+            AWS_BYTE_CURSOR_PRI(content_coding),
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_STREAM,
+        "id=%p: Content-Encoding '" PRInSTR "' will be %s.",
+        (void *)&incoming_stream->base,
+        AWS_BYTE_CURSOR_PRI(content_coding),
+        incoming_stream->content_decoder ? "decoded" : "passed along as-is");
+    return AWS_OP_SUCCESS;
+}
+
+static int s_decoder_on_headers_batch(
+    const struct aws_h1_decoded_header *headers,
+    size_t num_headers,
+    void *user_data) {
+    struct aws_h1_connection *connection = user_data;
+    struct aws_h1_stream *incoming_stream = connection->thread_data.incoming_stream;
+    struct aws_array_list *deliver = &connection->thread_data.incoming_headers_batch;
+
+    enum aws_http_header_block header_block =
+        aws_h1_decoder_get_header_block(connection->thread_data.incoming_stream_decoder);
+
+    aws_array_list_clear(deliver);
+    for (size_t i = 0; i < num_headers; ++i) {
+        s_process_incoming_header(connection, &headers[i]);
+
+        if (headers[i].name == AWS_HTTP_HEADER_CONTENT_ENCODING && header_block == AWS_HTTP_HEADER_BLOCK_MAIN &&
+            incoming_stream->content_decoding.new_decoder) {
+            if (s_append_content_coding(incoming_stream, headers[i].value_data)) {
+                return AWS_OP_ERR;
+            }
+        }
+
+        struct aws_http_header header = {
+            .name = headers[i].name_data,
+            .value = headers[i].value_data,
         };
+        if (aws_array_list_push_back(deliver, &header)) {
+            return AWS_OP_ERR;
+        }
+    }
 
+    if (incoming_stream->base.on_incoming_headers) {
         int err = incoming_stream->base.on_incoming_headers(
-            &incoming_stream->base, header_block, &deliver, 1, incoming_stream->base.user_data);
+            &incoming_stream->base, header_block, deliver->data, num_headers, incoming_stream->base.user_data);
 
         if (err) {
             AWS_LOGF_ERROR(
@@ -1286,11 +1984,30 @@ static int s_mark_head_done(struct aws_h1_stream *incoming_stream) {
 
     enum aws_http_header_block header_block =
         aws_h1_decoder_get_header_block(connection->thread_data.incoming_stream_decoder);
+    AWS_HTTP_PROBE3(header__block__done, &incoming_stream->base, header_block, 0 /*is_http2*/);
 
     if (header_block == AWS_HTTP_HEADER_BLOCK_MAIN) {
         AWS_LOGF_TRACE(AWS_LS_HTTP_STREAM, "id=%p: Main header block done.", (void *)&incoming_stream->base);
         incoming_stream->is_incoming_head_done = true;
 
+        /* A final response to an "Expect: 100-continue" request means the server doesn't want the body */
+        if (incoming_stream->base.client_data) {
+            s_end_wait_for_continue(connection, incoming_stream, false /*send_body*/);
+        }
+
+        struct aws_http_stream_metrics *metrics = &incoming_stream->base.metrics;
+        metrics->header_bytes_received = aws_h1_decoder_get_head_bytes(connection->thread_data.incoming_stream_decoder);
+        metrics->header_bytes_received_encoded = metrics->header_bytes_received;
+        if (incoming_stream->base.client_data && metrics->send_start_timestamp_ns != -1) {
+            uint64_t now_ns = 0;
+            aws_high_res_clock_get_ticks(&now_ns);
+            metrics->time_to_headers_done_ns = (int64_t)now_ns - metrics->send_start_timestamp_ns;
+        }
+
+        if (s_create_content_decoder(incoming_stream)) {
+            return AWS_OP_ERR;
+        }
+
     } else if (header_block == AWS_HTTP_HEADER_BLOCK_INFORMATIONAL) {
         AWS_LOGF_TRACE(AWS_LS_HTTP_STREAM, "id=%p: Informational header block done.", (void *)&incoming_stream->base);
 
@@ -1300,6 +2017,8 @@ static int s_mark_head_done(struct aws_h1_stream *incoming_stream) {
             if (s_aws_http1_switch_protocols(connection)) {
                 return AWS_OP_ERR;
             }
+        } else if (incoming_stream->base.client_data->response_status == AWS_HTTP_STATUS_CODE_100_CONTINUE) {
+            s_end_wait_for_continue(connection, incoming_stream, true /*send_body*/);
         }
     }
 
@@ -1322,37 +2041,32 @@ static int s_mark_head_done(struct aws_h1_stream *incoming_stream) {
     return AWS_OP_SUCCESS;
 }
 
-static int s_decoder_on_body(const struct aws_byte_cursor *data, bool finished, void *user_data) {
-    (void)finished;
-
-    struct aws_h1_connection *connection = user_data;
-    struct aws_h1_stream *incoming_stream = connection->thread_data.incoming_stream;
-    AWS_ASSERT(incoming_stream);
-
-    int err = s_mark_head_done(incoming_stream);
-    if (err) {
-        return AWS_OP_ERR;
-    }
-
-    /* No need to invoke callback for 0-length data */
-    if (data->len == 0) {
-        return AWS_OP_SUCCESS;
-    }
-
-    AWS_LOGF_TRACE(
-        AWS_LS_HTTP_STREAM, "id=%p: Incoming body: %zu bytes received.", (void *)&incoming_stream->base, data->len);
+/* Let the stream's window shrink by the amount of body data, and pass the data to the user */
+static int s_deliver_incoming_body(
+    struct aws_h1_connection *connection,
+    struct aws_h1_stream *incoming_stream,
+    const struct aws_byte_cursor *data) {
 
     if (connection->base.stream_manual_window_management) {
         /* Let stream window shrink by amount of body data received */
         if (data->len > incoming_stream->thread_data.stream_window) {
-            /* This error shouldn't be possible, but it's all complicated, so do runtime check to be safe. */
-            AWS_LOGF_ERROR(
-                AWS_LS_HTTP_STREAM,
-                "id=%p: Internal error. Data exceeds HTTP-stream's window.",
-                (void *)&incoming_stream->base);
-            return aws_raise_error(AWS_ERROR_INVALID_STATE);
+            if (!incoming_stream->content_decoder) {
+                /* This error shouldn't be possible, but it's all complicated, so do runtime check to be safe. */
+                AWS_LOGF_ERROR(
+                    AWS_LS_HTTP_STREAM,
+                    "id=%p: Internal error. Data exceeds HTTP-stream's window.",
+                    (void *)&incoming_stream->base);
+                return aws_raise_error(AWS_ERROR_INVALID_STATE);
+            }
+
+            /* Encoded data can decode to more than the window. The excess is deducted from later window updates */
+            incoming_stream->thread_data.stream_window_debt = aws_add_u64_saturating(
+                incoming_stream->thread_data.stream_window_debt,
+                data->len - incoming_stream->thread_data.stream_window);
+            incoming_stream->thread_data.stream_window = 0;
+        } else {
+            incoming_stream->thread_data.stream_window -= data->len;
         }
-        incoming_stream->thread_data.stream_window -= data->len;
 
         if (incoming_stream->thread_data.stream_window == 0) {
             AWS_LOGF_DEBUG(
@@ -1363,7 +2077,8 @@ static int s_decoder_on_body(const struct aws_byte_cursor *data, bool finished,
     }
 
     if (incoming_stream->base.on_incoming_body) {
-        err = incoming_stream->base.on_incoming_body(&incoming_stream->base, data, incoming_stream->base.user_data);
+        int err =
+            incoming_stream->base.on_incoming_body(&incoming_stream->base, data, incoming_stream->base.user_data);
         if (err) {
             AWS_LOGF_ERROR(
                 AWS_LS_HTTP_STREAM,
@@ -1379,6 +2094,105 @@ static int s_decoder_on_body(const struct aws_byte_cursor *data, bool finished,
     return AWS_OP_SUCCESS;
 }
 
+/* Run encoded body data through the stream's content decoder, delivering output one buffer-full at a time.
+ * Pass empty input to collect whatever output the decoder is still holding. */
+static int s_decode_incoming_body(
+    struct aws_h1_connection *connection,
+    struct aws_h1_stream *incoming_stream,
+    struct aws_byte_cursor input) {
+
+    struct aws_http_content_decoder *decoder = incoming_stream->content_decoder;
+    struct aws_byte_buf *output = &connection->thread_data.content_decode_buffer;
+    if (!output->allocator) {
+        if (aws_byte_buf_init(output, connection->base.alloc, CONTENT_DECODE_BUFFER_SIZE)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    do {
+        const size_t prev_input_len = input.len;
+        aws_byte_buf_reset(output, false /*zero_contents*/);
+
+        if (decoder->vtable->decode(decoder, &input, output)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_STREAM,
+                "id=%p: Content decoder failed, error %d (%s).",
+                (void *)&incoming_stream->base,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            return AWS_OP_ERR;
+        }
+
+        if (output->len == 0 && input.len == prev_input_len && input.len > 0) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_STREAM, "id=%p: Content decoder made no progress.", (void *)&incoming_stream->base);
+            return aws_raise_error(AWS_ERROR_HTTP_CONTENT_DECODING_FAILED);
+        }
+
+        if (output->len > 0) {
+            struct aws_byte_cursor decoded = aws_byte_cursor_from_buf(output);
+            if (s_deliver_incoming_body(connection, incoming_stream, &decoded)) {
+                return AWS_OP_ERR;
+            }
+        }
+    } while (input.len > 0 || output->len == output->capacity);
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Decode whatever the decoder is still holding, and check that the encoded body was complete */
+static int s_finish_content_decoder(struct aws_h1_connection *connection, struct aws_h1_stream *incoming_stream) {
+    if (!incoming_stream->content_decoder || !incoming_stream->has_content_decoder_input) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_byte_cursor no_input;
+    AWS_ZERO_STRUCT(no_input);
+    if (s_decode_incoming_body(connection, incoming_stream, no_input)) {
+        return AWS_OP_ERR;
+    }
+
+    if (incoming_stream->content_decoder->vtable->finish(incoming_stream->content_decoder)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM,
+            "id=%p: Encoded body is incomplete, error %d (%s).",
+            (void *)&incoming_stream->base,
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_decoder_on_body(const struct aws_byte_cursor *data, bool finished, void *user_data) {
+    (void)finished;
+
+    struct aws_h1_connection *connection = user_data;
+    struct aws_h1_stream *incoming_stream = connection->thread_data.incoming_stream;
+    AWS_ASSERT(incoming_stream);
+
+    int err = s_mark_head_done(incoming_stream);
+    if (err) {
+        return AWS_OP_ERR;
+    }
+
+    /* No need to invoke callback for 0-length data */
+    if (data->len == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_STREAM, "id=%p: Incoming body: %zu bytes received.", (void *)&incoming_stream->base, data->len);
+
+    if (incoming_stream->content_decoder) {
+        incoming_stream->has_content_decoder_input = true;
+        return s_decode_incoming_body(connection, incoming_stream, *data);
+    }
+
+    return s_deliver_incoming_body(connection, incoming_stream, data);
+}
+
 static int s_decoder_on_done(void *user_data) {
     struct aws_h1_connection *connection = user_data;
     struct aws_h1_stream *incoming_stream = connection->thread_data.incoming_stream;
@@ -1389,6 +2203,9 @@ static int s_decoder_on_done(void *user_data) {
     if (err) {
         return AWS_OP_ERR;
     }
+    incoming_stream->base.metrics.bytes_received +=
+        aws_h1_decoder_get_message_bytes(connection->thread_data.incoming_stream_decoder);
+
     /* If it is a informational response, we stop here, keep waiting for new response */
     enum aws_http_header_block header_block =
         aws_h1_decoder_get_header_block(connection->thread_data.incoming_stream_decoder);
@@ -1396,6 +2213,10 @@ static int s_decoder_on_done(void *user_data) {
         return AWS_OP_SUCCESS;
     }
 
+    if (s_finish_content_decoder(connection, incoming_stream)) {
+        return AWS_OP_ERR;
+    }
+
     /* Otherwise the incoming stream is finished decoding and we will update it if needed */
     incoming_stream->is_incoming_message_done = true;
     aws_high_res_clock_get_ticks((uint64_t *)&incoming_stream->base.metrics.receive_end_timestamp_ns);
@@ -1446,6 +2267,13 @@ static int s_decoder_on_done(void *user_data) {
         s_stream_complete(incoming_stream, AWS_ERROR_SUCCESS);
 
         s_client_update_incoming_stream_ptr(connection);
+
+        /* A request held back by the pipeline limit may go now */
+        if (connection->max_pipeline_depth && !connection->thread_data.is_outgoing_stream_task_active &&
+            !connection->thread_data.is_writing_stopped) {
+            connection->thread_data.is_outgoing_stream_task_active = true;
+            aws_channel_schedule_task_now(connection->base.channel_slot->channel, &connection->outgoing_stream_task);
+        }
     }
 
     /* Report success even if user's on_complete() callback shuts down on the connection.
@@ -1481,6 +2309,7 @@ static struct aws_h1_connection *s_connection_new(
 
     /* 1 refcount for user */
     aws_atomic_init_int(&connection->base.refcount, 1);
+    aws_atomic_init_int(&connection->base.health_score, AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX);
 
     if (manual_window_management) {
         connection->initial_stream_window_size = initial_window_size;
@@ -1497,13 +2326,32 @@ static struct aws_h1_connection *s_connection_new(
         }
 
         connection->thread_data.connection_window = connection->thread_data.read_buffer.capacity;
+        connection->thread_data.read_buffer.min_capacity = connection->thread_data.read_buffer.capacity;
+        connection->thread_data.read_buffer.max_capacity =
+            aws_max_size(connection->thread_data.read_buffer.capacity, http1_options->read_buffer_max_capacity);
     } else {
         /* No backpressure, keep connection window at SIZE_MAX */
         connection->initial_stream_window_size = SIZE_MAX;
         connection->thread_data.read_buffer.capacity = SIZE_MAX;
+        connection->thread_data.read_buffer.min_capacity = SIZE_MAX;
+        connection->thread_data.read_buffer.max_capacity = SIZE_MAX;
         connection->thread_data.connection_window = SIZE_MAX;
     }
 
+    if (server) {
+        connection->idle_timeout_ms = http1_options->idle_timeout_ms;
+        connection->max_requests = http1_options->max_requests;
+        aws_http_timer_init(&connection->thread_data.idle_timer, s_server_on_idle_timeout, connection);
+    } else {
+        connection->max_pipeline_depth = http1_options->max_pipeline_depth;
+        connection->expect_continue_threshold = http1_options->expect_continue_threshold;
+        connection->expect_continue_timeout_ms = http1_options->expect_continue_timeout_ms
+                                                     ? http1_options->expect_continue_timeout_ms
+                                                     : AWS_HTTP1_DEFAULT_EXPECT_CONTINUE_TIMEOUT_MS;
+    }
+
+    connection->sendfile_socket_fd = -1;
+
     aws_h1_encoder_init(&connection->thread_data.encoder, alloc);
 
     aws_channel_task_init(
@@ -1513,8 +2361,14 @@ static struct aws_h1_connection *s_connection_new(
         s_cross_thread_work_task,
         connection,
         "http1_connection_cross_thread_work");
+    aws_task_init(
+        &connection->body_ref_release_task, s_body_ref_release_task, connection, "http1_connection_body_ref_release");
+    aws_channel_task_init(
+        &connection->memory_budget_task, s_memory_budget_task, connection, "http1_connection_memory_budget");
+    aws_http_memory_budget_waiter_init(&connection->memory_budget_waiter, s_on_memory_budget_available, connection);
     aws_linked_list_init(&connection->thread_data.stream_list);
     aws_linked_list_init(&connection->thread_data.read_buffer.messages);
+    aws_linked_list_init(&connection->synced_data.released_body_refs);
     aws_crt_statistics_http1_channel_init(&connection->thread_data.stats);
 
     int err = aws_mutex_init(&connection->synced_data.lock);
@@ -1528,7 +2382,19 @@ static struct aws_h1_connection *s_connection_new(
         goto error_mutex;
     }
 
-    aws_linked_list_init(&connection->synced_data.new_client_stream_list);
+    if (aws_h1_chunk_pool_init(&connection->chunk_pool, alloc, CHUNK_POOL_MAX_FREE)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION,
+            "static: Failed to initialize chunk pool, error %d (%s).",
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+
+        goto error_chunk_pool;
+    }
+
+    aws_http_mpsc_queue_init(&connection->new_client_stream_queue);
+    aws_atomic_init_int(&connection->next_client_stream_id, 1);
+    aws_atomic_init_int(&connection->new_stream_error_code, 0);
     connection->synced_data.is_open = true;
 
     struct aws_h1_decoder_params options = {
@@ -1549,9 +2415,24 @@ static struct aws_h1_connection *s_connection_new(
         goto error_decoder;
     }
 
+    if (aws_array_list_init_dynamic(
+            &connection->thread_data.incoming_headers_batch, alloc, 0, sizeof(struct aws_http_header))) {
+        goto error_headers_batch;
+    }
+
+    if (manual_window_management && http1_options->memory_budget) {
+        /* The window opens once the connection is installed and can draw from the budget */
+        connection->memory_budget = aws_http_memory_budget_acquire(http1_options->memory_budget);
+        connection->thread_data.connection_window = 0;
+    }
+
     return connection;
 
+error_headers_batch:
+    aws_h1_decoder_destroy(connection->thread_data.incoming_stream_decoder);
 error_decoder:
+    aws_h1_chunk_pool_clean_up(&connection->chunk_pool);
+error_chunk_pool:
     aws_mutex_clean_up(&connection->synced_data.lock);
 error_mutex:
     aws_mem_release(alloc, connection);
@@ -1599,7 +2480,8 @@ static void s_handler_destroy(struct aws_channel_handler *handler) {
     AWS_LOGF_TRACE(AWS_LS_HTTP_CONNECTION, "id=%p: Destroying connection.", (void *)&connection->base);
 
     AWS_ASSERT(aws_linked_list_empty(&connection->thread_data.stream_list));
-    AWS_ASSERT(aws_linked_list_empty(&connection->synced_data.new_client_stream_list));
+    AWS_ASSERT(aws_http_mpsc_queue_is_empty(&connection->new_client_stream_queue));
+    AWS_ASSERT(!connection->thread_data.is_waiting_for_memory_budget);
 
     /* Clean up any buffered read messages. */
     while (!aws_linked_list_empty(&connection->thread_data.read_buffer.messages)) {
@@ -1609,8 +2491,15 @@ static void s_handler_destroy(struct aws_channel_handler *handler) {
     }
 
     aws_h1_decoder_destroy(connection->thread_data.incoming_stream_decoder);
+    aws_array_list_clean_up(&connection->thread_data.incoming_headers_batch);
+    aws_byte_buf_clean_up(&connection->thread_data.content_decode_buffer);
     aws_h1_encoder_clean_up(&connection->thread_data.encoder);
+    aws_h1_chunk_pool_clean_up(&connection->chunk_pool);
     aws_mutex_clean_up(&connection->synced_data.lock);
+    if (connection->memory_budget) {
+        aws_http_memory_budget_give_back(connection->memory_budget, connection->thread_data.memory_budget_drawn);
+        aws_http_memory_budget_release(connection->memory_budget);
+    }
     aws_mem_release(connection->base.alloc, connection);
 }
 
@@ -1621,6 +2510,212 @@ static void s_handler_installed(struct aws_channel_handler *handler, struct aws_
     /* Acquire a hold on the channel to prevent its destruction until the user has
      * given the go-ahead via aws_http_connection_release() */
     aws_channel_acquire_hold(slot->channel);
+
+    if (connection->memory_budget && s_update_connection_window(connection)) {
+        s_shutdown_due_to_error(connection, aws_last_error());
+    }
+
+    s_server_update_idle_timer(connection);
+}
+
+/* Body data a user has kept alive with aws_http1_stream_retain_incoming_body() */
+struct aws_http1_incoming_body_ref {
+    struct aws_h1_connection *connection;
+
+    /* Message the data is in. NULL if the data was copied into `copy` instead */
+    struct aws_io_message *message;
+    struct aws_byte_buf copy;
+
+    /* Bytes counted against the connection window until this is freed. Only touched on the event-loop thread */
+    size_t window_bytes;
+
+    /* The members below are protected by the connection's lock */
+    size_t ref_count;
+
+    /* True once the connection is done with `message`, and leaves this to free it */
+    bool owns_message;
+
+    /* For connection's synced_data.released_body_refs */
+    struct aws_linked_list_node node;
+};
+
+struct aws_http1_incoming_body_ref *aws_h1_connection_retain_incoming_body(
+    struct aws_h1_connection *connection,
+    struct aws_h1_stream *stream,
+    struct aws_byte_cursor *data) {
+
+    struct aws_channel *channel = connection->base.channel_slot->channel;
+    struct aws_io_message *message = connection->thread_data.decoding_message;
+    if (!aws_channel_thread_is_callers_thread(channel) || !message ||
+        connection->thread_data.incoming_stream != stream) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM,
+            "id=%p: Incoming body can only be retained from within the on_incoming_body callback.",
+            (void *)&stream->base);
+        aws_raise_error(AWS_ERROR_INVALID_STATE);
+        return NULL;
+    }
+
+    const uint8_t *message_begin = message->message_data.buffer;
+    const uint8_t *message_end = message_begin + message->message_data.len;
+    const bool is_in_message = data->ptr >= message_begin && data->len <= (size_t)(message_end - data->ptr);
+
+    struct aws_http1_incoming_body_ref *ref = NULL;
+    if (is_in_message && connection->thread_data.is_decoding_message_retained) {
+        /* BEGIN CRITICAL SECTION */
+        aws_h1_connection_lock_synced_data(connection);
+        ref = connection->synced_data.decoding_message_ref;
+        if (ref) {
+            ++ref->ref_count;
+        }
+        aws_h1_connection_unlock_synced_data(connection);
+        /* END CRITICAL SECTION */
+    }
+
+    if (!ref) {
+        ref = aws_mem_calloc(connection->base.alloc, 1, sizeof(struct aws_http1_incoming_body_ref));
+        ref->connection = connection;
+        ref->ref_count = 1;
+
+        if (is_in_message) {
+            ref->message = message;
+            connection->thread_data.is_decoding_message_retained = true;
+
+            /* BEGIN CRITICAL SECTION */
+            aws_h1_connection_lock_synced_data(connection);
+            connection->synced_data.decoding_message_ref = ref;
+            aws_h1_connection_unlock_synced_data(connection);
+            /* END CRITICAL SECTION */
+        } else {
+            if (aws_byte_buf_init_copy_from_cursor(&ref->copy, connection->base.alloc, *data)) {
+                aws_mem_release(connection->base.alloc, ref);
+                return NULL;
+            }
+            *data = aws_byte_cursor_from_buf(&ref->copy);
+        }
+
+        /* Keep the channel, and therefore the connection, alive until the ref is freed */
+        aws_channel_acquire_hold(channel);
+    }
+
+    ref->window_bytes += data->len;
+    connection->thread_data.retained_body_bytes += data->len;
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_STREAM,
+        "id=%p: Retained %zu bytes of incoming body%s.",
+        (void *)&stream->base,
+        data->len,
+        is_in_message ? "" : " by copying");
+
+    return ref;
+}
+
+void aws_http1_incoming_body_ref_release(struct aws_http1_incoming_body_ref *ref) {
+    if (!ref) {
+        return;
+    }
+
+    struct aws_h1_connection *connection = ref->connection;
+    bool should_schedule_task = false;
+
+    /* BEGIN CRITICAL SECTION */
+    aws_h1_connection_lock_synced_data(connection);
+
+    AWS_FATAL_ASSERT(ref->ref_count > 0);
+    if (--ref->ref_count == 0) {
+        if (connection->synced_data.decoding_message_ref == ref) {
+            /* Connection is still decoding the message, it will free the message itself */
+            connection->synced_data.decoding_message_ref = NULL;
+        }
+
+        aws_linked_list_push_back(&connection->synced_data.released_body_refs, &ref->node);
+        if (!connection->synced_data.is_body_ref_release_task_scheduled) {
+            connection->synced_data.is_body_ref_release_task_scheduled = true;
+            should_schedule_task = true;
+        }
+    }
+
+    aws_h1_connection_unlock_synced_data(connection);
+    /* END CRITICAL SECTION */
+
+    if (should_schedule_task) {
+        AWS_LOGF_TRACE(
+            AWS_LS_HTTP_CONNECTION, "id=%p: Scheduling task to free released body data.", (void *)&connection->base);
+        aws_event_loop_schedule_task_now(
+            aws_channel_get_event_loop(connection->base.channel_slot->channel), &connection->body_ref_release_task);
+    }
+}
+
+static void s_body_ref_release_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_h1_connection *connection = arg;
+    struct aws_channel *channel = connection->base.channel_slot->channel;
+
+    struct aws_linked_list released;
+    aws_linked_list_init(&released);
+
+    /* BEGIN CRITICAL SECTION */
+    aws_h1_connection_lock_synced_data(connection);
+    connection->synced_data.is_body_ref_release_task_scheduled = false;
+    aws_linked_list_swap_contents(&released, &connection->synced_data.released_body_refs);
+    aws_h1_connection_unlock_synced_data(connection);
+    /* END CRITICAL SECTION */
+
+    size_t num_holds = 0;
+    while (!aws_linked_list_empty(&released)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&released);
+        struct aws_http1_incoming_body_ref *ref = AWS_CONTAINER_OF(node, struct aws_http1_incoming_body_ref, node);
+
+        if (ref->owns_message) {
+            aws_mem_release(ref->message->allocator, ref->message);
+        }
+        aws_byte_buf_clean_up(&ref->copy);
+
+        AWS_ASSERT(connection->thread_data.retained_body_bytes >= ref->window_bytes);
+        connection->thread_data.retained_body_bytes -= ref->window_bytes;
+
+        aws_mem_release(connection->base.alloc, ref);
+        ++num_holds;
+    }
+
+    /* Freed bytes no longer count against the connection window */
+    if (status == AWS_TASK_STATUS_RUN_READY && s_update_connection_window(connection)) {
+        s_shutdown_due_to_error(connection, aws_last_error());
+    }
+
+    /* Releasing the last hold may destroy the connection, so this must come last */
+    for (size_t i = 0; i < num_holds; ++i) {
+        aws_channel_release_hold(channel);
+    }
+}
+
+/* Remove a queued read message the connection is done with, and free it unless body data from it is retained */
+static void s_remove_processed_read_message(struct aws_h1_connection *connection, struct aws_io_message *message) {
+    aws_linked_list_remove(&message->queueing_handle);
+
+    if (connection->thread_data.is_decoding_message_retained) {
+        connection->thread_data.is_decoding_message_retained = false;
+
+        struct aws_http1_incoming_body_ref *ref = NULL;
+
+        /* BEGIN CRITICAL SECTION */
+        aws_h1_connection_lock_synced_data(connection);
+        ref = connection->synced_data.decoding_message_ref;
+        if (ref) {
+            AWS_ASSERT(ref->message == message);
+            ref->owns_message = true;
+            connection->synced_data.decoding_message_ref = NULL;
+        }
+        aws_h1_connection_unlock_synced_data(connection);
+        /* END CRITICAL SECTION */
+
+        if (ref) {
+            return;
+        }
+    }
+
+    aws_mem_release(message->allocator, message);
 }
 
 /* Try to send the next queued aws_io_message to the downstream handler.
@@ -1686,8 +2781,7 @@ static int s_try_process_next_midchannel_read_message(struct aws_h1_connection *
 
         /* If the last of queued_msg has been copied, it can be deleted now. */
         if (queued_msg->copy_mark == queued_msg->message_data.len) {
-            aws_linked_list_remove(queued_msg_node);
-            aws_mem_release(queued_msg->allocator, queued_msg);
+            s_remove_processed_read_message(connection, queued_msg);
         }
     } else {
         /* Sending all of queued_msg along. */
@@ -1773,6 +2867,36 @@ static struct aws_http_stream *s_new_server_request_handler_stream(
     return &stream->base;
 }
 
+static int s_shed_stream_on_request_done(struct aws_http_stream *stream, void *user_data) {
+    struct aws_http_server_admission *admission = user_data;
+    return aws_http_stream_send_static_response(stream, admission->shed_response);
+}
+
+static void s_shed_stream_on_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)error_code;
+    (void)user_data;
+    aws_http_stream_release(stream);
+}
+
+/* The server is overloaded. Rather than bothering the user, an internal stream
+ * discards the request and answers with the admission control's 503 response */
+static struct aws_h1_stream *s_server_new_shed_stream(struct aws_h1_connection *connection) {
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_CONNECTION, "id=%p: Server is overloaded, shedding incoming request.", (void *)&connection->base);
+
+    struct aws_http_request_handler_options options = AWS_HTTP_REQUEST_HANDLER_OPTIONS_INIT;
+    options.server_connection = &connection->base;
+    options.user_data = connection->base.server_data->admission;
+    options.on_request_done = s_shed_stream_on_request_done;
+    options.on_complete = s_shed_stream_on_complete;
+
+    connection->thread_data.can_create_request_handler_stream = true;
+    struct aws_http_stream *new_stream = aws_http_stream_new_server_request_handler(&options);
+    connection->thread_data.can_create_request_handler_stream = false;
+
+    return new_stream ? AWS_CONTAINER_OF(new_stream, struct aws_h1_stream, base) : NULL;
+}
+
 /* Invokes the on_incoming_request callback and returns new stream. */
 static struct aws_h1_stream *s_server_invoke_on_incoming_request(struct aws_h1_connection *connection) {
     AWS_PRECONDITION(connection->base.server_data);
@@ -1780,6 +2904,12 @@ static struct aws_h1_stream *s_server_invoke_on_incoming_request(struct aws_h1_c
     AWS_PRECONDITION(!connection->thread_data.can_create_request_handler_stream);
     AWS_PRECONDITION(!connection->thread_data.incoming_stream);
 
+    struct aws_http_server_admission *admission = connection->base.server_data->admission;
+    if (admission && !aws_http_server_admission_try_admit_stream(
+                         admission, aws_channel_get_event_loop(connection->base.channel_slot->channel))) {
+        return s_server_new_shed_stream(connection);
+    }
+
     /**
      * The user MUST create the new request-handler stream during the on-incoming-request callback.
      */
@@ -1790,7 +2920,16 @@ static struct aws_h1_stream *s_server_invoke_on_incoming_request(struct aws_h1_c
 
     connection->thread_data.can_create_request_handler_stream = false;
 
-    return new_stream ? AWS_CONTAINER_OF(new_stream, struct aws_h1_stream, base) : NULL;
+    if (!new_stream) {
+        if (admission) {
+            aws_http_server_admission_on_stream_complete(admission);
+        }
+        return NULL;
+    }
+
+    struct aws_h1_stream *h1_stream = AWS_CONTAINER_OF(new_stream, struct aws_h1_stream, base);
+    h1_stream->is_admission_counted = admission != NULL;
+    return h1_stream;
 }
 
 static int s_handler_process_read_message(
@@ -1816,6 +2955,10 @@ static int s_handler_process_read_message(
         return aws_raise_error(AWS_ERROR_INVALID_STATE);
     }
     connection->thread_data.connection_window -= message_size;
+    connection->thread_data.stats.bytes_read += message_size;
+    if (connection->thread_data.connection_window == 0) {
+        connection->thread_data.read_buffer.is_window_exhausted = true;
+    }
 
     /* Push message into queue of buffered messages */
     aws_linked_list_push_back(&connection->thread_data.read_buffer.messages, &message->queueing_handle);
@@ -1867,6 +3010,10 @@ void aws_h1_connection_try_process_read_messages(struct aws_h1_connection *conne
         }
     }
 
+    if (!connection->thread_data.has_switched_protocols) {
+        s_autotune_read_buffer(connection);
+    }
+
     /* Increment connection window, if necessary */
     if (s_update_connection_window(connection)) {
         goto shutdown;
@@ -1917,6 +3064,24 @@ static int s_try_process_next_stream_read_message(struct aws_h1_connection *conn
 
                 return AWS_OP_ERR;
             }
+
+            connection->thread_data.request_count++;
+            if (connection->max_requests && connection->thread_data.request_count >= connection->max_requests) {
+                AWS_LOGF_DEBUG(
+                    AWS_LS_HTTP_CONNECTION,
+                    "id=%p: Reached max of %zu requests, this will be the final stream on this connection.",
+                    (void *)&connection->base,
+                    connection->max_requests);
+
+                connection->thread_data.incoming_stream->is_final_stream = true;
+                { /* BEGIN CRITICAL SECTION */
+                    aws_h1_connection_lock_synced_data(connection);
+                    aws_atomic_store_int(&connection->new_stream_error_code, AWS_ERROR_HTTP_CONNECTION_CLOSED);
+                    aws_h1_connection_unlock_synced_data(connection);
+                } /* END CRITICAL SECTION */
+            }
+
+            s_server_update_idle_timer(connection);
         }
     }
 
@@ -1960,20 +3125,24 @@ static int s_try_process_next_stream_read_message(struct aws_h1_connection *conn
     if (incoming_stream->base.metrics.receive_start_timestamp_ns == -1) {
         /* That's the first time for the stream receives any message */
         aws_high_res_clock_get_ticks((uint64_t *)&incoming_stream->base.metrics.receive_start_timestamp_ns);
-        if (incoming_stream->base.client_data &&
-            incoming_stream->base.client_data->response_first_byte_timeout_task.fn != NULL) {
-            /* There is an outstanding response timeout task, as we already received the data, we can cancel it now. We
-             * are safe to do it as we always on connection thread to schedule the task or cancel it */
-            struct aws_event_loop *connection_loop = aws_channel_get_event_loop(connection->base.channel_slot->channel);
-            /* The task will be zeroed out within the call */
-            aws_event_loop_cancel_task(
-                connection_loop, &incoming_stream->base.client_data->response_first_byte_timeout_task);
+        if (incoming_stream->base.client_data) {
+            if (incoming_stream->base.metrics.send_start_timestamp_ns != -1) {
+                incoming_stream->base.metrics.time_to_first_byte_ns =
+                    incoming_stream->base.metrics.receive_start_timestamp_ns -
+                    incoming_stream->base.metrics.send_start_timestamp_ns;
+            }
+            /* There may be an outstanding response timeout, as we already received the data, we can cancel it now. We
+             * are safe to do it as we always on connection thread to arm or cancel it */
+            aws_http_timer_cancel(&incoming_stream->response_first_byte_timer);
         }
     }
 
     /* As decoder runs, it invokes the internal s_decoder_X callbacks, which in turn invoke user callbacks.
      * The decoder will stop once it hits the end of the request/response OR the end of the message data. */
-    if (aws_h1_decode(connection->thread_data.incoming_stream_decoder, &message_cursor)) {
+    connection->thread_data.decoding_message = queued_msg;
+    int decode_err = aws_h1_decode(connection->thread_data.incoming_stream_decoder, &message_cursor);
+    connection->thread_data.decoding_message = NULL;
+    if (decode_err) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_CONNECTION,
             "id=%p: Message processing failed, error %d (%s). Closing connection.",
@@ -2000,8 +3169,7 @@ static int s_try_process_next_stream_read_message(struct aws_h1_connection *conn
     /* If the last of queued_msg has been processed, it can be deleted now.
      * Otherwise, it remains in the queue for further processing later. */
     if (queued_msg->copy_mark == queued_msg->message_data.len) {
-        aws_linked_list_remove(&queued_msg->queueing_handle);
-        aws_mem_release(queued_msg->allocator, queued_msg);
+        s_remove_processed_read_message(connection, queued_msg);
     }
 
     return AWS_OP_SUCCESS;
@@ -2102,6 +3270,14 @@ static int s_handler_shutdown(
     if (dir == AWS_CHANNEL_DIR_READ) {
         /* This call ensures that no further streams will be created or worked on. */
         s_stop(connection, true /*stop_reading*/, false /*stop_writing*/, false /*schedule_shutdown*/, error_code);
+        aws_http_timer_cancel(&connection->thread_data.idle_timer);
+
+        /* The window won't open again. If bytes already came back, the scheduled task lets go of the channel */
+        if (connection->thread_data.is_waiting_for_memory_budget &&
+            aws_http_memory_budget_stop_waiting(connection->memory_budget, &connection->memory_budget_waiter)) {
+            connection->thread_data.is_waiting_for_memory_budget = false;
+            aws_channel_release_hold(slot->channel);
+        }
     } else /* dir == AWS_CHANNEL_DIR_WRITE */ {
 
         s_stop(connection, false /*stop_reading*/, true /*stop_writing*/, false /*schedule_shutdown*/, error_code);
@@ -2112,12 +3288,18 @@ static int s_handler_shutdown(
         while (!aws_linked_list_empty(&connection->thread_data.stream_list)) {
             struct aws_linked_list_node *node = aws_linked_list_front(&connection->thread_data.stream_list);
             s_stream_complete(AWS_CONTAINER_OF(node, struct aws_h1_stream, node), stream_error_code);
+            if (connection->max_pipeline_depth && connection->base.client_data) {
+                /* The requests behind the first didn't break the connection, let the user know they may retry */
+                stream_error_code = AWS_ERROR_HTTP_PIPELINED_REQUEST_UNANSWERED;
+            }
         }
 
-        /* It's OK to access synced_data.new_client_stream_list without holding the lock because
-         * no more streams can be added after s_stop() has been invoked. */
-        while (!aws_linked_list_empty(&connection->synced_data.new_client_stream_list)) {
-            struct aws_linked_list_node *node = aws_linked_list_front(&connection->synced_data.new_client_stream_list);
+        /* Close the queue so streams activated from now on fail, and complete the ones that never got here */
+        struct aws_linked_list new_client_streams;
+        aws_linked_list_init(&new_client_streams);
+        aws_http_mpsc_queue_close(&connection->new_client_stream_queue, &new_client_streams);
+        while (!aws_linked_list_empty(&new_client_streams)) {
+            struct aws_linked_list_node *node = aws_linked_list_front(&new_client_streams);
             s_stream_complete(AWS_CONTAINER_OF(node, struct aws_h1_stream, node), stream_error_code);
         }
     }
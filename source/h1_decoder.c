@@ -3,6 +3,7 @@
  * SPDX-License-Identifier: Apache-2.0.
  */
 
+#include <aws/common/array_list.h>
 #include <aws/common/string.h>
 #include <aws/http/private/h1_decoder.h>
 #include <aws/http/private/strutil.h>
@@ -18,18 +19,32 @@ AWS_STATIC_STRING_FROM_LITERAL(s_transfer_coding_x_gzip, "x-gzip");
 
 /* Decoder runs a state machine.
  * Each state consumes data until it sets the next state.
- * A common state is the "line state", which handles consuming one line ending in CRLF
- * and feeding the line to a linestate_fn, which should process data and set the next state.
+ * Most states consume one line ending in CRLF, via s_read_line(),
+ * and feed the line to a s_linestate_xyz() function, which should process data and set the next state.
+ *
+ * The states that differ between requests and responses are compiled once per role, from h1_decoder_role.def,
+ * so neither role pays for the other's checks.
  */
 typedef int(state_fn)(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input);
-typedef int(linestate_fn)(struct aws_h1_decoder *decoder, struct aws_byte_cursor input);
+
+/* Chunks at least this big are never copied to be coalesced with the chunks around them */
+static const size_t s_coalesce_chunk_max_copy = 1024;
 
 struct aws_h1_decoder {
     /* Implementation data. */
     struct aws_allocator *alloc;
     struct aws_byte_buf scratch_space;
+    /* Chunked body data not yet passed to on_body, so small chunks in the same input go out together.
+     * Points into the input if it's one span, otherwise into body_coalesce_buf.
+     * Always flushed before aws_h1_decode() returns. */
+    struct aws_byte_cursor pending_body;
+    struct aws_byte_buf body_coalesce_buf;
+    /* Headers not yet passed to on_headers_batch (struct aws_h1_decoded_header).
+     * They may point into the input or scratch_space, so they're flushed before either can change. */
+    struct aws_array_list pending_headers;
     state_fn *run_state;
-    linestate_fn *process_line;
+    /* The role's s_state_headers, which decodes the headers and trailers */
+    state_fn *headers_state;
     int transfer_encoding;
     uint64_t content_processed;
     uint64_t content_length;
@@ -42,16 +57,24 @@ struct aws_h1_decoder {
     enum aws_http_header_block header_block;
     const void *logging_id;
 
+    /* Bytes of the current message consumed before this call to aws_h1_decode() */
+    uint64_t message_bytes_prev;
+    /* Bytes of the current message's head (start line and headers), set once the head is done */
+    uint64_t head_bytes;
+    /* Input of the current aws_h1_decode() call, and its length when the call began */
+    const struct aws_byte_cursor *input;
+    size_t input_start_len;
+
     /* User callbacks and settings. */
     struct aws_h1_decoder_vtable vtable;
     bool is_decoding_requests;
     void *user_data;
 };
 
-static int s_linestate_request(struct aws_h1_decoder *decoder, struct aws_byte_cursor input);
-static int s_linestate_response(struct aws_h1_decoder *decoder, struct aws_byte_cursor input);
-static int s_linestate_header(struct aws_h1_decoder *decoder, struct aws_byte_cursor input);
-static int s_linestate_chunk_size(struct aws_h1_decoder *decoder, struct aws_byte_cursor input);
+static int s_state_request_line(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input);
+static int s_state_status_line(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input);
+static int s_state_chunk_size(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input);
+static int s_flush_pending_headers(struct aws_h1_decoder *decoder);
 
 static bool s_scan_for_crlf(struct aws_h1_decoder *decoder, struct aws_byte_cursor input, size_t *bytes_processed) {
     AWS_ASSERT(input.len > 0);
@@ -89,8 +112,14 @@ static bool s_scan_for_crlf(struct aws_h1_decoder *decoder, struct aws_byte_curs
     return false;
 }
 
-/* This state consumes an entire line, then calls a linestate_fn to process the line. */
-static int s_state_getline(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input) {
+/* Consume an entire line. If the CRLF was found, out_line is set to the line without it.
+ * Otherwise the partial line is kept in scratch_space, and found_line is false until more data comes in. */
+static int s_read_line(
+    struct aws_h1_decoder *decoder,
+    struct aws_byte_cursor *input,
+    struct aws_byte_cursor *out_line,
+    bool *found_line) {
+
     /* If preceding runs of this state failed to find CRLF, their data is stored in the scratch_space
      * and new data needs to be combined with the old data for processing. */
     bool has_prev_data = decoder->scratch_space.len;
@@ -103,6 +132,11 @@ static int s_state_getline(struct aws_h1_decoder *decoder, struct aws_byte_curso
 
     bool use_scratch = !found_crlf | has_prev_data;
     if (AWS_UNLIKELY(use_scratch)) {
+        /* A pending header may point into scratch_space, deliver it before scratch_space is overwritten */
+        if (s_flush_pending_headers(decoder)) {
+            return AWS_OP_ERR;
+        }
+
         if (aws_byte_buf_append_dynamic(&decoder->scratch_space, &line)) {
             AWS_LOGF_ERROR(
                 AWS_LS_HTTP_STREAM,
@@ -117,16 +151,16 @@ static int s_state_getline(struct aws_h1_decoder *decoder, struct aws_byte_curso
         line = aws_byte_cursor_from_buf(&decoder->scratch_space);
     }
 
+    *found_line = found_crlf;
     if (AWS_LIKELY(found_crlf)) {
         /* Backup so "\r\n" is not included. */
         /* RFC-7230 section 3 Message Format */
         AWS_ASSERT(line.len >= 2);
         line.len -= 2;
-
-        return decoder->process_line(decoder, line);
+        *out_line = line;
     }
 
-    /* Didn't find crlf, we'll continue scanning when more data comes in */
+    /* If crlf wasn't found, we'll continue scanning when more data comes in */
     return AWS_OP_SUCCESS;
 }
 
@@ -182,13 +216,6 @@ static int s_cursor_split_exactly_n_times(
 static void s_set_state(struct aws_h1_decoder *decoder, state_fn *state) {
     decoder->scratch_space.len = 0;
     decoder->run_state = state;
-    decoder->process_line = NULL;
-}
-
-/* Set next state to capture a full line, then call the specified linestate_fn on it */
-static void s_set_line_state(struct aws_h1_decoder *decoder, linestate_fn *line_processor) {
-    s_set_state(decoder, s_state_getline);
-    decoder->process_line = line_processor;
 }
 
 static int s_mark_done(struct aws_h1_decoder *decoder) {
@@ -200,9 +227,9 @@ static int s_mark_done(struct aws_h1_decoder *decoder) {
 /* Reset state, in preparation for processing a new message */
 static void s_reset_state(struct aws_h1_decoder *decoder) {
     if (decoder->is_decoding_requests) {
-        s_set_line_state(decoder, s_linestate_request);
+        s_set_state(decoder, s_state_request_line);
     } else {
-        s_set_line_state(decoder, s_linestate_response);
+        s_set_state(decoder, s_state_status_line);
     }
 
     decoder->transfer_encoding = 0;
@@ -216,6 +243,8 @@ static void s_reset_state(struct aws_h1_decoder *decoder) {
     decoder->body_headers_forbidden = false;
     /* set to normal by default */
     decoder->header_block = AWS_HTTP_HEADER_BLOCK_MAIN;
+    decoder->message_bytes_prev = 0;
+    decoder->head_bytes = 0;
 }
 
 static int s_state_unchunked_body(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input) {
@@ -248,6 +277,70 @@ static int s_state_unchunked_body(struct aws_h1_decoder *decoder, struct aws_byt
     return AWS_OP_SUCCESS;
 }
 
+/* Invoke on_headers_batch with any headers that have been held back */
+static int s_flush_pending_headers(struct aws_h1_decoder *decoder) {
+    const size_t num_headers = aws_array_list_length(&decoder->pending_headers);
+    if (num_headers == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    const struct aws_h1_decoded_header *headers = decoder->pending_headers.data;
+    aws_array_list_clear(&decoder->pending_headers);
+    return decoder->vtable.on_headers_batch(headers, num_headers, decoder->user_data);
+}
+
+/* Invoke on_body with any chunked body data that's been held back */
+static int s_flush_pending_body(struct aws_h1_decoder *decoder) {
+    if (decoder->pending_body.len == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_byte_cursor body = decoder->pending_body;
+    AWS_ZERO_STRUCT(decoder->pending_body);
+    return decoder->vtable.on_body(&body, false, decoder->user_data);
+}
+
+/* Hold back chunked body data, to be delivered along with the chunks after it in the same input */
+static int s_append_pending_body(struct aws_h1_decoder *decoder, struct aws_byte_cursor body) {
+    if (decoder->pending_body.len == 0) {
+        decoder->pending_body = body;
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Don't copy big chunks, it's cheaper to deliver them on their own */
+    if (body.len >= s_coalesce_chunk_max_copy) {
+        if (s_flush_pending_body(decoder)) {
+            return AWS_OP_ERR;
+        }
+        decoder->pending_body = body;
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Pending data still points into the input, copy it out before appending */
+    if (decoder->pending_body.ptr != decoder->body_coalesce_buf.buffer) {
+        decoder->body_coalesce_buf.len = 0;
+        if (aws_byte_buf_append_dynamic(&decoder->body_coalesce_buf, &decoder->pending_body)) {
+            goto error;
+        }
+    }
+
+    if (aws_byte_buf_append_dynamic(&decoder->body_coalesce_buf, &body)) {
+        goto error;
+    }
+
+    decoder->pending_body = aws_byte_cursor_from_buf(&decoder->body_coalesce_buf);
+    return AWS_OP_SUCCESS;
+
+error:
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_STREAM,
+        "id=%p: Internal buffer write failed with error code %d (%s)",
+        decoder->logging_id,
+        aws_last_error(),
+        aws_error_name(aws_last_error()));
+    return AWS_OP_ERR;
+}
+
 static int s_linestate_chunk_terminator(struct aws_h1_decoder *decoder, struct aws_byte_cursor input) {
 
     /* Expecting CRLF at end of each chunk */
@@ -258,11 +351,21 @@ static int s_linestate_chunk_terminator(struct aws_h1_decoder *decoder, struct a
         return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
     }
 
-    s_set_line_state(decoder, s_linestate_chunk_size);
+    s_set_state(decoder, s_state_chunk_size);
 
     return AWS_OP_SUCCESS;
 }
 
+static int s_state_chunk_terminator(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input) {
+    struct aws_byte_cursor line;
+    bool found_line;
+    if (s_read_line(decoder, input, &line, &found_line)) {
+        return AWS_OP_ERR;
+    }
+
+    return found_line ? s_linestate_chunk_terminator(decoder, line) : AWS_OP_SUCCESS;
+}
+
 static int s_state_chunk(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input) {
     size_t processed_bytes = 0;
     AWS_ASSERT(decoder->chunk_processed < decoder->chunk_size);
@@ -277,13 +380,13 @@ static int s_state_chunk(struct aws_h1_decoder *decoder, struct aws_byte_cursor
 
     bool finished = decoder->chunk_processed == decoder->chunk_size;
     struct aws_byte_cursor body = aws_byte_cursor_advance(input, processed_bytes);
-    int err = decoder->vtable.on_body(&body, false, decoder->user_data);
+    int err = s_append_pending_body(decoder, body);
     if (err) {
         return AWS_OP_ERR;
     }
 
     if (AWS_LIKELY(finished)) {
-        s_set_line_state(decoder, s_linestate_chunk_terminator);
+        s_set_state(decoder, s_state_chunk_terminator);
     }
 
     return AWS_OP_SUCCESS;
@@ -319,6 +422,11 @@ static int s_linestate_chunk_size(struct aws_h1_decoder *decoder, struct aws_byt
 
     /* Empty chunk signifies all chunks have been read. */
     if (AWS_UNLIKELY(decoder->chunk_size == 0)) {
+        err = s_flush_pending_body(decoder);
+        if (err) {
+            return AWS_OP_ERR;
+        }
+
         struct aws_byte_cursor cursor;
         cursor.ptr = NULL;
         cursor.len = 0;
@@ -329,7 +437,7 @@ static int s_linestate_chunk_size(struct aws_h1_decoder *decoder, struct aws_byt
 
         /* Expected empty newline and end of message. */
         decoder->doing_trailers = true;
-        s_set_line_state(decoder, s_linestate_header);
+        s_set_state(decoder, decoder->headers_state);
         return AWS_OP_SUCCESS;
     }
 
@@ -341,45 +449,25 @@ static int s_linestate_chunk_size(struct aws_h1_decoder *decoder, struct aws_byt
     return AWS_OP_SUCCESS;
 }
 
-static int s_linestate_header(struct aws_h1_decoder *decoder, struct aws_byte_cursor input) {
-    int err;
-
-    /* The \r\n was just processed by `s_state_getline`. */
-    /* Empty line signifies end of headers, and beginning of body or end of trailers. */
-    /* RFC-7230 section 3 Message Format */
-    if (input.len == 0) {
-        if (AWS_LIKELY(!decoder->doing_trailers)) {
-            if (decoder->body_headers_ignored) {
-                err = s_mark_done(decoder);
-                if (err) {
-                    return AWS_OP_ERR;
-                }
-            } else if (decoder->transfer_encoding & AWS_HTTP_TRANSFER_ENCODING_CHUNKED) {
-                s_set_line_state(decoder, s_linestate_chunk_size);
-            } else if (decoder->content_length > 0) {
-                s_set_state(decoder, s_state_unchunked_body);
-            } else {
-                err = s_mark_done(decoder);
-                if (err) {
-                    return AWS_OP_ERR;
-                }
-            }
-        } else {
-            /* Empty line means end of message. */
-            err = s_mark_done(decoder);
-            if (err) {
-                return AWS_OP_ERR;
-            }
-        }
-
-        return AWS_OP_SUCCESS;
+static int s_state_chunk_size(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input) {
+    struct aws_byte_cursor line;
+    bool found_line;
+    if (s_read_line(decoder, input, &line, &found_line)) {
+        return AWS_OP_ERR;
     }
 
-    /* Each header field consists of a case-insensitive field name followed by a colon (":"),
-     * optional leading whitespace, the field value, and optional trailing whitespace.
-     * RFC-7230 3.2 */
+    return found_line ? s_linestate_chunk_size(decoder, line) : AWS_OP_SUCCESS;
+}
+
+/* Table-driven header line split, which checks each rule separately so the error log is precise */
+static int s_split_header_line_slow(
+    struct aws_h1_decoder *decoder,
+    struct aws_byte_cursor input,
+    struct aws_byte_cursor *out_name,
+    struct aws_byte_cursor *out_value) {
+
     struct aws_byte_cursor splits[2];
-    err = s_cursor_split_first_n_times(input, ':', splits, 2); /* value may contain more colons */
+    int err = s_cursor_split_first_n_times(input, ':', splits, 2); /* value may contain more colons */
     if (err) {
         AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=%p: Invalid incoming header, missing colon.", decoder->logging_id);
         AWS_LOGF_DEBUG(
@@ -403,144 +491,23 @@ static int s_linestate_header(struct aws_h1_decoder *decoder, struct aws_byte_cu
         return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
     }
 
-    struct aws_h1_decoded_header header;
-    header.name = aws_http_str_to_header_name(name);
-    header.name_data = name;
-    header.value_data = value;
-    header.data = input;
-
-    switch (header.name) {
-        case AWS_HTTP_HEADER_CONTENT_LENGTH:
-            if (decoder->transfer_encoding) {
-                AWS_LOGF_ERROR(
-                    AWS_LS_HTTP_STREAM,
-                    "id=%p: Incoming headers for both content-length and transfer-encoding received. This is illegal.",
-                    decoder->logging_id);
-                return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
-            }
-
-            if (aws_byte_cursor_utf8_parse_u64(header.value_data, &decoder->content_length)) {
-                AWS_LOGF_ERROR(
-                    AWS_LS_HTTP_STREAM,
-                    "id=%p: Incoming content-length header has invalid value.",
-                    decoder->logging_id);
-                AWS_LOGF_DEBUG(
-                    AWS_LS_HTTP_STREAM,
-                    "id=%p: Bad content-length value is: '" PRInSTR "'",
-                    decoder->logging_id,
-                    AWS_BYTE_CURSOR_PRI(header.value_data));
-                return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
-            }
-
-            if (decoder->body_headers_forbidden && decoder->content_length != 0) {
-                AWS_LOGF_ERROR(
-                    AWS_LS_HTTP_STREAM,
-                    "id=%p: Incoming headers for content-length received, but it is illegal for this message to have a "
-                    "body",
-                    decoder->logging_id);
-                return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
-            }
-
-            break;
-
-        case AWS_HTTP_HEADER_TRANSFER_ENCODING: {
-            if (decoder->content_length) {
-                AWS_LOGF_ERROR(
-                    AWS_LS_HTTP_STREAM,
-                    "id=%p: Incoming headers for both content-length and transfer-encoding received. This is illegal.",
-                    decoder->logging_id);
-                return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
-            }
-
-            if (decoder->body_headers_forbidden) {
-                AWS_LOGF_ERROR(
-                    AWS_LS_HTTP_STREAM,
-                    "id=%p: Incoming headers for transfer-encoding received, but it is illegal for this message to "
-                    "have a body",
-                    decoder->logging_id);
-                return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
-            }
-            /* RFC-7230 section 3.3.1 Transfer-Encoding */
-            /* RFC-7230 section 4.2 Compression Codings */
-
-            /* Note that it's possible for multiple Transfer-Encoding headers to exist, in which case the values
-             * should be appended with those from any previously encountered Transfer-Encoding headers. */
-            struct aws_byte_cursor split;
-            AWS_ZERO_STRUCT(split);
-            while (aws_byte_cursor_next_split(&header.value_data, ',', &split)) {
-                struct aws_byte_cursor coding = aws_strutil_trim_http_whitespace(split);
-                int prev_flags = decoder->transfer_encoding;
-
-                if (aws_string_eq_byte_cursor_ignore_case(s_transfer_coding_chunked, &coding)) {
-                    decoder->transfer_encoding |= AWS_HTTP_TRANSFER_ENCODING_CHUNKED;
-
-                } else if (
-                    aws_string_eq_byte_cursor_ignore_case(s_transfer_coding_compress, &coding) ||
-                    aws_string_eq_byte_cursor_ignore_case(s_transfer_coding_x_compress, &coding)) {
-                    /* A recipient SHOULD consider "x-compress" to be equivalent to "compress". RFC-7230 4.2.1 */
-                    decoder->transfer_encoding |= AWS_HTTP_TRANSFER_ENCODING_DEPRECATED_COMPRESS;
-
-                } else if (aws_string_eq_byte_cursor_ignore_case(s_transfer_coding_deflate, &coding)) {
-                    decoder->transfer_encoding |= AWS_HTTP_TRANSFER_ENCODING_DEFLATE;
-
-                } else if (
-                    aws_string_eq_byte_cursor_ignore_case(s_transfer_coding_gzip, &coding) ||
-                    aws_string_eq_byte_cursor_ignore_case(s_transfer_coding_x_gzip, &coding)) {
-                    /* A recipient SHOULD consider "x-gzip" to be equivalent to "gzip". RFC-7230 4.2.3 */
-                    decoder->transfer_encoding |= AWS_HTTP_TRANSFER_ENCODING_GZIP;
-
-                } else if (coding.len > 0) {
-                    AWS_LOGF_ERROR(
-                        AWS_LS_HTTP_STREAM,
-                        "id=%p: Incoming transfer-encoding header lists unrecognized coding.",
-                        decoder->logging_id);
-                    AWS_LOGF_DEBUG(
-                        AWS_LS_HTTP_STREAM,
-                        "id=%p: Unrecognized coding is: '" PRInSTR "'",
-                        decoder->logging_id,
-                        AWS_BYTE_CURSOR_PRI(coding));
-                    return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
-                }
-
-                /* If any transfer coding other than chunked is applied to a request payload body, the sender MUST
-                 * apply chunked as the final transfer coding to ensure that the message is properly framed.
-                 * RFC-7230 3.3.1 */
-                if ((prev_flags & AWS_HTTP_TRANSFER_ENCODING_CHUNKED) && (decoder->transfer_encoding != prev_flags)) {
-                    AWS_LOGF_ERROR(
-                        AWS_LS_HTTP_STREAM,
-                        "id=%p: Incoming transfer-encoding header lists a coding after 'chunked', this is illegal.",
-                        decoder->logging_id);
-                    AWS_LOGF_DEBUG(
-                        AWS_LS_HTTP_STREAM,
-                        "id=%p: Misplaced coding is '" PRInSTR "'",
-                        decoder->logging_id,
-                        AWS_BYTE_CURSOR_PRI(coding));
-                    return aws_raise_error(AWS_ERROR_HTTP_PROTOCOL_ERROR);
-                }
-            }
-
-            /* TODO: deal with body of indeterminate length, marking it as successful when connection is closed:
-             *
-             * A response that has neither chunked transfer coding nor Content-Length is terminated by closure of
-             * the connection and, thus, is considered complete regardless of the number of message body octets
-             * received, provided that the header section was received intact.
-             * RFC-7230 3.4 */
-        } break;
-
-        default:
-            break;
-    }
-
-    err = decoder->vtable.on_header(&header, decoder->user_data);
-    if (err) {
-        return AWS_OP_ERR;
-    }
-
-    s_set_line_state(decoder, s_linestate_header);
-
+    *out_name = name;
+    *out_value = value;
     return AWS_OP_SUCCESS;
 }
 
+#define H1_DECODER_IS_REQUEST 1
+#define H1_DECODER_ROLE_FN(name) name##_request
+#include <aws/http/private/h1_decoder_role.def>
+#undef H1_DECODER_IS_REQUEST
+#undef H1_DECODER_ROLE_FN
+
+#define H1_DECODER_IS_REQUEST 0
+#define H1_DECODER_ROLE_FN(name) name##_response
+#include <aws/http/private/h1_decoder_role.def>
+#undef H1_DECODER_IS_REQUEST
+#undef H1_DECODER_ROLE_FN
+
 static int s_linestate_request(struct aws_h1_decoder *decoder, struct aws_byte_cursor input) {
     struct aws_byte_cursor cursors[3];
     int err = s_cursor_split_exactly_n_times(input, ' ', cursors, 3); /* extra spaces not allowed */
@@ -608,11 +575,21 @@ static int s_linestate_request(struct aws_h1_decoder *decoder, struct aws_byte_c
         return AWS_OP_ERR;
     }
 
-    s_set_line_state(decoder, s_linestate_header);
+    s_set_state(decoder, s_state_headers_request);
 
     return AWS_OP_SUCCESS;
 }
 
+static int s_state_request_line(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input) {
+    struct aws_byte_cursor line;
+    bool found_line;
+    if (s_read_line(decoder, input, &line, &found_line)) {
+        return AWS_OP_ERR;
+    }
+
+    return found_line ? s_linestate_request(decoder, line) : AWS_OP_SUCCESS;
+}
+
 static bool s_check_info_response_status_code(int code_val) {
     return code_val >= 100 && code_val < 200;
 }
@@ -681,10 +658,20 @@ static int s_linestate_response(struct aws_h1_decoder *decoder, struct aws_byte_
         return AWS_OP_ERR;
     }
 
-    s_set_line_state(decoder, s_linestate_header);
+    s_set_state(decoder, s_state_headers_response);
     return AWS_OP_SUCCESS;
 }
 
+static int s_state_status_line(struct aws_h1_decoder *decoder, struct aws_byte_cursor *input) {
+    struct aws_byte_cursor line;
+    bool found_line;
+    if (s_read_line(decoder, input, &line, &found_line)) {
+        return AWS_OP_ERR;
+    }
+
+    return found_line ? s_linestate_response(decoder, line) : AWS_OP_SUCCESS;
+}
+
 struct aws_h1_decoder *aws_h1_decoder_new(struct aws_h1_decoder_params *params) {
     AWS_ASSERT(params);
 
@@ -698,8 +685,17 @@ struct aws_h1_decoder *aws_h1_decoder_new(struct aws_h1_decoder_params *params)
     decoder->user_data = params->user_data;
     decoder->vtable = params->vtable;
     decoder->is_decoding_requests = params->is_decoding_requests;
+    decoder->headers_state = params->is_decoding_requests ? s_state_headers_request : s_state_headers_response;
 
     aws_byte_buf_init(&decoder->scratch_space, params->alloc, params->scratch_space_initial_size);
+    aws_byte_buf_init(&decoder->body_coalesce_buf, params->alloc, 0);
+    if (aws_array_list_init_dynamic(
+            &decoder->pending_headers, params->alloc, 0, sizeof(struct aws_h1_decoded_header))) {
+        aws_byte_buf_clean_up(&decoder->scratch_space);
+        aws_byte_buf_clean_up(&decoder->body_coalesce_buf);
+        aws_mem_release(params->alloc, decoder);
+        return NULL;
+    }
 
     s_reset_state(decoder);
 
@@ -711,6 +707,8 @@ void aws_h1_decoder_destroy(struct aws_h1_decoder *decoder) {
         return;
     }
     aws_byte_buf_clean_up(&decoder->scratch_space);
+    aws_byte_buf_clean_up(&decoder->body_coalesce_buf);
+    aws_array_list_clean_up(&decoder->pending_headers);
     aws_mem_release(decoder->alloc, decoder);
 }
 
@@ -719,21 +717,49 @@ int aws_h1_decode(struct aws_h1_decoder *decoder, struct aws_byte_cursor *data)
     AWS_ASSERT(data);
 
     struct aws_byte_cursor backup = *data;
+    decoder->input = data;
+    decoder->input_start_len = data->len;
 
     while (data->len && !decoder->is_done) {
         int err = decoder->run_state(decoder, data);
         if (err) {
-            /* Reset the data param to how we found it */
-            *data = backup;
-            return AWS_OP_ERR;
+            goto error;
         }
     }
 
+    /* Pending body and headers may point into the input, so they can't wait for the next call */
+    if (s_flush_pending_body(decoder) || s_flush_pending_headers(decoder)) {
+        goto error;
+    }
+
     if (decoder->is_done) {
         s_reset_state(decoder);
+    } else {
+        decoder->message_bytes_prev = aws_h1_decoder_get_message_bytes(decoder);
     }
 
+    decoder->input = NULL;
     return AWS_OP_SUCCESS;
+
+error:
+    AWS_ZERO_STRUCT(decoder->pending_body);
+    aws_array_list_clear(&decoder->pending_headers);
+    decoder->input = NULL;
+    /* Reset the data param to how we found it */
+    *data = backup;
+    return AWS_OP_ERR;
+}
+
+uint64_t aws_h1_decoder_get_head_bytes(const struct aws_h1_decoder *decoder) {
+    return decoder->head_bytes;
+}
+
+uint64_t aws_h1_decoder_get_message_bytes(const struct aws_h1_decoder *decoder) {
+    uint64_t bytes = decoder->message_bytes_prev;
+    if (decoder->input) {
+        bytes += decoder->input_start_len - decoder->input->len;
+    }
+    return bytes;
 }
 
 int aws_h1_decoder_get_encoding_flags(const struct aws_h1_decoder *decoder) {
@@ -2,7 +2,10 @@
  * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
  * SPDX-License-Identifier: Apache-2.0.
  */
+#include <aws/http/private/async_body_stream.h>
+#include <aws/http/private/body_fd_stream.h>
 #include <aws/http/private/h1_encoder.h>
+#include <aws/http/private/request_response_impl.h>
 #include <aws/http/private/strutil.h>
 #include <aws/http/status_code.h>
 #include <aws/io/logging.h>
@@ -17,55 +20,90 @@
 #define MAX_ASCII_HEX_CHUNK_STR_SIZE (sizeof(uint64_t) * 2 + 1)
 #define CRLF_SIZE 2
 
+/**
+ * Validate a header field (RFC-7230 3.2).
+ * aws_http_headers already checked this when the header was added, so usually there's nothing to do,
+ * and headers sent many times (retries, forwarded proxy headers) don't pay for it every time.
+ */
+static int s_validate_outgoing_header(
+    const struct aws_http_headers *headers,
+    size_t index,
+    const struct aws_http_header *header) {
+
+    if (aws_http_headers_is_field_valid(headers, index)) {
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Validate header field-name (RFC-7230 3.2): field-name = token */
+    if (!aws_strutil_is_http_token(header->name)) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=static: Header name is invalid");
+        return aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_NAME);
+    }
+
+    /* Validate header field-value.
+     * The value itself isn't supposed to have whitespace on either side,
+     * but aws_http_headers trims it off, so we don't start needlessly
+     * failing requests that used to work before we added validation.
+     * This should be OK because field-value can be sent with any amount
+     * of whitespace around it, which the other side will just ignore (RFC-7230 3.2):
+     * header-field = field-name ":" OWS field-value OWS */
+    if (!aws_strutil_is_http_field_value(header->value)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM,
+            "id=static: Header '" PRInSTR "' has invalid value",
+            AWS_BYTE_CURSOR_PRI(header->name));
+        return aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_VALUE);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 /**
  * Scan headers to detect errors and determine anything we'll need to know later (ex: total length).
+ * Headers before first_header_index are skipped, they've already been validated (see aws_http_message_template).
  */
 static int s_scan_outgoing_headers(
     struct aws_h1_encoder_message *encoder_message,
     const struct aws_http_message *message,
+    size_t first_header_index,
     size_t *out_header_lines_len,
     bool body_headers_ignored,
     bool body_headers_forbidden) {
 
     size_t total = 0;
-    bool has_body_stream = aws_http_message_get_body_stream(message);
+    bool has_body_stream =
+        aws_http_message_get_body_stream(message) != NULL || aws_http_message_get_body_async_stream(message) != NULL;
     bool has_content_length_header = false;
     bool has_transfer_encoding_header = false;
 
+    const struct aws_http_headers *headers = aws_http_message_get_const_headers(message);
     const size_t num_headers = aws_http_message_get_header_count(message);
-    for (size_t i = 0; i < num_headers; ++i) {
+    for (size_t i = first_header_index; i < num_headers; ++i) {
         struct aws_http_header header;
         aws_http_message_get_header(message, &header, i);
 
-        /* Validate header field-name (RFC-7230 3.2): field-name = token */
-        if (!aws_strutil_is_http_token(header.name)) {
-            AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=static: Header name is invalid");
-            return aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_NAME);
+        if (s_validate_outgoing_header(headers, i, &header)) {
+            return AWS_OP_ERR;
         }
+        struct aws_byte_cursor field_value = header.value;
 
-        /* Validate header field-value.
-         * The value itself isn't supposed to have whitespace on either side,
-         * but we'll trim it off before validation so we don't start needlessly
-         * failing requests that used to work before we added validation.
-         * This should be OK because field-value can be sent with any amount
-         * of whitespace around it, which the other side will just ignore (RFC-7230 3.2):
-         * header-field = field-name ":" OWS field-value OWS */
-        struct aws_byte_cursor field_value = aws_strutil_trim_http_whitespace(header.value);
-        if (!aws_strutil_is_http_field_value(field_value)) {
-            AWS_LOGF_ERROR(
-                AWS_LS_HTTP_STREAM,
-                "id=static: Header '" PRInSTR "' has invalid value",
-                AWS_BYTE_CURSOR_PRI(header.name));
-            return aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_VALUE);
+        enum aws_http_header_name name_enum = aws_http_headers_get_name_enum(headers, i);
+        if (name_enum == AWS_HTTP_HEADER_CONTENT_LENGTH && encoder_message->has_chunked_body_stream) {
+            /* Not sent, the chunked body stream replaces the body this described */
+            continue;
         }
-
-        enum aws_http_header_name name_enum = aws_http_str_to_header_name(header.name);
         switch (name_enum) {
             case AWS_HTTP_HEADER_CONNECTION: {
                 if (aws_byte_cursor_eq_c_str(&field_value, "close")) {
                     encoder_message->has_connection_close_header = true;
                 }
             } break;
+            case AWS_HTTP_HEADER_EXPECT: {
+                /* RFC-9110 10.1.1 */
+                if (aws_byte_cursor_eq_c_str_ignore_case(&field_value, "100-continue")) {
+                    encoder_message->has_expect_continue_header = true;
+                }
+            } break;
             case AWS_HTTP_HEADER_CONTENT_LENGTH: {
                 has_content_length_header = true;
                 if (aws_byte_cursor_utf8_parse_u64(field_value, &encoder_message->content_length)) {
@@ -127,7 +165,7 @@ static int s_scan_outgoing_headers(
         return aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_VALUE);
     }
 
-    if (encoder_message->has_chunked_encoding_header && has_body_stream) {
+    if (encoder_message->has_chunked_encoding_header && has_body_stream && !encoder_message->has_chunked_body_stream) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_STREAM,
             "id=static: Both Transfer-Encoding chunked header and body stream is set. "
@@ -162,29 +200,11 @@ static int s_scan_outgoing_trailer(const struct aws_http_headers *headers, size_
     for (size_t i = 0; i < num_headers; i++) {
         struct aws_http_header header;
         aws_http_headers_get_index(headers, i, &header);
-        /* Validate header field-name (RFC-7230 3.2): field-name = token */
-        if (!aws_strutil_is_http_token(header.name)) {
-            AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=static: Header name is invalid");
-            return aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_NAME);
-        }
-
-        /* Validate header field-value.
-         * The value itself isn't supposed to have whitespace on either side,
-         * but we'll trim it off before validation so we don't start needlessly
-         * failing requests that used to work before we added validation.
-         * This should be OK because field-value can be sent with any amount
-         * of whitespace around it, which the other side will just ignore (RFC-7230 3.2):
-         * header-field = field-name ":" OWS field-value OWS */
-        struct aws_byte_cursor field_value = aws_strutil_trim_http_whitespace(header.value);
-        if (!aws_strutil_is_http_field_value(field_value)) {
-            AWS_LOGF_ERROR(
-                AWS_LS_HTTP_STREAM,
-                "id=static: Header '" PRInSTR "' has invalid value",
-                AWS_BYTE_CURSOR_PRI(header.name));
-            return aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_VALUE);
+        if (s_validate_outgoing_header(headers, i, &header)) {
+            return AWS_OP_ERR;
         }
 
-        enum aws_http_header_name name_enum = aws_http_str_to_header_name(header.name);
+        enum aws_http_header_name name_enum = aws_http_headers_get_name_enum(headers, i);
         if (name_enum == AWS_HTTP_HEADER_TRANSFER_ENCODING || name_enum == AWS_HTTP_HEADER_CONTENT_LENGTH ||
             name_enum == AWS_HTTP_HEADER_HOST || name_enum == AWS_HTTP_HEADER_EXPECT ||
             name_enum == AWS_HTTP_HEADER_CACHE_CONTROL || name_enum == AWS_HTTP_HEADER_MAX_FORWARDS ||
@@ -226,12 +246,20 @@ static bool s_write_crlf(struct aws_byte_buf *dst) {
     return aws_byte_buf_write_from_whole_cursor(dst, crlf_cursor);
 }
 
-static void s_write_headers(struct aws_byte_buf *dst, const struct aws_http_headers *headers) {
+static void s_write_headers(
+    struct aws_byte_buf *dst,
+    const struct aws_http_headers *headers,
+    size_t first_header_index,
+    bool skip_content_length) {
 
     const size_t num_headers = aws_http_headers_count(headers);
 
     bool wrote_all = true;
-    for (size_t i = 0; i < num_headers; ++i) {
+    for (size_t i = first_header_index; i < num_headers; ++i) {
+        if (skip_content_length && aws_http_headers_get_name_enum(headers, i) == AWS_HTTP_HEADER_CONTENT_LENGTH) {
+            continue;
+        }
+
         struct aws_http_header header;
         aws_http_headers_get_index(headers, i, &header);
 
@@ -246,17 +274,24 @@ static void s_write_headers(struct aws_byte_buf *dst, const struct aws_http_head
     (void)wrote_all;
 }
 
-int aws_h1_encoder_message_init_from_request(
+static int s_message_init_from_request(
     struct aws_h1_encoder_message *message,
     struct aws_allocator *allocator,
     const struct aws_http_message *request,
+    struct aws_byte_cursor target_prefix,
+    struct aws_input_stream *chunked_body,
     struct aws_linked_list *pending_chunk_list) {
 
     AWS_PRECONDITION(aws_linked_list_is_valid(pending_chunk_list));
 
     AWS_ZERO_STRUCT(*message);
 
-    message->body = aws_input_stream_acquire(aws_http_message_get_body_stream(request));
+    if (chunked_body) {
+        message->body = aws_input_stream_acquire(chunked_body);
+        message->has_chunked_body_stream = true;
+    } else {
+        message->body = aws_http_message_acquire_outgoing_body(allocator, request);
+    }
     message->pending_chunk_list = pending_chunk_list;
 
     struct aws_byte_cursor method;
@@ -286,22 +321,57 @@ int aws_h1_encoder_message_init_from_request(
         goto error;
     }
 
+    /* Only origin-form and asterisk-form targets get the prefix, anything else was already rewritten */
+    if (target_prefix.len > 0 && !aws_h1_encoder_is_prefixable_request_target(method, uri)) {
+        AWS_ZERO_STRUCT(target_prefix);
+    }
+    /* RFC-7230 5.3.4: asterisk-form becomes an absolute-form with an empty path */
+    if (target_prefix.len > 0 && uri.len > 0 && uri.ptr[0] == '*') {
+        AWS_ZERO_STRUCT(uri);
+    }
+
     struct aws_byte_cursor version = aws_http_version_to_str(AWS_HTTP_VERSION_1_1);
 
+    /* If the request came from a template, its leading headers are already validated and encoded */
+    struct aws_byte_cursor template_header_lines;
+    AWS_ZERO_STRUCT(template_header_lines);
+    size_t template_header_count = 0;
+    aws_http_message_get_template_encoding(
+        request,
+        &template_header_lines,
+        &template_header_count,
+        &message->has_connection_close_header,
+        &message->has_expect_continue_header);
+
     /**
      * Calculate total size needed for outgoing_head_buffer, then write to buffer.
      */
 
     size_t header_lines_len;
     err = s_scan_outgoing_headers(
-        message, request, &header_lines_len, false /*body_headers_ignored*/, false /*body_headers_forbidden*/);
+        message,
+        request,
+        template_header_count,
+        &header_lines_len,
+        false /*body_headers_ignored*/,
+        false /*body_headers_forbidden*/);
     if (err) {
         goto error;
     }
+    /* A chunked body stream's length isn't known, so it's always sent with chunked encoding */
+    struct aws_byte_cursor chunked_header_line;
+    AWS_ZERO_STRUCT(chunked_header_line);
+    if (message->has_chunked_body_stream && !message->has_chunked_encoding_header) {
+        chunked_header_line = aws_byte_cursor_from_c_str("Transfer-Encoding: chunked\r\n");
+        message->has_chunked_encoding_header = true;
+    }
+    err |= aws_add_size_checked(template_header_lines.len, header_lines_len, &header_lines_len);
+    err |= aws_add_size_checked(chunked_header_line.len, header_lines_len, &header_lines_len);
 
     /* request-line: "{method} {uri} {version}\r\n" */
     size_t request_line_len = 4; /* 2 spaces + "\r\n" */
     err |= aws_add_size_checked(method.len, request_line_len, &request_line_len);
+    err |= aws_add_size_checked(target_prefix.len, request_line_len, &request_line_len);
     err |= aws_add_size_checked(uri.len, request_line_len, &request_line_len);
     err |= aws_add_size_checked(version.len, request_line_len, &request_line_len);
 
@@ -324,16 +394,24 @@ int aws_h1_encoder_message_init_from_request(
 
     wrote_all &= aws_byte_buf_write_from_whole_cursor(&message->outgoing_head_buf, method);
     wrote_all &= aws_byte_buf_write_u8(&message->outgoing_head_buf, ' ');
+    wrote_all &= aws_byte_buf_write_from_whole_cursor(&message->outgoing_head_buf, target_prefix);
     wrote_all &= aws_byte_buf_write_from_whole_cursor(&message->outgoing_head_buf, uri);
     wrote_all &= aws_byte_buf_write_u8(&message->outgoing_head_buf, ' ');
     wrote_all &= aws_byte_buf_write_from_whole_cursor(&message->outgoing_head_buf, version);
     wrote_all &= s_write_crlf(&message->outgoing_head_buf);
 
-    s_write_headers(&message->outgoing_head_buf, aws_http_message_get_const_headers(request));
+    wrote_all &= aws_byte_buf_write_from_whole_cursor(&message->outgoing_head_buf, template_header_lines);
+    s_write_headers(
+        &message->outgoing_head_buf,
+        aws_http_message_get_const_headers(request),
+        template_header_count,
+        message->has_chunked_body_stream /*skip_content_length*/);
+    wrote_all &= aws_byte_buf_write_from_whole_cursor(&message->outgoing_head_buf, chunked_header_line);
 
     wrote_all &= s_write_crlf(&message->outgoing_head_buf);
     (void)wrote_all;
     AWS_ASSERT(wrote_all);
+    message->head_len = message->outgoing_head_buf.len;
 
     return AWS_OP_SUCCESS;
 error:
@@ -341,6 +419,55 @@ error:
     return AWS_OP_ERR;
 }
 
+int aws_h1_encoder_message_init_from_request(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator,
+    const struct aws_http_message *request,
+    struct aws_linked_list *pending_chunk_list) {
+
+    struct aws_byte_cursor no_prefix;
+    AWS_ZERO_STRUCT(no_prefix);
+    return s_message_init_from_request(
+        message, allocator, request, no_prefix, NULL /*chunked_body*/, pending_chunk_list);
+}
+
+int aws_h1_encoder_message_init_from_request_with_chunked_body(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator,
+    const struct aws_http_message *request,
+    struct aws_input_stream *body,
+    struct aws_linked_list *pending_chunk_list) {
+
+    AWS_PRECONDITION(body);
+    struct aws_byte_cursor no_prefix;
+    AWS_ZERO_STRUCT(no_prefix);
+    return s_message_init_from_request(message, allocator, request, no_prefix, body, pending_chunk_list);
+}
+
+int aws_h1_encoder_message_init_from_proxied_request(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator,
+    const struct aws_http_message *request,
+    struct aws_byte_cursor target_prefix,
+    struct aws_input_stream *chunked_body,
+    struct aws_linked_list *pending_chunk_list) {
+
+    return s_message_init_from_request(message, allocator, request, target_prefix, chunked_body, pending_chunk_list);
+}
+
+bool aws_h1_encoder_is_prefixable_request_target(struct aws_byte_cursor method, struct aws_byte_cursor path) {
+    if (path.len == 0) {
+        return false;
+    }
+
+    if (path.ptr[0] == '/') {
+        return true;
+    }
+
+    /* RFC-7230 5.3.4: asterisk-form is only for OPTIONS */
+    return path.len == 1 && path.ptr[0] == '*' && aws_byte_cursor_eq_c_str_ignore_case(&method, "OPTIONS");
+}
+
 int aws_h1_encoder_message_init_from_response(
     struct aws_h1_encoder_message *message,
     struct aws_allocator *allocator,
@@ -352,7 +479,7 @@ int aws_h1_encoder_message_init_from_response(
 
     AWS_ZERO_STRUCT(*message);
 
-    message->body = aws_input_stream_acquire(aws_http_message_get_body_stream(response));
+    message->body = aws_http_message_acquire_outgoing_body(allocator, response);
     message->pending_chunk_list = pending_chunk_list;
 
     struct aws_byte_cursor version = aws_http_version_to_str(AWS_HTTP_VERSION_1_1);
@@ -382,10 +509,13 @@ int aws_h1_encoder_message_init_from_response(
      */
     body_headers_ignored |= status_int == AWS_HTTP_STATUS_CODE_304_NOT_MODIFIED;
     bool body_headers_forbidden = status_int == AWS_HTTP_STATUS_CODE_204_NO_CONTENT || status_int / 100 == 1;
-    err = s_scan_outgoing_headers(message, response, &header_lines_len, body_headers_ignored, body_headers_forbidden);
+    err = s_scan_outgoing_headers(
+        message, response, 0 /*first_header_index*/, &header_lines_len, body_headers_ignored, body_headers_forbidden);
     if (err) {
         goto error;
     }
+    /* Only requests wait for 100 (Continue) */
+    message->has_expect_continue_header = false;
 
     /* valid status must be three digital code, change it into byte_cursor */
     /* response-line: "{version} {status} {status_text}\r\n" */
@@ -414,11 +544,16 @@ int aws_h1_encoder_message_init_from_response(
     wrote_all &= aws_byte_buf_write_from_whole_cursor(&message->outgoing_head_buf, status_text);
     wrote_all &= s_write_crlf(&message->outgoing_head_buf);
 
-    s_write_headers(&message->outgoing_head_buf, aws_http_message_get_const_headers(response));
+    s_write_headers(
+        &message->outgoing_head_buf,
+        aws_http_message_get_const_headers(response),
+        0 /*first_header_index*/,
+        false /*skip_content_length*/);
 
     wrote_all &= s_write_crlf(&message->outgoing_head_buf);
     (void)wrote_all;
     AWS_ASSERT(wrote_all);
+    message->head_len = message->outgoing_head_buf.len;
 
     /* Success! */
     return AWS_OP_SUCCESS;
@@ -428,6 +563,168 @@ error:
     return AWS_OP_ERR;
 }
 
+static void s_static_response_destroy(void *user_data) {
+    struct aws_http_static_response *response = user_data;
+    aws_byte_buf_clean_up(&response->data);
+    aws_mem_release(response->allocator, response);
+}
+
+struct aws_http_static_response *aws_http_static_response_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *response) {
+
+    AWS_PRECONDITION(response);
+
+    /* Validate and serialize the head, exactly as if the response were being sent */
+    struct aws_linked_list unused_chunk_list;
+    aws_linked_list_init(&unused_chunk_list);
+    struct aws_h1_encoder_message encoder_message;
+    if (aws_h1_encoder_message_init_from_response(
+            &encoder_message, allocator, response, false /*body_headers_ignored*/, &unused_chunk_list)) {
+        return NULL;
+    }
+
+    struct aws_http_static_response *static_response = NULL;
+
+    if (aws_http_message_get_body_async_stream(response) != NULL) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=static: A static response cannot use an async body stream");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        goto error;
+    }
+
+    if (encoder_message.has_chunked_encoding_header) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=static: A static response cannot use chunked encoding");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        goto error;
+    }
+
+    size_t head_len = encoder_message.outgoing_head_buf.len;
+    size_t total_len = 0;
+    if (encoder_message.content_length > SIZE_MAX ||
+        aws_add_size_checked(head_len, (size_t)encoder_message.content_length, &total_len)) {
+        aws_raise_error(AWS_ERROR_OVERFLOW_DETECTED);
+        goto error;
+    }
+
+    static_response = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_static_response));
+    static_response->allocator = allocator;
+    aws_ref_count_init(&static_response->ref_count, static_response, s_static_response_destroy);
+    static_response->head_len = head_len;
+    static_response->has_connection_close_header = encoder_message.has_connection_close_header;
+
+    aws_byte_buf_init(&static_response->data, allocator, total_len);
+    aws_byte_buf_write_from_whole_buffer(&static_response->data, encoder_message.outgoing_head_buf);
+
+    /* Read the whole body now, so sending never has to */
+    while (static_response->data.len < total_len) {
+        if (aws_input_stream_read(encoder_message.body, &static_response->data)) {
+            goto error;
+        }
+
+        struct aws_stream_status status;
+        if (aws_input_stream_get_status(encoder_message.body, &status)) {
+            goto error;
+        }
+
+        if (status.is_end_of_stream && static_response->data.len < total_len) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_STREAM, "id=static: Static response body is shorter than its Content-Length");
+            aws_raise_error(AWS_ERROR_HTTP_OUTGOING_STREAM_LENGTH_INCORRECT);
+            goto error;
+        }
+    }
+
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    return static_response;
+
+error:
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    aws_http_static_response_release(static_response);
+    return NULL;
+}
+
+struct aws_http_static_response *aws_http_static_response_acquire(struct aws_http_static_response *response) {
+    if (response) {
+        aws_ref_count_acquire(&response->ref_count);
+    }
+    return response;
+}
+
+void aws_http_static_response_release(struct aws_http_static_response *response) {
+    if (response) {
+        aws_ref_count_release(&response->ref_count);
+    }
+}
+
+void aws_h1_encoder_message_init_from_static_response(
+    struct aws_h1_encoder_message *message,
+    const struct aws_http_static_response *response,
+    bool body_headers_ignored,
+    struct aws_linked_list *pending_chunk_list) {
+
+    AWS_ZERO_STRUCT(*message);
+    message->pending_chunk_list = pending_chunk_list;
+    message->has_connection_close_header = response->has_connection_close_header;
+
+    /* The body is sent along with the head. A buffer without an allocator is never freed by the encoder. */
+    size_t len = body_headers_ignored ? response->head_len : response->data.len;
+    message->outgoing_head_buf = aws_byte_buf_from_array(response->data.buffer, len);
+    message->head_len = response->head_len;
+}
+
+void aws_h1_encoder_message_add_header(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor name,
+    struct aws_byte_cursor value) {
+
+    AWS_PRECONDITION(message->head_len >= CRLF_SIZE);
+
+    /* header-line: "{name}: {value}\r\n" */
+    const size_t header_line_len = name.len + value.len + 4;
+
+    /* The header line goes before the blank line that ends the head. Anything after the head (the body of a
+     * static response) moves along with it */
+    struct aws_byte_cursor old_data = aws_byte_cursor_from_buf(&message->outgoing_head_buf);
+    struct aws_byte_cursor head_lines = aws_byte_cursor_advance(&old_data, message->head_len - CRLF_SIZE);
+
+    struct aws_byte_buf new_buf;
+    aws_byte_buf_init(&new_buf, allocator, message->outgoing_head_buf.len + header_line_len); /* cannot fail */
+    bool wrote_all = true;
+    wrote_all &= aws_byte_buf_write_from_whole_cursor(&new_buf, head_lines);
+    wrote_all &= aws_byte_buf_write_from_whole_cursor(&new_buf, name);
+    wrote_all &= aws_byte_buf_write_u8(&new_buf, ':');
+    wrote_all &= aws_byte_buf_write_u8(&new_buf, ' ');
+    wrote_all &= aws_byte_buf_write_from_whole_cursor(&new_buf, value);
+    wrote_all &= s_write_crlf(&new_buf);
+    wrote_all &= aws_byte_buf_write_from_whole_cursor(&new_buf, old_data);
+    AWS_ASSERT(wrote_all);
+    (void)wrote_all;
+
+    /* Frees nothing if the buffer pointed into a static response */
+    aws_byte_buf_clean_up(&message->outgoing_head_buf);
+    message->outgoing_head_buf = new_buf;
+    message->head_len += header_line_len;
+}
+
+void aws_h1_encoder_message_add_connection_close(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator) {
+
+    aws_h1_encoder_message_add_header(
+        message, allocator, aws_byte_cursor_from_c_str("Connection"), aws_byte_cursor_from_c_str("close"));
+    message->has_connection_close_header = true;
+}
+
+void aws_h1_encoder_message_add_expect_continue(
+    struct aws_h1_encoder_message *message,
+    struct aws_allocator *allocator) {
+
+    aws_h1_encoder_message_add_header(
+        message, allocator, aws_byte_cursor_from_c_str("Expect"), aws_byte_cursor_from_c_str("100-continue"));
+    message->has_expect_continue_header = true;
+}
+
 void aws_h1_encoder_message_clean_up(struct aws_h1_encoder_message *message) {
     aws_input_stream_release(message->body);
     aws_byte_buf_clean_up(&message->outgoing_head_buf);
@@ -521,7 +818,7 @@ struct aws_h1_trailer *aws_h1_trailer_new(
     trailer->allocator = allocator;
 
     aws_byte_buf_init(&trailer->trailer_data, allocator, trailer_size); /* cannot fail */
-    s_write_headers(&trailer->trailer_data, trailing_headers);
+    s_write_headers(&trailer->trailer_data, trailing_headers, 0 /*first_header_index*/, false /*skip_content_length*/);
     s_write_crlf(&trailer->trailer_data); /* \r\n */
     return trailer;
 }
@@ -534,29 +831,103 @@ void aws_h1_trailer_destroy(struct aws_h1_trailer *trailer) {
     aws_mem_release(trailer->allocator, trailer);
 }
 
-struct aws_h1_chunk *aws_h1_chunk_new(struct aws_allocator *allocator, const struct aws_http1_chunk_options *options) {
-    /* Allocate chunk along with storage for the chunk-line */
-    struct aws_h1_chunk *chunk;
-    size_t chunk_line_size = s_calculate_chunk_line_size(options);
-    void *chunk_line_storage;
-    if (!aws_mem_acquire_many(
-            allocator, 2, &chunk, sizeof(struct aws_h1_chunk), &chunk_line_storage, chunk_line_size)) {
-        return NULL;
+int aws_h1_chunk_pool_init(struct aws_h1_chunk_pool *pool, struct aws_allocator *allocator, size_t max_free) {
+    AWS_ZERO_STRUCT(*pool);
+    pool->allocator = allocator;
+    pool->max_free = max_free;
+    aws_linked_list_init(&pool->free_list);
+    return aws_mutex_init(&pool->lock);
+}
+
+void aws_h1_chunk_pool_clean_up(struct aws_h1_chunk_pool *pool) {
+    while (!aws_linked_list_empty(&pool->free_list)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&pool->free_list);
+        struct aws_h1_chunk *chunk = AWS_CONTAINER_OF(node, struct aws_h1_chunk, node);
+        aws_mem_release(chunk->allocator, chunk);
+    }
+    aws_mutex_clean_up(&pool->lock);
+    AWS_ZERO_STRUCT(*pool);
+}
+
+/* Returns a chunk from the free list, or NULL if it's empty */
+static struct aws_h1_chunk *s_chunk_pool_acquire(struct aws_h1_chunk_pool *pool) {
+    struct aws_h1_chunk *chunk = NULL;
+
+    aws_mutex_lock(&pool->lock);
+    if (!aws_linked_list_empty(&pool->free_list)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&pool->free_list);
+        chunk = AWS_CONTAINER_OF(node, struct aws_h1_chunk, node);
+        pool->free_count--;
+    }
+    aws_mutex_unlock(&pool->lock);
+
+    return chunk;
+}
+
+/* Returns false if the pool is full, and the chunk should be freed instead */
+static bool s_chunk_pool_release(struct aws_h1_chunk_pool *pool, struct aws_h1_chunk *chunk) {
+    bool pooled = false;
+
+    aws_mutex_lock(&pool->lock);
+    if (pool->free_count < pool->max_free) {
+        aws_linked_list_push_back(&pool->free_list, &chunk->node);
+        pool->free_count++;
+        pooled = true;
+    }
+    aws_mutex_unlock(&pool->lock);
+
+    return pooled;
+}
+
+struct aws_h1_chunk *aws_h1_chunk_new(
+    struct aws_allocator *allocator,
+    struct aws_h1_chunk_pool *pool,
+    const struct aws_http1_chunk_options *options) {
+
+    /* Only chunks without extensions are pooled, since those all have the same size */
+    if (options->num_extensions > 0) {
+        pool = NULL;
+    }
+
+    struct aws_h1_chunk *chunk = pool ? s_chunk_pool_acquire(pool) : NULL;
+    if (chunk) {
+        /* Reuse the chunk-line storage that was allocated along with the chunk */
+        chunk->chunk_line.len = 0;
+    } else {
+        /* Allocate chunk along with storage for the chunk-line */
+        size_t chunk_line_size = s_calculate_chunk_line_size(options);
+        void *chunk_line_storage;
+        if (!aws_mem_acquire_many(
+                allocator, 2, &chunk, sizeof(struct aws_h1_chunk), &chunk_line_storage, chunk_line_size)) {
+            return NULL;
+        }
+        chunk->allocator = allocator;
+        chunk->chunk_line = aws_byte_buf_from_empty_array(chunk_line_storage, chunk_line_size);
     }
 
-    chunk->allocator = allocator;
+    chunk->pool = pool;
     chunk->data = aws_input_stream_acquire(options->chunk_data);
+    chunk->zero_copy_data = options->zero_copy_data;
     chunk->data_size = options->chunk_data_size;
     chunk->on_complete = options->on_complete;
     chunk->user_data = options->user_data;
-    chunk->chunk_line = aws_byte_buf_from_empty_array(chunk_line_storage, chunk_line_size);
-    s_populate_chunk_line_buffer(&chunk->chunk_line, options);
+
+    /* Extensions are caller-owned, so they must be copied now.
+     * Otherwise the line is just the chunk-size, which is written when the chunk is sent. */
+    if (options->num_extensions > 0) {
+        s_populate_chunk_line_buffer(&chunk->chunk_line, options);
+    }
     return chunk;
 }
 
 void aws_h1_chunk_destroy(struct aws_h1_chunk *chunk) {
     AWS_PRECONDITION(chunk);
     aws_input_stream_release(chunk->data);
+    chunk->data = NULL;
+
+    if (chunk->pool && s_chunk_pool_release(chunk->pool, chunk)) {
+        return;
+    }
     aws_mem_release(chunk->allocator, chunk);
 }
 
@@ -715,6 +1086,28 @@ static int s_state_fn_init(struct aws_h1_encoder *encoder, struct aws_byte_buf *
     return s_switch_state(encoder, AWS_H1_ENCODER_STATE_HEAD);
 }
 
+/* Whether anything follows the head */
+static bool s_has_body_to_send(const struct aws_h1_encoder_message *message) {
+    return message->has_chunked_body_stream || (message->body && message->content_length) ||
+           message->has_chunked_encoding_header;
+}
+
+/* Pick the state that sends the message's body, if it has one */
+static int s_switch_to_body_state(struct aws_h1_encoder *encoder) {
+    if (encoder->message->has_chunked_body_stream) {
+        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_CHUNKED_BODY_STREAM);
+
+    } else if (encoder->message->body && encoder->message->content_length) {
+        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_UNCHUNKED_BODY);
+
+    } else if (encoder->message->has_chunked_encoding_header) {
+        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_CHUNK_NEXT);
+
+    } else {
+        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_DONE);
+    }
+}
+
 /* Write out first line of request/response, plus all the headers.
  * These have been pre-encoded in aws_h1_encoder_message->outgoing_head_buf. */
 static int s_state_fn_head(struct aws_h1_encoder *encoder, struct aws_byte_buf *dst) {
@@ -727,20 +1120,31 @@ static int s_state_fn_head(struct aws_h1_encoder *encoder, struct aws_byte_buf *
     /* Don't NEED to free this buffer now, but we don't need it anymore, so why not */
     aws_byte_buf_clean_up(&encoder->message->outgoing_head_buf);
 
-    /* Pick next state */
-    if (encoder->message->body && encoder->message->content_length) {
-        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_UNCHUNKED_BODY);
+    if (encoder->message->has_expect_continue_header && s_has_body_to_send(encoder->message)) {
+        ENCODER_LOG(TRACE, encoder, "Holding back body until server responds with 100 (Continue).");
+        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_AWAIT_CONTINUE);
+    }
 
-    } else if (encoder->message->has_chunked_encoding_header) {
-        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_CHUNK_NEXT);
+    return s_switch_to_body_state(encoder);
+}
 
-    } else {
-        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_DONE);
-    }
+/* Stay in this state until aws_h1_encoder_end_wait_for_continue() is called */
+static int s_state_fn_await_continue(struct aws_h1_encoder *encoder, struct aws_byte_buf *dst) {
+    (void)encoder;
+    (void)dst;
+    return AWS_OP_SUCCESS;
 }
 
 /* Write out body (not using chunked encoding). */
 static int s_state_fn_unchunked_body(struct aws_h1_encoder *encoder, struct aws_byte_buf *dst) {
+    int file_fd;
+    uint64_t file_offset;
+    uint64_t file_remaining;
+    if (aws_h1_encoder_get_file_body(encoder, &file_fd, &file_offset, &file_remaining)) {
+        /* Remain in this state while the connection sends the body straight from the file */
+        return AWS_OP_SUCCESS;
+    }
+
     bool done;
     if (s_encode_stream(encoder, dst, encoder->message->body, encoder->message->content_length, &done)) {
         return AWS_OP_ERR;
@@ -755,6 +1159,90 @@ static int s_state_fn_unchunked_body(struct aws_h1_encoder *encoder, struct aws_
     return s_switch_state(encoder, AWS_H1_ENCODER_STATE_DONE);
 }
 
+/* Number of hex digits needed to write this value */
+static size_t s_hex_digit_count(size_t value) {
+    size_t count = 1;
+    while (value >>= 4) {
+        ++count;
+    }
+    return count;
+}
+
+/* Write out a body stream of unknown length, as a series of chunks.
+ * Each chunk is as big as the space left in dst, so space for its chunk-size line is reserved before reading.
+ * chunk-size is written with leading zeros to fill that space, which RFC-9112 7.1 allows. */
+static int s_state_fn_chunked_body_stream(struct aws_h1_encoder *encoder, struct aws_byte_buf *dst) {
+    const size_t space = dst->capacity - dst->len;
+    const size_t size_digits = s_hex_digit_count(space);
+    const size_t overhead = size_digits + CRLF_SIZE + CRLF_SIZE;
+    if (space <= overhead) {
+        /* Remain in this state until there's room for a chunk */
+        return AWS_OP_SUCCESS;
+    }
+
+    uint8_t *chunk_line = dst->buffer + dst->len;
+    struct aws_byte_buf chunk_data =
+        aws_byte_buf_from_empty_array(chunk_line + size_digits + CRLF_SIZE, space - overhead);
+
+    ENCODER_LOG(TRACE, encoder, "Reading from chunked body stream.");
+    if (aws_input_stream_read(encoder->message->body, &chunk_data)) {
+        ENCODER_LOGF(
+            ERROR,
+            encoder,
+            "Failed to read body stream, error %d (%s)",
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    if (chunk_data.len > 0) {
+        size_t chunk_size = chunk_data.len;
+        for (size_t i = size_digits; i > 0; --i) {
+            chunk_line[i - 1] = (uint8_t)"0123456789ABCDEF"[chunk_size & 0xF];
+            chunk_size >>= 4;
+        }
+        dst->len += size_digits;
+        s_write_crlf(dst);
+        dst->len += chunk_data.len;
+        s_write_crlf(dst);
+
+        encoder->progress_bytes += chunk_data.len;
+        encoder->chunk_count++;
+        ENCODER_LOGF(
+            TRACE,
+            encoder,
+            "Sent chunk %zu with size %zu, progress: %" PRIu64,
+            encoder->chunk_count,
+            chunk_data.len,
+            encoder->progress_bytes);
+
+        /* Remain in this state until the stream ends */
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_stream_status status;
+    if (aws_input_stream_get_status(encoder->message->body, &status)) {
+        ENCODER_LOGF(
+            TRACE,
+            encoder,
+            "Failed to query body stream status, error %d (%s)",
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+    if (!status.is_end_of_stream) {
+        /* Remain in this state. Maybe the data isn't ready yet */
+        return AWS_OP_SUCCESS;
+    }
+
+    /* last-chunk: "0" CRLF. The trailer follows */
+    ENCODER_LOG(TRACE, encoder, "Final chunk complete");
+    bool wrote_all = aws_byte_buf_write_u8(dst, '0') && s_write_crlf(dst);
+    AWS_ASSERT(wrote_all);
+    (void)wrote_all;
+    return s_switch_state(encoder, AWS_H1_ENCODER_STATE_CHUNK_TRAILER);
+}
+
 /* Select next chunk to work on.
  * Encoder is essentially "paused" here if no chunks are available. */
 static int s_state_fn_chunk_next(struct aws_h1_encoder *encoder, struct aws_byte_buf *dst) {
@@ -781,9 +1269,23 @@ static int s_state_fn_chunk_next(struct aws_h1_encoder *encoder, struct aws_byte
 }
 
 /* Write out "chunk-size [chunk-ext] CRLF".
- * This data is pre-encoded in the chunk's chunk_line buffer */
+ * If the chunk has extensions this data is pre-encoded in the chunk's chunk_line buffer.
+ * Otherwise it's written directly to dst, unless it won't fit and must be split across messages. */
 static int s_state_fn_chunk_line(struct aws_h1_encoder *encoder, struct aws_byte_buf *dst) {
-    bool done = s_encode_buf(encoder, dst, &encoder->current_chunk->chunk_line);
+    struct aws_h1_chunk *chunk = encoder->current_chunk;
+    bool done;
+    if (chunk->chunk_line.len == 0 && (dst->capacity - dst->len) >= MAX_ASCII_HEX_CHUNK_STR_SIZE + CRLF_SIZE) {
+        done = s_write_chunk_size(dst, chunk->data_size) && s_write_crlf(dst);
+        AWS_ASSERT(done);
+    } else {
+        if (chunk->chunk_line.len == 0) {
+            bool wrote_chunk_line = s_write_chunk_size(&chunk->chunk_line, chunk->data_size);
+            wrote_chunk_line &= s_write_crlf(&chunk->chunk_line);
+            AWS_ASSERT(wrote_chunk_line);
+            (void)wrote_chunk_line;
+        }
+        done = s_encode_buf(encoder, dst, &chunk->chunk_line);
+    }
     if (!done) {
         /* Remain in state until done writing line */
         return AWS_OP_SUCCESS;
@@ -804,6 +1306,16 @@ static int s_state_fn_chunk_line(struct aws_h1_encoder *encoder, struct aws_byte
 
 /* Write out data for current chunk */
 static int s_state_fn_chunk_body(struct aws_h1_encoder *encoder, struct aws_byte_buf *dst) {
+    if (encoder->current_chunk->zero_copy_data.len > 0) {
+        /* Zero-copy data is never written to dst, the connection takes it via aws_h1_encoder_take_zero_copy_data().
+         * Remain in this state until that happens. After that, we only run again once it's been sent. */
+        if (encoder->progress_bytes == 0) {
+            return AWS_OP_SUCCESS;
+        }
+
+        return s_switch_state(encoder, AWS_H1_ENCODER_STATE_CHUNK_END);
+    }
+
     bool done;
     if (s_encode_stream(encoder, dst, encoder->current_chunk->data, encoder->current_chunk->data_size, &done)) {
         int error_code = aws_last_error();
@@ -871,7 +1383,9 @@ struct encoder_state_def {
 static struct encoder_state_def s_encoder_states[] = {
     [AWS_H1_ENCODER_STATE_INIT] = {.fn = s_state_fn_init, .name = "INIT"},
     [AWS_H1_ENCODER_STATE_HEAD] = {.fn = s_state_fn_head, .name = "HEAD"},
+    [AWS_H1_ENCODER_STATE_AWAIT_CONTINUE] = {.fn = s_state_fn_await_continue, .name = "AWAIT_CONTINUE"},
     [AWS_H1_ENCODER_STATE_UNCHUNKED_BODY] = {.fn = s_state_fn_unchunked_body, .name = "BODY"},
+    [AWS_H1_ENCODER_STATE_CHUNKED_BODY_STREAM] = {.fn = s_state_fn_chunked_body_stream, .name = "CHUNKED_BODY_STREAM"},
     [AWS_H1_ENCODER_STATE_CHUNK_NEXT] = {.fn = s_state_fn_chunk_next, .name = "CHUNK_NEXT"},
     [AWS_H1_ENCODER_STATE_CHUNK_LINE] = {.fn = s_state_fn_chunk_line, .name = "CHUNK_LINE"},
     [AWS_H1_ENCODER_STATE_CHUNK_BODY] = {.fn = s_state_fn_chunk_body, .name = "CHUNK_BODY"},
@@ -891,6 +1405,7 @@ int aws_h1_encoder_process(struct aws_h1_encoder *encoder, struct aws_byte_buf *
 
     /* Run state machine until states stop changing. (due to out_buf running
      * out of space, input_stream stalling, waiting for more chunks, etc) */
+    size_t prev_len = out_buf->len;
     enum aws_h1_encoder_state prev_state;
     do {
         prev_state = encoder->state;
@@ -899,6 +1414,10 @@ int aws_h1_encoder_process(struct aws_h1_encoder *encoder, struct aws_byte_buf *
         }
     } while (prev_state != encoder->state);
 
+    /* Only one message is encoded per call, so everything written belongs to the current stream */
+    if (encoder->current_stream) {
+        encoder->current_stream->metrics.bytes_sent += out_buf->len - prev_len;
+    }
     return AWS_OP_SUCCESS;
 }
 
@@ -910,3 +1429,88 @@ bool aws_h1_encoder_is_waiting_for_chunks(const struct aws_h1_encoder *encoder)
     return encoder->state == AWS_H1_ENCODER_STATE_CHUNK_NEXT &&
            aws_linked_list_empty(encoder->message->pending_chunk_list);
 }
+
+bool aws_h1_encoder_is_waiting_for_continue(const struct aws_h1_encoder *encoder) {
+    return encoder->state == AWS_H1_ENCODER_STATE_AWAIT_CONTINUE;
+}
+
+void aws_h1_encoder_end_wait_for_continue(struct aws_h1_encoder *encoder, bool send_body) {
+    AWS_PRECONDITION(encoder->state == AWS_H1_ENCODER_STATE_AWAIT_CONTINUE);
+
+    if (send_body) {
+        ENCODER_LOG(TRACE, encoder, "Done waiting for 100 (Continue), sending body.");
+        s_switch_to_body_state(encoder);
+    } else {
+        /* Message is done */
+        ENCODER_LOG(TRACE, encoder, "Done waiting for 100 (Continue), body will not be sent.");
+        s_switch_state(encoder, AWS_H1_ENCODER_STATE_DONE);
+        s_state_fn_done(encoder, NULL);
+    }
+}
+
+bool aws_h1_encoder_take_zero_copy_data(
+    struct aws_h1_encoder *encoder,
+    struct aws_byte_cursor *out_data,
+    aws_http1_stream_write_chunk_complete_fn **out_on_complete,
+    void **out_user_data) {
+
+    if (encoder->state != AWS_H1_ENCODER_STATE_CHUNK_BODY || encoder->current_chunk->zero_copy_data.len == 0 ||
+        encoder->progress_bytes != 0) {
+        return false;
+    }
+
+    struct aws_h1_chunk *chunk = encoder->current_chunk;
+    *out_data = chunk->zero_copy_data;
+    encoder->progress_bytes = chunk->zero_copy_data.len;
+
+    /* The chunk's callback must not fire until the channel is done with the memory,
+     * which may be after the chunk itself is done (ex: stream completes early) */
+    *out_on_complete = chunk->on_complete;
+    *out_user_data = chunk->user_data;
+    chunk->on_complete = NULL;
+    chunk->user_data = NULL;
+
+    ENCODER_LOGF(TRACE, encoder, "Sending %zu bytes of chunk body without copying", out_data->len);
+    return true;
+}
+
+bool aws_h1_encoder_get_file_body(
+    const struct aws_h1_encoder *encoder,
+    int *out_fd,
+    uint64_t *out_offset,
+    uint64_t *out_remaining) {
+
+    if (!encoder->sends_file_bodies_directly || encoder->state != AWS_H1_ENCODER_STATE_UNCHUNKED_BODY) {
+        return false;
+    }
+
+    if (!aws_http_body_fd_stream_get_range(encoder->message->body, out_fd, out_offset, out_remaining)) {
+        return false;
+    }
+
+    /* Never send more than the Content-Length promised */
+    *out_remaining = aws_min_u64(*out_remaining, encoder->message->content_length - encoder->progress_bytes);
+    return true;
+}
+
+void aws_h1_encoder_on_file_body_sent(struct aws_h1_encoder *encoder, uint64_t bytes) {
+    AWS_PRECONDITION(encoder->state == AWS_H1_ENCODER_STATE_UNCHUNKED_BODY);
+    AWS_PRECONDITION(bytes <= encoder->message->content_length - encoder->progress_bytes);
+
+    aws_http_body_fd_stream_skip(encoder->message->body, bytes);
+    encoder->progress_bytes += bytes;
+
+    ENCODER_LOGF(
+        TRACE,
+        encoder,
+        "Sent %" PRIu64 " bytes of body from file, progress: %" PRIu64 "/%" PRIu64,
+        bytes,
+        encoder->progress_bytes,
+        encoder->message->content_length);
+
+    if (encoder->progress_bytes == encoder->message->content_length) {
+        /* Message is done */
+        s_switch_state(encoder, AWS_H1_ENCODER_STATE_DONE);
+        s_state_fn_done(encoder, NULL);
+    }
+}
@@ -4,8 +4,10 @@
  */
 #include <aws/http/private/h1_stream.h>
 
+#include <aws/http/private/content_encoding_stream.h>
 #include <aws/http/private/h1_connection.h>
 #include <aws/http/private/h1_encoder.h>
+#include <aws/http/private/tracing.h>
 
 #include <aws/http/status_code.h>
 #include <aws/io/logging.h>
@@ -16,7 +18,7 @@
 static void s_stream_destroy(struct aws_http_stream *stream_base) {
     struct aws_h1_stream *stream = AWS_CONTAINER_OF(stream_base, struct aws_h1_stream, base);
     AWS_ASSERT(
-        stream->synced_data.api_state != AWS_H1_STREAM_API_STATE_ACTIVE &&
+        aws_atomic_load_int(&stream->api_state) != AWS_H1_STREAM_API_STATE_ACTIVE &&
         "Stream should be complete (or never-activated) when stream destroyed");
     AWS_ASSERT(
         aws_linked_list_empty(&stream->thread_data.pending_chunk_list) &&
@@ -24,7 +26,12 @@ static void s_stream_destroy(struct aws_http_stream *stream_base) {
         "Chunks should be marked complete before stream destroyed");
 
     aws_h1_encoder_message_clean_up(&stream->encoder_message);
+    aws_http_static_response_release(stream->static_response);
     aws_byte_buf_clean_up(&stream->incoming_storage_buf);
+    aws_byte_buf_clean_up(&stream->incoming_content_coding);
+    if (stream->content_decoder) {
+        stream->content_decoder->vtable->destroy(stream->content_decoder);
+    }
     aws_mem_release(stream->base.alloc, stream);
 }
 
@@ -56,7 +63,7 @@ static void s_stream_cross_thread_work_task(struct aws_channel_task *task, void
 
     stream->synced_data.is_cross_thread_work_task_scheduled = false;
 
-    int api_state = stream->synced_data.api_state;
+    int api_state = (int)aws_atomic_load_int(&stream->api_state);
 
     bool found_chunks = !aws_linked_list_empty(&stream->synced_data.pending_chunk_list);
     aws_linked_list_move_all_back(&stream->thread_data.pending_chunk_list, &stream->synced_data.pending_chunk_list);
@@ -85,10 +92,14 @@ static void s_stream_cross_thread_work_task(struct aws_channel_task *task, void
         aws_h1_connection_try_write_outgoing_stream(connection);
     }
 
+    /* Decoded body that went beyond the window is paid back first */
+    const uint64_t debt_paid = aws_min_u64(stream->thread_data.stream_window_debt, pending_window_update);
+    stream->thread_data.stream_window_debt -= debt_paid;
+
     /* Add to window size using saturated sum to prevent overflow.
      * Saturating is fine because it's a u64, the stream could never receive that much data. */
     stream->thread_data.stream_window =
-        aws_add_u64_saturating(stream->thread_data.stream_window, pending_window_update);
+        aws_add_u64_saturating(stream->thread_data.stream_window, pending_window_update - debt_paid);
     if ((pending_window_update > 0) && (api_state == AWS_H1_STREAM_API_STATE_ACTIVE)) {
         /* Now that stream window is larger, connection might have buffered
          * data to send, or might need to increment its own window */
@@ -121,7 +132,7 @@ static void s_stream_update_window(struct aws_http_stream *stream_base, size_t i
             aws_add_u64_saturating(stream->synced_data.pending_window_update, increment_size);
 
         /* Don't alert the connection unless the stream is active */
-        if (stream->synced_data.api_state == AWS_H1_STREAM_API_STATE_ACTIVE) {
+        if (aws_atomic_load_int(&stream->api_state) == AWS_H1_STREAM_API_STATE_ACTIVE) {
             if (!stream->synced_data.is_cross_thread_work_task_scheduled) {
                 stream->synced_data.is_cross_thread_work_task_scheduled = true;
                 should_schedule_task = true;
@@ -145,13 +156,22 @@ static int s_stream_write_chunk(struct aws_http_stream *stream_base, const struc
     AWS_PRECONDITION(options);
     struct aws_h1_stream *stream = AWS_CONTAINER_OF(stream_base, struct aws_h1_stream, base);
 
-    if (options->chunk_data == NULL && options->chunk_data_size > 0) {
+    if (options->zero_copy_data.len > 0) {
+        if (options->chunk_data != NULL || options->chunk_data_size != options->zero_copy_data.len) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_STREAM,
+                "id=%p: Zero-copy chunk data cannot be combined with a data stream, and must match data size",
+                (void *)stream_base);
+            return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        }
+    } else if (options->chunk_data == NULL && options->chunk_data_size > 0) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_STREAM, "id=%p: Chunk data cannot be NULL if data size is non-zero", (void *)stream_base);
         return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
     }
 
-    struct aws_h1_chunk *chunk = aws_h1_chunk_new(stream_base->alloc, options);
+    struct aws_h1_chunk *chunk =
+        aws_h1_chunk_new(stream_base->alloc, &s_get_h1_connection(stream)->chunk_pool, options);
     if (AWS_UNLIKELY(NULL == chunk)) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_STREAM,
@@ -169,10 +189,10 @@ static int s_stream_write_chunk(struct aws_http_stream *stream_base, const struc
         s_stream_lock_synced_data(stream);
 
         /* Can only add chunks while stream is active. */
-        if (stream->synced_data.api_state != AWS_H1_STREAM_API_STATE_ACTIVE) {
-            error_code = (stream->synced_data.api_state == AWS_H1_STREAM_API_STATE_INIT)
-                             ? AWS_ERROR_HTTP_STREAM_NOT_ACTIVATED
-                             : AWS_ERROR_HTTP_STREAM_HAS_COMPLETED;
+        const size_t api_state = aws_atomic_load_int(&stream->api_state);
+        if (api_state != AWS_H1_STREAM_API_STATE_ACTIVE) {
+            error_code = (api_state == AWS_H1_STREAM_API_STATE_INIT) ? AWS_ERROR_HTTP_STREAM_NOT_ACTIVATED
+                                                                     : AWS_ERROR_HTTP_STREAM_HAS_COMPLETED;
             goto unlock;
         }
 
@@ -260,10 +280,10 @@ static int s_stream_add_trailer(struct aws_http_stream *stream_base, const struc
     { /* BEGIN CRITICAL SECTION */
         s_stream_lock_synced_data(stream);
         /* Can only add trailers while stream is active. */
-        if (stream->synced_data.api_state != AWS_H1_STREAM_API_STATE_ACTIVE) {
-            error_code = (stream->synced_data.api_state == AWS_H1_STREAM_API_STATE_INIT)
-                             ? AWS_ERROR_HTTP_STREAM_NOT_ACTIVATED
-                             : AWS_ERROR_HTTP_STREAM_HAS_COMPLETED;
+        const size_t api_state = aws_atomic_load_int(&stream->api_state);
+        if (api_state != AWS_H1_STREAM_API_STATE_ACTIVE) {
+            error_code = (api_state == AWS_H1_STREAM_API_STATE_INIT) ? AWS_ERROR_HTTP_STREAM_NOT_ACTIVATED
+                                                                     : AWS_ERROR_HTTP_STREAM_HAS_COMPLETED;
             goto unlock;
         }
 
@@ -325,6 +345,14 @@ static int s_stream_add_trailer(struct aws_http_stream *stream_base, const struc
     return AWS_OP_SUCCESS;
 }
 
+static struct aws_http1_incoming_body_ref *s_stream_retain_incoming_body(
+    struct aws_http_stream *stream_base,
+    struct aws_byte_cursor *data) {
+
+    struct aws_h1_stream *stream = AWS_CONTAINER_OF(stream_base, struct aws_h1_stream, base);
+    return aws_h1_connection_retain_incoming_body(s_get_h1_connection(stream), stream, data);
+}
+
 static const struct aws_http_stream_vtable s_stream_vtable = {
     .destroy = s_stream_destroy,
     .update_window = s_stream_update_window,
@@ -332,6 +360,7 @@ static const struct aws_http_stream_vtable s_stream_vtable = {
     .cancel = aws_h1_stream_cancel,
     .http1_write_chunk = s_stream_write_chunk,
     .http1_add_trailer = s_stream_add_trailer,
+    .http1_retain_incoming_body = s_stream_retain_incoming_body,
     .http2_reset_stream = NULL,
     .http2_get_received_error_code = NULL,
     .http2_get_sent_error_code = NULL,
@@ -368,18 +397,24 @@ static struct aws_h1_stream *s_stream_new_common(
     stream->base.metrics.receive_start_timestamp_ns = -1;
     stream->base.metrics.receive_end_timestamp_ns = -1;
     stream->base.metrics.receiving_duration_ns = -1;
+    stream->base.metrics.queue_start_timestamp_ns = -1;
+    stream->base.metrics.queue_duration_ns = -1;
+    stream->base.metrics.time_to_first_byte_ns = -1;
+    stream->base.metrics.time_to_headers_done_ns = -1;
 
     aws_channel_task_init(
         &stream->cross_thread_work_task, s_stream_cross_thread_work_task, stream, "http1_stream_cross_thread_work");
 
     aws_linked_list_init(&stream->thread_data.pending_chunk_list);
     aws_linked_list_init(&stream->synced_data.pending_chunk_list);
+    aws_atomic_init_int(&stream->api_state, AWS_H1_STREAM_API_STATE_INIT);
 
     stream->thread_data.stream_window = connection->initial_stream_window_size;
 
     /* Stream refcount starts at 1 for user and is incremented upon activation for the connection */
     aws_atomic_init_int(&stream->base.refcount, 1);
 
+    AWS_HTTP_PROBE2(stream__create, &stream->base, connection_base);
     return stream;
 }
 
@@ -406,27 +441,109 @@ struct aws_h1_stream *aws_h1_stream_new_request(
         }
     }
 
+    if (options->content_decoding) {
+        if (!options->content_decoding->new_decoder) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_STREAM, "id=static: Content decoding options must provide a new_decoder callback");
+            aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+            goto error;
+        }
+        stream->content_decoding = *options->content_decoding;
+        AWS_ZERO_STRUCT(stream->content_decoding.accept_encoding);
+
+        struct aws_http_headers *request_headers = aws_http_message_get_headers(options->request);
+        const struct aws_byte_cursor accept_encoding_name = aws_byte_cursor_from_c_str("Accept-Encoding");
+        if (options->content_decoding->accept_encoding.len > 0 &&
+            !aws_http_headers_has(request_headers, accept_encoding_name)) {
+            if (aws_http_headers_add(
+                    request_headers, accept_encoding_name, options->content_decoding->accept_encoding)) {
+                goto error;
+            }
+        }
+    }
+
     stream->base.client_data = &stream->base.client_or_server_data.client;
     stream->base.client_data->response_status = AWS_HTTP_STATUS_CODE_UNKNOWN;
     stream->base.client_data->response_first_byte_timeout_ms = options->response_first_byte_timeout_ms;
+    stream->base.client_data->request_timeout_ms = options->request_timeout_ms;
+    aws_h1_connection_init_stream_timers(stream);
     stream->base.on_metrics = options->on_metrics;
 
+    /* An encoded body's length isn't known in advance, so it's sent with chunked encoding */
+    struct aws_input_stream *encoded_body = NULL;
+    if (options->content_encoding) {
+        encoded_body =
+            aws_http_content_encoding_stream_new(client_connection->alloc, options->request, options->content_encoding);
+        if (!encoded_body) {
+            goto error;
+        }
+    }
+
     /* Validate request and cache info that the encoder will eventually need */
-    if (aws_h1_encoder_message_init_from_request(
+    int encoder_err;
+    if (client_connection->proxy_request_target_prefix.len > 0) {
+        encoder_err = aws_h1_encoder_message_init_from_proxied_request(
             &stream->encoder_message,
             client_connection->alloc,
             options->request,
-            &stream->thread_data.pending_chunk_list)) {
+            client_connection->proxy_request_target_prefix,
+            encoded_body,
+            &stream->thread_data.pending_chunk_list);
+        aws_input_stream_release(encoded_body);
+    } else if (encoded_body) {
+        encoder_err = aws_h1_encoder_message_init_from_request_with_chunked_body(
+            &stream->encoder_message,
+            client_connection->alloc,
+            options->request,
+            encoded_body,
+            &stream->thread_data.pending_chunk_list);
+        aws_input_stream_release(encoded_body);
+    } else {
+        encoder_err = aws_h1_encoder_message_init_from_request(
+            &stream->encoder_message,
+            client_connection->alloc,
+            options->request,
+            &stream->thread_data.pending_chunk_list);
+    }
+    if (encoder_err) {
         goto error;
     }
 
+    /* Headers for this stream go in the encoded head only, so the user's request can be sent again as it was */
+    if (options->content_encoding) {
+        aws_h1_encoder_message_add_header(
+            &stream->encoder_message,
+            client_connection->alloc,
+            aws_byte_cursor_from_c_str("Content-Encoding"),
+            options->content_encoding->content_coding);
+    }
+
+    /* Ask before uploading a large body, see aws_http1_connection_options.expect_continue_threshold */
+    struct aws_h1_connection *h1_connection = AWS_CONTAINER_OF(client_connection, struct aws_h1_connection, base);
+    if (h1_connection->expect_continue_threshold > 0 && !stream->encoder_message.has_expect_continue_header &&
+        stream->encoder_message.content_length >= h1_connection->expect_continue_threshold) {
+        aws_h1_encoder_message_add_expect_continue(&stream->encoder_message, client_connection->alloc);
+    }
+
     /* RFC-7230 Section 6.3: The "close" connection option is used to signal
      * that a connection will not persist after the current request/response*/
     if (stream->encoder_message.has_connection_close_header) {
         stream->is_final_stream = true;
     }
 
-    stream->synced_data.using_chunked_encoding = stream->encoder_message.has_chunked_encoding_header;
+    /* The user writes chunks, unless the encoder is sending a body stream as chunks */
+    stream->synced_data.using_chunked_encoding =
+        stream->encoder_message.has_chunked_encoding_header && !stream->encoder_message.has_chunked_body_stream;
+
+    /* RFC-7231 Section 4.2.2 */
+    struct aws_byte_cursor method;
+    AWS_ZERO_STRUCT(method);
+    aws_http_message_get_request_method(options->request, &method);
+    stream->is_idempotent = aws_byte_cursor_eq(&method, &aws_http_method_get) ||
+                            aws_byte_cursor_eq(&method, &aws_http_method_head) ||
+                            aws_byte_cursor_eq(&method, &aws_http_method_put) ||
+                            aws_byte_cursor_eq(&method, &aws_http_method_delete) ||
+                            aws_byte_cursor_eq(&method, &aws_http_method_options);
 
     return stream;
 
@@ -451,12 +568,13 @@ struct aws_h1_stream *aws_h1_stream_new_request_handler(const struct aws_http_re
     /* This code is only executed in server mode and can only be invoked from the event-loop thread so don't worry
      * with the lock here. */
     stream->base.id = aws_http_connection_get_next_stream_id(options->server_connection);
+    stream->base.metrics.connection_reuse_count = (stream->base.id - 1) / 2;
 
     /* Request-handler (server) streams don't need user to call activate() on them.
      * Since these these streams can only be created on the event-loop thread,
      * it's not possible for callbacks to fire before the stream pointer is returned.
      * (Clients must call stream.activate() because they might create a stream on any thread) */
-    stream->synced_data.api_state = AWS_H1_STREAM_API_STATE_ACTIVE;
+    aws_atomic_store_int(&stream->api_state, AWS_H1_STREAM_API_STATE_ACTIVE);
 
     stream->base.server_data = &stream->base.client_or_server_data.server;
     stream->base.server_data->on_request_done = options->on_request_done;
@@ -465,42 +583,34 @@ struct aws_h1_stream *aws_h1_stream_new_request_handler(const struct aws_http_re
     return stream;
 }
 
-int aws_h1_stream_send_response(struct aws_h1_stream *stream, struct aws_http_message *response) {
+/* Move the encoder_message into the stream. static_response is set if the message points into it */
+static int s_stream_send_encoder_message(
+    struct aws_h1_stream *stream,
+    struct aws_h1_encoder_message *encoder_message,
+    struct aws_http_static_response *static_response) {
+
     struct aws_h1_connection *connection = s_get_h1_connection(stream);
     int error_code = 0;
 
-    /* Validate the response and cache info that encoder will eventually need.
-     * The encoder_message object will be moved into the stream later while holding the lock */
-    struct aws_h1_encoder_message encoder_message;
-    bool body_headers_ignored = stream->base.request_method == AWS_HTTP_METHOD_HEAD;
-    if (aws_h1_encoder_message_init_from_response(
-            &encoder_message,
-            stream->base.alloc,
-            response,
-            body_headers_ignored,
-            &stream->thread_data.pending_chunk_list)) {
-        error_code = aws_last_error();
-        goto error;
-    }
-
     bool should_schedule_task = false;
     { /* BEGIN CRITICAL SECTION */
         s_stream_lock_synced_data(stream);
-        if (stream->synced_data.api_state == AWS_H1_STREAM_API_STATE_COMPLETE) {
+        if (aws_atomic_load_int(&stream->api_state) == AWS_H1_STREAM_API_STATE_COMPLETE) {
             error_code = AWS_ERROR_HTTP_STREAM_HAS_COMPLETED;
         } else if (stream->synced_data.has_outgoing_response) {
             AWS_LOGF_ERROR(AWS_LS_HTTP_STREAM, "id=%p: Response already created on the stream", (void *)&stream->base);
             error_code = AWS_ERROR_INVALID_STATE;
         } else {
             stream->synced_data.has_outgoing_response = true;
-            stream->encoder_message = encoder_message;
-            if (encoder_message.has_connection_close_header) {
+            stream->encoder_message = *encoder_message;
+            stream->static_response = aws_http_static_response_acquire(static_response);
+            if (encoder_message->has_connection_close_header) {
                 /* This will be the last stream connection will process, new streams will be rejected */
                 stream->is_final_stream = true;
 
-                /* Note: We're touching the connection's synced_data, which is OK
-                 * because an h1_connection and all its h1_streams share a single lock. */
-                connection->synced_data.new_stream_error_code = AWS_ERROR_HTTP_CONNECTION_CLOSED;
+                /* Note: Writers of the connection's new_stream_error_code hold its lock,
+                 * which is OK because an h1_connection and all its h1_streams share a single lock. */
+                aws_atomic_store_int(&connection->new_stream_error_code, AWS_ERROR_HTTP_CONNECTION_CLOSED);
             }
             stream->synced_data.using_chunked_encoding = stream->encoder_message.has_chunked_encoding_header;
 
@@ -539,6 +649,40 @@ error:
         error_code,
         aws_error_name(error_code));
 
-    aws_h1_encoder_message_clean_up(&encoder_message);
+    aws_h1_encoder_message_clean_up(encoder_message);
     return aws_raise_error(error_code);
 }
+
+int aws_h1_stream_send_response(struct aws_h1_stream *stream, struct aws_http_message *response) {
+    /* Validate the response and cache info that encoder will eventually need.
+     * The encoder_message object will be moved into the stream later while holding the lock */
+    struct aws_h1_encoder_message encoder_message;
+    bool body_headers_ignored = stream->base.request_method == AWS_HTTP_METHOD_HEAD;
+    if (aws_h1_encoder_message_init_from_response(
+            &encoder_message,
+            stream->base.alloc,
+            response,
+            body_headers_ignored,
+            &stream->thread_data.pending_chunk_list)) {
+        int error_code = aws_last_error();
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM,
+            "id=%p: Sending response on the stream failed, error %d (%s)",
+            (void *)&stream->base,
+            error_code,
+            aws_error_name(error_code));
+        return AWS_OP_ERR;
+    }
+
+    return s_stream_send_encoder_message(stream, &encoder_message, NULL /*static_response*/);
+}
+
+int aws_h1_stream_send_static_response(struct aws_h1_stream *stream, struct aws_http_static_response *response) {
+    /* Already validated and serialized, so there's nothing to allocate */
+    struct aws_h1_encoder_message encoder_message;
+    bool body_headers_ignored = stream->base.request_method == AWS_HTTP_METHOD_HEAD;
+    aws_h1_encoder_message_init_from_static_response(
+        &encoder_message, response, body_headers_ignored, &stream->thread_data.pending_chunk_list);
+
+    return s_stream_send_encoder_message(stream, &encoder_message, response);
+}
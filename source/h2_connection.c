@@ -8,7 +8,9 @@
 
 #include <aws/http/private/h2_decoder.h>
 #include <aws/http/private/h2_stream.h>
+#include <aws/http/private/server_admission.h>
 #include <aws/http/private/strutil.h>
+#include <aws/http/private/tracing.h>
 
 #include <aws/common/clock.h>
 #include <aws/common/logging.h>
@@ -55,6 +57,7 @@ static struct aws_http_stream *s_connection_make_request(
     const struct aws_http_make_request_options *options);
 static void s_connection_close(struct aws_http_connection *connection_base);
 static void s_connection_stop_new_request(struct aws_http_connection *connection_base);
+static void s_connection_drain(struct aws_http_connection *connection_base);
 static bool s_connection_is_open(const struct aws_http_connection *connection_base);
 static bool s_connection_new_requests_allowed(const struct aws_http_connection *connection_base);
 static void s_connection_update_window(struct aws_http_connection *connection_base, uint32_t increment_size);
@@ -88,11 +91,17 @@ static void s_connection_get_local_settings(
 static void s_connection_get_remote_settings(
     const struct aws_http_connection *connection_base,
     struct aws_http2_setting out_settings[AWS_HTTP2_SETTINGS_COUNT]);
+static size_t s_connection_get_hpack_memory_usage(const struct aws_http_connection *connection_base);
 
 static void s_cross_thread_work_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
 static void s_outgoing_frames_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
+static void s_write_batch_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
 static int s_encode_outgoing_frames_queue(struct aws_h2_connection *connection, struct aws_byte_buf *output);
-static int s_encode_data_from_outgoing_streams(struct aws_h2_connection *connection, struct aws_byte_buf *output);
+static int s_encode_data_from_outgoing_streams(
+    struct aws_h2_connection *connection,
+    struct aws_byte_buf *output,
+    struct aws_h2_stream **out_zero_copy_stream,
+    struct aws_h2_stream_data_write **out_zero_copy_write);
 static int s_record_closed_stream(
     struct aws_h2_connection *connection,
     uint32_t stream_id,
@@ -119,6 +128,13 @@ static struct aws_h2err s_decoder_on_headers_i(
     enum aws_http_header_name name_enum,
     enum aws_http_header_block block_type,
     void *userdata);
+static struct aws_h2err s_decoder_on_headers_batch(
+    uint32_t stream_id,
+    const struct aws_http_header *headers,
+    const enum aws_http_header_name *name_enums,
+    size_t num_headers,
+    enum aws_http_header_block block_type,
+    void *userdata);
 static struct aws_h2err s_decoder_on_headers_end(
     uint32_t stream_id,
     bool malformed,
@@ -168,8 +184,10 @@ static struct aws_http_connection_vtable s_h2_connection_vtable = {
     .make_request = s_connection_make_request,
     .new_server_request_handler_stream = NULL,
     .stream_send_response = NULL,
+    .stream_send_static_response = NULL,
     .close = s_connection_close,
     .stop_new_requests = s_connection_stop_new_request,
+    .drain = s_connection_drain,
     .is_open = s_connection_is_open,
     .new_requests_allowed = s_connection_new_requests_allowed,
     .update_window = s_connection_update_window,
@@ -180,11 +198,13 @@ static struct aws_http_connection_vtable s_h2_connection_vtable = {
     .get_received_goaway = s_connection_get_received_goaway,
     .get_local_settings = s_connection_get_local_settings,
     .get_remote_settings = s_connection_get_remote_settings,
+    .get_hpack_memory_usage = s_connection_get_hpack_memory_usage,
 };
 
 static const struct aws_h2_decoder_vtable s_h2_decoder_vtable = {
     .on_headers_begin = s_decoder_on_headers_begin,
     .on_headers_i = s_decoder_on_headers_i,
+    .on_headers_batch = s_decoder_on_headers_batch,
     .on_headers_end = s_decoder_on_headers_end,
     .on_push_promise_begin = s_decoder_on_push_promise,
     .on_data_begin = s_decoder_on_data_begin,
@@ -225,6 +245,169 @@ static void s_release_stream_and_connection_lock(struct aws_h2_stream *stream, s
     (void)err;
 }
 
+/* Initial slot count of active_streams. Must be a power of 2 */
+static const size_t s_active_streams_initial_capacity = 16;
+
+/* Marks a slot whose stream was removed, so probes for streams further along don't stop there */
+static uint8_t s_active_streams_removed_storage;
+#define REMOVED_STREAM_SLOT ((struct aws_h2_stream *)&s_active_streams_removed_storage)
+
+static size_t s_active_streams_home_slot(const struct aws_h2_active_streams *streams, uint32_t stream_id) {
+    /* Each side's stream-ids have the same parity, so halving puts consecutive streams in consecutive slots */
+    return (stream_id >> 1) & (streams->capacity - 1);
+}
+
+static int s_active_streams_init(struct aws_h2_active_streams *streams, struct aws_allocator *alloc) {
+    AWS_ZERO_STRUCT(*streams);
+    streams->slots = aws_mem_calloc(alloc, s_active_streams_initial_capacity, sizeof(struct aws_h2_stream *));
+    if (!streams->slots) {
+        return AWS_OP_ERR;
+    }
+    streams->capacity = s_active_streams_initial_capacity;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_active_streams_clean_up(struct aws_h2_active_streams *streams, struct aws_allocator *alloc) {
+    aws_mem_release(alloc, streams->slots);
+    AWS_ZERO_STRUCT(*streams);
+}
+
+/* Returns index of the stream's slot, or SIZE_MAX if not found */
+static size_t s_active_streams_find_slot(const struct aws_h2_active_streams *streams, uint32_t stream_id) {
+    /* The table always has NULL slots, so this loop ends */
+    const size_t mask = streams->capacity - 1;
+    for (size_t i = s_active_streams_home_slot(streams, stream_id);; i = (i + 1) & mask) {
+        struct aws_h2_stream *stream = streams->slots[i];
+        if (stream == NULL) {
+            return SIZE_MAX;
+        }
+        if (stream != REMOVED_STREAM_SLOT && stream->base.id == stream_id) {
+            return i;
+        }
+    }
+}
+
+static struct aws_h2_stream *s_active_streams_find(const struct aws_h2_active_streams *streams, uint32_t stream_id) {
+    size_t slot = s_active_streams_find_slot(streams, stream_id);
+    return slot == SIZE_MAX ? NULL : streams->slots[slot];
+}
+
+/* Put stream in first available slot, starting from its home slot. Returns whether a removed-marker was reused */
+static bool s_active_streams_place(struct aws_h2_active_streams *streams, struct aws_h2_stream *stream) {
+    const size_t mask = streams->capacity - 1;
+    for (size_t i = s_active_streams_home_slot(streams, stream->base.id);; i = (i + 1) & mask) {
+        if (streams->slots[i] == NULL || streams->slots[i] == REMOVED_STREAM_SLOT) {
+            bool reused = streams->slots[i] == REMOVED_STREAM_SLOT;
+            streams->slots[i] = stream;
+            return reused;
+        }
+    }
+}
+
+static int s_active_streams_rebuild(
+    struct aws_h2_active_streams *streams,
+    struct aws_allocator *alloc,
+    size_t new_capacity) {
+
+    struct aws_h2_stream **new_slots = aws_mem_calloc(alloc, new_capacity, sizeof(struct aws_h2_stream *));
+    if (!new_slots) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_h2_stream **old_slots = streams->slots;
+    size_t old_capacity = streams->capacity;
+    streams->slots = new_slots;
+    streams->capacity = new_capacity;
+    streams->removed_count = 0;
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old_slots[i] != NULL && old_slots[i] != REMOVED_STREAM_SLOT) {
+            s_active_streams_place(streams, old_slots[i]);
+        }
+    }
+
+    aws_mem_release(alloc, old_slots);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_active_streams_insert(
+    struct aws_h2_active_streams *streams,
+    struct aws_allocator *alloc,
+    struct aws_h2_stream *stream) {
+
+    AWS_PRECONDITION(s_active_streams_find(streams, stream->base.id) == NULL);
+
+    /* Keep at least half the slots NULL, so probes stay short.
+     * Rebuilding clears out removed-markers, only grow if the table is still more than a quarter full after that. */
+    if ((streams->count + streams->removed_count + 1) * 2 > streams->capacity) {
+        size_t new_capacity = streams->capacity;
+        if ((streams->count + 1) * 4 > streams->capacity) {
+            if (aws_mul_size_checked(new_capacity, 2, &new_capacity)) {
+                return AWS_OP_ERR;
+            }
+        }
+        if (s_active_streams_rebuild(streams, alloc, new_capacity)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    if (s_active_streams_place(streams, stream)) {
+        streams->removed_count--;
+    }
+    streams->count++;
+    return AWS_OP_SUCCESS;
+}
+
+/* Does nothing if stream isn't in the table */
+static void s_active_streams_remove(struct aws_h2_active_streams *streams, uint32_t stream_id) {
+    size_t slot = s_active_streams_find_slot(streams, stream_id);
+    if (slot != SIZE_MAX) {
+        streams->slots[slot] = REMOVED_STREAM_SLOT;
+        streams->count--;
+        streams->removed_count++;
+    }
+}
+
+/* Iterate streams by passing the same iter (starting at 0) until NULL is returned.
+ * It's safe to remove streams while iterating, but not to insert them. */
+static struct aws_h2_stream *s_active_streams_next(const struct aws_h2_active_streams *streams, size_t *iter) {
+    while (*iter < streams->capacity) {
+        struct aws_h2_stream *stream = streams->slots[(*iter)++];
+        if (stream != NULL && stream != REMOVED_STREAM_SLOT) {
+            return stream;
+        }
+    }
+    return NULL;
+}
+
+static void s_token_bucket_init(struct aws_h2_token_bucket *bucket, uint32_t tokens_per_second, uint32_t burst) {
+    bucket->tokens_per_second = tokens_per_second;
+    bucket->max_nano_tokens = (uint64_t)burst * AWS_TIMESTAMP_NANOS;
+    /* Start full. The first refill saturates, since last_refill_ns is 0 */
+    bucket->nano_tokens = bucket->max_nano_tokens;
+    bucket->last_refill_ns = 0;
+}
+
+/* Spend a token, returns false if there's none left */
+static bool s_token_bucket_spend(struct aws_h2_token_bucket *bucket, uint64_t now_ns) {
+    if (bucket->tokens_per_second == UINT32_MAX) {
+        return true;
+    }
+
+    if (now_ns > bucket->last_refill_ns) {
+        uint64_t refill = aws_mul_u64_saturating(now_ns - bucket->last_refill_ns, bucket->tokens_per_second);
+        bucket->nano_tokens =
+            aws_min_u64(aws_add_u64_saturating(bucket->nano_tokens, refill), bucket->max_nano_tokens);
+        bucket->last_refill_ns = now_ns;
+    }
+
+    if (bucket->nano_tokens < AWS_TIMESTAMP_NANOS) {
+        return false;
+    }
+    bucket->nano_tokens -= AWS_TIMESTAMP_NANOS;
+    return true;
+}
+
 static void s_add_time_measurement_to_stats(uint64_t start_ns, uint64_t end_ns, uint64_t *output_ms) {
     if (end_ns > start_ns) {
         *output_ms += aws_timestamp_convert(end_ns - start_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MILLIS, NULL);
@@ -294,6 +477,48 @@ void aws_h2_connection_shutdown_due_to_write_err(struct aws_h2_connection *conne
     }
 }
 
+/* Let other threads see how much memory HPACK is using */
+static void s_publish_hpack_memory_usage(struct aws_h2_connection *connection) {
+    size_t usage = aws_hpack_encoder_get_memory_usage(&connection->thread_data.encoder.hpack) +
+                   aws_h2_decoder_get_hpack_memory_usage(connection->thread_data.decoder);
+    if (usage != connection->thread_data.hpack_memory_usage) {
+        connection->thread_data.hpack_memory_usage = usage;
+        aws_atomic_store_int(&connection->synced_data.hpack_memory_usage, usage);
+    }
+}
+
+/* No streams have been active for lean_hpack_idle_ms, release HPACK memory until it's needed again */
+static void s_hpack_idle_timeout(struct aws_http_timer *timer, void *user_data) {
+    (void)timer;
+    struct aws_h2_connection *connection = user_data;
+
+    if (connection->thread_data.active_streams.count > 0) {
+        /* Re-armed when they're done */
+        return;
+    }
+
+    size_t usage_before = connection->thread_data.hpack_memory_usage;
+    /* Failure to shrink leaves the tables as they were, which is fine */
+    if (aws_hpack_encoder_trim(&connection->thread_data.encoder.hpack) ||
+        aws_h2_decoder_trim_hpack(connection->thread_data.decoder)) {
+        CONNECTION_LOGF(
+            WARN,
+            connection,
+            "Failed to trim HPACK memory, error %d (%s).",
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+    }
+    s_publish_hpack_memory_usage(connection);
+
+    CONNECTION_LOGF(
+        TRACE,
+        connection,
+        "Idle for %" PRIu64 "ms, trimmed HPACK memory from %zu to %zu bytes.",
+        connection->lean_hpack_idle_ms,
+        usage_before,
+        connection->thread_data.hpack_memory_usage);
+}
+
 /* Common new() logic for server & client */
 static struct aws_h2_connection *s_connection_new(
     struct aws_allocator *alloc,
@@ -320,17 +545,48 @@ static struct aws_h2_connection *s_connection_new(
 
     /* Connection window management */
     connection->conn_manual_window_management = http2_options->conn_manual_window_management;
+    connection->window_update_threshold_percent = aws_min_u32(http2_options->window_update_threshold_percent, 100);
+    connection->write_batch_target_size = http2_options->write_batch_target_size;
+    connection->write_batch_max_delay_ns = aws_timestamp_convert(
+        http2_options->write_batch_max_delay_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    connection->lean_hpack_idle_ms = http2_options->lean_hpack_idle_ms;
+    aws_http_timer_init(&connection->thread_data.hpack_idle_timer, s_hpack_idle_timeout, connection);
+    if (!manual_window_management) {
+        connection->bdp_max_window_size = aws_min_u32(http2_options->bdp_max_window_size, AWS_H2_WINDOW_UPDATE_MAX);
+    }
     connection->on_goaway_received = http2_options->on_goaway_received;
     connection->on_remote_settings_change = http2_options->on_remote_settings_change;
 
+    /* The floods these limit are aimed at servers, so clients only get the limits they ask for */
+    uint32_t max_stream_resets_per_second = http2_options->max_stream_resets_per_second;
+    if (max_stream_resets_per_second == 0) {
+        max_stream_resets_per_second = server ? AWS_HTTP2_DEFAULT_MAX_STREAM_RESETS_PER_SECOND : UINT32_MAX;
+    }
+    uint32_t max_control_frames_per_second = http2_options->max_control_frames_per_second;
+    if (max_control_frames_per_second == 0) {
+        max_control_frames_per_second = server ? AWS_HTTP2_DEFAULT_MAX_CONTROL_FRAMES_PER_SECOND : UINT32_MAX;
+    }
+    s_token_bucket_init(
+        &connection->thread_data.stream_reset_bucket,
+        max_stream_resets_per_second,
+        http2_options->stream_reset_burst ? http2_options->stream_reset_burst : AWS_HTTP2_DEFAULT_STREAM_RESET_BURST);
+    s_token_bucket_init(
+        &connection->thread_data.control_frame_bucket,
+        max_control_frames_per_second,
+        http2_options->control_frame_burst ? http2_options->control_frame_burst
+                                           : AWS_HTTP2_DEFAULT_CONTROL_FRAME_BURST);
+
     aws_channel_task_init(
         &connection->cross_thread_work_task, s_cross_thread_work_task, connection, "HTTP/2 cross-thread work");
 
     aws_channel_task_init(
         &connection->outgoing_frames_task, s_outgoing_frames_task, connection, "HTTP/2 outgoing frames");
 
+    aws_channel_task_init(&connection->write_batch_task, s_write_batch_task, connection, "HTTP/2 write batch");
+
     /* 1 refcount for user */
     aws_atomic_init_int(&connection->base.refcount, 1);
+    aws_atomic_init_int(&connection->base.health_score, AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX);
     uint32_t max_stream_id = AWS_H2_STREAM_ID_MAX;
     connection->synced_data.goaway_sent_last_stream_id = max_stream_id + 1;
     connection->synced_data.goaway_received_last_stream_id = max_stream_id + 1;
@@ -354,11 +610,13 @@ static struct aws_h2_connection *s_connection_new(
         goto error;
     }
 
-    if (aws_hash_table_init(
-            &connection->thread_data.active_streams_map, alloc, 8, aws_hash_ptr, aws_ptr_eq, NULL, NULL)) {
-
+    if (s_active_streams_init(&connection->thread_data.active_streams, alloc)) {
         CONNECTION_LOGF(
-            ERROR, connection, "Hashtable init error %d (%s).", aws_last_error(), aws_error_name(aws_last_error()));
+            ERROR,
+            connection,
+            "Active streams table init error %d (%s).",
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
         goto error;
     }
     size_t max_closed_streams = AWS_HTTP2_DEFAULT_MAX_CLOSED_STREAMS;
@@ -392,6 +650,7 @@ static struct aws_h2_connection *s_connection_new(
 
     connection->synced_data.is_open = true;
     connection->synced_data.new_stream_error_code = AWS_ERROR_SUCCESS;
+    aws_atomic_init_int(&connection->synced_data.hpack_memory_usage, 0);
 
     /* Create a new decoder */
     struct aws_h2_decoder_params params = {
@@ -413,16 +672,43 @@ static struct aws_h2_connection *s_connection_new(
             ERROR, connection, "Encoder init error %d (%s)", aws_last_error(), aws_error_name(aws_last_error()));
         goto error;
     }
+    connection->thread_data.frame_allocator = aws_small_block_allocator_new(alloc, false /*multi_threaded*/);
+    if (!connection->thread_data.frame_allocator) {
+        goto error;
+    }
+
+    /* Lean HPACK advertises a small table, unless the user picked a size */
+    bool add_lean_header_table_size = connection->lean_hpack_idle_ms != 0;
+    for (size_t i = 0; i < http2_options->num_initial_settings; ++i) {
+        if (http2_options->initial_settings_array[i].id == AWS_HTTP2_SETTINGS_HEADER_TABLE_SIZE) {
+            add_lean_header_table_size = false;
+        }
+    }
+    size_t num_initial_settings = http2_options->num_initial_settings + (add_lean_header_table_size ? 1 : 0);
+
     /* User data from connection base is not ready until the handler installed */
     connection->thread_data.init_pending_settings = s_new_pending_settings(
         connection->base.alloc,
-        http2_options->initial_settings_array,
-        http2_options->num_initial_settings,
+        NULL /*settings_array*/,
+        num_initial_settings,
         http2_options->on_initial_settings_completed,
         NULL /* user_data is set later... */);
     if (!connection->thread_data.init_pending_settings) {
         goto error;
     }
+    if (http2_options->num_initial_settings > 0) {
+        memcpy(
+            connection->thread_data.init_pending_settings->settings_array,
+            http2_options->initial_settings_array,
+            http2_options->num_initial_settings * sizeof(struct aws_http2_setting));
+    }
+    if (add_lean_header_table_size) {
+        connection->thread_data.init_pending_settings->settings_array[http2_options->num_initial_settings] =
+            (struct aws_http2_setting){
+                .id = AWS_HTTP2_SETTINGS_HEADER_TABLE_SIZE,
+                .value = AWS_HTTP2_LEAN_HPACK_HEADER_TABLE_SIZE,
+            };
+    }
     /* We enqueue the inital settings when handler get installed */
     return connection;
 
@@ -467,9 +753,7 @@ static void s_handler_destroy(struct aws_channel_handler *handler) {
     CONNECTION_LOG(TRACE, connection, "Destroying connection");
 
     /* No streams should be left in internal datastructures */
-    AWS_ASSERT(
-        !aws_hash_table_is_valid(&connection->thread_data.active_streams_map) ||
-        aws_hash_table_get_entry_count(&connection->thread_data.active_streams_map) == 0);
+    AWS_ASSERT(connection->thread_data.active_streams.count == 0);
 
     AWS_ASSERT(aws_linked_list_empty(&connection->thread_data.waiting_streams_list));
     AWS_ASSERT(aws_linked_list_empty(&connection->thread_data.stalled_window_streams_list));
@@ -483,6 +767,9 @@ static void s_handler_destroy(struct aws_channel_handler *handler) {
     AWS_ASSERT(aws_linked_list_empty(&connection->thread_data.pending_settings_queue));
 
     /* Clean up any unsent frames and structures */
+    if (connection->thread_data.write_batch_msg) {
+        aws_mem_release(connection->thread_data.write_batch_msg->allocator, connection->thread_data.write_batch_msg);
+    }
     struct aws_linked_list *outgoing_frames_queue = &connection->thread_data.outgoing_frames_queue;
     while (!aws_linked_list_empty(outgoing_frames_queue)) {
         struct aws_linked_list_node *node = aws_linked_list_pop_front(outgoing_frames_queue);
@@ -495,7 +782,10 @@ static void s_handler_destroy(struct aws_channel_handler *handler) {
     }
     aws_h2_decoder_destroy(connection->thread_data.decoder);
     aws_h2_frame_encoder_clean_up(&connection->thread_data.encoder);
-    aws_hash_table_clean_up(&connection->thread_data.active_streams_map);
+    if (connection->thread_data.frame_allocator) {
+        aws_small_block_allocator_destroy(connection->thread_data.frame_allocator);
+    }
+    s_active_streams_clean_up(&connection->thread_data.active_streams, connection->base.alloc);
     aws_cache_destroy(connection->thread_data.closed_streams);
     aws_mutex_clean_up(&connection->synced_data.lock);
     aws_mem_release(connection->base.alloc, connection);
@@ -580,6 +870,19 @@ static struct aws_h2_pending_goaway *s_new_pending_goaway(
     return pending_goaway;
 }
 
+/* Control frames the peer may be waiting on, which are never held back by write batching */
+static bool s_frame_is_urgent(const struct aws_h2_frame *frame) {
+    switch (frame->type) {
+        case AWS_H2_FRAME_T_PING:
+        case AWS_H2_FRAME_T_SETTINGS:
+        case AWS_H2_FRAME_T_RST_STREAM:
+        case AWS_H2_FRAME_T_GOAWAY:
+            return true;
+        default:
+            return false;
+    }
+}
+
 void aws_h2_connection_enqueue_outgoing_frame(struct aws_h2_connection *connection, struct aws_h2_frame *frame) {
     AWS_PRECONDITION(frame->type != AWS_H2_FRAME_T_DATA);
     AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
@@ -604,6 +907,15 @@ void aws_h2_connection_enqueue_outgoing_frame(struct aws_h2_connection *connecti
     } else {
         aws_linked_list_push_back(&connection->thread_data.outgoing_frames_queue, &frame->node);
     }
+
+    if (s_frame_is_urgent(frame) && connection->thread_data.write_batch_msg &&
+        !connection->thread_data.write_batch_has_urgent_frame) {
+        /* The peer may be timing this frame, so stop holding the batch and send it now */
+        CONNECTION_LOGF(
+            TRACE, connection, "Flushing held message for %s frame", aws_h2_frame_type_to_str(frame->type));
+        connection->thread_data.write_batch_has_urgent_frame = true;
+        aws_channel_schedule_task_now(connection->base.channel_slot->channel, &connection->outgoing_frames_task);
+    }
 }
 
 static void s_on_channel_write_complete(
@@ -635,6 +947,72 @@ static void s_on_channel_write_complete(
     aws_channel_schedule_task_now(channel, &connection->outgoing_frames_task);
 }
 
+/* An aws_io_message whose data is a slice of caller-owned memory from a zero-copy DATA write
+ * (see aws_http2_stream_write_data_options). It directly follows the message containing its frame prefix. */
+struct aws_h2_zero_copy_message {
+    struct aws_io_message base;
+    struct aws_h2_connection *connection;
+    struct aws_h2_stream *stream;
+    struct aws_h2_stream_data_write *write;
+};
+
+static void s_on_zero_copy_message_write_complete(
+    struct aws_channel *channel,
+    struct aws_io_message *message,
+    int err_code,
+    void *user_data) {
+
+    struct aws_h2_zero_copy_message *zero_copy_msg = user_data;
+    struct aws_h2_connection *connection = zero_copy_msg->connection;
+
+    /* The message is released by whoever invoked this callback, once it returns */
+    aws_h2_stream_on_zero_copy_data_written(zero_copy_msg->stream, zero_copy_msg->write, err_code);
+    s_on_channel_write_complete(channel, message, err_code, connection);
+}
+
+/* Send a zero-copy write's in-flight slice as its own aws_io_message, without copying */
+static int s_send_zero_copy_message(
+    struct aws_h2_connection *connection,
+    struct aws_h2_stream *stream,
+    struct aws_h2_stream_data_write *write) {
+
+    struct aws_h2_zero_copy_message *zero_copy_msg =
+        aws_mem_calloc(connection->base.alloc, 1, sizeof(struct aws_h2_zero_copy_message));
+
+    /* Releasing the message frees the whole struct, but not the memory it points to */
+    zero_copy_msg->base.allocator = connection->base.alloc;
+    zero_copy_msg->base.message_type = AWS_IO_MESSAGE_APPLICATION_DATA;
+    zero_copy_msg->base.message_data =
+        aws_byte_buf_from_array(write->zero_copy_in_flight.ptr, write->zero_copy_in_flight.len);
+    zero_copy_msg->base.on_completion = s_on_zero_copy_message_write_complete;
+    zero_copy_msg->base.user_data = zero_copy_msg;
+    zero_copy_msg->connection = connection;
+    zero_copy_msg->stream = stream;
+    zero_copy_msg->write = write;
+
+    CONNECTION_LOGF(
+        TRACE,
+        connection,
+        "Outgoing frames task sending zero-copy DATA payload of size %zu",
+        zero_copy_msg->base.message_data.len);
+
+    connection->thread_data.stats.zero_copy_bytes_written += zero_copy_msg->base.message_data.len;
+    if (aws_channel_slot_send_message(connection->base.channel_slot, &zero_copy_msg->base, AWS_CHANNEL_DIR_WRITE)) {
+        int error_code = aws_last_error();
+        CONNECTION_LOGF(
+            ERROR,
+            connection,
+            "Failed to send zero-copy channel message: %s. Closing connection.",
+            aws_error_name(error_code));
+
+        aws_h2_stream_on_zero_copy_data_written(stream, write, error_code);
+        aws_mem_release(zero_copy_msg->base.allocator, zero_copy_msg);
+        return aws_raise_error(error_code);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 static void s_outgoing_frames_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
     (void)task;
 
@@ -644,6 +1022,46 @@ static void s_outgoing_frames_task(struct aws_channel_task *task, void *arg, enu
 
     struct aws_h2_connection *connection = arg;
     s_write_outgoing_frames(connection, false /*first_try*/);
+    s_publish_hpack_memory_usage(connection);
+}
+
+/* Whether a batched message should wait for more frames: it's short of the target size, time remains,
+ * and it carries nothing the peer is waiting on */
+static bool s_should_hold_write_batch(
+    const struct aws_h2_connection *connection,
+    const struct aws_io_message *msg,
+    uint64_t now_ns) {
+
+    if (connection->thread_data.write_batch_has_urgent_frame) {
+        return false;
+    }
+
+    size_t target_size = aws_min_size(connection->write_batch_target_size, msg->message_data.capacity);
+    return msg->message_data.len < target_size && now_ns < connection->thread_data.write_batch_deadline_ns;
+}
+
+static void s_write_batch_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_h2_connection *connection = arg;
+    connection->thread_data.is_write_batch_task_scheduled = false;
+
+    if (status != AWS_TASK_STATUS_RUN_READY || !connection->thread_data.write_batch_msg) {
+        /* Batch was already sent */
+        return;
+    }
+
+    struct aws_channel *channel = connection->base.channel_slot->channel;
+    uint64_t now_ns = 0;
+    if (aws_channel_current_clock_time(channel, &now_ns) == AWS_OP_SUCCESS &&
+        now_ns < connection->thread_data.write_batch_deadline_ns) {
+        /* Task was scheduled for an earlier batch, wait for this one's deadline */
+        connection->thread_data.is_write_batch_task_scheduled = true;
+        aws_channel_schedule_task_future(
+            channel, &connection->write_batch_task, connection->thread_data.write_batch_deadline_ns);
+        return;
+    }
+
+    s_write_outgoing_frames(connection, false /*first_try*/);
 }
 
 static void s_write_outgoing_frames(struct aws_h2_connection *connection, bool first_try) {
@@ -658,13 +1076,17 @@ static void s_write_outgoing_frames(struct aws_h2_connection *connection, bool f
         return;
     }
 
+    /* Pick up the message being batched, if any */
+    struct aws_io_message *msg = connection->thread_data.write_batch_msg;
+    connection->thread_data.write_batch_msg = NULL;
+
     /* Determine whether there's work to do, and end task immediately if there's not.
      * Note that we stop writing DATA frames if the channel is trying to shut down */
     bool has_control_frames = !aws_linked_list_empty(outgoing_frames_queue);
     bool has_data_frames = !aws_linked_list_empty(outgoing_streams_list);
     bool may_write_data_frames = (connection->thread_data.window_size_peer > AWS_H2_MIN_WINDOW_SIZE) &&
                                  !connection->thread_data.channel_shutdown_waiting_for_goaway_to_be_written;
-    bool will_write = has_control_frames || (has_data_frames && may_write_data_frames);
+    bool will_write = has_control_frames || (has_data_frames && may_write_data_frames) || msg != NULL;
 
     if (!will_write) {
         if (!first_try) {
@@ -686,20 +1108,44 @@ static void s_write_outgoing_frames(struct aws_h2_connection *connection, bool f
         return;
     }
 
+    /* Don't hold anything back once shutdown is waiting on us */
+    bool batching = connection->write_batch_target_size != 0 &&
+                    !connection->thread_data.channel_shutdown_waiting_for_goaway_to_be_written;
+
     if (first_try) {
+        if (batching) {
+            /* Cork until the end of this tick, so frames queued by other tasks this tick share the message */
+            CONNECTION_LOG(TRACE, connection, "Starting outgoing frames task at end of tick");
+            aws_channel_schedule_task_now(channel_slot->channel, &connection->outgoing_frames_task);
+            return;
+        }
         CONNECTION_LOG(TRACE, connection, "Starting outgoing frames task");
     }
 
-    /* Acquire aws_io_message, that we will attempt to fill up */
-    struct aws_io_message *msg = aws_channel_slot_acquire_max_message_for_write(channel_slot);
-    if (AWS_UNLIKELY(!msg)) {
-        CONNECTION_LOG(ERROR, connection, "Failed to acquire message from pool, closing connection.");
+    /* Set if msg ends with the prefix of a zero-copy DATA frame, whose payload must be sent right after it */
+    struct aws_h2_stream *zero_copy_stream = NULL;
+    struct aws_h2_stream_data_write *zero_copy_write = NULL;
+
+    uint64_t now_ns = 0;
+    if (batching && aws_channel_current_clock_time(channel_slot->channel, &now_ns)) {
         goto error;
     }
 
-    /* Set up callback so we can send another message when this one completes */
-    msg->on_completion = s_on_channel_write_complete;
-    msg->user_data = connection;
+    if (!msg) {
+        /* Acquire aws_io_message, that we will attempt to fill up */
+        msg = aws_channel_slot_acquire_max_message_for_write(channel_slot);
+        if (AWS_UNLIKELY(!msg)) {
+            CONNECTION_LOG(ERROR, connection, "Failed to acquire message from pool, closing connection.");
+            goto error;
+        }
+
+        /* Set up callback so we can send another message when this one completes */
+        msg->on_completion = s_on_channel_write_complete;
+        msg->user_data = connection;
+
+        connection->thread_data.write_batch_deadline_ns = now_ns + connection->write_batch_max_delay_ns;
+        connection->thread_data.write_batch_has_urgent_frame = false;
+    }
 
     CONNECTION_LOGF(
         TRACE,
@@ -715,15 +1161,41 @@ static void s_write_outgoing_frames(struct aws_h2_connection *connection, bool f
     /* If outgoing_frames_queue emptied, and connection is running normally,
      * then write as many DATA frames from outgoing_streams_list as possible. */
     if (aws_linked_list_empty(outgoing_frames_queue) && may_write_data_frames) {
-        if (s_encode_data_from_outgoing_streams(connection, &msg->message_data)) {
+        if (s_encode_data_from_outgoing_streams(
+                connection, &msg->message_data, &zero_copy_stream, &zero_copy_write)) {
             goto error;
         }
     }
 
     if (msg->message_data.len) {
+        if (batching && !zero_copy_write && s_should_hold_write_batch(connection, msg, now_ns)) {
+            /* Wait for more frames to fill the message, but no longer than the batch's deadline */
+            CONNECTION_LOGF(
+                TRACE, connection, "Outgoing frames task holding message of size %zu", msg->message_data.len);
+            connection->thread_data.write_batch_msg = msg;
+            if (!connection->thread_data.is_write_batch_task_scheduled) {
+                connection->thread_data.is_write_batch_task_scheduled = true;
+                aws_channel_schedule_task_future(
+                    channel_slot->channel,
+                    &connection->write_batch_task,
+                    connection->thread_data.write_batch_deadline_ns);
+            }
+            return;
+        }
+
         /* Write message to channel.
          * outgoing_frames_task will resume when message completes. */
         CONNECTION_LOGF(TRACE, connection, "Outgoing frames task sending message of size %zu", msg->message_data.len);
+        connection->thread_data.stats.messages_written++;
+        connection->thread_data.stats.bytes_written += msg->message_data.len;
+        connection->thread_data.stats.message_capacity_written += msg->message_data.capacity;
+
+        if (zero_copy_write) {
+            /* The zero-copy payload is written after this message, so its completion resumes the task instead.
+             * If this message fails to write, the payload behind it fails too. */
+            msg->on_completion = NULL;
+            msg->user_data = NULL;
+        }
 
         if (aws_channel_slot_send_message(channel_slot, msg, AWS_CHANNEL_DIR_WRITE)) {
             CONNECTION_LOGF(
@@ -734,6 +1206,16 @@ static void s_write_outgoing_frames(struct aws_h2_connection *connection, bool f
 
             goto error;
         }
+
+        if (zero_copy_write) {
+            /* msg belongs to the channel now */
+            msg = NULL;
+            if (s_send_zero_copy_message(connection, zero_copy_stream, zero_copy_write)) {
+                /* The write was already informed of the failure */
+                zero_copy_write = NULL;
+                goto error;
+            }
+        }
     } else {
         /* Message is empty, warn that no work is being done and reschedule the task to try again next tick.
          * It's likely that body isn't ready, so body streaming function has no data to write yet.
@@ -749,6 +1231,10 @@ static void s_write_outgoing_frames(struct aws_h2_connection *connection, bool f
 error:;
     int error_code = aws_last_error();
 
+    if (zero_copy_write) {
+        aws_h2_stream_on_zero_copy_data_written(zero_copy_stream, zero_copy_write, error_code);
+    }
+
     if (msg) {
         aws_mem_release(msg->allocator, msg);
     }
@@ -756,6 +1242,19 @@ error:;
     aws_h2_connection_shutdown_due_to_write_err(connection, error_code);
 }
 
+/* Add the time a stream spent stalled on the peer's flow-control window to its metrics */
+static void s_stream_window_stall_end(struct aws_h2_stream *stream) {
+    if (stream->thread_data.window_stalled_timestamp_ns == 0) {
+        return;
+    }
+
+    uint64_t now_ns = 0;
+    aws_high_res_clock_get_ticks(&now_ns);
+    stream->base.metrics.flow_control_stalled_duration_ns +=
+        (int64_t)(now_ns - stream->thread_data.window_stalled_timestamp_ns);
+    stream->thread_data.window_stalled_timestamp_ns = 0;
+}
+
 /* Write as many frames from outgoing_frames_queue as possible (contains all non-DATA frames) */
 static int s_encode_outgoing_frames_queue(struct aws_h2_connection *connection, struct aws_byte_buf *output) {
 
@@ -797,6 +1296,23 @@ static int s_encode_outgoing_frames_queue(struct aws_h2_connection *connection,
             break;
         }
 
+        if (frame->type == AWS_H2_FRAME_T_HEADERS) {
+            /* The encoder remembers the header-block's length until the next one is encoded */
+            struct aws_h2_stream *stream =
+                s_active_streams_find(&connection->thread_data.active_streams, frame->stream_id);
+            if (stream) {
+                size_t encoded_len = connection->thread_data.encoder.header_block_len;
+                stream->base.metrics.header_bytes_sent_encoded += encoded_len;
+                stream->base.metrics.bytes_sent += encoded_len;
+            }
+        }
+
+        AWS_HTTP_PROBE3(h2__frame__sent, connection, frame->type, frame->stream_id);
+
+        if (s_frame_is_urgent(frame)) {
+            connection->thread_data.write_batch_has_urgent_frame = true;
+        }
+
         /* Done encoding frame, pop from queue and cleanup*/
         aws_linked_list_remove(frame_node);
         aws_h2_frame_destroy(frame);
@@ -806,8 +1322,36 @@ static int s_encode_outgoing_frames_queue(struct aws_h2_connection *connection,
     return AWS_OP_SUCCESS;
 }
 
-/* Write as many DATA frames from outgoing_streams_list as possible. */
-static int s_encode_data_from_outgoing_streams(struct aws_h2_connection *connection, struct aws_byte_buf *output) {
+/* Pop the stream that should send DATA next: the first stream at the most urgent level (RFC-9218 4).
+ * Order within a level comes from where streams are put back after sending, see below. */
+static struct aws_h2_stream *s_pop_next_outgoing_stream(struct aws_linked_list *outgoing_streams_list) {
+    AWS_PRECONDITION(!aws_linked_list_empty(outgoing_streams_list));
+
+    struct aws_h2_stream *next = NULL;
+    for (struct aws_linked_list_node *iter = aws_linked_list_begin(outgoing_streams_list);
+         iter != aws_linked_list_end(outgoing_streams_list);
+         iter = aws_linked_list_next(iter)) {
+
+        struct aws_h2_stream *stream = AWS_CONTAINER_OF(iter, struct aws_h2_stream, node);
+        if (next == NULL || stream->priority.urgency < next->priority.urgency) {
+            next = stream;
+            if (next->priority.urgency == 0) {
+                break;
+            }
+        }
+    }
+
+    aws_linked_list_remove(&next->node);
+    return next;
+}
+
+/* Write as many DATA frames from outgoing_streams_list as possible.
+ * Stops early if a zero-copy DATA frame's prefix was encoded, since its payload must directly follow output. */
+static int s_encode_data_from_outgoing_streams(
+    struct aws_h2_connection *connection,
+    struct aws_byte_buf *output,
+    struct aws_h2_stream **out_zero_copy_stream,
+    struct aws_h2_stream_data_write **out_zero_copy_write) {
 
     AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
     struct aws_linked_list *outgoing_streams_list = &connection->thread_data.outgoing_streams_list;
@@ -824,9 +1368,12 @@ static int s_encode_data_from_outgoing_streams(struct aws_h2_connection *connect
 
     int aws_error_code = 0;
 
-    /* We simply round-robin through streams, instead of using stream priority.
-     * Respecting priority is not required (RFC-7540 5.3), so we're ignoring it for now. This also keeps use safe
-     * from priority DOS attacks: https://cve.mitre.org/cgi-bin/cvename.cgi?name=CVE-2019-9513 */
+    /* Each DATA frame goes to the most urgent stream with data to send, using the priority the user gave the
+     * stream (RFC-9218 urgency and incremental), see s_pop_next_outgoing_stream().
+     * Streams of the same urgency take turns if incremental, otherwise each sends all its DATA before the next.
+     * The peer's PRIORITY frames and priority signals are ignored, which RFC-9113 5.3 allows. Our sending order
+     * is never dictated by the peer, which keeps us safe from priority DOS attacks:
+     * https://cve.mitre.org/cgi-bin/cvename.cgi?name=CVE-2019-9513 */
     while (!aws_linked_list_empty(outgoing_streams_list)) {
         if (connection->thread_data.window_size_peer <= AWS_H2_MIN_WINDOW_SIZE) {
             CONNECTION_LOGF(
@@ -846,15 +1393,17 @@ static int s_encode_data_from_outgoing_streams(struct aws_h2_connection *connect
             goto done;
         }
 
-        struct aws_linked_list_node *node = aws_linked_list_pop_front(outgoing_streams_list);
-        struct aws_h2_stream *stream = AWS_CONTAINER_OF(node, struct aws_h2_stream, node);
+        struct aws_h2_stream *stream = s_pop_next_outgoing_stream(outgoing_streams_list);
+        struct aws_linked_list_node *node = &stream->node;
 
         /* Ask stream to encode a data frame.
          * Stream may complete itself as a result of encoding its data,
          * in which case it will vanish from the connection's datastructures as a side-effect of this call.
          * But if stream has more data to send, push it back into the appropriate list. */
         int data_encode_status;
-        if (aws_h2_stream_encode_data_frame(stream, &connection->thread_data.encoder, output, &data_encode_status)) {
+        struct aws_h2_stream_data_write *zero_copy_write = NULL;
+        if (aws_h2_stream_encode_data_frame(
+                stream, &connection->thread_data.encoder, output, &data_encode_status, &zero_copy_write)) {
 
             aws_error_code = aws_last_error();
             CONNECTION_LOGF(
@@ -871,7 +1420,13 @@ static int s_encode_data_from_outgoing_streams(struct aws_h2_connection *connect
             case AWS_H2_DATA_ENCODE_COMPLETE:
                 break;
             case AWS_H2_DATA_ENCODE_ONGOING:
-                aws_linked_list_push_back(outgoing_streams_list, node);
+                /* Incremental streams take turns with others of the same urgency.
+                 * Non-incremental streams keep their turn until they're out of DATA */
+                if (stream->priority.incremental) {
+                    aws_linked_list_push_back(outgoing_streams_list, node);
+                } else {
+                    aws_linked_list_push_front(outgoing_streams_list, node);
+                }
                 break;
             case AWS_H2_DATA_ENCODE_ONGOING_BODY_STREAM_STALLED:
                 aws_linked_list_push_back(&stalled_streams_list, node);
@@ -880,8 +1435,13 @@ static int s_encode_data_from_outgoing_streams(struct aws_h2_connection *connect
                 stream->thread_data.waiting_for_writes = true;
                 aws_linked_list_push_back(waiting_streams_list, node);
                 break;
+            case AWS_H2_DATA_ENCODE_ONGOING_WAITING_FOR_BODY:
+                /* The stream moves itself back to outgoing_streams_list once the read completes */
+                aws_linked_list_push_back(waiting_streams_list, node);
+                break;
             case AWS_H2_DATA_ENCODE_ONGOING_WINDOW_STALLED:
                 aws_linked_list_push_back(stalled_window_streams_list, node);
+                aws_high_res_clock_get_ticks(&stream->thread_data.window_stalled_timestamp_ns);
                 AWS_H2_STREAM_LOG(
                     DEBUG,
                     stream,
@@ -892,6 +1452,12 @@ static int s_encode_data_from_outgoing_streams(struct aws_h2_connection *connect
                 CONNECTION_LOG(ERROR, connection, "Data encode status is invalid.");
                 aws_error_code = AWS_ERROR_INVALID_STATE;
         }
+
+        if (zero_copy_write) {
+            *out_zero_copy_stream = stream;
+            *out_zero_copy_write = zero_copy_write;
+            goto done;
+        }
     }
 
 done:
@@ -943,12 +1509,10 @@ struct aws_h2err s_get_active_stream_for_incoming_frame(
     *out_stream = NULL;
 
     /* Check active streams */
-    struct aws_hash_element *found = NULL;
-    const void *stream_id_key = (void *)(size_t)stream_id;
-    aws_hash_table_find(&connection->thread_data.active_streams_map, stream_id_key, &found);
+    struct aws_h2_stream *found = s_active_streams_find(&connection->thread_data.active_streams, stream_id);
     if (found) {
         /* Found it! return */
-        *out_stream = found->value;
+        *out_stream = found;
         return AWS_H2ERR_SUCCESS;
     }
 
@@ -984,6 +1548,7 @@ struct aws_h2err s_get_active_stream_for_incoming_frame(
 
     void *cached_value = NULL;
     /* Stream is closed, check whether it's legal for a few more frames to trickle in */
+    const void *stream_id_key = (void *)(size_t)stream_id;
     if (aws_cache_find(connection->thread_data.closed_streams, stream_id_key, &cached_value)) {
         return aws_h2err_from_last_error();
     }
@@ -1027,8 +1592,8 @@ struct aws_h2err s_get_active_stream_for_incoming_frame(
                     "Illegal to receive %s frame on stream id=%" PRIu32 " after RST_STREAM has been received",
                     aws_h2_frame_type_to_str(frame_type),
                     stream_id);
-                struct aws_h2_frame *rst_stream =
-                    aws_h2_frame_new_rst_stream(connection->base.alloc, stream_id, AWS_HTTP2_ERR_STREAM_CLOSED);
+                struct aws_h2_frame *rst_stream = aws_h2_frame_new_rst_stream(
+                    connection->thread_data.frame_allocator, stream_id, AWS_HTTP2_ERR_STREAM_CLOSED);
                 if (!rst_stream) {
                     CONNECTION_LOGF(
                         ERROR, connection, "Error creating RST_STREAM frame, %s", aws_error_name(aws_last_error()));
@@ -1078,6 +1643,29 @@ struct aws_h2err s_decoder_on_headers_begin(uint32_t stream_id, void *userdata)
     struct aws_h2_connection *connection = userdata;
 
     if (connection->base.server_data) {
+        struct aws_http_server_admission *admission = connection->base.server_data->admission;
+        if (admission && stream_id > connection->thread_data.latest_peer_initiated_stream_id) {
+            /* Streams beyond the last GOAWAY are ignored, the client will retry them elsewhere */
+            if (stream_id > connection->thread_data.goaway_sent_last_stream_id) {
+                connection->thread_data.latest_peer_initiated_stream_id = stream_id;
+                return AWS_H2ERR_SUCCESS;
+            }
+
+            struct aws_event_loop *loop = aws_channel_get_event_loop(connection->base.channel_slot->channel);
+            if (aws_http_server_admission_is_overloaded(admission, loop)) {
+                CONNECTION_LOGF(DEBUG, connection, "Server is overloaded, refusing stream id=%" PRIu32 "", stream_id);
+                connection->thread_data.latest_peer_initiated_stream_id = stream_id;
+
+                /* Graceful GOAWAY so the client stops opening streams here, then refuse this one */
+                s_send_goaway(connection, AWS_HTTP2_ERR_NO_ERROR, false /*allow_more_streams*/, NULL);
+                if (aws_h2_connection_send_rst_and_close_reserved_stream(
+                        connection, stream_id, AWS_HTTP2_ERR_REFUSED_STREAM)) {
+                    return aws_h2err_from_last_error();
+                }
+                return AWS_H2ERR_SUCCESS;
+            }
+        }
+
         /* Server would create new request-handler stream... */
         return aws_h2err_from_aws_code(AWS_ERROR_UNIMPLEMENTED);
     }
@@ -1124,6 +1712,33 @@ struct aws_h2err s_decoder_on_headers_i(
     return AWS_H2ERR_SUCCESS;
 }
 
+/* The decoder collects a HEADERS header-block's fields, so the stream is looked up and the user is called once */
+struct aws_h2err s_decoder_on_headers_batch(
+    uint32_t stream_id,
+    const struct aws_http_header *headers,
+    const enum aws_http_header_name *name_enums,
+    size_t num_headers,
+    enum aws_http_header_block block_type,
+    void *userdata) {
+
+    struct aws_h2_connection *connection = userdata;
+    struct aws_h2_stream *stream;
+    struct aws_h2err err =
+        s_get_active_stream_for_incoming_frame(connection, stream_id, AWS_H2_FRAME_T_HEADERS, &stream);
+    if (aws_h2err_failed(err)) {
+        return err;
+    }
+
+    if (stream) {
+        err = aws_h2_stream_on_decoder_headers_batch(stream, headers, name_enums, num_headers, block_type);
+        if (aws_h2err_failed(err)) {
+            return err;
+        }
+    }
+
+    return AWS_H2ERR_SUCCESS;
+}
+
 struct aws_h2err s_decoder_on_headers_end(
     uint32_t stream_id,
     bool malformed,
@@ -1139,6 +1754,13 @@ struct aws_h2err s_decoder_on_headers_end(
     }
 
     if (stream) {
+        AWS_HTTP_PROBE3(header__block__done, &stream->base, block_type, 1 /*is_http2*/);
+        uint64_t encoded_len = aws_h2_decoder_get_header_block_encoded_len(connection->thread_data.decoder);
+        stream->base.metrics.header_bytes_received += aws_h2_decoder_get_header_block_plain_len(
+            connection->thread_data.decoder);
+        stream->base.metrics.header_bytes_received_encoded += encoded_len;
+        stream->base.metrics.bytes_received += encoded_len;
+
         err = aws_h2_stream_on_decoder_headers_end(stream, malformed, block_type);
         if (aws_h2err_failed(err)) {
             return err;
@@ -1186,9 +1808,29 @@ struct aws_h2err s_decoder_on_push_promise(uint32_t stream_id, uint32_t promised
     return AWS_H2ERR_SUCCESS;
 }
 
-static int s_connection_send_update_window(struct aws_h2_connection *connection, uint32_t window_size) {
+bool aws_h2_connection_should_send_window_update(
+    const struct aws_h2_connection *connection,
+    int64_t window_size_self,
+    size_t window_update_pending) {
+
+    if (connection->window_update_threshold_percent == 0 || window_size_self <= 0) {
+        return true;
+    }
+
+    /* Send once the pending increment is at least threshold% of the full window (remaining + pending).
+     * Both values are bounded by a few times AWS_H2_WINDOW_UPDATE_MAX, so this can't overflow. */
+    uint64_t full_window = (uint64_t)window_size_self + window_update_pending;
+    return (uint64_t)window_update_pending * 100 >= full_window * connection->window_update_threshold_percent;
+}
+
+static int s_connection_flush_window_update(struct aws_h2_connection *connection) {
+    size_t window_size = connection->thread_data.window_update_pending;
+    if (window_size == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
     struct aws_h2_frame *connection_window_update_frame =
-        aws_h2_frame_new_window_update(connection->base.alloc, 0, window_size);
+        aws_h2_frame_new_window_update(connection->thread_data.frame_allocator, 0, (uint32_t)window_size);
     if (!connection_window_update_frame) {
         CONNECTION_LOGF(
             ERROR,
@@ -1198,7 +1840,137 @@ static int s_connection_send_update_window(struct aws_h2_connection *connection,
         return AWS_OP_ERR;
     }
     aws_h2_connection_enqueue_outgoing_frame(connection, connection_window_update_frame);
-    connection->thread_data.window_size_self += window_size;
+    AWS_HTTP_PROBE3(h2__window__update__sent, connection, 0 /*stream_id*/, window_size);
+    connection->thread_data.window_update_pending = 0;
+    /* Let our peer check for overflow, it will detect it for us. */
+    connection->thread_data.window_size_self =
+        aws_add_size_saturating(connection->thread_data.window_size_self, window_size);
+    return AWS_OP_SUCCESS;
+}
+
+/* Increment the connection's flow-control window.
+ * The WINDOW_UPDATE may be held back and merged with later increments, see window_update_threshold_percent */
+static int s_connection_send_update_window(struct aws_h2_connection *connection, size_t window_size) {
+    AWS_PRECONDITION(window_size <= AWS_H2_WINDOW_UPDATE_MAX);
+
+    if (connection->thread_data.window_update_pending + window_size > AWS_H2_WINDOW_UPDATE_MAX) {
+        if (s_connection_flush_window_update(connection)) {
+            return AWS_OP_ERR;
+        }
+    }
+    connection->thread_data.window_update_pending += window_size;
+
+    if (aws_h2_connection_should_send_window_update(
+            connection,
+            (int64_t)connection->thread_data.window_size_self,
+            connection->thread_data.window_update_pending)) {
+        return s_connection_flush_window_update(connection);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* The SETTINGS_INITIAL_WINDOW_SIZE that BDP estimation is currently growing from */
+static uint32_t s_bdp_current_window_size(const struct aws_h2_connection *connection) {
+    return aws_max_u32(
+        connection->thread_data.bdp.window_size,
+        connection->thread_data.settings_self[AWS_HTTP2_SETTINGS_INITIAL_WINDOW_SIZE]);
+}
+
+static int s_bdp_send_window_size(struct aws_h2_connection *connection, uint32_t window_size) {
+    struct aws_http2_setting setting = {.id = AWS_HTTP2_SETTINGS_INITIAL_WINDOW_SIZE, .value = window_size};
+    struct aws_h2_pending_settings *pending_settings =
+        s_new_pending_settings(connection->base.alloc, &setting, 1, NULL /*on_completed*/, NULL /*user_data*/);
+    if (!pending_settings) {
+        return AWS_OP_ERR;
+    }
+    struct aws_h2_frame *settings_frame =
+        aws_h2_frame_new_settings(connection->thread_data.frame_allocator, &setting, 1, false /*ACK*/);
+    if (!settings_frame) {
+        aws_mem_release(connection->base.alloc, pending_settings);
+        return AWS_OP_ERR;
+    }
+
+    /* The window changes once the peer ACKs, just like SETTINGS the user sends */
+    aws_linked_list_push_back(&connection->thread_data.pending_settings_queue, &pending_settings->node);
+    aws_h2_connection_enqueue_outgoing_frame(connection, settings_frame);
+    connection->thread_data.bdp.window_size = window_size;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_bdp_ping_complete(
+    struct aws_http_connection *connection_base,
+    uint64_t round_trip_time_ns,
+    int error_code,
+    void *user_data) {
+
+    (void)connection_base;
+    struct aws_h2_connection *connection = user_data;
+    connection->thread_data.bdp.ping_in_flight = false;
+    if (error_code) {
+        return;
+    }
+
+    /* If the peer sent close to a full window in one round trip, the window is what limits it. Double the window. */
+    uint64_t sample_bytes = connection->thread_data.bdp.sample_bytes;
+    uint32_t window_size = s_bdp_current_window_size(connection);
+    if (sample_bytes * 3 < (uint64_t)window_size * 2) {
+        return;
+    }
+    uint32_t new_window_size = (uint32_t)aws_min_u64(sample_bytes * 2, connection->bdp_max_window_size);
+    if (new_window_size <= window_size) {
+        return;
+    }
+
+    CONNECTION_LOGF(
+        DEBUG,
+        connection,
+        "Received %" PRIu64 " bytes in %" PRIu64 "ns round trip, growing stream window from %" PRIu32 " to %" PRIu32,
+        sample_bytes,
+        round_trip_time_ns,
+        window_size,
+        new_window_size);
+    if (s_bdp_send_window_size(connection, new_window_size)) {
+        CONNECTION_LOGF(
+            ERROR, connection, "Failed to send SETTINGS to grow window, error %s", aws_error_name(aws_last_error()));
+        aws_h2_connection_shutdown_due_to_write_err(connection, aws_last_error());
+    }
+}
+
+/* Count received DATA towards the BDP sample, starting a new sample with a PING if none is being measured */
+static int s_bdp_on_data_received(struct aws_h2_connection *connection, uint32_t payload_len) {
+    if (connection->bdp_max_window_size == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    if (!connection->thread_data.bdp.ping_in_flight) {
+        if (s_bdp_current_window_size(connection) >= connection->bdp_max_window_size) {
+            /* Reached the ceiling, no more measuring needed */
+            return AWS_OP_SUCCESS;
+        }
+
+        uint64_t time_stamp;
+        if (aws_high_res_clock_get_ticks(&time_stamp)) {
+            return AWS_OP_ERR;
+        }
+        struct aws_h2_pending_ping *pending_ping =
+            s_new_pending_ping(connection->base.alloc, NULL, time_stamp, connection, s_on_bdp_ping_complete);
+        if (!pending_ping) {
+            return AWS_OP_ERR;
+        }
+        struct aws_h2_frame *ping_frame =
+            aws_h2_frame_new_ping(connection->thread_data.frame_allocator, false /*ACK*/, pending_ping->opaque_data);
+        if (!ping_frame) {
+            aws_mem_release(connection->base.alloc, pending_ping);
+            return AWS_OP_ERR;
+        }
+
+        aws_linked_list_push_back(&connection->thread_data.pending_ping_queue, &pending_ping->node);
+        aws_h2_connection_enqueue_outgoing_frame(connection, ping_frame);
+        connection->thread_data.bdp.ping_in_flight = true;
+        connection->thread_data.bdp.sample_bytes = 0;
+    }
+
+    connection->thread_data.bdp.sample_bytes += payload_len;
     return AWS_OP_SUCCESS;
 }
 
@@ -1223,6 +1995,12 @@ struct aws_h2err s_decoder_on_data_begin(
         return aws_h2err_from_h2_code(AWS_HTTP2_ERR_FLOW_CONTROL_ERROR);
     }
 
+    if (s_bdp_on_data_received(connection, payload_len)) {
+        CONNECTION_LOGF(
+            ERROR, connection, "Failed to measure bandwidth-delay product, error %s", aws_error_name(aws_last_error()));
+        return aws_h2err_from_last_error();
+    }
+
     struct aws_h2_stream *stream;
     struct aws_h2err err = s_get_active_stream_for_incoming_frame(connection, stream_id, AWS_H2_FRAME_T_DATA, &stream);
     if (aws_h2err_failed(err)) {
@@ -1289,10 +2067,8 @@ struct aws_h2err s_decoder_on_end_stream(uint32_t stream_id, void *userdata) {
      * isn't an actual frame type. It's a flag on DATA or HEADERS frames, and we
      * already checked the legality of those frames in their respective callbacks. */
 
-    struct aws_hash_element *found = NULL;
-    aws_hash_table_find(&connection->thread_data.active_streams_map, (void *)(size_t)stream_id, &found);
-    if (found) {
-        struct aws_h2_stream *stream = found->value;
+    struct aws_h2_stream *stream = s_active_streams_find(&connection->thread_data.active_streams, stream_id);
+    if (stream) {
         struct aws_h2err err = aws_h2_stream_on_decoder_end_stream(stream);
         if (aws_h2err_failed(err)) {
             return err;
@@ -1302,9 +2078,43 @@ struct aws_h2err s_decoder_on_end_stream(uint32_t stream_id, void *userdata) {
     return AWS_H2ERR_SUCCESS;
 }
 
+/* Spend a token for a frame the peer sent, or fail with ENHANCE_YOUR_CALM if it's sending them too fast.
+ * This comes before any work is done for the frame, so a flood costs little more than decoding it */
+static struct aws_h2err s_spend_incoming_frame_token(
+    struct aws_h2_connection *connection,
+    struct aws_h2_token_bucket *bucket,
+    enum aws_h2_frame_type frame_type) {
+
+    uint64_t now_ns = 0;
+    aws_channel_current_clock_time(connection->base.channel_slot->channel, &now_ns);
+    if (s_token_bucket_spend(bucket, now_ns)) {
+        return AWS_H2ERR_SUCCESS;
+    }
+
+    CONNECTION_LOGF(
+        ERROR,
+        connection,
+        "Peer is sending %s frames too fast, closing connection",
+        aws_h2_frame_type_to_str(frame_type));
+    connection->thread_data.stats.flood_detected = true;
+    return aws_h2err_from_h2_code(AWS_HTTP2_ERR_ENHANCE_YOUR_CALM);
+}
+
 static struct aws_h2err s_decoder_on_rst_stream(uint32_t stream_id, uint32_t h2_error_code, void *userdata) {
     struct aws_h2_connection *connection = userdata;
 
+    ++connection->thread_data.stats.stream_resets_received;
+
+    /* Only resets of streams still in progress are charged. That's what a rapid reset attack sends,
+     * while a peer may reset every stream once its response is complete, which costs nothing */
+    if (s_active_streams_find(&connection->thread_data.active_streams, stream_id) != NULL) {
+        struct aws_h2err err = s_spend_incoming_frame_token(
+            connection, &connection->thread_data.stream_reset_bucket, AWS_H2_FRAME_T_RST_STREAM);
+        if (aws_h2err_failed(err)) {
+            return err;
+        }
+    }
+
     /* Pass RST_STREAM to stream */
     struct aws_h2_stream *stream;
     struct aws_h2err err =
@@ -1323,6 +2133,23 @@ static struct aws_h2err s_decoder_on_rst_stream(uint32_t stream_id, uint32_t h2_
     return AWS_H2ERR_SUCCESS;
 }
 
+/* Fold a PING round trip into the connection's RTT statistics, same as TCP's RTO estimator (RFC-6298 2) */
+static void s_record_rtt_sample(struct aws_h2_connection *connection, uint64_t rtt) {
+    struct aws_crt_statistics_http2_channel *stats = &connection->thread_data.stats;
+    if (stats->smoothed_rtt_ns == 0) {
+        stats->smoothed_rtt_ns = rtt;
+        stats->rtt_variance_ns = rtt / 2;
+        stats->min_rtt_ns = rtt;
+        return;
+    }
+
+    uint64_t deviation = rtt > stats->smoothed_rtt_ns ? rtt - stats->smoothed_rtt_ns : stats->smoothed_rtt_ns - rtt;
+    /* RTTVAR = 3/4 * RTTVAR + 1/4 * |SRTT - R'|, then SRTT = 7/8 * SRTT + 1/8 * R' */
+    stats->rtt_variance_ns = stats->rtt_variance_ns - stats->rtt_variance_ns / 4 + deviation / 4;
+    stats->smoothed_rtt_ns = stats->smoothed_rtt_ns - stats->smoothed_rtt_ns / 8 + rtt / 8;
+    stats->min_rtt_ns = aws_min_u64(stats->min_rtt_ns, rtt);
+}
+
 static struct aws_h2err s_decoder_on_ping_ack(uint8_t opaque_data[AWS_HTTP2_PING_DATA_SIZE], void *userdata) {
     struct aws_h2_connection *connection = userdata;
     if (aws_linked_list_empty(&connection->thread_data.pending_ping_queue)) {
@@ -1359,6 +2186,7 @@ static struct aws_h2err s_decoder_on_ping_ack(uint8_t opaque_data[AWS_HTTP2_PING
         goto error;
     }
     CONNECTION_LOGF(TRACE, connection, "Round trip time is %lf ms, approximately", (double)rtt / 1000000);
+    s_record_rtt_sample(connection, rtt);
     /* fire the callback */
     if (pending_ping->on_completed) {
         pending_ping->on_completed(&connection->base, rtt, AWS_ERROR_SUCCESS, pending_ping->user_data);
@@ -1376,8 +2204,16 @@ error:
 static struct aws_h2err s_decoder_on_ping(uint8_t opaque_data[AWS_HTTP2_PING_DATA_SIZE], void *userdata) {
     struct aws_h2_connection *connection = userdata;
 
+    ++connection->thread_data.stats.control_frames_received;
+    struct aws_h2err err = s_spend_incoming_frame_token(
+        connection, &connection->thread_data.control_frame_bucket, AWS_H2_FRAME_T_PING);
+    if (aws_h2err_failed(err)) {
+        return err;
+    }
+
     /* send a PING frame with the ACK flag set in response, with an identical payload. */
-    struct aws_h2_frame *ping_ack_frame = aws_h2_frame_new_ping(connection->base.alloc, true, opaque_data);
+    struct aws_h2_frame *ping_ack_frame =
+        aws_h2_frame_new_ping(connection->thread_data.frame_allocator, true, opaque_data);
     if (!ping_ack_frame) {
         CONNECTION_LOGF(
             ERROR, connection, "Ping ACK frame failed to be sent, error %s", aws_error_name(aws_last_error()));
@@ -1393,11 +2229,19 @@ static struct aws_h2err s_decoder_on_settings(
     size_t num_settings,
     void *userdata) {
     struct aws_h2_connection *connection = userdata;
-    struct aws_h2err err;
+
+    ++connection->thread_data.stats.control_frames_received;
+    struct aws_h2err err = s_spend_incoming_frame_token(
+        connection, &connection->thread_data.control_frame_bucket, AWS_H2_FRAME_T_SETTINGS);
+    if (aws_h2err_failed(err)) {
+        return err;
+    }
+
     /* Once all values have been processed, the recipient MUST immediately emit a SETTINGS frame with the ACK flag
      * set.(RFC-7540 6.5.3) */
     CONNECTION_LOG(TRACE, connection, "Setting frame processing ends");
-    struct aws_h2_frame *settings_ack_frame = aws_h2_frame_new_settings(connection->base.alloc, NULL, 0, true);
+    struct aws_h2_frame *settings_ack_frame =
+        aws_h2_frame_new_settings(connection->thread_data.frame_allocator, NULL, 0, true);
     if (!settings_ack_frame) {
         CONNECTION_LOGF(
             ERROR, connection, "Settings ACK frame failed to be sent, error %s", aws_error_name(aws_last_error()));
@@ -1419,6 +2263,24 @@ static struct aws_h2err s_decoder_on_settings(
     /* Apply the change to encoder and connection */
     struct aws_h2_frame_encoder *encoder = &connection->thread_data.encoder;
     for (size_t i = 0; i < num_settings; i++) {
+        if (settings_array[i].id == AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL) {
+            /* Not part of settings_peer[], see aws_http2_settings_id */
+            bool enable = settings_array[i].value == 1;
+            if (enable == connection->thread_data.peer_enables_connect_protocol) {
+                continue;
+            }
+            if (!enable) {
+                CONNECTION_LOG(
+                    ERROR,
+                    connection,
+                    "Connection error, peer disabled SETTINGS_ENABLE_CONNECT_PROTOCOL after enabling it");
+                err = aws_h2err_from_h2_code(AWS_HTTP2_ERR_PROTOCOL_ERROR);
+                goto error;
+            }
+            connection->thread_data.peer_enables_connect_protocol = true;
+            callback_array[callback_array_num++] = settings_array[i];
+            continue;
+        }
         if (connection->thread_data.settings_peer[settings_array[i].id] == settings_array[i].value) {
             /* No change, don't do any work */
             continue;
@@ -1432,10 +2294,9 @@ static struct aws_h2err s_decoder_on_settings(
                  * flow-control windows that it maintains by the difference between the new value and the old value. */
                 int32_t size_changed =
                     settings_array[i].value - connection->thread_data.settings_peer[settings_array[i].id];
-                struct aws_hash_iter stream_iter = aws_hash_iter_begin(&connection->thread_data.active_streams_map);
-                while (!aws_hash_iter_done(&stream_iter)) {
-                    struct aws_h2_stream *stream = stream_iter.element.value;
-                    aws_hash_iter_next(&stream_iter);
+                size_t stream_iter = 0;
+                struct aws_h2_stream *stream;
+                while ((stream = s_active_streams_next(&connection->thread_data.active_streams, &stream_iter))) {
                     err = aws_h2_stream_window_size_change(stream, size_changed, false /*self*/);
                     if (aws_h2err_failed(err)) {
                         CONNECTION_LOG(
@@ -1492,6 +2353,10 @@ static struct aws_h2err s_decoder_on_settings_ack(void *userdata) {
     /* Apply the settings */
     struct aws_h2_decoder *decoder = connection->thread_data.decoder;
     for (size_t i = 0; i < pending_settings->num_settings; i++) {
+        if (settings_array[i].id == AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL) {
+            /* Only affects what the peer may send, and isn't part of settings_self[] */
+            continue;
+        }
         if (connection->thread_data.settings_self[settings_array[i].id] == settings_array[i].value) {
             /* No change, don't do any work */
             continue;
@@ -1508,10 +2373,9 @@ static struct aws_h2err s_decoder_on_settings_ack(void *userdata) {
                  * flow-control windows that it maintains by the difference between the new value and the old value. */
                 int32_t size_changed =
                     settings_array[i].value - connection->thread_data.settings_self[settings_array[i].id];
-                struct aws_hash_iter stream_iter = aws_hash_iter_begin(&connection->thread_data.active_streams_map);
-                while (!aws_hash_iter_done(&stream_iter)) {
-                    struct aws_h2_stream *stream = stream_iter.element.value;
-                    aws_hash_iter_next(&stream_iter);
+                size_t stream_iter = 0;
+                struct aws_h2_stream *stream;
+                while ((stream = s_active_streams_next(&connection->thread_data.active_streams, &stream_iter))) {
                     err = aws_h2_stream_window_size_change(stream, size_changed, true /*self*/);
                     if (aws_h2err_failed(err)) {
                         CONNECTION_LOG(
@@ -1560,6 +2424,7 @@ error:
 
 static struct aws_h2err s_decoder_on_window_update(uint32_t stream_id, uint32_t window_size_increment, void *userdata) {
     struct aws_h2_connection *connection = userdata;
+    AWS_HTTP_PROBE3(h2__window__update__received, connection, stream_id, window_size_increment);
 
     if (stream_id == 0) {
         /* Let's update the connection flow-control window size */
@@ -1610,6 +2475,7 @@ static struct aws_h2err s_decoder_on_window_update(uint32_t stream_id, uint32_t
                     stream->thread_data.window_size_peer);
                 aws_linked_list_remove(&stream->node);
                 aws_linked_list_push_back(&connection->thread_data.outgoing_streams_list, &stream->node);
+                s_stream_window_stall_end(stream);
             }
         }
     }
@@ -1653,10 +2519,9 @@ struct aws_h2err s_decoder_on_goaway(
     /* Complete activated streams whose id is higher than last_stream, since they will not process by peer. We should
      * treat them as they had never been created at all.
      * This would be more efficient if we could iterate streams in reverse-id order */
-    struct aws_hash_iter stream_iter = aws_hash_iter_begin(&connection->thread_data.active_streams_map);
-    while (!aws_hash_iter_done(&stream_iter)) {
-        struct aws_h2_stream *stream = stream_iter.element.value;
-        aws_hash_iter_next(&stream_iter);
+    size_t stream_iter = 0;
+    struct aws_h2_stream *stream;
+    while ((stream = s_active_streams_next(&connection->thread_data.active_streams, &stream_iter))) {
         if (stream->base.id > last_stream) {
             AWS_H2_STREAM_LOG(
                 DEBUG,
@@ -1761,6 +2626,7 @@ static void s_handler_installed(struct aws_channel_handler *handler, struct aws_
         /* enqueue the windows update frame here */
         aws_linked_list_push_back(
             &connection->thread_data.outgoing_frames_queue, &connection_window_update_frame->node);
+        AWS_HTTP_PROBE3(h2__window__update__sent, connection, 0 /*stream_id*/, initial_window_update_size);
         connection->thread_data.window_size_self += initial_window_update_size;
     }
     aws_h2_try_write_outgoing_frames(connection);
@@ -1785,13 +2651,19 @@ static void s_stream_complete(struct aws_h2_connection *connection, struct aws_h
         AWS_H2_STREAM_LOG(DEBUG, stream, "Server stream complete");
     }
 
-    /* Remove stream from active_streams_map and outgoing_stream_list (if it was in them at all) */
-    aws_hash_table_remove(&connection->thread_data.active_streams_map, (void *)(size_t)stream->base.id, NULL, NULL);
+    ++connection->thread_data.stats.streams_completed;
+    if (error_code != AWS_ERROR_SUCCESS) {
+        ++connection->thread_data.stats.streams_failed;
+    }
+
+    /* Remove stream from active_streams and outgoing_stream_list (if it was in them at all) */
+    s_active_streams_remove(&connection->thread_data.active_streams, stream->base.id);
     if (stream->node.next) {
         aws_linked_list_remove(&stream->node);
     }
+    s_stream_window_stall_end(stream);
 
-    if (aws_hash_table_get_entry_count(&connection->thread_data.active_streams_map) == 0 &&
+    if (connection->thread_data.active_streams.count == 0 &&
         connection->thread_data.incoming_timestamp_ns != 0) {
         uint64_t now_ns = 0;
         aws_channel_current_clock_time(connection->base.channel_slot->channel, &now_ns);
@@ -1804,6 +2676,28 @@ static void s_stream_complete(struct aws_h2_connection *connection, struct aws_h
         connection->thread_data.incoming_timestamp_ns = 0;
     }
 
+    /* Connection just went idle, trim HPACK memory if it stays that way */
+    if (connection->thread_data.active_streams.count == 0 && connection->lean_hpack_idle_ms != 0 &&
+        !connection->thread_data.is_reading_stopped) {
+        struct aws_event_loop *event_loop = aws_channel_get_event_loop(connection->base.channel_slot->channel);
+        uint64_t idle_ns =
+            aws_timestamp_convert(connection->lean_hpack_idle_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+        if (aws_http_event_loop_timer_arm(event_loop, &connection->thread_data.hpack_idle_timer, idle_ns)) {
+            CONNECTION_LOGF(
+                WARN,
+                connection,
+                "Failed to arm HPACK idle timer, error %d (%s).",
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+        }
+    }
+
+    /* The last stream of a draining connection is done */
+    if (connection->thread_data.is_draining && connection->thread_data.active_streams.count == 0) {
+        CONNECTION_LOG(DEBUG, connection, "Draining connection has no more active streams, closing.");
+        s_connection_close(&connection->base);
+    }
+
     aws_h2_stream_complete(stream, error_code);
 
     /* release connection's hold on stream */
@@ -1855,7 +2749,8 @@ int aws_h2_connection_send_rst_and_close_reserved_stream(
     uint32_t h2_error_code) {
     AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
 
-    struct aws_h2_frame *rst_stream = aws_h2_frame_new_rst_stream(connection->base.alloc, stream_id, h2_error_code);
+    struct aws_h2_frame *rst_stream =
+        aws_h2_frame_new_rst_stream(connection->thread_data.frame_allocator, stream_id, h2_error_code);
     if (!rst_stream) {
         CONNECTION_LOGF(ERROR, connection, "Error creating RST_STREAM frame, %s", aws_error_name(aws_last_error()));
         return AWS_OP_ERR;
@@ -1887,14 +2782,13 @@ static void s_move_stream_to_thread(
     }
 
     uint32_t max_concurrent_streams = connection->thread_data.settings_peer[AWS_HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS];
-    if (aws_hash_table_get_entry_count(&connection->thread_data.active_streams_map) >= max_concurrent_streams) {
+    if (connection->thread_data.active_streams.count >= max_concurrent_streams) {
         AWS_H2_STREAM_LOG(ERROR, stream, "Failed activating stream, max concurrent streams are reached");
         aws_raise_error(AWS_ERROR_HTTP_MAX_CONCURRENT_STREAMS_EXCEEDED);
         goto error;
     }
 
-    if (aws_hash_table_put(
-            &connection->thread_data.active_streams_map, (void *)(size_t)stream->base.id, stream, NULL)) {
+    if (s_active_streams_insert(&connection->thread_data.active_streams, connection->base.alloc, stream)) {
         AWS_H2_STREAM_LOG(ERROR, stream, "Failed inserting stream into map");
         goto error;
     }
@@ -1904,7 +2798,7 @@ static void s_move_stream_to_thread(
         goto error;
     }
 
-    if (aws_hash_table_get_entry_count(&connection->thread_data.active_streams_map) == 1) {
+    if (connection->thread_data.active_streams.count == 1) {
         /* transition from nothing to read -> something to read */
         uint64_t now_ns = 0;
         aws_channel_current_clock_time(connection->base.channel_slot->channel, &now_ns);
@@ -1976,10 +2870,13 @@ static void s_cross_thread_work_task(struct aws_channel_task *task, void *arg, e
         aws_h2_connection_enqueue_outgoing_frame(connection, frame);
     }
 
-    /* We already enqueued the window_update frame, just apply the change and let our peer check this value, no matter
-     * overflow happens or not. Peer will detect it for us. */
-    connection->thread_data.window_size_self =
-        aws_add_size_saturating(connection->thread_data.window_size_self, window_update_size);
+    /* Apply the window increments the user requested */
+    if (window_update_size > 0) {
+        if (s_connection_send_update_window(connection, window_update_size)) {
+            /* OOM should result in a crash, and the size was already checked against the max */
+            aws_h2_connection_shutdown_due_to_write_err(connection, aws_last_error());
+        }
+    }
 
     /* Process new pending_streams */
     while (!aws_linked_list_empty(&pending_streams)) {
@@ -2043,6 +2940,10 @@ int aws_h2_stream_activate(struct aws_http_stream *stream) {
             was_cross_thread_work_scheduled = connection->synced_data.is_cross_thread_work_task_scheduled;
             connection->synced_data.is_cross_thread_work_task_scheduled = true;
 
+            if (stream->metrics.queue_start_timestamp_ns == -1) {
+                aws_high_res_clock_get_ticks((uint64_t *)&stream->metrics.queue_start_timestamp_ns);
+            }
+            stream->metrics.connection_reuse_count = (stream->id - 1) / 2;
             aws_linked_list_push_back(&connection->synced_data.pending_stream_list, &h2_stream->node);
             h2_stream->synced_data.api_state = AWS_H2_STREAM_API_STATE_ACTIVE;
         }
@@ -2058,6 +2959,7 @@ int aws_h2_stream_activate(struct aws_http_stream *stream) {
     /* connection keeps activated stream alive until stream completes */
     aws_atomic_fetch_add(&stream->refcount, 1);
     stream->metrics.stream_id = stream->id;
+    AWS_HTTP_PROBE2(stream__activate, stream, stream->id);
 
     if (!was_cross_thread_work_scheduled) {
         CONNECTION_LOG(TRACE, connection, "Scheduling cross-thread work task");
@@ -2142,6 +3044,32 @@ static void s_connection_stop_new_request(struct aws_http_connection *connection
     } /* END CRITICAL SECTION */
 }
 
+/* Graceful GOAWAY with the last stream processed, so the peer retries anything newer elsewhere.
+ * Streams already active are allowed to finish, then the connection closes */
+static void s_connection_drain(struct aws_http_connection *connection_base) {
+    struct aws_h2_connection *connection = AWS_CONTAINER_OF(connection_base, struct aws_h2_connection, base);
+    AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+
+    if (connection->thread_data.is_draining) {
+        return;
+    }
+    connection->thread_data.is_draining = true;
+
+    s_connection_stop_new_request(connection_base);
+    s_send_goaway(connection, AWS_HTTP2_ERR_NO_ERROR, false /*allow_more_streams*/, NULL);
+
+    if (connection->thread_data.active_streams.count == 0) {
+        CONNECTION_LOG(DEBUG, connection, "Draining idle connection, closing.");
+        s_connection_close(connection_base);
+    } else {
+        CONNECTION_LOGF(
+            DEBUG,
+            connection,
+            "Draining connection, waiting for %zu active streams to complete.",
+            connection->thread_data.active_streams.count);
+    }
+}
+
 static bool s_connection_is_open(const struct aws_http_connection *connection_base) {
     struct aws_h2_connection *connection = AWS_CONTAINER_OF(connection_base, struct aws_h2_connection, base);
     bool is_open;
@@ -2180,19 +3108,8 @@ static void s_connection_update_window(struct aws_http_connection *connection_ba
             "Connection manual window management is off, update window operations are not supported.");
         return;
     }
-    struct aws_h2_frame *connection_window_update_frame =
-        aws_h2_frame_new_window_update(connection->base.alloc, 0, increment_size);
-    if (!connection_window_update_frame) {
-        CONNECTION_LOGF(
-            ERROR,
-            connection,
-            "Failed to create WINDOW_UPDATE frame on connection, error %s",
-            aws_error_name(aws_last_error()));
-        /* OOM should result in a crash. And the increment size is too huge is the only other failure case, which will
-         * result in overflow. */
-        goto overflow;
-    }
 
+    /* The WINDOW_UPDATE frame is created on the event-loop thread, where it may be coalesced with other increments */
     int err = 0;
     bool cross_thread_work_should_schedule = false;
     bool connection_open = false;
@@ -2207,8 +3124,6 @@ static void s_connection_update_window(struct aws_http_connection *connection_ba
         if (!err && connection_open) {
             cross_thread_work_should_schedule = !connection->synced_data.is_cross_thread_work_task_scheduled;
             connection->synced_data.is_cross_thread_work_task_scheduled = true;
-            aws_linked_list_push_back(
-                &connection->synced_data.pending_frame_list, &connection_window_update_frame->node);
             connection->synced_data.window_update_size = sum_size;
         }
         s_unlock_synced_data(connection);
@@ -2218,7 +3133,6 @@ static void s_connection_update_window(struct aws_http_connection *connection_ba
             ERROR,
             connection,
             "The connection's flow-control windows has been incremented beyond 2**31 -1, the max for HTTP/2. The ");
-        aws_h2_frame_destroy(connection_window_update_frame);
         goto overflow;
     }
 
@@ -2229,7 +3143,6 @@ static void s_connection_update_window(struct aws_http_connection *connection_ba
 
     if (!connection_open) {
         /* connection already closed, just do nothing */
-        aws_h2_frame_destroy(connection_window_update_frame);
         return;
     }
     CONNECTION_LOGF(
@@ -2453,6 +3366,11 @@ static void s_connection_get_remote_settings(
     s_get_settings_general(connection_base, out_settings, false /*local*/);
 }
 
+static size_t s_connection_get_hpack_memory_usage(const struct aws_http_connection *connection_base) {
+    struct aws_h2_connection *connection = AWS_CONTAINER_OF(connection_base, struct aws_h2_connection, base);
+    return aws_atomic_load_int(&connection->synced_data.hpack_memory_usage);
+}
+
 /* Send a GOAWAY with the lowest possible last-stream-id or graceful shutdown warning */
 static void s_send_goaway(
     struct aws_h2_connection *connection,
@@ -2481,7 +3399,7 @@ static void s_send_goaway(
     }
 
     struct aws_h2_frame *goaway =
-        aws_h2_frame_new_goaway(connection->base.alloc, last_stream_id, h2_error_code, debug_data);
+        aws_h2_frame_new_goaway(connection->thread_data.frame_allocator, last_stream_id, h2_error_code, debug_data);
     if (!goaway) {
         CONNECTION_LOGF(ERROR, connection, "Error creating GOAWAY frame, %s", aws_error_name(aws_last_error()));
         goto error;
@@ -2574,6 +3492,7 @@ static int s_handler_process_read_message(
 
     /* Any error that bubbles up from the decoder or its callbacks is treated as
      * a Connection Error (a GOAWAY frames is sent, and the connection is closed) */
+    connection->thread_data.stats.bytes_read += message->message_data.len;
     struct aws_byte_cursor message_cursor = aws_byte_cursor_from_buf(&message->message_data);
     struct aws_h2err err = aws_h2_decode(connection->thread_data.decoder, &message_cursor);
     if (aws_h2err_failed(err)) {
@@ -2612,6 +3531,7 @@ clean_up:
 
     /* Flush any outgoing frames that might have been queued as a result of decoder callbacks. */
     aws_h2_try_write_outgoing_frames(connection);
+    s_publish_hpack_memory_usage(connection);
 
     return AWS_OP_SUCCESS;
 }
@@ -2657,6 +3577,7 @@ static int s_handler_shutdown(
     if (dir == AWS_CHANNEL_DIR_READ) {
         /* This call ensures that no further streams will be created. */
         s_stop(connection, true /*stop_reading*/, false /*stop_writing*/, false /*schedule_shutdown*/, error_code);
+        aws_http_timer_cancel(&connection->thread_data.hpack_idle_timer);
         /* Send user requested GOAWAY, if they haven't been sent before. It's OK to access
          * synced_data.pending_goaway_list without holding the lock because no more user_requested GOAWAY can be added
          * after s_stop() has been invoked. */
@@ -2720,11 +3641,10 @@ static void s_finish_shutdown(struct aws_h2_connection *connection) {
 
     /* Remove remaining streams from internal datastructures and mark them as complete. */
 
-    struct aws_hash_iter stream_iter = aws_hash_iter_begin(&connection->thread_data.active_streams_map);
-    while (!aws_hash_iter_done(&stream_iter)) {
-        struct aws_h2_stream *stream = stream_iter.element.value;
-        aws_hash_iter_delete(&stream_iter, true);
-        aws_hash_iter_next(&stream_iter);
+    size_t stream_iter = 0;
+    struct aws_h2_stream *stream;
+    while ((stream = s_active_streams_next(&connection->thread_data.active_streams, &stream_iter))) {
+        s_active_streams_remove(&connection->thread_data.active_streams, stream->base.id);
 
         s_stream_complete(connection, stream, AWS_ERROR_HTTP_CONNECTION_CLOSED);
     }
@@ -2807,13 +3727,24 @@ static size_t s_handler_message_overhead(struct aws_channel_handler *handler) {
 static void s_reset_statistics(struct aws_channel_handler *handler) {
     struct aws_h2_connection *connection = handler->impl;
     aws_crt_statistics_http2_channel_reset(&connection->thread_data.stats);
-    if (aws_hash_table_get_entry_count(&connection->thread_data.active_streams_map) == 0) {
+    if (connection->thread_data.active_streams.count == 0) {
         /* Check the current state */
         connection->thread_data.stats.was_inactive = true;
     }
     return;
 }
 
+static uint32_t s_count_stalled_window_streams(const struct aws_h2_connection *connection) {
+    uint32_t stalled_count = 0;
+    const struct aws_linked_list *stalled_list = &connection->thread_data.stalled_window_streams_list;
+    for (const struct aws_linked_list_node *node = aws_linked_list_begin(stalled_list);
+         node != aws_linked_list_end(stalled_list);
+         node = aws_linked_list_next(node)) {
+        ++stalled_count;
+    }
+    return stalled_count;
+}
+
 static void s_gather_statistics(struct aws_channel_handler *handler, struct aws_array_list *stats) {
 
     struct aws_h2_connection *connection = handler->impl;
@@ -2835,7 +3766,7 @@ static void s_gather_statistics(struct aws_channel_handler *handler, struct aws_
 
         connection->thread_data.outgoing_timestamp_ns = now_ns;
     }
-    if (aws_hash_table_get_entry_count(&connection->thread_data.active_streams_map) != 0) {
+    if (connection->thread_data.active_streams.count != 0) {
         s_add_time_measurement_to_stats(
             connection->thread_data.incoming_timestamp_ns,
             now_ns,
@@ -2846,6 +3777,19 @@ static void s_gather_statistics(struct aws_channel_handler *handler, struct aws_
         connection->thread_data.stats.was_inactive = true;
     }
 
+    connection->thread_data.stats.window_size_peer = connection->thread_data.window_size_peer;
+    connection->thread_data.stats.window_size_self = connection->thread_data.window_size_self;
+    connection->thread_data.stats.stalled_window_stream_count = s_count_stalled_window_streams(connection);
+
     void *stats_base = &connection->thread_data.stats;
     aws_array_list_push_back(stats, &stats_base);
 }
+
+void aws_h2_connection_get_load(struct aws_http_connection *http2_connection, struct aws_h2_connection_load *out_load) {
+    struct aws_h2_connection *connection = AWS_CONTAINER_OF(http2_connection, struct aws_h2_connection, base);
+    AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection->base.channel_slot->channel));
+
+    out_load->window_size_peer = connection->thread_data.window_size_peer;
+    out_load->stalled_stream_count = s_count_stalled_window_streams(connection);
+    out_load->smoothed_rtt_ns = connection->thread_data.stats.smoothed_rtt_ns;
+}
@@ -6,6 +6,7 @@
 
 #include <aws/http/private/hpack.h>
 #include <aws/http/private/strutil.h>
+#include <aws/http/private/tracing.h>
 
 #include <aws/common/string.h>
 #include <aws/http/status_code.h>
@@ -267,8 +268,22 @@ struct aws_h2_decoder {
         /* If separate cookie fields have different compression types, the concatenated cookie uses the strictest type.
          */
         enum aws_http_header_compression cookie_header_compression_type;
+
+        /* Size of the header-block so far, as HPACK-encoded on the wire, and as plain names and values */
+        uint64_t encoded_len;
+        uint64_t plain_len;
     } header_block_in_progress;
 
+    /* Header-fields of the HEADERS header-block in progress, collected for on_headers_batch().
+     * Only used if that callback is set. Storage is kept between header-blocks to avoid reallocating. */
+    struct aws_header_batch {
+        /* Names and values are copied here, since HPACK's strings don't outlive the entry */
+        struct aws_byte_buf storage;
+        struct aws_array_list fields;     /* struct aws_header_batch_field */
+        struct aws_array_list headers;    /* struct aws_http_header, built from fields on delivery */
+        struct aws_array_list name_enums; /* enum aws_http_header_name, built from fields on delivery */
+    } header_batch;
+
     /* Settings for decoder, which is based on the settings sent to the peer and ACKed by peer */
     struct {
         /* enable/disable server push */
@@ -287,8 +302,25 @@ struct aws_h2_decoder {
     bool has_errored;
 };
 
+/* A header-field held by aws_header_batch. Offsets are into its storage, which may move as it grows. */
+struct aws_header_batch_field {
+    size_t name_offset;
+    size_t name_len;
+    size_t value_offset;
+    size_t value_len;
+    enum aws_http_header_compression compression;
+    enum aws_http_header_name name_enum;
+};
+
 /***********************************************************************************************************************/
 
+static void s_header_batch_clean_up(struct aws_header_batch *batch) {
+    aws_byte_buf_clean_up(&batch->storage);
+    aws_array_list_clean_up(&batch->fields);
+    aws_array_list_clean_up(&batch->headers);
+    aws_array_list_clean_up(&batch->name_enums);
+}
+
 struct aws_h2_decoder *aws_h2_decoder_new(struct aws_h2_decoder_params *params) {
     AWS_PRECONDITION(params);
     AWS_PRECONDITION(params->alloc);
@@ -335,6 +367,16 @@ struct aws_h2_decoder *aws_h2_decoder_new(struct aws_h2_decoder_params *params)
         goto error;
     }
 
+    if (aws_byte_buf_init(&decoder->header_batch.storage, decoder->alloc, 0) ||
+        aws_array_list_init_dynamic(
+            &decoder->header_batch.fields, decoder->alloc, 0, sizeof(struct aws_header_batch_field)) ||
+        aws_array_list_init_dynamic(
+            &decoder->header_batch.headers, decoder->alloc, 0, sizeof(struct aws_http_header)) ||
+        aws_array_list_init_dynamic(
+            &decoder->header_batch.name_enums, decoder->alloc, 0, sizeof(enum aws_http_header_name))) {
+        goto error;
+    }
+
     return decoder;
 
 error:
@@ -342,6 +384,7 @@ error:
         aws_hpack_decoder_clean_up(&decoder->hpack);
         aws_array_list_clean_up(&decoder->settings_buffer_list);
         aws_byte_buf_clean_up(&decoder->header_block_in_progress.cookies);
+        s_header_batch_clean_up(&decoder->header_batch);
     }
     aws_mem_release(params->alloc, allocation);
     return NULL;
@@ -355,6 +398,9 @@ static void s_reset_header_block_in_progress(struct aws_h2_decoder *decoder) {
     AWS_ZERO_STRUCT(decoder->header_block_in_progress);
     decoder->header_block_in_progress.cookies = cookie_backup;
     aws_byte_buf_reset(&decoder->header_block_in_progress.cookies, false);
+
+    aws_byte_buf_reset(&decoder->header_batch.storage, false);
+    aws_array_list_clear(&decoder->header_batch.fields);
 }
 
 void aws_h2_decoder_destroy(struct aws_h2_decoder *decoder) {
@@ -365,10 +411,41 @@ void aws_h2_decoder_destroy(struct aws_h2_decoder *decoder) {
     aws_hpack_decoder_clean_up(&decoder->hpack);
     s_reset_header_block_in_progress(decoder);
     aws_byte_buf_clean_up(&decoder->header_block_in_progress.cookies);
+    s_header_batch_clean_up(&decoder->header_batch);
     aws_byte_buf_clean_up(&decoder->goaway_in_progress.debug_data);
     aws_mem_release(decoder->alloc, decoder);
 }
 
+/* True if the next frame, prefix and payload, is entirely within data */
+static bool s_whole_frame_available(const struct aws_h2_decoder *decoder, const struct aws_byte_cursor *data) {
+    if (decoder->state != &s_state_prefix || decoder->scratch.len || data->len < s_scratch_space_size) {
+        return false;
+    }
+    const uint32_t payload_len = ((uint32_t)data->ptr[0] << 16) | ((uint32_t)data->ptr[1] << 8) | data->ptr[2];
+    return data->len - s_scratch_space_size >= payload_len;
+}
+
+/* Fast path for a frame that's entirely within data.
+ * Every state the frame goes through can run straight from the cursor, since s_decoder_switch_state() ensures
+ * no state requires more than the remaining payload. So skip the scratch bookkeeping, and just run states
+ * until the frame is complete and we're back at the prefix state. */
+static struct aws_h2err s_decode_whole_frame(struct aws_h2_decoder *decoder, struct aws_byte_cursor *data) {
+    DECODER_LOGF(TRACE, decoder, "Decoding whole frame with %zu bytes available", data->len);
+    do {
+        decoder->state_changed = false;
+        AWS_ASSERT(data->len >= decoder->state->bytes_required);
+
+        struct aws_h2err err = decoder->state->fn(decoder, data);
+        if (aws_h2err_failed(err)) {
+            return err;
+        }
+    } while (decoder->state_changed && decoder->state != &s_state_prefix);
+
+    /* Let aws_h2_decode() carry on with whatever's next */
+    decoder->state_changed = true;
+    return AWS_H2ERR_SUCCESS;
+}
+
 struct aws_h2err aws_h2_decode(struct aws_h2_decoder *decoder, struct aws_byte_cursor *data) {
     AWS_PRECONDITION(decoder);
     AWS_PRECONDITION(data);
@@ -381,6 +458,14 @@ struct aws_h2err aws_h2_decode(struct aws_h2_decoder *decoder, struct aws_byte_c
      * We don't simply loop `while(data->len)` because some states consume no data,
      * and these states should run even when there is no data left. */
     do {
+        if (s_whole_frame_available(decoder, data)) {
+            err = s_decode_whole_frame(decoder, data);
+            if (aws_h2err_failed(err)) {
+                goto handle_error;
+            }
+            continue;
+        }
+
         decoder->state_changed = false;
 
         const uint32_t bytes_required = decoder->state->bytes_required;
@@ -615,6 +700,7 @@ static struct aws_h2err s_state_fn_prefix(struct aws_h2_decoder *decoder, struct
 
     /* Reserved bit (1st bit) MUST be ignored when receiving (RFC-7540 4.1) */
     frame->stream_id &= s_31_bit_mask;
+    AWS_HTTP_PROBE4(h2__frame__received, decoder->logging_id, raw_type, frame->stream_id, frame->payload_len);
 
     /* Some frame types require a stream ID, some frame types require that stream ID be zero. */
     const enum stream_id_rules stream_id_rules = s_stream_id_rules_for_frame[frame->type];
@@ -923,6 +1009,18 @@ static struct aws_h2err s_state_fn_frame_settings_i(struct aws_h2_decoder *decod
             DECODER_LOGF(ERROR, decoder, "Writing setting to buffer failed, %s", aws_error_name(aws_last_error()));
             return aws_h2err_from_last_error();
         }
+    } else if (id == AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL) {
+        /* "A sender MUST NOT send a SETTINGS_ENABLE_CONNECT_PROTOCOL parameter with the value of 0
+         * after previously sending a value of 1" (RFC-8441 3). The connection checks that, we check the bounds. */
+        if (value > 1) {
+            DECODER_LOGF(ERROR, decoder, "SETTINGS_ENABLE_CONNECT_PROTOCOL has invalid value: %" PRIu32, value);
+            return aws_h2err_from_h2_code(AWS_HTTP2_ERR_PROTOCOL_ERROR);
+        }
+        struct aws_http2_setting setting = {.id = AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL, .value = value};
+        if (aws_array_list_push_back(&decoder->settings_buffer_list, &setting)) {
+            DECODER_LOGF(ERROR, decoder, "Writing setting to buffer failed, %s", aws_error_name(aws_last_error()));
+            return aws_h2err_from_last_error();
+        }
     }
 
     /* Update payload len */
@@ -1125,6 +1223,77 @@ static struct aws_h2err s_state_fn_frame_unknown(struct aws_h2_decoder *decoder,
 
 /* Perform analysis that can't be done until all pseudo-headers are received.
  * Then deliver buffered pseudoheaders via callback */
+/* Deliver a validated header-field of the header-block in progress.
+ * For HEADERS, if the user wants them in a batch, the field is collected until the header-block ends. */
+static struct aws_h2err s_deliver_header_field(
+    struct aws_h2_decoder *decoder,
+    const struct aws_http_header *header_field,
+    enum aws_http_header_name name_enum) {
+
+    struct aws_header_block_in_progress *current_block = &decoder->header_block_in_progress;
+    if (current_block->is_push_promise) {
+        DECODER_CALL_VTABLE_STREAM_ARGS(decoder, on_push_promise_i, header_field, name_enum);
+        return AWS_H2ERR_SUCCESS;
+    }
+
+    if (!decoder->vtable->on_headers_batch) {
+        DECODER_CALL_VTABLE_STREAM_ARGS(decoder, on_headers_i, header_field, name_enum, current_block->block_type);
+        return AWS_H2ERR_SUCCESS;
+    }
+
+    struct aws_header_batch *batch = &decoder->header_batch;
+    struct aws_header_batch_field field = {
+        .name_offset = batch->storage.len,
+        .name_len = header_field->name.len,
+        .value_offset = batch->storage.len + header_field->name.len,
+        .value_len = header_field->value.len,
+        .compression = header_field->compression,
+        .name_enum = name_enum,
+    };
+    if (aws_byte_buf_append_dynamic(&batch->storage, &header_field->name) ||
+        aws_byte_buf_append_dynamic(&batch->storage, &header_field->value) ||
+        aws_array_list_push_back(&batch->fields, &field)) {
+        return aws_h2err_from_last_error();
+    }
+    return AWS_H2ERR_SUCCESS;
+}
+
+/* Deliver the header-fields collected for on_headers_batch() */
+static struct aws_h2err s_flush_header_batch(struct aws_h2_decoder *decoder) {
+    struct aws_header_batch *batch = &decoder->header_batch;
+    const size_t num_fields = aws_array_list_length(&batch->fields);
+    if (!decoder->vtable->on_headers_batch || decoder->header_block_in_progress.malformed || num_fields == 0) {
+        return AWS_H2ERR_SUCCESS;
+    }
+
+    /* storage is done growing, so cursors into it stay valid until the header-block is reset */
+    aws_array_list_clear(&batch->headers);
+    aws_array_list_clear(&batch->name_enums);
+    for (size_t i = 0; i < num_fields; ++i) {
+        struct aws_header_batch_field *field = NULL;
+        aws_array_list_get_at_ptr(&batch->fields, (void **)&field, i);
+
+        struct aws_http_header header = {
+            .name = aws_byte_cursor_from_array(batch->storage.buffer + field->name_offset, field->name_len),
+            .value = aws_byte_cursor_from_array(batch->storage.buffer + field->value_offset, field->value_len),
+            .compression = field->compression,
+        };
+        if (aws_array_list_push_back(&batch->headers, &header) ||
+            aws_array_list_push_back(&batch->name_enums, &field->name_enum)) {
+            return aws_h2err_from_last_error();
+        }
+    }
+
+    DECODER_CALL_VTABLE_STREAM_ARGS(
+        decoder,
+        on_headers_batch,
+        batch->headers.data,
+        batch->name_enums.data,
+        num_fields,
+        decoder->header_block_in_progress.block_type);
+    return AWS_H2ERR_SUCCESS;
+}
+
 static struct aws_h2err s_flush_pseudoheaders(struct aws_h2_decoder *decoder) {
     struct aws_header_block_in_progress *current_block = &decoder->header_block_in_progress;
 
@@ -1215,11 +1384,9 @@ static struct aws_h2err s_flush_pseudoheaders(struct aws_h2_decoder *decoder) {
 
             enum aws_http_header_name name_enum = s_pseudoheader_to_header_name[i];
 
-            if (current_block->is_push_promise) {
-                DECODER_CALL_VTABLE_STREAM_ARGS(decoder, on_push_promise_i, &header_field, name_enum);
-            } else {
-                DECODER_CALL_VTABLE_STREAM_ARGS(
-                    decoder, on_headers_i, &header_field, name_enum, current_block->block_type);
+            struct aws_h2err err = s_deliver_header_field(decoder, &header_field, name_enum);
+            if (aws_h2err_failed(err)) {
+                return err;
             }
         }
     }
@@ -1372,10 +1539,9 @@ static struct aws_h2err s_process_header_field(
                 break;
         }
         /* Deliver header-field via callback */
-        if (current_block->is_push_promise) {
-            DECODER_CALL_VTABLE_STREAM_ARGS(decoder, on_push_promise_i, header_field, name_enum);
-        } else {
-            DECODER_CALL_VTABLE_STREAM_ARGS(decoder, on_headers_i, header_field, name_enum, current_block->block_type);
+        struct aws_h2err err = s_deliver_header_field(decoder, header_field, name_enum);
+        if (aws_h2err_failed(err)) {
+            return err;
         }
     }
 
@@ -1404,13 +1570,7 @@ static struct aws_h2err s_flush_cookie_header(struct aws_h2_decoder *decoder) {
     concatenated_cookie.name = header_name;
     concatenated_cookie.value = aws_byte_cursor_from_buf(&current_block->cookies);
     concatenated_cookie.compression = current_block->cookie_header_compression_type;
-    if (current_block->is_push_promise) {
-        DECODER_CALL_VTABLE_STREAM_ARGS(decoder, on_push_promise_i, &concatenated_cookie, AWS_HTTP_HEADER_COOKIE);
-    } else {
-        DECODER_CALL_VTABLE_STREAM_ARGS(
-            decoder, on_headers_i, &concatenated_cookie, AWS_HTTP_HEADER_COOKIE, current_block->block_type);
-    }
-    return AWS_H2ERR_SUCCESS;
+    return s_deliver_header_field(decoder, &concatenated_cookie, AWS_HTTP_HEADER_COOKIE);
 }
 
 /* This state checks whether we've consumed the current frame's entire header-block fragment.
@@ -1434,6 +1594,13 @@ static struct aws_h2err s_state_fn_header_block_loop(struct aws_h2_decoder *deco
             if (aws_h2err_failed(err)) {
                 return err;
             }
+            /* deliver the whole header-block, if the user wants it in one batch */
+            if (!decoder->header_block_in_progress.is_push_promise) {
+                err = s_flush_header_batch(decoder);
+                if (aws_h2err_failed(err)) {
+                    return err;
+                }
+            }
 
             bool malformed = decoder->header_block_in_progress.malformed;
             DECODER_LOGF(TRACE, decoder, "Done decoding header-block, malformed=%d", malformed);
@@ -1501,6 +1668,7 @@ static struct aws_h2err s_state_fn_header_block_entry(struct aws_h2_decoder *dec
     const size_t bytes_consumed = prev_fragment_len - fragment.len;
     aws_byte_cursor_advance(input, bytes_consumed);
     decoder->frame_in_progress.payload_len -= (uint32_t)bytes_consumed;
+    decoder->header_block_in_progress.encoded_len += bytes_consumed;
 
     if (result.type == AWS_HPACK_DECODE_T_ONGOING) {
         /* HPACK decoder hasn't finished entry */
@@ -1534,6 +1702,7 @@ static struct aws_h2err s_state_fn_header_block_entry(struct aws_h2_decoder *dec
 
     if (result.type == AWS_HPACK_DECODE_T_HEADER_FIELD) {
         const struct aws_http_header *header_field = &result.data.header_field;
+        decoder->header_block_in_progress.plain_len += header_field->name.len + header_field->value.len;
 
         DECODER_LOGF(
             TRACE,
@@ -1590,3 +1759,22 @@ void aws_h2_decoder_set_setting_enable_push(struct aws_h2_decoder *decoder, uint
 void aws_h2_decoder_set_setting_max_frame_size(struct aws_h2_decoder *decoder, uint32_t data) {
     decoder->settings.max_frame_size = data;
 }
+
+uint64_t aws_h2_decoder_get_header_block_encoded_len(const struct aws_h2_decoder *decoder) {
+    return decoder->header_block_in_progress.encoded_len;
+}
+
+uint64_t aws_h2_decoder_get_header_block_plain_len(const struct aws_h2_decoder *decoder) {
+    return decoder->header_block_in_progress.plain_len;
+}
+
+size_t aws_h2_decoder_get_hpack_memory_usage(const struct aws_h2_decoder *decoder) {
+    return aws_hpack_decoder_get_memory_usage(&decoder->hpack);
+}
+
+int aws_h2_decoder_trim_hpack(struct aws_h2_decoder *decoder) {
+    if (decoder->header_block_in_progress.stream_id != 0) {
+        return AWS_OP_SUCCESS;
+    }
+    return aws_hpack_decoder_trim(&decoder->hpack);
+}
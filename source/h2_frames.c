@@ -299,6 +299,11 @@ int aws_h2_frame_encoder_init(
 
     aws_hpack_encoder_init(&encoder->hpack, allocator, logging_id);
 
+    if (aws_byte_buf_init(&encoder->header_block_buf, allocator, s_encoded_header_block_reserve)) {
+        aws_hpack_encoder_clean_up(&encoder->hpack);
+        return AWS_OP_ERR;
+    }
+
     encoder->settings.max_frame_size = aws_h2_settings_initial[AWS_HTTP2_SETTINGS_MAX_FRAME_SIZE];
     return AWS_OP_SUCCESS;
 }
@@ -306,6 +311,7 @@ void aws_h2_frame_encoder_clean_up(struct aws_h2_frame_encoder *encoder) {
     AWS_PRECONDITION(encoder);
 
     aws_hpack_encoder_clean_up(&encoder->hpack);
+    aws_byte_buf_clean_up(&encoder->header_block_buf);
 }
 
 /***********************************************************************************************************************
@@ -457,6 +463,66 @@ error:
     return AWS_OP_ERR;
 }
 
+int aws_h2_encode_zero_copy_data_frame(
+    struct aws_h2_frame_encoder *encoder,
+    uint32_t stream_id,
+    struct aws_byte_cursor *body,
+    bool body_ends_stream,
+    int32_t *stream_window_size_peer,
+    size_t *connection_window_size_peer,
+    struct aws_byte_buf *output,
+    struct aws_byte_cursor *out_payload,
+    bool *body_complete) {
+
+    AWS_PRECONDITION(encoder);
+    AWS_PRECONDITION(body);
+    AWS_PRECONDITION(output);
+    AWS_PRECONDITION(out_payload);
+    AWS_PRECONDITION(body_complete);
+    AWS_PRECONDITION(*stream_window_size_peer > 0);
+
+    if (aws_h2_validate_stream_id(stream_id)) {
+        return AWS_OP_ERR;
+    }
+
+    AWS_ZERO_STRUCT(*out_payload);
+    *body_complete = false;
+    uint8_t flags = 0;
+
+    /* Only the frame prefix goes in output, so space limits whether we can encode at all, but not the payload size */
+    if (output->capacity - output->len < AWS_H2_FRAME_PREFIX_SIZE) {
+        ENCODER_LOGF(TRACE, encoder, "Insufficient space to encode DATA for stream %" PRIu32 " right now", stream_id);
+        return AWS_OP_SUCCESS;
+    }
+
+    size_t min_window_size = aws_min_size(*stream_window_size_peer, *connection_window_size_peer);
+    size_t payload_len = aws_min_size(aws_min_size(encoder->settings.max_frame_size, min_window_size), body->len);
+
+    *out_payload = aws_byte_cursor_advance(body, payload_len);
+    if (body->len == 0) {
+        *body_complete = true;
+        if (body_ends_stream) {
+            flags |= AWS_H2_FRAME_F_END_STREAM;
+        }
+    }
+
+    ENCODER_LOGF(
+        TRACE,
+        encoder,
+        "Encoding frame type=DATA stream_id=%" PRIu32 " data_len=%zu zero-copy%s",
+        stream_id,
+        payload_len,
+        (flags & AWS_H2_FRAME_F_END_STREAM) ? " END_STREAM" : "");
+
+    s_frame_prefix_encode(AWS_H2_FRAME_T_DATA, stream_id, payload_len, flags, output);
+
+    /* The payload counts against the flow-control windows as soon as its prefix is encoded */
+    *connection_window_size_peer -= payload_len;
+    *stream_window_size_peer -= (int32_t)payload_len;
+
+    return AWS_OP_SUCCESS;
+}
+
 /***********************************************************************************************************************
  * HEADERS / PUSH_PROMISE
  **********************************************************************************************************************/
@@ -481,13 +547,20 @@ struct aws_h2_frame_headers {
     /* State */
     enum {
         AWS_H2_HEADERS_STATE_INIT,
-        AWS_H2_HEADERS_STATE_FIRST_FRAME,  /* header-block pre-encoded, no frames written yet */
+        AWS_H2_HEADERS_STATE_FIRST_FRAME,  /* no frames written yet */
         AWS_H2_HEADERS_STATE_CONTINUATION, /* first frame written, need to write CONTINUATION frames now */
         AWS_H2_HEADERS_STATE_COMPLETE,
     } state;
 
-    struct aws_byte_buf whole_encoded_header_block;
-    struct aws_byte_cursor header_block_cursor; /* tracks progress sending encoded header-block in fragments */
+    /* Headers are HPACK encoded straight into each frame's payload, as it's written. This is the next one to encode */
+    size_t next_header_index;
+
+    /* Encoded bytes that didn't fit in the previous frame, and go first in the next one.
+     * Points into the encoder's header_block_buf */
+    struct aws_byte_cursor spill_cursor;
+
+    /* Length of header-block encoded so far */
+    size_t header_block_len;
 };
 
 static struct aws_h2_frame *s_frame_new_headers_or_push_promise(
@@ -529,10 +602,6 @@ static struct aws_h2_frame *s_frame_new_headers_or_push_promise(
         return NULL;
     }
 
-    if (aws_byte_buf_init(&frame->whole_encoded_header_block, allocator, s_encoded_header_block_reserve)) {
-        goto error;
-    }
-
     if (frame_type == AWS_H2_FRAME_T_HEADERS) {
         frame->end_stream = end_stream;
         if (optional_priority) {
@@ -550,10 +619,6 @@ static struct aws_h2_frame *s_frame_new_headers_or_push_promise(
     frame->pad_length = pad_length;
 
     return &frame->base;
-
-error:
-    s_frame_headers_destroy(&frame->base);
-    return NULL;
 }
 
 struct aws_h2_frame *aws_h2_frame_new_headers(
@@ -596,12 +661,57 @@ struct aws_h2_frame *aws_h2_frame_new_push_promise(
 static void s_frame_headers_destroy(struct aws_h2_frame *frame_base) {
     struct aws_h2_frame_headers *frame = AWS_CONTAINER_OF(frame_base, struct aws_h2_frame_headers, base);
     aws_http_headers_release((struct aws_http_headers *)frame->headers);
-    aws_byte_buf_clean_up(&frame->whole_encoded_header_block);
     aws_mem_release(frame->base.alloc, frame);
 }
 
+/* Move as much of the spill as fits into the fragment */
+static void s_write_header_block_spill(struct aws_h2_frame_headers *frame, struct aws_byte_buf *fragment_buf) {
+    const size_t len = aws_min_size(frame->spill_cursor.len, fragment_buf->capacity - fragment_buf->len);
+    struct aws_byte_cursor spill = aws_byte_cursor_advance(&frame->spill_cursor, len);
+    bool writes_ok = aws_byte_buf_write_from_whole_cursor(fragment_buf, spill);
+    AWS_ASSERT(writes_ok);
+    (void)writes_ok;
+}
+
+/* HPACK encode headers into the fragment until it's full or there are no more headers.
+ * A header is encoded straight into the fragment if it's sure to fit. If it might not, it's encoded into the
+ * encoder's header_block_buf instead, and whatever doesn't fit spills into the next frame.
+ * Once a header is encoded the HPACK state has moved on, so it must be sent in full, there's no taking it back. */
+static int s_write_header_block_fragment(
+    struct aws_h2_frame_headers *frame,
+    struct aws_h2_frame_encoder *encoder,
+    struct aws_byte_buf *fragment_buf) {
+
+    s_write_header_block_spill(frame, fragment_buf);
+
+    const size_t num_headers = aws_http_headers_count(frame->headers);
+    while (frame->spill_cursor.len == 0 && frame->next_header_index < num_headers) {
+        struct aws_http_header header;
+        aws_http_headers_get_index(frame->headers, frame->next_header_index, &header);
+
+        const size_t space_available = fragment_buf->capacity - fragment_buf->len;
+        if (aws_hpack_get_encoded_header_length_upper_bound(&header) <= space_available) {
+            /* The fragment can't need resizing, which is good, since it doesn't own its memory */
+            if (aws_hpack_encode_header(&encoder->hpack, &header, fragment_buf)) {
+                return AWS_OP_ERR;
+            }
+        } else {
+            aws_byte_buf_reset(&encoder->header_block_buf, false /*zero_contents*/);
+            if (aws_hpack_encode_header(&encoder->hpack, &header, &encoder->header_block_buf)) {
+                return AWS_OP_ERR;
+            }
+            frame->spill_cursor = aws_byte_cursor_from_buf(&encoder->header_block_buf);
+            s_write_header_block_spill(frame, fragment_buf);
+        }
+
+        frame->next_header_index++;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 /* Encode the next frame for this header-block (or encode nothing if output buffer is too small). */
-static void s_encode_single_header_block_frame(
+static int s_encode_single_header_block_frame(
     struct aws_h2_frame_headers *frame,
     struct aws_h2_frame_encoder *encoder,
     struct aws_byte_buf *output,
@@ -619,6 +729,7 @@ static void s_encode_single_header_block_frame(
     const struct aws_h2_frame_priority_settings *priority_settings = NULL;
     const uint32_t *promised_stream_id = NULL;
     size_t payload_overhead = 0; /* Amount of payload holding things other than header-block (padding, etc) */
+    size_t bytes_preceding_fragment = AWS_H2_FRAME_PREFIX_SIZE;
 
     if (frame->state == AWS_H2_HEADERS_STATE_FIRST_FRAME) {
         frame_type = frame->base.type;
@@ -627,12 +738,14 @@ static void s_encode_single_header_block_frame(
             flags |= AWS_H2_FRAME_F_PADDED;
             pad_length = frame->pad_length;
             payload_overhead += 1 + pad_length;
+            bytes_preceding_fragment += 1;
         }
 
         if (frame->has_priority) {
             priority_settings = &frame->priority;
             flags |= AWS_H2_FRAME_F_PRIORITY;
             payload_overhead += s_frame_priority_settings_size;
+            bytes_preceding_fragment += s_frame_priority_settings_size;
         }
 
         if (frame->end_stream) {
@@ -642,6 +755,7 @@ static void s_encode_single_header_block_frame(
         if (frame_type == AWS_H2_FRAME_T_PUSH_PROMISE) {
             promised_stream_id = &frame->promised_stream_id;
             payload_overhead += 4;
+            bytes_preceding_fragment += 4;
         }
 
     } else /* CONTINUATION */ {
@@ -649,7 +763,7 @@ static void s_encode_single_header_block_frame(
     }
 
     /*
-     * Figure out what size header-block fragment should go in this frame.
+     * Figure out what size header-block fragment could go in this frame.
      */
 
     size_t max_payload;
@@ -662,34 +776,53 @@ static void s_encode_single_header_block_frame(
         goto handle_waiting_for_more_space;
     }
 
-    const size_t fragment_len = aws_min_size(max_fragment, frame->header_block_cursor.len);
-    if (fragment_len == frame->header_block_cursor.len) {
-        /* This will finish the header-block */
-        flags |= AWS_H2_FRAME_F_END_HEADERS;
-    } else {
-        /* If we're not finishing the header-block, is it even worth trying to send this frame now? */
+    /* We don't know how long the rest of the header-block is until it's encoded, and encoding can't be undone.
+     * So unless it's just the spill left, is it even worth trying to send this frame now? */
+    const bool only_spill_remains = frame->next_header_index == aws_http_headers_count(frame->headers);
+    if (!only_spill_remains || frame->spill_cursor.len > max_fragment) {
         const size_t even_worth_sending_threshold = AWS_H2_FRAME_PREFIX_SIZE + payload_overhead;
-        if (fragment_len < even_worth_sending_threshold) {
+        if (max_fragment < even_worth_sending_threshold) {
             goto handle_waiting_for_more_space;
         }
     }
 
-    /*
-     * Ok, it fits! Write the frame
-     */
+    /* Use a sub-buffer to limit where the header-block fragment can go */
+    struct aws_byte_buf fragment_sub_buf =
+        aws_byte_buf_from_empty_array(output->buffer + output->len + bytes_preceding_fragment, max_fragment);
+
+    if (s_write_header_block_fragment(frame, encoder, &fragment_sub_buf)) {
+        ENCODER_LOGF(
+            ERROR,
+            encoder,
+            "Error doing HPACK encoding on %s of stream %" PRIu32 ": %s",
+            aws_h2_frame_type_to_str(frame->base.type),
+            frame->base.stream_id,
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    if (frame->spill_cursor.len == 0 && frame->next_header_index == aws_http_headers_count(frame->headers)) {
+        /* This finishes the header-block */
+        flags |= AWS_H2_FRAME_F_END_HEADERS;
+    }
+
     ENCODER_LOGF(
         TRACE,
         encoder,
-        "Encoding frame type=%s stream_id=%" PRIu32 "%s%s",
+        "Encoding frame type=%s stream_id=%" PRIu32 " fragment_len=%zu%s%s",
         aws_h2_frame_type_to_str(frame_type),
         frame->base.stream_id,
+        fragment_sub_buf.len,
         (flags & AWS_H2_FRAME_F_END_HEADERS) ? " END_HEADERS" : "",
         (flags & AWS_H2_FRAME_F_END_STREAM) ? " END_STREAM" : "");
 
+    /*
+     * Write in the other parts of the frame.
+     */
     bool writes_ok = true;
 
     /* Write the frame prefix */
-    const size_t payload_len = fragment_len + payload_overhead;
+    const size_t payload_len = fragment_sub_buf.len + payload_overhead;
     s_frame_prefix_encode(frame_type, frame->base.stream_id, payload_len, flags, output);
 
     /* Write pad length */
@@ -710,11 +843,10 @@ static void s_encode_single_header_block_frame(
         writes_ok &= aws_byte_buf_write_be32(output, *promised_stream_id);
     }
 
-    /* Write header-block fragment */
-    if (fragment_len > 0) {
-        struct aws_byte_cursor fragment = aws_byte_cursor_advance(&frame->header_block_cursor, fragment_len);
-        writes_ok &= aws_byte_buf_write_from_whole_cursor(output, fragment);
-    }
+    /* Increment output->len to jump over the header-block fragment that we already wrote in */
+    AWS_ASSERT(output->buffer + output->len == fragment_sub_buf.buffer && "Encoded headers to wrong position");
+    output->len += fragment_sub_buf.len;
+    frame->header_block_len += fragment_sub_buf.len;
 
     /* Write padding */
     if (flags & AWS_H2_FRAME_F_PADDED) {
@@ -725,10 +857,14 @@ static void s_encode_single_header_block_frame(
     (void)writes_ok;
 
     /* Success! Wrote entire frame. It's safe to change state now */
-    frame->state =
-        flags & AWS_H2_FRAME_F_END_HEADERS ? AWS_H2_HEADERS_STATE_COMPLETE : AWS_H2_HEADERS_STATE_CONTINUATION;
+    if (flags & AWS_H2_FRAME_F_END_HEADERS) {
+        frame->state = AWS_H2_HEADERS_STATE_COMPLETE;
+        encoder->header_block_len = frame->header_block_len;
+    } else {
+        frame->state = AWS_H2_HEADERS_STATE_CONTINUATION;
+    }
     *waiting_for_more_space = false;
-    return;
+    return AWS_OP_SUCCESS;
 
 handle_waiting_for_more_space:
     ENCODER_LOGF(
@@ -738,6 +874,7 @@ handle_waiting_for_more_space:
         aws_h2_frame_type_to_str(frame->base.type),
         frame->base.stream_id);
     *waiting_for_more_space = true;
+    return AWS_OP_SUCCESS;
 }
 
 static int s_frame_headers_encode(
@@ -748,10 +885,11 @@ static int s_frame_headers_encode(
 
     struct aws_h2_frame_headers *frame = AWS_CONTAINER_OF(frame_base, struct aws_h2_frame_headers, base);
 
-    /* Pre-encode the entire header-block into another buffer
-     * the first time we're called. */
+    /* The first time we're called, encode anything HPACK needs at the start of the header-block.
+     * It's tiny, and goes out as spill at the start of the first frame. */
     if (frame->state == AWS_H2_HEADERS_STATE_INIT) {
-        if (aws_hpack_encode_header_block(&encoder->hpack, frame->headers, &frame->whole_encoded_header_block)) {
+        aws_byte_buf_reset(&encoder->header_block_buf, false /*zero_contents*/);
+        if (aws_hpack_encode_header_block_start(&encoder->hpack, &encoder->header_block_buf)) {
             ENCODER_LOGF(
                 ERROR,
                 encoder,
@@ -762,7 +900,7 @@ static int s_frame_headers_encode(
             goto error;
         }
 
-        frame->header_block_cursor = aws_byte_cursor_from_buf(&frame->whole_encoded_header_block);
+        frame->spill_cursor = aws_byte_cursor_from_buf(&encoder->header_block_buf);
         frame->state = AWS_H2_HEADERS_STATE_FIRST_FRAME;
     }
 
@@ -770,7 +908,9 @@ static int s_frame_headers_encode(
      * until we're done writing header-block or the buffer is too full to continue */
     bool waiting_for_more_space = false;
     while (frame->state < AWS_H2_HEADERS_STATE_COMPLETE && !waiting_for_more_space) {
-        s_encode_single_header_block_frame(frame, encoder, output, &waiting_for_more_space);
+        if (s_encode_single_header_block_frame(frame, encoder, output, &waiting_for_more_space)) {
+            goto error;
+        }
     }
 
     *complete = frame->state == AWS_H2_HEADERS_STATE_COMPLETE;
@@ -6,8 +6,11 @@
 #include <aws/http/private/h2_stream.h>
 
 #include <aws/common/clock.h>
+#include <aws/http/private/async_body_stream.h>
+#include <aws/http/private/content_encoding_stream.h>
 #include <aws/http/private/h2_connection.h>
 #include <aws/http/private/strutil.h>
+#include <aws/http/private/tracing.h>
 #include <aws/http/status_code.h>
 #include <aws/io/channel.h>
 #include <aws/io/logging.h>
@@ -209,33 +212,93 @@ static struct aws_h2err s_check_state_allows_frame_type(
     return aws_h2err_from_h2_code(h2_error_code);
 }
 
-static int s_stream_send_update_window_frame(struct aws_h2_stream *stream, size_t increment_size) {
+static int s_stream_flush_window_update(struct aws_h2_stream *stream) {
     AWS_PRECONDITION_ON_CHANNEL_THREAD(stream);
-    AWS_PRECONDITION(increment_size <= AWS_H2_WINDOW_UPDATE_MAX);
 
-    struct aws_h2_connection *connection = s_get_h2_connection(stream);
-    struct aws_h2_frame *stream_window_update_frame =
-        aws_h2_frame_new_window_update(stream->base.alloc, stream->base.id, (uint32_t)increment_size);
+    size_t window_size = stream->thread_data.window_update_pending;
+    if (window_size == 0) {
+        return AWS_OP_SUCCESS;
+    }
 
+    struct aws_h2_frame *stream_window_update_frame =
+        aws_h2_frame_new_window_update(
+        s_get_h2_connection(stream)->thread_data.frame_allocator, stream->base.id, (uint32_t)window_size);
     if (!stream_window_update_frame) {
         AWS_H2_STREAM_LOGF(
             ERROR,
             stream,
-            "Failed to create WINDOW_UPDATE frame on connection, error %s",
+            "WINDOW_UPDATE frame on stream failed to be sent, error %s",
             aws_error_name(aws_last_error()));
         return AWS_OP_ERR;
     }
-    aws_h2_connection_enqueue_outgoing_frame(connection, stream_window_update_frame);
 
+    aws_h2_connection_enqueue_outgoing_frame(s_get_h2_connection(stream), stream_window_update_frame);
+    AWS_HTTP_PROBE3(h2__window__update__sent, s_get_h2_connection(stream), stream->base.id, window_size);
+    stream->thread_data.window_update_pending = 0;
+    /* The largest legal value will be 2 * max window size, which is way less than INT64_MAX, so if the window_size_self
+     * overflows, remote peer will find it out. So just apply the change and ignore the possible overflow.*/
+    stream->thread_data.window_size_self += window_size;
+    return AWS_OP_SUCCESS;
+}
+
+/* Increment the stream's flow-control window.
+ * The WINDOW_UPDATE may be held back and merged with later increments, see window_update_threshold_percent */
+static int s_stream_send_update_window(struct aws_h2_stream *stream, size_t window_size) {
+    AWS_PRECONDITION(window_size <= AWS_H2_WINDOW_UPDATE_MAX);
+
+    if (stream->thread_data.window_update_pending + window_size > AWS_H2_WINDOW_UPDATE_MAX) {
+        if (s_stream_flush_window_update(stream)) {
+            return AWS_OP_ERR;
+        }
+    }
+    stream->thread_data.window_update_pending += window_size;
+
+    if (aws_h2_connection_should_send_window_update(
+            s_get_h2_connection(stream),
+            stream->thread_data.window_size_self,
+            stream->thread_data.window_update_pending)) {
+        return s_stream_flush_window_update(stream);
+    }
     return AWS_OP_SUCCESS;
 }
 
+/* Copy an HTTP/2 request, so the headers this stream sends can differ from the user's request */
+static struct aws_http_message *s_h2_request_copy(struct aws_allocator *alloc, const struct aws_http_message *request) {
+    struct aws_http_message *copy = aws_http2_message_new_request(alloc);
+    if (!copy) {
+        return NULL;
+    }
+
+    const size_t header_count = aws_http_message_get_header_count(request);
+    for (size_t i = 0; i < header_count; ++i) {
+        struct aws_http_header header;
+        aws_http_message_get_header(request, &header, i);
+        if (aws_http_message_add_header(copy, header)) {
+            aws_http_message_release(copy);
+            return NULL;
+        }
+    }
+
+    aws_http_message_set_body_stream(copy, aws_http_message_get_body_stream(request));
+    aws_http_message_set_body_async_stream(copy, aws_http_message_get_body_async_stream(request));
+    return copy;
+}
+
 struct aws_h2_stream *aws_h2_stream_new_request(
     struct aws_http_connection *client_connection,
     const struct aws_http_make_request_options *options) {
     AWS_PRECONDITION(client_connection);
     AWS_PRECONDITION(options);
 
+    if (options->content_decoding) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM,
+            "id=%p: Content decoding is not supported on HTTP/2 connections",
+            (void *)client_connection);
+        aws_raise_error(AWS_ERROR_HTTP_UNSUPPORTED_PROTOCOL);
+        return NULL;
+    }
+
     struct aws_h2_stream *stream = aws_mem_calloc(client_connection->alloc, 1, sizeof(struct aws_h2_stream));
 
     /* Initialize base stream */
@@ -257,6 +320,10 @@ struct aws_h2_stream *aws_h2_stream_new_request(
     stream->base.metrics.receive_start_timestamp_ns = -1;
     stream->base.metrics.receive_end_timestamp_ns = -1;
     stream->base.metrics.receiving_duration_ns = -1;
+    stream->base.metrics.queue_start_timestamp_ns = -1;
+    stream->base.metrics.queue_duration_ns = -1;
+    stream->base.metrics.time_to_first_byte_ns = -1;
+    stream->base.metrics.time_to_headers_done_ns = -1;
     aws_linked_list_init(&stream->thread_data.outgoing_writes);
     aws_linked_list_init(&stream->synced_data.pending_write_list);
 
@@ -275,8 +342,16 @@ struct aws_h2_stream *aws_h2_stream_new_request(
             }
             break;
         case AWS_HTTP_VERSION_2:
-            stream->thread_data.outgoing_message = options->request;
-            aws_http_message_acquire(stream->thread_data.outgoing_message);
+            if (options->content_encoding) {
+                /* Content encoding changes the headers, which mustn't affect the user's request */
+                stream->thread_data.outgoing_message = s_h2_request_copy(stream->base.alloc, options->request);
+                if (!stream->thread_data.outgoing_message) {
+                    goto error;
+                }
+            } else {
+                stream->thread_data.outgoing_message = options->request;
+                aws_http_message_acquire(stream->thread_data.outgoing_message);
+            }
             break;
         default:
             /* Not supported */
@@ -296,12 +371,46 @@ struct aws_h2_stream *aws_h2_stream_new_request(
     stream->synced_data.manual_write_ended = !options->http2_use_manual_data_writes;
     stream->manual_write = options->http2_use_manual_data_writes;
 
+    if (options->http2_priority) {
+        if (options->http2_priority->urgency > AWS_HTTP2_PRIORITY_URGENCY_MAX) {
+            AWS_H2_STREAM_LOGF(ERROR, stream, "Invalid priority urgency %" PRIu8, options->http2_priority->urgency);
+            aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+            goto error;
+        }
+        stream->priority = *options->http2_priority;
+    } else {
+        stream->priority.urgency = AWS_HTTP2_PRIORITY_URGENCY_DEFAULT;
+        stream->priority.incremental = true;
+    }
+
     /* if there's a request body to write, add it as the first outgoing write */
-    struct aws_input_stream *body_stream = aws_http_message_get_body_stream(options->request);
+    struct aws_input_stream *body_stream = NULL;
+    if (options->content_encoding) {
+        body_stream =
+            aws_http_content_encoding_stream_new(stream->base.alloc, options->request, options->content_encoding);
+        if (!body_stream) {
+            goto error;
+        }
+
+        /* The outgoing message is the stream's own copy of the request, so its headers can be changed.
+         * The encoded length isn't known in advance */
+        struct aws_http_headers *h2_headers = aws_http_message_get_headers(stream->thread_data.outgoing_message);
+        aws_http_headers_erase(h2_headers, aws_byte_cursor_from_c_str("content-length"));
+        if (aws_http_headers_add(
+                h2_headers,
+                aws_byte_cursor_from_c_str("content-encoding"),
+                options->content_encoding->content_coding)) {
+            aws_input_stream_release(body_stream);
+            goto error;
+        }
+    } else {
+        body_stream = aws_http_message_acquire_outgoing_body(stream->base.alloc, options->request);
+    }
+
     if (body_stream) {
         struct aws_h2_stream_data_write *body_write =
             aws_mem_calloc(stream->base.alloc, 1, sizeof(struct aws_h2_stream_data_write));
-        body_write->data_stream = aws_input_stream_acquire(body_stream);
+        body_write->data_stream = body_stream;
         body_write->end_stream = !stream->manual_write;
         aws_linked_list_push_back(&stream->thread_data.outgoing_writes, &body_write->node);
     }
@@ -317,6 +426,7 @@ struct aws_h2_stream *aws_h2_stream_new_request(
     }
     aws_channel_task_init(
         &stream->cross_thread_work_task, s_stream_cross_thread_work_task, stream, "HTTP/2 stream cross-thread work");
+    AWS_HTTP_PROBE2(stream__create, &stream->base, client_connection);
     return stream;
 error:
     s_stream_destroy(&stream->base);
@@ -366,16 +476,15 @@ static void s_stream_cross_thread_work_task(struct aws_channel_task *task, void
     } /* END CRITICAL SECTION */
 
     if (window_update_size > 0 && !ignore_window_update) {
-        if (s_stream_send_update_window_frame(stream, window_update_size)) {
+        if (s_stream_send_update_window(stream, window_update_size)) {
             /* Treat this as a connection error */
             aws_h2_connection_shutdown_due_to_write_err(connection, aws_last_error());
         }
+    } else {
+        /* Nothing will be sent, but keep the window accurate */
+        stream->thread_data.window_size_self += window_update_size;
     }
 
-    /* The largest legal value will be 2 * max window size, which is way less than INT64_MAX, so if the window_size_self
-     * overflows, remote peer will find it out. So just apply the change and ignore the possible overflow.*/
-    stream->thread_data.window_size_self += window_update_size;
-
     if (reset_called) {
         struct aws_h2err returned_h2err = s_send_rst_and_close_stream(stream, reset_error);
         if (aws_h2err_failed(returned_h2err)) {
@@ -407,6 +516,12 @@ static void s_stream_data_write_destroy(
 
     AWS_PRECONDITION(stream);
     AWS_PRECONDITION(write);
+    if (write->zero_copy_in_flight.len > 0) {
+        /* The channel still holds part of the caller's memory, finish destroying once it's done with it */
+        write->destroy_pending = true;
+        write->destroy_error_code = error_code;
+        return;
+    }
     if (write->on_complete) {
         write->on_complete(&stream->base, error_code, write->user_data);
     }
@@ -457,6 +572,7 @@ void aws_h2_stream_complete(struct aws_h2_stream *stream, int error_code) {
     } /* END CRITICAL SECTION */
 
     s_h2_stream_destroy_pending_writes(stream);
+    AWS_HTTP_PROBE2(stream__complete, &stream->base, error_code);
 
     /* Invoke callback */
     if (stream->base.on_metrics) {
@@ -649,7 +765,7 @@ static struct aws_h2err s_send_rst_and_close_stream(struct aws_h2_stream *stream
 
     /* Send RST_STREAM */
     struct aws_h2_frame *rst_stream_frame =
-        aws_h2_frame_new_rst_stream(stream->base.alloc, stream->base.id, stream_error.h2_code);
+        aws_h2_frame_new_rst_stream(connection->thread_data.frame_allocator, stream->base.id, stream_error.h2_code);
     AWS_FATAL_ASSERT(rst_stream_frame != NULL);
     aws_h2_connection_enqueue_outgoing_frame(connection, rst_stream_frame); /* connection takes ownership of frame */
     stream->sent_reset_error_code = stream_error.h2_code;
@@ -703,11 +819,6 @@ static struct aws_h2_stream_data_write *s_h2_stream_get_current_write(struct aws
     return write;
 }
 
-static struct aws_input_stream *s_h2_stream_get_data_stream(struct aws_h2_stream *stream) {
-    struct aws_h2_stream_data_write *write = s_h2_stream_get_current_write(stream);
-    return write->data_stream;
-}
-
 static bool s_h2_stream_does_current_write_end_stream(struct aws_h2_stream *stream) {
     struct aws_h2_stream_data_write *write = s_h2_stream_get_current_write(stream);
     return write->end_stream;
@@ -723,12 +834,22 @@ int aws_h2_stream_on_activated(struct aws_h2_stream *stream, enum aws_h2_stream_
     /* Should be ensured when the stream is created */
     AWS_ASSERT(aws_http_message_get_protocol_version(msg) == AWS_HTTP_VERSION_2);
     /* If manual write, always has data to be sent. */
-    bool with_data = aws_http_message_get_body_stream(msg) != NULL || stream->manual_write;
+    bool with_data = aws_http_message_get_body_stream(msg) != NULL ||
+                     aws_http_message_get_body_async_stream(msg) != NULL || stream->manual_write;
 
     struct aws_http_headers *h2_headers = aws_http_message_get_headers(msg);
 
+    /* RFC-8441 Section 4: Extended CONNECT (the :protocol pseudo-header) may only be used
+     * once the peer has sent SETTINGS_ENABLE_CONNECT_PROTOCOL=1 */
+    if (aws_http_headers_has(h2_headers, aws_http_header_protocol) &&
+        !connection->thread_data.peer_enables_connect_protocol) {
+        AWS_H2_STREAM_LOG(ERROR, stream, "Cannot send extended CONNECT, peer has not enabled the CONNECT protocol");
+        aws_raise_error(AWS_ERROR_HTTP_EXTENDED_CONNECT_NOT_SUPPORTED);
+        goto error;
+    }
+
     struct aws_h2_frame *headers_frame = aws_h2_frame_new_headers(
-        stream->base.alloc,
+        connection->thread_data.frame_allocator,
         stream->base.id,
         h2_headers,
         !with_data /* end_stream */,
@@ -739,8 +860,18 @@ int aws_h2_stream_on_activated(struct aws_h2_stream *stream, enum aws_h2_stream_
         AWS_H2_STREAM_LOGF(ERROR, stream, "Failed to create HEADERS frame: %s", aws_error_name(aws_last_error()));
         goto error;
     }
-    AWS_ASSERT(stream->base.metrics.send_start_timestamp_ns == -1);
-    aws_high_res_clock_get_ticks((uint64_t *)&stream->base.metrics.send_start_timestamp_ns);
+    struct aws_http_stream_metrics *metrics = &stream->base.metrics;
+    AWS_ASSERT(metrics->send_start_timestamp_ns == -1);
+    aws_high_res_clock_get_ticks((uint64_t *)&metrics->send_start_timestamp_ns);
+    if (metrics->queue_start_timestamp_ns != -1) {
+        metrics->queue_duration_ns = metrics->send_start_timestamp_ns - metrics->queue_start_timestamp_ns;
+    }
+    const size_t header_count = aws_http_headers_count(h2_headers);
+    for (size_t i = 0; i < header_count; ++i) {
+        struct aws_http_header header;
+        aws_http_headers_get_index(h2_headers, i, &header);
+        metrics->header_bytes_sent += header.name.len + header.value.len;
+    }
     /* Initialize the flow-control window size */
     stream->thread_data.window_size_peer =
         connection->thread_data.settings_peer[AWS_HTTP2_SETTINGS_INITIAL_WINDOW_SIZE];
@@ -773,17 +904,41 @@ int aws_h2_stream_on_activated(struct aws_h2_stream *stream, enum aws_h2_stream_
         }
     }
     aws_h2_connection_enqueue_outgoing_frame(connection, headers_frame);
+
+    /* The HEADERS frame holds its own reference to the headers, and the body is already in outgoing_writes.
+     * Drop the message now rather than carrying it (possibly a converted copy of the request) until destroy */
+    stream->thread_data.outgoing_message = aws_http_message_release(stream->thread_data.outgoing_message);
     return AWS_OP_SUCCESS;
 
 error:
     return AWS_OP_ERR;
 }
 
+/* The read an async body stream was waiting on completed, see aws_http_async_body_stream_wait() */
+static void s_on_async_body_ready(void *user_data) {
+    struct aws_h2_stream *stream = user_data;
+    struct aws_h2_connection *connection = s_get_h2_connection(stream);
+
+    if (stream->thread_data.waiting_for_body) {
+        stream->thread_data.waiting_for_body = false;
+
+        /* Unless the stream completed in the meantime, it's still asleep in waiting_streams_list */
+        if (stream->node.next != NULL) {
+            aws_linked_list_remove(&stream->node);
+            aws_linked_list_push_back(&connection->thread_data.outgoing_streams_list, &stream->node);
+            aws_h2_try_write_outgoing_frames(connection);
+        }
+
+        aws_http_stream_release(&stream->base);
+    }
+}
+
 int aws_h2_stream_encode_data_frame(
     struct aws_h2_stream *stream,
     struct aws_h2_frame_encoder *encoder,
     struct aws_byte_buf *output,
-    int *data_encode_status) {
+    int *data_encode_status,
+    struct aws_h2_stream_data_write **out_zero_copy_write) {
 
     AWS_PRECONDITION_ON_CHANNEL_THREAD(stream);
     AWS_PRECONDITION(
@@ -799,23 +954,48 @@ int aws_h2_stream_encode_data_frame(
     }
 
     *data_encode_status = AWS_H2_DATA_ENCODE_COMPLETE;
-    struct aws_input_stream *input_stream = s_h2_stream_get_data_stream(stream);
-    AWS_ASSERT(input_stream);
+    *out_zero_copy_write = NULL;
+    struct aws_h2_stream_data_write *write = s_h2_stream_get_current_write(stream);
 
     bool input_stream_complete = false;
     bool input_stream_stalled = false;
     bool ends_stream = s_h2_stream_does_current_write_end_stream(stream);
-    if (aws_h2_encode_data_frame(
+    /* The peer's window shrinks by exactly the DATA payload sent */
+    const int32_t prev_window_size_peer = stream->thread_data.window_size_peer;
+    int encode_result;
+    if (write->data_stream) {
+        encode_result = aws_h2_encode_data_frame(
             encoder,
             stream->base.id,
-            input_stream,
+            write->data_stream,
             ends_stream,
             0 /*pad_length*/,
             &stream->thread_data.window_size_peer,
             &connection->thread_data.window_size_peer,
             output,
             &input_stream_complete,
-            &input_stream_stalled)) {
+            &input_stream_stalled);
+    } else {
+        AWS_ASSERT(write->zero_copy_in_flight.len == 0);
+        encode_result = aws_h2_encode_zero_copy_data_frame(
+            encoder,
+            stream->base.id,
+            &write->zero_copy_data,
+            ends_stream,
+            &stream->thread_data.window_size_peer,
+            &connection->thread_data.window_size_peer,
+            output,
+            &write->zero_copy_in_flight,
+            &input_stream_complete);
+
+        if (encode_result == AWS_OP_SUCCESS && write->zero_copy_in_flight.len > 0) {
+            /* Keep stream alive until the channel is done with the payload, even if the stream completes now */
+            aws_atomic_fetch_add(&stream->base.refcount, 1);
+            *out_zero_copy_write = write;
+        }
+    }
+
+    if (encode_result) {
 
         /* Failed to write DATA, treat it as a Stream Error */
         AWS_H2_STREAM_LOGF(ERROR, stream, "Error encoding stream DATA, %s", aws_error_name(aws_last_error()));
@@ -825,6 +1005,9 @@ int aws_h2_stream_encode_data_frame(
         }
         return AWS_OP_SUCCESS;
     }
+    const uint32_t payload_len = (uint32_t)(prev_window_size_peer - stream->thread_data.window_size_peer);
+    stream->base.metrics.bytes_sent += payload_len;
+    AWS_HTTP_PROBE3(h2__frame__sent, connection, AWS_H2_FRAME_T_DATA, stream->base.id);
 
     bool waiting_writes = false;
     if (input_stream_complete) {
@@ -861,6 +1044,15 @@ int aws_h2_stream_encode_data_frame(
         if (input_stream_stalled) {
             AWS_ASSERT(!input_stream_complete);
             *data_encode_status = AWS_H2_DATA_ENCODE_ONGOING_BODY_STREAM_STALLED;
+            if (aws_http_async_body_stream_wait(
+                    write->data_stream, connection->base.channel_slot->channel, s_on_async_body_ready, stream)) {
+                /* Sleep until the read completes, rather than polling the body on every pass */
+                if (!stream->thread_data.waiting_for_body) {
+                    stream->thread_data.waiting_for_body = true;
+                    aws_atomic_fetch_add(&stream->base.refcount, 1);
+                }
+                *data_encode_status = AWS_H2_DATA_ENCODE_ONGOING_WAITING_FOR_BODY;
+            }
         }
         if (stream->thread_data.window_size_peer <= AWS_H2_MIN_WINDOW_SIZE) {
             /* if body and window both stalled, we take the window stalled status, which will take the stream out
@@ -886,23 +1078,18 @@ struct aws_h2err aws_h2_stream_on_decoder_headers_begin(struct aws_h2_stream *st
         return s_send_rst_and_close_stream(stream, stream_err);
     }
     aws_high_res_clock_get_ticks((uint64_t *)&stream->base.metrics.receive_start_timestamp_ns);
+    if (stream->base.metrics.time_to_first_byte_ns == -1 && stream->base.metrics.send_start_timestamp_ns != -1) {
+        stream->base.metrics.time_to_first_byte_ns =
+            stream->base.metrics.receive_start_timestamp_ns - stream->base.metrics.send_start_timestamp_ns;
+    }
 
     return AWS_H2ERR_SUCCESS;
 }
 
-struct aws_h2err aws_h2_stream_on_decoder_headers_i(
-    struct aws_h2_stream *stream,
-    const struct aws_http_header *header,
-    enum aws_http_header_name name_enum,
-    enum aws_http_header_block block_type) {
-
-    AWS_PRECONDITION_ON_CHANNEL_THREAD(stream);
-
-    /* Not calling s_check_state_allows_frame_type() here because we already checked
-     * at start of HEADERS frame in aws_h2_stream_on_decoder_headers_begin() */
-
-    bool is_server = stream->base.server_data;
-
+/* Check that a header-block of this type is allowed now.
+ * Not calling s_check_state_allows_frame_type() here because we already checked
+ * at start of HEADERS frame in aws_h2_stream_on_decoder_headers_begin() */
+static bool s_header_block_type_allowed(struct aws_h2_stream *stream, enum aws_http_header_block block_type) {
     /* RFC-7540 8.1 - Message consists of:
      * - 0+ Informational 1xx headers (response-only, decoder validates that this only occurs in responses)
      * - 1 main headers with normal request or response.
@@ -912,58 +1099,70 @@ struct aws_h2err aws_h2_stream_on_decoder_headers_i(
             if (stream->thread_data.received_main_headers) {
                 AWS_H2_STREAM_LOG(
                     ERROR, stream, "Malformed message, received informational (1xx) response after main response");
-                goto malformed;
+                return false;
             }
             break;
         case AWS_HTTP_HEADER_BLOCK_MAIN:
             if (stream->thread_data.received_main_headers) {
                 AWS_H2_STREAM_LOG(ERROR, stream, "Malformed message, received second set of headers");
-                goto malformed;
+                return false;
             }
             break;
         case AWS_HTTP_HEADER_BLOCK_TRAILING:
             if (!stream->thread_data.received_main_headers) {
                 /* A HEADERS frame without any pseudo-headers looks like trailing headers to the decoder */
                 AWS_H2_STREAM_LOG(ERROR, stream, "Malformed headers lack required pseudo-header fields.");
-                goto malformed;
+                return false;
             }
             break;
         default:
             AWS_ASSERT(0);
     }
+    return true;
+}
 
-    if (is_server) {
-        return aws_h2err_from_aws_code(AWS_ERROR_UNIMPLEMENTED);
-
-    } else {
-        /* Client */
-        switch (name_enum) {
-            case AWS_HTTP_HEADER_STATUS: {
-                uint64_t status_code = 0;
-                int err = aws_byte_cursor_utf8_parse_u64(header->value, &status_code);
-                AWS_ASSERT(!err && "Invalid :status value. Decoder should have already validated this");
-                (void)err;
-
-                stream->base.client_data->response_status = (int)status_code;
-            } break;
-            case AWS_HTTP_HEADER_CONTENT_LENGTH: {
-                if (stream->thread_data.content_length_received) {
-                    AWS_H2_STREAM_LOG(ERROR, stream, "Duplicate content-length value");
-                    goto malformed;
-                }
-                if (aws_byte_cursor_utf8_parse_u64(header->value, &stream->thread_data.incoming_content_length)) {
-                    AWS_H2_STREAM_LOG(ERROR, stream, "Invalid content-length value");
-                    goto malformed;
-                }
-                stream->thread_data.content_length_received = true;
-            } break;
-            default:
-                break;
-        }
+/* Process a single incoming header-field, before it's passed along to the user.
+ * Returns false if the message is malformed */
+static bool s_process_incoming_header(
+    struct aws_h2_stream *stream,
+    const struct aws_http_header *header,
+    enum aws_http_header_name name_enum) {
+
+    /* Client */
+    switch (name_enum) {
+        case AWS_HTTP_HEADER_STATUS: {
+            uint64_t status_code = 0;
+            int err = aws_byte_cursor_utf8_parse_u64(header->value, &status_code);
+            AWS_ASSERT(!err && "Invalid :status value. Decoder should have already validated this");
+            (void)err;
+
+            stream->base.client_data->response_status = (int)status_code;
+        } break;
+        case AWS_HTTP_HEADER_CONTENT_LENGTH: {
+            if (stream->thread_data.content_length_received) {
+                AWS_H2_STREAM_LOG(ERROR, stream, "Duplicate content-length value");
+                return false;
+            }
+            if (aws_byte_cursor_utf8_parse_u64(header->value, &stream->thread_data.incoming_content_length)) {
+                AWS_H2_STREAM_LOG(ERROR, stream, "Invalid content-length value");
+                return false;
+            }
+            stream->thread_data.content_length_received = true;
+        } break;
+        default:
+            break;
     }
+    return true;
+}
+
+static struct aws_h2err s_deliver_incoming_headers(
+    struct aws_h2_stream *stream,
+    const struct aws_http_header *headers,
+    size_t num_headers,
+    enum aws_http_header_block block_type) {
 
     if (stream->base.on_incoming_headers) {
-        if (stream->base.on_incoming_headers(&stream->base, block_type, header, 1, stream->base.user_data)) {
+        if (stream->base.on_incoming_headers(&stream->base, block_type, headers, num_headers, stream->base.user_data)) {
             AWS_H2_STREAM_LOGF(
                 ERROR, stream, "Incoming header callback raised error, %s", aws_error_name(aws_last_error()));
             return s_send_rst_and_close_stream(stream, aws_h2err_from_last_error());
@@ -971,13 +1170,64 @@ struct aws_h2err aws_h2_stream_on_decoder_headers_i(
     }
 
     return AWS_H2ERR_SUCCESS;
+}
 
-malformed:
-    /* RFC-9113 8.1.1 Malformed requests or responses that are detected MUST be treated as a stream error
-     * (Section 5.4.2) of type PROTOCOL_ERROR.*/
+/* RFC-9113 8.1.1 Malformed requests or responses that are detected MUST be treated as a stream error
+ * (Section 5.4.2) of type PROTOCOL_ERROR.*/
+static struct aws_h2err s_on_malformed_incoming_headers(struct aws_h2_stream *stream) {
     return s_send_rst_and_close_stream(stream, aws_h2err_from_h2_code(AWS_HTTP2_ERR_PROTOCOL_ERROR));
 }
 
+struct aws_h2err aws_h2_stream_on_decoder_headers_i(
+    struct aws_h2_stream *stream,
+    const struct aws_http_header *header,
+    enum aws_http_header_name name_enum,
+    enum aws_http_header_block block_type) {
+
+    AWS_PRECONDITION_ON_CHANNEL_THREAD(stream);
+
+    if (!s_header_block_type_allowed(stream, block_type)) {
+        return s_on_malformed_incoming_headers(stream);
+    }
+
+    if (stream->base.server_data) {
+        return aws_h2err_from_aws_code(AWS_ERROR_UNIMPLEMENTED);
+    }
+
+    if (!s_process_incoming_header(stream, header, name_enum)) {
+        return s_on_malformed_incoming_headers(stream);
+    }
+
+    return s_deliver_incoming_headers(stream, header, 1, block_type);
+}
+
+struct aws_h2err aws_h2_stream_on_decoder_headers_batch(
+    struct aws_h2_stream *stream,
+    const struct aws_http_header *headers,
+    const enum aws_http_header_name *name_enums,
+    size_t num_headers,
+    enum aws_http_header_block block_type) {
+
+    AWS_PRECONDITION_ON_CHANNEL_THREAD(stream);
+
+    if (!s_header_block_type_allowed(stream, block_type)) {
+        return s_on_malformed_incoming_headers(stream);
+    }
+
+    if (stream->base.server_data) {
+        return aws_h2err_from_aws_code(AWS_ERROR_UNIMPLEMENTED);
+    }
+
+    for (size_t i = 0; i < num_headers; ++i) {
+        if (!s_process_incoming_header(stream, &headers[i], name_enums[i])) {
+            return s_on_malformed_incoming_headers(stream);
+        }
+    }
+
+    /* Pass the whole header-block to the user at once */
+    return s_deliver_incoming_headers(stream, headers, num_headers, block_type);
+}
+
 struct aws_h2err aws_h2_stream_on_decoder_headers_end(
     struct aws_h2_stream *stream,
     bool malformed,
@@ -1000,6 +1250,12 @@ struct aws_h2err aws_h2_stream_on_decoder_headers_end(
         case AWS_HTTP_HEADER_BLOCK_MAIN:
             AWS_H2_STREAM_LOG(TRACE, stream, "Main header-block done.");
             stream->thread_data.received_main_headers = true;
+            if (stream->base.metrics.send_start_timestamp_ns != -1) {
+                uint64_t now_ns = 0;
+                aws_high_res_clock_get_ticks(&now_ns);
+                stream->base.metrics.time_to_headers_done_ns =
+                    (int64_t)now_ns - stream->base.metrics.send_start_timestamp_ns;
+            }
             break;
         case AWS_HTTP_HEADER_BLOCK_TRAILING:
             AWS_H2_STREAM_LOG(TRACE, stream, "Trailing 1xx header-block done.");
@@ -1041,23 +1297,6 @@ struct aws_h2err aws_h2_stream_on_decoder_push_promise(struct aws_h2_stream *str
     return AWS_H2ERR_SUCCESS;
 }
 
-static int s_stream_send_update_window(struct aws_h2_stream *stream, uint32_t window_size) {
-    struct aws_h2_frame *stream_window_update_frame =
-        aws_h2_frame_new_window_update(stream->base.alloc, stream->base.id, window_size);
-    if (!stream_window_update_frame) {
-        AWS_H2_STREAM_LOGF(
-            ERROR,
-            stream,
-            "WINDOW_UPDATE frame on stream failed to be sent, error %s",
-            aws_error_name(aws_last_error()));
-        return AWS_OP_ERR;
-    }
-
-    aws_h2_connection_enqueue_outgoing_frame(s_get_h2_connection(stream), stream_window_update_frame);
-    stream->thread_data.window_size_self += window_size;
-    return AWS_OP_SUCCESS;
-}
-
 struct aws_h2err aws_h2_stream_on_decoder_data_begin(
     struct aws_h2_stream *stream,
     uint32_t payload_len,
@@ -1070,6 +1309,7 @@ struct aws_h2err aws_h2_stream_on_decoder_data_begin(
     if (aws_h2err_failed(stream_err)) {
         return s_send_rst_and_close_stream(stream, stream_err);
     }
+    stream->base.metrics.bytes_received += payload_len;
 
     if (!stream->thread_data.received_main_headers) {
         AWS_H2_STREAM_LOG(ERROR, stream, "Malformed message, received DATA before main HEADERS");
@@ -1302,6 +1542,24 @@ struct aws_h2err aws_h2_stream_on_decoder_rst_stream(struct aws_h2_stream *strea
     return AWS_H2ERR_SUCCESS;
 }
 
+void aws_h2_stream_on_zero_copy_data_written(
+    struct aws_h2_stream *stream,
+    struct aws_h2_stream_data_write *write,
+    int error_code) {
+
+    AWS_PRECONDITION_ON_CHANNEL_THREAD(stream);
+    AWS_PRECONDITION(write->zero_copy_in_flight.len > 0);
+
+    AWS_ZERO_STRUCT(write->zero_copy_in_flight);
+    if (write->destroy_pending) {
+        /* If the last slice failed to write, that's the error the user should hear about */
+        int write_error_code = write->destroy_error_code ? write->destroy_error_code : error_code;
+        s_stream_data_write_destroy(stream, write, write_error_code);
+    }
+
+    aws_http_stream_release(&stream->base);
+}
+
 static int s_stream_write_data(
     struct aws_http_stream *stream_base,
     const struct aws_http2_stream_write_data_options *options) {
@@ -1314,6 +1572,10 @@ static int s_stream_write_data(
             "'http2_use_manual_data_writes' to true in 'aws_http_make_request_options'");
         return aws_raise_error(AWS_ERROR_HTTP_MANUAL_WRITE_NOT_ENABLED);
     }
+    if (options->data && options->zero_copy_data.len > 0) {
+        AWS_H2_STREAM_LOG(ERROR, stream, "Cannot write DATA from both an input stream and zero-copy data");
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
     struct aws_h2_connection *connection = s_get_h2_connection(stream);
 
     /* queue this new write into the pending write list for the stream */
@@ -1321,6 +1583,8 @@ static int s_stream_write_data(
         aws_mem_calloc(stream->base.alloc, 1, sizeof(struct aws_h2_stream_data_write));
     if (options->data) {
         pending_write->data_stream = aws_input_stream_acquire(options->data);
+    } else if (options->zero_copy_data.len > 0) {
+        pending_write->zero_copy_data = options->zero_copy_data;
     } else {
         struct aws_byte_cursor empty_cursor;
         AWS_ZERO_STRUCT(empty_cursor);
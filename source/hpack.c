@@ -10,13 +10,9 @@
 
 /* RFC-7540 6.5.2 */
 const size_t s_hpack_dynamic_table_initial_size = 4096;
-const size_t s_hpack_dynamic_table_initial_elements = 512;
 /* TODO: shouldn't be a hardcoded max_size, it should be driven by SETTINGS_HEADER_TABLE_SIZE */
 const size_t s_hpack_dynamic_table_max_size = 16 * 1024 * 1024;
 
-/* Used for growing the dynamic table buffer when it fills up */
-const float s_hpack_dynamic_table_buffer_growth_rate = 1.5F;
-
 struct aws_http_header s_static_header_table[] = {
 #define HEADER(_index, _name)                                                                                          \
     [_index] = {                                                                                                       \
@@ -46,72 +42,160 @@ struct aws_byte_cursor s_static_header_table_name_only[] = {
 #undef HEADER_WITH_VALUE
 };
 
-/* aws_http_header * -> size_t */
-static struct aws_hash_table s_static_header_reverse_lookup;
-/* aws_byte_cursor * -> size_t */
-static struct aws_hash_table s_static_header_reverse_lookup_name_only;
+/**
+ * Reverse lookup for the static table.
+ * Rather than a generic hash table, names are bucketed by length, and within a bucket
+ * told apart by their first and last bytes (which happen to be unique for every name in the static table).
+ * So a lookup costs a few byte compares and one memcmp, and never hashes the whole name.
+ * Entries with the same name are adjacent in the static table, so we just store the range for each name.
+ */
+enum {
+    AWS_HPACK_STATIC_NAME_MAX_LEN = 32,
+    AWS_HPACK_STATIC_NAMES_PER_LEN_MAX = 8,
+};
 
-static uint64_t s_header_hash(const void *key) {
-    const struct aws_http_header *header = key;
+struct aws_hpack_static_name {
+    uint8_t first_byte;
+    uint8_t last_byte;
+    uint8_t first_index; /* index of first entry with this name */
+    uint8_t end_index;   /* 1 past index of last entry with this name */
+};
 
-    return aws_hash_combine(aws_hash_byte_cursor_ptr(&header->name), aws_hash_byte_cursor_ptr(&header->value));
-}
+static struct aws_hpack_static_name_bucket {
+    size_t count;
+    struct aws_hpack_static_name names[AWS_HPACK_STATIC_NAMES_PER_LEN_MAX];
+} s_static_names_by_len[AWS_HPACK_STATIC_NAME_MAX_LEN + 1];
 
-static bool s_header_eq(const void *a, const void *b) {
-    const struct aws_http_header *left = a;
-    const struct aws_http_header *right = b;
+/* Returns NULL if name is not in the static table */
+static const struct aws_hpack_static_name *s_static_name_find(struct aws_byte_cursor name) {
+    if (name.len == 0 || name.len > AWS_HPACK_STATIC_NAME_MAX_LEN) {
+        return NULL;
+    }
 
-    if (!aws_byte_cursor_eq(&left->name, &right->name)) {
-        return false;
+    const struct aws_hpack_static_name_bucket *bucket = &s_static_names_by_len[name.len];
+    const uint8_t first_byte = name.ptr[0];
+    const uint8_t last_byte = name.ptr[name.len - 1];
+    for (size_t i = 0; i < bucket->count; ++i) {
+        const struct aws_hpack_static_name *static_name = &bucket->names[i];
+        if (static_name->first_byte == first_byte && static_name->last_byte == last_byte) {
+            /* This is the only candidate, but still need to check the whole name */
+            if (aws_byte_cursor_eq(&s_static_header_table_name_only[static_name->first_index], &name)) {
+                return static_name;
+            }
+            return NULL;
+        }
     }
 
-    /* If the header stored in the table doesn't have a value, then it's a match */
-    return aws_byte_cursor_eq(&left->value, &right->value);
+    return NULL;
+}
+
+static uint64_t s_header_hash(const void *key) {
+    const struct aws_http_header *header = key;
+
+    return aws_hash_combine(aws_hash_byte_cursor_ptr(&header->name), aws_hash_byte_cursor_ptr(&header->value));
 }
 
 void aws_hpack_static_table_init(struct aws_allocator *allocator) {
+    (void)allocator;
+
+    AWS_ZERO_ARRAY(s_static_names_by_len);
+    AWS_FATAL_ASSERT(s_static_header_table_size <= UINT8_MAX);
+
+    /* the table is 1-based indexing */
+    size_t i = 1;
+    while (i < s_static_header_table_size) {
+        const struct aws_byte_cursor name = s_static_header_table_name_only[i];
+
+        struct aws_hpack_static_name static_name = {
+            .first_byte = name.ptr[0],
+            .last_byte = name.ptr[name.len - 1],
+            .first_index = (uint8_t)i,
+        };
+
+        /* Entries with the same name are always adjacent */
+        do {
+            ++i;
+        } while (i < s_static_header_table_size && aws_byte_cursor_eq(&s_static_header_table_name_only[i], &name));
+        static_name.end_index = (uint8_t)i;
+
+        /* If these fail, the lookup scheme needs to change to accommodate new entries in the static table */
+        AWS_FATAL_ASSERT(name.len <= AWS_HPACK_STATIC_NAME_MAX_LEN);
+        struct aws_hpack_static_name_bucket *bucket = &s_static_names_by_len[name.len];
+        AWS_FATAL_ASSERT(bucket->count < AWS_HPACK_STATIC_NAMES_PER_LEN_MAX);
+        for (size_t j = 0; j < bucket->count; ++j) {
+            AWS_FATAL_ASSERT(
+                bucket->names[j].first_byte != static_name.first_byte ||
+                bucket->names[j].last_byte != static_name.last_byte);
+        }
 
-    int result = aws_hash_table_init(
-        &s_static_header_reverse_lookup,
-        allocator,
-        s_static_header_table_size - 1,
-        s_header_hash,
-        s_header_eq,
-        NULL,
-        NULL);
-    AWS_FATAL_ASSERT(AWS_OP_SUCCESS == result);
-
-    result = aws_hash_table_init(
-        &s_static_header_reverse_lookup_name_only,
-        allocator,
-        s_static_header_table_size - 1,
-        aws_hash_byte_cursor_ptr,
-        (aws_hash_callback_eq_fn *)aws_byte_cursor_eq,
-        NULL,
-        NULL);
-    AWS_FATAL_ASSERT(AWS_OP_SUCCESS == result);
-
-    /* Process in reverse so that name_only prefers lower indices */
-    for (size_t i = s_static_header_table_size - 1; i > 0; --i) {
-        /* the tables are created as 1-based indexing */
-        result = aws_hash_table_put(&s_static_header_reverse_lookup, &s_static_header_table[i], (void *)i, NULL);
-        AWS_FATAL_ASSERT(AWS_OP_SUCCESS == result);
-
-        result = aws_hash_table_put(
-            &s_static_header_reverse_lookup_name_only, &s_static_header_table_name_only[i], (void *)(i), NULL);
-        AWS_FATAL_ASSERT(AWS_OP_SUCCESS == result);
+        bucket->names[bucket->count++] = static_name;
     }
 }
 
 void aws_hpack_static_table_clean_up(void) {
-    aws_hash_table_clean_up(&s_static_header_reverse_lookup);
-    aws_hash_table_clean_up(&s_static_header_reverse_lookup_name_only);
+    /* Nothing allocated */
 }
 
 #define HPACK_LOGF(level, hpack, text, ...)                                                                            \
     AWS_LOGF_##level((hpack)->log_subject, "id=%p [HPACK]: " text, (hpack)->log_id, __VA_ARGS__)
 #define HPACK_LOG(level, hpack, text) HPACK_LOGF(level, hpack, "%s", text)
 
+/**
+ * -- Dynamic Table Notes --
+ * Entries are kept in a ring, newest first. Each entry gets a sequence number when it's inserted,
+ * which never changes, so an entry's index is simply (newest_seq - seq).
+ *
+ * The strings for all entries live in a single byte ring. An entry's name and value are always contiguous,
+ * and never wrap around the end of the ring (if they don't fit at the end, they go at the start).
+ * Once the ring's capacity is twice max_size, there's always room for a new entry after the
+ * RFC-7541 4.4 evictions, so we never need to evict extra entries (which would de-sync us from the peer).
+ * Until then, the ring grows on demand, so we don't allocate the full amount for a huge max_size we'll never use.
+ *
+ * Reverse lookups use intrusive hash chains: each bucket holds the seq of the newest entry that hashes there,
+ * and each entry holds the seq of the next older entry in its bucket.
+ * Evicted entries are never unlinked, a walk just stops once it reaches a seq older than the oldest entry.
+ *
+ * So inserts and evictions don't allocate, except while the table is growing into space it's never used before.
+ */
+struct aws_hpack_dynamic_table_entry {
+    struct aws_http_header header; /* name and value point into the string ring */
+    size_t string_offset;          /* where name (followed by value) is in the string ring */
+    uint64_t name_hash;
+    uint64_t header_hash;
+    uint64_t next_seq_name_only;      /* next older entry in same name-only bucket */
+    uint64_t next_seq_name_and_value; /* next older entry in same name-and-value bucket */
+};
+
+enum {
+    AWS_HPACK_DYNAMIC_TABLE_INITIAL_ENTRIES = 16,
+};
+
+/* Size in bytes of the smallest possible entry, according to [4.1] */
+static const size_t s_hpack_entry_overhead = 32;
+
+static struct aws_hpack_dynamic_table_entry *s_dynamic_table_entry_from_seq(
+    const struct aws_hpack_context *context,
+    uint64_t seq) {
+
+    return &context->dynamic_table.entries[seq % context->dynamic_table.entries_capacity];
+}
+
+/*
+ * Gets the entry from the dynamic table.
+ * NOTE: This function does not bounds check. Index 0 is the newest entry.
+ */
+static struct aws_hpack_dynamic_table_entry *s_dynamic_table_entry_get(
+    const struct aws_hpack_context *context,
+    size_t index) {
+
+    AWS_ASSERT(index < context->dynamic_table.num_elements);
+    return s_dynamic_table_entry_from_seq(context, context->dynamic_table.newest_seq - index);
+}
+
+static struct aws_http_header *s_dynamic_table_get(const struct aws_hpack_context *context, size_t index) {
+    return &s_dynamic_table_entry_get(context, index)->header;
+}
+
 void aws_hpack_context_init(
     struct aws_hpack_context *context,
     struct aws_allocator *allocator,
@@ -123,54 +207,27 @@ void aws_hpack_context_init(
     context->log_subject = log_subject;
     context->log_id = log_id;
 
-    /* Initialize dynamic table */
+    /* Storage is allocated on first insert */
     context->dynamic_table.max_size = s_hpack_dynamic_table_initial_size;
-    context->dynamic_table.buffer_capacity = s_hpack_dynamic_table_initial_elements;
-    context->dynamic_table.buffer =
-        aws_mem_calloc(allocator, context->dynamic_table.buffer_capacity, sizeof(struct aws_http_header));
-
-    aws_hash_table_init(
-        &context->dynamic_table.reverse_lookup,
-        allocator,
-        s_hpack_dynamic_table_initial_elements,
-        s_header_hash,
-        s_header_eq,
-        NULL,
-        NULL);
-
-    aws_hash_table_init(
-        &context->dynamic_table.reverse_lookup_name_only,
-        allocator,
-        s_hpack_dynamic_table_initial_elements,
-        aws_hash_byte_cursor_ptr,
-        (aws_hash_callback_eq_fn *)aws_byte_cursor_eq,
-        NULL,
-        NULL);
 }
 
-static struct aws_http_header *s_dynamic_table_get(const struct aws_hpack_context *context, size_t index);
-
-static void s_clean_up_dynamic_table_buffer(struct aws_hpack_context *context) {
-    while (context->dynamic_table.num_elements > 0) {
-        struct aws_http_header *back = s_dynamic_table_get(context, context->dynamic_table.num_elements - 1);
-        context->dynamic_table.num_elements -= 1;
-        /* clean-up the memory we allocate for it */
-        aws_mem_release(context->allocator, back->name.ptr);
-    }
-    aws_mem_release(context->allocator, context->dynamic_table.buffer);
+void aws_hpack_context_clean_up(struct aws_hpack_context *context) {
+    /* entries, buckets, and strings are all in one allocation */
+    aws_mem_release(context->allocator, context->dynamic_table.entries);
+    AWS_ZERO_STRUCT(*context);
 }
 
-void aws_hpack_context_clean_up(struct aws_hpack_context *context) {
-    if (context->dynamic_table.buffer) {
-        s_clean_up_dynamic_table_buffer(context);
+size_t aws_hpack_context_get_memory_usage(const struct aws_hpack_context *context) {
+    if (context->dynamic_table.entries == NULL) {
+        return 0;
     }
-    aws_hash_table_clean_up(&context->dynamic_table.reverse_lookup);
-    aws_hash_table_clean_up(&context->dynamic_table.reverse_lookup_name_only);
-    AWS_ZERO_STRUCT(*context);
+    /* entries, buckets, and strings are all in one allocation, see s_dynamic_table_realloc() */
+    return context->dynamic_table.entries_capacity * sizeof(struct aws_hpack_dynamic_table_entry) +
+           context->dynamic_table.bucket_count * 2 * sizeof(uint64_t) + context->dynamic_table.strings_capacity;
 }
 
 size_t aws_hpack_get_header_size(const struct aws_http_header *header) {
-    return header->name.len + header->value.len + 32;
+    return header->name.len + header->value.len + s_hpack_entry_overhead;
 }
 
 size_t aws_hpack_get_dynamic_table_num_elements(const struct aws_hpack_context *context) {
@@ -181,18 +238,6 @@ size_t aws_hpack_get_dynamic_table_max_size(const struct aws_hpack_context *cont
     return context->dynamic_table.max_size;
 }
 
-/*
- * Gets the header from the dynamic table.
- * NOTE: This function only bounds checks on the buffer size, not the number of elements.
- */
-static struct aws_http_header *s_dynamic_table_get(const struct aws_hpack_context *context, size_t index) {
-
-    AWS_ASSERT(index < context->dynamic_table.buffer_capacity);
-
-    return &context->dynamic_table
-                .buffer[(context->dynamic_table.index_0 + index) % context->dynamic_table.buffer_capacity];
-}
-
 const struct aws_http_header *aws_hpack_get_header(const struct aws_hpack_context *context, size_t index) {
     if (index == 0 || index >= s_static_header_table_size + context->dynamic_table.num_elements) {
         aws_raise_error(AWS_ERROR_INVALID_INDEX);
@@ -208,6 +253,43 @@ const struct aws_http_header *aws_hpack_get_header(const struct aws_hpack_contex
     return s_dynamic_table_get(context, index - s_static_header_table_size);
 }
 
+/* Returns seq of newest entry in dynamic table matching this header (or just its name), or 0 if none found */
+static uint64_t s_dynamic_table_find(
+    const struct aws_hpack_context *context,
+    const struct aws_http_header *header,
+    bool match_value) {
+
+    if (context->dynamic_table.num_elements == 0) {
+        return 0;
+    }
+
+    const uint64_t oldest_seq = context->dynamic_table.newest_seq - context->dynamic_table.num_elements + 1;
+    const uint64_t hash = match_value ? s_header_hash(header) : aws_hash_byte_cursor_ptr(&header->name);
+    const size_t bucket = (size_t)hash & (context->dynamic_table.bucket_count - 1);
+
+    uint64_t seq = match_value ? context->dynamic_table.buckets_name_and_value[bucket]
+                               : context->dynamic_table.buckets_name_only[bucket];
+
+    /* seq 0 is never used, so an empty bucket will also end the loop */
+    while (seq >= oldest_seq) {
+        const struct aws_hpack_dynamic_table_entry *entry = s_dynamic_table_entry_from_seq(context, seq);
+        if (match_value) {
+            if (entry->header_hash == hash && aws_byte_cursor_eq(&entry->header.name, &header->name) &&
+                aws_byte_cursor_eq(&entry->header.value, &header->value)) {
+                return seq;
+            }
+            seq = entry->next_seq_name_and_value;
+        } else {
+            if (entry->name_hash == hash && aws_byte_cursor_eq(&entry->header.name, &header->name)) {
+                return seq;
+            }
+            seq = entry->next_seq_name_only;
+        }
+    }
+
+    return 0;
+}
+
 /* TODO: remove `bool search_value`, this option has no reason to exist */
 size_t aws_hpack_find_index(
     const struct aws_hpack_context *context,
@@ -217,184 +299,264 @@ size_t aws_hpack_find_index(
 
     *found_value = false;
 
-    struct aws_hash_element *elem = NULL;
+    const struct aws_hpack_static_name *static_name = s_static_name_find(header->name);
+
+    uint64_t seq = 0;
     if (search_value) {
         /* Check name-and-value first in static table */
-        aws_hash_table_find(&s_static_header_reverse_lookup, header, &elem);
-        if (elem) {
-            /* TODO: Maybe always set found_value to true? Who cares that the value is empty if they matched? */
-            /* If an element was found, check if it has a value */
-            *found_value = ((const struct aws_http_header *)elem->key)->value.len;
-            return (size_t)elem->value;
+        if (static_name) {
+            for (size_t i = static_name->first_index; i < static_name->end_index; ++i) {
+                const struct aws_byte_cursor *static_value = &s_static_header_table[i].value;
+                if (aws_byte_cursor_eq(static_value, &header->value)) {
+                    /* TODO: Maybe always set found_value to true? Who cares that the value is empty if they matched? */
+                    /* If an element was found, check if it has a value */
+                    *found_value = static_value->len;
+                    return i;
+                }
+            }
         }
         /* Check name-and-value in dynamic table */
-        aws_hash_table_find(&context->dynamic_table.reverse_lookup, header, &elem);
-        if (elem) {
+        seq = s_dynamic_table_find(context, header, true /*match_value*/);
+        if (seq) {
             /* TODO: Maybe always set found_value to true? Who cares that the value is empty if they matched? */
-            *found_value = ((const struct aws_http_header *)elem->key)->value.len;
+            *found_value = header->value.len;
             goto trans_index_from_dynamic_table;
         }
     }
     /* Check the name-only table. Note, even if we search for value, when we fail in searching for name-and-value, we
      * should also check the name only table */
-    aws_hash_table_find(&s_static_header_reverse_lookup_name_only, &header->name, &elem);
-    if (elem) {
-        return (size_t)elem->value;
+    if (static_name) {
+        return static_name->first_index;
     }
-    aws_hash_table_find(&context->dynamic_table.reverse_lookup_name_only, &header->name, &elem);
-    if (elem) {
+    seq = s_dynamic_table_find(context, header, false /*match_value*/);
+    if (seq) {
         goto trans_index_from_dynamic_table;
     }
     return 0;
 
 trans_index_from_dynamic_table:
-    AWS_ASSERT(elem);
-    size_t index;
-    const size_t absolute_index = (size_t)elem->value;
-    if (absolute_index >= context->dynamic_table.index_0) {
-        index = absolute_index - context->dynamic_table.index_0;
-    } else {
-        index = (context->dynamic_table.buffer_capacity - context->dynamic_table.index_0) + absolute_index;
-    }
     /* Need to add the static table size to re-base indicies */
-    index += s_static_header_table_size;
-    return index;
+    return (size_t)(context->dynamic_table.newest_seq - seq) + s_static_header_table_size;
 }
 
-/* Remove elements from the dynamic table until it fits in max_size bytes */
-static int s_dynamic_table_shrink(struct aws_hpack_context *context, size_t max_size) {
-    while (context->dynamic_table.size > max_size && context->dynamic_table.num_elements > 0) {
-        struct aws_http_header *back = s_dynamic_table_get(context, context->dynamic_table.num_elements - 1);
-
-        /* "Remove" the header from the table */
-        context->dynamic_table.size -= aws_hpack_get_header_size(back);
-        context->dynamic_table.num_elements -= 1;
-
-        /* Remove old header from hash tables */
-        if (aws_hash_table_remove(&context->dynamic_table.reverse_lookup, back, NULL, NULL)) {
-            HPACK_LOG(ERROR, context, "Failed to remove header from the reverse lookup table");
-            goto error;
+/* Find where `len` bytes of strings can go in the ring, without overwriting live entries or wrapping.
+ * Returns false if there's no room */
+static bool s_dynamic_table_find_string_space(const struct aws_hpack_context *context, size_t len, size_t *out_offset) {
+    const size_t capacity = context->dynamic_table.strings_capacity;
+    const size_t head = context->dynamic_table.strings_head;
+
+    if (context->dynamic_table.num_elements == 0) {
+        /* strings_head is reset to 0 when the table is emptied */
+        AWS_ASSERT(head == 0);
+        if (len <= capacity) {
+            *out_offset = 0;
+            return true;
         }
+        return false;
+    }
 
-        /* If the name-only lookup is pointing to the element we're removing, it needs to go.
-         * If not, it's pointing to a younger, sexier element. */
-        struct aws_hash_element *elem = NULL;
-        aws_hash_table_find(&context->dynamic_table.reverse_lookup_name_only, &back->name, &elem);
-        if (elem && elem->key == back) {
-            if (aws_hash_table_remove_element(&context->dynamic_table.reverse_lookup_name_only, elem)) {
-                HPACK_LOG(ERROR, context, "Failed to remove header from the reverse lookup (name-only) table");
-                goto error;
-            }
-        }
+    /* tail is where the oldest entry's strings are */
+    const size_t tail = s_dynamic_table_entry_get(context, context->dynamic_table.num_elements - 1)->string_offset;
 
-        /* clean up the memory we allocated to hold the name and value string*/
-        aws_mem_release(context->allocator, back->name.ptr);
+    if (context->dynamic_table.strings_wrapped) {
+        /* Live strings are at [tail, end) and [0, head). Only free space is [head, tail) */
+        if (tail - head >= len) {
+            *out_offset = head;
+            return true;
+        }
+        return false;
     }
 
-    return AWS_OP_SUCCESS;
-
-error:
-    return AWS_OP_ERR;
+    /* Live strings are at [tail, head). Free space is [head, capacity) and [0, tail) */
+    if (capacity - head >= len) {
+        *out_offset = head;
+        return true;
+    }
+    if (tail >= len) {
+        *out_offset = 0;
+        return true;
+    }
+    return false;
 }
 
-/*
- * Resizes the dynamic table storage buffer to new_max_elements.
- * Useful when inserting over capacity, or when downsizing.
- * Do shrink first, if you want to remove elements, or memory leak will happen.
- */
-static int s_dynamic_table_resize_buffer(struct aws_hpack_context *context, size_t new_max_elements) {
-
-    /* Clear the old hash tables */
-    aws_hash_table_clear(&context->dynamic_table.reverse_lookup);
-    aws_hash_table_clear(&context->dynamic_table.reverse_lookup_name_only);
+/* Add a new entry at the front of the table.
+ * Caller must ensure there's room for it in entries, and that string_offset came from
+ * s_dynamic_table_find_string_space(). Does not update size. */
+static void s_dynamic_table_push(
+    struct aws_hpack_context *context,
+    const struct aws_http_header *header,
+    size_t string_offset) {
 
-    struct aws_http_header *new_buffer = NULL;
+    AWS_ASSERT(context->dynamic_table.num_elements < context->dynamic_table.entries_capacity);
 
-    if (AWS_UNLIKELY(new_max_elements == 0)) {
-        /* If new buffer is of size 0, don't both initializing, just clean up the old one. */
-        goto cleanup_old_buffer;
+    if (context->dynamic_table.num_elements > 0 && string_offset < context->dynamic_table.strings_head) {
+        context->dynamic_table.strings_wrapped = true;
     }
 
-    /* Allocate the new buffer */
-    new_buffer = aws_mem_calloc(context->allocator, new_max_elements, sizeof(struct aws_http_header));
-    if (!new_buffer) {
-        return AWS_OP_ERR;
+    context->dynamic_table.newest_seq++;
+    context->dynamic_table.num_elements++;
+    const uint64_t seq = context->dynamic_table.newest_seq;
+    struct aws_hpack_dynamic_table_entry *entry = s_dynamic_table_entry_from_seq(context, seq);
+
+    /* Copy strings into the ring.
+     * Use memmove, since the name may refer to an entry that was just evicted to make room for this one (RFC-7541 4.4),
+     * and whose memory we may now be reusing */
+    uint8_t *dst = context->dynamic_table.strings + string_offset;
+    if (header->name.len) {
+        memmove(dst, header->name.ptr, header->name.len);
     }
-
-    /* Don't bother copying data if old buffer was of size 0 */
-    if (AWS_UNLIKELY(context->dynamic_table.num_elements == 0)) {
-        goto reset_dyn_table_state;
+    if (header->value.len) {
+        memmove(dst + header->name.len, header->value.ptr, header->value.len);
     }
+    entry->header = *header;
+    entry->header.name.ptr = dst;
+    entry->header.value.ptr = dst + header->name.len;
+    entry->string_offset = string_offset;
+    context->dynamic_table.strings_head = string_offset + header->name.len + header->value.len;
+
+    /* Link into reverse lookup */
+    const size_t bucket_mask = context->dynamic_table.bucket_count - 1;
+
+    entry->name_hash = aws_hash_byte_cursor_ptr(&entry->header.name);
+    size_t bucket = (size_t)entry->name_hash & bucket_mask;
+    entry->next_seq_name_only = context->dynamic_table.buckets_name_only[bucket];
+    context->dynamic_table.buckets_name_only[bucket] = seq;
+
+    entry->header_hash = s_header_hash(&entry->header);
+    bucket = (size_t)entry->header_hash & bucket_mask;
+    entry->next_seq_name_and_value = context->dynamic_table.buckets_name_and_value[bucket];
+    context->dynamic_table.buckets_name_and_value[bucket] = seq;
+}
 
-    /*
-     * Take a buffer that looks like this:
-     *
-     *               Index 0
-     *               ^
-     * +---------------------------+
-     * | Below Block | Above Block |
-     * +---------------------------+
-     * And make it look like this:
-     *
-     * Index 0
-     * ^
-     * +-------------+-------------+
-     * | Above Block | Below Block |
-     * +-------------+-------------+
-     */
-
-    /* Copy as much the above block as possible */
-    size_t above_block_size = context->dynamic_table.buffer_capacity - context->dynamic_table.index_0;
-    if (above_block_size > new_max_elements) {
-        above_block_size = new_max_elements;
-    }
-    memcpy(
-        new_buffer,
-        context->dynamic_table.buffer + context->dynamic_table.index_0,
-        above_block_size * sizeof(struct aws_http_header));
-
-    /* Copy as much of below block as possible */
-    const size_t free_blocks_available = new_max_elements - above_block_size;
-    const size_t old_blocks_to_copy = context->dynamic_table.buffer_capacity - above_block_size;
-    const size_t below_block_size = aws_min_size(free_blocks_available, old_blocks_to_copy);
-    if (below_block_size) {
-        memcpy(
-            new_buffer + above_block_size,
-            context->dynamic_table.buffer,
-            below_block_size * sizeof(struct aws_http_header));
+/* Remove the oldest entry. The memory isn't touched, it just becomes available for reuse */
+static void s_dynamic_table_pop_back(struct aws_hpack_context *context) {
+    AWS_ASSERT(context->dynamic_table.num_elements > 0);
+
+    const struct aws_hpack_dynamic_table_entry *back =
+        s_dynamic_table_entry_get(context, context->dynamic_table.num_elements - 1);
+
+    context->dynamic_table.size -= aws_hpack_get_header_size(&back->header);
+    context->dynamic_table.num_elements -= 1;
+
+    if (context->dynamic_table.num_elements == 0) {
+        context->dynamic_table.strings_head = 0;
+        context->dynamic_table.strings_wrapped = false;
+    } else if (context->dynamic_table.strings_wrapped) {
+        /* If the new oldest entry is before the one we removed, the tail has wrapped around to meet the head */
+        const struct aws_hpack_dynamic_table_entry *new_back =
+            s_dynamic_table_entry_get(context, context->dynamic_table.num_elements - 1);
+        if (new_back->string_offset < back->string_offset) {
+            context->dynamic_table.strings_wrapped = false;
+        }
     }
+}
 
-    /* Free the old memory */
-cleanup_old_buffer:
-    aws_mem_release(context->allocator, context->dynamic_table.buffer);
-
-    /* Reset state */
-reset_dyn_table_state:
-    if (context->dynamic_table.num_elements > new_max_elements) {
-        context->dynamic_table.num_elements = new_max_elements;
+/* Remove elements from the dynamic table until it fits in max_size bytes */
+static void s_dynamic_table_shrink(struct aws_hpack_context *context, size_t max_size) {
+    while (context->dynamic_table.size > max_size && context->dynamic_table.num_elements > 0) {
+        s_dynamic_table_pop_back(context);
     }
-    context->dynamic_table.buffer_capacity = new_max_elements;
-    context->dynamic_table.index_0 = 0;
-    context->dynamic_table.buffer = new_buffer;
-
-    /* Re-insert all of the reverse lookup elements */
-    for (size_t i = 0; i < context->dynamic_table.num_elements; ++i) {
-        if (aws_hash_table_put(
-                &context->dynamic_table.reverse_lookup, &context->dynamic_table.buffer[i], (void *)i, NULL)) {
+}
+
+/*
+ * Move the dynamic table into new storage, with the given capacities.
+ * Entries are re-inserted oldest first, so the strings end up compacted at the start of the new ring.
+ * If new_header is set, it's pushed as the newest entry before the old storage is freed,
+ * since its name may point into the old storage (RFC-7541 4.4). Does not update size.
+ * Capacities of 0 free all storage (the table must be empty).
+ */
+static int s_dynamic_table_realloc(
+    struct aws_hpack_context *context,
+    size_t entries_capacity,
+    size_t strings_capacity,
+    const struct aws_http_header *new_header) {
+
+    AWS_ASSERT(entries_capacity >= context->dynamic_table.num_elements);
+
+    /* Keep a copy of the old storage until everything's been moved */
+    struct aws_hpack_context old_context = *context;
+
+    size_t bucket_count = 0;
+    struct aws_hpack_dynamic_table_entry *allocation = NULL;
+    if (entries_capacity > 0) {
+        /* Buckets for twice as many entries, to keep the chains short */
+        size_t entries_bytes;
+        size_t buckets_bytes;
+        size_t total_bytes;
+        if (aws_mul_size_checked(entries_capacity, 2, &bucket_count) ||
+            aws_round_up_to_power_of_two(bucket_count, &bucket_count) ||
+            aws_mul_size_checked(entries_capacity, sizeof(struct aws_hpack_dynamic_table_entry), &entries_bytes) ||
+            aws_mul_size_checked(bucket_count, 2 * sizeof(uint64_t), &buckets_bytes) ||
+            aws_add_size_checked(entries_bytes, buckets_bytes, &total_bytes) ||
+            aws_add_size_checked(total_bytes, strings_capacity, &total_bytes)) {
             return AWS_OP_ERR;
         }
-        if (aws_hash_table_put(
-                &context->dynamic_table.reverse_lookup_name_only,
-                &context->dynamic_table.buffer[i].name,
-                (void *)i,
-                NULL)) {
+
+        /* Entries and buckets are 8-byte aligned, so put strings last */
+        allocation = aws_mem_calloc(context->allocator, 1, total_bytes);
+        if (!allocation) {
             return AWS_OP_ERR;
         }
+
+        context->dynamic_table.buckets_name_only = (uint64_t *)((uint8_t *)allocation + entries_bytes);
+        context->dynamic_table.buckets_name_and_value = context->dynamic_table.buckets_name_only + bucket_count;
+        context->dynamic_table.strings = (uint8_t *)(context->dynamic_table.buckets_name_and_value + bucket_count);
+    } else {
+        AWS_ASSERT(context->dynamic_table.num_elements == 0);
+        context->dynamic_table.buckets_name_only = NULL;
+        context->dynamic_table.buckets_name_and_value = NULL;
+        context->dynamic_table.strings = NULL;
+        strings_capacity = 0;
     }
 
+    context->dynamic_table.entries = allocation;
+    context->dynamic_table.entries_capacity = entries_capacity;
+    context->dynamic_table.bucket_count = bucket_count;
+    context->dynamic_table.strings_capacity = strings_capacity;
+    context->dynamic_table.strings_head = 0;
+    context->dynamic_table.strings_wrapped = false;
+    context->dynamic_table.num_elements = 0;
+    context->dynamic_table.newest_seq = 0;
+
+    for (size_t n = old_context.dynamic_table.num_elements; n > 0; --n) {
+        const struct aws_http_header *old_header = s_dynamic_table_get(&old_context, n - 1);
+
+        size_t string_offset = 0;
+        bool has_space =
+            s_dynamic_table_find_string_space(context, old_header->name.len + old_header->value.len, &string_offset);
+        AWS_FATAL_ASSERT(has_space && "Strings always fit, they were compacted into a ring at least as big as used");
+        s_dynamic_table_push(context, old_header, string_offset);
+    }
+
+    if (new_header) {
+        size_t string_offset = 0;
+        bool has_space =
+            s_dynamic_table_find_string_space(context, new_header->name.len + new_header->value.len, &string_offset);
+        AWS_FATAL_ASSERT(has_space && "Caller must ensure new storage has room for new_header");
+        s_dynamic_table_push(context, new_header, string_offset);
+    }
+
+    aws_mem_release(context->allocator, old_context.dynamic_table.entries);
     return AWS_OP_SUCCESS;
 }
 
+/* Used bytes of string ring, not counting any space wasted due to wrapping */
+static size_t s_dynamic_table_strings_used(const struct aws_hpack_context *context) {
+    /* Every entry's size includes the overhead */
+    return context->dynamic_table.size - (context->dynamic_table.num_elements * s_hpack_entry_overhead);
+}
+
+int aws_hpack_context_compact(struct aws_hpack_context *context) {
+    const size_t entries_capacity = context->dynamic_table.num_elements;
+    const size_t strings_capacity = entries_capacity ? s_dynamic_table_strings_used(context) : 0;
+    if (entries_capacity == context->dynamic_table.entries_capacity &&
+        strings_capacity == context->dynamic_table.strings_capacity) {
+        return AWS_OP_SUCCESS;
+    }
+
+    return s_dynamic_table_realloc(context, entries_capacity, strings_capacity, NULL);
+}
+
 int aws_hpack_insert_header(struct aws_hpack_context *context, const struct aws_http_header *header) {
 
     /* Don't move forward if no elements allowed in the dynamic table */
@@ -412,73 +574,41 @@ int aws_hpack_insert_header(struct aws_hpack_context *context, const struct aws_
 
     /* Rotate out headers until there's room for the new header (this function will return immediately if nothing needs
      * to be evicted) */
-    if (s_dynamic_table_shrink(context, context->dynamic_table.max_size - header_size)) {
-        goto error;
-    }
+    s_dynamic_table_shrink(context, context->dynamic_table.max_size - header_size);
+
+    /* If we're out of space in the entries ring, or string ring, grow them.
+     * The string ring is never grown past twice max_size, at which point there's always space. */
+    const size_t strings_len = header->name.len + header->value.len;
+    size_t string_offset = 0;
+    const bool need_entry = context->dynamic_table.num_elements == context->dynamic_table.entries_capacity;
+    const bool need_strings = !s_dynamic_table_find_string_space(context, strings_len, &string_offset);
+    if (need_entry || need_strings) {
+        size_t entries_capacity = context->dynamic_table.entries_capacity;
+        if (need_entry) {
+            entries_capacity = aws_max_size(entries_capacity * 2, AWS_HPACK_DYNAMIC_TABLE_INITIAL_ENTRIES);
+        }
 
-    /* If we're out of space in the buffer, grow it */
-    if (context->dynamic_table.num_elements == context->dynamic_table.buffer_capacity) {
-        /* If the buffer is currently of 0 size, reset it back to its initial size */
-        const size_t new_size =
-            context->dynamic_table.buffer_capacity
-                ? (size_t)(context->dynamic_table.buffer_capacity * s_hpack_dynamic_table_buffer_growth_rate)
-                : s_hpack_dynamic_table_initial_elements;
+        size_t strings_capacity = context->dynamic_table.strings_capacity;
+        if (need_strings) {
+            const size_t strings_max_capacity = context->dynamic_table.max_size * 2;
+            AWS_FATAL_ASSERT(strings_capacity < strings_max_capacity && "String ring at max capacity always has space");
 
-        if (s_dynamic_table_resize_buffer(context, new_size)) {
-            goto error;
+            strings_capacity = aws_max_size(strings_capacity * 2, s_hpack_dynamic_table_initial_size);
+            strings_capacity = aws_max_size(strings_capacity, s_dynamic_table_strings_used(context) + strings_len);
+            strings_capacity = aws_min_size(strings_capacity, strings_max_capacity);
         }
-    }
 
-    /* Decrement index 0, wrapping if necessary */
-    if (context->dynamic_table.index_0 == 0) {
-        context->dynamic_table.index_0 = context->dynamic_table.buffer_capacity - 1;
+        /* The header gets pushed during realloc, since its name may be in the storage that's being replaced */
+        if (s_dynamic_table_realloc(context, entries_capacity, strings_capacity, header)) {
+            goto error;
+        }
     } else {
-        context->dynamic_table.index_0--;
+        s_dynamic_table_push(context, header, string_offset);
     }
 
-    /* Increment num_elements */
-    context->dynamic_table.num_elements++;
     /* Increment the size */
     context->dynamic_table.size += header_size;
 
-    /* Put the header at the "front" of the table */
-    struct aws_http_header *table_header = s_dynamic_table_get(context, 0);
-
-    /* TODO:: We can optimize this with ring buffer. */
-    /* allocate memory for the name and value, which will be deallocated whenever the entry is evicted from the table or
-     * the table is cleaned up. We keep the pointer in the name pointer of each entry */
-    const size_t buf_memory_size = header->name.len + header->value.len;
-
-    if (buf_memory_size) {
-        uint8_t *buf_memory = aws_mem_acquire(context->allocator, buf_memory_size);
-        if (!buf_memory) {
-            return AWS_OP_ERR;
-        }
-        struct aws_byte_buf buf = aws_byte_buf_from_empty_array(buf_memory, buf_memory_size);
-        /* Copy header, then backup strings into our own allocation */
-        *table_header = *header;
-        aws_byte_buf_append_and_update(&buf, &table_header->name);
-        aws_byte_buf_append_and_update(&buf, &table_header->value);
-    } else {
-        /* if buf_memory_size is 0, no memory needed, we will insert the empty header into dynamic table */
-        *table_header = *header;
-        table_header->name.ptr = NULL;
-        table_header->value.ptr = NULL;
-    }
-    /* Write the new header to the look up tables */
-    if (aws_hash_table_put(
-            &context->dynamic_table.reverse_lookup, table_header, (void *)context->dynamic_table.index_0, NULL)) {
-        goto error;
-    }
-    /* Note that we can just blindly put here, we want to overwrite any older entry so it isn't accidentally removed. */
-    if (aws_hash_table_put(
-            &context->dynamic_table.reverse_lookup_name_only,
-            &table_header->name,
-            (void *)context->dynamic_table.index_0,
-            NULL)) {
-        goto error;
-    }
-
     return AWS_OP_SUCCESS;
 
 error:
@@ -506,13 +636,26 @@ int aws_hpack_resize_dynamic_table(struct aws_hpack_context *context, size_t new
     }
 
     /* If downsizing, remove elements until we're within the new size constraints */
-    if (s_dynamic_table_shrink(context, new_max_size)) {
-        goto error;
-    }
+    s_dynamic_table_shrink(context, new_max_size);
+
+    /* If downsizing, release memory we won't need anymore. Storage grows lazily on insert if upsizing */
+    if (new_max_size < context->dynamic_table.max_size) {
+        size_t entries_capacity = 0;
+        size_t strings_capacity = 0;
+        if (new_max_size > 0) {
+            /* Every entry takes at least 32 bytes, so that's the most that can fit */
+            entries_capacity =
+                aws_min_size(context->dynamic_table.entries_capacity, new_max_size / s_hpack_entry_overhead);
+            entries_capacity = aws_max_size(entries_capacity, context->dynamic_table.num_elements);
+            strings_capacity = aws_min_size(context->dynamic_table.strings_capacity, new_max_size * 2);
+        }
 
-    /* Resize the buffer to the current size */
-    if (s_dynamic_table_resize_buffer(context, context->dynamic_table.num_elements)) {
-        goto error;
+        if (entries_capacity < context->dynamic_table.entries_capacity ||
+            strings_capacity < context->dynamic_table.strings_capacity) {
+            if (s_dynamic_table_realloc(context, entries_capacity, strings_capacity, NULL)) {
+                goto error;
+            }
+        }
     }
 
     /* Update the max size */
@@ -4,6 +4,8 @@
  */
 #include <aws/http/private/hpack.h>
 
+#include <aws/common/thread.h>
+
 #define HPACK_LOGF(level, decoder, text, ...)                                                                          \
     AWS_LOGF_##level(AWS_LS_HTTP_DECODER, "id=%p [HPACK]: " text, (decoder)->log_id, __VA_ARGS__)
 #define HPACK_LOG(level, decoder, text) HPACK_LOGF(level, decoder, "%s", text)
@@ -13,12 +15,180 @@ struct aws_huffman_symbol_coder *hpack_get_coder(void);
 /* Used while decoding the header name & value, grows if necessary */
 const size_t s_hpack_decoder_scratch_initial_size = 512;
 
+/**
+ * -- Huffman Decoding Notes --
+ * Rather than walk the Huffman tree 1 bit at a time, we decode 4 bits at a time using a state machine
+ * (the same approach as nghttp2 and h2o). Each state is an internal node of the HPACK Huffman tree,
+ * and each transition consumes a nibble, emitting a symbol if it passed through a leaf.
+ * The shortest HPACK code is 5 bits, so a nibble never emits more than 1 symbol.
+ *
+ * The tree has 257 leaves (256 bytes + EOS), so it has exactly 256 internal nodes, and a state fits in a byte.
+ * The table is built from the static code points the first time a decoder is initialized.
+ */
+enum {
+    AWS_HPACK_HUFFMAN_STATE_COUNT = 256,
+    AWS_HPACK_HUFFMAN_EOS_SYMBOL = 256,
+};
+
+enum aws_hpack_huffman_transition_flags {
+    /* The input may legally end after this transition, with the bits since the last symbol being EOS padding */
+    AWS_HPACK_HUFFMAN_ACCEPT = 0x1,
+    /* This transition emits a symbol */
+    AWS_HPACK_HUFFMAN_SYMBOL = 0x2,
+    /* This transition decodes EOS, which HPACK says to treat as an error */
+    AWS_HPACK_HUFFMAN_FAIL = 0x4,
+};
+
+struct aws_hpack_huffman_transition {
+    uint8_t next_state;
+    uint8_t flags;
+    uint8_t symbol;
+};
+
+static struct aws_hpack_huffman_transition s_huffman_transitions[AWS_HPACK_HUFFMAN_STATE_COUNT][16];
+static aws_thread_once s_huffman_transitions_once = AWS_THREAD_ONCE_STATIC_INIT;
+
+/* Add one code to a tree where children > 0 are internal nodes, children < 0 are leaves storing -(symbol + 1),
+ * and 0 means no child yet (the root is never anyone's child) */
+static void s_huffman_tree_add(
+    int16_t (*children)[2],
+    size_t *node_count,
+    uint32_t pattern,
+    uint8_t num_bits,
+    uint16_t symbol) {
+
+    size_t node = 0;
+    for (uint8_t i = num_bits; i > 1; --i) {
+        const uint8_t bit = (pattern >> (i - 1)) & 1;
+        if (children[node][bit] == 0) {
+            AWS_FATAL_ASSERT(*node_count < AWS_HPACK_HUFFMAN_STATE_COUNT);
+            children[node][bit] = (int16_t)(*node_count)++;
+        }
+        AWS_FATAL_ASSERT(children[node][bit] > 0 && "Huffman codes must be prefix-free");
+        node = (size_t)children[node][bit];
+    }
+
+    const uint8_t bit = pattern & 1;
+    AWS_FATAL_ASSERT(children[node][bit] == 0 && "Huffman codes must be prefix-free");
+    children[node][bit] = (int16_t)(-(int)symbol - 1);
+}
+
+static void s_huffman_transitions_init(void *user_data) {
+    (void)user_data;
+    struct aws_huffman_symbol_coder *coder = hpack_get_coder();
+
+    int16_t children[AWS_HPACK_HUFFMAN_STATE_COUNT][2];
+    AWS_ZERO_ARRAY(children);
+    size_t node_count = 1; /* root */
+
+    for (size_t symbol = 0; symbol < 256; ++symbol) {
+        struct aws_huffman_code code = coder->encode((uint8_t)symbol, coder->userdata);
+        s_huffman_tree_add(children, &node_count, code.pattern, code.num_bits, (uint16_t)symbol);
+    }
+    /* The coder only deals in bytes, so add EOS by hand: RFC-7541 Appendix B */
+    s_huffman_tree_add(children, &node_count, 0x3fffffff, 30, AWS_HPACK_HUFFMAN_EOS_SYMBOL);
+
+    AWS_FATAL_ASSERT(node_count == AWS_HPACK_HUFFMAN_STATE_COUNT && "HPACK Huffman tree must be complete");
+
+    /* Input may end at the root, or partway down the all-1s path (EOS prefix) so long as it's under 8 bits.
+     * RFC-7541 5.2: padding strictly longer than 7 bits MUST be treated as a decoding error */
+    bool accepting[AWS_HPACK_HUFFMAN_STATE_COUNT];
+    AWS_ZERO_ARRAY(accepting);
+    size_t node = 0;
+    for (size_t depth = 0; depth < 8; ++depth) {
+        accepting[node] = true;
+        node = (size_t)children[node][1];
+    }
+
+    for (size_t state = 0; state < AWS_HPACK_HUFFMAN_STATE_COUNT; ++state) {
+        for (size_t nibble = 0; nibble < 16; ++nibble) {
+            struct aws_hpack_huffman_transition transition = {.next_state = 0};
+            node = state;
+            for (size_t i = 4; i > 0; --i) {
+                const int16_t child = children[node][(nibble >> (i - 1)) & 1];
+                if (child > 0) {
+                    node = (size_t)child;
+                    continue;
+                }
+
+                const int symbol = -(int)child - 1;
+                if (symbol == AWS_HPACK_HUFFMAN_EOS_SYMBOL) {
+                    transition.flags = AWS_HPACK_HUFFMAN_FAIL;
+                    break;
+                }
+                AWS_FATAL_ASSERT(!(transition.flags & AWS_HPACK_HUFFMAN_SYMBOL) && "Max 1 symbol per nibble");
+                transition.flags |= AWS_HPACK_HUFFMAN_SYMBOL;
+                transition.symbol = (uint8_t)symbol;
+                node = 0;
+            }
+
+            if (!(transition.flags & AWS_HPACK_HUFFMAN_FAIL)) {
+                transition.next_state = (uint8_t)node;
+                if (accepting[node]) {
+                    transition.flags |= AWS_HPACK_HUFFMAN_ACCEPT;
+                }
+            }
+            s_huffman_transitions[state][nibble] = transition;
+        }
+    }
+}
+
+/* Decode a chunk of a Huffman encoded string, appending to output. State is kept in progress_string between chunks */
+static int s_huffman_decode(
+    struct aws_hpack_decoder *decoder,
+    struct aws_byte_cursor chunk,
+    struct aws_byte_buf *output) {
+
+    /* The shortest code is 5 bits, so each byte decodes to at most 2 symbols.
+     * We always write a symbol and only advance if it was real, so make room for the worst case up front */
+    size_t required_capacity;
+    if (aws_mul_size_checked(chunk.len, 2, &required_capacity) ||
+        aws_add_size_checked(required_capacity, output->len, &required_capacity)) {
+        return AWS_OP_ERR;
+    }
+    if (required_capacity > output->capacity) {
+        if (aws_byte_buf_reserve(output, aws_max_size(required_capacity, output->capacity * 2))) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    struct hpack_progress_string *progress = &decoder->progress_string;
+    uint8_t state = progress->huffman_state;
+    uint8_t flags = progress->huffman_flags;
+    uint8_t *dst = output->buffer + output->len;
+
+    for (size_t i = 0; i < chunk.len; ++i) {
+        const uint8_t byte = chunk.ptr[i];
+
+        /* High nibble, then low nibble */
+        const struct aws_hpack_huffman_transition *high = &s_huffman_transitions[state][byte >> 4];
+        *dst = high->symbol;
+        dst += (high->flags & AWS_HPACK_HUFFMAN_SYMBOL) >> 1;
+
+        const struct aws_hpack_huffman_transition *low = &s_huffman_transitions[high->next_state][byte & 0xf];
+        *dst = low->symbol;
+        dst += (low->flags & AWS_HPACK_HUFFMAN_SYMBOL) >> 1;
+
+        if (AWS_UNLIKELY((high->flags | low->flags) & AWS_HPACK_HUFFMAN_FAIL)) {
+            HPACK_LOG(ERROR, decoder, "Huffman encoded end-of-string symbol is illegal");
+            return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        }
+
+        state = low->next_state;
+        flags = low->flags;
+    }
+
+    output->len = (size_t)(dst - output->buffer);
+    progress->huffman_state = state;
+    progress->huffman_flags = flags;
+    return AWS_OP_SUCCESS;
+}
+
 void aws_hpack_decoder_init(struct aws_hpack_decoder *decoder, struct aws_allocator *allocator, const void *log_id) {
     AWS_ZERO_STRUCT(*decoder);
     decoder->log_id = log_id;
 
-    aws_huffman_decoder_init(&decoder->huffman_decoder, hpack_get_coder());
-    aws_huffman_decoder_allow_growth(&decoder->huffman_decoder, true);
+    aws_thread_call_once(&s_huffman_transitions_once, s_huffman_transitions_init, NULL);
 
     aws_hpack_context_init(&decoder->context, allocator, AWS_LS_HTTP_DECODER, log_id);
 
@@ -47,6 +217,21 @@ void aws_hpack_decoder_update_max_table_size(struct aws_hpack_decoder *decoder,
     decoder->dynamic_table_protocol_max_size_setting = setting_max_size;
 }
 
+size_t aws_hpack_decoder_get_memory_usage(const struct aws_hpack_decoder *decoder) {
+    return aws_hpack_context_get_memory_usage(&decoder->context) + decoder->progress_entry.scratch.capacity;
+}
+
+int aws_hpack_decoder_trim(struct aws_hpack_decoder *decoder) {
+    AWS_PRECONDITION(decoder->progress_entry.state == HPACK_ENTRY_STATE_INIT);
+
+    /* Scratch grows back on demand */
+    struct aws_allocator *allocator = decoder->progress_entry.scratch.allocator;
+    aws_byte_buf_clean_up(&decoder->progress_entry.scratch);
+    aws_byte_buf_init(&decoder->progress_entry.scratch, allocator, 0);
+
+    return aws_hpack_context_compact(&decoder->context);
+}
+
 /* Return a byte with the N right-most bits masked.
  * Ex: 2 -> 00000011 */
 static uint8_t s_masked_right_bits_u8(uint8_t num_masked_bits) {
@@ -149,7 +334,8 @@ int aws_hpack_decode_string(
                 /* Do init stuff */
                 progress->state = HPACK_STRING_STATE_LENGTH;
                 progress->use_huffman = *to_decode->ptr >> 7;
-                aws_huffman_decoder_reset(&decoder->huffman_decoder);
+                progress->huffman_state = 0;
+                progress->huffman_flags = AWS_HPACK_HUFFMAN_ACCEPT;
                 /* fallthrough, since we didn't consume any data */
             }
             /* FALLTHRU */
@@ -182,17 +368,10 @@ int aws_hpack_decode_string(
                 struct aws_byte_cursor chunk = aws_byte_cursor_advance(to_decode, to_process);
 
                 if (progress->use_huffman) {
-                    if (aws_huffman_decode(&decoder->huffman_decoder, &chunk, output)) {
-                        HPACK_LOGF(ERROR, decoder, "Error from Huffman decoder: %s", aws_error_name(aws_last_error()));
+                    /* EOS (end-of-string) symbol is illegal within the string, HPACK says to treat EOS as error. */
+                    if (s_huffman_decode(decoder, chunk, output)) {
                         return AWS_OP_ERR;
                     }
-
-                    /* Decoder should consume all bytes we feed it.
-                     * EOS (end-of-string) symbol could stop it early, but HPACK says to treat EOS as error. */
-                    if (chunk.len != 0) {
-                        HPACK_LOG(ERROR, decoder, "Huffman encoded end-of-string symbol is illegal");
-                        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
-                    }
                 } else {
                     if (aws_byte_buf_append_dynamic(output, &chunk)) {
                         return AWS_OP_ERR;
@@ -201,9 +380,12 @@ int aws_hpack_decode_string(
 
                 /* If whole length consumed, we're done */
                 if (progress->length == 0) {
-                    /* #TODO Validate any padding bits left over in final byte of string.
-                     * "A padding not corresponding to the most significant bits of the
+                    /* "A padding not corresponding to the most significant bits of the
                      * code for the EOS symbol MUST be treated as a decoding error" */
+                    if (progress->use_huffman && !(progress->huffman_flags & AWS_HPACK_HUFFMAN_ACCEPT)) {
+                        HPACK_LOG(ERROR, decoder, "Huffman encoded string has invalid padding");
+                        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+                    }
 
                     /* #TODO impose limits on string length */
 
@@ -25,14 +25,61 @@ void aws_hpack_encoder_init(struct aws_hpack_encoder *encoder, struct aws_alloca
 }
 
 void aws_hpack_encoder_clean_up(struct aws_hpack_encoder *encoder) {
+    for (size_t i = 0; i < AWS_HPACK_ENCODER_STRING_CACHE_SIZE; ++i) {
+        aws_byte_buf_clean_up(&encoder->string_cache.entries[i].storage);
+    }
     aws_hpack_context_clean_up(&encoder->context);
     AWS_ZERO_STRUCT(*encoder);
 }
 
 void aws_hpack_encoder_set_huffman_mode(struct aws_hpack_encoder *encoder, enum aws_hpack_huffman_mode mode) {
+    if (mode != encoder->huffman_mode) {
+        /* Cached encodings were chosen under the old mode, forget them (but keep the memory) */
+        for (size_t i = 0; i < AWS_HPACK_ENCODER_STRING_CACHE_SIZE; ++i) {
+            encoder->string_cache.entries[i].last_used = 0;
+        }
+    }
     encoder->huffman_mode = mode;
 }
 
+size_t aws_hpack_encoder_get_memory_usage(const struct aws_hpack_encoder *encoder) {
+    size_t usage = aws_hpack_context_get_memory_usage(&encoder->context);
+    for (size_t i = 0; i < AWS_HPACK_ENCODER_STRING_CACHE_SIZE; ++i) {
+        usage += encoder->string_cache.entries[i].storage.capacity;
+    }
+    return usage;
+}
+
+int aws_hpack_encoder_trim(struct aws_hpack_encoder *encoder) {
+    /* The cache allocates an entry's storage again the next time it's used */
+    for (size_t i = 0; i < AWS_HPACK_ENCODER_STRING_CACHE_SIZE; ++i) {
+        aws_byte_buf_clean_up(&encoder->string_cache.entries[i].storage);
+        encoder->string_cache.entries[i].last_used = 0;
+    }
+
+    /* Restore whatever size the table would have had, once the peer has been told it was emptied */
+    size_t max_size = aws_hpack_get_dynamic_table_max_size(&encoder->context);
+    if (encoder->dynamic_table_size_update.pending) {
+        max_size = encoder->dynamic_table_size_update.latest_value;
+    }
+    if (max_size == 0 || aws_hpack_get_dynamic_table_num_elements(&encoder->context) == 0) {
+        return aws_hpack_context_compact(&encoder->context);
+    }
+
+    /* Resizing to 0 empties the table and frees its storage */
+    if (aws_hpack_resize_dynamic_table(&encoder->context, 0)) {
+        return AWS_OP_ERR;
+    }
+    encoder->dynamic_table_size_update.pending = true;
+    encoder->dynamic_table_size_update.smallest_value = 0;
+    encoder->dynamic_table_size_update.latest_value = max_size;
+    return AWS_OP_SUCCESS;
+}
+
+void aws_hpack_encoder_set_adaptive_indexing(struct aws_hpack_encoder *encoder, bool enabled) {
+    encoder->name_stats.disabled = !enabled;
+}
+
 void aws_hpack_encoder_update_max_table_size(struct aws_hpack_encoder *encoder, uint32_t new_max_size) {
 
     if (!encoder->dynamic_table_size_update.pending) {
@@ -130,6 +177,113 @@ error:
     return AWS_OP_ERR;
 }
 
+/* Returns the number of bytes aws_hpack_encode_integer() will write */
+static size_t s_encoded_integer_len(uint64_t integer, uint8_t prefix_size) {
+    const uint8_t prefix_mask = s_masked_right_bits_u8(prefix_size);
+    if (integer < prefix_mask) {
+        return 1;
+    }
+
+    integer -= prefix_mask;
+    size_t len = 1;
+    do {
+        ++len;
+        integer >>= 7;
+    } while (integer);
+    return len;
+}
+
+/*
+ * String literals are encoded like so (RFC-7541 5.2):
+ * H is whether or not data is huffman-encoded.
+ *
+ *   0   1   2   3   4   5   6   7
+ * +---+---+---+---+---+---+---+---+
+ * | H |    String Length (7+)     |
+ * +---+---------------------------+
+ * |  String Data (Length octets)  |
+ * +-------------------------------+
+ */
+static int s_encode_string_raw(struct aws_byte_cursor to_encode, struct aws_byte_buf *output) {
+    if (aws_hpack_encode_integer(to_encode.len, 0, 7, output)) {
+        return AWS_OP_ERR;
+    }
+    return aws_byte_buf_append_dynamic(output, &to_encode);
+}
+
+static int s_encode_string_huffman(
+    struct aws_hpack_encoder *encoder,
+    struct aws_byte_cursor to_encode,
+    struct aws_byte_buf *output) {
+
+    const size_t str_length = aws_huffman_get_encoded_length(&encoder->huffman_encoder, to_encode);
+    if (aws_hpack_encode_integer(str_length, 1 << 7, 7, output)) {
+        return AWS_OP_ERR;
+    }
+
+    /* Huffman encoder doesn't grow buffer, so we ensure it's big enough here */
+    if (s_ensure_space(output, str_length)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_huffman_encode(&encoder->huffman_encoder, &to_encode, output)) {
+        HPACK_LOGF(ERROR, encoder, "Error from Huffman encoder: %s", aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Use Huffman only if it's smaller, in a single pass:
+ * Huffman encode straight into the output, but stop if it's not smaller than the raw string.
+ * Only if that fails do we go back and write the raw string.
+ */
+static int s_encode_string_smallest(
+    struct aws_hpack_encoder *encoder,
+    struct aws_byte_cursor to_encode,
+    struct aws_byte_buf *output) {
+
+    if (to_encode.len == 0) {
+        return s_encode_string_raw(to_encode, output);
+    }
+
+    /* The Huffman length prefix is never longer than the raw length prefix, since its length is smaller.
+     * So reserve enough for the raw encoding, and the Huffman encoding fits too, without reallocating */
+    const size_t raw_prefix_len = s_encoded_integer_len(to_encode.len, 7);
+    size_t raw_encoded_len;
+    if (aws_add_size_checked(raw_prefix_len, to_encode.len, &raw_encoded_len)) {
+        return AWS_OP_ERR;
+    }
+    if (s_ensure_space(output, raw_encoded_len)) {
+        return AWS_OP_ERR;
+    }
+
+    /* Huffman data goes after the space for the longest possible prefix, and must be strictly smaller than
+     * the raw string. The Huffman encoder raises SHORT_BUFFER if it doesn't fit */
+    uint8_t *huffman_start = output->buffer + output->len + raw_prefix_len;
+    struct aws_byte_buf huffman_buf = aws_byte_buf_from_empty_array(huffman_start, to_encode.len - 1);
+    struct aws_byte_cursor huffman_input = to_encode;
+    if (aws_huffman_encode(&encoder->huffman_encoder, &huffman_input, &huffman_buf)) {
+        if (aws_last_error() != AWS_ERROR_SHORT_BUFFER) {
+            HPACK_LOGF(ERROR, encoder, "Error from Huffman encoder: %s", aws_error_name(aws_last_error()));
+            return AWS_OP_ERR;
+        }
+
+        /* Huffman isn't smaller, write raw string instead */
+        aws_huffman_encoder_reset(&encoder->huffman_encoder);
+        return s_encode_string_raw(to_encode, output);
+    }
+
+    /* Write the real prefix, then slide the Huffman data down to meet it (if the prefix turned out shorter) */
+    if (aws_hpack_encode_integer(huffman_buf.len, 1 << 7, 7, output)) {
+        return AWS_OP_ERR;
+    }
+    AWS_ASSERT(output->buffer + output->len <= huffman_start);
+    memmove(output->buffer + output->len, huffman_start, huffman_buf.len);
+    output->len += huffman_buf.len;
+    return AWS_OP_SUCCESS;
+}
+
 int aws_hpack_encode_string(
     struct aws_hpack_encoder *encoder,
     struct aws_byte_cursor to_encode,
@@ -141,80 +295,93 @@ int aws_hpack_encode_string(
 
     const size_t original_len = output->len;
 
-    /* Determine length of encoded string (and whether or not to use huffman) */
-    uint8_t use_huffman;
-    size_t str_length;
+    int result = AWS_OP_ERR;
     switch (encoder->huffman_mode) {
         case AWS_HPACK_HUFFMAN_NEVER:
-            use_huffman = 0;
-            str_length = to_encode.len;
+            result = s_encode_string_raw(to_encode, output);
             break;
 
         case AWS_HPACK_HUFFMAN_ALWAYS:
-            use_huffman = 1;
-            str_length = aws_huffman_get_encoded_length(&encoder->huffman_encoder, to_encode);
+            result = s_encode_string_huffman(encoder, to_encode, output);
             break;
 
         case AWS_HPACK_HUFFMAN_SMALLEST:
-            str_length = aws_huffman_get_encoded_length(&encoder->huffman_encoder, to_encode);
-            if (str_length < to_encode.len) {
-                use_huffman = 1;
-            } else {
-                str_length = to_encode.len;
-                use_huffman = 0;
-            }
+            result = s_encode_string_smallest(encoder, to_encode, output);
             break;
 
         default:
             aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
-            goto error;
+            break;
     }
 
-    /*
-     * String literals are encoded like so (RFC-7541 5.2):
-     * H is whether or not data is huffman-encoded.
-     *
-     *   0   1   2   3   4   5   6   7
-     * +---+---+---+---+---+---+---+---+
-     * | H |    String Length (7+)     |
-     * +---+---------------------------+
-     * |  String Data (Length octets)  |
-     * +-------------------------------+
-     */
-
-    /* Encode string length */
-    uint8_t starting_bits = use_huffman << 7;
-    if (aws_hpack_encode_integer(str_length, starting_bits, 7, output)) {
-        HPACK_LOGF(ERROR, encoder, "Error encoding HPACK integer: %s", aws_error_name(aws_last_error()));
-        goto error;
+    if (result) {
+        HPACK_LOGF(ERROR, encoder, "Error encoding HPACK string: %s", aws_error_name(aws_last_error()));
+        output->len = original_len;
+        aws_huffman_encoder_reset(&encoder->huffman_encoder);
+        return AWS_OP_ERR;
     }
 
-    /* Encode string data */
-    if (str_length > 0) {
-        if (use_huffman) {
-            /* Huffman encoder doesn't grow buffer, so we ensure it's big enough here */
-            if (s_ensure_space(output, str_length)) {
-                goto error;
-            }
+    return AWS_OP_SUCCESS;
+}
 
-            if (aws_huffman_encode(&encoder->huffman_encoder, &to_encode, output)) {
-                HPACK_LOGF(ERROR, encoder, "Error from Huffman encoder: %s", aws_error_name(aws_last_error()));
-                goto error;
-            }
+/* Encode a string literal, using the encoder's string cache if it's been encoded recently */
+static int s_encode_string_cached(
+    struct aws_hpack_encoder *encoder,
+    struct aws_byte_cursor to_encode,
+    struct aws_byte_buf *output) {
 
-        } else {
-            if (aws_byte_buf_append_dynamic(output, &to_encode)) {
-                goto error;
-            }
+    /* Raw strings are already just a memcpy */
+    if (encoder->huffman_mode == AWS_HPACK_HUFFMAN_NEVER || to_encode.len == 0 ||
+        to_encode.len > AWS_HPACK_ENCODER_STRING_CACHE_MAX_LITERAL_LEN) {
+        return aws_hpack_encode_string(encoder, to_encode, output);
+    }
+
+    const uint64_t hash = aws_hash_byte_cursor_ptr(&to_encode);
+
+    /* Look for a hit, while keeping track of the least recently used entry in case of a miss */
+    struct aws_hpack_encoder_string_cache_entry *lru_entry = &encoder->string_cache.entries[0];
+    for (size_t i = 0; i < AWS_HPACK_ENCODER_STRING_CACHE_SIZE; ++i) {
+        struct aws_hpack_encoder_string_cache_entry *entry = &encoder->string_cache.entries[i];
+        if (entry->last_used != 0 && entry->hash == hash && entry->literal_len == to_encode.len &&
+            memcmp(entry->storage.buffer, to_encode.ptr, to_encode.len) == 0) {
+
+            entry->last_used = ++encoder->string_cache.clock;
+            struct aws_byte_cursor encoded = aws_byte_cursor_from_buf(&entry->storage);
+            aws_byte_cursor_advance(&encoded, entry->literal_len);
+            return aws_byte_buf_append_dynamic(output, &encoded);
+        }
+
+        if (entry->last_used < lru_entry->last_used) {
+            lru_entry = entry;
         }
     }
 
-    return AWS_OP_SUCCESS;
+    /* Miss. Encode it, then replace the least recently used entry */
+    const size_t original_len = output->len;
+    if (aws_hpack_encode_string(encoder, to_encode, output)) {
+        return AWS_OP_ERR;
+    }
 
-error:
-    output->len = original_len;
-    aws_huffman_encoder_reset(&encoder->huffman_encoder);
-    return AWS_OP_ERR;
+    struct aws_byte_cursor encoded = {
+        .ptr = output->buffer + original_len,
+        .len = output->len - original_len,
+    };
+
+    lru_entry->last_used = 0;
+    lru_entry->storage.len = 0;
+    if (lru_entry->storage.buffer == NULL) {
+        if (aws_byte_buf_init(&lru_entry->storage, encoder->context.allocator, to_encode.len + encoded.len)) {
+            return AWS_OP_ERR;
+        }
+    }
+    if (aws_byte_buf_append_dynamic(&lru_entry->storage, &to_encode) ||
+        aws_byte_buf_append_dynamic(&lru_entry->storage, &encoded)) {
+        return AWS_OP_ERR;
+    }
+    lru_entry->hash = hash;
+    lru_entry->literal_len = to_encode.len;
+    lru_entry->last_used = ++encoder->string_cache.clock;
+    return AWS_OP_SUCCESS;
 }
 
 /* All types that HPACK might encode/decode (RFC-7541 6 - Binary Format) */
@@ -274,6 +441,74 @@ static int s_convert_http_compression_to_literal_entry_type(
     return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
 }
 
+/* Record this header's value in its name's statistics.
+ * Return true if the name's values rarely repeat, so the header isn't worth inserting into the dynamic table */
+static bool s_update_name_stats(struct aws_hpack_encoder *encoder, const struct aws_http_header *header) {
+    const uint64_t name_hash = aws_hash_byte_cursor_ptr(&header->name);
+    const uint64_t value_hash = aws_hash_byte_cursor_ptr(&header->value);
+
+    /* Look for the name, while keeping track of the least recently used entry in case it's new */
+    struct aws_hpack_encoder_name_stats *stats = NULL;
+    struct aws_hpack_encoder_name_stats *lru_entry = &encoder->name_stats.entries[0];
+    for (size_t i = 0; i < AWS_HPACK_ENCODER_NAME_STATS_SIZE; ++i) {
+        struct aws_hpack_encoder_name_stats *entry = &encoder->name_stats.entries[i];
+        if (entry->last_used != 0 && entry->name_hash == name_hash && entry->name_len == header->name.len) {
+            stats = entry;
+            break;
+        }
+
+        if (entry->last_used < lru_entry->last_used) {
+            lru_entry = entry;
+        }
+    }
+
+    if (stats == NULL) {
+        stats = lru_entry;
+        AWS_ZERO_STRUCT(*stats);
+        stats->name_hash = name_hash;
+        stats->name_len = header->name.len;
+    }
+    stats->last_used = ++encoder->name_stats.clock;
+
+    bool is_repeat = false;
+    const size_t num_recent = aws_min_size(stats->num_recent_values, AWS_HPACK_ENCODER_NAME_STATS_RECENT_VALUES);
+    for (size_t i = 0; i < num_recent; ++i) {
+        if (stats->recent_value_hashes[i] == value_hash) {
+            is_repeat = true;
+            break;
+        }
+    }
+    if (!is_repeat) {
+        stats->recent_value_hashes[stats->num_recent_values % AWS_HPACK_ENCODER_NAME_STATS_RECENT_VALUES] = value_hash;
+        ++stats->num_recent_values;
+    }
+
+    if (stats->samples == AWS_HPACK_ENCODER_NAME_STATS_MAX_SAMPLES) {
+        stats->samples /= 2;
+        stats->repeats /= 2;
+    }
+    ++stats->samples;
+    if (is_repeat) {
+        ++stats->repeats;
+    }
+
+    /* Volatile if fewer than 1 in 4 values were seen recently */
+    return stats->samples >= AWS_HPACK_ENCODER_NAME_STATS_MIN_SAMPLES && stats->repeats * 4 < stats->samples;
+}
+
+/* Encode a header's name or value. Headers that must never be indexed are sensitive, so don't cache them */
+static int s_encode_string_literal(
+    struct aws_hpack_encoder *encoder,
+    const struct aws_http_header *header,
+    struct aws_byte_cursor to_encode,
+    struct aws_byte_buf *output) {
+
+    if (header->compression == AWS_HTTP_HEADER_COMPRESSION_NO_FORWARD_CACHE) {
+        return aws_hpack_encode_string(encoder, to_encode, output);
+    }
+    return s_encode_string_cached(encoder, to_encode, output);
+}
+
 static int s_encode_header_field(
     struct aws_hpack_encoder *encoder,
     const struct aws_http_header *header,
@@ -294,6 +529,11 @@ static int s_encode_header_field(
         found_indexed_value = false;
     }
 
+    bool is_volatile = false;
+    if (header->compression == AWS_HTTP_HEADER_COMPRESSION_USE_CACHE && !encoder->name_stats.disabled) {
+        is_volatile = s_update_name_stats(encoder, header);
+    }
+
     if (header_index && found_indexed_value) {
         /* Indexed header field */
         const enum aws_hpack_entry_type entry_type = AWS_HPACK_ENTRY_INDEXED_HEADER_FIELD;
@@ -316,6 +556,11 @@ static int s_encode_header_field(
         goto error;
     }
 
+    /* Don't let volatile values churn the dynamic table, evicting entries that would be reused */
+    if (literal_entry_type == AWS_HPACK_ENTRY_LITERAL_HEADER_FIELD_WITH_INCREMENTAL_INDEXING && is_volatile) {
+        literal_entry_type = AWS_HPACK_ENTRY_LITERAL_HEADER_FIELD_WITHOUT_INDEXING;
+    }
+
     /* the entry type makes up the first few bits of the next integer we encode */
     uint8_t starting_bit_pattern = s_hpack_entry_starting_bit_pattern[literal_entry_type];
     uint8_t num_prefix_bits = s_hpack_entry_num_prefix_bits[literal_entry_type];
@@ -336,13 +581,13 @@ static int s_encode_header_field(
         }
 
         /* next encode header-name string */
-        if (aws_hpack_encode_string(encoder, header->name, output)) {
+        if (s_encode_string_literal(encoder, header, header->name, output)) {
             goto error;
         }
     }
 
     /* then encode header-value string, and we're done encoding! */
-    if (aws_hpack_encode_string(encoder, header->value, output)) {
+    if (s_encode_string_literal(encoder, header, header->value, output)) {
         goto error;
     }
 
@@ -359,11 +604,24 @@ error:
     return AWS_OP_ERR;
 }
 
-int aws_hpack_encode_header_block(
+size_t aws_hpack_get_encoded_header_length_upper_bound(const struct aws_http_header *header) {
+    /* Worst case is a literal with a new name, and both strings Huffman encoded.
+     * The longest Huffman code is 30 bits, so no string grows more than 4x.
+     * Each integer (the name index, and the two string lengths) takes at most 11 bytes */
+    size_t string_bytes = aws_add_size_saturating(header->name.len, header->value.len);
+    return aws_add_size_saturating(aws_mul_size_saturating(string_bytes, 4), 3 * 11);
+}
+
+int aws_hpack_encode_header(
     struct aws_hpack_encoder *encoder,
-    const struct aws_http_headers *headers,
+    const struct aws_http_header *header,
     struct aws_byte_buf *output) {
 
+    return s_encode_header_field(encoder, header, output);
+}
+
+int aws_hpack_encode_header_block_start(struct aws_hpack_encoder *encoder, struct aws_byte_buf *output) {
+
     /* Encode a dynamic table size update at the beginning of the first header-block
      * following the change to the dynamic table size RFC-7541 4.2 */
     if (encoder->dynamic_table_size_update.pending) {
@@ -405,6 +663,18 @@ int aws_hpack_encode_header_block(
         encoder->dynamic_table_size_update.smallest_value = SIZE_MAX;
     }
 
+    return AWS_OP_SUCCESS;
+}
+
+int aws_hpack_encode_header_block(
+    struct aws_hpack_encoder *encoder,
+    const struct aws_http_headers *headers,
+    struct aws_byte_buf *output) {
+
+    if (aws_hpack_encode_header_block_start(encoder, output)) {
+        return AWS_OP_ERR;
+    }
+
     const size_t num_headers = aws_http_headers_count(headers);
     for (size_t i = 0; i < num_headers; ++i) {
         struct aws_http_header header;
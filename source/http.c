@@ -151,6 +151,31 @@ static struct aws_error_info s_errors[] = {
     AWS_DEFINE_ERROR_INFO_HTTP(
         AWS_ERROR_HTTP_RESPONSE_FIRST_BYTE_TIMEOUT,
         "The server does not begin responding within the configuration after a request is fully sent."),
+    AWS_DEFINE_ERROR_INFO_HTTP(
+        AWS_ERROR_HTTP_CONNECTION_MANAGER_ACQUISITION_TIMEOUT,
+        "Connection acquisition was still pending when its timeout ran out."),
+    AWS_DEFINE_ERROR_INFO_HTTP(
+        AWS_ERROR_HTTP_PIPELINED_REQUEST_UNANSWERED,
+        "The connection broke while the request was pipelined behind another, without any response to it. "
+        "It is safe to retry an idempotent request."),
+    AWS_DEFINE_ERROR_INFO_HTTP(
+        AWS_ERROR_HTTP_REQUEST_TIMEOUT,
+        "The request and its response did not complete within the request's timeout."),
+    AWS_DEFINE_ERROR_INFO_HTTP(
+        AWS_ERROR_HTTP_CONTENT_DECODING_FAILED,
+        "The response body's Content-Encoding could not be decoded."),
+    AWS_DEFINE_ERROR_INFO_HTTP(
+        AWS_ERROR_HTTP_CONTENT_ENCODING_FAILED,
+        "The request body could not be encoded for its Content-Encoding."),
+    AWS_DEFINE_ERROR_INFO_HTTP(
+        AWS_ERROR_HTTP_WEBSOCKET_MESSAGE_TOO_BIG,
+        "Incoming websocket message is larger than the max incoming message size."),
+    AWS_DEFINE_ERROR_INFO_HTTP(
+        AWS_ERROR_HTTP_EXTENDED_CONNECT_NOT_SUPPORTED,
+        "The HTTP/2 server has not enabled extended CONNECT (RFC-8441), so websockets cannot use the connection."),
+    AWS_DEFINE_ERROR_INFO_HTTP(
+        AWS_ERROR_HTTP_SERVER_OVERLOADED,
+        "The server is overloaded, and turned away the connection or request."),
 };
 /* clang-format on */
 
@@ -293,55 +318,49 @@ struct aws_byte_cursor aws_http_version_to_str(enum aws_http_version version) {
 }
 
 /* HEADERS */
-static struct aws_hash_table s_header_str_to_enum;           /* for case-insensitive string -> enum lookup */
 static struct aws_hash_table s_lowercase_header_str_to_enum; /* for case-sensitive string -> enum lookup */
-static struct aws_byte_cursor s_header_enum_to_str[AWS_HTTP_HEADER_COUNT]; /* for enum -> string lookup */
-
-static void s_headers_init(struct aws_allocator *alloc) {
-    s_header_enum_to_str[AWS_HTTP_HEADER_METHOD] = aws_byte_cursor_from_c_str(":method");
-    s_header_enum_to_str[AWS_HTTP_HEADER_SCHEME] = aws_byte_cursor_from_c_str(":scheme");
-    s_header_enum_to_str[AWS_HTTP_HEADER_AUTHORITY] = aws_byte_cursor_from_c_str(":authority");
-    s_header_enum_to_str[AWS_HTTP_HEADER_PATH] = aws_byte_cursor_from_c_str(":path");
-    s_header_enum_to_str[AWS_HTTP_HEADER_STATUS] = aws_byte_cursor_from_c_str(":status");
-    s_header_enum_to_str[AWS_HTTP_HEADER_COOKIE] = aws_byte_cursor_from_c_str("cookie");
-    s_header_enum_to_str[AWS_HTTP_HEADER_SET_COOKIE] = aws_byte_cursor_from_c_str("set-cookie");
-    s_header_enum_to_str[AWS_HTTP_HEADER_HOST] = aws_byte_cursor_from_c_str("host");
-    s_header_enum_to_str[AWS_HTTP_HEADER_CONNECTION] = aws_byte_cursor_from_c_str("connection");
-    s_header_enum_to_str[AWS_HTTP_HEADER_CONTENT_LENGTH] = aws_byte_cursor_from_c_str("content-length");
-    s_header_enum_to_str[AWS_HTTP_HEADER_EXPECT] = aws_byte_cursor_from_c_str("expect");
-    s_header_enum_to_str[AWS_HTTP_HEADER_TRANSFER_ENCODING] = aws_byte_cursor_from_c_str("transfer-encoding");
-    s_header_enum_to_str[AWS_HTTP_HEADER_CACHE_CONTROL] = aws_byte_cursor_from_c_str("cache-control");
-    s_header_enum_to_str[AWS_HTTP_HEADER_MAX_FORWARDS] = aws_byte_cursor_from_c_str("max-forwards");
-    s_header_enum_to_str[AWS_HTTP_HEADER_PRAGMA] = aws_byte_cursor_from_c_str("pragma");
-    s_header_enum_to_str[AWS_HTTP_HEADER_RANGE] = aws_byte_cursor_from_c_str("range");
-    s_header_enum_to_str[AWS_HTTP_HEADER_TE] = aws_byte_cursor_from_c_str("te");
-    s_header_enum_to_str[AWS_HTTP_HEADER_CONTENT_ENCODING] = aws_byte_cursor_from_c_str("content-encoding");
-    s_header_enum_to_str[AWS_HTTP_HEADER_CONTENT_TYPE] = aws_byte_cursor_from_c_str("content-type");
-    s_header_enum_to_str[AWS_HTTP_HEADER_CONTENT_RANGE] = aws_byte_cursor_from_c_str("content-range");
-    s_header_enum_to_str[AWS_HTTP_HEADER_TRAILER] = aws_byte_cursor_from_c_str("trailer");
-    s_header_enum_to_str[AWS_HTTP_HEADER_WWW_AUTHENTICATE] = aws_byte_cursor_from_c_str("www-authenticate");
-    s_header_enum_to_str[AWS_HTTP_HEADER_AUTHORIZATION] = aws_byte_cursor_from_c_str("authorization");
-    s_header_enum_to_str[AWS_HTTP_HEADER_PROXY_AUTHENTICATE] = aws_byte_cursor_from_c_str("proxy-authenticate");
-    s_header_enum_to_str[AWS_HTTP_HEADER_PROXY_AUTHORIZATION] = aws_byte_cursor_from_c_str("proxy-authorization");
-    s_header_enum_to_str[AWS_HTTP_HEADER_AGE] = aws_byte_cursor_from_c_str("age");
-    s_header_enum_to_str[AWS_HTTP_HEADER_EXPIRES] = aws_byte_cursor_from_c_str("expires");
-    s_header_enum_to_str[AWS_HTTP_HEADER_DATE] = aws_byte_cursor_from_c_str("date");
-    s_header_enum_to_str[AWS_HTTP_HEADER_LOCATION] = aws_byte_cursor_from_c_str("location");
-    s_header_enum_to_str[AWS_HTTP_HEADER_RETRY_AFTER] = aws_byte_cursor_from_c_str("retry-after");
-    s_header_enum_to_str[AWS_HTTP_HEADER_VARY] = aws_byte_cursor_from_c_str("vary");
-    s_header_enum_to_str[AWS_HTTP_HEADER_WARNING] = aws_byte_cursor_from_c_str("warning");
-    s_header_enum_to_str[AWS_HTTP_HEADER_UPGRADE] = aws_byte_cursor_from_c_str("upgrade");
-    s_header_enum_to_str[AWS_HTTP_HEADER_KEEP_ALIVE] = aws_byte_cursor_from_c_str("keep-alive");
-    s_header_enum_to_str[AWS_HTTP_HEADER_PROXY_CONNECTION] = aws_byte_cursor_from_c_str("proxy-connection");
 
-    s_init_str_to_enum_hash_table(
-        &s_header_str_to_enum,
-        alloc,
-        s_header_enum_to_str,
-        AWS_HTTP_HEADER_UNKNOWN + 1,
-        AWS_HTTP_HEADER_COUNT,
-        true /* ignore case */);
+/* for enum -> string lookup, and for case-insensitive string -> enum lookup.
+ * Filled in at compile time, since aws_http_headers use it whether or not the library is initialized */
+static struct aws_byte_cursor s_header_enum_to_str[AWS_HTTP_HEADER_COUNT] = {
+    [AWS_HTTP_HEADER_METHOD] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":method"),
+    [AWS_HTTP_HEADER_SCHEME] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":scheme"),
+    [AWS_HTTP_HEADER_AUTHORITY] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":authority"),
+    [AWS_HTTP_HEADER_PATH] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":path"),
+    [AWS_HTTP_HEADER_STATUS] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":status"),
+    [AWS_HTTP_HEADER_COOKIE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("cookie"),
+    [AWS_HTTP_HEADER_SET_COOKIE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("set-cookie"),
+    [AWS_HTTP_HEADER_HOST] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("host"),
+    [AWS_HTTP_HEADER_CONNECTION] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("connection"),
+    [AWS_HTTP_HEADER_CONTENT_LENGTH] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("content-length"),
+    [AWS_HTTP_HEADER_EXPECT] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("expect"),
+    [AWS_HTTP_HEADER_TRANSFER_ENCODING] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("transfer-encoding"),
+    [AWS_HTTP_HEADER_CACHE_CONTROL] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("cache-control"),
+    [AWS_HTTP_HEADER_MAX_FORWARDS] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("max-forwards"),
+    [AWS_HTTP_HEADER_PRAGMA] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("pragma"),
+    [AWS_HTTP_HEADER_RANGE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("range"),
+    [AWS_HTTP_HEADER_TE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("te"),
+    [AWS_HTTP_HEADER_CONTENT_ENCODING] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("content-encoding"),
+    [AWS_HTTP_HEADER_CONTENT_TYPE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("content-type"),
+    [AWS_HTTP_HEADER_CONTENT_RANGE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("content-range"),
+    [AWS_HTTP_HEADER_TRAILER] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("trailer"),
+    [AWS_HTTP_HEADER_WWW_AUTHENTICATE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("www-authenticate"),
+    [AWS_HTTP_HEADER_AUTHORIZATION] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("authorization"),
+    [AWS_HTTP_HEADER_PROXY_AUTHENTICATE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("proxy-authenticate"),
+    [AWS_HTTP_HEADER_PROXY_AUTHORIZATION] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("proxy-authorization"),
+    [AWS_HTTP_HEADER_AGE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("age"),
+    [AWS_HTTP_HEADER_EXPIRES] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("expires"),
+    [AWS_HTTP_HEADER_DATE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("date"),
+    [AWS_HTTP_HEADER_LOCATION] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("location"),
+    [AWS_HTTP_HEADER_RETRY_AFTER] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("retry-after"),
+    [AWS_HTTP_HEADER_VARY] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("vary"),
+    [AWS_HTTP_HEADER_WARNING] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("warning"),
+    [AWS_HTTP_HEADER_UPGRADE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("upgrade"),
+    [AWS_HTTP_HEADER_KEEP_ALIVE] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("keep-alive"),
+    [AWS_HTTP_HEADER_PROXY_CONNECTION] = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("proxy-connection"),
+};
 
+static void s_headers_init(struct aws_allocator *alloc) {
     s_init_str_to_enum_hash_table(
         &s_lowercase_header_str_to_enum,
         alloc,
@@ -352,14 +371,16 @@ static void s_headers_init(struct aws_allocator *alloc) {
 }
 
 static void s_headers_clean_up(void) {
-    aws_hash_table_clean_up(&s_header_str_to_enum);
     aws_hash_table_clean_up(&s_lowercase_header_str_to_enum);
 }
 
 enum aws_http_header_name aws_http_str_to_header_name(struct aws_byte_cursor cursor) {
-    int header = s_find_in_str_to_enum_hash_table(&s_header_str_to_enum, &cursor);
-    if (header >= 0) {
-        return (enum aws_http_header_name)header;
+    /* Needs no aws_http_library_init(). Checking the length first rules out most names without reading them */
+    for (int header = AWS_HTTP_HEADER_UNKNOWN + 1; header < AWS_HTTP_HEADER_COUNT; ++header) {
+        if (s_header_enum_to_str[header].len == cursor.len &&
+            aws_byte_cursor_eq_ignore_case(&s_header_enum_to_str[header], &cursor)) {
+            return (enum aws_http_header_name)header;
+        }
     }
     return AWS_HTTP_HEADER_UNKNOWN;
 }
@@ -563,6 +584,7 @@ const struct aws_byte_cursor aws_http_header_scheme = AWS_BYTE_CUR_INIT_FROM_STR
 const struct aws_byte_cursor aws_http_header_authority = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":authority");
 const struct aws_byte_cursor aws_http_header_path = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":path");
 const struct aws_byte_cursor aws_http_header_status = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":status");
+const struct aws_byte_cursor aws_http_header_protocol = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(":protocol");
 
 const struct aws_byte_cursor aws_http_scheme_http = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("http");
 const struct aws_byte_cursor aws_http_scheme_https = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("https");
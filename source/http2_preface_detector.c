@@ -0,0 +1,203 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/http2_preface_detector.h>
+
+#include <aws/http/private/h2_frames.h>
+
+#include <aws/common/linked_list.h>
+#include <aws/io/channel.h>
+#include <aws/io/logging.h>
+
+#include <string.h>
+
+struct aws_http2_preface_detector {
+    struct aws_channel_handler handler;
+    struct aws_channel_slot *slot;
+    size_t initial_window_size;
+
+    aws_http2_preface_detector_on_detected_fn *on_detected;
+    void *user_data;
+
+    /* Bytes received so far that matched the HTTP/2 connection preface */
+    size_t matched_len;
+    bool is_detected;
+
+    /* aws_io_messages held until the protocol is known, linked by their queueing_handle */
+    struct aws_linked_list pending_messages;
+};
+
+static void s_release_pending_messages(struct aws_http2_preface_detector *detector) {
+    while (!aws_linked_list_empty(&detector->pending_messages)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&detector->pending_messages);
+        struct aws_io_message *msg = AWS_CONTAINER_OF(node, struct aws_io_message, queueing_handle);
+        aws_mem_release(msg->allocator, msg);
+    }
+}
+
+static void s_pass_read_message(struct aws_http2_preface_detector *detector, struct aws_io_message *message) {
+    /* If no connection was installed to the right, the channel is already shutting down */
+    if (!detector->slot->adj_right) {
+        aws_mem_release(message->allocator, message);
+        return;
+    }
+
+    if (aws_channel_slot_send_message(detector->slot, message, AWS_CHANNEL_DIR_READ)) {
+        int error_code = aws_last_error();
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_SERVER,
+            "id=%p: Failed to send message in read direction, error %d (%s).",
+            (void *)detector,
+            error_code,
+            aws_error_name(error_code));
+
+        aws_mem_release(message->allocator, message);
+        aws_channel_shutdown(detector->slot->channel, error_code);
+    }
+}
+
+static void s_on_detected(struct aws_http2_preface_detector *detector, enum aws_http_version version) {
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_SERVER,
+        "id=%p: Client is speaking " PRInSTR ".",
+        (void *)detector,
+        AWS_BYTE_CURSOR_PRI(aws_http_version_to_str(version)));
+
+    detector->is_detected = true;
+    detector->on_detected(detector->slot->channel, version, detector->user_data);
+
+    while (!aws_linked_list_empty(&detector->pending_messages)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&detector->pending_messages);
+        s_pass_read_message(detector, AWS_CONTAINER_OF(node, struct aws_io_message, queueing_handle));
+    }
+}
+
+static int s_handler_process_read_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+
+    (void)slot;
+    struct aws_http2_preface_detector *detector = handler->impl;
+
+    if (detector->is_detected) {
+        s_pass_read_message(detector, message);
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Compare the new bytes against the rest of the preface */
+    struct aws_byte_cursor preface_remaining = aws_h2_connection_preface_client_string;
+    aws_byte_cursor_advance(&preface_remaining, detector->matched_len);
+    size_t compare_len = aws_min_size(preface_remaining.len, message->message_data.len);
+    bool is_match = memcmp(preface_remaining.ptr, message->message_data.buffer, compare_len) == 0;
+    detector->matched_len += compare_len;
+
+    aws_linked_list_push_back(&detector->pending_messages, &message->queueing_handle);
+
+    if (!is_match) {
+        s_on_detected(detector, AWS_HTTP_VERSION_1_1);
+    } else if (detector->matched_len == aws_h2_connection_preface_client_string.len) {
+        s_on_detected(detector, AWS_HTTP_VERSION_2);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_handler_process_write_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+
+    (void)handler;
+    return aws_channel_slot_send_message(slot, message, AWS_CHANNEL_DIR_WRITE);
+}
+
+static int s_handler_increment_read_window(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    size_t size) {
+
+    (void)handler;
+    return aws_channel_slot_increment_read_window(slot, size);
+}
+
+static int s_handler_shutdown(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    enum aws_channel_direction dir,
+    int error_code,
+    bool free_scarce_resources_immediately) {
+
+    struct aws_http2_preface_detector *detector = handler->impl;
+    if (dir == AWS_CHANNEL_DIR_READ) {
+        s_release_pending_messages(detector);
+    }
+
+    return aws_channel_slot_on_handler_shutdown_complete(slot, dir, error_code, free_scarce_resources_immediately);
+}
+
+static size_t s_handler_initial_window_size(struct aws_channel_handler *handler) {
+    struct aws_http2_preface_detector *detector = handler->impl;
+    return detector->initial_window_size;
+}
+
+static size_t s_handler_message_overhead(struct aws_channel_handler *handler) {
+    (void)handler;
+    return 0;
+}
+
+static void s_handler_destroy(struct aws_channel_handler *handler) {
+    struct aws_http2_preface_detector *detector = handler->impl;
+    s_release_pending_messages(detector);
+    aws_mem_release(handler->alloc, detector);
+}
+
+static struct aws_channel_handler_vtable s_preface_detector_vtable = {
+    .process_read_message = s_handler_process_read_message,
+    .process_write_message = s_handler_process_write_message,
+    .increment_read_window = s_handler_increment_read_window,
+    .shutdown = s_handler_shutdown,
+    .initial_window_size = s_handler_initial_window_size,
+    .message_overhead = s_handler_message_overhead,
+    .destroy = s_handler_destroy,
+};
+
+int aws_http2_preface_detector_install(const struct aws_http2_preface_detector_options *options) {
+    AWS_PRECONDITION(options->on_detected);
+    AWS_PRECONDITION(aws_channel_thread_is_callers_thread(options->channel));
+
+    struct aws_channel_slot *slot = aws_channel_slot_new(options->channel);
+    if (!slot) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_channel_slot_insert_end(options->channel, slot)) {
+        goto error;
+    }
+
+    struct aws_http2_preface_detector *detector =
+        aws_mem_calloc(options->allocator, 1, sizeof(struct aws_http2_preface_detector));
+    detector->handler.vtable = &s_preface_detector_vtable;
+    detector->handler.alloc = options->allocator;
+    detector->handler.impl = detector;
+    detector->slot = slot;
+    /* The window must at least let the whole preface through */
+    detector->initial_window_size =
+        aws_max_size(options->initial_window_size, aws_h2_connection_preface_client_string.len);
+    detector->on_detected = options->on_detected;
+    detector->user_data = options->user_data;
+    aws_linked_list_init(&detector->pending_messages);
+
+    if (aws_channel_slot_set_handler(slot, &detector->handler)) {
+        aws_mem_release(options->allocator, detector);
+        goto error;
+    }
+
+    return AWS_OP_SUCCESS;
+
+error:
+    aws_channel_slot_remove(slot);
+    return AWS_OP_ERR;
+}
@@ -13,13 +13,16 @@
 #include <aws/io/channel.h>
 #include <aws/io/channel_bootstrap.h>
 #include <aws/io/event_loop.h>
+#include <aws/io/stream.h>
 
 #include <aws/http/http2_stream_manager.h>
 #include <aws/http/private/http2_stream_manager_impl.h>
 #include <aws/http/private/request_response_impl.h>
+#include <aws/http/private/tracing.h>
 #include <aws/http/status_code.h>
 
 #include <inttypes.h>
+#include <stdlib.h>
 
 #ifdef _MSC_VER
 #    pragma warning(disable : 4204) /* non-constant aggregate initializer */
@@ -32,12 +35,21 @@
     AWS_LOGF_##level(AWS_LS_HTTP_STREAM_MANAGER, "id=%p: " text, (void *)(stream_manager), __VA_ARGS__)
 #define STREAM_MANAGER_LOG(level, stream_manager, text) STREAM_MANAGER_LOGF(level, stream_manager, "%s", text)
 
+/* Completed streams needed before hedging after the p95 latency */
+static const size_t s_hedge_p95_min_samples = 20;
+
 /* 3 seconds */
 static const size_t s_default_ping_timeout_ms = 3000;
 
+/* Where enable_adaptive_concurrency starts if ideal_concurrent_streams_per_connection is unset */
+static const uint32_t s_adaptive_default_ideal_streams = 8;
+/* A stream taking longer than this many times the connection's lowest latency means it's congested */
+static const uint64_t s_adaptive_latency_tolerance = 2;
+
 static void s_stream_manager_start_destroy(struct aws_http2_stream_manager *stream_manager);
 static void s_aws_http2_stream_manager_build_transaction_synced(struct aws_http2_stream_management_transaction *work);
 static void s_aws_http2_stream_manager_execute_transaction(struct aws_http2_stream_management_transaction *work);
+static void s_sm_connection_finish_streams_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
 
 static struct aws_h2_sm_pending_stream_acquisition *s_new_pending_stream_acquisition(
     struct aws_allocator *allocator,
@@ -54,9 +66,43 @@ static struct aws_h2_sm_pending_stream_acquisition *s_new_pending_stream_acquisi
     pending_stream_acquisition->callback = callback;
     pending_stream_acquisition->user_data = user_data;
     pending_stream_acquisition->allocator = allocator;
+    aws_high_res_clock_get_ticks(&pending_stream_acquisition->acquire_timestamp);
     return pending_stream_acquisition;
 }
 
+static void s_hedge_destroy(void *user_data) {
+    struct aws_h2_sm_hedge *hedge = user_data;
+    if (hedge->stream_made && hedge->options.on_destroy) {
+        hedge->options.on_destroy(hedge->options.user_data);
+    }
+    aws_http_message_release(hedge->request);
+    aws_mutex_clean_up(&hedge->lock);
+    aws_mem_release(hedge->allocator, hedge);
+}
+
+static struct aws_h2_sm_hedge *s_hedge_new(
+    struct aws_http2_stream_manager *stream_manager,
+    const struct aws_http2_stream_manager_acquire_stream_options *acquire_stream_option) {
+    const struct aws_http_make_request_options *options = acquire_stream_option->options;
+    if ((!acquire_stream_option->hedge_delay_ms && !acquire_stream_option->hedge_after_p95_latency) ||
+        options->http2_use_manual_data_writes || aws_http_message_get_body_stream(options->request) ||
+        aws_http_message_get_body_async_stream(options->request)) {
+        /* A body can only be read once, so there's nothing to duplicate */
+        return NULL;
+    }
+    struct aws_h2_sm_hedge *hedge = aws_mem_calloc(stream_manager->allocator, 1, sizeof(struct aws_h2_sm_hedge));
+    hedge->allocator = stream_manager->allocator;
+    hedge->stream_manager = stream_manager;
+    aws_ref_count_init(&hedge->ref_count, hedge, s_hedge_destroy);
+    hedge->options = *options;
+    hedge->request = aws_http_message_acquire(options->request);
+    hedge->delay_ns = aws_timestamp_convert(
+        acquire_stream_option->hedge_delay_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    hedge->after_p95_latency = acquire_stream_option->hedge_after_p95_latency;
+    aws_mutex_init(&hedge->lock);
+    return hedge;
+}
+
 static void s_pending_stream_acquisition_destroy(
     struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition) {
     if (pending_stream_acquisition == NULL) {
@@ -65,9 +111,77 @@ static void s_pending_stream_acquisition_destroy(
     if (pending_stream_acquisition->request) {
         aws_http_message_release(pending_stream_acquisition->request);
     }
+    struct aws_h2_sm_hedge *hedge = pending_stream_acquisition->hedge;
+    if (hedge) {
+        aws_mutex_lock(&hedge->lock);
+        if (hedge->primary == pending_stream_acquisition) {
+            hedge->primary = NULL;
+        } else if (hedge->duplicate == pending_stream_acquisition) {
+            hedge->duplicate = NULL;
+        }
+        if (hedge->winner == pending_stream_acquisition) {
+            hedge->winner = NULL;
+        }
+        aws_mutex_unlock(&hedge->lock);
+        aws_ref_count_release(&hedge->ref_count);
+    }
     aws_mem_release(pending_stream_acquisition->allocator, pending_stream_acquisition);
 }
 
+/**
+ * Returns whether the acquisition's stream is the one delivered to the user, claiming the win if it's undecided.
+ * With defer_to_other, an active stream on the other side is let to win instead.
+ * Never invoke with the stream manager's lock held.
+ */
+static bool s_hedge_claim(
+    struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition,
+    bool defer_to_other) {
+    struct aws_h2_sm_hedge *hedge = pending_stream_acquisition->hedge;
+    if (hedge == NULL) {
+        return true;
+    }
+    aws_mutex_lock(&hedge->lock);
+    if (!hedge->is_decided) {
+        struct aws_h2_sm_pending_stream_acquisition *other =
+            hedge->primary == pending_stream_acquisition ? hedge->duplicate : hedge->primary;
+        bool other_active = other && other->hedge_stream;
+        if (!defer_to_other || !other_active) {
+            hedge->winner = pending_stream_acquisition;
+            hedge->is_decided = true;
+            if (other_active) {
+                STREAM_MANAGER_LOGF(
+                    DEBUG,
+                    hedge->stream_manager,
+                    "hedged stream:%p won the race, resetting stream:%p",
+                    (void *)pending_stream_acquisition->hedge_stream,
+                    (void *)other->hedge_stream);
+                /* The stream stays alive until its completion, which clears hedge_stream under the lock */
+                aws_http2_stream_reset(other->hedge_stream, AWS_HTTP2_ERR_CANCEL);
+            }
+        }
+    }
+    bool won = hedge->winner == pending_stream_acquisition;
+    aws_mutex_unlock(&hedge->lock);
+    return won;
+}
+
+/* Track the active stream of a hedged acquisition, NULL once it completes. Only called from the stream's thread */
+static void s_hedge_set_stream(
+    struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition,
+    struct aws_http_stream *stream) {
+    struct aws_h2_sm_hedge *hedge = pending_stream_acquisition->hedge;
+    if (hedge == NULL) {
+        return;
+    }
+    aws_mutex_lock(&hedge->lock);
+    pending_stream_acquisition->hedge_stream = stream;
+    if (stream && hedge->is_decided && hedge->winner != pending_stream_acquisition) {
+        /* Lost before it even started */
+        aws_http2_stream_reset(stream, AWS_HTTP2_ERR_CANCEL);
+    }
+    aws_mutex_unlock(&hedge->lock);
+}
+
 static void s_lock_synced_data(struct aws_http2_stream_manager *stream_manager) {
     int err = aws_mutex_lock(&stream_manager->synced_data.lock);
     AWS_ASSERT(!err && "lock failed");
@@ -131,18 +245,137 @@ static void s_aws_stream_management_transaction_clean_up(struct aws_http2_stream
     aws_ref_count_release(&work->stream_manager->internal_ref_count);
 }
 
-static struct aws_h2_sm_connection *s_get_best_sm_connection_from_set(struct aws_random_access_set *set) {
+/* Whether a is a better pick than b by the selection policy. *_synced should only be called with LOCK HELD */
+static bool s_sm_connection_is_better_synced(
+    enum aws_http2_stream_manager_selection_policy policy,
+    const struct aws_h2_sm_connection *a,
+    const struct aws_h2_sm_connection *b) {
+
+    switch (policy) {
+        case AWS_HTTP2_STREAM_MANAGER_SELECTION_LEAST_OUTSTANDING_BYTES:
+            if (a->load.window_size_peer != b->load.window_size_peer) {
+                return a->load.window_size_peer > b->load.window_size_peer;
+            }
+            break;
+        case AWS_HTTP2_STREAM_MANAGER_SELECTION_FEWEST_STALLED_STREAMS:
+            if (a->load.stalled_stream_count != b->load.stalled_stream_count) {
+                return a->load.stalled_stream_count < b->load.stalled_stream_count;
+            }
+            break;
+        case AWS_HTTP2_STREAM_MANAGER_SELECTION_LOWEST_RTT:
+            /* Only comparable once both have had a PING round trip */
+            if (a->load.smoothed_rtt_ns && b->load.smoothed_rtt_ns &&
+                a->load.smoothed_rtt_ns != b->load.smoothed_rtt_ns) {
+                return a->load.smoothed_rtt_ns < b->load.smoothed_rtt_ns;
+            }
+            break;
+        default:
+            break;
+    }
+    return a->num_streams_assigned < b->num_streams_assigned;
+}
+
+/* *_synced should only be called with LOCK HELD */
+static bool s_sm_connection_is_degraded_synced(
+    const struct aws_http2_stream_manager *stream_manager,
+    const struct aws_h2_sm_connection *sm_connection) {
+    return sm_connection->health_score < stream_manager->degraded_health_score;
+}
+
+/* Returns NULL if the set is empty, or has nothing but the excluded connection */
+static struct aws_h2_sm_connection *s_get_best_sm_connection_from_set(
+    struct aws_http2_stream_manager *stream_manager,
+    struct aws_intrusive_random_access_set *set,
+    const struct aws_h2_sm_connection *excluded) {
     /* Use the best two algorithm */
     int errored = AWS_ERROR_SUCCESS;
-    struct aws_h2_sm_connection *sm_connection_a = NULL;
-    errored = aws_random_access_set_random_get_ptr(set, (void **)&sm_connection_a);
-    struct aws_h2_sm_connection *sm_connection_b = NULL;
-    errored |= aws_random_access_set_random_get_ptr(set, (void **)&sm_connection_b);
-    struct aws_h2_sm_connection *chosen_connection =
-        sm_connection_a->num_streams_assigned > sm_connection_b->num_streams_assigned ? sm_connection_b
-                                                                                      : sm_connection_a;
-    return errored == AWS_ERROR_SUCCESS ? chosen_connection : NULL;
-    (void)errored;
+    struct aws_intrusive_random_access_set_node *node_a = NULL;
+    errored = aws_intrusive_random_access_set_random_get(set, &node_a);
+    struct aws_intrusive_random_access_set_node *node_b = NULL;
+    errored |= aws_intrusive_random_access_set_random_get(set, &node_b);
+    if (errored != AWS_ERROR_SUCCESS) {
+        return NULL;
+    }
+    struct aws_h2_sm_connection *sm_connection_a =
+        AWS_CONTAINER_OF(node_a, struct aws_h2_sm_connection, available_node);
+    struct aws_h2_sm_connection *sm_connection_b =
+        AWS_CONTAINER_OF(node_b, struct aws_h2_sm_connection, available_node);
+    if (excluded) {
+        if (sm_connection_a == excluded) {
+            sm_connection_a = sm_connection_b;
+        } else if (sm_connection_b == excluded) {
+            sm_connection_b = sm_connection_a;
+        }
+        if (sm_connection_a == excluded) {
+            /* Both picks missed, take any other one */
+            sm_connection_a = NULL;
+            size_t size = aws_intrusive_random_access_set_get_size(set);
+            for (size_t i = 0; i < size && sm_connection_a == NULL; ++i) {
+                struct aws_intrusive_random_access_set_node *node = NULL;
+                aws_intrusive_random_access_set_get_index(set, &node, i);
+                struct aws_h2_sm_connection *sm_connection =
+                    AWS_CONTAINER_OF(node, struct aws_h2_sm_connection, available_node);
+                if (sm_connection != excluded) {
+                    sm_connection_a = sm_connection;
+                }
+            }
+            return sm_connection_a;
+        }
+    }
+    /* A degraded connection only wins if both picks are degraded */
+    bool degraded_a = s_sm_connection_is_degraded_synced(stream_manager, sm_connection_a);
+    bool degraded_b = s_sm_connection_is_degraded_synced(stream_manager, sm_connection_b);
+    if (degraded_a != degraded_b) {
+        return degraded_a ? sm_connection_b : sm_connection_a;
+    }
+    return s_sm_connection_is_better_synced(stream_manager->selection_policy, sm_connection_b, sm_connection_a)
+               ? sm_connection_b
+               : sm_connection_a;
+}
+
+/* Sample the connection's load for the selection policy, and its health. Only called from the connection's thread */
+static void s_sm_connection_sample_load(struct aws_h2_sm_connection *sm_connection) {
+    struct aws_http2_stream_manager *stream_manager = sm_connection->stream_manager;
+    bool sample_load = stream_manager->selection_policy != AWS_HTTP2_STREAM_MANAGER_SELECTION_FEWEST_STREAMS;
+    bool sample_health = stream_manager->degraded_health_score > 0;
+    if ((!sample_load && !sample_health) || sm_connection->connection == NULL) {
+        return;
+    }
+
+    struct aws_h2_connection_load load;
+    AWS_ZERO_STRUCT(load);
+    if (sample_load) {
+        aws_h2_connection_get_load(sm_connection->connection, &load);
+    }
+    uint32_t health_score = aws_http_connection_get_health_score(sm_connection->connection);
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(stream_manager);
+        if (sample_load) {
+            sm_connection->load = load;
+        }
+        sm_connection->health_score = health_score;
+        s_unlock_synced_data(stream_manager);
+    } /* END CRITICAL SECTION */
+}
+
+/* The streams a connection takes before new streams prefer other connections */
+/* *_synced should only be called with LOCK HELD or from another synced function */
+static size_t s_sm_connection_ideal_streams_synced(
+    const struct aws_http2_stream_manager *stream_manager,
+    const struct aws_h2_sm_connection *sm_connection) {
+    if (stream_manager->enable_adaptive_concurrency) {
+        return sm_connection->adaptive.ideal_streams;
+    }
+    return stream_manager->ideal_concurrent_streams_per_connection;
+}
+
+/* The streams a connection not made yet is expected to take */
+/* *_synced should only be called with LOCK HELD or from another synced function */
+static size_t s_sm_new_connection_ideal_streams_synced(const struct aws_http2_stream_manager *stream_manager) {
+    if (stream_manager->enable_adaptive_concurrency) {
+        return stream_manager->synced_data.adaptive_ideal_streams;
+    }
+    return stream_manager->ideal_concurrent_streams_per_connection;
 }
 
 /* helper function for building the transaction: Try to assign connection for a pending stream acquisition */
@@ -153,13 +386,18 @@ static void s_sm_try_assign_connection_to_pending_stream_acquisition_synced(
 
     AWS_ASSERT(pending_stream_acquisition->sm_connection == NULL);
     int errored = 0;
-    if (aws_random_access_set_get_size(&stream_manager->synced_data.ideal_available_set)) {
+    struct aws_h2_sm_connection *ideal_connection = NULL;
+    if (aws_intrusive_random_access_set_get_size(&stream_manager->synced_data.ideal_available_set)) {
+        ideal_connection = s_get_best_sm_connection_from_set(
+            stream_manager,
+            &stream_manager->synced_data.ideal_available_set,
+            pending_stream_acquisition->excluded_connection);
+    }
+    if (ideal_connection) {
         /**
          * Try assigning to connection from ideal set
          */
-        struct aws_h2_sm_connection *chosen_connection =
-            s_get_best_sm_connection_from_set(&stream_manager->synced_data.ideal_available_set);
-        AWS_ASSERT(chosen_connection);
+        struct aws_h2_sm_connection *chosen_connection = ideal_connection;
         pending_stream_acquisition->sm_connection = chosen_connection;
         chosen_connection->num_streams_assigned++;
 
@@ -175,8 +413,8 @@ static void s_sm_try_assign_connection_to_pending_stream_acquisition_synced(
             /* It becomes not available for new streams any more, remove it from the set, but still alive (streams
              * created will track the lifetime) */
             chosen_connection->state = AWS_H2SMCST_FULL;
-            errored |=
-                aws_random_access_set_remove(&stream_manager->synced_data.ideal_available_set, chosen_connection);
+            aws_intrusive_random_access_set_remove(
+                &stream_manager->synced_data.ideal_available_set, &chosen_connection->available_node);
             STREAM_MANAGER_LOGF(
                 DEBUG,
                 stream_manager,
@@ -184,13 +422,15 @@ static void s_sm_try_assign_connection_to_pending_stream_acquisition_synced(
                 "Connection max limits=%" PRIu32 ". Moving it out of available connections.",
                 (void *)chosen_connection->connection,
                 chosen_connection->max_concurrent_streams);
-        } else if (chosen_connection->num_streams_assigned >= stream_manager->ideal_concurrent_streams_per_connection) {
+        } else if (
+            chosen_connection->num_streams_assigned >=
+            s_sm_connection_ideal_streams_synced(stream_manager, chosen_connection)) {
             /* It meets the ideal limit, but still available for new streams, move it to the nonidea-available set */
-            errored |=
-                aws_random_access_set_remove(&stream_manager->synced_data.ideal_available_set, chosen_connection);
+            aws_intrusive_random_access_set_remove(
+                &stream_manager->synced_data.ideal_available_set, &chosen_connection->available_node);
             bool added = false;
-            errored |= aws_random_access_set_add(
-                &stream_manager->synced_data.nonideal_available_set, chosen_connection, &added);
+            errored |= aws_intrusive_random_access_set_add(
+                &stream_manager->synced_data.nonideal_available_set, &chosen_connection->available_node, &added);
             errored |= !added;
             chosen_connection->state = AWS_H2SMCST_NEARLY_FULL;
             STREAM_MANAGER_LOGF(
@@ -198,9 +438,12 @@ static void s_sm_try_assign_connection_to_pending_stream_acquisition_synced(
                 stream_manager,
                 "connection:%p reaches ideal concurrent streams limits. Ideal limits=%zu. Moving it to nonlimited set.",
                 (void *)chosen_connection->connection,
-                stream_manager->ideal_concurrent_streams_per_connection);
+                s_sm_connection_ideal_streams_synced(stream_manager, chosen_connection));
+        }
+        if (chosen_connection->num_streams_assigned >= chosen_connection->adaptive.ideal_streams) {
+            chosen_connection->adaptive.round_saturated = true;
         }
-    } else if (stream_manager->synced_data.holding_connections_count == stream_manager->max_connections) {
+    } else if (stream_manager->synced_data.holding_connections_count >= stream_manager->max_connections) {
         /**
          * Try assigning to connection from nonideal available set.
          *
@@ -208,10 +451,14 @@ static void s_sm_try_assign_connection_to_pending_stream_acquisition_synced(
          * possibly get. This way, we don't overfill the first connections we get our hands on.
          */
 
-        if (aws_random_access_set_get_size(&stream_manager->synced_data.nonideal_available_set)) {
-            struct aws_h2_sm_connection *chosen_connection =
-                s_get_best_sm_connection_from_set(&stream_manager->synced_data.nonideal_available_set);
-            AWS_ASSERT(chosen_connection);
+        if (aws_intrusive_random_access_set_get_size(&stream_manager->synced_data.nonideal_available_set)) {
+            struct aws_h2_sm_connection *chosen_connection = s_get_best_sm_connection_from_set(
+                stream_manager,
+                &stream_manager->synced_data.nonideal_available_set,
+                pending_stream_acquisition->excluded_connection);
+            if (chosen_connection == NULL) {
+                return;
+            }
             pending_stream_acquisition->sm_connection = chosen_connection;
             chosen_connection->num_streams_assigned++;
 
@@ -227,8 +474,8 @@ static void s_sm_try_assign_connection_to_pending_stream_acquisition_synced(
                 /* It becomes not available for new streams any more, remove it from the set, but still alive (streams
                  * created will track the lifetime) */
                 chosen_connection->state = AWS_H2SMCST_FULL;
-                errored |= aws_random_access_set_remove(
-                    &stream_manager->synced_data.nonideal_available_set, chosen_connection);
+                aws_intrusive_random_access_set_remove(
+                    &stream_manager->synced_data.nonideal_available_set, &chosen_connection->available_node);
                 STREAM_MANAGER_LOGF(
                     DEBUG,
                     stream_manager,
@@ -237,12 +484,37 @@ static void s_sm_try_assign_connection_to_pending_stream_acquisition_synced(
                     (void *)chosen_connection->connection,
                     chosen_connection->max_concurrent_streams);
             }
+            chosen_connection->adaptive.round_saturated = true;
         }
     }
     AWS_ASSERT(errored == 0 && "random access set went wrong");
     (void)errored;
 }
 
+/**
+ * Tell the user an acquisition failed. A replay has no acquire callback, instead the stream it replaces completes
+ * with the error. NOTE: never invoke with lock held
+ */
+static void s_pending_stream_acquisition_notify_failure(
+    struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition,
+    int error_code) {
+    if (pending_stream_acquisition->callback) {
+        pending_stream_acquisition->callback(NULL, error_code, pending_stream_acquisition->user_data);
+    }
+    struct aws_http_stream *replaced_stream = pending_stream_acquisition->replaced_stream;
+    if (replaced_stream) {
+        pending_stream_acquisition->replaced_stream = NULL;
+        if (pending_stream_acquisition->options.on_complete) {
+            pending_stream_acquisition->options.on_complete(
+                replaced_stream, error_code, pending_stream_acquisition->options.user_data);
+        }
+        aws_http_stream_release(replaced_stream);
+        if (pending_stream_acquisition->options.on_destroy) {
+            pending_stream_acquisition->options.on_destroy(pending_stream_acquisition->options.user_data);
+        }
+    }
+}
+
 /* NOTE: never invoke with lock held */
 static void s_finish_pending_stream_acquisitions_list_helper(
     struct aws_http2_stream_manager *stream_manager,
@@ -254,9 +526,8 @@ static void s_finish_pending_stream_acquisitions_list_helper(
             AWS_CONTAINER_OF(node, struct aws_h2_sm_pending_stream_acquisition, node);
         /* Make sure no connection assigned. */
         AWS_ASSERT(pending_stream_acquisition->sm_connection == NULL);
-        if (pending_stream_acquisition->callback) {
-            pending_stream_acquisition->callback(NULL, error_code, pending_stream_acquisition->user_data);
-        }
+        AWS_HTTP_PROBE3(stream__manager__acquire, stream_manager, NULL, error_code);
+        s_pending_stream_acquisition_notify_failure(pending_stream_acquisition, error_code);
         STREAM_MANAGER_LOGF(
             DEBUG,
             stream_manager,
@@ -301,12 +572,11 @@ static void s_finish_pending_stream_acquisitions_task(struct aws_task *task, voi
 static void s_check_new_connections_needed_synced(struct aws_http2_stream_management_transaction *work) {
     struct aws_http2_stream_manager *stream_manager = work->stream_manager;
     /* The ideal new connection we need to fit all the pending stream acquisitions */
+    size_t ideal_streams = s_sm_new_connection_ideal_streams_synced(stream_manager);
     size_t ideal_new_connection_count =
-        stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION] /
-        stream_manager->ideal_concurrent_streams_per_connection;
+        stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION] / ideal_streams;
     /* Rounding up */
-    if (stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION] %
-        stream_manager->ideal_concurrent_streams_per_connection) {
+    if (stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION] % ideal_streams) {
         ++ideal_new_connection_count;
     }
     /* The ideal new connections sub the number of connections we are acquiring to avoid the async acquiring */
@@ -314,9 +584,11 @@ static void s_check_new_connections_needed_synced(struct aws_http2_stream_manage
         ideal_new_connection_count,
         stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_CONNECTIONS_ACQUIRING]);
     /* The real number we can have is the min of how many more we can still have and how many we need */
-    size_t new_connections_available =
-        stream_manager->max_connections - stream_manager->synced_data.holding_connections_count -
-        stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_CONNECTIONS_ACQUIRING];
+    /* Saturating, since a successor being acquired can take it over the max for a while */
+    size_t new_connections_available = aws_sub_size_saturating(
+        stream_manager->max_connections,
+        stream_manager->synced_data.holding_connections_count +
+            stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_CONNECTIONS_ACQUIRING]);
     work->new_connections = aws_min_size(new_connections_available, work->new_connections);
     /* Update the number of connections we acquiring */
     s_sm_count_increase_synced(stream_manager, AWS_SMCT_CONNECTIONS_ACQUIRING, work->new_connections);
@@ -417,6 +689,8 @@ static void s_on_ping_complete(
         (void *)sm_connection->connection,
         round_trip_time_ns);
     sm_connection->thread_data.ping_received = true;
+    /* The connection folded this round trip into its RTT estimate */
+    s_sm_connection_sample_load(sm_connection);
 
 done:
     /* Release refcount held for ping complete */
@@ -496,6 +770,7 @@ static void s_connection_ping_task(struct aws_channel_task *task, void *arg, enu
 
 static void s_sm_connection_destroy(void *user_data) {
     struct aws_h2_sm_connection *sm_connection = user_data;
+    aws_array_list_clean_up(&sm_connection->thread_data.finished_streams);
     aws_mem_release(sm_connection->allocator, sm_connection);
 }
 
@@ -512,10 +787,25 @@ static struct aws_h2_sm_connection *s_sm_connection_new(
     uint32_t remote_max_con_streams = out_settings[AWS_HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS - 1].value;
     sm_connection->max_concurrent_streams =
         aws_min_u32((uint32_t)stream_manager->max_concurrent_streams_per_connection, remote_max_con_streams);
+    sm_connection->adaptive.ideal_streams = aws_max_u32(
+        aws_min_u32(stream_manager->synced_data.adaptive_ideal_streams, sm_connection->max_concurrent_streams), 1);
     sm_connection->connection = connection;
     sm_connection->stream_manager = stream_manager;
     sm_connection->state = AWS_H2SMCST_IDEAL;
+    sm_connection->health_score = aws_http_connection_get_health_score(connection);
+    aws_high_res_clock_get_ticks(&sm_connection->created_timestamp);
     aws_ref_count_init(&sm_connection->ref_count, sm_connection, s_sm_connection_destroy);
+    /* Can't fail without an initial allocation */
+    aws_array_list_init_dynamic(
+        &sm_connection->thread_data.finished_streams,
+        stream_manager->allocator,
+        0,
+        sizeof(struct aws_h2_sm_finished_stream));
+    aws_channel_task_init(
+        &sm_connection->finish_streams_task,
+        s_sm_connection_finish_streams_task,
+        sm_connection,
+        "Stream manager finish streams task");
     if (stream_manager->connection_ping_period_ns) {
         struct aws_channel *channel = aws_http_connection_get_channel(connection);
         uint64_t schedule_time = 0;
@@ -551,7 +841,7 @@ static void s_sm_on_connection_acquired_failed_synced(
     /* Once we failed to acquire a connection, we fail the stream acquisitions that cannot fit into the remaining
      * acquiring connections. */
     size_t num_can_fit = aws_mul_size_saturating(
-        stream_manager->ideal_concurrent_streams_per_connection,
+        s_sm_new_connection_ideal_streams_synced(stream_manager),
         stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_CONNECTIONS_ACQUIRING]);
     size_t num_to_fail = aws_sub_size_saturating(
         stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION], num_can_fit);
@@ -564,6 +854,83 @@ static void s_sm_on_connection_acquired_failed_synced(
     s_sm_count_decrease_synced(stream_manager, AWS_SMCT_PENDING_ACQUISITION, num_to_fail);
 }
 
+/*
+ * The front of connections_awaiting_successor got its successor: move new streams off of it, and let it drain.
+ * *_synced should only be called with LOCK HELD or from another synced function
+ */
+static void s_sm_connection_retire_synced(struct aws_http2_stream_manager *stream_manager) {
+    struct aws_linked_list_node *node =
+        aws_linked_list_pop_front(&stream_manager->synced_data.connections_awaiting_successor);
+    struct aws_h2_sm_connection *sm_connection = AWS_CONTAINER_OF(node, struct aws_h2_sm_connection, successor_node);
+    sm_connection->successor_requested = false;
+    sm_connection->is_retiring = true;
+    /* It might not be in either, but, it's fine */
+    aws_intrusive_random_access_set_remove(
+        &stream_manager->synced_data.ideal_available_set, &sm_connection->available_node);
+    aws_intrusive_random_access_set_remove(
+        &stream_manager->synced_data.nonideal_available_set, &sm_connection->available_node);
+    sm_connection->state = AWS_H2SMCST_FULL;
+    --stream_manager->synced_data.holding_connections_count;
+    ++stream_manager->synced_data.retiring_connections_count;
+    /* Still has streams, or it would have been released already. The last one to finish releases it */
+    AWS_ASSERT(sm_connection->num_streams_assigned > 0);
+    STREAM_MANAGER_LOGF(
+        DEBUG,
+        stream_manager,
+        "connection:%p replaced by a successor, draining %" PRIu32 " streams",
+        (void *)sm_connection->connection,
+        sm_connection->num_streams_assigned);
+}
+
+/*
+ * Request a successor once a connection passes its replacement threshold, or degrades.
+ * Degraded connections are replaced one at a time, so a slow peer doesn't churn every connection at once.
+ * Only called from the connection's thread
+ */
+static void s_sm_connection_check_replacement(struct aws_h2_sm_connection *sm_connection, uint32_t stream_id) {
+    struct aws_http2_stream_manager *stream_manager = sm_connection->stream_manager;
+    bool past_stream_id = stream_manager->connection_replacement_stream_id &&
+                          stream_id >= stream_manager->connection_replacement_stream_id;
+    bool past_age = false;
+    if (stream_manager->connection_replacement_age_ns) {
+        uint64_t now = 0;
+        aws_high_res_clock_get_ticks(&now);
+        past_age = now - sm_connection->created_timestamp >= stream_manager->connection_replacement_age_ns;
+    }
+    bool degraded = stream_manager->degraded_health_score > 0 &&
+                    aws_http_connection_get_health_score(sm_connection->connection) <
+                        stream_manager->degraded_health_score;
+    if (!past_stream_id && !past_age && !degraded) {
+        return;
+    }
+
+    struct aws_http2_stream_management_transaction work;
+    s_aws_stream_management_transaction_init(&work, stream_manager);
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(stream_manager);
+        bool replacing_another = !aws_linked_list_empty(&stream_manager->synced_data.connections_awaiting_successor) ||
+                                 stream_manager->synced_data.retiring_connections_count > 0;
+        bool should_replace = past_stream_id || past_age || !replacing_another;
+        if (should_replace && stream_manager->synced_data.state == AWS_H2SMST_READY &&
+            !sm_connection->successor_requested && !sm_connection->is_retiring &&
+            sm_connection->num_streams_assigned > 0) {
+            STREAM_MANAGER_LOGF(
+                DEBUG,
+                stream_manager,
+                "connection:%p %s, acquiring a successor",
+                (void *)sm_connection->connection,
+                (past_stream_id || past_age) ? "past its replacement threshold" : "degraded");
+            sm_connection->successor_requested = true;
+            aws_linked_list_push_back(
+                &stream_manager->synced_data.connections_awaiting_successor, &sm_connection->successor_node);
+            s_sm_count_increase_synced(stream_manager, AWS_SMCT_CONNECTIONS_ACQUIRING, 1);
+            work.new_connections = 1;
+        }
+        s_unlock_synced_data(stream_manager);
+    } /* END CRITICAL SECTION */
+    s_aws_http2_stream_manager_execute_transaction(&work);
+}
+
 static void s_sm_on_connection_acquired(struct aws_http_connection *connection, int error_code, void *user_data) {
     struct aws_http2_stream_manager *stream_manager = user_data;
     struct aws_http2_stream_management_transaction work;
@@ -603,7 +970,9 @@ static void s_sm_on_connection_acquired(struct aws_http_connection *connection,
                 (void *)connection);
             /* Release the acquired connection */
             should_release_connection = true;
-        } else if (stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION] == 0) {
+        } else if (
+            stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION] == 0 &&
+            aws_linked_list_empty(&stream_manager->synced_data.connections_awaiting_successor)) {
             STREAM_MANAGER_LOGF(
                 DEBUG,
                 stream_manager,
@@ -614,10 +983,14 @@ static void s_sm_on_connection_acquired(struct aws_http_connection *connection,
         } else {
             struct aws_h2_sm_connection *sm_connection = s_sm_connection_new(stream_manager, connection);
             bool added = false;
-            re_error |=
-                aws_random_access_set_add(&stream_manager->synced_data.ideal_available_set, sm_connection, &added);
+            re_error |= aws_intrusive_random_access_set_add(
+                &stream_manager->synced_data.ideal_available_set, &sm_connection->available_node, &added);
             re_error |= !added;
             ++stream_manager->synced_data.holding_connections_count;
+            if (!aws_linked_list_empty(&stream_manager->synced_data.connections_awaiting_successor)) {
+                /* Whatever it was acquired for, it takes over the new streams of a connection being replaced */
+                s_sm_connection_retire_synced(stream_manager);
+            }
         }
         s_aws_http2_stream_manager_build_transaction_synced(&work);
         s_unlock_synced_data(stream_manager);
@@ -646,7 +1019,12 @@ static int s_on_incoming_headers(
     struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition = user_data;
     struct aws_h2_sm_connection *sm_connection = pending_stream_acquisition->sm_connection;
     struct aws_http2_stream_manager *stream_manager = sm_connection->stream_manager;
+    pending_stream_acquisition->response_started = true;
 
+    if (!s_hedge_claim(pending_stream_acquisition, false /*defer_to_other*/)) {
+        /* Lost the race, the stream is being reset */
+        return AWS_OP_SUCCESS;
+    }
     if (pending_stream_acquisition->options.on_response_headers) {
         return pending_stream_acquisition->options.on_response_headers(
             stream, header_block, header_array, num_headers, pending_stream_acquisition->options.user_data);
@@ -686,6 +1064,9 @@ static int s_on_incoming_header_block_done(
     enum aws_http_header_block header_block,
     void *user_data) {
     struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition = user_data;
+    if (!s_hedge_claim(pending_stream_acquisition, false /*defer_to_other*/)) {
+        return AWS_OP_SUCCESS;
+    }
     if (pending_stream_acquisition->options.on_response_header_block_done) {
         return pending_stream_acquisition->options.on_response_header_block_done(
             stream, header_block, pending_stream_acquisition->options.user_data);
@@ -695,6 +1076,9 @@ static int s_on_incoming_header_block_done(
 
 static int s_on_incoming_body(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
     struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition = user_data;
+    if (!s_hedge_claim(pending_stream_acquisition, false /*defer_to_other*/)) {
+        return AWS_OP_SUCCESS;
+    }
     if (pending_stream_acquisition->options.on_response_body) {
         return pending_stream_acquisition->options.on_response_body(
             stream, data, pending_stream_acquisition->options.user_data);
@@ -709,7 +1093,7 @@ static void s_update_sm_connection_set_on_stream_finishes_synced(
 
     int re_error = 0;
     size_t cur_num = sm_connection->num_streams_assigned;
-    size_t ideal_num = stream_manager->ideal_concurrent_streams_per_connection;
+    size_t ideal_num = s_sm_connection_ideal_streams_synced(stream_manager, sm_connection);
     size_t max_num = sm_connection->max_concurrent_streams;
     /**
      * TODO: When the MAX_CONCURRENT_STREAMS from other side changed after the initial settings. We need to:
@@ -719,17 +1103,24 @@ static void s_update_sm_connection_set_on_stream_finishes_synced(
      */
     if (sm_connection->state == AWS_H2SMCST_NEARLY_FULL && cur_num < ideal_num) {
         /* this connection is back from soft limited to ideal */
-        bool exist = false;
-        (void)exist;
-        AWS_ASSERT(
-            aws_random_access_set_exist(&stream_manager->synced_data.nonideal_available_set, sm_connection, &exist) ==
-                AWS_OP_SUCCESS &&
-            exist);
-        re_error |= aws_random_access_set_remove(&stream_manager->synced_data.nonideal_available_set, sm_connection);
+        AWS_ASSERT(aws_intrusive_random_access_set_exist(
+            &stream_manager->synced_data.nonideal_available_set, &sm_connection->available_node));
+        aws_intrusive_random_access_set_remove(
+            &stream_manager->synced_data.nonideal_available_set, &sm_connection->available_node);
         bool added = false;
-        re_error |= aws_random_access_set_add(&stream_manager->synced_data.ideal_available_set, sm_connection, &added);
+        re_error |= aws_intrusive_random_access_set_add(
+            &stream_manager->synced_data.ideal_available_set, &sm_connection->available_node, &added);
         re_error |= !added;
         sm_connection->state = AWS_H2SMCST_IDEAL;
+    } else if (sm_connection->state == AWS_H2SMCST_IDEAL && cur_num >= ideal_num) {
+        /* its adaptive ideal number went down past the streams it has */
+        aws_intrusive_random_access_set_remove(
+            &stream_manager->synced_data.ideal_available_set, &sm_connection->available_node);
+        bool added = false;
+        re_error |= aws_intrusive_random_access_set_add(
+            &stream_manager->synced_data.nonideal_available_set, &sm_connection->available_node, &added);
+        re_error |= !added;
+        sm_connection->state = AWS_H2SMCST_NEARLY_FULL;
     } else if (sm_connection->state == AWS_H2SMCST_FULL && cur_num < max_num) {
         /* this connection is back from full */
         STREAM_MANAGER_LOGF(
@@ -744,14 +1135,14 @@ static void s_update_sm_connection_set_on_stream_finishes_synced(
             sm_connection->state = AWS_H2SMCST_NEARLY_FULL;
             STREAM_MANAGER_LOGF(
                 TRACE, stream_manager, "connection:%p added to soft limited set", (void *)sm_connection->connection);
-            re_error |=
-                aws_random_access_set_add(&stream_manager->synced_data.nonideal_available_set, sm_connection, &added);
+            re_error |= aws_intrusive_random_access_set_add(
+                &stream_manager->synced_data.nonideal_available_set, &sm_connection->available_node, &added);
         } else {
             sm_connection->state = AWS_H2SMCST_IDEAL;
             STREAM_MANAGER_LOGF(
                 TRACE, stream_manager, "connection:%p added to ideal set", (void *)sm_connection->connection);
-            re_error |=
-                aws_random_access_set_add(&stream_manager->synced_data.ideal_available_set, sm_connection, &added);
+            re_error |= aws_intrusive_random_access_set_add(
+                &stream_manager->synced_data.ideal_available_set, &sm_connection->available_node, &added);
         }
         re_error |= !added;
     }
@@ -759,32 +1150,151 @@ static void s_update_sm_connection_set_on_stream_finishes_synced(
     (void)re_error;
 }
 
-static void s_sm_connection_on_scheduled_stream_finishes(
+/* *_synced should only be called with LOCK HELD or from another synced function */
+static void s_sm_record_latency_synced(struct aws_http2_stream_manager *stream_manager, uint64_t latency_ns) {
+    stream_manager->synced_data.recent_latencies_ns[stream_manager->synced_data.recent_latencies_next] = latency_ns;
+    stream_manager->synced_data.recent_latencies_next =
+        (stream_manager->synced_data.recent_latencies_next + 1) % AWS_H2_SM_LATENCY_SAMPLES;
+    if (stream_manager->synced_data.recent_latencies_count < AWS_H2_SM_LATENCY_SAMPLES) {
+        ++stream_manager->synced_data.recent_latencies_count;
+    }
+}
+
+static int s_compare_latency(const void *a, const void *b) {
+    uint64_t latency_a = *(const uint64_t *)a;
+    uint64_t latency_b = *(const uint64_t *)b;
+    return latency_a < latency_b ? -1 : (latency_a > latency_b ? 1 : 0);
+}
+
+/* Returns 0 until enough streams completed. *_synced should only be called with LOCK HELD */
+static uint64_t s_sm_recent_latency_p95_synced(const struct aws_http2_stream_manager *stream_manager) {
+    size_t count = stream_manager->synced_data.recent_latencies_count;
+    if (count < s_hedge_p95_min_samples) {
+        return 0;
+    }
+    uint64_t sorted[AWS_H2_SM_LATENCY_SAMPLES];
+    memcpy(sorted, stream_manager->synced_data.recent_latencies_ns, count * sizeof(uint64_t));
+    qsort(sorted, count, sizeof(uint64_t), s_compare_latency);
+    return sorted[(count * 95) / 100];
+}
+
+/**
+ * AIMD over the connection's ideal number of streams, see enable_adaptive_concurrency.
+ * latency_ns is zero unless the stream succeeded.
+ * *_synced should only be called with LOCK HELD or from another synced function
+ */
+static void s_sm_connection_adapt_ideal_streams_synced(
+    struct aws_http2_stream_manager *stream_manager,
     struct aws_h2_sm_connection *sm_connection,
-    struct aws_http2_stream_manager *stream_manager) {
+    uint64_t latency_ns,
+    bool is_refused) {
+    if (!stream_manager->enable_adaptive_concurrency || (latency_ns == 0 && !is_refused)) {
+        return;
+    }
+    uint32_t ideal_streams = sm_connection->adaptive.ideal_streams;
+    bool is_congested = is_refused;
+    if (latency_ns) {
+        if (sm_connection->adaptive.min_latency_ns == 0 || latency_ns < sm_connection->adaptive.min_latency_ns) {
+            sm_connection->adaptive.min_latency_ns = latency_ns;
+        }
+        is_congested |=
+            latency_ns > aws_mul_u64_saturating(sm_connection->adaptive.min_latency_ns, s_adaptive_latency_tolerance);
+    }
+    if (is_congested) {
+        /* Streams made before backing off still finish slow, only the first of them counts */
+        if (!sm_connection->adaptive.round_decreased) {
+            ideal_streams = aws_max_u32(ideal_streams / 2, 1);
+            sm_connection->adaptive.round_decreased = true;
+            sm_connection->adaptive.round_completed_count = 0;
+            sm_connection->adaptive.round_saturated = false;
+        }
+    } else if (++sm_connection->adaptive.round_completed_count >= ideal_streams) {
+        /* Only grow when the ideal number was what held the connection back */
+        if (sm_connection->adaptive.round_saturated && !sm_connection->adaptive.round_decreased &&
+            ideal_streams < sm_connection->max_concurrent_streams) {
+            ++ideal_streams;
+        }
+        sm_connection->adaptive.round_completed_count = 0;
+        sm_connection->adaptive.round_saturated = sm_connection->num_streams_assigned >= ideal_streams;
+        sm_connection->adaptive.round_decreased = false;
+    }
+    if (ideal_streams != sm_connection->adaptive.ideal_streams) {
+        STREAM_MANAGER_LOGF(
+            DEBUG,
+            stream_manager,
+            "connection:%p ideal concurrent streams %" PRIu32 " -> %" PRIu32 " (%s)",
+            (void *)sm_connection->connection,
+            sm_connection->adaptive.ideal_streams,
+            ideal_streams,
+            is_congested ? "congested" : "growing");
+        sm_connection->adaptive.ideal_streams = ideal_streams;
+        stream_manager->synced_data.adaptive_ideal_streams = ideal_streams;
+    }
+}
+
+/**
+ * Runs on the connection's thread once a tick, for every stream finished on it since the last time, so a read
+ * completing many streams takes the lock and builds a transaction once.
+ */
+static void s_sm_connection_finish_streams_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    /* Canceled means the channel shut down, the streams still have to be let go of */
+    (void)status;
+    struct aws_h2_sm_connection *sm_connection = arg;
+    struct aws_http2_stream_manager *stream_manager = sm_connection->stream_manager;
+    struct aws_array_list *finished_streams = &sm_connection->thread_data.finished_streams;
+    size_t finished_count = aws_array_list_length(finished_streams);
+    sm_connection->thread_data.finish_streams_task_scheduled = false;
+    /* The streams not let go of yet keep the connection from being released */
+    AWS_ASSERT(finished_count > 0 && sm_connection->connection);
+
+    s_sm_connection_sample_load(sm_connection);
     /* Reach the max current will still allow new requests, but the new stream will complete with error */
     bool connection_available = aws_http_connection_new_requests_allowed(sm_connection->connection);
     struct aws_http2_stream_management_transaction work;
     s_aws_stream_management_transaction_init(&work, stream_manager);
     { /* BEGIN CRITICAL SECTION */
         s_lock_synced_data(stream_manager);
-        s_sm_count_decrease_synced(stream_manager, AWS_SMCT_OPEN_STREAM, 1);
-        --sm_connection->num_streams_assigned;
+        s_sm_count_decrease_synced(stream_manager, AWS_SMCT_OPEN_STREAM, finished_count);
+        AWS_ASSERT(sm_connection->num_streams_assigned >= finished_count);
+        sm_connection->num_streams_assigned -= (uint32_t)finished_count;
+        for (size_t i = 0; i < finished_count; ++i) {
+            struct aws_h2_sm_finished_stream *finished = NULL;
+            aws_array_list_get_at_ptr(finished_streams, (void **)&finished, i);
+            if (finished->latency_ns) {
+                s_sm_record_latency_synced(stream_manager, finished->latency_ns);
+            }
+            s_sm_connection_adapt_ideal_streams_synced(
+                stream_manager, sm_connection, finished->latency_ns, finished->is_refused);
+        }
         if (!connection_available) {
             /* It might be removed already, but, it's fine */
-            aws_random_access_set_remove(&stream_manager->synced_data.ideal_available_set, sm_connection);
-            aws_random_access_set_remove(&stream_manager->synced_data.nonideal_available_set, sm_connection);
-        } else {
+            aws_intrusive_random_access_set_remove(
+                &stream_manager->synced_data.ideal_available_set, &sm_connection->available_node);
+            aws_intrusive_random_access_set_remove(
+                &stream_manager->synced_data.nonideal_available_set, &sm_connection->available_node);
+        } else if (!sm_connection->is_retiring) {
             s_update_sm_connection_set_on_stream_finishes_synced(sm_connection, stream_manager);
         }
+        /* Pending acquisitions get all the room the finished streams left at once */
         s_aws_http2_stream_manager_build_transaction_synced(&work);
         /* After we build transaction, if the sm_connection still have zero assigned stream, we can kill the
          * sm_connection */
         if (sm_connection->num_streams_assigned == 0) {
             /* It might be removed already, but, it's fine */
-            aws_random_access_set_remove(&stream_manager->synced_data.ideal_available_set, sm_connection);
+            aws_intrusive_random_access_set_remove(
+                &stream_manager->synced_data.ideal_available_set, &sm_connection->available_node);
             work.sm_connection_to_release = sm_connection;
-            --stream_manager->synced_data.holding_connections_count;
+            if (sm_connection->is_retiring) {
+                --stream_manager->synced_data.retiring_connections_count;
+            } else {
+                --stream_manager->synced_data.holding_connections_count;
+            }
+            if (sm_connection->successor_requested) {
+                /* Done before its successor came, the successor is just another connection now */
+                aws_linked_list_remove(&sm_connection->successor_node);
+                sm_connection->successor_requested = false;
+            }
             /* After we release one connection back, we should check if we need more connections */
             if (stream_manager->synced_data.state == AWS_H2SMST_READY &&
                 stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION]) {
@@ -793,28 +1303,255 @@ static void s_sm_connection_on_scheduled_stream_finishes(
         }
         s_unlock_synced_data(stream_manager);
     } /* END CRITICAL SECTION */
+    /* Streams finishing from here on wait for the next task */
+    aws_array_list_clear(finished_streams);
+    s_aws_http2_stream_manager_execute_transaction(&work);
+    aws_ref_count_release(&sm_connection->ref_count);
+}
+
+/**
+ * A stream assigned to the connection is done with it. latency_ns is recorded, if non-zero. is_refused if the server
+ * reset the stream with REFUSED_STREAM. Only called from the connection's thread, the stream manager hears of it in
+ * s_sm_connection_finish_streams_task.
+ */
+static void s_sm_connection_on_scheduled_stream_finishes(
+    struct aws_h2_sm_connection *sm_connection,
+    uint64_t latency_ns,
+    bool is_refused) {
+    struct aws_h2_sm_finished_stream finished = {
+        .latency_ns = latency_ns,
+        .is_refused = is_refused,
+    };
+    AWS_FATAL_ASSERT(
+        aws_array_list_push_back(&sm_connection->thread_data.finished_streams, &finished) == AWS_OP_SUCCESS);
+    if (sm_connection->thread_data.finish_streams_task_scheduled) {
+        return;
+    }
+    sm_connection->thread_data.finish_streams_task_scheduled = true;
+    /* Keep the sm_connection alive for the task, the streams it lets go of keep the stream manager alive */
+    aws_ref_count_acquire(&sm_connection->ref_count);
+    aws_channel_schedule_task_now(
+        aws_http_connection_get_channel(sm_connection->connection), &sm_connection->finish_streams_task);
+}
+
+/* Whether the acquisition's request can be replayed, should the server never process its stream */
+static bool s_sm_may_replay(
+    const struct aws_http2_stream_manager *stream_manager,
+    const struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition) {
+    return pending_stream_acquisition->retry_count < stream_manager->max_unprocessed_stream_retries &&
+           pending_stream_acquisition->hedge == NULL &&
+           !pending_stream_acquisition->options.http2_use_manual_data_writes &&
+           aws_http_message_get_body_async_stream(pending_stream_acquisition->request) == NULL;
+}
+
+/* Whether the server reset the stream with REFUSED_STREAM */
+static bool s_stream_was_refused(struct aws_http_stream *stream, int error_code) {
+    uint32_t h2_error_code = AWS_HTTP2_ERR_NO_ERROR;
+    return error_code == AWS_ERROR_HTTP_RST_STREAM_RECEIVED &&
+           aws_http2_stream_get_received_reset_error_code(stream, &h2_error_code) == AWS_OP_SUCCESS &&
+           h2_error_code == AWS_HTTP2_ERR_REFUSED_STREAM;
+}
+
+/**
+ * If the server never processed the stream, replay its request as a new acquisition, which takes over the user's
+ * callbacks. Returns whether it did. See max_unprocessed_stream_retries.
+ */
+static bool s_sm_try_replay_unprocessed_stream(
+    struct aws_http2_stream_manager *stream_manager,
+    struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition,
+    struct aws_http_stream *stream,
+    int error_code,
+    bool is_refused) {
+
+    /* The request is only kept past making the stream if it may be replayed */
+    if (pending_stream_acquisition->request == NULL || pending_stream_acquisition->response_started) {
+        return false;
+    }
+    /* Streams above a GOAWAY's last-stream-id complete with GOAWAY_RECEIVED */
+    bool is_cut_off_by_goaway = error_code == AWS_ERROR_HTTP_GOAWAY_RECEIVED;
+    if (!is_cut_off_by_goaway && !is_refused) {
+        return false;
+    }
+
+    bool is_ready = false;
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(stream_manager);
+        is_ready = stream_manager->synced_data.state == AWS_H2SMST_READY;
+        s_unlock_synced_data(stream_manager);
+    } /* END CRITICAL SECTION */
+    if (!is_ready) {
+        return false;
+    }
+
+    struct aws_input_stream *body = aws_http_message_get_body_stream(pending_stream_acquisition->request);
+    if (body && aws_input_stream_seek(body, 0, AWS_SSB_BEGIN)) {
+        STREAM_MANAGER_LOGF(
+            DEBUG,
+            stream_manager,
+            "stream:%p was never processed, but its body can't seek back to the start to replay it.",
+            (void *)stream);
+        return false;
+    }
+
+    struct aws_h2_sm_pending_stream_acquisition *replay = s_new_pending_stream_acquisition(
+        stream_manager->allocator, &pending_stream_acquisition->options, NULL /*callback*/, NULL /*user_data*/);
+    replay->retry_count = pending_stream_acquisition->retry_count + 1;
+    replay->replaced_stream = aws_http_stream_acquire(stream);
+    if (is_cut_off_by_goaway) {
+        /* The connection takes no new streams. A refused stream may go anywhere, the peer was just busy */
+        replay->excluded_connection = pending_stream_acquisition->sm_connection;
+    }
+    /* The user's on_destroy goes with the replay */
+    pending_stream_acquisition->options.on_destroy = NULL;
+
+    STREAM_MANAGER_LOGF(
+        DEBUG,
+        stream_manager,
+        "stream:%p was never processed (%s), replaying it as acquisition:%p, retry %" PRIu32 " of %zu",
+        (void *)stream,
+        is_cut_off_by_goaway ? "GOAWAY" : "REFUSED_STREAM",
+        (void *)replay,
+        replay->retry_count,
+        stream_manager->max_unprocessed_stream_retries);
+
+    struct aws_http2_stream_management_transaction work;
+    s_aws_stream_management_transaction_init(&work, stream_manager);
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(stream_manager);
+        aws_linked_list_push_back(&stream_manager->synced_data.pending_stream_acquisitions, &replay->node);
+        s_sm_count_increase_synced(stream_manager, AWS_SMCT_PENDING_ACQUISITION, 1);
+        s_aws_http2_stream_manager_build_transaction_synced(&work);
+        s_unlock_synced_data(stream_manager);
+    } /* END CRITICAL SECTION */
     s_aws_http2_stream_manager_execute_transaction(&work);
+    return true;
 }
 
 static void s_on_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
     struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition = user_data;
     struct aws_h2_sm_connection *sm_connection = pending_stream_acquisition->sm_connection;
     struct aws_http2_stream_manager *stream_manager = sm_connection->stream_manager;
-    if (pending_stream_acquisition->options.on_complete) {
-        pending_stream_acquisition->options.on_complete(
-            stream, error_code, pending_stream_acquisition->options.user_data);
+    uint64_t latency_ns = 0;
+    bool is_refused = s_stream_was_refused(stream, error_code);
+    if (error_code != AWS_ERROR_SUCCESS &&
+        s_sm_try_replay_unprocessed_stream(
+            stream_manager, pending_stream_acquisition, stream, error_code, is_refused)) {
+        /* The replay reports completion instead */
+        AWS_HTTP_PROBE2(stream__manager__release, stream_manager, stream);
+        s_sm_connection_on_scheduled_stream_finishes(sm_connection, 0 /*latency_ns*/, is_refused);
+        return;
+    }
+    /* A failed stream loses to an active one on the other side */
+    bool won = s_hedge_claim(pending_stream_acquisition, error_code != AWS_ERROR_SUCCESS /*defer_to_other*/);
+    s_hedge_set_stream(pending_stream_acquisition, NULL);
+    if (won) {
+        if (pending_stream_acquisition->options.on_complete) {
+            pending_stream_acquisition->options.on_complete(
+                stream, error_code, pending_stream_acquisition->options.user_data);
+        }
+        if (error_code == AWS_ERROR_SUCCESS) {
+            uint64_t now = 0;
+            aws_high_res_clock_get_ticks(&now);
+            latency_ns = aws_max_u64(now - pending_stream_acquisition->activate_timestamp, 1);
+        }
+    }
+    AWS_HTTP_PROBE2(stream__manager__release, stream_manager, stream);
+    s_sm_connection_on_scheduled_stream_finishes(sm_connection, latency_ns, is_refused);
+}
+
+static void s_on_stream_metrics(
+    struct aws_http_stream *stream,
+    const struct aws_http_stream_metrics *metrics,
+    void *user_data) {
+    struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition = user_data;
+    /* Metrics come before completion decides a hedge, so only the original stream of a hedge reports them */
+    bool is_duplicate = pending_stream_acquisition->hedge && pending_stream_acquisition->excluded_connection;
+    if (pending_stream_acquisition->options.on_metrics && !is_duplicate) {
+        pending_stream_acquisition->options.on_metrics(stream, metrics, pending_stream_acquisition->options.user_data);
     }
-    s_sm_connection_on_scheduled_stream_finishes(sm_connection, stream_manager);
 }
 
 static void s_on_stream_destroy(void *user_data) {
     struct aws_h2_sm_pending_stream_acquisition *pending_stream_acquisition = user_data;
-    if (pending_stream_acquisition->options.on_destroy) {
+    /* A hedged acquisition's on_destroy waits for both streams, see s_hedge_destroy */
+    if (pending_stream_acquisition->options.on_destroy && !pending_stream_acquisition->hedge) {
         pending_stream_acquisition->options.on_destroy(pending_stream_acquisition->options.user_data);
     }
     s_pending_stream_acquisition_destroy(pending_stream_acquisition);
 }
 
+/* Runs on the primary stream's connection once the hedge delay passed, making the duplicate if still undecided */
+static void s_hedge_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_h2_sm_hedge *hedge = arg;
+    struct aws_http2_stream_manager *stream_manager = hedge->stream_manager;
+    struct aws_h2_sm_pending_stream_acquisition *duplicate = NULL;
+    if (status != AWS_TASK_STATUS_RUN_READY) {
+        goto done;
+    }
+
+    aws_mutex_lock(&hedge->lock);
+    bool should_hedge = !hedge->is_decided && hedge->primary && hedge->primary->hedge_stream && !hedge->duplicate;
+    if (should_hedge) {
+        struct aws_http_make_request_options options = hedge->options;
+        options.request = hedge->request;
+        duplicate = s_new_pending_stream_acquisition(hedge->allocator, &options, NULL, NULL);
+        duplicate->hedge = hedge;
+        aws_ref_count_acquire(&hedge->ref_count);
+        duplicate->excluded_connection = hedge->primary->sm_connection;
+        hedge->duplicate = duplicate;
+    }
+    aws_mutex_unlock(&hedge->lock);
+    if (!duplicate) {
+        goto done;
+    }
+
+    struct aws_http2_stream_management_transaction work;
+    s_aws_stream_management_transaction_init(&work, stream_manager);
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(stream_manager);
+        if (stream_manager->synced_data.state == AWS_H2SMST_READY) {
+            s_sm_try_assign_connection_to_pending_stream_acquisition_synced(stream_manager, duplicate);
+        }
+        if (duplicate->sm_connection) {
+            aws_linked_list_push_back(&work.pending_make_requests, &duplicate->node);
+            s_sm_count_increase_synced(stream_manager, AWS_SMCT_PENDING_MAKE_REQUESTS, 1);
+        }
+        s_unlock_synced_data(stream_manager);
+    } /* END CRITICAL SECTION */
+    if (duplicate->sm_connection) {
+        STREAM_MANAGER_LOGF(
+            DEBUG,
+            stream_manager,
+            "hedging acquisition:%p to connection:%p",
+            (void *)duplicate,
+            (void *)duplicate->sm_connection->connection);
+    } else {
+        /* Hedging on the same connection wouldn't help, and waiting on a new one takes longer than the delay */
+        STREAM_MANAGER_LOG(DEBUG, stream_manager, "no other connection available to hedge on, skipping.");
+        s_pending_stream_acquisition_destroy(duplicate);
+    }
+    s_aws_http2_stream_manager_execute_transaction(&work);
+done:
+    aws_ref_count_release(&hedge->ref_count);
+    aws_ref_count_release(&stream_manager->internal_ref_count);
+}
+
+/* Only called from the connection's thread */
+static void s_schedule_hedge_task(
+    struct aws_h2_sm_hedge *hedge,
+    struct aws_h2_sm_connection *sm_connection,
+    uint64_t delay_ns) {
+    struct aws_channel *channel = aws_http_connection_get_channel(sm_connection->connection);
+    uint64_t now = 0;
+    aws_channel_current_clock_time(channel, &now);
+    /* Keep the hedge and the stream manager alive until the task runs */
+    aws_ref_count_acquire(&hedge->ref_count);
+    aws_ref_count_acquire(&hedge->stream_manager->internal_ref_count);
+    aws_channel_task_init(&hedge->hedge_task, s_hedge_task, hedge, "Stream manager hedge task");
+    aws_channel_schedule_task_future(channel, &hedge->hedge_task, now + delay_ns);
+}
+
 /* Scheduled to happen from connection's thread */
 static void s_make_request_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
     (void)task;
@@ -830,9 +1567,26 @@ static void s_make_request_task(struct aws_channel_task *task, void *arg, enum a
         (void *)pending_stream_acquisition,
         (void *)sm_connection->connection);
     bool is_shutting_down = false;
+    uint64_t now = 0;
+    aws_high_res_clock_get_ticks(&now);
+    uint64_t acquire_wait_ns =
+        now > pending_stream_acquisition->acquire_timestamp ? now - pending_stream_acquisition->acquire_timestamp : 0;
+    struct aws_h2_sm_hedge *hedge = pending_stream_acquisition->hedge;
+    /* The duplicate is the one kept off a connection */
+    bool is_duplicate = hedge && pending_stream_acquisition->excluded_connection;
+    uint64_t hedge_delay_ns = 0;
     { /* BEGIN CRITICAL SECTION */
         s_lock_synced_data(stream_manager);
         is_shutting_down = stream_manager->synced_data.state != AWS_H2SMST_READY;
+        if (hedge && !is_duplicate) {
+            hedge_delay_ns = hedge->after_p95_latency ? s_sm_recent_latency_p95_synced(stream_manager) : 0;
+            if (hedge_delay_ns == 0) {
+                hedge_delay_ns = hedge->delay_ns;
+            }
+        }
+        aws_http_latency_histogram_record(
+            &stream_manager->synced_data.acquire_wait,
+            aws_timestamp_convert(acquire_wait_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MICROS, NULL));
         s_sm_count_decrease_synced(stream_manager, AWS_SMCT_PENDING_MAKE_REQUESTS, 1);
         /* The stream has not open yet, but we increase the count here, if anything fails, the count will be decreased
          */
@@ -862,6 +1616,21 @@ static void s_make_request_task(struct aws_channel_task *task, void *arg, enum a
         error_code = AWS_ERROR_HTTP_STREAM_MANAGER_SHUTTING_DOWN;
         goto error;
     }
+    if (is_duplicate) {
+        bool is_decided = false;
+        aws_mutex_lock(&hedge->lock);
+        is_decided = hedge->is_decided;
+        aws_mutex_unlock(&hedge->lock);
+        if (is_decided) {
+            STREAM_MANAGER_LOGF(
+                TRACE,
+                stream_manager,
+                "hedge acquisition:%p dropped, the race was decided before it was made.",
+                (void *)pending_stream_acquisition);
+            error_code = AWS_ERROR_HTTP_STREAM_HAS_COMPLETED;
+            goto error;
+        }
+    }
     struct aws_http_make_request_options request_options = {
         .self_size = sizeof(request_options),
         .request = pending_stream_acquisition->request,
@@ -870,6 +1639,7 @@ static void s_make_request_task(struct aws_channel_task *task, void *arg, enum a
         .on_response_body = s_on_incoming_body,
         .on_complete = s_on_stream_complete,
         .on_destroy = s_on_stream_destroy,
+        .on_metrics = s_on_stream_metrics,
         .user_data = pending_stream_acquisition,
         .http2_use_manual_data_writes = pending_stream_acquisition->options.http2_use_manual_data_writes,
     };
@@ -888,6 +1658,9 @@ static void s_make_request_task(struct aws_channel_task *task, void *arg, enum a
             aws_error_str(error_code));
         goto error;
     }
+    /* The stream's queue time starts when the user asked for it, not when a connection was found */
+    stream->metrics.queue_start_timestamp_ns = (int64_t)pending_stream_acquisition->acquire_timestamp;
+    stream->metrics.retry_count = pending_stream_acquisition->retry_count;
     /* Since we're in the connection's thread, this should be safe, there won't be any other callbacks to the user */
     if (aws_http_stream_activate(stream)) {
         /* Activate failed, the on_completed callback will NOT be invoked from HTTP, but we already told user about
@@ -902,22 +1675,43 @@ static void s_make_request_task(struct aws_channel_task *task, void *arg, enum a
             aws_error_str(error_code));
         goto error;
     }
+    aws_high_res_clock_get_ticks(&pending_stream_acquisition->activate_timestamp);
+    if (pending_stream_acquisition->replaced_stream) {
+        /* The replay's stream stands in for it now */
+        aws_http_stream_release(pending_stream_acquisition->replaced_stream);
+        pending_stream_acquisition->replaced_stream = NULL;
+    }
+    if (hedge) {
+        s_hedge_set_stream(pending_stream_acquisition, stream);
+        if (!is_duplicate) {
+            aws_mutex_lock(&hedge->lock);
+            hedge->stream_made = true;
+            aws_mutex_unlock(&hedge->lock);
+            if (hedge_delay_ns) {
+                s_schedule_hedge_task(hedge, sm_connection, hedge_delay_ns);
+            }
+        }
+    }
+    AWS_HTTP_PROBE3(stream__manager__acquire, stream_manager, stream, 0);
     if (pending_stream_acquisition->callback) {
         pending_stream_acquisition->callback(stream, 0, pending_stream_acquisition->user_data);
     }
+    s_sm_connection_sample_load(sm_connection);
+    s_sm_connection_check_replacement(sm_connection, aws_http_stream_get_id(stream));
 
     /* Happy case, the complete callback will be invoked, and we clean things up at the callback, but we can release the
-     * request now */
-    aws_http_message_release(pending_stream_acquisition->request);
-    pending_stream_acquisition->request = NULL;
+     * request now, unless it may be replayed */
+    if (!s_sm_may_replay(stream_manager, pending_stream_acquisition)) {
+        aws_http_message_release(pending_stream_acquisition->request);
+        pending_stream_acquisition->request = NULL;
+    }
     return;
 error:
-    if (pending_stream_acquisition->callback) {
-        pending_stream_acquisition->callback(NULL, error_code, pending_stream_acquisition->user_data);
-    }
+    AWS_HTTP_PROBE3(stream__manager__acquire, stream_manager, NULL, error_code);
+    s_pending_stream_acquisition_notify_failure(pending_stream_acquisition, error_code);
     s_pending_stream_acquisition_destroy(pending_stream_acquisition);
     /* task should happen after destroy, as the task can trigger the whole stream manager to be destroyed */
-    s_sm_connection_on_scheduled_stream_finishes(sm_connection, stream_manager);
+    s_sm_connection_on_scheduled_stream_finishes(sm_connection, 0 /*latency_ns*/, false);
 }
 
 /* NEVER invoke with lock held */
@@ -995,8 +1789,8 @@ void s_stream_manager_destroy_final(struct aws_http2_stream_manager *stream_mana
     AWS_FATAL_ASSERT(stream_manager->connection_manager == NULL);
     AWS_FATAL_ASSERT(aws_linked_list_empty(&stream_manager->synced_data.pending_stream_acquisitions));
     aws_mutex_clean_up(&stream_manager->synced_data.lock);
-    aws_random_access_set_clean_up(&stream_manager->synced_data.ideal_available_set);
-    aws_random_access_set_clean_up(&stream_manager->synced_data.nonideal_available_set);
+    aws_intrusive_random_access_set_clean_up(&stream_manager->synced_data.ideal_available_set);
+    aws_intrusive_random_access_set_clean_up(&stream_manager->synced_data.nonideal_available_set);
     aws_client_bootstrap_release(stream_manager->bootstrap);
 
     if (stream_manager->shutdown_complete_callback) {
@@ -1019,8 +1813,8 @@ void s_stream_manager_on_cm_shutdown_complete(void *user_data) {
 static void s_stream_manager_start_destroy(struct aws_http2_stream_manager *stream_manager) {
     STREAM_MANAGER_LOG(TRACE, stream_manager, "Stream Manager reaches the condition to destroy, start to destroy");
     /* If there is no outstanding streams, the connections set should be empty. */
-    AWS_ASSERT(aws_random_access_set_get_size(&stream_manager->synced_data.ideal_available_set) == 0);
-    AWS_ASSERT(aws_random_access_set_get_size(&stream_manager->synced_data.nonideal_available_set) == 0);
+    AWS_ASSERT(aws_intrusive_random_access_set_get_size(&stream_manager->synced_data.ideal_available_set) == 0);
+    AWS_ASSERT(aws_intrusive_random_access_set_get_size(&stream_manager->synced_data.nonideal_available_set) == 0);
     AWS_ASSERT(stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_CONNECTIONS_ACQUIRING] == 0);
     AWS_ASSERT(stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_OPEN_STREAM] == 0);
     AWS_ASSERT(stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_MAKE_REQUESTS] == 0);
@@ -1068,26 +1862,17 @@ struct aws_http2_stream_manager *aws_http2_stream_manager_new(
         aws_mem_calloc(allocator, 1, sizeof(struct aws_http2_stream_manager));
     stream_manager->allocator = allocator;
     aws_linked_list_init(&stream_manager->synced_data.pending_stream_acquisitions);
+    aws_linked_list_init(&stream_manager->synced_data.connections_awaiting_successor);
 
     if (aws_mutex_init(&stream_manager->synced_data.lock)) {
         goto on_error;
     }
-    if (aws_random_access_set_init(
-            &stream_manager->synced_data.ideal_available_set,
-            allocator,
-            aws_hash_ptr,
-            aws_ptr_eq,
-            NULL /* destroy function */,
-            2)) {
+    if (aws_intrusive_random_access_set_init(
+            &stream_manager->synced_data.ideal_available_set, allocator, NULL /* less_fn */, 2)) {
         goto on_error;
     }
-    if (aws_random_access_set_init(
-            &stream_manager->synced_data.nonideal_available_set,
-            allocator,
-            aws_hash_ptr,
-            aws_ptr_eq,
-            NULL /* destroy function */,
-            2)) {
+    if (aws_intrusive_random_access_set_init(
+            &stream_manager->synced_data.nonideal_available_set, allocator, NULL /* less_fn */, 2)) {
         goto on_error;
     }
     aws_ref_count_init(
@@ -1131,13 +1916,17 @@ struct aws_http2_stream_manager *aws_http2_stream_manager_new(
         .monitoring_options = options->monitoring_options,
         .proxy_options = options->proxy_options,
         .proxy_ev_settings = options->proxy_ev_settings,
-        .max_connections = options->max_connections,
+        /* Connections being replaced drain on top of the max */
+        .max_connections = (options->connection_replacement_stream_id || options->connection_replacement_age_ms)
+                               ? aws_mul_size_saturating(options->max_connections, 2)
+                               : options->max_connections,
         .shutdown_complete_user_data = stream_manager,
         .shutdown_complete_callback = s_stream_manager_on_cm_shutdown_complete,
         .initial_settings_array = options->initial_settings_array,
         .num_initial_settings = options->num_initial_settings,
         .max_closed_streams = options->max_closed_streams,
         .http2_conn_manual_window_management = options->conn_manual_window_management,
+        .memory_budget = options->memory_budget,
     };
     /* aws_http_connection_manager_new needs to be the last thing that can fail */
     stream_manager->connection_manager = aws_http_connection_manager_new(allocator, &cm_options);
@@ -1151,10 +1940,23 @@ struct aws_http2_stream_manager *aws_http2_stream_manager_new(
     stream_manager->ideal_concurrent_streams_per_connection = options->ideal_concurrent_streams_per_connection
                                                                   ? options->ideal_concurrent_streams_per_connection
                                                                   : UINT32_MAX;
+    stream_manager->enable_adaptive_concurrency = options->enable_adaptive_concurrency;
+    stream_manager->synced_data.adaptive_ideal_streams =
+        options->ideal_concurrent_streams_per_connection
+            ? (uint32_t)aws_min_size(options->ideal_concurrent_streams_per_connection, UINT32_MAX)
+            : s_adaptive_default_ideal_streams;
     stream_manager->max_concurrent_streams_per_connection =
         options->max_concurrent_streams_per_connection ? options->max_concurrent_streams_per_connection : UINT32_MAX;
     stream_manager->max_connections = options->max_connections;
     stream_manager->close_connection_on_server_error = options->close_connection_on_server_error;
+    stream_manager->selection_policy = options->selection_policy;
+    stream_manager->connection_replacement_stream_id = options->connection_replacement_stream_id;
+    stream_manager->connection_replacement_age_ns = aws_timestamp_convert(
+        options->connection_replacement_age_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    stream_manager->max_unprocessed_stream_retries = options->max_unprocessed_stream_retries;
+    if (options->monitoring_options) {
+        stream_manager->degraded_health_score = options->monitoring_options->degraded_health_score;
+    }
 
     return stream_manager;
 on_error:
@@ -1189,6 +1991,10 @@ void aws_http2_stream_manager_acquire_stream(
         acquire_stream_option->options,
         acquire_stream_option->callback,
         acquire_stream_option->user_data);
+    pending_stream_acquisition->hedge = s_hedge_new(stream_manager, acquire_stream_option);
+    if (pending_stream_acquisition->hedge) {
+        pending_stream_acquisition->hedge->primary = pending_stream_acquisition;
+    }
     STREAM_MANAGER_LOGF(
         TRACE, stream_manager, "Stream Manager creates acquisition:%p for user", (void *)pending_stream_acquisition);
     s_aws_stream_management_transaction_init(&work, stream_manager);
@@ -1205,12 +2011,14 @@ void aws_http2_stream_manager_acquire_stream(
     s_aws_http2_stream_manager_execute_transaction(&work);
 }
 
-static size_t s_get_available_streams_num_from_connection_set(const struct aws_random_access_set *set) {
+static size_t s_get_available_streams_num_from_connection_set(const struct aws_intrusive_random_access_set *set) {
     size_t all_available_streams_num = 0;
-    size_t ideal_connection_num = aws_random_access_set_get_size(set);
+    size_t ideal_connection_num = aws_intrusive_random_access_set_get_size(set);
     for (size_t i = 0; i < ideal_connection_num; i++) {
-        struct aws_h2_sm_connection *sm_connection = NULL;
-        AWS_FATAL_ASSERT(aws_random_access_set_random_get_ptr_index(set, (void **)&sm_connection, i) == AWS_OP_SUCCESS);
+        struct aws_intrusive_random_access_set_node *node = NULL;
+        AWS_FATAL_ASSERT(aws_intrusive_random_access_set_get_index(set, &node, i) == AWS_OP_SUCCESS);
+        struct aws_h2_sm_connection *sm_connection =
+            AWS_CONTAINER_OF(node, struct aws_h2_sm_connection, available_node);
         uint32_t available_streams = sm_connection->max_concurrent_streams - sm_connection->num_streams_assigned;
         all_available_streams_num += (size_t)available_streams;
     }
@@ -1222,6 +2030,8 @@ void aws_http2_stream_manager_fetch_metrics(
     struct aws_http_manager_metrics *out_metrics) {
     AWS_PRECONDITION(stream_manager);
     AWS_PRECONDITION(out_metrics);
+    /* The connection histograms and failures come from the underlying connection manager, the rest is ours */
+    aws_http_connection_manager_fetch_metrics(stream_manager->connection_manager, out_metrics);
     { /* BEGIN CRITICAL SECTION */
         s_lock_synced_data((struct aws_http2_stream_manager *)(void *)stream_manager);
         size_t all_available_streams_num = 0;
@@ -1233,6 +2043,7 @@ void aws_http2_stream_manager_fetch_metrics(
             stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_PENDING_ACQUISITION];
         out_metrics->available_concurrency = all_available_streams_num;
         out_metrics->leased_concurrency = stream_manager->synced_data.internal_refcount_stats[AWS_SMCT_OPEN_STREAM];
+        out_metrics->acquire_wait = stream_manager->synced_data.acquire_wait;
         s_unlock_synced_data((struct aws_http2_stream_manager *)(void *)stream_manager);
     } /* END CRITICAL SECTION */
 }
@@ -0,0 +1,155 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/memory_budget_impl.h>
+
+#include <aws/common/logging.h>
+
+static void s_memory_budget_lock(const struct aws_http_memory_budget *budget) {
+    int err = aws_mutex_lock((struct aws_mutex *)(void *)&budget->synced_data.lock);
+    AWS_ASSERT(!err);
+    (void)err;
+}
+
+static void s_memory_budget_unlock(const struct aws_http_memory_budget *budget) {
+    int err = aws_mutex_unlock((struct aws_mutex *)(void *)&budget->synced_data.lock);
+    AWS_ASSERT(!err);
+    (void)err;
+}
+
+static void s_memory_budget_destroy(void *user_data) {
+    struct aws_http_memory_budget *budget = user_data;
+
+    AWS_ASSERT(budget->synced_data.used == 0 && "Everyone drawing from the budget holds a reference");
+    AWS_ASSERT(aws_linked_list_empty(&budget->synced_data.waiters));
+    aws_mutex_clean_up(&budget->synced_data.lock);
+    aws_mem_release(budget->allocator, budget);
+}
+
+struct aws_http_memory_budget *aws_http_memory_budget_new(struct aws_allocator *allocator, size_t limit) {
+    if (limit == 0) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_GENERAL, "static: Memory budget limit must be non-zero.");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    struct aws_http_memory_budget *budget = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_memory_budget));
+    budget->allocator = allocator;
+    budget->limit = limit;
+    aws_ref_count_init(&budget->ref_count, budget, s_memory_budget_destroy);
+    if (aws_mutex_init(&budget->synced_data.lock)) {
+        aws_mem_release(allocator, budget);
+        return NULL;
+    }
+    aws_linked_list_init(&budget->synced_data.waiters);
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_GENERAL, "id=%p: Memory budget created with a limit of %zu bytes.", (void *)budget, limit);
+    return budget;
+}
+
+struct aws_http_memory_budget *aws_http_memory_budget_acquire(struct aws_http_memory_budget *budget) {
+    if (budget) {
+        aws_ref_count_acquire(&budget->ref_count);
+    }
+    return budget;
+}
+
+void aws_http_memory_budget_release(struct aws_http_memory_budget *budget) {
+    if (budget) {
+        aws_ref_count_release(&budget->ref_count);
+    }
+}
+
+size_t aws_http_memory_budget_get_limit(const struct aws_http_memory_budget *budget) {
+    return budget->limit;
+}
+
+size_t aws_http_memory_budget_get_used(const struct aws_http_memory_budget *budget) {
+    s_memory_budget_lock(budget);
+    size_t used = budget->synced_data.used;
+    s_memory_budget_unlock(budget);
+    return used;
+}
+
+bool aws_http_memory_budget_is_exhausted(const struct aws_http_memory_budget *budget) {
+    return aws_http_memory_budget_get_used(budget) >= budget->limit;
+}
+
+void aws_http_memory_budget_waiter_init(
+    struct aws_http_memory_budget_waiter *waiter,
+    aws_http_memory_budget_on_available_fn *on_available,
+    void *user_data) {
+
+    AWS_ZERO_STRUCT(*waiter);
+    waiter->on_available = on_available;
+    waiter->user_data = user_data;
+}
+
+size_t aws_http_memory_budget_draw(
+    struct aws_http_memory_budget *budget,
+    size_t size,
+    struct aws_http_memory_budget_waiter *optional_waiter) {
+
+    s_memory_budget_lock(budget);
+    /* BEGIN CRITICAL SECTION */
+    size_t drawn = aws_min_size(size, aws_sub_size_saturating(budget->limit, budget->synced_data.used));
+    budget->synced_data.used += drawn;
+
+    if (drawn < size && optional_waiter) {
+        AWS_ASSERT(optional_waiter->node.next == NULL && "Waiter is already waiting");
+        aws_linked_list_push_back(&budget->synced_data.waiters, &optional_waiter->node);
+    }
+    /* END CRITICAL SECTION */
+    s_memory_budget_unlock(budget);
+
+    if (drawn < size) {
+        AWS_LOGF_TRACE(
+            AWS_LS_HTTP_GENERAL,
+            "id=%p: Memory budget exhausted, drew %zu of %zu bytes requested.",
+            (void *)budget,
+            drawn,
+            size);
+    }
+    return drawn;
+}
+
+void aws_http_memory_budget_give_back(struct aws_http_memory_budget *budget, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    s_memory_budget_lock(budget);
+    /* BEGIN CRITICAL SECTION */
+    AWS_ASSERT(budget->synced_data.used >= size && "Giving back more than was drawn");
+    budget->synced_data.used = aws_sub_size_saturating(budget->synced_data.used, size);
+
+    /* Everyone gets a chance to draw. Whoever's too late just waits again */
+    while (!aws_linked_list_empty(&budget->synced_data.waiters)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&budget->synced_data.waiters);
+        aws_linked_list_node_reset(node);
+        struct aws_http_memory_budget_waiter *waiter =
+            AWS_CONTAINER_OF(node, struct aws_http_memory_budget_waiter, node);
+        waiter->on_available(waiter->user_data);
+    }
+    /* END CRITICAL SECTION */
+    s_memory_budget_unlock(budget);
+}
+
+bool aws_http_memory_budget_stop_waiting(
+    struct aws_http_memory_budget *budget,
+    struct aws_http_memory_budget_waiter *waiter) {
+
+    s_memory_budget_lock(budget);
+    /* BEGIN CRITICAL SECTION */
+    bool was_waiting = waiter->node.next != NULL;
+    if (was_waiting) {
+        aws_linked_list_remove(&waiter->node);
+        aws_linked_list_node_reset(&waiter->node);
+    }
+    /* END CRITICAL SECTION */
+    s_memory_budget_unlock(budget);
+    return was_waiting;
+}
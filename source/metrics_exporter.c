@@ -0,0 +1,667 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/metrics_exporter.h>
+
+#include <aws/http/connection_manager.h>
+#include <aws/http/http2_stream_manager.h>
+#include <aws/http/statistics.h>
+
+#include <aws/common/atomics.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/mutex.h>
+#include <aws/common/ref_count.h>
+#include <aws/common/string.h>
+#include <aws/common/thread.h>
+#include <aws/io/statistics.h>
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4204) /* non-constant aggregate initializer */
+#endif
+
+/* Threads are spread over this many shards, so event loops rarely write the same cache lines */
+#define AWS_HTTP_METRICS_EXPORTER_SHARD_COUNT 16
+
+/* Every fourth histogram bucket ends on a power of two, those bounds are the rendered buckets */
+#define AWS_HTTP_METRICS_EXPORTER_BUCKET_STRIDE 4
+
+enum aws_http_metrics_exporter_counter {
+    AWS_HTTP_COUNTER_H1_SAMPLES,
+    AWS_HTTP_COUNTER_H1_BYTES_READ,
+    AWS_HTTP_COUNTER_H1_BYTES_WRITTEN,
+    AWS_HTTP_COUNTER_H1_PENDING_INCOMING_MS,
+    AWS_HTTP_COUNTER_H1_PENDING_OUTGOING_MS,
+    AWS_HTTP_COUNTER_H2_SAMPLES,
+    AWS_HTTP_COUNTER_H2_BYTES_READ,
+    AWS_HTTP_COUNTER_H2_BYTES_WRITTEN,
+    AWS_HTTP_COUNTER_H2_PENDING_INCOMING_MS,
+    AWS_HTTP_COUNTER_H2_PENDING_OUTGOING_MS,
+    AWS_HTTP_COUNTER_H2_MESSAGES_WRITTEN,
+    AWS_HTTP_COUNTER_H2_MESSAGE_CAPACITY_WRITTEN,
+    AWS_HTTP_COUNTER_H2_ZERO_COPY_BYTES_WRITTEN,
+    AWS_HTTP_COUNTER_COUNT,
+};
+
+/**
+ * Running totals written by the threads that hash to it. Only ever added to, with relaxed atomics.
+ * Counters are size_t, so on 32-bit platforms they wrap, which scrapers read as a counter reset.
+ */
+struct aws_http_metrics_exporter_shard {
+    struct aws_atomic_var counters[AWS_HTTP_COUNTER_COUNT];
+
+    /* HTTP/2 smoothed round trip times, one per sample of a connection that has measured it */
+    struct aws_atomic_var rtt_count;
+    struct aws_atomic_var rtt_sum_us;
+    struct aws_atomic_var rtt_buckets[AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT];
+
+    /* Keep neighboring shards off each other's cache lines */
+    uint8_t padding[64];
+};
+
+struct aws_http_metrics_exporter_manager_entry {
+    const void *manager;
+    bool is_stream_manager;
+    struct aws_string *name;
+};
+
+struct aws_http_metrics_exporter {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+
+    struct aws_http_metrics_exporter_shard shards[AWS_HTTP_METRICS_EXPORTER_SHARD_COUNT];
+
+    /* Only taken to add, remove, and render managers. Never on a connection's thread */
+    struct aws_mutex lock;
+    /* aws_http_metrics_exporter_manager_entry */
+    struct aws_array_list managers;
+};
+
+static void s_exporter_destroy(void *user_data) {
+    struct aws_http_metrics_exporter *exporter = user_data;
+
+    for (size_t i = 0; i < aws_array_list_length(&exporter->managers); ++i) {
+        struct aws_http_metrics_exporter_manager_entry *entry = NULL;
+        aws_array_list_get_at_ptr(&exporter->managers, (void **)&entry, i);
+        aws_string_destroy(entry->name);
+    }
+    aws_array_list_clean_up(&exporter->managers);
+    aws_mutex_clean_up(&exporter->lock);
+    aws_mem_release(exporter->allocator, exporter);
+}
+
+struct aws_http_metrics_exporter *aws_http_metrics_exporter_new(struct aws_allocator *allocator) {
+    struct aws_http_metrics_exporter *exporter = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_metrics_exporter));
+    exporter->allocator = allocator;
+
+    for (size_t i = 0; i < AWS_HTTP_METRICS_EXPORTER_SHARD_COUNT; ++i) {
+        struct aws_http_metrics_exporter_shard *shard = &exporter->shards[i];
+        for (size_t c = 0; c < AWS_HTTP_COUNTER_COUNT; ++c) {
+            aws_atomic_init_int(&shard->counters[c], 0);
+        }
+        aws_atomic_init_int(&shard->rtt_count, 0);
+        aws_atomic_init_int(&shard->rtt_sum_us, 0);
+        for (size_t b = 0; b < AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT; ++b) {
+            aws_atomic_init_int(&shard->rtt_buckets[b], 0);
+        }
+    }
+
+    if (aws_mutex_init(&exporter->lock)) {
+        goto error;
+    }
+
+    if (aws_array_list_init_dynamic(
+            &exporter->managers, allocator, 4, sizeof(struct aws_http_metrics_exporter_manager_entry))) {
+        aws_mutex_clean_up(&exporter->lock);
+        goto error;
+    }
+
+    aws_ref_count_init(&exporter->ref_count, exporter, s_exporter_destroy);
+    return exporter;
+
+error:
+    aws_mem_release(allocator, exporter);
+    return NULL;
+}
+
+struct aws_http_metrics_exporter *aws_http_metrics_exporter_acquire(struct aws_http_metrics_exporter *exporter) {
+    if (exporter) {
+        aws_ref_count_acquire(&exporter->ref_count);
+    }
+    return exporter;
+}
+
+void aws_http_metrics_exporter_release(struct aws_http_metrics_exporter *exporter) {
+    if (exporter) {
+        aws_ref_count_release(&exporter->ref_count);
+    }
+}
+
+static struct aws_http_metrics_exporter_shard *s_get_current_thread_shard(struct aws_http_metrics_exporter *exporter) {
+    aws_thread_id_t thread_id = aws_thread_current_thread_id();
+    struct aws_byte_cursor thread_id_cursor = aws_byte_cursor_from_array(&thread_id, sizeof(thread_id));
+    uint64_t hash = aws_hash_byte_cursor_ptr(&thread_id_cursor);
+    return &exporter->shards[hash % AWS_HTTP_METRICS_EXPORTER_SHARD_COUNT];
+}
+
+static void s_add(struct aws_atomic_var *var, uint64_t value) {
+    if (value > 0) {
+        aws_atomic_fetch_add_explicit(var, (size_t)value, aws_memory_order_relaxed);
+    }
+}
+
+static void s_add_counter(
+    struct aws_http_metrics_exporter_shard *shard,
+    enum aws_http_metrics_exporter_counter counter,
+    uint64_t value) {
+
+    s_add(&shard->counters[counter], value);
+}
+
+void aws_http_metrics_exporter_observe_statistics(
+    size_t connection_nonce,
+    const struct aws_array_list *stats_list,
+    void *exporter) {
+
+    (void)connection_nonce;
+    struct aws_http_metrics_exporter_shard *shard = s_get_current_thread_shard(exporter);
+
+    for (size_t i = 0; i < aws_array_list_length(stats_list); ++i) {
+        struct aws_crt_statistics_base *stats_base = NULL;
+        if (aws_array_list_get_at(stats_list, &stats_base, i)) {
+            continue;
+        }
+
+        switch (stats_base->category) {
+            case AWSCRT_STAT_CAT_HTTP1_CHANNEL: {
+                struct aws_crt_statistics_http1_channel *h1 = (struct aws_crt_statistics_http1_channel *)stats_base;
+                s_add_counter(shard, AWS_HTTP_COUNTER_H1_SAMPLES, 1);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H1_BYTES_READ, h1->bytes_read);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H1_BYTES_WRITTEN, h1->bytes_written);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H1_PENDING_INCOMING_MS, h1->pending_incoming_stream_ms);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H1_PENDING_OUTGOING_MS, h1->pending_outgoing_stream_ms);
+                break;
+            }
+
+            case AWSCRT_STAT_CAT_HTTP2_CHANNEL: {
+                struct aws_crt_statistics_http2_channel *h2 = (struct aws_crt_statistics_http2_channel *)stats_base;
+                s_add_counter(shard, AWS_HTTP_COUNTER_H2_SAMPLES, 1);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H2_BYTES_READ, h2->bytes_read);
+                s_add_counter(
+                    shard, AWS_HTTP_COUNTER_H2_BYTES_WRITTEN, h2->bytes_written + h2->zero_copy_bytes_written);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H2_PENDING_INCOMING_MS, h2->pending_incoming_stream_ms);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H2_PENDING_OUTGOING_MS, h2->pending_outgoing_stream_ms);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H2_MESSAGES_WRITTEN, h2->messages_written);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H2_MESSAGE_CAPACITY_WRITTEN, h2->message_capacity_written);
+                s_add_counter(shard, AWS_HTTP_COUNTER_H2_ZERO_COPY_BYTES_WRITTEN, h2->zero_copy_bytes_written);
+
+                /* RTT carries over between samples, it's 0 until the first PING ACK */
+                if (h2->smoothed_rtt_ns > 0) {
+                    uint64_t rtt_us = h2->smoothed_rtt_ns / 1000;
+                    s_add(&shard->rtt_buckets[aws_http_latency_histogram_bucket_index(rtt_us)], 1);
+                    s_add(&shard->rtt_count, 1);
+                    s_add(&shard->rtt_sum_us, rtt_us);
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+static void s_handler_process_statistics(
+    struct aws_crt_statistics_handler *handler,
+    struct aws_crt_statistics_sample_interval *interval,
+    struct aws_array_list *stats_list,
+    void *context) {
+
+    (void)interval;
+    (void)context;
+    aws_http_metrics_exporter_observe_statistics(0, stats_list, handler->impl);
+}
+
+static void s_handler_destroy(struct aws_crt_statistics_handler *handler) {
+    aws_http_metrics_exporter_release(handler->impl);
+    aws_mem_release(handler->allocator, handler);
+}
+
+static uint64_t s_handler_get_report_interval_ms(struct aws_crt_statistics_handler *handler) {
+    (void)handler;
+    return 1000;
+}
+
+static struct aws_crt_statistics_handler_vtable s_metrics_exporter_handler_vtable = {
+    .process_statistics = s_handler_process_statistics,
+    .destroy = s_handler_destroy,
+    .get_report_interval_ms = s_handler_get_report_interval_ms,
+};
+
+struct aws_crt_statistics_handler *aws_http_metrics_exporter_new_statistics_handler(
+    struct aws_http_metrics_exporter *exporter) {
+
+    struct aws_crt_statistics_handler *handler =
+        aws_mem_calloc(exporter->allocator, 1, sizeof(struct aws_crt_statistics_handler));
+    handler->vtable = &s_metrics_exporter_handler_vtable;
+    handler->allocator = exporter->allocator;
+    handler->impl = aws_http_metrics_exporter_acquire(exporter);
+    return handler;
+}
+
+static int s_add_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const void *manager,
+    bool is_stream_manager,
+    struct aws_byte_cursor name) {
+
+    struct aws_http_metrics_exporter_manager_entry entry = {
+        .manager = manager,
+        .is_stream_manager = is_stream_manager,
+        .name = aws_string_new_from_cursor(exporter->allocator, &name),
+    };
+    if (!entry.name) {
+        return AWS_OP_ERR;
+    }
+
+    aws_mutex_lock(&exporter->lock);
+    int result = aws_array_list_push_back(&exporter->managers, &entry);
+    aws_mutex_unlock(&exporter->lock);
+
+    if (result) {
+        aws_string_destroy(entry.name);
+    }
+    return result;
+}
+
+static void s_remove_manager(struct aws_http_metrics_exporter *exporter, const void *manager) {
+    aws_mutex_lock(&exporter->lock);
+    size_t count = aws_array_list_length(&exporter->managers);
+    for (size_t i = 0; i < count; ++i) {
+        struct aws_http_metrics_exporter_manager_entry *entry = NULL;
+        aws_array_list_get_at_ptr(&exporter->managers, (void **)&entry, i);
+        if (entry->manager == manager) {
+            aws_string_destroy(entry->name);
+            aws_array_list_swap(&exporter->managers, i, count - 1);
+            aws_array_list_pop_back(&exporter->managers);
+            break;
+        }
+    }
+    aws_mutex_unlock(&exporter->lock);
+}
+
+int aws_http_metrics_exporter_add_connection_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const struct aws_http_connection_manager *manager,
+    struct aws_byte_cursor name) {
+
+    return s_add_manager(exporter, manager, false /*is_stream_manager*/, name);
+}
+
+void aws_http_metrics_exporter_remove_connection_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const struct aws_http_connection_manager *manager) {
+
+    s_remove_manager(exporter, manager);
+}
+
+int aws_http_metrics_exporter_add_stream_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const struct aws_http2_stream_manager *manager,
+    struct aws_byte_cursor name) {
+
+    return s_add_manager(exporter, manager, true /*is_stream_manager*/, name);
+}
+
+void aws_http_metrics_exporter_remove_stream_manager(
+    struct aws_http_metrics_exporter *exporter,
+    const struct aws_http2_stream_manager *manager) {
+
+    s_remove_manager(exporter, manager);
+}
+
+/*
+ * Rendering
+ */
+
+static int s_appendf(struct aws_byte_buf *output, const char *format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    AWS_FATAL_ASSERT(len >= 0 && (size_t)len < sizeof(text));
+    struct aws_byte_cursor cursor = aws_byte_cursor_from_array(text, (size_t)len);
+    return aws_byte_buf_append_dynamic(output, &cursor);
+}
+
+static int s_append_family(struct aws_byte_buf *output, const char *name, const char *type, const char *help) {
+    return s_appendf(output, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+/* Label values escape backslash, double-quote, and line feed */
+static int s_append_label_value(struct aws_byte_buf *output, const struct aws_string *value) {
+    struct aws_byte_cursor remaining = aws_byte_cursor_from_string(value);
+    while (remaining.len > 0) {
+        uint8_t c = *remaining.ptr;
+        aws_byte_cursor_advance(&remaining, 1);
+
+        struct aws_byte_cursor piece = aws_byte_cursor_from_array(&c, 1);
+        if (c == '\\') {
+            piece = aws_byte_cursor_from_c_str("\\\\");
+        } else if (c == '"') {
+            piece = aws_byte_cursor_from_c_str("\\\"");
+        } else if (c == '\n') {
+            piece = aws_byte_cursor_from_c_str("\\n");
+        }
+        if (aws_byte_buf_append_dynamic(output, &piece)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Writes `<name><suffix>`, then `{` and the manager's labels if there's a manager.
+ * The caller writes any more labels, and closes the brace if it was opened.
+ */
+static int s_append_sample_start(
+    struct aws_byte_buf *output,
+    const char *name,
+    const char *suffix,
+    const struct aws_http_metrics_exporter_manager_entry *entry) {
+
+    if (s_appendf(output, "%s%s", name, suffix)) {
+        return AWS_OP_ERR;
+    }
+    if (!entry) {
+        return AWS_OP_SUCCESS;
+    }
+    if (s_appendf(output, "{manager=\"") || s_append_label_value(output, entry->name)) {
+        return AWS_OP_ERR;
+    }
+    return s_appendf(output, "\",kind=\"%s\"", entry->is_stream_manager ? "stream" : "connection");
+}
+
+/* Buckets are cumulative, and end at each power of two microseconds */
+static int s_append_histogram_samples(
+    struct aws_byte_buf *output,
+    const char *name,
+    const struct aws_http_metrics_exporter_manager_entry *entry,
+    const struct aws_http_latency_histogram *histogram) {
+
+    const char *le_prefix = entry ? "," : "{";
+    const char *closing = entry ? "}" : "";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT - 1; ++i) {
+        cumulative += histogram->buckets[i];
+        if (i % AWS_HTTP_METRICS_EXPORTER_BUCKET_STRIDE != AWS_HTTP_METRICS_EXPORTER_BUCKET_STRIDE - 1) {
+            continue;
+        }
+
+        /* Durations are whole microseconds, so everything in the bucket is below its upper bound + 1 */
+        double le_sec = (double)(aws_http_latency_histogram_bucket_upper_bound(i) + 1) / 1000000.0;
+        if (s_append_sample_start(output, name, "_bucket", entry) ||
+            s_appendf(output, "%sle=\"%.6f\"} %" PRIu64 "\n", le_prefix, le_sec, cumulative)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    if (s_append_sample_start(output, name, "_bucket", entry) ||
+        s_appendf(output, "%sle=\"+Inf\"} %" PRIu64 "\n", le_prefix, histogram->count)) {
+        return AWS_OP_ERR;
+    }
+    if (s_append_sample_start(output, name, "_count", entry) ||
+        s_appendf(output, "%s %" PRIu64 "\n", closing, histogram->count)) {
+        return AWS_OP_ERR;
+    }
+    if (s_append_sample_start(output, name, "_sum", entry) ||
+        s_appendf(output, "%s %.6f\n", closing, (double)histogram->sum_us / 1000000.0)) {
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+struct aws_http_metrics_exporter_counter_family {
+    const char *name;
+    const char *help;
+    /* Counters in milliseconds are rendered in seconds */
+    bool is_ms;
+    /* Indexed by protocol, AWS_HTTP_COUNTER_COUNT if the protocol doesn't have it */
+    enum aws_http_metrics_exporter_counter counters[2];
+};
+
+static const char *s_protocol_labels[2] = {"http1", "http2"};
+
+static struct aws_http_metrics_exporter_counter_family s_counter_families[] = {
+    {
+        .name = "aws_http_connection_samples",
+        .help = "Statistics samples reported by connections, one per connection per second.",
+        .counters = {AWS_HTTP_COUNTER_H1_SAMPLES, AWS_HTTP_COUNTER_H2_SAMPLES},
+    },
+    {
+        .name = "aws_http_connection_read_bytes",
+        .help = "Bytes read by connections.",
+        .counters = {AWS_HTTP_COUNTER_H1_BYTES_READ, AWS_HTTP_COUNTER_H2_BYTES_READ},
+    },
+    {
+        .name = "aws_http_connection_written_bytes",
+        .help = "Bytes written by connections.",
+        .counters = {AWS_HTTP_COUNTER_H1_BYTES_WRITTEN, AWS_HTTP_COUNTER_H2_BYTES_WRITTEN},
+    },
+    {
+        .name = "aws_http_connection_pending_incoming_seconds",
+        .help = "Time connections spent waiting on incoming stream data.",
+        .is_ms = true,
+        .counters = {AWS_HTTP_COUNTER_H1_PENDING_INCOMING_MS, AWS_HTTP_COUNTER_H2_PENDING_INCOMING_MS},
+    },
+    {
+        .name = "aws_http_connection_pending_outgoing_seconds",
+        .help = "Time connections spent waiting on outgoing stream data.",
+        .is_ms = true,
+        .counters = {AWS_HTTP_COUNTER_H1_PENDING_OUTGOING_MS, AWS_HTTP_COUNTER_H2_PENDING_OUTGOING_MS},
+    },
+    {
+        .name = "aws_http_connection_messages_written",
+        .help = "IO messages of encoded frames written by connections.",
+        .counters = {AWS_HTTP_COUNTER_COUNT, AWS_HTTP_COUNTER_H2_MESSAGES_WRITTEN},
+    },
+    {
+        .name = "aws_http_connection_message_capacity_written_bytes",
+        .help = "Capacity of the IO messages written by connections.",
+        .counters = {AWS_HTTP_COUNTER_COUNT, AWS_HTTP_COUNTER_H2_MESSAGE_CAPACITY_WRITTEN},
+    },
+    {
+        .name = "aws_http_connection_zero_copy_written_bytes",
+        .help = "DATA payload bytes written straight from the user's buffers.",
+        .counters = {AWS_HTTP_COUNTER_COUNT, AWS_HTTP_COUNTER_H2_ZERO_COPY_BYTES_WRITTEN},
+    },
+};
+
+static int s_render_connection_metrics(struct aws_http_metrics_exporter *exporter, struct aws_byte_buf *output) {
+    /* Sum the shards. Each counter is read atomically, though not all at the same instant */
+    uint64_t counters[AWS_HTTP_COUNTER_COUNT] = {0};
+    struct aws_http_latency_histogram rtt;
+    AWS_ZERO_STRUCT(rtt);
+
+    for (size_t s = 0; s < AWS_HTTP_METRICS_EXPORTER_SHARD_COUNT; ++s) {
+        struct aws_http_metrics_exporter_shard *shard = &exporter->shards[s];
+        for (size_t c = 0; c < AWS_HTTP_COUNTER_COUNT; ++c) {
+            counters[c] += aws_atomic_load_int_explicit(&shard->counters[c], aws_memory_order_relaxed);
+        }
+        for (size_t b = 0; b < AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT; ++b) {
+            rtt.buckets[b] += aws_atomic_load_int_explicit(&shard->rtt_buckets[b], aws_memory_order_relaxed);
+        }
+        rtt.count += aws_atomic_load_int_explicit(&shard->rtt_count, aws_memory_order_relaxed);
+        rtt.sum_us += aws_atomic_load_int_explicit(&shard->rtt_sum_us, aws_memory_order_relaxed);
+    }
+
+    for (size_t f = 0; f < AWS_ARRAY_SIZE(s_counter_families); ++f) {
+        const struct aws_http_metrics_exporter_counter_family *family = &s_counter_families[f];
+        if (s_append_family(output, family->name, "counter", family->help)) {
+            return AWS_OP_ERR;
+        }
+
+        for (size_t p = 0; p < AWS_ARRAY_SIZE(family->counters); ++p) {
+            if (family->counters[p] == AWS_HTTP_COUNTER_COUNT) {
+                continue;
+            }
+
+            uint64_t value = counters[family->counters[p]];
+            int result = family->is_ms ? s_appendf(
+                                             output,
+                                             "%s_total{protocol=\"%s\"} %.3f\n",
+                                             family->name,
+                                             s_protocol_labels[p],
+                                             (double)value / 1000.0)
+                                       : s_appendf(
+                                             output,
+                                             "%s_total{protocol=\"%s\"} %" PRIu64 "\n",
+                                             family->name,
+                                             s_protocol_labels[p],
+                                             value);
+            if (result) {
+                return AWS_OP_ERR;
+            }
+        }
+    }
+
+    const char *rtt_name = "aws_http_connection_smoothed_rtt_seconds";
+    if (s_append_family(output, rtt_name, "histogram", "HTTP/2 smoothed round trip time, sampled once a second.") ||
+        s_append_histogram_samples(output, rtt_name, NULL, &rtt)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_fetch_manager_metrics(
+    const struct aws_http_metrics_exporter_manager_entry *entry,
+    struct aws_http_manager_metrics *out_metrics) {
+
+    if (entry->is_stream_manager) {
+        aws_http2_stream_manager_fetch_metrics(entry->manager, out_metrics);
+    } else {
+        aws_http_connection_manager_fetch_metrics(entry->manager, out_metrics);
+    }
+}
+
+static int s_render_manager_metrics(struct aws_http_metrics_exporter *exporter, struct aws_byte_buf *output) {
+    size_t count = aws_array_list_length(&exporter->managers);
+    if (count == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_http_manager_metrics *metrics =
+        aws_mem_calloc(exporter->allocator, count, sizeof(struct aws_http_manager_metrics));
+    for (size_t i = 0; i < count; ++i) {
+        struct aws_http_metrics_exporter_manager_entry *entry = NULL;
+        aws_array_list_get_at_ptr(&exporter->managers, (void **)&entry, i);
+        s_fetch_manager_metrics(entry, &metrics[i]);
+    }
+
+    struct {
+        const char *name;
+        const char *help;
+        size_t offset;
+    } gauges[] = {
+        {"aws_http_manager_available_concurrency",
+         "Requests the manager can take on without a new connection.",
+         offsetof(struct aws_http_manager_metrics, available_concurrency)},
+        {"aws_http_manager_pending_acquires",
+         "Acquisitions waiting on the manager.",
+         offsetof(struct aws_http_manager_metrics, pending_concurrency_acquires)},
+        {"aws_http_manager_leased_concurrency",
+         "Connections or streams currently vended by the manager.",
+         offsetof(struct aws_http_manager_metrics, leased_concurrency)},
+    };
+
+    struct {
+        const char *name;
+        const char *help;
+        size_t offset;
+    } histograms[] = {
+        {"aws_http_manager_acquire_wait_seconds",
+         "Time acquisitions spent waiting.",
+         offsetof(struct aws_http_manager_metrics, acquire_wait)},
+        {"aws_http_manager_connection_setup_seconds",
+         "Time new connections took to set up.",
+         offsetof(struct aws_http_manager_metrics, connection_setup)},
+        {"aws_http_manager_connection_lifetime_seconds",
+         "Time from set up to shut down of connections.",
+         offsetof(struct aws_http_manager_metrics, connection_lifetime)},
+        {"aws_http_manager_idle_before_cull_seconds",
+         "Time idle connections sat in the pool before they were culled.",
+         offsetof(struct aws_http_manager_metrics, idle_before_cull)},
+    };
+
+    int result = AWS_OP_ERR;
+
+    for (size_t g = 0; g < AWS_ARRAY_SIZE(gauges); ++g) {
+        if (s_append_family(output, gauges[g].name, "gauge", gauges[g].help)) {
+            goto done;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            struct aws_http_metrics_exporter_manager_entry *entry = NULL;
+            aws_array_list_get_at_ptr(&exporter->managers, (void **)&entry, i);
+            size_t value = *(const size_t *)((const uint8_t *)&metrics[i] + gauges[g].offset);
+            if (s_append_sample_start(output, gauges[g].name, "", entry) || s_appendf(output, "} %zu\n", value)) {
+                goto done;
+            }
+        }
+    }
+
+    const char *failures_name = "aws_http_manager_connect_failures";
+    if (s_append_family(output, failures_name, "counter", "New connections that failed to set up.")) {
+        goto done;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        struct aws_http_metrics_exporter_manager_entry *entry = NULL;
+        aws_array_list_get_at_ptr(&exporter->managers, (void **)&entry, i);
+        if (s_append_sample_start(output, failures_name, "_total", entry) ||
+            s_appendf(output, "} %" PRIu64 "\n", metrics[i].connect_failure_count)) {
+            goto done;
+        }
+    }
+
+    for (size_t h = 0; h < AWS_ARRAY_SIZE(histograms); ++h) {
+        if (s_append_family(output, histograms[h].name, "histogram", histograms[h].help)) {
+            goto done;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            struct aws_http_metrics_exporter_manager_entry *entry = NULL;
+            aws_array_list_get_at_ptr(&exporter->managers, (void **)&entry, i);
+            const struct aws_http_latency_histogram *histogram =
+                (const struct aws_http_latency_histogram *)((const uint8_t *)&metrics[i] + histograms[h].offset);
+            if (s_append_histogram_samples(output, histograms[h].name, entry, histogram)) {
+                goto done;
+            }
+        }
+    }
+
+    result = AWS_OP_SUCCESS;
+done:
+    aws_mem_release(exporter->allocator, metrics);
+    return result;
+}
+
+int aws_http_metrics_exporter_render(struct aws_http_metrics_exporter *exporter, struct aws_byte_buf *output) {
+    if (s_render_connection_metrics(exporter, output)) {
+        return AWS_OP_ERR;
+    }
+
+    aws_mutex_lock(&exporter->lock);
+    int result = s_render_manager_metrics(exporter, output);
+    aws_mutex_unlock(&exporter->lock);
+    if (result) {
+        return AWS_OP_ERR;
+    }
+
+    return s_appendf(output, "# EOF\n");
+}
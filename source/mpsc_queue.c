@@ -0,0 +1,68 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/mpsc_queue.h>
+
+/* Its address marks a closed queue. Never linked into anything */
+static struct aws_linked_list_node s_closed_sentinel;
+
+void aws_http_mpsc_queue_init(struct aws_http_mpsc_queue *queue) {
+    aws_atomic_init_ptr(&queue->head, NULL);
+}
+
+enum aws_http_mpsc_queue_push_result aws_http_mpsc_queue_push(
+    struct aws_http_mpsc_queue *queue,
+    struct aws_linked_list_node *node) {
+
+    void *head = aws_atomic_load_ptr(&queue->head);
+    do {
+        if (head == &s_closed_sentinel) {
+            return AWS_HTTP_MPSC_QUEUE_CLOSED;
+        }
+        /* Nodes are chained newest-first through `next` until the consumer takes them */
+        node->next = head;
+        node->prev = NULL;
+    } while (!aws_atomic_compare_exchange_ptr(&queue->head, &head, node));
+
+    return head == NULL ? AWS_HTTP_MPSC_QUEUE_PUSHED_FIRST : AWS_HTTP_MPSC_QUEUE_PUSHED;
+}
+
+/* Swap the whole chain out for `replacement`, and append it to out_list oldest-first */
+static void s_take_all(struct aws_http_mpsc_queue *queue, struct aws_linked_list *out_list, void *replacement) {
+    void *head = aws_atomic_load_ptr(&queue->head);
+    do {
+        if (head == &s_closed_sentinel || (head == NULL && replacement == NULL)) {
+            return;
+        }
+    } while (!aws_atomic_compare_exchange_ptr(&queue->head, &head, replacement));
+
+    struct aws_linked_list_node *oldest_first = NULL;
+    struct aws_linked_list_node *node = head;
+    while (node != NULL) {
+        struct aws_linked_list_node *next = node->next;
+        node->next = oldest_first;
+        oldest_first = node;
+        node = next;
+    }
+
+    while (oldest_first != NULL) {
+        struct aws_linked_list_node *next = oldest_first->next;
+        aws_linked_list_push_back(out_list, oldest_first);
+        oldest_first = next;
+    }
+}
+
+void aws_http_mpsc_queue_take_all(struct aws_http_mpsc_queue *queue, struct aws_linked_list *out_list) {
+    s_take_all(queue, out_list, NULL);
+}
+
+void aws_http_mpsc_queue_close(struct aws_http_mpsc_queue *queue, struct aws_linked_list *out_list) {
+    s_take_all(queue, out_list, &s_closed_sentinel);
+}
+
+bool aws_http_mpsc_queue_is_empty(const struct aws_http_mpsc_queue *queue) {
+    void *head = aws_atomic_load_ptr(&queue->head);
+    return head == NULL || head == &s_closed_sentinel;
+}
@@ -10,7 +10,10 @@
 #include <aws/common/hash_table.h>
 #include <aws/common/string.h>
 #include <aws/http/connection_manager.h>
+#include <aws/http/http2_stream_manager.h>
+#include <aws/http/memory_budget.h>
 #include <aws/http/private/connection_impl.h>
+#include <aws/http/private/h1_encoder.h>
 #include <aws/http/proxy.h>
 #include <aws/http/request_response.h>
 #include <aws/io/channel.h>
@@ -63,7 +66,13 @@ void aws_http_proxy_user_data_destroy(struct aws_http_proxy_user_data *user_data
         user_data->proxy_connection = NULL;
     }
 
+    if (user_data->connect_request) {
+        aws_http_message_destroy(user_data->connect_request);
+    }
+
     aws_string_destroy(user_data->original_host);
+    aws_byte_buf_clean_up(&user_data->forwarding_target_prefix);
+    aws_byte_buf_clean_up(&user_data->http2.pending_read_data);
     if (user_data->proxy_config) {
         aws_http_proxy_config_destroy(user_data->proxy_config);
     }
@@ -75,6 +84,7 @@ void aws_http_proxy_user_data_destroy(struct aws_http_proxy_user_data *user_data
 
     aws_http_proxy_negotiator_release(user_data->proxy_negotiator);
 
+    aws_http_memory_budget_release(user_data->original_http1_options.memory_budget);
     aws_client_bootstrap_release(user_data->original_bootstrap);
 
     aws_mem_release(user_data->allocator, user_data);
@@ -179,6 +189,7 @@ struct aws_http_proxy_user_data *aws_http_proxy_user_data_new(
 
     user_data->original_user_data = options.user_data;
     user_data->original_http1_options = *options.http1_options;
+    aws_http_memory_budget_acquire(user_data->original_http1_options.memory_budget);
     user_data->original_http2_options = *options.http2_options;
 
     /* keep a copy of the settings array if it's not NULL */
@@ -270,6 +281,7 @@ struct aws_http_proxy_user_data *aws_http_proxy_user_data_new_reset_clone(
     user_data->original_channel_on_shutdown = old_user_data->original_channel_on_shutdown;
     user_data->original_user_data = old_user_data->original_user_data;
     user_data->original_http1_options = old_user_data->original_http1_options;
+    aws_http_memory_budget_acquire(user_data->original_http1_options.memory_budget);
     user_data->original_http2_options = old_user_data->original_http2_options;
 
     /* keep a copy of the settings array if it's not NULL */
@@ -351,6 +363,11 @@ static void s_aws_http_on_client_connection_http_forwarding_proxy_setup_fn(
     void *user_data) {
     struct aws_http_proxy_user_data *proxy_ud = user_data;
 
+    /* Must be set before the user gets the connection and starts making requests */
+    if (connection != NULL) {
+        connection->proxy_request_target_prefix = aws_byte_cursor_from_buf(&proxy_ud->forwarding_target_prefix);
+    }
+
     s_do_on_setup_callback(proxy_ud, connection, error_code);
 
     if (error_code != AWS_ERROR_SUCCESS) {
@@ -607,12 +624,14 @@ static int s_aws_http_apply_http_connection_to_proxied_channel(struct aws_http_p
         channel,
         false,
         context->original_tls_options != NULL,
+        false, /* is_socket_channel */
         context->original_manual_window_management,
         context->prior_knowledge_http2,
         context->original_initial_window_size,
         context->alpn_string_map.p_impl == NULL ? NULL : &context->alpn_string_map,
         &context->original_http1_options,
         &context->original_http2_options,
+        NULL, /* traffic_capture_options */
         context->original_user_data);
     if (connection == NULL) {
         AWS_LOGF_ERROR(
@@ -997,15 +1016,55 @@ done:
     return result;
 }
 
+/*
+ * Builds "http://host:port" once per connection, so that the H1 encoder can write it in front of each request's
+ * path, rather than every request being parsed and rebuilt into a new absolute uri.
+ */
+static int s_init_forwarding_target_prefix(struct aws_http_proxy_user_data *proxy_user_data) {
+    struct aws_byte_cursor host_cursor = aws_byte_cursor_from_string(proxy_user_data->original_host);
+
+    /* "http://" + host + ":" + up to 10 port digits */
+    if (aws_byte_buf_init(
+            &proxy_user_data->forwarding_target_prefix, proxy_user_data->allocator, host_cursor.len + 18)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_buf *prefix = &proxy_user_data->forwarding_target_prefix;
+    struct aws_byte_cursor scheme_separator = aws_byte_cursor_from_c_str("://");
+    aws_byte_buf_write_from_whole_cursor(prefix, aws_http_scheme_http);
+    aws_byte_buf_write_from_whole_cursor(prefix, scheme_separator);
+    aws_byte_buf_write_from_whole_cursor(prefix, host_cursor);
+
+    /* match aws_uri_init_from_builder_options(), which leaves out a port of 0 */
+    if (proxy_user_data->original_port != 0) {
+        char port_str[12];
+        snprintf(port_str, sizeof(port_str), ":%u", proxy_user_data->original_port);
+        aws_byte_buf_write_from_whole_cursor(prefix, aws_byte_cursor_from_c_str(port_str));
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 /*
  * Plaintext proxy request transformation function
  *
- * Rewrites the target uri to absolute form and injects any desired headers
+ * Makes sure the target uri will be sent in absolute form and injects any desired headers.
+ * Origin-form and star-pathed OPTIONS targets are left alone, the H1 encoder writes the connection's
+ * target prefix in front of them. Anything else gets rewritten the slow way.
  */
 static int s_proxy_http_request_transform(struct aws_http_message *request, void *user_data) {
     struct aws_http_proxy_user_data *proxy_ud = user_data;
 
-    if (aws_http_rewrite_uri_for_proxy_request(request, proxy_ud)) {
+    struct aws_byte_cursor method_cursor;
+    AWS_ZERO_STRUCT(method_cursor);
+    struct aws_byte_cursor path_cursor;
+    AWS_ZERO_STRUCT(path_cursor);
+    bool is_prefixable = proxy_ud->forwarding_target_prefix.len > 0 &&
+                         aws_http_message_get_request_method(request, &method_cursor) == AWS_OP_SUCCESS &&
+                         aws_http_message_get_request_path(request, &path_cursor) == AWS_OP_SUCCESS &&
+                         aws_h1_encoder_is_prefixable_request_target(method_cursor, path_cursor);
+
+    if (!is_prefixable && aws_http_rewrite_uri_for_proxy_request(request, proxy_ud)) {
         return AWS_OP_ERR;
     }
 
@@ -1036,6 +1095,11 @@ static int s_aws_http_client_connect_via_forwarding_proxy(const struct aws_http_
         return AWS_OP_ERR;
     }
 
+    if (s_init_forwarding_target_prefix(proxy_user_data)) {
+        aws_http_proxy_user_data_destroy(proxy_user_data);
+        return AWS_OP_ERR;
+    }
+
     AWS_FATAL_ASSERT(options->proxy_options != NULL);
 
     /* Fill in a new connection options pointing at the proxy */
@@ -1101,6 +1165,730 @@ static int s_create_tunneling_connection(struct aws_http_proxy_user_data *user_d
     return result;
 }
 
+/*****************************************************************************************************************
+ * Tunnels over HTTP/2
+ *
+ * The CONNECT request is a stream from the user's HTTP/2 stream manager for the proxy (RFC-9113 8.5),
+ * and a 200 response opens the tunnel. The stream then carries the origin's bytes in its DATA frames.
+ *
+ * The origin's TLS handler and HTTP connection expect to sit in a channel, so the tunnel gets a lightweight
+ * channel of its own, on the HTTP/2 connection's event-loop. The leftmost handler in that channel is a bridge:
+ * it sends stream DATA to the right as read messages, and writes the channel's write messages to the stream.
+ * Websockets over HTTP/2 are set up the same way, see websocket_bootstrap.c.
+ *
+ * The proxy user data is destroyed once the stream has completed, the channel is destroyed,
+ * and the stream is done with the data of every write message.
+ *****************************************************************************************************************/
+
+struct aws_http_proxy_http2_bridge {
+    struct aws_channel_handler handler;
+    struct aws_http_proxy_user_data *proxy_ud;
+};
+
+static void s_http2_tunnel_make_connect_request(struct aws_http_proxy_user_data *proxy_ud);
+
+struct aws_http_message *aws_http_proxy_new_http2_connect_request(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *http1_connect_request) {
+
+    /* This already takes ":authority" from "Host", and drops connection-specific headers like "Proxy-Connection" */
+    struct aws_http_message *request = aws_http2_message_new_from_http1(allocator, http1_connect_request);
+    if (request == NULL) {
+        return NULL;
+    }
+
+    struct aws_http_headers *headers = aws_http_message_get_headers(request);
+    if (aws_http_headers_erase(headers, aws_http_header_scheme) ||
+        aws_http_headers_erase(headers, aws_http_header_path)) {
+        aws_http_message_release(request);
+        return NULL;
+    }
+
+    return request;
+}
+
+/*
+ * Examines the proxy user data state and makes an http-interface or raw channel setup callback,
+ * with the tunnel's connection or channel
+ */
+static void s_http2_tunnel_do_on_setup_callback(struct aws_http_proxy_user_data *proxy_ud, int error_code) {
+    if (proxy_ud->original_http_on_setup) {
+        struct aws_http_connection *connection = error_code ? NULL : proxy_ud->final_connection;
+        proxy_ud->original_http_on_setup(connection, error_code, proxy_ud->original_user_data);
+        proxy_ud->original_http_on_setup = NULL;
+    }
+
+    if (proxy_ud->original_channel_on_setup) {
+        struct aws_channel *channel = error_code ? NULL : proxy_ud->http2.channel;
+        proxy_ud->original_channel_on_setup(
+            proxy_ud->original_bootstrap, error_code, channel, proxy_ud->original_user_data);
+        proxy_ud->original_channel_on_setup = NULL;
+    }
+}
+
+/* Destroy the proxy user data once nothing refers to it anymore,
+ * reporting failed setup first if it never succeeded */
+static void s_http2_tunnel_try_finish(struct aws_http_proxy_user_data *proxy_ud) {
+    if (!proxy_ud->http2.is_stream_acquire_done || !proxy_ud->http2.is_stream_complete ||
+        proxy_ud->http2.channel != NULL || !aws_linked_list_empty(&proxy_ud->http2.pending_writes)) {
+        return;
+    }
+
+    if (proxy_ud->state != AWS_PBS_SUCCESS) {
+        int error_code = proxy_ud->error_code;
+        if (error_code == AWS_ERROR_SUCCESS) {
+            error_code = proxy_ud->http2.stream_error_code;
+        }
+        if (error_code == AWS_ERROR_SUCCESS) {
+            error_code = AWS_ERROR_UNKNOWN;
+        }
+
+        AWS_LOGF_WARN(
+            AWS_LS_HTTP_CONNECTION,
+            "(STATIC) Error %d while connecting to \"%s\" via HTTP/2 proxy tunnel.",
+            error_code,
+            (char *)proxy_ud->original_host->bytes);
+
+        proxy_ud->state = AWS_PBS_FAILURE;
+        s_http2_tunnel_do_on_setup_callback(proxy_ud, error_code);
+    }
+
+    aws_http_stream_release(proxy_ud->http2.stream);
+    proxy_ud->http2.stream = NULL;
+    aws_http_proxy_user_data_destroy(proxy_ud);
+}
+
+/* Fail setup before there's a CONNECT stream */
+static void s_http2_tunnel_fail_without_stream(struct aws_http_proxy_user_data *proxy_ud, int error_code) {
+    proxy_ud->error_code = error_code;
+    proxy_ud->http2.is_stream_acquire_done = true;
+    proxy_ud->http2.is_stream_complete = true;
+    s_http2_tunnel_try_finish(proxy_ud);
+}
+
+/* Send as much buffered stream DATA to the tunnel's channel as its read window allows */
+static void s_http2_tunnel_flush_read_data(struct aws_http_proxy_user_data *proxy_ud) {
+    struct aws_channel_slot *slot = proxy_ud->http2.slot;
+    if (!slot || !slot->adj_right || proxy_ud->http2.is_reading_stopped) {
+        return;
+    }
+
+    struct aws_byte_cursor pending = aws_byte_cursor_from_buf(&proxy_ud->http2.pending_read_data);
+    while (pending.len > 0) {
+        size_t window = aws_channel_slot_downstream_read_window(slot);
+        if (window == 0) {
+            break;
+        }
+
+        struct aws_io_message *msg = aws_channel_acquire_message_from_pool(
+            slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, aws_min_size(pending.len, window));
+        if (!msg) {
+            goto error;
+        }
+
+        size_t chunk_size = aws_min_size(aws_min_size(pending.len, window), msg->message_data.capacity);
+        struct aws_byte_cursor chunk = aws_byte_cursor_advance(&pending, chunk_size);
+        aws_byte_buf_write_from_whole_cursor(&msg->message_data, chunk);
+
+        if (aws_channel_slot_send_message(slot, msg, AWS_CHANNEL_DIR_READ)) {
+            aws_mem_release(msg->allocator, msg);
+            goto error;
+        }
+    }
+
+    /* Keep whatever the channel can't take yet at the front of the buffer */
+    if (pending.len < proxy_ud->http2.pending_read_data.len) {
+        memmove(proxy_ud->http2.pending_read_data.buffer, pending.ptr, pending.len);
+        proxy_ud->http2.pending_read_data.len = pending.len;
+    }
+    return;
+
+error:
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_CONNECTION,
+        "(%p) Failed to pass HTTP/2 proxy tunnel data to channel, error %d(%s)",
+        (void *)slot->channel,
+        aws_last_error(),
+        aws_error_str(aws_last_error()));
+    aws_byte_buf_reset(&proxy_ud->http2.pending_read_data, false /*zero_contents*/);
+    aws_channel_shutdown(slot->channel, aws_last_error());
+}
+
+static int s_http2_bridge_process_read_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+
+    (void)handler;
+    (void)slot;
+    (void)message;
+    /* The bridge is the leftmost handler, nothing sends it read messages */
+    return aws_raise_error(AWS_ERROR_INVALID_STATE);
+}
+
+static void s_http2_bridge_on_write_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+
+    /* Writes complete in the order they were made */
+    AWS_FATAL_ASSERT(!aws_linked_list_empty(&proxy_ud->http2.pending_writes));
+    struct aws_linked_list_node *node = aws_linked_list_pop_front(&proxy_ud->http2.pending_writes);
+    struct aws_io_message *msg = AWS_CONTAINER_OF(node, struct aws_io_message, queueing_handle);
+
+    if (msg->on_completion) {
+        msg->on_completion(msg->owning_channel, msg, error_code, msg->user_data);
+    }
+    aws_mem_release(msg->allocator, msg);
+
+    s_http2_tunnel_try_finish(proxy_ud);
+}
+
+static int s_http2_bridge_process_write_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+
+    (void)slot;
+    struct aws_http_proxy_http2_bridge *bridge = handler->impl;
+    struct aws_http_proxy_user_data *proxy_ud = bridge->proxy_ud;
+
+    if (proxy_ud->http2.is_writing_stopped) {
+        return aws_raise_error(AWS_ERROR_HTTP_CONNECTION_CLOSED);
+    }
+
+    /* The message stays alive until the stream is done sending its data */
+    struct aws_http2_stream_write_data_options write = {
+        .zero_copy_data = aws_byte_cursor_from_buf(&message->message_data),
+        .on_complete = s_http2_bridge_on_write_complete,
+        .user_data = proxy_ud,
+    };
+    if (aws_http2_stream_write_data(proxy_ud->http2.stream, &write)) {
+        return AWS_OP_ERR;
+    }
+
+    aws_linked_list_push_back(&proxy_ud->http2.pending_writes, &message->queueing_handle);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_http2_bridge_increment_read_window(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    size_t size) {
+
+    (void)slot;
+    struct aws_http_proxy_http2_bridge *bridge = handler->impl;
+    struct aws_http_proxy_user_data *proxy_ud = bridge->proxy_ud;
+
+    if (!proxy_ud->http2.is_stream_complete) {
+        aws_http_stream_update_window(proxy_ud->http2.stream, size);
+    }
+
+    s_http2_tunnel_flush_read_data(proxy_ud);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_http2_bridge_shutdown(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    enum aws_channel_direction dir,
+    int error_code,
+    bool free_scarce_resources_immediately) {
+
+    struct aws_http_proxy_http2_bridge *bridge = handler->impl;
+    struct aws_http_proxy_user_data *proxy_ud = bridge->proxy_ud;
+
+    if (dir == AWS_CHANNEL_DIR_READ) {
+        proxy_ud->http2.is_reading_stopped = true;
+    } else {
+        proxy_ud->http2.is_writing_stopped = true;
+
+        /* The channel is going away, so its handlers mustn't hear about writes that are still in flight */
+        for (struct aws_linked_list_node *node = aws_linked_list_begin(&proxy_ud->http2.pending_writes);
+             node != aws_linked_list_end(&proxy_ud->http2.pending_writes);
+             node = aws_linked_list_next(node)) {
+
+            struct aws_io_message *msg = AWS_CONTAINER_OF(node, struct aws_io_message, queueing_handle);
+            if (msg->on_completion) {
+                msg->on_completion(msg->owning_channel, msg, AWS_ERROR_HTTP_CONNECTION_CLOSED, msg->user_data);
+                msg->on_completion = NULL;
+            }
+        }
+
+        /* After a clean close, end our side of the tunnel, and let the proxy end its side.
+         * Otherwise, reset the stream. The connection to the proxy stays up either way. */
+        if (!proxy_ud->http2.is_stream_complete) {
+            if (error_code || free_scarce_resources_immediately) {
+                aws_http2_stream_reset(proxy_ud->http2.stream, AWS_HTTP2_ERR_CANCEL);
+            } else {
+                struct aws_http2_stream_write_data_options end_stream = {.end_stream = true};
+                aws_http2_stream_write_data(proxy_ud->http2.stream, &end_stream);
+            }
+        }
+    }
+
+    return aws_channel_slot_on_handler_shutdown_complete(slot, dir, error_code, free_scarce_resources_immediately);
+}
+
+static size_t s_http2_bridge_initial_window_size(struct aws_channel_handler *handler) {
+    (void)handler;
+    /* Nothing sits to the left of the bridge */
+    return SIZE_MAX;
+}
+
+static size_t s_http2_bridge_message_overhead(struct aws_channel_handler *handler) {
+    (void)handler;
+    return 0;
+}
+
+static void s_http2_bridge_destroy(struct aws_channel_handler *handler) {
+    /* The bridge is destroyed along with the channel, which may outlive the proxy user data */
+    struct aws_http_proxy_http2_bridge *bridge = handler->impl;
+    aws_mem_release(handler->alloc, bridge);
+}
+
+static struct aws_channel_handler_vtable s_http2_bridge_vtable = {
+    .process_read_message = s_http2_bridge_process_read_message,
+    .process_write_message = s_http2_bridge_process_write_message,
+    .increment_read_window = s_http2_bridge_increment_read_window,
+    .shutdown = s_http2_bridge_shutdown,
+    .initial_window_size = s_http2_bridge_initial_window_size,
+    .message_overhead = s_http2_bridge_message_overhead,
+    .destroy = s_http2_bridge_destroy,
+};
+
+static int s_http2_tunnel_install_bridge(struct aws_http_proxy_user_data *proxy_ud) {
+    struct aws_channel_slot *slot = aws_channel_slot_new(proxy_ud->http2.channel);
+    if (!slot) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_http_proxy_http2_bridge *bridge =
+        aws_mem_calloc(proxy_ud->allocator, 1, sizeof(struct aws_http_proxy_http2_bridge));
+    bridge->proxy_ud = proxy_ud;
+    bridge->handler.vtable = &s_http2_bridge_vtable;
+    bridge->handler.alloc = proxy_ud->allocator;
+    bridge->handler.impl = bridge;
+
+    if (aws_channel_slot_set_handler(slot, &bridge->handler)) {
+        aws_mem_release(proxy_ud->allocator, bridge);
+        return AWS_OP_ERR;
+    }
+
+    proxy_ud->http2.slot = slot;
+    return AWS_OP_SUCCESS;
+}
+
+/* The tunnel is open (and TLS to the origin negotiated, if any). Install the origin's HTTP connection */
+static void s_http2_tunnel_finish_setup(struct aws_http_proxy_user_data *proxy_ud) {
+    struct aws_channel *channel = proxy_ud->http2.channel;
+
+    if (proxy_ud->original_http_on_setup != NULL) {
+        struct aws_http_connection *connection = aws_http_connection_new_channel_handler(
+            proxy_ud->allocator,
+            channel,
+            false,
+            proxy_ud->original_tls_options != NULL,
+            false, /* is_socket_channel: the bridge to the HTTP/2 stream is leftmost */
+            proxy_ud->original_manual_window_management,
+            proxy_ud->prior_knowledge_http2,
+            proxy_ud->original_initial_window_size,
+            proxy_ud->alpn_string_map.p_impl == NULL ? NULL : &proxy_ud->alpn_string_map,
+            &proxy_ud->original_http1_options,
+            &proxy_ud->original_http2_options,
+            NULL, /* traffic_capture_options */
+            proxy_ud->original_user_data);
+        if (connection == NULL) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_CONNECTION,
+                "(%p) Failed to create the client connection object in HTTP/2 proxy tunnel, error %d(%s)",
+                (void *)channel,
+                aws_last_error(),
+                aws_error_str(aws_last_error()));
+            proxy_ud->error_code = aws_last_error();
+            aws_channel_shutdown(channel, proxy_ud->error_code);
+            return;
+        }
+
+        AWS_LOGF_INFO(
+            AWS_LS_HTTP_CONNECTION,
+            "id=%p: " PRInSTR " client connection established through HTTP/2 proxy tunnel.",
+            (void *)connection,
+            AWS_BYTE_CURSOR_PRI(aws_http_version_to_str(connection->http_version)));
+
+        proxy_ud->final_connection = connection;
+    }
+
+    proxy_ud->state = AWS_PBS_SUCCESS;
+    s_http2_tunnel_do_on_setup_callback(proxy_ud, AWS_ERROR_SUCCESS);
+
+    /* Pass along any DATA that arrived while the tunnel was being set up */
+    s_http2_tunnel_flush_read_data(proxy_ud);
+}
+
+static void s_on_http2_tunnel_origin_tls_negotiation_result(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    int error_code,
+    void *user_data) {
+
+    (void)handler;
+    (void)slot;
+
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+    if (error_code != AWS_ERROR_SUCCESS) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION,
+            "(%p) HTTP/2 proxy tunnel failed origin server TLS negotiation with error %d(%s)",
+            (void *)proxy_ud->http2.channel,
+            error_code,
+            aws_error_str(error_code));
+        proxy_ud->error_code = error_code;
+        aws_channel_shutdown(proxy_ud->http2.channel, error_code);
+        return;
+    }
+
+    s_http2_tunnel_finish_setup(proxy_ud);
+}
+
+/* Invoked when the tunnel's own channel is ready (or failed to set up) */
+static void s_http2_tunnel_on_channel_setup(struct aws_channel *channel, int error_code, void *user_data) {
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+
+    if (error_code) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION,
+            "(STATIC) Failed to set up HTTP/2 proxy tunnel channel, error %d(%s)",
+            error_code,
+            aws_error_str(error_code));
+
+        aws_channel_destroy(channel);
+        proxy_ud->http2.channel = NULL;
+        proxy_ud->error_code = error_code;
+        if (!proxy_ud->http2.is_stream_complete) {
+            aws_http2_stream_reset(proxy_ud->http2.stream, AWS_HTTP2_ERR_INTERNAL_ERROR);
+        }
+        s_http2_tunnel_try_finish(proxy_ud);
+        return;
+    }
+
+    if (proxy_ud->http2.is_stream_complete) {
+        /* The stream ended while the channel was setting up */
+        error_code = proxy_ud->http2.stream_error_code ? proxy_ud->http2.stream_error_code
+                                                       : AWS_ERROR_HTTP_CONNECTION_CLOSED;
+        goto error;
+    }
+
+    if (s_http2_tunnel_install_bridge(proxy_ud)) {
+        error_code = aws_last_error();
+        goto error;
+    }
+
+    if (proxy_ud->original_tls_options == NULL) {
+        s_http2_tunnel_finish_setup(proxy_ud);
+        return;
+    }
+
+    /* Perform TLS negotiation to the origin server through the tunnel */
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_CONNECTION, "(%p) Beginning TLS negotiation through HTTP/2 proxy tunnel", (void *)channel);
+
+    proxy_ud->original_tls_options->on_negotiation_result = s_on_http2_tunnel_origin_tls_negotiation_result;
+    proxy_ud->state = AWS_PBS_TLS_NEGOTIATION;
+    if (s_vtable->aws_channel_setup_client_tls(proxy_ud->http2.slot, proxy_ud->original_tls_options)) {
+        error_code = aws_last_error();
+        goto error;
+    }
+
+    /* The TLS handler is waiting on any DATA that arrived while the channel was setting up */
+    s_http2_tunnel_flush_read_data(proxy_ud);
+    return;
+
+error:
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_CONNECTION,
+        "(%p) Failed to set up HTTP/2 proxy tunnel, error %d(%s)",
+        (void *)channel,
+        error_code,
+        aws_error_str(error_code));
+
+    /* Setup failure is reported once the channel has shut down and the stream has completed */
+    proxy_ud->error_code = error_code;
+    aws_channel_shutdown(channel, error_code);
+}
+
+/* Invoked when the tunnel's own channel has finished shutting down */
+static void s_http2_tunnel_on_channel_shutdown(struct aws_channel *channel, int error_code, void *user_data) {
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+
+    if (proxy_ud->state == AWS_PBS_SUCCESS) {
+        AWS_LOGF_INFO(
+            AWS_LS_HTTP_CONNECTION,
+            "(%p) HTTP/2 proxy tunnel (channel %p) shutting down.",
+            (void *)proxy_ud,
+            (void *)channel);
+
+        if (proxy_ud->original_http_on_shutdown) {
+            proxy_ud->original_http_on_shutdown(proxy_ud->final_connection, error_code, proxy_ud->original_user_data);
+            proxy_ud->original_http_on_shutdown = NULL;
+        }
+
+        if (proxy_ud->original_channel_on_shutdown) {
+            proxy_ud->original_channel_on_shutdown(
+                proxy_ud->original_bootstrap, error_code, channel, proxy_ud->original_user_data);
+            proxy_ud->original_channel_on_shutdown = NULL;
+        }
+    } else if (proxy_ud->error_code == AWS_ERROR_SUCCESS) {
+        proxy_ud->error_code = error_code ? error_code : AWS_ERROR_HTTP_CONNECTION_CLOSED;
+    }
+
+    /* It's still up to the user to release the HTTP connection itself */
+    aws_channel_destroy(channel);
+    proxy_ud->http2.channel = NULL;
+    proxy_ud->http2.slot = NULL;
+
+    s_http2_tunnel_try_finish(proxy_ud);
+}
+
+static void s_http2_tunnel_on_stream_acquired(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+
+    proxy_ud->http2.is_stream_acquire_done = true;
+
+    if (error_code) {
+        /* None of the stream callbacks will be invoked */
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION,
+            "(STATIC) HTTP/2 proxy tunnel failed to acquire CONNECT stream, error %d(%s)",
+            error_code,
+            aws_error_str(error_code));
+
+        proxy_ud->http2.is_stream_complete = true;
+        proxy_ud->http2.stream_error_code = error_code;
+    } else {
+        proxy_ud->http2.stream = stream;
+    }
+
+    s_http2_tunnel_try_finish(proxy_ud);
+}
+
+static int s_http2_tunnel_on_response_headers(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    const struct aws_http_header *header_array,
+    size_t num_headers,
+    void *user_data) {
+
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+    if (proxy_ud->http2.got_success_response) {
+        /* Trailing headers at the end of a tunnel, nothing to do with setup */
+        return AWS_OP_SUCCESS;
+    }
+
+    return s_aws_http_on_response_headers_tunnel_proxy(stream, header_block, header_array, num_headers, user_data);
+}
+
+static int s_http2_tunnel_on_response_header_block_done(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    void *user_data) {
+
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+    if (proxy_ud->http2.got_success_response || header_block != AWS_HTTP_HEADER_BLOCK_MAIN) {
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Records the status and passes it to the proxy strategy */
+    s_aws_http_on_incoming_header_block_done_tunnel_proxy(stream, header_block, user_data);
+    if (proxy_ud->connect_status_code != AWS_HTTP_STATUS_CODE_200_OK) {
+        /* Keep the stream going, failure is reported once the complete response has been received */
+        return AWS_OP_SUCCESS;
+    }
+
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_CONNECTION,
+        "(%p) Made successful CONNECT request to \"%s\" via HTTP/2 proxy",
+        (void *)stream,
+        (char *)proxy_ud->original_host->bytes);
+
+    struct aws_http_connection *http_connection = aws_http_stream_get_connection(stream);
+    struct aws_channel *http_channel = aws_http_connection_get_channel(http_connection);
+
+    struct aws_channel_options channel_options = {
+        .event_loop = aws_channel_get_event_loop(http_channel),
+        .on_setup_completed = s_http2_tunnel_on_channel_setup,
+        .setup_user_data = proxy_ud,
+        .on_shutdown_completed = s_http2_tunnel_on_channel_shutdown,
+        .shutdown_user_data = proxy_ud,
+        .enable_read_back_pressure = proxy_ud->original_manual_window_management,
+    };
+
+    proxy_ud->http2.channel = aws_channel_new(proxy_ud->allocator, &channel_options);
+    if (!proxy_ud->http2.channel) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION,
+            "(%p) Failed to create HTTP/2 proxy tunnel channel, error %d(%s)",
+            (void *)stream,
+            aws_last_error(),
+            aws_error_str(aws_last_error()));
+        proxy_ud->error_code = aws_last_error();
+        /* Returning error resets the stream */
+        return AWS_OP_ERR;
+    }
+
+    proxy_ud->http2.got_success_response = true;
+    return AWS_OP_SUCCESS;
+}
+
+static int s_http2_tunnel_on_response_body(
+    struct aws_http_stream *stream,
+    const struct aws_byte_cursor *data,
+    void *user_data) {
+
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+
+    if (!proxy_ud->http2.got_success_response) {
+        /* Body of a failed response */
+        return s_aws_http_on_incoming_body_tunnel_proxy(stream, data, user_data);
+    }
+
+    if (proxy_ud->http2.channel == NULL || proxy_ud->http2.is_reading_stopped) {
+        /* The tunnel is gone, drop the data */
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Buffer the data until the channel is set up and has the window for it */
+    if (aws_byte_buf_append_dynamic(&proxy_ud->http2.pending_read_data, data)) {
+        return AWS_OP_ERR;
+    }
+
+    s_http2_tunnel_flush_read_data(proxy_ud);
+    return AWS_OP_SUCCESS;
+}
+
+static void s_http2_tunnel_on_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct aws_http_proxy_user_data *proxy_ud = user_data;
+
+    proxy_ud->http2.is_stream_complete = true;
+    proxy_ud->http2.stream_error_code = error_code;
+
+    /* The tunnel can't outlive its stream */
+    if (proxy_ud->http2.channel) {
+        aws_channel_shutdown(proxy_ud->http2.channel, error_code ? error_code : AWS_ERROR_HTTP_CONNECTION_CLOSED);
+    } else if (!proxy_ud->http2.got_success_response) {
+        if (proxy_ud->error_code == AWS_ERROR_SUCCESS) {
+            proxy_ud->error_code = error_code ? error_code : AWS_ERROR_HTTP_PROXY_CONNECT_FAILED;
+        }
+
+        /* An authenticating strategy may want another try, which is just another stream */
+        if (proxy_ud->connect_status_code == AWS_HTTP_STATUS_CODE_407_PROXY_AUTHENTICATION_REQUIRED &&
+            aws_http_proxy_negotiator_get_retry_directive(proxy_ud->proxy_negotiator) != AWS_HPNRD_STOP) {
+
+            aws_http_stream_release(stream);
+            proxy_ud->http2.stream = NULL;
+            proxy_ud->http2.is_stream_acquire_done = false;
+            proxy_ud->http2.is_stream_complete = false;
+            proxy_ud->http2.stream_error_code = AWS_ERROR_SUCCESS;
+            proxy_ud->error_code = AWS_ERROR_SUCCESS;
+            proxy_ud->connect_status_code = AWS_HTTP_STATUS_CODE_UNKNOWN;
+
+            s_http2_tunnel_make_connect_request(proxy_ud);
+            return;
+        }
+    }
+
+    s_http2_tunnel_try_finish(proxy_ud);
+}
+
+static void s_terminate_http2_tunnel_connect(
+    struct aws_http_message *message,
+    int error_code,
+    void *internal_proxy_user_data) {
+    (void)message;
+
+    struct aws_http_proxy_user_data *proxy_ud = internal_proxy_user_data;
+
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_CONNECTION,
+        "(STATIC) HTTP/2 proxy tunnel failed to create CONNECT request with error %d(%s)",
+        error_code,
+        aws_error_str(error_code));
+
+    s_http2_tunnel_fail_without_stream(proxy_ud, error_code);
+}
+
+static void s_continue_http2_tunnel_connect(struct aws_http_message *message, void *internal_proxy_user_data) {
+    struct aws_http_proxy_user_data *proxy_ud = internal_proxy_user_data;
+
+    struct aws_http_message *request = aws_http_proxy_new_http2_connect_request(proxy_ud->allocator, message);
+    if (request == NULL) {
+        s_http2_tunnel_fail_without_stream(proxy_ud, aws_last_error());
+        return;
+    }
+
+    struct aws_http_make_request_options request_options = {
+        .self_size = sizeof(request_options),
+        .request = request,
+        .user_data = proxy_ud,
+        .on_response_headers = s_http2_tunnel_on_response_headers,
+        .on_response_header_block_done = s_http2_tunnel_on_response_header_block_done,
+        .on_response_body = s_http2_tunnel_on_response_body,
+        .on_complete = s_http2_tunnel_on_stream_complete,
+        .http2_use_manual_data_writes = true,
+    };
+
+    struct aws_http2_stream_manager_acquire_stream_options acquire_options = {
+        .callback = s_http2_tunnel_on_stream_acquired,
+        .user_data = proxy_ud,
+        .options = &request_options,
+    };
+
+    /* The stream manager keeps the request alive */
+    aws_http2_stream_manager_acquire_stream(proxy_ud->proxy_config->http2_stream_manager, &acquire_options);
+    aws_http_message_release(request);
+}
+
+/*
+ * Builds the CONNECT request and lets the proxy strategy modify it, before it's sent as an HTTP/2 stream
+ */
+static void s_http2_tunnel_make_connect_request(struct aws_http_proxy_user_data *proxy_ud) {
+    proxy_ud->state = AWS_PBS_HTTP_CONNECT;
+
+    if (proxy_ud->connect_request != NULL) {
+        aws_http_message_destroy(proxy_ud->connect_request);
+    }
+
+    /* The strategies know how to modify HTTP/1.1 requests, it's converted to HTTP/2 afterwards */
+    proxy_ud->connect_request = s_build_h1_proxy_connect_request(proxy_ud);
+    if (proxy_ud->connect_request == NULL) {
+        s_http2_tunnel_fail_without_stream(proxy_ud, aws_last_error());
+        return;
+    }
+
+    (*proxy_ud->proxy_negotiator->strategy_vtable.tunnelling_vtable->connect_request_transform)(
+        proxy_ud->proxy_negotiator,
+        proxy_ud->connect_request,
+        s_terminate_http2_tunnel_connect,
+        s_continue_http2_tunnel_connect,
+        proxy_ud);
+}
+
+/*
+ * Opens a tunnel as a CONNECT stream on one of the proxy's HTTP/2 connections, instead of a connection of its own.
+ * Takes ownership of the user data, setup is always reported asynchronously.
+ */
+static int s_connect_via_http2_tunnel(struct aws_http_proxy_user_data *proxy_ud) {
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_CONNECTION,
+        "(STATIC) Opening tunnel to \"%s\" as HTTP/2 stream on proxy connection",
+        (char *)proxy_ud->original_host->bytes);
+
+    aws_byte_buf_init(&proxy_ud->http2.pending_read_data, proxy_ud->allocator, 0);
+    aws_linked_list_init(&proxy_ud->http2.pending_writes);
+
+    s_http2_tunnel_make_connect_request(proxy_ud);
+    return AWS_OP_SUCCESS;
+}
+
 /*
  * Top-level function to route a connection through a proxy server via a CONNECT request
  */
@@ -1123,6 +1911,10 @@ static int s_aws_http_client_connect_via_tunneling_proxy(
         return AWS_OP_ERR;
     }
 
+    if (user_data->proxy_config->http2_stream_manager != NULL) {
+        return s_connect_via_http2_tunnel(user_data);
+    }
+
     return s_create_tunneling_connection(user_data);
 }
 
@@ -1362,6 +2154,10 @@ static struct aws_http_proxy_config *s_aws_http_proxy_config_new(
 
     config->port = proxy_options->port;
 
+    if (override_proxy_connection_type == AWS_HPCT_HTTP_TUNNEL) {
+        config->http2_stream_manager = aws_http2_stream_manager_acquire(proxy_options->http2_stream_manager);
+    }
+
     if (proxy_options->proxy_strategy != NULL) {
         config->proxy_strategy = aws_http_proxy_strategy_acquire(proxy_options->proxy_strategy);
     } else if (proxy_options->auth_type == AWS_HPAT_BASIC) {
@@ -1483,6 +2279,7 @@ struct aws_http_proxy_config *aws_http_proxy_config_new_clone(
     config->allocator = allocator;
     config->port = proxy_config->port;
     config->proxy_strategy = aws_http_proxy_strategy_acquire(proxy_config->proxy_strategy);
+    config->http2_stream_manager = aws_http2_stream_manager_acquire(proxy_config->http2_stream_manager);
 
     return config;
 
@@ -1506,6 +2303,7 @@ void aws_http_proxy_config_destroy(struct aws_http_proxy_config *config) {
     }
 
     aws_http_proxy_strategy_release(config->proxy_strategy);
+    aws_http2_stream_manager_release(config->http2_stream_manager);
 
     aws_mem_release(config->allocator, config);
 }
@@ -1520,6 +2318,7 @@ void aws_http_proxy_options_init_from_config(
     options->port = config->port;
     options->tls_options = config->tls_options;
     options->proxy_strategy = config->proxy_strategy;
+    options->http2_stream_manager = config->http2_stream_manager;
 }
 
 int aws_http_options_validate_proxy_configuration(const struct aws_http_client_connection_options *options) {
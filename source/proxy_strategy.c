@@ -5,6 +5,7 @@
 
 #include <aws/http/proxy.h>
 
+#include <aws/common/atomics.h>
 #include <aws/common/encoding.h>
 #include <aws/common/string.h>
 #include <aws/http/private/proxy_impl.h>
@@ -1328,6 +1329,7 @@ struct aws_http_proxy_strategy *aws_http_proxy_strategy_new_tunneling_adaptive(
     struct aws_http_proxy_strategy_tunneling_sequence_options sequence_config = {
         .strategies = strategies,
         .strategy_count = strategy_count,
+        .remember_successful_strategy = true,
     };
 
     adaptive_sequence_strategy = aws_http_proxy_strategy_new_tunneling_sequence(allocator, &sequence_config);
@@ -1352,14 +1354,30 @@ struct aws_http_proxy_strategy_tunneling_sequence {
 
     struct aws_array_list strategies;
 
+    /*
+     * Shared by every connection's negotiator.  If remember_successful_strategy is set, this is the index of the
+     * strategy that began the last successful negotiation, and new negotiators start from it.
+     */
+    bool remember_successful_strategy;
+    struct aws_atomic_var first_strategy_index;
+
     struct aws_http_proxy_strategy strategy_base;
 };
 
 struct aws_http_proxy_negotiator_tunneling_sequence {
     struct aws_allocator *allocator;
 
+    struct aws_http_proxy_strategy *strategy;
+
+    /*
+     * negotiators are in strategy order, but they're tried starting from first_negotiator_index, wrapping around.
+     * Positions below are in the order they're tried.
+     */
     struct aws_array_list negotiators;
+    size_t first_negotiator_index;
     size_t current_negotiator_transform_index;
+    /* Position of the negotiator that began negotiating on the current connection */
+    size_t connection_start_transform_index;
     void *original_internal_proxy_user_data;
     aws_http_proxy_negotiation_terminate_fn *original_negotiation_termination_callback;
     aws_http_proxy_negotiation_http_request_forward_fn *original_negotiation_http_request_forward_callback;
@@ -1367,6 +1385,24 @@ struct aws_http_proxy_negotiator_tunneling_sequence {
     struct aws_http_proxy_negotiator negotiator_base;
 };
 
+/* Get the negotiator at a position in the order they're tried */
+static struct aws_http_proxy_negotiator *s_sequence_get_negotiator(
+    struct aws_http_proxy_negotiator_tunneling_sequence *sequence_negotiator,
+    size_t position) {
+
+    size_t negotiator_count = aws_array_list_length(&sequence_negotiator->negotiators);
+    if (position >= negotiator_count) {
+        return NULL;
+    }
+
+    struct aws_http_proxy_negotiator *negotiator = NULL;
+    aws_array_list_get_at(
+        &sequence_negotiator->negotiators,
+        &negotiator,
+        (sequence_negotiator->first_negotiator_index + position) % negotiator_count);
+    return negotiator;
+}
+
 static void s_sequence_tunnel_iteration_termination_callback(
     struct aws_http_message *message,
     int error_code,
@@ -1404,18 +1440,12 @@ static void s_sequence_tunnel_try_next_negotiator(
     struct aws_http_message *message) {
     struct aws_http_proxy_negotiator_tunneling_sequence *sequence_negotiator = proxy_negotiator->impl;
 
-    size_t negotiator_count = aws_array_list_length(&sequence_negotiator->negotiators);
-    if (sequence_negotiator->current_negotiator_transform_index >= negotiator_count) {
-        goto on_error;
-    }
-
-    struct aws_http_proxy_negotiator *current_negotiator = NULL;
-    if (aws_array_list_get_at(
-            &sequence_negotiator->negotiators,
-            &current_negotiator,
-            sequence_negotiator->current_negotiator_transform_index++)) {
+    struct aws_http_proxy_negotiator *current_negotiator =
+        s_sequence_get_negotiator(sequence_negotiator, sequence_negotiator->current_negotiator_transform_index);
+    if (current_negotiator == NULL) {
         goto on_error;
     }
+    ++sequence_negotiator->current_negotiator_transform_index;
 
     current_negotiator->strategy_vtable.tunnelling_vtable->connect_request_transform(
         current_negotiator,
@@ -1491,6 +1521,22 @@ static int s_sequence_on_connect_status(
         }
     }
 
+    /* Later connections can skip straight to what worked, saving a round trip (or a whole connection) */
+    struct aws_http_proxy_strategy_tunneling_sequence *sequence_strategy = sequence_negotiator->strategy->impl;
+    if (sequence_strategy->remember_successful_strategy && AWS_HTTP_STATUS_CODE_200_OK == status_code &&
+        negotiator_count > 0) {
+        size_t strategy_index =
+            (sequence_negotiator->first_negotiator_index + sequence_negotiator->connection_start_transform_index) %
+            negotiator_count;
+        if (aws_atomic_exchange_int(&sequence_strategy->first_strategy_index, strategy_index) != strategy_index) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_HTTP_PROXY_NEGOTIATION,
+                "(id=%p) Proxy negotiation succeeded, later connections will start from strategy %zu",
+                (void *)proxy_negotiator,
+                strategy_index);
+        }
+    }
+
     return AWS_OP_SUCCESS;
 }
 
@@ -1520,19 +1566,16 @@ static enum aws_http_proxy_negotiation_retry_directive s_sequence_get_retry_dire
     struct aws_http_proxy_negotiator *proxy_negotiator) {
     struct aws_http_proxy_negotiator_tunneling_sequence *sequence_negotiator = proxy_negotiator->impl;
 
-    if (sequence_negotiator->current_negotiator_transform_index <
-        aws_array_list_length(&sequence_negotiator->negotiators)) {
-        struct aws_http_proxy_negotiator *next_negotiator = NULL;
-        aws_array_list_get_at(
-            &sequence_negotiator->negotiators,
-            &next_negotiator,
-            sequence_negotiator->current_negotiator_transform_index);
-
+    struct aws_http_proxy_negotiator *next_negotiator =
+        s_sequence_get_negotiator(sequence_negotiator, sequence_negotiator->current_negotiator_transform_index);
+    if (next_negotiator != NULL) {
         enum aws_http_proxy_negotiation_retry_directive next_negotiator_directive =
             aws_http_proxy_negotiator_get_retry_directive(next_negotiator);
         if (next_negotiator_directive == AWS_HPNRD_CURRENT_CONNECTION) {
             return AWS_HPNRD_CURRENT_CONNECTION;
         } else {
+            sequence_negotiator->connection_start_transform_index =
+                sequence_negotiator->current_negotiator_transform_index;
             return AWS_HPNRD_NEW_CONNECTION;
         }
     }
@@ -1562,6 +1605,7 @@ static void s_destroy_tunneling_sequence_negotiator(struct aws_http_proxy_negoti
     }
 
     aws_array_list_clean_up(&sequence_negotiator->negotiators);
+    aws_http_proxy_strategy_release(sequence_negotiator->strategy);
 
     aws_mem_release(sequence_negotiator->allocator, sequence_negotiator);
 }
@@ -1593,6 +1637,12 @@ static struct aws_http_proxy_negotiator *s_create_tunneling_sequence_negotiator(
     struct aws_http_proxy_strategy_tunneling_sequence *sequence_strategy = proxy_strategy->impl;
     size_t strategy_count = aws_array_list_length(&sequence_strategy->strategies);
 
+    sequence_negotiator->strategy = aws_http_proxy_strategy_acquire(proxy_strategy);
+    if (strategy_count > 0) {
+        sequence_negotiator->first_negotiator_index =
+            aws_atomic_load_int(&sequence_strategy->first_strategy_index) % strategy_count;
+    }
+
     if (aws_array_list_init_dynamic(
             &sequence_negotiator->negotiators, allocator, strategy_count, sizeof(struct aws_http_proxy_negotiator *))) {
         goto on_error;
@@ -1665,6 +1715,8 @@ struct aws_http_proxy_strategy *aws_http_proxy_strategy_new_tunneling_sequence(
     sequence_strategy->strategy_base.vtable = &s_tunneling_sequence_strategy_vtable;
     sequence_strategy->strategy_base.proxy_connection_type = AWS_HPCT_HTTP_TUNNEL;
     sequence_strategy->allocator = allocator;
+    sequence_strategy->remember_successful_strategy = config->remember_successful_strategy;
+    aws_atomic_init_int(&sequence_strategy->first_strategy_index, 0);
 
     aws_ref_count_init(
         &sequence_strategy->strategy_base.ref_count,
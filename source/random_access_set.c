@@ -185,3 +185,189 @@ int aws_random_access_set_random_get_ptr_index(const struct aws_random_access_se
     AWS_PRECONDITION(out != NULL);
     return aws_array_list_get_at(&set->impl->list, (void *)out, index);
 }
+
+static struct aws_intrusive_random_access_set_node *s_intrusive_get(
+    const struct aws_intrusive_random_access_set *set,
+    size_t index) {
+    struct aws_intrusive_random_access_set_node **node_ptr = NULL;
+    aws_array_list_get_at_ptr(&set->list, (void **)&node_ptr, index);
+    return *node_ptr;
+}
+
+static void s_intrusive_set(
+    struct aws_intrusive_random_access_set *set,
+    size_t index,
+    struct aws_intrusive_random_access_set_node *node) {
+    struct aws_intrusive_random_access_set_node **node_ptr = NULL;
+    aws_array_list_get_at_ptr(&set->list, (void **)&node_ptr, index);
+    *node_ptr = node;
+    node->index = index;
+}
+
+/* Returns the final index of the node */
+static size_t s_intrusive_sift_up(struct aws_intrusive_random_access_set *set, size_t index) {
+    struct aws_intrusive_random_access_set_node *node = s_intrusive_get(set, index);
+    while (index > 0) {
+        size_t parent_index = (index - 1) / 2;
+        struct aws_intrusive_random_access_set_node *parent = s_intrusive_get(set, parent_index);
+        if (!set->less_fn(node, parent)) {
+            break;
+        }
+        s_intrusive_set(set, index, parent);
+        index = parent_index;
+    }
+    s_intrusive_set(set, index, node);
+    return index;
+}
+
+static void s_intrusive_sift_down(struct aws_intrusive_random_access_set *set, size_t index) {
+    size_t length = aws_array_list_length(&set->list);
+    struct aws_intrusive_random_access_set_node *node = s_intrusive_get(set, index);
+    while (true) {
+        size_t child_index = index * 2 + 1;
+        if (child_index >= length) {
+            break;
+        }
+        struct aws_intrusive_random_access_set_node *child = s_intrusive_get(set, child_index);
+        if (child_index + 1 < length) {
+            struct aws_intrusive_random_access_set_node *right = s_intrusive_get(set, child_index + 1);
+            if (set->less_fn(right, child)) {
+                child = right;
+                ++child_index;
+            }
+        }
+        if (!set->less_fn(child, node)) {
+            break;
+        }
+        s_intrusive_set(set, index, child);
+        index = child_index;
+    }
+    s_intrusive_set(set, index, node);
+}
+
+static void s_intrusive_restore_order(struct aws_intrusive_random_access_set *set, size_t index) {
+    if (set->less_fn && s_intrusive_sift_up(set, index) == index) {
+        s_intrusive_sift_down(set, index);
+    }
+}
+
+int aws_intrusive_random_access_set_init(
+    struct aws_intrusive_random_access_set *set,
+    struct aws_allocator *allocator,
+    aws_intrusive_random_access_set_less_fn *less_fn,
+    size_t initial_item_allocation) {
+    AWS_FATAL_PRECONDITION(set);
+    AWS_FATAL_PRECONDITION(allocator);
+    AWS_ZERO_STRUCT(*set);
+    set->less_fn = less_fn;
+    return aws_array_list_init_dynamic(
+        &set->list, allocator, initial_item_allocation, sizeof(struct aws_intrusive_random_access_set_node *));
+}
+
+void aws_intrusive_random_access_set_clean_up(struct aws_intrusive_random_access_set *set) {
+    if (!set) {
+        return;
+    }
+    size_t length = aws_array_list_length(&set->list);
+    for (size_t i = 0; i < length; ++i) {
+        s_intrusive_get(set, i)->owner = NULL;
+    }
+    aws_array_list_clean_up(&set->list);
+}
+
+int aws_intrusive_random_access_set_add(
+    struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node *node,
+    bool *added) {
+    AWS_PRECONDITION(set);
+    AWS_PRECONDITION(node);
+    AWS_PRECONDITION(added);
+    AWS_PRECONDITION(node->owner == NULL || node->owner == set);
+    if (node->owner == set) {
+        *added = false;
+        return AWS_OP_SUCCESS;
+    }
+    if (aws_array_list_push_back(&set->list, (void *)&node)) {
+        *added = false;
+        return AWS_OP_ERR;
+    }
+    node->owner = set;
+    node->index = aws_array_list_length(&set->list) - 1;
+    if (set->less_fn) {
+        s_intrusive_sift_up(set, node->index);
+    }
+    *added = true;
+    return AWS_OP_SUCCESS;
+}
+
+void aws_intrusive_random_access_set_remove(
+    struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node *node) {
+    AWS_PRECONDITION(set);
+    AWS_PRECONDITION(node);
+    if (node->owner != set) {
+        /* It's removed already */
+        return;
+    }
+    size_t index_to_remove = node->index;
+    size_t last_index = aws_array_list_length(&set->list) - 1;
+    if (index_to_remove != last_index) {
+        /* Move the last one into the hole */
+        s_intrusive_set(set, index_to_remove, s_intrusive_get(set, last_index));
+    }
+    aws_array_list_pop_back(&set->list);
+    if (index_to_remove != last_index) {
+        s_intrusive_restore_order(set, index_to_remove);
+    }
+    node->owner = NULL;
+}
+
+bool aws_intrusive_random_access_set_exist(
+    const struct aws_intrusive_random_access_set *set,
+    const struct aws_intrusive_random_access_set_node *node) {
+    AWS_PRECONDITION(set);
+    AWS_PRECONDITION(node);
+    return node->owner == set;
+}
+
+size_t aws_intrusive_random_access_set_get_size(const struct aws_intrusive_random_access_set *set) {
+    return aws_array_list_length(&set->list);
+}
+
+int aws_intrusive_random_access_set_random_get(
+    const struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node **out) {
+    AWS_PRECONDITION(set);
+    AWS_PRECONDITION(out != NULL);
+    size_t length = aws_array_list_length(&set->list);
+    if (length == 0) {
+        return aws_raise_error(AWS_ERROR_LIST_EMPTY);
+    }
+
+    uint64_t random_64_bit_num = 0;
+    aws_device_random_u64(&random_64_bit_num);
+    *out = s_intrusive_get(set, (size_t)random_64_bit_num % length);
+    return AWS_OP_SUCCESS;
+}
+
+int aws_intrusive_random_access_set_get_index(
+    const struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node **out,
+    size_t index) {
+    AWS_PRECONDITION(set);
+    AWS_PRECONDITION(out != NULL);
+    if (index >= aws_array_list_length(&set->list)) {
+        return aws_raise_error(AWS_ERROR_INVALID_INDEX);
+    }
+    *out = s_intrusive_get(set, index);
+    return AWS_OP_SUCCESS;
+}
+
+void aws_intrusive_random_access_set_update(
+    struct aws_intrusive_random_access_set *set,
+    struct aws_intrusive_random_access_set_node *node) {
+    AWS_PRECONDITION(set);
+    AWS_PRECONDITION(node);
+    AWS_PRECONDITION(node->owner == set);
+    s_intrusive_restore_order(set, node->index);
+}
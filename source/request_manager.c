@@ -0,0 +1,1165 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/request_manager.h>
+
+#include <aws/common/array_list.h>
+#include <aws/common/atomics.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/logging.h>
+#include <aws/common/mutex.h>
+#include <aws/common/ref_count.h>
+#include <aws/common/string.h>
+#include <aws/http/connection.h>
+#include <aws/http/connection_manager.h>
+#include <aws/http/http2_stream_manager.h>
+#include <aws/http/private/connection_impl.h>
+#include <aws/http/private/request_manager_system_vtable.h>
+#include <aws/http/private/request_response_impl.h>
+#include <aws/http/request_response.h>
+#include <aws/http/status_code.h>
+#include <aws/io/tls_channel_handler.h>
+
+#define REQUEST_MANAGER_LOGF(level, manager, text, ...)                                                                \
+    AWS_LOGF_##level(AWS_LS_HTTP_CONNECTION_MANAGER, "id=%p: " text, (void *)(manager), __VA_ARGS__)
+#define REQUEST_MANAGER_LOG(level, manager, text) REQUEST_MANAGER_LOGF(level, manager, "%s", text)
+
+static const char *s_alpn_list = "h2;http/1.1";
+
+static struct aws_http_request_manager_system_vtable s_default_system_vtable = {
+    .aws_http_connection_manager_acquire_connection = aws_http_connection_manager_acquire_connection,
+    .aws_http_connection_manager_release_connection = aws_http_connection_manager_release_connection,
+    .aws_http2_stream_manager_acquire_stream = aws_http2_stream_manager_acquire_stream,
+};
+
+const struct aws_http_request_manager_system_vtable *g_aws_http_request_manager_default_system_vtable_ptr =
+    &s_default_system_vtable;
+
+bool aws_http_request_manager_system_vtable_is_valid(const struct aws_http_request_manager_system_vtable *table) {
+    return table->aws_http_connection_manager_acquire_connection &&
+           table->aws_http_connection_manager_release_connection && table->aws_http2_stream_manager_acquire_stream;
+}
+
+struct aws_http_request_manager {
+    struct aws_allocator *allocator;
+    const struct aws_http_request_manager_system_vtable *system_vtable;
+
+    /* Held by the user. Once it drops to zero, the sub-managers are released */
+    struct aws_ref_count external_ref_count;
+    /* One for the external refcount, one per sub-manager that hasn't finished shutting down,
+     * and one while a connection is being acquired to learn the protocol */
+    struct aws_ref_count internal_ref_count;
+
+    aws_http_request_manager_shutdown_complete_fn *shutdown_complete_callback;
+    void *shutdown_complete_user_data;
+
+    /* Whether identical GETs share a stream, and the names (aws_string *) of the headers that tell them apart */
+    bool enable_request_coalescing;
+    struct aws_array_list coalescing_header_names;
+
+    /* Any thread may touch this data, but the lock must be held */
+    struct {
+        struct aws_mutex lock;
+
+        /* AWS_HTTP_VERSION_UNKNOWN until the first connection negotiates. Doesn't change after that */
+        enum aws_http_version version;
+
+        /* Whether a connection is being acquired to learn the protocol, and from which connection manager.
+         * That connection manager outlives the connection, even if it's released in the meantime */
+        bool is_learning_version;
+        struct aws_http_connection_manager *learning_connection_manager;
+
+        /* aws_http_request_manager_request, waiting for the protocol to be learned */
+        struct aws_linked_list pending_requests;
+
+        /* NULL once released: when the user is done with the manager,
+         * or when the endpoint turned out to speak the other protocol */
+        struct aws_http_connection_manager *connection_manager;
+        struct aws_http2_stream_manager *stream_manager;
+
+        /* Coalescing key (aws_string *) -> aws_http_request_flight, for GETs whose response hasn't begun */
+        struct aws_hash_table flights;
+    } synced_data;
+};
+
+/* A request that hasn't been handed off yet, or that's running on a leased HTTP/1.1 connection */
+struct aws_http_request_manager_request {
+    struct aws_allocator *allocator;
+    struct aws_linked_list_node node;
+    struct aws_http_request_manager *manager;
+
+    aws_http_request_manager_on_stream_acquired_fn *callback;
+    void *user_data;
+
+    /* The user's options, with the request kept alive until the stream is made */
+    struct aws_http_make_request_options options;
+    struct aws_http_message *request;
+
+    /* HTTP/1.1 only. The connection is released back to its manager when the stream completes */
+    struct aws_http_connection_manager *connection_manager;
+    struct aws_http_connection *connection;
+    /* The user was told the stream failed, so they don't hear about its destruction either */
+    bool is_failed;
+};
+
+static void s_lock_synced_data(struct aws_http_request_manager *manager) {
+    int err = aws_mutex_lock(&manager->synced_data.lock);
+    AWS_ASSERT(!err && "lock failed");
+    (void)err;
+}
+
+static void s_unlock_synced_data(struct aws_http_request_manager *manager) {
+    int err = aws_mutex_unlock(&manager->synced_data.lock);
+    AWS_ASSERT(!err && "unlock failed");
+    (void)err;
+}
+
+static void s_request_destroy(struct aws_http_request_manager_request *request) {
+    aws_http_message_release(request->request);
+    aws_mem_release(request->allocator, request);
+}
+
+static void s_request_fail(struct aws_http_request_manager_request *request, int error_code) {
+    REQUEST_MANAGER_LOGF(
+        ERROR,
+        request->manager,
+        "request:%p failed with error: %d(%s).",
+        (void *)request,
+        error_code,
+        aws_error_str(error_code));
+    request->callback(NULL, error_code, request->user_data);
+    s_request_destroy(request);
+}
+
+/*
+ * HTTP/2: hand the request to the stream manager, which multiplexes it with the others
+ */
+
+static void s_request_send_h2(
+    struct aws_http2_stream_manager *stream_manager,
+    struct aws_http_request_manager_request *request) {
+
+    struct aws_http2_stream_manager_acquire_stream_options acquire_options = {
+        .callback = request->callback,
+        .user_data = request->user_data,
+        .options = &request->options,
+    };
+    /* The stream manager copies what it needs */
+    request->manager->system_vtable->aws_http2_stream_manager_acquire_stream(stream_manager, &acquire_options);
+    s_request_destroy(request);
+}
+
+/*
+ * HTTP/1.1: lease a connection for the request, and release it once the stream completes.
+ * The stream's callbacks go through the request, so it knows when that is.
+ */
+
+static int s_on_h1_incoming_headers(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    const struct aws_http_header *header_array,
+    size_t num_headers,
+    void *user_data) {
+
+    struct aws_http_request_manager_request *request = user_data;
+    if (request->options.on_response_headers) {
+        return request->options.on_response_headers(
+            stream, header_block, header_array, num_headers, request->options.user_data);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_h1_incoming_header_block_done(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    void *user_data) {
+
+    struct aws_http_request_manager_request *request = user_data;
+    if (request->options.on_response_header_block_done) {
+        return request->options.on_response_header_block_done(stream, header_block, request->options.user_data);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_h1_incoming_body(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
+    struct aws_http_request_manager_request *request = user_data;
+    if (request->options.on_response_body) {
+        return request->options.on_response_body(stream, data, request->options.user_data);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_h1_stream_metrics(
+    struct aws_http_stream *stream,
+    const struct aws_http_stream_metrics *metrics,
+    void *user_data) {
+
+    struct aws_http_request_manager_request *request = user_data;
+    if (request->options.on_metrics) {
+        request->options.on_metrics(stream, metrics, request->options.user_data);
+    }
+}
+
+static void s_release_connection(struct aws_http_request_manager_request *request) {
+    if (request->connection != NULL) {
+        request->manager->system_vtable->aws_http_connection_manager_release_connection(
+            request->connection_manager, request->connection);
+        request->connection = NULL;
+    }
+}
+
+static void s_on_h1_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct aws_http_request_manager_request *request = user_data;
+    if (request->options.on_complete) {
+        request->options.on_complete(stream, error_code, request->options.user_data);
+    }
+    s_release_connection(request);
+}
+
+static void s_on_h1_stream_destroy(void *user_data) {
+    struct aws_http_request_manager_request *request = user_data;
+    if (request->options.on_destroy && !request->is_failed) {
+        request->options.on_destroy(request->options.user_data);
+    }
+    s_request_destroy(request);
+}
+
+static void s_request_send_h1(
+    struct aws_http_request_manager_request *request,
+    struct aws_http_connection *connection) {
+    request->connection = connection;
+
+    struct aws_http_make_request_options options = request->options;
+    options.request = request->request;
+    options.on_response_headers = s_on_h1_incoming_headers;
+    options.on_response_header_block_done = s_on_h1_incoming_header_block_done;
+    options.on_response_body = s_on_h1_incoming_body;
+    options.on_metrics = s_on_h1_stream_metrics;
+    options.on_complete = s_on_h1_stream_complete;
+    options.on_destroy = s_on_h1_stream_destroy;
+    options.user_data = request;
+
+    struct aws_http_stream *stream = aws_http_connection_make_request(connection, &options);
+    if (!stream) {
+        s_release_connection(request);
+        s_request_fail(request, aws_last_error());
+        return;
+    }
+
+    if (aws_http_stream_activate(stream)) {
+        /* on_complete won't be invoked. The stream's destruction cleans up the request */
+        int error_code = aws_last_error();
+        REQUEST_MANAGER_LOGF(
+            ERROR,
+            request->manager,
+            "request:%p failed as stream activate failed with error: %d(%s).",
+            (void *)request,
+            error_code,
+            aws_error_str(error_code));
+        request->is_failed = true;
+        request->callback(NULL, error_code, request->user_data);
+        s_release_connection(request);
+        aws_http_stream_release(stream);
+        return;
+    }
+
+    /* The stream holds its own reference to the message now */
+    request->request = aws_http_message_release(request->request);
+    request->callback(stream, AWS_ERROR_SUCCESS, request->user_data);
+}
+
+static void s_on_h1_connection_acquired(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct aws_http_request_manager_request *request = user_data;
+    if (error_code || !connection) {
+        s_request_fail(request, error_code ? error_code : AWS_ERROR_UNKNOWN);
+        return;
+    }
+    s_request_send_h1(request, connection);
+}
+
+static void s_request_lease_h1(
+    struct aws_http_connection_manager *connection_manager,
+    struct aws_http_request_manager_request *request) {
+
+    request->connection_manager = connection_manager;
+    request->manager->system_vtable->aws_http_connection_manager_acquire_connection(
+        connection_manager, s_on_h1_connection_acquired, request);
+}
+
+/*
+ * The first connection tells us the protocol, and sends the requests that waited for it on their way
+ */
+
+static void s_on_version_learned(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct aws_http_request_manager *manager = user_data;
+
+    struct aws_linked_list pending_requests;
+    aws_linked_list_init(&pending_requests);
+    struct aws_http_connection_manager *connection_manager = NULL;
+    struct aws_http_connection_manager *connection_manager_to_release = NULL;
+    struct aws_http2_stream_manager *stream_manager = NULL;
+    struct aws_http2_stream_manager *stream_manager_to_release = NULL;
+    enum aws_http_version version = AWS_HTTP_VERSION_UNKNOWN;
+
+    if (!error_code && connection) {
+        version = aws_http_connection_get_version(connection) == AWS_HTTP_VERSION_2 ? AWS_HTTP_VERSION_2
+                                                                                    : AWS_HTTP_VERSION_1_1;
+    }
+
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(manager);
+        manager->synced_data.is_learning_version = false;
+        aws_linked_list_swap_contents(&pending_requests, &manager->synced_data.pending_requests);
+        connection_manager = manager->synced_data.learning_connection_manager;
+        manager->synced_data.learning_connection_manager = NULL;
+        stream_manager = manager->synced_data.stream_manager;
+
+        if (version == AWS_HTTP_VERSION_2 && stream_manager != NULL) {
+            manager->synced_data.version = version;
+            /* No more leases. The connection manager shuts down once this connection is back */
+            connection_manager_to_release = manager->synced_data.connection_manager;
+            manager->synced_data.connection_manager = NULL;
+        } else if (version == AWS_HTTP_VERSION_1_1 && manager->synced_data.connection_manager != NULL) {
+            manager->synced_data.version = version;
+            stream_manager_to_release = stream_manager;
+            manager->synced_data.stream_manager = NULL;
+        } else if (version != AWS_HTTP_VERSION_UNKNOWN) {
+            /* The user released the manager in the meantime */
+            error_code = AWS_ERROR_HTTP_CONNECTION_MANAGER_SHUTTING_DOWN;
+        }
+        s_unlock_synced_data(manager);
+    } /* END CRITICAL SECTION */
+
+    if (error_code || !connection) {
+        error_code = error_code ? error_code : AWS_ERROR_UNKNOWN;
+        REQUEST_MANAGER_LOGF(
+            ERROR,
+            manager,
+            "Failed to learn the endpoint's protocol, error: %d(%s)",
+            error_code,
+            aws_error_str(error_code));
+        if (connection) {
+            manager->system_vtable->aws_http_connection_manager_release_connection(connection_manager, connection);
+        }
+        while (!aws_linked_list_empty(&pending_requests)) {
+            struct aws_linked_list_node *node = aws_linked_list_pop_front(&pending_requests);
+            s_request_fail(AWS_CONTAINER_OF(node, struct aws_http_request_manager_request, node), error_code);
+        }
+        goto done;
+    }
+
+    REQUEST_MANAGER_LOGF(
+        INFO,
+        manager,
+        "Endpoint speaks %s, %s",
+        version == AWS_HTTP_VERSION_2 ? "HTTP/2" : "HTTP/1.1",
+        version == AWS_HTTP_VERSION_2 ? "multiplexing requests" : "pooling connections");
+
+    if (version == AWS_HTTP_VERSION_2) {
+        manager->system_vtable->aws_http_connection_manager_release_connection(connection_manager, connection);
+        aws_http_connection_manager_release(connection_manager_to_release);
+        while (!aws_linked_list_empty(&pending_requests)) {
+            struct aws_linked_list_node *node = aws_linked_list_pop_front(&pending_requests);
+            s_request_send_h2(stream_manager, AWS_CONTAINER_OF(node, struct aws_http_request_manager_request, node));
+        }
+    } else {
+        aws_http2_stream_manager_release(stream_manager_to_release);
+        /* The first request gets the connection already made, the rest lease their own */
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&pending_requests);
+        struct aws_http_request_manager_request *first =
+            AWS_CONTAINER_OF(node, struct aws_http_request_manager_request, node);
+        first->connection_manager = connection_manager;
+        while (!aws_linked_list_empty(&pending_requests)) {
+            node = aws_linked_list_pop_front(&pending_requests);
+            s_request_lease_h1(
+                connection_manager, AWS_CONTAINER_OF(node, struct aws_http_request_manager_request, node));
+        }
+        s_request_send_h1(first, connection);
+    }
+
+done:
+    aws_ref_count_release(&manager->internal_ref_count);
+}
+
+static void s_request_manager_make_request(
+    struct aws_http_request_manager *manager,
+    aws_http_request_manager_on_stream_acquired_fn *callback,
+    void *user_data,
+    const struct aws_http_make_request_options *options) {
+
+    struct aws_http_request_manager_request *request =
+        aws_mem_calloc(manager->allocator, 1, sizeof(struct aws_http_request_manager_request));
+    request->allocator = manager->allocator;
+    request->manager = manager;
+    request->callback = callback;
+    request->user_data = user_data;
+    request->options = *options;
+    request->request = aws_http_message_acquire(request->options.request);
+
+    enum aws_http_version version = AWS_HTTP_VERSION_UNKNOWN;
+    bool should_learn_version = false;
+    struct aws_http_connection_manager *connection_manager = NULL;
+    struct aws_http2_stream_manager *stream_manager = NULL;
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(manager);
+        version = manager->synced_data.version;
+        connection_manager = manager->synced_data.connection_manager;
+        stream_manager = manager->synced_data.stream_manager;
+        if (version == AWS_HTTP_VERSION_UNKNOWN) {
+            aws_linked_list_push_back(&manager->synced_data.pending_requests, &request->node);
+            if (!manager->synced_data.is_learning_version) {
+                manager->synced_data.is_learning_version = true;
+                manager->synced_data.learning_connection_manager = connection_manager;
+                should_learn_version = true;
+                aws_ref_count_acquire(&manager->internal_ref_count);
+            }
+        }
+        s_unlock_synced_data(manager);
+    } /* END CRITICAL SECTION */
+
+    switch (version) {
+        case AWS_HTTP_VERSION_UNKNOWN:
+            if (should_learn_version) {
+                REQUEST_MANAGER_LOG(DEBUG, manager, "Connecting to learn the endpoint's protocol");
+                manager->system_vtable->aws_http_connection_manager_acquire_connection(
+                    connection_manager, s_on_version_learned, manager);
+            }
+            break;
+        case AWS_HTTP_VERSION_2:
+            s_request_send_h2(stream_manager, request);
+            break;
+        default:
+            s_request_lease_h1(connection_manager, request);
+            break;
+    }
+}
+
+/*
+ * Coalescing: a GET identical to one already in flight shares its stream, instead of making another request.
+ * Every requester, the first included, gets a coalesced stream of its own, which hears everything the shared
+ * stream hears. The response is passed to each of them in turn, so its headers and body are never copied.
+ */
+
+/* Identical GETs sharing one stream */
+struct aws_http_request_flight {
+    struct aws_allocator *allocator;
+    struct aws_http_request_manager *manager;
+    struct aws_string *key;
+
+    /* Protected by the manager's lock */
+    struct {
+        /* Identical GETs may join until the response begins, or the shared stream fails to be made.
+         * Then the flight leaves the manager's table, and its list of streams doesn't change again */
+        bool is_joinable;
+        /* Set once the shared stream is made. Coalesced streams joining after that are ready right away */
+        bool is_acquired;
+        struct aws_http_connection *connection;
+        uint32_t stream_id;
+
+        /* aws_http_coalesced_stream */
+        struct aws_linked_list streams;
+        size_t num_streams;
+    } synced_data;
+
+    /* Only touched by the shared stream's callbacks */
+    bool is_response_begun;
+};
+
+/* One requester's share of a flight. Cancelling it only detaches that requester */
+struct aws_http_coalesced_stream {
+    struct aws_http_stream base;
+    struct aws_linked_list_node node;
+
+    aws_http_request_manager_on_stream_acquired_fn *callback;
+    void *callback_user_data;
+
+    /* Set once on_complete is invoked, by whichever got there first: the shared stream, or a cancel */
+    struct aws_atomic_var is_complete;
+};
+
+static void s_coalesced_stream_destroy(struct aws_http_stream *stream) {
+    aws_mem_release(stream->alloc, stream);
+}
+
+static void s_coalesced_stream_update_window(struct aws_http_stream *stream, size_t increment_size) {
+    /* The request manager's streams don't manage their windows */
+    (void)stream;
+    (void)increment_size;
+}
+
+static int s_coalesced_stream_activate(struct aws_http_stream *stream) {
+    /* Already active, like every stream the request manager hands out */
+    (void)stream;
+    return AWS_OP_SUCCESS;
+}
+
+static bool s_coalesced_stream_is_complete(struct aws_http_coalesced_stream *coalesced_stream) {
+    return aws_atomic_load_int(&coalesced_stream->is_complete) != 0;
+}
+
+static void s_coalesced_stream_complete(struct aws_http_coalesced_stream *coalesced_stream, int error_code) {
+    size_t expected = 0;
+    if (!aws_atomic_compare_exchange_int(&coalesced_stream->is_complete, &expected, 1)) {
+        return;
+    }
+    if (coalesced_stream->base.on_complete) {
+        coalesced_stream->base.on_complete(&coalesced_stream->base, error_code, coalesced_stream->base.user_data);
+    }
+}
+
+static void s_coalesced_stream_cancel(struct aws_http_stream *stream, int error_code) {
+    /* The others may still want the response, so the shared stream carries on */
+    s_coalesced_stream_complete(AWS_CONTAINER_OF(stream, struct aws_http_coalesced_stream, base), error_code);
+}
+
+static const struct aws_http_stream_vtable s_coalesced_stream_vtable = {
+    .destroy = s_coalesced_stream_destroy,
+    .update_window = s_coalesced_stream_update_window,
+    .activate = s_coalesced_stream_activate,
+    .cancel = s_coalesced_stream_cancel,
+};
+
+static struct aws_http_coalesced_stream *s_coalesced_stream_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_request_manager_acquire_stream_options *acquire_stream_options) {
+
+    const struct aws_http_make_request_options *options = acquire_stream_options->options;
+    struct aws_http_coalesced_stream *coalesced_stream =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_http_coalesced_stream));
+    coalesced_stream->base.vtable = &s_coalesced_stream_vtable;
+    coalesced_stream->base.alloc = allocator;
+    coalesced_stream->base.user_data = options->user_data;
+    coalesced_stream->base.on_incoming_headers = options->on_response_headers;
+    coalesced_stream->base.on_incoming_header_block_done = options->on_response_header_block_done;
+    coalesced_stream->base.on_incoming_body = options->on_response_body;
+    coalesced_stream->base.on_metrics = options->on_metrics;
+    coalesced_stream->base.on_complete = options->on_complete;
+    coalesced_stream->base.on_destroy = options->on_destroy;
+    /* One for the user, one for the flight */
+    aws_atomic_init_int(&coalesced_stream->base.refcount, 2);
+    coalesced_stream->base.request_method = AWS_HTTP_METHOD_GET;
+    coalesced_stream->base.client_data = &coalesced_stream->base.client_or_server_data.client;
+    coalesced_stream->base.client_data->response_status = AWS_HTTP_STATUS_CODE_UNKNOWN;
+    coalesced_stream->callback = acquire_stream_options->callback;
+    coalesced_stream->callback_user_data = acquire_stream_options->user_data;
+    aws_atomic_init_int(&coalesced_stream->is_complete, 0);
+    return coalesced_stream;
+}
+
+/* The shared stream was made. NOTE: the manager's lock must be held */
+static void s_coalesced_stream_set_acquired_synced(
+    struct aws_http_coalesced_stream *coalesced_stream,
+    struct aws_http_request_flight *flight) {
+
+    coalesced_stream->base.id = flight->synced_data.stream_id;
+    coalesced_stream->base.owning_connection = flight->synced_data.connection;
+    aws_http_connection_acquire(flight->synced_data.connection);
+}
+
+static void s_flight_destroy(struct aws_http_request_flight *flight) {
+    struct aws_http_request_manager *manager = flight->manager;
+    while (!aws_linked_list_empty(&flight->synced_data.streams)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&flight->synced_data.streams);
+        aws_http_stream_release(&AWS_CONTAINER_OF(node, struct aws_http_coalesced_stream, node)->base);
+    }
+    aws_string_destroy(flight->key);
+    aws_mem_release(flight->allocator, flight);
+    aws_ref_count_release(&manager->internal_ref_count);
+}
+
+/* No one joins from now on. NOTE: the manager's lock must be held */
+static void s_flight_close_synced(struct aws_http_request_flight *flight) {
+    if (flight->synced_data.is_joinable) {
+        flight->synced_data.is_joinable = false;
+        aws_hash_table_remove(&flight->manager->synced_data.flights, flight->key, NULL, NULL);
+    }
+}
+
+static void s_flight_begin_response(struct aws_http_request_flight *flight) {
+    if (flight->is_response_begun) {
+        return;
+    }
+    flight->is_response_begun = true;
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(flight->manager);
+        s_flight_close_synced(flight);
+        s_unlock_synced_data(flight->manager);
+    } /* END CRITICAL SECTION */
+}
+
+/* The callbacks below are the shared stream's. Once the response begins, the list of streams is settled */
+
+static int s_on_flight_incoming_headers(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    const struct aws_http_header *header_array,
+    size_t num_headers,
+    void *user_data) {
+
+    struct aws_http_request_flight *flight = user_data;
+    s_flight_begin_response(flight);
+
+    int status = AWS_HTTP_STATUS_CODE_UNKNOWN;
+    aws_http_stream_get_incoming_response_status(stream, &status);
+
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&flight->synced_data.streams);
+         node != aws_linked_list_end(&flight->synced_data.streams);
+         node = aws_linked_list_next(node)) {
+        struct aws_http_coalesced_stream *coalesced_stream =
+            AWS_CONTAINER_OF(node, struct aws_http_coalesced_stream, node);
+        if (s_coalesced_stream_is_complete(coalesced_stream)) {
+            continue;
+        }
+        coalesced_stream->base.client_data->response_status = status;
+        if (coalesced_stream->base.on_incoming_headers &&
+            coalesced_stream->base.on_incoming_headers(
+                &coalesced_stream->base, header_block, header_array, num_headers, coalesced_stream->base.user_data)) {
+            s_coalesced_stream_complete(coalesced_stream, aws_last_error());
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_flight_incoming_header_block_done(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    void *user_data) {
+
+    (void)stream;
+    struct aws_http_request_flight *flight = user_data;
+    s_flight_begin_response(flight);
+
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&flight->synced_data.streams);
+         node != aws_linked_list_end(&flight->synced_data.streams);
+         node = aws_linked_list_next(node)) {
+        struct aws_http_coalesced_stream *coalesced_stream =
+            AWS_CONTAINER_OF(node, struct aws_http_coalesced_stream, node);
+        if (s_coalesced_stream_is_complete(coalesced_stream)) {
+            continue;
+        }
+        if (coalesced_stream->base.on_incoming_header_block_done &&
+            coalesced_stream->base.on_incoming_header_block_done(
+                &coalesced_stream->base, header_block, coalesced_stream->base.user_data)) {
+            s_coalesced_stream_complete(coalesced_stream, aws_last_error());
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_flight_incoming_body(
+    struct aws_http_stream *stream,
+    const struct aws_byte_cursor *data,
+    void *user_data) {
+
+    (void)stream;
+    struct aws_http_request_flight *flight = user_data;
+    s_flight_begin_response(flight);
+
+    /* Everyone reads the same bytes, the shared stream's cursor isn't copied */
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&flight->synced_data.streams);
+         node != aws_linked_list_end(&flight->synced_data.streams);
+         node = aws_linked_list_next(node)) {
+        struct aws_http_coalesced_stream *coalesced_stream =
+            AWS_CONTAINER_OF(node, struct aws_http_coalesced_stream, node);
+        if (s_coalesced_stream_is_complete(coalesced_stream)) {
+            continue;
+        }
+        if (coalesced_stream->base.on_incoming_body &&
+            coalesced_stream->base.on_incoming_body(&coalesced_stream->base, data, coalesced_stream->base.user_data)) {
+            s_coalesced_stream_complete(coalesced_stream, aws_last_error());
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_flight_stream_metrics(
+    struct aws_http_stream *stream,
+    const struct aws_http_stream_metrics *metrics,
+    void *user_data) {
+
+    (void)stream;
+    struct aws_http_request_flight *flight = user_data;
+    s_flight_begin_response(flight);
+
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&flight->synced_data.streams);
+         node != aws_linked_list_end(&flight->synced_data.streams);
+         node = aws_linked_list_next(node)) {
+        struct aws_http_coalesced_stream *coalesced_stream =
+            AWS_CONTAINER_OF(node, struct aws_http_coalesced_stream, node);
+        if (s_coalesced_stream_is_complete(coalesced_stream)) {
+            continue;
+        }
+        coalesced_stream->base.metrics = *metrics;
+        if (coalesced_stream->base.on_metrics) {
+            coalesced_stream->base.on_metrics(&coalesced_stream->base, metrics, coalesced_stream->base.user_data);
+        }
+    }
+}
+
+static void s_on_flight_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct aws_http_request_flight *flight = user_data;
+    s_flight_begin_response(flight);
+
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&flight->synced_data.streams);
+         node != aws_linked_list_end(&flight->synced_data.streams);
+         node = aws_linked_list_next(node)) {
+        s_coalesced_stream_complete(AWS_CONTAINER_OF(node, struct aws_http_coalesced_stream, node), error_code);
+    }
+}
+
+static void s_on_flight_stream_destroy(void *user_data) {
+    s_flight_destroy(user_data);
+}
+
+static void s_on_flight_stream_acquired(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct aws_http_request_flight *flight = user_data;
+    struct aws_http_request_manager *manager = flight->manager;
+
+    /* Streams joining from now on are told by whoever joins them, these are the ones waiting until now */
+    struct aws_array_list waiting_streams;
+    AWS_ZERO_STRUCT(waiting_streams);
+
+    if (!error_code && stream) {
+        { /* BEGIN CRITICAL SECTION */
+            s_lock_synced_data(manager);
+            flight->synced_data.is_acquired = true;
+            flight->synced_data.connection = aws_http_stream_get_connection(stream);
+            flight->synced_data.stream_id = aws_http_stream_get_id(stream);
+            aws_array_list_init_dynamic(
+                &waiting_streams,
+                flight->allocator,
+                flight->synced_data.num_streams,
+                sizeof(struct aws_http_coalesced_stream *));
+            for (struct aws_linked_list_node *node = aws_linked_list_begin(&flight->synced_data.streams);
+                 node != aws_linked_list_end(&flight->synced_data.streams);
+                 node = aws_linked_list_next(node)) {
+                struct aws_http_coalesced_stream *coalesced_stream =
+                    AWS_CONTAINER_OF(node, struct aws_http_coalesced_stream, node);
+                s_coalesced_stream_set_acquired_synced(coalesced_stream, flight);
+                aws_array_list_push_back(&waiting_streams, &coalesced_stream);
+            }
+            s_unlock_synced_data(manager);
+        } /* END CRITICAL SECTION */
+
+        REQUEST_MANAGER_LOGF(
+            DEBUG,
+            manager,
+            "flight:%p made stream:%p, shared by %zu requests so far",
+            (void *)flight,
+            (void *)stream,
+            aws_array_list_length(&waiting_streams));
+
+        for (size_t i = 0; i < aws_array_list_length(&waiting_streams); ++i) {
+            struct aws_http_coalesced_stream *coalesced_stream = NULL;
+            aws_array_list_get_at(&waiting_streams, &coalesced_stream, i);
+            coalesced_stream->callback(
+                &coalesced_stream->base, AWS_ERROR_SUCCESS, coalesced_stream->callback_user_data);
+        }
+        aws_array_list_clean_up(&waiting_streams);
+
+        /* The connection keeps the shared stream alive until it completes, and the flight goes with it */
+        aws_http_stream_release(stream);
+        return;
+    }
+
+    error_code = error_code ? error_code : AWS_ERROR_UNKNOWN;
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(manager);
+        s_flight_close_synced(flight);
+        s_unlock_synced_data(manager);
+    } /* END CRITICAL SECTION */
+
+    REQUEST_MANAGER_LOGF(
+        ERROR,
+        manager,
+        "flight:%p failed with error: %d(%s).",
+        (void *)flight,
+        error_code,
+        aws_error_str(error_code));
+
+    /* No one else joins, and none of these streams were handed out, so they go without a word */
+    while (!aws_linked_list_empty(&flight->synced_data.streams)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&flight->synced_data.streams);
+        struct aws_http_coalesced_stream *coalesced_stream =
+            AWS_CONTAINER_OF(node, struct aws_http_coalesced_stream, node);
+        coalesced_stream->callback(NULL, error_code, coalesced_stream->callback_user_data);
+        s_coalesced_stream_destroy(&coalesced_stream->base);
+    }
+    s_flight_destroy(flight);
+}
+
+static int s_append_coalescing_key_field(
+    struct aws_byte_buf *key_buf,
+    struct aws_byte_cursor field,
+    uint8_t terminator) {
+
+    if (aws_byte_buf_append_dynamic(key_buf, &field) || aws_byte_buf_append_byte_dynamic(key_buf, terminator)) {
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Returns NULL if the request can't be coalesced: anything but a plain GET, or one the user must see alone */
+static struct aws_string *s_coalescing_key_new(
+    struct aws_http_request_manager *manager,
+    const struct aws_http_make_request_options *options) {
+
+    if (options->http2_use_manual_data_writes || options->content_decoding != NULL) {
+        return NULL;
+    }
+
+    struct aws_http_message *request = options->request;
+    struct aws_byte_cursor method;
+    struct aws_byte_cursor path;
+    if (aws_http_message_get_request_method(request, &method) || !aws_byte_cursor_eq(&method, &aws_http_method_get) ||
+        aws_http_message_get_request_path(request, &path) || aws_http_message_get_body_stream(request) != NULL) {
+        return NULL;
+    }
+
+    /* Every request goes to the same host, but the authority it names may still differ */
+    struct aws_http_headers *headers = aws_http_message_get_headers(request);
+    struct aws_byte_cursor authority;
+    AWS_ZERO_STRUCT(authority);
+    if (aws_http_headers_get(headers, aws_byte_cursor_from_c_str(":authority"), &authority)) {
+        aws_http_headers_get(headers, aws_byte_cursor_from_c_str("host"), &authority);
+    }
+
+    struct aws_byte_buf key_buf;
+    aws_byte_buf_init(&key_buf, manager->allocator, method.len + authority.len + path.len + 64);
+    if (s_append_coalescing_key_field(&key_buf, method, '\n') ||
+        s_append_coalescing_key_field(&key_buf, authority, '\n') ||
+        s_append_coalescing_key_field(&key_buf, path, '\n')) {
+        goto error;
+    }
+
+    /* Header values can't contain newlines, so the fields can't run into each other */
+    const size_t num_headers = aws_http_headers_count(headers);
+    for (size_t i = 0; i < aws_array_list_length(&manager->coalescing_header_names); ++i) {
+        struct aws_string *name = NULL;
+        aws_array_list_get_at(&manager->coalescing_header_names, &name, i);
+        struct aws_byte_cursor name_cursor = aws_byte_cursor_from_string(name);
+        for (size_t j = 0; j < num_headers; ++j) {
+            struct aws_http_header header;
+            aws_http_headers_get_index(headers, j, &header);
+            if (!aws_byte_cursor_eq_ignore_case(&header.name, &name_cursor)) {
+                continue;
+            }
+            if (s_append_coalescing_key_field(&key_buf, name_cursor, ':') ||
+                s_append_coalescing_key_field(&key_buf, header.value, '\n')) {
+                goto error;
+            }
+        }
+    }
+
+    struct aws_string *key = aws_string_new_from_buf(manager->allocator, &key_buf);
+    aws_byte_buf_clean_up(&key_buf);
+    return key;
+
+error:
+    aws_byte_buf_clean_up(&key_buf);
+    return NULL;
+}
+
+/* Returns false if the request wasn't coalesced, and should be made as usual */
+static bool s_request_coalesce(
+    struct aws_http_request_manager *manager,
+    const struct aws_http_request_manager_acquire_stream_options *acquire_stream_options) {
+
+    struct aws_string *key = s_coalescing_key_new(manager, acquire_stream_options->options);
+    if (key == NULL) {
+        return false;
+    }
+
+    struct aws_http_coalesced_stream *coalesced_stream =
+        s_coalesced_stream_new(manager->allocator, acquire_stream_options);
+    struct aws_http_request_flight *flight = NULL;
+    bool is_new_flight = false;
+    bool is_ready = false;
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(manager);
+        struct aws_hash_element *found = NULL;
+        aws_hash_table_find(&manager->synced_data.flights, key, &found);
+        if (found != NULL) {
+            flight = found->value;
+        } else {
+            flight = aws_mem_calloc(manager->allocator, 1, sizeof(struct aws_http_request_flight));
+            flight->allocator = manager->allocator;
+            flight->manager = manager;
+            flight->key = key;
+            flight->synced_data.is_joinable = true;
+            aws_linked_list_init(&flight->synced_data.streams);
+            if (aws_hash_table_put(&manager->synced_data.flights, flight->key, flight, NULL)) {
+                aws_mem_release(flight->allocator, flight);
+                flight = NULL;
+            } else {
+                key = NULL;
+                is_new_flight = true;
+                aws_ref_count_acquire(&manager->internal_ref_count);
+            }
+        }
+        if (flight != NULL) {
+            aws_linked_list_push_back(&flight->synced_data.streams, &coalesced_stream->node);
+            ++flight->synced_data.num_streams;
+            if (flight->synced_data.is_acquired) {
+                s_coalesced_stream_set_acquired_synced(coalesced_stream, flight);
+                is_ready = true;
+            }
+        }
+        s_unlock_synced_data(manager);
+    } /* END CRITICAL SECTION */
+
+    aws_string_destroy(key);
+    if (flight == NULL) {
+        s_coalesced_stream_destroy(&coalesced_stream->base);
+        return false;
+    }
+
+    if (is_new_flight) {
+        REQUEST_MANAGER_LOGF(DEBUG, manager, "flight:%p started, identical GETs will share its stream", (void *)flight);
+
+        struct aws_http_make_request_options options = *acquire_stream_options->options;
+        options.on_response_headers = s_on_flight_incoming_headers;
+        options.on_response_header_block_done = s_on_flight_incoming_header_block_done;
+        options.on_response_body = s_on_flight_incoming_body;
+        options.on_metrics = s_on_flight_stream_metrics;
+        options.on_complete = s_on_flight_stream_complete;
+        options.on_destroy = s_on_flight_stream_destroy;
+        options.user_data = flight;
+        s_request_manager_make_request(manager, s_on_flight_stream_acquired, flight, &options);
+        return true;
+    }
+
+    REQUEST_MANAGER_LOGF(
+        TRACE, manager, "stream:%p joined flight:%p", (void *)&coalesced_stream->base, (void *)flight);
+    if (is_ready) {
+        coalesced_stream->callback(&coalesced_stream->base, AWS_ERROR_SUCCESS, coalesced_stream->callback_user_data);
+    }
+    return true;
+}
+
+void aws_http_request_manager_acquire_stream(
+    struct aws_http_request_manager *manager,
+    const struct aws_http_request_manager_acquire_stream_options *acquire_stream_options) {
+
+    AWS_PRECONDITION(manager);
+    AWS_PRECONDITION(acquire_stream_options);
+    AWS_PRECONDITION(acquire_stream_options->callback);
+    AWS_PRECONDITION(acquire_stream_options->options);
+
+    if (manager->enable_request_coalescing && s_request_coalesce(manager, acquire_stream_options)) {
+        return;
+    }
+    s_request_manager_make_request(
+        manager, acquire_stream_options->callback, acquire_stream_options->user_data, acquire_stream_options->options);
+}
+
+/*
+ * Lifetime
+ */
+
+static void s_request_manager_clean_up_coalescing(struct aws_http_request_manager *manager) {
+    if (!manager->enable_request_coalescing) {
+        return;
+    }
+    AWS_ASSERT(aws_hash_table_get_entry_count(&manager->synced_data.flights) == 0);
+    aws_hash_table_clean_up(&manager->synced_data.flights);
+    for (size_t i = 0; i < aws_array_list_length(&manager->coalescing_header_names); ++i) {
+        struct aws_string *name = NULL;
+        aws_array_list_get_at(&manager->coalescing_header_names, &name, i);
+        aws_string_destroy(name);
+    }
+    aws_array_list_clean_up(&manager->coalescing_header_names);
+}
+
+static void s_request_manager_destroy(struct aws_http_request_manager *manager) {
+    AWS_ASSERT(aws_linked_list_empty(&manager->synced_data.pending_requests));
+    s_request_manager_clean_up_coalescing(manager);
+    aws_http_request_manager_shutdown_complete_fn *shutdown_complete_callback = manager->shutdown_complete_callback;
+    void *shutdown_complete_user_data = manager->shutdown_complete_user_data;
+
+    REQUEST_MANAGER_LOG(TRACE, manager, "Request manager destroyed");
+    aws_mutex_clean_up(&manager->synced_data.lock);
+    aws_mem_release(manager->allocator, manager);
+
+    if (shutdown_complete_callback) {
+        shutdown_complete_callback(shutdown_complete_user_data);
+    }
+}
+
+static void s_on_sub_manager_shutdown_complete(void *user_data) {
+    struct aws_http_request_manager *manager = user_data;
+    aws_ref_count_release(&manager->internal_ref_count);
+}
+
+static void s_request_manager_on_zero_external_ref(struct aws_http_request_manager *manager) {
+    REQUEST_MANAGER_LOG(TRACE, manager, "Last refcount released, shutting down");
+
+    struct aws_http_connection_manager *connection_manager = NULL;
+    struct aws_http2_stream_manager *stream_manager = NULL;
+    { /* BEGIN CRITICAL SECTION */
+        s_lock_synced_data(manager);
+        connection_manager = manager->synced_data.connection_manager;
+        stream_manager = manager->synced_data.stream_manager;
+        manager->synced_data.connection_manager = NULL;
+        manager->synced_data.stream_manager = NULL;
+        s_unlock_synced_data(manager);
+    } /* END CRITICAL SECTION */
+
+    aws_http_connection_manager_release(connection_manager);
+    aws_http2_stream_manager_release(stream_manager);
+    aws_ref_count_release(&manager->internal_ref_count);
+}
+
+struct aws_http_request_manager *aws_http_request_manager_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_request_manager_options *options) {
+
+    AWS_PRECONDITION(allocator);
+    AWS_PRECONDITION(options);
+
+    struct aws_tls_connection_options tls_connection_options;
+    AWS_ZERO_STRUCT(tls_connection_options);
+    if (options->tls_connection_options) {
+        if (aws_tls_connection_options_copy(&tls_connection_options, options->tls_connection_options) ||
+            aws_tls_connection_options_set_alpn_list(&tls_connection_options, allocator, s_alpn_list)) {
+            aws_tls_connection_options_clean_up(&tls_connection_options);
+            return NULL;
+        }
+    }
+
+    struct aws_http_request_manager *manager = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_request_manager));
+    manager->allocator = allocator;
+    manager->system_vtable = g_aws_http_request_manager_default_system_vtable_ptr;
+    aws_linked_list_init(&manager->synced_data.pending_requests);
+    if (aws_mutex_init(&manager->synced_data.lock)) {
+        aws_mem_release(allocator, manager);
+        aws_tls_connection_options_clean_up(&tls_connection_options);
+        return NULL;
+    }
+    aws_ref_count_init(
+        &manager->external_ref_count,
+        manager,
+        (aws_simple_completion_callback *)s_request_manager_on_zero_external_ref);
+    aws_ref_count_init(
+        &manager->internal_ref_count, manager, (aws_simple_completion_callback *)s_request_manager_destroy);
+
+    if (options->enable_request_coalescing) {
+        /* Flights find each other by key, which they own */
+        if (aws_hash_table_init(
+                &manager->synced_data.flights,
+                allocator,
+                16,
+                aws_hash_string,
+                aws_hash_callback_string_eq,
+                NULL /*destroy_key_fn*/,
+                NULL /*destroy_value_fn*/)) {
+            goto error;
+        }
+        manager->enable_request_coalescing = true;
+        aws_array_list_init_dynamic(
+            &manager->coalescing_header_names,
+            allocator,
+            options->num_coalescing_header_names,
+            sizeof(struct aws_string *));
+        for (size_t i = 0; i < options->num_coalescing_header_names; ++i) {
+            struct aws_string *name = aws_string_new_from_cursor(allocator, &options->coalescing_header_names[i]);
+            aws_array_list_push_back(&manager->coalescing_header_names, &name);
+        }
+    }
+
+    struct aws_http_connection_manager_options cm_options = {
+        .bootstrap = options->bootstrap,
+        .socket_options = options->socket_options,
+        .tls_connection_options = options->tls_connection_options ? &tls_connection_options : NULL,
+        .host = options->host,
+        .port = options->port,
+        .monitoring_options = options->monitoring_options,
+        .proxy_options = options->proxy_options,
+        .proxy_ev_settings = options->proxy_ev_settings,
+        .max_connections = options->max_connections,
+        .memory_budget = options->memory_budget,
+        .shutdown_complete_user_data = manager,
+        .shutdown_complete_callback = s_on_sub_manager_shutdown_complete,
+    };
+    manager->synced_data.connection_manager = aws_http_connection_manager_new(allocator, &cm_options);
+    if (!manager->synced_data.connection_manager) {
+        goto error;
+    }
+    aws_ref_count_acquire(&manager->internal_ref_count);
+
+    if (options->tls_connection_options) {
+        /* Nothing connects until the first request, so an endpoint that only speaks HTTP/1.1 costs nothing here */
+        struct aws_http2_stream_manager_options sm_options = {
+            .bootstrap = options->bootstrap,
+            .socket_options = options->socket_options,
+            .tls_connection_options = &tls_connection_options,
+            .host = options->host,
+            .port = options->port,
+            .monitoring_options = options->monitoring_options,
+            .proxy_options = options->proxy_options,
+            .proxy_ev_settings = options->proxy_ev_settings,
+            .max_connections = options->max_connections,
+            .ideal_concurrent_streams_per_connection = options->ideal_concurrent_streams_per_connection,
+            .max_concurrent_streams_per_connection = options->max_concurrent_streams_per_connection,
+            .max_unprocessed_stream_retries = options->max_unprocessed_stream_retries,
+            .enable_adaptive_concurrency = options->enable_adaptive_concurrency,
+            .memory_budget = options->memory_budget,
+            .shutdown_complete_user_data = manager,
+            .shutdown_complete_callback = s_on_sub_manager_shutdown_complete,
+        };
+        manager->synced_data.stream_manager = aws_http2_stream_manager_new(allocator, &sm_options);
+        if (!manager->synced_data.stream_manager) {
+            goto error;
+        }
+        aws_ref_count_acquire(&manager->internal_ref_count);
+    } else {
+        /* Cleartext connections don't negotiate, they're HTTP/1.1 */
+        manager->synced_data.version = AWS_HTTP_VERSION_1_1;
+    }
+
+    aws_tls_connection_options_clean_up(&tls_connection_options);
+    manager->shutdown_complete_callback = options->shutdown_complete_callback;
+    manager->shutdown_complete_user_data = options->shutdown_complete_user_data;
+    REQUEST_MANAGER_LOG(TRACE, manager, "Request manager created");
+    return manager;
+
+error:
+    aws_tls_connection_options_clean_up(&tls_connection_options);
+    /* Anything created shuts down asynchronously, and the manager is destroyed after it, without telling the user */
+    aws_ref_count_release(&manager->external_ref_count);
+    return NULL;
+}
+
+struct aws_http_request_manager *aws_http_request_manager_acquire(struct aws_http_request_manager *manager) {
+    if (manager) {
+        aws_ref_count_acquire(&manager->external_ref_count);
+    }
+    return manager;
+}
+
+struct aws_http_request_manager *aws_http_request_manager_release(struct aws_http_request_manager *manager) {
+    if (manager) {
+        aws_ref_count_release(&manager->external_ref_count);
+    }
+    return NULL;
+}
+
+void aws_http_request_manager_set_system_vtable(
+    struct aws_http_request_manager *manager,
+    const struct aws_http_request_manager_system_vtable *system_vtable) {
+
+    AWS_FATAL_ASSERT(aws_http_request_manager_system_vtable_is_valid(system_vtable));
+    manager->system_vtable = system_vtable;
+}
+
+enum aws_http_version aws_http_request_manager_get_version(const struct aws_http_request_manager *manager) {
+    struct aws_http_request_manager *mutable_manager = (struct aws_http_request_manager *)manager;
+    s_lock_synced_data(mutable_manager);
+    enum aws_http_version version = manager->synced_data.version;
+    s_unlock_synced_data(mutable_manager);
+    return version;
+}
@@ -4,6 +4,7 @@
  */
 
 #include <aws/common/array_list.h>
+#include <aws/common/hash_table.h>
 #include <aws/common/mutex.h>
 #include <aws/common/string.h>
 #include <aws/http/private/connection_impl.h>
@@ -11,6 +12,7 @@
 #include <aws/http/private/strutil.h>
 #include <aws/http/server.h>
 #include <aws/http/status_code.h>
+#include <aws/io/async_stream.h>
 #include <aws/io/logging.h>
 #include <aws/io/stream.h>
 
@@ -21,8 +23,23 @@
 enum {
     /* Initial capacity for the aws_http_message.headers array_list. */
     AWS_HTTP_REQUEST_NUM_RESERVED_HEADERS = 16,
+
+    /* Once aws_http_headers has this many entries, lookups by name go through a hash index. */
+    AWS_HTTP_HEADERS_INDEX_THRESHOLD = 16,
+
+    /* Default size of the first block, for aws_http_headers in arena mode. */
+    AWS_HTTP_HEADERS_DEFAULT_ARENA_BLOCK_SIZE = 1024,
+
+    /* Outside arena mode, a header whose name and value fit in this many bytes is stored in a small-string slot. */
+    AWS_HTTP_HEADERS_SMALL_STRING_SIZE = 48,
+
+    /* Number of small-string slots in each chunk. */
+    AWS_HTTP_HEADERS_SMALL_STRING_CHUNK_SLOTS = 16,
 };
 
+/* Marks an empty slot, or the end of a chain, in the aws_http_headers index */
+#define AWS_HTTP_HEADERS_INDEX_NONE SIZE_MAX
+
 bool aws_http_header_name_eq(struct aws_byte_cursor name_a, struct aws_byte_cursor name_b) {
     return aws_byte_cursor_eq_ignore_case(&name_a, &name_b);
 }
@@ -33,30 +50,373 @@ bool aws_http_header_name_eq(struct aws_byte_cursor name_a, struct aws_byte_curs
  * The linear array was simpler to implement and may be faster due to having fewer allocations.
  * The API has been designed so we can swap out the implementation later if desired.
  *
+ * -- Index Notes --
+ * Once there are AWS_HTTP_HEADERS_INDEX_THRESHOLD headers, we also keep a hash index of the names,
+ * so that get(), has(), and erase() don't need to scan the whole array.
+ * The index is kept up to date by the functions that modify the array, rather than on lookup,
+ * so that lookups on a const aws_http_headers never write to it.
+ * Appending a header (the common case) updates the index in O(1).
+ * Anything that shifts the array (push-front, erase) already costs O(N), so we simply rebuild the index.
+ *
+ * -- Name Notes --
+ * Each entry also stores its name's aws_http_header_name, looked up once when the header is added.
+ * Lookups resolve the name they're given once too, so a well-known name is found by integer compares alone.
+ * A well-known name can only match entries with the same enum, and an unknown name only entries whose
+ * enum is also unknown, so byte compares are only needed between two unknown names.
+ *
  * -- String Storage Notes --
  * We use a single allocation to hold the name and value of each aws_http_header.
- * We could optimize storage by using something like a string pool. If we do this, be sure to maintain
- * the address of existing strings when adding new strings (a dynamic aws_byte_buf would not suffice).
+ *
+ * In arena mode (see aws_http_headers_new_with_arena()) that storage is instead bump-allocated from
+ * a list of blocks. Blocks are never moved or resized, so the address of existing strings is maintained.
+ * The first block is part of the same allocation as the aws_http_headers itself.
+ * Memory from erased headers is not reused until aws_http_headers_clear(), or the final release.
+ *
+ * Otherwise, most headers are short (content-length, short tokens, etc.), so a header whose name and value
+ * fit in AWS_HTTP_HEADERS_SMALL_STRING_SIZE bytes goes in a fixed-size slot, rather than an allocation of its own.
+ * Slots come from chunks holding several at once, and an erased header's slot goes on a free list for reuse.
+ * The strings can't live in the array_list's elements themselves, since those move whenever the array grows
+ * or shifts, and a header's strings must stay where they are until it's erased.
+ * Chunks are freed by aws_http_headers_clear(), or the final release.
  */
+struct aws_http_headers_arena_block {
+    struct aws_http_headers_arena_block *next;
+    size_t capacity;
+    size_t used;
+    /* uint8_t data[capacity] follows */
+};
+
+union aws_http_headers_small_string {
+    union aws_http_headers_small_string *next_free;
+    uint8_t data[AWS_HTTP_HEADERS_SMALL_STRING_SIZE];
+};
+
+struct aws_http_headers_small_string_chunk {
+    struct aws_http_headers_small_string_chunk *next;
+    union aws_http_headers_small_string slots[AWS_HTTP_HEADERS_SMALL_STRING_CHUNK_SLOTS];
+};
+
+/* Element of aws_http_headers.array_list.
+ * The header comes first, so a pointer to an entry is also a pointer to its aws_http_header. */
+struct aws_http_headers_entry {
+    struct aws_http_header header;
+    enum aws_http_header_name name_enum;
+    /* Name is a token and value is a valid field-value (RFC-7230 3.2), checked once when the header is added */
+    bool is_valid;
+};
+
 struct aws_http_headers {
     struct aws_allocator *alloc;
-    struct aws_array_list array_list; /* Contains aws_http_header */
+    struct aws_array_list array_list; /* Contains aws_http_headers_entry */
     struct aws_atomic_var refcount;
+
+    /* Hash index of names. All arrays live in one allocation, which is NULL while the index is inactive. */
+    struct {
+        void *allocation;
+        uint64_t *name_hashes; /* Case-insensitive hash of each header's name. Parallel to array_list */
+        size_t *next;          /* Index of next header with the same name, or AWS_HTTP_HEADERS_INDEX_NONE */
+        size_t *slots;         /* Open-addressing table. Index of first header with a given name */
+        size_t capacity;       /* Number of entries in name_hashes and next */
+        size_t slot_count;     /* Always a power of 2, and always more than capacity, so probing terminates */
+    } index;
+
+    /* Only used in arena mode. Newest block is at the front of the list, the first block is always at the back. */
+    struct {
+        struct aws_http_headers_arena_block *blocks;
+        struct aws_http_headers_arena_block *first_block;
+    } arena;
+
+    /* Only used outside arena mode. Chunks of small-string slots, and the slots not in use */
+    struct {
+        struct aws_http_headers_small_string_chunk *chunks;
+        union aws_http_headers_small_string *free_list;
+    } small_strings;
+
+    /* If headers were copied from an aws_http_message_template, this is how many of the leading headers
+     * are still exactly the template's. Reset to 0 by anything that modifies or moves those headers. */
+    size_t template_prefix_count;
 };
 
-struct aws_http_headers *aws_http_headers_new(struct aws_allocator *allocator) {
-    AWS_PRECONDITION(allocator);
+static bool s_arena_is_active(const struct aws_http_headers *headers) {
+    return headers->arena.first_block != NULL;
+}
+
+static uint8_t *s_arena_block_data(struct aws_http_headers_arena_block *block) {
+    return (uint8_t *)(block + 1);
+}
+
+static uint8_t *s_small_string_acquire(struct aws_http_headers *headers) {
+    if (!headers->small_strings.free_list) {
+        struct aws_http_headers_small_string_chunk *chunk =
+            aws_mem_acquire(headers->alloc, sizeof(struct aws_http_headers_small_string_chunk));
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->next = headers->small_strings.chunks;
+        headers->small_strings.chunks = chunk;
+
+        /* Thread the new slots onto the free list, so they're handed out in order */
+        for (size_t i = AWS_HTTP_HEADERS_SMALL_STRING_CHUNK_SLOTS; i > 0; --i) {
+            chunk->slots[i - 1].next_free = headers->small_strings.free_list;
+            headers->small_strings.free_list = &chunk->slots[i - 1];
+        }
+    }
+
+    union aws_http_headers_small_string *slot = headers->small_strings.free_list;
+    headers->small_strings.free_list = slot->next_free;
+    return slot->data;
+}
+
+static void s_small_string_release(struct aws_http_headers *headers, uint8_t *mem) {
+    union aws_http_headers_small_string *slot = (union aws_http_headers_small_string *)mem;
+    slot->next_free = headers->small_strings.free_list;
+    headers->small_strings.free_list = slot;
+}
+
+/* Free every chunk of small-string slots */
+static void s_small_strings_clean_up(struct aws_http_headers *headers) {
+    struct aws_http_headers_small_string_chunk *chunk = headers->small_strings.chunks;
+    while (chunk) {
+        struct aws_http_headers_small_string_chunk *next = chunk->next;
+        aws_mem_release(headers->alloc, chunk);
+        chunk = next;
+    }
+    AWS_ZERO_STRUCT(headers->small_strings);
+}
+
+/* Get storage for a header's name and value */
+static uint8_t *s_headers_acquire_strmem(struct aws_http_headers *headers, size_t size) {
+    if (!s_arena_is_active(headers)) {
+        if (size <= AWS_HTTP_HEADERS_SMALL_STRING_SIZE) {
+            return s_small_string_acquire(headers);
+        }
+        return aws_mem_acquire(headers->alloc, size);
+    }
+
+    struct aws_http_headers_arena_block *block = headers->arena.blocks;
+    if (block->capacity - block->used < size) {
+        /* Each new block is double the size of the last, to keep the number of allocations down */
+        size_t capacity;
+        size_t alloc_size;
+        if (aws_mul_size_checked(block->capacity, 2, &capacity)) {
+            capacity = size;
+        }
+        capacity = aws_max_size(capacity, size);
+        if (aws_add_size_checked(capacity, sizeof(struct aws_http_headers_arena_block), &alloc_size)) {
+            return NULL;
+        }
+
+        block = aws_mem_acquire(headers->alloc, alloc_size);
+        if (!block) {
+            return NULL;
+        }
+        block->capacity = capacity;
+        block->used = 0;
+        block->next = headers->arena.blocks;
+        headers->arena.blocks = block;
+    }
+
+    uint8_t *mem = s_arena_block_data(block) + block->used;
+    block->used += size;
+    return mem;
+}
+
+/* Release storage for a header's name and value.
+ * In arena mode, the memory is only reclaimed if it's the most recent thing allocated. */
+static void s_headers_release_strmem(struct aws_http_headers *headers, uint8_t *mem, size_t size) {
+    if (!s_arena_is_active(headers)) {
+        if (size <= AWS_HTTP_HEADERS_SMALL_STRING_SIZE) {
+            s_small_string_release(headers, mem);
+        } else {
+            aws_mem_release(headers->alloc, mem);
+        }
+        return;
+    }
+
+    struct aws_http_headers_arena_block *block = headers->arena.blocks;
+    if (block->used >= size && mem == s_arena_block_data(block) + block->used - size) {
+        block->used -= size;
+    }
+}
+
+/* Free every block but the first, and mark the first as unused */
+static void s_arena_reset(struct aws_http_headers *headers) {
+    struct aws_http_headers_arena_block *block = headers->arena.blocks;
+    while (block != headers->arena.first_block) {
+        struct aws_http_headers_arena_block *next = block->next;
+        aws_mem_release(headers->alloc, block);
+        block = next;
+    }
+
+    headers->arena.blocks = headers->arena.first_block;
+    headers->arena.first_block->used = 0;
+}
+
+static void s_index_clean_up(struct aws_http_headers *headers) {
+    aws_mem_release(headers->alloc, headers->index.allocation);
+    AWS_ZERO_STRUCT(headers->index);
+}
+
+static bool s_index_is_active(const struct aws_http_headers *headers) {
+    return headers->index.allocation != NULL;
+}
+
+static const struct aws_http_headers_entry *s_entry_at(const struct aws_http_headers *headers, size_t i) {
+    struct aws_http_headers_entry *entry = NULL;
+    aws_array_list_get_at_ptr(&headers->array_list, (void **)&entry, i);
+    AWS_ASSUME(entry);
+    return entry;
+}
+
+static const struct aws_http_header *s_header_at(const struct aws_http_headers *headers, size_t i) {
+    return &s_entry_at(headers, i)->header;
+}
+
+/* Whether the entry has this name. `name_enum` must be aws_http_str_to_header_name(name) */
+static bool s_entry_name_eq(
+    const struct aws_http_headers_entry *entry,
+    struct aws_byte_cursor name,
+    enum aws_http_header_name name_enum) {
+
+    if (name_enum != AWS_HTTP_HEADER_UNKNOWN || entry->name_enum != AWS_HTTP_HEADER_UNKNOWN) {
+        return entry->name_enum == name_enum;
+    }
+    return aws_http_header_name_eq(entry->header.name, name);
+}
+
+/* Returns index of the first header with this name, or AWS_HTTP_HEADERS_INDEX_NONE.
+ * If out_slot is passed, it's set to the slot where the name is (or where it would go) */
+static size_t s_index_find(
+    const struct aws_http_headers *headers,
+    struct aws_byte_cursor name,
+    enum aws_http_header_name name_enum,
+    uint64_t name_hash,
+    size_t *out_slot) {
+
+    const size_t mask = headers->index.slot_count - 1;
+    size_t slot = (size_t)name_hash & mask;
+    while (true) {
+        const size_t i = headers->index.slots[slot];
+        if (i == AWS_HTTP_HEADERS_INDEX_NONE ||
+            (headers->index.name_hashes[i] == name_hash && s_entry_name_eq(s_entry_at(headers, i), name, name_enum))) {
+            if (out_slot) {
+                *out_slot = slot;
+            }
+            return i;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+/* Add header at index i to the index. i must be greater than any index already in there. */
+static void s_index_insert(struct aws_http_headers *headers, size_t i) {
+    AWS_PRECONDITION(i < headers->index.capacity);
+
+    const struct aws_http_headers_entry *entry = s_entry_at(headers, i);
+    const uint64_t name_hash = aws_hash_byte_cursor_ptr_ignore_case(&entry->header.name);
+    headers->index.name_hashes[i] = name_hash;
+    headers->index.next[i] = AWS_HTTP_HEADERS_INDEX_NONE;
+
+    size_t slot;
+    size_t chain = s_index_find(headers, entry->header.name, entry->name_enum, name_hash, &slot);
+    if (chain == AWS_HTTP_HEADERS_INDEX_NONE) {
+        headers->index.slots[slot] = i;
+        return;
+    }
+
+    /* Name already present, append to end of chain, so chains stay in array order */
+    while (headers->index.next[chain] != AWS_HTTP_HEADERS_INDEX_NONE) {
+        chain = headers->index.next[chain];
+    }
+    headers->index.next[chain] = i;
+}
 
-    struct aws_http_headers *headers = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_headers));
+/* Rebuild the index from scratch, or tear it down if there aren't enough headers to bother.
+ * If memory can't be allocated, the index is simply deactivated and lookups fall back to linear search. */
+static void s_index_rebuild(struct aws_http_headers *headers) {
+    const size_t count = aws_http_headers_count(headers);
+    if (count < AWS_HTTP_HEADERS_INDEX_THRESHOLD) {
+        s_index_clean_up(headers);
+        return;
+    }
+
+    if (count > headers->index.capacity) {
+        s_index_clean_up(headers);
+
+        /* Leave room to grow, so appends don't need to rebuild */
+        size_t capacity;
+        size_t slot_count;
+        size_t entry_size = sizeof(uint64_t) + sizeof(size_t);
+        size_t entries_bytes;
+        size_t slots_bytes;
+        size_t total_bytes;
+        if (aws_mul_size_checked(count, 2, &capacity) || aws_round_up_to_power_of_two(capacity, &capacity) ||
+            aws_mul_size_checked(capacity, 2, &slot_count) ||
+            aws_mul_size_checked(capacity, entry_size, &entries_bytes) ||
+            aws_mul_size_checked(slot_count, sizeof(size_t), &slots_bytes) ||
+            aws_add_size_checked(entries_bytes, slots_bytes, &total_bytes)) {
+            return;
+        }
+
+        uint8_t *allocation = aws_mem_acquire(headers->alloc, total_bytes);
+        if (!allocation) {
+            return;
+        }
+
+        /* uint64_t array first, so everything is aligned */
+        headers->index.allocation = allocation;
+        headers->index.name_hashes = (uint64_t *)allocation;
+        headers->index.next = (size_t *)(allocation + capacity * sizeof(uint64_t));
+        headers->index.slots = headers->index.next + capacity;
+        headers->index.capacity = capacity;
+        headers->index.slot_count = slot_count;
+    }
+
+    /* Setting every byte to 0xFF sets every slot to AWS_HTTP_HEADERS_INDEX_NONE */
+    memset(headers->index.slots, 0xFF, headers->index.slot_count * sizeof(size_t));
+    for (size_t i = 0; i < count; ++i) {
+        s_index_insert(headers, i);
+    }
+}
+
+/* Update index after a header was pushed to the back of the array */
+static void s_index_on_push_back(struct aws_http_headers *headers) {
+    const size_t count = aws_http_headers_count(headers);
+    if (s_index_is_active(headers) && count <= headers->index.capacity) {
+        s_index_insert(headers, count - 1);
+    } else if (count >= AWS_HTTP_HEADERS_INDEX_THRESHOLD) {
+        s_index_rebuild(headers);
+    }
+}
+
+static struct aws_http_headers *s_http_headers_new_common(struct aws_allocator *allocator, size_t arena_block_size) {
+    /* In arena mode, the first block comes right after the aws_http_headers, in the same allocation */
+    size_t alloc_size = sizeof(struct aws_http_headers);
+    if (arena_block_size) {
+        if (aws_add_size_checked(alloc_size, sizeof(struct aws_http_headers_arena_block), &alloc_size) ||
+            aws_add_size_checked(alloc_size, arena_block_size, &alloc_size)) {
+            goto alloc_failed;
+        }
+    }
+
+    struct aws_http_headers *headers = aws_mem_calloc(allocator, 1, alloc_size);
     if (!headers) {
         goto alloc_failed;
     }
 
     headers->alloc = allocator;
+    if (arena_block_size) {
+        headers->arena.first_block = (struct aws_http_headers_arena_block *)(headers + 1);
+        headers->arena.first_block->capacity = arena_block_size;
+        headers->arena.blocks = headers->arena.first_block;
+    }
     aws_atomic_init_int(&headers->refcount, 1);
 
     if (aws_array_list_init_dynamic(
-            &headers->array_list, allocator, AWS_HTTP_REQUEST_NUM_RESERVED_HEADERS, sizeof(struct aws_http_header))) {
+            &headers->array_list,
+            allocator,
+            AWS_HTTP_REQUEST_NUM_RESERVED_HEADERS,
+            sizeof(struct aws_http_headers_entry))) {
         goto array_list_failed;
     }
 
@@ -68,6 +428,21 @@ alloc_failed:
     return NULL;
 }
 
+struct aws_http_headers *aws_http_headers_new(struct aws_allocator *allocator) {
+    AWS_PRECONDITION(allocator);
+
+    return s_http_headers_new_common(allocator, 0 /*arena_block_size*/);
+}
+
+struct aws_http_headers *aws_http_headers_new_with_arena(struct aws_allocator *allocator, size_t block_size) {
+    AWS_PRECONDITION(allocator);
+
+    if (block_size == 0) {
+        block_size = AWS_HTTP_HEADERS_DEFAULT_ARENA_BLOCK_SIZE;
+    }
+    return s_http_headers_new_common(allocator, block_size);
+}
+
 void aws_http_headers_release(struct aws_http_headers *headers) {
     AWS_PRECONDITION(!headers || headers->alloc);
     if (!headers) {
@@ -115,25 +490,37 @@ static int s_http_headers_add_header_impl(
 
     /* Store our own copy of the strings.
      * We put the name and value into the same allocation. */
-    uint8_t *strmem = aws_mem_acquire(headers->alloc, total_len);
+    uint8_t *strmem = s_headers_acquire_strmem(headers, total_len);
+    if (!strmem) {
+        return AWS_OP_ERR;
+    }
 
     struct aws_byte_buf strbuf = aws_byte_buf_from_empty_array(strmem, total_len);
     aws_byte_buf_append_and_update(&strbuf, &header_copy.name);
     aws_byte_buf_append_and_update(&strbuf, &header_copy.value);
+
+    struct aws_http_headers_entry entry = {
+        .header = header_copy,
+        .name_enum = aws_http_str_to_header_name(header_copy.name),
+        .is_valid = aws_strutil_is_http_token(header_copy.name) && aws_strutil_is_http_field_value(header_copy.value),
+    };
     if (front) {
-        if (aws_array_list_push_front(&headers->array_list, &header_copy)) {
+        if (aws_array_list_push_front(&headers->array_list, &entry)) {
             goto error;
         }
+        headers->template_prefix_count = 0;
+        s_index_rebuild(headers);
     } else {
-        if (aws_array_list_push_back(&headers->array_list, &header_copy)) {
+        if (aws_array_list_push_back(&headers->array_list, &entry)) {
             goto error;
         }
+        s_index_on_push_back(headers);
     }
 
     return AWS_OP_SUCCESS;
 
 error:
-    aws_mem_release(headers->alloc, strmem);
+    s_headers_release_strmem(headers, strmem, total_len);
     return AWS_OP_ERR;
 }
 
@@ -160,29 +547,42 @@ int aws_http_headers_add(struct aws_http_headers *headers, struct aws_byte_curso
 void aws_http_headers_clear(struct aws_http_headers *headers) {
     AWS_PRECONDITION(headers);
 
-    struct aws_http_header *header = NULL;
-    const size_t count = aws_http_headers_count(headers);
-    for (size_t i = 0; i < count; ++i) {
-        aws_array_list_get_at_ptr(&headers->array_list, (void **)&header, i);
-        AWS_ASSUME(header);
-
-        /* Storage for name & value is in the same allocation */
-        aws_mem_release(headers->alloc, header->name.ptr);
+    if (s_arena_is_active(headers)) {
+        s_arena_reset(headers);
+    } else {
+        struct aws_http_header *header = NULL;
+        const size_t count = aws_http_headers_count(headers);
+        for (size_t i = 0; i < count; ++i) {
+            aws_array_list_get_at_ptr(&headers->array_list, (void **)&header, i);
+            AWS_ASSUME(header);
+
+            /* Storage for name & value is in the same allocation. Small-string slots all go with their chunks */
+            if (header->name.len + header->value.len > AWS_HTTP_HEADERS_SMALL_STRING_SIZE) {
+                aws_mem_release(headers->alloc, header->name.ptr);
+            }
+        }
+        s_small_strings_clean_up(headers);
     }
 
     aws_array_list_clear(&headers->array_list);
+    s_index_clean_up(headers);
+    headers->template_prefix_count = 0;
 }
 
-/* Does not check index */
+/* Does not check index. Does not update the hash index, caller must rebuild it when done erasing. */
 static void s_http_headers_erase_index(struct aws_http_headers *headers, size_t index) {
     struct aws_http_header *header = NULL;
     aws_array_list_get_at_ptr(&headers->array_list, (void **)&header, index);
     AWS_ASSUME(header);
 
     /* Storage for name & value is in the same allocation */
-    aws_mem_release(headers->alloc, header->name.ptr);
+    s_headers_release_strmem(headers, header->name.ptr, header->name.len + header->value.len);
 
     aws_array_list_erase(&headers->array_list, index);
+
+    if (index < headers->template_prefix_count) {
+        headers->template_prefix_count = 0;
+    }
 }
 
 int aws_http_headers_erase_index(struct aws_http_headers *headers, size_t index) {
@@ -193,6 +593,7 @@ int aws_http_headers_erase_index(struct aws_http_headers *headers, size_t index)
     }
 
     s_http_headers_erase_index(headers, index);
+    s_index_rebuild(headers);
     return AWS_OP_SUCCESS;
 }
 
@@ -203,25 +604,45 @@ static int s_http_headers_erase(
     size_t start_index,
     size_t end_index) {
     bool erased_any = false;
-    struct aws_http_header *header = NULL;
+    const enum aws_http_header_name name_enum = aws_http_str_to_header_name(name);
+
+    if (s_index_is_active(headers)) {
+        /* Walk the chain of headers with this name, which is in array order.
+         * Each erase shifts later headers down, so adjust by the number erased so far.
+         * Note that name may reference memory we're erasing, so it's only used before the first erase. */
+        const uint64_t name_hash = aws_hash_byte_cursor_ptr_ignore_case(&name);
+        size_t num_erased = 0;
+        for (size_t i = s_index_find(headers, name, name_enum, name_hash, NULL); i != AWS_HTTP_HEADERS_INDEX_NONE;
+             i = headers->index.next[i]) {
+
+            if (i >= end_index) {
+                break;
+            }
+            if (i >= start_index) {
+                s_http_headers_erase_index(headers, i - num_erased);
+                ++num_erased;
+            }
+        }
+        erased_any = num_erased > 0;
+        goto done;
+    }
 
     /* Iterating in reverse is simpler */
     for (size_t n = end_index; n > start_index; --n) {
         const size_t i = n - 1;
 
-        aws_array_list_get_at_ptr(&headers->array_list, (void **)&header, i);
-        AWS_ASSUME(header);
-
-        if (aws_http_header_name_eq(header->name, name)) {
+        if (s_entry_name_eq(s_entry_at(headers, i), name, name_enum)) {
             s_http_headers_erase_index(headers, i);
             erased_any = true;
         }
     }
 
+done:
     if (!erased_any) {
         return aws_raise_error(AWS_ERROR_HTTP_HEADER_NOT_FOUND);
     }
 
+    s_index_rebuild(headers);
     return AWS_OP_SUCCESS;
 }
 
@@ -240,14 +661,30 @@ int aws_http_headers_erase_value(
     AWS_PRECONDITION(headers);
     AWS_PRECONDITION(aws_byte_cursor_is_valid(&name) && aws_byte_cursor_is_valid(&value));
 
-    struct aws_http_header *header = NULL;
+    const enum aws_http_header_name name_enum = aws_http_str_to_header_name(name);
+
+    if (s_index_is_active(headers)) {
+        const uint64_t name_hash = aws_hash_byte_cursor_ptr_ignore_case(&name);
+        for (size_t i = s_index_find(headers, name, name_enum, name_hash, NULL); i != AWS_HTTP_HEADERS_INDEX_NONE;
+             i = headers->index.next[i]) {
+
+            if (aws_byte_cursor_eq(&s_header_at(headers, i)->value, &value)) {
+                s_http_headers_erase_index(headers, i);
+                s_index_rebuild(headers);
+                return AWS_OP_SUCCESS;
+            }
+        }
+
+        return aws_raise_error(AWS_ERROR_HTTP_HEADER_NOT_FOUND);
+    }
+
     const size_t count = aws_http_headers_count(headers);
     for (size_t i = 0; i < count; ++i) {
-        aws_array_list_get_at_ptr(&headers->array_list, (void **)&header, i);
-        AWS_ASSUME(header);
+        const struct aws_http_headers_entry *entry = s_entry_at(headers, i);
 
-        if (aws_http_header_name_eq(header->name, name) && aws_byte_cursor_eq(&header->value, &value)) {
+        if (s_entry_name_eq(entry, name, name_enum) && aws_byte_cursor_eq(&entry->header.value, &value)) {
             s_http_headers_erase_index(headers, i);
+            s_index_rebuild(headers);
             return AWS_OP_SUCCESS;
         }
     }
@@ -274,6 +711,7 @@ error:
     for (size_t new_count = aws_http_headers_count(headers); new_count > orig_count; --new_count) {
         s_http_headers_erase_index(headers, new_count - 1);
     }
+    s_index_rebuild(headers);
 
     return AWS_OP_ERR;
 }
@@ -308,7 +746,32 @@ int aws_http_headers_get_index(
     AWS_PRECONDITION(headers);
     AWS_PRECONDITION(out_header);
 
-    return aws_array_list_get_at(&headers->array_list, out_header, index);
+    if (index >= aws_http_headers_count(headers)) {
+        return aws_raise_error(AWS_ERROR_INVALID_INDEX);
+    }
+
+    *out_header = *s_header_at(headers, index);
+    return AWS_OP_SUCCESS;
+}
+
+bool aws_http_headers_is_field_valid(const struct aws_http_headers *headers, size_t index) {
+    AWS_PRECONDITION(headers);
+
+    if (index >= aws_http_headers_count(headers)) {
+        return false;
+    }
+
+    return s_entry_at(headers, index)->is_valid;
+}
+
+enum aws_http_header_name aws_http_headers_get_name_enum(const struct aws_http_headers *headers, size_t index) {
+    AWS_PRECONDITION(headers);
+
+    if (index >= aws_http_headers_count(headers)) {
+        return AWS_HTTP_HEADER_UNKNOWN;
+    }
+
+    return s_entry_at(headers, index)->name_enum;
 }
 
 /* RFC-9110 - 5.3
@@ -330,20 +793,35 @@ struct aws_string *aws_http_headers_get_all(const struct aws_http_headers *heade
     struct aws_byte_buf value_builder;
     aws_byte_buf_init(&value_builder, headers->alloc, 0);
     bool found = false;
-    struct aws_http_header *header = NULL;
+    const enum aws_http_header_name name_enum = aws_http_str_to_header_name(name);
+    if (s_index_is_active(headers)) {
+        const uint64_t name_hash = aws_hash_byte_cursor_ptr_ignore_case(&name);
+        for (size_t i = s_index_find(headers, name, name_enum, name_hash, NULL); i != AWS_HTTP_HEADERS_INDEX_NONE;
+             i = headers->index.next[i]) {
+
+            if (found) {
+                aws_byte_buf_append_dynamic(&value_builder, &separator);
+            }
+            found = true;
+            aws_byte_buf_append_dynamic(&value_builder, &s_header_at(headers, i)->value);
+        }
+        goto done;
+    }
+
     const size_t count = aws_http_headers_count(headers);
     for (size_t i = 0; i < count; ++i) {
-        aws_array_list_get_at_ptr(&headers->array_list, (void **)&header, i);
-        if (aws_http_header_name_eq(name, header->name)) {
+        const struct aws_http_headers_entry *entry = s_entry_at(headers, i);
+        if (s_entry_name_eq(entry, name, name_enum)) {
             if (!found) {
                 found = true;
             } else {
                 aws_byte_buf_append_dynamic(&value_builder, &separator);
             }
-            aws_byte_buf_append_dynamic(&value_builder, &header->value);
+            aws_byte_buf_append_dynamic(&value_builder, &entry->header.value);
         }
     }
 
+done:
     if (found) {
         value_str = aws_string_new_from_buf(headers->alloc, &value_builder);
     } else {
@@ -363,14 +841,24 @@ int aws_http_headers_get(
     AWS_PRECONDITION(out_value);
     AWS_PRECONDITION(aws_byte_cursor_is_valid(&name));
 
-    struct aws_http_header *header = NULL;
+    const enum aws_http_header_name name_enum = aws_http_str_to_header_name(name);
+
+    if (s_index_is_active(headers)) {
+        const uint64_t name_hash = aws_hash_byte_cursor_ptr_ignore_case(&name);
+        const size_t i = s_index_find(headers, name, name_enum, name_hash, NULL);
+        if (i == AWS_HTTP_HEADERS_INDEX_NONE) {
+            return aws_raise_error(AWS_ERROR_HTTP_HEADER_NOT_FOUND);
+        }
+        *out_value = s_header_at(headers, i)->value;
+        return AWS_OP_SUCCESS;
+    }
+
     const size_t count = aws_http_headers_count(headers);
     for (size_t i = 0; i < count; ++i) {
-        aws_array_list_get_at_ptr(&headers->array_list, (void **)&header, i);
-        AWS_ASSUME(header);
+        const struct aws_http_headers_entry *entry = s_entry_at(headers, i);
 
-        if (aws_http_header_name_eq(header->name, name)) {
-            *out_value = header->value;
+        if (s_entry_name_eq(entry, name, name_enum)) {
+            *out_value = entry->header.value;
             return AWS_OP_SUCCESS;
         }
     }
@@ -453,6 +941,7 @@ struct aws_http_message {
     struct aws_allocator *allocator;
     struct aws_http_headers *headers;
     struct aws_input_stream *body_stream;
+    struct aws_async_input_stream *body_async_stream;
     struct aws_atomic_var refcount;
     enum aws_http_version http_version;
 
@@ -469,6 +958,31 @@ struct aws_http_message {
 
     struct aws_http_message_request_data *request_data;
     struct aws_http_message_response_data *response_data;
+
+    /* Set if request was created from an aws_http_message_template */
+    struct aws_http_message_template *message_template;
+};
+
+/**
+ * The header lines are validated and encoded once, when the template is created.
+ * Each request from the template gets a copy of the headers, so the request looks like any other request
+ * to anyone who inspects or modifies it (HTTP/2 conversion, proxies, signers, etc).
+ * The HTTP/1 encoder can skip straight to copying encoded_header_lines,
+ * so long as the request's leading headers are still exactly the template's.
+ */
+struct aws_http_message_template {
+    struct aws_allocator *allocator;
+    struct aws_atomic_var refcount;
+
+    /* Headers, whose names and values all point into `strings` */
+    struct aws_http_headers_entry *entries;
+    size_t header_count;
+    struct aws_byte_buf strings;
+
+    /* "{name}: {value}\r\n" for each header */
+    struct aws_byte_buf encoded_header_lines;
+    bool has_connection_close_header;
+    bool has_expect_continue_header;
 };
 
 static int s_set_string_from_cursor(
@@ -497,7 +1011,8 @@ static int s_set_string_from_cursor(
 }
 static struct aws_http_message *s_message_new_common(
     struct aws_allocator *allocator,
-    struct aws_http_headers *existing_headers) {
+    struct aws_http_headers *existing_headers,
+    bool arena) {
 
     /* allocation cannot fail */
     struct aws_http_message *message = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_message));
@@ -509,7 +1024,8 @@ static struct aws_http_message *s_message_new_common(
         message->headers = existing_headers;
         aws_http_headers_acquire(message->headers);
     } else {
-        message->headers = aws_http_headers_new(allocator);
+        message->headers = arena ? aws_http_headers_new_with_arena(allocator, 0 /*block_size*/)
+                                 : aws_http_headers_new(allocator);
         if (!message->headers) {
             goto error;
         }
@@ -524,9 +1040,10 @@ error:
 static struct aws_http_message *s_message_new_request_common(
     struct aws_allocator *allocator,
     struct aws_http_headers *existing_headers,
-    enum aws_http_version version) {
+    enum aws_http_version version,
+    bool arena) {
 
-    struct aws_http_message *message = s_message_new_common(allocator, existing_headers);
+    struct aws_http_message *message = s_message_new_common(allocator, existing_headers, arena);
     if (message) {
         message->request_data = &message->subclass_data.request;
         message->http_version = version;
@@ -541,17 +1058,22 @@ struct aws_http_message *aws_http_message_new_request_with_headers(
     AWS_PRECONDITION(allocator);
     AWS_PRECONDITION(existing_headers);
 
-    return s_message_new_request_common(allocator, existing_headers, AWS_HTTP_VERSION_1_1);
+    return s_message_new_request_common(allocator, existing_headers, AWS_HTTP_VERSION_1_1, false /*arena*/);
 }
 
 struct aws_http_message *aws_http_message_new_request(struct aws_allocator *allocator) {
     AWS_PRECONDITION(allocator);
-    return s_message_new_request_common(allocator, NULL, AWS_HTTP_VERSION_1_1);
+    return s_message_new_request_common(allocator, NULL, AWS_HTTP_VERSION_1_1, false /*arena*/);
+}
+
+struct aws_http_message *aws_http_message_new_request_with_arena(struct aws_allocator *allocator) {
+    AWS_PRECONDITION(allocator);
+    return s_message_new_request_common(allocator, NULL, AWS_HTTP_VERSION_1_1, true /*arena*/);
 }
 
 struct aws_http_message *aws_http2_message_new_request(struct aws_allocator *allocator) {
     AWS_PRECONDITION(allocator);
-    return s_message_new_request_common(allocator, NULL, AWS_HTTP_VERSION_2);
+    return s_message_new_request_common(allocator, NULL, AWS_HTTP_VERSION_2, false /*arena*/);
 }
 
 static struct aws_http_message *s_http_message_new_response_common(
@@ -559,7 +1081,7 @@ static struct aws_http_message *s_http_message_new_response_common(
     enum aws_http_version version) {
     AWS_PRECONDITION(allocator);
 
-    struct aws_http_message *message = s_message_new_common(allocator, NULL);
+    struct aws_http_message *message = s_message_new_common(allocator, NULL, false /*arena*/);
     if (message) {
         message->response_data = &message->subclass_data.response;
         message->response_data->status = AWS_HTTP_STATUS_CODE_UNKNOWN;
@@ -598,6 +1120,8 @@ struct aws_http_message *aws_http_message_release(struct aws_http_message *messa
 
         aws_http_headers_release(message->headers);
         aws_input_stream_release(message->body_stream);
+        aws_async_input_stream_release(message->body_async_stream);
+        aws_http_message_template_release(message->message_template);
         aws_mem_release(message->allocator, message);
     } else {
         AWS_ASSERT(prev_refcount != 0);
@@ -614,6 +1138,248 @@ struct aws_http_message *aws_http_message_acquire(struct aws_http_message *messa
     return message;
 }
 
+/* Copy all of a template's headers into empty headers, which must be in arena mode */
+static int s_http_headers_add_template(
+    struct aws_http_headers *headers,
+    const struct aws_http_message_template *message_template) {
+
+    AWS_PRECONDITION(s_arena_is_active(headers));
+    AWS_PRECONDITION(aws_http_headers_count(headers) == 0);
+
+    if (message_template->header_count == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    if (aws_array_list_ensure_capacity(&headers->array_list, message_template->header_count - 1)) {
+        return AWS_OP_ERR;
+    }
+
+    /* Copy all the strings at once, then point each header at its part of the copy */
+    uint8_t *strmem = s_headers_acquire_strmem(headers, message_template->strings.len);
+    if (!strmem) {
+        return AWS_OP_ERR;
+    }
+    memcpy(strmem, message_template->strings.buffer, message_template->strings.len);
+
+    for (size_t i = 0; i < message_template->header_count; ++i) {
+        struct aws_http_headers_entry entry = message_template->entries[i];
+        entry.header.name.ptr = strmem + (entry.header.name.ptr - message_template->strings.buffer);
+        entry.header.value.ptr = strmem + (entry.header.value.ptr - message_template->strings.buffer);
+
+        /* Can't fail, we ensured capacity above */
+        aws_array_list_push_back(&headers->array_list, &entry);
+        s_index_on_push_back(headers);
+    }
+
+    headers->template_prefix_count = message_template->header_count;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_message_template_destroy(struct aws_http_message_template *message_template) {
+    aws_byte_buf_clean_up(&message_template->encoded_header_lines);
+    aws_byte_buf_clean_up(&message_template->strings);
+    aws_mem_release(message_template->allocator, message_template->entries);
+    aws_mem_release(message_template->allocator, message_template);
+}
+
+struct aws_http_message_template *aws_http_message_template_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_headers *headers) {
+
+    AWS_PRECONDITION(allocator);
+    AWS_PRECONDITION(headers);
+
+    /* allocation cannot fail */
+    struct aws_http_message_template *message_template =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_http_message_template));
+    message_template->allocator = allocator;
+    aws_atomic_init_int(&message_template->refcount, 1);
+
+    /* Validate headers, and determine how much space is needed */
+    const size_t header_count = aws_http_headers_count(headers);
+    size_t strings_len = 0;
+    size_t encoded_len = 0;
+    for (size_t i = 0; i < header_count; ++i) {
+        const struct aws_http_headers_entry *entry = s_entry_at(headers, i);
+        const struct aws_http_header *header = &entry->header;
+
+        /* aws_http_headers already validated the header when it was added, just find out what was wrong */
+        if (!entry->is_valid) {
+            if (!aws_strutil_is_http_token(header->name)) {
+                AWS_LOGF_ERROR(AWS_LS_HTTP_GENERAL, "id=static: Template header name is invalid");
+                aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_NAME);
+            } else {
+                AWS_LOGF_ERROR(
+                    AWS_LS_HTTP_GENERAL,
+                    "id=static: Template header '" PRInSTR "' has invalid value",
+                    AWS_BYTE_CURSOR_PRI(header->name));
+                aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_VALUE);
+            }
+            goto error;
+        }
+
+        switch (entry->name_enum) {
+            case AWS_HTTP_HEADER_CONTENT_LENGTH:
+            case AWS_HTTP_HEADER_TRANSFER_ENCODING:
+                AWS_LOGF_ERROR(
+                    AWS_LS_HTTP_GENERAL,
+                    "id=static: Template cannot contain '" PRInSTR "', it must be set on each request",
+                    AWS_BYTE_CURSOR_PRI(header->name));
+                aws_raise_error(AWS_ERROR_HTTP_INVALID_HEADER_FIELD);
+                goto error;
+            case AWS_HTTP_HEADER_CONNECTION:
+                if (aws_byte_cursor_eq_c_str(&header->value, "close")) {
+                    message_template->has_connection_close_header = true;
+                }
+                break;
+            case AWS_HTTP_HEADER_EXPECT:
+                if (aws_byte_cursor_eq_c_str_ignore_case(&header->value, "100-continue")) {
+                    message_template->has_expect_continue_header = true;
+                }
+                break;
+            default:
+                break;
+        }
+
+        /* header-line: "{name}: {value}\r\n" */
+        int err = 0;
+        err |= aws_add_size_checked(header->name.len, strings_len, &strings_len);
+        err |= aws_add_size_checked(header->value.len, strings_len, &strings_len);
+        err |= aws_add_size_checked(header->name.len, encoded_len, &encoded_len);
+        err |= aws_add_size_checked(header->value.len, encoded_len, &encoded_len);
+        err |= aws_add_size_checked(4, encoded_len, &encoded_len); /* ": " + "\r\n" */
+        if (err) {
+            goto error;
+        }
+    }
+
+    if (header_count > 0) {
+        message_template->entries = aws_mem_calloc(allocator, header_count, sizeof(struct aws_http_headers_entry));
+        if (!message_template->entries) {
+            goto error;
+        }
+    }
+    message_template->header_count = header_count;
+
+    if (aws_byte_buf_init(&message_template->strings, allocator, strings_len) ||
+        aws_byte_buf_init(&message_template->encoded_header_lines, allocator, encoded_len)) {
+        goto error;
+    }
+
+    bool wrote_all = true;
+    for (size_t i = 0; i < header_count; ++i) {
+        struct aws_http_headers_entry entry = *s_entry_at(headers, i);
+        struct aws_http_header header = entry.header;
+        struct aws_byte_buf *dst = &message_template->encoded_header_lines;
+
+        wrote_all &= aws_byte_buf_write_from_whole_cursor(dst, header.name);
+        wrote_all &= aws_byte_buf_write_u8(dst, ':');
+        wrote_all &= aws_byte_buf_write_u8(dst, ' ');
+        wrote_all &= aws_byte_buf_write_from_whole_cursor(dst, header.value);
+        wrote_all &= aws_byte_buf_write_u8(dst, '\r');
+        wrote_all &= aws_byte_buf_write_u8(dst, '\n');
+
+        /* Store our own copy of the strings, and update the cursors to point at them */
+        wrote_all &= aws_byte_buf_append_and_update(&message_template->strings, &header.name) == AWS_OP_SUCCESS;
+        wrote_all &= aws_byte_buf_append_and_update(&message_template->strings, &header.value) == AWS_OP_SUCCESS;
+        entry.header = header;
+        message_template->entries[i] = entry;
+    }
+    AWS_ASSERT(wrote_all);
+    (void)wrote_all;
+
+    return message_template;
+
+error:
+    s_message_template_destroy(message_template);
+    return NULL;
+}
+
+struct aws_http_message_template *aws_http_message_template_acquire(
+    struct aws_http_message_template *message_template) {
+
+    if (message_template != NULL) {
+        aws_atomic_fetch_add(&message_template->refcount, 1);
+    }
+
+    return message_template;
+}
+
+struct aws_http_message_template *aws_http_message_template_release(
+    struct aws_http_message_template *message_template) {
+
+    if (message_template != NULL) {
+        size_t prev_refcount = aws_atomic_fetch_sub(&message_template->refcount, 1);
+        if (prev_refcount == 1) {
+            s_message_template_destroy(message_template);
+        } else {
+            AWS_ASSERT(prev_refcount != 0);
+        }
+    }
+
+    return NULL;
+}
+
+struct aws_http_message *aws_http_message_new_request_from_template(
+    struct aws_allocator *allocator,
+    struct aws_http_message_template *message_template) {
+
+    AWS_PRECONDITION(allocator);
+    AWS_PRECONDITION(message_template);
+
+    /* Make the first block big enough for the template's strings, plus room for a few more */
+    size_t block_size;
+    if (aws_add_size_checked(message_template->strings.len, AWS_HTTP_HEADERS_DEFAULT_ARENA_BLOCK_SIZE, &block_size)) {
+        return NULL;
+    }
+
+    struct aws_http_headers *headers = s_http_headers_new_common(allocator, block_size);
+    if (!headers) {
+        return NULL;
+    }
+
+    struct aws_http_message *message = NULL;
+    if (s_http_headers_add_template(headers, message_template)) {
+        goto done;
+    }
+
+    message = s_message_new_request_common(allocator, headers, AWS_HTTP_VERSION_1_1, false /*arena*/);
+    if (message) {
+        message->message_template = aws_http_message_template_acquire(message_template);
+    }
+
+done:
+    /* On success, the message has its own hold on the headers */
+    aws_http_headers_release(headers);
+    return message;
+}
+
+bool aws_http_message_get_template_encoding(
+    const struct aws_http_message *request,
+    struct aws_byte_cursor *out_header_lines,
+    size_t *out_header_count,
+    bool *out_has_connection_close_header,
+    bool *out_has_expect_continue_header) {
+
+    AWS_PRECONDITION(request);
+    AWS_PRECONDITION(out_header_lines);
+    AWS_PRECONDITION(out_header_count);
+    AWS_PRECONDITION(out_has_connection_close_header);
+    AWS_PRECONDITION(out_has_expect_continue_header);
+
+    const struct aws_http_message_template *message_template = request->message_template;
+    if (message_template == NULL || message_template->header_count == 0 ||
+        request->headers->template_prefix_count != message_template->header_count) {
+        return false;
+    }
+
+    *out_header_lines = aws_byte_cursor_from_buf(&message_template->encoded_header_lines);
+    *out_header_count = message_template->header_count;
+    *out_has_connection_close_header = message_template->has_connection_close_header;
+    *out_has_expect_continue_header = message_template->has_expect_continue_header;
+    return true;
+}
+
 bool aws_http_message_is_request(const struct aws_http_message *message) {
     AWS_PRECONDITION(message);
     return message->request_data;
@@ -778,6 +1544,26 @@ void aws_http_message_set_body_stream(struct aws_http_message *message, struct a
     message->body_stream = body_stream;
     if (message->body_stream) {
         aws_input_stream_acquire(message->body_stream);
+
+        /* A message has one body */
+        message->body_async_stream = aws_async_input_stream_release(message->body_async_stream);
+    }
+}
+
+void aws_http_message_set_body_async_stream(
+    struct aws_http_message *message,
+    struct aws_async_input_stream *body_stream) {
+    AWS_PRECONDITION(message);
+    /* release previous stream, if any */
+    aws_async_input_stream_release(message->body_async_stream);
+
+    message->body_async_stream = body_stream;
+    if (message->body_async_stream) {
+        aws_async_input_stream_acquire(message->body_async_stream);
+
+        /* A message has one body */
+        aws_input_stream_release(message->body_stream);
+        message->body_stream = NULL;
     }
 }
 
@@ -824,11 +1610,34 @@ int aws_http1_stream_add_chunked_trailer(
     return http1_stream->vtable->http1_add_trailer(http1_stream, trailing_headers);
 }
 
+struct aws_http1_incoming_body_ref *aws_http1_stream_retain_incoming_body(
+    struct aws_http_stream *http1_stream,
+    struct aws_byte_cursor *data) {
+    AWS_PRECONDITION(http1_stream);
+    AWS_PRECONDITION(http1_stream->vtable);
+    AWS_PRECONDITION(data);
+    if (!http1_stream->vtable->http1_retain_incoming_body) {
+        AWS_LOGF_TRACE(
+            AWS_LS_HTTP_STREAM,
+            "id=%p: HTTP/1 stream only function invoked on other stream, ignoring call.",
+            (void *)http1_stream);
+        aws_raise_error(AWS_ERROR_INVALID_STATE);
+        return NULL;
+    }
+
+    return http1_stream->vtable->http1_retain_incoming_body(http1_stream, data);
+}
+
 struct aws_input_stream *aws_http_message_get_body_stream(const struct aws_http_message *message) {
     AWS_PRECONDITION(message);
     return message->body_stream;
 }
 
+struct aws_async_input_stream *aws_http_message_get_body_async_stream(const struct aws_http_message *message) {
+    AWS_PRECONDITION(message);
+    return message->body_async_stream;
+}
+
 struct aws_http_headers *aws_http_message_get_headers(const struct aws_http_message *message) {
     AWS_PRECONDITION(message);
     return message->headers;
@@ -1034,7 +1843,7 @@ struct aws_http_message *aws_http2_message_new_from_http1(
         /* append lower case name to the buffer */
         aws_byte_buf_append_with_lookup(&lower_name_buf, &header_iter.name, aws_lookup_table_to_lower_get());
         struct aws_byte_cursor lower_name_cursor = aws_byte_cursor_from_buf(&lower_name_buf);
-        enum aws_http_header_name name_enum = aws_http_lowercase_str_to_header_name(lower_name_cursor);
+        enum aws_http_header_name name_enum = s_entry_at(old_headers, iter)->name_enum;
         switch (name_enum) {
             case AWS_HTTP_HEADER_TRANSFER_ENCODING:
             case AWS_HTTP_HEADER_UPGRADE:
@@ -1071,6 +1880,7 @@ struct aws_http_message *aws_http2_message_new_from_http1(
     }
     aws_byte_buf_clean_up(&lower_name_buf);
     aws_http_message_set_body_stream(message, aws_http_message_get_body_stream(http1_msg));
+    aws_http_message_set_body_async_stream(message, aws_http_message_get_body_async_stream(http1_msg));
 
     return message;
 error:
@@ -1113,6 +1923,22 @@ int aws_http_stream_send_response(struct aws_http_stream *stream, struct aws_htt
     return stream->owning_connection->vtable->stream_send_response(stream, response);
 }
 
+int aws_http_stream_send_static_response(
+    struct aws_http_stream *stream,
+    struct aws_http_static_response *response) {
+    AWS_PRECONDITION(stream);
+    AWS_PRECONDITION(response);
+
+    if (!stream->owning_connection->vtable->stream_send_static_response) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_STREAM,
+            "id=%p: Static responses are only supported on HTTP/1.1 connections.",
+            (void *)stream);
+        return aws_raise_error(AWS_ERROR_HTTP_UNSUPPORTED_PROTOCOL);
+    }
+    return stream->owning_connection->vtable->stream_send_static_response(stream, response);
+}
+
 struct aws_http_stream *aws_http_stream_acquire(struct aws_http_stream *stream) {
     AWS_PRECONDITION(stream);
 
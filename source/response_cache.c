@@ -0,0 +1,798 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/response_cache_impl.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/common/clock.h>
+#include <aws/common/date_time.h>
+#include <aws/common/logging.h>
+#include <aws/common/math.h>
+#include <aws/common/string.h>
+#include <aws/http/private/http_impl.h>
+#include <aws/http/private/strutil.h>
+#include <aws/http/request_response.h>
+
+#include <inttypes.h>
+
+/* Without explicit freshness, a response is fresh for a tenth of the time since it was last modified
+ * (RFC 9111 4.2.2), but no longer than a day */
+#define AWS_HTTP_RESPONSE_CACHE_HEURISTIC_DIVISOR 10
+#define AWS_HTTP_RESPONSE_CACHE_MAX_HEURISTIC_SECS (24 * 60 * 60)
+
+/* A response body, shared by every version of a cached response that revalidation makes */
+struct aws_http_response_cache_slab {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+    struct aws_byte_cursor data;
+};
+
+struct aws_http_cached_response {
+    struct aws_allocator *allocator;
+    struct aws_ref_count ref_count;
+    struct aws_string *uri;
+    /* In its shard's LRU list while the shard holds it. Protected by the shard's lock */
+    struct aws_linked_list_node lru_node;
+
+    int status_code;
+    struct aws_http_headers *headers;
+    struct aws_http_response_cache_slab *body;
+    /* The values the request had for the headers named by Vary. Later requests must have the same ones */
+    struct aws_http_headers *selecting_headers;
+
+    /* In seconds. See RFC 9111 4.2.3 */
+    uint64_t response_time;
+    uint64_t corrected_initial_age;
+    uint64_t freshness_lifetime;
+
+    /* Bytes counted against the shard */
+    size_t size;
+};
+
+/* The Cache-Control directives we act on, from a request or a response */
+struct aws_http_cache_control {
+    bool no_store;
+    bool no_cache;
+    bool has_max_age;
+    uint64_t max_age;
+};
+
+static uint64_t s_now_secs(const struct aws_http_response_cache *cache) {
+    uint64_t now_ns = 0;
+    cache->system_clock_fn(&now_ns);
+    return aws_timestamp_convert(now_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_SECS, NULL);
+}
+
+/*
+ * Parsing
+ */
+
+/* Split `name=argument`, and unquote the argument */
+static struct aws_byte_cursor s_split_directive(
+    struct aws_byte_cursor directive,
+    struct aws_byte_cursor *out_argument) {
+
+    directive = aws_strutil_trim_http_whitespace(directive);
+    AWS_ZERO_STRUCT(*out_argument);
+
+    struct aws_byte_cursor name = directive;
+    for (size_t i = 0; i < directive.len; ++i) {
+        if (directive.ptr[i] == '=') {
+            name.len = i;
+            *out_argument = aws_byte_cursor_from_array(directive.ptr + i + 1, directive.len - i - 1);
+            *out_argument = aws_strutil_trim_http_whitespace(*out_argument);
+            if (out_argument->len >= 2 && out_argument->ptr[0] == '"' &&
+                out_argument->ptr[out_argument->len - 1] == '"') {
+                aws_byte_cursor_advance(out_argument, 1);
+                out_argument->len -= 1;
+            }
+            break;
+        }
+    }
+    return aws_strutil_trim_http_whitespace(name);
+}
+
+/* Qualified forms (no-cache="field") are treated like the unqualified ones, which is stricter */
+static void s_parse_cache_control(const struct aws_http_headers *headers, struct aws_http_cache_control *out) {
+    AWS_ZERO_STRUCT(*out);
+    bool has_cache_control = false;
+    bool has_pragma_no_cache = false;
+
+    const size_t num_headers = aws_http_headers_count(headers);
+    for (size_t i = 0; i < num_headers; ++i) {
+        struct aws_http_header header;
+        aws_http_headers_get_index(headers, i, &header);
+        enum aws_http_header_name name = aws_http_str_to_header_name(header.name);
+        if (name != AWS_HTTP_HEADER_CACHE_CONTROL && name != AWS_HTTP_HEADER_PRAGMA) {
+            continue;
+        }
+        has_cache_control |= name == AWS_HTTP_HEADER_CACHE_CONTROL;
+
+        struct aws_byte_cursor directive;
+        AWS_ZERO_STRUCT(directive);
+        while (aws_byte_cursor_next_split(&header.value, ',', &directive)) {
+            struct aws_byte_cursor argument;
+            struct aws_byte_cursor directive_name = s_split_directive(directive, &argument);
+            if (name == AWS_HTTP_HEADER_PRAGMA) {
+                has_pragma_no_cache |= aws_byte_cursor_eq_c_str_ignore_case(&directive_name, "no-cache");
+            } else if (aws_byte_cursor_eq_c_str_ignore_case(&directive_name, "no-store")) {
+                out->no_store = true;
+            } else if (aws_byte_cursor_eq_c_str_ignore_case(&directive_name, "no-cache")) {
+                out->no_cache = true;
+            } else if (aws_byte_cursor_eq_c_str_ignore_case(&directive_name, "max-age") && !out->has_max_age) {
+                out->has_max_age = aws_byte_cursor_utf8_parse_u64(argument, &out->max_age) == AWS_OP_SUCCESS;
+            }
+        }
+    }
+
+    /* Pragma only counts when there's no Cache-Control (RFC 9111 5.4) */
+    if (!has_cache_control && has_pragma_no_cache) {
+        out->no_cache = true;
+    }
+}
+
+/* Returns false if the header is missing or isn't a valid HTTP-date */
+static bool s_get_date_header(const struct aws_http_headers *headers, const char *name, uint64_t *out_secs) {
+    struct aws_byte_cursor value;
+    if (aws_http_headers_get(headers, aws_byte_cursor_from_c_str(name), &value)) {
+        return false;
+    }
+    struct aws_date_time date_time;
+    if (aws_date_time_init_from_str_cursor(&date_time, &value, AWS_DATE_FORMAT_RFC822)) {
+        return false;
+    }
+    time_t epoch_secs = aws_date_time_as_epoch_secs(&date_time);
+    *out_secs = epoch_secs > 0 ? (uint64_t)epoch_secs : 0;
+    return true;
+}
+
+/* Statuses that may be stored without explicit freshness (RFC 9110 15.1) */
+static bool s_is_heuristically_cacheable(int status_code) {
+    switch (status_code) {
+        case 200:
+        case 203:
+        case 204:
+        case 300:
+        case 301:
+        case 308:
+        case 404:
+        case 405:
+        case 410:
+        case 414:
+        case 501:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Hop-by-hop headers, and those describing the message rather than the response, aren't stored (RFC 9111 3.1) */
+static bool s_is_excluded_from_storage(struct aws_byte_cursor name) {
+    switch (aws_http_str_to_header_name(name)) {
+        case AWS_HTTP_HEADER_CONNECTION:
+        case AWS_HTTP_HEADER_CONTENT_LENGTH:
+        case AWS_HTTP_HEADER_TRANSFER_ENCODING:
+        case AWS_HTTP_HEADER_KEEP_ALIVE:
+        case AWS_HTTP_HEADER_PROXY_CONNECTION:
+        case AWS_HTTP_HEADER_TE:
+        case AWS_HTTP_HEADER_TRAILER:
+        case AWS_HTTP_HEADER_UPGRADE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+typedef bool(s_on_vary_name_fn)(struct aws_byte_cursor name, void *user_data);
+
+/* Invoke on_name for each field name the response's Vary headers list. Returns false if on_name stopped early */
+static bool s_for_each_vary_name(
+    const struct aws_http_headers *response_headers,
+    s_on_vary_name_fn *on_name,
+    void *user_data) {
+
+    const size_t num_headers = aws_http_headers_count(response_headers);
+    for (size_t i = 0; i < num_headers; ++i) {
+        struct aws_http_header header;
+        aws_http_headers_get_index(response_headers, i, &header);
+        if (aws_http_str_to_header_name(header.name) != AWS_HTTP_HEADER_VARY) {
+            continue;
+        }
+        struct aws_byte_cursor name;
+        AWS_ZERO_STRUCT(name);
+        while (aws_byte_cursor_next_split(&header.value, ',', &name)) {
+            struct aws_byte_cursor trimmed = aws_strutil_trim_http_whitespace(name);
+            if (trimmed.len > 0 && !on_name(trimmed, user_data)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool s_is_not_star(struct aws_byte_cursor name, void *user_data) {
+    (void)user_data;
+    return !aws_byte_cursor_eq_c_str(&name, "*");
+}
+
+struct aws_http_vary_context {
+    const struct aws_http_headers *request_headers;
+    struct aws_http_headers *selecting_headers;
+};
+
+static bool s_copy_selecting_header(struct aws_byte_cursor name, void *user_data) {
+    struct aws_http_vary_context *context = user_data;
+    struct aws_byte_cursor value;
+    if (aws_http_headers_get(context->request_headers, name, &value) == AWS_OP_SUCCESS) {
+        return aws_http_headers_add(context->selecting_headers, name, value) == AWS_OP_SUCCESS;
+    }
+    return true;
+}
+
+static bool s_matches_selecting_header(struct aws_byte_cursor name, void *user_data) {
+    struct aws_http_vary_context *context = user_data;
+    struct aws_byte_cursor request_value;
+    struct aws_byte_cursor selecting_value;
+    bool request_has = aws_http_headers_get(context->request_headers, name, &request_value) == AWS_OP_SUCCESS;
+    bool selecting_has =
+        aws_http_headers_get(context->selecting_headers, name, &selecting_value) == AWS_OP_SUCCESS;
+    if (request_has != selecting_has) {
+        return false;
+    }
+    return !request_has || aws_byte_cursor_eq(&request_value, &selecting_value);
+}
+
+/* Requests share a cache entry if they name the same authority and path */
+static struct aws_string *s_uri_new(struct aws_allocator *allocator, const struct aws_http_message *request) {
+    struct aws_byte_cursor path;
+    if (aws_http_message_get_request_path(request, &path)) {
+        return NULL;
+    }
+    struct aws_http_headers *headers = aws_http_message_get_headers(request);
+    struct aws_byte_cursor authority;
+    AWS_ZERO_STRUCT(authority);
+    if (aws_http_headers_get(headers, aws_byte_cursor_from_c_str(":authority"), &authority)) {
+        aws_http_headers_get(headers, aws_byte_cursor_from_c_str("host"), &authority);
+    }
+
+    struct aws_byte_buf uri_buf;
+    aws_byte_buf_init(&uri_buf, allocator, authority.len + path.len);
+    aws_byte_buf_append_dynamic(&uri_buf, &authority);
+    aws_byte_buf_append_dynamic(&uri_buf, &path);
+    struct aws_string *uri = aws_string_new_from_buf(allocator, &uri_buf);
+    aws_byte_buf_clean_up(&uri_buf);
+    return uri;
+}
+
+/*
+ * Cached responses
+ */
+
+static void s_slab_destroy(void *user_data) {
+    struct aws_http_response_cache_slab *slab = user_data;
+    aws_mem_release(slab->allocator, slab);
+}
+
+/* The body lives in the same allocation as the slab */
+static struct aws_http_response_cache_slab *s_slab_new(struct aws_allocator *allocator, struct aws_byte_cursor body) {
+    struct aws_http_response_cache_slab *slab =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_http_response_cache_slab) + body.len);
+    slab->allocator = allocator;
+    aws_ref_count_init(&slab->ref_count, slab, s_slab_destroy);
+    uint8_t *data = (uint8_t *)(slab + 1);
+    if (body.len > 0) {
+        memcpy(data, body.ptr, body.len);
+    }
+    slab->data = aws_byte_cursor_from_array(data, body.len);
+    return slab;
+}
+
+static void s_cached_response_destroy(void *user_data) {
+    struct aws_http_cached_response *response = user_data;
+    aws_http_headers_release(response->headers);
+    aws_http_headers_release(response->selecting_headers);
+    if (response->body) {
+        aws_ref_count_release(&response->body->ref_count);
+    }
+    aws_string_destroy(response->uri);
+    aws_mem_release(response->allocator, response);
+}
+
+static struct aws_http_cached_response *s_cached_response_new(
+    struct aws_allocator *allocator,
+    struct aws_string *uri,
+    int status_code) {
+
+    struct aws_http_cached_response *response = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_cached_response));
+    response->allocator = allocator;
+    aws_ref_count_init(&response->ref_count, response, s_cached_response_destroy);
+    response->uri = uri;
+    response->status_code = status_code;
+    response->headers = aws_http_headers_new(allocator);
+    return response;
+}
+
+/* Copy headers that may be stored, skipping any named in `replaced_by` */
+static int s_copy_stored_headers(
+    struct aws_http_headers *dest,
+    const struct aws_http_headers *src,
+    const struct aws_http_headers *replaced_by) {
+
+    const size_t num_headers = aws_http_headers_count(src);
+    for (size_t i = 0; i < num_headers; ++i) {
+        struct aws_http_header header;
+        aws_http_headers_get_index(src, i, &header);
+        if (s_is_excluded_from_storage(header.name) ||
+            (replaced_by != NULL && aws_http_headers_has(replaced_by, header.name))) {
+            continue;
+        }
+        if (aws_http_headers_add_header(dest, &header)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Work out the response's age and freshness from its headers, as of `now`, when it was received */
+static void s_cached_response_set_times(struct aws_http_cached_response *response, uint64_t now) {
+    struct aws_http_cache_control cache_control;
+    s_parse_cache_control(response->headers, &cache_control);
+
+    uint64_t date = now;
+    s_get_date_header(response->headers, "date", &date);
+
+    uint64_t age_value = 0;
+    struct aws_byte_cursor age_cursor;
+    if (aws_http_headers_get(response->headers, aws_byte_cursor_from_c_str("age"), &age_cursor) == AWS_OP_SUCCESS) {
+        aws_byte_cursor_utf8_parse_u64(aws_strutil_trim_http_whitespace(age_cursor), &age_value);
+    }
+
+    response->response_time = now;
+    response->corrected_initial_age = aws_max_u64(aws_sub_u64_saturating(now, date), age_value);
+
+    uint64_t expires = 0;
+    uint64_t last_modified = 0;
+    if (cache_control.no_cache) {
+        /* Stored, but revalidated before every use */
+        response->freshness_lifetime = 0;
+    } else if (cache_control.has_max_age) {
+        response->freshness_lifetime = cache_control.max_age;
+    } else if (aws_http_headers_has(response->headers, aws_byte_cursor_from_c_str("expires"))) {
+        /* An invalid Expires means it's already expired */
+        bool is_valid = s_get_date_header(response->headers, "expires", &expires);
+        response->freshness_lifetime = is_valid ? aws_sub_u64_saturating(expires, date) : 0;
+    } else if (
+        s_is_heuristically_cacheable(response->status_code) &&
+        s_get_date_header(response->headers, "last-modified", &last_modified)) {
+        response->freshness_lifetime = aws_min_u64(
+            aws_sub_u64_saturating(date, last_modified) / AWS_HTTP_RESPONSE_CACHE_HEURISTIC_DIVISOR,
+            AWS_HTTP_RESPONSE_CACHE_MAX_HEURISTIC_SECS);
+    } else {
+        response->freshness_lifetime = 0;
+    }
+}
+
+static void s_cached_response_set_size(struct aws_http_cached_response *response) {
+    size_t size = sizeof(struct aws_http_cached_response) + response->uri->len + response->body->data.len;
+    const size_t num_headers = aws_http_headers_count(response->headers);
+    for (size_t i = 0; i < num_headers; ++i) {
+        struct aws_http_header header;
+        aws_http_headers_get_index(response->headers, i, &header);
+        size += header.name.len + header.value.len;
+    }
+    response->size = size;
+}
+
+static bool s_cached_response_has_validators(const struct aws_http_cached_response *response) {
+    return aws_http_headers_has(response->headers, aws_byte_cursor_from_c_str("etag")) ||
+           aws_http_headers_has(response->headers, aws_byte_cursor_from_c_str("last-modified"));
+}
+
+/*
+ * Shards
+ */
+
+static struct aws_http_response_cache_shard *s_get_shard(
+    struct aws_http_response_cache *cache,
+    const struct aws_string *uri) {
+    return &cache->shards[aws_hash_string(uri) % AWS_HTTP_RESPONSE_CACHE_SHARD_COUNT];
+}
+
+static void s_shard_lock(struct aws_http_response_cache_shard *shard) {
+    int err = aws_mutex_lock(&shard->lock);
+    AWS_ASSERT(!err);
+    (void)err;
+}
+
+static void s_shard_unlock(struct aws_http_response_cache_shard *shard) {
+    int err = aws_mutex_unlock(&shard->lock);
+    AWS_ASSERT(!err);
+    (void)err;
+}
+
+/* The shard's reference moves to `removed`, to be released once the lock is let go. NOTE: lock must be held */
+static void s_shard_remove_synced(
+    struct aws_http_response_cache_shard *shard,
+    struct aws_http_cached_response *response,
+    struct aws_linked_list *removed) {
+
+    aws_hash_table_remove(&shard->responses, response->uri, NULL, NULL);
+    aws_linked_list_remove(&response->lru_node);
+    aws_linked_list_push_back(removed, &response->lru_node);
+    shard->size -= response->size;
+}
+
+static void s_release_removed(struct aws_linked_list *removed) {
+    while (!aws_linked_list_empty(removed)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(removed);
+        struct aws_http_cached_response *response = AWS_CONTAINER_OF(node, struct aws_http_cached_response, lru_node);
+        aws_ref_count_release(&response->ref_count);
+    }
+}
+
+/* The shard takes the caller's reference. Whatever was cached for the URI is replaced */
+static void s_cache_insert(struct aws_http_response_cache *cache, struct aws_http_cached_response *response) {
+    struct aws_http_response_cache_shard *shard = s_get_shard(cache, response->uri);
+    struct aws_linked_list removed;
+    aws_linked_list_init(&removed);
+    size_t num_evicted = 0;
+
+    s_shard_lock(shard);
+    /* BEGIN CRITICAL SECTION */
+    struct aws_hash_element *existing = NULL;
+    aws_hash_table_find(&shard->responses, response->uri, &existing);
+    if (existing != NULL) {
+        s_shard_remove_synced(shard, existing->value, &removed);
+    }
+
+    while (shard->size + response->size > cache->shard_capacity && !aws_linked_list_empty(&shard->lru_list)) {
+        struct aws_linked_list_node *node = aws_linked_list_back(&shard->lru_list);
+        s_shard_remove_synced(shard, AWS_CONTAINER_OF(node, struct aws_http_cached_response, lru_node), &removed);
+        ++num_evicted;
+    }
+
+    if (aws_hash_table_put(&shard->responses, response->uri, response, NULL)) {
+        aws_linked_list_push_back(&removed, &response->lru_node);
+    } else {
+        aws_linked_list_push_front(&shard->lru_list, &response->lru_node);
+        shard->size += response->size;
+    }
+    /* END CRITICAL SECTION */
+    s_shard_unlock(shard);
+
+    if (num_evicted > 0) {
+        AWS_LOGF_TRACE(
+            AWS_LS_HTTP_GENERAL,
+            "id=%p: Response cache evicted %zu least recently used responses to make room.",
+            (void *)cache,
+            num_evicted);
+    }
+    s_release_removed(&removed);
+}
+
+static void s_cache_remove(struct aws_http_response_cache *cache, const struct aws_string *uri) {
+    struct aws_http_response_cache_shard *shard = s_get_shard(cache, uri);
+    struct aws_linked_list removed;
+    aws_linked_list_init(&removed);
+
+    s_shard_lock(shard);
+    /* BEGIN CRITICAL SECTION */
+    struct aws_hash_element *existing = NULL;
+    aws_hash_table_find(&shard->responses, uri, &existing);
+    if (existing != NULL) {
+        s_shard_remove_synced(shard, existing->value, &removed);
+    }
+    /* END CRITICAL SECTION */
+    s_shard_unlock(shard);
+
+    s_release_removed(&removed);
+}
+
+/*
+ * Cache
+ */
+
+static void s_response_cache_destroy(void *user_data) {
+    struct aws_http_response_cache *cache = user_data;
+    for (size_t i = 0; i < AWS_HTTP_RESPONSE_CACHE_SHARD_COUNT; ++i) {
+        struct aws_http_response_cache_shard *shard = &cache->shards[i];
+        while (!aws_linked_list_empty(&shard->lru_list)) {
+            struct aws_linked_list_node *node = aws_linked_list_pop_front(&shard->lru_list);
+            aws_ref_count_release(&AWS_CONTAINER_OF(node, struct aws_http_cached_response, lru_node)->ref_count);
+        }
+        aws_hash_table_clean_up(&shard->responses);
+        aws_mutex_clean_up(&shard->lock);
+    }
+    aws_mem_release(cache->allocator, cache);
+}
+
+struct aws_http_response_cache *aws_http_response_cache_new(
+    struct aws_allocator *allocator,
+    const struct aws_http_response_cache_options *options) {
+
+    if (options->max_bytes == 0) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_GENERAL, "static: Response cache max_bytes must be non-zero.");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    struct aws_http_response_cache *cache = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_response_cache));
+    cache->allocator = allocator;
+    cache->shard_capacity = options->max_bytes / AWS_HTTP_RESPONSE_CACHE_SHARD_COUNT;
+    cache->system_clock_fn = aws_sys_clock_get_ticks;
+
+    size_t num_initialized = 0;
+    for (; num_initialized < AWS_HTTP_RESPONSE_CACHE_SHARD_COUNT; ++num_initialized) {
+        struct aws_http_response_cache_shard *shard = &cache->shards[num_initialized];
+        if (aws_mutex_init(&shard->lock)) {
+            goto error;
+        }
+        if (aws_hash_table_init(
+                &shard->responses,
+                allocator,
+                16,
+                aws_hash_string,
+                aws_hash_callback_string_eq,
+                NULL /*destroy_key_fn*/,
+                NULL /*destroy_value_fn*/)) {
+            aws_mutex_clean_up(&shard->lock);
+            goto error;
+        }
+        aws_linked_list_init(&shard->lru_list);
+    }
+    aws_ref_count_init(&cache->ref_count, cache, s_response_cache_destroy);
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_GENERAL,
+        "id=%p: Response cache created, holding up to %zu bytes.",
+        (void *)cache,
+        options->max_bytes);
+    return cache;
+
+error:
+    while (num_initialized > 0) {
+        --num_initialized;
+        aws_hash_table_clean_up(&cache->shards[num_initialized].responses);
+        aws_mutex_clean_up(&cache->shards[num_initialized].lock);
+    }
+    aws_mem_release(allocator, cache);
+    return NULL;
+}
+
+struct aws_http_response_cache *aws_http_response_cache_acquire(struct aws_http_response_cache *cache) {
+    if (cache) {
+        aws_ref_count_acquire(&cache->ref_count);
+    }
+    return cache;
+}
+
+void aws_http_response_cache_release(struct aws_http_response_cache *cache) {
+    if (cache) {
+        aws_ref_count_release(&cache->ref_count);
+    }
+}
+
+enum aws_http_response_cache_lookup_result aws_http_response_cache_lookup(
+    struct aws_http_response_cache *cache,
+    const struct aws_http_message *request,
+    struct aws_http_cached_response **out_response) {
+
+    *out_response = NULL;
+    struct aws_byte_cursor method;
+    if (aws_http_message_get_request_method(request, &method) || !aws_byte_cursor_eq(&method, &aws_http_method_get)) {
+        return AWS_HTTP_RESPONSE_CACHE_MISS;
+    }
+    struct aws_string *uri = s_uri_new(cache->allocator, request);
+    if (uri == NULL) {
+        return AWS_HTTP_RESPONSE_CACHE_MISS;
+    }
+
+    struct aws_http_response_cache_shard *shard = s_get_shard(cache, uri);
+    struct aws_http_cached_response *response = NULL;
+    s_shard_lock(shard);
+    /* BEGIN CRITICAL SECTION */
+    struct aws_hash_element *found = NULL;
+    aws_hash_table_find(&shard->responses, uri, &found);
+    if (found != NULL) {
+        response = found->value;
+        aws_linked_list_remove(&response->lru_node);
+        aws_linked_list_push_front(&shard->lru_list, &response->lru_node);
+        aws_ref_count_acquire(&response->ref_count);
+    }
+    /* END CRITICAL SECTION */
+    s_shard_unlock(shard);
+    aws_string_destroy(uri);
+
+    if (response == NULL) {
+        return AWS_HTTP_RESPONSE_CACHE_MISS;
+    }
+
+    /* Cached responses never change, so they're read without the lock */
+    const struct aws_http_headers *request_headers = aws_http_message_get_headers(request);
+    struct aws_http_vary_context vary_context = {
+        .request_headers = request_headers,
+        .selecting_headers = response->selecting_headers,
+    };
+    if (!s_for_each_vary_name(response->headers, s_matches_selecting_header, &vary_context)) {
+        aws_ref_count_release(&response->ref_count);
+        return AWS_HTTP_RESPONSE_CACHE_MISS;
+    }
+
+    struct aws_http_cache_control request_cache_control;
+    s_parse_cache_control(request_headers, &request_cache_control);
+    uint64_t resident_time = aws_sub_u64_saturating(s_now_secs(cache), response->response_time);
+    uint64_t current_age = aws_add_u64_saturating(response->corrected_initial_age, resident_time);
+
+    bool is_fresh = current_age < response->freshness_lifetime && !request_cache_control.no_cache &&
+                    (!request_cache_control.has_max_age || current_age <= request_cache_control.max_age);
+
+    *out_response = response;
+    return is_fresh ? AWS_HTTP_RESPONSE_CACHE_FRESH : AWS_HTTP_RESPONSE_CACHE_STALE;
+}
+
+int aws_http_response_cache_store(
+    struct aws_http_response_cache *cache,
+    const struct aws_http_message *request,
+    int status_code,
+    const struct aws_http_headers *response_headers,
+    struct aws_byte_cursor body) {
+
+    struct aws_byte_cursor method;
+    if (aws_http_message_get_request_method(request, &method)) {
+        return AWS_OP_ERR;
+    }
+    struct aws_string *uri = s_uri_new(cache->allocator, request);
+    if (uri == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    if (!aws_byte_cursor_eq(&method, &aws_http_method_get)) {
+        /* A successful unsafe request may have changed the resource (RFC 9111 4.4) */
+        bool is_safe = aws_byte_cursor_eq(&method, &aws_http_method_head) ||
+                       aws_byte_cursor_eq(&method, &aws_http_method_options);
+        if (!is_safe && status_code >= 200 && status_code < 400) {
+            s_cache_remove(cache, uri);
+        }
+        aws_string_destroy(uri);
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Partial content, and 304s that weren't a revalidation, aren't complete responses */
+    struct aws_http_cache_control request_cache_control;
+    struct aws_http_cache_control response_cache_control;
+    s_parse_cache_control(aws_http_message_get_headers(request), &request_cache_control);
+    s_parse_cache_control(response_headers, &response_cache_control);
+    if (status_code < 200 || status_code == 206 || status_code == 304 || request_cache_control.no_store ||
+        response_cache_control.no_store || !s_for_each_vary_name(response_headers, s_is_not_star, NULL)) {
+        aws_string_destroy(uri);
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_http_cached_response *response = s_cached_response_new(cache->allocator, uri, status_code);
+    response->selecting_headers = aws_http_headers_new(cache->allocator);
+    struct aws_http_vary_context vary_context = {
+        .request_headers = aws_http_message_get_headers(request),
+        .selecting_headers = response->selecting_headers,
+    };
+    if (s_copy_stored_headers(response->headers, response_headers, NULL) ||
+        !s_for_each_vary_name(response_headers, s_copy_selecting_header, &vary_context)) {
+        aws_ref_count_release(&response->ref_count);
+        return AWS_OP_ERR;
+    }
+    response->body = s_slab_new(cache->allocator, body);
+    s_cached_response_set_times(response, s_now_secs(cache));
+    s_cached_response_set_size(response);
+
+    /* Stale and unverifiable is useless. Too big would evict the whole shard for one response */
+    if ((response->freshness_lifetime == 0 && !s_cached_response_has_validators(response)) ||
+        response->size > cache->shard_capacity) {
+        aws_ref_count_release(&response->ref_count);
+        return AWS_OP_SUCCESS;
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_GENERAL,
+        "id=%p: Response cache storing %d response, fresh for %" PRIu64 " seconds.",
+        (void *)cache,
+        status_code,
+        aws_sub_u64_saturating(response->freshness_lifetime, response->corrected_initial_age));
+    s_cache_insert(cache, response);
+    return AWS_OP_SUCCESS;
+}
+
+struct aws_http_cached_response *aws_http_response_cache_update(
+    struct aws_http_response_cache *cache,
+    struct aws_http_cached_response *stale_response,
+    const struct aws_http_headers *not_modified_headers) {
+
+    struct aws_string *uri = aws_string_new_from_string(cache->allocator, stale_response->uri);
+    if (uri == NULL) {
+        return NULL;
+    }
+
+    /* The 304's headers replace the stored ones of the same name (RFC 9111 4.3.4). The body is shared */
+    struct aws_http_cached_response *response =
+        s_cached_response_new(cache->allocator, uri, stale_response->status_code);
+    if (s_copy_stored_headers(response->headers, stale_response->headers, not_modified_headers) ||
+        s_copy_stored_headers(response->headers, not_modified_headers, NULL)) {
+        aws_ref_count_release(&response->ref_count);
+        return NULL;
+    }
+    response->selecting_headers = stale_response->selecting_headers;
+    aws_http_headers_acquire(response->selecting_headers);
+    response->body = stale_response->body;
+    aws_ref_count_acquire(&response->body->ref_count);
+    s_cached_response_set_times(response, s_now_secs(cache));
+    s_cached_response_set_size(response);
+
+    if (response->size <= cache->shard_capacity) {
+        aws_ref_count_acquire(&response->ref_count);
+        s_cache_insert(cache, response);
+    }
+    return response;
+}
+
+size_t aws_http_response_cache_get_size(const struct aws_http_response_cache *cache) {
+    struct aws_http_response_cache *mutable_cache = (struct aws_http_response_cache *)cache;
+    size_t size = 0;
+    for (size_t i = 0; i < AWS_HTTP_RESPONSE_CACHE_SHARD_COUNT; ++i) {
+        struct aws_http_response_cache_shard *shard = &mutable_cache->shards[i];
+        s_shard_lock(shard);
+        size += shard->size;
+        s_shard_unlock(shard);
+    }
+    return size;
+}
+
+struct aws_http_cached_response *aws_http_cached_response_acquire(struct aws_http_cached_response *response) {
+    if (response) {
+        aws_ref_count_acquire(&response->ref_count);
+    }
+    return response;
+}
+
+void aws_http_cached_response_release(struct aws_http_cached_response *response) {
+    if (response) {
+        aws_ref_count_release(&response->ref_count);
+    }
+}
+
+int aws_http_cached_response_get_status(const struct aws_http_cached_response *response) {
+    return response->status_code;
+}
+
+const struct aws_http_headers *aws_http_cached_response_get_headers(const struct aws_http_cached_response *response) {
+    return response->headers;
+}
+
+struct aws_byte_cursor aws_http_cached_response_get_body(const struct aws_http_cached_response *response) {
+    return response->body->data;
+}
+
+int aws_http_cached_response_add_validators(
+    const struct aws_http_cached_response *response,
+    struct aws_http_message *request) {
+
+    struct aws_http_headers *request_headers = aws_http_message_get_headers(request);
+    bool has_validator = false;
+    struct aws_byte_cursor value;
+    if (aws_http_headers_get(response->headers, aws_byte_cursor_from_c_str("etag"), &value) == AWS_OP_SUCCESS) {
+        if (aws_http_headers_set(request_headers, aws_byte_cursor_from_c_str("if-none-match"), value)) {
+            return AWS_OP_ERR;
+        }
+        has_validator = true;
+    }
+    if (aws_http_headers_get(response->headers, aws_byte_cursor_from_c_str("last-modified"), &value) ==
+        AWS_OP_SUCCESS) {
+        if (aws_http_headers_set(request_headers, aws_byte_cursor_from_c_str("if-modified-since"), value)) {
+            return AWS_OP_ERR;
+        }
+        has_validator = true;
+    }
+    if (!has_validator) {
+        return aws_raise_error(AWS_ERROR_HTTP_HEADER_NOT_FOUND);
+    }
+    return AWS_OP_SUCCESS;
+}
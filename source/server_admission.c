@@ -0,0 +1,243 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/server_admission.h>
+
+#include <aws/common/clock.h>
+#include <aws/http/request_response.h>
+#include <aws/http/status_code.h>
+#include <aws/io/event_loop.h>
+#include <aws/io/logging.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4204) /* non-constant aggregate initializer */
+#endif
+
+static void s_lag_probe_task(struct aws_task *task, void *arg, enum aws_task_status status);
+
+static void s_lag_probe_schedule(struct aws_http_server_lag_probe *probe, uint64_t now_ns) {
+    probe->scheduled_run_ns = now_ns + aws_timestamp_convert(
+                                           AWS_HTTP_SERVER_LAG_PROBE_INTERVAL_MS,
+                                           AWS_TIMESTAMP_MILLIS,
+                                           AWS_TIMESTAMP_NANOS,
+                                           NULL);
+    aws_event_loop_schedule_task_future(probe->event_loop, &probe->task, probe->scheduled_run_ns);
+}
+
+/* Runs on the probe's event loop. The later it runs, the further behind the event loop is */
+static void s_lag_probe_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_http_server_lag_probe *probe = arg;
+    struct aws_http_server_admission *admission = probe->admission;
+
+    if (status != AWS_TASK_STATUS_RUN_READY || aws_atomic_load_int(&admission->is_stopped)) {
+        aws_http_server_admission_release(admission);
+        return;
+    }
+
+    uint64_t now_ns = 0;
+    aws_event_loop_current_clock_time(probe->event_loop, &now_ns);
+
+    uint64_t lag_ns = now_ns > probe->scheduled_run_ns ? now_ns - probe->scheduled_run_ns : 0;
+    uint64_t lag_ms = aws_timestamp_convert(lag_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MILLIS, NULL);
+    size_t prev_lag_ms = aws_atomic_exchange_int(&probe->lag_ms, (size_t)lag_ms);
+
+    if ((lag_ms > admission->options.max_event_loop_lag_ms) !=
+        (prev_lag_ms > admission->options.max_event_loop_lag_ms)) {
+        AWS_LOGF_INFO(
+            AWS_LS_HTTP_SERVER,
+            "id=%p: Event loop %p is %" PRIu64 "ms behind, %s shedding load.",
+            (void *)admission,
+            (void *)probe->event_loop,
+            lag_ms,
+            lag_ms > admission->options.max_event_loop_lag_ms ? "started" : "stopped");
+    }
+
+    s_lag_probe_schedule(probe, now_ns);
+}
+
+static void s_admission_destroy(void *user_data) {
+    struct aws_http_server_admission *admission = user_data;
+
+    aws_http_static_response_release(admission->shed_response);
+    aws_mem_release(admission->allocator, admission->probes);
+    aws_mem_release(admission->allocator, admission);
+}
+
+static struct aws_http_static_response *s_new_shed_response(
+    struct aws_allocator *allocator,
+    const struct aws_http_server_admission_options *options) {
+
+    struct aws_http_message *response = aws_http_message_new_response(allocator);
+    if (!response) {
+        return NULL;
+    }
+
+    if (aws_http_message_set_response_status(response, AWS_HTTP_STATUS_CODE_503_SERVICE_UNAVAILABLE)) {
+        goto error;
+    }
+
+    struct aws_http_headers *headers = aws_http_message_get_headers(response);
+    if (options->retry_after_sec > 0) {
+        char retry_after[16];
+        snprintf(retry_after, sizeof(retry_after), "%" PRIu32, options->retry_after_sec);
+        if (aws_http_headers_add(
+                headers, aws_byte_cursor_from_c_str("Retry-After"), aws_byte_cursor_from_c_str(retry_after))) {
+            goto error;
+        }
+    }
+
+    if (aws_http_headers_add(headers, aws_byte_cursor_from_c_str("Content-Length"), aws_byte_cursor_from_c_str("0"))) {
+        goto error;
+    }
+
+    struct aws_http_static_response *static_response = aws_http_static_response_new(allocator, response);
+    aws_http_message_release(response);
+    return static_response;
+
+error:
+    aws_http_message_release(response);
+    return NULL;
+}
+
+struct aws_http_server_admission *aws_http_server_admission_new(
+    struct aws_allocator *allocator,
+    struct aws_event_loop_group *event_loop_group,
+    const struct aws_http_server_admission_options *options) {
+
+    struct aws_http_server_admission *admission =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_http_server_admission));
+    admission->allocator = allocator;
+    admission->options = *options;
+    aws_ref_count_init(&admission->ref_count, admission, s_admission_destroy);
+    aws_atomic_init_int(&admission->connection_count, 0);
+    aws_atomic_init_int(&admission->in_flight_stream_count, 0);
+    aws_atomic_init_int(&admission->is_stopped, 0);
+
+    admission->shed_response = s_new_shed_response(allocator, options);
+    if (!admission->shed_response) {
+        goto error;
+    }
+
+    if (options->max_event_loop_lag_ms > 0) {
+        admission->probe_count = aws_event_loop_group_get_loop_count(event_loop_group);
+        admission->probes =
+            aws_mem_calloc(allocator, admission->probe_count, sizeof(struct aws_http_server_lag_probe));
+
+        for (size_t i = 0; i < admission->probe_count; ++i) {
+            struct aws_http_server_lag_probe *probe = &admission->probes[i];
+            probe->admission = aws_http_server_admission_acquire(admission);
+            probe->event_loop = aws_event_loop_group_get_loop_at(event_loop_group, i);
+            aws_atomic_init_int(&probe->lag_ms, 0);
+            aws_task_init(&probe->task, s_lag_probe_task, probe, "http_server_lag_probe");
+
+            uint64_t now_ns = 0;
+            aws_event_loop_current_clock_time(probe->event_loop, &now_ns);
+            s_lag_probe_schedule(probe, now_ns);
+        }
+    }
+
+    return admission;
+
+error:
+    aws_http_server_admission_release(admission);
+    return NULL;
+}
+
+struct aws_http_server_admission *aws_http_server_admission_acquire(struct aws_http_server_admission *admission) {
+    if (admission) {
+        aws_ref_count_acquire(&admission->ref_count);
+    }
+    return admission;
+}
+
+void aws_http_server_admission_release(struct aws_http_server_admission *admission) {
+    if (admission) {
+        aws_ref_count_release(&admission->ref_count);
+    }
+}
+
+void aws_http_server_admission_stop(struct aws_http_server_admission *admission) {
+    aws_atomic_store_int(&admission->is_stopped, 1);
+}
+
+uint64_t aws_http_server_admission_get_event_loop_lag_ms(
+    const struct aws_http_server_admission *admission,
+    const struct aws_event_loop *event_loop) {
+
+    for (size_t i = 0; i < admission->probe_count; ++i) {
+        if (admission->probes[i].event_loop == event_loop) {
+            return aws_atomic_load_int(&admission->probes[i].lag_ms);
+        }
+    }
+    return 0;
+}
+
+static bool s_is_event_loop_overloaded(
+    const struct aws_http_server_admission *admission,
+    const struct aws_event_loop *event_loop) {
+
+    return admission->options.max_event_loop_lag_ms > 0 &&
+           aws_http_server_admission_get_event_loop_lag_ms(admission, event_loop) >
+               admission->options.max_event_loop_lag_ms;
+}
+
+/* Count one more against the limit, unless the limit has been reached. A max of 0 means no limit */
+static bool s_try_increment(struct aws_atomic_var *count, size_t max) {
+    size_t current = aws_atomic_load_int(count);
+    do {
+        if (max > 0 && current >= max) {
+            return false;
+        }
+    } while (!aws_atomic_compare_exchange_int(count, &current, current + 1));
+
+    return true;
+}
+
+bool aws_http_server_admission_try_admit_connection(
+    struct aws_http_server_admission *admission,
+    struct aws_event_loop *event_loop) {
+
+    if (s_is_event_loop_overloaded(admission, event_loop)) {
+        return false;
+    }
+    return s_try_increment(&admission->connection_count, admission->options.max_connections);
+}
+
+void aws_http_server_admission_on_connection_closed(struct aws_http_server_admission *admission) {
+    size_t prev = aws_atomic_fetch_sub(&admission->connection_count, 1);
+    AWS_FATAL_ASSERT(prev > 0);
+    (void)prev;
+}
+
+bool aws_http_server_admission_try_admit_stream(
+    struct aws_http_server_admission *admission,
+    struct aws_event_loop *event_loop) {
+
+    if (s_is_event_loop_overloaded(admission, event_loop)) {
+        return false;
+    }
+    return s_try_increment(&admission->in_flight_stream_count, admission->options.max_in_flight_streams);
+}
+
+void aws_http_server_admission_on_stream_complete(struct aws_http_server_admission *admission) {
+    size_t prev = aws_atomic_fetch_sub(&admission->in_flight_stream_count, 1);
+    AWS_FATAL_ASSERT(prev > 0);
+    (void)prev;
+}
+
+bool aws_http_server_admission_is_overloaded(
+    const struct aws_http_server_admission *admission,
+    const struct aws_event_loop *event_loop) {
+
+    if (s_is_event_loop_overloaded(admission, event_loop)) {
+        return true;
+    }
+    return admission->options.max_in_flight_streams > 0 &&
+           aws_atomic_load_int(&admission->in_flight_stream_count) >= admission->options.max_in_flight_streams;
+}
@@ -0,0 +1,513 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/server_listener_group.h>
+
+#include <aws/common/mutex.h>
+#include <aws/io/channel.h>
+#include <aws/io/event_loop.h>
+#include <aws/io/logging.h>
+#include <aws/io/socket.h>
+#include <aws/io/socket_channel_handler.h>
+#include <aws/io/tls_channel_handler.h>
+
+#ifndef _WIN32
+#    include <sys/socket.h>
+#endif
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4204) /* non-constant aggregate initializer */
+#endif
+
+/* Same backlog aws_server_bootstrap uses */
+#define LISTENER_BACKLOG 1024
+
+/* One listening socket, and the event loop that accepts on it and runs its connections */
+struct aws_http_server_listener {
+    struct aws_http_server_listener_group *listener_group;
+    struct aws_event_loop *event_loop;
+    struct aws_socket socket;
+    struct aws_task stop_task;
+    bool is_initialized;
+    bool is_listening;
+};
+
+struct aws_http_server_listener_group {
+    struct aws_allocator *allocator;
+    struct aws_socket_endpoint endpoint;
+    struct aws_socket_options socket_options;
+    struct aws_tls_connection_options tls_options;
+    bool is_using_tls;
+    bool enable_read_back_pressure;
+    aws_server_bootstrap_on_accept_channel_setup_fn *incoming_callback;
+    aws_server_bootstrap_on_accept_channel_shutdown_fn *shutdown_callback;
+    aws_server_bootstrap_on_server_listener_destroy_fn *destroy_callback;
+    void *user_data;
+
+    size_t listener_count;
+    struct aws_http_server_listener *listeners;
+
+    /* Any thread may touch this data, but the lock must be held */
+    struct {
+        struct aws_mutex lock;
+        bool is_destroying;
+        bool is_destroy_complete;
+        size_t open_listener_count;
+        size_t channel_count;
+    } synced_data;
+};
+
+/* An accepted connection, from accept until its channel is destroyed */
+struct aws_http_server_incoming {
+    struct aws_http_server_listener_group *listener_group;
+    struct aws_socket *socket;
+    struct aws_channel *channel;
+    /* Once the user has been told about the channel, they're told about its shutdown too */
+    bool is_user_notified;
+};
+
+static void s_lock_synced_data(struct aws_http_server_listener_group *listener_group) {
+    int err = aws_mutex_lock(&listener_group->synced_data.lock);
+    AWS_ASSERT(!err);
+    (void)err;
+}
+
+static void s_unlock_synced_data(struct aws_http_server_listener_group *listener_group) {
+    int err = aws_mutex_unlock(&listener_group->synced_data.lock);
+    AWS_ASSERT(!err);
+    (void)err;
+}
+
+static void s_listener_group_clean_up(struct aws_http_server_listener_group *listener_group) {
+    for (size_t i = 0; i < listener_group->listener_count; ++i) {
+        struct aws_http_server_listener *listener = &listener_group->listeners[i];
+        if (listener->is_initialized) {
+            aws_socket_clean_up(&listener->socket);
+        }
+    }
+
+    if (listener_group->is_using_tls) {
+        aws_tls_connection_options_clean_up(&listener_group->tls_options);
+    }
+    aws_mutex_clean_up(&listener_group->synced_data.lock);
+    aws_mem_release(listener_group->allocator, listener_group->listeners);
+    aws_mem_release(listener_group->allocator, listener_group);
+}
+
+/* Invoke destroy_callback if nothing is left open. Call without the lock held */
+static void s_finish_destroy_if_done(struct aws_http_server_listener_group *listener_group) {
+    s_lock_synced_data(listener_group);
+    bool is_done = listener_group->synced_data.is_destroying && !listener_group->synced_data.is_destroy_complete &&
+                   listener_group->synced_data.open_listener_count == 0 &&
+                   listener_group->synced_data.channel_count == 0;
+    if (is_done) {
+        listener_group->synced_data.is_destroy_complete = true;
+    }
+    s_unlock_synced_data(listener_group);
+
+    if (!is_done) {
+        return;
+    }
+
+    AWS_LOGF_DEBUG(AWS_LS_HTTP_SERVER, "id=%p: All listeners and connections closed.", (void *)listener_group);
+
+    aws_server_bootstrap_on_server_listener_destroy_fn *destroy_callback = listener_group->destroy_callback;
+    void *user_data = listener_group->user_data;
+    s_listener_group_clean_up(listener_group);
+
+    if (destroy_callback) {
+        destroy_callback(NULL, user_data);
+    }
+}
+
+static void s_incoming_destroy(struct aws_http_server_incoming *incoming) {
+    struct aws_http_server_listener_group *listener_group = incoming->listener_group;
+
+    if (incoming->channel) {
+        aws_channel_destroy(incoming->channel);
+    }
+    aws_socket_clean_up(incoming->socket);
+    aws_mem_release(listener_group->allocator, incoming->socket);
+    aws_mem_release(listener_group->allocator, incoming);
+
+    s_lock_synced_data(listener_group);
+    listener_group->synced_data.channel_count--;
+    s_unlock_synced_data(listener_group);
+
+    s_finish_destroy_if_done(listener_group);
+}
+
+static void s_incoming_notify_user(struct aws_http_server_incoming *incoming) {
+    incoming->is_user_notified = true;
+    incoming->listener_group->incoming_callback(
+        NULL, AWS_ERROR_SUCCESS, incoming->channel, incoming->listener_group->user_data);
+}
+
+static void s_on_tls_negotiation_result(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    int error_code,
+    void *user_data) {
+
+    struct aws_http_server_incoming *incoming = user_data;
+    struct aws_http_server_listener_group *listener_group = incoming->listener_group;
+
+    if (listener_group->tls_options.on_negotiation_result) {
+        listener_group->tls_options.on_negotiation_result(
+            handler, slot, error_code, listener_group->tls_options.user_data);
+    }
+
+    if (error_code) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_SERVER,
+            "id=%p: TLS negotiation failed on incoming connection, error %d (%s).",
+            (void *)listener_group,
+            error_code,
+            aws_error_name(error_code));
+        listener_group->incoming_callback(NULL, error_code, NULL, listener_group->user_data);
+        aws_channel_shutdown(incoming->channel, error_code);
+        return;
+    }
+
+    s_incoming_notify_user(incoming);
+}
+
+static int s_incoming_add_handlers(struct aws_http_server_incoming *incoming) {
+    struct aws_http_server_listener_group *listener_group = incoming->listener_group;
+
+    struct aws_channel_slot *socket_slot = aws_channel_slot_new(incoming->channel);
+    if (!socket_slot) {
+        return AWS_OP_ERR;
+    }
+    if (aws_channel_slot_insert_end(incoming->channel, socket_slot)) {
+        return AWS_OP_ERR;
+    }
+    struct aws_channel_handler *socket_handler = aws_socket_handler_new(
+        listener_group->allocator, incoming->socket, socket_slot, g_aws_channel_max_fragment_size);
+    if (!socket_handler) {
+        return AWS_OP_ERR;
+    }
+    if (aws_channel_slot_set_handler(socket_slot, socket_handler)) {
+        aws_channel_handler_destroy(socket_handler);
+        return AWS_OP_ERR;
+    }
+
+    if (!listener_group->is_using_tls) {
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Intercept the negotiation result, the user hears about the channel once TLS is up */
+    struct aws_tls_connection_options tls_options = listener_group->tls_options;
+    tls_options.on_negotiation_result = s_on_tls_negotiation_result;
+    tls_options.user_data = incoming;
+
+    struct aws_channel_slot *tls_slot = aws_channel_slot_new(incoming->channel);
+    if (!tls_slot) {
+        return AWS_OP_ERR;
+    }
+    if (aws_channel_slot_insert_end(incoming->channel, tls_slot)) {
+        return AWS_OP_ERR;
+    }
+    struct aws_channel_handler *tls_handler =
+        aws_tls_server_handler_new(listener_group->allocator, &tls_options, tls_slot);
+    if (!tls_handler) {
+        return AWS_OP_ERR;
+    }
+    if (aws_channel_slot_set_handler(tls_slot, tls_handler)) {
+        aws_channel_handler_destroy(tls_handler);
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_incoming_channel_setup(struct aws_channel *channel, int error_code, void *user_data) {
+    struct aws_http_server_incoming *incoming = user_data;
+    struct aws_http_server_listener_group *listener_group = incoming->listener_group;
+
+    if (error_code) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_SERVER,
+            "id=%p: Failed to set up channel for incoming connection, error %d (%s).",
+            (void *)listener_group,
+            error_code,
+            aws_error_name(error_code));
+        listener_group->incoming_callback(NULL, error_code, NULL, listener_group->user_data);
+        s_incoming_destroy(incoming);
+        return;
+    }
+
+    if (s_incoming_add_handlers(incoming)) {
+        error_code = aws_last_error();
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_SERVER,
+            "id=%p: Failed to set up handlers for incoming connection, error %d (%s).",
+            (void *)listener_group,
+            error_code,
+            aws_error_name(error_code));
+        listener_group->incoming_callback(NULL, error_code, NULL, listener_group->user_data);
+        aws_channel_shutdown(channel, error_code);
+        return;
+    }
+
+    if (!listener_group->is_using_tls) {
+        s_incoming_notify_user(incoming);
+    }
+}
+
+static void s_on_incoming_channel_shutdown(struct aws_channel *channel, int error_code, void *user_data) {
+    struct aws_http_server_incoming *incoming = user_data;
+    struct aws_http_server_listener_group *listener_group = incoming->listener_group;
+
+    if (incoming->is_user_notified) {
+        listener_group->shutdown_callback(NULL, error_code, channel, listener_group->user_data);
+    }
+
+    s_incoming_destroy(incoming);
+}
+
+/* Invoked on the listener's event loop thread */
+static void s_on_accept_result(
+    struct aws_socket *socket,
+    int error_code,
+    struct aws_socket *new_socket,
+    void *user_data) {
+
+    (void)socket;
+    struct aws_http_server_listener *listener = user_data;
+    struct aws_http_server_listener_group *listener_group = listener->listener_group;
+
+    if (error_code) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_SERVER,
+            "id=%p: Accept failed, error %d (%s).",
+            (void *)listener_group,
+            error_code,
+            aws_error_name(error_code));
+        listener_group->incoming_callback(NULL, error_code, NULL, listener_group->user_data);
+        return;
+    }
+
+    s_lock_synced_data(listener_group);
+    bool is_destroying = listener_group->synced_data.is_destroying;
+    if (!is_destroying) {
+        listener_group->synced_data.channel_count++;
+    }
+    s_unlock_synced_data(listener_group);
+
+    if (is_destroying) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_SERVER, "id=%p: Closing connection accepted while shutting down.", (void *)listener_group);
+        aws_socket_clean_up(new_socket);
+        aws_mem_release(listener_group->allocator, new_socket);
+        return;
+    }
+
+    struct aws_http_server_incoming *incoming =
+        aws_mem_calloc(listener_group->allocator, 1, sizeof(struct aws_http_server_incoming));
+    incoming->listener_group = listener_group;
+    incoming->socket = new_socket;
+
+    /* The connection stays on the event loop that accepted it */
+    if (aws_socket_assign_to_event_loop(new_socket, listener->event_loop)) {
+        goto error;
+    }
+
+    struct aws_channel_options channel_options = {
+        .event_loop = listener->event_loop,
+        .on_setup_completed = s_on_incoming_channel_setup,
+        .setup_user_data = incoming,
+        .on_shutdown_completed = s_on_incoming_channel_shutdown,
+        .shutdown_user_data = incoming,
+        .enable_read_back_pressure = listener_group->enable_read_back_pressure,
+    };
+
+    incoming->channel = aws_channel_new(listener_group->allocator, &channel_options);
+    if (!incoming->channel) {
+        goto error;
+    }
+
+    return;
+
+error:
+    error_code = aws_last_error();
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_SERVER,
+        "id=%p: Failed to set up incoming connection, error %d (%s).",
+        (void *)listener_group,
+        error_code,
+        aws_error_name(error_code));
+    listener_group->incoming_callback(NULL, error_code, NULL, listener_group->user_data);
+    s_incoming_destroy(incoming);
+}
+
+static int s_set_reuse_port(struct aws_socket *socket) {
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+    int option_value = 1;
+    if (setsockopt(socket->io_handle.data.fd, SOL_SOCKET, SO_REUSEPORT, &option_value, sizeof(option_value))) {
+        return aws_raise_error(AWS_IO_SYS_CALL_FAILURE);
+    }
+    return AWS_OP_SUCCESS;
+#else
+    (void)socket;
+    return aws_raise_error(AWS_ERROR_PLATFORM_NOT_SUPPORTED);
+#endif
+}
+
+static int s_listener_start(struct aws_http_server_listener *listener) {
+    struct aws_http_server_listener_group *listener_group = listener->listener_group;
+
+    if (aws_socket_init(&listener->socket, listener_group->allocator, &listener_group->socket_options)) {
+        return AWS_OP_ERR;
+    }
+    listener->is_initialized = true;
+
+    if (s_set_reuse_port(&listener->socket)) {
+        return AWS_OP_ERR;
+    }
+    if (aws_socket_bind(&listener->socket, &listener_group->endpoint)) {
+        return AWS_OP_ERR;
+    }
+    if (aws_socket_listen(&listener->socket, LISTENER_BACKLOG)) {
+        return AWS_OP_ERR;
+    }
+
+    /* If the OS picked the port, the rest of the listeners need to share it */
+    listener_group->endpoint = listener->socket.local_endpoint;
+
+    if (aws_socket_start_accept(&listener->socket, listener->event_loop, s_on_accept_result, listener)) {
+        return AWS_OP_ERR;
+    }
+    listener->is_listening = true;
+    return AWS_OP_SUCCESS;
+}
+
+struct aws_http_server_listener_group *aws_http_server_listener_group_new(
+    const struct aws_http_server_listener_group_options *options) {
+
+    AWS_PRECONDITION(options);
+
+    if (options->socket_options->domain != AWS_SOCKET_IPV4 && options->socket_options->domain != AWS_SOCKET_IPV6) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_SERVER, "static: A listener per event loop needs an IPv4 or IPv6 socket.");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    struct aws_http_server_listener_group *listener_group =
+        aws_mem_calloc(options->allocator, 1, sizeof(struct aws_http_server_listener_group));
+    listener_group->allocator = options->allocator;
+    listener_group->endpoint = *options->endpoint;
+    listener_group->socket_options = *options->socket_options;
+    listener_group->enable_read_back_pressure = options->enable_read_back_pressure;
+    listener_group->incoming_callback = options->incoming_callback;
+    listener_group->shutdown_callback = options->shutdown_callback;
+    listener_group->destroy_callback = options->destroy_callback;
+    listener_group->user_data = options->user_data;
+
+    listener_group->listener_count = aws_event_loop_group_get_loop_count(options->event_loop_group);
+    listener_group->listeners = aws_mem_calloc(
+        options->allocator, listener_group->listener_count, sizeof(struct aws_http_server_listener));
+
+    if (aws_mutex_init(&listener_group->synced_data.lock)) {
+        aws_mem_release(options->allocator, listener_group->listeners);
+        aws_mem_release(options->allocator, listener_group);
+        return NULL;
+    }
+
+    if (options->tls_options) {
+        if (aws_tls_connection_options_copy(&listener_group->tls_options, options->tls_options)) {
+            goto error;
+        }
+        listener_group->is_using_tls = true;
+    }
+
+    /* Protect against accept callbacks firing before every listener is set up */
+    s_lock_synced_data(listener_group);
+    int err = AWS_OP_SUCCESS;
+    for (size_t i = 0; i < listener_group->listener_count && !err; ++i) {
+        struct aws_http_server_listener *listener = &listener_group->listeners[i];
+        listener->listener_group = listener_group;
+        listener->event_loop = aws_event_loop_group_get_loop_at(options->event_loop_group, i);
+        err = s_listener_start(listener);
+        if (listener->is_listening) {
+            listener_group->synced_data.open_listener_count++;
+        }
+    }
+    s_unlock_synced_data(listener_group);
+
+    if (err) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_SERVER,
+            "static: Failed to set up a listener per event loop, error %d (%s).",
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+
+        /* The caller cleans up after a failed new(), don't call back into it */
+        listener_group->destroy_callback = NULL;
+        aws_http_server_listener_group_destroy(listener_group);
+        return NULL;
+    }
+
+    AWS_LOGF_INFO(
+        AWS_LS_HTTP_SERVER,
+        "id=%p %s:%u: Listening on %zu event loops.",
+        (void *)listener_group,
+        listener_group->endpoint.address,
+        listener_group->endpoint.port,
+        listener_group->listener_count);
+
+    return listener_group;
+
+error:
+    s_listener_group_clean_up(listener_group);
+    return NULL;
+}
+
+/* Stop accepting, must happen on the listener's event loop thread */
+static void s_listener_stop_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    (void)status;
+    struct aws_http_server_listener *listener = arg;
+    struct aws_http_server_listener_group *listener_group = listener->listener_group;
+
+    aws_socket_stop_accept(&listener->socket);
+    aws_socket_close(&listener->socket);
+
+    s_lock_synced_data(listener_group);
+    listener_group->synced_data.open_listener_count--;
+    s_unlock_synced_data(listener_group);
+
+    s_finish_destroy_if_done(listener_group);
+}
+
+void aws_http_server_listener_group_destroy(struct aws_http_server_listener_group *listener_group) {
+    if (!listener_group) {
+        return;
+    }
+
+    AWS_LOGF_DEBUG(AWS_LS_HTTP_SERVER, "id=%p: Closing listeners.", (void *)listener_group);
+
+    s_lock_synced_data(listener_group);
+    AWS_FATAL_ASSERT(!listener_group->synced_data.is_destroying);
+    listener_group->synced_data.is_destroying = true;
+    s_unlock_synced_data(listener_group);
+
+    for (size_t i = 0; i < listener_group->listener_count; ++i) {
+        struct aws_http_server_listener *listener = &listener_group->listeners[i];
+        if (listener->is_listening) {
+            aws_task_init(&listener->stop_task, s_listener_stop_task, listener, "http_server_listener_stop");
+            aws_event_loop_schedule_task_now(listener->event_loop, &listener->stop_task);
+        }
+    }
+
+    /* In case no listeners ever started */
+    s_finish_destroy_if_done(listener_group);
+}
+
+const struct aws_socket_endpoint *aws_http_server_listener_group_get_endpoint(
+    const struct aws_http_server_listener_group *listener_group) {
+
+    return &listener_group->endpoint;
+}
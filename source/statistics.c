@@ -5,6 +5,8 @@
 
 #include <aws/http/statistics.h>
 
+#include <aws/common/math.h>
+
 int aws_crt_statistics_http1_channel_init(struct aws_crt_statistics_http1_channel *stats) {
     AWS_ZERO_STRUCT(*stats);
     stats->category = AWSCRT_STAT_CAT_HTTP1_CHANNEL;
@@ -21,6 +23,10 @@ void aws_crt_statistics_http1_channel_reset(struct aws_crt_statistics_http1_chan
     stats->pending_incoming_stream_ms = 0;
     stats->current_outgoing_stream_id = 0;
     stats->current_incoming_stream_id = 0;
+    stats->bytes_written = 0;
+    stats->bytes_read = 0;
+    stats->streams_completed = 0;
+    stats->streams_failed = 0;
 }
 
 void aws_crt_statistics_http2_channel_init(struct aws_crt_statistics_http2_channel *stats) {
@@ -32,4 +38,82 @@ void aws_crt_statistics_http2_channel_reset(struct aws_crt_statistics_http2_chan
     stats->pending_outgoing_stream_ms = 0;
     stats->pending_incoming_stream_ms = 0;
     stats->was_inactive = false;
+    stats->messages_written = 0;
+    stats->bytes_written = 0;
+    stats->message_capacity_written = 0;
+    stats->zero_copy_bytes_written = 0;
+    stats->bytes_read = 0;
+    stats->streams_completed = 0;
+    stats->streams_failed = 0;
+    stats->stream_resets_received = 0;
+    stats->control_frames_received = 0;
+}
+
+/*
+ * Values under 4 get a bucket each.  Above that, each power of two is split into 4 buckets by the two bits
+ * after the leading one.
+ */
+size_t aws_http_latency_histogram_bucket_index(uint64_t value_us) {
+    if (value_us < 4) {
+        return (size_t)value_us;
+    }
+
+    size_t power = 63 - aws_clz_u64(value_us);
+    size_t bucket = 4 * (power - 1) + (size_t)((value_us >> (power - 2)) & 3);
+    return aws_min_size(bucket, AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT - 1);
+}
+
+uint64_t aws_http_latency_histogram_bucket_upper_bound(size_t bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+
+    size_t power = bucket / 4 + 1;
+    uint64_t lower_bound = (uint64_t)(4 + bucket % 4) << (power - 2);
+    return lower_bound + ((uint64_t)1 << (power - 2)) - 1;
+}
+
+void aws_http_latency_histogram_record(struct aws_http_latency_histogram *histogram, uint64_t value_us) {
+    histogram->buckets[aws_http_latency_histogram_bucket_index(value_us)]++;
+    histogram->count++;
+    histogram->sum_us += value_us;
+    histogram->max_us = aws_max_u64(histogram->max_us, value_us);
+}
+
+void aws_http_latency_histogram_merge(
+    struct aws_http_latency_histogram *histogram,
+    const struct aws_http_latency_histogram *other) {
+
+    for (size_t i = 0; i < AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        histogram->buckets[i] += other->buckets[i];
+    }
+    histogram->count += other->count;
+    histogram->sum_us += other->sum_us;
+    histogram->max_us = aws_max_u64(histogram->max_us, other->max_us);
+}
+
+uint64_t aws_http_latency_histogram_percentile(const struct aws_http_latency_histogram *histogram, double percentile) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    if (percentile < 0.0) {
+        percentile = 0.0;
+    } else if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+
+    /* The rank of the value we're after, counting from 1 */
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->count + 0.5);
+    rank = aws_max_u64(rank, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            return aws_min_u64(aws_http_latency_histogram_bucket_upper_bound(i), histogram->max_us);
+        }
+    }
+
+    return histogram->max_us;
 }
@@ -4,6 +4,16 @@
  */
 #include <aws/http/private/strutil.h>
 
+#include <aws/common/math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define AWS_STRUTIL_SSE2
+#    include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#    define AWS_STRUTIL_NEON
+#    include <arm_neon.h>
+#endif
+
 static struct aws_byte_cursor s_trim(struct aws_byte_cursor cursor, const bool trim_table[256]) {
     /* trim leading whitespace */
     size_t i;
@@ -183,6 +193,117 @@ bool aws_strutil_is_http_field_value(struct aws_byte_cursor cursor) {
     return true;
 }
 
+/* Scan 16 bytes at a time, looking for the first ':' and for any octet that's not legal field-content.
+ * Returns the number of bytes scanned, which is a multiple of 16 (the caller finishes the tail).
+ * Stops early, with out_all_valid=false, if an illegal octet is found. */
+static size_t s_scan_header_line_blocks(struct aws_byte_cursor line, size_t *colon_index, bool *out_all_valid) {
+    size_t i = 0;
+
+#if defined(AWS_STRUTIL_SSE2)
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i max_ctl = _mm_set1_epi8(0x1F);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i del = _mm_set1_epi8(0x7F);
+
+    for (; line.len - i >= 16; i += 16) {
+        const __m128i block = _mm_loadu_si128((const __m128i *)(line.ptr + i));
+
+        /* illegal = (control char other than HTAB) or DEL. SSE2 lacks unsigned compare, so use max() to find c <= 0x1F */
+        const __m128i is_ctl = _mm_cmpeq_epi8(_mm_max_epu8(block, max_ctl), max_ctl);
+        const __m128i is_illegal =
+            _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(block, tab), is_ctl), _mm_cmpeq_epi8(block, del));
+        if (_mm_movemask_epi8(is_illegal) != 0) {
+            *out_all_valid = false;
+            return i;
+        }
+
+        if (*colon_index == line.len) {
+            const int colon_bits = _mm_movemask_epi8(_mm_cmpeq_epi8(block, colon));
+            if (colon_bits != 0) {
+                *colon_index = i + aws_ctz_u32((uint32_t)colon_bits);
+            }
+        }
+    }
+
+#elif defined(AWS_STRUTIL_NEON)
+    const uint8x16_t colon = vdupq_n_u8(':');
+    const uint8x16_t space = vdupq_n_u8(' ');
+    const uint8x16_t tab = vdupq_n_u8('\t');
+    const uint8x16_t del = vdupq_n_u8(0x7F);
+
+    for (; line.len - i >= 16; i += 16) {
+        const uint8x16_t block = vld1q_u8(line.ptr + i);
+
+        const uint8x16_t is_ctl = vcltq_u8(block, space);
+        const uint8x16_t is_illegal = vorrq_u8(vbicq_u8(is_ctl, vceqq_u8(block, tab)), vceqq_u8(block, del));
+
+        /* NEON has no movemask. Narrow each 8bit lane to 4bits, giving a 64bit mask with 4 bits per byte */
+        const uint64_t illegal_bits =
+            vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(is_illegal), 4)), 0);
+        if (illegal_bits != 0) {
+            *out_all_valid = false;
+            return i;
+        }
+
+        if (*colon_index == line.len) {
+            const uint64_t colon_bits = vget_lane_u64(
+                vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(block, colon)), 4)), 0);
+            if (colon_bits != 0) {
+                *colon_index = i + (aws_ctz_u64(colon_bits) / 4);
+            }
+        }
+    }
+#else
+    (void)line;
+    (void)colon_index;
+#endif
+
+    *out_all_valid = true;
+    return i;
+}
+
+bool aws_strutil_split_http_header_line(
+    struct aws_byte_cursor line,
+    struct aws_byte_cursor *out_name,
+    struct aws_byte_cursor *out_value) {
+
+    /* Single pass over the whole line, to find the colon and validate every octet as field-content.
+     * token characters are a subset of field-content, so anything rejected here is invalid in the name too. */
+    size_t colon_index = line.len;
+    bool all_valid = false;
+    size_t i = s_scan_header_line_blocks(line, &colon_index, &all_valid);
+    if (!all_valid) {
+        return false;
+    }
+
+    /* Finish the tail (or the whole line, if no SIMD is available) with the lookup tables */
+    for (; i < line.len; ++i) {
+        const uint8_t c = line.ptr[i];
+        if (s_http_field_content_table[c] == false) {
+            return false;
+        }
+        if (c == ':' && colon_index == line.len) {
+            colon_index = i;
+        }
+    }
+
+    if (colon_index == line.len) {
+        return false;
+    }
+
+    /* The name is typically short, so the table is as fast as anything here */
+    struct aws_byte_cursor name = aws_byte_cursor_from_array(line.ptr, colon_index);
+    if (!s_is_token(name, s_http_token_table)) {
+        return false;
+    }
+
+    /* After trimming, remaining value has no leading/trailing whitespace, and every octet was validated above */
+    struct aws_byte_cursor value = aws_byte_cursor_from_array(line.ptr + colon_index + 1, line.len - colon_index - 1);
+    *out_name = name;
+    *out_value = s_trim(value, s_http_whitespace_table);
+    return true;
+}
+
 /**
  * From RFC7230 section 3.1.2:
  * reason-phrase  = *( HTAB / SP / VCHAR / obs-text )
@@ -0,0 +1,349 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/timer_wheel.h>
+
+#include <aws/common/math.h>
+#include <aws/io/event_loop.h>
+
+static const uint64_t s_slot_mask = AWS_HTTP_TIMER_WHEEL_SLOTS - 1;
+
+/* Number of ticks covered by one slot of this level */
+static uint64_t s_slot_span(size_t level) {
+    return (uint64_t)1 << (level * AWS_HTTP_TIMER_WHEEL_SLOT_BITS);
+}
+
+static void s_set_slot_occupied(struct aws_http_timer_wheel *wheel, size_t level, size_t slot) {
+    wheel->occupied[level] |= (uint64_t)1 << slot;
+}
+
+static void s_update_slot_occupied(struct aws_http_timer_wheel *wheel, size_t level, size_t slot) {
+    if (aws_linked_list_empty(&wheel->slots[level][slot])) {
+        wheel->occupied[level] &= ~((uint64_t)1 << slot);
+    }
+}
+
+/* Rotate right, so bit 0 is the slot at `pos` */
+static uint64_t s_rotate_occupied(uint64_t occupied, size_t pos) {
+    if (pos == 0) {
+        return occupied;
+    }
+    return (occupied >> pos) | (occupied << (AWS_HTTP_TIMER_WHEEL_SLOTS - pos));
+}
+
+/* Put an armed timer in the lowest level whose span reaches its expiry */
+static void s_insert(struct aws_http_timer_wheel *wheel, struct aws_http_timer *timer) {
+    /* A timer that's already due fires on the next tick processed */
+    const uint64_t expiry_tick = aws_max_u64(timer->expiry_tick, wheel->current_tick);
+    const uint64_t delta = expiry_tick - wheel->current_tick;
+
+    for (size_t level = 0; level < AWS_HTTP_TIMER_WHEEL_LEVELS; ++level) {
+        if (delta < s_slot_span(level + 1)) {
+            const size_t slot = (size_t)((expiry_tick / s_slot_span(level)) & s_slot_mask);
+            timer->level = (uint8_t)level;
+            timer->slot = (uint8_t)slot;
+            aws_linked_list_push_back(&wheel->slots[level][slot], &timer->node);
+            s_set_slot_occupied(wheel, level, slot);
+            return;
+        }
+    }
+
+    timer->level = AWS_HTTP_TIMER_WHEEL_LEVELS;
+    timer->slot = 0;
+    aws_linked_list_push_back(&wheel->overflow, &timer->node);
+}
+
+static void s_remove(struct aws_http_timer_wheel *wheel, struct aws_http_timer *timer) {
+    aws_linked_list_remove(&timer->node);
+    if (timer->level < AWS_HTTP_TIMER_WHEEL_LEVELS) {
+        s_update_slot_occupied(wheel, timer->level, timer->slot);
+    }
+    timer->wheel = NULL;
+    AWS_ASSERT(wheel->num_timers > 0);
+    --wheel->num_timers;
+}
+
+/* Re-insert every timer in the list, relative to the current tick */
+static void s_reinsert_all(struct aws_http_timer_wheel *wheel, struct aws_linked_list *list) {
+    struct aws_linked_list timers;
+    aws_linked_list_init(&timers);
+    aws_linked_list_swap_contents(&timers, list);
+
+    while (!aws_linked_list_empty(&timers)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&timers);
+        s_insert(wheel, AWS_CONTAINER_OF(node, struct aws_http_timer, node));
+    }
+}
+
+/* Process `current_tick`: move timers down from any level whose slot starts now, then fire level 0's slot */
+static void s_process_tick(struct aws_http_timer_wheel *wheel) {
+    const uint64_t tick = wheel->current_tick;
+    const size_t top_level = AWS_HTTP_TIMER_WHEEL_LEVELS - 1;
+
+    if (tick % s_slot_span(top_level) == 0) {
+        s_reinsert_all(wheel, &wheel->overflow);
+    }
+
+    for (size_t level = top_level; level > 0; --level) {
+        if (tick % s_slot_span(level) == 0) {
+            const size_t slot = (size_t)((tick / s_slot_span(level)) & s_slot_mask);
+            wheel->occupied[level] &= ~((uint64_t)1 << slot);
+            s_reinsert_all(wheel, &wheel->slots[level][slot]);
+        }
+    }
+
+    /* Advance before firing, so timers armed from callbacks land in the future */
+    wheel->current_tick = tick + 1;
+
+    const size_t slot = (size_t)(tick & s_slot_mask);
+    struct aws_linked_list expired;
+    aws_linked_list_init(&expired);
+    aws_linked_list_swap_contents(&expired, &wheel->slots[0][slot]);
+    wheel->occupied[0] &= ~((uint64_t)1 << slot);
+
+    /* Callbacks may cancel timers that are still in `expired`, which removes them from it */
+    while (!aws_linked_list_empty(&expired)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&expired);
+        struct aws_http_timer *timer = AWS_CONTAINER_OF(node, struct aws_http_timer, node);
+        timer->wheel = NULL;
+        --wheel->num_timers;
+        timer->fn(timer, timer->user_data);
+    }
+}
+
+/* The next tick with work to do, or UINT64_MAX if no timers are armed */
+static uint64_t s_next_work_tick(const struct aws_http_timer_wheel *wheel) {
+    if (wheel->num_timers == 0) {
+        return UINT64_MAX;
+    }
+
+    const uint64_t tick = wheel->current_tick;
+    uint64_t next_tick = UINT64_MAX;
+
+    /* Level 0 timers expire within one turn of the current tick */
+    if (wheel->occupied[0]) {
+        const uint64_t rotated = s_rotate_occupied(wheel->occupied[0], (size_t)(tick & s_slot_mask));
+        next_tick = tick + aws_ctz_u64(rotated);
+    }
+
+    /* Higher level timers move down when the wheel reaches the start of their slot */
+    for (size_t level = 1; level < AWS_HTTP_TIMER_WHEEL_LEVELS; ++level) {
+        if (!wheel->occupied[level]) {
+            continue;
+        }
+
+        const uint64_t span = s_slot_span(level);
+        const uint64_t slot_index = tick / span;
+        uint64_t rotated = s_rotate_occupied(wheel->occupied[level], (size_t)(slot_index & s_slot_mask));
+        if (tick % span != 0) {
+            /* Current slot has begun already, so it next starts a whole turn from now */
+            rotated &= ~(uint64_t)1;
+        }
+        const uint64_t slots_ahead = rotated ? aws_ctz_u64(rotated) : AWS_HTTP_TIMER_WHEEL_SLOTS;
+        next_tick = aws_min_u64(next_tick, (slot_index + slots_ahead) * span);
+    }
+
+    if (!aws_linked_list_empty(&wheel->overflow)) {
+        const uint64_t span = s_slot_span(AWS_HTTP_TIMER_WHEEL_LEVELS - 1);
+        const uint64_t slot_index = tick / span;
+        const uint64_t slots_ahead = (tick % span == 0) ? 0 : 1;
+        next_tick = aws_min_u64(next_tick, (slot_index + slots_ahead) * span);
+    }
+
+    return next_tick;
+}
+
+void aws_http_timer_init(struct aws_http_timer *timer, aws_http_timer_fn *fn, void *user_data) {
+    AWS_PRECONDITION(timer);
+    AWS_PRECONDITION(fn);
+    AWS_ZERO_STRUCT(*timer);
+    timer->fn = fn;
+    timer->user_data = user_data;
+}
+
+bool aws_http_timer_is_armed(const struct aws_http_timer *timer) {
+    return timer->wheel != NULL;
+}
+
+void aws_http_timer_cancel(struct aws_http_timer *timer) {
+    if (timer->wheel) {
+        s_remove(timer->wheel, timer);
+    }
+}
+
+void aws_http_timer_wheel_init(struct aws_http_timer_wheel *wheel, uint64_t now_ns) {
+    AWS_ZERO_STRUCT(*wheel);
+    wheel->current_tick = now_ns / AWS_HTTP_TIMER_WHEEL_TICK_NS;
+    for (size_t level = 0; level < AWS_HTTP_TIMER_WHEEL_LEVELS; ++level) {
+        for (size_t slot = 0; slot < AWS_HTTP_TIMER_WHEEL_SLOTS; ++slot) {
+            aws_linked_list_init(&wheel->slots[level][slot]);
+        }
+    }
+    aws_linked_list_init(&wheel->overflow);
+}
+
+static void s_disarm_all(struct aws_linked_list *list) {
+    while (!aws_linked_list_empty(list)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(list);
+        AWS_CONTAINER_OF(node, struct aws_http_timer, node)->wheel = NULL;
+    }
+}
+
+void aws_http_timer_wheel_clean_up(struct aws_http_timer_wheel *wheel) {
+    for (size_t level = 0; level < AWS_HTTP_TIMER_WHEEL_LEVELS; ++level) {
+        for (size_t slot = 0; slot < AWS_HTTP_TIMER_WHEEL_SLOTS; ++slot) {
+            s_disarm_all(&wheel->slots[level][slot]);
+        }
+    }
+    s_disarm_all(&wheel->overflow);
+    AWS_ZERO_STRUCT(*wheel);
+}
+
+void aws_http_timer_wheel_arm(struct aws_http_timer_wheel *wheel, struct aws_http_timer *timer, uint64_t expiry_ns) {
+    AWS_PRECONDITION(wheel);
+    AWS_PRECONDITION(timer);
+    AWS_PRECONDITION(timer->fn);
+
+    aws_http_timer_cancel(timer);
+
+    /* Round up, so timers never fire early */
+    timer->expiry_tick =
+        expiry_ns / AWS_HTTP_TIMER_WHEEL_TICK_NS + (expiry_ns % AWS_HTTP_TIMER_WHEEL_TICK_NS != 0 ? 1 : 0);
+    timer->wheel = wheel;
+    ++wheel->num_timers;
+    s_insert(wheel, timer);
+}
+
+void aws_http_timer_wheel_advance(struct aws_http_timer_wheel *wheel, uint64_t now_ns) {
+    const uint64_t now_tick = now_ns / AWS_HTTP_TIMER_WHEEL_TICK_NS;
+
+    /* Skip straight to each tick with work to do */
+    uint64_t next_tick = s_next_work_tick(wheel);
+    while (next_tick <= now_tick) {
+        wheel->current_tick = next_tick;
+        s_process_tick(wheel);
+        next_tick = s_next_work_tick(wheel);
+    }
+
+    if (wheel->current_tick <= now_tick) {
+        wheel->current_tick = now_tick + 1;
+    }
+}
+
+uint64_t aws_http_timer_wheel_next_run_ns(const struct aws_http_timer_wheel *wheel) {
+    const uint64_t next_tick = s_next_work_tick(wheel);
+    if (next_tick == UINT64_MAX) {
+        return UINT64_MAX;
+    }
+    return aws_mul_u64_saturating(next_tick, AWS_HTTP_TIMER_WHEEL_TICK_NS);
+}
+
+/* The wheel shared by everything on an event-loop, stored as one of the event-loop's local objects */
+struct aws_http_event_loop_timer_wheel {
+    struct aws_allocator *allocator;
+    struct aws_event_loop *event_loop;
+    struct aws_http_timer_wheel wheel;
+    struct aws_task task;
+    /* When `task` is scheduled to run. UINT64_MAX if it isn't scheduled */
+    uint64_t task_run_ns;
+};
+
+/* Only the address matters, it's the local object's key */
+static int s_event_loop_timer_wheel_key;
+
+static void s_event_loop_timer_wheel_schedule(struct aws_http_event_loop_timer_wheel *loop_wheel) {
+    const uint64_t run_ns = aws_http_timer_wheel_next_run_ns(&loop_wheel->wheel);
+    if (run_ns >= loop_wheel->task_run_ns) {
+        /* Task will run soon enough. If no timers are armed, it just finds nothing to do */
+        return;
+    }
+
+    if (loop_wheel->task_run_ns != UINT64_MAX) {
+        aws_event_loop_cancel_task(loop_wheel->event_loop, &loop_wheel->task);
+    }
+
+    loop_wheel->task_run_ns = run_ns;
+    aws_event_loop_schedule_task_future(loop_wheel->event_loop, &loop_wheel->task, run_ns);
+}
+
+static void s_event_loop_timer_wheel_task(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    struct aws_http_event_loop_timer_wheel *loop_wheel = arg;
+    loop_wheel->task_run_ns = UINT64_MAX;
+
+    if (status != AWS_TASK_STATUS_RUN_READY) {
+        return;
+    }
+
+    uint64_t now_ns = 0;
+    aws_event_loop_current_clock_time(loop_wheel->event_loop, &now_ns);
+    aws_http_timer_wheel_advance(&loop_wheel->wheel, now_ns);
+    s_event_loop_timer_wheel_schedule(loop_wheel);
+}
+
+static void s_event_loop_timer_wheel_on_removed(struct aws_event_loop_local_object *local_object) {
+    struct aws_http_event_loop_timer_wheel *loop_wheel = local_object->object;
+    aws_http_timer_wheel_clean_up(&loop_wheel->wheel);
+    aws_mem_release(loop_wheel->allocator, loop_wheel);
+}
+
+static struct aws_http_event_loop_timer_wheel *s_get_event_loop_timer_wheel(struct aws_event_loop *event_loop) {
+    struct aws_event_loop_local_object local_object;
+    if (aws_event_loop_fetch_local_object(event_loop, &s_event_loop_timer_wheel_key, &local_object) ==
+        AWS_OP_SUCCESS) {
+        return local_object.object;
+    }
+
+    uint64_t now_ns = 0;
+    if (aws_event_loop_current_clock_time(event_loop, &now_ns)) {
+        return NULL;
+    }
+
+    struct aws_http_event_loop_timer_wheel *loop_wheel =
+        aws_mem_calloc(event_loop->alloc, 1, sizeof(struct aws_http_event_loop_timer_wheel));
+    loop_wheel->allocator = event_loop->alloc;
+    loop_wheel->event_loop = event_loop;
+    loop_wheel->task_run_ns = UINT64_MAX;
+    aws_http_timer_wheel_init(&loop_wheel->wheel, now_ns);
+    aws_task_init(&loop_wheel->task, s_event_loop_timer_wheel_task, loop_wheel, "http_timer_wheel");
+
+    local_object.key = &s_event_loop_timer_wheel_key;
+    local_object.object = loop_wheel;
+    local_object.on_object_removed = s_event_loop_timer_wheel_on_removed;
+    if (aws_event_loop_put_local_object(event_loop, &local_object)) {
+        aws_mem_release(loop_wheel->allocator, loop_wheel);
+        return NULL;
+    }
+
+    return loop_wheel;
+}
+
+int aws_http_event_loop_timer_arm(
+    struct aws_event_loop *event_loop,
+    struct aws_http_timer *timer,
+    uint64_t timeout_ns) {
+    AWS_PRECONDITION(event_loop);
+    AWS_PRECONDITION(timer);
+    AWS_PRECONDITION(aws_event_loop_thread_is_callers_thread(event_loop));
+
+    struct aws_http_event_loop_timer_wheel *loop_wheel = s_get_event_loop_timer_wheel(event_loop);
+    if (!loop_wheel) {
+        return AWS_OP_ERR;
+    }
+
+    uint64_t now_ns = 0;
+    if (aws_event_loop_current_clock_time(event_loop, &now_ns)) {
+        return AWS_OP_ERR;
+    }
+
+    if (loop_wheel->wheel.num_timers == 0) {
+        /* Nothing to fire, so skip the ticks that passed while the wheel sat idle */
+        loop_wheel->wheel.current_tick = now_ns / AWS_HTTP_TIMER_WHEEL_TICK_NS;
+    }
+
+    aws_http_timer_wheel_arm(&loop_wheel->wheel, timer, aws_add_u64_saturating(now_ns, timeout_ns));
+    s_event_loop_timer_wheel_schedule(loop_wheel);
+    return AWS_OP_SUCCESS;
+}
@@ -0,0 +1,311 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/traffic_capture.h>
+
+#include <aws/common/atomics.h>
+#include <aws/common/clock.h>
+#include <aws/common/file.h>
+#include <aws/http/connection.h>
+#include <aws/io/channel.h>
+#include <aws/io/logging.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+static const struct aws_byte_cursor s_magic = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("AWSHTCAP");
+
+/* Makes file names unique when several connections start within the same clock tick */
+static struct aws_atomic_var s_capture_count = AWS_ATOMIC_INIT_INT(0);
+
+struct aws_http_traffic_capture {
+    struct aws_channel_handler handler;
+    struct aws_channel_slot *slot;
+
+    /* NULL once recording stops, whether because the limit was reached or a write failed */
+    FILE *file;
+    uint64_t file_size;
+    uint64_t max_file_size;
+    uint64_t start_timestamp_ns;
+};
+
+static void s_stop_recording(struct aws_http_traffic_capture *capture) {
+    if (capture->file) {
+        fclose(capture->file);
+        capture->file = NULL;
+    }
+}
+
+static void s_record(
+    struct aws_http_traffic_capture *capture,
+    enum aws_http_traffic_capture_direction direction,
+    struct aws_byte_cursor data) {
+
+    if (!capture->file) {
+        return;
+    }
+
+    uint64_t record_size = AWS_HTTP_TRAFFIC_CAPTURE_RECORD_HEADER_SIZE + (uint64_t)data.len;
+    if (capture->max_file_size && capture->file_size + record_size > capture->max_file_size) {
+        AWS_LOGF_INFO(
+            AWS_LS_HTTP_CONNECTION,
+            "id=%p: Traffic capture reached its limit of %" PRIu64 " bytes, recording stopped.",
+            (void *)capture,
+            capture->max_file_size);
+        s_stop_recording(capture);
+        return;
+    }
+
+    uint64_t now_ns = 0;
+    aws_high_res_clock_get_ticks(&now_ns);
+
+    uint8_t header_storage[AWS_HTTP_TRAFFIC_CAPTURE_RECORD_HEADER_SIZE];
+    struct aws_byte_buf header = aws_byte_buf_from_empty_array(header_storage, sizeof(header_storage));
+    aws_byte_buf_write_u8(&header, (uint8_t)direction);
+    aws_byte_buf_write_be64(&header, now_ns - capture->start_timestamp_ns);
+    aws_byte_buf_write_be32(&header, (uint32_t)data.len);
+
+    if (fwrite(header.buffer, 1, header.len, capture->file) != header.len ||
+        (data.len > 0 && fwrite(data.ptr, 1, data.len, capture->file) != data.len)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_CONNECTION, "id=%p: Failed to write traffic capture, recording stopped.", (void *)capture);
+        s_stop_recording(capture);
+        return;
+    }
+
+    capture->file_size += record_size;
+}
+
+static int s_handler_process_read_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+
+    struct aws_http_traffic_capture *capture = handler->impl;
+    s_record(capture, AWS_HTTP_TRAFFIC_CAPTURE_INBOUND, aws_byte_cursor_from_buf(&message->message_data));
+    return aws_channel_slot_send_message(slot, message, AWS_CHANNEL_DIR_READ);
+}
+
+static int s_handler_process_write_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+
+    struct aws_http_traffic_capture *capture = handler->impl;
+    s_record(capture, AWS_HTTP_TRAFFIC_CAPTURE_OUTBOUND, aws_byte_cursor_from_buf(&message->message_data));
+    return aws_channel_slot_send_message(slot, message, AWS_CHANNEL_DIR_WRITE);
+}
+
+static int s_handler_increment_read_window(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    size_t size) {
+
+    (void)handler;
+    return aws_channel_slot_increment_read_window(slot, size);
+}
+
+static int s_handler_shutdown(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    enum aws_channel_direction dir,
+    int error_code,
+    bool free_scarce_resources_immediately) {
+
+    struct aws_http_traffic_capture *capture = handler->impl;
+    /* Nothing more is written once the write direction has shut down */
+    if (dir == AWS_CHANNEL_DIR_WRITE) {
+        s_stop_recording(capture);
+    }
+
+    return aws_channel_slot_on_handler_shutdown_complete(slot, dir, error_code, free_scarce_resources_immediately);
+}
+
+/* The connection to the right passes its window along once it's installed */
+static size_t s_handler_initial_window_size(struct aws_channel_handler *handler) {
+    (void)handler;
+    return 0;
+}
+
+static size_t s_handler_message_overhead(struct aws_channel_handler *handler) {
+    (void)handler;
+    return 0;
+}
+
+static void s_handler_destroy(struct aws_channel_handler *handler) {
+    struct aws_http_traffic_capture *capture = handler->impl;
+    s_stop_recording(capture);
+    aws_mem_release(handler->alloc, capture);
+}
+
+static struct aws_channel_handler_vtable s_traffic_capture_vtable = {
+    .process_read_message = s_handler_process_read_message,
+    .process_write_message = s_handler_process_write_message,
+    .increment_read_window = s_handler_increment_read_window,
+    .shutdown = s_handler_shutdown,
+    .initial_window_size = s_handler_initial_window_size,
+    .message_overhead = s_handler_message_overhead,
+    .destroy = s_handler_destroy,
+};
+
+/* Create the capture file and write its header. Returns NULL if that fails */
+static FILE *s_open_capture_file(
+    struct aws_allocator *allocator,
+    const struct aws_http_traffic_capture_options *options,
+    enum aws_http_version http_version,
+    bool is_server) {
+
+    uint64_t start_time_ns = 0;
+    aws_sys_clock_get_ticks(&start_time_ns);
+    size_t count = aws_atomic_fetch_add(&s_capture_count, 1);
+
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), "http-%" PRIu64 "-%zu.awscap", start_time_ns, count);
+
+    struct aws_byte_buf path;
+    aws_byte_buf_init(&path, allocator, options->directory.len + sizeof(file_name) + 2);
+    struct aws_byte_cursor file_name_cursor = aws_byte_cursor_from_c_str(file_name);
+    aws_byte_buf_append(&path, &options->directory);
+    aws_byte_buf_write_u8(&path, (uint8_t)aws_get_platform_directory_separator());
+    aws_byte_buf_append(&path, &file_name_cursor);
+    aws_byte_buf_write_u8(&path, '\0');
+
+    FILE *file = aws_fopen((const char *)path.buffer, "wb");
+    if (!file) {
+        AWS_LOGF_WARN(
+            AWS_LS_HTTP_CONNECTION,
+            "static: Failed to create traffic capture file %s, error %d (%s). Connection will not be captured.",
+            (const char *)path.buffer,
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        goto done;
+    }
+
+    uint8_t header_storage[AWS_HTTP_TRAFFIC_CAPTURE_FILE_HEADER_SIZE];
+    struct aws_byte_buf header = aws_byte_buf_from_empty_array(header_storage, sizeof(header_storage));
+    aws_byte_buf_write_from_whole_cursor(&header, s_magic);
+    aws_byte_buf_write_u8(&header, AWS_HTTP_TRAFFIC_CAPTURE_FORMAT_VERSION);
+    aws_byte_buf_write_u8(&header, (uint8_t)http_version);
+    aws_byte_buf_write_u8(&header, is_server ? AWS_HTTP_TRAFFIC_CAPTURE_FLAG_SERVER : 0);
+    aws_byte_buf_write_u8(&header, 0);
+    aws_byte_buf_write_be64(&header, start_time_ns);
+    if (fwrite(header.buffer, 1, header.len, file) != header.len) {
+        AWS_LOGF_WARN(
+            AWS_LS_HTTP_CONNECTION,
+            "static: Failed to write traffic capture file %s. Connection will not be captured.",
+            (const char *)path.buffer);
+        fclose(file);
+        file = NULL;
+        goto done;
+    }
+
+    AWS_LOGF_DEBUG(AWS_LS_HTTP_CONNECTION, "static: Capturing connection traffic to %s", (const char *)path.buffer);
+
+done:
+    aws_byte_buf_clean_up(&path);
+    return file;
+}
+
+int aws_http_traffic_capture_install(
+    struct aws_allocator *allocator,
+    struct aws_channel_slot *connection_slot,
+    const struct aws_http_traffic_capture_options *options,
+    enum aws_http_version http_version,
+    bool is_server) {
+
+    AWS_PRECONDITION(options);
+    AWS_PRECONDITION(aws_channel_thread_is_callers_thread(connection_slot->channel));
+
+    FILE *file = s_open_capture_file(allocator, options, http_version, is_server);
+    if (!file) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_channel_slot *slot = aws_channel_slot_new(connection_slot->channel);
+    if (!slot) {
+        goto error;
+    }
+
+    if (aws_channel_slot_insert_left(connection_slot, slot)) {
+        goto error;
+    }
+
+    struct aws_http_traffic_capture *capture = aws_mem_calloc(allocator, 1, sizeof(struct aws_http_traffic_capture));
+    capture->handler.vtable = &s_traffic_capture_vtable;
+    capture->handler.alloc = allocator;
+    capture->handler.impl = capture;
+    capture->slot = slot;
+    capture->file = file;
+    capture->file_size = AWS_HTTP_TRAFFIC_CAPTURE_FILE_HEADER_SIZE;
+    capture->max_file_size = options->max_file_size;
+    aws_high_res_clock_get_ticks(&capture->start_timestamp_ns);
+
+    if (aws_channel_slot_set_handler(slot, &capture->handler)) {
+        aws_mem_release(allocator, capture);
+        goto error;
+    }
+
+    return AWS_OP_SUCCESS;
+
+error:
+    fclose(file);
+    if (slot) {
+        aws_channel_slot_remove(slot);
+    }
+    return AWS_OP_ERR;
+}
+
+int aws_http_traffic_capture_read_file_header(
+    struct aws_byte_cursor *input,
+    struct aws_http_traffic_capture_file_header *header) {
+
+    struct aws_byte_cursor cursor = *input;
+    struct aws_byte_cursor magic = aws_byte_cursor_advance(&cursor, s_magic.len);
+    uint8_t format_version = 0;
+    uint8_t http_version = 0;
+    uint8_t flags = 0;
+    uint8_t reserved = 0;
+    uint64_t start_time_ns = 0;
+    if (!aws_byte_cursor_eq(&magic, &s_magic) || !aws_byte_cursor_read_u8(&cursor, &format_version) ||
+        !aws_byte_cursor_read_u8(&cursor, &http_version) || !aws_byte_cursor_read_u8(&cursor, &flags) ||
+        !aws_byte_cursor_read_u8(&cursor, &reserved) || !aws_byte_cursor_read_be64(&cursor, &start_time_ns)) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    if (format_version != AWS_HTTP_TRAFFIC_CAPTURE_FORMAT_VERSION) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    header->http_version = (enum aws_http_version)http_version;
+    header->is_server = (flags & AWS_HTTP_TRAFFIC_CAPTURE_FLAG_SERVER) != 0;
+    header->start_time_ns = start_time_ns;
+    *input = cursor;
+    return AWS_OP_SUCCESS;
+}
+
+int aws_http_traffic_capture_read_record(
+    struct aws_byte_cursor *input,
+    struct aws_http_traffic_capture_record *record) {
+
+    struct aws_byte_cursor cursor = *input;
+    uint8_t direction = 0;
+    uint64_t timestamp_ns = 0;
+    uint32_t data_len = 0;
+    if (!aws_byte_cursor_read_u8(&cursor, &direction) || !aws_byte_cursor_read_be64(&cursor, &timestamp_ns) ||
+        !aws_byte_cursor_read_be32(&cursor, &data_len) || cursor.len < data_len) {
+        return aws_raise_error(AWS_ERROR_SHORT_BUFFER);
+    }
+
+    if (direction != AWS_HTTP_TRAFFIC_CAPTURE_INBOUND && direction != AWS_HTTP_TRAFFIC_CAPTURE_OUTBOUND) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    record->direction = (enum aws_http_traffic_capture_direction)direction;
+    record->timestamp_ns = timestamp_ns;
+    record->data = aws_byte_cursor_advance(&cursor, data_len);
+    *input = cursor;
+    return AWS_OP_SUCCESS;
+}
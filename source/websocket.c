@@ -6,12 +6,16 @@
 #include <aws/http/private/websocket_impl.h>
 
 #include <aws/common/atomics.h>
+#include <aws/common/clock.h>
 #include <aws/common/device_random.h>
 #include <aws/common/encoding.h>
 #include <aws/common/mutex.h>
 #include <aws/common/ref_count.h>
+#include <aws/http/private/tracing.h>
 #include <aws/http/private/websocket_decoder.h>
+#include <aws/http/private/websocket_deflate.h>
 #include <aws/http/private/websocket_encoder.h>
+#include <aws/http/private/websocket_message_pool.h>
 #include <aws/http/request_response.h>
 #include <aws/io/channel.h>
 #include <aws/io/logging.h>
@@ -24,9 +28,23 @@
 
 /* TODO: If something goes wrong during normal shutdown, do I change the error_code? */
 
+/* Size of buffer that outgoing payload is read into, before it's compressed */
+#define UNCOMPRESSED_PAYLOAD_BUF_SIZE (16 * 1024)
+
 struct outgoing_frame {
     struct aws_websocket_send_frame_options def;
     struct aws_linked_list_node node;
+
+    /* Set if the frame was encoded ahead of time. The outgoing_frame holds a reference to it */
+    struct aws_websocket_encoded_frame *encoded_frame;
+};
+
+struct aws_websocket_encoded_frame {
+    struct aws_allocator *alloc;
+    struct aws_ref_count ref_count;
+    struct aws_websocket_frame frame;
+    /* Header and payload, in the same allocation, right after this struct */
+    struct aws_byte_cursor encoded;
 };
 
 struct aws_websocket {
@@ -37,6 +55,10 @@ struct aws_websocket {
     size_t initial_window_size;
     bool manual_window_update;
 
+    /* True if the read window is managed by the websocket itself, according to the message pool's read budgets.
+     * manual_window_update is also true in this mode, so the window shrinks once it's over budget */
+    bool auto_window_update;
+
     void *user_data;
     aws_websocket_on_incoming_frame_begin_fn *on_incoming_frame_begin;
     aws_websocket_on_incoming_frame_payload_fn *on_incoming_frame_payload;
@@ -47,8 +69,25 @@ struct aws_websocket {
     struct aws_channel_task increment_read_window_task;
     struct aws_channel_task waiting_on_payload_stream_task;
     struct aws_channel_task close_timeout_task;
+    struct aws_channel_task write_batch_task;
+    struct aws_channel_task read_budget_task;
     bool is_server;
 
+    /* See aws_websocket_client_connection_options.write_batch_target_size. 0 means outgoing frames aren't batched */
+    size_t write_batch_target_size;
+    uint64_t write_batch_max_delay_ns;
+    aws_websocket_on_outgoing_frames_complete_fn *on_outgoing_frames_complete;
+
+    /* Set if TEXT and BINARY messages are delivered whole, NULL otherwise */
+    aws_websocket_on_incoming_message_fn *on_incoming_message;
+    struct aws_websocket_message_pool *message_pool;
+
+    /* Set if permessage-deflate (RFC-7692) was negotiated, NULL otherwise */
+    struct aws_websocket_compressor *compressor;
+    struct aws_websocket_decompressor *decompressor;
+    bool reset_compressor_after_message;
+    size_t compression_threshold;
+
     /* Data that should only be accessed from the websocket's channel thread. */
     struct {
         struct aws_websocket_encoder encoder;
@@ -65,10 +104,27 @@ struct aws_websocket {
          */
         struct aws_linked_list write_completion_frames;
 
+        /* True from the first frame of a compressed outgoing message until its final frame */
+        bool is_sending_compressed_message;
+
+        /* True if current_outgoing_frame's payload is compressed.
+         * The frame header states the compressed length, so the whole payload is read from the user
+         * and compressed before encoding begins. It's then sent from compressed_payload_cursor. */
+        bool is_current_outgoing_frame_compressed;
+        bool is_compressing_current_outgoing_frame;
+        uint64_t current_outgoing_payload_bytes_read;
+        struct aws_byte_buf uncompressed_payload;
+        struct aws_byte_buf compressed_payload;
+        struct aws_byte_cursor compressed_payload_cursor;
+
         struct aws_websocket_decoder decoder;
         struct aws_websocket_incoming_frame *current_incoming_frame;
         struct aws_websocket_incoming_frame incoming_frame_storage;
 
+        /* TEXT or BINARY message being reassembled for on_incoming_message.
+         * Set from the message's first frame until its final frame completes */
+        struct aws_websocket_incoming_message *incoming_message;
+
         /* Payload of incoming PING frame.
          * The PONG frame we send in response must have an identical payload */
         struct aws_byte_buf incoming_ping_payload;
@@ -79,6 +135,14 @@ struct aws_websocket {
         /* Amount to increment window after a channel message has been processed. */
         size_t incoming_message_window_update;
 
+        /* Decompressed payload delivered beyond the bytes read from the socket.
+         * This is deducted from later window increments, so the window measures decompressed data. */
+        size_t read_window_debt;
+
+        /* With auto_window_update, payload the window shrank by while over budget.
+         * The window is incremented by this much once the budget frees up */
+        size_t throttled_window_size;
+
         /* Cached slot to right */
         struct aws_channel_slot *last_known_right_slot;
 
@@ -107,6 +171,12 @@ struct aws_websocket {
          * schedule a task to try again in the near-future. */
         bool is_waiting_on_payload_stream_task;
 
+        /* Partially filled aws_io_message, held back so more frames can join it */
+        struct aws_io_message *write_batch_msg;
+        /* When write_batch_msg must be sent, even if it isn't full */
+        uint64_t write_batch_deadline_ns;
+        bool is_write_batch_task_scheduled;
+
         /* True if this websocket is being used as a dumb mid-channel handler.
          * The websocket will no longer respond to its public API or invoke callbacks. */
         bool is_midchannel_handler;
@@ -130,6 +200,9 @@ struct aws_websocket {
 
         bool is_move_synced_data_to_thread_task_scheduled;
 
+        /* Set when the message pool reports freed-up budget, until read_budget_task runs */
+        bool is_read_budget_task_scheduled;
+
         /* Mirrors variable from thread_data */
         bool is_midchannel_handler;
     } synced_data;
@@ -163,6 +236,10 @@ static void s_handler_destroy(struct aws_channel_handler *handler);
 static void s_websocket_on_refcount_zero(void *user_data);
 
 static int s_encoder_stream_outgoing_payload(struct aws_byte_buf *out_buf, void *user_data);
+static int s_init_permessage_deflate(
+    struct aws_websocket *websocket,
+    const struct aws_websocket_handler_options *options);
+static int s_start_outgoing_frame(struct aws_websocket *websocket, bool *out_frame_started);
 
 static int s_decoder_on_frame(const struct aws_websocket_frame *frame, void *user_data);
 static int s_decoder_on_payload(struct aws_byte_cursor data, void *user_data);
@@ -182,13 +259,20 @@ static int s_send_frame(
     struct aws_websocket *websocket,
     const struct aws_websocket_send_frame_options *options,
     bool from_public_api);
+static int s_enqueue_outgoing_frame(
+    struct aws_websocket *websocket,
+    struct outgoing_frame *frame,
+    bool from_public_api);
 static bool s_midchannel_send_payload(struct aws_websocket *websocket, struct aws_byte_buf *out_buf, void *user_data);
 static void s_midchannel_send_complete(struct aws_websocket *websocket, int error_code, void *user_data);
 static void s_move_synced_data_to_thread_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
 static void s_increment_read_window_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
+static void s_read_budget_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
+static void s_on_read_budget_freed(void *user_data);
 static void s_shutdown_channel_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
 static void s_waiting_on_payload_stream_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
 static void s_close_timeout_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
+static void s_write_batch_task(struct aws_channel_task *task, void *arg, enum aws_task_status status);
 static void s_schedule_channel_shutdown(struct aws_websocket *websocket, int error_code);
 static void s_shutdown_due_to_write_err(struct aws_websocket *websocket, int error_code);
 static void s_shutdown_due_to_read_err(struct aws_websocket *websocket, int error_code);
@@ -279,6 +363,11 @@ struct aws_websocket *aws_websocket_handler_new(const struct aws_websocket_handl
 
     websocket->is_server = options->is_server;
 
+    websocket->write_batch_target_size = options->write_batch_target_size;
+    websocket->write_batch_max_delay_ns = aws_timestamp_convert(
+        options->write_batch_max_delay_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    websocket->on_outgoing_frames_complete = options->on_outgoing_frames_complete;
+
     aws_channel_task_init(
         &websocket->move_synced_data_to_thread_task,
         s_move_synced_data_to_thread_task,
@@ -297,6 +386,8 @@ struct aws_websocket *aws_websocket_handler_new(const struct aws_websocket_handl
         websocket,
         "websocket_waiting_on_payload_stream");
     aws_channel_task_init(&websocket->close_timeout_task, s_close_timeout_task, websocket, "websocket_close_timeout");
+    aws_channel_task_init(&websocket->write_batch_task, s_write_batch_task, websocket, "websocket_write_batch");
+    aws_channel_task_init(&websocket->read_budget_task, s_read_budget_task, websocket, "websocket_read_budget");
 
     aws_linked_list_init(&websocket->thread_data.outgoing_frame_list);
     aws_linked_list_init(&websocket->thread_data.write_completion_frames);
@@ -320,6 +411,40 @@ struct aws_websocket *aws_websocket_handler_new(const struct aws_websocket_handl
         goto error;
     }
 
+    if (options->permessage_deflate) {
+        err = s_init_permessage_deflate(websocket, options);
+        if (err) {
+            goto error;
+        }
+    }
+
+    if (options->on_incoming_message) {
+        websocket->on_incoming_message = options->on_incoming_message;
+        websocket->message_pool = aws_websocket_message_pool_new(websocket->alloc, options->max_incoming_message_size);
+        if (!websocket->message_pool) {
+            goto error;
+        }
+    }
+
+    if (options->read_budget || options->shared_read_budget) {
+        /* Budgets count delivered messages, so they only work with whole-message delivery */
+        if (!websocket->message_pool) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET, "static: A read budget requires the on_incoming_message callback to be set.");
+            aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+            goto error;
+        }
+
+        websocket->auto_window_update = true;
+        websocket->manual_window_update = true;
+        aws_websocket_message_pool_set_budget(
+            websocket->message_pool,
+            options->read_budget,
+            options->shared_read_budget,
+            s_on_read_budget_freed,
+            websocket);
+    }
+
     err = aws_channel_slot_set_handler(slot, &websocket->channel_handler);
     if (err) {
         goto error;
@@ -340,6 +465,68 @@ error:
     return NULL;
 }
 
+/* Create the compressor and decompressor, now that the handshake has agreed on permessage-deflate */
+static int s_init_permessage_deflate(
+    struct aws_websocket *websocket,
+    const struct aws_websocket_handler_options *options) {
+
+    const struct aws_websocket_permessage_deflate_options *deflate = options->permessage_deflate;
+    const struct aws_websocket_permessage_deflate_params *params = &options->permessage_deflate_params;
+
+    uint8_t server_window_bits =
+        params->server_max_window_bits ? params->server_max_window_bits : AWS_WEBSOCKET_DEFLATE_DEFAULT_WINDOW_BITS;
+    uint8_t client_window_bits =
+        params->client_max_window_bits ? params->client_max_window_bits : AWS_WEBSOCKET_DEFLATE_DEFAULT_WINDOW_BITS;
+
+    uint8_t compress_window_bits = websocket->is_server ? server_window_bits : client_window_bits;
+    uint8_t decompress_window_bits = websocket->is_server ? client_window_bits : server_window_bits;
+
+    if (deflate->new_compressor(websocket->alloc, compress_window_bits, deflate->user_data, &websocket->compressor) ||
+        !websocket->compressor) {
+        goto error;
+    }
+
+    if (deflate->new_decompressor(
+            websocket->alloc, decompress_window_bits, deflate->user_data, &websocket->decompressor) ||
+        !websocket->decompressor) {
+        goto error;
+    }
+
+    websocket->reset_compressor_after_message =
+        websocket->is_server ? params->server_no_context_takeover : params->client_no_context_takeover;
+    websocket->compression_threshold = deflate->compression_threshold;
+
+    aws_websocket_decoder_set_decompressor(
+        &websocket->thread_data.decoder,
+        websocket->decompressor,
+        websocket->is_server ? params->client_no_context_takeover : params->server_no_context_takeover);
+
+    aws_byte_buf_init(&websocket->thread_data.uncompressed_payload, websocket->alloc, UNCOMPRESSED_PAYLOAD_BUF_SIZE);
+    aws_byte_buf_init(&websocket->thread_data.compressed_payload, websocket->alloc, UNCOMPRESSED_PAYLOAD_BUF_SIZE);
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_WEBSOCKET,
+        "id=%p: Using permessage-deflate, compressing with window_bits=%" PRIu8 " and decompressing with "
+        "window_bits=%" PRIu8 ".",
+        (void *)websocket,
+        compress_window_bits,
+        decompress_window_bits);
+
+    return AWS_OP_SUCCESS;
+
+error:
+    if (!aws_last_error()) {
+        aws_raise_error(AWS_ERROR_UNKNOWN);
+    }
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_WEBSOCKET,
+        "id=%p: Failed to create permessage-deflate codecs, error %d (%s).",
+        (void *)websocket,
+        aws_last_error(),
+        aws_error_name(aws_last_error()));
+    return AWS_OP_ERR;
+}
+
 static void s_handler_destroy(struct aws_channel_handler *handler) {
     struct aws_websocket *websocket = handler->impl;
     AWS_ASSERT(!websocket->thread_data.current_outgoing_frame);
@@ -347,8 +534,28 @@ static void s_handler_destroy(struct aws_channel_handler *handler) {
 
     AWS_LOGF_TRACE(AWS_LS_HTTP_WEBSOCKET, "id=%p: Destroying websocket.", (void *)websocket);
 
+    if (websocket->thread_data.write_batch_msg) {
+        aws_mem_release(websocket->thread_data.write_batch_msg->allocator, websocket->thread_data.write_batch_msg);
+    }
+
+    /* Messages the user acquired keep the pool alive until they're released.
+     * Those releases mustn't call back into this websocket though. */
+    if (websocket->message_pool) {
+        aws_websocket_message_pool_stop_budget_callbacks(websocket->message_pool);
+    }
+    aws_websocket_incoming_message_release(websocket->thread_data.incoming_message);
+    aws_websocket_message_pool_release(websocket->message_pool);
+
     aws_websocket_decoder_clean_up(&websocket->thread_data.decoder);
     aws_byte_buf_clean_up(&websocket->thread_data.incoming_ping_payload);
+    aws_byte_buf_clean_up(&websocket->thread_data.uncompressed_payload);
+    aws_byte_buf_clean_up(&websocket->thread_data.compressed_payload);
+    if (websocket->compressor) {
+        websocket->compressor->vtable->destroy(websocket->compressor);
+    }
+    if (websocket->decompressor) {
+        websocket->decompressor->vtable->destroy(websocket->decompressor);
+    }
     aws_mutex_clean_up(&websocket->synced_data.lock);
     aws_mem_release(websocket->alloc, websocket);
 }
@@ -416,6 +623,22 @@ int aws_websocket_convert_to_midchannel_handler(struct aws_websocket *websocket)
         return aws_raise_error(AWS_ERROR_INVALID_STATE);
     }
 
+    if (websocket->decompressor) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Cannot convert to midchannel handler while using permessage-deflate.",
+            (void *)websocket);
+        return aws_raise_error(AWS_ERROR_INVALID_STATE);
+    }
+
+    if (websocket->thread_data.incoming_message) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Cannot convert to midchannel handler in the middle of an incoming message.",
+            (void *)websocket);
+        return aws_raise_error(AWS_ERROR_INVALID_STATE);
+    }
+
     websocket->thread_data.is_midchannel_handler = true;
 
     return AWS_OP_SUCCESS;
@@ -445,7 +668,24 @@ static int s_send_frame(
 
     frame->def = *options;
 
-    /* Enqueue frame, unless no further sending is allowed. */
+    if (s_enqueue_outgoing_frame(websocket, frame, from_public_api)) {
+        aws_mem_release(websocket->alloc, frame);
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Enqueue frame, unless no further sending is allowed. On failure, the caller still owns the frame */
+static int s_enqueue_outgoing_frame(
+    struct aws_websocket *websocket,
+    struct outgoing_frame *frame,
+    bool from_public_api) {
+
+    /* Copy what's logged, the frame may be sent and destroyed on another thread as soon as it's enqueued */
+    const struct aws_websocket_send_frame_options def = frame->def;
+    const bool is_pre_encoded = frame->encoded_frame != NULL;
+
     int send_error = 0;
     bool should_schedule_task = false;
 
@@ -475,18 +715,18 @@ static int s_send_frame(
             send_error,
             aws_error_name(send_error));
 
-        aws_mem_release(websocket->alloc, frame);
         return aws_raise_error(send_error);
     }
 
     AWS_LOGF_DEBUG(
         AWS_LS_HTTP_WEBSOCKET,
-        "id=%p: Enqueuing outgoing frame with opcode=%" PRIu8 "(%s) length=%" PRIu64 " fin=%s",
+        "id=%p: Enqueuing outgoing frame with opcode=%" PRIu8 "(%s) length=%" PRIu64 " fin=%s pre-encoded=%s",
         (void *)websocket,
-        options->opcode,
-        aws_websocket_opcode_str(options->opcode),
-        options->payload_length,
-        options->fin ? "T" : "F");
+        def.opcode,
+        aws_websocket_opcode_str(def.opcode),
+        def.payload_length,
+        def.fin ? "T" : "F",
+        is_pre_encoded ? "T" : "F");
 
     if (should_schedule_task) {
         AWS_LOGF_TRACE(AWS_LS_HTTP_WEBSOCKET, "id=%p: Scheduling synced data task.", (void *)websocket);
@@ -500,6 +740,145 @@ int aws_websocket_send_frame(struct aws_websocket *websocket, const struct aws_w
     return s_send_frame(websocket, options, true);
 }
 
+/* Encoder's outgoing_payload callback, while a frame is encoded ahead of time */
+static int s_encoded_frame_write_payload(struct aws_byte_buf *out_buf, void *user_data) {
+    struct aws_byte_cursor *payload = user_data;
+    aws_byte_buf_write_to_capacity(out_buf, payload);
+    return AWS_OP_SUCCESS;
+}
+
+static void s_encoded_frame_destroy(void *user_data) {
+    struct aws_websocket_encoded_frame *encoded_frame = user_data;
+    aws_mem_release(encoded_frame->alloc, encoded_frame);
+}
+
+struct aws_websocket_encoded_frame *aws_websocket_encoded_frame_new(
+    struct aws_allocator *allocator,
+    uint8_t opcode,
+    struct aws_byte_cursor payload) {
+
+    AWS_PRECONDITION(allocator);
+
+    struct aws_websocket_frame frame = {
+        .fin = true,
+        .opcode = opcode,
+        .payload_length = payload.len,
+    };
+
+    /* A whole message can't start with CONTINUATION, and control frames' payloads are limited.
+     * RFC-6455 Section 5.5 */
+    if (opcode == AWS_WEBSOCKET_OPCODE_CONTINUATION ||
+        (!aws_websocket_is_data_frame(opcode) && payload.len >= AWS_WEBSOCKET_2BYTE_EXTENDED_LENGTH_MIN_VALUE)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET,
+            "Cannot pre-encode frame with opcode=%" PRIu8 "(%s) length=%zu.",
+            opcode,
+            aws_websocket_opcode_str(opcode),
+            payload.len);
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    /* The payload is already in memory, so the encoded size fits in a size_t unless the addition overflows */
+    const size_t encoded_size = (size_t)aws_websocket_frame_encoded_size(&frame);
+    size_t alloc_size;
+    if (encoded_size < payload.len ||
+        aws_add_size_checked(sizeof(struct aws_websocket_encoded_frame), encoded_size, &alloc_size)) {
+        aws_raise_error(AWS_ERROR_OVERFLOW_DETECTED);
+        return NULL;
+    }
+
+    struct aws_websocket_encoded_frame *encoded_frame = aws_mem_acquire(allocator, alloc_size);
+    if (!encoded_frame) {
+        return NULL;
+    }
+    AWS_ZERO_STRUCT(*encoded_frame);
+    encoded_frame->alloc = allocator;
+    aws_ref_count_init(&encoded_frame->ref_count, encoded_frame, s_encoded_frame_destroy);
+    encoded_frame->frame = frame;
+
+    /* Run the frame through an encoder of its own, whose output buffer fits it exactly */
+    struct aws_byte_buf encoded_buf = aws_byte_buf_from_empty_array(
+        (uint8_t *)(encoded_frame + 1), alloc_size - sizeof(struct aws_websocket_encoded_frame));
+    struct aws_websocket_encoder encoder;
+    aws_websocket_encoder_init(&encoder, s_encoded_frame_write_payload, &payload);
+    if (aws_websocket_encoder_start_frame(&encoder, &frame) || aws_websocket_encoder_process(&encoder, &encoded_buf)) {
+        aws_mem_release(allocator, encoded_frame);
+        return NULL;
+    }
+    AWS_ASSERT(!aws_websocket_encoder_is_frame_in_progress(&encoder));
+
+    encoded_frame->encoded = aws_byte_cursor_from_buf(&encoded_buf);
+    return encoded_frame;
+}
+
+struct aws_websocket_encoded_frame *aws_websocket_encoded_frame_acquire(struct aws_websocket_encoded_frame *frame) {
+    if (frame) {
+        aws_ref_count_acquire(&frame->ref_count);
+    }
+    return frame;
+}
+
+void aws_websocket_encoded_frame_release(struct aws_websocket_encoded_frame *frame) {
+    if (frame) {
+        aws_ref_count_release(&frame->ref_count);
+    }
+}
+
+int aws_websocket_send_encoded_frame(
+    struct aws_websocket *websocket,
+    const struct aws_websocket_send_encoded_frame_options *options) {
+
+    AWS_PRECONDITION(websocket);
+    AWS_PRECONDITION(options);
+    AWS_PRECONDITION(options->encoded_frame);
+
+    /* RFC-6455 Section 5.3 Client-to-Server Masking.
+     * A client must mask each frame with a fresh key, so there's nothing to share */
+    if (!websocket->is_server) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET, "id=%p: Only server websockets can send pre-encoded frames.", (void *)websocket);
+        return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+    }
+
+    struct outgoing_frame *frame = aws_mem_calloc(websocket->alloc, 1, sizeof(struct outgoing_frame));
+    if (!frame) {
+        return AWS_OP_ERR;
+    }
+
+    const struct aws_websocket_frame *frame_def = &options->encoded_frame->frame;
+    frame->def.payload_length = frame_def->payload_length;
+    frame->def.user_data = options->user_data;
+    frame->def.on_complete = options->on_complete;
+    frame->def.opcode = frame_def->opcode;
+    frame->def.fin = frame_def->fin;
+    frame->encoded_frame = aws_websocket_encoded_frame_acquire(options->encoded_frame);
+
+    if (s_enqueue_outgoing_frame(websocket, frame, true /*from_public_api*/)) {
+        aws_websocket_encoded_frame_release(frame->encoded_frame);
+        aws_mem_release(websocket->alloc, frame);
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+size_t aws_websocket_broadcast_encoded_frame(
+    struct aws_websocket *const *websockets,
+    size_t num_websockets,
+    const struct aws_websocket_send_encoded_frame_options *options) {
+
+    AWS_PRECONDITION(websockets || num_websockets == 0);
+
+    size_t num_sent = 0;
+    for (size_t i = 0; i < num_websockets; ++i) {
+        if (aws_websocket_send_encoded_frame(websockets[i], options) == AWS_OP_SUCCESS) {
+            ++num_sent;
+        }
+    }
+    return num_sent;
+}
+
 static void s_move_synced_data_to_thread_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
     (void)task;
     if (status != AWS_TASK_STATUS_RUN_READY) {
@@ -526,13 +905,23 @@ static void s_move_synced_data_to_thread_task(struct aws_channel_task *task, voi
     }
 }
 
+/* Whether a batched message should wait for more frames: it's short of the target size and time remains */
+static bool s_should_hold_write_batch(
+    const struct aws_websocket *websocket,
+    const struct aws_io_message *io_msg,
+    uint64_t now_ns) {
+
+    size_t target_size = aws_min_size(websocket->write_batch_target_size, io_msg->message_data.capacity);
+    return io_msg->message_data.len < target_size && now_ns < websocket->thread_data.write_batch_deadline_ns;
+}
+
 static void s_try_write_outgoing_frames(struct aws_websocket *websocket) {
     AWS_ASSERT(aws_channel_thread_is_callers_thread(websocket->channel_slot->channel));
     int err;
 
     /* Check whether we should be writing data */
     if (!websocket->thread_data.current_outgoing_frame &&
-        aws_linked_list_empty(&websocket->thread_data.outgoing_frame_list)) {
+        aws_linked_list_empty(&websocket->thread_data.outgoing_frame_list) && !websocket->thread_data.write_batch_msg) {
 
         AWS_LOGF_TRACE(AWS_LS_HTTP_WEBSOCKET, "id=%p: No data to write at this time.", (void *)websocket);
         return;
@@ -551,20 +940,36 @@ static void s_try_write_outgoing_frames(struct aws_websocket *websocket) {
         return;
     }
 
-    /* Acquire aws_io_message */
-    struct aws_io_message *io_msg = aws_channel_slot_acquire_max_message_for_write(websocket->channel_slot);
-    if (!io_msg) {
-        AWS_LOGF_ERROR(
-            AWS_LS_HTTP_WEBSOCKET,
-            "id=%p: Failed acquire message from pool, error %d (%s).",
-            (void *)websocket,
-            aws_last_error(),
-            aws_error_name(aws_last_error()));
-        goto error;
+    /* Don't hold anything back once shutdown is waiting on us */
+    bool batching = websocket->write_batch_target_size != 0 &&
+                    !websocket->thread_data.is_shutting_down_and_waiting_for_close_frame_to_be_written;
+
+    uint64_t now_ns = 0;
+    if (batching && aws_channel_current_clock_time(websocket->channel_slot->channel, &now_ns)) {
+        s_shutdown_due_to_write_err(websocket, aws_last_error());
+        return;
     }
 
-    io_msg->user_data = websocket;
-    io_msg->on_completion = s_io_message_write_completed;
+    /* Pick up the message being batched, or acquire a new aws_io_message */
+    struct aws_io_message *io_msg = websocket->thread_data.write_batch_msg;
+    websocket->thread_data.write_batch_msg = NULL;
+    if (!io_msg) {
+        io_msg = aws_channel_slot_acquire_max_message_for_write(websocket->channel_slot);
+        if (!io_msg) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET,
+                "id=%p: Failed acquire message from pool, error %d (%s).",
+                (void *)websocket,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            goto error;
+        }
+
+        io_msg->user_data = websocket;
+        io_msg->on_completion = s_io_message_write_completed;
+
+        websocket->thread_data.write_batch_deadline_ns = now_ns + websocket->write_batch_max_delay_ns;
+    }
 
     /* Loop through frames, writing their data into the io_msg */
     bool wrote_close_frame = false;
@@ -588,50 +993,23 @@ static void s_try_write_outgoing_frames(struct aws_websocket *websocket) {
 
             struct aws_linked_list_node *node = aws_linked_list_pop_front(&websocket->thread_data.outgoing_frame_list);
             websocket->thread_data.current_outgoing_frame = AWS_CONTAINER_OF(node, struct outgoing_frame, node);
+        }
 
-            struct aws_websocket_frame frame = {
-                .fin = websocket->thread_data.current_outgoing_frame->def.fin,
-                .opcode = websocket->thread_data.current_outgoing_frame->def.opcode,
-                .payload_length = websocket->thread_data.current_outgoing_frame->def.payload_length,
-            };
-
-            /* RFC-6455 Section 5.3 Client-to-Server Masking
-             * Clients must mask payload with key derived from an unpredictable source of entropy. */
-            if (!websocket->is_server) {
-                frame.masked = true;
-                /* TODO: faster source of random (but still seeded by device_random) */
-                struct aws_byte_buf masking_key_buf = aws_byte_buf_from_empty_array(frame.masking_key, 4);
-                err = aws_device_random_buffer(&masking_key_buf);
-                if (err) {
-                    AWS_LOGF_ERROR(
-                        AWS_LS_HTTP_WEBSOCKET,
-                        "id=%p: Failed to derive masking key, error %d (%s).",
-                        (void *)websocket,
-                        aws_last_error(),
-                        aws_error_name(aws_last_error()));
-                    goto error;
-                }
-            }
-
-            err = aws_websocket_encoder_start_frame(&websocket->thread_data.encoder, &frame);
+        /* A frame that's popped off the list isn't encoded until its payload is compressed, if it's compressed */
+        if (!aws_websocket_encoder_is_frame_in_progress(&websocket->thread_data.encoder)) {
+            bool frame_started;
+            err = s_start_outgoing_frame(websocket, &frame_started);
             if (err) {
-                AWS_LOGF_ERROR(
-                    AWS_LS_HTTP_WEBSOCKET,
-                    "id=%p: Failed to start frame encoding, error %d (%s).",
-                    (void *)websocket,
-                    aws_last_error(),
-                    aws_error_name(aws_last_error()));
                 goto error;
             }
 
-            AWS_LOGF_TRACE(
-                AWS_LS_HTTP_WEBSOCKET,
-                "id=%p: Start writing frame=%p opcode=%" PRIu8 "(%s) payload-length=%" PRIu64 ".",
-                (void *)websocket,
-                (void *)websocket->thread_data.current_outgoing_frame,
-                websocket->thread_data.current_outgoing_frame->def.opcode,
-                aws_websocket_opcode_str(websocket->thread_data.current_outgoing_frame->def.opcode),
-                websocket->thread_data.current_outgoing_frame->def.payload_length);
+            if (!frame_started) {
+                AWS_LOGF_TRACE(
+                    AWS_LS_HTTP_WEBSOCKET,
+                    "id=%p: Outgoing frame is still being compressed, but no more data can be read at this time.",
+                    (void *)websocket);
+                break;
+            }
         }
 
         err = aws_websocket_encoder_process(&websocket->thread_data.encoder, &io_msg->message_data);
@@ -693,6 +1071,28 @@ static void s_try_write_outgoing_frames(struct aws_websocket *websocket) {
 
     /* Prepare to send aws_io_message up the channel. */
 
+    /* Wait for more frames to fill the message, but no longer than the batch's deadline.
+     * If the current frame's payload stream is waiting on data, there's no point holding the message back. */
+    if (batching && !wrote_close_frame && !websocket->thread_data.current_outgoing_frame &&
+        s_should_hold_write_batch(websocket, io_msg, now_ns)) {
+
+        AWS_LOGF_TRACE(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Holding aws_io_message of size %zu for more frames.",
+            (void *)websocket,
+            io_msg->message_data.len);
+
+        websocket->thread_data.write_batch_msg = io_msg;
+        if (!websocket->thread_data.is_write_batch_task_scheduled) {
+            websocket->thread_data.is_write_batch_task_scheduled = true;
+            aws_channel_schedule_task_future(
+                websocket->channel_slot->channel,
+                &websocket->write_batch_task,
+                websocket->thread_data.write_batch_deadline_ns);
+        }
+        return;
+    }
+
     /* If CLOSE frame was written, that's the last data we'll write */
     if (wrote_close_frame) {
         s_stop_writing(websocket, AWS_ERROR_HTTP_WEBSOCKET_CLOSE_FRAME_SENT);
@@ -735,12 +1135,247 @@ error:
     s_shutdown_due_to_write_err(websocket, aws_last_error());
 }
 
+/* Run data through the compressor, appending its output to compressed_payload */
+static int s_compress(struct aws_websocket *websocket, struct aws_byte_cursor *input, bool flush) {
+    struct aws_byte_buf *output = &websocket->thread_data.compressed_payload;
+
+    while (true) {
+        if (output->len == output->capacity && aws_byte_buf_reserve_relative(output, output->capacity)) {
+            return AWS_OP_ERR;
+        }
+
+        const size_t prev_input_len = input->len;
+        const size_t prev_output_len = output->len;
+        if (websocket->compressor->vtable->compress(websocket->compressor, input, output, flush)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET,
+                "id=%p: Failed to compress payload, error %d (%s).",
+                (void *)websocket,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            return AWS_OP_ERR;
+        }
+
+        /* Done once the input is used up and the compressor has room to spare (it's holding no more output) */
+        if (input->len == 0 && output->len < output->capacity) {
+            return AWS_OP_SUCCESS;
+        }
+
+        if (input->len == prev_input_len && output->len == prev_output_len) {
+            AWS_LOGF_ERROR(AWS_LS_HTTP_WEBSOCKET, "id=%p: Compressor is making no progress.", (void *)websocket);
+            return aws_raise_error(AWS_ERROR_INVALID_STATE);
+        }
+    }
+}
+
+/* Read the current outgoing frame's payload from the user and compress it.
+ * out_done is set false if the payload stream has no data available right now. */
+static int s_compress_outgoing_payload(struct aws_websocket *websocket, bool *out_done) {
+    struct outgoing_frame *current_frame = websocket->thread_data.current_outgoing_frame;
+
+    if (!websocket->thread_data.is_compressing_current_outgoing_frame) {
+        websocket->thread_data.is_compressing_current_outgoing_frame = true;
+        websocket->thread_data.current_outgoing_payload_bytes_read = 0;
+        aws_byte_buf_reset(&websocket->thread_data.compressed_payload, false /*zero_contents*/);
+    }
+
+    while (websocket->thread_data.current_outgoing_payload_bytes_read < current_frame->def.payload_length) {
+        uint64_t remaining =
+            current_frame->def.payload_length - websocket->thread_data.current_outgoing_payload_bytes_read;
+        size_t read_size = (size_t)aws_min_u64(remaining, websocket->thread_data.uncompressed_payload.capacity);
+        struct aws_byte_buf read_buf =
+            aws_byte_buf_from_empty_array(websocket->thread_data.uncompressed_payload.buffer, read_size);
+
+        if (!current_frame->def.stream_outgoing_payload(websocket, &read_buf, current_frame->def.user_data)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET, "id=%p: Outgoing payload callback has reported a failure.", (void *)websocket);
+            return aws_raise_error(AWS_ERROR_HTTP_CALLBACK_FAILURE);
+        }
+
+        if (read_buf.len == 0) {
+            *out_done = false;
+            return AWS_OP_SUCCESS;
+        }
+
+        websocket->thread_data.current_outgoing_payload_bytes_read += read_buf.len;
+
+        struct aws_byte_cursor input = aws_byte_cursor_from_buf(&read_buf);
+        if (s_compress(websocket, &input, false /*flush*/)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    /* RFC-7692 Section 7.2.1: Flush, so the frame ends on a byte boundary */
+    struct aws_byte_cursor no_input;
+    AWS_ZERO_STRUCT(no_input);
+    if (s_compress(websocket, &no_input, true /*flush*/)) {
+        return AWS_OP_ERR;
+    }
+
+    if (current_frame->def.fin) {
+        /* Remove the 4 bytes the flush ended with, the receiver puts them back */
+        struct aws_byte_buf *compressed = &websocket->thread_data.compressed_payload;
+        if (compressed->len >= AWS_WEBSOCKET_DEFLATE_TAIL_LENGTH &&
+            memcmp(
+                compressed->buffer + compressed->len - AWS_WEBSOCKET_DEFLATE_TAIL_LENGTH,
+                aws_websocket_deflate_tail,
+                AWS_WEBSOCKET_DEFLATE_TAIL_LENGTH) == 0) {
+            compressed->len -= AWS_WEBSOCKET_DEFLATE_TAIL_LENGTH;
+        }
+
+        if (websocket->reset_compressor_after_message &&
+            websocket->compressor->vtable->reset(websocket->compressor)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET,
+                "id=%p: Failed to reset compressor, error %d (%s).",
+                (void *)websocket,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            return AWS_OP_ERR;
+        }
+    }
+
+    websocket->thread_data.is_compressing_current_outgoing_frame = false;
+    websocket->thread_data.compressed_payload_cursor =
+        aws_byte_cursor_from_buf(&websocket->thread_data.compressed_payload);
+    *out_done = true;
+    return AWS_OP_SUCCESS;
+}
+
+/* Start writing the current outgoing frame, which was encoded ahead of time.
+ * It's written as is: it's never compressed, and only servers send them, so it's never masked. */
+static int s_start_pre_encoded_outgoing_frame(struct aws_websocket *websocket, bool *out_frame_started) {
+    struct outgoing_frame *current_frame = websocket->thread_data.current_outgoing_frame;
+    const struct aws_websocket_encoded_frame *encoded_frame = current_frame->encoded_frame;
+
+    AWS_HTTP_PROBE3(websocket__frame__out, websocket, encoded_frame->frame.opcode, encoded_frame->frame.payload_length);
+    if (aws_websocket_encoder_start_pre_encoded_frame(
+            &websocket->thread_data.encoder, &encoded_frame->frame, encoded_frame->encoded)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Failed to start pre-encoded frame, error %d (%s).",
+            (void *)websocket,
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    /* RFC-7692 Section 6: A message may go uncompressed, even when permessage-deflate is in use */
+    websocket->thread_data.is_current_outgoing_frame_compressed = false;
+    if (aws_websocket_is_data_frame(encoded_frame->frame.opcode)) {
+        websocket->thread_data.is_sending_compressed_message = false;
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_WEBSOCKET,
+        "id=%p: Start writing pre-encoded frame=%p opcode=%" PRIu8 "(%s) payload-length=%" PRIu64 ".",
+        (void *)websocket,
+        (void *)current_frame,
+        encoded_frame->frame.opcode,
+        aws_websocket_opcode_str(encoded_frame->frame.opcode),
+        encoded_frame->frame.payload_length);
+
+    *out_frame_started = true;
+    return AWS_OP_SUCCESS;
+}
+
+/* Start encoding the current outgoing frame.
+ * If its payload is compressed, that must be done first, and out_frame_started is set false
+ * if the payload stream has no data available right now. */
+static int s_start_outgoing_frame(struct aws_websocket *websocket, bool *out_frame_started) {
+    struct outgoing_frame *current_frame = websocket->thread_data.current_outgoing_frame;
+    *out_frame_started = false;
+
+    if (current_frame->encoded_frame) {
+        return s_start_pre_encoded_outgoing_frame(websocket, out_frame_started);
+    }
+
+    struct aws_websocket_frame frame = {
+        .fin = current_frame->def.fin,
+        .opcode = current_frame->def.opcode,
+        .payload_length = current_frame->def.payload_length,
+    };
+
+    /* RFC-7692 Section 6: Data frames of a compressed message are compressed,
+     * and the RSV1 bit is set on the message's first frame. */
+    websocket->thread_data.is_current_outgoing_frame_compressed = false;
+    if (websocket->compressor && aws_websocket_is_data_frame(frame.opcode)) {
+        if (frame.opcode != AWS_WEBSOCKET_OPCODE_CONTINUATION) {
+            /* A small, unfragmented message isn't worth compressing */
+            websocket->thread_data.is_sending_compressed_message =
+                !(frame.fin && frame.payload_length < websocket->compression_threshold);
+            frame.rsv[0] = websocket->thread_data.is_sending_compressed_message;
+        }
+
+        if (websocket->thread_data.is_sending_compressed_message) {
+            bool done;
+            if (s_compress_outgoing_payload(websocket, &done)) {
+                return AWS_OP_ERR;
+            }
+
+            if (!done) {
+                return AWS_OP_SUCCESS;
+            }
+
+            websocket->thread_data.is_current_outgoing_frame_compressed = true;
+            frame.payload_length = websocket->thread_data.compressed_payload.len;
+        }
+    }
+
+    /* RFC-6455 Section 5.3 Client-to-Server Masking
+     * Clients must mask payload with key derived from an unpredictable source of entropy. */
+    if (!websocket->is_server) {
+        frame.masked = true;
+        /* TODO: faster source of random (but still seeded by device_random) */
+        struct aws_byte_buf masking_key_buf = aws_byte_buf_from_empty_array(frame.masking_key, 4);
+        if (aws_device_random_buffer(&masking_key_buf)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET,
+                "id=%p: Failed to derive masking key, error %d (%s).",
+                (void *)websocket,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            return AWS_OP_ERR;
+        }
+    }
+
+    AWS_HTTP_PROBE3(websocket__frame__out, websocket, frame.opcode, frame.payload_length);
+    if (aws_websocket_encoder_start_frame(&websocket->thread_data.encoder, &frame)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Failed to start frame encoding, error %d (%s).",
+            (void *)websocket,
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_WEBSOCKET,
+        "id=%p: Start writing frame=%p opcode=%" PRIu8 "(%s) payload-length=%" PRIu64 " compressed=%s.",
+        (void *)websocket,
+        (void *)current_frame,
+        current_frame->def.opcode,
+        aws_websocket_opcode_str(current_frame->def.opcode),
+        frame.payload_length,
+        websocket->thread_data.is_current_outgoing_frame_compressed ? "T" : "F");
+
+    *out_frame_started = true;
+    return AWS_OP_SUCCESS;
+}
+
 /* Encoder's outgoing_payload callback invokes current frame's callback */
 static int s_encoder_stream_outgoing_payload(struct aws_byte_buf *out_buf, void *user_data) {
     struct aws_websocket *websocket = user_data;
     AWS_ASSERT(aws_channel_thread_is_callers_thread(websocket->channel_slot->channel));
     AWS_ASSERT(websocket->thread_data.current_outgoing_frame);
 
+    /* Compressed payload was already read from the user */
+    if (websocket->thread_data.is_current_outgoing_frame_compressed) {
+        aws_byte_buf_write_to_capacity(out_buf, &websocket->thread_data.compressed_payload_cursor);
+        return AWS_OP_SUCCESS;
+    }
+
     struct outgoing_frame *current_frame = websocket->thread_data.current_outgoing_frame;
     AWS_ASSERT(current_frame->def.stream_outgoing_payload);
 
@@ -771,6 +1406,26 @@ static void s_waiting_on_payload_stream_task(struct aws_channel_task *task, void
     s_try_write_outgoing_frames(websocket);
 }
 
+static void s_write_batch_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+    if (status != AWS_TASK_STATUS_RUN_READY) {
+        return;
+    }
+
+    struct aws_websocket *websocket = arg;
+    AWS_ASSERT(aws_channel_thread_is_callers_thread(websocket->channel_slot->channel));
+
+    websocket->thread_data.is_write_batch_task_scheduled = false;
+
+    /* The held message may have been sent already, in which case this does nothing,
+     * or a newer message with a later deadline may be held, in which case this re-schedules the task */
+    if (websocket->thread_data.write_batch_msg) {
+        AWS_LOGF_TRACE(
+            AWS_LS_HTTP_WEBSOCKET, "id=%p: Write batch deadline reached, sending held data...", (void *)websocket);
+        s_try_write_outgoing_frames(websocket);
+    }
+}
+
 static void s_io_message_write_completed(
     struct aws_channel *channel,
     struct aws_io_message *message,
@@ -881,20 +1536,28 @@ static void s_destroy_outgoing_frame(struct aws_websocket *websocket, struct out
         frame->def.on_complete(websocket, error_code, frame->def.user_data);
     }
 
+    aws_websocket_encoded_frame_release(frame->encoded_frame);
     aws_mem_release(websocket->alloc, frame);
 }
 
 static void s_complete_frame_list(struct aws_websocket *websocket, struct aws_linked_list *frames, int error_code) {
+    size_t num_frames = 0;
     struct aws_linked_list_node *node = aws_linked_list_begin(frames);
     while (node != aws_linked_list_end(frames)) {
         struct outgoing_frame *frame = AWS_CONTAINER_OF(node, struct outgoing_frame, node);
 
         node = aws_linked_list_next(node);
         s_destroy_outgoing_frame(websocket, frame, error_code);
+        num_frames++;
     }
 
     /* we've released everything, so reset the list to empty */
     aws_linked_list_init(frames);
+
+    /* One callback for the whole batch. Midchannel handlers don't invoke user callbacks */
+    if (num_frames > 0 && websocket->on_outgoing_frames_complete && !websocket->thread_data.is_midchannel_handler) {
+        websocket->on_outgoing_frames_complete(websocket, num_frames, error_code, websocket->user_data);
+    }
 }
 
 static void s_stop_writing(struct aws_websocket *websocket, int send_frame_error_code) {
@@ -921,6 +1584,13 @@ static void s_stop_writing(struct aws_websocket *websocket, int send_frame_error
     /* END CRITICAL SECTION */
 
     websocket->thread_data.is_writing_stopped = true;
+
+    /* A message held for batching will never be sent.
+     * Its frames are still in write_completion_frames, and complete when shutdown finishes */
+    if (websocket->thread_data.write_batch_msg) {
+        aws_mem_release(websocket->thread_data.write_batch_msg->allocator, websocket->thread_data.write_batch_msg);
+        websocket->thread_data.write_batch_msg = NULL;
+    }
 }
 
 static void s_shutdown_due_to_write_err(struct aws_websocket *websocket, int error_code) {
@@ -1282,17 +1952,88 @@ clean_up:
     return AWS_OP_SUCCESS;
 }
 
+/* Get a buffer for the current data frame's payload, starting a new message if it's the first frame */
+static int s_begin_incoming_message_frame(struct aws_websocket *websocket) {
+    const struct aws_websocket_incoming_frame *frame = websocket->thread_data.current_incoming_frame;
+    const size_t max_size = websocket->message_pool->max_message_size;
+    const size_t prev_len =
+        websocket->thread_data.incoming_message ? websocket->thread_data.incoming_message->payload.len : 0;
+
+    /* Compressed payload may decompress to any size, so it can't be rejected yet,
+     * and the buffer grows as needed once decompressed data arrives */
+    if (frame->payload_length > max_size - prev_len && !frame->compressed) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Incoming message would exceed max size %zu, frame payload-length=%" PRIu64 ".",
+            (void *)websocket,
+            max_size,
+            frame->payload_length);
+        return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_MESSAGE_TOO_BIG);
+    }
+
+    size_t capacity = prev_len + (size_t)aws_min_u64(frame->payload_length, max_size - prev_len);
+
+    if (frame->opcode != AWS_WEBSOCKET_OPCODE_CONTINUATION) {
+        /* The decoder ensures a new message doesn't start until the previous one is finished */
+        AWS_ASSERT(!websocket->thread_data.incoming_message);
+        websocket->thread_data.incoming_message = aws_websocket_message_pool_acquire(websocket->message_pool, capacity);
+        if (!websocket->thread_data.incoming_message) {
+            return AWS_OP_ERR;
+        }
+        websocket->thread_data.incoming_message->opcode = frame->opcode;
+        return AWS_OP_SUCCESS;
+    }
+
+    AWS_ASSERT(websocket->thread_data.incoming_message);
+    return aws_websocket_incoming_message_reserve(&websocket->thread_data.incoming_message, capacity);
+}
+
+/* Copy payload into the message being reassembled */
+static int s_append_incoming_message(struct aws_websocket *websocket, struct aws_byte_cursor data) {
+    AWS_ASSERT(websocket->thread_data.incoming_message);
+    const size_t len = websocket->thread_data.incoming_message->payload.len;
+
+    if (data.len > websocket->message_pool->max_message_size - len) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Incoming message exceeds max size %zu.",
+            (void *)websocket,
+            websocket->message_pool->max_message_size);
+        return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_MESSAGE_TOO_BIG);
+    }
+
+    if (aws_websocket_incoming_message_reserve(&websocket->thread_data.incoming_message, len + data.len)) {
+        return AWS_OP_ERR;
+    }
+
+    aws_byte_buf_write_from_whole_cursor(&websocket->thread_data.incoming_message->payload, data);
+    return AWS_OP_SUCCESS;
+}
+
 static int s_decoder_on_frame(const struct aws_websocket_frame *frame, void *user_data) {
     struct aws_websocket *websocket = user_data;
     AWS_ASSERT(aws_channel_thread_is_callers_thread(websocket->channel_slot->channel));
     AWS_ASSERT(!websocket->thread_data.current_incoming_frame);
     AWS_ASSERT(!websocket->thread_data.is_reading_stopped);
+    AWS_HTTP_PROBE3(websocket__frame__in, websocket, frame->opcode, frame->payload_length);
+
+    /* RFC-6455 Section 5.2: RSV bits MUST be 0 unless an extension defining them was negotiated.
+     * permessage-deflate defines RSV1, and the decoder has already checked which frames may have it. */
+    if ((frame->rsv[0] && !websocket->decompressor) || frame->rsv[1] || frame->rsv[2]) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Received frame with RSV bits set, but no extension was negotiated that defines them.",
+            (void *)websocket);
+        return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_PROTOCOL_ERROR);
+    }
 
     websocket->thread_data.current_incoming_frame = &websocket->thread_data.incoming_frame_storage;
 
     websocket->thread_data.current_incoming_frame->payload_length = frame->payload_length;
     websocket->thread_data.current_incoming_frame->opcode = frame->opcode;
     websocket->thread_data.current_incoming_frame->fin = frame->fin;
+    websocket->thread_data.current_incoming_frame->compressed =
+        websocket->thread_data.decoder.processing_compressed_message && aws_websocket_is_data_frame(frame->opcode);
 
     /* If CONTINUATION frames are expected, remember which type of data is being continued.
      * RFC-6455 Section 5.4 Fragmentation */
@@ -1328,6 +2069,15 @@ static int s_decoder_on_frame(const struct aws_websocket_frame *frame, void *use
         return aws_raise_error(AWS_ERROR_HTTP_CALLBACK_FAILURE);
     }
 
+    /* Make room for this frame's payload in the message being reassembled */
+    if (websocket->message_pool && aws_websocket_is_data_frame(frame->opcode) &&
+        !websocket->thread_data.is_midchannel_handler) {
+
+        if (s_begin_incoming_message_frame(websocket)) {
+            return AWS_OP_ERR;
+        }
+    }
+
     return AWS_OP_SUCCESS;
 }
 
@@ -1351,7 +2101,13 @@ static int s_decoder_on_payload(struct aws_byte_cursor data, void *user_data) {
 
 /* Invoke user cb */
 static int s_decoder_on_user_payload(struct aws_websocket *websocket, struct aws_byte_cursor data) {
-    if (websocket->on_incoming_frame_payload) {
+    if (websocket->message_pool && aws_websocket_is_data_frame(websocket->thread_data.current_incoming_frame->opcode)) {
+        /* Data is delivered once the whole message has arrived */
+        if (s_append_incoming_message(websocket, data)) {
+            return AWS_OP_ERR;
+        }
+
+    } else if (websocket->on_incoming_frame_payload) {
         if (!websocket->on_incoming_frame_payload(
                 websocket, websocket->thread_data.current_incoming_frame, data, websocket->user_data)) {
 
@@ -1361,16 +2117,33 @@ static int s_decoder_on_user_payload(struct aws_websocket *websocket, struct aws
         }
     }
 
-    /* If this is a "data" frame's payload, let the window shrink */
+    /* If this is a "data" frame's payload, let the window shrink.
+     * Decompressed payload may be larger than what was read, the excess is deducted from later increments.
+     * With auto_window_update, the window only shrinks while the user holds more messages than the budget allows. */
     if (aws_websocket_is_data_frame(websocket->thread_data.current_incoming_frame->opcode) &&
-        websocket->manual_window_update) {
+        websocket->manual_window_update &&
+        (!websocket->auto_window_update || aws_websocket_message_pool_is_over_budget(websocket->message_pool))) {
 
-        websocket->thread_data.incoming_message_window_update -= data.len;
+        size_t shrink = aws_min_size(data.len, websocket->thread_data.incoming_message_window_update);
+        websocket->thread_data.incoming_message_window_update -= shrink;
+        websocket->thread_data.read_window_debt =
+            aws_add_size_saturating(websocket->thread_data.read_window_debt, data.len - shrink);
         AWS_LOGF_DEBUG(
             AWS_LS_HTTP_WEBSOCKET,
             "id=%p: The read window is shrinking by %zu due to incoming payload from 'data' frame.",
             (void *)websocket,
             data.len);
+
+        if (websocket->auto_window_update) {
+            websocket->thread_data.throttled_window_size =
+                aws_add_size_saturating(websocket->thread_data.throttled_window_size, data.len);
+
+            /* If budget was freed up between checking and waiting, the callback won't come, so check again */
+            aws_websocket_message_pool_wait_for_budget(websocket->message_pool);
+            if (!aws_websocket_message_pool_is_over_budget(websocket->message_pool)) {
+                s_on_read_budget_freed(websocket);
+            }
+        }
     }
 
     return AWS_OP_SUCCESS;
@@ -1533,9 +2306,37 @@ static void s_complete_incoming_frame(struct aws_websocket *websocket, int error
         }
     }
 
-    /* Invoke user cb */
+    /* Deliver the reassembled message once its final frame is done, or drop it if the frame failed */
     bool callback_result = true;
-    if (websocket->on_incoming_frame_complete && !websocket->thread_data.is_midchannel_handler) {
+    struct aws_websocket_incoming_message *message = websocket->thread_data.incoming_message;
+    if (message && aws_websocket_is_data_frame(websocket->thread_data.current_incoming_frame->opcode) &&
+        (error_code || websocket->thread_data.current_incoming_frame->fin)) {
+
+        websocket->thread_data.incoming_message = NULL;
+        if (error_code == 0 && !websocket->thread_data.is_midchannel_handler) {
+            AWS_LOGF_TRACE(
+                AWS_LS_HTTP_WEBSOCKET,
+                "id=%p: Incoming message complete, opcode=%" PRIu8 "(%s) payload-length=%zu.",
+                (void *)websocket,
+                message->opcode,
+                aws_websocket_opcode_str(message->opcode),
+                message->payload.len);
+
+            /* Message counts against the read budgets until the user releases it */
+            aws_websocket_message_pool_charge(websocket->message_pool, message);
+            callback_result = websocket->on_incoming_message(websocket, message, websocket->user_data);
+            if (!callback_result) {
+                AWS_LOGF_ERROR(
+                    AWS_LS_HTTP_WEBSOCKET,
+                    "id=%p: Incoming message callback has reported a failure.",
+                    (void *)websocket);
+            }
+        }
+        aws_websocket_incoming_message_release(message);
+    }
+
+    /* Invoke user cb */
+    if (callback_result && websocket->on_incoming_frame_complete && !websocket->thread_data.is_midchannel_handler) {
         callback_result = websocket->on_incoming_frame_complete(
             websocket, websocket->thread_data.current_incoming_frame, error_code, websocket->user_data);
     }
@@ -1611,6 +2412,14 @@ error:
 static void s_increment_read_window_action(struct aws_websocket *websocket, size_t size) {
     AWS_ASSERT(aws_channel_thread_is_callers_thread(websocket->channel_slot->channel));
 
+    /* Pay off any decompressed payload that was delivered beyond the window */
+    size_t debt_paid = aws_min_size(size, websocket->thread_data.read_window_debt);
+    websocket->thread_data.read_window_debt -= debt_paid;
+    size -= debt_paid;
+    if (size == 0) {
+        return;
+    }
+
     int err = aws_channel_slot_increment_read_window(websocket->channel_slot, size);
     if (err) {
         AWS_LOGF_ERROR(
@@ -1649,12 +2458,81 @@ static void s_increment_read_window_task(struct aws_channel_task *task, void *ar
     s_increment_read_window_action(websocket, size);
 }
 
+/* Invoked by the message pool, from any thread, when budget frees up */
+static void s_on_read_budget_freed(void *user_data) {
+    struct aws_websocket *websocket = user_data;
+    bool should_schedule_task = false;
+
+    /* BEGIN CRITICAL SECTION */
+    s_lock_synced_data(websocket);
+
+    if (!websocket->synced_data.is_midchannel_handler && !websocket->synced_data.is_read_budget_task_scheduled) {
+        websocket->synced_data.is_read_budget_task_scheduled = true;
+        should_schedule_task = true;
+    }
+
+    s_unlock_synced_data(websocket);
+    /* END CRITICAL SECTION */
+
+    if (should_schedule_task) {
+        aws_channel_schedule_task_now(websocket->channel_slot->channel, &websocket->read_budget_task);
+    }
+}
+
+/* Restore the window that was throttled while over budget */
+static void s_read_budget_task(struct aws_channel_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+
+    if (status != AWS_TASK_STATUS_RUN_READY) {
+        return;
+    }
+
+    struct aws_websocket *websocket = arg;
+
+    /* BEGIN CRITICAL SECTION */
+    s_lock_synced_data(websocket);
+    websocket->synced_data.is_read_budget_task_scheduled = false;
+    s_unlock_synced_data(websocket);
+    /* END CRITICAL SECTION */
+
+    size_t size = websocket->thread_data.throttled_window_size;
+    if (size == 0 || websocket->thread_data.is_midchannel_handler) {
+        return;
+    }
+
+    /* Other websockets sharing the budget may have used up what was freed */
+    if (aws_websocket_message_pool_is_over_budget(websocket->message_pool)) {
+        aws_websocket_message_pool_wait_for_budget(websocket->message_pool);
+        if (aws_websocket_message_pool_is_over_budget(websocket->message_pool)) {
+            return;
+        }
+    }
+
+    websocket->thread_data.throttled_window_size = 0;
+
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_WEBSOCKET,
+        "id=%p: Read budget freed up, incrementing read window by %zu.",
+        (void *)websocket,
+        size);
+
+    s_increment_read_window_action(websocket, size);
+}
+
 void aws_websocket_increment_read_window(struct aws_websocket *websocket, size_t size) {
     if (size == 0) {
         AWS_LOGF_TRACE(AWS_LS_HTTP_WEBSOCKET, "id=%p: Ignoring window increment of size 0.", (void *)websocket);
         return;
     }
 
+    if (websocket->auto_window_update) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Ignoring window increment. The read window is managed automatically, due to the read budget.",
+            (void *)websocket);
+        return;
+    }
+
     if (!websocket->manual_window_update) {
         AWS_LOGF_DEBUG(
             AWS_LS_HTTP_WEBSOCKET,
@@ -8,11 +8,14 @@
 #include <aws/common/logging.h>
 #include <aws/common/string.h>
 #include <aws/http/connection.h>
+#include <aws/http/http2_stream_manager.h>
 #include <aws/http/private/http_impl.h>
 #include <aws/http/private/strutil.h>
+#include <aws/http/private/websocket_deflate.h>
 #include <aws/http/private/websocket_impl.h>
 #include <aws/http/request_response.h>
 #include <aws/http/status_code.h>
+#include <aws/io/channel.h>
 #include <aws/io/uri.h>
 
 #include <inttypes.h>
@@ -77,6 +80,23 @@ struct aws_websocket_client_bootstrap {
     /* Comma-separated values from the request's "Sec-WebSocket-Protocol" (or NULL if none)  */
     struct aws_string *expected_sec_websocket_protocols;
 
+    /* permessage-deflate options, if it was offered in the request's "Sec-WebSocket-Extensions" */
+    struct aws_websocket_permessage_deflate_options permessage_deflate;
+    bool offered_permessage_deflate;
+
+    /* Outgoing frame batching settings, passed along to the websocket */
+    size_t write_batch_target_size;
+    uint32_t write_batch_max_delay_ms;
+    aws_websocket_on_outgoing_frames_complete_fn *websocket_outgoing_frames_complete_callback;
+
+    /* Whole-message delivery settings, passed along to the websocket */
+    aws_websocket_on_incoming_message_fn *websocket_message_callback;
+    size_t max_incoming_message_size;
+
+    /* Read budget settings, passed along to the websocket */
+    size_t read_budget;
+    struct aws_websocket_read_budget *shared_read_budget;
+
     /* Handshake response data */
     int response_status;
     struct aws_http_headers *response_headers;
@@ -86,6 +106,31 @@ struct aws_websocket_client_bootstrap {
 
     int setup_error_code;
     struct aws_websocket *websocket;
+
+    /* Only used when the websocket runs over an HTTP/2 stream (RFC-8441).
+     * The websocket handler gets a channel of its own, where the leftmost handler
+     * passes data back and forth with the stream. See s_ws_bootstrap_connect_over_http2() */
+    struct {
+        struct aws_http2_stream_manager *stream_manager;
+        struct aws_http_stream *stream;
+        struct aws_channel *channel;
+        struct aws_channel_slot *slot;
+        struct aws_websocket_permessage_deflate_params deflate_params;
+        bool use_permessage_deflate;
+
+        /* Stream DATA that the websocket hasn't taken yet */
+        struct aws_byte_buf pending_read_data;
+
+        /* aws_io_messages whose data is being written to the stream, in order */
+        struct aws_linked_list pending_writes;
+
+        bool is_stream_acquire_done;
+        bool is_stream_complete;
+        int stream_error_code;
+        bool got_success_response;
+        bool is_reading_stopped;
+        bool is_writing_stopped;
+    } http2;
 };
 
 static void s_ws_bootstrap_destroy(struct aws_websocket_client_bootstrap *ws_bootstrap);
@@ -117,6 +162,9 @@ static int s_ws_bootstrap_on_handshake_response_body(
     const struct aws_byte_cursor *data,
     void *user_data);
 static void s_ws_bootstrap_on_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data);
+static int s_ws_bootstrap_connect_over_http2(
+    struct aws_websocket_client_bootstrap *ws_bootstrap,
+    const struct aws_websocket_client_connection_options *options);
 
 int aws_websocket_client_connect(const struct aws_websocket_client_connection_options *options) {
     aws_http_fatal_assert_library_initialized();
@@ -125,8 +173,9 @@ int aws_websocket_client_connect(const struct aws_websocket_client_connection_op
     /* Validate options */
     struct aws_byte_cursor path;
     aws_http_message_get_request_path(options->handshake_request, &path);
-    if (!options->allocator || !options->bootstrap || !options->socket_options || !options->host.len || !path.len ||
-        !options->on_connection_setup) {
+    const bool over_http2 = options->http2_stream_manager != NULL;
+    if (!options->allocator || !path.len || !options->on_connection_setup ||
+        (!over_http2 && (!options->bootstrap || !options->socket_options || !options->host.len))) {
 
         AWS_LOGF_ERROR(AWS_LS_HTTP_WEBSOCKET_SETUP, "id=static: Missing required websocket connection options.");
         return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
@@ -148,18 +197,41 @@ int aws_websocket_client_connect(const struct aws_websocket_client_connection_op
     }
 
     const struct aws_http_headers *request_headers = aws_http_message_get_headers(options->handshake_request);
+    /* The Sec-WebSocket-Key/Accept exchange is HTTP/1.1 only (RFC-8441 Section 5) */
     struct aws_byte_cursor sec_websocket_key;
-    if (aws_http_headers_get(request_headers, aws_byte_cursor_from_c_str("Sec-WebSocket-Key"), &sec_websocket_key)) {
+    if (aws_http_headers_get(request_headers, aws_byte_cursor_from_c_str("Sec-WebSocket-Key"), &sec_websocket_key) &&
+        !over_http2) {
         AWS_LOGF_ERROR(
             AWS_LS_HTTP_WEBSOCKET_SETUP,
             "id=static: Websocket handshake request is missing required 'Sec-WebSocket-Key' header");
         return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
     }
 
-    /* Extensions are not currently supported */
+    /* Extensions are only supported via options->permessage_deflate */
     if (aws_http_headers_has(request_headers, aws_byte_cursor_from_c_str("Sec-WebSocket-Extensions"))) {
         AWS_LOGF_ERROR(
-            AWS_LS_HTTP_WEBSOCKET_SETUP, "id=static: 'Sec-WebSocket-Extensions' are not currently supported");
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=static: 'Sec-WebSocket-Extensions' header is not supported, use the permessage_deflate option");
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    if (options->permessage_deflate) {
+        const struct aws_websocket_permessage_deflate_options *deflate = options->permessage_deflate;
+        bool valid_server_bits = deflate->server_max_window_bits == 0 ||
+                                 (deflate->server_max_window_bits >= 8 && deflate->server_max_window_bits <= 15);
+        bool valid_client_bits = deflate->client_max_window_bits == 0 ||
+                                 (deflate->client_max_window_bits >= 8 && deflate->client_max_window_bits <= 15);
+        if (!deflate->new_compressor || !deflate->new_decompressor || !valid_server_bits || !valid_client_bits) {
+            AWS_LOGF_ERROR(AWS_LS_HTTP_WEBSOCKET_SETUP, "id=static: Invalid permessage-deflate options.");
+            return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        }
+    }
+
+    const bool auto_window_update = options->read_budget || options->shared_read_budget;
+    if (auto_window_update && (options->manual_window_management || !options->on_incoming_message)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=static: A read budget requires on_incoming_message, and can't be used with manual window management.");
         return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
     }
 
@@ -169,26 +241,69 @@ int aws_websocket_client_connect(const struct aws_websocket_client_connection_op
 
     ws_bootstrap->alloc = options->allocator;
     ws_bootstrap->initial_window_size = options->initial_window_size;
-    ws_bootstrap->manual_window_update = options->manual_window_management;
+    ws_bootstrap->manual_window_update = options->manual_window_management || auto_window_update;
+    if (auto_window_update && ws_bootstrap->initial_window_size == 0) {
+        ws_bootstrap->initial_window_size = AWS_WEBSOCKET_DEFAULT_AUTO_WINDOW_SIZE;
+    }
     ws_bootstrap->user_data = options->user_data;
     ws_bootstrap->websocket_setup_callback = options->on_connection_setup;
     ws_bootstrap->websocket_shutdown_callback = options->on_connection_shutdown;
     ws_bootstrap->websocket_frame_begin_callback = options->on_incoming_frame_begin;
     ws_bootstrap->websocket_frame_payload_callback = options->on_incoming_frame_payload;
     ws_bootstrap->websocket_frame_complete_callback = options->on_incoming_frame_complete;
+    ws_bootstrap->write_batch_target_size = options->write_batch_target_size;
+    ws_bootstrap->write_batch_max_delay_ms = options->write_batch_max_delay_ms;
+    ws_bootstrap->websocket_outgoing_frames_complete_callback = options->on_outgoing_frames_complete;
+    ws_bootstrap->websocket_message_callback = options->on_incoming_message;
+    ws_bootstrap->max_incoming_message_size = options->max_incoming_message_size;
+    ws_bootstrap->read_budget = options->read_budget;
+    ws_bootstrap->shared_read_budget = aws_websocket_read_budget_acquire(options->shared_read_budget);
     ws_bootstrap->handshake_request = aws_http_message_acquire(options->handshake_request);
     ws_bootstrap->response_status = AWS_HTTP_STATUS_CODE_UNKNOWN;
     ws_bootstrap->response_headers = aws_http_headers_new(ws_bootstrap->alloc);
     aws_byte_buf_init(&ws_bootstrap->response_body, ws_bootstrap->alloc, 0);
 
-    if (s_ws_bootstrap_calculate_sec_websocket_accept(
-            sec_websocket_key, &ws_bootstrap->expected_sec_websocket_accept, ws_bootstrap->alloc)) {
+    if (!over_http2 && s_ws_bootstrap_calculate_sec_websocket_accept(
+                           sec_websocket_key, &ws_bootstrap->expected_sec_websocket_accept, ws_bootstrap->alloc)) {
         goto error;
     }
 
     ws_bootstrap->expected_sec_websocket_protocols =
         aws_http_headers_get_all(request_headers, aws_byte_cursor_from_c_str("Sec-WebSocket-Protocol"));
 
+    /* Offer permessage-deflate (RFC-7692 Section 5) */
+    if (options->permessage_deflate) {
+        ws_bootstrap->permessage_deflate = *options->permessage_deflate;
+        ws_bootstrap->offered_permessage_deflate = true;
+
+        struct aws_byte_buf offer;
+        aws_byte_buf_init(&offer, ws_bootstrap->alloc, 128);
+        int err = aws_websocket_permessage_deflate_write_offer(&ws_bootstrap->permessage_deflate, &offer);
+        if (!err) {
+            err = aws_http_headers_add(
+                aws_http_message_get_headers(options->handshake_request),
+                aws_byte_cursor_from_c_str("Sec-WebSocket-Extensions"),
+                aws_byte_cursor_from_buf(&offer));
+        }
+        aws_byte_buf_clean_up(&offer);
+        if (err) {
+            goto error;
+        }
+    }
+
+    if (over_http2) {
+        if (s_ws_bootstrap_connect_over_http2(ws_bootstrap, options)) {
+            goto error;
+        }
+
+        AWS_LOGF_TRACE(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: Websocket setup begun, acquiring HTTP/2 stream for " PRInSTR,
+            (void *)ws_bootstrap,
+            AWS_BYTE_CURSOR_PRI(path));
+        return AWS_OP_SUCCESS;
+    }
+
     /* Initiate HTTP connection */
     struct aws_http_client_connection_options http_options = AWS_HTTP_CLIENT_CONNECTION_OPTIONS_INIT;
     http_options.allocator = ws_bootstrap->alloc;
@@ -198,7 +313,7 @@ int aws_websocket_client_connect(const struct aws_websocket_client_connection_op
     http_options.tls_options = options->tls_options;
     http_options.proxy_options = options->proxy_options;
 
-    if (options->manual_window_management) {
+    if (ws_bootstrap->manual_window_update) {
         http_options.manual_window_management = true;
 
         /* Give HTTP handler enough window to comfortably receive the handshake response.
@@ -258,6 +373,9 @@ static void s_ws_bootstrap_destroy(struct aws_websocket_client_bootstrap *ws_boo
     aws_byte_buf_clean_up(&ws_bootstrap->expected_sec_websocket_accept);
     aws_string_destroy(ws_bootstrap->expected_sec_websocket_protocols);
     aws_byte_buf_clean_up(&ws_bootstrap->response_body);
+    aws_byte_buf_clean_up(&ws_bootstrap->http2.pending_read_data);
+    aws_http2_stream_manager_release(ws_bootstrap->http2.stream_manager);
+    aws_websocket_read_budget_release(ws_bootstrap->shared_read_budget);
 
     aws_mem_release(ws_bootstrap->alloc, ws_bootstrap);
 }
@@ -653,6 +771,51 @@ static int s_ws_bootstrap_validate_sec_websocket_protocol(const struct aws_webso
     return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
 }
 
+static int s_ws_bootstrap_validate_sec_websocket_extensions(
+    const struct aws_websocket_client_bootstrap *ws_bootstrap,
+    struct aws_websocket_permessage_deflate_params *out_params,
+    bool *out_use_permessage_deflate) {
+
+    AWS_ZERO_STRUCT(*out_params);
+    *out_use_permessage_deflate = false;
+
+    /* If the server declined all extensions, there's no header */
+    struct aws_string *response_extensions = aws_http_headers_get_all(
+        ws_bootstrap->response_headers, aws_byte_cursor_from_c_str("Sec-WebSocket-Extensions"));
+    if (response_extensions == NULL) {
+        if (ws_bootstrap->offered_permessage_deflate) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_HTTP_WEBSOCKET_SETUP,
+                "id=%p: Server declined permessage-deflate, messages will not be compressed",
+                (void *)ws_bootstrap);
+        }
+        return AWS_OP_SUCCESS;
+    }
+
+    int err = AWS_OP_SUCCESS;
+    if (!ws_bootstrap->offered_permessage_deflate) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: Response has 'Sec-WebSocket-Extensions' header, but no extensions were requested.",
+            (void *)ws_bootstrap);
+        err = aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+    } else {
+        err = aws_websocket_permessage_deflate_parse_response(
+            &ws_bootstrap->permessage_deflate, aws_byte_cursor_from_string(response_extensions), out_params);
+        if (!err) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_HTTP_WEBSOCKET_SETUP,
+                "id=%p: Server accepted Sec-WebSocket-Extensions: %s",
+                (void *)ws_bootstrap,
+                aws_string_c_str(response_extensions));
+            *out_use_permessage_deflate = true;
+        }
+    }
+
+    aws_string_destroy(response_extensions);
+    return err;
+}
+
 /* OK, we've got all the headers for the 101 Switching Protocols response.
  * Validate the handshake response, install the websocket handler into the channel,
  * and invoke the on_connection_setup callback. */
@@ -698,13 +861,14 @@ static int s_ws_bootstrap_validate_response_and_install_websocket_handler(
         goto error;
     }
 
-    /* (step 5 is about validating Sec-WebSocket-Extensions, but we don't support extensions) */
-    if (aws_http_headers_has(ws_bootstrap->response_headers, aws_byte_cursor_from_c_str("Sec-WebSocket-Extensions"))) {
-        AWS_LOGF_ERROR(
-            AWS_LS_HTTP_WEBSOCKET_SETUP,
-            "id=%p: Response has 'Sec-WebSocket-Extensions' header, but client does not support extensions.",
-            (void *)ws_bootstrap);
-        aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+    /* 5.   If the response includes a |Sec-WebSocket-Extensions| header
+     *      field and this header field indicates the use of an extension
+     *      that was not present in the client's handshake (the server has
+     *      indicated an extension not requested by the client), the client
+     *      MUST _Fail the WebSocket Connection_. */
+    struct aws_websocket_permessage_deflate_params deflate_params;
+    bool use_permessage_deflate = false;
+    if (s_ws_bootstrap_validate_sec_websocket_extensions(ws_bootstrap, &deflate_params, &use_permessage_deflate)) {
         goto error;
     }
 
@@ -731,6 +895,15 @@ static int s_ws_bootstrap_validate_response_and_install_websocket_handler(
         .on_incoming_frame_complete = ws_bootstrap->websocket_frame_complete_callback,
         .is_server = false,
         .manual_window_update = ws_bootstrap->manual_window_update,
+        .permessage_deflate = use_permessage_deflate ? &ws_bootstrap->permessage_deflate : NULL,
+        .permessage_deflate_params = deflate_params,
+        .write_batch_target_size = ws_bootstrap->write_batch_target_size,
+        .write_batch_max_delay_ms = ws_bootstrap->write_batch_max_delay_ms,
+        .on_outgoing_frames_complete = ws_bootstrap->websocket_outgoing_frames_complete_callback,
+        .on_incoming_message = ws_bootstrap->websocket_message_callback,
+        .max_incoming_message_size = ws_bootstrap->max_incoming_message_size,
+        .read_budget = ws_bootstrap->read_budget,
+        .shared_read_budget = ws_bootstrap->shared_read_budget,
     };
 
     ws_bootstrap->websocket = s_system_vtable->aws_websocket_handler_new(&ws_options);
@@ -865,3 +1038,631 @@ static void s_ws_bootstrap_on_stream_complete(struct aws_http_stream *stream, in
     /* Done with stream, let it be cleaned up */
     s_system_vtable->aws_http_stream_release(stream);
 }
+
+/*****************************************************************************************************************
+ * Websocket over HTTP/2 (RFC-8441)
+ *
+ * The handshake is an extended CONNECT request on a stream from the user's stream manager,
+ * and a 200 response opens the websocket. The stream then carries websocket frames in its DATA frames.
+ *
+ * The websocket handler expects to sit in a channel, so it gets a lightweight channel of its own,
+ * on the HTTP/2 connection's event-loop. The leftmost handler in that channel is a bridge:
+ * it sends stream DATA to the right as read messages, and writes the websocket's write messages to the stream.
+ *
+ * The bootstrap is destroyed once the stream has completed, the channel is destroyed,
+ * and the stream is done with the data of every write message.
+ *****************************************************************************************************************/
+
+struct aws_websocket_http2_bridge {
+    struct aws_channel_handler handler;
+    struct aws_websocket_client_bootstrap *ws_bootstrap;
+};
+
+static void s_ws_bootstrap_on_http2_stream_acquired(struct aws_http_stream *stream, int error_code, void *user_data);
+static int s_ws_bootstrap_on_http2_response_header_block_done(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    void *user_data);
+static int s_ws_bootstrap_on_http2_response_body(
+    struct aws_http_stream *stream,
+    const struct aws_byte_cursor *data,
+    void *user_data);
+static void s_ws_bootstrap_on_http2_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data);
+
+/* Build the extended CONNECT request from the HTTP/1.1 handshake request.
+ * RFC-8441 Section 5: ":method" is "CONNECT", ":protocol" is "websocket",
+ * and the Sec-WebSocket-Key/Accept and Upgrade mechanisms are not used. */
+static struct aws_http_message *s_ws_bootstrap_new_extended_connect_request(
+    struct aws_allocator *alloc,
+    const struct aws_http_message *handshake_request) {
+
+    /* This already drops the connection-specific headers, like "Upgrade" and "Host" */
+    struct aws_http_message *request = aws_http2_message_new_from_http1(alloc, handshake_request);
+    if (!request) {
+        return NULL;
+    }
+
+    struct aws_http_headers *headers = aws_http_message_get_headers(request);
+    if (aws_http2_headers_set_request_method(headers, aws_http_method_connect) ||
+        aws_http_headers_set(headers, aws_http_header_protocol, aws_byte_cursor_from_c_str("websocket"))) {
+        aws_http_message_release(request);
+        return NULL;
+    }
+
+    const char *http1_only_headers[] = {"connection", "sec-websocket-key"};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(http1_only_headers); ++i) {
+        struct aws_byte_cursor name = aws_byte_cursor_from_c_str(http1_only_headers[i]);
+        if (aws_http_headers_has(headers, name)) {
+            aws_http_headers_erase(headers, name);
+        }
+    }
+
+    return request;
+}
+
+static int s_ws_bootstrap_connect_over_http2(
+    struct aws_websocket_client_bootstrap *ws_bootstrap,
+    const struct aws_websocket_client_connection_options *options) {
+
+    struct aws_http_message *request =
+        s_ws_bootstrap_new_extended_connect_request(ws_bootstrap->alloc, options->handshake_request);
+    if (!request) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: Failed to create extended CONNECT request, error %d (%s).",
+            (void *)ws_bootstrap,
+            aws_last_error(),
+            aws_error_name(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    ws_bootstrap->http2.stream_manager = aws_http2_stream_manager_acquire(options->http2_stream_manager);
+    aws_byte_buf_init(&ws_bootstrap->http2.pending_read_data, ws_bootstrap->alloc, 0);
+    aws_linked_list_init(&ws_bootstrap->http2.pending_writes);
+
+    struct aws_http_make_request_options request_options = {
+        .self_size = sizeof(request_options),
+        .request = request,
+        .user_data = ws_bootstrap,
+        .on_response_headers = s_ws_bootstrap_on_handshake_response_headers,
+        .on_response_header_block_done = s_ws_bootstrap_on_http2_response_header_block_done,
+        .on_response_body = s_ws_bootstrap_on_http2_response_body,
+        .on_complete = s_ws_bootstrap_on_http2_stream_complete,
+        .http2_use_manual_data_writes = true,
+    };
+
+    struct aws_http2_stream_manager_acquire_stream_options acquire_options = {
+        .callback = s_ws_bootstrap_on_http2_stream_acquired,
+        .user_data = ws_bootstrap,
+        .options = &request_options,
+    };
+
+    /* The stream manager keeps the request alive */
+    aws_http2_stream_manager_acquire_stream(ws_bootstrap->http2.stream_manager, &acquire_options);
+    aws_http_message_release(request);
+    return AWS_OP_SUCCESS;
+}
+
+/* Destroy the bootstrap once nothing refers to it anymore,
+ * reporting failed setup first if it never succeeded */
+static void s_ws_bootstrap_http2_try_finish(struct aws_websocket_client_bootstrap *ws_bootstrap) {
+    if (!ws_bootstrap->http2.is_stream_acquire_done || !ws_bootstrap->http2.is_stream_complete ||
+        ws_bootstrap->http2.channel != NULL || !aws_linked_list_empty(&ws_bootstrap->http2.pending_writes)) {
+        return;
+    }
+
+    if (ws_bootstrap->websocket_setup_callback) {
+        AWS_ASSERT(!ws_bootstrap->websocket);
+
+        int error_code = ws_bootstrap->setup_error_code;
+        if (!error_code) {
+            error_code = ws_bootstrap->http2.stream_error_code;
+        }
+        if (!error_code) {
+            error_code = AWS_ERROR_UNKNOWN;
+        }
+
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: Websocket setup failed, error %d (%s).",
+            (void *)ws_bootstrap,
+            error_code,
+            aws_error_name(error_code));
+
+        s_ws_bootstrap_invoke_setup_callback(ws_bootstrap, error_code);
+    }
+
+    s_system_vtable->aws_http_stream_release(ws_bootstrap->http2.stream);
+    s_ws_bootstrap_destroy(ws_bootstrap);
+}
+
+/* Send as much buffered stream DATA to the websocket as its read window allows */
+static void s_ws_bootstrap_http2_flush_read_data(struct aws_websocket_client_bootstrap *ws_bootstrap) {
+    struct aws_channel_slot *slot = ws_bootstrap->http2.slot;
+    if (!slot || !slot->adj_right || ws_bootstrap->http2.is_reading_stopped) {
+        return;
+    }
+
+    struct aws_byte_cursor pending = aws_byte_cursor_from_buf(&ws_bootstrap->http2.pending_read_data);
+    while (pending.len > 0) {
+        size_t window = aws_channel_slot_downstream_read_window(slot);
+        if (window == 0) {
+            break;
+        }
+
+        struct aws_io_message *msg = aws_channel_acquire_message_from_pool(
+            slot->channel, AWS_IO_MESSAGE_APPLICATION_DATA, aws_min_size(pending.len, window));
+        if (!msg) {
+            goto error;
+        }
+
+        size_t chunk_size = aws_min_size(aws_min_size(pending.len, window), msg->message_data.capacity);
+        struct aws_byte_cursor chunk = aws_byte_cursor_advance(&pending, chunk_size);
+        aws_byte_buf_write_from_whole_cursor(&msg->message_data, chunk);
+
+        if (aws_channel_slot_send_message(slot, msg, AWS_CHANNEL_DIR_READ)) {
+            aws_mem_release(msg->allocator, msg);
+            goto error;
+        }
+    }
+
+    /* Keep whatever the websocket can't take yet at the front of the buffer */
+    if (pending.len < ws_bootstrap->http2.pending_read_data.len) {
+        memmove(ws_bootstrap->http2.pending_read_data.buffer, pending.ptr, pending.len);
+        ws_bootstrap->http2.pending_read_data.len = pending.len;
+    }
+    return;
+
+error:
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_WEBSOCKET,
+        "id=%p: Failed to pass HTTP/2 stream data to websocket, error %d (%s).",
+        (void *)ws_bootstrap->websocket,
+        aws_last_error(),
+        aws_error_name(aws_last_error()));
+    aws_byte_buf_reset(&ws_bootstrap->http2.pending_read_data, false /*zero_contents*/);
+    aws_channel_shutdown(slot->channel, aws_last_error());
+}
+
+static int s_http2_bridge_process_read_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+
+    (void)handler;
+    (void)slot;
+    (void)message;
+    /* The bridge is the leftmost handler, nothing sends it read messages */
+    return aws_raise_error(AWS_ERROR_INVALID_STATE);
+}
+
+static void s_http2_bridge_on_write_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct aws_websocket_client_bootstrap *ws_bootstrap = user_data;
+
+    /* Writes complete in the order they were made */
+    AWS_FATAL_ASSERT(!aws_linked_list_empty(&ws_bootstrap->http2.pending_writes));
+    struct aws_linked_list_node *node = aws_linked_list_pop_front(&ws_bootstrap->http2.pending_writes);
+    struct aws_io_message *msg = AWS_CONTAINER_OF(node, struct aws_io_message, queueing_handle);
+
+    if (msg->on_completion) {
+        msg->on_completion(msg->owning_channel, msg, error_code, msg->user_data);
+    }
+    aws_mem_release(msg->allocator, msg);
+
+    s_ws_bootstrap_http2_try_finish(ws_bootstrap);
+}
+
+static int s_http2_bridge_process_write_message(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    struct aws_io_message *message) {
+
+    (void)slot;
+    struct aws_websocket_http2_bridge *bridge = handler->impl;
+    struct aws_websocket_client_bootstrap *ws_bootstrap = bridge->ws_bootstrap;
+
+    if (ws_bootstrap->http2.is_writing_stopped) {
+        return aws_raise_error(AWS_ERROR_HTTP_CONNECTION_CLOSED);
+    }
+
+    /* The message stays alive until the stream is done sending its data */
+    struct aws_http2_stream_write_data_options write = {
+        .zero_copy_data = aws_byte_cursor_from_buf(&message->message_data),
+        .on_complete = s_http2_bridge_on_write_complete,
+        .user_data = ws_bootstrap,
+    };
+    if (aws_http2_stream_write_data(ws_bootstrap->http2.stream, &write)) {
+        return AWS_OP_ERR;
+    }
+
+    aws_linked_list_push_back(&ws_bootstrap->http2.pending_writes, &message->queueing_handle);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_http2_bridge_increment_read_window(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    size_t size) {
+
+    (void)slot;
+    struct aws_websocket_http2_bridge *bridge = handler->impl;
+    struct aws_websocket_client_bootstrap *ws_bootstrap = bridge->ws_bootstrap;
+
+    if (!ws_bootstrap->http2.is_stream_complete) {
+        s_system_vtable->aws_http_stream_update_window(ws_bootstrap->http2.stream, size);
+    }
+
+    s_ws_bootstrap_http2_flush_read_data(ws_bootstrap);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_http2_bridge_shutdown(
+    struct aws_channel_handler *handler,
+    struct aws_channel_slot *slot,
+    enum aws_channel_direction dir,
+    int error_code,
+    bool free_scarce_resources_immediately) {
+
+    struct aws_websocket_http2_bridge *bridge = handler->impl;
+    struct aws_websocket_client_bootstrap *ws_bootstrap = bridge->ws_bootstrap;
+
+    if (dir == AWS_CHANNEL_DIR_READ) {
+        ws_bootstrap->http2.is_reading_stopped = true;
+    } else {
+        ws_bootstrap->http2.is_writing_stopped = true;
+
+        /* The websocket is going away, so it mustn't hear about writes that are still in flight */
+        for (struct aws_linked_list_node *node = aws_linked_list_begin(&ws_bootstrap->http2.pending_writes);
+             node != aws_linked_list_end(&ws_bootstrap->http2.pending_writes);
+             node = aws_linked_list_next(node)) {
+
+            struct aws_io_message *msg = AWS_CONTAINER_OF(node, struct aws_io_message, queueing_handle);
+            if (msg->on_completion) {
+                msg->on_completion(msg->owning_channel, msg, AWS_ERROR_HTTP_CONNECTION_CLOSED, msg->user_data);
+                msg->on_completion = NULL;
+            }
+        }
+
+        /* After a clean close, end our side of the stream, and let the server end its side.
+         * Otherwise, reset the stream. */
+        if (!ws_bootstrap->http2.is_stream_complete) {
+            if (error_code || free_scarce_resources_immediately) {
+                aws_http2_stream_reset(ws_bootstrap->http2.stream, AWS_HTTP2_ERR_CANCEL);
+            } else {
+                struct aws_http2_stream_write_data_options end_stream = {.end_stream = true};
+                aws_http2_stream_write_data(ws_bootstrap->http2.stream, &end_stream);
+            }
+        }
+    }
+
+    return aws_channel_slot_on_handler_shutdown_complete(slot, dir, error_code, free_scarce_resources_immediately);
+}
+
+static size_t s_http2_bridge_initial_window_size(struct aws_channel_handler *handler) {
+    (void)handler;
+    /* Nothing sits to the left of the bridge */
+    return SIZE_MAX;
+}
+
+static size_t s_http2_bridge_message_overhead(struct aws_channel_handler *handler) {
+    (void)handler;
+    return 0;
+}
+
+static void s_http2_bridge_destroy(struct aws_channel_handler *handler) {
+    /* The bridge is destroyed along with the channel, which may outlive the bootstrap */
+    struct aws_websocket_http2_bridge *bridge = handler->impl;
+    aws_mem_release(handler->alloc, bridge);
+}
+
+static struct aws_channel_handler_vtable s_http2_bridge_vtable = {
+    .process_read_message = s_http2_bridge_process_read_message,
+    .process_write_message = s_http2_bridge_process_write_message,
+    .increment_read_window = s_http2_bridge_increment_read_window,
+    .shutdown = s_http2_bridge_shutdown,
+    .initial_window_size = s_http2_bridge_initial_window_size,
+    .message_overhead = s_http2_bridge_message_overhead,
+    .destroy = s_http2_bridge_destroy,
+};
+
+static int s_ws_bootstrap_http2_install_websocket(struct aws_websocket_client_bootstrap *ws_bootstrap) {
+    struct aws_channel *channel = ws_bootstrap->http2.channel;
+
+    struct aws_channel_slot *slot = aws_channel_slot_new(channel);
+    if (!slot) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_websocket_http2_bridge *bridge =
+        aws_mem_calloc(ws_bootstrap->alloc, 1, sizeof(struct aws_websocket_http2_bridge));
+    bridge->ws_bootstrap = ws_bootstrap;
+    bridge->handler.vtable = &s_http2_bridge_vtable;
+    bridge->handler.alloc = ws_bootstrap->alloc;
+    bridge->handler.impl = bridge;
+
+    if (aws_channel_slot_set_handler(slot, &bridge->handler)) {
+        aws_mem_release(ws_bootstrap->alloc, bridge);
+        return AWS_OP_ERR;
+    }
+    ws_bootstrap->http2.slot = slot;
+
+    struct aws_websocket_handler_options ws_options = {
+        .allocator = ws_bootstrap->alloc,
+        .channel = channel,
+        .initial_window_size = ws_bootstrap->initial_window_size,
+        .user_data = ws_bootstrap->user_data,
+        .on_incoming_frame_begin = ws_bootstrap->websocket_frame_begin_callback,
+        .on_incoming_frame_payload = ws_bootstrap->websocket_frame_payload_callback,
+        .on_incoming_frame_complete = ws_bootstrap->websocket_frame_complete_callback,
+        .is_server = false,
+        .manual_window_update = ws_bootstrap->manual_window_update,
+        .permessage_deflate = ws_bootstrap->http2.use_permessage_deflate ? &ws_bootstrap->permessage_deflate : NULL,
+        .permessage_deflate_params = ws_bootstrap->http2.deflate_params,
+        .write_batch_target_size = ws_bootstrap->write_batch_target_size,
+        .write_batch_max_delay_ms = ws_bootstrap->write_batch_max_delay_ms,
+        .on_outgoing_frames_complete = ws_bootstrap->websocket_outgoing_frames_complete_callback,
+        .on_incoming_message = ws_bootstrap->websocket_message_callback,
+        .max_incoming_message_size = ws_bootstrap->max_incoming_message_size,
+        .read_budget = ws_bootstrap->read_budget,
+        .shared_read_budget = ws_bootstrap->shared_read_budget,
+    };
+
+    ws_bootstrap->websocket = s_system_vtable->aws_websocket_handler_new(&ws_options);
+    if (!ws_bootstrap->websocket) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Invoked when the websocket's own channel is ready (or failed to set up) */
+static void s_ws_bootstrap_on_http2_channel_setup(struct aws_channel *channel, int error_code, void *user_data) {
+    struct aws_websocket_client_bootstrap *ws_bootstrap = user_data;
+
+    if (error_code) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: Failed to set up websocket channel, error %d (%s).",
+            (void *)ws_bootstrap,
+            error_code,
+            aws_error_name(error_code));
+
+        aws_channel_destroy(channel);
+        ws_bootstrap->http2.channel = NULL;
+        ws_bootstrap->setup_error_code = error_code;
+        if (!ws_bootstrap->http2.is_stream_complete) {
+            aws_http2_stream_reset(ws_bootstrap->http2.stream, AWS_HTTP2_ERR_INTERNAL_ERROR);
+        }
+        s_ws_bootstrap_http2_try_finish(ws_bootstrap);
+        return;
+    }
+
+    if (ws_bootstrap->http2.is_stream_complete) {
+        /* The stream ended while the channel was setting up */
+        error_code = ws_bootstrap->http2.stream_error_code ? ws_bootstrap->http2.stream_error_code
+                                                           : AWS_ERROR_HTTP_CONNECTION_CLOSED;
+        goto error;
+    }
+
+    if (s_ws_bootstrap_http2_install_websocket(ws_bootstrap)) {
+        error_code = aws_last_error();
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: Failed to create websocket handler, error %d (%s)",
+            (void *)ws_bootstrap,
+            error_code,
+            aws_error_name(error_code));
+        goto error;
+    }
+
+    /* Success! Setup complete! */
+    AWS_LOGF_TRACE(
+        AWS_LS_HTTP_WEBSOCKET_SETUP,
+        "id=%p: Setup success, created websocket=%p over HTTP/2 stream=%p",
+        (void *)ws_bootstrap,
+        (void *)ws_bootstrap->websocket,
+        (void *)ws_bootstrap->http2.stream);
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_HTTP_WEBSOCKET, "id=%p: Websocket client connection established.", (void *)ws_bootstrap->websocket);
+
+    s_ws_bootstrap_invoke_setup_callback(ws_bootstrap, 0 /*error_code*/);
+
+    /* Pass along any DATA that arrived while the channel was setting up */
+    s_ws_bootstrap_http2_flush_read_data(ws_bootstrap);
+    return;
+
+error:
+    /* Setup failure is reported once the channel has shut down and the stream has completed */
+    ws_bootstrap->setup_error_code = error_code;
+    aws_channel_shutdown(channel, error_code);
+}
+
+/* Invoked when the websocket's own channel has finished shutting down */
+static void s_ws_bootstrap_on_http2_channel_shutdown(struct aws_channel *channel, int error_code, void *user_data) {
+    struct aws_websocket_client_bootstrap *ws_bootstrap = user_data;
+
+    if (!ws_bootstrap->websocket_setup_callback && ws_bootstrap->websocket_shutdown_callback) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_WEBSOCKET,
+            "id=%p: Websocket client connection shut down with error %d (%s).",
+            (void *)ws_bootstrap->websocket,
+            error_code,
+            aws_error_name(error_code));
+
+        ws_bootstrap->websocket_shutdown_callback(ws_bootstrap->websocket, error_code, ws_bootstrap->user_data);
+    }
+
+    /* It's still up to the user to release the websocket itself */
+    aws_channel_destroy(channel);
+    ws_bootstrap->http2.channel = NULL;
+    ws_bootstrap->http2.slot = NULL;
+
+    s_ws_bootstrap_http2_try_finish(ws_bootstrap);
+}
+
+/* RFC-8441 Section 5: a 2xx response means the websocket is open.
+ * HTTP/2 has no Upgrade, Connection, or Sec-WebSocket-Accept headers to check,
+ * but the extensions and subprotocol are validated as in RFC-6455 Section 4.1 */
+static int s_ws_bootstrap_validate_http2_response_and_create_channel(
+    struct aws_websocket_client_bootstrap *ws_bootstrap,
+    struct aws_http_stream *stream) {
+
+    if (s_ws_bootstrap_validate_sec_websocket_extensions(
+            ws_bootstrap, &ws_bootstrap->http2.deflate_params, &ws_bootstrap->http2.use_permessage_deflate)) {
+        goto error;
+    }
+
+    if (s_ws_bootstrap_validate_sec_websocket_protocol(ws_bootstrap)) {
+        goto error;
+    }
+
+    struct aws_http_connection *http_connection = s_system_vtable->aws_http_stream_get_connection(stream);
+    struct aws_channel *http_channel = s_system_vtable->aws_http_connection_get_channel(http_connection);
+
+    struct aws_channel_options channel_options = {
+        .event_loop = aws_channel_get_event_loop(http_channel),
+        .on_setup_completed = s_ws_bootstrap_on_http2_channel_setup,
+        .setup_user_data = ws_bootstrap,
+        .on_shutdown_completed = s_ws_bootstrap_on_http2_channel_shutdown,
+        .shutdown_user_data = ws_bootstrap,
+        .enable_read_back_pressure = ws_bootstrap->manual_window_update,
+    };
+
+    ws_bootstrap->http2.channel = aws_channel_new(ws_bootstrap->alloc, &channel_options);
+    if (!ws_bootstrap->http2.channel) {
+        goto error;
+    }
+
+    ws_bootstrap->http2.got_success_response = true;
+    return AWS_OP_SUCCESS;
+
+error:
+    AWS_LOGF_ERROR(
+        AWS_LS_HTTP_WEBSOCKET_SETUP,
+        "id=%p: Canceling websocket setup due to error %d (%s).",
+        (void *)ws_bootstrap,
+        aws_last_error(),
+        aws_error_name(aws_last_error()));
+
+    ws_bootstrap->setup_error_code = aws_last_error();
+    /* Returning error resets the stream */
+    return AWS_OP_ERR;
+}
+
+static void s_ws_bootstrap_on_http2_stream_acquired(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct aws_websocket_client_bootstrap *ws_bootstrap = user_data;
+
+    ws_bootstrap->http2.is_stream_acquire_done = true;
+
+    if (error_code) {
+        /* None of the stream callbacks will be invoked */
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: Websocket setup failed to acquire HTTP/2 stream, error %d (%s).",
+            (void *)ws_bootstrap,
+            error_code,
+            aws_error_name(error_code));
+
+        ws_bootstrap->http2.is_stream_complete = true;
+        ws_bootstrap->http2.stream_error_code = error_code;
+    } else {
+        AWS_LOGF_TRACE(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: HTTP/2 stream=%p acquired, sending extended CONNECT request.",
+            (void *)ws_bootstrap,
+            (void *)stream);
+
+        ws_bootstrap->http2.stream = stream;
+    }
+
+    s_ws_bootstrap_http2_try_finish(ws_bootstrap);
+}
+
+static int s_ws_bootstrap_on_http2_response_header_block_done(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    void *user_data) {
+
+    struct aws_websocket_client_bootstrap *ws_bootstrap = user_data;
+
+    if (ws_bootstrap->http2.got_success_response) {
+        /* Trailing headers at the end of a websocket, nothing to do with setup */
+        return AWS_OP_SUCCESS;
+    }
+
+    s_system_vtable->aws_http_stream_get_incoming_response_status(stream, &ws_bootstrap->response_status);
+    ws_bootstrap->got_full_response_headers = true;
+
+    if (header_block == AWS_HTTP_HEADER_BLOCK_INFORMATIONAL) {
+        /* Another response should come eventually. Just ignore the headers from this one... */
+        AWS_LOGF_DEBUG(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=%p: Server sent interim response with status code %d",
+            (void *)ws_bootstrap,
+            ws_bootstrap->response_status);
+
+        aws_http_headers_clear(ws_bootstrap->response_headers);
+        ws_bootstrap->got_full_response_headers = false;
+        return AWS_OP_SUCCESS;
+    }
+
+    if (header_block == AWS_HTTP_HEADER_BLOCK_MAIN && ws_bootstrap->response_status == AWS_HTTP_STATUS_CODE_200_OK) {
+        return s_ws_bootstrap_validate_http2_response_and_create_channel(ws_bootstrap, stream);
+    }
+
+    /* The handshake did not succeed. Keep the stream going.
+     * We'll report failed setup to the user after we've received the complete response */
+    if (!ws_bootstrap->setup_error_code) {
+        ws_bootstrap->setup_error_code = AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_ws_bootstrap_on_http2_response_body(
+    struct aws_http_stream *stream,
+    const struct aws_byte_cursor *data,
+    void *user_data) {
+
+    struct aws_websocket_client_bootstrap *ws_bootstrap = user_data;
+
+    if (!ws_bootstrap->http2.got_success_response) {
+        /* Body of a failed response */
+        return s_ws_bootstrap_on_handshake_response_body(stream, data, user_data);
+    }
+
+    if (ws_bootstrap->http2.channel == NULL || ws_bootstrap->http2.is_reading_stopped) {
+        /* The websocket is gone, drop the data */
+        return AWS_OP_SUCCESS;
+    }
+
+    /* Websocket frames. Buffer them until the websocket is installed and has the window for them */
+    if (aws_byte_buf_append_dynamic(&ws_bootstrap->http2.pending_read_data, data)) {
+        return AWS_OP_ERR;
+    }
+
+    s_ws_bootstrap_http2_flush_read_data(ws_bootstrap);
+    return AWS_OP_SUCCESS;
+}
+
+static void s_ws_bootstrap_on_http2_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct aws_websocket_client_bootstrap *ws_bootstrap = user_data;
+
+    /* Only report the body if we received a complete response */
+    if (error_code == 0) {
+        ws_bootstrap->got_full_response_body = true;
+    }
+
+    ws_bootstrap->http2.is_stream_complete = true;
+    ws_bootstrap->http2.stream_error_code = error_code;
+
+    /* The websocket can't outlive its stream */
+    if (ws_bootstrap->http2.channel) {
+        aws_channel_shutdown(
+            ws_bootstrap->http2.channel, error_code ? error_code : AWS_ERROR_HTTP_CONNECTION_CLOSED);
+    }
+
+    s_ws_bootstrap_http2_try_finish(ws_bootstrap);
+}
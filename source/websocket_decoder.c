@@ -5,10 +5,15 @@
 
 #include <aws/http/private/websocket_decoder.h>
 
+#include <aws/http/private/websocket_deflate.h>
+
 #include <aws/common/encoding.h>
 
 #include <inttypes.h>
 
+/* Size of buffer that decompressed payload is written to, before it's passed along */
+#define DECOMPRESSED_BUF_SIZE (16 * 1024)
+
 typedef int(state_fn)(struct aws_websocket_decoder *decoder, struct aws_byte_cursor *data);
 
 /* STATE_INIT: Resets things, consumes no data */
@@ -88,6 +93,23 @@ static int s_state_opcode_byte(struct aws_websocket_decoder *decoder, struct aws
         }
     }
 
+    /* RFC-7692 Section 6: With permessage-deflate, the RSV1 bit marks the first frame of a compressed message.
+     * It must be clear on CONTINUATION frames and control frames. */
+    if (decoder->decompressor && decoder->current_frame.rsv[0]) {
+        if (decoder->current_frame.opcode != AWS_WEBSOCKET_OPCODE_TEXT &&
+            decoder->current_frame.opcode != AWS_WEBSOCKET_OPCODE_BINARY) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET,
+                "id=%p: Received RSV1 bit on frame with opcode 0x%" PRIx8 ", only the first frame of a message may "
+                "be marked compressed",
+                (void *)decoder->user_data,
+                decoder->current_frame.opcode);
+            return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_PROTOCOL_ERROR);
+        }
+
+        decoder->processing_compressed_message = true;
+    }
+
     if (decoder->current_frame.opcode == AWS_WEBSOCKET_OPCODE_TEXT) {
         decoder->processing_text_message = true;
     }
@@ -246,6 +268,56 @@ static int s_state_payload_check(struct aws_websocket_decoder *decoder, struct a
     return AWS_OP_SUCCESS;
 }
 
+/* Validate payload data, after any unmasking and decompression, and pass it along via on_payload() */
+static int s_deliver_payload(struct aws_websocket_decoder *decoder, struct aws_byte_cursor payload) {
+    /* Validate the UTF-8 for TEXT messages (a TEXT frame and any subsequent CONTINUATION frames) */
+    if (decoder->processing_text_message && aws_websocket_is_data_frame(decoder->current_frame.opcode)) {
+        if (aws_websocket_utf8_validator_update(&decoder->text_message_validator, payload)) {
+            AWS_LOGF_ERROR(AWS_LS_HTTP_WEBSOCKET, "id=%p: Received invalid UTF-8", (void *)decoder->user_data);
+            return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_PROTOCOL_ERROR);
+        }
+    }
+
+    /* Invoke on_payload() callback to inform user of payload data */
+    return decoder->on_payload(payload, decoder->user_data);
+}
+
+/* Run compressed payload through the decompressor, passing along output each time the buffer fills */
+static int s_decompress_payload(struct aws_websocket_decoder *decoder, struct aws_byte_cursor input) {
+    while (true) {
+        const size_t prev_input_len = input.len;
+        aws_byte_buf_reset(&decoder->decompressed_buf, false /*zero_contents*/);
+
+        if (decoder->decompressor->vtable->decompress(decoder->decompressor, &input, &decoder->decompressed_buf)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET,
+                "id=%p: Failed to decompress payload, error %d (%s)",
+                (void *)decoder->user_data,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_PROTOCOL_ERROR);
+        }
+
+        const size_t output_len = decoder->decompressed_buf.len;
+        if (output_len > 0) {
+            if (s_deliver_payload(decoder, aws_byte_cursor_from_buf(&decoder->decompressed_buf))) {
+                return AWS_OP_ERR;
+            }
+        }
+
+        /* Done once the input is used up and the decompressor has room to spare (it's holding no more output) */
+        if (input.len == 0 && output_len < decoder->decompressed_buf.capacity) {
+            return AWS_OP_SUCCESS;
+        }
+
+        if (input.len == prev_input_len && output_len == 0) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET, "id=%p: Decompressor is making no progress", (void *)decoder->user_data);
+            return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_PROTOCOL_ERROR);
+        }
+    }
+}
+
 /* PAYLOAD: Decode payload until we're done (state skipped if no payload). */
 static int s_state_payload(struct aws_websocket_decoder *decoder, struct aws_byte_cursor *data) {
     if (data->len == 0) {
@@ -262,28 +334,17 @@ static int s_state_payload(struct aws_websocket_decoder *decoder, struct aws_byt
      * RFC-6455 Section 5.3 Client-to-Server Masking
      * Each byte of payload is XOR against a byte of the masking-key */
     if (decoder->current_frame.masked) {
-        uint64_t mask_index = decoder->state_bytes_processed;
-
-        /* Optimization idea: don't do this 1 byte at a time */
-        uint8_t *current_byte = payload.ptr;
-        uint8_t *end_byte = payload.ptr + payload.len;
-        while (current_byte != end_byte) {
-            *current_byte++ ^= decoder->current_frame.masking_key[mask_index++ % 4];
-        }
+        aws_websocket_mask_payload(payload, decoder->current_frame.masking_key, decoder->state_bytes_processed);
     }
 
     /* TODO: validate payload of CLOSE frame */
 
-    /* Validate the UTF-8 for TEXT messages (a TEXT frame and any subsequent CONTINUATION frames) */
-    if (decoder->processing_text_message && aws_websocket_is_data_frame(decoder->current_frame.opcode)) {
-        if (aws_utf8_decoder_update(decoder->text_message_validator, payload)) {
-            AWS_LOGF_ERROR(AWS_LS_HTTP_WEBSOCKET, "id=%p: Received invalid UTF-8", (void *)decoder->user_data);
-            return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_PROTOCOL_ERROR);
-        }
+    int err;
+    if (decoder->processing_compressed_message && aws_websocket_is_data_frame(decoder->current_frame.opcode)) {
+        err = s_decompress_payload(decoder, payload);
+    } else {
+        err = s_deliver_payload(decoder, payload);
     }
-
-    /* Invoke on_payload() callback to inform user of payload data */
-    int err = decoder->on_payload(payload, decoder->user_data);
     if (err) {
         return AWS_OP_ERR;
     }
@@ -303,12 +364,36 @@ static int s_state_payload(struct aws_websocket_decoder *decoder, struct aws_byt
 static int s_state_frame_end(struct aws_websocket_decoder *decoder, struct aws_byte_cursor *data) {
     (void)data;
 
+    /* If we're done processing a compressed message, feed the decompressor the bytes that
+     * the sender removed from the end of the message (RFC-7692 Section 7.2.2) */
+    if (decoder->processing_compressed_message && aws_websocket_is_data_frame(decoder->current_frame.opcode) &&
+        decoder->current_frame.fin) {
+
+        struct aws_byte_cursor tail =
+            aws_byte_cursor_from_array(aws_websocket_deflate_tail, sizeof(aws_websocket_deflate_tail));
+        if (s_decompress_payload(decoder, tail)) {
+            return AWS_OP_ERR;
+        }
+
+        if (decoder->reset_decompressor_after_message && decoder->decompressor->vtable->reset(decoder->decompressor)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET,
+                "id=%p: Failed to reset decompressor, error %d (%s)",
+                (void *)decoder->user_data,
+                aws_last_error(),
+                aws_error_name(aws_last_error()));
+            return AWS_OP_ERR;
+        }
+
+        decoder->processing_compressed_message = false;
+    }
+
     /* If we're done processing a text message (a TEXT frame and any subsequent CONTINUATION frames),
      * complete the UTF-8 validation */
     if (decoder->processing_text_message && aws_websocket_is_data_frame(decoder->current_frame.opcode) &&
         decoder->current_frame.fin) {
 
-        if (aws_utf8_decoder_finalize(decoder->text_message_validator)) {
+        if (aws_websocket_utf8_validator_finalize(&decoder->text_message_validator)) {
             AWS_LOGF_ERROR(
                 AWS_LS_HTTP_WEBSOCKET,
                 "id=%p: Received invalid UTF-8 (incomplete encoding)",
@@ -375,13 +460,26 @@ void aws_websocket_decoder_init(
     void *user_data) {
 
     AWS_ZERO_STRUCT(*decoder);
+    decoder->alloc = alloc;
     decoder->user_data = user_data;
     decoder->on_frame = on_frame;
     decoder->on_payload = on_payload;
-    decoder->text_message_validator = aws_utf8_decoder_new(alloc, NULL /*options*/);
 }
 
 void aws_websocket_decoder_clean_up(struct aws_websocket_decoder *decoder) {
-    aws_utf8_decoder_destroy(decoder->text_message_validator);
+    aws_byte_buf_clean_up(&decoder->decompressed_buf);
     AWS_ZERO_STRUCT(*decoder);
 }
+
+void aws_websocket_decoder_set_decompressor(
+    struct aws_websocket_decoder *decoder,
+    struct aws_websocket_decompressor *decompressor,
+    bool reset_after_message) {
+
+    AWS_PRECONDITION(decompressor);
+    AWS_PRECONDITION(!decoder->decompressor);
+
+    decoder->decompressor = decompressor;
+    decoder->reset_decompressor_after_message = reset_after_message;
+    aws_byte_buf_init(&decoder->decompressed_buf, decoder->alloc, DECOMPRESSED_BUF_SIZE);
+}
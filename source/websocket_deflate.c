@@ -0,0 +1,331 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/websocket_deflate.h>
+
+#include <aws/common/logging.h>
+#include <aws/http/private/strutil.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4204) /* non-constant aggregate initializer */
+#endif
+
+const uint8_t aws_websocket_deflate_tail[AWS_WEBSOCKET_DEFLATE_TAIL_LENGTH] = {0x00, 0x00, 0xFF, 0xFF};
+
+/* One permessage-deflate element from a Sec-WebSocket-Extensions header */
+struct deflate_element {
+    struct aws_websocket_permessage_deflate_params params;
+
+    /* "client_max_window_bits" appeared, possibly without a value */
+    bool has_client_max_window_bits;
+};
+
+/* RFC-7692 Section 7.1.2: window bits are a decimal integer from 8 to 15, possibly in a quoted-string */
+static bool s_parse_window_bits(struct aws_byte_cursor value, uint8_t *out_bits) {
+    if (value.len >= 2 && value.ptr[0] == '"' && value.ptr[value.len - 1] == '"') {
+        aws_byte_cursor_advance(&value, 1);
+        value.len--;
+    }
+
+    uint64_t bits;
+    if (value.len == 0 || value.ptr[0] == '0' || aws_byte_cursor_utf8_parse_u64(value, &bits)) {
+        return false;
+    }
+
+    if (bits < 8 || bits > 15) {
+        return false;
+    }
+
+    *out_bits = (uint8_t)bits;
+    return true;
+}
+
+/* Parse one comma-separated element of a Sec-WebSocket-Extensions value.
+ * Returns false if the element isn't permessage-deflate.
+ * Otherwise, `out_valid` is set false if its parameters are malformed, unknown, or repeated (RFC-7692 Section 5) */
+static bool s_parse_deflate_element(struct aws_byte_cursor element, struct deflate_element *out, bool *out_valid) {
+    AWS_ZERO_STRUCT(*out);
+    *out_valid = false;
+
+    struct aws_byte_cursor part;
+    AWS_ZERO_STRUCT(part);
+    if (!aws_byte_cursor_next_split(&element, ';', &part)) {
+        return false;
+    }
+
+    struct aws_byte_cursor extension_name = aws_strutil_trim_http_whitespace(part);
+    if (!aws_byte_cursor_eq_c_str_ignore_case(&extension_name, "permessage-deflate")) {
+        return false;
+    }
+
+    while (aws_byte_cursor_next_split(&element, ';', &part)) {
+        struct aws_byte_cursor param = aws_strutil_trim_http_whitespace(part);
+        struct aws_byte_cursor name = param;
+        struct aws_byte_cursor value;
+        AWS_ZERO_STRUCT(value);
+        bool has_value = false;
+
+        uint8_t *equals = memchr(param.ptr, '=', param.len);
+        if (equals) {
+            name = aws_strutil_trim_http_whitespace(aws_byte_cursor_advance(&param, (size_t)(equals - param.ptr)));
+            aws_byte_cursor_advance(&param, 1);
+            value = aws_strutil_trim_http_whitespace(param);
+            has_value = true;
+        }
+
+        if (aws_byte_cursor_eq_c_str_ignore_case(&name, "server_no_context_takeover")) {
+            if (has_value || out->params.server_no_context_takeover) {
+                return true;
+            }
+            out->params.server_no_context_takeover = true;
+
+        } else if (aws_byte_cursor_eq_c_str_ignore_case(&name, "client_no_context_takeover")) {
+            if (has_value || out->params.client_no_context_takeover) {
+                return true;
+            }
+            out->params.client_no_context_takeover = true;
+
+        } else if (aws_byte_cursor_eq_c_str_ignore_case(&name, "server_max_window_bits")) {
+            if (!has_value || out->params.server_max_window_bits ||
+                !s_parse_window_bits(value, &out->params.server_max_window_bits)) {
+                return true;
+            }
+
+        } else if (aws_byte_cursor_eq_c_str_ignore_case(&name, "client_max_window_bits")) {
+            if (out->has_client_max_window_bits) {
+                return true;
+            }
+            if (has_value && !s_parse_window_bits(value, &out->params.client_max_window_bits)) {
+                return true;
+            }
+            out->has_client_max_window_bits = true;
+
+        } else {
+            return true;
+        }
+    }
+
+    *out_valid = true;
+    return true;
+}
+
+static int s_append_c_str(struct aws_byte_buf *dst, const char *str) {
+    struct aws_byte_cursor cursor = aws_byte_cursor_from_c_str(str);
+    return aws_byte_buf_append_dynamic(dst, &cursor);
+}
+
+static int s_append_window_bits(struct aws_byte_buf *dst, const char *name, uint8_t bits) {
+    char param[32];
+    snprintf(param, sizeof(param), "; %s=%" PRIu8, name, bits);
+    return s_append_c_str(dst, param);
+}
+
+static uint8_t s_min_window_bits(uint8_t a, uint8_t b) {
+    /* 0 means "no limit" */
+    if (a == 0) {
+        return b;
+    }
+    if (b == 0) {
+        return a;
+    }
+    return a < b ? a : b;
+}
+
+int aws_websocket_permessage_deflate_write_offer(
+    const struct aws_websocket_permessage_deflate_options *options,
+    struct aws_byte_buf *out_value) {
+
+    if (s_append_c_str(out_value, "permessage-deflate")) {
+        return AWS_OP_ERR;
+    }
+
+    if (options->server_no_context_takeover && s_append_c_str(out_value, "; server_no_context_takeover")) {
+        return AWS_OP_ERR;
+    }
+
+    if (options->client_no_context_takeover && s_append_c_str(out_value, "; client_no_context_takeover")) {
+        return AWS_OP_ERR;
+    }
+
+    if (options->server_max_window_bits &&
+        s_append_window_bits(out_value, "server_max_window_bits", options->server_max_window_bits)) {
+        return AWS_OP_ERR;
+    }
+
+    /* Always advertise client_max_window_bits, the compressor can be created with any window size */
+    if (options->client_max_window_bits) {
+        if (s_append_window_bits(out_value, "client_max_window_bits", options->client_max_window_bits)) {
+            return AWS_OP_ERR;
+        }
+    } else if (s_append_c_str(out_value, "; client_max_window_bits")) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_websocket_permessage_deflate_parse_response(
+    const struct aws_websocket_permessage_deflate_options *offer,
+    struct aws_byte_cursor response_value,
+    struct aws_websocket_permessage_deflate_params *out_params) {
+
+    AWS_ZERO_STRUCT(*out_params);
+
+    /* We only offered one extension, so the server can only have accepted that one */
+    struct aws_byte_cursor element;
+    AWS_ZERO_STRUCT(element);
+    size_t num_elements = 0;
+    struct deflate_element accepted;
+    AWS_ZERO_STRUCT(accepted);
+    while (aws_byte_cursor_next_split(&response_value, ',', &element)) {
+        if (++num_elements > 1) {
+            AWS_LOGF_ERROR(AWS_LS_HTTP_WEBSOCKET_SETUP, "id=static: Server accepted more than one extension");
+            return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+        }
+
+        bool valid;
+        if (!s_parse_deflate_element(element, &accepted, &valid)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET_SETUP,
+                "id=static: Server accepted extension '" PRInSTR "', which was not offered",
+                AWS_BYTE_CURSOR_PRI(element));
+            return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+        }
+
+        if (!valid) {
+            AWS_LOGF_ERROR(
+                AWS_LS_HTTP_WEBSOCKET_SETUP,
+                "id=static: Server's permessage-deflate parameters are invalid: '" PRInSTR "'",
+                AWS_BYTE_CURSOR_PRI(element));
+            return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+        }
+    }
+
+    if (num_elements == 0) {
+        AWS_LOGF_ERROR(AWS_LS_HTTP_WEBSOCKET_SETUP, "id=static: Server's Sec-WebSocket-Extensions header is empty");
+        return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+    }
+
+    /* RFC-7692 Section 7.1.1.1: the server accepts server_no_context_takeover by echoing it */
+    if (offer->server_no_context_takeover && !accepted.params.server_no_context_takeover) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=static: Server did not agree to permessage-deflate server_no_context_takeover");
+        return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+    }
+
+    /* RFC-7692 Section 7.1.2.1: the server accepts server_max_window_bits with the same or a smaller value */
+    if (offer->server_max_window_bits &&
+        (accepted.params.server_max_window_bits == 0 ||
+         accepted.params.server_max_window_bits > offer->server_max_window_bits)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP,
+            "id=static: Server did not agree to permessage-deflate server_max_window_bits");
+        return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+    }
+
+    /* RFC-7692 Section 7.1.2.2: the server may only limit our window to be smaller */
+    if (accepted.has_client_max_window_bits && accepted.params.client_max_window_bits == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_HTTP_WEBSOCKET_SETUP, "id=static: Server's permessage-deflate client_max_window_bits has no value");
+        return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_UPGRADE_FAILURE);
+    }
+
+    out_params->server_no_context_takeover = accepted.params.server_no_context_takeover;
+    out_params->client_no_context_takeover =
+        offer->client_no_context_takeover || accepted.params.client_no_context_takeover;
+    out_params->server_max_window_bits = accepted.params.server_max_window_bits;
+    out_params->client_max_window_bits =
+        s_min_window_bits(offer->client_max_window_bits, accepted.params.client_max_window_bits);
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_websocket_permessage_deflate_negotiate(
+    const struct aws_websocket_permessage_deflate_options *options,
+    struct aws_byte_cursor sec_websocket_extensions,
+    struct aws_websocket_permessage_deflate_params *out_params,
+    struct aws_byte_buf *out_response_value,
+    bool *out_accepted) {
+
+    AWS_PRECONDITION(options);
+    AWS_PRECONDITION(out_params);
+    AWS_PRECONDITION(out_response_value);
+    AWS_PRECONDITION(out_accepted);
+
+    AWS_ZERO_STRUCT(*out_params);
+    *out_accepted = false;
+
+    /* The client lists its offers in order of preference. Accept the first one we can. */
+    struct aws_byte_cursor element;
+    AWS_ZERO_STRUCT(element);
+    while (aws_byte_cursor_next_split(&sec_websocket_extensions, ',', &element)) {
+        struct deflate_element offer;
+        bool valid;
+        if (!s_parse_deflate_element(element, &offer, &valid)) {
+            continue;
+        }
+
+        if (!valid) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_HTTP_WEBSOCKET_SETUP,
+                "id=static: Declining malformed permessage-deflate offer: '" PRInSTR "'",
+                AWS_BYTE_CURSOR_PRI(element));
+            continue;
+        }
+
+        /* We can only limit the client's window if the client says it supports that */
+        if (options->client_max_window_bits && !offer.has_client_max_window_bits) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_HTTP_WEBSOCKET_SETUP,
+                "id=static: Declining permessage-deflate offer without client_max_window_bits support");
+            continue;
+        }
+
+        struct aws_websocket_permessage_deflate_params params = {
+            .server_no_context_takeover =
+                offer.params.server_no_context_takeover || options->server_no_context_takeover,
+            .client_no_context_takeover =
+                offer.params.client_no_context_takeover || options->client_no_context_takeover,
+            .server_max_window_bits =
+                s_min_window_bits(offer.params.server_max_window_bits, options->server_max_window_bits),
+            .client_max_window_bits =
+                s_min_window_bits(offer.params.client_max_window_bits, options->client_max_window_bits),
+        };
+
+        if (s_append_c_str(out_response_value, "permessage-deflate")) {
+            return AWS_OP_ERR;
+        }
+
+        if (params.server_no_context_takeover && s_append_c_str(out_response_value, "; server_no_context_takeover")) {
+            return AWS_OP_ERR;
+        }
+
+        if (options->client_no_context_takeover &&
+            s_append_c_str(out_response_value, "; client_no_context_takeover")) {
+            return AWS_OP_ERR;
+        }
+
+        /* RFC-7692 Section 7.1.2.1: The response may only have server_max_window_bits if the offer did */
+        if (offer.params.server_max_window_bits &&
+            s_append_window_bits(out_response_value, "server_max_window_bits", params.server_max_window_bits)) {
+            return AWS_OP_ERR;
+        }
+
+        if (options->client_max_window_bits &&
+            s_append_window_bits(out_response_value, "client_max_window_bits", params.client_max_window_bits)) {
+            return AWS_OP_ERR;
+        }
+
+        *out_params = params;
+        *out_accepted = true;
+        return AWS_OP_SUCCESS;
+    }
+
+    return AWS_OP_SUCCESS;
+}
@@ -17,7 +17,11 @@ static int s_state_init(struct aws_websocket_encoder *encoder, struct aws_byte_b
         return aws_raise_error(AWS_ERROR_INVALID_STATE);
     }
 
-    encoder->state = AWS_WEBSOCKET_ENCODER_STATE_OPCODE_BYTE;
+    if (encoder->is_frame_pre_encoded) {
+        encoder->state = AWS_WEBSOCKET_ENCODER_STATE_PRE_ENCODED;
+    } else {
+        encoder->state = AWS_WEBSOCKET_ENCODER_STATE_OPCODE_BYTE;
+    }
     return AWS_OP_SUCCESS;
 }
 
@@ -201,14 +205,8 @@ static int s_state_payload(struct aws_websocket_encoder *encoder, struct aws_byt
      * RFC-6455 Section 5.3 Client-to-Server Masking
      * Each byte of payload is XOR against a byte of the masking-key */
     if (encoder->frame.masked) {
-        uint64_t mask_index = prev_bytes_processed;
-
-        /* Optimization idea: don't do this 1 byte at a time */
-        uint8_t *current_byte = out_buf->buffer + prev_buf.len;
-        uint8_t *end_byte = out_buf->buffer + out_buf->len;
-        while (current_byte != end_byte) {
-            *current_byte++ ^= encoder->frame.masking_key[mask_index++ % 4];
-        }
+        struct aws_byte_cursor written = aws_byte_cursor_from_array(out_buf->buffer + prev_buf.len, bytes_written);
+        aws_websocket_mask_payload(written, encoder->frame.masking_key, prev_bytes_processed);
     }
 
     /* If done writing payload, proceed to next state */
@@ -229,6 +227,17 @@ static int s_state_payload(struct aws_websocket_encoder *encoder, struct aws_byt
     return AWS_OP_SUCCESS;
 }
 
+/* PRE_ENCODED: Output the rest of a frame that was encoded ahead of time. Replaces all the states above. */
+static int s_state_pre_encoded(struct aws_websocket_encoder *encoder, struct aws_byte_buf *out_buf) {
+    aws_byte_buf_write_to_capacity(out_buf, &encoder->pre_encoded);
+
+    if (encoder->pre_encoded.len == 0) {
+        encoder->state = AWS_WEBSOCKET_ENCODER_STATE_DONE;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 static state_fn *s_state_functions[AWS_WEBSOCKET_ENCODER_STATE_DONE] = {
     s_state_init,
     s_state_opcode_byte,
@@ -238,6 +247,7 @@ static state_fn *s_state_functions[AWS_WEBSOCKET_ENCODER_STATE_DONE] = {
     s_state_masking_key,
     s_state_payload_check,
     s_state_payload,
+    s_state_pre_encoded,
 };
 
 int aws_websocket_encoder_process(struct aws_websocket_encoder *encoder, struct aws_byte_buf *out_buf) {
@@ -264,6 +274,8 @@ int aws_websocket_encoder_process(struct aws_websocket_encoder *encoder, struct
     if (encoder->state == AWS_WEBSOCKET_ENCODER_STATE_DONE) {
         encoder->state = AWS_WEBSOCKET_ENCODER_STATE_INIT;
         encoder->is_frame_in_progress = false;
+        encoder->is_frame_pre_encoded = false;
+        AWS_ZERO_STRUCT(encoder->pre_encoded);
     }
 
     return AWS_OP_SUCCESS;
@@ -334,6 +346,22 @@ int aws_websocket_encoder_start_frame(struct aws_websocket_encoder *encoder, con
     return AWS_OP_SUCCESS;
 }
 
+int aws_websocket_encoder_start_pre_encoded_frame(
+    struct aws_websocket_encoder *encoder,
+    const struct aws_websocket_frame *frame,
+    struct aws_byte_cursor encoded) {
+
+    AWS_ASSERT(encoded.len == aws_websocket_frame_encoded_size(frame));
+
+    if (aws_websocket_encoder_start_frame(encoder, frame)) {
+        return AWS_OP_ERR;
+    }
+
+    encoder->pre_encoded = encoded;
+    encoder->is_frame_pre_encoded = true;
+    return AWS_OP_SUCCESS;
+}
+
 bool aws_websocket_encoder_is_frame_in_progress(const struct aws_websocket_encoder *encoder) {
     return encoder->is_frame_in_progress;
 }
@@ -0,0 +1,151 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/websocket_impl.h>
+
+#include <aws/common/cpuid.h>
+
+#include <string.h>
+
+/* Pick SIMD paths at compile time based on what the compiler can target.
+ * SSE2 and NEON are baseline on the architectures that have them.
+ * AVX2 is compiled via a function-level target attribute and chosen at runtime. */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define AWS_WEBSOCKET_MASK_SSE2
+#    include <emmintrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#    define AWS_WEBSOCKET_MASK_AVX2
+#    include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#    define AWS_WEBSOCKET_MASK_NEON
+#    include <arm_neon.h>
+#endif
+
+/* Every kernel below takes a 32 byte pattern (the masking-key repeated, already rotated to line up with ptr),
+ * and masks as many whole blocks as it can. Returns the number of bytes processed.
+ * Block sizes are all multiples of 4, so the masking-key phase is the same before and after. */
+typedef size_t(s_mask_kernel_fn)(uint8_t *ptr, size_t len, const uint8_t pattern[32]);
+
+static size_t s_mask_words(uint8_t *ptr, size_t len, const uint8_t pattern[32]) {
+    uint64_t pattern_word;
+    memcpy(&pattern_word, pattern, sizeof(pattern_word));
+
+    size_t processed = 0;
+    while (len - processed >= sizeof(uint64_t)) {
+        /* memcpy() compiles to a plain load/store, and is safe for any alignment */
+        uint64_t word;
+        memcpy(&word, ptr + processed, sizeof(word));
+        word ^= pattern_word;
+        memcpy(ptr + processed, &word, sizeof(word));
+        processed += sizeof(uint64_t);
+    }
+
+    return processed;
+}
+
+#ifdef AWS_WEBSOCKET_MASK_SSE2
+static size_t s_mask_sse2(uint8_t *ptr, size_t len, const uint8_t pattern[32]) {
+    const __m128i pattern_vec = _mm_loadu_si128((const __m128i *)pattern);
+
+    size_t processed = 0;
+    while (len - processed >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(ptr + processed));
+        block = _mm_xor_si128(block, pattern_vec);
+        _mm_storeu_si128((__m128i *)(ptr + processed), block);
+        processed += 16;
+    }
+
+    return processed + s_mask_words(ptr + processed, len - processed, pattern);
+}
+#endif /* AWS_WEBSOCKET_MASK_SSE2 */
+
+#ifdef AWS_WEBSOCKET_MASK_AVX2
+__attribute__((target("avx2"))) static size_t s_mask_avx2(uint8_t *ptr, size_t len, const uint8_t pattern[32]) {
+    const __m256i pattern_vec = _mm256_loadu_si256((const __m256i *)pattern);
+
+    size_t processed = 0;
+    while (len - processed >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(ptr + processed));
+        block = _mm256_xor_si256(block, pattern_vec);
+        _mm256_storeu_si256((__m256i *)(ptr + processed), block);
+        processed += 32;
+    }
+
+    return processed + s_mask_words(ptr + processed, len - processed, pattern);
+}
+#endif /* AWS_WEBSOCKET_MASK_AVX2 */
+
+#ifdef AWS_WEBSOCKET_MASK_NEON
+static size_t s_mask_neon(uint8_t *ptr, size_t len, const uint8_t pattern[32]) {
+    const uint8x16_t pattern_vec = vld1q_u8(pattern);
+
+    size_t processed = 0;
+    while (len - processed >= 16) {
+        uint8x16_t block = vld1q_u8(ptr + processed);
+        block = veorq_u8(block, pattern_vec);
+        vst1q_u8(ptr + processed, block);
+        processed += 16;
+    }
+
+    return processed + s_mask_words(ptr + processed, len - processed, pattern);
+}
+#endif /* AWS_WEBSOCKET_MASK_NEON */
+
+static s_mask_kernel_fn *s_choose_kernel(size_t len) {
+    /* Don't bother with anything fancy for tiny payloads */
+    if (len < 16) {
+        return s_mask_words;
+    }
+
+#ifdef AWS_WEBSOCKET_MASK_AVX2
+    if (len >= 32 && aws_cpu_has_feature(AWS_CPU_FEATURE_AVX2)) {
+        return s_mask_avx2;
+    }
+#endif
+
+#if defined(AWS_WEBSOCKET_MASK_SSE2)
+    return s_mask_sse2;
+#elif defined(AWS_WEBSOCKET_MASK_NEON)
+    return s_mask_neon;
+#else
+    return s_mask_words;
+#endif
+}
+
+void aws_websocket_mask_payload(struct aws_byte_cursor payload, const uint8_t masking_key[4], uint64_t mask_offset) {
+    uint8_t *ptr = payload.ptr;
+    size_t len = payload.len;
+    size_t key_index = (size_t)(mask_offset % 4);
+
+    /* Process misaligned head 1 byte at a time, so the bulk of the loads and stores are aligned */
+    while (len > 0 && ((uintptr_t)ptr % sizeof(uint64_t)) != 0) {
+        *ptr++ ^= masking_key[key_index];
+        key_index = (key_index + 1) % 4;
+        --len;
+    }
+
+    if (len >= sizeof(uint64_t)) {
+        /* Repeat masking-key, rotated so that pattern[0] lines up with ptr[0] */
+        uint8_t pattern[32];
+        for (size_t i = 0; i < sizeof(pattern); ++i) {
+            pattern[i] = masking_key[(key_index + i) % 4];
+        }
+
+        size_t processed = s_choose_kernel(len)(ptr, len, pattern);
+        ptr += processed;
+        len -= processed;
+    }
+
+    /* Process tail 1 byte at a time */
+    while (len > 0) {
+        *ptr++ ^= masking_key[key_index];
+        key_index = (key_index + 1) % 4;
+        --len;
+    }
+}
@@ -0,0 +1,379 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/websocket_message_pool.h>
+
+static size_t s_class_size(const struct aws_websocket_message_pool *pool, size_t size_class) {
+    size_t size = (size_t)AWS_WEBSOCKET_MESSAGE_POOL_MIN_CLASS_SIZE << size_class;
+    return aws_min_size(size, pool->max_message_size);
+}
+
+/* Smallest size class that holds `capacity` bytes */
+static size_t s_class_for_capacity(const struct aws_websocket_message_pool *pool, size_t capacity) {
+    AWS_ASSERT(capacity <= pool->max_message_size);
+    size_t size_class = 0;
+    while (s_class_size(pool, size_class) < capacity) {
+        size_class++;
+    }
+    AWS_ASSERT(size_class < pool->num_classes);
+    return size_class;
+}
+
+static void s_message_pool_destroy(void *user_data) {
+    struct aws_websocket_message_pool *pool = user_data;
+
+    for (size_t i = 0; i < pool->num_classes; ++i) {
+        while (!aws_linked_list_empty(&pool->free_lists[i])) {
+            struct aws_linked_list_node *node = aws_linked_list_pop_front(&pool->free_lists[i]);
+            struct aws_websocket_incoming_message *message =
+                AWS_CONTAINER_OF(node, struct aws_websocket_incoming_message, node);
+            aws_mem_release(message->allocator, message);
+        }
+    }
+
+    AWS_ASSERT(!pool->is_waiting_for_shared_budget);
+    aws_websocket_read_budget_release(pool->shared_budget);
+
+    aws_mutex_clean_up(&pool->lock);
+    aws_mem_release(pool->allocator, pool);
+}
+
+struct aws_websocket_message_pool *aws_websocket_message_pool_new(
+    struct aws_allocator *allocator,
+    size_t max_message_size) {
+
+    struct aws_websocket_message_pool *pool = aws_mem_calloc(allocator, 1, sizeof(struct aws_websocket_message_pool));
+    pool->allocator = allocator;
+    pool->max_message_size = max_message_size ? max_message_size : AWS_WEBSOCKET_DEFAULT_MAX_INCOMING_MESSAGE_SIZE;
+
+    if (aws_mutex_init(&pool->lock)) {
+        aws_mem_release(allocator, pool);
+        return NULL;
+    }
+
+    /* The largest class is the first one that's clamped to the max message size */
+    pool->num_classes = 1;
+    while (s_class_size(pool, pool->num_classes - 1) < pool->max_message_size) {
+        pool->num_classes++;
+    }
+    AWS_FATAL_ASSERT(pool->num_classes <= AWS_WEBSOCKET_MESSAGE_POOL_MAX_CLASSES);
+
+    for (size_t i = 0; i < pool->num_classes; ++i) {
+        aws_linked_list_init(&pool->free_lists[i]);
+    }
+
+    aws_ref_count_init(&pool->ref_count, pool, s_message_pool_destroy);
+    return pool;
+}
+
+void aws_websocket_message_pool_release(struct aws_websocket_message_pool *pool) {
+    if (pool) {
+        aws_ref_count_release(&pool->ref_count);
+    }
+}
+
+static void s_read_budget_destroy(void *user_data) {
+    struct aws_websocket_read_budget *budget = user_data;
+    AWS_ASSERT(aws_linked_list_empty(&budget->waiting_pools));
+    aws_mutex_clean_up(&budget->lock);
+    aws_mem_release(budget->allocator, budget);
+}
+
+struct aws_websocket_read_budget *aws_websocket_read_budget_new(struct aws_allocator *allocator, size_t max_bytes) {
+    if (max_bytes == 0) {
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    struct aws_websocket_read_budget *budget = aws_mem_calloc(allocator, 1, sizeof(struct aws_websocket_read_budget));
+    budget->allocator = allocator;
+    budget->max_bytes = max_bytes;
+    aws_linked_list_init(&budget->waiting_pools);
+
+    if (aws_mutex_init(&budget->lock)) {
+        aws_mem_release(allocator, budget);
+        return NULL;
+    }
+
+    aws_ref_count_init(&budget->ref_count, budget, s_read_budget_destroy);
+    return budget;
+}
+
+struct aws_websocket_read_budget *aws_websocket_read_budget_acquire(struct aws_websocket_read_budget *budget) {
+    if (budget) {
+        aws_ref_count_acquire(&budget->ref_count);
+    }
+    return budget;
+}
+
+void aws_websocket_read_budget_release(struct aws_websocket_read_budget *budget) {
+    if (budget) {
+        aws_ref_count_release(&budget->ref_count);
+    }
+}
+
+void aws_websocket_message_pool_set_budget(
+    struct aws_websocket_message_pool *pool,
+    size_t max_charged_bytes,
+    struct aws_websocket_read_budget *shared_budget,
+    aws_websocket_message_pool_on_budget_freed_fn *on_budget_freed,
+    void *user_data) {
+
+    AWS_PRECONDITION(max_charged_bytes > 0 || shared_budget);
+    AWS_PRECONDITION(!pool->shared_budget);
+
+    pool->shared_budget = aws_websocket_read_budget_acquire(shared_budget);
+
+    aws_mutex_lock(&pool->lock);
+    pool->max_charged_bytes = max_charged_bytes;
+    pool->on_budget_freed = on_budget_freed;
+    pool->on_budget_freed_user_data = user_data;
+    aws_mutex_unlock(&pool->lock);
+}
+
+void aws_websocket_message_pool_stop_budget_callbacks(struct aws_websocket_message_pool *pool) {
+    struct aws_websocket_read_budget *shared_budget = pool->shared_budget;
+    if (shared_budget) {
+        aws_mutex_lock(&shared_budget->lock);
+        if (pool->is_waiting_for_shared_budget) {
+            aws_linked_list_remove(&pool->shared_budget_node);
+            pool->is_waiting_for_shared_budget = false;
+        }
+        aws_mutex_unlock(&shared_budget->lock);
+    }
+
+    aws_mutex_lock(&pool->lock);
+    pool->on_budget_freed = NULL;
+    pool->on_budget_freed_user_data = NULL;
+    pool->is_waiting_for_budget = false;
+    aws_mutex_unlock(&pool->lock);
+}
+
+void aws_websocket_message_pool_charge(
+    struct aws_websocket_message_pool *pool,
+    struct aws_websocket_incoming_message *message) {
+
+    AWS_PRECONDITION(message->pool == pool);
+    AWS_PRECONDITION(message->charged_bytes == 0);
+
+    struct aws_websocket_read_budget *shared_budget = pool->shared_budget;
+    if (pool->max_charged_bytes == 0 && !shared_budget) {
+        return;
+    }
+
+    /* It's the buffer that takes up memory, not just the payload in it */
+    message->charged_bytes = message->payload.capacity;
+
+    aws_mutex_lock(&pool->lock);
+    pool->charged_bytes += message->charged_bytes;
+    aws_mutex_unlock(&pool->lock);
+
+    if (shared_budget) {
+        aws_mutex_lock(&shared_budget->lock);
+        shared_budget->charged_bytes += message->charged_bytes;
+        aws_mutex_unlock(&shared_budget->lock);
+    }
+}
+
+bool aws_websocket_message_pool_is_over_budget(struct aws_websocket_message_pool *pool) {
+    aws_mutex_lock(&pool->lock);
+    bool is_over = pool->max_charged_bytes > 0 && pool->charged_bytes > pool->max_charged_bytes;
+    aws_mutex_unlock(&pool->lock);
+
+    struct aws_websocket_read_budget *shared_budget = pool->shared_budget;
+    if (!is_over && shared_budget) {
+        aws_mutex_lock(&shared_budget->lock);
+        is_over = shared_budget->charged_bytes > shared_budget->max_bytes;
+        aws_mutex_unlock(&shared_budget->lock);
+    }
+
+    return is_over;
+}
+
+void aws_websocket_message_pool_wait_for_budget(struct aws_websocket_message_pool *pool) {
+    aws_mutex_lock(&pool->lock);
+    pool->is_waiting_for_budget = pool->on_budget_freed != NULL;
+    aws_mutex_unlock(&pool->lock);
+
+    /* Messages from other websockets' pools free up shared budget too */
+    struct aws_websocket_read_budget *shared_budget = pool->shared_budget;
+    if (shared_budget) {
+        aws_mutex_lock(&shared_budget->lock);
+        if (!pool->is_waiting_for_shared_budget) {
+            aws_linked_list_push_back(&shared_budget->waiting_pools, &pool->shared_budget_node);
+            pool->is_waiting_for_shared_budget = true;
+        }
+        aws_mutex_unlock(&shared_budget->lock);
+    }
+}
+
+/* Call with pool's lock held */
+static void s_notify_budget_freed_synced(struct aws_websocket_message_pool *pool) {
+    if (pool->is_waiting_for_budget && pool->on_budget_freed) {
+        pool->is_waiting_for_budget = false;
+        pool->on_budget_freed(pool->on_budget_freed_user_data);
+    }
+}
+
+/* Give a released message's bytes back to the budgets, and wake anyone waiting on them */
+static void s_refund_budget(struct aws_websocket_message_pool *pool, size_t charged_bytes) {
+    aws_mutex_lock(&pool->lock);
+    pool->charged_bytes -= charged_bytes;
+    s_notify_budget_freed_synced(pool);
+    aws_mutex_unlock(&pool->lock);
+
+    struct aws_websocket_read_budget *shared_budget = pool->shared_budget;
+    if (shared_budget) {
+        aws_mutex_lock(&shared_budget->lock);
+        shared_budget->charged_bytes -= charged_bytes;
+        while (!aws_linked_list_empty(&shared_budget->waiting_pools)) {
+            struct aws_linked_list_node *node = aws_linked_list_pop_front(&shared_budget->waiting_pools);
+            struct aws_websocket_message_pool *waiting_pool =
+                AWS_CONTAINER_OF(node, struct aws_websocket_message_pool, shared_budget_node);
+            waiting_pool->is_waiting_for_shared_budget = false;
+
+            /* Lock order is always shared budget, then pool */
+            aws_mutex_lock(&waiting_pool->lock);
+            s_notify_budget_freed_synced(waiting_pool);
+            aws_mutex_unlock(&waiting_pool->lock);
+        }
+        aws_mutex_unlock(&shared_budget->lock);
+    }
+}
+
+struct aws_websocket_incoming_message *aws_websocket_message_pool_acquire(
+    struct aws_websocket_message_pool *pool,
+    size_t capacity) {
+
+    if (capacity > pool->max_message_size) {
+        aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_MESSAGE_TOO_BIG);
+        return NULL;
+    }
+
+    const size_t size_class = s_class_for_capacity(pool, capacity);
+    struct aws_websocket_incoming_message *message = NULL;
+
+    aws_mutex_lock(&pool->lock);
+    if (!aws_linked_list_empty(&pool->free_lists[size_class])) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&pool->free_lists[size_class]);
+        message = AWS_CONTAINER_OF(node, struct aws_websocket_incoming_message, node);
+        pool->free_counts[size_class]--;
+    }
+    aws_mutex_unlock(&pool->lock);
+
+    if (message) {
+        message->payload.len = 0;
+    } else {
+        /* Allocate message along with its payload storage */
+        const size_t class_size = s_class_size(pool, size_class);
+        void *payload_storage;
+        if (!aws_mem_acquire_many(
+                pool->allocator,
+                2,
+                &message,
+                sizeof(struct aws_websocket_incoming_message),
+                &payload_storage,
+                class_size)) {
+            return NULL;
+        }
+        AWS_ZERO_STRUCT(*message);
+        message->allocator = pool->allocator;
+        message->size_class = size_class;
+        message->payload = aws_byte_buf_from_empty_array(payload_storage, class_size);
+    }
+
+    message->pool = pool;
+    message->opcode = 0;
+    message->charged_bytes = 0;
+    aws_atomic_init_int(&message->ref_count, 1);
+    aws_ref_count_acquire(&pool->ref_count);
+    return message;
+}
+
+int aws_websocket_incoming_message_reserve(struct aws_websocket_incoming_message **message, size_t capacity) {
+    struct aws_websocket_incoming_message *old_message = *message;
+    AWS_PRECONDITION(aws_atomic_load_int(&old_message->ref_count) == 1);
+
+    if (capacity <= old_message->payload.capacity) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_websocket_message_pool *pool = old_message->pool;
+    if (capacity > pool->max_message_size) {
+        return aws_raise_error(AWS_ERROR_HTTP_WEBSOCKET_MESSAGE_TOO_BIG);
+    }
+
+    /* Grow by at least double, so a message arriving in many small pieces doesn't move each time */
+    size_t new_capacity = aws_max_size(capacity, aws_mul_size_saturating(old_message->payload.capacity, 2));
+    new_capacity = aws_min_size(new_capacity, pool->max_message_size);
+
+    struct aws_websocket_incoming_message *new_message = aws_websocket_message_pool_acquire(pool, new_capacity);
+    if (!new_message) {
+        return AWS_OP_ERR;
+    }
+
+    new_message->opcode = old_message->opcode;
+    aws_byte_buf_write_from_whole_buffer(&new_message->payload, old_message->payload);
+
+    aws_websocket_incoming_message_release(old_message);
+    *message = new_message;
+    return AWS_OP_SUCCESS;
+}
+
+struct aws_websocket_incoming_message *aws_websocket_incoming_message_acquire(
+    struct aws_websocket_incoming_message *message) {
+
+    AWS_PRECONDITION(message);
+    aws_atomic_fetch_add(&message->ref_count, 1);
+    return message;
+}
+
+void aws_websocket_incoming_message_release(struct aws_websocket_incoming_message *message) {
+    if (!message) {
+        return;
+    }
+
+    size_t prev_count = aws_atomic_fetch_sub(&message->ref_count, 1);
+    AWS_FATAL_ASSERT(prev_count != 0 && "Websocket incoming message released too many times");
+    if (prev_count > 1) {
+        return;
+    }
+
+    struct aws_websocket_message_pool *pool = message->pool;
+    if (message->charged_bytes > 0) {
+        s_refund_budget(pool, message->charged_bytes);
+        message->charged_bytes = 0;
+    }
+
+    /* Back to the pool, unless its size class already has enough free buffers */
+    bool pooled = false;
+
+    aws_mutex_lock(&pool->lock);
+    if (pool->free_counts[message->size_class] < AWS_WEBSOCKET_MESSAGE_POOL_MAX_FREE_PER_CLASS) {
+        aws_linked_list_push_back(&pool->free_lists[message->size_class], &message->node);
+        pool->free_counts[message->size_class]++;
+        pooled = true;
+    }
+    aws_mutex_unlock(&pool->lock);
+
+    if (!pooled) {
+        aws_mem_release(message->allocator, message);
+    }
+
+    /* Each outstanding message keeps the pool alive */
+    aws_ref_count_release(&pool->ref_count);
+}
+
+uint8_t aws_websocket_incoming_message_get_opcode(const struct aws_websocket_incoming_message *message) {
+    AWS_PRECONDITION(message);
+    return message->opcode;
+}
+
+struct aws_byte_cursor aws_websocket_incoming_message_get_payload(
+    const struct aws_websocket_incoming_message *message) {
+
+    AWS_PRECONDITION(message);
+    return aws_byte_cursor_from_buf(&message->payload);
+}
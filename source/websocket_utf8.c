@@ -0,0 +1,208 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/websocket_impl.h>
+
+#include <aws/common/cpuid.h>
+
+#include <string.h>
+
+/* Pick SIMD paths at compile time based on what the compiler can target, same as websocket_mask.c.
+ * SSE2 and AArch64 NEON are baseline on the architectures that have them.
+ * AVX2 is compiled via a function-level target attribute and chosen at runtime. */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define AWS_WEBSOCKET_UTF8_SSE2
+#    include <emmintrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#    define AWS_WEBSOCKET_UTF8_AVX2
+#    include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#    define AWS_WEBSOCKET_UTF8_NEON
+#    include <arm_neon.h>
+#endif
+
+/* Every kernel below checks whole blocks for ASCII, stopping at the first block with a byte >= 0x80.
+ * Returns the number of bytes that are definitely ASCII.
+ * The caller validates from there, byte by byte, until it's back to ASCII. */
+typedef size_t(s_ascii_kernel_fn)(const uint8_t *ptr, size_t len);
+
+static size_t s_ascii_words(const uint8_t *ptr, size_t len) {
+    const uint64_t high_bits = 0x8080808080808080ULL;
+
+    size_t processed = 0;
+    while (len - processed >= sizeof(uint64_t)) {
+        /* memcpy() compiles to a plain load, and is safe for any alignment */
+        uint64_t word;
+        memcpy(&word, ptr + processed, sizeof(word));
+        if (word & high_bits) {
+            break;
+        }
+        processed += sizeof(uint64_t);
+    }
+
+    return processed;
+}
+
+#ifdef AWS_WEBSOCKET_UTF8_SSE2
+static size_t s_ascii_sse2(const uint8_t *ptr, size_t len) {
+    size_t processed = 0;
+    while (len - processed >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(ptr + processed));
+        if (_mm_movemask_epi8(block) != 0) {
+            return processed;
+        }
+        processed += 16;
+    }
+
+    return processed + s_ascii_words(ptr + processed, len - processed);
+}
+#endif /* AWS_WEBSOCKET_UTF8_SSE2 */
+
+#ifdef AWS_WEBSOCKET_UTF8_AVX2
+__attribute__((target("avx2"))) static size_t s_ascii_avx2(const uint8_t *ptr, size_t len) {
+    size_t processed = 0;
+
+    /* OR 2 blocks together so the hot loop does 1 test per 64 bytes */
+    while (len - processed >= 64) {
+        __m256i block_a = _mm256_loadu_si256((const __m256i *)(ptr + processed));
+        __m256i block_b = _mm256_loadu_si256((const __m256i *)(ptr + processed + 32));
+        if (_mm256_movemask_epi8(_mm256_or_si256(block_a, block_b)) != 0) {
+            break;
+        }
+        processed += 64;
+    }
+
+    while (len - processed >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(ptr + processed));
+        if (_mm256_movemask_epi8(block) != 0) {
+            return processed;
+        }
+        processed += 32;
+    }
+
+    return processed + s_ascii_words(ptr + processed, len - processed);
+}
+#endif /* AWS_WEBSOCKET_UTF8_AVX2 */
+
+#ifdef AWS_WEBSOCKET_UTF8_NEON
+static size_t s_ascii_neon(const uint8_t *ptr, size_t len) {
+    size_t processed = 0;
+    while (len - processed >= 16) {
+        uint8x16_t block = vld1q_u8(ptr + processed);
+        if (vmaxvq_u8(block) >= 0x80) {
+            return processed;
+        }
+        processed += 16;
+    }
+
+    return processed + s_ascii_words(ptr + processed, len - processed);
+}
+#endif /* AWS_WEBSOCKET_UTF8_NEON */
+
+static s_ascii_kernel_fn *s_choose_kernel(size_t len) {
+    /* Don't bother with anything fancy for tiny payloads */
+    if (len < 16) {
+        return s_ascii_words;
+    }
+
+#ifdef AWS_WEBSOCKET_UTF8_AVX2
+    if (len >= 32 && aws_cpu_has_feature(AWS_CPU_FEATURE_AVX2)) {
+        return s_ascii_avx2;
+    }
+#endif
+
+#if defined(AWS_WEBSOCKET_UTF8_SSE2)
+    return s_ascii_sse2;
+#elif defined(AWS_WEBSOCKET_UTF8_NEON)
+    return s_ascii_neon;
+#else
+    return s_ascii_words;
+#endif
+}
+
+void aws_websocket_utf8_validator_reset(struct aws_websocket_utf8_validator *validator) {
+    AWS_ZERO_STRUCT(*validator);
+}
+
+/* Check a lead byte, and set up the validator to expect its continuation bytes.
+ * Unicode Standard Table 3-7: Well-Formed UTF-8 Byte Sequences */
+static int s_process_lead_byte(struct aws_websocket_utf8_validator *validator, uint8_t byte) {
+    validator->next_min = 0x80;
+    validator->next_max = 0xBF;
+
+    if (byte >= 0xC2 && byte <= 0xDF) {
+        validator->remaining = 1;
+    } else if (byte >= 0xE0 && byte <= 0xEF) {
+        validator->remaining = 2;
+        if (byte == 0xE0) {
+            validator->next_min = 0xA0; /* overlong */
+        } else if (byte == 0xED) {
+            validator->next_max = 0x9F; /* surrogates */
+        }
+    } else if (byte >= 0xF0 && byte <= 0xF4) {
+        validator->remaining = 3;
+        if (byte == 0xF0) {
+            validator->next_min = 0x90; /* overlong */
+        } else if (byte == 0xF4) {
+            validator->next_max = 0x8F; /* above U+10FFFF */
+        }
+    } else {
+        /* stray continuation byte, or a lead byte that can only start an overlong or out-of-range encoding */
+        return aws_raise_error(AWS_ERROR_INVALID_UTF8);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_websocket_utf8_validator_update(struct aws_websocket_utf8_validator *validator, struct aws_byte_cursor text) {
+    const uint8_t *ptr = text.ptr;
+    const size_t len = text.len;
+    s_ascii_kernel_fn *ascii_kernel = s_choose_kernel(len);
+
+    size_t i = 0;
+    size_t bytewise_until = 0; /* After the bulk check stops at mixed text, go bytewise for a while */
+    while (i < len) {
+        /* Between code points, skip over runs of ASCII in bulk */
+        if (validator->remaining == 0 && i >= bytewise_until && ptr[i] < 0x80) {
+            i += ascii_kernel(ptr + i, len - i);
+            if (i == len) {
+                break;
+            }
+            bytewise_until = i + 16;
+        }
+
+        const uint8_t byte = ptr[i++];
+        if (validator->remaining == 0) {
+            if (byte < 0x80) {
+                continue;
+            }
+            if (s_process_lead_byte(validator, byte)) {
+                return AWS_OP_ERR;
+            }
+        } else {
+            if (byte < validator->next_min || byte > validator->next_max) {
+                return aws_raise_error(AWS_ERROR_INVALID_UTF8);
+            }
+            validator->next_min = 0x80;
+            validator->next_max = 0xBF;
+            validator->remaining--;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_websocket_utf8_validator_finalize(struct aws_websocket_utf8_validator *validator) {
+    const bool is_complete = validator->remaining == 0;
+    aws_websocket_utf8_validator_reset(validator);
+    if (!is_complete) {
+        return aws_raise_error(AWS_ERROR_INVALID_UTF8);
+    }
+    return AWS_OP_SUCCESS;
+}
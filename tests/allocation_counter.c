@@ -0,0 +1,70 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include "allocation_counter.h"
+
+static void s_count(struct allocation_counter *counter, size_t size) {
+    aws_atomic_fetch_add(&counter->allocations, 1);
+    aws_atomic_fetch_add(&counter->bytes, size);
+}
+
+static void *s_counter_acquire(struct aws_allocator *allocator, size_t size) {
+    struct allocation_counter *counter = allocator->impl;
+    s_count(counter, size);
+    return aws_mem_acquire(counter->wrapped, size);
+}
+
+static void s_counter_release(struct aws_allocator *allocator, void *ptr) {
+    struct allocation_counter *counter = allocator->impl;
+    aws_mem_release(counter->wrapped, ptr);
+}
+
+static void *s_counter_realloc(struct aws_allocator *allocator, void *ptr, size_t oldsize, size_t newsize) {
+    struct allocation_counter *counter = allocator->impl;
+    s_count(counter, newsize);
+    void *new_ptr = ptr;
+    if (aws_mem_realloc(counter->wrapped, &new_ptr, oldsize, newsize)) {
+        return NULL;
+    }
+    return new_ptr;
+}
+
+static void *s_counter_calloc(struct aws_allocator *allocator, size_t num, size_t size) {
+    struct allocation_counter *counter = allocator->impl;
+    s_count(counter, num * size);
+    return aws_mem_calloc(counter->wrapped, num, size);
+}
+
+void allocation_counter_init(struct allocation_counter *counter, struct aws_allocator *wrapped) {
+    AWS_ZERO_STRUCT(*counter);
+    counter->wrapped = wrapped;
+    counter->allocator = (struct aws_allocator){
+        .mem_acquire = s_counter_acquire,
+        .mem_release = s_counter_release,
+        .mem_realloc = s_counter_realloc,
+        .mem_calloc = s_counter_calloc,
+        .impl = counter,
+    };
+    aws_atomic_init_int(&counter->allocations, 0);
+    aws_atomic_init_int(&counter->bytes, 0);
+}
+
+struct allocation_count allocation_counter_snapshot(const struct allocation_counter *counter) {
+    struct allocation_count count = {
+        .allocations = aws_atomic_load_int(&counter->allocations),
+        .bytes = aws_atomic_load_int(&counter->bytes),
+    };
+    return count;
+}
+
+struct allocation_count allocation_counter_since(
+    const struct allocation_counter *counter,
+    struct allocation_count since) {
+
+    struct allocation_count now = allocation_counter_snapshot(counter);
+    now.allocations -= since.allocations;
+    now.bytes -= since.bytes;
+    return now;
+}
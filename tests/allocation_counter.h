@@ -0,0 +1,38 @@
+#ifndef AWS_HTTP_ALLOCATION_COUNTER_H
+#define AWS_HTTP_ALLOCATION_COUNTER_H
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/common/atomics.h>
+#include <aws/common/common.h>
+
+/**
+ * An aws_allocator that passes everything through to another one,
+ * counting allocations and bytes allocated along the way.
+ * Counts are atomic, so the allocator can be handed to event-loop threads.
+ */
+struct allocation_counter {
+    struct aws_allocator allocator;
+    struct aws_allocator *wrapped;
+    struct aws_atomic_var allocations;
+    struct aws_atomic_var bytes;
+};
+
+/* What was allocated since a snapshot was taken */
+struct allocation_count {
+    size_t allocations;
+    size_t bytes;
+};
+
+void allocation_counter_init(struct allocation_counter *counter, struct aws_allocator *wrapped);
+
+struct allocation_count allocation_counter_snapshot(const struct allocation_counter *counter);
+
+/* Returns what was allocated since `since` was taken */
+struct allocation_count allocation_counter_since(
+    const struct allocation_counter *counter,
+    struct allocation_count since);
+
+#endif /* AWS_HTTP_ALLOCATION_COUNTER_H */
@@ -124,7 +124,17 @@ class H2Protocol(asyncio.Protocol):
 
         path = request_data.headers[':path']
         method = request_data.headers[':method']
-        if method == "PUT" or method == "POST":
+        if path.startswith('/loopback/'):
+            # Sized response for the loopback benchmark, whatever the method
+            length = int(path[len('/loopback/'):])
+            self.conn.send_headers(
+                stream_id, [(':status', '200'), ('content-length', str(length))])
+            if length == 0:
+                self.conn.end_stream(stream_id)
+                self.transport.write(self.conn.data_to_send())
+            else:
+                asyncio.ensure_future(self.send_repeat_data(length, stream_id))
+        elif method == "PUT" or method == "POST":
             self.conn.send_headers(stream_id, [(':status', '200')])
             asyncio.ensure_future(self.send_data(
                 str(self.num_sentence_received[stream_id]).encode(), stream_id))
@@ -28,6 +28,9 @@ struct client_stream_tester {
      * They copied into a new `info_responses` entry when the block is done */
     struct aws_http_headers *current_info_headers;
 
+    /* Number of times on_response_headers fired */
+    size_t on_response_headers_count;
+
     /* Main header-block */
     struct aws_http_headers *response_headers;
     bool response_headers_done;
@@ -51,6 +54,8 @@ struct client_stream_tester {
 struct client_stream_tester_options {
     struct aws_http_message *request;
     struct aws_http_connection *connection;
+    const struct aws_http_content_decoding_options *content_decoding;
+    const struct aws_http_content_encoding_options *content_encoding;
 };
 
 int client_stream_tester_init(
@@ -0,0 +1,426 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+/*
+ * Allocations per request on warm connections, and per call for the constructors on those paths.
+ * The constructors' counts don't depend on the platform, so they're checked exactly.
+ * Byte counts do, so the request paths are checked against baselines measured in the same test:
+ * a warm request must cost no more than the first request on a new connection,
+ * and the cost must not grow as more requests are made.
+ * Struct sizes are checked against published budgets, which are ceilings for 64-bit platforms.
+ *
+ * Only the code under test gets the counting allocator.
+ * Testing channels, fake peers and the messages they send use the test's allocator and aren't counted.
+ */
+
+#include "allocation_counter.h"
+#include "h2_test_helper.h"
+
+#include <aws/common/clock.h>
+#include <aws/http/private/h1_connection.h>
+#include <aws/http/private/h1_encoder.h>
+#include <aws/http/private/h2_connection.h>
+#include <aws/http/private/h2_frames.h>
+#include <aws/http/private/h2_stream.h>
+#include <aws/http/private/hpack.h>
+#include <aws/http/request_response.h>
+#include <aws/io/stream.h>
+#include <aws/testing/aws_test_harness.h>
+#include <aws/testing/io_testing_channel.h>
+
+#include <stdio.h>
+
+#define TEST_CASE(NAME)                                                                                                \
+    AWS_TEST_CASE(NAME, s_test_##NAME);                                                                                \
+    static int s_test_##NAME(struct aws_allocator *allocator, void *ctx)
+
+#define DEFINE_HEADER(NAME, VALUE)                                                                                     \
+    {                                                                                                                  \
+        .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(NAME),                                                           \
+        .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(VALUE),                                                         \
+    }
+
+enum {
+    WARMUP_REQUESTS = 50,
+    MEASURED_REQUESTS = 200,
+
+    /* A proxy holding a thousand concurrent streams per connection pays these per stream, so keep them tight.
+     * Rarely used state (timers only HTTP/1 uses, the request after its HEADERS are sent) isn't carried here */
+    HTTP_STREAM_MAX_SIZE = 352,
+    H2_STREAM_MAX_SIZE = 736,
+};
+
+/* Baseline (64-bit Linux): 312 bytes for the common stream data, 672 for an HTTP/2 stream */
+TEST_CASE(sizeof_budget_streams) {
+    (void)allocator;
+    (void)ctx;
+    ASSERT_TRUE(sizeof(struct aws_http_stream) <= HTTP_STREAM_MAX_SIZE);
+    ASSERT_TRUE(sizeof(struct aws_h2_stream) <= H2_STREAM_MAX_SIZE);
+    return AWS_OP_SUCCESS;
+}
+
+/* Baseline: 3 allocations, the message, its headers, and the headers' array */
+TEST_CASE(allocation_count_http_message_new_request) {
+    (void)ctx;
+    struct allocation_counter counter;
+    allocation_counter_init(&counter, allocator);
+
+    struct allocation_count start = allocation_counter_snapshot(&counter);
+    struct aws_http_message *request = aws_http_message_new_request(&counter.allocator);
+    ASSERT_NOT_NULL(request);
+    struct allocation_count count = allocation_counter_since(&counter, start);
+    ASSERT_TRUE(count.allocations <= 3);
+
+    aws_http_message_release(request);
+    return AWS_OP_SUCCESS;
+}
+
+/* Baseline: 1 allocation, the frame. The headers are referenced, not copied */
+TEST_CASE(allocation_count_h2_frame_new_headers) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+    struct allocation_counter counter;
+    allocation_counter_init(&counter, allocator);
+
+    struct aws_http_header headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+        DEFINE_HEADER(":authority", "example.com"),
+        DEFINE_HEADER("user-agent", "allocation-count-test"),
+    };
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(headers);
+    ASSERT_SUCCESS(aws_http_headers_add_array(headers, headers_src, AWS_ARRAY_SIZE(headers_src)));
+
+    struct allocation_count start = allocation_counter_snapshot(&counter);
+    struct aws_h2_frame *frame = aws_h2_frame_new_headers(
+        &counter.allocator, 1 /*stream_id*/, headers, true /*end_stream*/, 0 /*pad_length*/, NULL /*priority*/);
+    ASSERT_NOT_NULL(frame);
+    struct allocation_count count = allocation_counter_since(&counter, start);
+    ASSERT_UINT_EQUALS(1, count.allocations);
+
+    aws_h2_frame_destroy(frame);
+    aws_http_headers_release(headers);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* Baseline: 0 allocations once the dynamic table has filled up and is evicting */
+TEST_CASE(allocation_count_hpack_insert_header) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+    struct allocation_counter counter;
+    allocation_counter_init(&counter, allocator);
+
+    struct aws_hpack_context context;
+    aws_hpack_context_init(&context, &counter.allocator, AWS_LS_HTTP_ENCODER, NULL /*log_id*/);
+
+    char value[32];
+    struct aws_http_header header = {
+        .name = aws_byte_cursor_from_c_str("x-amz-meta-counter"),
+    };
+
+    /* About 70 of these headers fit in the default 4KiB table */
+    const size_t warmup_inserts = 500;
+    const size_t measured_inserts = 1000;
+    struct allocation_count start = allocation_counter_snapshot(&counter);
+    for (size_t i = 0; i < warmup_inserts + measured_inserts; ++i) {
+        if (i == warmup_inserts) {
+            start = allocation_counter_snapshot(&counter);
+        }
+        snprintf(value, sizeof(value), "value-%zu", i);
+        header.value = aws_byte_cursor_from_c_str(value);
+        ASSERT_SUCCESS(aws_hpack_insert_header(&context, &header));
+    }
+    struct allocation_count count = allocation_counter_since(&counter, start);
+    ASSERT_UINT_EQUALS(0, count.allocations);
+
+    aws_hpack_context_clean_up(&context);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* Baseline: 1 allocation from an empty pool, 0 once a chunk has gone back to it */
+TEST_CASE(allocation_count_h1_chunk_new) {
+    (void)ctx;
+    struct allocation_counter counter;
+    allocation_counter_init(&counter, allocator);
+
+    struct aws_h1_chunk_pool pool;
+    ASSERT_SUCCESS(aws_h1_chunk_pool_init(&pool, &counter.allocator, 4 /*max_free*/));
+
+    struct aws_byte_cursor data = aws_byte_cursor_from_c_str("chunk");
+    struct aws_input_stream *data_stream = aws_input_stream_new_from_cursor(allocator, &data);
+    ASSERT_NOT_NULL(data_stream);
+    struct aws_http1_chunk_options options = {
+        .chunk_data = data_stream,
+        .chunk_data_size = data.len,
+    };
+
+    struct allocation_count start = allocation_counter_snapshot(&counter);
+    struct aws_h1_chunk *chunk = aws_h1_chunk_new(&counter.allocator, &pool, &options);
+    ASSERT_NOT_NULL(chunk);
+    struct allocation_count count = allocation_counter_since(&counter, start);
+    ASSERT_UINT_EQUALS(1, count.allocations);
+    aws_h1_chunk_destroy(chunk);
+
+    start = allocation_counter_snapshot(&counter);
+    chunk = aws_h1_chunk_new(&counter.allocator, &pool, &options);
+    ASSERT_NOT_NULL(chunk);
+    count = allocation_counter_since(&counter, start);
+    ASSERT_UINT_EQUALS(0, count.allocations);
+    aws_h1_chunk_destroy(chunk);
+
+    aws_h1_chunk_pool_clean_up(&pool);
+    aws_input_stream_release(data_stream);
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Steady state on warm connections
+ */
+
+struct request_tester {
+    bool complete;
+    int error_code;
+};
+
+static void s_on_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct request_tester *tester = user_data;
+    tester->complete = true;
+    tester->error_code = error_code;
+}
+
+static int s_install_connection(struct testing_channel *testing_channel, struct aws_http_connection *connection) {
+    struct aws_channel_slot *slot = aws_channel_slot_new(testing_channel->channel);
+    ASSERT_NOT_NULL(slot);
+    ASSERT_SUCCESS(aws_channel_slot_insert_end(testing_channel->channel, slot));
+    ASSERT_SUCCESS(aws_channel_slot_set_handler(slot, &connection->channel_handler));
+    connection->vtable->on_channel_handler_installed(&connection->channel_handler, slot);
+    testing_channel_drain_queued_tasks(testing_channel);
+    return AWS_OP_SUCCESS;
+}
+
+/* Makes one request and waits for its response */
+typedef int(request_round_trip_fn)(void *user_data);
+
+/*
+ * The first request on a new connection is the baseline. It also pays for anything set up lazily,
+ * so warm requests must cost no more than it did.
+ * Two equal runs of warm requests are measured, and the second must cost no more than the first,
+ * so nothing accumulates per request.
+ */
+static int s_check_steady_state(
+    struct allocation_counter *counter,
+    request_round_trip_fn *round_trip,
+    void *user_data) {
+
+    struct allocation_count start = allocation_counter_snapshot(counter);
+    ASSERT_SUCCESS(round_trip(user_data));
+    struct allocation_count first_request = allocation_counter_since(counter, start);
+
+    for (size_t i = 0; i < WARMUP_REQUESTS; ++i) {
+        ASSERT_SUCCESS(round_trip(user_data));
+    }
+
+    struct allocation_count runs[2];
+    for (size_t run = 0; run < AWS_ARRAY_SIZE(runs); ++run) {
+        start = allocation_counter_snapshot(counter);
+        for (size_t i = 0; i < MEASURED_REQUESTS; ++i) {
+            ASSERT_SUCCESS(round_trip(user_data));
+        }
+        runs[run] = allocation_counter_since(counter, start);
+    }
+
+    ASSERT_TRUE(runs[0].allocations <= first_request.allocations * MEASURED_REQUESTS);
+    ASSERT_TRUE(runs[0].bytes <= first_request.bytes * MEASURED_REQUESTS);
+    ASSERT_TRUE(runs[1].allocations <= runs[0].allocations);
+    ASSERT_TRUE(runs[1].bytes <= runs[0].bytes);
+    return AWS_OP_SUCCESS;
+}
+
+struct h1_round_trip {
+    struct testing_channel *testing_channel;
+    struct aws_http_connection *connection;
+    struct aws_http_message *request;
+    struct aws_byte_buf written;
+};
+
+static int s_h1_round_trip(void *user_data) {
+    struct h1_round_trip *h1 = user_data;
+
+    struct request_tester tester = {0};
+    struct aws_http_make_request_options options = {
+        .self_size = sizeof(options),
+        .request = h1->request,
+        .user_data = &tester,
+        .on_complete = s_on_complete,
+    };
+    struct aws_http_stream *stream = aws_http_connection_make_request(h1->connection, &options);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_SUCCESS(aws_http_stream_activate(stream));
+    testing_channel_drain_queued_tasks(h1->testing_channel);
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(
+        h1->testing_channel,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 5\r\n"
+        "\r\n"
+        "hello"));
+    testing_channel_drain_queued_tasks(h1->testing_channel);
+    ASSERT_TRUE(tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, tester.error_code);
+    aws_http_stream_release(stream);
+
+    h1->written.len = 0;
+    ASSERT_SUCCESS(testing_channel_drain_written_messages(h1->testing_channel, &h1->written));
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(allocation_count_h1_client_steady_state) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+    struct allocation_counter counter;
+    allocation_counter_init(&counter, allocator);
+
+    struct testing_channel testing_channel;
+    struct aws_testing_channel_options channel_options = {.clock_fn = aws_high_res_clock_get_ticks};
+    ASSERT_SUCCESS(testing_channel_init(&testing_channel, allocator, &channel_options));
+
+    struct aws_http1_connection_options http1_options;
+    AWS_ZERO_STRUCT(http1_options);
+    struct aws_http_connection *connection = aws_http_connection_new_http1_1_client(
+        &counter.allocator, false /*manual_window_management*/, SIZE_MAX /*initial_window_size*/, &http1_options);
+    ASSERT_NOT_NULL(connection);
+    ASSERT_SUCCESS(s_install_connection(&testing_channel, connection));
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_http_method_get));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/")));
+    ASSERT_SUCCESS(aws_http_message_add_header(request, (struct aws_http_header)DEFINE_HEADER("Host", "example.com")));
+
+    struct h1_round_trip h1 = {
+        .testing_channel = &testing_channel,
+        .connection = connection,
+        .request = request,
+    };
+    ASSERT_SUCCESS(aws_byte_buf_init(&h1.written, allocator, 256));
+
+    ASSERT_SUCCESS(s_check_steady_state(&counter, s_h1_round_trip, &h1));
+
+    aws_byte_buf_clean_up(&h1.written);
+    aws_http_message_release(request);
+    aws_http_connection_release(connection);
+    ASSERT_SUCCESS(testing_channel_clean_up(&testing_channel));
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+struct h2_round_trip {
+    struct testing_channel *testing_channel;
+    struct aws_http_connection *connection;
+    struct h2_fake_peer *peer;
+    struct aws_http_message *request;
+    struct aws_http_headers *response_headers;
+};
+
+static int s_h2_round_trip(void *user_data) {
+    struct h2_round_trip *h2 = user_data;
+
+    struct request_tester tester = {0};
+    struct aws_http_make_request_options options = {
+        .self_size = sizeof(options),
+        .request = h2->request,
+        .user_data = &tester,
+        .on_complete = s_on_complete,
+    };
+    struct aws_http_stream *stream = aws_http_connection_make_request(h2->connection, &options);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_SUCCESS(aws_http_stream_activate(stream));
+    testing_channel_drain_queued_tasks(h2->testing_channel);
+    uint32_t stream_id = aws_http_stream_get_id(stream);
+
+    struct aws_h2_frame *headers_frame =
+        aws_h2_frame_new_headers(h2->peer->alloc, stream_id, h2->response_headers, false /*end_stream*/, 0, NULL);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(h2->peer, headers_frame));
+    ASSERT_SUCCESS(h2_fake_peer_send_data_frame_str(h2->peer, stream_id, "hello", true /*end_stream*/));
+    testing_channel_drain_queued_tasks(h2->testing_channel);
+    ASSERT_TRUE(tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, tester.error_code);
+    aws_http_stream_release(stream);
+
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(h2->peer));
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(allocation_count_h2_client_steady_state) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+    struct allocation_counter counter;
+    allocation_counter_init(&counter, allocator);
+
+    struct testing_channel testing_channel;
+    struct aws_testing_channel_options channel_options = {.clock_fn = aws_high_res_clock_get_ticks};
+    ASSERT_SUCCESS(testing_channel_init(&testing_channel, allocator, &channel_options));
+
+    struct aws_http2_connection_options http2_options = {
+        .max_closed_streams = AWS_HTTP2_DEFAULT_MAX_CLOSED_STREAMS,
+    };
+    struct aws_http_connection *connection =
+        aws_http_connection_new_http2_client(&counter.allocator, false /*manual_window_management*/, &http2_options);
+    ASSERT_NOT_NULL(connection);
+    ASSERT_SUCCESS(s_install_connection(&testing_channel, connection));
+
+    struct h2_fake_peer peer;
+    struct h2_fake_peer_options peer_options = {
+        .alloc = allocator,
+        .testing_channel = &testing_channel,
+        .is_server = true,
+    };
+    ASSERT_SUCCESS(h2_fake_peer_init(&peer, &peer_options));
+    testing_channel_drain_queued_tasks(&testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&peer));
+    testing_channel_drain_queued_tasks(&testing_channel);
+
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+        DEFINE_HEADER(":authority", "example.com"),
+    };
+    ASSERT_SUCCESS(
+        aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src)));
+
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+        DEFINE_HEADER("content-length", "5"),
+    };
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(response_headers);
+    ASSERT_SUCCESS(
+        aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src)));
+
+    struct h2_round_trip h2 = {
+        .testing_channel = &testing_channel,
+        .connection = connection,
+        .peer = &peer,
+        .request = request,
+        .response_headers = response_headers,
+    };
+    ASSERT_SUCCESS(s_check_steady_state(&counter, s_h2_round_trip, &h2));
+
+    aws_http_headers_release(response_headers);
+    aws_http_message_release(request);
+    h2_fake_peer_clean_up(&peer);
+    aws_http_connection_release(connection);
+    ASSERT_SUCCESS(testing_channel_clean_up(&testing_channel));
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/async_body_stream.h>
+
+#include <aws/io/async_stream.h>
+#include <aws/io/future.h>
+#include <aws/io/stream.h>
+#include <aws/testing/aws_test_harness.h>
+
+/* Async stream whose reads complete only when the test says so */
+struct manual_async_stream {
+    struct aws_async_input_stream base;
+    struct aws_byte_buf *pending_dest;
+    struct aws_future_bool *pending_future;
+};
+
+static void s_manual_async_stream_destroy(struct aws_async_input_stream *stream) {
+    struct manual_async_stream *impl = stream->impl;
+    AWS_FATAL_ASSERT(impl->pending_future == NULL);
+    aws_mem_release(stream->alloc, impl);
+}
+
+static struct aws_future_bool *s_manual_async_stream_read(
+    struct aws_async_input_stream *stream,
+    struct aws_byte_buf *dest) {
+
+    struct manual_async_stream *impl = stream->impl;
+    AWS_FATAL_ASSERT(impl->pending_future == NULL);
+    impl->pending_dest = dest;
+    impl->pending_future = aws_future_bool_new(stream->alloc);
+    return aws_future_bool_acquire(impl->pending_future);
+}
+
+static const struct aws_async_input_stream_vtable s_manual_async_stream_vtable = {
+    .destroy = s_manual_async_stream_destroy,
+    .read = s_manual_async_stream_read,
+};
+
+static struct manual_async_stream *s_manual_async_stream_new(struct aws_allocator *allocator) {
+    struct manual_async_stream *impl = aws_mem_calloc(allocator, 1, sizeof(struct manual_async_stream));
+    aws_async_input_stream_init_base(&impl->base, allocator, &s_manual_async_stream_vtable, impl);
+    return impl;
+}
+
+static void s_manual_async_stream_complete_read(struct manual_async_stream *impl, const char *data, bool eof) {
+    AWS_FATAL_ASSERT(impl->pending_future != NULL);
+    struct aws_byte_cursor cursor = aws_byte_cursor_from_c_str(data);
+    aws_byte_buf_write_from_whole_cursor(impl->pending_dest, cursor);
+    struct aws_future_bool *future = impl->pending_future;
+    impl->pending_future = NULL;
+    impl->pending_dest = NULL;
+    aws_future_bool_set_result(future, eof);
+    aws_future_bool_release(future);
+}
+
+static int s_read_and_check(struct aws_input_stream *stream, const char *expected, bool expected_eof) {
+    uint8_t storage[64];
+    struct aws_byte_buf dest = aws_byte_buf_from_empty_array(storage, sizeof(storage));
+    ASSERT_SUCCESS(aws_input_stream_read(stream, &dest));
+    ASSERT_BIN_ARRAYS_EQUALS(expected, strlen(expected), dest.buffer, dest.len);
+
+    struct aws_stream_status status;
+    ASSERT_SUCCESS(aws_input_stream_get_status(stream, &status));
+    ASSERT_TRUE(status.is_valid);
+    ASSERT_UINT_EQUALS(expected_eof, status.is_end_of_stream);
+    return AWS_OP_SUCCESS;
+}
+
+/* Reading never blocks: while the source's read is in progress, it gives nothing (but isn't end-of-stream) */
+static int s_async_body_stream_reads_ahead_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct manual_async_stream *source = s_manual_async_stream_new(allocator);
+    struct aws_input_stream *body = aws_http_async_body_stream_new(allocator, &source->base, 16);
+    aws_async_input_stream_release(&source->base);
+
+    /* First read starts reading from the source */
+    ASSERT_SUCCESS(s_read_and_check(body, "", false));
+    ASSERT_NOT_NULL(source->pending_future);
+    ASSERT_SUCCESS(s_read_and_check(body, "", false));
+
+    /* Once the read completes, its data comes out, and the next read starts */
+    s_manual_async_stream_complete_read(source, "hello", false);
+    ASSERT_SUCCESS(s_read_and_check(body, "hello", false));
+    ASSERT_NOT_NULL(source->pending_future);
+
+    s_manual_async_stream_complete_read(source, " world", true);
+    ASSERT_SUCCESS(s_read_and_check(body, " world", true));
+    ASSERT_NULL(source->pending_future);
+
+    aws_input_stream_release(body);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(async_body_stream_reads_ahead, s_async_body_stream_reads_ahead_fn)
+
+/* Releasing the stream mid-read must wait for the source to finish writing into its buffer */
+static int s_async_body_stream_release_during_read_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct manual_async_stream *source = s_manual_async_stream_new(allocator);
+    aws_async_input_stream_acquire(&source->base);
+    struct aws_input_stream *body = aws_http_async_body_stream_new(allocator, &source->base, 16);
+
+    ASSERT_SUCCESS(s_read_and_check(body, "", false));
+    aws_input_stream_release(body);
+
+    s_manual_async_stream_complete_read(source, "late", false);
+    aws_async_input_stream_release(&source->base);
+
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(async_body_stream_release_during_read, s_async_body_stream_release_during_read_fn)
@@ -45,6 +45,12 @@ struct tester_options {
     bool no_connection; /* don't connect server to client */
     bool pin_event_loop;
     bool use_tcp; /* otherwise uses domain sockets */
+    bool listener_per_event_loop;
+    const struct aws_http_server_admission_options *admission_options;
+    bool http2_prior_knowledge; /* cleartext HTTP/2 client, server accepts it */
+    const char *client_host_name; /* TCP only, instead of the server's address */
+    uint64_t connection_attempt_delay_ms;
+    const struct aws_http2_connection_options *client_http2_options;
 };
 
 /* Singleton used by tests in this file */
@@ -80,6 +86,10 @@ struct tester {
 
     enum aws_http_version connection_version;
 
+    /* From the client's on_initial_settings_completed */
+    int client_initial_settings_completed;
+    void *client_initial_settings_user_data;
+
     /* Tls context */
     struct aws_tls_ctx_options server_ctx_options;
     struct aws_tls_ctx_options client_ctx_options;
@@ -363,6 +373,9 @@ static int s_tester_init(struct tester *tester, const struct tester_options *opt
     server_options.server_user_data = tester;
     server_options.on_incoming_connection = s_tester_on_server_connection_setup;
     server_options.on_destroy_complete = s_tester_http_server_on_destroy;
+    server_options.listener_per_event_loop = options->listener_per_event_loop;
+    server_options.admission_options = options->admission_options;
+    server_options.accept_http2_prior_knowledge = options->http2_prior_knowledge;
     if (options->tls) {
         ASSERT_SUCCESS(s_tls_server_opt_tester_init(
             tester, options->server_alpn_list ? options->server_alpn_list : "h2;http/1.1"));
@@ -396,6 +409,13 @@ static int s_tester_init(struct tester *tester, const struct tester_options *opt
         client_options.tls_options = &tester->client_tls_connection_options;
     }
 
+    client_options.prior_knowledge_http2 = options->http2_prior_knowledge;
+    client_options.connection_attempt_delay_ms = options->connection_attempt_delay_ms;
+    client_options.http2_options = options->client_http2_options;
+    if (options->client_host_name) {
+        client_options.host_name = aws_byte_cursor_from_c_str(options->client_host_name);
+    }
+
     if (options->pin_event_loop) {
         client_options.requested_event_loop = aws_event_loop_group_get_next_loop(tester->client_event_loop_group);
     }
@@ -505,6 +525,113 @@ static int s_test_connection_setup_shutdown(struct aws_allocator *allocator, voi
 }
 AWS_TEST_CASE(connection_setup_shutdown, s_test_connection_setup_shutdown);
 
+/* With racing on, "localhost" may resolve to an IPv6 address nobody listens on. The IPv4 one must win anyway */
+static int s_test_connection_setup_shutdown_race(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct tester_options options = {
+        .alloc = allocator,
+        .use_tcp = true,
+        .client_host_name = "localhost",
+        .connection_attempt_delay_ms = 50,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, &options));
+    ASSERT_INT_EQUALS(1, tester.client_connection_num);
+
+    release_all_client_connections(&tester);
+    release_all_server_connections(&tester);
+    ASSERT_SUCCESS(s_tester_wait(&tester, s_tester_connection_shutdown_pred));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(connection_setup_shutdown_race, s_test_connection_setup_shutdown_race);
+
+static void s_tester_on_client_initial_settings_completed(
+    struct aws_http_connection *http2_connection,
+    int error_code,
+    void *user_data) {
+
+    (void)http2_connection;
+    (void)error_code;
+    /* Were the race passed on instead of the tester, the test would crash here or fail its check */
+    struct tester *tester = user_data;
+    AWS_FATAL_ASSERT(aws_mutex_lock(&tester->wait_lock) == AWS_OP_SUCCESS);
+    tester->client_initial_settings_completed++;
+    tester->client_initial_settings_user_data = user_data;
+    AWS_FATAL_ASSERT(aws_mutex_unlock(&tester->wait_lock) == AWS_OP_SUCCESS);
+    aws_condition_variable_notify_one(&tester->wait_cvar);
+}
+
+static bool s_tester_client_initial_settings_completed_pred(void *user_data) {
+    struct tester *tester = user_data;
+    return tester->client_initial_settings_completed > 0;
+}
+
+/* The HTTP/2 callbacks of a raced connection get the user's user_data, not the race's */
+static int s_test_connection_setup_shutdown_race_http2(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct aws_http2_connection_options http2_options = {
+        .on_initial_settings_completed = s_tester_on_client_initial_settings_completed,
+    };
+    struct tester_options options = {
+        .alloc = allocator,
+        .use_tcp = true,
+        .client_host_name = "localhost",
+        .connection_attempt_delay_ms = 50,
+        .http2_prior_knowledge = true,
+        .client_http2_options = &http2_options,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, &options));
+    ASSERT_INT_EQUALS(1, tester.client_connection_num);
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_2, aws_http_connection_get_version(tester.client_connections[0]));
+
+    /* The server acknowledges the client's settings */
+    ASSERT_SUCCESS(s_tester_wait(&tester, s_tester_client_initial_settings_completed_pred));
+    ASSERT_INT_EQUALS(1, tester.client_initial_settings_completed);
+    ASSERT_PTR_EQUALS(&tester, tester.client_initial_settings_user_data);
+
+    release_all_client_connections(&tester);
+    release_all_server_connections(&tester);
+    ASSERT_SUCCESS(s_tester_wait(&tester, s_tester_connection_shutdown_pred));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(connection_setup_shutdown_race_http2, s_test_connection_setup_shutdown_race_http2);
+
+static int s_test_connection_setup_metrics(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct tester_options options = {
+        .alloc = allocator,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, &options));
+
+    struct aws_http_connection_setup_metrics metrics;
+    ASSERT_SUCCESS(aws_http_connection_get_setup_metrics(tester.client_connections[0], &metrics));
+    ASSERT_TRUE(metrics.connect_start_timestamp_ns >= 0);
+    ASSERT_TRUE(metrics.socket_connected_timestamp_ns >= metrics.connect_start_timestamp_ns);
+    ASSERT_TRUE(metrics.setup_complete_timestamp_ns >= metrics.socket_connected_timestamp_ns);
+    ASSERT_INT_EQUALS(
+        metrics.socket_connected_timestamp_ns - metrics.connect_start_timestamp_ns, metrics.connect_duration_ns);
+    /* No TLS */
+    ASSERT_INT_EQUALS(-1, metrics.tls_negotiation_duration_ns);
+
+    /* Server connections aren't set up by this side */
+    ASSERT_FAILS(aws_http_connection_get_setup_metrics(tester.server_connections[0], &metrics));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_STATE, aws_last_error());
+
+    release_all_client_connections(&tester);
+    release_all_server_connections(&tester);
+    ASSERT_SUCCESS(s_tester_wait(&tester, s_tester_connection_shutdown_pred));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(connection_setup_metrics, s_test_connection_setup_metrics);
+
 static int s_test_connection_setup_shutdown_tls(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
 
@@ -995,3 +1122,85 @@ static int s_test_connection_setup_shutdown_pinned_event_loop(struct aws_allocat
     return AWS_OP_SUCCESS;
 }
 AWS_TEST_CASE(connection_setup_shutdown_pinned_event_loop, s_test_connection_setup_shutdown_pinned_event_loop);
+
+static int s_test_connection_setup_shutdown_listener_per_event_loop(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+#ifdef _WIN32 /* no SO_REUSEPORT */
+    return AWS_OP_SUCCESS;
+#endif
+    struct tester_options options = {
+        .alloc = allocator,
+        .use_tcp = true,
+        .listener_per_event_loop = true,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, &options));
+
+    /* the connection lives on the event loop that accepted it */
+    ASSERT_INT_EQUALS(1, tester.server_connection_num);
+    ASSERT_PTR_EQUALS(
+        aws_event_loop_group_get_loop_at(tester.server_event_loop_group, 0),
+        aws_channel_get_event_loop(tester.server_connections[0]->channel_slot->channel));
+
+    release_all_client_connections(&tester);
+    release_all_server_connections(&tester);
+    ASSERT_SUCCESS(s_tester_wait(&tester, s_tester_connection_shutdown_pred));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(
+    connection_setup_shutdown_listener_per_event_loop,
+    s_test_connection_setup_shutdown_listener_per_event_loop);
+
+static int s_test_connection_setup_shutdown_with_admission_control(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct aws_http_server_admission_options admission_options = {
+        .max_connections = 1,
+        .max_in_flight_streams = 1,
+        .max_event_loop_lag_ms = 1000,
+        .retry_after_sec = 1,
+    };
+    struct tester_options options = {
+        .alloc = allocator,
+        .admission_options = &admission_options,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, &options));
+
+    /* the one connection allowed was admitted */
+    ASSERT_INT_EQUALS(1, tester.server_connection_num);
+
+    release_all_client_connections(&tester);
+    release_all_server_connections(&tester);
+    ASSERT_SUCCESS(s_tester_wait(&tester, s_tester_connection_shutdown_pred));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(
+    connection_setup_shutdown_with_admission_control,
+    s_test_connection_setup_shutdown_with_admission_control);
+
+static int s_test_connection_setup_shutdown_http2_prior_knowledge(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct tester_options options = {
+        .alloc = allocator,
+        .http2_prior_knowledge = true,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, &options));
+
+    /* the server recognized the client's connection preface */
+    ASSERT_INT_EQUALS(1, tester.server_connection_num);
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_2, aws_http_connection_get_version(tester.server_connections[0]));
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_2, aws_http_connection_get_version(tester.client_connections[0]));
+
+    release_all_client_connections(&tester);
+    release_all_server_connections(&tester);
+    ASSERT_SUCCESS(s_tester_wait(&tester, s_tester_connection_shutdown_pred));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(connection_setup_shutdown_http2_prior_knowledge, s_test_connection_setup_shutdown_http2_prior_knowledge);
@@ -5,6 +5,8 @@
 
 #include <aws/testing/aws_test_harness.h>
 
+#include "allocation_counter.h"
+
 #include <aws/common/array_list.h>
 #include <aws/common/clock.h>
 #include <aws/common/condition_variable.h>
@@ -19,6 +21,7 @@
 #include <aws/http/private/connection_manager_system_vtable.h>
 #include <aws/http/proxy.h>
 #include <aws/http/server.h>
+#include <aws/io/channel.h>
 #include <aws/io/channel_bootstrap.h>
 #include <aws/io/event_loop.h>
 #include <aws/io/socket.h>
@@ -42,6 +45,10 @@ enum new_connection_result_type {
 struct mock_connection {
     enum new_connection_result_type result;
     bool is_closed_on_release;
+    uint32_t health_score;
+    void *user_data;
+    /* The host_name the connection was made to */
+    char host_name[64];
 };
 
 struct cm_tester_options {
@@ -58,6 +65,15 @@ struct cm_tester_options {
     struct aws_http2_setting *initial_settings_array;
     size_t num_initial_settings;
     bool self_lib_init;
+    bool enable_sharding;
+    /* Default is 1 */
+    uint16_t event_loop_count;
+    size_t min_idle_connections;
+    size_t max_concurrent_proxy_negotiations;
+    uint64_t adaptive_culling_window_in_ms;
+    uint64_t surplus_connection_idle_in_ms;
+    bool enable_multi_address;
+    uint32_t degraded_health_score;
 };
 
 struct cm_tester {
@@ -90,6 +106,11 @@ struct cm_tester {
     struct aws_array_list mock_connections;
     aws_http_on_client_connection_shutdown_fn *release_connection_fn;
 
+    /* Connection attempts held open by the deferred mock, until the test completes them */
+    aws_http_on_client_connection_setup_fn *deferred_on_setup[8];
+    void *deferred_user_data[8];
+    size_t deferred_connect_count;
+
     struct aws_mutex mock_time_lock;
     uint64_t mock_time;
 
@@ -158,7 +179,9 @@ static int s_cm_tester_init(struct cm_tester_options *options) {
         clock_fn = options->mock_table->aws_high_res_clock_get_ticks;
     }
 
-    tester->event_loop_group = aws_event_loop_group_new(tester->allocator, clock_fn, 1, s_new_event_loop, NULL, NULL);
+    uint16_t el_count = options->event_loop_count ? options->event_loop_count : 1;
+    tester->event_loop_group =
+        aws_event_loop_group_new(tester->allocator, clock_fn, el_count, s_new_event_loop, NULL, NULL);
 
     struct aws_host_resolver_default_options resolver_options = {
         .el_group = tester->event_loop_group,
@@ -203,6 +226,12 @@ static int s_cm_tester_init(struct cm_tester_options *options) {
         tester->proxy_ev_settings.tls_options = &default_tls_connection_options;
     }
 
+    struct aws_http_connection_monitoring_options monitoring_options = {
+        .minimum_throughput_bytes_per_second = 1,
+        .allowable_throughput_failure_interval_seconds = 1,
+        .degraded_health_score = options->degraded_health_score,
+    };
+
     struct aws_http_connection_manager_options cm_options = {
         .bootstrap = tester->client_bootstrap,
         .initial_window_size = SIZE_MAX,
@@ -219,6 +248,13 @@ static int s_cm_tester_init(struct cm_tester_options *options) {
         .http2_prior_knowledge = !options->use_tls && options->http2,
         .initial_settings_array = options->initial_settings_array,
         .num_initial_settings = options->num_initial_settings,
+        .enable_sharding = options->enable_sharding,
+        .min_idle_connections = options->min_idle_connections,
+        .max_concurrent_proxy_negotiations = options->max_concurrent_proxy_negotiations,
+        .adaptive_culling_window_in_milliseconds = options->adaptive_culling_window_in_ms,
+        .surplus_connection_idle_in_milliseconds = options->surplus_connection_idle_in_ms,
+        .enable_multi_address = options->enable_multi_address,
+        .monitoring_options = options->degraded_health_score ? &monitoring_options : NULL,
     };
 
     if (options->mock_table) {
@@ -252,6 +288,7 @@ static void s_add_mock_connections(size_t count, enum new_connection_result_type
 
         mock->result = result;
         mock->is_closed_on_release = closed_on_release;
+        mock->health_score = AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX;
 
         aws_array_list_push_back(&tester->mock_connections, &mock);
     }
@@ -725,6 +762,112 @@ static int s_test_connection_manager_acquire_release_mix(struct aws_allocator *a
 }
 AWS_TEST_CASE(test_connection_manager_acquire_release_mix, s_test_connection_manager_acquire_release_mix);
 
+static int s_test_connection_manager_sharded_acquire_release_mix(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct cm_tester_options options = {
+        .allocator = allocator,
+        .max_connections = 5,
+        .enable_sharding = true,
+        /* one shard per event loop */
+        .event_loop_count = 4,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+
+    for (size_t i = 0; i < 10; ++i) {
+        s_acquire_connections(2);
+
+        ASSERT_SUCCESS(s_wait_on_connection_reply_count(i + 1));
+
+        ASSERT_SUCCESS(s_release_connections(1, false));
+    }
+
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(15));
+
+    /* The budget is shared by all shards */
+    struct aws_http_manager_metrics metrics;
+    aws_http_connection_manager_fetch_metrics(s_tester.connection_manager, &metrics);
+    ASSERT_TRUE(metrics.leased_concurrency <= 5);
+
+    for (size_t i = 15; i < 20; ++i) {
+        ASSERT_SUCCESS(s_release_connections(1, false));
+
+        ASSERT_SUCCESS(s_wait_on_connection_reply_count(i + 1));
+    }
+    ASSERT_UINT_EQUALS(0, s_tester.connection_errors);
+
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(
+    test_connection_manager_sharded_acquire_release_mix,
+    s_test_connection_manager_sharded_acquire_release_mix);
+
+static void s_acquire_connections_on_event_loop(size_t count, struct aws_event_loop *event_loop) {
+    struct cm_tester *tester = &s_tester;
+
+    struct aws_http_connection_manager_acquire_options acquire_options = {
+        .callback = s_on_acquire_connection,
+        .user_data = tester,
+        .event_loop_affinity = AWS_HTTP_CONNECTION_MANAGER_AFFINITY_REQUIRE,
+        .event_loop = event_loop,
+    };
+    for (size_t i = 0; i < count; ++i) {
+        aws_http_connection_manager_acquire_connection_with_options(tester->connection_manager, &acquire_options);
+    }
+}
+
+static int s_check_connections_on_event_loop(struct aws_event_loop *event_loop) {
+    struct cm_tester *tester = &s_tester;
+
+    ASSERT_SUCCESS(aws_mutex_lock(&tester->lock));
+    for (size_t i = 0; i < aws_array_list_length(&tester->connections); ++i) {
+        struct aws_http_connection *connection = NULL;
+        aws_array_list_get_at(&tester->connections, &connection, i);
+        ASSERT_PTR_EQUALS(event_loop, aws_channel_get_event_loop(aws_http_connection_get_channel(connection)));
+    }
+    ASSERT_SUCCESS(aws_mutex_unlock(&tester->lock));
+    return AWS_OP_SUCCESS;
+}
+
+static int s_test_connection_manager_acquire_event_loop_affinity(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct cm_tester_options options = {
+        .allocator = allocator,
+        .max_connections = 2,
+        .event_loop_count = 4,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+
+    struct aws_event_loop *event_loop = aws_event_loop_group_get_loop_at(s_tester.event_loop_group, 2);
+    s_acquire_connections_on_event_loop(2, event_loop);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(2));
+    ASSERT_SUCCESS(s_check_connections_on_event_loop(event_loop));
+
+    /* Released connections stay idle on their event loop */
+    ASSERT_SUCCESS(s_release_connections(2, false));
+
+    /* The manager is full of idle connections on the wrong event loop, one makes room for the right one */
+    event_loop = aws_event_loop_group_get_loop_at(s_tester.event_loop_group, 3);
+    s_acquire_connections_on_event_loop(1, event_loop);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(3));
+    ASSERT_SUCCESS(s_check_connections_on_event_loop(event_loop));
+
+    ASSERT_UINT_EQUALS(0, s_tester.connection_errors);
+
+    ASSERT_SUCCESS(s_release_connections(1, false));
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(
+    test_connection_manager_acquire_event_loop_affinity,
+    s_test_connection_manager_acquire_event_loop_affinity);
+
 static int s_aws_http_connection_manager_create_connection_sync_mock(
     const struct aws_http_client_connection_options *options) {
     struct cm_tester *tester = &s_tester;
@@ -753,6 +896,9 @@ static int s_aws_http_connection_manager_create_connection_sync_mock(
     }
 
     if (connection) {
+        connection->user_data = options->user_data;
+        size_t host_name_len = aws_min_size(options->host_name.len, sizeof(connection->host_name) - 1);
+        memcpy(connection->host_name, options->host_name.ptr, host_name_len);
         if (connection->result == AWS_NCRT_SUCCESS) {
             options->on_setup((struct aws_http_connection *)connection, AWS_ERROR_SUCCESS, options->user_data);
         } else if (connection->result == AWS_NCRT_ERROR_VIA_CALLBACK) {
@@ -768,11 +914,10 @@ static int s_aws_http_connection_manager_create_connection_sync_mock(
 }
 
 static void s_aws_http_connection_manager_release_connection_sync_mock(struct aws_http_connection *connection) {
-    (void)connection;
-
     struct cm_tester *tester = &s_tester;
+    struct mock_connection *mock_connection = (struct mock_connection *)connection;
 
-    tester->release_connection_fn(connection, AWS_ERROR_SUCCESS, tester->connection_manager);
+    tester->release_connection_fn(connection, AWS_ERROR_SUCCESS, mock_connection->user_data);
 }
 
 static void s_aws_http_connection_manager_close_connection_sync_mock(struct aws_http_connection *connection) {
@@ -860,6 +1005,136 @@ AWS_TEST_CASE(
     test_connection_manager_acquire_release_mix_synchronous,
     s_test_connection_manager_acquire_release_mix_synchronous);
 
+static uint32_t s_aws_http_connection_manager_connection_get_health_score_sync_mock(
+    const struct aws_http_connection *connection) {
+
+    const struct mock_connection *proxy = (const struct mock_connection *)(const void *)connection;
+
+    return proxy->health_score;
+}
+
+static struct aws_http_connection_manager_system_vtable s_health_mocks = {
+    .aws_http_client_connect = s_aws_http_connection_manager_create_connection_sync_mock,
+    .aws_http_connection_release = s_aws_http_connection_manager_release_connection_sync_mock,
+    .aws_http_connection_close = s_aws_http_connection_manager_close_connection_sync_mock,
+    .aws_http_connection_new_requests_allowed = s_aws_http_connection_manager_is_connection_available_sync_mock,
+    .aws_high_res_clock_get_ticks = aws_high_res_clock_get_ticks,
+    .aws_http_connection_get_channel = s_aws_http_connection_manager_connection_get_channel_sync_mock,
+    .aws_channel_thread_is_callers_thread = s_aws_http_connection_manager_is_callers_thread_sync_mock,
+    .aws_http_connection_get_version = s_aws_http_connection_manager_connection_get_version_sync_mock,
+    .aws_http_connection_get_health_score = s_aws_http_connection_manager_connection_get_health_score_sync_mock,
+};
+
+/* Degraded connections are leased only when there's nothing healthier, and recycled on release one at a time */
+static int s_test_connection_manager_degraded_connections(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct cm_tester_options options = {
+        .allocator = allocator,
+        .max_connections = 3,
+        .mock_table = &s_health_mocks,
+        .degraded_health_score = 50,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+
+    s_add_mock_connections(3, AWS_NCRT_SUCCESS, false);
+    s_acquire_connections(3);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(3));
+
+    /* Connections are released from the back, so the healthy one goes first */
+    struct aws_http_connection *connections[3];
+    for (size_t i = 0; i < 3; ++i) {
+        aws_array_list_get_at(&s_tester.connections, &connections[i], i);
+    }
+    ((struct mock_connection *)(void *)connections[0])->health_score = 10;
+    ((struct mock_connection *)(void *)connections[1])->health_score = 10;
+
+    ASSERT_SUCCESS(s_release_connections(3, false));
+
+    /* The first degraded connection was recycled, the second had to wait its turn */
+    struct aws_http_manager_metrics metrics;
+    aws_http_connection_manager_fetch_metrics(s_tester.connection_manager, &metrics);
+    ASSERT_UINT_EQUALS(2, metrics.available_concurrency);
+
+    /* The healthy connection is picked, though the degraded one was idled last */
+    s_acquire_connections(1);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(4));
+    struct aws_http_connection *acquired = NULL;
+    aws_array_list_get_at(&s_tester.connections, &acquired, 0);
+    ASSERT_PTR_EQUALS(connections[2], acquired);
+
+    ASSERT_SUCCESS(s_release_connections(1, false));
+    ASSERT_UINT_EQUALS(0, s_tester.connection_errors);
+
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_connection_manager_degraded_connections, s_test_connection_manager_degraded_connections);
+
+static int s_acquire_release_cycle(size_t cycle_index) {
+    s_acquire_connections(1);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(cycle_index + 1));
+    ASSERT_SUCCESS(s_release_connections(1, false));
+    return AWS_OP_SUCCESS;
+}
+
+/* Reusing an idle connection shouldn't cost more than the first cycle, which also made the connection,
+ * and the cost shouldn't grow as connections keep being reused */
+static int s_test_connection_manager_acquire_release_allocations(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    enum {
+        WARMUP_CYCLES = 10,
+        MEASURED_CYCLES = 100,
+    };
+
+    struct allocation_counter counter;
+    allocation_counter_init(&counter, allocator);
+
+    struct cm_tester_options options = {
+        .allocator = &counter.allocator,
+        .max_connections = 1,
+        .mock_table = &s_synchronous_mocks,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+
+    s_add_mock_connections(1, AWS_NCRT_SUCCESS, false);
+
+    size_t cycle_index = 0;
+    struct allocation_count start = allocation_counter_snapshot(&counter);
+    ASSERT_SUCCESS(s_acquire_release_cycle(cycle_index++));
+    struct allocation_count first_cycle = allocation_counter_since(&counter, start);
+
+    for (size_t i = 0; i < WARMUP_CYCLES; ++i) {
+        ASSERT_SUCCESS(s_acquire_release_cycle(cycle_index++));
+    }
+
+    struct allocation_count runs[2];
+    for (size_t run = 0; run < AWS_ARRAY_SIZE(runs); ++run) {
+        start = allocation_counter_snapshot(&counter);
+        for (size_t i = 0; i < MEASURED_CYCLES; ++i) {
+            ASSERT_SUCCESS(s_acquire_release_cycle(cycle_index++));
+        }
+        runs[run] = allocation_counter_since(&counter, start);
+    }
+
+    ASSERT_TRUE(runs[0].allocations <= first_cycle.allocations * MEASURED_CYCLES);
+    ASSERT_TRUE(runs[0].bytes <= first_cycle.bytes * MEASURED_CYCLES);
+    ASSERT_TRUE(runs[1].allocations <= runs[0].allocations);
+    ASSERT_TRUE(runs[1].bytes <= runs[0].bytes);
+    ASSERT_UINT_EQUALS(0, s_tester.connection_errors);
+
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(
+    test_connection_manager_acquire_release_allocations,
+    s_test_connection_manager_acquire_release_allocations);
+
 static int s_test_connection_manager_connect_callback_failure(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
 
@@ -879,6 +1154,16 @@ static int s_test_connection_manager_connect_callback_failure(struct aws_allocat
 
     ASSERT_TRUE(s_tester.connection_errors == 5);
 
+    /* Every attempt failed the same way, and every acquisition waited for one */
+    struct aws_http_manager_metrics metrics;
+    aws_http_connection_manager_fetch_metrics(s_tester.connection_manager, &metrics);
+    ASSERT_UINT_EQUALS(5, metrics.connect_failure_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_UNKNOWN, metrics.connect_failures[0].error_code);
+    ASSERT_UINT_EQUALS(5, metrics.connect_failures[0].count);
+    ASSERT_UINT_EQUALS(0, metrics.connect_failures[1].count);
+    ASSERT_UINT_EQUALS(5, metrics.acquire_wait.count);
+    ASSERT_UINT_EQUALS(0, metrics.connection_setup.count);
+
     ASSERT_SUCCESS(s_cm_tester_clean_up());
 
     return AWS_OP_SUCCESS;
@@ -933,6 +1218,103 @@ static int s_test_connection_manager_proxy_setup_shutdown(struct aws_allocator *
 }
 AWS_TEST_CASE(test_connection_manager_proxy_setup_shutdown, s_test_connection_manager_proxy_setup_shutdown);
 
+static int s_aws_http_connection_manager_create_connection_deferred_mock(
+    const struct aws_http_client_connection_options *options) {
+    struct cm_tester *tester = &s_tester;
+
+    ASSERT_SUCCESS(aws_mutex_lock(&tester->lock));
+    tester->release_connection_fn = options->on_shutdown;
+    ASSERT_TRUE(tester->deferred_connect_count < AWS_ARRAY_SIZE(tester->deferred_on_setup));
+    tester->deferred_on_setup[tester->deferred_connect_count] = options->on_setup;
+    tester->deferred_user_data[tester->deferred_connect_count] = options->user_data;
+    ++tester->deferred_connect_count;
+    ASSERT_SUCCESS(aws_mutex_unlock(&tester->lock));
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Finish a connection attempt held open by the deferred mock, with the next mock connection */
+static int s_complete_deferred_connect(size_t index) {
+    struct cm_tester *tester = &s_tester;
+
+    size_t next_connection_id = aws_atomic_fetch_add(&tester->next_connection_id, 1);
+    struct mock_connection *connection = NULL;
+    ASSERT_SUCCESS(aws_array_list_get_at(&tester->mock_connections, &connection, next_connection_id));
+
+    ASSERT_SUCCESS(aws_mutex_lock(&tester->lock));
+    ASSERT_TRUE(index < tester->deferred_connect_count);
+    aws_http_on_client_connection_setup_fn *on_setup = tester->deferred_on_setup[index];
+    connection->user_data = tester->deferred_user_data[index];
+    ASSERT_SUCCESS(aws_mutex_unlock(&tester->lock));
+
+    on_setup((struct aws_http_connection *)connection, AWS_ERROR_SUCCESS, connection->user_data);
+    return AWS_OP_SUCCESS;
+}
+
+static size_t s_get_deferred_connect_count(void) {
+    aws_mutex_lock(&s_tester.lock);
+    size_t count = s_tester.deferred_connect_count;
+    aws_mutex_unlock(&s_tester.lock);
+    return count;
+}
+
+static struct aws_http_connection_manager_system_vtable s_deferred_mocks = {
+    .aws_http_client_connect = s_aws_http_connection_manager_create_connection_deferred_mock,
+    .aws_http_connection_release = s_aws_http_connection_manager_release_connection_sync_mock,
+    .aws_http_connection_close = s_aws_http_connection_manager_close_connection_sync_mock,
+    .aws_http_connection_new_requests_allowed = s_aws_http_connection_manager_is_connection_available_sync_mock,
+    .aws_high_res_clock_get_ticks = aws_high_res_clock_get_ticks,
+    .aws_http_connection_get_channel = s_aws_http_connection_manager_connection_get_channel_sync_mock,
+    .aws_channel_thread_is_callers_thread = s_aws_http_connection_manager_is_callers_thread_sync_mock,
+    .aws_http_connection_get_version = s_aws_http_connection_manager_connection_get_version_sync_mock,
+};
+
+static int s_test_connection_manager_max_concurrent_proxy_negotiations(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_http_proxy_options proxy_options = {
+        .host = aws_byte_cursor_from_c_str("127.0.0.1"),
+        .port = 3280,
+        .connection_type = AWS_HPCT_HTTP_TUNNEL,
+    };
+
+    struct cm_tester_options options = {
+        .allocator = allocator,
+        .max_connections = 4,
+        .mock_table = &s_deferred_mocks,
+        .proxy_options = &proxy_options,
+        .max_concurrent_proxy_negotiations = 2,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+    s_add_mock_connections(4, AWS_NCRT_SUCCESS, false);
+
+    /* A burst of acquisitions only has 2 tunnels negotiating at once */
+    s_acquire_connections(4);
+    ASSERT_UINT_EQUALS(2, s_get_deferred_connect_count());
+
+    /* Each tunnel that's set up lets another start */
+    ASSERT_SUCCESS(s_complete_deferred_connect(0));
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(1));
+    ASSERT_UINT_EQUALS(3, s_get_deferred_connect_count());
+
+    ASSERT_SUCCESS(s_complete_deferred_connect(1));
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(2));
+    ASSERT_UINT_EQUALS(4, s_get_deferred_connect_count());
+
+    ASSERT_SUCCESS(s_complete_deferred_connect(2));
+    ASSERT_SUCCESS(s_complete_deferred_connect(3));
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(4));
+    ASSERT_UINT_EQUALS(0, s_tester.connection_errors);
+
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(
+    test_connection_manager_max_concurrent_proxy_negotiations,
+    s_test_connection_manager_max_concurrent_proxy_negotiations);
+
 static struct aws_http_connection_manager_system_vtable s_idle_mocks = {
     .aws_http_client_connect = s_aws_http_connection_manager_create_connection_sync_mock,
     .aws_http_connection_release = s_aws_http_connection_manager_release_connection_sync_mock,
@@ -1198,6 +1580,270 @@ static int s_test_connection_manager_idle_culling_refcount(struct aws_allocator
 
 AWS_TEST_CASE(test_connection_manager_idle_culling_refcount, s_test_connection_manager_idle_culling_refcount);
 
+static int s_test_connection_manager_min_idle_connections(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    uint64_t one_sec_in_nanos = aws_timestamp_convert(1, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+    struct cm_tester_options options = {
+        .allocator = allocator,
+        .max_connections = 3,
+        .mock_table = &s_idle_mocks,
+        .max_connection_idle_in_ms = 1000,
+        .min_idle_connections = 2,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+
+    /* The manager tried to warm up before there were any mock connections, move past the backoff */
+    s_add_mock_connections(8, AWS_NCRT_SUCCESS, false);
+    s_tester_set_mock_time(one_sec_in_nanos);
+
+    s_acquire_connections(1);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(1));
+
+    /* Two more were opened in the background, to be idle */
+    struct aws_http_manager_metrics metrics;
+    aws_http_connection_manager_fetch_metrics(s_tester.connection_manager, &metrics);
+    ASSERT_UINT_EQUALS(2, metrics.available_concurrency);
+    ASSERT_UINT_EQUALS(1, metrics.leased_concurrency);
+
+    s_release_connections(1, false);
+    aws_http_connection_manager_fetch_metrics(s_tester.connection_manager, &metrics);
+    ASSERT_UINT_EQUALS(3, metrics.available_concurrency);
+
+    /* Culling stops at min_idle_connections */
+    s_tester_set_mock_time(3 * one_sec_in_nanos);
+    aws_thread_current_sleep(2 * one_sec_in_nanos);
+    aws_http_connection_manager_fetch_metrics(s_tester.connection_manager, &metrics);
+    ASSERT_UINT_EQUALS(2, metrics.available_concurrency);
+
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_connection_manager_min_idle_connections, s_test_connection_manager_min_idle_connections);
+
+static int s_test_connection_manager_adaptive_idle_culling(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    uint64_t one_sec_in_nanos = aws_timestamp_convert(1, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+    struct cm_tester_options options = {
+        .allocator = allocator,
+        .max_connections = 4,
+        .mock_table = &s_idle_mocks,
+        .max_connection_idle_in_ms = 10000,
+        .adaptive_culling_window_in_ms = 1000,
+        .surplus_connection_idle_in_ms = 500,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+
+    s_add_mock_connections(4, AWS_NCRT_SUCCESS, false);
+
+    s_acquire_connections(4);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(4));
+    s_release_connections(4, false);
+
+    /* The peak of 4 is still in the window, so the surplus timeout doesn't apply */
+    struct aws_http_manager_metrics metrics;
+    s_tester_set_mock_time(one_sec_in_nanos * 6 / 10);
+    aws_thread_current_sleep(one_sec_in_nanos);
+    aws_http_connection_manager_fetch_metrics(s_tester.connection_manager, &metrics);
+    ASSERT_UINT_EQUALS(4, metrics.available_concurrency);
+
+    /* Once the peak leaves the window, they're all surplus, long before the regular idle timeout */
+    s_tester_set_mock_time(2 * one_sec_in_nanos);
+    aws_thread_current_sleep(one_sec_in_nanos);
+    aws_http_connection_manager_fetch_metrics(s_tester.connection_manager, &metrics);
+    ASSERT_UINT_EQUALS(0, metrics.available_concurrency);
+
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_connection_manager_adaptive_idle_culling, s_test_connection_manager_adaptive_idle_culling);
+
+static const char *s_mock_host_addresses[] = {"10.0.0.1", "10.0.0.2"};
+
+static int s_aws_host_resolver_resolve_host_mock(
+    struct aws_host_resolver *resolver,
+    const struct aws_string *host_name,
+    aws_on_host_resolved_result_fn *res,
+    const struct aws_host_resolution_config *config,
+    void *user_data) {
+    (void)config;
+
+    struct cm_tester *tester = &s_tester;
+    struct aws_array_list host_addresses;
+    aws_array_list_init_dynamic(
+        &host_addresses, tester->allocator, AWS_ARRAY_SIZE(s_mock_host_addresses), sizeof(struct aws_host_address));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(s_mock_host_addresses); ++i) {
+        struct aws_host_address host_address;
+        AWS_ZERO_STRUCT(host_address);
+        host_address.allocator = tester->allocator;
+        host_address.host = host_name;
+        host_address.address = aws_string_new_from_c_str(tester->allocator, s_mock_host_addresses[i]);
+        aws_array_list_push_back(&host_addresses, &host_address);
+    }
+
+    res(resolver, host_name, AWS_ERROR_SUCCESS, &host_addresses, user_data);
+
+    for (size_t i = 0; i < aws_array_list_length(&host_addresses); ++i) {
+        struct aws_host_address *host_address = NULL;
+        aws_array_list_get_at_ptr(&host_addresses, (void **)&host_address, i);
+        aws_string_destroy((struct aws_string *)host_address->address);
+    }
+    aws_array_list_clean_up(&host_addresses);
+
+    return AWS_OP_SUCCESS;
+}
+
+static struct aws_http_connection_manager_system_vtable s_multi_address_mocks = {
+    .aws_http_client_connect = s_aws_http_connection_manager_create_connection_sync_mock,
+    .aws_http_connection_release = s_aws_http_connection_manager_release_connection_sync_mock,
+    .aws_http_connection_close = s_aws_http_connection_manager_close_connection_sync_mock,
+    .aws_http_connection_new_requests_allowed = s_aws_http_connection_manager_is_connection_available_sync_mock,
+    .aws_high_res_clock_get_ticks = s_tester_get_mock_time,
+    .aws_http_connection_get_channel = s_aws_http_connection_manager_connection_get_channel_sync_mock,
+    .aws_channel_thread_is_callers_thread = s_aws_http_connection_manager_is_callers_thread_sync_mock,
+    .aws_http_connection_get_version = s_aws_http_connection_manager_connection_get_version_sync_mock,
+    .aws_host_resolver_resolve_host = s_aws_host_resolver_resolve_host_mock,
+};
+
+static const char *s_mock_connection_host_name(size_t index) {
+    struct mock_connection *connection = NULL;
+    aws_array_list_get_at(&s_tester.mock_connections, &connection, index);
+    return connection->host_name;
+}
+
+static int s_test_connection_manager_multi_address(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct cm_tester_options options = {
+        .allocator = allocator,
+        .max_connections = 5,
+        .mock_table = &s_multi_address_mocks,
+        .enable_multi_address = true,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+
+    s_add_mock_connections(1, AWS_NCRT_ERROR_VIA_CALLBACK, false);
+    s_add_mock_connections(3, AWS_NCRT_SUCCESS, false);
+
+    /* The first address fails, and backs off */
+    s_acquire_connections(2);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(2));
+    ASSERT_UINT_EQUALS(1, s_tester.connection_errors);
+    ASSERT_STR_EQUALS("10.0.0.1", s_mock_connection_host_name(0));
+    ASSERT_STR_EQUALS("10.0.0.2", s_mock_connection_host_name(1));
+
+    /* Still backed off, so the second address gets another one */
+    s_acquire_connections(1);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(3));
+    ASSERT_STR_EQUALS("10.0.0.2", s_mock_connection_host_name(2));
+
+    /* Once the backoff is over, the first address has the fewest connections */
+    s_tester_set_mock_time(aws_timestamp_convert(1, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL));
+    s_acquire_connections(1);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(4));
+    ASSERT_STR_EQUALS("10.0.0.1", s_mock_connection_host_name(3));
+
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_connection_manager_multi_address, s_test_connection_manager_multi_address);
+
+/* The order prioritized acquisitions completed in, by tag, and how */
+struct prioritized_acquisition_results {
+    size_t tags[4];
+    int error_codes[4];
+    size_t count;
+};
+
+static struct prioritized_acquisition_results s_prioritized_results;
+
+static void s_on_acquire_prioritized_connection(
+    struct aws_http_connection *connection,
+    int error_code,
+    void *user_data) {
+
+    AWS_FATAL_ASSERT(aws_mutex_lock(&s_tester.lock) == AWS_OP_SUCCESS);
+    AWS_FATAL_ASSERT(s_prioritized_results.count < AWS_ARRAY_SIZE(s_prioritized_results.tags));
+    s_prioritized_results.tags[s_prioritized_results.count] = (size_t)(uintptr_t)user_data;
+    s_prioritized_results.error_codes[s_prioritized_results.count] = error_code;
+    ++s_prioritized_results.count;
+    AWS_FATAL_ASSERT(aws_mutex_unlock(&s_tester.lock) == AWS_OP_SUCCESS);
+
+    s_on_acquire_connection(connection, error_code, user_data);
+}
+
+static void s_acquire_prioritized_connection(
+    size_t tag,
+    enum aws_http_connection_manager_acquisition_priority priority,
+    uint64_t acquisition_timeout_ms) {
+
+    struct aws_http_connection_manager_acquire_options acquire_options = {
+        .callback = s_on_acquire_prioritized_connection,
+        .user_data = (void *)(uintptr_t)tag,
+        .priority = priority,
+        .acquisition_timeout_ms = acquisition_timeout_ms,
+    };
+    aws_http_connection_manager_acquire_connection_with_options(s_tester.connection_manager, &acquire_options);
+}
+
+static int s_test_connection_manager_acquisition_priority_and_timeout(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct cm_tester_options options = {
+        .allocator = allocator,
+        .max_connections = 1,
+        .mock_table = &s_idle_mocks,
+    };
+
+    ASSERT_SUCCESS(s_cm_tester_init(&options));
+    AWS_ZERO_STRUCT(s_prioritized_results);
+
+    s_add_mock_connections(1, AWS_NCRT_SUCCESS, false);
+
+    /* Saturate the pool, so the rest have to wait */
+    s_acquire_connections(1);
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(1));
+
+    s_acquire_prioritized_connection(1, AWS_HTTP_CONNECTION_MANAGER_PRIORITY_LOW, 0);
+    s_acquire_prioritized_connection(2, AWS_HTTP_CONNECTION_MANAGER_PRIORITY_NORMAL, 500);
+    s_acquire_prioritized_connection(3, AWS_HTTP_CONNECTION_MANAGER_PRIORITY_HIGH, 0);
+
+    /* The one with a timeout fails once it runs out, without waiting on a connection */
+    s_tester_set_mock_time(aws_timestamp_convert(1, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL));
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(2));
+    ASSERT_UINT_EQUALS(1, s_prioritized_results.count);
+    ASSERT_UINT_EQUALS(2, s_prioritized_results.tags[0]);
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_CONNECTION_MANAGER_ACQUISITION_TIMEOUT, s_prioritized_results.error_codes[0]);
+
+    /* High priority goes first, though it was made last */
+    ASSERT_SUCCESS(s_release_connections(1, false));
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(3));
+    ASSERT_SUCCESS(s_release_connections(1, false));
+    ASSERT_SUCCESS(s_wait_on_connection_reply_count(4));
+
+    ASSERT_UINT_EQUALS(3, s_prioritized_results.count);
+    ASSERT_UINT_EQUALS(3, s_prioritized_results.tags[1]);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, s_prioritized_results.error_codes[1]);
+    ASSERT_UINT_EQUALS(1, s_prioritized_results.tags[2]);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, s_prioritized_results.error_codes[2]);
+
+    ASSERT_SUCCESS(s_cm_tester_clean_up());
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(
+    test_connection_manager_acquisition_priority_and_timeout,
+    s_test_connection_manager_acquisition_priority_and_timeout);
+
 /**
  * Proxy integration tests. Maybe we should move this to another file. But let's do it later. Someday.
  * AWS_TEST_HTTP_PROXY_HOST - host address of the proxy to use for tests that make open connections to the proxy
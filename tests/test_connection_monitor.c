@@ -1522,3 +1522,193 @@ static int s_test_http_stats_multiple_requests_with_gap(struct aws_allocator *al
     return AWS_OP_SUCCESS;
 }
 AWS_TEST_CASE(test_http_stats_multiple_requests_with_gap, s_test_http_stats_multiple_requests_with_gap);
+
+static int s_test_http_latency_histogram_percentiles(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_http_latency_histogram histogram;
+    AWS_ZERO_STRUCT(histogram);
+    ASSERT_UINT_EQUALS(0, aws_http_latency_histogram_percentile(&histogram, 50.0));
+
+    /* 1..1000us, once each */
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        aws_http_latency_histogram_record(&histogram, i);
+    }
+    ASSERT_UINT_EQUALS(1000, histogram.count);
+    ASSERT_UINT_EQUALS(500500, histogram.sum_us);
+    ASSERT_UINT_EQUALS(1000, histogram.max_us);
+
+    /* Buckets are never more than a quarter wider than their lower bound */
+    uint64_t p50 = aws_http_latency_histogram_percentile(&histogram, 50.0);
+    ASSERT_TRUE(p50 >= 500 && p50 <= 625);
+    uint64_t p99 = aws_http_latency_histogram_percentile(&histogram, 99.0);
+    ASSERT_TRUE(p99 >= 990 && p99 <= 1000);
+    ASSERT_UINT_EQUALS(1000, aws_http_latency_histogram_percentile(&histogram, 100.0));
+    ASSERT_UINT_EQUALS(1, aws_http_latency_histogram_percentile(&histogram, 0.0));
+
+    /* Huge values land in the last bucket */
+    struct aws_http_latency_histogram other;
+    AWS_ZERO_STRUCT(other);
+    aws_http_latency_histogram_record(&other, (uint64_t)1 << 40);
+    aws_http_latency_histogram_merge(&histogram, &other);
+    ASSERT_UINT_EQUALS(1001, histogram.count);
+    ASSERT_UINT_EQUALS(1, histogram.buckets[AWS_HTTP_LATENCY_HISTOGRAM_BUCKET_COUNT - 1]);
+    ASSERT_UINT_EQUALS((uint64_t)1 << 40, histogram.max_us);
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_http_latency_histogram_percentiles, s_test_http_latency_histogram_percentiles);
+
+struct h2_monitor_test_event {
+    uint64_t active_ms;
+    uint64_t bytes;
+    uint64_t zero_copy_bytes;
+    uint64_t expected_throughput;
+    uint64_t expected_consecutive_failure_time_ms;
+};
+
+/* HTTP/2 throughput counts the connection's bytes, across all streams, over the time any stream was active */
+static int s_test_http_connection_monitor_h2_throughput(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct testing_channel testing_channel;
+    struct aws_testing_channel_options test_channel_options = {.clock_fn = s_mock_clock};
+    ASSERT_SUCCESS(testing_channel_init(&testing_channel, allocator, &test_channel_options));
+
+    struct aws_http_connection_monitoring_options options = {
+        .allowable_throughput_failure_interval_seconds = 1,
+        .minimum_throughput_bytes_per_second = 1000,
+    };
+    struct aws_crt_statistics_handler *monitor =
+        aws_crt_statistics_handler_new_http_connection_monitor(allocator, &options);
+    ASSERT_NOT_NULL(monitor);
+    struct aws_statistics_handler_http_connection_monitor_impl *monitor_impl = monitor->impl;
+
+    struct h2_monitor_test_event events[] = {
+        /* Fast enough, even though streams weren't active the whole interval */
+        {.active_ms = 500, .bytes = 200, .zero_copy_bytes = 400, .expected_throughput = 1200},
+        {.active_ms = 600, .bytes = 300, .expected_throughput = 500, .expected_consecutive_failure_time_ms = 600},
+        /* An idle connection isn't slow */
+        {.active_ms = 0, .bytes = 0, .expected_throughput = 0},
+        {.active_ms = 1000, .bytes = 0, .expected_throughput = 0, .expected_consecutive_failure_time_ms = 1000},
+        {.active_ms = 500, .bytes = 0, .expected_throughput = 0, .expected_consecutive_failure_time_ms = 1500},
+    };
+
+    struct aws_array_list stats_list;
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&stats_list, allocator, 1, sizeof(void *)));
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(events); ++i) {
+        struct aws_crt_statistics_http2_channel h2_stats;
+        aws_crt_statistics_http2_channel_init(&h2_stats);
+        h2_stats.was_inactive = events[i].active_ms < AWS_TIMESTAMP_MILLIS;
+        h2_stats.pending_incoming_stream_ms = events[i].active_ms;
+        h2_stats.bytes_read = events[i].bytes / 2;
+        h2_stats.bytes_written = events[i].bytes - h2_stats.bytes_read;
+        h2_stats.zero_copy_bytes_written = events[i].zero_copy_bytes;
+
+        aws_array_list_clear(&stats_list);
+        void *stats_base = &h2_stats;
+        ASSERT_SUCCESS(aws_array_list_push_back(&stats_list, &stats_base));
+
+        monitor->vtable->process_statistics(monitor, NULL, &stats_list, testing_channel.channel);
+        testing_channel_drain_queued_tasks(&testing_channel);
+
+        ASSERT_UINT_EQUALS(events[i].expected_throughput, monitor_impl->last_measured_throughput);
+        ASSERT_UINT_EQUALS(events[i].expected_consecutive_failure_time_ms, monitor_impl->throughput_failure_time_ms);
+        ASSERT_TRUE(testing_channel_is_shutdown_completed(&testing_channel) == (i == AWS_ARRAY_SIZE(events) - 1));
+    }
+    ASSERT_INT_EQUALS(
+        AWS_ERROR_HTTP_CHANNEL_THROUGHPUT_FAILURE, testing_channel_get_shutdown_error_code(&testing_channel));
+
+    aws_array_list_clean_up(&stats_list);
+    aws_crt_statistics_handler_destroy(monitor);
+    ASSERT_SUCCESS(testing_channel_clean_up(&testing_channel));
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_http_connection_monitor_h2_throughput, s_test_http_connection_monitor_h2_throughput);
+
+struct health_monitor_test_event {
+    uint64_t active_ms;
+    uint64_t bytes;
+    uint32_t streams_completed;
+    uint32_t streams_failed;
+    uint64_t smoothed_rtt_ms;
+    uint64_t min_rtt_ms;
+    uint32_t expected_health_score;
+};
+
+/* Health is scored on throughput, stream errors, and RTT inflation, smoothed over reports */
+static int s_test_http_connection_monitor_health_score(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct testing_channel testing_channel;
+    struct aws_testing_channel_options test_channel_options = {.clock_fn = s_mock_clock};
+    ASSERT_SUCCESS(testing_channel_init(&testing_channel, allocator, &test_channel_options));
+
+    struct aws_http_connection_monitoring_options options = {
+        .allowable_throughput_failure_interval_seconds = 1,
+        .minimum_throughput_bytes_per_second = 1000,
+        .degraded_health_score = 50,
+    };
+    struct aws_crt_statistics_handler *monitor =
+        aws_crt_statistics_handler_new_http_connection_monitor(allocator, &options);
+    ASSERT_NOT_NULL(monitor);
+    struct aws_statistics_handler_http_connection_monitor_impl *monitor_impl = monitor->impl;
+    ASSERT_UINT_EQUALS(AWS_HTTP_CONNECTION_HEALTH_SCORE_MAX, monitor_impl->health_score);
+
+    struct health_monitor_test_event events[] = {
+        /* Half the streams failed */
+        {.active_ms = 1000, .bytes = 1000, .streams_completed = 4, .streams_failed = 2, .expected_health_score = 87},
+        /* Half the minimum throughput */
+        {.active_ms = 1000, .bytes = 500, .expected_health_score = 77},
+        /* Idle reports don't count */
+        {.active_ms = 0, .bytes = 0, .expected_health_score = 77},
+        /* RTT grew to 8x the best, 4x past the allowance */
+        {.active_ms = 1000,
+         .bytes = 1000,
+         .streams_completed = 1,
+         .smoothed_rtt_ms = 40,
+         .min_rtt_ms = 5,
+         .expected_health_score = 64},
+        /* And recovers */
+        {.active_ms = 1000, .bytes = 1000, .smoothed_rtt_ms = 10, .min_rtt_ms = 5, .expected_health_score = 73},
+    };
+
+    struct aws_array_list stats_list;
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&stats_list, allocator, 1, sizeof(void *)));
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(events); ++i) {
+        struct aws_crt_statistics_http2_channel h2_stats;
+        aws_crt_statistics_http2_channel_init(&h2_stats);
+        h2_stats.was_inactive = events[i].active_ms < AWS_TIMESTAMP_MILLIS;
+        h2_stats.pending_incoming_stream_ms = events[i].active_ms;
+        h2_stats.bytes_read = events[i].bytes;
+        h2_stats.streams_completed = events[i].streams_completed;
+        h2_stats.streams_failed = events[i].streams_failed;
+        h2_stats.smoothed_rtt_ns =
+            aws_timestamp_convert(events[i].smoothed_rtt_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+        h2_stats.min_rtt_ns =
+            aws_timestamp_convert(events[i].min_rtt_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+
+        aws_array_list_clear(&stats_list);
+        void *stats_base = &h2_stats;
+        ASSERT_SUCCESS(aws_array_list_push_back(&stats_list, &stats_base));
+
+        monitor->vtable->process_statistics(monitor, NULL, &stats_list, testing_channel.channel);
+        testing_channel_drain_queued_tasks(&testing_channel);
+
+        ASSERT_UINT_EQUALS(events[i].expected_health_score, monitor_impl->health_score);
+    }
+    ASSERT_FALSE(testing_channel_is_shutdown_completed(&testing_channel));
+
+    aws_array_list_clean_up(&stats_list);
+    aws_crt_statistics_handler_destroy(monitor);
+    ASSERT_SUCCESS(testing_channel_clean_up(&testing_channel));
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_http_connection_monitor_health_score, s_test_http_connection_monitor_health_score);
@@ -6,6 +6,7 @@
 #include "stream_test_helper.h"
 #include <aws/common/uuid.h>
 #include <aws/http/private/h1_connection.h>
+#include <aws/http/private/memory_budget_impl.h>
 #include <aws/http/request_response.h>
 #include <aws/http/status_code.h>
 #include <aws/io/logging.h>
@@ -94,6 +95,10 @@ struct tester_options {
     bool manual_window_management;
     size_t initial_stream_window_size;
     size_t read_buffer_capacity;
+    size_t read_buffer_max_capacity;
+    size_t max_pipeline_depth;
+    struct aws_http_memory_budget *memory_budget;
+    uint64_t expect_continue_threshold;
 };
 
 static int s_tester_init_ex(struct tester *tester, struct aws_allocator *alloc, const struct tester_options *options) {
@@ -116,6 +121,10 @@ static int s_tester_init_ex(struct tester *tester, struct aws_allocator *alloc,
     struct aws_http1_connection_options http1_options;
     AWS_ZERO_STRUCT(http1_options);
     http1_options.read_buffer_capacity = options->read_buffer_capacity;
+    http1_options.read_buffer_max_capacity = options->read_buffer_max_capacity;
+    http1_options.max_pipeline_depth = options->max_pipeline_depth;
+    http1_options.memory_budget = options->memory_budget;
+    http1_options.expect_continue_threshold = options->expect_continue_threshold;
 
     tester->connection = aws_http_connection_new_http1_1_client(
         alloc, options->manual_window_management, options->initial_stream_window_size, &http1_options);
@@ -326,6 +335,76 @@ H1_CLIENT_TEST_CASE(h1_client_request_send_body_chunked) {
     return AWS_OP_SUCCESS;
 }
 
+struct zero_copy_chunk_tester {
+    int on_complete_count;
+    int on_complete_error_code;
+};
+
+static void s_on_zero_copy_chunk_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct zero_copy_chunk_tester *chunk_tester = user_data;
+    chunk_tester->on_complete_count++;
+    chunk_tester->on_complete_error_code = error_code;
+}
+
+/* Chunk data from caller-owned memory goes out in its own message, without being copied */
+H1_CLIENT_TEST_CASE(h1_client_request_send_chunk_zero_copy) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    /* send request */
+    struct aws_http_message *request = s_new_default_chunked_put_request(allocator);
+    struct aws_http_make_request_options opt = {
+        .self_size = sizeof(opt),
+        .request = request,
+    };
+    struct aws_http_stream *stream = aws_http_connection_make_request(tester.connection, &opt);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_SUCCESS(aws_http_stream_activate(stream));
+
+    static const struct aws_byte_cursor body = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("write more tests");
+    struct zero_copy_chunk_tester chunk_tester = {.on_complete_error_code = -1};
+    struct aws_http1_chunk_options options = {
+        .zero_copy_data = body,
+        .chunk_data_size = body.len,
+        .on_complete = s_on_zero_copy_chunk_complete,
+        .user_data = &chunk_tester,
+    };
+
+    /* Zero-copy data can't be combined with a data stream, and must match chunk_data_size */
+    options.chunk_data_size = body.len + 1;
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_http1_stream_write_chunk(stream, &options));
+    options.chunk_data_size = body.len;
+
+    ASSERT_SUCCESS(aws_http1_stream_write_chunk(stream, &options));
+    ASSERT_SUCCESS(s_write_termination_chunk(allocator, stream));
+
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_INT_EQUALS(1, chunk_tester.on_complete_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, chunk_tester.on_complete_error_code);
+
+    /* check result */
+    const char *expected = "PUT /plan.txt HTTP/1.1\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "\r\n"
+                           "10\r\n"
+                           "write more tests"
+                           "\r\n"
+                           "0\r\n"
+                           "\r\n";
+
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(&tester.testing_channel, allocator, expected));
+
+    /* clean up */
+    aws_http_message_destroy(request);
+    aws_http_stream_release(stream);
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
 int chunked_test_helper(
     const struct aws_byte_cursor *body,
     struct aws_http_headers *trailers,
@@ -1944,6 +2023,26 @@ H1_CLIENT_TEST_CASE(h1_client_response_get_body) {
         stream_tester.metrics.sending_duration_ns ==
         stream_tester.metrics.send_end_timestamp_ns - stream_tester.metrics.send_start_timestamp_ns);
     ASSERT_TRUE(stream_tester.metrics.stream_id == stream_tester.stream->id);
+    ASSERT_UINT_EQUALS(0, stream_tester.metrics.connection_reuse_count);
+
+    ASSERT_TRUE(stream_tester.metrics.queue_start_timestamp_ns > 0);
+    ASSERT_TRUE(
+        stream_tester.metrics.queue_duration_ns ==
+        stream_tester.metrics.send_start_timestamp_ns - stream_tester.metrics.queue_start_timestamp_ns);
+    ASSERT_TRUE(
+        stream_tester.metrics.time_to_first_byte_ns ==
+        stream_tester.metrics.receive_start_timestamp_ns - stream_tester.metrics.send_start_timestamp_ns);
+    ASSERT_TRUE(stream_tester.metrics.time_to_headers_done_ns >= stream_tester.metrics.time_to_first_byte_ns);
+    ASSERT_INT_EQUALS(0, stream_tester.metrics.flow_control_stalled_duration_ns);
+
+    /* "GET / HTTP/1.1\r\n\r\n" */
+    ASSERT_UINT_EQUALS(18, stream_tester.metrics.bytes_sent);
+    ASSERT_UINT_EQUALS(18, stream_tester.metrics.header_bytes_sent);
+    ASSERT_UINT_EQUALS(18, stream_tester.metrics.header_bytes_sent_encoded);
+    /* The response head is 38 bytes, followed by 9 bytes of body */
+    ASSERT_UINT_EQUALS(47, stream_tester.metrics.bytes_received);
+    ASSERT_UINT_EQUALS(38, stream_tester.metrics.header_bytes_received);
+    ASSERT_UINT_EQUALS(38, stream_tester.metrics.header_bytes_received_encoded);
 
     /* clean up */
     client_stream_tester_clean_up(&stream_tester);
@@ -2565,6 +2664,253 @@ H1_CLIENT_TEST_CASE(h1_client_request_close_header_ends_connection) {
     return AWS_OP_SUCCESS;
 }
 
+/* With max_pipeline_depth set, requests beyond the limit wait for responses before they're sent.
+ * When the connection dies, the requests behind the first complete with a retryable error. */
+H1_CLIENT_TEST_CASE(h1_client_request_pipeline_depth_limit) {
+    (void)ctx;
+    struct tester tester;
+    struct tester_options tester_options = {
+        .max_pipeline_depth = 2,
+    };
+    ASSERT_SUCCESS(s_tester_init_ex(&tester, allocator, &tester_options));
+
+    enum { NUM_STREAMS = 3 };
+    struct aws_http_message *requests[NUM_STREAMS];
+    struct client_stream_tester stream_testers[NUM_STREAMS];
+    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+        requests[i] = s_new_default_get_request(allocator);
+        ASSERT_SUCCESS(s_stream_tester_init(&stream_testers[i], &tester, requests[i]));
+    }
+
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    /* Only 2 requests may be in flight */
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(
+        &tester.testing_channel,
+        allocator,
+        "GET / HTTP/1.1\r\n"
+        "\r\n"
+        "GET / HTTP/1.1\r\n"
+        "\r\n"));
+
+    /* 1st response lets the 3rd request go */
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "HTTP/1.1 200 OK\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_TRUE(stream_testers[0].complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_testers[0].on_complete_error_code);
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(
+        &tester.testing_channel,
+        allocator,
+        "GET / HTTP/1.1\r\n"
+        "\r\n"));
+
+    /* Connection dies before the other responses arrive */
+    aws_channel_shutdown(tester.testing_channel.channel, AWS_IO_SOCKET_CLOSED);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_TRUE(stream_testers[1].complete);
+    ASSERT_INT_EQUALS(AWS_IO_SOCKET_CLOSED, stream_testers[1].on_complete_error_code);
+    ASSERT_TRUE(stream_testers[2].complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_PIPELINED_REQUEST_UNANSWERED, stream_testers[2].on_complete_error_code);
+
+    /* clean up */
+    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+        aws_http_message_destroy(requests[i]);
+        client_stream_tester_clean_up(&stream_testers[i]);
+    }
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* A non-idempotent request is never pipelined, it waits until the requests ahead of it are answered,
+ * and the requests behind it wait for its response. */
+H1_CLIENT_TEST_CASE(h1_client_request_pipeline_non_idempotent_waits) {
+    (void)ctx;
+    struct tester tester;
+    struct tester_options tester_options = {
+        .max_pipeline_depth = 4,
+    };
+    ASSERT_SUCCESS(s_tester_init_ex(&tester, allocator, &tester_options));
+
+    struct aws_http_message *post_request = aws_http_message_new_request(allocator);
+    ASSERT_NOT_NULL(post_request);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(post_request, aws_byte_cursor_from_c_str("POST")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(post_request, aws_byte_cursor_from_c_str("/")));
+
+    enum { NUM_STREAMS = 3 };
+    struct aws_http_message *requests[NUM_STREAMS] = {
+        s_new_default_get_request(allocator),
+        post_request,
+        s_new_default_get_request(allocator),
+    };
+    struct client_stream_tester stream_testers[NUM_STREAMS];
+    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+        ASSERT_SUCCESS(s_stream_tester_init(&stream_testers[i], &tester, requests[i]));
+    }
+
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(
+        &tester.testing_channel,
+        allocator,
+        "GET / HTTP/1.1\r\n"
+        "\r\n"));
+
+    /* POST goes once the 1st request is answered */
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "HTTP/1.1 200 OK\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(
+        &tester.testing_channel,
+        allocator,
+        "POST / HTTP/1.1\r\n"
+        "\r\n"));
+
+    /* Last GET goes once the POST is answered */
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "HTTP/1.1 200 OK\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(
+        &tester.testing_channel,
+        allocator,
+        "GET / HTTP/1.1\r\n"
+        "\r\n"));
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "HTTP/1.1 200 OK\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+        ASSERT_TRUE(stream_testers[i].complete);
+        ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_testers[i].on_complete_error_code);
+        ASSERT_INT_EQUALS(200, stream_testers[i].response_status);
+    }
+
+    /* clean up */
+    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+        aws_http_message_destroy(requests[i]);
+        client_stream_tester_clean_up(&stream_testers[i]);
+    }
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+static struct aws_http_message *s_new_expect_continue_put_request(
+    struct aws_allocator *allocator,
+    struct aws_input_stream *body_stream) {
+
+    struct aws_http_header headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Content-Length"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("16"),
+        },
+    };
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    AWS_FATAL_ASSERT(request);
+    AWS_FATAL_ASSERT(!aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    AWS_FATAL_ASSERT(!aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/plan.txt")));
+    AWS_FATAL_ASSERT(!aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers)));
+    aws_http_message_set_body_stream(request, body_stream);
+    return request;
+}
+
+/* With expect_continue_threshold set, a large enough body is held back until the server sends 100 Continue */
+H1_CLIENT_TEST_CASE(h1_client_request_expect_continue) {
+    (void)ctx;
+    struct tester tester;
+    struct tester_options tester_options = {
+        .expect_continue_threshold = 10,
+    };
+    ASSERT_SUCCESS(s_tester_init_ex(&tester, allocator, &tester_options));
+
+    static const struct aws_byte_cursor body = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("write more tests");
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+    struct aws_http_message *request = s_new_expect_continue_put_request(allocator, body_stream);
+
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, &tester, request));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    /* Only the head goes out */
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(
+        &tester.testing_channel,
+        allocator,
+        "PUT /plan.txt HTTP/1.1\r\n"
+        "Content-Length: 16\r\n"
+        "Expect: 100-continue\r\n"
+        "\r\n"));
+
+    /* The header was added to the encoded head, not to the user's request */
+    ASSERT_FALSE(aws_http_headers_has(aws_http_message_get_headers(request), aws_byte_cursor_from_c_str("Expect")));
+
+    /* The body follows 100 Continue */
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "HTTP/1.1 100 Continue\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_SUCCESS(
+        testing_channel_check_written_messages_str(&tester.testing_channel, allocator, "write more tests"));
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "HTTP/1.1 200 OK\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+    ASSERT_INT_EQUALS(200, stream_tester.response_status);
+    ASSERT_TRUE(aws_http_connection_is_open(tester.connection));
+
+    /* clean up */
+    aws_input_stream_release(body_stream);
+    aws_http_message_destroy(request);
+    client_stream_tester_clean_up(&stream_tester);
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* If the server answers Expect: 100-continue with a final response, the body is never sent,
+ * and the connection closes since the server can't tell where the next request would begin. */
+H1_CLIENT_TEST_CASE(h1_client_request_expect_continue_final_response) {
+    (void)ctx;
+    struct tester tester;
+    struct tester_options tester_options = {
+        .expect_continue_threshold = 10,
+    };
+    ASSERT_SUCCESS(s_tester_init_ex(&tester, allocator, &tester_options));
+
+    static const struct aws_byte_cursor body = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("write more tests");
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+    struct aws_http_message *request = s_new_expect_continue_put_request(allocator, body_stream);
+
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, &tester, request));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(
+        &tester.testing_channel,
+        allocator,
+        "PUT /plan.txt HTTP/1.1\r\n"
+        "Content-Length: 16\r\n"
+        "Expect: 100-continue\r\n"
+        "\r\n"));
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(
+        &tester.testing_channel, "HTTP/1.1 413 Content Too Large\r\nContent-Length: 0\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+    ASSERT_INT_EQUALS(413, stream_tester.response_status);
+    ASSERT_TRUE(aws_linked_list_empty(testing_channel_get_written_message_queue(&tester.testing_channel)));
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&tester.testing_channel));
+
+    /* clean up */
+    aws_input_stream_release(body_stream);
+    aws_http_message_destroy(request);
+    client_stream_tester_clean_up(&stream_tester);
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
 /* While pipelining 3 requests, and 2nd response has a "Connection: close" header.
  * 2 requests should complete successfully and the connection should close. */
 H1_CLIENT_TEST_CASE(h1_client_response_close_header_with_pipelining) {
@@ -3105,34 +3451,740 @@ H1_CLIENT_TEST_CASE(h1_client_connection_window_with_small_buffer) {
     return AWS_OP_SUCCESS;
 }
 
-static void s_on_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
-    (void)stream;
-    int *completion_error_code = user_data;
-    *completion_error_code = error_code;
-}
+/* The connection window is drawn from a shared memory budget, and stays closed while the budget is exhausted */
+H1_CLIENT_TEST_CASE(h1_client_connection_window_with_memory_budget) {
+    (void)ctx;
 
-static int s_test_content_length_mismatch_is_error(
-    struct aws_allocator *allocator,
-    const char *body,
-    const char *wrong_length) {
+    /* Something else holds most of the budget */
+    struct aws_http_memory_budget *budget = aws_http_memory_budget_new(allocator, 60);
+    ASSERT_NOT_NULL(budget);
+    ASSERT_UINT_EQUALS(40, aws_http_memory_budget_draw(budget, 40, NULL));
 
+    struct tester_options tester_opts = {
+        .manual_window_management = true,
+        .initial_stream_window_size = 0,
+        .read_buffer_capacity = 100,
+        .memory_budget = budget,
+    };
     struct tester tester;
-    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+    ASSERT_SUCCESS(s_tester_init_ex(&tester, allocator, &tester_opts));
 
-    /* send request whose Content-Length does not match body length */
-    const struct aws_byte_cursor body_cur = aws_byte_cursor_from_c_str(body);
-    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body_cur);
+    struct aws_http_message *request = s_new_default_get_request(allocator);
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, &tester, request));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
 
-    struct aws_http_header headers[] = {
-        {
-            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Content-Length"),
-            .value = aws_byte_cursor_from_c_str(wrong_length),
-        },
-    };
+    /* The window only gets what's left of the budget */
+    struct aws_h1_window_stats window_stats = aws_h1_connection_window_stats(tester.connection);
+    ASSERT_UINT_EQUALS(100, window_stats.buffer_capacity);
+    ASSERT_UINT_EQUALS(20, window_stats.connection_window);
+    ASSERT_TRUE(aws_http_memory_budget_is_exhausted(budget));
 
-    struct aws_http_message *request = aws_http_message_new_request(allocator);
-    ASSERT_NOT_NULL(request);
-    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    /* Once bytes are given back, the window opens as far as the budget allows */
+    aws_http_memory_budget_give_back(budget, 40);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    window_stats = aws_h1_connection_window_stats(tester.connection);
+    ASSERT_UINT_EQUALS(60, window_stats.connection_window);
+    ASSERT_UINT_EQUALS(60, aws_http_memory_budget_get_used(budget));
+
+    /* The stream's window is closed, so data waits in the read buffer, still drawn from the budget */
+    const char *response_str = "HTTP/1.1 200 OK\r\n"
+                               "Content-Length: 10\r\n"
+                               "\r\n"
+                               "0123456789";
+    ASSERT_SUCCESS(testing_channel_push_read_data(&tester.testing_channel, aws_byte_cursor_from_c_str(response_str)));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    window_stats = aws_h1_connection_window_stats(tester.connection);
+    ASSERT_TRUE(window_stats.buffer_pending_bytes > 0);
+    ASSERT_UINT_EQUALS(60, aws_http_memory_budget_get_used(budget));
+
+    /* Processed data is given back, and drawn again to reopen the window */
+    aws_http_stream_update_window(stream_tester.stream, 10);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_UINT_EQUALS(10, stream_tester.response_body.len);
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_SUCCESS(stream_tester.on_complete_error_code);
+
+    window_stats = aws_h1_connection_window_stats(tester.connection);
+    ASSERT_UINT_EQUALS(0, window_stats.buffer_pending_bytes);
+    ASSERT_UINT_EQUALS(60, window_stats.connection_window);
+    ASSERT_UINT_EQUALS(60, aws_http_memory_budget_get_used(budget));
+
+    /* Everything is given back when the connection goes away */
+    client_stream_tester_clean_up(&stream_tester);
+    aws_http_message_release(request);
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    ASSERT_UINT_EQUALS(0, aws_http_memory_budget_get_used(budget));
+    aws_http_memory_budget_release(budget);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_check_read_buffer(struct tester *tester, size_t capacity, size_t pending_bytes, size_t connection_window) {
+    struct aws_h1_window_stats window_stats = aws_h1_connection_window_stats(tester->connection);
+    ASSERT_UINT_EQUALS(capacity, window_stats.buffer_capacity);
+    ASSERT_UINT_EQUALS(pending_bytes, window_stats.buffer_pending_bytes);
+    ASSERT_UINT_EQUALS(connection_window, window_stats.connection_window);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_push_read_bytes(struct tester *tester, struct aws_byte_cursor *src, size_t size) {
+    ASSERT_SUCCESS(testing_channel_push_read_data(&tester->testing_channel, aws_byte_cursor_advance(src, size)));
+    testing_channel_drain_queued_tasks(&tester->testing_channel);
+    return AWS_OP_SUCCESS;
+}
+
+/* The read buffer grows while the stream keeps up with the window, shrinks behind a blocked stream,
+ * and returns to its minimum once the connection is idle */
+H1_CLIENT_TEST_CASE(h1_client_connection_window_autotune) {
+    (void)ctx;
+
+    struct tester_options tester_opts = {
+        .manual_window_management = true,
+        .initial_stream_window_size = 30,
+        .read_buffer_capacity = 10,
+        .read_buffer_max_capacity = 40,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init_ex(&tester, allocator, &tester_opts));
+
+    struct aws_http_message *request = s_new_default_get_request(allocator);
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, &tester, request));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 10 /*capacity*/, 0 /*pending*/, 10 /*window*/));
+
+    /* 40 bytes of head, then 100 bytes of body */
+    struct aws_byte_buf response;
+    ASSERT_SUCCESS(aws_byte_buf_init(&response, allocator, 140));
+    struct aws_byte_cursor head = aws_byte_cursor_from_c_str("HTTP/1.1 200 OK\r\n"
+                                                             "Content-Length: 100\r\n"
+                                                             "\r\n");
+    ASSERT_UINT_EQUALS(40, head.len);
+    ASSERT_SUCCESS(aws_byte_buf_append(&response, &head));
+    while (response.len < response.capacity) {
+        aws_byte_buf_write_u8(&response, (uint8_t)'a');
+    }
+    struct aws_byte_cursor response_cursor = aws_byte_cursor_from_buf(&response);
+
+    /* Stream consumes each full window, so capacity doubles up to the max */
+    ASSERT_SUCCESS(s_push_read_bytes(&tester, &response_cursor, 10));
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 20, 0, 20));
+    ASSERT_SUCCESS(s_push_read_bytes(&tester, &response_cursor, 20));
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 40, 0, 40));
+    ASSERT_SUCCESS(s_push_read_bytes(&tester, &response_cursor, 40));
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 40, 0, 40));
+    ASSERT_UINT_EQUALS(30, stream_tester.response_body.len);
+
+    /* Stream window is now 0. Data piling up halves the capacity, without taking back window already granted */
+    ASSERT_SUCCESS(s_push_read_bytes(&tester, &response_cursor, 20));
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 20, 20, 20));
+    ASSERT_SUCCESS(s_push_read_bytes(&tester, &response_cursor, 20));
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 10, 40, 0));
+
+    /* Once the stream catches up, it grows again */
+    aws_http_stream_update_window(stream_tester.stream, 100);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_UINT_EQUALS(70, stream_tester.response_body.len);
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 10, 0, 10));
+    ASSERT_SUCCESS(s_push_read_bytes(&tester, &response_cursor, 10));
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 20, 0, 20));
+
+    /* Last of the response. The connection has no more streams, so capacity goes back to the minimum */
+    ASSERT_SUCCESS(s_push_read_bytes(&tester, &response_cursor, 20));
+    ASSERT_UINT_EQUALS(0, response_cursor.len);
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_SUCCESS(stream_tester.on_complete_error_code);
+    ASSERT_UINT_EQUALS(100, stream_tester.response_body.len);
+    ASSERT_SUCCESS(s_check_read_buffer(&tester, 10, 0, 10));
+
+    /* clean up */
+    aws_byte_buf_clean_up(&response);
+    client_stream_tester_clean_up(&stream_tester);
+    aws_http_message_release(request);
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+struct retain_body_tester {
+    struct aws_http1_incoming_body_ref *refs[2];
+    struct aws_byte_cursor retained_data[2];
+    size_t num_refs;
+    bool complete;
+    int on_complete_error_code;
+};
+
+static int s_retain_body_on_response_body(
+    struct aws_http_stream *stream,
+    const struct aws_byte_cursor *data,
+    void *user_data) {
+
+    struct retain_body_tester *retain_tester = user_data;
+    ASSERT_TRUE(retain_tester->num_refs < AWS_ARRAY_SIZE(retain_tester->refs));
+
+    struct aws_byte_cursor retained = *data;
+    struct aws_http1_incoming_body_ref *ref = aws_http1_stream_retain_incoming_body(stream, &retained);
+    ASSERT_NOT_NULL(ref);
+
+    /* Data that arrived in an io message isn't copied */
+    ASSERT_PTR_EQUALS(data->ptr, retained.ptr);
+    ASSERT_UINT_EQUALS(data->len, retained.len);
+
+    retain_tester->refs[retain_tester->num_refs] = ref;
+    retain_tester->retained_data[retain_tester->num_refs] = retained;
+    retain_tester->num_refs++;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_retain_body_on_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct retain_body_tester *retain_tester = user_data;
+    retain_tester->complete = true;
+    retain_tester->on_complete_error_code = error_code;
+}
+
+/* Retained body data outlives the io messages' processing, and counts against the connection window until released */
+H1_CLIENT_TEST_CASE(h1_client_response_retain_body) {
+    (void)ctx;
+
+    struct tester_options tester_opts = {
+        .manual_window_management = true,
+        .initial_stream_window_size = 100,
+        .read_buffer_capacity = 100,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init_ex(&tester, allocator, &tester_opts));
+
+    struct retain_body_tester retain_tester;
+    AWS_ZERO_STRUCT(retain_tester);
+
+    struct aws_http_message *request = s_new_default_get_request(allocator);
+    struct aws_http_make_request_options opt = {
+        .self_size = sizeof(opt),
+        .request = request,
+        .on_response_body = s_retain_body_on_response_body,
+        .on_complete = s_retain_body_on_complete,
+        .user_data = &retain_tester,
+    };
+    struct aws_http_stream *stream = aws_http_connection_make_request(tester.connection, &opt);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_SUCCESS(aws_http_stream_activate(stream));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    /* Body arrives in 2 io messages, 5 bytes each */
+    ASSERT_SUCCESS(testing_channel_push_read_str(
+        &tester.testing_channel,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 10\r\n"
+        "\r\n"
+        "01234"));
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "56789"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_TRUE(retain_tester.complete);
+    ASSERT_SUCCESS(retain_tester.on_complete_error_code);
+    ASSERT_UINT_EQUALS(2, retain_tester.num_refs);
+    ASSERT_BIN_ARRAYS_EQUALS("01234", 5, retain_tester.retained_data[0].ptr, retain_tester.retained_data[0].len);
+    ASSERT_BIN_ARRAYS_EQUALS("56789", 5, retain_tester.retained_data[1].ptr, retain_tester.retained_data[1].len);
+
+    /* Every byte has been processed, but the retained body still counts against the connection window */
+    struct aws_h1_window_stats window_stats = aws_h1_connection_window_stats(tester.connection);
+    ASSERT_UINT_EQUALS(0, window_stats.buffer_pending_bytes);
+    ASSERT_UINT_EQUALS(90, window_stats.connection_window);
+
+    /* Releasing data, from off the event-loop thread, opens the window back up */
+    testing_channel_set_is_on_users_thread(&tester.testing_channel, false);
+    aws_http1_incoming_body_ref_release(retain_tester.refs[0]);
+    testing_channel_set_is_on_users_thread(&tester.testing_channel, true);
+    ASSERT_BIN_ARRAYS_EQUALS("56789", 5, retain_tester.retained_data[1].ptr, retain_tester.retained_data[1].len);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    window_stats = aws_h1_connection_window_stats(tester.connection);
+    ASSERT_UINT_EQUALS(95, window_stats.connection_window);
+
+    aws_http1_incoming_body_ref_release(retain_tester.refs[1]);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    window_stats = aws_h1_connection_window_stats(tester.connection);
+    ASSERT_UINT_EQUALS(100, window_stats.connection_window);
+
+    /* clean up */
+    aws_http_message_release(request);
+    aws_http_stream_release(stream);
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* Content decoder for "x-repeat", where each encoded byte stands for `repeat` copies of itself */
+struct repeat_decoder {
+    struct aws_http_content_decoder base;
+    struct aws_allocator *alloc;
+    size_t repeat;
+    uint8_t pending_byte;
+    size_t pending_count;
+    int *destroy_count;
+};
+
+static int s_repeat_decoder_decode(
+    struct aws_http_content_decoder *decoder_base,
+    struct aws_byte_cursor *input,
+    struct aws_byte_buf *output) {
+
+    struct repeat_decoder *decoder = decoder_base->impl;
+    while (output->len < output->capacity) {
+        if (decoder->pending_count == 0) {
+            if (!aws_byte_cursor_read_u8(input, &decoder->pending_byte)) {
+                break;
+            }
+            decoder->pending_count = decoder->repeat;
+        }
+        size_t n = aws_min_size(decoder->pending_count, output->capacity - output->len);
+        memset(output->buffer + output->len, decoder->pending_byte, n);
+        output->len += n;
+        decoder->pending_count -= n;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_repeat_decoder_finish(struct aws_http_content_decoder *decoder_base) {
+    struct repeat_decoder *decoder = decoder_base->impl;
+    return decoder->pending_count == 0 ? AWS_OP_SUCCESS : aws_raise_error(AWS_ERROR_HTTP_CONTENT_DECODING_FAILED);
+}
+
+static void s_repeat_decoder_destroy(struct aws_http_content_decoder *decoder_base) {
+    struct repeat_decoder *decoder = decoder_base->impl;
+    *decoder->destroy_count += 1;
+    aws_mem_release(decoder->alloc, decoder);
+}
+
+static const struct aws_http_content_decoder_vtable s_repeat_decoder_vtable = {
+    .decode = s_repeat_decoder_decode,
+    .finish = s_repeat_decoder_finish,
+    .destroy = s_repeat_decoder_destroy,
+};
+
+struct repeat_decoder_options {
+    size_t repeat;
+    int destroy_count;
+};
+
+static int s_repeat_decoder_new(
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor content_coding,
+    void *user_data,
+    struct aws_http_content_decoder **out_decoder) {
+
+    struct repeat_decoder_options *options = user_data;
+    if (!aws_byte_cursor_eq_c_str(&content_coding, "x-repeat")) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct repeat_decoder *decoder = aws_mem_calloc(allocator, 1, sizeof(struct repeat_decoder));
+    decoder->base.vtable = &s_repeat_decoder_vtable;
+    decoder->base.impl = decoder;
+    decoder->alloc = allocator;
+    decoder->repeat = options->repeat;
+    decoder->destroy_count = &options->destroy_count;
+    *out_decoder = &decoder->base;
+    return AWS_OP_SUCCESS;
+}
+
+H1_CLIENT_TEST_CASE(h1_client_response_content_decoding) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    /* Decoded body is bigger than the connection's decode buffer, so it arrives in pieces */
+    enum { REPEAT = 10000 };
+    struct repeat_decoder_options decoder_options = {.repeat = REPEAT};
+    struct aws_http_content_decoding_options content_decoding = {
+        .accept_encoding = aws_byte_cursor_from_c_str("x-repeat"),
+        .new_decoder = s_repeat_decoder_new,
+        .user_data = &decoder_options,
+    };
+
+    struct aws_http_message *request = s_new_default_get_request(allocator);
+    struct client_stream_tester stream_tester;
+    struct client_stream_tester_options stream_options = {
+        .request = request,
+        .connection = tester.connection,
+        .content_decoding = &content_decoding,
+    };
+    ASSERT_SUCCESS(client_stream_tester_init(&stream_tester, allocator, &stream_options));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    /* Accept-Encoding was added to the request */
+    ASSERT_SUCCESS(testing_channel_check_written_message_str(
+        &tester.testing_channel,
+        "GET / HTTP/1.1\r\n"
+        "Accept-Encoding: x-repeat\r\n"
+        "\r\n"));
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(
+        &tester.testing_channel,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Encoding: x-repeat\r\n"
+        "Content-Length: 3\r\n"
+        "\r\n"
+        "abc"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+    ASSERT_UINT_EQUALS(3 * REPEAT, stream_tester.response_body.len);
+    for (size_t i = 0; i < stream_tester.response_body.len; ++i) {
+        ASSERT_UINT_EQUALS('a' + i / REPEAT, stream_tester.response_body.buffer[i]);
+    }
+    client_stream_tester_clean_up(&stream_tester);
+    ASSERT_INT_EQUALS(1, decoder_options.destroy_count);
+
+    /* A coding the decoder doesn't handle is passed along as-is */
+    ASSERT_SUCCESS(client_stream_tester_init(&stream_tester, allocator, &stream_options));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_SUCCESS(testing_channel_push_read_str(
+        &tester.testing_channel,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Encoding: x-unknown\r\n"
+        "Content-Length: 3\r\n"
+        "\r\n"
+        "abc"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+    ASSERT_BIN_ARRAYS_EQUALS("abc", 3, stream_tester.response_body.buffer, stream_tester.response_body.len);
+    client_stream_tester_clean_up(&stream_tester);
+    ASSERT_INT_EQUALS(1, decoder_options.destroy_count);
+
+    aws_http_message_destroy(request);
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* With a content decoder, the stream window measures decoded bytes */
+H1_CLIENT_TEST_CASE(h1_client_response_content_decoding_respects_stream_window) {
+    (void)ctx;
+
+    struct tester_options tester_opts = {
+        .manual_window_management = true,
+        .initial_stream_window_size = 5,
+        .read_buffer_capacity = SIZE_MAX,
+    };
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init_ex(&tester, allocator, &tester_opts));
+
+    struct repeat_decoder_options decoder_options = {.repeat = 2};
+    struct aws_http_content_decoding_options content_decoding = {
+        .new_decoder = s_repeat_decoder_new,
+        .user_data = &decoder_options,
+    };
+
+    struct aws_http_message *request = s_new_default_get_request(allocator);
+    struct client_stream_tester stream_tester;
+    struct client_stream_tester_options stream_options = {
+        .request = request,
+        .connection = tester.connection,
+        .content_decoding = &content_decoding,
+    };
+    ASSERT_SUCCESS(client_stream_tester_init(&stream_tester, allocator, &stream_options));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(
+        &tester.testing_channel,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Encoding: x-repeat\r\n"
+        "Content-Length: 10\r\n"
+        "\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "abcdefghij"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    /* 5 encoded bytes were read, decoding to 10 bytes, 5 beyond the window */
+    ASSERT_BIN_ARRAYS_EQUALS(
+        "aabbccddee", 10, stream_tester.response_body.buffer, stream_tester.response_body.len);
+    struct aws_h1_window_stats window_stats = aws_h1_connection_window_stats(tester.connection);
+    ASSERT_UINT_EQUALS(0, window_stats.stream_window);
+
+    /* This update only pays back the excess */
+    aws_http_stream_update_window(stream_tester.stream, 5);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_UINT_EQUALS(10, stream_tester.response_body.len);
+    ASSERT_FALSE(stream_tester.complete);
+
+    aws_http_stream_update_window(stream_tester.stream, 10);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        "aabbccddeeffgghhiijj", 20, stream_tester.response_body.buffer, stream_tester.response_body.len);
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+
+    client_stream_tester_clean_up(&stream_tester);
+    aws_http_message_destroy(request);
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* Content encoder for "x-upper", which uppercases the body and ends it with '!' */
+struct upper_encoder {
+    struct aws_http_content_encoder base;
+    struct aws_allocator *alloc;
+    int *destroy_count;
+};
+
+static int s_upper_encoder_encode(
+    struct aws_http_content_encoder *encoder_base,
+    struct aws_byte_cursor *input,
+    struct aws_byte_buf *output) {
+
+    (void)encoder_base;
+    uint8_t c;
+    while (output->len < output->capacity && aws_byte_cursor_read_u8(input, &c)) {
+        aws_byte_buf_write_u8(output, (c >= 'a' && c <= 'z') ? (uint8_t)(c - 'a' + 'A') : c);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_upper_encoder_finish(
+    struct aws_http_content_encoder *encoder_base,
+    struct aws_byte_buf *output,
+    bool *out_done) {
+
+    (void)encoder_base;
+    *out_done = aws_byte_buf_write_u8(output, '!');
+    return AWS_OP_SUCCESS;
+}
+
+static void s_upper_encoder_destroy(struct aws_http_content_encoder *encoder_base) {
+    struct upper_encoder *encoder = encoder_base->impl;
+    *encoder->destroy_count += 1;
+    aws_mem_release(encoder->alloc, encoder);
+}
+
+static const struct aws_http_content_encoder_vtable s_upper_encoder_vtable = {
+    .encode = s_upper_encoder_encode,
+    .finish = s_upper_encoder_finish,
+    .destroy = s_upper_encoder_destroy,
+};
+
+static int s_upper_encoder_new(
+    struct aws_allocator *allocator,
+    void *user_data,
+    struct aws_http_content_encoder **out_encoder) {
+
+    struct upper_encoder *encoder = aws_mem_calloc(allocator, 1, sizeof(struct upper_encoder));
+    encoder->base.vtable = &s_upper_encoder_vtable;
+    encoder->base.impl = encoder;
+    encoder->alloc = allocator;
+    encoder->destroy_count = user_data;
+    *out_encoder = &encoder->base;
+    return AWS_OP_SUCCESS;
+}
+
+/* The encoded body replaces Content-Length with chunked encoding */
+H1_CLIENT_TEST_CASE(h1_client_request_content_encoding) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    static const struct aws_byte_cursor body = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("write more tests");
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+
+    struct aws_http_header headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Content-Length"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("16"),
+        },
+    };
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/plan.txt")));
+    aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers));
+    aws_http_message_set_body_stream(request, body_stream);
+
+    int destroy_count = 0;
+    struct aws_http_content_encoding_options content_encoding = {
+        .content_coding = aws_byte_cursor_from_c_str("x-upper"),
+        .new_encoder = s_upper_encoder_new,
+        .user_data = &destroy_count,
+    };
+
+    struct client_stream_tester stream_tester;
+    struct client_stream_tester_options stream_options = {
+        .request = request,
+        .connection = tester.connection,
+        .content_encoding = &content_encoding,
+    };
+    ASSERT_SUCCESS(client_stream_tester_init(&stream_tester, allocator, &stream_options));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    struct aws_byte_buf written_buf;
+    ASSERT_SUCCESS(aws_byte_buf_init(&written_buf, allocator, 128));
+    ASSERT_SUCCESS(testing_channel_drain_written_messages(&tester.testing_channel, &written_buf));
+
+    struct aws_byte_cursor written = aws_byte_cursor_from_buf(&written_buf);
+    struct aws_byte_cursor expected_head = aws_byte_cursor_from_c_str(
+        "PUT /plan.txt HTTP/1.1\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Content-Encoding: x-upper\r\n"
+        "\r\n");
+    ASSERT_TRUE(aws_byte_cursor_starts_with(&written, &expected_head));
+    aws_byte_cursor_advance(&written, expected_head.len);
+
+    /* Reassemble the chunks */
+    struct aws_byte_buf encoded_body;
+    ASSERT_SUCCESS(aws_byte_buf_init(&encoded_body, allocator, 32));
+    const struct aws_byte_cursor crlf = aws_byte_cursor_from_c_str("\r\n");
+    uint64_t chunk_size;
+    do {
+        struct aws_byte_cursor size_line;
+        ASSERT_SUCCESS(aws_byte_cursor_find_exact(&written, &crlf, &size_line));
+        size_line.len = (size_t)(size_line.ptr - written.ptr);
+        size_line.ptr = written.ptr;
+        ASSERT_SUCCESS(aws_byte_cursor_utf8_parse_u64_hex(size_line, &chunk_size));
+        aws_byte_cursor_advance(&written, size_line.len + crlf.len);
+        if (chunk_size > 0) {
+            ASSERT_TRUE(written.len >= chunk_size + crlf.len);
+            struct aws_byte_cursor chunk = aws_byte_cursor_advance(&written, (size_t)chunk_size);
+            ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&encoded_body, &chunk));
+            struct aws_byte_cursor chunk_end = aws_byte_cursor_advance(&written, crlf.len);
+            ASSERT_TRUE(aws_byte_cursor_eq(&chunk_end, &crlf));
+        }
+    } while (chunk_size > 0);
+    ASSERT_TRUE(aws_byte_cursor_eq(&written, &crlf));
+    ASSERT_BIN_ARRAYS_EQUALS("WRITE MORE TESTS!", 17, encoded_body.buffer, encoded_body.len);
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(
+        &tester.testing_channel,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+
+    client_stream_tester_clean_up(&stream_tester);
+    ASSERT_INT_EQUALS(1, destroy_count);
+
+    aws_byte_buf_clean_up(&encoded_body);
+    aws_byte_buf_clean_up(&written_buf);
+    aws_input_stream_release(body_stream);
+    aws_http_message_destroy(request);
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* Content encoding doesn't modify the request, so the same request can be sent again */
+H1_CLIENT_TEST_CASE(h1_client_request_content_encoding_sent_twice) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    static const struct aws_byte_cursor body = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("write more tests");
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+
+    struct aws_http_header headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Content-Length"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("16"),
+        },
+    };
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/plan.txt")));
+    ASSERT_SUCCESS(aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers)));
+    aws_http_message_set_body_stream(request, body_stream);
+
+    int destroy_count = 0;
+    struct aws_http_content_encoding_options content_encoding = {
+        .content_coding = aws_byte_cursor_from_c_str("x-upper"),
+        .new_encoder = s_upper_encoder_new,
+        .user_data = &destroy_count,
+    };
+
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_SUCCESS(aws_input_stream_seek(body_stream, 0, AWS_SSB_BEGIN));
+
+        struct client_stream_tester stream_tester;
+        struct client_stream_tester_options stream_options = {
+            .request = request,
+            .connection = tester.connection,
+            .content_encoding = &content_encoding,
+        };
+        ASSERT_SUCCESS(client_stream_tester_init(&stream_tester, allocator, &stream_options));
+        testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+        /* Same head both times */
+        struct aws_byte_buf written_buf;
+        ASSERT_SUCCESS(aws_byte_buf_init(&written_buf, allocator, 128));
+        ASSERT_SUCCESS(testing_channel_drain_written_messages(&tester.testing_channel, &written_buf));
+        struct aws_byte_cursor written = aws_byte_cursor_from_buf(&written_buf);
+        struct aws_byte_cursor expected_head = aws_byte_cursor_from_c_str(
+            "PUT /plan.txt HTTP/1.1\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "Content-Encoding: x-upper\r\n"
+            "\r\n");
+        ASSERT_TRUE(aws_byte_cursor_starts_with(&written, &expected_head));
+        aws_byte_buf_clean_up(&written_buf);
+
+        ASSERT_SUCCESS(testing_channel_push_read_str(
+            &tester.testing_channel,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n"));
+        testing_channel_drain_queued_tasks(&tester.testing_channel);
+        ASSERT_TRUE(stream_tester.complete);
+        ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+        client_stream_tester_clean_up(&stream_tester);
+
+        /* The request is just as the user left it */
+        ASSERT_UINT_EQUALS(1, aws_http_message_get_header_count(request));
+        struct aws_http_header header;
+        ASSERT_SUCCESS(aws_http_message_get_header(request, &header, 0));
+        ASSERT_TRUE(aws_byte_cursor_eq_c_str(&header.name, "Content-Length"));
+        ASSERT_TRUE(aws_byte_cursor_eq_c_str(&header.value, "16"));
+    }
+    ASSERT_INT_EQUALS(2, destroy_count);
+
+    aws_input_stream_release(body_stream);
+    aws_http_message_destroy(request);
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    int *completion_error_code = user_data;
+    *completion_error_code = error_code;
+}
+
+static int s_test_content_length_mismatch_is_error(
+    struct aws_allocator *allocator,
+    const char *body,
+    const char *wrong_length) {
+
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    /* send request whose Content-Length does not match body length */
+    const struct aws_byte_cursor body_cur = aws_byte_cursor_from_c_str(body);
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body_cur);
+
+    struct aws_http_header headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Content-Length"),
+            .value = aws_byte_cursor_from_c_str(wrong_length),
+        },
+    };
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
     ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/plan.txt")));
     aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers));
     aws_http_message_set_body_stream(request, body_stream);
@@ -4519,3 +5571,55 @@ H1_CLIENT_TEST_CASE(h1_client_response_first_byte_timeout_request_override) {
     ASSERT_SUCCESS(s_tester_clean_up(&tester));
     return AWS_OP_SUCCESS;
 }
+
+/* The request timeout covers the whole exchange, so it fires even though the response has begun */
+H1_CLIENT_TEST_CASE(h1_client_request_timeout) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    struct aws_http_message *request = s_new_default_get_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    size_t request_timeout_ms = 100;
+
+    int completion_error_code = 0;
+    struct aws_http_make_request_options opt = {
+        .self_size = sizeof(opt),
+        .request = request,
+        .request_timeout_ms = request_timeout_ms,
+        .on_complete = s_on_complete,
+        .user_data = &completion_error_code,
+    };
+    struct aws_http_stream *stream = aws_http_connection_make_request(tester.connection, &opt);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_SUCCESS(aws_http_stream_activate(stream));
+
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+
+    /* send the start of a response, but never finish its body */
+    ASSERT_SUCCESS(testing_channel_push_read_str(
+        &tester.testing_channel,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 9\r\n"
+        "\r\n"
+        "love"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_FALSE(testing_channel_is_shutdown_completed(&tester.testing_channel));
+
+    aws_thread_current_sleep(
+        aws_timestamp_convert(request_timeout_ms + 1, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
+
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    /* Check if the testing channel has shut down. */
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&tester.testing_channel));
+
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_REQUEST_TIMEOUT, completion_error_code);
+
+    /* clean up */
+    aws_http_message_release(request);
+    aws_http_stream_release(stream);
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
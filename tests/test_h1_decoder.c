@@ -333,6 +333,77 @@ static int s_h1_test_receive_response_headers(struct aws_allocator *allocator, v
     return AWS_OP_SUCCESS;
 }
 
+struct s_header_batch_params {
+    int num_batches;
+    /* Every header received, as "name: value\n" */
+    struct aws_byte_buf headers;
+};
+
+static int s_got_header_batch(const struct aws_h1_decoded_header *headers, size_t num_headers, void *user_data) {
+    struct s_header_batch_params *params = (struct s_header_batch_params *)user_data;
+    params->num_batches++;
+    for (size_t i = 0; i < num_headers; ++i) {
+        struct aws_byte_cursor separator = aws_byte_cursor_from_c_str(": ");
+        struct aws_byte_cursor newline = aws_byte_cursor_from_c_str("\n");
+        if (aws_byte_buf_append_dynamic(&params->headers, &headers[i].name_data) ||
+            aws_byte_buf_append_dynamic(&params->headers, &separator) ||
+            aws_byte_buf_append_dynamic(&params->headers, &headers[i].value_data) ||
+            aws_byte_buf_append_dynamic(&params->headers, &newline)) {
+            return AWS_OP_ERR;
+        }
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* With on_headers_batch, the headers in each aws_h1_decode() call arrive together */
+AWS_TEST_CASE(h1_test_receive_response_headers_batched, s_h1_test_receive_response_headers_batched);
+static int s_h1_test_receive_response_headers_batched(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    s_test_init(allocator);
+    struct aws_h1_decoder_params params;
+    struct s_header_batch_params batch_params;
+    AWS_ZERO_STRUCT(batch_params);
+    ASSERT_SUCCESS(aws_byte_buf_init(&batch_params.headers, allocator, 128));
+    s_common_decoder_setup(allocator, 4, &params, s_response, &batch_params);
+    params.vtable.on_headers_batch = s_got_header_batch;
+    struct aws_h1_decoder *decoder = aws_h1_decoder_new(&params);
+
+    const char *expected = "Server: some-server\n"
+                           "Accept-Ranges: bytes\n"
+                           "Content-Length: 11\n";
+
+    /* Whole header-block in one call */
+    struct aws_byte_cursor msg = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("HTTP/1.1 200 OK\r\n"
+                                                                       "Server: some-server\r\n"
+                                                                       "Accept-Ranges: bytes\r\n"
+                                                                       "Content-Length: 11\r\n"
+                                                                       "\r\n"
+                                                                       "Hello noob.");
+    const struct aws_byte_cursor full_msg = msg;
+    ASSERT_SUCCESS(aws_h1_decode(decoder, &msg));
+    ASSERT_INT_EQUALS(1, batch_params.num_batches);
+    ASSERT_BIN_ARRAYS_EQUALS(expected, strlen(expected), batch_params.headers.buffer, batch_params.headers.len);
+
+    /* Same message split mid-header, so some headers are decoded from scratch space */
+    batch_params.num_batches = 0;
+    batch_params.headers.len = 0;
+    const size_t split_points[] = {30, 45};
+    size_t prev_split = 0;
+    for (size_t i = 0; i <= AWS_ARRAY_SIZE(split_points); ++i) {
+        size_t split = i < AWS_ARRAY_SIZE(split_points) ? split_points[i] : full_msg.len;
+        struct aws_byte_cursor part = aws_byte_cursor_from_array(full_msg.ptr + prev_split, split - prev_split);
+        ASSERT_SUCCESS(aws_h1_decode(decoder, &part));
+        prev_split = split;
+    }
+    ASSERT_INT_EQUALS(2, batch_params.num_batches);
+    ASSERT_BIN_ARRAYS_EQUALS(expected, strlen(expected), batch_params.headers.buffer, batch_params.headers.len);
+
+    aws_byte_buf_clean_up(&batch_params.headers);
+    aws_h1_decoder_destroy(decoder);
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
 AWS_TEST_CASE(h1_test_get_transfer_encoding_flags, s_h1_test_get_transfer_encoding_flags);
 static int s_h1_test_get_transfer_encoding_flags(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
@@ -407,6 +478,47 @@ static int s_h1_test_body_unchunked(struct aws_allocator *allocator, void *ctx)
     return AWS_OP_SUCCESS;
 }
 
+/* body_headers_ignored (set for the response to a HEAD) skips a response's body, but never a request's */
+AWS_TEST_CASE(h1_test_body_headers_ignored, s_h1_test_body_headers_ignored);
+static int s_h1_test_body_headers_ignored(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    s_test_init(allocator);
+    struct s_body_params body_params;
+    aws_array_list_init_dynamic(&body_params.body_data, allocator, 256, sizeof(uint8_t));
+
+    struct aws_h1_decoder_params params;
+    s_common_decoder_setup(allocator, 1024, &params, s_response, &body_params);
+    params.vtable.on_body = s_on_body;
+    struct aws_h1_decoder *decoder = aws_h1_decoder_new(&params);
+    aws_h1_decoder_set_body_headers_ignored(decoder, true);
+
+    struct aws_byte_cursor msg = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("HTTP/1.1 200 OK\r\n"
+                                                                       "Content-Length: 5\r\n"
+                                                                       "\r\n");
+    ASSERT_SUCCESS(aws_h1_decode(decoder, &msg));
+    ASSERT_UINT_EQUALS(0, msg.len);
+    ASSERT_UINT_EQUALS(0, body_params.body_data.length);
+    aws_h1_decoder_destroy(decoder);
+
+    s_common_decoder_setup(allocator, 1024, &params, s_request, &body_params);
+    params.vtable.on_body = s_on_body;
+    decoder = aws_h1_decoder_new(&params);
+    aws_h1_decoder_set_body_headers_ignored(decoder, true);
+
+    msg = aws_byte_cursor_from_c_str("HEAD / HTTP/1.1\r\n"
+                                     "Content-Length: 5\r\n"
+                                     "\r\n"
+                                     "hello");
+    ASSERT_SUCCESS(aws_h1_decode(decoder, &msg));
+    ASSERT_UINT_EQUALS(0, msg.len);
+    ASSERT_BIN_ARRAYS_EQUALS("hello", 5, body_params.body_data.data, body_params.body_data.length);
+    aws_h1_decoder_destroy(decoder);
+
+    aws_array_list_clean_up(&body_params.body_data);
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
 AWS_TEST_CASE(h1_test_body_chunked, s_h1_test_body_chunked);
 static int s_h1_test_body_chunked(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
@@ -445,6 +557,75 @@ static int s_h1_test_body_chunked(struct aws_allocator *allocator, void *ctx) {
     return AWS_OP_SUCCESS;
 }
 
+struct s_counting_body_params {
+    struct aws_byte_buf body;
+    size_t num_calls;
+};
+
+static int s_on_body_counting(const struct aws_byte_cursor *data, bool finished, void *user_data) {
+    (void)finished;
+
+    struct s_counting_body_params *params = user_data;
+    if (data->len > 0) {
+        params->num_calls++;
+        ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&params->body, data));
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Many small chunks in one input should be delivered with a single on_body callback */
+AWS_TEST_CASE(h1_test_body_chunked_coalesced, s_h1_test_body_chunked_coalesced);
+static int s_h1_test_body_chunked_coalesced(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    s_test_init(allocator);
+    struct aws_byte_cursor msg = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("GET / HTTP/1.1\r\n"
+                                                                       "Transfer-Encoding: chunked\r\n"
+                                                                       "\r\n"
+                                                                       "2\r\n"
+                                                                       "{\"\r\n"
+                                                                       "1;ext=1\r\n"
+                                                                       "a\r\n"
+                                                                       "4\r\n"
+                                                                       "\":1,\r\n"
+                                                                       "5\r\n"
+                                                                       "\"b\":2\r\n"
+                                                                       "1\r\n"
+                                                                       "}\r\n"
+                                                                       "0\r\n"
+                                                                       "\r\n");
+    const char *expected_body = "{\"a\":1,\"b\":2}";
+
+    struct aws_h1_decoder_params params;
+    struct s_counting_body_params body_params;
+    AWS_ZERO_STRUCT(body_params);
+    s_common_decoder_setup(allocator, 1024, &params, s_request, &body_params);
+    params.vtable.on_body = s_on_body_counting;
+    struct aws_h1_decoder *decoder = aws_h1_decoder_new(&params);
+
+    /* All at once */
+    ASSERT_SUCCESS(aws_byte_buf_init(&body_params.body, allocator, 64));
+    struct aws_byte_cursor input = msg;
+    ASSERT_SUCCESS(aws_h1_decode(decoder, &input));
+    ASSERT_UINT_EQUALS(0, input.len);
+    ASSERT_UINT_EQUALS(1, body_params.num_calls);
+    ASSERT_BIN_ARRAYS_EQUALS(expected_body, strlen(expected_body), body_params.body.buffer, body_params.body.len);
+
+    /* One byte at a time, the body must come out the same */
+    body_params.body.len = 0;
+    body_params.num_calls = 0;
+    input = msg;
+    while (input.len > 0) {
+        struct aws_byte_cursor one_byte = aws_byte_cursor_advance(&input, 1);
+        ASSERT_SUCCESS(aws_h1_decode(decoder, &one_byte));
+    }
+    ASSERT_BIN_ARRAYS_EQUALS(expected_body, strlen(expected_body), body_params.body.buffer, body_params.body.len);
+
+    aws_h1_decoder_destroy(decoder);
+    aws_byte_buf_clean_up(&body_params.body);
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
 AWS_TEST_CASE(h1_decode_trailers, s_h1_decode_trailers);
 static int s_h1_decode_trailers(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
@@ -564,3 +564,588 @@ H1_ENCODER_TEST_CASE(h1_encoder_rejects_bad_header_value) {
         AWS_ARRAY_SIZE(headers) /*header_count*/,
         AWS_ERROR_HTTP_INVALID_HEADER_VALUE /*expected_error*/);
 }
+
+static int s_check_encoded_request_head(
+    struct aws_allocator *allocator,
+    const struct aws_http_message *request,
+    const char *expected_head) {
+
+    struct aws_linked_list chunk_list;
+    aws_linked_list_init(&chunk_list);
+
+    struct aws_h1_encoder_message encoder_message;
+    ASSERT_SUCCESS(aws_h1_encoder_message_init_from_request(&encoder_message, allocator, request, &chunk_list));
+    ASSERT_BIN_ARRAYS_EQUALS(
+        expected_head,
+        strlen(expected_head),
+        encoder_message.outgoing_head_buf.buffer,
+        encoder_message.outgoing_head_buf.len);
+    ASSERT_TRUE(encoder_message.has_connection_close_header);
+
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    return AWS_OP_SUCCESS;
+}
+
+H1_ENCODER_TEST_CASE(h1_encoder_request_from_template) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    const struct aws_http_header template_headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Host"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("amazon.com"),
+        },
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Connection"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("close"),
+        },
+    };
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_SUCCESS(aws_http_headers_add_array(headers, template_headers, AWS_ARRAY_SIZE(template_headers)));
+    struct aws_http_message_template *message_template = aws_http_message_template_new(allocator, headers);
+    ASSERT_NOT_NULL(message_template);
+    aws_http_headers_release(headers);
+
+    struct aws_http_message *request = aws_http_message_new_request_from_template(allocator, message_template);
+    ASSERT_NOT_NULL(request);
+    /* request keeps its own hold on the template */
+    aws_http_message_template_release(message_template);
+
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("GET")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/index.html")));
+    ASSERT_SUCCESS(aws_http_headers_add(
+        aws_http_message_get_headers(request),
+        aws_byte_cursor_from_c_str("X-Request-Id"),
+        aws_byte_cursor_from_c_str("1")));
+
+    /* template's headers are visible like any other */
+    ASSERT_UINT_EQUALS(3, aws_http_message_get_header_count(request));
+
+    ASSERT_SUCCESS(s_check_encoded_request_head(
+        allocator,
+        request,
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: amazon.com\r\n"
+        "Connection: close\r\n"
+        "X-Request-Id: 1\r\n"
+        "\r\n"));
+
+    /* modifying template's headers means the pre-encoded lines can't be used, but result must still be correct */
+    ASSERT_SUCCESS(aws_http_headers_set(
+        aws_http_message_get_headers(request),
+        aws_byte_cursor_from_c_str("Host"),
+        aws_byte_cursor_from_c_str("a.com")));
+
+    ASSERT_SUCCESS(s_check_encoded_request_head(
+        allocator,
+        request,
+        "GET /index.html HTTP/1.1\r\n"
+        "Connection: close\r\n"
+        "X-Request-Id: 1\r\n"
+        "Host: a.com\r\n"
+        "\r\n"));
+
+    aws_http_message_release(request);
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* The encoder doesn't re-scan a template's headers, so the template must report Expect: 100-continue */
+H1_ENCODER_TEST_CASE(h1_encoder_template_expect_continue) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("Expect"), aws_byte_cursor_from_c_str("100-continue")));
+    struct aws_http_message_template *message_template = aws_http_message_template_new(allocator, headers);
+    ASSERT_NOT_NULL(message_template);
+    aws_http_headers_release(headers);
+
+    struct aws_http_message *request = aws_http_message_new_request_from_template(allocator, message_template);
+    ASSERT_NOT_NULL(request);
+    aws_http_message_template_release(message_template);
+
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/plan.txt")));
+    ASSERT_SUCCESS(aws_http_headers_add(
+        aws_http_message_get_headers(request),
+        aws_byte_cursor_from_c_str("Content-Length"),
+        aws_byte_cursor_from_c_str("0")));
+
+    struct aws_linked_list chunk_list;
+    aws_linked_list_init(&chunk_list);
+
+    struct aws_h1_encoder_message encoder_message;
+    ASSERT_SUCCESS(aws_h1_encoder_message_init_from_request(&encoder_message, allocator, request, &chunk_list));
+    ASSERT_TRUE(encoder_message.has_expect_continue_header);
+    ASSERT_FALSE(encoder_message.has_connection_close_header);
+
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    aws_http_message_release(request);
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+H1_ENCODER_TEST_CASE(h1_encoder_template_rejects_body_headers) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("Content-Length"), aws_byte_cursor_from_c_str("16")));
+    ASSERT_NULL(aws_http_message_template_new(allocator, headers));
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_INVALID_HEADER_FIELD, aws_last_error());
+
+    aws_http_headers_clear(headers);
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("X-Line-Folds-Are-Bad-Mkay"), aws_byte_cursor_from_c_str("a,\r\n b")));
+    ASSERT_NULL(aws_http_message_template_new(allocator, headers));
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_INVALID_HEADER_VALUE, aws_last_error());
+
+    aws_http_headers_release(headers);
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+static int s_check_proxied_request_line(
+    struct aws_allocator *allocator,
+    const char *method,
+    const char *path,
+    const char *expected_request_line) {
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str(method)));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str(path)));
+
+    struct aws_linked_list chunk_list;
+    aws_linked_list_init(&chunk_list);
+
+    struct aws_h1_encoder_message encoder_message;
+    ASSERT_SUCCESS(aws_h1_encoder_message_init_from_proxied_request(
+        &encoder_message,
+        allocator,
+        request,
+        aws_byte_cursor_from_c_str("http://amazon.com:80"),
+        NULL /*chunked_body*/,
+        &chunk_list));
+
+    struct aws_byte_cursor head = aws_byte_cursor_from_buf(&encoder_message.outgoing_head_buf);
+    size_t expected_len = strlen(expected_request_line);
+    ASSERT_TRUE(head.len >= expected_len);
+    ASSERT_BIN_ARRAYS_EQUALS(expected_request_line, expected_len, head.ptr, expected_len);
+
+    /* the request itself is left alone */
+    struct aws_byte_cursor request_path;
+    ASSERT_SUCCESS(aws_http_message_get_request_path(request, &request_path));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&request_path, path));
+
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    aws_http_message_release(request);
+    return AWS_OP_SUCCESS;
+}
+
+/* Forwarding proxy requests get their absolute-form target written straight into the request-line */
+H1_ENCODER_TEST_CASE(h1_encoder_proxied_request_target) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    ASSERT_SUCCESS(s_check_proxied_request_line(
+        allocator, "GET", "/index.html?a=b", "GET http://amazon.com:80/index.html?a=b HTTP/1.1\r\n"));
+    ASSERT_SUCCESS(s_check_proxied_request_line(allocator, "GET", "/", "GET http://amazon.com:80/ HTTP/1.1\r\n"));
+
+    /* RFC-7230 5.3.4: star-pathed OPTIONS becomes the authority with an empty path */
+    ASSERT_SUCCESS(
+        s_check_proxied_request_line(allocator, "OPTIONS", "*", "OPTIONS http://amazon.com:80 HTTP/1.1\r\n"));
+
+    /* targets that are already absolute-form are sent as-is */
+    ASSERT_SUCCESS(s_check_proxied_request_line(
+        allocator, "GET", "http://example.com/index.html", "GET http://example.com/index.html HTTP/1.1\r\n"));
+
+    ASSERT_FALSE(aws_h1_encoder_is_prefixable_request_target(
+        aws_byte_cursor_from_c_str("GET"), aws_byte_cursor_from_c_str("*")));
+    ASSERT_FALSE(aws_h1_encoder_is_prefixable_request_target(
+        aws_byte_cursor_from_c_str("GET"), aws_byte_cursor_from_c_str("")));
+
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* Chunks without extensions should be recycled by the pool, chunks with extensions are never pooled */
+H1_ENCODER_TEST_CASE(h1_encoder_chunk_pool_reuses_chunks) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    struct aws_h1_chunk_pool pool;
+    ASSERT_SUCCESS(aws_h1_chunk_pool_init(&pool, allocator, 1 /*max_free*/));
+
+    struct aws_http1_chunk_options options = {
+        .chunk_data_size = 0,
+    };
+
+    struct aws_h1_chunk *chunk_a = aws_h1_chunk_new(allocator, &pool, &options);
+    struct aws_h1_chunk *chunk_b = aws_h1_chunk_new(allocator, &pool, &options);
+    ASSERT_NOT_NULL(chunk_a);
+    ASSERT_NOT_NULL(chunk_b);
+    ASSERT_PTR_EQUALS(&pool, chunk_a->pool);
+
+    /* Pool only keeps 1, the other is freed */
+    aws_h1_chunk_destroy(chunk_a);
+    aws_h1_chunk_destroy(chunk_b);
+    ASSERT_UINT_EQUALS(1, pool.free_count);
+
+    struct aws_h1_chunk *chunk_c = aws_h1_chunk_new(allocator, &pool, &options);
+    ASSERT_PTR_EQUALS(chunk_a, chunk_c);
+    ASSERT_UINT_EQUALS(0, pool.free_count);
+    ASSERT_UINT_EQUALS(0, chunk_c->chunk_line.len);
+
+    struct aws_http1_chunk_extension extension = {
+        .key = aws_byte_cursor_from_c_str("foo"),
+        .value = aws_byte_cursor_from_c_str("bar"),
+    };
+    options.extensions = &extension;
+    options.num_extensions = 1;
+    struct aws_h1_chunk *chunk_with_extension = aws_h1_chunk_new(allocator, &pool, &options);
+    ASSERT_NOT_NULL(chunk_with_extension);
+    ASSERT_NULL(chunk_with_extension->pool);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        "0;foo=bar\r\n",
+        strlen("0;foo=bar\r\n"),
+        chunk_with_extension->chunk_line.buffer,
+        chunk_with_extension->chunk_line.len);
+
+    aws_h1_chunk_destroy(chunk_with_extension);
+    aws_h1_chunk_destroy(chunk_c);
+    aws_h1_chunk_pool_clean_up(&pool);
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+static int s_encode_chunked_request(struct aws_allocator *allocator, size_t dst_size, struct aws_byte_buf *output) {
+    struct aws_http_header headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Transfer-Encoding"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("chunked"),
+        },
+    };
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/")));
+    ASSERT_SUCCESS(aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers)));
+
+    struct aws_linked_list chunk_list;
+    aws_linked_list_init(&chunk_list);
+
+    struct aws_h1_encoder_message encoder_message;
+    ASSERT_SUCCESS(aws_h1_encoder_message_init_from_request(&encoder_message, allocator, request, &chunk_list));
+
+    struct aws_byte_cursor body = aws_byte_cursor_from_c_str("write more tests");
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+    struct aws_http1_chunk_options options = {
+        .chunk_data = body_stream,
+        .chunk_data_size = body.len,
+    };
+    struct aws_h1_chunk *chunk = aws_h1_chunk_new(allocator, NULL, &options);
+    ASSERT_NOT_NULL(chunk);
+    aws_input_stream_release(body_stream);
+    aws_linked_list_push_back(&chunk_list, &chunk->node);
+
+    struct aws_http1_chunk_options final_options = {
+        .chunk_data_size = 0,
+    };
+    struct aws_h1_chunk *final_chunk = aws_h1_chunk_new(allocator, NULL, &final_options);
+    ASSERT_NOT_NULL(final_chunk);
+    aws_linked_list_push_back(&chunk_list, &final_chunk->node);
+
+    struct aws_h1_encoder encoder;
+    aws_h1_encoder_init(&encoder, allocator);
+    ASSERT_SUCCESS(aws_h1_encoder_start_message(&encoder, &encoder_message, NULL /*stream*/));
+
+    struct aws_byte_buf dst;
+    ASSERT_SUCCESS(aws_byte_buf_init(&dst, allocator, dst_size));
+    while (aws_h1_encoder_is_message_in_progress(&encoder)) {
+        dst.len = 0;
+        ASSERT_SUCCESS(aws_h1_encoder_process(&encoder, &dst));
+        ASSERT_TRUE(dst.len > 0);
+        struct aws_byte_cursor written = aws_byte_cursor_from_buf(&dst);
+        ASSERT_SUCCESS(aws_byte_buf_append_dynamic(output, &written));
+    }
+    ASSERT_TRUE(aws_linked_list_empty(&chunk_list));
+
+    aws_byte_buf_clean_up(&dst);
+    aws_h1_encoder_clean_up(&encoder);
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    aws_http_message_destroy(request);
+    return AWS_OP_SUCCESS;
+}
+
+/* The chunk-size line is written straight into the output when it fits, and split across outputs when it doesn't */
+H1_ENCODER_TEST_CASE(h1_encoder_chunk_line_split_across_messages) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    const char *expected = "PUT / HTTP/1.1\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "\r\n"
+                           "10\r\n"
+                           "write more tests"
+                           "\r\n"
+                           "0\r\n"
+                           "\r\n";
+
+    const size_t dst_sizes[] = {1024, 4};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(dst_sizes); ++i) {
+        struct aws_byte_buf output;
+        ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 128));
+        ASSERT_SUCCESS(s_encode_chunked_request(allocator, dst_sizes[i], &output));
+        ASSERT_BIN_ARRAYS_EQUALS(expected, strlen(expected), output.buffer, output.len);
+        aws_byte_buf_clean_up(&output);
+    }
+
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* Encode a request whose body stream has no known length, so it's sent as chunks sized to fit each dst buffer */
+static int s_encode_chunked_body_stream_request(
+    struct aws_allocator *allocator,
+    size_t dst_size,
+    struct aws_byte_buf *output) {
+
+    static const struct aws_byte_cursor body = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("write more tests");
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+
+    struct aws_http_header headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Transfer-Encoding"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("chunked"),
+        },
+    };
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/")));
+    ASSERT_SUCCESS(aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers)));
+
+    struct aws_linked_list chunk_list;
+    aws_linked_list_init(&chunk_list);
+
+    struct aws_h1_encoder_message encoder_message;
+    ASSERT_SUCCESS(aws_h1_encoder_message_init_from_request_with_chunked_body(
+        &encoder_message, allocator, request, body_stream, &chunk_list));
+    ASSERT_TRUE(encoder_message.has_chunked_encoding_header);
+    ASSERT_TRUE(encoder_message.has_chunked_body_stream);
+
+    struct aws_h1_encoder encoder;
+    aws_h1_encoder_init(&encoder, allocator);
+    ASSERT_SUCCESS(aws_h1_encoder_start_message(&encoder, &encoder_message, NULL /*stream*/));
+
+    struct aws_byte_buf dst;
+    ASSERT_SUCCESS(aws_byte_buf_init(&dst, allocator, dst_size));
+    while (aws_h1_encoder_is_message_in_progress(&encoder)) {
+        dst.len = 0;
+        ASSERT_SUCCESS(aws_h1_encoder_process(&encoder, &dst));
+        struct aws_byte_cursor written = aws_byte_cursor_from_buf(&dst);
+        ASSERT_SUCCESS(aws_byte_buf_append_dynamic(output, &written));
+    }
+
+    aws_byte_buf_clean_up(&dst);
+    aws_h1_encoder_clean_up(&encoder);
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    aws_http_message_destroy(request);
+    aws_input_stream_release(body_stream);
+    return AWS_OP_SUCCESS;
+}
+
+H1_ENCODER_TEST_CASE(h1_encoder_chunked_body_stream) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    const char *head = "PUT / HTTP/1.1\r\n"
+                       "Transfer-Encoding: chunked\r\n"
+                       "\r\n";
+
+    /* chunk-size has leading zeros to fill the space reserved for it */
+    struct {
+        size_t dst_size;
+        const char *body;
+    } cases[] = {
+        {1024, "010\r\nwrite more tests\r\n0\r\n\r\n"},
+        {32, "0C\r\nwrite more t\r\n04\r\nests\r\n0\r\n\r\n"},
+    };
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(cases); ++i) {
+        struct aws_byte_buf expected;
+        ASSERT_SUCCESS(aws_byte_buf_init_copy_from_cursor(&expected, allocator, aws_byte_cursor_from_c_str(head)));
+        struct aws_byte_cursor expected_body = aws_byte_cursor_from_c_str(cases[i].body);
+        ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&expected, &expected_body));
+
+        struct aws_byte_buf output;
+        ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 128));
+        ASSERT_SUCCESS(s_encode_chunked_body_stream_request(allocator, cases[i].dst_size, &output));
+        ASSERT_BIN_ARRAYS_EQUALS(expected.buffer, expected.len, output.buffer, output.len);
+        aws_byte_buf_clean_up(&output);
+        aws_byte_buf_clean_up(&expected);
+    }
+
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* The request's Content-Length describes the body that the chunked body stream replaces */
+H1_ENCODER_TEST_CASE(h1_encoder_chunked_body_stream_replaces_content_length) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    static const struct aws_byte_cursor body = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("write more tests");
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+
+    struct aws_http_header headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Content-Length"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("99"),
+        },
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Host"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("amazon.com"),
+        },
+    };
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/")));
+    ASSERT_SUCCESS(aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers)));
+
+    struct aws_linked_list chunk_list;
+    aws_linked_list_init(&chunk_list);
+
+    struct aws_h1_encoder_message encoder_message;
+    ASSERT_SUCCESS(aws_h1_encoder_message_init_from_request_with_chunked_body(
+        &encoder_message, allocator, request, body_stream, &chunk_list));
+    ASSERT_TRUE(encoder_message.has_chunked_encoding_header);
+    ASSERT_UINT_EQUALS(0, encoder_message.content_length);
+
+    const char *expected_head = "PUT / HTTP/1.1\r\n"
+                                "Host: amazon.com\r\n"
+                                "Transfer-Encoding: chunked\r\n"
+                                "\r\n";
+    ASSERT_BIN_ARRAYS_EQUALS(
+        expected_head,
+        strlen(expected_head),
+        encoder_message.outgoing_head_buf.buffer,
+        encoder_message.outgoing_head_buf.len);
+
+    /* The request itself is unchanged */
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(headers), aws_http_message_get_header_count(request));
+
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    aws_http_message_destroy(request);
+    aws_input_stream_release(body_stream);
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+#ifndef _WIN32
+static int s_encode_file_body_request(
+    struct aws_allocator *allocator,
+    bool sends_file_bodies_directly,
+    struct aws_byte_buf *output) {
+
+    /* The body is a range in the middle of the file */
+    FILE *file = tmpfile();
+    ASSERT_NOT_NULL(file);
+    const char *file_contents = "skipwrite more teststail";
+    ASSERT_UINT_EQUALS(strlen(file_contents), fwrite(file_contents, 1, strlen(file_contents), file));
+    ASSERT_INT_EQUALS(0, fflush(file));
+
+    struct aws_input_stream *body_stream = aws_http_body_stream_new_from_fd(allocator, fileno(file), 4, 16);
+    ASSERT_NOT_NULL(body_stream);
+
+    struct aws_http_header headers[] = {
+        {
+            .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Content-Length"),
+            .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("16"),
+        },
+    };
+
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("PUT")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/")));
+    ASSERT_SUCCESS(aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers)));
+    aws_http_message_set_body_stream(request, body_stream);
+
+    struct aws_linked_list chunk_list;
+    aws_linked_list_init(&chunk_list);
+
+    struct aws_h1_encoder_message encoder_message;
+    ASSERT_SUCCESS(aws_h1_encoder_message_init_from_request(&encoder_message, allocator, request, &chunk_list));
+
+    struct aws_h1_encoder encoder;
+    aws_h1_encoder_init(&encoder, allocator);
+    encoder.sends_file_bodies_directly = sends_file_bodies_directly;
+    ASSERT_SUCCESS(aws_h1_encoder_start_message(&encoder, &encoder_message, NULL /*stream*/));
+
+    struct aws_byte_buf dst;
+    ASSERT_SUCCESS(aws_byte_buf_init(&dst, allocator, 1024));
+    while (aws_h1_encoder_is_message_in_progress(&encoder)) {
+        dst.len = 0;
+        ASSERT_SUCCESS(aws_h1_encoder_process(&encoder, &dst));
+        struct aws_byte_cursor written = aws_byte_cursor_from_buf(&dst);
+        ASSERT_SUCCESS(aws_byte_buf_append_dynamic(output, &written));
+
+        int fd = -1;
+        uint64_t offset = 0;
+        uint64_t remaining = 0;
+        if (aws_h1_encoder_get_file_body(&encoder, &fd, &offset, &remaining)) {
+            /* Pretend the connection sent the body in two parts, copying it from the file ourselves */
+            ASSERT_TRUE(sends_file_bodies_directly);
+            ASSERT_INT_EQUALS(fileno(file), fd);
+            ASSERT_UINT_EQUALS(4, offset);
+            ASSERT_UINT_EQUALS(16, remaining);
+            struct aws_byte_cursor first_part = aws_byte_cursor_from_array(file_contents + offset, 10);
+            ASSERT_SUCCESS(aws_byte_buf_append_dynamic(output, &first_part));
+            aws_h1_encoder_on_file_body_sent(&encoder, first_part.len);
+
+            ASSERT_TRUE(aws_h1_encoder_get_file_body(&encoder, &fd, &offset, &remaining));
+            ASSERT_UINT_EQUALS(14, offset);
+            ASSERT_UINT_EQUALS(6, remaining);
+            struct aws_byte_cursor second_part = aws_byte_cursor_from_array(file_contents + offset, (size_t)remaining);
+            ASSERT_SUCCESS(aws_byte_buf_append_dynamic(output, &second_part));
+            aws_h1_encoder_on_file_body_sent(&encoder, second_part.len);
+
+            ASSERT_FALSE(aws_h1_encoder_get_file_body(&encoder, &fd, &offset, &remaining));
+        }
+    }
+
+    aws_byte_buf_clean_up(&dst);
+    aws_h1_encoder_clean_up(&encoder);
+    aws_h1_encoder_message_clean_up(&encoder_message);
+    aws_http_message_destroy(request);
+    aws_input_stream_release(body_stream);
+    fclose(file);
+    return AWS_OP_SUCCESS;
+}
+
+/* A body from aws_http_body_stream_new_from_fd() is left for the connection to send, or copied when it can't */
+H1_ENCODER_TEST_CASE(h1_encoder_file_body) {
+    (void)ctx;
+    s_test_init(allocator);
+
+    const char *expected = "PUT / HTTP/1.1\r\n"
+                           "Content-Length: 16\r\n"
+                           "\r\n"
+                           "write more tests";
+
+    const bool sends_file_bodies_directly[] = {true, false};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(sends_file_bodies_directly); ++i) {
+        struct aws_byte_buf output;
+        ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 128));
+        ASSERT_SUCCESS(s_encode_file_body_request(allocator, sends_file_bodies_directly[i], &output));
+        ASSERT_BIN_ARRAYS_EQUALS(expected, strlen(expected), output.buffer, output.len);
+        aws_byte_buf_clean_up(&output);
+    }
+
+    s_test_clean_up();
+    return AWS_OP_SUCCESS;
+}
+#endif /* _WIN32 */
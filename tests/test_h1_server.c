@@ -6,12 +6,14 @@
 #include <aws/http/connection.h>
 #include <aws/http/private/h1_connection.h>
 #include <aws/http/private/request_response_impl.h>
+#include <aws/http/private/server_admission.h>
 #include <aws/http/request_response.h>
 #include <aws/http/server.h>
 
 #include <aws/common/clock.h>
 #include <aws/common/condition_variable.h>
 #include <aws/common/log_writer.h>
+#include <aws/common/thread.h>
 #include <aws/common/uuid.h>
 #include <aws/io/channel_bootstrap.h>
 #include <aws/io/logging.h>
@@ -163,7 +165,7 @@ static struct aws_http_stream *s_tester_on_incoming_request(struct aws_http_conn
     return tester->requests[index].request_handler;
 }
 
-static int s_tester_init(struct aws_allocator *alloc) {
+static int s_tester_init_ex(struct aws_allocator *alloc, const struct aws_http1_connection_options *http1_options) {
 
     aws_http_library_init(alloc);
 
@@ -183,9 +185,7 @@ static int s_tester_init(struct aws_allocator *alloc) {
     struct aws_testing_channel_options test_channel_options = {.clock_fn = aws_high_res_clock_get_ticks};
     ASSERT_SUCCESS(testing_channel_init(&s_tester.testing_channel, alloc, &test_channel_options));
 
-    struct aws_http1_connection_options http1_options;
-    AWS_ZERO_STRUCT(http1_options);
-    s_tester.server_connection = aws_http_connection_new_http1_1_server(alloc, true, SIZE_MAX, &http1_options);
+    s_tester.server_connection = aws_http_connection_new_http1_1_server(alloc, true, SIZE_MAX, http1_options);
     ASSERT_NOT_NULL(s_tester.server_connection);
     struct aws_http_server_connection_options options = AWS_HTTP_SERVER_CONNECTION_OPTIONS_INIT;
     options.connection_user_data = &s_tester;
@@ -205,6 +205,12 @@ static int s_tester_init(struct aws_allocator *alloc) {
     return AWS_OP_SUCCESS;
 }
 
+static int s_tester_init(struct aws_allocator *alloc) {
+    struct aws_http1_connection_options http1_options;
+    AWS_ZERO_STRUCT(http1_options);
+    return s_tester_init_ex(alloc, &http1_options);
+}
+
 static int s_server_request_clean_up(void) {
     for (int i = 0; i < s_tester.request_num; i++) {
         aws_http_stream_release(s_tester.requests[i].request_handler);
@@ -497,6 +503,254 @@ TEST_CASE(h1_server_send_response_headers) {
     return AWS_OP_SUCCESS;
 }
 
+TEST_CASE(h1_server_send_static_response) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator));
+
+    struct aws_http_header headers[] = {
+        {
+            .name = aws_byte_cursor_from_c_str("Content-Length"),
+            .value = aws_byte_cursor_from_c_str("9"),
+        },
+    };
+    struct aws_byte_cursor body_src = aws_byte_cursor_from_c_str("not found");
+    struct aws_input_stream *body = aws_input_stream_new_from_cursor(allocator, &body_src);
+    struct aws_http_message *response;
+    ASSERT_SUCCESS(s_create_response(&response, 404, headers, AWS_ARRAY_SIZE(headers), body));
+    struct aws_http_static_response *static_response = aws_http_static_response_new(allocator, response);
+    ASSERT_NOT_NULL(static_response);
+    /* The static response doesn't need the message anymore */
+    aws_http_message_release(response);
+    aws_input_stream_release(body);
+
+    const char *incoming_requests = "GET /a HTTP/1.1\r\n"
+                                    "\r\n"
+                                    "HEAD /b HTTP/1.1\r\n"
+                                    "\r\n"
+                                    "GET /c HTTP/1.1\r\n"
+                                    "\r\n";
+    ASSERT_SUCCESS(s_send_message_c_str(incoming_requests));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_INT_EQUALS(3, s_tester.request_num);
+
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_SUCCESS(aws_http_stream_send_static_response(s_tester.requests[i].request_handler, static_response));
+    }
+    /* Streams keep it alive as long as they need it */
+    aws_http_static_response_release(static_response);
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* HEAD gets the headers, without the body */
+    const char *expected = "HTTP/1.1 404 Not Found\r\n"
+                           "Content-Length: 9\r\n"
+                           "\r\n"
+                           "not found"
+                           "HTTP/1.1 404 Not Found\r\n"
+                           "Content-Length: 9\r\n"
+                           "\r\n"
+                           "HTTP/1.1 404 Not Found\r\n"
+                           "Content-Length: 9\r\n"
+                           "\r\n"
+                           "not found";
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(&s_tester.testing_channel, allocator, expected));
+
+    ASSERT_SUCCESS(s_server_tester_clean_up());
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(h1_server_static_response_rejects_chunked_encoding) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator));
+
+    struct aws_http_header headers[] = {
+        {
+            .name = aws_byte_cursor_from_c_str("Transfer-Encoding"),
+            .value = aws_byte_cursor_from_c_str("chunked"),
+        },
+    };
+    struct aws_http_message *response;
+    ASSERT_SUCCESS(s_create_response(&response, 200, headers, AWS_ARRAY_SIZE(headers), NULL));
+    ASSERT_NULL(aws_http_static_response_new(allocator, response));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+
+    aws_http_message_release(response);
+    ASSERT_SUCCESS(s_server_tester_clean_up());
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(h1_server_idle_timeout) {
+    (void)ctx;
+    struct aws_http1_connection_options http1_options;
+    AWS_ZERO_STRUCT(http1_options);
+    http1_options.idle_timeout_ms = 200;
+    ASSERT_SUCCESS(s_tester_init_ex(allocator, &http1_options));
+
+    ASSERT_SUCCESS(s_send_message_c_str("GET / HTTP/1.1\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_INT_EQUALS(1, s_tester.request_num);
+
+    /* The connection isn't idle while a request is in progress */
+    aws_thread_current_sleep(
+        aws_timestamp_convert(http1_options.idle_timeout_ms + 1, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_FALSE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+
+    struct aws_http_message *response;
+    ASSERT_SUCCESS(s_create_response(&response, 204, NULL, 0, NULL));
+    ASSERT_SUCCESS(aws_http_stream_send_response(s_tester.requests[0].request_handler, response));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_UINT_EQUALS(1, s_tester.requests[0].on_complete_cb_count);
+    ASSERT_FALSE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+
+    /* Once the response is sent, the connection is idle */
+    aws_thread_current_sleep(
+        aws_timestamp_convert(http1_options.idle_timeout_ms + 1, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, testing_channel_get_shutdown_error_code(&s_tester.testing_channel));
+
+    aws_http_message_destroy(response);
+    ASSERT_SUCCESS(s_server_tester_clean_up());
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(h1_server_max_requests_per_connection) {
+    (void)ctx;
+    struct aws_http1_connection_options http1_options;
+    AWS_ZERO_STRUCT(http1_options);
+    http1_options.max_requests = 2;
+    ASSERT_SUCCESS(s_tester_init_ex(allocator, &http1_options));
+
+    /* The 3rd request is never processed */
+    const char *incoming_requests = "GET /a HTTP/1.1\r\n"
+                                    "\r\n"
+                                    "GET /b HTTP/1.1\r\n"
+                                    "\r\n"
+                                    "GET /c HTTP/1.1\r\n"
+                                    "\r\n";
+    ASSERT_SUCCESS(s_send_message_c_str(incoming_requests));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_INT_EQUALS(2, s_tester.request_num);
+
+    struct aws_http_message *response;
+    ASSERT_SUCCESS(s_create_response(&response, 204, NULL, 0, NULL));
+    ASSERT_SUCCESS(aws_http_stream_send_response(s_tester.requests[0].request_handler, response));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_FALSE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+
+    /* The final response says the connection is closing, and it closes once the response is sent */
+    ASSERT_SUCCESS(aws_http_stream_send_response(s_tester.requests[1].request_handler, response));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_UINT_EQUALS(1, s_tester.requests[1].on_complete_cb_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, s_tester.requests[1].on_complete_error_code);
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, testing_channel_get_shutdown_error_code(&s_tester.testing_channel));
+
+    const char *expected = "HTTP/1.1 204 No Content\r\n"
+                           "\r\n"
+                           "HTTP/1.1 204 No Content\r\n"
+                           "Connection: close\r\n"
+                           "\r\n";
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(&s_tester.testing_channel, allocator, expected));
+
+    aws_http_message_destroy(response);
+    ASSERT_SUCCESS(s_server_tester_clean_up());
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(h1_server_drain_idle_connection) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator));
+
+    /* With no request in progress, there's nothing to wait for */
+    aws_http_connection_drain(s_tester.server_connection);
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, testing_channel_get_shutdown_error_code(&s_tester.testing_channel));
+
+    ASSERT_SUCCESS(s_server_tester_clean_up());
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(h1_server_drain_finishes_request_in_progress) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator));
+
+    ASSERT_SUCCESS(s_send_message_c_str("GET / HTTP/1.1\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_INT_EQUALS(1, s_tester.request_num);
+
+    aws_http_connection_drain(s_tester.server_connection);
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_FALSE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+    ASSERT_FALSE(aws_http_connection_new_requests_allowed(s_tester.server_connection));
+
+    /* Requests after the final one aren't processed */
+    ASSERT_SUCCESS(s_send_message_c_str("GET /two HTTP/1.1\r\n\r\n"));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_INT_EQUALS(1, s_tester.request_num);
+
+    /* The response says the connection is closing, and it closes once the response is sent */
+    struct aws_http_message *response;
+    ASSERT_SUCCESS(s_create_response(&response, 204, NULL, 0, NULL));
+    ASSERT_SUCCESS(aws_http_stream_send_response(s_tester.requests[0].request_handler, response));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_UINT_EQUALS(1, s_tester.requests[0].on_complete_cb_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, s_tester.requests[0].on_complete_error_code);
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, testing_channel_get_shutdown_error_code(&s_tester.testing_channel));
+
+    const char *expected = "HTTP/1.1 204 No Content\r\n"
+                           "Connection: close\r\n"
+                           "\r\n";
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(&s_tester.testing_channel, allocator, expected));
+
+    aws_http_message_destroy(response);
+    ASSERT_SUCCESS(s_server_tester_clean_up());
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(h1_server_sheds_request_when_overloaded) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator));
+
+    struct aws_http_server_admission_options admission_options = {
+        .max_in_flight_streams = 1,
+        .retry_after_sec = 5,
+    };
+    struct aws_http_server_admission *admission = aws_http_server_admission_new(allocator, NULL, &admission_options);
+    ASSERT_NOT_NULL(admission);
+    s_tester.server_connection->server_data->admission = admission;
+
+    /* The 1st request stays in flight, so the 2nd is shed without the user ever seeing it */
+    const char *incoming_requests = "GET / HTTP/1.1\r\n"
+                                    "\r\n"
+                                    "GET /two HTTP/1.1\r\n"
+                                    "\r\n";
+    ASSERT_SUCCESS(s_send_message_c_str(incoming_requests));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_INT_EQUALS(1, s_tester.request_num);
+
+    struct aws_http_message *response;
+    ASSERT_SUCCESS(s_create_response(&response, 204, NULL, 0, NULL));
+    ASSERT_SUCCESS(aws_http_stream_send_response(s_tester.requests[0].request_handler, response));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    const char *expected = "HTTP/1.1 204 No Content\r\n"
+                           "\r\n"
+                           "HTTP/1.1 503 Service Unavailable\r\n"
+                           "Retry-After: 5\r\n"
+                           "Content-Length: 0\r\n"
+                           "\r\n";
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(&s_tester.testing_channel, allocator, expected));
+    ASSERT_UINT_EQUALS(0, aws_atomic_load_int(&admission->in_flight_stream_count));
+
+    aws_http_message_destroy(response);
+    ASSERT_SUCCESS(s_server_tester_clean_up());
+    aws_http_server_admission_release(admission);
+    return AWS_OP_SUCCESS;
+}
+
 TEST_CASE(h1_server_send_response_body) {
 
     (void)ctx;
@@ -705,6 +959,61 @@ TEST_CASE(h1_server_send_multiple_responses_in_order) {
     return AWS_OP_SUCCESS;
 }
 
+/* Responses that are ready at the same time should be coalesced into one aws_io_message */
+TEST_CASE(h1_server_send_multiple_responses_coalesced) {
+
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator));
+
+    const char *incoming_request = "GET / HTTP/1.1\r\n"
+                                   "\r\n"
+                                   "GET / HTTP/1.1\r\n"
+                                   "\r\n"
+                                   "GET / HTTP/1.1\r\n"
+                                   "\r\n";
+    ASSERT_SUCCESS(s_send_message_c_str(incoming_request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    ASSERT_TRUE(s_tester.request_num == 3);
+
+    /* Send the 1st response last, so all 3 are ready when the connection starts writing */
+    struct aws_http_message *responses[3];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(responses); ++i) {
+        ASSERT_SUCCESS(s_create_response(&responses[i], 204, NULL, 0, NULL));
+    }
+    ASSERT_SUCCESS(aws_http_stream_send_response(s_tester.requests[2].request_handler, responses[2]));
+    ASSERT_SUCCESS(aws_http_stream_send_response(s_tester.requests[1].request_handler, responses[1]));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_TRUE(aws_linked_list_empty(testing_channel_get_written_message_queue(&s_tester.testing_channel)));
+
+    ASSERT_SUCCESS(aws_http_stream_send_response(s_tester.requests[0].request_handler, responses[0]));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* Check that EXACTLY 1 aws_io_message holds all 3 responses */
+    struct aws_linked_list *msgs = testing_channel_get_written_message_queue(&s_tester.testing_channel);
+    ASSERT_FALSE(aws_linked_list_empty(msgs));
+    ASSERT_PTR_EQUALS(aws_linked_list_front(msgs), aws_linked_list_back(msgs));
+
+    const char *expected = "HTTP/1.1 204 No Content\r\n"
+                           "\r\n"
+                           "HTTP/1.1 204 No Content\r\n"
+                           "\r\n"
+                           "HTTP/1.1 204 No Content\r\n"
+                           "\r\n";
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(&s_tester.testing_channel, allocator, expected));
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(responses); ++i) {
+        aws_http_message_destroy(responses[i]);
+    }
+    ASSERT_SUCCESS(s_server_tester_clean_up());
+
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_TRUE(s_tester.requests[i].on_complete_cb_count == 1);
+        ASSERT_TRUE(s_tester.requests[i].on_complete_error_code == AWS_ERROR_SUCCESS);
+    }
+    return AWS_OP_SUCCESS;
+}
+
 TEST_CASE(h1_server_send_multiple_responses_out_of_order) {
 
     (void)ctx;
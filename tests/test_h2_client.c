@@ -5,6 +5,7 @@
 
 #include "h2_test_helper.h"
 #include "stream_test_helper.h"
+#include <aws/common/thread.h>
 #include <aws/http/private/h2_connection.h>
 #include <aws/http/private/request_response_impl.h>
 #include <aws/http/request_response.h>
@@ -82,6 +83,15 @@ static struct tester {
     struct connection_user_data user_data;
 
     bool no_conn_manual_win_management;
+    uint32_t window_update_threshold_percent;
+    uint32_t bdp_max_window_size;
+    size_t write_batch_target_size;
+    uint32_t write_batch_max_delay_ms;
+    uint32_t lean_hpack_idle_ms;
+    uint32_t max_stream_resets_per_second;
+    uint32_t stream_reset_burst;
+    uint32_t max_control_frames_per_second;
+    uint32_t control_frame_burst;
 } s_tester;
 
 static int s_tester_init(struct aws_allocator *alloc, void *ctx) {
@@ -106,6 +116,15 @@ static int s_tester_init(struct aws_allocator *alloc, void *ctx) {
         .on_goaway_received = s_on_goaway_received,
         .on_remote_settings_change = s_on_remote_settings_change,
         .conn_manual_window_management = !s_tester.no_conn_manual_win_management,
+        .window_update_threshold_percent = s_tester.window_update_threshold_percent,
+        .bdp_max_window_size = s_tester.bdp_max_window_size,
+        .write_batch_target_size = s_tester.write_batch_target_size,
+        .write_batch_max_delay_ms = s_tester.write_batch_max_delay_ms,
+        .lean_hpack_idle_ms = s_tester.lean_hpack_idle_ms,
+        .max_stream_resets_per_second = s_tester.max_stream_resets_per_second,
+        .stream_reset_burst = s_tester.stream_reset_burst,
+        .max_control_frames_per_second = s_tester.max_control_frames_per_second,
+        .control_frame_burst = s_tester.control_frame_burst,
     };
 
     s_tester.connection =
@@ -187,6 +206,52 @@ TEST_CASE(h2_client_stream_create) {
     return s_tester_clean_up();
 }
 
+static int s_unused_decoder_new(
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor content_coding,
+    void *user_data,
+    struct aws_http_content_decoder **out_decoder) {
+
+    (void)allocator;
+    (void)content_coding;
+    (void)user_data;
+    (void)out_decoder;
+    return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+}
+
+/* Content decoding isn't supported on HTTP/2, the request must fail rather than deliver an undecoded body */
+TEST_CASE(h2_client_stream_content_decoding_unsupported) {
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    struct aws_http_header headers[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    ASSERT_SUCCESS(aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers)));
+
+    struct aws_http_content_decoding_options content_decoding = {
+        .accept_encoding = aws_byte_cursor_from_c_str("gzip"),
+        .new_decoder = s_unused_decoder_new,
+    };
+    struct aws_http_make_request_options options = {
+        .self_size = sizeof(options),
+        .request = request,
+        .content_decoding = &content_decoding,
+    };
+
+    ASSERT_NULL(aws_http_connection_make_request(s_tester.connection, &options));
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_UNSUPPORTED_PROTOCOL, aws_last_error());
+    /* The request wasn't touched */
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(headers), aws_http_message_get_header_count(request));
+
+    aws_http_message_release(request);
+    return s_tester_clean_up();
+}
+
 static void s_stream_cleans_up_on_destroy(void *data) {
     bool *destroyed = data;
     *destroyed = true;
@@ -397,6 +462,269 @@ TEST_CASE(h2_client_auto_ping_ack_higher_priority) {
     return s_tester_clean_up();
 }
 
+static int s_get_stats(struct aws_crt_statistics_http2_channel *out_stats) {
+    struct aws_array_list stats_list;
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&stats_list, s_tester.alloc, 1, sizeof(void *)));
+    s_tester.connection->channel_handler.vtable->gather_statistics(&s_tester.connection->channel_handler, &stats_list);
+    struct aws_crt_statistics_http2_channel *stats = NULL;
+    ASSERT_SUCCESS(aws_array_list_get_at(&stats_list, &stats, 0));
+    *out_stats = *stats;
+    aws_array_list_clean_up(&stats_list);
+    return AWS_OP_SUCCESS;
+}
+
+/* Test that a peer sending PINGs faster than allowed gets GOAWAY(ENHANCE_YOUR_CALM), and no more PING ACKs */
+TEST_CASE(h2_client_conn_err_control_frame_flood) {
+    s_tester.max_control_frames_per_second = 1;
+    /* the preface's SETTINGS spends one, leaving room for 2 PINGs */
+    s_tester.control_frame_burst = 3;
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    uint8_t opaque_data[AWS_HTTP2_PING_DATA_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7};
+    for (size_t i = 0; i < 5; ++i) {
+        struct aws_h2_frame *frame = aws_h2_frame_new_ping(allocator, false /*ack*/, opaque_data);
+        ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, frame));
+    }
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* validate that connection has closed */
+    ASSERT_FALSE(aws_http_connection_is_open(s_tester.connection));
+    ASSERT_INT_EQUALS(
+        AWS_ERROR_HTTP_PROTOCOL_ERROR, testing_channel_get_shutdown_error_code(&s_tester.testing_channel));
+
+    /* validate that only the PINGs within the burst were ACKed, then GOAWAY was sent */
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    size_t ping_ack_count = 0;
+    size_t frame_index = 0;
+    struct h2_decoded_frame *ping_frame;
+    while ((ping_frame = h2_decode_tester_find_frame(
+                &s_tester.peer.decode, AWS_H2_FRAME_T_PING, frame_index, &frame_index)) != NULL) {
+        ASSERT_TRUE(ping_frame->ack);
+        ++ping_ack_count;
+        ++frame_index;
+    }
+    ASSERT_UINT_EQUALS(2, ping_ack_count);
+
+    struct h2_decoded_frame *goaway =
+        h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_GOAWAY, 0, NULL);
+    ASSERT_NOT_NULL(goaway);
+    ASSERT_UINT_EQUALS(AWS_HTTP2_ERR_ENHANCE_YOUR_CALM, goaway->error_code);
+
+    struct aws_crt_statistics_http2_channel stats;
+    ASSERT_SUCCESS(s_get_stats(&stats));
+    ASSERT_UINT_EQUALS(4, stats.control_frames_received);
+    ASSERT_TRUE(stats.flood_detected);
+
+    return s_tester_clean_up();
+}
+
+/* Test that a peer sending RST_STREAM faster than allowed gets GOAWAY(ENHANCE_YOUR_CALM) */
+TEST_CASE(h2_client_conn_err_stream_reset_flood) {
+    s_tester.max_stream_resets_per_second = 1;
+    s_tester.stream_reset_burst = 1;
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct client_stream_tester stream_testers[2];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
+        ASSERT_SUCCESS(s_stream_tester_init(&stream_testers[i], request));
+    }
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* fake peer resets both streams. The first reset is within the burst, the second isn't */
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
+        struct aws_h2_frame *peer_frame = aws_h2_frame_new_rst_stream(
+            allocator, aws_http_stream_get_id(stream_testers[i].stream), AWS_HTTP2_ERR_CANCEL);
+        ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, peer_frame));
+    }
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* the first stream heard its RST_STREAM, the second was failed by the connection closing */
+    ASSERT_TRUE(stream_testers[0].complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_RST_STREAM_RECEIVED, stream_testers[0].on_complete_error_code);
+    ASSERT_TRUE(stream_testers[1].complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_CONNECTION_CLOSED, stream_testers[1].on_complete_error_code);
+    ASSERT_FALSE(aws_http_connection_is_open(s_tester.connection));
+
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    struct h2_decoded_frame *goaway =
+        h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_GOAWAY, 0, NULL);
+    ASSERT_NOT_NULL(goaway);
+    ASSERT_UINT_EQUALS(AWS_HTTP2_ERR_ENHANCE_YOUR_CALM, goaway->error_code);
+
+    struct aws_crt_statistics_http2_channel stats;
+    ASSERT_SUCCESS(s_get_stats(&stats));
+    ASSERT_UINT_EQUALS(2, stats.stream_resets_received);
+    ASSERT_TRUE(stats.flood_detected);
+
+    /* clean up */
+    aws_http_message_release(request);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
+        client_stream_tester_clean_up(&stream_testers[i]);
+    }
+    return s_tester_clean_up();
+}
+
+/* Test that a peer resetting each stream after its response completes doesn't count as a flood.
+ * That's allowed (RFC-9113 8.1), and some servers send RST_STREAM(NO_ERROR) after every response */
+TEST_CASE(h2_client_rst_stream_after_response_not_flood) {
+    s_tester.max_stream_resets_per_second = 1;
+    s_tester.stream_reset_burst = 1;
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+    };
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+
+    /* far more resets than the burst allows, each after its stream's response */
+    struct client_stream_tester stream_testers[5];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
+        ASSERT_SUCCESS(s_stream_tester_init(&stream_testers[i], request));
+        testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+        uint32_t stream_id = aws_http_stream_get_id(stream_testers[i].stream);
+        struct aws_h2_frame *response_frame =
+            aws_h2_frame_new_headers(allocator, stream_id, response_headers, true /*end_stream*/, 0, NULL);
+        ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+        struct aws_h2_frame *rst_frame = aws_h2_frame_new_rst_stream(allocator, stream_id, AWS_HTTP2_ERR_NO_ERROR);
+        ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, rst_frame));
+        testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+        ASSERT_TRUE(stream_testers[i].complete);
+        ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_testers[i].on_complete_error_code);
+        ASSERT_INT_EQUALS(200, stream_testers[i].response_status);
+    }
+
+    /* the connection is still open, and never sent GOAWAY */
+    ASSERT_TRUE(aws_http_connection_is_open(s_tester.connection));
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    ASSERT_NULL(h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_GOAWAY, 0, NULL));
+
+    struct aws_crt_statistics_http2_channel stats;
+    ASSERT_SUCCESS(s_get_stats(&stats));
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(stream_testers), stats.stream_resets_received);
+    ASSERT_FALSE(stats.flood_detected);
+
+    /* clean up */
+    aws_http_headers_release(response_headers);
+    aws_http_message_release(request);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
+        client_stream_tester_clean_up(&stream_testers[i]);
+    }
+    return s_tester_clean_up();
+}
+
+/* Test that client connections have no flood limits by default, since the floods they guard against target servers */
+TEST_CASE(h2_client_no_flood_limits_by_default) {
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* more PINGs than the server default burst */
+    uint8_t opaque_data[AWS_HTTP2_PING_DATA_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7};
+    const size_t num_pings = AWS_HTTP2_DEFAULT_CONTROL_FRAME_BURST + 1;
+    for (size_t i = 0; i < num_pings; ++i) {
+        struct aws_h2_frame *frame = aws_h2_frame_new_ping(allocator, false /*ack*/, opaque_data);
+        ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, frame));
+    }
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    ASSERT_TRUE(aws_http_connection_is_open(s_tester.connection));
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    ASSERT_NULL(h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_GOAWAY, 0, NULL));
+
+    struct aws_crt_statistics_http2_channel stats;
+    ASSERT_SUCCESS(s_get_stats(&stats));
+    ASSERT_FALSE(stats.flood_detected);
+
+    return s_tester_clean_up();
+}
+
+/* Test that a draining connection sends a graceful GOAWAY, and closes once its active stream completes */
+TEST_CASE(h2_client_drain_waits_for_active_streams) {
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    aws_http_connection_drain(s_tester.connection);
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* GOAWAY(NO_ERROR) went out, but the connection stays up for the active stream */
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    struct h2_decoded_frame *goaway =
+        h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_GOAWAY, 0, NULL);
+    ASSERT_NOT_NULL(goaway);
+    ASSERT_UINT_EQUALS(AWS_HTTP2_ERR_NO_ERROR, goaway->error_code);
+    ASSERT_FALSE(stream_tester.complete);
+    ASSERT_FALSE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+    ASSERT_FALSE(aws_http_connection_new_requests_allowed(s_tester.connection));
+
+    /* fake peer completes the stream, then the connection closes */
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "204"),
+    };
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+    struct aws_h2_frame *response_frame = aws_h2_frame_new_headers(
+        allocator, aws_http_stream_get_id(stream_tester.stream), response_headers, true /*end_stream*/, 0, NULL);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&s_tester.testing_channel));
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, testing_channel_get_shutdown_error_code(&s_tester.testing_channel));
+
+    /* clean up */
+    aws_http_headers_release(response_headers);
+    aws_http_message_release(request);
+    client_stream_tester_clean_up(&stream_tester);
+    return s_tester_clean_up();
+}
+
 /* Test client can automatically send SETTINGs ACK */
 TEST_CASE(h2_client_auto_settings_ack) {
     ASSERT_SUCCESS(s_tester_init(allocator, ctx));
@@ -509,6 +837,70 @@ TEST_CASE(h2_client_stream_complete) {
     return s_tester_clean_up();
 }
 
+/* Many streams active at once, completing in a different order than they started.
+ * Later streams reuse table slots left by earlier ones. */
+TEST_CASE(h2_client_stream_many_concurrent_out_of_order) {
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    /* fake peer sends connection preface */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+    };
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+
+    enum { STREAM_COUNT = 100 };
+    struct client_stream_tester *stream_testers =
+        aws_mem_calloc(allocator, STREAM_COUNT, sizeof(struct client_stream_tester));
+
+    for (int round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < STREAM_COUNT; ++i) {
+            ASSERT_SUCCESS(s_stream_tester_init(&stream_testers[i], request));
+        }
+        testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+        /* Complete every other stream in reverse order, then the rest in order */
+        for (size_t n = 0; n < STREAM_COUNT; ++n) {
+            size_t i = n < STREAM_COUNT / 2 ? STREAM_COUNT - 1 - (n * 2) : (n - STREAM_COUNT / 2) * 2;
+            ASSERT_FALSE(stream_testers[i].complete);
+
+            struct aws_h2_frame *response_frame = aws_h2_frame_new_headers(
+                allocator, aws_http_stream_get_id(stream_testers[i].stream), response_headers, true, 0, NULL);
+            ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+            testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+            ASSERT_TRUE(stream_testers[i].complete);
+            ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_testers[i].on_complete_error_code);
+            ASSERT_INT_EQUALS(200, stream_testers[i].response_status);
+        }
+
+        for (size_t i = 0; i < STREAM_COUNT; ++i) {
+            client_stream_tester_clean_up(&stream_testers[i]);
+        }
+    }
+
+    ASSERT_TRUE(aws_http_connection_is_open(s_tester.connection));
+
+    /* clean up */
+    aws_mem_release(allocator, stream_testers);
+    aws_http_headers_release(response_headers);
+    aws_http_message_release(request);
+    return s_tester_clean_up();
+}
+
 /* Calling aws_http_connection_close() should cleanly shut down connection */
 TEST_CASE(h2_client_close) {
     ASSERT_SUCCESS(s_tester_init(allocator, ctx));
@@ -749,6 +1141,114 @@ TEST_CASE(h2_client_stream_with_cookies_headers) {
     return s_tester_clean_up();
 }
 
+static struct aws_http_message *s_new_extended_connect_request(struct aws_allocator *allocator) {
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    AWS_FATAL_ASSERT(request);
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "CONNECT"),
+        DEFINE_HEADER(":protocol", "websocket"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/chat"),
+        DEFINE_HEADER(":authority", "example.com"),
+        DEFINE_HEADER("sec-websocket-version", "13"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+    return request;
+}
+
+/* Test that extended CONNECT (RFC-8441) is sent once the peer enables it */
+TEST_CASE(h2_client_stream_extended_connect) {
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    /* fake peer sends connection preface, enabling the CONNECT protocol */
+    struct aws_http2_setting settings_array[] = {
+        {.id = AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL, .value = 1},
+    };
+    struct aws_h2_frame *settings =
+        aws_h2_frame_new_settings(allocator, settings_array, AWS_ARRAY_SIZE(settings_array), false /*ack*/);
+    ASSERT_NOT_NULL(settings);
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface(&s_tester.peer, settings));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* the setting is reported to the user */
+    ASSERT_UINT_EQUALS(1, s_tester.user_data.num_settings);
+    ASSERT_UINT_EQUALS(AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL, s_tester.user_data.remote_settings_array[0].id);
+    ASSERT_UINT_EQUALS(1, s_tester.user_data.remote_settings_array[0].value);
+
+    struct aws_http_message *request = s_new_extended_connect_request(allocator);
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* validate that the request went out, with its :protocol */
+    ASSERT_FALSE(stream_tester.complete);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    struct h2_decoded_frame *sent_headers_frame = h2_decode_tester_latest_frame(&s_tester.peer.decode);
+    ASSERT_INT_EQUALS(AWS_H2_FRAME_T_HEADERS, sent_headers_frame->type);
+    ASSERT_SUCCESS(s_compare_headers(aws_http_message_get_headers(request), sent_headers_frame->headers));
+
+    /* clean up */
+    aws_http_message_release(request);
+    client_stream_tester_clean_up(&stream_tester);
+    return s_tester_clean_up();
+}
+
+/* Extended CONNECT fails if the peer never enabled it, and nothing is sent */
+TEST_CASE(h2_client_stream_err_extended_connect_not_enabled) {
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    struct aws_http_message *request = s_new_extended_connect_request(allocator);
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* validate that stream completed with error */
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_EXTENDED_CONNECT_NOT_SUPPORTED, stream_tester.on_complete_error_code);
+    ASSERT_TRUE(aws_http_connection_is_open(s_tester.connection));
+
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    ASSERT_NULL(h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_HEADERS, 0, NULL));
+
+    /* clean up */
+    aws_http_message_release(request);
+    client_stream_tester_clean_up(&stream_tester);
+    return s_tester_clean_up();
+}
+
+/* "A sender MUST NOT send a SETTINGS_ENABLE_CONNECT_PROTOCOL parameter with the value of 0
+ * after previously sending a value of 1" (RFC-8441 3) */
+TEST_CASE(h2_client_conn_err_extended_connect_disabled_after_enabled) {
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    struct aws_http2_setting enable[] = {{.id = AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL, .value = 1}};
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface(
+        &s_tester.peer, aws_h2_frame_new_settings(allocator, enable, 1, false /*ack*/)));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    struct aws_http2_setting disable[] = {{.id = AWS_HTTP2_SETTINGS_ENABLE_CONNECT_PROTOCOL, .value = 0}};
+    ASSERT_SUCCESS(
+        h2_fake_peer_send_frame(&s_tester.peer, aws_h2_frame_new_settings(allocator, disable, 1, false /*ack*/)));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* validate the connection completed with error, and the client sent GOAWAY */
+    ASSERT_FALSE(aws_http_connection_is_open(s_tester.connection));
+    ASSERT_INT_EQUALS(
+        AWS_ERROR_HTTP_PROTOCOL_ERROR, testing_channel_get_shutdown_error_code(&s_tester.testing_channel));
+
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    struct h2_decoded_frame *goaway =
+        h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_GOAWAY, 0, NULL);
+    ASSERT_NOT_NULL(goaway);
+    ASSERT_UINT_EQUALS(AWS_HTTP2_ERR_PROTOCOL_ERROR, goaway->error_code);
+
+    return s_tester_clean_up();
+}
+
 /* Receiving malformed headers should result in a "Stream Error", not a "Connection Error". */
 TEST_CASE(h2_client_stream_err_malformed_header) {
     ASSERT_SUCCESS(s_tester_init(allocator, ctx));
@@ -1047,7 +1547,73 @@ TEST_CASE(h2_client_stream_receive_info_headers) {
 
     /* clean up */
     aws_http_headers_release(response_headers);
-    aws_http_headers_release(info_response_headers);
+    aws_http_headers_release(info_response_headers);
+    aws_http_message_release(request);
+    client_stream_tester_clean_up(&stream_tester);
+    return s_tester_clean_up();
+}
+
+/* The whole header-block should reach the user in a single on_response_headers callback */
+TEST_CASE(h2_client_stream_receive_headers_in_one_batch) {
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    /* fake peer sends connection preface */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* send request */
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
+
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    uint32_t stream_id = aws_http_stream_get_id(stream_tester.stream);
+
+    /* fake peer sends response headers, and separate cookies which the decoder concatenates */
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+        DEFINE_HEADER("date", "Wed, 01 Apr 2020 23:02:49 GMT"),
+        DEFINE_HEADER("cookie", "a=b"),
+        DEFINE_HEADER("content-type", "text/plain"),
+        DEFINE_HEADER("cookie", "c=d"),
+        DEFINE_HEADER("content-length", "0"),
+    };
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+    struct aws_h2_frame *peer_frame =
+        aws_h2_frame_new_headers(allocator, stream_id, response_headers, true /*end_stream*/, 0, NULL);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, peer_frame));
+
+    /* validate that client received complete response, all at once */
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_TRUE(stream_tester.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester.on_complete_error_code);
+    ASSERT_INT_EQUALS(200, stream_tester.response_status);
+    ASSERT_UINT_EQUALS(1, stream_tester.on_response_headers_count);
+
+    struct aws_http_header expected_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+        DEFINE_HEADER("date", "Wed, 01 Apr 2020 23:02:49 GMT"),
+        DEFINE_HEADER("content-type", "text/plain"),
+        DEFINE_HEADER("content-length", "0"),
+        DEFINE_HEADER("cookie", "a=b; c=d"),
+    };
+    struct aws_http_headers *expected_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(expected_headers, expected_headers_src, AWS_ARRAY_SIZE(expected_headers_src));
+    ASSERT_SUCCESS(s_compare_headers(expected_headers, stream_tester.response_headers));
+
+    /* clean up */
+    aws_http_headers_release(expected_headers);
+    aws_http_headers_release(response_headers);
     aws_http_message_release(request);
     client_stream_tester_clean_up(&stream_tester);
     return s_tester_clean_up();
@@ -2421,60 +2987,395 @@ TEST_CASE(h2_client_stream_send_data_controlled_by_connection_and_stream_window_
         true /*end_stream*/,
         true /*skip_check_data*/));
 
-    /* finally, send responses and ensure all streams complete successfully */
-    struct aws_http_header response_headers_src[] = {DEFINE_HEADER(":status", "200")};
-    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
-    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
-    for (size_t i = 0; i < NUM_STREAMS; ++i) {
-        struct aws_h2_frame *response_frame = aws_h2_frame_new_headers(
-            allocator,
-            aws_http_stream_get_id(stream_testers[i].stream),
-            response_headers,
-            true /* end_stream */,
-            0,
-            NULL);
-        ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+    /* finally, send responses and ensure all streams complete successfully */
+    struct aws_http_header response_headers_src[] = {DEFINE_HEADER(":status", "200")};
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+        struct aws_h2_frame *response_frame = aws_h2_frame_new_headers(
+            allocator,
+            aws_http_stream_get_id(stream_testers[i].stream),
+            response_headers,
+            true /* end_stream */,
+            0,
+            NULL);
+        ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+    }
+
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+        ASSERT_TRUE(stream_testers[i].complete);
+        ASSERT_INT_EQUALS(200, stream_testers[i].response_status);
+    }
+
+    ASSERT_TRUE(aws_http_connection_is_open(s_tester.connection));
+
+    /* clean up */
+    aws_http_headers_release(response_headers);
+    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+        client_stream_tester_clean_up(&stream_testers[i]);
+        aws_http_message_release(requests[i]);
+        aws_input_stream_release(request_bodies[i]);
+        aws_byte_buf_clean_up(&request_body_bufs[i]);
+    }
+    return s_tester_clean_up();
+}
+
+/* Test receiving a response with DATA frames, the window update frame will be sent */
+TEST_CASE(h2_client_stream_send_window_update) {
+    /* Enable automatic window manager management */
+    s_tester.no_conn_manual_win_management = true;
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    /* fake peer sends connection preface */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    /* Check the inital window update frame has been sent to maximize the connection window */
+    size_t initial_window_update_index = 0;
+    struct h2_decoded_frame *initial_connection_window_update_frame = h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode, AWS_H2_FRAME_T_WINDOW_UPDATE, 0 /*stream_id*/, 0 /*idx*/, &initial_window_update_index);
+    ASSERT_NOT_NULL(initial_connection_window_update_frame);
+    ASSERT_UINT_EQUALS(
+        AWS_H2_WINDOW_UPDATE_MAX - AWS_H2_INIT_WINDOW_SIZE,
+        initial_connection_window_update_frame->window_size_increment);
+
+    /* send request */
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    uint32_t stream_id = aws_http_stream_get_id(stream_tester.stream);
+
+    /* fake peer sends response headers */
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+    };
+
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+
+    struct aws_h2_frame *response_frame =
+        aws_h2_frame_new_headers(allocator, stream_id, response_headers, false /*end_stream*/, 0, NULL);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+
+    /* fake peer sends 1 DATA frame */
+    const char *body_src = "hello";
+    ASSERT_SUCCESS(h2_fake_peer_send_data_frame_str(&s_tester.peer, stream_id, body_src, false /*end_stream*/));
+
+    /* check that 2 WINDOW_UPDATE frames have been sent.
+     * 1 for the connection, and 1 for the stream */
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    struct h2_decoded_frame *stream_window_update_frame = h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode, AWS_H2_FRAME_T_WINDOW_UPDATE, stream_id, 0 /*idx*/, NULL);
+    ASSERT_NOT_NULL(stream_window_update_frame);
+    ASSERT_UINT_EQUALS(5, stream_window_update_frame->window_size_increment);
+
+    struct h2_decoded_frame *connection_window_update_frame = h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode,
+        AWS_H2_FRAME_T_WINDOW_UPDATE,
+        0 /*stream_id*/,
+        initial_window_update_index + 1 /*idx*/,
+        NULL);
+    ASSERT_NOT_NULL(connection_window_update_frame);
+    ASSERT_UINT_EQUALS(5, connection_window_update_frame->window_size_increment);
+
+    /* clean up */
+    aws_http_headers_release(response_headers);
+    aws_http_message_release(request);
+    client_stream_tester_clean_up(&stream_tester);
+    return s_tester_clean_up();
+}
+
+/* Test that WINDOW_UPDATEs are held back and merged until the threshold fraction of the window is consumed */
+TEST_CASE(h2_client_stream_coalesce_window_update) {
+    s_tester.no_conn_manual_win_management = true;
+    s_tester.window_update_threshold_percent = 50;
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    /* fake peer sends connection preface */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    /* The initial connection WINDOW_UPDATE is still sent right away */
+    size_t initial_window_update_index = 0;
+    ASSERT_NOT_NULL(h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode, AWS_H2_FRAME_T_WINDOW_UPDATE, 0 /*stream_id*/, 0 /*idx*/, &initial_window_update_index));
+
+    /* send request */
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    uint32_t stream_id = aws_http_stream_get_id(stream_tester.stream);
+
+    /* fake peer sends response headers */
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+    };
+
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+
+    struct aws_h2_frame *response_frame =
+        aws_h2_frame_new_headers(allocator, stream_id, response_headers, false /*end_stream*/, 0, NULL);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+
+    /* fake peer sends a max-size DATA frame, which uses a quarter of the stream's window */
+    uint8_t body_src[16384];
+    memset(body_src, 'a', sizeof(body_src));
+    struct aws_byte_cursor body_cursor = aws_byte_cursor_from_array(body_src, sizeof(body_src));
+    ASSERT_SUCCESS(h2_fake_peer_send_data_frame(&s_tester.peer, stream_id, body_cursor, false /*end_stream*/));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    /* not enough of the window has been consumed, no WINDOW_UPDATE yet */
+    ASSERT_NULL(h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode, AWS_H2_FRAME_T_WINDOW_UPDATE, stream_id, 0 /*idx*/, NULL));
+
+    /* another quarter reaches the threshold, a single WINDOW_UPDATE covers both DATA frames */
+    ASSERT_SUCCESS(h2_fake_peer_send_data_frame(&s_tester.peer, stream_id, body_cursor, false /*end_stream*/));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    size_t stream_window_update_index = 0;
+    struct h2_decoded_frame *stream_window_update_frame = h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode, AWS_H2_FRAME_T_WINDOW_UPDATE, stream_id, 0 /*idx*/, &stream_window_update_index);
+    ASSERT_NOT_NULL(stream_window_update_frame);
+    ASSERT_UINT_EQUALS(2 * sizeof(body_src), stream_window_update_frame->window_size_increment);
+    ASSERT_NULL(h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode,
+        AWS_H2_FRAME_T_WINDOW_UPDATE,
+        stream_id,
+        stream_window_update_index + 1 /*idx*/,
+        NULL));
+
+    /* the connection's window is huge, so none of its increments have been sent */
+    ASSERT_NULL(h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode,
+        AWS_H2_FRAME_T_WINDOW_UPDATE,
+        0 /*stream_id*/,
+        initial_window_update_index + 1 /*idx*/,
+        NULL));
+
+    /* clean up */
+    aws_http_headers_release(response_headers);
+    aws_http_message_release(request);
+    client_stream_tester_clean_up(&stream_tester);
+    return s_tester_clean_up();
+}
+
+/* Peer sends a frame larger than the window size we had on stream, will result in stream error */
+/* Test that a full window of DATA received within one PING round trip grows the stream window */
+TEST_CASE(h2_client_bdp_grows_stream_window) {
+    s_tester.no_conn_manual_win_management = true;
+    s_tester.bdp_max_window_size = 200000;
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    /* fake peer sends connection preface, and ACKs the initial settings */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    struct aws_h2_frame *peer_frame = aws_h2_frame_new_settings(allocator, NULL, 0, true /*ack*/);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, peer_frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    /* send request */
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    uint32_t stream_id = aws_http_stream_get_id(stream_tester.stream);
+
+    /* fake peer sends response headers */
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+    };
+
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+
+    struct aws_h2_frame *response_frame =
+        aws_h2_frame_new_headers(allocator, stream_id, response_headers, false /*end_stream*/, 0, NULL);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+
+    /* fake peer sends a full window of DATA. The first DATA frame makes the client send a PING */
+    uint8_t body_src[16384];
+    memset(body_src, 'a', sizeof(body_src));
+    struct aws_byte_cursor body_cursor = aws_byte_cursor_from_array(body_src, sizeof(body_src));
+    for (size_t i = 0; i < 4; ++i) {
+        ASSERT_SUCCESS(h2_fake_peer_send_data_frame(&s_tester.peer, stream_id, body_cursor, false /*end_stream*/));
+    }
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    size_t ping_index = 0;
+    struct h2_decoded_frame *ping_frame =
+        h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_PING, 0 /*idx*/, &ping_index);
+    ASSERT_NOT_NULL(ping_frame);
+    ASSERT_FALSE(ping_frame->ack);
+    /* only one PING while the sample is being measured */
+    ASSERT_NULL(h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_PING, ping_index + 1, NULL));
+
+    /* fake peer ACKs the PING. The whole window arrived within the round trip, so the client doubles the window */
+    peer_frame = aws_h2_frame_new_ping(allocator, true /*ack*/, ping_frame->ping_opaque_data);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, peer_frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    struct h2_decoded_frame *settings_frame = h2_decode_tester_latest_frame(&s_tester.peer.decode);
+    ASSERT_UINT_EQUALS(AWS_H2_FRAME_T_SETTINGS, settings_frame->type);
+    ASSERT_FALSE(settings_frame->ack);
+    ASSERT_UINT_EQUALS(1, settings_frame->settings.length);
+    struct aws_http2_setting setting_received;
+    aws_array_list_front(&settings_frame->settings, &setting_received);
+    ASSERT_UINT_EQUALS(AWS_HTTP2_SETTINGS_INITIAL_WINDOW_SIZE, setting_received.id);
+    ASSERT_UINT_EQUALS(4 * sizeof(body_src) * 2, setting_received.value);
+
+    /* fake peer ACKs the SETTINGS, the new window is in use */
+    peer_frame = aws_h2_frame_new_settings(allocator, NULL, 0, true /*ack*/);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, peer_frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    struct aws_http2_setting settings_get[AWS_HTTP2_SETTINGS_COUNT];
+    aws_http2_connection_get_local_settings(s_tester.connection, settings_get);
+    ASSERT_UINT_EQUALS(4 * sizeof(body_src) * 2, settings_get[AWS_HTTP2_SETTINGS_INITIAL_WINDOW_SIZE - 1].value);
+
+    /* the next sample can only grow the window up to the ceiling */
+    ASSERT_SUCCESS(h2_fake_peer_send_data_frame(&s_tester.peer, stream_id, body_cursor, false /*end_stream*/));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    ping_frame = h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_PING, ping_index + 1, &ping_index);
+    ASSERT_NOT_NULL(ping_frame);
+    for (size_t i = 0; i < 6; ++i) {
+        ASSERT_SUCCESS(h2_fake_peer_send_data_frame(&s_tester.peer, stream_id, body_cursor, false /*end_stream*/));
+    }
+    peer_frame = aws_h2_frame_new_ping(allocator, true /*ack*/, ping_frame->ping_opaque_data);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, peer_frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    settings_frame = h2_decode_tester_latest_frame(&s_tester.peer.decode);
+    ASSERT_UINT_EQUALS(AWS_H2_FRAME_T_SETTINGS, settings_frame->type);
+    aws_array_list_front(&settings_frame->settings, &setting_received);
+    ASSERT_UINT_EQUALS(200000, setting_received.value);
+
+    /* clean up */
+    aws_http_headers_release(response_headers);
+    aws_http_message_release(request);
+    client_stream_tester_clean_up(&stream_tester);
+    return s_tester_clean_up();
+}
+
+/* Test that with write batching, frames queued by different streams in the same tick go out in one message */
+TEST_CASE(h2_client_write_batching) {
+    s_tester.write_batch_target_size = SIZE_MAX;
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    /* get connection preface and acks out of the way */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    /* send 2 requests */
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct client_stream_tester stream_testers[2];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
+        ASSERT_SUCCESS(s_stream_tester_init(&stream_testers[i], request));
     }
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    size_t frames_count = h2_decode_tester_frame_count(&s_tester.peer.decode);
 
+    /* Each reset runs in its own stream task, and each task queues an RST_STREAM */
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
+        ASSERT_SUCCESS(aws_http2_stream_reset(stream_testers[i].stream, AWS_HTTP2_ERR_CANCEL));
+    }
     testing_channel_drain_queued_tasks(&s_tester.testing_channel);
-    for (size_t i = 0; i < NUM_STREAMS; ++i) {
-        ASSERT_TRUE(stream_testers[i].complete);
-        ASSERT_INT_EQUALS(200, stream_testers[i].response_status);
+
+    /* Both RST_STREAM frames were written in a single message */
+    struct aws_linked_list *written_msgs = testing_channel_get_written_message_queue(&s_tester.testing_channel);
+    ASSERT_FALSE(aws_linked_list_empty(written_msgs));
+    ASSERT_PTR_EQUALS(aws_linked_list_front(written_msgs), aws_linked_list_back(written_msgs));
+
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    ASSERT_UINT_EQUALS(frames_count + 2, h2_decode_tester_frame_count(&s_tester.peer.decode));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
+        ASSERT_NOT_NULL(h2_decode_tester_find_stream_frame(
+            &s_tester.peer.decode,
+            AWS_H2_FRAME_T_RST_STREAM,
+            aws_http_stream_get_id(stream_testers[i].stream),
+            frames_count /*idx*/,
+            NULL));
     }
 
-    ASSERT_TRUE(aws_http_connection_is_open(s_tester.connection));
+    /* The counters report what was written */
+    struct aws_array_list stats_list;
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&stats_list, allocator, 1, sizeof(void *)));
+    s_tester.connection->channel_handler.vtable->gather_statistics(&s_tester.connection->channel_handler, &stats_list);
+    struct aws_crt_statistics_http2_channel *stats = NULL;
+    ASSERT_SUCCESS(aws_array_list_get_at(&stats_list, &stats, 0));
+    ASSERT_TRUE(stats->messages_written > 0);
+    ASSERT_TRUE(stats->bytes_written > 0);
+    ASSERT_TRUE(stats->message_capacity_written >= stats->bytes_written);
+    aws_array_list_clean_up(&stats_list);
 
     /* clean up */
-    aws_http_headers_release(response_headers);
-    for (size_t i = 0; i < NUM_STREAMS; ++i) {
+    aws_http_message_release(request);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(stream_testers); ++i) {
         client_stream_tester_clean_up(&stream_testers[i]);
-        aws_http_message_release(requests[i]);
-        aws_input_stream_release(request_bodies[i]);
-        aws_byte_buf_clean_up(&request_body_bufs[i]);
     }
     return s_tester_clean_up();
 }
 
-/* Test receiving a response with DATA frames, the window update frame will be sent */
-TEST_CASE(h2_client_stream_send_window_update) {
-    /* Enable automatic window manager management */
-    s_tester.no_conn_manual_win_management = true;
+/* Test that a PING ACK is written right away, along with the batch being held, instead of waiting for the deadline */
+TEST_CASE(h2_client_write_batch_flushed_by_ping) {
+    s_tester.write_batch_target_size = SIZE_MAX;
+    s_tester.write_batch_max_delay_ms = 60000;
     ASSERT_SUCCESS(s_tester_init(allocator, ctx));
 
-    /* fake peer sends connection preface */
+    /* get connection preface and acks out of the way */
     ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
     testing_channel_drain_queued_tasks(&s_tester.testing_channel);
     ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
-    /* Check the inital window update frame has been sent to maximize the connection window */
-    size_t initial_window_update_index = 0;
-    struct h2_decoded_frame *initial_connection_window_update_frame = h2_decode_tester_find_stream_frame(
-        &s_tester.peer.decode, AWS_H2_FRAME_T_WINDOW_UPDATE, 0 /*stream_id*/, 0 /*idx*/, &initial_window_update_index);
-    ASSERT_NOT_NULL(initial_connection_window_update_frame);
-    ASSERT_UINT_EQUALS(
-        AWS_H2_WINDOW_UPDATE_MAX - AWS_H2_INIT_WINDOW_SIZE,
-        initial_connection_window_update_frame->window_size_increment);
+    size_t frames_count = h2_decode_tester_frame_count(&s_tester.peer.decode);
 
-    /* send request */
+    /* The request's HEADERS are held, waiting for more frames to fill the message */
     struct aws_http_message *request = aws_http2_message_new_request(allocator);
     ASSERT_NOT_NULL(request);
 
@@ -2488,51 +3389,124 @@ TEST_CASE(h2_client_stream_send_window_update) {
     struct client_stream_tester stream_tester;
     ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
     testing_channel_drain_queued_tasks(&s_tester.testing_channel);
-    uint32_t stream_id = aws_http_stream_get_id(stream_tester.stream);
 
-    /* fake peer sends response headers */
+    struct aws_linked_list *written_msgs = testing_channel_get_written_message_queue(&s_tester.testing_channel);
+    ASSERT_TRUE(aws_linked_list_empty(written_msgs));
+
+    /* The PING ACK goes out in the held message, long before the deadline */
+    uint8_t opaque_data[AWS_HTTP2_PING_DATA_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7};
+    struct aws_h2_frame *frame = aws_h2_frame_new_ping(allocator, false /*ack*/, opaque_data);
+    ASSERT_NOT_NULL(frame);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    ASSERT_FALSE(aws_linked_list_empty(written_msgs));
+    ASSERT_PTR_EQUALS(aws_linked_list_front(written_msgs), aws_linked_list_back(written_msgs));
+
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    ASSERT_UINT_EQUALS(frames_count + 2, h2_decode_tester_frame_count(&s_tester.peer.decode));
+    ASSERT_NOT_NULL(h2_decode_tester_find_stream_frame(
+        &s_tester.peer.decode,
+        AWS_H2_FRAME_T_HEADERS,
+        aws_http_stream_get_id(stream_tester.stream),
+        frames_count /*idx*/,
+        NULL));
+    struct h2_decoded_frame *ping_ack_frame =
+        h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_PING, frames_count /*idx*/, NULL);
+    ASSERT_NOT_NULL(ping_ack_frame);
+    ASSERT_TRUE(ping_ack_frame->ack);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        opaque_data, AWS_HTTP2_PING_DATA_SIZE, ping_ack_frame->ping_opaque_data, AWS_HTTP2_PING_DATA_SIZE);
+
+    /* clean up */
+    aws_http_message_release(request);
+    client_stream_tester_clean_up(&stream_tester);
+    return s_tester_clean_up();
+}
+
+/* With lean HPACK, a small header table is advertised, and HPACK memory is released once the connection goes idle */
+TEST_CASE(h2_client_lean_hpack) {
+    s_tester.lean_hpack_idle_ms = 50;
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+
+    /* Nothing's allocated until headers are sent or received */
+    ASSERT_UINT_EQUALS(0, aws_http2_connection_get_hpack_memory_usage(s_tester.connection));
+
+    /* The initial SETTINGS has the small table size, after the user's settings */
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    struct h2_decoded_frame *settings_frame =
+        h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_SETTINGS, 0, NULL);
+    ASSERT_NOT_NULL(settings_frame);
+    ASSERT_UINT_EQUALS(2, settings_frame->settings.length);
+    struct aws_http2_setting setting_received;
+    ASSERT_SUCCESS(aws_array_list_get_at(&settings_frame->settings, &setting_received, 1));
+    ASSERT_UINT_EQUALS(AWS_HTTP2_SETTINGS_HEADER_TABLE_SIZE, setting_received.id);
+    ASSERT_UINT_EQUALS(AWS_HTTP2_LEAN_HPACK_HEADER_TABLE_SIZE, setting_received.value);
+
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+        DEFINE_HEADER("user-agent", "aws-sdk-cpp/1.11.0"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct client_stream_tester stream_tester;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester, request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
     struct aws_http_header response_headers_src[] = {
         DEFINE_HEADER(":status", "200"),
+        DEFINE_HEADER("date", "Wed, 01 Apr 2020 23:02:49 GMT"),
     };
-
     struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
     aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
-
-    struct aws_h2_frame *response_frame =
-        aws_h2_frame_new_headers(allocator, stream_id, response_headers, false /*end_stream*/, 0, NULL);
+    struct aws_h2_frame *response_frame = aws_h2_frame_new_headers(
+        allocator, aws_http_stream_get_id(stream_tester.stream), response_headers, true /*end_stream*/, 0, NULL);
     ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_TRUE(stream_tester.complete);
 
-    /* fake peer sends 1 DATA frame */
-    const char *body_src = "hello";
-    ASSERT_SUCCESS(h2_fake_peer_send_data_frame_str(&s_tester.peer, stream_id, body_src, false /*end_stream*/));
+    size_t busy_usage = aws_http2_connection_get_hpack_memory_usage(s_tester.connection);
+    ASSERT_TRUE(busy_usage > 0);
 
-    /* check that 2 WINDOW_UPDATE frames have been sent.
-     * 1 for the connection, and 1 for the stream */
+    /* Once idle long enough, memory is released */
+    aws_thread_current_sleep(aws_timestamp_convert(
+        s_tester.lean_hpack_idle_ms + 1, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
     testing_channel_drain_queued_tasks(&s_tester.testing_channel);
-    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    size_t idle_usage = aws_http2_connection_get_hpack_memory_usage(s_tester.connection);
+    ASSERT_TRUE(idle_usage < busy_usage);
 
-    struct h2_decoded_frame *stream_window_update_frame = h2_decode_tester_find_stream_frame(
-        &s_tester.peer.decode, AWS_H2_FRAME_T_WINDOW_UPDATE, stream_id, 0 /*idx*/, NULL);
-    ASSERT_NOT_NULL(stream_window_update_frame);
-    ASSERT_UINT_EQUALS(5, stream_window_update_frame->window_size_increment);
+    /* The connection still works. The next request tells the peer the client's table was emptied */
+    struct client_stream_tester stream_tester2;
+    ASSERT_SUCCESS(s_stream_tester_init(&stream_tester2, request));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    struct h2_decoded_frame *sent_headers_frame = h2_decode_tester_latest_frame(&s_tester.peer.decode);
+    ASSERT_INT_EQUALS(AWS_H2_FRAME_T_HEADERS, sent_headers_frame->type);
+    ASSERT_SUCCESS(s_compare_headers(aws_http_message_get_headers(request), sent_headers_frame->headers));
 
-    struct h2_decoded_frame *connection_window_update_frame = h2_decode_tester_find_stream_frame(
-        &s_tester.peer.decode,
-        AWS_H2_FRAME_T_WINDOW_UPDATE,
-        0 /*stream_id*/,
-        initial_window_update_index + 1 /*idx*/,
-        NULL);
-    ASSERT_NOT_NULL(connection_window_update_frame);
-    ASSERT_UINT_EQUALS(5, connection_window_update_frame->window_size_increment);
+    response_frame = aws_h2_frame_new_headers(
+        allocator, aws_http_stream_get_id(stream_tester2.stream), response_headers, true /*end_stream*/, 0, NULL);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, response_frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_TRUE(stream_tester2.complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, stream_tester2.on_complete_error_code);
+    ASSERT_TRUE(aws_http_connection_is_open(s_tester.connection));
 
     /* clean up */
     aws_http_headers_release(response_headers);
     aws_http_message_release(request);
     client_stream_tester_clean_up(&stream_tester);
+    client_stream_tester_clean_up(&stream_tester2);
     return s_tester_clean_up();
 }
 
-/* Peer sends a frame larger than the window size we had on stream, will result in stream error */
 TEST_CASE(h2_client_stream_err_received_data_flow_control) {
 
     ASSERT_SUCCESS(s_tester_init(allocator, ctx));
@@ -4201,6 +5175,49 @@ TEST_CASE(h2_client_send_ping_successfully_receive_ack) {
     return s_tester_clean_up();
 }
 
+/* PING round trips are folded into the connection's statistics */
+TEST_CASE(h2_client_statistics_report_rtt) {
+
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+    /* get connection preface and acks out of the way */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    struct ping_user_data data = {.rtt_ns = 0, .error_code = INT32_MAX};
+    ASSERT_SUCCESS(aws_http2_connection_ping(s_tester.connection, NULL, on_ping_complete, &data));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    struct h2_decoded_frame *ping_frame =
+        h2_decode_tester_find_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_PING, 0, NULL);
+    ASSERT_NOT_NULL(ping_frame);
+
+    /* fake peer send PING ACK */
+    struct aws_h2_frame *peer_frame = aws_h2_frame_new_ping(allocator, true /*ACK*/, ping_frame->ping_opaque_data);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&s_tester.peer, peer_frame));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_INT_EQUALS(0, data.error_code);
+
+    struct aws_array_list stats_list;
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&stats_list, allocator, 1, sizeof(void *)));
+    s_tester.connection->channel_handler.vtable->gather_statistics(&s_tester.connection->channel_handler, &stats_list);
+    struct aws_crt_statistics_http2_channel *stats = NULL;
+    ASSERT_SUCCESS(aws_array_list_get_at(&stats_list, &stats, 0));
+
+    /* The first sample seeds the estimators */
+    ASSERT_UINT_EQUALS(data.rtt_ns, stats->smoothed_rtt_ns);
+    ASSERT_UINT_EQUALS(data.rtt_ns, stats->min_rtt_ns);
+    ASSERT_UINT_EQUALS(data.rtt_ns / 2, stats->rtt_variance_ns);
+
+    /* Nothing flow-controlled was sent or received */
+    ASSERT_UINT_EQUALS(AWS_H2_INIT_WINDOW_SIZE, stats->window_size_peer);
+    ASSERT_UINT_EQUALS(0, stats->stalled_window_stream_count);
+    ASSERT_TRUE(stats->bytes_read > 0);
+    aws_array_list_clean_up(&stats_list);
+
+    /* clean up */
+    return s_tester_clean_up();
+}
+
 /* Test the user request a PING, but peer never sends PING ACK back */
 TEST_CASE(h2_client_send_ping_no_ack_received) {
 
@@ -5708,3 +6725,198 @@ TEST_CASE(h2_client_manual_data_write_connection_close) {
     aws_input_stream_release(data_stream);
     return s_tester_clean_up();
 }
+
+struct h2_client_zero_copy_write_ctx {
+    int on_complete_count;
+    int complete_error_code;
+};
+
+static void s_on_zero_copy_write_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct h2_client_zero_copy_write_ctx *test_ctx = user_data;
+    test_ctx->on_complete_count++;
+    test_ctx->complete_error_code = error_code;
+}
+
+/* Zero-copy writes larger than MAX_FRAME_SIZE are split across DATA frames, whose payloads come from caller memory */
+TEST_CASE(h2_client_manual_data_write_zero_copy) {
+
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+    /* get connection preface and acks out of the way */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "PUT"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+    struct aws_http_make_request_options request_options = {
+        .self_size = sizeof(request_options),
+        .request = request,
+        .http2_use_manual_data_writes = true,
+    };
+    struct aws_http_stream *stream = aws_http_connection_make_request(s_tester.connection, &request_options);
+    ASSERT_NOT_NULL(stream);
+
+    aws_http_stream_activate(stream);
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    uint32_t stream_id = aws_http_stream_get_id(stream);
+
+    /* More than 2 frames' worth, but less than the initial flow-control window */
+    struct aws_byte_buf payload;
+    ASSERT_SUCCESS(aws_byte_buf_init(&payload, allocator, 40000));
+    for (size_t i = 0; i < payload.capacity; ++i) {
+        aws_byte_buf_write_u8(&payload, (uint8_t)(i % 251));
+    }
+
+    struct h2_client_zero_copy_write_ctx test_ctx;
+    AWS_ZERO_STRUCT(test_ctx);
+
+    /* Can't use both an input stream and zero-copy data */
+    struct aws_input_stream *data_stream = aws_input_stream_new_from_cursor(allocator, &request_headers_src[0].value);
+    struct aws_http2_stream_write_data_options bad_write = {
+        .data = data_stream,
+        .zero_copy_data = aws_byte_cursor_from_buf(&payload),
+    };
+    ASSERT_ERROR(AWS_ERROR_INVALID_ARGUMENT, aws_http2_stream_write_data(stream, &bad_write));
+    aws_input_stream_release(data_stream);
+
+    struct aws_http2_stream_write_data_options write = {
+        .zero_copy_data = aws_byte_cursor_from_buf(&payload),
+        .end_stream = true,
+        .on_complete = s_on_zero_copy_write_complete,
+        .user_data = &test_ctx,
+    };
+    ASSERT_SUCCESS(aws_http2_stream_write_data(stream, &write));
+
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_INT_EQUALS(1, test_ctx.on_complete_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, test_ctx.complete_error_code);
+
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+    ASSERT_SUCCESS(h2_decode_tester_check_data_across_frames(
+        &s_tester.peer.decode, stream_id, aws_byte_cursor_from_buf(&payload), true /*expect_end_stream*/));
+
+    /* Each frame is capped by MAX_FRAME_SIZE */
+    size_t data_frame_count = 0;
+    size_t search_idx = 0;
+    struct h2_decoded_frame *data_frame = NULL;
+    while ((data_frame = h2_decode_tester_find_stream_frame(
+                &s_tester.peer.decode, AWS_H2_FRAME_T_DATA, stream_id, search_idx, &search_idx)) != NULL) {
+        ASSERT_TRUE(data_frame->data_payload_len <= aws_h2_settings_initial[AWS_HTTP2_SETTINGS_MAX_FRAME_SIZE]);
+        ++data_frame_count;
+        ++search_idx;
+    }
+    ASSERT_UINT_EQUALS(3, data_frame_count);
+
+    aws_http_message_release(request);
+    aws_http_stream_release(stream);
+
+    /* close the connection */
+    aws_http_connection_close(s_tester.connection);
+
+    aws_byte_buf_clean_up(&payload);
+
+    /* clean up */
+    return s_tester_clean_up();
+}
+
+/* A more urgent stream sends its DATA before a less urgent one, even if the less urgent one started first */
+TEST_CASE(h2_client_stream_priority_urgency) {
+
+    ASSERT_SUCCESS(s_tester_init(allocator, ctx));
+    /* get connection preface and acks out of the way */
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&s_tester.peer));
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "POST"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/"),
+    };
+
+    /* Bulk request needs multiple DATA frames */
+    struct aws_byte_buf bulk_body;
+    ASSERT_SUCCESS(aws_byte_buf_init(&bulk_body, allocator, 40000));
+    ASSERT_TRUE(aws_byte_buf_write_u8_n(&bulk_body, 'b', bulk_body.capacity));
+    struct aws_byte_cursor bulk_cursor = aws_byte_cursor_from_buf(&bulk_body);
+    struct aws_input_stream *bulk_stream_body = aws_input_stream_new_from_cursor(allocator, &bulk_cursor);
+    struct aws_http_message *bulk_request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(bulk_request);
+    aws_http_message_add_header_array(bulk_request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+    aws_http_message_set_body_stream(bulk_request, bulk_stream_body);
+
+    struct aws_byte_cursor urgent_cursor = aws_byte_cursor_from_c_str("urgent");
+    struct aws_input_stream *urgent_stream_body = aws_input_stream_new_from_cursor(allocator, &urgent_cursor);
+    struct aws_http_message *urgent_request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(urgent_request);
+    aws_http_message_add_header_array(urgent_request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+    aws_http_message_set_body_stream(urgent_request, urgent_stream_body);
+
+    /* Urgency is out of range */
+    struct aws_http2_stream_priority bad_priority = {.urgency = AWS_HTTP2_PRIORITY_URGENCY_MAX + 1};
+    struct aws_http_make_request_options bad_options = {
+        .self_size = sizeof(bad_options),
+        .request = urgent_request,
+        .http2_priority = &bad_priority,
+    };
+    ASSERT_NULL(aws_http_connection_make_request(s_tester.connection, &bad_options));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+
+    struct aws_http2_stream_priority bulk_priority = {
+        .urgency = AWS_HTTP2_PRIORITY_URGENCY_MAX,
+        .incremental = true,
+    };
+    struct aws_http_make_request_options bulk_options = {
+        .self_size = sizeof(bulk_options),
+        .request = bulk_request,
+        .http2_priority = &bulk_priority,
+    };
+    struct aws_http_stream *bulk_stream = aws_http_connection_make_request(s_tester.connection, &bulk_options);
+    ASSERT_NOT_NULL(bulk_stream);
+
+    struct aws_http2_stream_priority urgent_priority = {.urgency = 0};
+    struct aws_http_make_request_options urgent_options = {
+        .self_size = sizeof(urgent_options),
+        .request = urgent_request,
+        .http2_priority = &urgent_priority,
+    };
+    struct aws_http_stream *urgent_stream = aws_http_connection_make_request(s_tester.connection, &urgent_options);
+    ASSERT_NOT_NULL(urgent_stream);
+
+    ASSERT_SUCCESS(aws_http_stream_activate(bulk_stream));
+    ASSERT_SUCCESS(aws_http_stream_activate(urgent_stream));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&s_tester.peer));
+
+    uint32_t bulk_id = aws_http_stream_get_id(bulk_stream);
+    uint32_t urgent_id = aws_http_stream_get_id(urgent_stream);
+    ASSERT_SUCCESS(h2_decode_tester_check_data_across_frames(
+        &s_tester.peer.decode, bulk_id, aws_byte_cursor_from_buf(&bulk_body), true /*expect_end_stream*/));
+    ASSERT_SUCCESS(h2_decode_tester_check_data_str_across_frames(
+        &s_tester.peer.decode, urgent_id, "urgent", true /*expect_end_stream*/));
+
+    /* All of the urgent stream's DATA goes out before any of the bulk stream's */
+    size_t urgent_data_idx = 0;
+    size_t bulk_data_idx = 0;
+    ASSERT_NOT_NULL(
+        h2_decode_tester_find_stream_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_DATA, urgent_id, 0, &urgent_data_idx));
+    ASSERT_NOT_NULL(
+        h2_decode_tester_find_stream_frame(&s_tester.peer.decode, AWS_H2_FRAME_T_DATA, bulk_id, 0, &bulk_data_idx));
+    ASSERT_TRUE(urgent_data_idx < bulk_data_idx);
+
+    /* clean up */
+    aws_http_stream_release(bulk_stream);
+    aws_http_stream_release(urgent_stream);
+    aws_http_message_release(bulk_request);
+    aws_http_message_release(urgent_request);
+    aws_input_stream_release(bulk_stream_body);
+    aws_input_stream_release(urgent_stream_body);
+    aws_byte_buf_clean_up(&bulk_body);
+    return s_tester_clean_up();
+}
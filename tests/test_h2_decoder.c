@@ -1954,6 +1954,28 @@ H2_DECODER_ON_CLIENT_TEST(h2_decoder_err_settings_invalid_values_max_frame_size)
     return AWS_OP_SUCCESS;
 }
 
+H2_DECODER_ON_CLIENT_TEST(h2_decoder_err_settings_invalid_values_enable_connect_protocol) {
+    (void)allocator;
+    struct fixture *fixture = ctx;
+
+    /* clang-format off */
+    uint8_t input[] = {
+        0x00, 0x00, 6,              /* Length (24) */
+        AWS_H2_FRAME_T_SETTINGS,    /* Type (8) */
+        0x00,                       /* Flags (8) */
+        0x00, 0x00, 0x00, 0x00,     /* Reserved (1) | Stream Identifier (31) */
+        /* SETTINGS */
+        0x00, 0x08,                 /* Identifier (16) */
+        0x00, 0x00, 0x00, 0x02,     /* Value (32) <-- INVALID value FOR ENABLE_CONNECT_PROTOCOL */
+    };
+    /* clang-format on */
+
+    ASSERT_H2ERR_ERROR(
+        AWS_HTTP2_ERR_PROTOCOL_ERROR, s_decode_all(fixture, aws_byte_cursor_from_array(input, sizeof(input))));
+
+    return AWS_OP_SUCCESS;
+}
+
 H2_DECODER_ON_CLIENT_TEST(h2_decoder_push_promise) {
     (void)allocator;
     struct fixture *fixture = ctx;
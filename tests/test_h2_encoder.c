@@ -248,6 +248,175 @@ TEST_CASE(h2_encoder_headers) {
     return AWS_OP_SUCCESS;
 }
 
+/* Test that a header-block which fits in the frame is encoded straight into it, without using the scratch buffer */
+TEST_CASE(h2_encoder_headers_encoded_in_place) {
+    (void)ctx;
+
+    struct aws_h2_frame_encoder encoder;
+    ASSERT_SUCCESS(aws_h2_frame_encoder_init(&encoder, allocator, NULL /*logging_id*/));
+    const size_t header_block_capacity = encoder.header_block_buf.capacity;
+
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 4096));
+
+    /* Well over the scratch buffer's initial reserve, even Huffman-encoded */
+    char big_value[1000];
+    memset(big_value, 'a', sizeof(big_value));
+    struct aws_http_header big_header = {
+        .name = aws_byte_cursor_from_c_str("x-big"),
+        .value = aws_byte_cursor_from_array(big_value, sizeof(big_value)),
+        .compression = AWS_HTTP_HEADER_COMPRESSION_NO_CACHE,
+    };
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(headers);
+    ASSERT_SUCCESS(aws_http_headers_add_header(headers, &big_header));
+
+    struct aws_h2_frame *frame =
+        aws_h2_frame_new_headers(allocator, 1 /*stream_id*/, headers, true /*end_stream*/, 0, NULL);
+    ASSERT_NOT_NULL(frame);
+    bool frame_complete;
+    ASSERT_SUCCESS(aws_h2_encode_frame(&encoder, frame, &output, &frame_complete));
+    ASSERT_TRUE(frame_complete);
+    aws_h2_frame_destroy(frame);
+
+    /* One frame, holding the whole header-block */
+    ASSERT_TRUE(output.len > AWS_H2_FRAME_PREFIX_SIZE);
+    ASSERT_UINT_EQUALS(output.len - AWS_H2_FRAME_PREFIX_SIZE, encoder.header_block_len);
+    ASSERT_UINT_EQUALS(AWS_H2_FRAME_F_END_STREAM | AWS_H2_FRAME_F_END_HEADERS, output.buffer[4] /* Flags (8) */);
+
+    /* Same bytes as encoding the header-block all at once */
+    struct aws_hpack_encoder hpack;
+    aws_hpack_encoder_init(&hpack, allocator, NULL /*log_id*/);
+    struct aws_byte_buf expected_block;
+    ASSERT_SUCCESS(aws_byte_buf_init(&expected_block, allocator, 0));
+    ASSERT_SUCCESS(aws_hpack_encode_header_block(&hpack, headers, &expected_block));
+    ASSERT_BIN_ARRAYS_EQUALS(
+        expected_block.buffer,
+        expected_block.len,
+        output.buffer + AWS_H2_FRAME_PREFIX_SIZE,
+        output.len - AWS_H2_FRAME_PREFIX_SIZE);
+
+    /* The scratch buffer never had to grow */
+    ASSERT_UINT_EQUALS(header_block_capacity, encoder.header_block_buf.capacity);
+
+    aws_byte_buf_clean_up(&expected_block);
+    aws_hpack_encoder_clean_up(&hpack);
+    aws_http_headers_release(headers);
+    aws_byte_buf_clean_up(&output);
+    aws_h2_frame_encoder_clean_up(&encoder);
+    return AWS_OP_SUCCESS;
+}
+
+/* Encode the frame, handing the encoder at most `message_size` bytes of space at a time (like aws_io_messages).
+ * Check that it's a HEADERS frame followed by CONTINUATION frames, none over the max frame size,
+ * and append their header-block fragments to `header_block` */
+static int s_encode_headers_in_pieces(
+    struct aws_allocator *allocator,
+    struct aws_h2_frame_encoder *encoder,
+    struct aws_h2_frame *frame,
+    size_t message_size,
+    struct aws_byte_buf *header_block) {
+
+    struct aws_byte_buf all_output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&all_output, allocator, 0));
+    struct aws_byte_buf message;
+    ASSERT_SUCCESS(aws_byte_buf_init(&message, allocator, message_size));
+
+    bool frame_complete = false;
+    while (!frame_complete) {
+        aws_byte_buf_reset(&message, false /*zero_contents*/);
+        ASSERT_SUCCESS(aws_h2_encode_frame(encoder, frame, &message, &frame_complete));
+        ASSERT_TRUE(message.len > 0);
+        struct aws_byte_cursor message_cursor = aws_byte_cursor_from_buf(&message);
+        ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&all_output, &message_cursor));
+    }
+
+    size_t num_frames = 0;
+    bool end_headers = false;
+    struct aws_byte_cursor cursor = aws_byte_cursor_from_buf(&all_output);
+    while (cursor.len > 0) {
+        ASSERT_FALSE(end_headers);
+        ASSERT_TRUE(cursor.len >= AWS_H2_FRAME_PREFIX_SIZE);
+        const size_t payload_len = ((size_t)cursor.ptr[0] << 16) | ((size_t)cursor.ptr[1] << 8) | cursor.ptr[2];
+        const uint8_t type = cursor.ptr[3];
+        const uint8_t flags = cursor.ptr[4];
+        ASSERT_UINT_EQUALS(num_frames == 0 ? AWS_H2_FRAME_T_HEADERS : AWS_H2_FRAME_T_CONTINUATION, type);
+        ASSERT_TRUE(payload_len <= encoder->settings.max_frame_size);
+        end_headers = flags & AWS_H2_FRAME_F_END_HEADERS;
+
+        aws_byte_cursor_advance(&cursor, AWS_H2_FRAME_PREFIX_SIZE);
+        ASSERT_TRUE(cursor.len >= payload_len);
+        struct aws_byte_cursor fragment = aws_byte_cursor_advance(&cursor, payload_len);
+        ASSERT_SUCCESS(aws_byte_buf_append_dynamic(header_block, &fragment));
+        ++num_frames;
+    }
+    ASSERT_TRUE(end_headers);
+    ASSERT_TRUE(num_frames > 1);
+
+    aws_byte_buf_clean_up(&message);
+    aws_byte_buf_clean_up(&all_output);
+    return AWS_OP_SUCCESS;
+}
+
+/* Test that a header-block bigger than the max frame size is split into CONTINUATION frames,
+ * with headers spilling across frame boundaries, and that the HPACK state stays consistent along the way */
+TEST_CASE(h2_encoder_headers_continuation) {
+    (void)ctx;
+
+    struct aws_h2_frame_encoder encoder;
+    ASSERT_SUCCESS(aws_h2_frame_encoder_init(&encoder, allocator, NULL /*logging_id*/));
+    /* Smaller than any peer could really set, so a handful of headers needs several frames */
+    encoder.settings.max_frame_size = 100;
+
+    /* Meanwhile, a lone HPACK encoder encodes the same header-blocks all at once */
+    struct aws_hpack_encoder hpack;
+    aws_hpack_encoder_init(&hpack, allocator, NULL /*log_id*/);
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(headers);
+    for (size_t i = 0; i < 8; ++i) {
+        char name[16];
+        snprintf(name, sizeof(name), "x-header-%zu", i);
+        char value[90];
+        for (size_t j = 0; j < sizeof(value); ++j) {
+            value[j] = (char)('a' + (i * 7 + j * 13) % 26);
+        }
+        struct aws_http_header header = {
+            .name = aws_byte_cursor_from_c_str(name),
+            .value = aws_byte_cursor_from_array(value, (i * 11) % sizeof(value)),
+            .compression = (i % 2) ? AWS_HTTP_HEADER_COMPRESSION_NO_CACHE : AWS_HTTP_HEADER_COMPRESSION_USE_CACHE,
+        };
+        ASSERT_SUCCESS(aws_http_headers_add_header(headers, &header));
+    }
+
+    /* Send the same headers a few times, the later header-blocks use the dynamic table */
+    const size_t message_sizes[] = {4096, 64, 31};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(message_sizes); ++i) {
+        struct aws_byte_buf expected_block;
+        ASSERT_SUCCESS(aws_byte_buf_init(&expected_block, allocator, 0));
+        ASSERT_SUCCESS(aws_hpack_encode_header_block(&hpack, headers, &expected_block));
+
+        struct aws_h2_frame *frame = aws_h2_frame_new_headers(
+            allocator, (uint32_t)(1 + 2 * i) /*stream_id*/, headers, false /*end_stream*/, 0, NULL);
+        ASSERT_NOT_NULL(frame);
+        struct aws_byte_buf header_block;
+        ASSERT_SUCCESS(aws_byte_buf_init(&header_block, allocator, 0));
+        ASSERT_SUCCESS(s_encode_headers_in_pieces(allocator, &encoder, frame, message_sizes[i], &header_block));
+        aws_h2_frame_destroy(frame);
+
+        ASSERT_BIN_ARRAYS_EQUALS(expected_block.buffer, expected_block.len, header_block.buffer, header_block.len);
+        ASSERT_UINT_EQUALS(expected_block.len, encoder.header_block_len);
+
+        aws_byte_buf_clean_up(&header_block);
+        aws_byte_buf_clean_up(&expected_block);
+    }
+
+    aws_http_headers_release(headers);
+    aws_hpack_encoder_clean_up(&hpack);
+    aws_h2_frame_encoder_clean_up(&encoder);
+    return AWS_OP_SUCCESS;
+}
+
 TEST_CASE(h2_encoder_priority) {
     (void)ctx;
 
@@ -468,6 +468,40 @@ TEST_DECODE_ONE_BYTE_AT_A_TIME(hpack_decode_string_huffman) {
     return AWS_OP_SUCCESS;
 }
 
+/* RFC-7541 5.2: padding longer than 7 bits MUST be treated as a decoding error */
+TEST_DECODE_ONE_BYTE_AT_A_TIME(hpack_decode_string_huffman_invalid_padding) {
+    struct decode_fixture *fixture = ctx;
+
+    /* Huffman-encoded "www.example.com" (from C.4.1), followed by an extra byte of 1s */
+    uint8_t input[] = {0x8d, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff, 0xff};
+    struct aws_byte_cursor to_decode = aws_byte_cursor_from_array(input, AWS_ARRAY_SIZE(input));
+
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 1));
+    bool complete;
+    ASSERT_FAILS(s_decode_string(fixture, &to_decode, &output, &complete));
+
+    aws_byte_buf_clean_up(&output);
+    return AWS_OP_SUCCESS;
+}
+
+/* HPACK says a Huffman encoded EOS symbol MUST be treated as a decoding error */
+TEST_DECODE_ONE_BYTE_AT_A_TIME(hpack_decode_string_huffman_eos) {
+    struct decode_fixture *fixture = ctx;
+
+    /* 'a' (00011), then EOS (30 1s), then padding */
+    uint8_t input[] = {0x85, 0x1f, 0xff, 0xff, 0xff, 0xff};
+    struct aws_byte_cursor to_decode = aws_byte_cursor_from_array(input, AWS_ARRAY_SIZE(input));
+
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 1));
+    bool complete;
+    ASSERT_FAILS(s_decode_string(fixture, &to_decode, &output, &complete));
+
+    aws_byte_buf_clean_up(&output);
+    return AWS_OP_SUCCESS;
+}
+
 /* Test that partial input doesn't register as "complete" */
 TEST_DECODE_ONE_BYTE_AT_A_TIME(hpack_decode_string_ongoing) {
     struct decode_fixture *fixture = ctx;
@@ -546,6 +580,45 @@ static int test_hpack_static_table_find(struct aws_allocator *allocator, void *c
     return AWS_OP_SUCCESS;
 }
 
+/* Every entry in the static table should be found at its own index */
+AWS_TEST_CASE(hpack_static_table_find_all, test_hpack_static_table_find_all)
+static int test_hpack_static_table_find_all(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_http_library_init(allocator);
+    struct aws_hpack_context context;
+    aws_hpack_context_init(&context, allocator, AWS_LS_HTTP_GENERAL, NULL);
+    ASSERT_SUCCESS(aws_hpack_resize_dynamic_table(&context, 0));
+
+    bool found_value = false;
+    for (size_t i = 1; i <= 61; ++i) {
+        const struct aws_http_header *header = aws_hpack_get_header(&context, i);
+        ASSERT_NOT_NULL(header);
+        ASSERT_UINT_EQUALS(i, aws_hpack_find_index(&context, header, true, &found_value));
+        ASSERT_TRUE(found_value == (header->value.len > 0));
+
+        /* Same name with different value should find first entry with that name */
+        struct aws_http_header other_value = {
+            .name = header->name,
+            .value = aws_byte_cursor_from_c_str("not-in-static-table"),
+        };
+        size_t name_index = aws_hpack_find_index(&context, &other_value, true, &found_value);
+        ASSERT_FALSE(found_value);
+        ASSERT_TRUE(name_index > 0 && name_index <= i);
+        ASSERT_TRUE(aws_byte_cursor_eq(&header->name, &aws_hpack_get_header(&context, name_index)->name));
+    }
+
+    /* Names that share length, first byte, and last byte with static entries */
+    DEFINE_STATIC_HEADER(s_almost_path, ":pxth", "/");
+    DEFINE_STATIC_HEADER(s_almost_host, "hoxt", "amazon.com");
+    ASSERT_UINT_EQUALS(0, aws_hpack_find_index(&context, &s_almost_path, true, &found_value));
+    ASSERT_UINT_EQUALS(0, aws_hpack_find_index(&context, &s_almost_host, false, &found_value));
+
+    aws_hpack_context_clean_up(&context);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
 AWS_TEST_CASE(hpack_static_table_get, test_hpack_static_table_get)
 static int test_hpack_static_table_get(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
@@ -703,6 +776,72 @@ static int s_check_header(
     return AWS_OP_SUCCESS;
 }
 
+/* Insert enough entries that the dynamic table's storage wraps around many times,
+ * including entries whose name refers to an entry that's about to be evicted (as the decoder does) */
+AWS_TEST_CASE(hpack_dynamic_table_ring_wraparound, test_hpack_dynamic_table_ring_wraparound)
+static int test_hpack_dynamic_table_ring_wraparound(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_http_library_init(allocator);
+    struct aws_hpack_context context;
+    aws_hpack_context_init(&context, allocator, AWS_LS_HTTP_GENERAL, NULL);
+
+    /* Room for a few headers at a time, depending on their length */
+    ASSERT_SUCCESS(aws_hpack_resize_dynamic_table(&context, 200));
+
+    char name_buf[32];
+    char value_buf[64];
+    for (size_t i = 0; i < 1000; ++i) {
+        struct aws_http_header header;
+        AWS_ZERO_STRUCT(header);
+
+        /* Every 7th header reuses the name of the oldest entry, which gets evicted by this insert */
+        const size_t num_elements = aws_hpack_get_dynamic_table_num_elements(&context);
+        if (i % 7 == 0 && num_elements > 0) {
+            const struct aws_http_header *oldest = aws_hpack_get_header(&context, 62 + num_elements - 1);
+            ASSERT_NOT_NULL(oldest);
+            header.name = oldest->name;
+        } else {
+            int name_len = snprintf(name_buf, sizeof(name_buf), "name-%zu", i);
+            header.name = aws_byte_cursor_from_array(name_buf, (size_t)name_len);
+        }
+
+        memset(value_buf, 'a' + (int)(i % 26), sizeof(value_buf));
+        header.value = aws_byte_cursor_from_array(value_buf, (i * 13) % sizeof(value_buf));
+
+        /* Copy what we expect, in case header.name refers to memory in the table */
+        char expected_name_buf[32];
+        ASSERT_TRUE(header.name.len <= sizeof(expected_name_buf));
+        memcpy(expected_name_buf, header.name.ptr, header.name.len);
+        struct aws_byte_cursor expected_name = aws_byte_cursor_from_array(expected_name_buf, header.name.len);
+
+        ASSERT_SUCCESS(aws_hpack_insert_header(&context, &header));
+        ASSERT_TRUE(aws_hpack_get_dynamic_table_num_elements(&context) > 0);
+
+        const struct aws_http_header *found = aws_hpack_get_header(&context, 62);
+        ASSERT_NOT_NULL(found);
+        ASSERT_BIN_ARRAYS_EQUALS(expected_name.ptr, expected_name.len, found->name.ptr, found->name.len);
+        ASSERT_BIN_ARRAYS_EQUALS(header.value.ptr, header.value.len, found->value.ptr, found->value.len);
+
+        /* Every entry still in the table must be found at its own index (or a newer identical one) */
+        for (size_t j = 0; j < aws_hpack_get_dynamic_table_num_elements(&context); ++j) {
+            found = aws_hpack_get_header(&context, 62 + j);
+            ASSERT_NOT_NULL(found);
+            bool found_value = false;
+            size_t index = aws_hpack_find_index(&context, found, true, &found_value);
+            ASSERT_TRUE(index >= 62 && index <= 62 + j);
+            const struct aws_http_header *match = aws_hpack_get_header(&context, index);
+            ASSERT_TRUE(aws_byte_cursor_eq(&found->name, &match->name));
+            ASSERT_TRUE(aws_byte_cursor_eq(&found->value, &match->value));
+        }
+        ASSERT_NULL(aws_hpack_get_header(&context, 62 + aws_hpack_get_dynamic_table_num_elements(&context)));
+    }
+
+    aws_hpack_context_clean_up(&context);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
 AWS_TEST_CASE(hpack_decode_indexed_from_dynamic_table, test_hpack_decode_indexed_from_dynamic_table)
 static int test_hpack_decode_indexed_from_dynamic_table(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
@@ -875,3 +1014,197 @@ static int test_hpack_dynamic_table_size_update_from_setting(struct aws_allocato
     aws_http_library_clean_up();
     return AWS_OP_SUCCESS;
 }
+
+/* In SMALLEST mode, Huffman is only used when it's shorter than the raw string */
+AWS_TEST_CASE(hpack_encode_string_smallest, test_hpack_encode_string_smallest)
+static int test_hpack_encode_string_smallest(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_http_library_init(allocator);
+    struct aws_hpack_encoder encoder;
+    aws_hpack_encoder_init(&encoder, allocator, NULL);
+    aws_hpack_encoder_set_huffman_mode(&encoder, AWS_HPACK_HUFFMAN_SMALLEST);
+
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 1)); /* Note buffer is initially too small */
+
+    /* RFC-7541 - Request Examples with Huffman Coding - C.4.1. First Request */
+    ASSERT_SUCCESS(aws_hpack_encode_string(&encoder, aws_byte_cursor_from_c_str("www.example.com"), &output));
+    const uint8_t expected_huffman[] = {0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff};
+    ASSERT_BIN_ARRAYS_EQUALS(expected_huffman, sizeof(expected_huffman), output.buffer, output.len);
+
+    /* These bytes have long Huffman codes, so the raw string is smaller */
+    aws_byte_buf_reset(&output, false);
+    const uint8_t binary[] = {0x00, 0xff, 0x7f};
+    ASSERT_SUCCESS(aws_hpack_encode_string(&encoder, aws_byte_cursor_from_array(binary, sizeof(binary)), &output));
+    const uint8_t expected_raw[] = {0x03, 0x00, 0xff, 0x7f};
+    ASSERT_BIN_ARRAYS_EQUALS(expected_raw, sizeof(expected_raw), output.buffer, output.len);
+
+    /* The Huffman encoder must be left in a good state after giving up on Huffman */
+    aws_byte_buf_reset(&output, false);
+    ASSERT_SUCCESS(aws_hpack_encode_string(&encoder, aws_byte_cursor_from_c_str("www.example.com"), &output));
+    ASSERT_BIN_ARRAYS_EQUALS(expected_huffman, sizeof(expected_huffman), output.buffer, output.len);
+
+    aws_byte_buf_clean_up(&output);
+    aws_hpack_encoder_clean_up(&encoder);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+static size_t s_encoder_string_cache_count(const struct aws_hpack_encoder *encoder) {
+    size_t count = 0;
+    for (size_t i = 0; i < AWS_HPACK_ENCODER_STRING_CACHE_SIZE; ++i) {
+        if (encoder->string_cache.entries[i].last_used != 0) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+/* Literals that aren't indexed get cached, and re-encoding them produces identical output */
+AWS_TEST_CASE(hpack_encoder_string_cache, test_hpack_encoder_string_cache)
+static int test_hpack_encoder_string_cache(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_http_library_init(allocator);
+    struct aws_hpack_encoder encoder;
+    aws_hpack_encoder_init(&encoder, allocator, NULL);
+    aws_hpack_encoder_set_huffman_mode(&encoder, AWS_HPACK_HUFFMAN_SMALLEST);
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    struct aws_http_header header = {
+        .name = aws_byte_cursor_from_c_str("x-amz-user-agent"),
+        .value = aws_byte_cursor_from_c_str("aws-sdk-cpp/1.11.0 Linux/6.1 x86_64 GCC/12.2.0"),
+        .compression = AWS_HTTP_HEADER_COMPRESSION_NO_CACHE,
+    };
+    ASSERT_SUCCESS(aws_http_headers_add_header(headers, &header));
+
+    /* Never-indexed headers are sensitive, so they must not be cached */
+    header.name = aws_byte_cursor_from_c_str("x-amz-security-token");
+    header.value = aws_byte_cursor_from_c_str("secret");
+    header.compression = AWS_HTTP_HEADER_COMPRESSION_NO_FORWARD_CACHE;
+    ASSERT_SUCCESS(aws_http_headers_add_header(headers, &header));
+
+    struct aws_byte_buf first_output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&first_output, allocator, 1));
+    ASSERT_SUCCESS(aws_hpack_encode_header_block(&encoder, headers, &first_output));
+    ASSERT_UINT_EQUALS(2, s_encoder_string_cache_count(&encoder));
+
+    struct aws_byte_buf second_output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&second_output, allocator, 1));
+    ASSERT_SUCCESS(aws_hpack_encode_header_block(&encoder, headers, &second_output));
+    ASSERT_UINT_EQUALS(2, s_encoder_string_cache_count(&encoder));
+    ASSERT_BIN_ARRAYS_EQUALS(first_output.buffer, first_output.len, second_output.buffer, second_output.len);
+
+    /* Changing Huffman mode invalidates the cache */
+    aws_hpack_encoder_set_huffman_mode(&encoder, AWS_HPACK_HUFFMAN_ALWAYS);
+    ASSERT_UINT_EQUALS(0, s_encoder_string_cache_count(&encoder));
+
+    aws_byte_buf_clean_up(&second_output);
+    aws_byte_buf_clean_up(&first_output);
+    aws_http_headers_release(headers);
+    aws_hpack_encoder_clean_up(&encoder);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* Encode `num_requests` header-blocks, each with a user-agent that never changes and a request-id that always does.
+ * and report how many dynamic table entries there are afterwards */
+static int s_encode_requests_with_volatile_header(
+    struct aws_allocator *allocator,
+    struct aws_hpack_encoder *encoder,
+    size_t num_requests,
+    size_t *out_num_elements) {
+
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 1));
+
+    for (size_t i = 0; i < num_requests; ++i) {
+        char request_id[32];
+        snprintf(request_id, sizeof(request_id), "%zu-8f2c41d7", i);
+
+        struct aws_http_headers *headers = aws_http_headers_new(allocator);
+        ASSERT_SUCCESS(aws_http_headers_add(
+            headers, aws_byte_cursor_from_c_str("user-agent"), aws_byte_cursor_from_c_str("aws-sdk-cpp/1.11.0")));
+        ASSERT_SUCCESS(aws_http_headers_add(
+            headers, aws_byte_cursor_from_c_str("x-amzn-requestid"), aws_byte_cursor_from_c_str(request_id)));
+
+        aws_byte_buf_reset(&output, false);
+        ASSERT_SUCCESS(aws_hpack_encode_header_block(encoder, headers, &output));
+        aws_http_headers_release(headers);
+    }
+
+    /* Once indexed, the user-agent is a single byte */
+    ASSERT_UINT_EQUALS(0x80, output.buffer[0] & 0x80);
+
+    *out_num_elements = aws_hpack_get_dynamic_table_num_elements(&encoder->context);
+    aws_byte_buf_clean_up(&output);
+    return AWS_OP_SUCCESS;
+}
+
+/* Once a name's values are seen to rarely repeat, its headers stop being inserted into the dynamic table */
+AWS_TEST_CASE(hpack_encoder_adaptive_indexing, test_hpack_encoder_adaptive_indexing)
+static int test_hpack_encoder_adaptive_indexing(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_http_library_init(allocator);
+    enum { NUM_REQUESTS = 32 };
+
+    struct aws_hpack_encoder encoder;
+    aws_hpack_encoder_init(&encoder, allocator, NULL);
+    size_t num_elements = 0;
+    ASSERT_SUCCESS(s_encode_requests_with_volatile_header(allocator, &encoder, NUM_REQUESTS, &num_elements));
+    /* The user-agent, plus request-ids from before the name was judged */
+    ASSERT_UINT_EQUALS(1 + (AWS_HPACK_ENCODER_NAME_STATS_MIN_SAMPLES - 1), num_elements);
+    aws_hpack_encoder_clean_up(&encoder);
+
+    /* Without adaptive indexing, every request-id is inserted */
+    aws_hpack_encoder_init(&encoder, allocator, NULL);
+    aws_hpack_encoder_set_adaptive_indexing(&encoder, false);
+    ASSERT_SUCCESS(s_encode_requests_with_volatile_header(allocator, &encoder, NUM_REQUESTS, &num_elements));
+    ASSERT_UINT_EQUALS(1 + NUM_REQUESTS, num_elements);
+    aws_hpack_encoder_clean_up(&encoder);
+
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* Trimming frees the encoder's memory, and the next header-block tells the peer the table was emptied */
+AWS_TEST_CASE(hpack_encoder_trim, test_hpack_encoder_trim)
+static int test_hpack_encoder_trim(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_http_library_init(allocator);
+    struct aws_hpack_encoder encoder;
+    aws_hpack_encoder_init(&encoder, allocator, NULL);
+    ASSERT_UINT_EQUALS(0, aws_hpack_encoder_get_memory_usage(&encoder));
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("user-agent"), aws_byte_cursor_from_c_str("aws-sdk-cpp/1.11.0")));
+
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 1));
+    ASSERT_SUCCESS(aws_hpack_encode_header_block(&encoder, headers, &output));
+    ASSERT_UINT_EQUALS(1, aws_hpack_get_dynamic_table_num_elements(&encoder.context));
+    ASSERT_TRUE(aws_hpack_encoder_get_memory_usage(&encoder) > 0);
+
+    ASSERT_SUCCESS(aws_hpack_encoder_trim(&encoder));
+    ASSERT_UINT_EQUALS(0, aws_hpack_encoder_get_memory_usage(&encoder));
+    ASSERT_UINT_EQUALS(0, aws_hpack_get_dynamic_table_num_elements(&encoder.context));
+
+    /* Dynamic Table Size Updates to 0, then back to 4096, come first */
+    aws_byte_buf_reset(&output, false);
+    ASSERT_SUCCESS(aws_hpack_encode_header_block(&encoder, headers, &output));
+    const uint8_t expected_prefix[] = {0x20, 0x3f, 0xe1, 0x1f};
+    ASSERT_TRUE(output.len > sizeof(expected_prefix));
+    ASSERT_BIN_ARRAYS_EQUALS(expected_prefix, sizeof(expected_prefix), output.buffer, sizeof(expected_prefix));
+    ASSERT_UINT_EQUALS(4096, aws_hpack_get_dynamic_table_max_size(&encoder.context));
+    ASSERT_UINT_EQUALS(1, aws_hpack_get_dynamic_table_num_elements(&encoder.context));
+
+    aws_byte_buf_clean_up(&output);
+    aws_http_headers_release(headers);
+    aws_hpack_encoder_clean_up(&encoder);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/http2_preface_detector.h>
+
+#include <aws/common/clock.h>
+#include <aws/testing/aws_test_harness.h>
+#include <aws/testing/io_testing_channel.h>
+
+struct tester {
+    struct testing_channel testing_channel;
+    int detected_count;
+    enum aws_http_version detected_version;
+    /* If false, the on_detected callback turns the client away instead of installing a handler */
+    bool install_downstream_handler;
+};
+
+static void s_on_detected(struct aws_channel *channel, enum aws_http_version version, void *user_data) {
+    struct tester *tester = user_data;
+    AWS_FATAL_ASSERT(channel == tester->testing_channel.channel);
+    tester->detected_count++;
+    tester->detected_version = version;
+
+    if (tester->install_downstream_handler) {
+        AWS_FATAL_ASSERT(testing_channel_install_downstream_handler(&tester->testing_channel, SIZE_MAX) == 0);
+    } else {
+        aws_channel_shutdown(channel, AWS_ERROR_HTTP_UNSUPPORTED_PROTOCOL);
+    }
+}
+
+static int s_tester_init(struct tester *tester, struct aws_allocator *allocator, bool install_downstream_handler) {
+    aws_http_library_init(allocator);
+    AWS_ZERO_STRUCT(*tester);
+    tester->install_downstream_handler = install_downstream_handler;
+
+    struct aws_testing_channel_options test_channel_options = {.clock_fn = aws_high_res_clock_get_ticks};
+    ASSERT_SUCCESS(testing_channel_init(&tester->testing_channel, allocator, &test_channel_options));
+
+    struct aws_http2_preface_detector_options options = {
+        .allocator = allocator,
+        .channel = tester->testing_channel.channel,
+        .initial_window_size = SIZE_MAX,
+        .on_detected = s_on_detected,
+        .user_data = tester,
+    };
+    ASSERT_SUCCESS(aws_http2_preface_detector_install(&options));
+    testing_channel_drain_queued_tasks(&tester->testing_channel);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_tester_clean_up(struct tester *tester) {
+    ASSERT_SUCCESS(testing_channel_clean_up(&tester->testing_channel));
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+/* The preface may arrive in pieces, nothing is passed along until all of it is seen */
+static int s_http2_preface_detector_detects_http2_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator, true /*install_downstream_handler*/));
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "PRI * HTTP/2.0\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_INT_EQUALS(0, tester.detected_count);
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "\r\nSM\r\n\r\nframes"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_INT_EQUALS(1, tester.detected_count);
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_2, tester.detected_version);
+
+    /* Data after detection passes straight through */
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "more frames"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_INT_EQUALS(1, tester.detected_count);
+    ASSERT_SUCCESS(testing_channel_check_midchannel_read_messages_str(
+        &tester.testing_channel, allocator, "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\nframesmore frames"));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(http2_preface_detector_detects_http2, s_http2_preface_detector_detects_http2_fn)
+
+/* HTTP/1.1 is detected as soon as the bytes stop matching the preface */
+static int s_http2_preface_detector_detects_http1_1_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator, true /*install_downstream_handler*/));
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "P"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_INT_EQUALS(0, tester.detected_count);
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "OST / HTTP/1.1\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_INT_EQUALS(1, tester.detected_count);
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_1_1, tester.detected_version);
+    ASSERT_SUCCESS(
+        testing_channel_check_midchannel_read_messages_str(&tester.testing_channel, allocator, "POST / HTTP/1.1\r\n"));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(http2_preface_detector_detects_http1_1, s_http2_preface_detector_detects_http1_1_fn)
+
+/* If nothing is installed after detection, the held data is dropped without leaking */
+static int s_http2_preface_detector_no_handler_installed_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator, false /*install_downstream_handler*/));
+
+    ASSERT_SUCCESS(testing_channel_push_read_str(&tester.testing_channel, "GET / HTTP/1.1\r\n"));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_INT_EQUALS(1, tester.detected_count);
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&tester.testing_channel));
+    ASSERT_INT_EQUALS(
+        AWS_ERROR_HTTP_UNSUPPORTED_PROTOCOL, testing_channel_get_shutdown_error_code(&tester.testing_channel));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(http2_preface_detector_no_handler_installed, s_http2_preface_detector_no_handler_installed_fn)
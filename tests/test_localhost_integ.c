@@ -532,3 +532,55 @@ static int s_localhost_integ_h2_download_stress(struct aws_allocator *allocator,
     aws_string_destroy(http_localhost_host);
     return s_tester_clean_up(&s_tester);
 }
+
+/* Test that the sized responses the loopback benchmark relies on come back with exactly the size asked for */
+AWS_TEST_CASE(localhost_integ_h2_loopback_sized_response, s_localhost_integ_h2_loopback_sized_response)
+static int s_localhost_integ_h2_loopback_sized_response(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    s_tester.alloc = allocator;
+    s_tester.download_body_len = 0;
+    size_t length = 100000; /* more than the initial window, so flow control is involved */
+
+    struct aws_string *http_localhost_host = NULL;
+    if (aws_get_environment_value(allocator, s_http_localhost_env_var, &http_localhost_host) ||
+        http_localhost_host == NULL) {
+        /* The environment variable is not set, default to localhost */
+        http_localhost_host = aws_string_new_from_c_str(allocator, "localhost");
+    }
+    struct aws_byte_cursor host_name = aws_byte_cursor_from_string(http_localhost_host);
+    ASSERT_SUCCESS(s_tester_init(&s_tester, allocator, host_name));
+    /* wait for connection connected */
+    ASSERT_SUCCESS(s_wait_on_connection_connected(&s_tester));
+
+    struct aws_http_header request_headers_src[] = {
+        DEFINE_HEADER(":method", "GET"),
+        DEFINE_HEADER(":scheme", "https"),
+        DEFINE_HEADER(":path", "/loopback/100000"),
+        {
+            .name = aws_byte_cursor_from_c_str(":authority"),
+            .value = host_name,
+        },
+    };
+    struct aws_http_message *request = aws_http2_message_new_request(allocator);
+    ASSERT_NOT_NULL(request);
+    aws_http_message_add_header_array(request, request_headers_src, AWS_ARRAY_SIZE(request_headers_src));
+
+    struct aws_http_make_request_options request_options = {
+        .self_size = sizeof(request_options),
+        .request = request,
+        .on_complete = s_tester_on_stream_completed,
+        .on_response_body = s_tester_on_download_body,
+    };
+    struct aws_http_stream *stream = aws_http_connection_make_request(s_tester.connection, &request_options);
+    ASSERT_NOT_NULL(stream);
+    aws_http_stream_activate(stream);
+    aws_http_stream_release(stream);
+
+    ASSERT_SUCCESS(s_wait_on_streams_completed_count(1));
+    ASSERT_UINT_EQUALS(length, s_tester.download_body_len);
+    ASSERT_TRUE(s_tester.stream_completed_with_200);
+
+    aws_http_message_release(request);
+    aws_string_destroy(http_localhost_host);
+    return s_tester_clean_up(&s_tester);
+}
@@ -0,0 +1,93 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/memory_budget_impl.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+static void s_count_notification(void *user_data) {
+    size_t *count = user_data;
+    ++(*count);
+}
+
+/* Draws are granted up to the limit, and bytes given back can be drawn again */
+static int s_memory_budget_draw_and_give_back_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    ASSERT_NULL(aws_http_memory_budget_new(allocator, 0));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+
+    struct aws_http_memory_budget *budget = aws_http_memory_budget_new(allocator, 100);
+    ASSERT_NOT_NULL(budget);
+    ASSERT_UINT_EQUALS(100, aws_http_memory_budget_get_limit(budget));
+
+    ASSERT_UINT_EQUALS(70, aws_http_memory_budget_draw(budget, 70, NULL));
+    ASSERT_FALSE(aws_http_memory_budget_is_exhausted(budget));
+
+    /* Only part of this one fits */
+    ASSERT_UINT_EQUALS(30, aws_http_memory_budget_draw(budget, 50, NULL));
+    ASSERT_UINT_EQUALS(100, aws_http_memory_budget_get_used(budget));
+    ASSERT_TRUE(aws_http_memory_budget_is_exhausted(budget));
+    ASSERT_UINT_EQUALS(0, aws_http_memory_budget_draw(budget, 1, NULL));
+
+    aws_http_memory_budget_give_back(budget, 70);
+    ASSERT_UINT_EQUALS(30, aws_http_memory_budget_get_used(budget));
+    ASSERT_UINT_EQUALS(50, aws_http_memory_budget_draw(budget, 50, NULL));
+
+    aws_http_memory_budget_give_back(budget, 80);
+    ASSERT_UINT_EQUALS(0, aws_http_memory_budget_get_used(budget));
+
+    aws_http_memory_budget_release(budget);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(memory_budget_draw_and_give_back, s_memory_budget_draw_and_give_back_fn)
+
+/* A waiter is notified once, the next time bytes are given back, unless it stops waiting first */
+static int s_memory_budget_waiters_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct aws_http_memory_budget *budget = aws_http_memory_budget_new(allocator, 10);
+    ASSERT_NOT_NULL(budget);
+
+    size_t notify_count_a = 0;
+    struct aws_http_memory_budget_waiter waiter_a;
+    aws_http_memory_budget_waiter_init(&waiter_a, s_count_notification, &notify_count_a);
+
+    size_t notify_count_b = 0;
+    struct aws_http_memory_budget_waiter waiter_b;
+    aws_http_memory_budget_waiter_init(&waiter_b, s_count_notification, &notify_count_b);
+
+    /* Fully granted draws don't wait */
+    ASSERT_UINT_EQUALS(10, aws_http_memory_budget_draw(budget, 10, &waiter_a));
+    ASSERT_FALSE(aws_http_memory_budget_stop_waiting(budget, &waiter_a));
+
+    ASSERT_UINT_EQUALS(0, aws_http_memory_budget_draw(budget, 5, &waiter_a));
+    ASSERT_UINT_EQUALS(0, aws_http_memory_budget_draw(budget, 5, &waiter_b));
+
+    /* Everyone waiting is notified */
+    aws_http_memory_budget_give_back(budget, 4);
+    ASSERT_UINT_EQUALS(1, notify_count_a);
+    ASSERT_UINT_EQUALS(1, notify_count_b);
+
+    /* But only once */
+    aws_http_memory_budget_give_back(budget, 1);
+    ASSERT_UINT_EQUALS(1, notify_count_a);
+    ASSERT_FALSE(aws_http_memory_budget_stop_waiting(budget, &waiter_a));
+
+    /* A waiter that stops waiting isn't notified */
+    ASSERT_UINT_EQUALS(5, aws_http_memory_budget_draw(budget, 6, &waiter_a));
+    ASSERT_TRUE(aws_http_memory_budget_stop_waiting(budget, &waiter_a));
+    aws_http_memory_budget_give_back(budget, 10);
+    ASSERT_UINT_EQUALS(1, notify_count_a);
+    ASSERT_UINT_EQUALS(1, notify_count_b);
+
+    aws_http_memory_budget_release(budget);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(memory_budget_waiters, s_memory_budget_waiters_fn)
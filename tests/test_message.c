@@ -389,6 +389,327 @@ TEST_CASE(headers_get_all) {
     return AWS_OP_SUCCESS;
 }
 
+/* Enough headers that lookups go through the hash index, and make sure it stays correct as headers change */
+TEST_CASE(headers_many) {
+    (void)ctx;
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(headers);
+
+    enum { NUM_HEADERS = 100 };
+    char name[32];
+    char value[32];
+    for (int i = 0; i < NUM_HEADERS; ++i) {
+        snprintf(name, sizeof(name), "X-Header-%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ASSERT_SUCCESS(
+            aws_http_headers_add(headers, aws_byte_cursor_from_c_str(name), aws_byte_cursor_from_c_str(value)));
+    }
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("X-Dupe"), aws_byte_cursor_from_c_str("A")));
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("x-dupe"), aws_byte_cursor_from_c_str("B")));
+
+    /* get() finds every header, with any case */
+    struct aws_byte_cursor get;
+    for (int i = 0; i < NUM_HEADERS; ++i) {
+        snprintf(name, sizeof(name), "x-HEADER-%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str(name), &get));
+        ASSERT_SUCCESS(s_check_value_eq(get, value));
+    }
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("X-Header-")));
+    ASSERT_FAILS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("X-Nope"), &get));
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_HEADER_NOT_FOUND, aws_last_error());
+
+    /* get() returns first, get_all() returns all in order */
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("X-DUPE"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "A"));
+    struct aws_string *all = aws_http_headers_get_all(headers, aws_byte_cursor_from_c_str("X-Dupe"));
+    ASSERT_NOT_NULL(all);
+    ASSERT_TRUE(aws_string_eq_c_str(all, "A, B"));
+    aws_string_destroy(all);
+
+    /* Pseudo-header goes to front, which shifts everything */
+    ASSERT_SUCCESS(aws_http_headers_add(headers, aws_byte_cursor_from_c_str(":path"), aws_byte_cursor_from_c_str("/")));
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str(":path"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "/"));
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("X-Header-0"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "0"));
+
+    /* erase() */
+    ASSERT_SUCCESS(aws_http_headers_erase(headers, aws_byte_cursor_from_c_str("x-dupe")));
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("X-Dupe")));
+    ASSERT_SUCCESS(aws_http_headers_erase(headers, aws_byte_cursor_from_c_str("X-Header-50")));
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("X-Header-50")));
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("X-Header-51"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "51"));
+    ASSERT_FAILS(aws_http_headers_erase(headers, aws_byte_cursor_from_c_str("X-Header-50")));
+
+    /* erase_value() and set() */
+    ASSERT_SUCCESS(aws_http_headers_erase_value(
+        headers, aws_byte_cursor_from_c_str("X-Header-7"), aws_byte_cursor_from_c_str("7")));
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("X-Header-7")));
+    ASSERT_SUCCESS(aws_http_headers_set(
+        headers, aws_byte_cursor_from_c_str("X-Header-8"), aws_byte_cursor_from_c_str("eight")));
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("X-Header-8"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "eight"));
+    all = aws_http_headers_get_all(headers, aws_byte_cursor_from_c_str("X-Header-8"));
+    ASSERT_NOT_NULL(all);
+    ASSERT_TRUE(aws_string_eq_c_str(all, "eight"));
+    aws_string_destroy(all);
+    ASSERT_UINT_EQUALS(NUM_HEADERS - 1, aws_http_headers_count(headers));
+
+    /* Erase down below threshold, lookups still work */
+    while (aws_http_headers_count(headers) > 3) {
+        ASSERT_SUCCESS(aws_http_headers_erase_index(headers, aws_http_headers_count(headers) - 1));
+    }
+    ASSERT_TRUE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str(":path")));
+    ASSERT_TRUE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("X-Header-1")));
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("X-Header-2")));
+
+    aws_http_headers_release(headers);
+    return AWS_OP_SUCCESS;
+}
+
+/* Well-known names are compared by id, unknown names by bytes. Check both, with and without the name index */
+static int s_check_well_known_names(struct aws_http_headers *headers) {
+    struct aws_byte_cursor get;
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("content-LENGTH"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "9"));
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("x-content-length"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "unknown"));
+
+    /* A well-known name is not a prefix or suffix match for an unknown one */
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("Host")));
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("Content-Lengt")));
+
+    struct aws_string *all = aws_http_headers_get_all(headers, aws_byte_cursor_from_c_str("CONNECTION"));
+    ASSERT_NOT_NULL(all);
+    ASSERT_TRUE(aws_string_eq_c_str(all, "keep-alive, close"));
+    aws_string_destroy(all);
+
+    ASSERT_SUCCESS(aws_http_headers_erase_value(
+        headers, aws_byte_cursor_from_c_str("connection"), aws_byte_cursor_from_c_str("close")));
+    ASSERT_SUCCESS(aws_http_headers_erase(headers, aws_byte_cursor_from_c_str("Content-Length")));
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("Content-Length")));
+    ASSERT_TRUE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("X-Content-Length")));
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("Connection"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "keep-alive"));
+    return AWS_OP_SUCCESS;
+}
+
+static int s_add_well_known_names(struct aws_http_headers *headers, int num_filler_headers) {
+    char name[32];
+    for (int i = 0; i < num_filler_headers; ++i) {
+        snprintf(name, sizeof(name), "X-Filler-%d", i);
+        ASSERT_SUCCESS(aws_http_headers_add(headers, aws_byte_cursor_from_c_str(name), aws_byte_cursor_from_c_str("")));
+    }
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("X-Content-Length"), aws_byte_cursor_from_c_str("unknown")));
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("Content-Length"), aws_byte_cursor_from_c_str("9")));
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("Connection"), aws_byte_cursor_from_c_str("keep-alive")));
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("connection"), aws_byte_cursor_from_c_str("close")));
+
+    /* Names are identified when added */
+    const size_t count = aws_http_headers_count(headers);
+    ASSERT_INT_EQUALS(AWS_HTTP_HEADER_UNKNOWN, aws_http_headers_get_name_enum(headers, count - 4));
+    ASSERT_INT_EQUALS(AWS_HTTP_HEADER_CONTENT_LENGTH, aws_http_headers_get_name_enum(headers, count - 3));
+    ASSERT_INT_EQUALS(AWS_HTTP_HEADER_CONNECTION, aws_http_headers_get_name_enum(headers, count - 1));
+    ASSERT_INT_EQUALS(AWS_HTTP_HEADER_UNKNOWN, aws_http_headers_get_name_enum(headers, count));
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(headers_well_known_names) {
+    (void)ctx;
+
+    const int num_filler_headers[] = {0, 32};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(num_filler_headers); ++i) {
+        struct aws_http_headers *headers = aws_http_headers_new(allocator);
+        ASSERT_NOT_NULL(headers);
+        ASSERT_SUCCESS(s_add_well_known_names(headers, num_filler_headers[i]));
+        ASSERT_SUCCESS(s_check_well_known_names(headers));
+        aws_http_headers_release(headers);
+    }
+    return AWS_OP_SUCCESS;
+}
+
+/* Headers don't need aws_http_library_init(), and ones made before it work the same after it */
+TEST_CASE(headers_well_known_names_without_library_init) {
+    (void)ctx;
+
+    struct aws_http_headers *before_init = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(before_init);
+    ASSERT_SUCCESS(s_add_well_known_names(before_init, 32));
+
+    aws_http_library_init(allocator);
+    ASSERT_SUCCESS(s_check_well_known_names(before_init));
+    aws_http_library_clean_up();
+    aws_http_headers_release(before_init);
+
+    struct aws_http_headers *after_clean_up = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(after_clean_up);
+    ASSERT_SUCCESS(s_add_well_known_names(after_clean_up, 0));
+    ASSERT_SUCCESS(s_check_well_known_names(after_clean_up));
+    aws_http_headers_release(after_clean_up);
+    return AWS_OP_SUCCESS;
+}
+
+/* Headers are validated once when added, so encoders can skip scanning them again */
+TEST_CASE(headers_validated_when_added) {
+    (void)ctx;
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(headers);
+
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("Valid-Name"), aws_byte_cursor_from_c_str("  valid value  ")));
+    ASSERT_SUCCESS(aws_http_headers_add(headers, aws_byte_cursor_from_c_str("Empty"), aws_byte_cursor_from_c_str("")));
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("Bad Name"), aws_byte_cursor_from_c_str("valid value")));
+    ASSERT_SUCCESS(aws_http_headers_add(
+        headers, aws_byte_cursor_from_c_str("Bad-Value"), aws_byte_cursor_from_c_str("line\r\nbreak")));
+
+    ASSERT_TRUE(aws_http_headers_is_field_valid(headers, 0));
+    ASSERT_TRUE(aws_http_headers_is_field_valid(headers, 1));
+    ASSERT_FALSE(aws_http_headers_is_field_valid(headers, 2));
+    ASSERT_FALSE(aws_http_headers_is_field_valid(headers, 3));
+    ASSERT_FALSE(aws_http_headers_is_field_valid(headers, 4));
+
+    /* Replacing a header validates the new one */
+    ASSERT_SUCCESS(
+        aws_http_headers_set(headers, aws_byte_cursor_from_c_str("Bad-Value"), aws_byte_cursor_from_c_str("fixed")));
+    ASSERT_TRUE(aws_http_headers_is_field_valid(headers, aws_http_headers_count(headers) - 1));
+
+    aws_http_headers_release(headers);
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(headers_arena) {
+    (void)ctx;
+
+    /* Use a tiny first block, so we're forced to grow */
+    struct aws_http_headers *headers = aws_http_headers_new_with_arena(allocator, 16);
+    ASSERT_NOT_NULL(headers);
+
+    enum { NUM_HEADERS = 50 };
+    char name[32];
+    char value[32];
+    for (int i = 0; i < NUM_HEADERS; ++i) {
+        snprintf(name, sizeof(name), "X-Header-%d", i);
+        snprintf(value, sizeof(value), "value-%d", i);
+        ASSERT_SUCCESS(
+            aws_http_headers_add(headers, aws_byte_cursor_from_c_str(name), aws_byte_cursor_from_c_str(value)));
+    }
+
+    /* Header larger than any block so far */
+    char big_value[4096];
+    memset(big_value, 'a', sizeof(big_value) - 1);
+    big_value[sizeof(big_value) - 1] = '\0';
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("X-Big"), aws_byte_cursor_from_c_str(big_value)));
+
+    /* Strings added earlier must not have moved */
+    struct aws_http_header header;
+    for (int i = 0; i < NUM_HEADERS; ++i) {
+        snprintf(name, sizeof(name), "X-Header-%d", i);
+        snprintf(value, sizeof(value), "value-%d", i);
+        ASSERT_SUCCESS(aws_http_headers_get_index(headers, i, &header));
+        ASSERT_SUCCESS(s_check_header_eq(header, name, value));
+    }
+    struct aws_byte_cursor get;
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("X-Big"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, big_value));
+
+    /* set() and erase() still work, they just don't give memory back */
+    ASSERT_SUCCESS(
+        aws_http_headers_set(headers, aws_byte_cursor_from_c_str("X-Header-3"), aws_byte_cursor_from_c_str("three")));
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("X-Header-3"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "three"));
+    ASSERT_SUCCESS(aws_http_headers_erase(headers, aws_byte_cursor_from_c_str("X-Big")));
+    ASSERT_FALSE(aws_http_headers_has(headers, aws_byte_cursor_from_c_str("X-Big")));
+
+    /* clear() resets the arena, and it's usable again afterwards */
+    aws_http_headers_clear(headers);
+    ASSERT_UINT_EQUALS(0, aws_http_headers_count(headers));
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("Host"), aws_byte_cursor_from_c_str("example.com")));
+    ASSERT_SUCCESS(aws_http_headers_get_index(headers, 0, &header));
+    ASSERT_SUCCESS(s_check_header_eq(header, "Host", "example.com"));
+
+    aws_http_headers_release(headers);
+
+    /* Request whose headers are in arena mode */
+    struct aws_http_message *request = aws_http_message_new_request_with_arena(allocator);
+    ASSERT_NOT_NULL(request);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_http_method_get));
+    struct aws_http_header host_header = DEFINE_HEADER("Host", "example.com");
+    ASSERT_SUCCESS(aws_http_message_add_header(request, host_header));
+    ASSERT_SUCCESS(aws_http_headers_get_index(aws_http_message_get_headers(request), 0, &header));
+    ASSERT_SUCCESS(s_check_header_eq(header, "Host", "example.com"));
+    aws_http_message_release(request);
+
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(headers_small_strings) {
+    (void)ctx;
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    ASSERT_NOT_NULL(headers);
+
+    /* Enough short headers to need several chunks of small-string slots, with some long ones mixed in */
+    enum { NUM_HEADERS = 50 };
+    char name[32];
+    char value[64];
+    for (int i = 0; i < NUM_HEADERS; ++i) {
+        snprintf(name, sizeof(name), "X-Header-%d", i);
+        snprintf(value, sizeof(value), (i % 5) ? "v%d" : "a-value-too-long-to-share-a-small-string-slot-%d", i);
+        ASSERT_SUCCESS(
+            aws_http_headers_add(headers, aws_byte_cursor_from_c_str(name), aws_byte_cursor_from_c_str(value)));
+    }
+
+    /* Strings added earlier must not move as the array grows */
+    struct aws_http_header first;
+    ASSERT_SUCCESS(aws_http_headers_get_index(headers, 1, &first));
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("X-Last"), aws_byte_cursor_from_c_str("last")));
+    ASSERT_SUCCESS(s_check_header_eq(first, "X-Header-1", "v1"));
+
+    /* Erased headers give their slots back, and new headers reuse them */
+    for (int i = 0; i < NUM_HEADERS; i += 2) {
+        snprintf(name, sizeof(name), "X-Header-%d", i);
+        ASSERT_SUCCESS(aws_http_headers_erase(headers, aws_byte_cursor_from_c_str(name)));
+    }
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("X-Reused"), aws_byte_cursor_from_c_str("slot")));
+
+    struct aws_http_header header;
+    for (int i = 1; i < NUM_HEADERS; i += 2) {
+        snprintf(name, sizeof(name), "X-Header-%d", i);
+        snprintf(value, sizeof(value), (i % 5) ? "v%d" : "a-value-too-long-to-share-a-small-string-slot-%d", i);
+        ASSERT_SUCCESS(aws_http_headers_get_index(headers, i / 2, &header));
+        ASSERT_SUCCESS(s_check_header_eq(header, name, value));
+    }
+    struct aws_byte_cursor get;
+    ASSERT_SUCCESS(aws_http_headers_get(headers, aws_byte_cursor_from_c_str("X-Reused"), &get));
+    ASSERT_SUCCESS(s_check_value_eq(get, "slot"));
+
+    /* clear() frees the slots, and headers are usable again afterwards */
+    aws_http_headers_clear(headers);
+    ASSERT_UINT_EQUALS(0, aws_http_headers_count(headers));
+    ASSERT_SUCCESS(
+        aws_http_headers_add(headers, aws_byte_cursor_from_c_str("Host"), aws_byte_cursor_from_c_str("example.com")));
+    ASSERT_SUCCESS(aws_http_headers_get_index(headers, 0, &header));
+    ASSERT_SUCCESS(s_check_header_eq(header, "Host", "example.com"));
+
+    aws_http_headers_release(headers);
+    return AWS_OP_SUCCESS;
+}
+
 TEST_CASE(h2_headers_request_pseudos_get_set) {
     (void)ctx;
     struct aws_http_headers *headers = aws_http_headers_new(allocator);
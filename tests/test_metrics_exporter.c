@@ -0,0 +1,109 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/metrics_exporter.h>
+#include <aws/http/statistics.h>
+#include <aws/io/statistics.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+static int s_check_rendered(struct aws_byte_buf *rendered, const char *expected_line) {
+    struct aws_byte_cursor search = aws_byte_cursor_from_buf(rendered);
+    struct aws_byte_cursor expected = aws_byte_cursor_from_c_str(expected_line);
+    struct aws_byte_cursor found;
+    if (aws_byte_cursor_find_exact(&search, &expected, &found)) {
+        fprintf(stderr, "Missing \"%s\" in:\n" PRInSTR "\n", expected_line, AWS_BYTE_CURSOR_PRI(search));
+        return AWS_OP_ERR;
+    }
+    return AWS_OP_SUCCESS;
+}
+
+static int s_observe(
+    struct aws_http_metrics_exporter *exporter,
+    struct aws_allocator *allocator,
+    struct aws_crt_statistics_base *stats) {
+
+    struct aws_array_list stats_list;
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&stats_list, allocator, 1, sizeof(struct aws_crt_statistics_base *)));
+    ASSERT_SUCCESS(aws_array_list_push_back(&stats_list, &stats));
+    aws_http_metrics_exporter_observe_statistics(0, &stats_list, exporter);
+    aws_array_list_clean_up(&stats_list);
+    return AWS_OP_SUCCESS;
+}
+
+/* Samples from every connection add up, per protocol */
+static int s_test_http_metrics_exporter_connection_stats(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct aws_http_metrics_exporter *exporter = aws_http_metrics_exporter_new(allocator);
+    ASSERT_NOT_NULL(exporter);
+
+    struct aws_crt_statistics_http1_channel h1_stats;
+    aws_crt_statistics_http1_channel_init(&h1_stats);
+    h1_stats.bytes_read = 100;
+    h1_stats.bytes_written = 50;
+    h1_stats.pending_incoming_stream_ms = 1500;
+    ASSERT_SUCCESS(s_observe(exporter, allocator, (struct aws_crt_statistics_base *)&h1_stats));
+    ASSERT_SUCCESS(s_observe(exporter, allocator, (struct aws_crt_statistics_base *)&h1_stats));
+
+    struct aws_crt_statistics_http2_channel h2_stats;
+    aws_crt_statistics_http2_channel_init(&h2_stats);
+    h2_stats.bytes_read = 7;
+    h2_stats.bytes_written = 9;
+    h2_stats.zero_copy_bytes_written = 1000;
+    h2_stats.smoothed_rtt_ns = 3000000; /* 3ms */
+
+    /* Through the statistics handler, as a channel would report it */
+    struct aws_crt_statistics_handler *handler = aws_http_metrics_exporter_new_statistics_handler(exporter);
+    ASSERT_NOT_NULL(handler);
+    struct aws_array_list stats_list;
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&stats_list, allocator, 1, sizeof(struct aws_crt_statistics_base *)));
+    struct aws_crt_statistics_base *h2_stats_base = (struct aws_crt_statistics_base *)&h2_stats;
+    ASSERT_SUCCESS(aws_array_list_push_back(&stats_list, &h2_stats_base));
+    aws_crt_statistics_handler_process_statistics(handler, NULL, &stats_list, NULL);
+    aws_array_list_clean_up(&stats_list);
+
+    struct aws_byte_buf rendered;
+    ASSERT_SUCCESS(aws_byte_buf_init(&rendered, allocator, 64));
+    ASSERT_SUCCESS(aws_http_metrics_exporter_render(exporter, &rendered));
+
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "# TYPE aws_http_connection_read_bytes counter\n"));
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "aws_http_connection_samples_total{protocol=\"http1\"} 2\n"));
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "aws_http_connection_samples_total{protocol=\"http2\"} 1\n"));
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "aws_http_connection_read_bytes_total{protocol=\"http1\"} 200\n"));
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "aws_http_connection_read_bytes_total{protocol=\"http2\"} 7\n"));
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "aws_http_connection_written_bytes_total{protocol=\"http2\"} 1009\n"));
+    ASSERT_SUCCESS(
+        s_check_rendered(&rendered, "aws_http_connection_pending_incoming_seconds_total{protocol=\"http1\"} 3.000\n"));
+    ASSERT_SUCCESS(s_check_rendered(
+        &rendered, "aws_http_connection_zero_copy_written_bytes_total{protocol=\"http2\"} 1000\n"));
+
+    /* 3ms falls between the 2.048ms and 4.096ms bounds */
+    ASSERT_SUCCESS(
+        s_check_rendered(&rendered, "aws_http_connection_smoothed_rtt_seconds_bucket{le=\"0.002048\"} 0\n"));
+    ASSERT_SUCCESS(
+        s_check_rendered(&rendered, "aws_http_connection_smoothed_rtt_seconds_bucket{le=\"0.004096\"} 1\n"));
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "aws_http_connection_smoothed_rtt_seconds_bucket{le=\"+Inf\"} 1\n"));
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "aws_http_connection_smoothed_rtt_seconds_count 1\n"));
+    ASSERT_SUCCESS(s_check_rendered(&rendered, "aws_http_connection_smoothed_rtt_seconds_sum 0.003000\n"));
+
+    /* Without managers, no manager families */
+    struct aws_byte_cursor rendered_cursor = aws_byte_cursor_from_buf(&rendered);
+    struct aws_byte_cursor manager_prefix = aws_byte_cursor_from_c_str("aws_http_manager_");
+    struct aws_byte_cursor found;
+    ASSERT_FAILS(aws_byte_cursor_find_exact(&rendered_cursor, &manager_prefix, &found));
+
+    struct aws_byte_cursor eof = aws_byte_cursor_from_c_str("# EOF\n");
+    ASSERT_TRUE(rendered.len >= eof.len);
+    ASSERT_BIN_ARRAYS_EQUALS(eof.ptr, eof.len, rendered.buffer + rendered.len - eof.len, eof.len);
+
+    aws_byte_buf_clean_up(&rendered);
+    aws_crt_statistics_handler_destroy(handler);
+    aws_http_metrics_exporter_release(exporter);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_http_metrics_exporter_connection_stats, s_test_http_metrics_exporter_connection_stats)
@@ -0,0 +1,157 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/mpsc_queue.h>
+
+#include <aws/common/thread.h>
+#include <aws/testing/aws_test_harness.h>
+
+struct tester_item {
+    struct aws_linked_list_node node;
+    size_t producer;
+    size_t sequence;
+};
+
+static int s_mpsc_queue_order_and_close_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_http_mpsc_queue queue;
+    aws_http_mpsc_queue_init(&queue);
+    ASSERT_TRUE(aws_http_mpsc_queue_is_empty(&queue));
+
+    struct tester_item items[4];
+    AWS_ZERO_ARRAY(items);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(items); ++i) {
+        items[i].sequence = i;
+    }
+
+    /* Only the push into the empty queue asks for the consumer to be scheduled */
+    ASSERT_INT_EQUALS(AWS_HTTP_MPSC_QUEUE_PUSHED_FIRST, aws_http_mpsc_queue_push(&queue, &items[0].node));
+    ASSERT_INT_EQUALS(AWS_HTTP_MPSC_QUEUE_PUSHED, aws_http_mpsc_queue_push(&queue, &items[1].node));
+    ASSERT_INT_EQUALS(AWS_HTTP_MPSC_QUEUE_PUSHED, aws_http_mpsc_queue_push(&queue, &items[2].node));
+    ASSERT_FALSE(aws_http_mpsc_queue_is_empty(&queue));
+
+    /* Taken in the order pushed */
+    struct aws_linked_list taken;
+    aws_linked_list_init(&taken);
+    aws_http_mpsc_queue_take_all(&queue, &taken);
+    ASSERT_TRUE(aws_http_mpsc_queue_is_empty(&queue));
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_FALSE(aws_linked_list_empty(&taken));
+        struct tester_item *item = AWS_CONTAINER_OF(aws_linked_list_pop_front(&taken), struct tester_item, node);
+        ASSERT_UINT_EQUALS(i, item->sequence);
+    }
+    ASSERT_TRUE(aws_linked_list_empty(&taken));
+
+    /* Taking from an empty queue takes nothing */
+    aws_http_mpsc_queue_take_all(&queue, &taken);
+    ASSERT_TRUE(aws_linked_list_empty(&taken));
+
+    /* Once the consumer has taken everything, the next push must schedule it again */
+    ASSERT_INT_EQUALS(AWS_HTTP_MPSC_QUEUE_PUSHED_FIRST, aws_http_mpsc_queue_push(&queue, &items[3].node));
+
+    /* Closing takes what's left, and later pushes fail */
+    aws_http_mpsc_queue_close(&queue, &taken);
+    ASSERT_TRUE(aws_http_mpsc_queue_is_empty(&queue));
+    ASSERT_PTR_EQUALS(&items[3].node, aws_linked_list_front(&taken));
+    ASSERT_PTR_EQUALS(&items[3].node, aws_linked_list_back(&taken));
+    aws_linked_list_pop_front(&taken);
+
+    ASSERT_INT_EQUALS(AWS_HTTP_MPSC_QUEUE_CLOSED, aws_http_mpsc_queue_push(&queue, &items[0].node));
+    aws_http_mpsc_queue_take_all(&queue, &taken);
+    aws_http_mpsc_queue_close(&queue, &taken);
+    ASSERT_TRUE(aws_linked_list_empty(&taken));
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(mpsc_queue_order_and_close, s_mpsc_queue_order_and_close_fn)
+
+enum {
+    TESTER_PRODUCER_COUNT = 4,
+    TESTER_ITEMS_PER_PRODUCER = 20000,
+};
+
+struct tester_producer {
+    struct aws_thread thread;
+    struct aws_http_mpsc_queue *queue;
+    struct aws_atomic_var *pushed_first_count;
+    struct tester_item *items;
+};
+
+static void s_producer_thread(void *arg) {
+    struct tester_producer *producer = arg;
+    for (size_t i = 0; i < TESTER_ITEMS_PER_PRODUCER; ++i) {
+        enum aws_http_mpsc_queue_push_result result =
+            aws_http_mpsc_queue_push(producer->queue, &producer->items[i].node);
+        AWS_FATAL_ASSERT(result != AWS_HTTP_MPSC_QUEUE_CLOSED);
+        if (result == AWS_HTTP_MPSC_QUEUE_PUSHED_FIRST) {
+            aws_atomic_fetch_add(producer->pushed_first_count, 1);
+        }
+    }
+}
+
+/* Many threads push while one takes. Nothing is lost, each producer's items stay in order,
+ * and there's exactly one "schedule the consumer" per batch the consumer takes */
+static int s_mpsc_queue_many_producers_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_http_mpsc_queue queue;
+    aws_http_mpsc_queue_init(&queue);
+    struct aws_atomic_var pushed_first_count;
+    aws_atomic_init_int(&pushed_first_count, 0);
+
+    struct tester_item *items =
+        aws_mem_calloc(allocator, TESTER_PRODUCER_COUNT * TESTER_ITEMS_PER_PRODUCER, sizeof(struct tester_item));
+    ASSERT_NOT_NULL(items);
+
+    struct tester_producer producers[TESTER_PRODUCER_COUNT];
+    for (size_t p = 0; p < TESTER_PRODUCER_COUNT; ++p) {
+        producers[p].queue = &queue;
+        producers[p].pushed_first_count = &pushed_first_count;
+        producers[p].items = &items[p * TESTER_ITEMS_PER_PRODUCER];
+        for (size_t i = 0; i < TESTER_ITEMS_PER_PRODUCER; ++i) {
+            producers[p].items[i].producer = p;
+            producers[p].items[i].sequence = i;
+        }
+        ASSERT_SUCCESS(aws_thread_init(&producers[p].thread, allocator));
+    }
+    for (size_t p = 0; p < TESTER_PRODUCER_COUNT; ++p) {
+        ASSERT_SUCCESS(
+            aws_thread_launch(&producers[p].thread, s_producer_thread, &producers[p], aws_default_thread_options()));
+    }
+
+    size_t next_sequence[TESTER_PRODUCER_COUNT] = {0};
+    size_t taken_count = 0;
+    size_t batch_count = 0;
+    while (taken_count < TESTER_PRODUCER_COUNT * TESTER_ITEMS_PER_PRODUCER) {
+        struct aws_linked_list taken;
+        aws_linked_list_init(&taken);
+        aws_http_mpsc_queue_take_all(&queue, &taken);
+        if (aws_linked_list_empty(&taken)) {
+            continue;
+        }
+
+        ++batch_count;
+        while (!aws_linked_list_empty(&taken)) {
+            struct tester_item *item = AWS_CONTAINER_OF(aws_linked_list_pop_front(&taken), struct tester_item, node);
+            ASSERT_UINT_EQUALS(next_sequence[item->producer], item->sequence);
+            next_sequence[item->producer]++;
+            ++taken_count;
+        }
+    }
+
+    for (size_t p = 0; p < TESTER_PRODUCER_COUNT; ++p) {
+        ASSERT_SUCCESS(aws_thread_join(&producers[p].thread));
+        aws_thread_clean_up(&producers[p].thread);
+    }
+
+    ASSERT_TRUE(aws_http_mpsc_queue_is_empty(&queue));
+    ASSERT_UINT_EQUALS(batch_count, aws_atomic_load_int(&pushed_first_count));
+
+    aws_mem_release(allocator, items);
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(mpsc_queue_many_producers, s_mpsc_queue_many_producers_fn)
@@ -465,6 +465,7 @@ AWS_TEST_CASE(test_https_tunnel_proxy_connection_failure_tls, s_test_https_tunne
 static int s_verify_transformed_request(
     struct aws_http_message *untransformed_request,
     struct aws_http_message *transformed_request,
+    struct aws_byte_cursor sent_request_target,
     struct aws_allocator *allocator) {
 
     /* method shouldn't change */
@@ -476,12 +477,14 @@ static int s_verify_transformed_request(
 
     ASSERT_TRUE(aws_byte_cursor_eq(&method_cursor, &starting_method_cursor));
 
-    /* path should be the full uri */
+    /* path is left alone, the encoder makes it absolute-form on the way out */
     struct aws_byte_cursor path;
     ASSERT_SUCCESS(aws_http_message_get_request_path(transformed_request, &path));
+    ASSERT_TRUE(aws_string_eq_byte_cursor(s_mock_request_path, &path));
 
+    /* request-target sent should be the full uri */
     struct aws_uri uri;
-    ASSERT_SUCCESS(aws_uri_init_parse(&uri, allocator, &path));
+    ASSERT_SUCCESS(aws_uri_init_parse(&uri, allocator, &sent_request_target));
 
     struct aws_byte_cursor expected_scheme = aws_byte_cursor_from_c_str("http");
     ASSERT_TRUE(aws_byte_cursor_eq(aws_uri_scheme(&uri), &expected_scheme));
@@ -531,7 +534,22 @@ static int s_do_http_forwarding_proxy_request_transform_test(
     struct testing_channel *channel = proxy_tester_get_current_channel(&tester);
     testing_channel_run_currently_queued_tasks(channel);
 
-    s_verify_transformed_request(untransformed_request, request, allocator);
+    /* request-line: "{method} {request-target} {version}" */
+    struct aws_byte_buf written;
+    ASSERT_SUCCESS(aws_byte_buf_init(&written, allocator, 1024));
+    ASSERT_SUCCESS(testing_channel_drain_written_messages(channel, &written));
+    struct aws_byte_cursor written_cursor = aws_byte_cursor_from_buf(&written);
+    struct aws_byte_cursor request_line;
+    AWS_ZERO_STRUCT(request_line);
+    ASSERT_TRUE(aws_byte_cursor_next_split(&written_cursor, '\r', &request_line));
+    struct aws_byte_cursor sent_method;
+    AWS_ZERO_STRUCT(sent_method);
+    ASSERT_TRUE(aws_byte_cursor_next_split(&request_line, ' ', &sent_method));
+    struct aws_byte_cursor sent_request_target = sent_method;
+    ASSERT_TRUE(aws_byte_cursor_next_split(&request_line, ' ', &sent_request_target));
+
+    ASSERT_SUCCESS(s_verify_transformed_request(untransformed_request, request, sent_request_target, allocator));
+    aws_byte_buf_clean_up(&written);
 
     if (transformed_request_verifier_fn != NULL) {
         ASSERT_SUCCESS(transformed_request_verifier_fn(request));
@@ -1048,6 +1066,77 @@ static int s_test_http_proxy_adaptive_failure(struct aws_allocator *allocator, v
 
 AWS_TEST_CASE(test_http_proxy_adaptive_failure, s_test_http_proxy_adaptive_failure);
 
+static void s_remembered_strategy_on_terminate(struct aws_http_message *message, int error_code, void *user_data) {
+    (void)message;
+    int *result = user_data;
+    *result = error_code;
+}
+
+static void s_remembered_strategy_on_forward(struct aws_http_message *message, void *user_data) {
+    (void)message;
+    int *result = user_data;
+    *result = AWS_ERROR_SUCCESS;
+}
+
+/* Run a negotiator's CONNECT transform on a fresh request, and verify what it added */
+static int s_transform_connect_and_verify(
+    struct aws_allocator *allocator,
+    struct aws_http_proxy_negotiator *negotiator,
+    aws_proxy_test_verify_connect_fn verify) {
+
+    struct aws_http_message *request = s_build_http_request(allocator);
+    int result = AWS_ERROR_UNKNOWN;
+    negotiator->strategy_vtable.tunnelling_vtable->connect_request_transform(
+        negotiator, request, s_remembered_strategy_on_terminate, s_remembered_strategy_on_forward, &result);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, result);
+    ASSERT_SUCCESS(verify(request));
+
+    aws_http_message_destroy(request);
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * The adaptive strategy remembers that the proxy wanted kerberos, and the next connection sends it on the first CONNECT
+ */
+static int s_test_http_proxy_adaptive_remembers_strategy(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct aws_http_proxy_strategy *adaptive_strategy = s_create_adaptive_strategy(allocator);
+    ASSERT_NOT_NULL(adaptive_strategy);
+
+    /* First connection: identity is rejected, then kerberos succeeds on a new connection */
+    struct aws_http_proxy_negotiator *negotiator =
+        aws_http_proxy_strategy_create_negotiator(adaptive_strategy, allocator);
+    ASSERT_NOT_NULL(negotiator);
+    ASSERT_SUCCESS(s_transform_connect_and_verify(allocator, negotiator, s_verify_identity_connect_request));
+    negotiator->strategy_vtable.tunnelling_vtable->on_status_callback(
+        negotiator, AWS_HTTP_STATUS_CODE_407_PROXY_AUTHENTICATION_REQUIRED);
+    ASSERT_INT_EQUALS(AWS_HPNRD_NEW_CONNECTION, aws_http_proxy_negotiator_get_retry_directive(negotiator));
+    ASSERT_SUCCESS(s_transform_connect_and_verify(allocator, negotiator, s_verify_kerberos_connect_request));
+    negotiator->strategy_vtable.tunnelling_vtable->on_status_callback(negotiator, AWS_HTTP_STATUS_CODE_200_OK);
+    aws_http_proxy_negotiator_release(negotiator);
+
+    /* Second connection: kerberos right away */
+    negotiator = aws_http_proxy_strategy_create_negotiator(adaptive_strategy, allocator);
+    ASSERT_NOT_NULL(negotiator);
+    ASSERT_SUCCESS(s_transform_connect_and_verify(allocator, negotiator, s_verify_kerberos_connect_request));
+
+    /* If kerberos stops working, the rest are still tried, wrapping around to identity last */
+    negotiator->strategy_vtable.tunnelling_vtable->on_status_callback(
+        negotiator, AWS_HTTP_STATUS_CODE_407_PROXY_AUTHENTICATION_REQUIRED);
+    ASSERT_INT_EQUALS(AWS_HPNRD_NEW_CONNECTION, aws_http_proxy_negotiator_get_retry_directive(negotiator));
+    ASSERT_SUCCESS(s_transform_connect_and_verify(allocator, negotiator, s_verify_ntlm_connect_token_request));
+    aws_http_proxy_negotiator_release(negotiator);
+
+    aws_http_proxy_strategy_release(adaptive_strategy);
+    aws_http_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(test_http_proxy_adaptive_remembers_strategy, s_test_http_proxy_adaptive_remembers_strategy);
+
 AWS_STATIC_STRING_FROM_LITERAL(s_rewrite_host, "www.uri.com");
 AWS_STATIC_STRING_FROM_LITERAL(s_rewrite_path, "/main/index.html?foo=bar");
 AWS_STATIC_STRING_FROM_LITERAL(s_expected_rewritten_path, "http://www.uri.com:80/main/index.html?foo=bar");
@@ -1144,3 +1233,48 @@ static int s_test_http_forwarding_proxy_uri_rewrite_options_star(struct aws_allo
 AWS_TEST_CASE(
     test_http_forwarding_proxy_uri_rewrite_options_star,
     s_test_http_forwarding_proxy_uri_rewrite_options_star);
+
+static int s_test_http_proxy_http2_connect_request(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_http_library_init(allocator);
+
+    struct aws_http_header headers[] = {
+        {.name = aws_byte_cursor_from_c_str("Host"), .value = aws_byte_cursor_from_c_str("example.com:443")},
+        {.name = aws_byte_cursor_from_c_str("Proxy-Connection"), .value = aws_byte_cursor_from_c_str("Keep-Alive")},
+        {.name = aws_byte_cursor_from_c_str("Proxy-Authorization"), .value = aws_byte_cursor_from_c_str("Basic Zm9v")},
+    };
+
+    struct aws_http_message *http1_request = aws_http_message_new_request(allocator);
+    ASSERT_NOT_NULL(http1_request);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(http1_request, aws_byte_cursor_from_c_str("CONNECT")));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(http1_request, aws_byte_cursor_from_c_str("example.com:443")));
+    ASSERT_SUCCESS(aws_http_message_add_header_array(http1_request, headers, AWS_ARRAY_SIZE(headers)));
+
+    struct aws_http_message *request = aws_http_proxy_new_http2_connect_request(allocator, http1_request);
+    ASSERT_NOT_NULL(request);
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_2, aws_http_message_get_protocol_version(request));
+
+    /* RFC-9113 8.5: only :method and :authority, no :scheme or :path */
+    struct aws_http_headers *h2_headers = aws_http_message_get_headers(request);
+    struct aws_byte_cursor value;
+    ASSERT_SUCCESS(aws_http_headers_get(h2_headers, aws_http_header_method, &value));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&value, "CONNECT"));
+    ASSERT_SUCCESS(aws_http_headers_get(h2_headers, aws_http_header_authority, &value));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&value, "example.com:443"));
+    ASSERT_FALSE(aws_http_headers_has(h2_headers, aws_http_header_scheme));
+    ASSERT_FALSE(aws_http_headers_has(h2_headers, aws_http_header_path));
+
+    /* Connection-specific headers are dropped, the rest are kept in lowercase */
+    ASSERT_FALSE(aws_http_headers_has(h2_headers, aws_byte_cursor_from_c_str("host")));
+    ASSERT_FALSE(aws_http_headers_has(h2_headers, aws_byte_cursor_from_c_str("proxy-connection")));
+    ASSERT_SUCCESS(aws_http_headers_get(h2_headers, aws_byte_cursor_from_c_str("proxy-authorization"), &value));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&value, "Basic Zm9v"));
+
+    aws_http_message_release(request);
+    aws_http_message_release(http1_request);
+    aws_http_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(test_http_proxy_http2_connect_request, s_test_http_proxy_http2_connect_request);
@@ -201,3 +201,98 @@ static int s_random_access_set_owns_element_fn(struct aws_allocator *allocator,
 }
 
 AWS_TEST_CASE(random_access_set_owns_element_test, s_random_access_set_owns_element_fn)
+
+struct intrusive_test_element {
+    int key;
+    struct aws_intrusive_random_access_set_node node;
+};
+
+static bool s_intrusive_test_element_less(
+    const struct aws_intrusive_random_access_set_node *a,
+    const struct aws_intrusive_random_access_set_node *b) {
+    return AWS_CONTAINER_OF(a, struct intrusive_test_element, node)->key <
+           AWS_CONTAINER_OF(b, struct intrusive_test_element, node)->key;
+}
+
+static int s_intrusive_random_access_set_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    struct intrusive_test_element elements[3];
+    AWS_ZERO_ARRAY(elements);
+
+    struct aws_intrusive_random_access_set set;
+    ASSERT_SUCCESS(aws_intrusive_random_access_set_init(&set, allocator, NULL /*less_fn*/, 1));
+    struct aws_intrusive_random_access_set_node *node = NULL;
+    ASSERT_FAILS(aws_intrusive_random_access_set_random_get(&set, &node));
+
+    bool added = false;
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(elements); ++i) {
+        ASSERT_SUCCESS(aws_intrusive_random_access_set_add(&set, &elements[i].node, &added));
+        ASSERT_TRUE(added);
+    }
+    /* You cannot have duplicates */
+    ASSERT_SUCCESS(aws_intrusive_random_access_set_add(&set, &elements[0].node, &added));
+    ASSERT_FALSE(added);
+    ASSERT_UINT_EQUALS(3, aws_intrusive_random_access_set_get_size(&set));
+
+    /* Remove from the middle, the rest is still reachable by index */
+    aws_intrusive_random_access_set_remove(&set, &elements[0].node);
+    ASSERT_FALSE(aws_intrusive_random_access_set_exist(&set, &elements[0].node));
+    /* Removing again does nothing */
+    aws_intrusive_random_access_set_remove(&set, &elements[0].node);
+    ASSERT_UINT_EQUALS(2, aws_intrusive_random_access_set_get_size(&set));
+    for (size_t i = 0; i < 2; ++i) {
+        ASSERT_SUCCESS(aws_intrusive_random_access_set_get_index(&set, &node, i));
+        ASSERT_UINT_EQUALS(i, node->index);
+        ASSERT_TRUE(node == &elements[1].node || node == &elements[2].node);
+    }
+    ASSERT_FAILS(aws_intrusive_random_access_set_get_index(&set, &node, 2));
+    ASSERT_SUCCESS(aws_intrusive_random_access_set_random_get(&set, &node));
+    ASSERT_TRUE(aws_intrusive_random_access_set_exist(&set, node));
+
+    aws_intrusive_random_access_set_clean_up(&set);
+    ASSERT_FALSE(aws_intrusive_random_access_set_exist(&set, &elements[1].node));
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(intrusive_random_access_set_test, s_intrusive_random_access_set_fn)
+
+static int s_intrusive_random_access_set_heap_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    int keys[] = {5, 3, 8, 1, 9, 2, 7};
+    struct intrusive_test_element elements[AWS_ARRAY_SIZE(keys)];
+    AWS_ZERO_ARRAY(elements);
+
+    struct aws_intrusive_random_access_set set;
+    ASSERT_SUCCESS(aws_intrusive_random_access_set_init(&set, allocator, s_intrusive_test_element_less, 2));
+    bool added = false;
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(keys); ++i) {
+        elements[i].key = keys[i];
+        ASSERT_SUCCESS(aws_intrusive_random_access_set_add(&set, &elements[i].node, &added));
+        ASSERT_TRUE(added);
+    }
+    struct aws_intrusive_random_access_set_node *node = NULL;
+    ASSERT_SUCCESS(aws_intrusive_random_access_set_get_index(&set, &node, 0));
+    ASSERT_INT_EQUALS(1, AWS_CONTAINER_OF(node, struct intrusive_test_element, node)->key);
+
+    /* Key changes move the element */
+    elements[4].key = 0;
+    aws_intrusive_random_access_set_update(&set, &elements[4].node);
+    ASSERT_SUCCESS(aws_intrusive_random_access_set_get_index(&set, &node, 0));
+    ASSERT_PTR_EQUALS(&elements[4].node, node);
+    elements[4].key = 10;
+    aws_intrusive_random_access_set_update(&set, &elements[4].node);
+
+    /* Removing the min each time gives the keys in order */
+    int expected[] = {1, 2, 3, 5, 7, 8, 10};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(expected); ++i) {
+        ASSERT_SUCCESS(aws_intrusive_random_access_set_get_index(&set, &node, 0));
+        ASSERT_INT_EQUALS(expected[i], AWS_CONTAINER_OF(node, struct intrusive_test_element, node)->key);
+        aws_intrusive_random_access_set_remove(&set, node);
+    }
+    ASSERT_UINT_EQUALS(0, aws_intrusive_random_access_set_get_size(&set));
+
+    aws_intrusive_random_access_set_clean_up(&set);
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(intrusive_random_access_set_heap_test, s_intrusive_random_access_set_heap_fn)
@@ -0,0 +1,647 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/connection.h>
+#include <aws/http/private/h1_connection.h>
+#include <aws/http/private/request_manager_system_vtable.h>
+#include <aws/http/request_manager.h>
+#include <aws/http/request_response.h>
+
+#include <aws/common/clock.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/mutex.h>
+#include <aws/common/uri.h>
+#include <aws/io/channel_bootstrap.h>
+#include <aws/io/event_loop.h>
+#include <aws/io/host_resolver.h>
+#include <aws/io/socket.h>
+#include <aws/io/stream.h>
+#include <aws/io/tls_channel_handler.h>
+#include <aws/testing/aws_test_harness.h>
+#include <aws/testing/io_testing_channel.h>
+
+#define TEST_CASE(NAME)                                                                                                \
+    AWS_TEST_CASE(NAME, s_test_##NAME);                                                                                \
+    static int s_test_##NAME(struct aws_allocator *allocator, void *ctx)
+
+enum {
+    TESTER_TIMEOUT_SEC = 30,
+};
+
+/* A connection the request manager asked for, which the test hands out when it's ready */
+struct rm_mock_acquisition {
+    aws_http_connection_manager_on_connection_setup_fn *callback;
+    void *user_data;
+};
+
+struct rm_tester {
+    struct aws_allocator *allocator;
+    struct aws_event_loop_group *event_loop_group;
+    struct aws_host_resolver *host_resolver;
+    struct aws_client_bootstrap *client_bootstrap;
+    struct aws_tls_ctx_options tls_ctx_options;
+    struct aws_tls_ctx *tls_ctx;
+    struct aws_tls_connection_options tls_connection_options;
+    struct aws_uri endpoint;
+
+    struct aws_http_request_manager *request_manager;
+    struct aws_http_message *request;
+
+    struct aws_mutex lock;
+    struct aws_condition_variable signal;
+    struct aws_array_list streams; /* aws_http_stream * */
+    size_t acquire_errors;
+    size_t completed_count;
+    size_t status_200_count;
+    bool is_shutdown_complete;
+
+    /* Only for the mock tests, which hand out an HTTP/1.1 connection on a testing channel */
+    struct aws_http_request_manager_system_vtable mock_vtable;
+    struct testing_channel testing_channel;
+    struct aws_http_connection *connection;
+    struct aws_array_list mock_acquisitions; /* rm_mock_acquisition */
+    size_t mock_acquisitions_resolved;
+    size_t mock_released_count;
+};
+
+static struct rm_tester s_tester;
+
+static void s_on_shutdown_complete(void *user_data) {
+    (void)user_data;
+    aws_mutex_lock(&s_tester.lock);
+    s_tester.is_shutdown_complete = true;
+    aws_mutex_unlock(&s_tester.lock);
+    aws_condition_variable_notify_one(&s_tester.signal);
+}
+
+static int s_tester_init(struct aws_allocator *allocator, const char *uri, bool enable_request_coalescing) {
+    aws_http_library_init(allocator);
+    AWS_ZERO_STRUCT(s_tester);
+    s_tester.allocator = allocator;
+    ASSERT_SUCCESS(aws_mutex_init(&s_tester.lock));
+    ASSERT_SUCCESS(aws_condition_variable_init(&s_tester.signal));
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(&s_tester.streams, allocator, 8, sizeof(struct aws_http_stream *)));
+
+    s_tester.event_loop_group = aws_event_loop_group_new_default(allocator, 0, NULL);
+    struct aws_host_resolver_default_options resolver_options = {
+        .el_group = s_tester.event_loop_group,
+        .max_entries = 8,
+    };
+    s_tester.host_resolver = aws_host_resolver_new_default(allocator, &resolver_options);
+    struct aws_client_bootstrap_options bootstrap_options = {
+        .event_loop_group = s_tester.event_loop_group,
+        .host_resolver = s_tester.host_resolver,
+    };
+    s_tester.client_bootstrap = aws_client_bootstrap_new(allocator, &bootstrap_options);
+    ASSERT_NOT_NULL(s_tester.client_bootstrap);
+
+    struct aws_byte_cursor uri_cursor = aws_byte_cursor_from_c_str(uri);
+    ASSERT_SUCCESS(aws_uri_init_parse(&s_tester.endpoint, allocator, &uri_cursor));
+
+    /* Cleartext endpoints are known to speak HTTP/1.1 */
+    bool use_tls = aws_byte_cursor_eq_c_str_ignore_case(&s_tester.endpoint.scheme, "https");
+    if (use_tls) {
+        aws_tls_ctx_options_init_default_client(&s_tester.tls_ctx_options, allocator);
+        s_tester.tls_ctx = aws_tls_client_ctx_new(allocator, &s_tester.tls_ctx_options);
+        ASSERT_NOT_NULL(s_tester.tls_ctx);
+        aws_tls_connection_options_init_from_ctx(&s_tester.tls_connection_options, s_tester.tls_ctx);
+        ASSERT_SUCCESS(aws_tls_connection_options_set_server_name(
+            &s_tester.tls_connection_options, allocator, &s_tester.endpoint.host_name));
+    }
+
+    struct aws_socket_options socket_options = {
+        .type = AWS_SOCKET_STREAM,
+        .domain = AWS_SOCKET_IPV4,
+        .connect_timeout_ms = 10000,
+    };
+    struct aws_http_request_manager_options options = {
+        .bootstrap = s_tester.client_bootstrap,
+        .socket_options = &socket_options,
+        .tls_connection_options = use_tls ? &s_tester.tls_connection_options : NULL,
+        .host = s_tester.endpoint.host_name,
+        .port = use_tls ? 443 : 80,
+        .max_connections = 4,
+        .enable_request_coalescing = enable_request_coalescing,
+        .shutdown_complete_callback = s_on_shutdown_complete,
+    };
+    s_tester.request_manager = aws_http_request_manager_new(allocator, &options);
+    ASSERT_NOT_NULL(s_tester.request_manager);
+    ASSERT_INT_EQUALS(
+        use_tls ? AWS_HTTP_VERSION_UNKNOWN : AWS_HTTP_VERSION_1_1,
+        aws_http_request_manager_get_version(s_tester.request_manager));
+
+    s_tester.request = aws_http_message_new_request(allocator);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(s_tester.request, aws_http_method_get));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(
+        s_tester.request,
+        s_tester.endpoint.path_and_query.len ? s_tester.endpoint.path_and_query : aws_byte_cursor_from_c_str("/")));
+    struct aws_http_header host_header = {
+        .name = aws_byte_cursor_from_c_str("host"),
+        .value = s_tester.endpoint.host_name,
+    };
+    ASSERT_SUCCESS(aws_http_message_add_header(s_tester.request, host_header));
+    return AWS_OP_SUCCESS;
+}
+
+static bool s_is_shutdown_complete(void *context) {
+    (void)context;
+    return s_tester.is_shutdown_complete;
+}
+
+static int s_tester_clean_up(void) {
+    for (size_t i = 0; i < aws_array_list_length(&s_tester.streams); ++i) {
+        struct aws_http_stream *stream = NULL;
+        aws_array_list_get_at(&s_tester.streams, &stream, i);
+        aws_http_stream_release(stream);
+    }
+    aws_array_list_clean_up(&s_tester.streams);
+    aws_http_message_release(s_tester.request);
+
+    aws_http_request_manager_release(s_tester.request_manager);
+    aws_mutex_lock(&s_tester.lock);
+    ASSERT_SUCCESS(aws_condition_variable_wait_pred(&s_tester.signal, &s_tester.lock, s_is_shutdown_complete, NULL));
+    aws_mutex_unlock(&s_tester.lock);
+
+    if (s_tester.connection) {
+        /* Any request still waiting on a connection would keep the manager from shutting down */
+        ASSERT_UINT_EQUALS(aws_array_list_length(&s_tester.mock_acquisitions), s_tester.mock_acquisitions_resolved);
+        aws_array_list_clean_up(&s_tester.mock_acquisitions);
+        aws_http_connection_release(s_tester.connection);
+        ASSERT_SUCCESS(testing_channel_clean_up(&s_tester.testing_channel));
+    }
+
+    aws_client_bootstrap_release(s_tester.client_bootstrap);
+    aws_host_resolver_release(s_tester.host_resolver);
+    aws_event_loop_group_release(s_tester.event_loop_group);
+    if (s_tester.tls_ctx) {
+        aws_tls_connection_options_clean_up(&s_tester.tls_connection_options);
+        aws_tls_ctx_release(s_tester.tls_ctx);
+        aws_tls_ctx_options_clean_up(&s_tester.tls_ctx_options);
+    }
+    aws_uri_clean_up(&s_tester.endpoint);
+    aws_mutex_clean_up(&s_tester.lock);
+    aws_condition_variable_clean_up(&s_tester.signal);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_stream_acquired(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)user_data;
+    aws_mutex_lock(&s_tester.lock);
+    if (error_code) {
+        ++s_tester.acquire_errors;
+        ++s_tester.completed_count;
+    } else {
+        aws_array_list_push_back(&s_tester.streams, &stream);
+    }
+    aws_mutex_unlock(&s_tester.lock);
+    aws_condition_variable_notify_one(&s_tester.signal);
+}
+
+static void s_on_stream_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)user_data;
+    int status = 0;
+    aws_mutex_lock(&s_tester.lock);
+    if (!error_code && !aws_http_stream_get_incoming_response_status(stream, &status) && status == 200) {
+        ++s_tester.status_200_count;
+    }
+    ++s_tester.completed_count;
+    aws_mutex_unlock(&s_tester.lock);
+    aws_condition_variable_notify_one(&s_tester.signal);
+}
+
+static size_t s_wait_target;
+
+static bool s_is_completed(void *context) {
+    (void)context;
+    return s_tester.completed_count >= s_wait_target;
+}
+
+static int s_make_requests_and_wait(size_t count) {
+    struct aws_http_make_request_options request_options = {
+        .self_size = sizeof(request_options),
+        .request = s_tester.request,
+        .on_complete = s_on_stream_complete,
+    };
+    struct aws_http_request_manager_acquire_stream_options acquire_options = {
+        .callback = s_on_stream_acquired,
+        .options = &request_options,
+    };
+    for (size_t i = 0; i < count; ++i) {
+        aws_http_request_manager_acquire_stream(s_tester.request_manager, &acquire_options);
+    }
+
+    aws_mutex_lock(&s_tester.lock);
+    s_wait_target = count;
+    int64_t timeout_ns = aws_timestamp_convert(TESTER_TIMEOUT_SEC, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+    int result =
+        aws_condition_variable_wait_for_pred(&s_tester.signal, &s_tester.lock, timeout_ns, s_is_completed, NULL);
+    aws_mutex_unlock(&s_tester.lock);
+    ASSERT_SUCCESS(result);
+    ASSERT_UINT_EQUALS(0, s_tester.acquire_errors);
+    ASSERT_UINT_EQUALS(count, s_tester.status_200_count);
+    return AWS_OP_SUCCESS;
+}
+
+/* An endpoint that negotiates h2 gets its requests multiplexed */
+TEST_CASE(request_manager_multiplexes_h2) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator, "https://www.amazon.com/", false));
+    ASSERT_SUCCESS(s_make_requests_and_wait(8));
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_2, aws_http_request_manager_get_version(s_tester.request_manager));
+    return s_tester_clean_up();
+}
+
+/* An endpoint that only speaks http/1.1 gets pooled connections */
+TEST_CASE(request_manager_falls_back_to_h1) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator, "https://aws-crt-test-stuff.s3.amazonaws.com/http_test_doc.txt", false));
+    ASSERT_SUCCESS(s_make_requests_and_wait(8));
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_1_1, aws_http_request_manager_get_version(s_tester.request_manager));
+    return s_tester_clean_up();
+}
+
+/* Identical GETs made together share one request, and each hears the whole response */
+TEST_CASE(request_manager_coalesces_identical_gets) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_tester_init(allocator, "https://www.amazon.com/", true));
+    ASSERT_SUCCESS(s_make_requests_and_wait(8));
+
+    ASSERT_UINT_EQUALS(8, aws_array_list_length(&s_tester.streams));
+    struct aws_http_stream *first = NULL;
+    aws_array_list_get_at(&s_tester.streams, &first, 0);
+    for (size_t i = 1; i < aws_array_list_length(&s_tester.streams); ++i) {
+        struct aws_http_stream *stream = NULL;
+        aws_array_list_get_at(&s_tester.streams, &stream, i);
+        ASSERT_TRUE(first != stream);
+        ASSERT_UINT_EQUALS(aws_http_stream_get_id(first), aws_http_stream_get_id(stream));
+        ASSERT_PTR_EQUALS(aws_http_stream_get_connection(first), aws_http_stream_get_connection(stream));
+    }
+    return s_tester_clean_up();
+}
+
+/*
+ * The tests below don't touch the network. The request manager leases an HTTP/1.1 connection on a testing channel,
+ * when the test decides, and the test plays the server.
+ */
+
+static void s_mock_acquire_connection(
+    struct aws_http_connection_manager *manager,
+    aws_http_connection_manager_on_connection_setup_fn *callback,
+    void *user_data) {
+
+    (void)manager;
+    struct rm_mock_acquisition acquisition = {
+        .callback = callback,
+        .user_data = user_data,
+    };
+    aws_array_list_push_back(&s_tester.mock_acquisitions, &acquisition);
+}
+
+static int s_mock_release_connection(
+    struct aws_http_connection_manager *manager,
+    struct aws_http_connection *connection) {
+    (void)manager;
+    AWS_FATAL_ASSERT(connection == s_tester.connection);
+    ++s_tester.mock_released_count;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_mock_acquire_stream(
+    struct aws_http2_stream_manager *http2_stream_manager,
+    const struct aws_http2_stream_manager_acquire_stream_options *acquire_stream_option) {
+
+    /* Cleartext endpoints never get here */
+    (void)http2_stream_manager;
+    acquire_stream_option->callback(NULL, AWS_ERROR_UNIMPLEMENTED, acquire_stream_option->user_data);
+}
+
+static int s_mock_tester_init(struct aws_allocator *allocator) {
+    ASSERT_SUCCESS(s_tester_init(allocator, "http://www.example.com/", true /*enable_request_coalescing*/));
+
+    ASSERT_SUCCESS(aws_array_list_init_dynamic(
+        &s_tester.mock_acquisitions, allocator, 4, sizeof(struct rm_mock_acquisition)));
+
+    struct aws_testing_channel_options test_channel_options = {.clock_fn = aws_high_res_clock_get_ticks};
+    ASSERT_SUCCESS(testing_channel_init(&s_tester.testing_channel, allocator, &test_channel_options));
+
+    struct aws_http1_connection_options http1_options;
+    AWS_ZERO_STRUCT(http1_options);
+    s_tester.connection = aws_http_connection_new_http1_1_client(allocator, false, 0, &http1_options);
+    ASSERT_NOT_NULL(s_tester.connection);
+
+    struct aws_channel_slot *slot = aws_channel_slot_new(s_tester.testing_channel.channel);
+    ASSERT_NOT_NULL(slot);
+    ASSERT_SUCCESS(aws_channel_slot_insert_end(s_tester.testing_channel.channel, slot));
+    ASSERT_SUCCESS(aws_channel_slot_set_handler(slot, &s_tester.connection->channel_handler));
+    s_tester.connection->vtable->on_channel_handler_installed(&s_tester.connection->channel_handler, slot);
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+
+    s_tester.mock_vtable = *g_aws_http_request_manager_default_system_vtable_ptr;
+    s_tester.mock_vtable.aws_http_connection_manager_acquire_connection = s_mock_acquire_connection;
+    s_tester.mock_vtable.aws_http_connection_manager_release_connection = s_mock_release_connection;
+    s_tester.mock_vtable.aws_http2_stream_manager_acquire_stream = s_mock_acquire_stream;
+    aws_http_request_manager_set_system_vtable(s_tester.request_manager, &s_tester.mock_vtable);
+    return AWS_OP_SUCCESS;
+}
+
+/* Hand out the testing channel's connection for the oldest acquisition, or fail it if error_code is set */
+static int s_mock_resolve_acquisition(int error_code) {
+    ASSERT_TRUE(s_tester.mock_acquisitions_resolved < aws_array_list_length(&s_tester.mock_acquisitions));
+    struct rm_mock_acquisition acquisition;
+    aws_array_list_get_at(&s_tester.mock_acquisitions, &acquisition, s_tester.mock_acquisitions_resolved++);
+
+    acquisition.callback(error_code ? NULL : s_tester.connection, error_code, acquisition.user_data);
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_mock_push_response_str(const char *str) {
+    ASSERT_SUCCESS(testing_channel_push_read_str(&s_tester.testing_channel, str));
+    testing_channel_drain_queued_tasks(&s_tester.testing_channel);
+    return AWS_OP_SUCCESS;
+}
+
+/* One caller of aws_http_request_manager_acquire_stream(), and what it heard */
+struct rm_requester {
+    bool is_acquire_done;
+    int acquire_error_code;
+    struct aws_http_stream *stream;
+
+    struct aws_byte_buf body;
+    bool is_complete;
+    int complete_error_code;
+};
+
+static void s_requester_on_acquired(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct rm_requester *requester = user_data;
+    AWS_FATAL_ASSERT(!requester->is_acquire_done);
+    requester->is_acquire_done = true;
+    requester->acquire_error_code = error_code;
+    requester->stream = stream;
+}
+
+static int s_requester_on_body(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
+    (void)stream;
+    struct rm_requester *requester = user_data;
+    return aws_byte_buf_append_dynamic(&requester->body, data);
+}
+
+static void s_requester_on_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)stream;
+    struct rm_requester *requester = user_data;
+    AWS_FATAL_ASSERT(!requester->is_complete);
+    requester->is_complete = true;
+    requester->complete_error_code = error_code;
+}
+
+static void s_requester_acquire(
+    struct rm_requester *requester,
+    struct aws_http_message *request,
+    const struct aws_http_content_decoding_options *content_decoding) {
+
+    AWS_ZERO_STRUCT(*requester);
+    aws_byte_buf_init(&requester->body, s_tester.allocator, 16);
+
+    struct aws_http_make_request_options request_options = {
+        .self_size = sizeof(request_options),
+        .request = request,
+        .user_data = requester,
+        .on_response_body = s_requester_on_body,
+        .on_complete = s_requester_on_complete,
+        .content_decoding = content_decoding,
+    };
+    struct aws_http_request_manager_acquire_stream_options acquire_options = {
+        .callback = s_requester_on_acquired,
+        .user_data = requester,
+        .options = &request_options,
+    };
+    aws_http_request_manager_acquire_stream(s_tester.request_manager, &acquire_options);
+}
+
+static int s_requester_check_response(struct rm_requester *requester, const char *expected_body) {
+    ASSERT_TRUE(requester->is_complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, requester->complete_error_code);
+    int status = 0;
+    ASSERT_SUCCESS(aws_http_stream_get_incoming_response_status(requester->stream, &status));
+    ASSERT_INT_EQUALS(200, status);
+    ASSERT_BIN_ARRAYS_EQUALS(expected_body, strlen(expected_body), requester->body.buffer, requester->body.len);
+    return AWS_OP_SUCCESS;
+}
+
+static void s_requester_clean_up(struct rm_requester *requester) {
+    aws_http_stream_release(requester->stream);
+    aws_byte_buf_clean_up(&requester->body);
+}
+
+/* Identical GETs share one request on the wire, and each hears the whole response */
+TEST_CASE(request_manager_mock_coalesces_identical_gets) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_mock_tester_init(allocator));
+
+    struct rm_requester requesters[3];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        s_requester_acquire(&requesters[i], s_tester.request, NULL);
+    }
+    ASSERT_UINT_EQUALS(1, aws_array_list_length(&s_tester.mock_acquisitions));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        ASSERT_FALSE(requesters[i].is_acquire_done);
+    }
+
+    ASSERT_SUCCESS(s_mock_resolve_acquisition(AWS_ERROR_SUCCESS));
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(
+        &s_tester.testing_channel,
+        allocator,
+        "GET / HTTP/1.1\r\n"
+        "host: www.example.com\r\n"
+        "\r\n"));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        ASSERT_TRUE(requesters[i].is_acquire_done);
+        ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, requesters[i].acquire_error_code);
+        ASSERT_NOT_NULL(requesters[i].stream);
+        ASSERT_PTR_EQUALS(s_tester.connection, aws_http_stream_get_connection(requesters[i].stream));
+        ASSERT_UINT_EQUALS(aws_http_stream_get_id(requesters[0].stream), aws_http_stream_get_id(requesters[i].stream));
+        ASSERT_FALSE(requesters[i].is_complete);
+    }
+    ASSERT_TRUE(requesters[0].stream != requesters[1].stream);
+
+    ASSERT_SUCCESS(s_mock_push_response_str("HTTP/1.1 200 OK\r\n"
+                                            "Content-Length: 5\r\n"
+                                            "\r\n"
+                                            "hello"));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        ASSERT_SUCCESS(s_requester_check_response(&requesters[i], "hello"));
+    }
+    ASSERT_UINT_EQUALS(1, s_tester.mock_released_count);
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        s_requester_clean_up(&requesters[i]);
+    }
+    return s_tester_clean_up();
+}
+
+/* Cancelling one coalesced stream completes only that one, the others still get the response */
+TEST_CASE(request_manager_mock_coalesced_stream_cancel) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_mock_tester_init(allocator));
+
+    struct rm_requester cancelled;
+    struct rm_requester remaining;
+    s_requester_acquire(&cancelled, s_tester.request, NULL);
+    s_requester_acquire(&remaining, s_tester.request, NULL);
+    ASSERT_SUCCESS(s_mock_resolve_acquisition(AWS_ERROR_SUCCESS));
+    ASSERT_NOT_NULL(cancelled.stream);
+    ASSERT_NOT_NULL(remaining.stream);
+
+    ASSERT_SUCCESS(s_mock_push_response_str("HTTP/1.1 200 OK\r\n"
+                                            "Content-Length: 10\r\n"
+                                            "\r\n"
+                                            "hello"));
+    aws_http_stream_cancel(cancelled.stream, AWS_ERROR_COND_VARIABLE_ERROR_UNKNOWN);
+    ASSERT_TRUE(cancelled.is_complete);
+    ASSERT_INT_EQUALS(AWS_ERROR_COND_VARIABLE_ERROR_UNKNOWN, cancelled.complete_error_code);
+    ASSERT_FALSE(remaining.is_complete);
+
+    /* The shared stream carries on, and the cancelled stream hears no more of it */
+    ASSERT_SUCCESS(s_mock_push_response_str("world"));
+    ASSERT_SUCCESS(s_requester_check_response(&remaining, "helloworld"));
+    ASSERT_BIN_ARRAYS_EQUALS("hello", 5, cancelled.body.buffer, cancelled.body.len);
+    ASSERT_INT_EQUALS(AWS_ERROR_COND_VARIABLE_ERROR_UNKNOWN, cancelled.complete_error_code);
+    ASSERT_UINT_EQUALS(1, s_tester.mock_released_count);
+
+    s_requester_clean_up(&cancelled);
+    s_requester_clean_up(&remaining);
+    return s_tester_clean_up();
+}
+
+/* Once the response has begun, an identical GET can't catch up with it, so it starts a new flight */
+TEST_CASE(request_manager_mock_join_after_response_begun) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_mock_tester_init(allocator));
+
+    struct rm_requester early;
+    s_requester_acquire(&early, s_tester.request, NULL);
+    ASSERT_SUCCESS(s_mock_resolve_acquisition(AWS_ERROR_SUCCESS));
+    ASSERT_SUCCESS(s_mock_push_response_str("HTTP/1.1 200 OK\r\n"
+                                            "Content-Length: 10\r\n"
+                                            "\r\n"
+                                            "hello"));
+
+    struct rm_requester late;
+    s_requester_acquire(&late, s_tester.request, NULL);
+    ASSERT_UINT_EQUALS(2, aws_array_list_length(&s_tester.mock_acquisitions));
+    ASSERT_FALSE(late.is_acquire_done);
+
+    ASSERT_SUCCESS(s_mock_push_response_str("world"));
+    ASSERT_SUCCESS(s_requester_check_response(&early, "helloworld"));
+
+    ASSERT_SUCCESS(s_mock_resolve_acquisition(AWS_ERROR_SUCCESS));
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, late.acquire_error_code);
+    ASSERT_NOT_NULL(late.stream);
+    ASSERT_TRUE(aws_http_stream_get_id(early.stream) != aws_http_stream_get_id(late.stream));
+    ASSERT_SUCCESS(s_mock_push_response_str("HTTP/1.1 200 OK\r\n"
+                                            "Content-Length: 3\r\n"
+                                            "\r\n"
+                                            "bye"));
+    ASSERT_SUCCESS(s_requester_check_response(&late, "bye"));
+    ASSERT_BIN_ARRAYS_EQUALS("helloworld", 10, early.body.buffer, early.body.len);
+    ASSERT_UINT_EQUALS(2, s_tester.mock_released_count);
+
+    s_requester_clean_up(&early);
+    s_requester_clean_up(&late);
+    return s_tester_clean_up();
+}
+
+/* If the shared stream can't be made, every requester waiting on it hears the error */
+TEST_CASE(request_manager_mock_coalesced_acquire_failure) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_mock_tester_init(allocator));
+
+    struct rm_requester requesters[3];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        s_requester_acquire(&requesters[i], s_tester.request, NULL);
+    }
+    ASSERT_UINT_EQUALS(1, aws_array_list_length(&s_tester.mock_acquisitions));
+
+    ASSERT_SUCCESS(s_mock_resolve_acquisition(AWS_ERROR_HTTP_CONNECTION_CLOSED));
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        ASSERT_TRUE(requesters[i].is_acquire_done);
+        ASSERT_INT_EQUALS(AWS_ERROR_HTTP_CONNECTION_CLOSED, requesters[i].acquire_error_code);
+        ASSERT_NULL(requesters[i].stream);
+        ASSERT_FALSE(requesters[i].is_complete);
+    }
+
+    /* The failed flight is gone, so the next identical GET starts over */
+    struct rm_requester retry;
+    s_requester_acquire(&retry, s_tester.request, NULL);
+    ASSERT_UINT_EQUALS(2, aws_array_list_length(&s_tester.mock_acquisitions));
+    ASSERT_SUCCESS(s_mock_resolve_acquisition(AWS_ERROR_HTTP_CONNECTION_CLOSED));
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_CONNECTION_CLOSED, retry.acquire_error_code);
+    ASSERT_UINT_EQUALS(0, s_tester.mock_released_count);
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        s_requester_clean_up(&requesters[i]);
+    }
+    s_requester_clean_up(&retry);
+    return s_tester_clean_up();
+}
+
+static int s_passthrough_decoder_new(
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor content_coding,
+    void *user_data,
+    struct aws_http_content_decoder **out_decoder) {
+
+    (void)allocator;
+    (void)content_coding;
+    (void)user_data;
+    *out_decoder = NULL;
+    return AWS_OP_SUCCESS;
+}
+
+/* A GET with a body, or whose response the user decodes, is never coalesced */
+TEST_CASE(request_manager_mock_excludes_body_and_content_decoding) {
+    (void)ctx;
+    ASSERT_SUCCESS(s_mock_tester_init(allocator));
+
+    struct aws_http_message *request_with_body = aws_http_message_new_request(allocator);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request_with_body, aws_http_method_get));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request_with_body, aws_byte_cursor_from_c_str("/")));
+    struct aws_http_header host_header = {
+        .name = aws_byte_cursor_from_c_str("host"),
+        .value = s_tester.endpoint.host_name,
+    };
+    ASSERT_SUCCESS(aws_http_message_add_header(request_with_body, host_header));
+    struct aws_byte_cursor body = aws_byte_cursor_from_c_str("body");
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+    aws_http_message_set_body_stream(request_with_body, body_stream);
+
+    static const struct aws_http_content_decoding_options s_content_decoding = {
+        .new_decoder = s_passthrough_decoder_new,
+    };
+
+    struct rm_requester requesters[4];
+    s_requester_acquire(&requesters[0], request_with_body, NULL);
+    s_requester_acquire(&requesters[1], request_with_body, NULL);
+    s_requester_acquire(&requesters[2], s_tester.request, &s_content_decoding);
+    s_requester_acquire(&requesters[3], s_tester.request, &s_content_decoding);
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(requesters), aws_array_list_length(&s_tester.mock_acquisitions));
+
+    /* Each request waits on its own connection, so each one fails alone */
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        ASSERT_SUCCESS(s_mock_resolve_acquisition(AWS_ERROR_HTTP_CONNECTION_CLOSED));
+        for (size_t j = 0; j < AWS_ARRAY_SIZE(requesters); ++j) {
+            ASSERT_TRUE(requesters[j].is_acquire_done == (j <= i));
+        }
+        ASSERT_INT_EQUALS(AWS_ERROR_HTTP_CONNECTION_CLOSED, requesters[i].acquire_error_code);
+    }
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(requesters); ++i) {
+        s_requester_clean_up(&requesters[i]);
+    }
+    aws_http_message_release(request_with_body);
+    aws_input_stream_release(body_stream);
+    return s_tester_clean_up();
+}
@@ -0,0 +1,248 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/response_cache_impl.h>
+
+#include <aws/common/clock.h>
+#include <aws/http/request_response.h>
+#include <aws/testing/aws_test_harness.h>
+
+#include <stdio.h>
+
+/* Sun, 06 Nov 1994 08:49:37 GMT */
+#define TEST_DATE_EPOCH_SECS 784111777
+
+static uint64_t s_mock_now_ns;
+
+static int s_mock_clock(uint64_t *timestamp) {
+    *timestamp = s_mock_now_ns;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_set_mock_clock_secs(uint64_t secs) {
+    s_mock_now_ns = aws_timestamp_convert(secs, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+}
+
+static struct aws_http_response_cache *s_cache_new(struct aws_allocator *allocator, size_t max_bytes) {
+    struct aws_http_response_cache_options options = {.max_bytes = max_bytes};
+    struct aws_http_response_cache *cache = aws_http_response_cache_new(allocator, &options);
+    if (cache) {
+        cache->system_clock_fn = s_mock_clock;
+    }
+    s_set_mock_clock_secs(TEST_DATE_EPOCH_SECS);
+    return cache;
+}
+
+static struct aws_http_message *s_request_new(struct aws_allocator *allocator, const char *method, const char *path) {
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str(method));
+    aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str(path));
+    aws_http_headers_add(
+        aws_http_message_get_headers(request),
+        aws_byte_cursor_from_c_str("Host"),
+        aws_byte_cursor_from_c_str("example.com"));
+    return request;
+}
+
+static void s_add(struct aws_http_headers *headers, const char *name, const char *value) {
+    aws_http_headers_add(headers, aws_byte_cursor_from_c_str(name), aws_byte_cursor_from_c_str(value));
+}
+
+/* A stored response is served until it goes stale, then again once a 304 revalidates it */
+static int s_response_cache_fresh_stale_revalidated_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+    struct aws_http_response_cache *cache = s_cache_new(allocator, 64 * 1024);
+    ASSERT_NOT_NULL(cache);
+
+    struct aws_http_message *request = s_request_new(allocator, "GET", "/object");
+    struct aws_http_cached_response *cached = NULL;
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_MISS, aws_http_response_cache_lookup(cache, request, &cached));
+    ASSERT_NULL(cached);
+
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    s_add(response_headers, "Date", "Sun, 06 Nov 1994 08:49:37 GMT");
+    s_add(response_headers, "Cache-Control", "public, max-age=60");
+    s_add(response_headers, "ETag", "\"v1\"");
+    s_add(response_headers, "Content-Length", "5");
+    ASSERT_SUCCESS(
+        aws_http_response_cache_store(cache, request, 200, response_headers, aws_byte_cursor_from_c_str("hello")));
+    ASSERT_TRUE(aws_http_response_cache_get_size(cache) > 0);
+
+    /* Fresh, minus the headers that described the message */
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_FRESH, aws_http_response_cache_lookup(cache, request, &cached));
+    ASSERT_INT_EQUALS(200, aws_http_cached_response_get_status(cached));
+    struct aws_byte_cursor body = aws_http_cached_response_get_body(cached);
+    ASSERT_BIN_ARRAYS_EQUALS("hello", 5, body.ptr, body.len);
+    const struct aws_http_headers *cached_headers = aws_http_cached_response_get_headers(cached);
+    ASSERT_FALSE(aws_http_headers_has(cached_headers, aws_byte_cursor_from_c_str("content-length")));
+    aws_http_cached_response_release(cached);
+
+    /* The request may ask for a fresher one */
+    struct aws_http_message *picky_request = s_request_new(allocator, "GET", "/object");
+    s_set_mock_clock_secs(TEST_DATE_EPOCH_SECS + 30);
+    s_add(aws_http_message_get_headers(picky_request), "Cache-Control", "max-age=10");
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_STALE, aws_http_response_cache_lookup(cache, picky_request, &cached));
+    aws_http_cached_response_release(cached);
+    aws_http_message_release(picky_request);
+
+    /* Stale once max-age passes */
+    s_set_mock_clock_secs(TEST_DATE_EPOCH_SECS + 61);
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_STALE, aws_http_response_cache_lookup(cache, request, &cached));
+
+    struct aws_http_message *revalidation = s_request_new(allocator, "GET", "/object");
+    ASSERT_SUCCESS(aws_http_cached_response_add_validators(cached, revalidation));
+    struct aws_byte_cursor if_none_match;
+    ASSERT_SUCCESS(aws_http_headers_get(
+        aws_http_message_get_headers(revalidation), aws_byte_cursor_from_c_str("If-None-Match"), &if_none_match));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&if_none_match, "\"v1\""));
+
+    /* A 304 refreshes it, and the body is shared rather than copied */
+    struct aws_http_headers *not_modified_headers = aws_http_headers_new(allocator);
+    s_add(not_modified_headers, "Date", "Sun, 06 Nov 1994 08:50:38 GMT");
+    s_add(not_modified_headers, "Cache-Control", "max-age=120");
+    struct aws_http_cached_response *refreshed = aws_http_response_cache_update(cache, cached, not_modified_headers);
+    ASSERT_NOT_NULL(refreshed);
+    ASSERT_PTR_EQUALS(body.ptr, aws_http_cached_response_get_body(refreshed).ptr);
+    aws_http_cached_response_release(refreshed);
+    aws_http_cached_response_release(cached);
+
+    s_set_mock_clock_secs(TEST_DATE_EPOCH_SECS + 121);
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_FRESH, aws_http_response_cache_lookup(cache, request, &cached));
+    struct aws_byte_cursor cache_control;
+    ASSERT_SUCCESS(aws_http_headers_get(
+        aws_http_cached_response_get_headers(cached), aws_byte_cursor_from_c_str("cache-control"), &cache_control));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&cache_control, "max-age=120"));
+    aws_http_cached_response_release(cached);
+
+    /* A successful unsafe request evicts it */
+    struct aws_http_message *put_request = s_request_new(allocator, "PUT", "/object");
+    ASSERT_SUCCESS(
+        aws_http_response_cache_store(cache, put_request, 200, not_modified_headers, aws_byte_cursor_from_c_str("")));
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_MISS, aws_http_response_cache_lookup(cache, request, &cached));
+    ASSERT_UINT_EQUALS(0, aws_http_response_cache_get_size(cache));
+
+    aws_http_message_release(put_request);
+    aws_http_headers_release(not_modified_headers);
+    aws_http_message_release(revalidation);
+    aws_http_headers_release(response_headers);
+    aws_http_message_release(request);
+    aws_http_response_cache_release(cache);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(response_cache_fresh_stale_revalidated, s_response_cache_fresh_stale_revalidated_fn)
+
+/* Responses that mustn't be stored aren't, and Vary picks which requests may use one */
+static int s_response_cache_storage_rules_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+    struct aws_http_response_cache *cache = s_cache_new(allocator, 64 * 1024);
+    ASSERT_NOT_NULL(cache);
+    struct aws_http_cached_response *cached = NULL;
+    struct aws_byte_cursor body = aws_byte_cursor_from_c_str("body");
+
+    struct aws_http_message *request = s_request_new(allocator, "GET", "/rules");
+    struct aws_http_headers *no_store = aws_http_headers_new(allocator);
+    s_add(no_store, "Cache-Control", "max-age=60, no-store");
+    ASSERT_SUCCESS(aws_http_response_cache_store(cache, request, 200, no_store, body));
+
+    struct aws_http_headers *vary_star = aws_http_headers_new(allocator);
+    s_add(vary_star, "Cache-Control", "max-age=60");
+    s_add(vary_star, "Vary", "*");
+    ASSERT_SUCCESS(aws_http_response_cache_store(cache, request, 200, vary_star, body));
+
+    /* Neither fresh nor revalidatable */
+    struct aws_http_headers *no_freshness = aws_http_headers_new(allocator);
+    s_add(no_freshness, "Content-Type", "text/plain");
+    ASSERT_SUCCESS(aws_http_response_cache_store(cache, request, 200, no_freshness, body));
+
+    ASSERT_SUCCESS(aws_http_response_cache_store(cache, request, 206, vary_star, body));
+    ASSERT_UINT_EQUALS(0, aws_http_response_cache_get_size(cache));
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_MISS, aws_http_response_cache_lookup(cache, request, &cached));
+
+    /* Vary on Accept-Encoding: only requests with the same one match */
+    s_add(aws_http_message_get_headers(request), "Accept-Encoding", "gzip");
+    struct aws_http_headers *vary = aws_http_headers_new(allocator);
+    s_add(vary, "Cache-Control", "max-age=60");
+    s_add(vary, "Vary", "accept-encoding");
+    ASSERT_SUCCESS(aws_http_response_cache_store(cache, request, 200, vary, body));
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_FRESH, aws_http_response_cache_lookup(cache, request, &cached));
+    aws_http_cached_response_release(cached);
+
+    struct aws_http_message *other_request = s_request_new(allocator, "GET", "/rules");
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_MISS, aws_http_response_cache_lookup(cache, other_request, &cached));
+    s_add(aws_http_message_get_headers(other_request), "Accept-Encoding", "br");
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_MISS, aws_http_response_cache_lookup(cache, other_request, &cached));
+
+    /* Without explicit freshness, Last-Modified gives a tenth of its age */
+    struct aws_http_message *heuristic_request = s_request_new(allocator, "GET", "/heuristic");
+    struct aws_http_headers *heuristic = aws_http_headers_new(allocator);
+    s_add(heuristic, "Date", "Sun, 06 Nov 1994 08:49:37 GMT");
+    s_add(heuristic, "Last-Modified", "Sun, 06 Nov 1994 08:32:57 GMT");
+    ASSERT_SUCCESS(aws_http_response_cache_store(cache, heuristic_request, 200, heuristic, body));
+    s_set_mock_clock_secs(TEST_DATE_EPOCH_SECS + 99);
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_FRESH, aws_http_response_cache_lookup(cache, heuristic_request, &cached));
+    aws_http_cached_response_release(cached);
+    s_set_mock_clock_secs(TEST_DATE_EPOCH_SECS + 100);
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_STALE, aws_http_response_cache_lookup(cache, heuristic_request, &cached));
+    aws_http_cached_response_release(cached);
+
+    aws_http_headers_release(heuristic);
+    aws_http_message_release(heuristic_request);
+    aws_http_message_release(other_request);
+    aws_http_headers_release(vary);
+    aws_http_headers_release(no_freshness);
+    aws_http_headers_release(vary_star);
+    aws_http_headers_release(no_store);
+    aws_http_message_release(request);
+    aws_http_response_cache_release(cache);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(response_cache_storage_rules, s_response_cache_storage_rules_fn)
+
+/* The cache stays within max_bytes, evicting the least recently used, and skips what would never fit */
+static int s_response_cache_bounded_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+    const size_t max_bytes = AWS_HTTP_RESPONSE_CACHE_SHARD_COUNT * 1024;
+    struct aws_http_response_cache *cache = s_cache_new(allocator, max_bytes);
+    ASSERT_NOT_NULL(cache);
+    struct aws_http_cached_response *cached = NULL;
+
+    struct aws_http_headers *headers = aws_http_headers_new(allocator);
+    s_add(headers, "Cache-Control", "max-age=60");
+    uint8_t body_bytes[400] = {0};
+    struct aws_byte_cursor body = aws_byte_cursor_from_array(body_bytes, sizeof(body_bytes));
+
+    struct aws_http_message *last_request = NULL;
+    for (size_t i = 0; i < 64; ++i) {
+        char path[32];
+        snprintf(path, sizeof(path), "/object/%zu", i);
+        struct aws_http_message *request = s_request_new(allocator, "GET", path);
+        ASSERT_SUCCESS(aws_http_response_cache_store(cache, request, 200, headers, body));
+        ASSERT_TRUE(aws_http_response_cache_get_size(cache) <= max_bytes);
+        aws_http_message_release(last_request);
+        last_request = request;
+    }
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_FRESH, aws_http_response_cache_lookup(cache, last_request, &cached));
+    aws_http_cached_response_release(cached);
+
+    /* Bigger than a shard */
+    uint8_t big_body_bytes[2048] = {0};
+    struct aws_http_message *big_request = s_request_new(allocator, "GET", "/big");
+    ASSERT_SUCCESS(aws_http_response_cache_store(
+        cache, big_request, 200, headers, aws_byte_cursor_from_array(big_body_bytes, sizeof(big_body_bytes))));
+    ASSERT_INT_EQUALS(AWS_HTTP_RESPONSE_CACHE_MISS, aws_http_response_cache_lookup(cache, big_request, &cached));
+
+    aws_http_message_release(big_request);
+    aws_http_message_release(last_request);
+    aws_http_headers_release(headers);
+    aws_http_response_cache_release(cache);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(response_cache_bounded, s_response_cache_bounded_fn)
@@ -55,6 +55,10 @@ struct sm_tester_options {
     bool close_connection_on_server_error;
     size_t connection_ping_period_ms;
     size_t connection_ping_timeout_ms;
+    enum aws_http2_stream_manager_selection_policy selection_policy;
+    uint32_t connection_replacement_stream_id;
+    size_t max_unprocessed_stream_retries;
+    bool enable_adaptive_concurrency;
 };
 
 static struct aws_logger s_logger;
@@ -112,6 +116,9 @@ struct sm_tester {
     aws_http_on_client_connection_setup_fn *on_setup;
 
     size_t length_sent;
+
+    /* Hedge delay of the streams acquired */
+    uint64_t hedge_delay_ms;
 };
 
 static struct sm_tester s_tester;
@@ -290,6 +297,10 @@ static int s_tester_init(struct sm_tester_options *options) {
         .connection_ping_period_ms = options->connection_ping_period_ms,
         .connection_ping_timeout_ms = options->connection_ping_timeout_ms,
         .http2_prior_knowledge = options->prior_knowledge,
+        .selection_policy = options->selection_policy,
+        .connection_replacement_stream_id = options->connection_replacement_stream_id,
+        .max_unprocessed_stream_retries = options->max_unprocessed_stream_retries,
+        .enable_adaptive_concurrency = options->enable_adaptive_concurrency,
     };
     s_tester.stream_manager = aws_http2_stream_manager_new(alloc, &sm_options);
 
@@ -524,6 +535,7 @@ static int s_sm_stream_acquiring_customize_request(
         .options = request_options,
         .callback = s_sm_tester_on_stream_acquired,
         .user_data = &s_tester,
+        .hedge_delay_ms = s_tester.hedge_delay_ms,
     };
     for (int i = 0; i < num_streams; ++i) {
         /* TODO: Test the callback will always be fired asynced, as now the CM cannot ensure the callback happens
@@ -752,6 +764,111 @@ TEST_CASE(h2_sm_mock_multiple_connections) {
     return s_tester_clean_up();
 }
 
+/* Every selection policy still spreads streams over the connections, up to their limit */
+TEST_CASE(h2_sm_mock_selection_policy) {
+    (void)ctx;
+    enum aws_http2_stream_manager_selection_policy policies[] = {
+        AWS_HTTP2_STREAM_MANAGER_SELECTION_LEAST_OUTSTANDING_BYTES,
+        AWS_HTTP2_STREAM_MANAGER_SELECTION_FEWEST_STALLED_STREAMS,
+        AWS_HTTP2_STREAM_MANAGER_SELECTION_LOWEST_RTT,
+    };
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(policies); ++i) {
+        struct sm_tester_options options = {
+            .max_connections = 3,
+            .max_concurrent_streams_per_connection = 3,
+            .selection_policy = policies[i],
+            .alloc = allocator,
+        };
+        ASSERT_SUCCESS(s_tester_init(&options));
+        s_override_cm_connect_function(s_aws_http_connection_manager_create_connection_sync_mock);
+        ASSERT_SUCCESS(s_sm_stream_acquiring(9));
+        ASSERT_SUCCESS(s_wait_on_fake_connection_count(3));
+        s_drain_all_fake_connection_testing_channel();
+        ASSERT_SUCCESS(s_wait_on_streams_acquired_count(9));
+        ASSERT_UINT_EQUALS(3, aws_array_list_length(&s_tester.fake_connections));
+        ASSERT_SUCCESS(s_complete_all_fake_connection_streams());
+        ASSERT_SUCCESS(s_tester_clean_up());
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Test that a connection past its replacement stream id gets a successor, and new streams go to the successor while
+ * the old connection drains */
+TEST_CASE(h2_sm_mock_connection_replacement) {
+    (void)ctx;
+    struct sm_tester_options options = {
+        .max_connections = 1,
+        .max_concurrent_streams_per_connection = 5,
+        .connection_replacement_stream_id = 5,
+        .alloc = allocator,
+    };
+    ASSERT_SUCCESS(s_tester_init(&options));
+    s_override_cm_connect_function(s_aws_http_connection_manager_create_connection_sync_mock);
+    ASSERT_SUCCESS(s_sm_stream_acquiring(3));
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(1));
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(3));
+    /* Stream 5 passed the threshold, the successor is made even though max_connections is 1 */
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(2));
+
+    /* New streams go to the successor, while the old connection keeps its streams */
+    ASSERT_SUCCESS(s_sm_stream_acquiring(2));
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(5));
+    ASSERT_INT_EQUALS(0, s_tester.acquiring_stream_errors);
+    ASSERT_INT_EQUALS(3, s_fake_connection_get_stream_received(s_get_fake_connection(0)));
+    ASSERT_INT_EQUALS(2, s_fake_connection_get_stream_received(s_get_fake_connection(1)));
+    ASSERT_SUCCESS(s_complete_all_fake_connection_streams());
+    ASSERT_INT_EQUALS(0, s_tester.stream_complete_errors);
+
+    return s_tester_clean_up();
+}
+
+/* Test that a hedged stream gets a duplicate on another connection after the delay, and the duplicate responding
+ * first wins while the original is reset */
+TEST_CASE(h2_sm_mock_hedged_stream) {
+    (void)ctx;
+    struct sm_tester_options options = {
+        .max_connections = 2,
+        .ideal_concurrent_streams_per_connection = 1,
+        .max_concurrent_streams_per_connection = 5,
+        .alloc = allocator,
+    };
+    ASSERT_SUCCESS(s_tester_init(&options));
+    s_override_cm_connect_function(s_aws_http_connection_manager_create_connection_sync_mock);
+    ASSERT_SUCCESS(s_sm_stream_acquiring(1));
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(1));
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(1));
+
+    /* The hedged stream gets the second connection */
+    s_tester.hedge_delay_ms = 10;
+    ASSERT_SUCCESS(s_sm_stream_acquiring(1));
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(2));
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(2));
+
+    /* After the delay, the duplicate goes to the first connection */
+    aws_thread_current_sleep(aws_timestamp_convert(50, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL));
+    s_drain_all_fake_connection_testing_channel();
+    s_drain_all_fake_connection_testing_channel();
+    struct sm_fake_connection *first_connection = s_get_fake_connection(0);
+    struct sm_fake_connection *hedged_connection = s_get_fake_connection(1);
+    ASSERT_INT_EQUALS(2, s_fake_connection_get_stream_received(first_connection));
+
+    /* The duplicate responds first, the original is reset and not reported */
+    s_fake_connection_complete_streams(first_connection, 0 /*all streams*/);
+    testing_channel_drain_queued_tasks(&hedged_connection->testing_channel);
+    ASSERT_SUCCESS(h2_fake_peer_decode_messages_from_testing_channel(&hedged_connection->peer));
+    ASSERT_NOT_NULL(h2_decode_tester_find_frame(&hedged_connection->peer.decode, AWS_H2_FRAME_T_RST_STREAM, 0, NULL));
+    ASSERT_UINT_EQUALS(2, s_tester.stream_completed_count);
+    ASSERT_UINT_EQUALS(2, s_tester.stream_status_not_200_count);
+    ASSERT_UINT_EQUALS(0, s_tester.stream_complete_errors);
+
+    return s_tester_clean_up();
+}
+
 /* Test stream manager got an bad connection and fail the expected number of stream requests. */
 TEST_CASE(h2_sm_mock_bad_connection_acquired) {
     (void)ctx;
@@ -878,6 +995,57 @@ TEST_CASE(h2_sm_mock_max_concurrent_streams_remote) {
     return s_tester_clean_up();
 }
 
+/* Test streams completing on one read are handed back to the stream manager together, on the next tick */
+TEST_CASE(h2_sm_mock_batched_stream_completions) {
+    (void)ctx;
+    struct sm_tester_options options = {
+        .max_connections = 1,
+        .alloc = allocator,
+    };
+    ASSERT_SUCCESS(s_tester_init(&options));
+    s_override_cm_connect_function(s_aws_http_connection_manager_create_connection_sync_mock);
+    s_tester.max_con_stream_remote = 3;
+    ASSERT_SUCCESS(s_sm_stream_acquiring(6));
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(1));
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(3));
+
+    /* Fake peer completes all 3 streams at once */
+    struct sm_fake_connection *fake_connection = s_get_fake_connection(0);
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&fake_connection->peer));
+    struct aws_http_header response_headers_src[] = {
+        DEFINE_HEADER(":status", "200"),
+    };
+    struct aws_http_headers *response_headers = aws_http_headers_new(allocator);
+    aws_http_headers_add_array(response_headers, response_headers_src, AWS_ARRAY_SIZE(response_headers_src));
+    for (size_t i = 0; i < 3; ++i) {
+        struct aws_http_stream *stream = NULL;
+        ASSERT_SUCCESS(aws_array_list_get_at(&s_tester.streams, &stream, i));
+        struct aws_h2_frame *response_frame = aws_h2_frame_new_headers(
+            allocator, aws_http_stream_get_id(stream), response_headers, true /*end_stream*/, 0, NULL);
+        ASSERT_SUCCESS(h2_fake_peer_send_frame(&fake_connection->peer, response_frame));
+    }
+    aws_http_headers_release(response_headers);
+    ASSERT_SUCCESS(s_wait_on_streams_completed_count(3));
+
+    /* The stream manager hasn't heard of them yet */
+    struct aws_http_manager_metrics out_metrics;
+    AWS_ZERO_STRUCT(out_metrics);
+    aws_http2_stream_manager_fetch_metrics(s_tester.stream_manager, &out_metrics);
+    ASSERT_UINT_EQUALS(3, out_metrics.leased_concurrency);
+    ASSERT_UINT_EQUALS(3, out_metrics.pending_concurrency_acquires);
+
+    /* Once it has, the pending acquisitions get all the room together */
+    testing_channel_drain_queued_tasks(&fake_connection->testing_channel);
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(6));
+    ASSERT_INT_EQUALS(6, s_fake_connection_get_stream_received(fake_connection));
+    ASSERT_INT_EQUALS(3, s_tester.stream_200_count);
+
+    ASSERT_SUCCESS(s_complete_all_fake_connection_streams());
+    return s_tester_clean_up();
+}
+
 /* Test that the remote max concurrent streams setting hit */
 TEST_CASE(h2_sm_mock_fetch_metric) {
     (void)ctx;
@@ -1120,6 +1288,93 @@ TEST_CASE(h2_sm_mock_goaway) {
     return s_tester_clean_up();
 }
 
+/* Test that streams cut off by goaway are replayed on a new connection, when the stream manager is set to */
+TEST_CASE(h2_sm_mock_goaway_replays_unprocessed_streams) {
+    (void)ctx;
+    struct sm_tester_options options = {
+        .max_connections = 5,
+        .max_unprocessed_stream_retries = 1,
+        .alloc = allocator,
+    };
+    ASSERT_SUCCESS(s_tester_init(&options));
+    s_override_cm_connect_function(s_aws_http_connection_manager_create_connection_sync_mock);
+    ASSERT_SUCCESS(s_sm_stream_acquiring(5));
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(1));
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(5));
+
+    /* Fake peer send goaway, only the first stream was processed */
+    struct sm_fake_connection *fake_connection = s_get_fake_connection(0);
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&fake_connection->peer));
+    struct aws_byte_cursor debug_info;
+    AWS_ZERO_STRUCT(debug_info);
+    struct aws_http_stream *stream = NULL;
+    aws_array_list_front(&s_tester.streams, &stream);
+    struct aws_h2_frame *peer_frame =
+        aws_h2_frame_new_goaway(allocator, aws_http_stream_get_id(stream), AWS_HTTP2_ERR_NO_ERROR, debug_info);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&fake_connection->peer, peer_frame));
+    testing_channel_drain_queued_tasks(&fake_connection->testing_channel);
+
+    /* The other 4 are replayed on a new connection instead of completing with error */
+    ASSERT_INT_EQUALS(0, s_tester.stream_complete_errors);
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(2));
+    s_drain_all_fake_connection_testing_channel();
+    struct sm_fake_connection *new_connection = s_get_fake_connection(1);
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&new_connection->peer));
+    testing_channel_drain_queued_tasks(&new_connection->testing_channel);
+    ASSERT_INT_EQUALS(4, s_fake_connection_get_stream_received(new_connection));
+
+    ASSERT_SUCCESS(s_complete_all_fake_connection_streams());
+    ASSERT_SUCCESS(s_wait_on_streams_completed_count(5));
+    ASSERT_INT_EQUALS(0, s_tester.stream_complete_errors);
+    /* No new stream was handed out for the replays */
+    ASSERT_UINT_EQUALS(5, aws_array_list_length(&s_tester.streams));
+
+    return s_tester_clean_up();
+}
+
+/* Test a refused stream halves the connection's adaptive ideal number, so new streams go to a new connection */
+TEST_CASE(h2_sm_mock_adaptive_concurrency_refused_stream) {
+    (void)ctx;
+    struct sm_tester_options options = {
+        .max_connections = 5,
+        .ideal_concurrent_streams_per_connection = 4,
+        .enable_adaptive_concurrency = true,
+        .alloc = allocator,
+    };
+    ASSERT_SUCCESS(s_tester_init(&options));
+    s_override_cm_connect_function(s_aws_http_connection_manager_create_connection_sync_mock);
+    ASSERT_SUCCESS(s_sm_stream_acquiring(4));
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(1));
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(4));
+
+    /* Fake peer refuses the first stream */
+    struct sm_fake_connection *fake_connection = s_get_fake_connection(0);
+    ASSERT_SUCCESS(h2_fake_peer_send_connection_preface_default_settings(&fake_connection->peer));
+    struct aws_http_stream *stream = NULL;
+    aws_array_list_front(&s_tester.streams, &stream);
+    struct aws_h2_frame *peer_frame =
+        aws_h2_frame_new_rst_stream(allocator, aws_http_stream_get_id(stream), AWS_HTTP2_ERR_REFUSED_STREAM);
+    ASSERT_SUCCESS(h2_fake_peer_send_frame(&fake_connection->peer, peer_frame));
+    testing_channel_drain_queued_tasks(&fake_connection->testing_channel);
+    ASSERT_SUCCESS(s_wait_on_streams_completed_count(1));
+    ASSERT_INT_EQUALS(1, s_tester.stream_complete_errors);
+
+    /* The connection still has 3 streams, over its ideal number of 2 now, so the next stream opens a new connection.
+     * With a fixed ideal number of 4, it would have gone to the first connection. */
+    ASSERT_SUCCESS(s_sm_stream_acquiring(1));
+    ASSERT_SUCCESS(s_wait_on_fake_connection_count(2));
+    s_drain_all_fake_connection_testing_channel();
+    ASSERT_SUCCESS(s_wait_on_streams_acquired_count(5));
+    /* The first connection got no more than the original 4 */
+    ASSERT_INT_EQUALS(4, s_fake_connection_get_stream_received(fake_connection));
+    ASSERT_INT_EQUALS(1, s_fake_connection_get_stream_received(s_get_fake_connection(1)));
+
+    ASSERT_SUCCESS(s_complete_all_fake_connection_streams());
+    return s_tester_clean_up();
+}
+
 /* Test that PING works as expected. */
 TEST_CASE(h2_sm_connection_ping) {
     (void)ctx;
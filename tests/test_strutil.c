@@ -159,6 +159,65 @@ static int s_strutil_is_http_field_value(struct aws_allocator *allocator, void *
     return 0;
 }
 
+AWS_TEST_CASE(strutil_split_http_header_line, s_strutil_split_http_header_line);
+static int s_strutil_split_http_header_line(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_byte_cursor name;
+    struct aws_byte_cursor value;
+
+    /* sanity check */
+    ASSERT_TRUE(aws_strutil_split_http_header_line(aws_byte_cursor_from_c_str("Host: example.com"), &name, &value));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&name, "Host"));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&value, "example.com"));
+
+    /* value is trimmed, and may contain more colons */
+    ASSERT_TRUE(aws_strutil_split_http_header_line(aws_byte_cursor_from_c_str("a:\t b:c \t"), &name, &value));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&name, "a"));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&value, "b:c"));
+
+    /* empty value is OK */
+    ASSERT_TRUE(aws_strutil_split_http_header_line(aws_byte_cursor_from_c_str("a:"), &name, &value));
+    ASSERT_UINT_EQUALS(0, value.len);
+
+    /* missing colon, empty name, bad name */
+    ASSERT_FALSE(aws_strutil_split_http_header_line(aws_byte_cursor_from_c_str("no-colon-here"), &name, &value));
+    ASSERT_FALSE(aws_strutil_split_http_header_line(aws_byte_cursor_from_c_str(":value"), &name, &value));
+    ASSERT_FALSE(aws_strutil_split_http_header_line(aws_byte_cursor_from_c_str("a b: value"), &name, &value));
+
+    /* Lines long enough to exercise the 16-byte SIMD blocks, with the colon and the test byte
+     * placed at every position, checked against the one-rule-at-a-time table-driven functions */
+    char line[48];
+    for (size_t colon_pos = 0; colon_pos < sizeof(line); colon_pos += 5) {
+        for (size_t test_pos = 0; test_pos < sizeof(line); ++test_pos) {
+            for (size_t c = 0; c < 256; c += 7) {
+                memset(line, 'x', sizeof(line));
+                line[colon_pos] = ':';
+                line[test_pos] = (char)c;
+
+                struct aws_byte_cursor line_cursor = aws_byte_cursor_from_array(line, sizeof(line));
+
+                uint8_t *first_colon = memchr(line, ':', sizeof(line));
+                bool expected = first_colon != NULL;
+                if (expected) {
+                    struct aws_byte_cursor expected_name =
+                        aws_byte_cursor_from_array(line, (size_t)(first_colon - (uint8_t *)line));
+                    struct aws_byte_cursor expected_value = aws_strutil_trim_http_whitespace(
+                        aws_byte_cursor_from_array(first_colon + 1, sizeof(line) - expected_name.len - 1));
+                    expected = aws_strutil_is_http_token(expected_name) &&
+                               aws_strutil_is_http_field_value(expected_value);
+                }
+
+                bool actual = aws_strutil_split_http_header_line(line_cursor, &name, &value);
+                ASSERT_INT_EQUALS(expected, actual, "failed with 0x%02X at [%zu], colon at [%zu]", c, test_pos, colon_pos);
+            }
+        }
+    }
+
+    return 0;
+}
+
 AWS_TEST_CASE(strutil_is_http_reason_phrase, s_strutil_is_http_reason_phrase);
 static int s_strutil_is_http_reason_phrase(struct aws_allocator *allocator, void *ctx) {
     (void)allocator;
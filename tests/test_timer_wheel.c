@@ -0,0 +1,230 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/timer_wheel.h>
+
+#include <aws/testing/aws_test_harness.h>
+
+#define TICK_NS ((uint64_t)AWS_HTTP_TIMER_WHEEL_TICK_NS)
+
+struct tester_timer {
+    struct aws_http_timer timer;
+    struct aws_http_timer_wheel *wheel;
+    /* Order this timer fired in, 1-based. 0 if it hasn't fired */
+    int fired_order;
+    /* If non-zero, re-arm the timer this far ahead when it fires */
+    uint64_t rearm_delay_ns;
+    uint64_t fired_at_ns;
+};
+
+static int s_fire_count;
+static uint64_t s_now_ns;
+
+static void s_on_timer(struct aws_http_timer *timer, void *user_data) {
+    struct tester_timer *tester_timer = user_data;
+    AWS_FATAL_ASSERT(timer == &tester_timer->timer);
+    AWS_FATAL_ASSERT(!aws_http_timer_is_armed(timer));
+    tester_timer->fired_order = ++s_fire_count;
+    tester_timer->fired_at_ns = s_now_ns;
+
+    if (tester_timer->rearm_delay_ns) {
+        uint64_t delay_ns = tester_timer->rearm_delay_ns;
+        tester_timer->rearm_delay_ns = 0;
+        aws_http_timer_wheel_arm(tester_timer->wheel, timer, s_now_ns + delay_ns);
+    }
+}
+
+static void s_tester_timer_init(struct tester_timer *tester_timer, struct aws_http_timer_wheel *wheel) {
+    AWS_ZERO_STRUCT(*tester_timer);
+    tester_timer->wheel = wheel;
+    aws_http_timer_init(&tester_timer->timer, s_on_timer, tester_timer);
+}
+
+/* Advance the wheel one tick at a time, the way a busy event-loop would */
+static void s_advance_by_ticks(struct aws_http_timer_wheel *wheel, uint64_t ticks) {
+    for (uint64_t i = 0; i < ticks; ++i) {
+        s_now_ns += TICK_NS;
+        aws_http_timer_wheel_advance(wheel, s_now_ns);
+    }
+}
+
+static void s_wheel_init(struct aws_http_timer_wheel *wheel, uint64_t now_ns) {
+    s_fire_count = 0;
+    s_now_ns = now_ns;
+    aws_http_timer_wheel_init(wheel, now_ns);
+}
+
+static int s_timer_wheel_fires_in_order_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_http_timer_wheel wheel;
+    s_wheel_init(&wheel, 1000 * TICK_NS);
+    ASSERT_UINT_EQUALS(UINT64_MAX, aws_http_timer_wheel_next_run_ns(&wheel));
+
+    struct tester_timer timers[3];
+    const uint64_t delays_ticks[3] = {30, 5, 12};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(timers); ++i) {
+        s_tester_timer_init(&timers[i], &wheel);
+        aws_http_timer_wheel_arm(&wheel, &timers[i].timer, s_now_ns + delays_ticks[i] * TICK_NS);
+        ASSERT_TRUE(aws_http_timer_is_armed(&timers[i].timer));
+    }
+    ASSERT_UINT_EQUALS(s_now_ns + 5 * TICK_NS, aws_http_timer_wheel_next_run_ns(&wheel));
+
+    /* Nothing fires early */
+    s_advance_by_ticks(&wheel, 4);
+    ASSERT_INT_EQUALS(0, s_fire_count);
+
+    s_advance_by_ticks(&wheel, 26);
+    ASSERT_INT_EQUALS(3, s_fire_count);
+    ASSERT_INT_EQUALS(1, timers[1].fired_order);
+    ASSERT_INT_EQUALS(2, timers[2].fired_order);
+    ASSERT_INT_EQUALS(3, timers[0].fired_order);
+    ASSERT_UINT_EQUALS(1005 * TICK_NS, timers[1].fired_at_ns);
+    ASSERT_UINT_EQUALS(1012 * TICK_NS, timers[2].fired_at_ns);
+    ASSERT_UINT_EQUALS(1030 * TICK_NS, timers[0].fired_at_ns);
+
+    ASSERT_UINT_EQUALS(UINT64_MAX, aws_http_timer_wheel_next_run_ns(&wheel));
+    aws_http_timer_wheel_clean_up(&wheel);
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(timer_wheel_fires_in_order, s_timer_wheel_fires_in_order_fn)
+
+static int s_timer_wheel_cancel_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_http_timer_wheel wheel;
+    s_wheel_init(&wheel, 0);
+
+    struct tester_timer canceled;
+    struct tester_timer kept;
+    s_tester_timer_init(&canceled, &wheel);
+    s_tester_timer_init(&kept, &wheel);
+    aws_http_timer_wheel_arm(&wheel, &canceled.timer, 3 * TICK_NS);
+    aws_http_timer_wheel_arm(&wheel, &kept.timer, 3 * TICK_NS);
+
+    aws_http_timer_cancel(&canceled.timer);
+    ASSERT_FALSE(aws_http_timer_is_armed(&canceled.timer));
+    /* Canceling a timer that isn't armed is harmless */
+    aws_http_timer_cancel(&canceled.timer);
+
+    s_advance_by_ticks(&wheel, 10);
+    ASSERT_INT_EQUALS(0, canceled.fired_order);
+    ASSERT_INT_EQUALS(1, kept.fired_order);
+
+    /* Re-arming an armed timer moves it */
+    aws_http_timer_wheel_arm(&wheel, &canceled.timer, s_now_ns + 100 * TICK_NS);
+    aws_http_timer_wheel_arm(&wheel, &canceled.timer, s_now_ns + 2 * TICK_NS);
+    s_advance_by_ticks(&wheel, 2);
+    ASSERT_INT_EQUALS(2, canceled.fired_order);
+
+    /* Cleaning up disarms, without firing */
+    aws_http_timer_wheel_arm(&wheel, &kept.timer, s_now_ns + 2 * TICK_NS);
+    aws_http_timer_wheel_clean_up(&wheel);
+    ASSERT_FALSE(aws_http_timer_is_armed(&kept.timer));
+    ASSERT_INT_EQUALS(2, s_fire_count);
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(timer_wheel_cancel, s_timer_wheel_cancel_fn)
+
+/* Timers far enough out to start in a higher level must still fire on their exact tick */
+static int s_timer_wheel_cascade_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_http_timer_wheel wheel;
+    /* Start mid-slot, so expiries don't line up with slot boundaries */
+    s_wheel_init(&wheel, 12345 * TICK_NS);
+
+    const uint64_t delays_ticks[] = {63, 64, 65, 4095, 4096, 4097, 300000};
+    struct tester_timer timers[AWS_ARRAY_SIZE(delays_ticks)];
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(timers); ++i) {
+        s_tester_timer_init(&timers[i], &wheel);
+        aws_http_timer_wheel_arm(&wheel, &timers[i].timer, s_now_ns + delays_ticks[i] * TICK_NS);
+    }
+
+    const uint64_t start_ns = s_now_ns;
+    /* Jump straight to the end, to exercise skipping ticks with no work */
+    s_now_ns = start_ns + 300000 * TICK_NS;
+    aws_http_timer_wheel_advance(&wheel, s_now_ns);
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(timers); ++i) {
+        ASSERT_INT_EQUALS((int)i + 1, timers[i].fired_order);
+    }
+
+    /* Now step tick by tick and check each timer fires on its own tick */
+    s_wheel_init(&wheel, 12345 * TICK_NS);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(timers) - 1; ++i) {
+        s_tester_timer_init(&timers[i], &wheel);
+        aws_http_timer_wheel_arm(&wheel, &timers[i].timer, s_now_ns + delays_ticks[i] * TICK_NS);
+    }
+    s_advance_by_ticks(&wheel, 4097);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(timers) - 1; ++i) {
+        ASSERT_UINT_EQUALS(start_ns + delays_ticks[i] * TICK_NS, timers[i].fired_at_ns);
+    }
+
+    aws_http_timer_wheel_clean_up(&wheel);
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(timer_wheel_cascade, s_timer_wheel_cascade_fn)
+
+/* Timers beyond the top level wait in overflow, and are never fired early */
+static int s_timer_wheel_overflow_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_http_timer_wheel wheel;
+    s_wheel_init(&wheel, 7 * TICK_NS);
+
+    /* Levels cover 64^4 ticks, go a couple turns past that */
+    const uint64_t top_span_ticks = (uint64_t)1 << (AWS_HTTP_TIMER_WHEEL_SLOT_BITS * AWS_HTTP_TIMER_WHEEL_LEVELS);
+    const uint64_t delay_ticks = 2 * top_span_ticks + 3;
+
+    struct tester_timer timer;
+    s_tester_timer_init(&timer, &wheel);
+    aws_http_timer_wheel_arm(&wheel, &timer.timer, s_now_ns + delay_ticks * TICK_NS);
+    const uint64_t expiry_ns = s_now_ns + delay_ticks * TICK_NS;
+
+    /* Run the wheel each time it asks to be run, the way the event-loop task does */
+    while (timer.fired_order == 0) {
+        uint64_t next_run_ns = aws_http_timer_wheel_next_run_ns(&wheel);
+        ASSERT_TRUE(next_run_ns != UINT64_MAX);
+        ASSERT_TRUE(next_run_ns <= expiry_ns);
+        s_now_ns = aws_max_u64(s_now_ns, next_run_ns);
+        aws_http_timer_wheel_advance(&wheel, s_now_ns);
+    }
+    ASSERT_UINT_EQUALS(expiry_ns, timer.fired_at_ns);
+
+    aws_http_timer_wheel_clean_up(&wheel);
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(timer_wheel_overflow, s_timer_wheel_overflow_fn)
+
+static int s_timer_wheel_rearm_from_callback_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)allocator;
+    (void)ctx;
+
+    struct aws_http_timer_wheel wheel;
+    s_wheel_init(&wheel, 0);
+
+    struct tester_timer timer;
+    s_tester_timer_init(&timer, &wheel);
+    /* Re-arm with an expiry that's already due, it must wait for the next tick rather than fire again now */
+    timer.rearm_delay_ns = 1;
+    aws_http_timer_wheel_arm(&wheel, &timer.timer, 2 * TICK_NS);
+
+    s_advance_by_ticks(&wheel, 2);
+    ASSERT_INT_EQUALS(1, s_fire_count);
+    ASSERT_TRUE(aws_http_timer_is_armed(&timer.timer));
+
+    s_advance_by_ticks(&wheel, 1);
+    ASSERT_INT_EQUALS(2, s_fire_count);
+    ASSERT_FALSE(aws_http_timer_is_armed(&timer.timer));
+
+    aws_http_timer_wheel_clean_up(&wheel);
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(timer_wheel_rearm_from_callback, s_timer_wheel_rearm_from_callback_fn)
@@ -0,0 +1,184 @@
+/**
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ * SPDX-License-Identifier: Apache-2.0.
+ */
+
+#include <aws/http/private/connection_impl.h>
+#include <aws/http/private/traffic_capture.h>
+
+#include <aws/common/clock.h>
+#include <aws/common/file.h>
+#include <aws/common/string.h>
+#include <aws/common/uuid.h>
+#include <aws/http/request_response.h>
+#include <aws/testing/aws_test_harness.h>
+#include <aws/testing/io_testing_channel.h>
+
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#    pragma warning(disable : 4204) /* non-constant aggregate initializer */
+#endif
+
+static const char *s_request_str = "GET / HTTP/1.1\r\n"
+                                   "Host: example.com\r\n"
+                                   "\r\n";
+
+static const char *s_response_str = "HTTP/1.1 200 OK\r\n"
+                                    "Content-Length: 5\r\n"
+                                    "\r\n"
+                                    "hello";
+
+/* Create an empty directory with a unique name, so tests running at the same time don't collide */
+static struct aws_string *s_new_capture_directory(struct aws_allocator *allocator) {
+    struct aws_uuid uuid;
+    AWS_FATAL_ASSERT(aws_uuid_init(&uuid) == AWS_OP_SUCCESS);
+    uint8_t uuid_storage[AWS_UUID_STR_LEN];
+    struct aws_byte_buf uuid_buf = aws_byte_buf_from_empty_array(uuid_storage, sizeof(uuid_storage));
+    AWS_FATAL_ASSERT(aws_uuid_to_str(&uuid, &uuid_buf) == AWS_OP_SUCCESS);
+
+    char dir_name[64];
+    snprintf(dir_name, sizeof(dir_name), "traffic_capture_" PRInSTR, AWS_BYTE_BUF_PRI(uuid_buf));
+    struct aws_string *dir = aws_string_new_from_c_str(allocator, dir_name);
+    AWS_FATAL_ASSERT(aws_directory_create(dir) == AWS_OP_SUCCESS);
+    return dir;
+}
+
+/* Read the one file in the directory */
+static int s_read_only_file(struct aws_allocator *allocator, const struct aws_string *dir, struct aws_byte_buf *out) {
+    struct aws_directory_iterator *iterator = aws_directory_entry_iterator_new(allocator, dir);
+    ASSERT_NOT_NULL(iterator);
+    const struct aws_directory_entry *entry = aws_directory_entry_iterator_get_value(iterator);
+    ASSERT_NOT_NULL(entry);
+
+    struct aws_string *path = aws_string_new_from_cursor(allocator, &entry->path);
+    int err = aws_byte_buf_init_from_file(out, allocator, aws_string_c_str(path));
+    aws_string_destroy(path);
+    ASSERT_SUCCESS(err);
+
+    ASSERT_FAILS(aws_directory_entry_iterator_next(iterator));
+    aws_directory_entry_iterator_destroy(iterator);
+    return AWS_OP_SUCCESS;
+}
+
+/* Everything the connection sends and receives is recorded, in order, and still passes through untouched */
+static int s_traffic_capture_records_h1_client_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct aws_string *dir = s_new_capture_directory(allocator);
+    struct aws_http_traffic_capture_options capture_options = {
+        .directory = aws_byte_cursor_from_string(dir),
+    };
+
+    struct testing_channel testing_channel;
+    struct aws_testing_channel_options test_channel_options = {.clock_fn = aws_high_res_clock_get_ticks};
+    ASSERT_SUCCESS(testing_channel_init(&testing_channel, allocator, &test_channel_options));
+
+    struct aws_http1_connection_options http1_options;
+    AWS_ZERO_STRUCT(http1_options);
+    struct aws_http2_connection_options http2_options;
+    AWS_ZERO_STRUCT(http2_options);
+    struct aws_http_connection *connection = aws_http_connection_new_channel_handler(
+        allocator,
+        testing_channel.channel,
+        false /*is_server*/,
+        false /*is_using_tls*/,
+        false /*is_socket_channel*/,
+        false /*manual_window_management*/,
+        false /*prior_knowledge_http2*/,
+        SIZE_MAX,
+        NULL /*alpn_string_map*/,
+        &http1_options,
+        &http2_options,
+        &capture_options,
+        NULL /*connection_user_data*/);
+    ASSERT_NOT_NULL(connection);
+    testing_channel_drain_queued_tasks(&testing_channel);
+
+    /* Send a request, in a single message */
+    struct aws_http_header host = {
+        .name = aws_byte_cursor_from_c_str("Host"),
+        .value = aws_byte_cursor_from_c_str("example.com"),
+    };
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    ASSERT_SUCCESS(aws_http_message_set_request_method(request, aws_http_method_get));
+    ASSERT_SUCCESS(aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/")));
+    ASSERT_SUCCESS(aws_http_message_add_header(request, host));
+    struct aws_http_make_request_options request_options = {
+        .self_size = sizeof(request_options),
+        .request = request,
+    };
+    struct aws_http_stream *stream = aws_http_connection_make_request(connection, &request_options);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_SUCCESS(aws_http_stream_activate(stream));
+    testing_channel_drain_queued_tasks(&testing_channel);
+    ASSERT_SUCCESS(testing_channel_check_written_messages_str(&testing_channel, allocator, s_request_str));
+
+    /* Receive the response in two pieces, each is its own record */
+    ASSERT_SUCCESS(testing_channel_push_read_str(&testing_channel, "HTTP/1.1 200 OK\r\n"));
+    ASSERT_SUCCESS(testing_channel_push_read_str(&testing_channel, "Content-Length: 5\r\n\r\nhello"));
+    testing_channel_drain_queued_tasks(&testing_channel);
+    int status = 0;
+    ASSERT_SUCCESS(aws_http_stream_get_incoming_response_status(stream, &status));
+    ASSERT_INT_EQUALS(200, status);
+
+    aws_http_stream_release(stream);
+    aws_http_message_release(request);
+    aws_http_connection_release(connection);
+    /* The file is closed when the channel is destroyed */
+    ASSERT_SUCCESS(testing_channel_clean_up(&testing_channel));
+
+    struct aws_byte_buf file;
+    ASSERT_SUCCESS(s_read_only_file(allocator, dir, &file));
+    struct aws_byte_cursor input = aws_byte_cursor_from_buf(&file);
+
+    struct aws_http_traffic_capture_file_header header;
+    ASSERT_SUCCESS(aws_http_traffic_capture_read_file_header(&input, &header));
+    ASSERT_INT_EQUALS(AWS_HTTP_VERSION_1_1, header.http_version);
+    ASSERT_FALSE(header.is_server);
+
+    struct aws_byte_buf sent;
+    aws_byte_buf_init(&sent, allocator, 128);
+    struct aws_byte_buf received;
+    aws_byte_buf_init(&received, allocator, 128);
+    size_t inbound_count = 0;
+    uint64_t prev_timestamp_ns = 0;
+    while (input.len > 0) {
+        struct aws_http_traffic_capture_record record;
+        ASSERT_SUCCESS(aws_http_traffic_capture_read_record(&input, &record));
+        ASSERT_TRUE(record.timestamp_ns >= prev_timestamp_ns);
+        prev_timestamp_ns = record.timestamp_ns;
+
+        if (record.direction == AWS_HTTP_TRAFFIC_CAPTURE_INBOUND) {
+            inbound_count++;
+            ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&received, &record.data));
+        } else {
+            ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&sent, &record.data));
+        }
+    }
+    ASSERT_UINT_EQUALS(2, inbound_count);
+    ASSERT_BIN_ARRAYS_EQUALS(s_request_str, strlen(s_request_str), sent.buffer, sent.len);
+    ASSERT_BIN_ARRAYS_EQUALS(s_response_str, strlen(s_response_str), received.buffer, received.len);
+
+    /* A record cut short, as if the process died mid-write, is reported as such */
+    struct aws_byte_cursor truncated = aws_byte_cursor_from_buf(&file);
+    truncated.len -= 1;
+    ASSERT_SUCCESS(aws_http_traffic_capture_read_file_header(&truncated, &header));
+    int result = AWS_OP_SUCCESS;
+    while (result == AWS_OP_SUCCESS && truncated.len > 0) {
+        struct aws_http_traffic_capture_record record;
+        result = aws_http_traffic_capture_read_record(&truncated, &record);
+    }
+    ASSERT_INT_EQUALS(AWS_OP_ERR, result);
+    ASSERT_INT_EQUALS(AWS_ERROR_SHORT_BUFFER, aws_last_error());
+
+    aws_byte_buf_clean_up(&sent);
+    aws_byte_buf_clean_up(&received);
+    aws_byte_buf_clean_up(&file);
+    ASSERT_SUCCESS(aws_directory_delete(dir, true /*recursive*/));
+    aws_string_destroy(dir);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(traffic_capture_records_h1_client, s_traffic_capture_records_h1_client_fn)
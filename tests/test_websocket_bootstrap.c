@@ -115,6 +115,8 @@ static struct tester {
     const struct test_response *handshake_response;
     size_t num_handshake_response_headers;
 
+    const struct aws_websocket_permessage_deflate_options *permessage_deflate;
+
     /* State */
     bool http_connect_called_successfully;
 
@@ -135,6 +137,8 @@ static struct tester {
     bool http_stream_on_complete_invoked;
 
     bool websocket_new_called_successfully;
+    const struct aws_websocket_permessage_deflate_options *websocket_new_permessage_deflate;
+    struct aws_websocket_permessage_deflate_params websocket_new_permessage_deflate_params;
 
     bool http_stream_release_called;
     bool http_stream_activate_called_successfully;
@@ -372,6 +376,8 @@ static struct aws_websocket *s_mock_websocket_handler_new(const struct aws_webso
     }
 
     s_tester.websocket_new_called_successfully = true;
+    s_tester.websocket_new_permessage_deflate = options->permessage_deflate;
+    s_tester.websocket_new_permessage_deflate_params = options->permessage_deflate_params;
     return s_mock_websocket;
 }
 
@@ -474,6 +480,7 @@ static int s_drive_websocket_connect(int *out_error_code) {
         .user_data = &s_tester,
         .on_connection_setup = s_on_websocket_setup,
         .on_connection_shutdown = s_on_websocket_shutdown,
+        .permessage_deflate = s_tester.permessage_deflate,
     };
 
     int err = aws_websocket_client_connect(&ws_options);
@@ -944,7 +951,7 @@ TEST_CASE(websocket_boot_fail_from_unsupported_sec_websocket_extensions_in_respo
                     .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="),
                 },
                 {
-                    /* extensions are not currently supported */
+                    /* permessage-deflate was not offered */
                     .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Sec-WebSocket-Extensions"),
                     .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("permessage-deflate"),
                 },
@@ -953,6 +960,174 @@ TEST_CASE(websocket_boot_fail_from_unsupported_sec_websocket_extensions_in_respo
     return s_websocket_boot_fail_from_bad_101_response(allocator, &bad_response);
 }
 
+/* Stand-ins for the permessage-deflate codec factories. The mocked websocket never calls them. */
+static int s_unused_new_compressor(
+    struct aws_allocator *allocator,
+    uint8_t window_bits,
+    void *user_data,
+    struct aws_websocket_compressor **out_compressor) {
+
+    (void)allocator;
+    (void)window_bits;
+    (void)user_data;
+    (void)out_compressor;
+    return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+}
+
+static int s_unused_new_decompressor(
+    struct aws_allocator *allocator,
+    uint8_t window_bits,
+    void *user_data,
+    struct aws_websocket_decompressor **out_decompressor) {
+
+    (void)allocator;
+    (void)window_bits;
+    (void)user_data;
+    (void)out_decompressor;
+    return aws_raise_error(AWS_ERROR_UNSUPPORTED_OPERATION);
+}
+
+/* Test that permessage-deflate is offered in the request, and the server's answer is passed to the websocket */
+TEST_CASE(websocket_boot_ok_with_permessage_deflate) {
+    (void)ctx;
+    struct aws_websocket_permessage_deflate_options deflate_options = {
+        .server_max_window_bits = 12,
+        .new_compressor = s_unused_new_compressor,
+        .new_decompressor = s_unused_new_decompressor,
+    };
+    s_tester.permessage_deflate = &deflate_options;
+
+    struct test_response response = {
+        .status_code = 101,
+        .headers =
+            {
+                {
+                    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Upgrade"),
+                    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("websocket"),
+                },
+                {
+                    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Connection"),
+                    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Upgrade"),
+                },
+                {
+                    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Sec-WebSocket-Accept"),
+                    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="),
+                },
+                {
+                    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Sec-WebSocket-Extensions"),
+                    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(
+                        "permessage-deflate; server_max_window_bits=10; client_max_window_bits=9"),
+                },
+            },
+    };
+    s_tester.handshake_response = &response;
+
+    ASSERT_SUCCESS(s_tester_init(allocator));
+
+    int websocket_connect_error_code;
+    ASSERT_SUCCESS(s_drive_websocket_connect(&websocket_connect_error_code));
+    ASSERT_INT_EQUALS(0, websocket_connect_error_code);
+
+    /* Check the offer that went out in the request */
+    struct aws_byte_cursor offer;
+    ASSERT_SUCCESS(aws_http_headers_get(
+        aws_http_message_get_headers(s_tester.handshake_request),
+        aws_byte_cursor_from_c_str("Sec-WebSocket-Extensions"),
+        &offer));
+    const char *expected_offer = "permessage-deflate; server_max_window_bits=12; client_max_window_bits";
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&offer, expected_offer));
+
+    /* Check what the websocket was told to use */
+    ASSERT_NOT_NULL(s_tester.websocket_new_permessage_deflate);
+    ASSERT_UINT_EQUALS(10, s_tester.websocket_new_permessage_deflate_params.server_max_window_bits);
+    ASSERT_UINT_EQUALS(9, s_tester.websocket_new_permessage_deflate_params.client_max_window_bits);
+    ASSERT_FALSE(s_tester.websocket_new_permessage_deflate_params.server_no_context_takeover);
+    ASSERT_FALSE(s_tester.websocket_new_permessage_deflate_params.client_no_context_takeover);
+
+    ASSERT_SUCCESS(s_tester_clean_up());
+    return AWS_OP_SUCCESS;
+}
+
+/* The server may not raise server_max_window_bits above what the client offered */
+TEST_CASE(websocket_boot_fail_from_bad_permessage_deflate_response) {
+    (void)ctx;
+    struct aws_websocket_permessage_deflate_options deflate_options = {
+        .server_max_window_bits = 10,
+        .new_compressor = s_unused_new_compressor,
+        .new_decompressor = s_unused_new_decompressor,
+    };
+    s_tester.permessage_deflate = &deflate_options;
+
+    struct test_response bad_response = {
+        .status_code = 101,
+        .headers =
+            {
+                {
+                    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Upgrade"),
+                    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("websocket"),
+                },
+                {
+                    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Connection"),
+                    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Upgrade"),
+                },
+                {
+                    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Sec-WebSocket-Accept"),
+                    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="),
+                },
+                {
+                    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Sec-WebSocket-Extensions"),
+                    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("permessage-deflate; server_max_window_bits=15"),
+                },
+            },
+    };
+    return s_websocket_boot_fail_from_bad_101_response(allocator, &bad_response);
+}
+
+/* Test the server-side helper that answers a client's permessage-deflate offers */
+TEST_CASE(websocket_permessage_deflate_negotiate) {
+    (void)ctx;
+    aws_http_library_init(allocator);
+
+    struct aws_websocket_permessage_deflate_options server_options = {
+        .client_max_window_bits = 10,
+    };
+
+    struct aws_byte_buf response_value;
+    ASSERT_SUCCESS(aws_byte_buf_init(&response_value, allocator, 64));
+
+    /* Skip the unknown extension, the malformed offer, and the offer lacking client_max_window_bits */
+    struct aws_byte_cursor offers = aws_byte_cursor_from_c_str(
+        "x-webkit-deflate-frame, "
+        "permessage-deflate; server_max_window_bits=99, "
+        "permessage-deflate; server_no_context_takeover, "
+        "permessage-deflate; server_max_window_bits=12; client_max_window_bits");
+
+    struct aws_websocket_permessage_deflate_params params;
+    bool accepted;
+    ASSERT_SUCCESS(aws_websocket_permessage_deflate_negotiate(
+        &server_options, offers, &params, &response_value, &accepted));
+    ASSERT_TRUE(accepted);
+    ASSERT_UINT_EQUALS(12, params.server_max_window_bits);
+    ASSERT_UINT_EQUALS(10, params.client_max_window_bits);
+    ASSERT_FALSE(params.server_no_context_takeover);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        "permessage-deflate; server_max_window_bits=12; client_max_window_bits=10",
+        strlen("permessage-deflate; server_max_window_bits=12; client_max_window_bits=10"),
+        response_value.buffer,
+        response_value.len);
+
+    /* Nothing acceptable */
+    aws_byte_buf_reset(&response_value, false);
+    ASSERT_SUCCESS(aws_websocket_permessage_deflate_negotiate(
+        &server_options, aws_byte_cursor_from_c_str("permessage-deflate"), &params, &response_value, &accepted));
+    ASSERT_FALSE(accepted);
+    ASSERT_UINT_EQUALS(0, response_value.len);
+
+    aws_byte_buf_clean_up(&response_value);
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
 /* If client requests a specific protocol, the server response must say it's being used */
 TEST_CASE(websocket_boot_ok_with_sec_websocket_protocol_header) {
     (void)ctx;
@@ -4,6 +4,7 @@
  */
 
 #include <aws/http/private/websocket_decoder.h>
+#include <aws/http/private/websocket_deflate.h>
 
 #include <aws/io/logging.h>
 #include <aws/testing/aws_test_harness.h>
@@ -866,6 +867,200 @@ DECODER_TEST_CASE(websocket_decoder_fail_on_fragmented_bad_utf8_text) {
     return AWS_OP_SUCCESS;
 }
 
+/* Check the validator's ASCII fast-path and bytewise paths, with tricky sequences
+ * placed around SIMD block boundaries, and the text split in two at every position */
+DECODER_TEST_CASE(websocket_utf8_validator) {
+    (void)ctx;
+    (void)allocator;
+
+    const struct {
+        const char *sequence;
+        bool valid;
+    } test_cases[] = {
+        {"", true},
+        {"\x7F", true},
+        {"\xC2\x80", true},             /* U+0080 */
+        {"\xDF\xBF", true},             /* U+07FF */
+        {"\xE0\xA0\x80", true},         /* U+0800 */
+        {"\xED\x9F\xBF", true},         /* U+D7FF */
+        {"\xEE\x80\x80", true},         /* U+E000 */
+        {"\xF0\x90\x8D\x88", true},     /* U+10348 */
+        {"\xF4\x8F\xBF\xBF", true},     /* U+10FFFF */
+        {"\x80", false},                /* stray continuation byte */
+        {"\xC0\xAF", false},            /* overlong */
+        {"\xC1\xBF", false},            /* overlong */
+        {"\xE0\x9F\xBF", false},        /* overlong */
+        {"\xED\xA0\x80", false},        /* surrogate */
+        {"\xF0\x8F\xBF\xBF", false},    /* overlong */
+        {"\xF4\x90\x80\x80", false},    /* above U+10FFFF */
+        {"\xF5\x80\x80\x80", false},    /* invalid lead byte */
+        {"\xFF", false},                /* invalid lead byte */
+        {"\xE2\x82", false},            /* truncated */
+        {"\xF0\x90\x8D", false},        /* truncated */
+        {"\xC3\xA9\xC3", false},        /* valid, then truncated */
+    };
+
+    uint8_t text[128];
+    for (size_t case_i = 0; case_i < AWS_ARRAY_SIZE(test_cases); ++case_i) {
+        const struct aws_byte_cursor sequence = aws_byte_cursor_from_c_str(test_cases[case_i].sequence);
+
+        /* Surround the sequence with ASCII, so it lands in different spots within a block */
+        for (size_t prefix_len = 0; prefix_len < 70; prefix_len += 1 + (prefix_len / 16)) {
+            const size_t text_len = prefix_len + sequence.len + 40;
+            memset(text, 'a', text_len);
+            memcpy(text + prefix_len, sequence.ptr, sequence.len);
+
+            for (size_t split = 0; split <= text_len; ++split) {
+                struct aws_websocket_utf8_validator validator;
+                aws_websocket_utf8_validator_reset(&validator);
+
+                struct aws_byte_cursor first = aws_byte_cursor_from_array(text, split);
+                struct aws_byte_cursor second = aws_byte_cursor_from_array(text + split, text_len - split);
+                bool is_valid = aws_websocket_utf8_validator_update(&validator, first) == AWS_OP_SUCCESS &&
+                                aws_websocket_utf8_validator_update(&validator, second) == AWS_OP_SUCCESS &&
+                                aws_websocket_utf8_validator_finalize(&validator) == AWS_OP_SUCCESS;
+
+                ASSERT_TRUE(test_cases[case_i].valid == is_valid);
+            }
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* Fake decompressor for permessage-deflate tests.
+ * It passes data through unchanged, and swallows the 4-byte tail that the decoder appends to each message. */
+struct fake_decompressor {
+    struct aws_websocket_decompressor base;
+    size_t reset_count;
+};
+
+static int s_fake_decompress(
+    struct aws_websocket_decompressor *decompressor,
+    struct aws_byte_cursor *input,
+    struct aws_byte_buf *output) {
+
+    (void)decompressor;
+    struct aws_byte_cursor tail =
+        aws_byte_cursor_from_array(aws_websocket_deflate_tail, sizeof(aws_websocket_deflate_tail));
+    if (aws_byte_cursor_eq(input, &tail)) {
+        aws_byte_cursor_advance(input, input->len);
+        return AWS_OP_SUCCESS;
+    }
+
+    aws_byte_buf_write_to_capacity(output, input);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_fake_decompressor_reset(struct aws_websocket_decompressor *decompressor) {
+    struct fake_decompressor *fake = decompressor->impl;
+    fake->reset_count++;
+    return AWS_OP_SUCCESS;
+}
+
+static void s_fake_decompressor_destroy(struct aws_websocket_decompressor *decompressor) {
+    (void)decompressor;
+}
+
+static struct aws_websocket_decompressor_vtable s_fake_decompressor_vtable = {
+    .decompress = s_fake_decompress,
+    .reset = s_fake_decompressor_reset,
+    .destroy = s_fake_decompressor_destroy,
+};
+
+static void s_fake_decompressor_init(struct fake_decompressor *fake) {
+    AWS_ZERO_STRUCT(*fake);
+    fake->base.vtable = &s_fake_decompressor_vtable;
+    fake->base.impl = fake;
+}
+
+/* Test that a compressed message (RSV1 set on its first frame) is run through the decompressor */
+DECODER_TEST_CASE(websocket_decoder_permessage_deflate) {
+    (void)ctx;
+    struct decoder_tester tester;
+    ASSERT_SUCCESS(s_decoder_tester_init(&tester, allocator));
+
+    struct fake_decompressor decompressor;
+    s_fake_decompressor_init(&decompressor);
+    aws_websocket_decoder_set_decompressor(&tester.decoder, &decompressor.base, true /*reset_after_message*/);
+
+    uint8_t input[] = {
+        /* TEXT FRAME, compressed */
+        0x41, /* fin | rsv1 | rsv2 | rsv3 | 4bit opcode */
+        0x02, /* mask | 7bit payload len */
+        /* payload */
+        'h',
+        'i',
+
+        /* CONTINUATION FRAME - RSV1 is only set on the first frame of a message */
+        0x80, /* fin | rsv1 | rsv2 | rsv3 | 4bit opcode */
+        0x01, /* mask | 7bit payload len */
+        /* payload */
+        '!',
+    };
+
+    bool frame_complete;
+    struct aws_byte_cursor input_cursor = aws_byte_cursor_from_array(input, sizeof(input));
+
+    ASSERT_SUCCESS(aws_websocket_decoder_process(&tester.decoder, &input_cursor, &frame_complete));
+    ASSERT_TRUE(frame_complete);
+    ASSERT_TRUE(tester.frame.rsv[0]);
+    ASSERT_UINT_EQUALS(0, decompressor.reset_count);
+
+    ASSERT_SUCCESS(aws_websocket_decoder_process(&tester.decoder, &input_cursor, &frame_complete));
+    ASSERT_TRUE(frame_complete);
+    ASSERT_UINT_EQUALS(0, input_cursor.len);
+
+    ASSERT_BIN_ARRAYS_EQUALS("hi!", 3, tester.payload.buffer, tester.payload.len);
+
+    /* Context is reset once the message is complete */
+    ASSERT_UINT_EQUALS(1, decompressor.reset_count);
+
+    ASSERT_SUCCESS(s_decoder_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* Test that RSV1 is rejected on frames other than the first frame of a TEXT or BINARY message */
+DECODER_TEST_CASE(websocket_decoder_fail_on_misplaced_rsv1_with_permessage_deflate) {
+    (void)ctx;
+    struct decoder_tester tester;
+    ASSERT_SUCCESS(s_decoder_tester_init(&tester, allocator));
+
+    uint8_t bad_first_bytes[] = {
+        0xC9, /* PING with RSV1 */
+        0xC0, /* CONTINUATION with RSV1 */
+    };
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(bad_first_bytes); ++i) {
+        s_decoder_tester_reset(&tester);
+
+        struct fake_decompressor decompressor;
+        s_fake_decompressor_init(&decompressor);
+        aws_websocket_decoder_set_decompressor(&tester.decoder, &decompressor.base, false /*reset_after_message*/);
+
+        uint8_t input[] = {
+            /* BINARY FRAME, compressed, not fin */
+            0x42, /* fin | rsv1 | rsv2 | rsv3 | 4bit opcode */
+            0x00, /* mask | 7bit payload len */
+
+            bad_first_bytes[i],
+            0x00, /* mask | 7bit payload len */
+        };
+
+        bool frame_complete;
+        struct aws_byte_cursor input_cursor = aws_byte_cursor_from_array(input, sizeof(input));
+
+        ASSERT_SUCCESS(aws_websocket_decoder_process(&tester.decoder, &input_cursor, &frame_complete));
+        ASSERT_TRUE(frame_complete);
+
+        ASSERT_FAILS(aws_websocket_decoder_process(&tester.decoder, &input_cursor, &frame_complete));
+        ASSERT_INT_EQUALS(AWS_ERROR_HTTP_WEBSOCKET_PROTOCOL_ERROR, aws_last_error());
+    }
+
+    ASSERT_SUCCESS(s_decoder_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
 /* Test that an error from the on_frame callback fails the decoder */
 DECODER_TEST_CASE(websocket_decoder_on_frame_callback_can_fail_decoder) {
     (void)ctx;
@@ -254,6 +254,41 @@ ENCODER_TEST_CASE(websocket_encoder_masking) {
     return AWS_OP_SUCCESS;
 }
 
+/* Check the vectorized masking against the simple 1-byte-at-a-time algorithm,
+ * with every combination of alignment, length, and starting mask offset */
+ENCODER_TEST_CASE(websocket_mask_payload_matches_bytewise) {
+    (void)ctx;
+    (void)allocator;
+    const uint8_t masking_key[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+    uint8_t original[200];
+    for (size_t i = 0; i < sizeof(original); ++i) {
+        original[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    uint8_t actual[sizeof(original)];
+    uint8_t expected[sizeof(original)];
+
+    for (size_t align = 0; align < 16; ++align) {
+        for (size_t len = 0; len <= sizeof(original) - align; len += 1 + (len / 16)) {
+            for (uint64_t mask_offset = 0; mask_offset < 5; ++mask_offset) {
+                memcpy(actual, original, sizeof(original));
+                memcpy(expected, original, sizeof(original));
+
+                for (size_t i = 0; i < len; ++i) {
+                    expected[align + i] ^= masking_key[(mask_offset + i) % 4];
+                }
+
+                aws_websocket_mask_payload(aws_byte_cursor_from_array(actual + align, len), masking_key, mask_offset);
+
+                ASSERT_BIN_ARRAYS_EQUALS(expected, sizeof(expected), actual, sizeof(actual));
+            }
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 ENCODER_TEST_CASE(websocket_encoder_extended_length) {
     (void)ctx;
     struct encoder_tester tester;
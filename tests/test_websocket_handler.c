@@ -5,6 +5,7 @@
 
 #include <aws/http/private/websocket_impl.h>
 
+#include <aws/common/thread.h>
 #include <aws/http/private/websocket_decoder.h>
 #include <aws/http/private/websocket_encoder.h>
 #include <aws/io/logging.h>
@@ -39,6 +40,13 @@ struct incoming_frame {
 
 static struct tester_options {
     bool manual_window_update;
+    size_t write_batch_target_size;
+    uint32_t write_batch_max_delay_ms;
+    bool deliver_whole_messages;
+    size_t max_incoming_message_size;
+    size_t read_budget;
+    struct aws_websocket_read_budget *shared_read_budget;
+    bool is_server;
 } s_tester_options;
 
 struct tester {
@@ -52,6 +60,10 @@ struct tester {
 
     size_t on_send_complete_count;
 
+    /* Reported by the on_outgoing_frames_complete callback */
+    size_t num_outgoing_batches;
+    size_t num_outgoing_batched_frames;
+
     /* To make the written output of the websocket-handler easier to check,
      * we translate the written bytes back into `written_frames` using a websocket-decoder.
      * We're not testing the decoder here, just using it as a tool (decoder tests go in test_websocket_decoder.c). */
@@ -67,6 +79,10 @@ struct tester {
     size_t fail_on_incoming_frame_payload_n;  /* If set, return false on Nth incoming_frame_payload callback */
     size_t fail_on_incoming_frame_complete_n; /* If set, return false on Nth incoming_frame_complete callback */
 
+    /* Messages reported via the on_incoming_message callback, the tester holds a reference to each */
+    struct aws_websocket_incoming_message *incoming_messages[10];
+    size_t num_incoming_messages;
+
     /* For pushing messages downstream, to be read by websocket handler.
      * readpush_frame is for tests to define websocket frames to be pushed downstream.
      * An encoder is used to turn these into proper bits */
@@ -256,7 +272,10 @@ static bool s_on_incoming_frame_complete(
 
     incoming_frame->is_complete = true;
     incoming_frame->on_complete_error_code = error_code;
-    if (error_code == AWS_ERROR_SUCCESS) {
+
+    /* Data frame payload isn't reported frame-by-frame when whole messages are delivered */
+    bool expect_payload = !s_tester_options.deliver_whole_messages || !aws_websocket_is_data_frame(frame->opcode);
+    if (error_code == AWS_ERROR_SUCCESS && expect_payload) {
         AWS_FATAL_ASSERT(incoming_frame->payload.len == incoming_frame->def.payload_length);
     }
 
@@ -270,6 +289,18 @@ static bool s_on_incoming_frame_complete(
     return true;
 }
 
+static bool s_on_incoming_message(
+    struct aws_websocket *websocket,
+    struct aws_websocket_incoming_message *message,
+    void *user_data) {
+
+    (void)websocket;
+    struct tester *tester = user_data;
+    AWS_FATAL_ASSERT(tester->num_incoming_messages < AWS_ARRAY_SIZE(tester->incoming_messages));
+    tester->incoming_messages[tester->num_incoming_messages++] = aws_websocket_incoming_message_acquire(message);
+    return true;
+}
+
 static void s_set_readpush_frames(struct tester *tester, struct readpush_frame *frames, size_t num_frames) {
     tester->readpush_frames = frames;
     tester->num_readpush_frames = num_frames;
@@ -462,6 +493,21 @@ static int s_writepush_check(struct tester *tester, size_t ignore_n_written_fram
     return AWS_OP_SUCCESS;
 }
 
+static void s_on_outgoing_frames_complete(
+    struct aws_websocket *websocket,
+    size_t num_frames,
+    int error_code,
+    void *user_data) {
+
+    struct tester *tester = user_data;
+    AWS_FATAL_ASSERT(websocket == tester->websocket);
+    AWS_FATAL_ASSERT(num_frames > 0);
+    (void)error_code;
+
+    tester->num_outgoing_batches++;
+    tester->num_outgoing_batched_frames += num_frames;
+}
+
 static int s_tester_init(struct tester *tester, struct aws_allocator *alloc) {
     aws_http_library_init(alloc);
 
@@ -487,6 +533,14 @@ static int s_tester_init(struct tester *tester, struct aws_allocator *alloc) {
         .on_incoming_frame_payload = s_on_incoming_frame_payload,
         .on_incoming_frame_complete = s_on_incoming_frame_complete,
         .manual_window_update = s_tester_options.manual_window_update,
+        .write_batch_target_size = s_tester_options.write_batch_target_size,
+        .write_batch_max_delay_ms = s_tester_options.write_batch_max_delay_ms,
+        .on_outgoing_frames_complete = s_on_outgoing_frames_complete,
+        .on_incoming_message = s_tester_options.deliver_whole_messages ? s_on_incoming_message : NULL,
+        .max_incoming_message_size = s_tester_options.max_incoming_message_size,
+        .read_budget = s_tester_options.read_budget,
+        .shared_read_budget = s_tester_options.shared_read_budget,
+        .is_server = s_tester_options.is_server,
     };
     tester->websocket = aws_websocket_handler_new(&ws_options);
     ASSERT_NOT_NULL(tester->websocket);
@@ -513,6 +567,11 @@ static int s_tester_clean_up(struct tester *tester) {
         aws_byte_buf_clean_up(&tester->incoming_frames[i].payload);
     }
 
+    /* Messages may outlive the websocket */
+    for (size_t i = 0; i < tester->num_incoming_messages; ++i) {
+        aws_websocket_incoming_message_release(tester->incoming_messages[i]);
+    }
+
     aws_byte_buf_clean_up(&tester->all_writepush_data);
 
     aws_websocket_decoder_clean_up(&tester->written_frame_decoder);
@@ -1146,6 +1205,176 @@ TEST_CASE(websocket_handler_delayed_write_completion) {
     return AWS_OP_SUCCESS;
 }
 
+/* Test that with write batching, frames sent at different times are held and go out together in one message */
+TEST_CASE(websocket_handler_send_write_batching) {
+    (void)ctx;
+    s_tester_options.write_batch_target_size = SIZE_MAX;
+    s_tester_options.write_batch_max_delay_ms = 60000;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    struct send_tester sending[] = {
+        {
+            .payload = aws_byte_cursor_from_c_str("bitter"),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_TEXT,
+                    .fin = true,
+                },
+        },
+        {
+            .payload = aws_byte_cursor_from_c_str("butter"),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_TEXT,
+                    .fin = true,
+                },
+        },
+        {
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_CLOSE,
+                    .fin = true,
+                },
+        },
+    };
+
+    /* The data frames are held, waiting for more frames to fill the message */
+    for (size_t i = 0; i < 2; ++i) {
+        ASSERT_SUCCESS(s_send_frame(&tester, &sending[i]));
+        ASSERT_SUCCESS(s_drain_written_messages(&tester));
+        ASSERT_UINT_EQUALS(0, tester.num_written_io_messages);
+    }
+
+    /* A CLOSE frame is never held back */
+    ASSERT_SUCCESS(s_send_frame(&tester, &sending[2]));
+    ASSERT_SUCCESS(s_drain_written_messages(&tester));
+
+    ASSERT_UINT_EQUALS(1, tester.num_written_io_messages);
+    ASSERT_UINT_EQUALS(3, tester.num_written_frames);
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(sending); ++i) {
+        ASSERT_SUCCESS(s_check_written_message(&sending[i], i));
+    }
+
+    /* Completion was reported once for the whole batch */
+    ASSERT_UINT_EQUALS(1, tester.num_outgoing_batches);
+    ASSERT_UINT_EQUALS(3, tester.num_outgoing_batched_frames);
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* Test that a message held for batching is sent once the max delay passes */
+TEST_CASE(websocket_handler_send_write_batching_max_delay) {
+    (void)ctx;
+    s_tester_options.write_batch_target_size = SIZE_MAX;
+    s_tester_options.write_batch_max_delay_ms = 1;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    struct send_tester sending = {
+        .payload = aws_byte_cursor_from_c_str("bitter butter."),
+        .def =
+            {
+                .opcode = AWS_WEBSOCKET_OPCODE_BINARY,
+                .fin = true,
+            },
+    };
+    ASSERT_SUCCESS(s_send_frame(&tester, &sending));
+
+    /* Keep running the channel until the deadline passes and the message goes out */
+    while (tester.num_written_io_messages == 0) {
+        ASSERT_SUCCESS(s_drain_written_messages(&tester));
+        aws_thread_current_sleep(1000000 /*1ms*/);
+    }
+
+    ASSERT_UINT_EQUALS(1, tester.num_written_frames);
+    ASSERT_SUCCESS(s_check_written_message(&sending, 0));
+    ASSERT_UINT_EQUALS(1, tester.num_outgoing_batches);
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_encoded_frame_complete(struct aws_websocket *websocket, int error_code, void *user_data) {
+    (void)websocket;
+    AWS_FATAL_ASSERT(error_code == AWS_ERROR_SUCCESS);
+    size_t *complete_count = user_data;
+    (*complete_count)++;
+}
+
+/* A pre-encoded frame can be sent any number of times, and each goes out unmasked, as a server's frames must */
+TEST_CASE(websocket_handler_send_encoded_frame) {
+    (void)ctx;
+    s_tester_options.is_server = true;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("Wee Willie Winkie runs through the town.");
+    struct aws_websocket_encoded_frame *encoded_frame =
+        aws_websocket_encoded_frame_new(allocator, AWS_WEBSOCKET_OPCODE_TEXT, payload);
+    ASSERT_NOT_NULL(encoded_frame);
+
+    size_t complete_count = 0;
+    struct aws_websocket_send_encoded_frame_options options = {
+        .encoded_frame = encoded_frame,
+        .user_data = &complete_count,
+        .on_complete = s_on_encoded_frame_complete,
+    };
+    ASSERT_SUCCESS(aws_websocket_send_encoded_frame(tester.websocket, &options));
+
+    /* Broadcast to the same websocket twice, since the tester only has one */
+    struct aws_websocket *websockets[] = {tester.websocket, tester.websocket};
+    ASSERT_UINT_EQUALS(2, aws_websocket_broadcast_encoded_frame(websockets, AWS_ARRAY_SIZE(websockets), &options));
+
+    /* Each send holds its own reference */
+    aws_websocket_encoded_frame_release(encoded_frame);
+
+    ASSERT_SUCCESS(s_drain_written_messages(&tester));
+    ASSERT_UINT_EQUALS(3, complete_count);
+    ASSERT_UINT_EQUALS(3, tester.num_written_frames);
+    for (size_t i = 0; i < 3; ++i) {
+        struct written_frame *written = &tester.written_frames[i];
+        ASSERT_TRUE(written->is_complete);
+        ASSERT_UINT_EQUALS(AWS_WEBSOCKET_OPCODE_TEXT, written->def.opcode);
+        ASSERT_TRUE(written->def.fin);
+        ASSERT_FALSE(written->def.masked);
+        ASSERT_TRUE(aws_byte_cursor_eq_byte_buf(&payload, &written->payload));
+    }
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+/* Clients must mask each frame with a fresh key, so they can't send pre-encoded frames */
+TEST_CASE(websocket_handler_send_encoded_frame_requires_server) {
+    (void)ctx;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    struct aws_websocket_encoded_frame *encoded_frame =
+        aws_websocket_encoded_frame_new(allocator, AWS_WEBSOCKET_OPCODE_PING, aws_byte_cursor_from_c_str("ping"));
+    ASSERT_NOT_NULL(encoded_frame);
+
+    struct aws_websocket_send_encoded_frame_options options = {.encoded_frame = encoded_frame};
+    ASSERT_FAILS(aws_websocket_send_encoded_frame(tester.websocket, &options));
+    ASSERT_INT_EQUALS(AWS_ERROR_UNSUPPORTED_OPERATION, aws_last_error());
+    ASSERT_UINT_EQUALS(0, aws_websocket_broadcast_encoded_frame(&tester.websocket, 1, &options));
+    aws_websocket_encoded_frame_release(encoded_frame);
+
+    /* A whole message can't be a CONTINUATION, and control frames' payloads are limited to 125 bytes */
+    ASSERT_NULL(aws_websocket_encoded_frame_new(
+        allocator, AWS_WEBSOCKET_OPCODE_CONTINUATION, aws_byte_cursor_from_c_str("continuation")));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+    uint8_t big_payload[126] = {0};
+    ASSERT_NULL(aws_websocket_encoded_frame_new(
+        allocator, AWS_WEBSOCKET_OPCODE_PING, aws_byte_cursor_from_array(big_payload, sizeof(big_payload))));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
 TEST_CASE(websocket_handler_send_halts_if_payload_fn_returns_false) {
     (void)ctx;
     struct tester tester;
@@ -1657,6 +1886,121 @@ TEST_CASE(websocket_handler_read_halts_if_complete_fn_returns_false) {
     return AWS_OP_SUCCESS;
 }
 
+TEST_CASE(websocket_handler_read_whole_messages) {
+    (void)ctx;
+    s_tester_options.deliver_whole_messages = true;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    struct readpush_frame pushing[] = {
+        {
+            .payload = aws_byte_cursor_from_c_str("Hello, "),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_TEXT,
+                },
+        },
+        {
+            .payload = aws_byte_cursor_from_c_str("ping"),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_PING,
+                    .fin = true,
+                },
+        },
+        {
+            .payload = aws_byte_cursor_from_c_str("World"),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_CONTINUATION,
+                },
+        },
+        {
+            .payload = aws_byte_cursor_from_c_str("!"),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_CONTINUATION,
+                    .fin = true,
+                },
+        },
+        {
+            .payload = aws_byte_cursor_from_c_str("unfragmented"),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_BINARY,
+                    .fin = true,
+                },
+        },
+    };
+
+    s_set_readpush_frames(&tester, pushing, AWS_ARRAY_SIZE(pushing));
+    ASSERT_SUCCESS(s_do_readpush_all(&tester));
+    ASSERT_SUCCESS(s_drain_written_messages(&tester));
+
+    /* Every frame still begins and completes */
+    ASSERT_UINT_EQUALS(AWS_ARRAY_SIZE(pushing), tester.num_incoming_frames);
+
+    /* Control frame payload is still reported frame-by-frame, data frame payload isn't */
+    ASSERT_UINT_EQUALS(0, tester.incoming_frames[0].on_payload_count);
+    ASSERT_TRUE(aws_byte_buf_eq_c_str(&tester.incoming_frames[1].payload, "ping"));
+
+    ASSERT_UINT_EQUALS(2, tester.num_incoming_messages);
+    ASSERT_UINT_EQUALS(
+        AWS_WEBSOCKET_OPCODE_TEXT, aws_websocket_incoming_message_get_opcode(tester.incoming_messages[0]));
+    struct aws_byte_cursor payload = aws_websocket_incoming_message_get_payload(tester.incoming_messages[0]);
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&payload, "Hello, World!"));
+
+    ASSERT_UINT_EQUALS(
+        AWS_WEBSOCKET_OPCODE_BINARY, aws_websocket_incoming_message_get_opcode(tester.incoming_messages[1]));
+    payload = aws_websocket_incoming_message_get_payload(tester.incoming_messages[1]);
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&payload, "unfragmented"));
+
+    /* Messages remain valid after the websocket is gone */
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(websocket_handler_read_message_too_big) {
+    (void)ctx;
+    s_tester_options.deliver_whole_messages = true;
+    s_tester_options.max_incoming_message_size = 8;
+    struct tester tester;
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    struct readpush_frame pushing[] = {
+        {
+            .payload = aws_byte_cursor_from_c_str("12345"),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_TEXT,
+                },
+        },
+        {
+            .payload = aws_byte_cursor_from_c_str("6789"),
+            .def =
+                {
+                    .opcode = AWS_WEBSOCKET_OPCODE_CONTINUATION,
+                    .fin = true,
+                },
+        },
+    };
+
+    s_set_readpush_frames(&tester, pushing, AWS_ARRAY_SIZE(pushing));
+    ASSERT_SUCCESS(s_do_readpush_all(&tester));
+    ASSERT_SUCCESS(s_drain_written_messages(&tester));
+
+    /* The frame that pushed the message over the max fails, and the message is never delivered */
+    ASSERT_UINT_EQUALS(2, tester.num_incoming_frames);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, tester.incoming_frames[0].on_complete_error_code);
+    ASSERT_INT_EQUALS(AWS_ERROR_HTTP_WEBSOCKET_MESSAGE_TOO_BIG, tester.incoming_frames[1].on_complete_error_code);
+    ASSERT_UINT_EQUALS(0, tester.num_incoming_messages);
+
+    ASSERT_TRUE(testing_channel_is_shutdown_completed(&tester.testing_channel));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    return AWS_OP_SUCCESS;
+}
+
 static int s_window_manual_increment_common(struct aws_allocator *allocator, bool on_thread) {
     struct tester tester;
     s_tester_options.manual_window_update = true;
@@ -1719,6 +2063,97 @@ TEST_CASE(websocket_handler_window_manual_increment_off_thread) {
     return s_window_manual_increment_common(allocator, false);
 }
 
+static int s_window_read_budget_common(struct aws_allocator *allocator, bool shared) {
+    struct tester tester;
+    s_tester_options.deliver_whole_messages = true;
+    if (shared) {
+        s_tester_options.shared_read_budget = aws_websocket_read_budget_new(allocator, 1);
+        ASSERT_NOT_NULL(s_tester_options.shared_read_budget);
+    } else {
+        s_tester_options.read_budget = 1;
+    }
+    ASSERT_SUCCESS(s_tester_init(&tester, allocator));
+
+    struct readpush_frame pushing = {
+        .payload = aws_byte_cursor_from_c_str("Hold onto this"),
+        .def =
+            {
+                .opcode = AWS_WEBSOCKET_OPCODE_TEXT,
+                .fin = true,
+            },
+    };
+
+    /* Nothing is held yet, so the window re-opens fully */
+    s_set_readpush_frames(&tester, &pushing, 1);
+    uint64_t frame_minus_payload_size = aws_websocket_frame_encoded_size(&pushing.def) - pushing.def.payload_length;
+    ASSERT_SUCCESS(s_do_readpush_all(&tester));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_UINT_EQUALS(1, tester.num_incoming_messages);
+    ASSERT_UINT_EQUALS(
+        aws_websocket_frame_encoded_size(&pushing.def), testing_channel_last_window_update(&tester.testing_channel));
+
+    /* The tester still holds the 1st message, which is over budget, so the window shrinks */
+    s_set_readpush_frames(&tester, &pushing, 1);
+    ASSERT_SUCCESS(s_do_readpush_all(&tester));
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_UINT_EQUALS(2, tester.num_incoming_messages);
+    ASSERT_UINT_EQUALS(frame_minus_payload_size, testing_channel_last_window_update(&tester.testing_channel));
+
+    /* Still over budget while the 2nd message is held */
+    aws_websocket_incoming_message_release(tester.incoming_messages[0]);
+    tester.incoming_messages[0] = NULL;
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_UINT_EQUALS(frame_minus_payload_size, testing_channel_last_window_update(&tester.testing_channel));
+
+    /* Releasing the last message re-opens the window by the throttled amount, from another thread */
+    testing_channel_set_is_on_users_thread(&tester.testing_channel, false);
+    aws_websocket_incoming_message_release(tester.incoming_messages[1]);
+    tester.incoming_messages[1] = NULL;
+    testing_channel_set_is_on_users_thread(&tester.testing_channel, true);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_UINT_EQUALS(pushing.def.payload_length, testing_channel_last_window_update(&tester.testing_channel));
+
+    /* Manual increments are ignored, the window is managed automatically */
+    aws_websocket_increment_read_window(tester.websocket, 100);
+    testing_channel_drain_queued_tasks(&tester.testing_channel);
+    ASSERT_UINT_EQUALS(pushing.def.payload_length, testing_channel_last_window_update(&tester.testing_channel));
+
+    ASSERT_SUCCESS(s_tester_clean_up(&tester));
+    aws_websocket_read_budget_release(s_tester_options.shared_read_budget);
+    return AWS_OP_SUCCESS;
+}
+
+TEST_CASE(websocket_handler_window_read_budget) {
+    (void)ctx;
+    return s_window_read_budget_common(allocator, false /*shared*/);
+}
+
+TEST_CASE(websocket_handler_window_shared_read_budget) {
+    (void)ctx;
+    return s_window_read_budget_common(allocator, true /*shared*/);
+}
+
+TEST_CASE(websocket_handler_read_budget_requires_whole_messages) {
+    (void)ctx;
+    struct testing_channel testing_channel;
+    struct aws_testing_channel_options test_channel_options = {.clock_fn = aws_high_res_clock_get_ticks};
+    aws_http_library_init(allocator);
+    ASSERT_SUCCESS(testing_channel_init(&testing_channel, allocator, &test_channel_options));
+
+    struct aws_websocket_handler_options ws_options = {
+        .allocator = allocator,
+        .channel = testing_channel.channel,
+        .initial_window_size = s_default_initial_window_size,
+        .read_budget = 1024,
+    };
+    ASSERT_NULL(aws_websocket_handler_new(&ws_options));
+    ASSERT_INT_EQUALS(AWS_ERROR_INVALID_ARGUMENT, aws_last_error());
+
+    ASSERT_SUCCESS(testing_channel_clean_up(&testing_channel));
+    aws_http_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
 TEST_CASE(websocket_midchannel_sanity_check) {
     (void)ctx;
     struct tester tester;